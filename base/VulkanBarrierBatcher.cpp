@@ -0,0 +1,338 @@
+/*
+* Image barrier batching
+*
+* Tracks the layout and last access of every subresource of registered images, derives minimal stage and access masks for transitions
+* and records all pending transitions with a single pipeline barrier
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanBarrierBatcher.h"
+#include <assert.h>
+
+namespace vks
+{
+	// Accesses that have to be made available before the subresource is used again, reads only need an execution dependency
+	static const VkAccessFlags2 writeAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+	static bool operator==(const BarrierBatcher::State &a, const BarrierBatcher::State &b)
+	{
+		return (a.layout == b.layout) && (a.stages == b.stages) && (a.access == b.access);
+	}
+
+	/**
+	* @param device Logical device the batcher records barriers for
+	* @param synchronization2 True if the synchronization2 feature (Vulkan 1.3 or VK_KHR_synchronization2) has been enabled on the device
+	*/
+	BarrierBatcher::BarrierBatcher(VkDevice device, bool synchronization2)
+	{
+		if (synchronization2)
+		{
+			vkCmdPipelineBarrier2KHR = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2KHR"));
+			if (!vkCmdPipelineBarrier2KHR)
+			{
+				vkCmdPipelineBarrier2KHR = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2"));
+			}
+		}
+	}
+
+	/** @brief Layout, stages and accesses of the commands using an image in the given way */
+	BarrierBatcher::State BarrierBatcher::getState(Usage usage)
+	{
+		State state{};
+		switch (usage)
+		{
+		case Usage::Undefined:
+			break;
+		case Usage::TransferSrc:
+			state = { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT };
+			break;
+		case Usage::TransferDst:
+			state = { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT };
+			break;
+		case Usage::ColorAttachment:
+			state = { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT };
+			break;
+		case Usage::DepthStencilAttachment:
+			state = { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+			break;
+		case Usage::DepthStencilReadOnly:
+			state = { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT };
+			break;
+		case Usage::SampledFragment:
+			state = { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT };
+			break;
+		case Usage::SampledCompute:
+			state = { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT };
+			break;
+		case Usage::SampledGraphics:
+			state = { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT };
+			break;
+		case Usage::InputAttachment:
+			state = { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_INPUT_ATTACHMENT_READ_BIT };
+			break;
+		case Usage::StorageCompute:
+			state = { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT };
+			break;
+		case Usage::Present:
+			// Presentation is ordered by semaphores, the acquire semaphore's wait stages have to cover the next usage
+			state = { VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE };
+			break;
+		}
+		return state;
+	}
+
+	/**
+	* Start tracking an image, all subresources are in the state of the given usage
+	*
+	* @param image Image to track
+	* @param aspectMask Aspects of the image, used for the subresource ranges of the barriers
+	* @param mipLevels Number of mip levels of the image
+	* @param layerCount Number of array layers of the image
+	* @param usage Current usage of the image, Usage::Undefined for images that haven't been used yet
+	*/
+	void BarrierBatcher::track(VkImage image, VkImageAspectFlags aspectMask, uint32_t mipLevels, uint32_t layerCount, Usage usage)
+	{
+		Image &target = images[image];
+		target.aspectMask = aspectMask;
+		target.mipLevels = mipLevels;
+		target.layerCount = layerCount;
+		target.subresources.assign(mipLevels * layerCount, Subresource{});
+		target.pending = false;
+		assume(image, usage);
+	}
+
+	void BarrierBatcher::track(vks::Texture &texture, Usage usage)
+	{
+		track(texture.image, VK_IMAGE_ASPECT_COLOR_BIT, texture.mipLevels, texture.layerCount, usage);
+	}
+
+	/** @brief Stop tracking an image, e.g. before it's destroyed, pending transitions are discarded */
+	void BarrierBatcher::untrack(VkImage image)
+	{
+		images.erase(image);
+	}
+
+	/** @brief Set the state of all subresources without a barrier, for usages that changed outside of the batcher (e.g. by render passes) */
+	void BarrierBatcher::assume(VkImage image, Usage usage)
+	{
+		auto it = images.find(image);
+		assert(it != images.end());
+		const State state = getState(usage);
+		for (auto &subresource : it->second.subresources)
+		{
+			subresource.state = state;
+			subresource.pending = false;
+		}
+		it->second.pending = false;
+	}
+
+	/**
+	* Request a transition of all subresources of an image to the given usage, recorded with the next flush()
+	*
+	* @param discard Don't preserve the contents, the transition starts from the undefined layout
+	*/
+	void BarrierBatcher::transition(VkImage image, Usage usage, bool discard)
+	{
+		auto it = images.find(image);
+		assert(it != images.end());
+		transition(image, usage, { it->second.aspectMask, 0, it->second.mipLevels, 0, it->second.layerCount }, discard);
+	}
+
+	void BarrierBatcher::transition(VkImage image, Usage usage, const VkImageSubresourceRange &subresourceRange, bool discard)
+	{
+		assert(usage != Usage::Undefined);
+		auto it = images.find(image);
+		assert(it != images.end());
+		Image &target = it->second;
+		const State next = getState(usage);
+		const uint32_t levelCount = (subresourceRange.levelCount == VK_REMAINING_MIP_LEVELS) ? target.mipLevels - subresourceRange.baseMipLevel : subresourceRange.levelCount;
+		const uint32_t layerCount = (subresourceRange.layerCount == VK_REMAINING_ARRAY_LAYERS) ? target.layerCount - subresourceRange.baseArrayLayer : subresourceRange.layerCount;
+		assert(subresourceRange.baseMipLevel + levelCount <= target.mipLevels);
+		assert(subresourceRange.baseArrayLayer + layerCount <= target.layerCount);
+		statistics.transitions++;
+		bool required = false;
+		for (uint32_t level = subresourceRange.baseMipLevel; level < subresourceRange.baseMipLevel + levelCount; level++)
+		{
+			for (uint32_t layer = subresourceRange.baseArrayLayer; layer < subresourceRange.baseArrayLayer + layerCount; layer++)
+			{
+				Subresource &subresource = target.subresources[level * target.layerCount + layer];
+				State &current = subresource.state;
+				// Reads in the same layout don't depend on each other, the readers are accumulated for the next transition to wait on
+				// This also merges readers into a pending transition to the same layout
+				if (!discard && (current.layout == next.layout) && !(current.access & writeAccessMask) && !(next.access & writeAccessMask))
+				{
+					current.stages |= next.stages;
+					current.access |= next.access;
+					required |= subresource.pending;
+					continue;
+				}
+				if (!subresource.pending)
+				{
+					subresource.before = current;
+					subresource.pending = true;
+				}
+				if (discard)
+				{
+					subresource.before.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+				}
+				// Transitions of a subresource between flushes have no commands in between, only the last usage is kept
+				current = next;
+				required = true;
+			}
+		}
+		target.pending |= required;
+		if (!required)
+		{
+			statistics.dropped++;
+		}
+	}
+
+	/** @brief Transition all subresources of a texture, its layout and the layout of its descriptor are updated */
+	void BarrierBatcher::transition(vks::Texture &texture, Usage usage, bool discard)
+	{
+		transition(texture.image, usage, discard);
+		texture.imageLayout = getState(usage).layout;
+		texture.descriptor.imageLayout = texture.imageLayout;
+	}
+
+	// Barriers for the pending subresources of an image, layers and then mip levels with the same transition are merged into one range
+	void BarrierBatcher::addBarriers(VkImage image, Image &target, std::vector<VkImageMemoryBarrier2> &barriers)
+	{
+		const size_t firstBarrier = barriers.size();
+		for (uint32_t level = 0; level < target.mipLevels; level++)
+		{
+			uint32_t layer = 0;
+			while (layer < target.layerCount)
+			{
+				Subresource &first = target.subresources[level * target.layerCount + layer];
+				// Merged transitions that returned to the layout they started from without writes in between don't need a barrier
+				if (first.pending && (first.before.layout == first.state.layout) && !(first.before.access & writeAccessMask) && !(first.state.access & writeAccessMask))
+				{
+					first.state.stages |= first.before.stages;
+					first.state.access |= first.before.access;
+					first.pending = false;
+				}
+				if (!first.pending)
+				{
+					layer++;
+					continue;
+				}
+				uint32_t runLength = 1;
+				while (layer + runLength < target.layerCount)
+				{
+					const Subresource &next = target.subresources[level * target.layerCount + layer + runLength];
+					if (!next.pending || !(next.before == first.before) || !(next.state == first.state))
+					{
+						break;
+					}
+					runLength++;
+				}
+				// Extend a barrier of the previous mip level with the same layers and transition
+				bool merged = false;
+				for (size_t i = firstBarrier; i < barriers.size(); i++)
+				{
+					VkImageMemoryBarrier2 &barrier = barriers[i];
+					const VkImageSubresourceRange &range = barrier.subresourceRange;
+					if ((range.baseMipLevel + range.levelCount == level) && (range.baseArrayLayer == layer) && (range.layerCount == runLength)
+						&& (barrier.oldLayout == first.before.layout) && (barrier.newLayout == first.state.layout)
+						&& (barrier.srcStageMask == first.before.stages) && (barrier.srcAccessMask == (first.before.access & writeAccessMask))
+						&& (barrier.dstStageMask == first.state.stages) && (barrier.dstAccessMask == first.state.access))
+					{
+						barrier.subresourceRange.levelCount++;
+						merged = true;
+						break;
+					}
+				}
+				if (!merged)
+				{
+					VkImageMemoryBarrier2 barrier{};
+					barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+					barrier.srcStageMask = first.before.stages;
+					barrier.srcAccessMask = first.before.access & writeAccessMask;
+					barrier.dstStageMask = first.state.stages;
+					barrier.dstAccessMask = first.state.access;
+					barrier.oldLayout = first.before.layout;
+					barrier.newLayout = first.state.layout;
+					barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.image = image;
+					barrier.subresourceRange = { target.aspectMask, level, 1, layer, runLength };
+					barriers.push_back(barrier);
+				}
+				for (uint32_t i = 0; i < runLength; i++)
+				{
+					target.subresources[level * target.layerCount + layer + i].pending = false;
+				}
+				layer += runLength;
+			}
+		}
+		target.pending = false;
+	}
+
+	/** @brief Record all pending transitions into the command buffer with one barrier, nothing is recorded if there are none */
+	void BarrierBatcher::flush(VkCommandBuffer commandBuffer)
+	{
+		std::vector<VkImageMemoryBarrier2> barriers;
+		for (auto &image : images)
+		{
+			if (image.second.pending)
+			{
+				addBarriers(image.first, image.second, barriers);
+			}
+		}
+		if (barriers.empty())
+		{
+			return;
+		}
+		statistics.barriers += static_cast<uint32_t>(barriers.size());
+		statistics.calls++;
+		if (vkCmdPipelineBarrier2KHR)
+		{
+			VkDependencyInfo dependencyInfo{};
+			dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+			dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+			dependencyInfo.pImageMemoryBarriers = barriers.data();
+			vkCmdPipelineBarrier2KHR(commandBuffer, &dependencyInfo);
+			return;
+		}
+		// The states only use stages and accesses that exist in the legacy flags, with the same bit values
+		VkPipelineStageFlags srcStageMask = 0;
+		VkPipelineStageFlags dstStageMask = 0;
+		std::vector<VkImageMemoryBarrier> legacyBarriers(barriers.size());
+		for (size_t i = 0; i < barriers.size(); i++)
+		{
+			const VkImageMemoryBarrier2 &barrier = barriers[i];
+			VkImageMemoryBarrier &legacyBarrier = legacyBarriers[i];
+			legacyBarrier = vks::initializers::imageMemoryBarrier();
+			legacyBarrier.srcAccessMask = static_cast<VkAccessFlags>(barrier.srcAccessMask);
+			legacyBarrier.dstAccessMask = static_cast<VkAccessFlags>(barrier.dstAccessMask);
+			legacyBarrier.oldLayout = barrier.oldLayout;
+			legacyBarrier.newLayout = barrier.newLayout;
+			legacyBarrier.image = barrier.image;
+			legacyBarrier.subresourceRange = barrier.subresourceRange;
+			srcStageMask |= static_cast<VkPipelineStageFlags>(barrier.srcStageMask);
+			dstStageMask |= static_cast<VkPipelineStageFlags>(barrier.dstStageMask);
+		}
+		vkCmdPipelineBarrier(commandBuffer, srcStageMask ? srcStageMask : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT), dstStageMask ? dstStageMask : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT), 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(legacyBarriers.size()), legacyBarriers.data());
+	}
+
+	/** @brief Layout of a subresource after the transitions requested so far */
+	VkImageLayout BarrierBatcher::getLayout(VkImage image, uint32_t mipLevel, uint32_t layer) const
+	{
+		auto it = images.find(image);
+		assert(it != images.end());
+		return it->second.subresources[mipLevel * it->second.layerCount + layer].state.layout;
+	}
+
+	const BarrierBatcher::Statistics &BarrierBatcher::getStatistics() const
+	{
+		return statistics;
+	}
+
+	void BarrierBatcher::resetStatistics()
+	{
+		statistics = {};
+	}
+}
@@ -0,0 +1,111 @@
+/*
+* Image barrier batching
+*
+* Tracks the layout and last access of every subresource of registered images, derives minimal stage and access masks for transitions
+* and records all pending transitions with a single pipeline barrier
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanTexture.h"
+
+namespace vks
+{
+	/**
+	* Batches image layout transitions and memory dependencies into one barrier per flush
+	*
+	* Usage:
+	*	vks::BarrierBatcher barriers(device, synchronization2Enabled);
+	*	barriers.track(colorImage, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, vks::BarrierBatcher::Usage::SampledFragment);
+	*	barriers.track(texture, vks::BarrierBatcher::Usage::SampledFragment);
+	*	// While recording
+	*	barriers.transition(colorImage, vks::BarrierBatcher::Usage::TransferSrc);
+	*	barriers.transition(texture, vks::BarrierBatcher::Usage::TransferDst);
+	*	barriers.flush(commandBuffer);	// One barrier for both images
+	*	vkCmdCopyImage(...);
+	*
+	* Every usage has a layout and the stages and accesses of the commands using the image that way (see getState()). A transition only waits
+	* for the stages that last used the subresource and only makes its writes available, read after read in the same layout is dropped and the
+	* readers are accumulated, so the next write waits for all of them. Transitions of the same subresource before a flush are merged into one
+	* with the layout before the first and the usage of the last transition, subresources with equal states are merged into one range.
+	*
+	* @note Changes made outside of the batcher (e.g. by a render pass's final layout) have to be reported with assume()
+	* @note Depth and stencil aspects of an image are tracked together
+	* @note With synchronization2 the barriers are recorded with vkCmdPipelineBarrier2, the feature has to be enabled on the device, otherwise
+	* they are recorded with vkCmdPipelineBarrier using the equivalent legacy masks
+	*/
+	class BarrierBatcher
+	{
+	public:
+		enum class Usage {
+			// Contents are discarded, only valid for track() and assume()
+			Undefined,
+			TransferSrc,
+			TransferDst,
+			ColorAttachment,
+			DepthStencilAttachment,
+			DepthStencilReadOnly,
+			SampledFragment,
+			SampledCompute,
+			SampledGraphics,
+			InputAttachment,
+			StorageCompute,
+			Present
+		};
+
+		struct State {
+			VkImageLayout layout;
+			VkPipelineStageFlags2 stages;
+			VkAccessFlags2 access;
+			State() : layout(VK_IMAGE_LAYOUT_UNDEFINED), stages(VK_PIPELINE_STAGE_2_NONE), access(VK_ACCESS_2_NONE) {}
+			State(VkImageLayout layout, VkPipelineStageFlags2 stages, VkAccessFlags2 access) : layout(layout), stages(stages), access(access) {}
+		};
+
+		/** @brief Number of transitions requested, dropped as redundant and barriers and barrier calls recorded since the last resetStatistics() */
+		struct Statistics {
+			uint32_t transitions = 0;
+			uint32_t dropped = 0;
+			uint32_t barriers = 0;
+			uint32_t calls = 0;
+		};
+
+		BarrierBatcher(VkDevice device, bool synchronization2);
+		static State getState(Usage usage);
+		void track(VkImage image, VkImageAspectFlags aspectMask, uint32_t mipLevels, uint32_t layerCount, Usage usage);
+		void track(vks::Texture &texture, Usage usage);
+		void untrack(VkImage image);
+		void assume(VkImage image, Usage usage);
+		void transition(VkImage image, Usage usage, bool discard = false);
+		void transition(VkImage image, Usage usage, const VkImageSubresourceRange &subresourceRange, bool discard = false);
+		void transition(vks::Texture &texture, Usage usage, bool discard = false);
+		void flush(VkCommandBuffer commandBuffer);
+		VkImageLayout getLayout(VkImage image, uint32_t mipLevel = 0, uint32_t layer = 0) const;
+		const Statistics &getStatistics() const;
+		void resetStatistics();
+	private:
+		struct Subresource {
+			State state;
+			// State at the last flush, only valid while pending
+			State before;
+			bool pending = false;
+		};
+		struct Image {
+			VkImageAspectFlags aspectMask;
+			uint32_t mipLevels;
+			uint32_t layerCount;
+			// Indexed by mip level * layer count + layer
+			std::vector<Subresource> subresources;
+			bool pending = false;
+		};
+		std::unordered_map<VkImage, Image> images;
+		PFN_vkCmdPipelineBarrier2KHR vkCmdPipelineBarrier2KHR = nullptr;
+		Statistics statistics;
+		void addBarriers(VkImage image, Image &target, std::vector<VkImageMemoryBarrier2> &barriers);
+	};
+}
@@ -0,0 +1,370 @@
+/*
+* Compute bloom
+*
+* Progressive downsample and tent filter upsample of the bright parts of an image through a mip chain, for bloom whose cost doesn't
+* depend on the blur radius and that can be shared by the examples' tone mapping passes
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanBloom.h"
+#include "VulkanDevice.h"
+#include <algorithm>
+
+namespace vks
+{
+	const VkFormat BloomChain::format;
+
+	// Work group size of both shaders in both dimensions
+	static const uint32_t bloomGroupSize = 8;
+
+	/**
+	* @param device Device to create the compute pipelines on
+	* @param downsampleShaderFile SPIR-V file of the "base/bloomdownsample.comp" shader
+	* @param upsampleShaderFile SPIR-V file of the "base/bloomupsample.comp" shader
+	* @param maxLevelCount Maximum number of levels of the chain, more levels spread the bloom further
+	*
+	* @note If the chain format can't be used as a storage image or a shader can't be loaded, no pipelines are created and isSupported() returns false
+	*/
+	BloomChain::BloomChain(vks::VulkanDevice *device, const std::string &downsampleShaderFile, const std::string &upsampleShaderFile, uint32_t maxLevelCount) : device(device), maxLevelCount(std::max(maxLevelCount, 1u))
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+		const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+		if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures)
+		{
+			return;
+		}
+
+#if defined(__ANDROID__)
+		downsampleModule = vks::tools::loadShader(androidApp->activity->assetManager, downsampleShaderFile.c_str(), device->logicalDevice);
+		upsampleModule = vks::tools::loadShader(androidApp->activity->assetManager, upsampleShaderFile.c_str(), device->logicalDevice);
+#else
+		downsampleModule = vks::tools::loadShader(downsampleShaderFile.c_str(), device->logicalDevice);
+		upsampleModule = vks::tools::loadShader(upsampleShaderFile.c_str(), device->logicalDevice);
+#endif
+		if ((downsampleModule == VK_NULL_HANDLE) || (upsampleModule == VK_NULL_HANDLE))
+		{
+			return;
+		}
+
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+		samplerCreateInfo.maxAnisotropy = 1.0f;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+
+		// Both passes read a coarser or finer image through the sampler and write one level of the chain
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCI.stage.pName = "main";
+		pipelineCI.stage.module = downsampleModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &downsamplePipeline));
+		pipelineCI.stage.module = upsampleModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &upsamplePipeline));
+
+		supported = true;
+	}
+
+	BloomChain::~BloomChain()
+	{
+		destroyImage();
+		if (downsamplePipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, downsamplePipeline, nullptr);
+		}
+		if (upsamplePipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, upsamplePipeline, nullptr);
+		}
+		if (pipelineLayout)
+		{
+			vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		}
+		if (descriptorSetLayout)
+		{
+			vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		}
+		if (sampler)
+		{
+			vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		}
+		if (downsampleModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, downsampleModule, nullptr);
+		}
+		if (upsampleModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, upsampleModule, nullptr);
+		}
+	}
+
+	void BloomChain::destroyImage()
+	{
+		for (VkImageView levelView : levelViews)
+		{
+			vkDestroyImageView(device->logicalDevice, levelView, nullptr);
+		}
+		levelViews.clear();
+		downsampleSets.clear();
+		upsampleSets.clear();
+		if (descriptorPool)
+		{
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+			descriptorPool = VK_NULL_HANDLE;
+		}
+		if (image)
+		{
+			vkDestroyImage(device->logicalDevice, image, nullptr);
+			device->freeMemory(memory, allocation);
+			image = VK_NULL_HANDLE;
+			memory = VK_NULL_HANDLE;
+			allocation = vks::MemoryAllocation{};
+		}
+		descriptor = VkDescriptorImageInfo{};
+	}
+
+	uint32_t BloomChain::getLevelWidth(uint32_t level) const
+	{
+		return std::max(srcWidth >> (level + 1), 1u);
+	}
+
+	uint32_t BloomChain::getLevelHeight(uint32_t level) const
+	{
+		return std::max(srcHeight >> (level + 1), 1u);
+	}
+
+	/** @brief True if the chain format is supported and both pipelines have been created */
+	bool BloomChain::isSupported() const
+	{
+		return supported;
+	}
+
+	/**
+	* Create the chain for a source image, replacing the previous one (e.g. after a resize)
+	*
+	* @param width Width of the source image
+	* @param height Height of the source image
+	* @param srcView View of the first mip level of the source image
+	* @param srcLayout Layout of the source image while record() reads it, e.g. VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	*
+	* @note The previous chain must not be in use anymore
+	*/
+	void BloomChain::create(uint32_t width, uint32_t height, VkImageView srcView, VkImageLayout srcLayout)
+	{
+		if (!supported)
+		{
+			return;
+		}
+		destroyImage();
+		srcWidth = std::max(width, 2u);
+		srcHeight = std::max(height, 2u);
+		// Levels stop before they get smaller than the tent filter
+		levelCount = 1;
+		while ((levelCount < maxLevelCount) && (std::min(getLevelWidth(levelCount), getLevelHeight(levelCount)) >= 2))
+		{
+			levelCount++;
+		}
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = format;
+		imageCI.extent = { getLevelWidth(0), getLevelHeight(0), 1 };
+		imageCI.mipLevels = levelCount;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &image));
+		VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memory, &allocation));
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = format;
+		viewCI.image = image;
+		levelViews.resize(levelCount);
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &levelViews[level]));
+		}
+		descriptor = { sampler, levelViews[0], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+		// The downsample reads the source image (first level) or the previous level, the upsample reads the next level and adds it to its level
+		const uint32_t setCount = 2 * levelCount - 1;
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, setCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+		std::vector<VkDescriptorSetLayout> setLayouts(setCount, descriptorSetLayout);
+		std::vector<VkDescriptorSet> descriptorSets(setCount);
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, setLayouts.data(), setCount);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, descriptorSets.data()));
+		downsampleSets.assign(descriptorSets.begin(), descriptorSets.begin() + levelCount);
+		upsampleSets.assign(descriptorSets.begin() + levelCount, descriptorSets.end());
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			VkDescriptorImageInfo srcDescriptor = (level == 0) ? VkDescriptorImageInfo{ sampler, srcView, srcLayout } : VkDescriptorImageInfo{ sampler, levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorImageInfo dstDescriptor = { VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(downsampleSets[level], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &srcDescriptor),
+				vks::initializers::writeDescriptorSet(downsampleSets[level], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &dstDescriptor),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+		for (uint32_t level = 0; level < levelCount - 1; level++)
+		{
+			VkDescriptorImageInfo srcDescriptor = { sampler, levelViews[level + 1], VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorImageInfo dstDescriptor = { VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(upsampleSets[level], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &srcDescriptor),
+				vks::initializers::writeDescriptorSet(upsampleSets[level], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &dstDescriptor),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+	}
+
+	/**
+	* Record the downsample and upsample passes through all levels of the chain, outside of a render pass
+	*
+	* @note The source image has to be in the layout passed to create() and its writes have to be made visible to compute shader reads before this
+	* @note The threshold and radius are passed as push constants, they only apply to command buffers recorded after changing them
+	*/
+	void BloomChain::record(VkCommandBuffer commandBuffer)
+	{
+		if (!supported || (image == VK_NULL_HANDLE))
+		{
+			return;
+		}
+		// The previous contents are discarded, all levels stay in the general layout while they are written and read by the dispatches
+		VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageBarrier.srcAccessMask = 0;
+		imageBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageBarrier.image = image;
+		imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		PushConstants pushConstants{};
+		pushConstants.threshold = threshold;
+		pushConstants.knee = knee;
+		pushConstants.radius = radius;
+
+		// Downsample, each level is the source of the next one
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, downsamplePipeline);
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			pushConstants.srcTexelSize[0] = 1.0f / static_cast<float>((level == 0) ? srcWidth : getLevelWidth(level - 1));
+			pushConstants.srcTexelSize[1] = 1.0f / static_cast<float>((level == 0) ? srcHeight : getLevelHeight(level - 1));
+			pushConstants.dstWidth = static_cast<int32_t>(getLevelWidth(level));
+			pushConstants.dstHeight = static_cast<int32_t>(getLevelHeight(level));
+			pushConstants.prefilter = (level == 0) ? 1 : 0;
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &downsampleSets[level], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, (pushConstants.dstWidth + bloomGroupSize - 1) / bloomGroupSize, (pushConstants.dstHeight + bloomGroupSize - 1) / bloomGroupSize, 1);
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		// Upsample from the coarsest level, each level accumulates all coarser ones before it's read by the next finer one
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, upsamplePipeline);
+		pushConstants.prefilter = 0;
+		for (uint32_t level = levelCount - 1; level-- > 0;)
+		{
+			pushConstants.srcTexelSize[0] = 1.0f / static_cast<float>(getLevelWidth(level + 1));
+			pushConstants.srcTexelSize[1] = 1.0f / static_cast<float>(getLevelHeight(level + 1));
+			pushConstants.dstWidth = static_cast<int32_t>(getLevelWidth(level));
+			pushConstants.dstHeight = static_cast<int32_t>(getLevelHeight(level));
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &upsampleSets[level], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, (pushConstants.dstWidth + bloomGroupSize - 1) / bloomGroupSize, (pushConstants.dstHeight + bloomGroupSize - 1) / bloomGroupSize, 1);
+			if (level > 0)
+			{
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+		}
+
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+	}
+
+	/**
+	* Set the brightness above which the source contributes to the bloom
+	*
+	* @param threshold Brightness (maximum color component) at which the source fully contributes
+	* @param knee Width of the soft transition below the threshold, 0 for a hard cut
+	*/
+	void BloomChain::setThreshold(float threshold, float knee)
+	{
+		this->threshold = std::max(threshold, 0.0f);
+		this->knee = std::max(knee, 0.0f);
+	}
+
+	/** @brief Set the tent filter radius in texels of the coarser level (1 = adjacent texels), values above 1 widen the bloom at the same cost */
+	void BloomChain::setRadius(float radius)
+	{
+		this->radius = std::max(radius, 0.0f);
+	}
+
+	float BloomChain::getRadius() const
+	{
+		return radius;
+	}
+
+	VkImage BloomChain::getImage() const
+	{
+		return image;
+	}
+
+	/** @brief View of the first (finest) level, which holds the result */
+	VkImageView BloomChain::getView() const
+	{
+		return descriptor.imageView;
+	}
+
+	VkSampler BloomChain::getSampler() const
+	{
+		return sampler;
+	}
+
+	/** @brief Descriptor of the result in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL with the chain's linear sampler */
+	const VkDescriptorImageInfo &BloomChain::getDescriptor() const
+	{
+		return descriptor;
+	}
+
+	uint32_t BloomChain::getLevelCount() const
+	{
+		return levelCount;
+	}
+}
@@ -0,0 +1,100 @@
+/*
+* Compute bloom
+*
+* Progressive downsample and tent filter upsample of the bright parts of an image through a mip chain, for bloom whose cost doesn't
+* depend on the blur radius and that can be shared by the examples' tone mapping passes
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanMemoryAllocator.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Bloom mip chain builder using the "base/bloomdownsample.comp" and "base/bloomupsample.comp" compute shaders
+	*
+	* Usage:
+	*	vks::BloomChain bloomChain(vulkanDevice, getShadersPath() + "base/bloomdownsample.comp.spv", getShadersPath() + "base/bloomupsample.comp.spv");
+	*	bloomChain.create(width, height, colorView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);	// and again on resize
+	*	// Per frame, after the source image has been written and transitioned to the layout passed to create()
+	*	bloomChain.record(commandBuffer);
+	*	// Add texture(bloom, uv).rgb * intensity to the color before tone mapping, using bloomChain.getDescriptor()
+	*
+	* The first level has half the size of the source image, every further level half the size of the previous one. The downsample pass filters
+	* the source with a 13 tap filter, only keeping the part above the threshold for the first level. The upsample pass then walks back up the
+	* chain, adding a 3x3 tent filtered version of each coarser level onto the next finer one. Every level is visited once in each direction,
+	* so a larger radius costs the same as a small one: the radius only scales the tent filter footprint, the number of levels bounds the spread.
+	*
+	* @note The source image needs to be created with VK_IMAGE_USAGE_SAMPLED_BIT, it's read with linear filtering
+	* @note The chain is in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL after record(), compute and fragment shaders can read it without further barriers
+	*/
+	class BloomChain
+	{
+	private:
+		struct PushConstants {
+			float srcTexelSize[2];
+			int32_t dstWidth;
+			int32_t dstHeight;
+			float threshold;
+			float knee;
+			float radius;
+			// Applying the threshold when reading the source image
+			uint32_t prefilter;
+		};
+		vks::VulkanDevice *device;
+		bool supported = false;
+		uint32_t srcWidth = 0;
+		uint32_t srcHeight = 0;
+		uint32_t levelCount = 0;
+		uint32_t maxLevelCount;
+		float threshold = 1.0f;
+		float knee = 0.5f;
+		float radius = 1.0f;
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		vks::MemoryAllocation allocation{};
+		// One view per level, the first one is also the consumers' view
+		std::vector<VkImageView> levelViews;
+		// Sets of the downsample (one per level) and the upsample (one per level except the last) pass
+		std::vector<VkDescriptorSet> downsampleSets;
+		std::vector<VkDescriptorSet> upsampleSets;
+		VkDescriptorImageInfo descriptor{};
+		VkShaderModule downsampleModule = VK_NULL_HANDLE;
+		VkShaderModule upsampleModule = VK_NULL_HANDLE;
+		// Linear filtering with clamp to edge addressing, used by both passes and for consumers
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline downsamplePipeline = VK_NULL_HANDLE;
+		VkPipeline upsamplePipeline = VK_NULL_HANDLE;
+		void destroyImage();
+		uint32_t getLevelWidth(uint32_t level) const;
+		uint32_t getLevelHeight(uint32_t level) const;
+	public:
+		static const VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+		BloomChain(vks::VulkanDevice *device, const std::string &downsampleShaderFile, const std::string &upsampleShaderFile, uint32_t maxLevelCount = 6);
+		~BloomChain();
+		bool isSupported() const;
+		void create(uint32_t width, uint32_t height, VkImageView srcView, VkImageLayout srcLayout);
+		void record(VkCommandBuffer commandBuffer);
+		void setThreshold(float threshold, float knee);
+		void setRadius(float radius);
+		float getRadius() const;
+		VkImage getImage() const;
+		VkImageView getView() const;
+		VkSampler getSampler() const;
+		const VkDescriptorImageInfo &getDescriptor() const;
+		uint32_t getLevelCount() const;
+	};
+}
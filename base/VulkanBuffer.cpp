@@ -9,6 +9,7 @@
 */
 
 #include "VulkanBuffer.h"
+#include "VulkanCommandCapture.h"
 
 namespace vks
 {	
@@ -19,22 +20,53 @@ namespace vks
 	* @param offset (Optional) Byte offset from beginning
 	* 
 	* @return VkResult of the buffer mapping call
+	*
+	* @note With vks::CommandCapture::enableMappingTracking() the mapped range is registered for capture and replay, unless the buffer is only a transfer source (staging)
+	* @note Host visible buffers created by VulkanDevice::createBuffer are persistently mapped and already mapped after creation, map() only sets the pointer
 	*/
 	VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset)
 	{
-		return vkMapMemory(device, memory, offset, size, 0, &mapped);
+		VkResult result = VK_SUCCESS;
+		if (mapped)
+		{
+			vks::CommandCapture::unregisterMapping(mapped);
+		}
+		if (hostMapping)
+		{
+			mapped = static_cast<char*>(hostMapping) + offset;
+		}
+		else if (allocator)
+		{
+			// Sub-allocated memory that isn't host visible
+			return VK_ERROR_MEMORY_MAP_FAILED;
+		}
+		else
+		{
+			result = vkMapMemory(device, memory, offset, size, 0, &mapped);
+		}
+		if ((result == VK_SUCCESS) && vks::CommandCapture::mappingTrackingEnabled() && (this->size > offset) && (usageFlags != VK_BUFFER_USAGE_TRANSFER_SRC_BIT))
+		{
+			const VkDeviceSize rangeSize = (size == VK_WHOLE_SIZE) ? this->size - offset : size;
+			vks::CommandCapture::registerMapping(mapped, rangeSize, device, memory, allocation.offset + offset, (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0);
+		}
+		return result;
 	}
 
 	/**
 	* Unmap a mapped memory range
 	*
 	* @note Does not return a result as vkUnmapMemory can't fail
+	* @note Persistently mapped memory stays mapped until the buffer is destroyed, only mapped is reset
 	*/
 	void Buffer::unmap()
 	{
 		if (mapped)
 		{
-			vkUnmapMemory(device, memory);
+			vks::CommandCapture::unregisterMapping(mapped);
+			if (!hostMapping)
+			{
+				vkUnmapMemory(device, memory);
+			}
 			mapped = nullptr;
 		}
 	}
@@ -48,7 +80,7 @@ namespace vks
 	*/
 	VkResult Buffer::bind(VkDeviceSize offset)
 	{
-		return vkBindBufferMemory(device, buffer, memory, offset);
+		return vkBindBufferMemory(device, buffer, memory, allocation.offset + offset);
 	}
 
 	/**
@@ -90,14 +122,42 @@ namespace vks
 	*/
 	VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset)
 	{
+		if (hostCoherent)
+		{
+			return VK_SUCCESS;
+		}
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
+		mappedRange.offset = allocation.offset + offset;
+		mappedRange.size = (allocator && size == VK_WHOLE_SIZE) ? allocation.size - offset : size;
 		return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
 	}
 
+	/**
+	* Mark a memory range of the buffer as written by the host, to be flushed with the next batched flush (see VulkanDevice::flushMappedRanges())
+	*
+	* @note Does nothing for coherent memory, ranges of buffers without a flush batch are flushed immediately
+	*
+	* @param size (Optional) Size of the written memory range. Pass VK_WHOLE_SIZE to mark the complete buffer range.
+	* @param offset (Optional) Byte offset from beginning
+	*
+	* @return VK_SUCCESS, or the result of the immediate flush
+	*/
+	VkResult Buffer::markDirty(VkDeviceSize size, VkDeviceSize offset)
+	{
+		if (hostCoherent)
+		{
+			return VK_SUCCESS;
+		}
+		if (!flushBatch)
+		{
+			return flush(size, offset);
+		}
+		flushBatch->add(memory, allocation.offset + offset, (allocator && size == VK_WHOLE_SIZE) ? allocation.size - offset : size);
+		return VK_SUCCESS;
+	}
+
 	/**
 	* Invalidate a memory range of the buffer to make it visible to the host
 	*
@@ -110,26 +170,60 @@ namespace vks
 	*/
 	VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset)
 	{
+		if (hostCoherent)
+		{
+			return VK_SUCCESS;
+		}
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
+		mappedRange.offset = allocation.offset + offset;
+		mappedRange.size = (allocator && size == VK_WHOLE_SIZE) ? allocation.size - offset : size;
 		return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
 	}
 
 	/** 
 	* Release all Vulkan resources held by this buffer
 	*/
+	/**
+	* Device address of the buffer for shaders reading it through a buffer reference
+	*
+	* @param offset (Optional) Byte offset from beginning
+	*
+	* @note The buffer must have been created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, see VulkanDevice::createDeviceAddressBuffer()
+	*/
+	VkDeviceAddress Buffer::getDeviceAddress(VkDeviceSize offset) const
+	{
+		assert(deviceAddress != 0);
+		return deviceAddress + offset;
+	}
+
 	void Buffer::destroy()
 	{
+		if (mapped)
+		{
+			vks::CommandCapture::unregisterMapping(mapped);
+		}
 		if (buffer)
 		{
 			vkDestroyBuffer(device, buffer, nullptr);
 		}
-		if (memory)
+		if (allocator)
+		{
+			allocator->free(allocation);
+			allocator = nullptr;
+		}
+		else if (memory)
 		{
+			if (tracker)
+			{
+				tracker->remove(memory);
+				tracker = nullptr;
+			}
 			vkFreeMemory(device, memory, nullptr);
 		}
+		deviceAddress = 0;
+		hostMapping = nullptr;
+		mapped = nullptr;
 	}
 };
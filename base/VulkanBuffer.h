@@ -14,6 +14,8 @@
 
 #include "vulkan/vulkan.h"
 #include "VulkanTools.h"
+#include "VulkanMappedRangeBatch.h"
+#include "VulkanMemoryAllocator.h"
 
 namespace vks
 {	
@@ -34,13 +36,29 @@ namespace vks
 		VkBufferUsageFlags usageFlags;
 		/** @brief Memory property flags to be filled by external source at buffer creation (to query at some later point) */
 		VkMemoryPropertyFlags memoryPropertyFlags;
+		/** @brief Allocator the memory has been sub-allocated from, nullptr if the buffer owns its memory */
+		vks::MemoryAllocator* allocator = nullptr;
+		/** @brief Range of memory used by the buffer if it has been sub-allocated */
+		vks::MemoryAllocation allocation;
+		/** @brief Tracker the buffer's own memory has been registered with, nullptr if not tracked */
+		vks::MemoryTracker* tracker = nullptr;
+		/** @brief Device address of buffers created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 0 otherwise */
+		VkDeviceAddress deviceAddress = 0;
+		/** @brief Persistent mapping of the start of the buffer's memory range, set by VulkanDevice::createBuffer for host visible memory */
+		void* hostMapping = nullptr;
+		/** @brief True if the buffer's memory type is host coherent, flushes and invalidations are skipped */
+		bool hostCoherent = false;
+		/** @brief Batch that collects the ranges passed to markDirty() for non-coherent memory, nullptr to flush them immediately */
+		vks::MappedRangeBatch* flushBatch = nullptr;
 		VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 		void unmap();
 		VkResult bind(VkDeviceSize offset = 0);
 		void setupDescriptor(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 		void copyTo(void* data, VkDeviceSize size);
 		VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		VkResult markDirty(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 		VkResult invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		VkDeviceAddress getDeviceAddress(VkDeviceSize offset = 0) const;
 		void destroy();
 	};
 }
\ No newline at end of file
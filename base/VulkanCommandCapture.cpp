@@ -0,0 +1,245 @@
+/*
+* Command stream capture and replay
+*
+* Captures the command buffers submitted and the contents of the mapped buffers for a range of frames, and replays them in a loop with
+* the captured buffer contents, so benchmarks measure the GPU cost of the frames without the example's CPU side updates
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanCommandCapture.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+namespace vks
+{
+	namespace
+	{
+		struct Mapping {
+			uint64_t id;
+			void *data;
+			VkDeviceSize size;
+			VkDevice device;
+			VkDeviceMemory memory;
+			VkDeviceSize memoryOffset;
+			bool coherent;
+		};
+
+		// Buffers may be mapped and destroyed by the worker threads of examples, so the registry is guarded by a mutex
+		struct MappingRegistry {
+			std::atomic<bool> enabled{ false };
+			std::mutex mutex;
+			std::vector<Mapping> mappings;
+			uint64_t nextId = 1;
+		};
+
+		MappingRegistry &mappingRegistry()
+		{
+			static MappingRegistry registry;
+			return registry;
+		}
+	}
+
+	/** @brief Track the ranges mapped by vks::Buffer::map() from now on, has to be called before the buffers to capture are mapped */
+	void CommandCapture::enableMappingTracking()
+	{
+		mappingRegistry().enabled = true;
+	}
+
+	bool CommandCapture::mappingTrackingEnabled()
+	{
+		return mappingRegistry().enabled;
+	}
+
+	void CommandCapture::registerMapping(void *data, VkDeviceSize size, VkDevice device, VkDeviceMemory memory, VkDeviceSize memoryOffset, bool coherent)
+	{
+		MappingRegistry &registry = mappingRegistry();
+		if (!registry.enabled || (data == nullptr) || (size == 0))
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.mappings.push_back({ registry.nextId++, data, size, device, memory, memoryOffset, coherent });
+	}
+
+	void CommandCapture::unregisterMapping(void *data)
+	{
+		MappingRegistry &registry = mappingRegistry();
+		if (!registry.enabled)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.mappings.erase(std::remove_if(registry.mappings.begin(), registry.mappings.end(), [data](const Mapping &mapping) { return mapping.data == data; }), registry.mappings.end());
+	}
+
+	/** @brief Start capturing the next frameCount frames, replaces a previous capture */
+	void CommandCapture::begin(uint32_t frameCount)
+	{
+		reset();
+		this->frameCount = std::max(frameCount, 1u);
+		frames.reserve(this->frameCount);
+		state = State::Capturing;
+	}
+
+	/**
+	* Store the command buffers of the frame's submission and the mapped ranges that changed since the previous captured frame
+	*
+	* @param submitInfo Submit info the example submitted the frame with
+	* @param imageCommandBuffers Command buffers of the swap chain images (drawCmdBuffers)
+	* @param imageIndex Index of the swap chain image the frame has been rendered to
+	*
+	* @note Stops capturing without a capture (state Idle) if the submit info has no command buffers, and switches to replaying once frameCount frames have been captured
+	*/
+	void CommandCapture::captureFrame(const VkSubmitInfo &submitInfo, const std::vector<VkCommandBuffer> &imageCommandBuffers, uint32_t imageIndex)
+	{
+		if (state != State::Capturing)
+		{
+			return;
+		}
+		if ((submitInfo.commandBufferCount == 0) || (submitInfo.pCommandBuffers == nullptr))
+		{
+			reset();
+			return;
+		}
+
+		Frame frame;
+		frame.commandBuffers.assign(submitInfo.pCommandBuffers, submitInfo.pCommandBuffers + submitInfo.commandBufferCount);
+		if (imageIndex < imageCommandBuffers.size())
+		{
+			auto imageCommandBuffer = std::find(frame.commandBuffers.begin(), frame.commandBuffers.end(), imageCommandBuffers[imageIndex]);
+			if (imageCommandBuffer != frame.commandBuffers.end())
+			{
+				frame.imageCommandBuffer = static_cast<int32_t>(std::distance(frame.commandBuffers.begin(), imageCommandBuffer));
+			}
+		}
+
+		MappingRegistry &registry = mappingRegistry();
+		{
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			std::vector<RangeData> currentRanges;
+			currentRanges.reserve(registry.mappings.size());
+			for (const Mapping &mapping : registry.mappings)
+			{
+				auto last = std::find_if(lastRanges.begin(), lastRanges.end(), [&mapping](const RangeData &range) { return range.rangeId == mapping.id; });
+				const bool changed = frames.empty() || (last == lastRanges.end()) || (last->data.size() != mapping.size) || (memcmp(last->data.data(), mapping.data, static_cast<size_t>(mapping.size)) != 0);
+				if (changed)
+				{
+					RangeData range{ mapping.id, std::vector<uint8_t>(static_cast<const uint8_t*>(mapping.data), static_cast<const uint8_t*>(mapping.data) + mapping.size) };
+					statistics.storedBytes += range.data.size();
+					frame.ranges.push_back(range);
+					currentRanges.push_back(std::move(range));
+				}
+				else
+				{
+					currentRanges.push_back(std::move(*last));
+				}
+			}
+			// Ranges unmapped since the previous frame are dropped
+			lastRanges = std::move(currentRanges);
+			statistics.mappedRanges = std::max(statistics.mappedRanges, static_cast<uint32_t>(registry.mappings.size()));
+		}
+
+		frames.push_back(std::move(frame));
+		statistics.frames = static_cast<uint32_t>(frames.size());
+		if (frames.size() >= frameCount)
+		{
+			finish();
+		}
+	}
+
+	/** @brief Stop capturing and replay the frames captured so far, without any captured frames the capture is reset */
+	void CommandCapture::finish()
+	{
+		if (frames.empty())
+		{
+			reset();
+			return;
+		}
+		lastRanges.clear();
+		lastRanges.shrink_to_fit();
+		replayFrameIndex = 0;
+		state = State::Replaying;
+	}
+
+	void CommandCapture::reset()
+	{
+		state = State::Idle;
+		frames.clear();
+		lastRanges.clear();
+		replayCommandBuffers.clear();
+		replayFrameIndex = 0;
+		statistics = Statistics();
+	}
+
+	/**
+	* Restore the mapped ranges of the next captured frame and return its command buffers for submission
+	*
+	* @param imageCommandBuffers Command buffers of the swap chain images (drawCmdBuffers)
+	* @param imageIndex Index of the acquired swap chain image, the frame's image command buffer is replaced with the one of this image
+	*
+	* @note Must be called after the frame's command buffers and the previous users of the mapped memory have finished (i.e. after prepareFrame())
+	*/
+	const std::vector<VkCommandBuffer> &CommandCapture::replayFrame(const std::vector<VkCommandBuffer> &imageCommandBuffers, uint32_t imageIndex)
+	{
+		replayCommandBuffers.clear();
+		if (state != State::Replaying)
+		{
+			return replayCommandBuffers;
+		}
+		const Frame &frame = frames[replayFrameIndex];
+		MappingRegistry &registry = mappingRegistry();
+		{
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			for (const RangeData &range : frame.ranges)
+			{
+				auto mapping = std::find_if(registry.mappings.begin(), registry.mappings.end(), [&range](const Mapping &mapping) { return mapping.id == range.rangeId; });
+				// Buffers destroyed since the capture are skipped
+				if ((mapping == registry.mappings.end()) || (mapping->size != range.data.size()))
+				{
+					continue;
+				}
+				memcpy(mapping->data, range.data.data(), range.data.size());
+				if (!mapping->coherent)
+				{
+					VkMappedMemoryRange mappedRange{};
+					mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+					mappedRange.memory = mapping->memory;
+					mappedRange.offset = mapping->memoryOffset;
+					mappedRange.size = mapping->size;
+					vkFlushMappedMemoryRanges(mapping->device, 1, &mappedRange);
+				}
+			}
+		}
+		replayCommandBuffers.insert(replayCommandBuffers.end(), frame.commandBuffers.begin(), frame.commandBuffers.end());
+		if ((frame.imageCommandBuffer >= 0) && (imageIndex < imageCommandBuffers.size()))
+		{
+			replayCommandBuffers[frame.imageCommandBuffer] = imageCommandBuffers[imageIndex];
+		}
+		replayFrameIndex = (replayFrameIndex + 1) % static_cast<uint32_t>(frames.size());
+		statistics.replayedFrames++;
+		return replayCommandBuffers;
+	}
+
+	CommandCapture::State CommandCapture::getState() const
+	{
+		return state;
+	}
+
+	bool CommandCapture::isCapturing() const
+	{
+		return state == State::Capturing;
+	}
+
+	bool CommandCapture::isReplaying() const
+	{
+		return state == State::Replaying;
+	}
+
+	const CommandCapture::Statistics &CommandCapture::getStatistics() const
+	{
+		return statistics;
+	}
+}
@@ -0,0 +1,101 @@
+/*
+* Command stream capture and replay
+*
+* Captures the command buffers submitted and the contents of the mapped buffers for a range of frames, and replays them in a loop with
+* the captured buffer contents, so benchmarks measure the GPU cost of the frames without the example's CPU side updates
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	/**
+	* Capture of the submissions of a range of frames, replayed with the uniform data stream the example wrote for them
+	*
+	* Usage:
+	*	// Before any buffer is mapped (e.g. when parsing the command line)
+	*	vks::CommandCapture::enableMappingTracking();
+	*	capture.begin(frameCount);
+	*	// In submitFrame(), after the example submitted the frame with submitInfo
+	*	if (capture.isCapturing()) {
+	*		capture.captureFrame(submitInfo, drawCmdBuffers, currentBuffer);
+	*	}
+	*	// Once capture.isReplaying(), instead of the example's render()
+	*	prepareFrame();
+	*	const std::vector<VkCommandBuffer>& commandBuffers = capture.replayFrame(drawCmdBuffers, currentBuffer);
+	*	// Submit commandBuffers with submitInfo and call submitFrame()
+	*
+	* vks::Buffer::map() registers the mapped ranges of buffers read by the GPU (staging only buffers are left out) while tracking is enabled.
+	* After each captured frame the registered ranges are compared against their contents after the previous frame, and only the ranges that
+	* changed are stored. The first captured frame stores all ranges, so replaying it after the last frame restores the state the loop started
+	* with. Replaying a frame copies its stored ranges back before its command buffers are submitted again.
+	*
+	* @note Only the command buffers of the base class' submitInfo are captured, submissions of the example with its own VkSubmitInfo (e.g.
+	* a separate compute submission) aren't replayed. Command buffers recorded every frame are replayed with their last recorded commands.
+	* @note Memory mapped with vkMapMemory instead of vks::Buffer::map() isn't captured, and neither are uploads through staging buffers, so
+	* examples updating device local resources every frame replay the state of the last captured frame
+	* @note The command buffers must not be recorded with VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	*/
+	class CommandCapture
+	{
+	public:
+		enum class State {
+			Idle = 0,
+			Capturing = 1,
+			Replaying = 2,
+		};
+
+		struct Statistics {
+			uint32_t frames = 0;
+			uint32_t mappedRanges = 0;
+			// Bytes of mapped memory stored over all captured frames
+			size_t storedBytes = 0;
+			// Frames replayed since the capture finished
+			uint64_t replayedFrames = 0;
+		};
+
+		static void enableMappingTracking();
+		static bool mappingTrackingEnabled();
+		/** @brief Register a mapped range of device memory, called by vks::Buffer::map() */
+		static void registerMapping(void *data, VkDeviceSize size, VkDevice device, VkDeviceMemory memory, VkDeviceSize memoryOffset, bool coherent);
+		/** @brief Remove the mapped range starting at data, called when a vks::Buffer is unmapped or destroyed */
+		static void unregisterMapping(void *data);
+
+	private:
+		// Contents of a registered range stored for a frame
+		struct RangeData {
+			uint64_t rangeId;
+			std::vector<uint8_t> data;
+		};
+		struct Frame {
+			std::vector<VkCommandBuffer> commandBuffers;
+			// Index of the entry of commandBuffers that is the acquired image's command buffer (replaced with the one of the image acquired when replaying), -1 if none
+			int32_t imageCommandBuffer = -1;
+			std::vector<RangeData> ranges;
+		};
+		State state = State::Idle;
+		uint32_t frameCount = 0;
+		uint32_t replayFrameIndex = 0;
+		std::vector<Frame> frames;
+		// Contents of the registered ranges after the last captured frame
+		std::vector<RangeData> lastRanges;
+		std::vector<VkCommandBuffer> replayCommandBuffers;
+		Statistics statistics;
+	public:
+		void begin(uint32_t frameCount);
+		void captureFrame(const VkSubmitInfo &submitInfo, const std::vector<VkCommandBuffer> &imageCommandBuffers, uint32_t imageIndex);
+		void finish();
+		void reset();
+		const std::vector<VkCommandBuffer> &replayFrame(const std::vector<VkCommandBuffer> &imageCommandBuffers, uint32_t imageIndex);
+		State getState() const;
+		bool isCapturing() const;
+		bool isReplaying() const;
+		const Statistics &getStatistics() const;
+	};
+}
@@ -257,5 +257,73 @@ namespace vks
 			setObjectName(device, (uint64_t)_event, VK_DEBUG_REPORT_OBJECT_TYPE_EVENT_EXT, name);
 		}
 	};
-}
 
+	namespace debugutils
+	{
+		bool active = false;
+
+		PFN_vkCmdBeginDebugUtilsLabelEXT vkCmdBeginDebugUtilsLabelEXT = VK_NULL_HANDLE;
+		PFN_vkCmdEndDebugUtilsLabelEXT vkCmdEndDebugUtilsLabelEXT = VK_NULL_HANDLE;
+		PFN_vkCmdInsertDebugUtilsLabelEXT vkCmdInsertDebugUtilsLabelEXT = VK_NULL_HANDLE;
+		PFN_vkSetDebugUtilsObjectNameEXT vkSetDebugUtilsObjectNameEXT = VK_NULL_HANDLE;
+
+		void setup(VkInstance instance)
+		{
+			vkCmdBeginDebugUtilsLabelEXT = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT"));
+			vkCmdEndDebugUtilsLabelEXT = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT"));
+			vkCmdInsertDebugUtilsLabelEXT = reinterpret_cast<PFN_vkCmdInsertDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkCmdInsertDebugUtilsLabelEXT"));
+			vkSetDebugUtilsObjectNameEXT = reinterpret_cast<PFN_vkSetDebugUtilsObjectNameEXT>(vkGetInstanceProcAddr(instance, "vkSetDebugUtilsObjectNameEXT"));
+
+			active = (vkCmdBeginDebugUtilsLabelEXT != VK_NULL_HANDLE) && (vkCmdEndDebugUtilsLabelEXT != VK_NULL_HANDLE) && (vkSetDebugUtilsObjectNameEXT != VK_NULL_HANDLE);
+		}
+
+		void cmdBeginLabel(VkCommandBuffer cmdbuffer, const char* caption, glm::vec4 color)
+		{
+			if (!active)
+			{
+				return;
+			}
+			VkDebugUtilsLabelEXT labelInfo{};
+			labelInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+			labelInfo.pLabelName = caption;
+			memcpy(labelInfo.color, &color[0], sizeof(float) * 4);
+			vkCmdBeginDebugUtilsLabelEXT(cmdbuffer, &labelInfo);
+		}
+
+		void cmdEndLabel(VkCommandBuffer cmdbuffer)
+		{
+			if (!active)
+			{
+				return;
+			}
+			vkCmdEndDebugUtilsLabelEXT(cmdbuffer);
+		}
+
+		void cmdInsertLabel(VkCommandBuffer cmdbuffer, const char* caption, glm::vec4 color)
+		{
+			if (!active || !vkCmdInsertDebugUtilsLabelEXT)
+			{
+				return;
+			}
+			VkDebugUtilsLabelEXT labelInfo{};
+			labelInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+			labelInfo.pLabelName = caption;
+			memcpy(labelInfo.color, &color[0], sizeof(float) * 4);
+			vkCmdInsertDebugUtilsLabelEXT(cmdbuffer, &labelInfo);
+		}
+
+		void setObjectName(VkDevice device, VkObjectType objectType, uint64_t object, const char* name)
+		{
+			if (!active || (object == 0))
+			{
+				return;
+			}
+			VkDebugUtilsObjectNameInfoEXT nameInfo{};
+			nameInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+			nameInfo.objectType = objectType;
+			nameInfo.objectHandle = object;
+			nameInfo.pObjectName = name;
+			vkSetDebugUtilsObjectNameEXT(device, &nameInfo);
+		}
+	}
+}
@@ -91,4 +91,26 @@ namespace vks
 		void setFenceName(VkDevice device, VkFence fence, const char * name);
 		void setEventName(VkDevice device, VkEvent _event, const char * name);
 	};
+
+	// Labels and object names through VK_EXT_debug_utils, shown by RenderDoc, Nsight and in validation messages
+	// The base class enables the instance extension whenever it's available, labels are ignored if no tool is attached
+	// The framework labels the GPU profiler scopes, render graph passes and base render passes, and names buffers and texture images at creation
+	namespace debugutils
+	{
+		// Set to true if the function pointers of the extension are available
+		extern bool active;
+
+		// Get the function pointers of the extension from the instance
+		void setup(VkInstance instance);
+
+		// Start a labeled region in a command buffer, regions may be nested and must end in the command buffer they began in
+		void cmdBeginLabel(VkCommandBuffer cmdbuffer, const char* caption, glm::vec4 color);
+		// End the innermost labeled region
+		void cmdEndLabel(VkCommandBuffer cmdbuffer);
+		// Insert a single label into a command buffer
+		void cmdInsertLabel(VkCommandBuffer cmdbuffer, const char* caption, glm::vec4 color);
+
+		// Sets the debug name of an object, all handles are passed as their 64-bit value
+		void setObjectName(VkDevice device, VkObjectType objectType, uint64_t object, const char* name);
+	}
 }
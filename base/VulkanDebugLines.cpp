@@ -0,0 +1,434 @@
+/*
+* Debug line renderer
+*
+* Batches debug lines (normals, bounds, skeletons, light volumes) from the host and from compute shaders into a GPU writable line
+* buffer that is drawn with a single indirect draw, without geometry shaders
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanDebugLines.h"
+#include "VulkanDevice.h"
+#include "VulkanStartupReport.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <glm/gtc/constants.hpp>
+
+namespace vks
+{
+	// Work group size of the normals shader
+	static const uint32_t normalsGroupSize = 64;
+	// The host line count is stored behind the draw command, beginAppend() copies it into the draw's vertex count
+	static const VkDeviceSize hostVertexCountOffset = sizeof(VkDrawIndirectCommand);
+	// The view projection matrix follows, read by the vertex shader at execution time
+	static const VkDeviceSize viewProjectionOffset = 32;
+
+	/**
+	* @param device Device to create the pipelines and buffers on
+	* @param renderPass Render pass the lines are drawn in
+	* @param pipelineCache Pipeline cache used for creating the pipelines
+	* @param slotCount Number of command buffers that can draw lines independently, usually the number of draw command buffers
+	* @param vertexShaderFile SPIR-V file of the "base/debuglines.vert" shader
+	* @param fragmentShaderFile SPIR-V file of the "base/debuglines.frag" shader
+	* @param normalsShaderFile SPIR-V file of the "base/debugnormals.comp" shader, may be empty if appendNormals() isn't used
+	* @param maxLines Number of lines each slot can hold, host and GPU lines combined
+	* @param maxSources Maximum number of vertex buffers that can be passed to addVertexSource()
+	* @param rasterizationSamples Sample count of the render pass
+	* @param subpass Index of the subpass of the render pass the lines are drawn in
+	*/
+	DebugLineRenderer::DebugLineRenderer(vks::VulkanDevice *device, VkRenderPass renderPass, VkPipelineCache pipelineCache, uint32_t slotCount, const std::string &vertexShaderFile, const std::string &fragmentShaderFile, const std::string &normalsShaderFile, uint32_t maxLines, uint32_t maxSources, VkSampleCountFlagBits rasterizationSamples, uint32_t subpass) : device(device), maxLines(maxLines), maxSources(maxSources)
+	{
+		// The vertices are bound at an offset behind the header, which has to meet the storage buffer offset alignment
+		const VkDeviceSize minAlignment = std::max<VkDeviceSize>(device->properties.limits.minStorageBufferOffsetAlignment, 32);
+		headerSize = (viewProjectionOffset + sizeof(glm::mat4) + minAlignment - 1) / minAlignment * minAlignment;
+		const VkDeviceSize verticesSize = static_cast<VkDeviceSize>(maxLines) * 2 * sizeof(LineVertex);
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Draw command written by the compute shaders, and the view projection matrix
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Line vertices, pulled by the vertex shader
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &lineSetLayout));
+		setLayoutBindings = {
+			// Binding 0: Source vertices, read as floats
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		};
+		descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &sourceSetLayout));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, slotCount * 2 + maxSources),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, slotCount + maxSources);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+
+		slots.resize(slotCount);
+		for (Slot &slot : slots)
+		{
+			// Host visible, so lines can be added without staging, the compute shaders write the few lines they append straight into it
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&slot.buffer,
+				headerSize + verticesSize));
+			VK_CHECK_RESULT(slot.buffer.map());
+			memset(slot.buffer.mapped, 0, static_cast<size_t>(headerSize));
+			VkDrawIndirectCommand *drawCommand = static_cast<VkDrawIndirectCommand*>(slot.buffer.mapped);
+			drawCommand->instanceCount = 1;
+			const glm::mat4 identity(1.0f);
+			memcpy(static_cast<uint8_t*>(slot.buffer.mapped) + viewProjectionOffset, &identity, sizeof(glm::mat4));
+
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &lineSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &slot.descriptorSet));
+			VkDescriptorBufferInfo drawCommandDescriptor = { slot.buffer.buffer, 0, headerSize };
+			VkDescriptorBufferInfo verticesDescriptor = { slot.buffer.buffer, headerSize, verticesSize };
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(slot.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &drawCommandDescriptor),
+				vks::initializers::writeDescriptorSet(slot.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &verticesDescriptor),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+
+		// Line drawing, the vertices are pulled from the slot's buffer by the vertex index
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&lineSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &drawPipelineLayout));
+
+		// Depth tested against the scene, but not written, so overlapping lines don't hide each other
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_LINE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(rasterizationSamples, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStages[0].pName = "main";
+		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderStages[1].pName = "main";
+#if defined(__ANDROID__)
+		shaderStages[0].module = vks::tools::loadShader(androidApp->activity->assetManager, vertexShaderFile.c_str(), device->logicalDevice);
+		shaderStages[1].module = vks::tools::loadShader(androidApp->activity->assetManager, fragmentShaderFile.c_str(), device->logicalDevice);
+#else
+		shaderStages[0].module = vks::tools::loadShader(vertexShaderFile.c_str(), device->logicalDevice);
+		shaderStages[1].module = vks::tools::loadShader(fragmentShaderFile.c_str(), device->logicalDevice);
+#endif
+		assert((shaderStages[0].module != VK_NULL_HANDLE) && (shaderStages[1].module != VK_NULL_HANDLE));
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(drawPipelineLayout, renderPass, 0);
+		pipelineCI.pVertexInputState = &vertexInputState;
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		pipelineCI.subpass = subpass;
+		{
+			VKS_STARTUP_SCOPE(vks::StartupReport::Pipeline, "debug lines");
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &drawPipeline));
+		}
+		for (const VkPipelineShaderStageCreateInfo &shaderStage : shaderStages)
+		{
+			vkDestroyShaderModule(device->logicalDevice, shaderStage.module, nullptr);
+		}
+
+		// Normal lines generated from a vertex buffer, appended to the slot's lines
+		if (!normalsShaderFile.empty())
+		{
+			const std::array<VkDescriptorSetLayout, 2> setLayouts = { lineSetLayout, sourceSetLayout };
+			VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(NormalsPushConstants), 0);
+			pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
+			pipelineLayoutCI.pushConstantRangeCount = 1;
+			pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &normalsPipelineLayout));
+
+			VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(normalsPipelineLayout, 0);
+			computePipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			computePipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			computePipelineCI.stage.pName = "main";
+#if defined(__ANDROID__)
+			computePipelineCI.stage.module = vks::tools::loadShader(androidApp->activity->assetManager, normalsShaderFile.c_str(), device->logicalDevice);
+#else
+			computePipelineCI.stage.module = vks::tools::loadShader(normalsShaderFile.c_str(), device->logicalDevice);
+#endif
+			assert(computePipelineCI.stage.module != VK_NULL_HANDLE);
+			{
+				VKS_STARTUP_SCOPE(vks::StartupReport::Pipeline, "debug normals");
+				VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCI, nullptr, &normalsPipeline));
+			}
+			vkDestroyShaderModule(device->logicalDevice, computePipelineCI.stage.module, nullptr);
+		}
+	}
+
+	DebugLineRenderer::~DebugLineRenderer()
+	{
+		vkDestroyPipeline(device->logicalDevice, drawPipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, drawPipelineLayout, nullptr);
+		if (normalsPipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, normalsPipeline, nullptr);
+			vkDestroyPipelineLayout(device->logicalDevice, normalsPipelineLayout, nullptr);
+		}
+		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, lineSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, sourceSetLayout, nullptr);
+		for (Slot &slot : slots)
+		{
+			slot.buffer.destroy();
+		}
+	}
+
+	DebugLineRenderer::LineVertex *DebugLineRenderer::hostVertices()
+	{
+		return reinterpret_cast<LineVertex*>(static_cast<uint8_t*>(slots[hostSlot].buffer.mapped) + headerSize);
+	}
+
+	/**
+	* Register a vertex buffer that normals can be generated from with appendNormals()
+	*
+	* @param buffer Vertex buffer, has to be created with VK_BUFFER_USAGE_STORAGE_BUFFER_BIT (e.g. through vkglTF::memoryPropertyFlags)
+	* @param range Size of the vertex data
+	*
+	* @return Index of the source to pass to appendNormals()
+	*/
+	uint32_t DebugLineRenderer::addVertexSource(VkBuffer buffer, VkDeviceSize range)
+	{
+		assert(sourceDescriptorSets.size() < maxSources);
+		VkDescriptorSet descriptorSet;
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &sourceSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+		VkDescriptorBufferInfo sourceDescriptor = { buffer, 0, range };
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &sourceDescriptor);
+		vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+		sourceDescriptorSets.push_back(descriptorSet);
+		return static_cast<uint32_t>(sourceDescriptorSets.size()) - 1;
+	}
+
+	/**
+	* Start replacing the host lines of a slot
+	*
+	* @note The slot's command buffer must not be pending execution
+	*/
+	void DebugLineRenderer::begin(uint32_t slot)
+	{
+		assert(!hostRecording);
+		hostSlot = slot;
+		hostLineCount = 0;
+		hostRecording = true;
+	}
+
+	/** @brief Add a line in world space, must be called between begin() and end() */
+	void DebugLineRenderer::addLine(const glm::vec3 &start, const glm::vec3 &end, const glm::vec4 &color)
+	{
+		addLine(start, end, color, color);
+	}
+
+	/** @brief Add a line in world space with a color gradient, must be called between begin() and end() */
+	void DebugLineRenderer::addLine(const glm::vec3 &start, const glm::vec3 &end, const glm::vec4 &startColor, const glm::vec4 &endColor)
+	{
+		assert(hostRecording);
+		if (hostLineCount >= maxLines)
+		{
+			return;
+		}
+		LineVertex *vertices = hostVertices() + hostLineCount * 2;
+		vertices[0] = { glm::vec4(start, 1.0f), startColor };
+		vertices[1] = { glm::vec4(end, 1.0f), endColor };
+		hostLineCount++;
+	}
+
+	/** @brief Add the edges of a box, e.g. the bounds of a model or node */
+	void DebugLineRenderer::addBox(const glm::vec3 &min, const glm::vec3 &max, const glm::mat4 &transform, const glm::vec4 &color)
+	{
+		std::array<glm::vec3, 8> corners;
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			const glm::vec3 corner((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+			corners[i] = glm::vec3(transform * glm::vec4(corner, 1.0f));
+		}
+		// Corners that differ in a single axis bit are connected
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			for (uint32_t axis = 1; axis < 8; axis <<= 1)
+			{
+				if ((i & axis) == 0)
+				{
+					addLine(corners[i], corners[i | axis], color);
+				}
+			}
+		}
+	}
+
+	/** @brief Add a sphere as three circles around the main axes, e.g. for the volume of a point light */
+	void DebugLineRenderer::addSphere(const glm::vec3 &center, float radius, const glm::vec4 &color, uint32_t segments)
+	{
+		const float step = glm::two_pi<float>() / static_cast<float>(segments);
+		for (uint32_t i = 0; i < segments; i++)
+		{
+			const float a0 = step * static_cast<float>(i);
+			const float a1 = step * static_cast<float>(i + 1);
+			const glm::vec2 p0 = glm::vec2(cos(a0), sin(a0)) * radius;
+			const glm::vec2 p1 = glm::vec2(cos(a1), sin(a1)) * radius;
+			addLine(center + glm::vec3(p0.x, p0.y, 0.0f), center + glm::vec3(p1.x, p1.y, 0.0f), color);
+			addLine(center + glm::vec3(p0.x, 0.0f, p0.y), center + glm::vec3(p1.x, 0.0f, p1.y), color);
+			addLine(center + glm::vec3(0.0f, p0.x, p0.y), center + glm::vec3(0.0f, p1.x, p1.y), color);
+		}
+	}
+
+	/** @brief Add the x (red), y (green) and z (blue) axes of a transform */
+	void DebugLineRenderer::addAxes(const glm::mat4 &transform, float size)
+	{
+		const glm::vec3 origin = glm::vec3(transform[3]);
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			glm::vec4 color(0.0f, 0.0f, 0.0f, 1.0f);
+			color[axis] = 1.0f;
+			addLine(origin, origin + glm::vec3(transform[axis]) * size, color);
+		}
+	}
+
+	/**
+	* Add the bones of a skeleton as lines from each joint to its parent
+	*
+	* @param jointMatrices World transforms of the joints (not multiplied with the inverse bind matrices)
+	* @param parents Index of each joint's parent joint in jointMatrices, negative for root joints
+	* @param color Color of the bones
+	*/
+	void DebugLineRenderer::addSkeleton(const std::vector<glm::mat4> &jointMatrices, const std::vector<int32_t> &parents, const glm::vec4 &color)
+	{
+		assert(jointMatrices.size() == parents.size());
+		for (size_t i = 0; i < jointMatrices.size(); i++)
+		{
+			if (parents[i] >= 0)
+			{
+				addLine(glm::vec3(jointMatrices[parents[i]][3]), glm::vec3(jointMatrices[i][3]), color);
+			}
+		}
+	}
+
+	/**
+	* Set the matrix transforming the world space lines of a slot to clip space, read when the slot's command buffer is executed
+	*
+	* @note The slot's command buffer must not be pending execution
+	*/
+	void DebugLineRenderer::setViewProjection(uint32_t slot, const glm::mat4 &viewProjection)
+	{
+		memcpy(static_cast<uint8_t*>(slots[slot].buffer.mapped) + viewProjectionOffset, &viewProjection, sizeof(glm::mat4));
+	}
+
+	/** @brief Finish the host lines of the slot passed to begin(), they are drawn by the slot's next submission */
+	void DebugLineRenderer::end()
+	{
+		assert(hostRecording);
+		uint8_t *mapped = static_cast<uint8_t*>(slots[hostSlot].buffer.mapped);
+		const uint32_t hostVertexCount = hostLineCount * 2;
+		memcpy(mapped + hostVertexCountOffset, &hostVertexCount, sizeof(uint32_t));
+		hostRecording = false;
+	}
+
+	/**
+	* Reset the slot's draw to the host lines, so GPU lines can be appended for this execution of the command buffer
+	*
+	* @note Must be recorded outside of a render pass
+	*/
+	void DebugLineRenderer::beginAppend(VkCommandBuffer commandBuffer, uint32_t slot)
+	{
+		const Slot &target = slots[slot];
+		VkBufferCopy copyRegion = { hostVertexCountOffset, 0, sizeof(uint32_t) };
+		vkCmdCopyBuffer(commandBuffer, target.buffer.buffer, target.buffer.buffer, 1, &copyRegion);
+
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = target.buffer.buffer;
+		bufferBarrier.offset = 0;
+		bufferBarrier.size = sizeof(VkDrawIndirectCommand);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+	}
+
+	/**
+	* Append a line along the normal of each vertex of a vertex buffer, generated in a compute shader
+	*
+	* @param commandBuffer Command buffer of the slot, between beginAppend() and endAppend()
+	* @param slot Slot to append the lines to
+	* @param source Index returned by addVertexSource()
+	* @param vertexCount Number of vertices
+	* @param vertexStride Size of a vertex in bytes, must be a multiple of 4
+	* @param positionOffset Offset of the position (3 floats) in a vertex in bytes
+	* @param normalOffset Offset of the normal (3 floats) in a vertex in bytes
+	* @param transform Transforms the vertices to world space
+	* @param length Length of the lines in world space
+	* @param baseColor Color at the vertex
+	* @param tipColor Color at the end of the normal
+	*/
+	void DebugLineRenderer::appendNormals(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t source, uint32_t vertexCount, uint32_t vertexStride, uint32_t positionOffset, uint32_t normalOffset, const glm::mat4 &transform, float length, const glm::vec4 &baseColor, const glm::vec4 &tipColor)
+	{
+		assert(normalsPipeline != VK_NULL_HANDLE);
+		if (vertexCount == 0)
+		{
+			return;
+		}
+		NormalsPushConstants pushConstants{};
+		pushConstants.transform = transform;
+		pushConstants.baseColor = baseColor;
+		pushConstants.tipColor = tipColor;
+		pushConstants.vertexCount = vertexCount;
+		pushConstants.vertexStride = vertexStride / sizeof(float);
+		pushConstants.positionOffset = positionOffset / sizeof(float);
+		pushConstants.normalOffset = normalOffset / sizeof(float);
+		pushConstants.length = length;
+		const std::array<VkDescriptorSet, 2> descriptorSets = { slots[slot].descriptorSet, sourceDescriptorSets[source] };
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, normalsPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, normalsPipelineLayout, 0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
+		vkCmdPushConstants(commandBuffer, normalsPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(NormalsPushConstants), &pushConstants);
+		vkCmdDispatch(commandBuffer, (vertexCount + normalsGroupSize - 1) / normalsGroupSize, 1, 1);
+	}
+
+	/**
+	* Make the appended lines and the final line count visible to the draw
+	*
+	* @note Must be recorded outside of a render pass
+	*/
+	void DebugLineRenderer::endAppend(VkCommandBuffer commandBuffer, uint32_t slot)
+	{
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = slots[slot].buffer.buffer;
+		bufferBarrier.offset = 0;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+	}
+
+	/**
+	* Draw all lines of a slot with a single indirect draw
+	*
+	* @param commandBuffer Command buffer inside the render pass passed to the constructor, with viewport and scissor set
+	* @param slot Slot to draw the lines of, transformed with the matrix passed to setViewProjection()
+	*/
+	void DebugLineRenderer::draw(VkCommandBuffer commandBuffer, uint32_t slot)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipelineLayout, 0, 1, &slots[slot].descriptorSet, 0, nullptr);
+		vkCmdDrawIndirect(commandBuffer, slots[slot].buffer.buffer, 0, 1, sizeof(VkDrawIndirectCommand));
+	}
+}
@@ -0,0 +1,113 @@
+/*
+* Debug line renderer
+*
+* Batches debug lines (normals, bounds, skeletons, light volumes) from the host and from compute shaders into a GPU writable line
+* buffer that is drawn with a single indirect draw, without geometry shaders
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Debug line batching using the "base/debuglines.vert", "base/debuglines.frag" and "base/debugnormals.comp" shaders
+	*
+	* Usage:
+	*	vks::DebugLineRenderer debugLines(vulkanDevice, renderPass, pipelineCache, drawCmdBuffers.size(), getShadersPath() + "base/debuglines.vert.spv", getShadersPath() + "base/debuglines.frag.spv", getShadersPath() + "base/debugnormals.comp.spv");
+	*	uint32_t source = debugLines.addVertexSource(model.vertices.buffer);	// Needs storage buffer usage
+	*	// Per command buffer, outside of the render pass
+	*	debugLines.beginAppend(commandBuffer, i);
+	*	debugLines.appendNormals(commandBuffer, i, source, vertexCount, sizeof(vkglTF::Vertex), offsetof(vkglTF::Vertex, pos), offsetof(vkglTF::Vertex, normal), glm::mat4(1.0f), 0.02f);
+	*	debugLines.endAppend(commandBuffer, i);
+	*	// Inside the render pass
+	*	debugLines.draw(commandBuffer, i);
+	*	// Per frame, once the slot's command buffer has finished execution (e.g. after prepareFrame() with slot = currentBuffer)
+	*	debugLines.setViewProjection(currentBuffer, camera.matrices.perspective * camera.matrices.view);
+	*	debugLines.begin(currentBuffer);
+	*	debugLines.addBox(model.dimensions.min, model.dimensions.max, glm::mat4(1.0f), glm::vec4(1.0f, 1.0f, 0.0f, 1.0f));
+	*	debugLines.end();
+	*
+	* Each slot (usually one per draw command buffer) has a host visible buffer starting with a VkDrawIndirectCommand and the view
+	* projection matrix, followed by the line vertices. Lines added on the host are written straight into the slot's buffer,
+	* beginAppend() resets the draw to these lines, and compute shaders append theirs behind them with an atomic add on the draw's
+	* vertex count. The vertex shader pulls the vertices from the buffer, so any number of lines from any number of sources is one
+	* vkCmdDrawIndirect. Command buffers can be recorded once, as the host line count and the matrix are read at execution time.
+	*
+	* @note Lines beyond the capacity passed to the constructor are dropped
+	* @note beginAppend() and endAppend() have to be recorded (outside of a render pass) before every draw, even without appends in between
+	*/
+	class DebugLineRenderer
+	{
+	private:
+		// Matches the line vertices of the shaders (std430)
+		struct LineVertex {
+			glm::vec4 position;
+			glm::vec4 color;
+		};
+		// Matches the push constants of debugnormals.comp
+		struct NormalsPushConstants {
+			glm::mat4 transform;
+			glm::vec4 baseColor;
+			glm::vec4 tipColor;
+			uint32_t vertexCount;
+			uint32_t vertexStride;
+			uint32_t positionOffset;
+			uint32_t normalOffset;
+			float length;
+		};
+		struct Slot {
+			vks::Buffer buffer;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		};
+		vks::VulkanDevice *device;
+		std::vector<Slot> slots;
+		uint32_t maxLines;
+		// Size of the draw command, host line count and matrix in front of the vertices, aligned for the vertex descriptor's offset
+		VkDeviceSize headerSize = 0;
+		// Slot and number of lines added on the host between begin() and end()
+		uint32_t hostSlot = 0;
+		uint32_t hostLineCount = 0;
+		bool hostRecording = false;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout lineSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout sourceSetLayout = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet> sourceDescriptorSets;
+		uint32_t maxSources;
+		VkPipelineLayout drawPipelineLayout = VK_NULL_HANDLE;
+		VkPipelineLayout normalsPipelineLayout = VK_NULL_HANDLE;
+		VkPipeline drawPipeline = VK_NULL_HANDLE;
+		VkPipeline normalsPipeline = VK_NULL_HANDLE;
+		LineVertex *hostVertices();
+	public:
+		DebugLineRenderer(vks::VulkanDevice *device, VkRenderPass renderPass, VkPipelineCache pipelineCache, uint32_t slotCount, const std::string &vertexShaderFile, const std::string &fragmentShaderFile, const std::string &normalsShaderFile, uint32_t maxLines = 65536, uint32_t maxSources = 8, VkSampleCountFlagBits rasterizationSamples = VK_SAMPLE_COUNT_1_BIT, uint32_t subpass = 0);
+		~DebugLineRenderer();
+		uint32_t addVertexSource(VkBuffer buffer, VkDeviceSize range = VK_WHOLE_SIZE);
+		void begin(uint32_t slot);
+		void addLine(const glm::vec3 &start, const glm::vec3 &end, const glm::vec4 &color);
+		void addLine(const glm::vec3 &start, const glm::vec3 &end, const glm::vec4 &startColor, const glm::vec4 &endColor);
+		void addBox(const glm::vec3 &min, const glm::vec3 &max, const glm::mat4 &transform, const glm::vec4 &color);
+		void addSphere(const glm::vec3 &center, float radius, const glm::vec4 &color, uint32_t segments = 32);
+		void addAxes(const glm::mat4 &transform, float size);
+		void addSkeleton(const std::vector<glm::mat4> &jointMatrices, const std::vector<int32_t> &parents, const glm::vec4 &color);
+		void setViewProjection(uint32_t slot, const glm::mat4 &viewProjection);
+		void end();
+		void beginAppend(VkCommandBuffer commandBuffer, uint32_t slot);
+		void appendNormals(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t source, uint32_t vertexCount, uint32_t vertexStride, uint32_t positionOffset, uint32_t normalOffset, const glm::mat4 &transform, float length, const glm::vec4 &baseColor = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f), const glm::vec4 &tipColor = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+		void endAppend(VkCommandBuffer commandBuffer, uint32_t slot);
+		void draw(VkCommandBuffer commandBuffer, uint32_t slot);
+	};
+}
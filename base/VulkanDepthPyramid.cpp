@@ -0,0 +1,300 @@
+/*
+* Hierarchical depth pyramid
+*
+* Reduces a depth attachment into a mip chain storing the nearest and farthest depth covered by each texel, for GPU occlusion culling and
+* screen space effects that need conservative depth bounds of a screen region without reading the depth buffer back to the host
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanDepthPyramid.h"
+#include "VulkanDevice.h"
+#include <algorithm>
+
+namespace vks
+{
+	const VkFormat DepthPyramid::format;
+
+	// Work group size of the reduction shader in both dimensions
+	static const uint32_t reductionGroupSize = 8;
+
+	/**
+	* @param device Device to create the compute pipeline on
+	* @param shaderFile SPIR-V file of the "base/depthpyramid.comp" shader
+	*
+	* @note If the pyramid format can't be used as a storage image or the shader can't be loaded, no pipeline is created and isSupported() returns false
+	*/
+	DepthPyramid::DepthPyramid(vks::VulkanDevice *device, const std::string &shaderFile) : device(device)
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+		const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+		if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures)
+		{
+			return;
+		}
+
+#if defined(__ANDROID__)
+		shaderModule = vks::tools::loadShader(androidApp->activity->assetManager, shaderFile.c_str(), device->logicalDevice);
+#else
+		shaderModule = vks::tools::loadShader(shaderFile.c_str(), device->logicalDevice);
+#endif
+		if (shaderModule == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+		samplerCreateInfo.maxAnisotropy = 1.0f;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCI.stage.module = shaderModule;
+		pipelineCI.stage.pName = "main";
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline));
+
+		supported = true;
+	}
+
+	DepthPyramid::~DepthPyramid()
+	{
+		destroyImage();
+		if (pipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+		}
+		if (pipelineLayout)
+		{
+			vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		}
+		if (descriptorSetLayout)
+		{
+			vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		}
+		if (sampler)
+		{
+			vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		}
+		if (shaderModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, shaderModule, nullptr);
+		}
+	}
+
+	void DepthPyramid::destroyImage()
+	{
+		for (VkImageView levelView : levelViews)
+		{
+			vkDestroyImageView(device->logicalDevice, levelView, nullptr);
+		}
+		levelViews.clear();
+		descriptorSets.clear();
+		if (descriptorPool)
+		{
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+			descriptorPool = VK_NULL_HANDLE;
+		}
+		if (view)
+		{
+			vkDestroyImageView(device->logicalDevice, view, nullptr);
+			view = VK_NULL_HANDLE;
+		}
+		if (image)
+		{
+			vkDestroyImage(device->logicalDevice, image, nullptr);
+			device->freeMemory(memory, allocation);
+			image = VK_NULL_HANDLE;
+			memory = VK_NULL_HANDLE;
+			allocation = vks::MemoryAllocation{};
+		}
+		descriptor = VkDescriptorImageInfo{};
+	}
+
+	/** @brief True if the pyramid format is supported and the reduction pipeline has been created */
+	bool DepthPyramid::isSupported() const
+	{
+		return supported;
+	}
+
+	/**
+	* Create the pyramid for a depth attachment, replacing the previous one (e.g. after a resize)
+	*
+	* @param width Width of the depth attachment
+	* @param height Height of the depth attachment
+	* @param depthView View of the depth aspect of the attachment
+	* @param depthLayout Layout of the attachment while record() reads it, e.g. VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+	*
+	* @note The previous pyramid must not be in use anymore
+	*/
+	void DepthPyramid::create(uint32_t width, uint32_t height, VkImageView depthView, VkImageLayout depthLayout)
+	{
+		if (!supported)
+		{
+			return;
+		}
+		destroyImage();
+		this->width = std::max(width, 1u);
+		this->height = std::max(height, 1u);
+		levelCount = 1;
+		while (((this->width >> levelCount) > 0) || ((this->height >> levelCount) > 0))
+		{
+			levelCount++;
+		}
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = format;
+		imageCI.extent = { this->width, this->height, 1 };
+		imageCI.mipLevels = levelCount;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &image));
+		VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memory, &allocation));
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+		viewCI.image = image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &view));
+		levelViews.resize(levelCount);
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &levelViews[level]));
+		}
+		descriptor = { sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+		// One set per level, reading the depth attachment (first level) or the previous level and writing the level
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, levelCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levelCount),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, levelCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+		descriptorSets.resize(levelCount);
+		std::vector<VkDescriptorSetLayout> setLayouts(levelCount, descriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, setLayouts.data(), levelCount);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, descriptorSets.data()));
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			VkDescriptorImageInfo srcDescriptor = (level == 0) ? VkDescriptorImageInfo{ sampler, depthView, depthLayout } : VkDescriptorImageInfo{ sampler, levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorImageInfo dstDescriptor = { VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSets[level], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &srcDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[level], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &dstDescriptor),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+	}
+
+	/**
+	* Record the reduction of the depth attachment into all levels of the pyramid, outside of a render pass
+	*
+	* @note The depth attachment has to be in the layout passed to create() and its writes have to be made visible to compute shader reads before this
+	*/
+	void DepthPyramid::record(VkCommandBuffer commandBuffer)
+	{
+		if (!supported || (image == VK_NULL_HANDLE))
+		{
+			return;
+		}
+		// The previous contents are discarded, all levels stay in the general layout while they are written and read by the dispatches
+		VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageBarrier.srcAccessMask = 0;
+		imageBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageBarrier.image = image;
+		imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			PushConstants pushConstants{};
+			pushConstants.srcWidth = static_cast<int32_t>((level == 0) ? width : std::max(width >> (level - 1), 1u));
+			pushConstants.srcHeight = static_cast<int32_t>((level == 0) ? height : std::max(height >> (level - 1), 1u));
+			pushConstants.dstWidth = static_cast<int32_t>(std::max(width >> level, 1u));
+			pushConstants.dstHeight = static_cast<int32_t>(std::max(height >> level, 1u));
+			pushConstants.depthSource = (level == 0) ? 1 : 0;
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[level], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, (pushConstants.dstWidth + reductionGroupSize - 1) / reductionGroupSize, (pushConstants.dstHeight + reductionGroupSize - 1) / reductionGroupSize, 1);
+
+			// Each level is the source of the next one
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+	}
+
+	VkImage DepthPyramid::getImage() const
+	{
+		return image;
+	}
+
+	VkImageView DepthPyramid::getView() const
+	{
+		return view;
+	}
+
+	VkSampler DepthPyramid::getSampler() const
+	{
+		return sampler;
+	}
+
+	/** @brief Descriptor of all levels in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL with the pyramid's nearest sampler */
+	const VkDescriptorImageInfo &DepthPyramid::getDescriptor() const
+	{
+		return descriptor;
+	}
+
+	uint32_t DepthPyramid::getWidth() const
+	{
+		return width;
+	}
+
+	uint32_t DepthPyramid::getHeight() const
+	{
+		return height;
+	}
+
+	uint32_t DepthPyramid::getLevelCount() const
+	{
+		return levelCount;
+	}
+}
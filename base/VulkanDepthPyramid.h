@@ -0,0 +1,89 @@
+/*
+* Hierarchical depth pyramid
+*
+* Reduces a depth attachment into a mip chain storing the nearest and farthest depth covered by each texel, for GPU occlusion culling and
+* screen space effects that need conservative depth bounds of a screen region without reading the depth buffer back to the host
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanMemoryAllocator.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Depth pyramid builder using the "base/depthpyramid.comp" compute shader
+	*
+	* Usage:
+	*	vks::DepthPyramid depthPyramid(vulkanDevice, getShadersPath() + "base/depthpyramid.comp.spv");
+	*	depthPyramid.create(width, height, depthStencil.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);	// and again on resize
+	*	// Per frame, after the depth attachment has been written and transitioned to the layout passed to create()
+	*	depthPyramid.record(commandBuffer);
+	*	// Sample depthPyramid.getDescriptor() with textureLod(pyramid, uv, level).rg
+	*
+	* The first level has the size of the depth attachment, every further level half the size of the previous one (rounded down) with each texel
+	* covering all texels of the previous level it overlaps. The R channel holds the maximum and the G channel the minimum depth. With the standard
+	* depth range (0 = near) R is the farthest depth that can be used as the occluder depth of a region, with reversed depth it's G.
+	*
+	* @note The depth attachment needs to be created with VK_IMAGE_USAGE_SAMPLED_BIT and the view passed to create() has to use the depth aspect only
+	* @note Only the R channel of the first level of the source view is read, so other single channel data (e.g. a height map through a view swizzling
+	* the height into R) can be reduced the same way
+	* @note The pyramid is in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL after record(), compute and fragment shaders can read it without further barriers
+	*/
+	class DepthPyramid
+	{
+	private:
+		struct PushConstants {
+			int32_t srcWidth;
+			int32_t srcHeight;
+			int32_t dstWidth;
+			int32_t dstHeight;
+			// Reading the depth attachment instead of a pyramid level
+			uint32_t depthSource;
+		};
+		vks::VulkanDevice *device;
+		bool supported = false;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t levelCount = 0;
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		vks::MemoryAllocation allocation{};
+		// View of all levels for consumers and one view per level for the reduction
+		VkImageView view = VK_NULL_HANDLE;
+		std::vector<VkImageView> levelViews;
+		std::vector<VkDescriptorSet> descriptorSets;
+		VkDescriptorImageInfo descriptor{};
+		VkShaderModule shaderModule = VK_NULL_HANDLE;
+		// Nearest filtering with clamp to edge addressing, used by the reduction and for consumers
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		void destroyImage();
+	public:
+		static const VkFormat format = VK_FORMAT_R32G32_SFLOAT;
+
+		DepthPyramid(vks::VulkanDevice *device, const std::string &shaderFile);
+		~DepthPyramid();
+		bool isSupported() const;
+		void create(uint32_t width, uint32_t height, VkImageView depthView, VkImageLayout depthLayout);
+		void record(VkCommandBuffer commandBuffer);
+		VkImage getImage() const;
+		VkImageView getView() const;
+		VkSampler getSampler() const;
+		const VkDescriptorImageInfo &getDescriptor() const;
+		uint32_t getWidth() const;
+		uint32_t getHeight() const;
+		uint32_t getLevelCount() const;
+	};
+}
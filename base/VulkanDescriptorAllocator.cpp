@@ -0,0 +1,311 @@
+/*
+* Descriptor set allocation
+*
+* Allocates descriptor sets from lists of descriptor pools that grow on demand instead of pools sized up front, with cheap resets for
+* transient per-frame sets and a cache that reuses sets with identical contents
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanDescriptorAllocator.h"
+#include <algorithm>
+#include <assert.h>
+
+namespace vks
+{
+	/**
+	* @param device Logical device to create the pools on
+	* @param ratios Descriptors per set of layout class 0
+	* @param initialSetsPerPool Set count of the first pool of layout class 0
+	* @param poolFlags Flags used for all pools, VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT is needed for sets with update after bind bindings
+	*/
+	DescriptorAllocator::DescriptorAllocator(VkDevice device, const std::vector<PoolSizeRatio> &ratios, uint32_t initialSetsPerPool, VkDescriptorPoolCreateFlags poolFlags) : device(device), poolFlags(poolFlags)
+	{
+		addLayoutClass(ratios, initialSetsPerPool);
+	}
+
+	/** @brief Destroy all pools, which releases all sets allocated from them */
+	DescriptorAllocator::~DescriptorAllocator()
+	{
+		for (auto &layoutClass : layoutClasses)
+		{
+			if (layoutClass.currentPool != VK_NULL_HANDLE)
+			{
+				vkDestroyDescriptorPool(device, layoutClass.currentPool, nullptr);
+			}
+			for (auto pool : layoutClass.fullPools)
+			{
+				vkDestroyDescriptorPool(device, pool, nullptr);
+			}
+			for (auto pool : layoutClass.freePools)
+			{
+				vkDestroyDescriptorPool(device, pool, nullptr);
+			}
+		}
+	}
+
+	/** @brief Ratios for layouts made up of a few buffers and images, as used by most samples */
+	std::vector<DescriptorAllocator::PoolSizeRatio> DescriptorAllocator::defaultRatios()
+	{
+		return {
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0.5f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f },
+		};
+	}
+
+	/**
+	* Add a layout class with its own list of pools
+	*
+	* @param ratios Descriptors of each type per set, the pool sizes are the ratios multiplied by the set count of the pool (at least one)
+	* @param initialSetsPerPool Set count of the first pool of the class
+	*
+	* @return Index of the layout class to pass to allocate()
+	*/
+	uint32_t DescriptorAllocator::addLayoutClass(const std::vector<PoolSizeRatio> &ratios, uint32_t initialSetsPerPool)
+	{
+		assert(!ratios.empty());
+		LayoutClass layoutClass{};
+		layoutClass.ratios = ratios;
+		layoutClass.setsPerPool = std::max(1u, std::min(initialSetsPerPool, maxSetsPerPool));
+		layoutClasses.push_back(layoutClass);
+		return static_cast<uint32_t>(layoutClasses.size() - 1);
+	}
+
+	VkDescriptorPool DescriptorAllocator::createPool(LayoutClass &layoutClass)
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		bool inlineUniformBlocks = false;
+		for (auto &ratio : layoutClass.ratios)
+		{
+			const uint32_t count = std::max(1u, static_cast<uint32_t>(ratio.ratio * layoutClass.setsPerPool));
+			poolSizes.push_back({ ratio.type, count });
+			inlineUniformBlocks |= (ratio.type == VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK_EXT);
+		}
+		VkDescriptorPoolCreateInfo descriptorPoolCI{};
+		descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		// The ratio of inline uniform blocks is in bytes, the number of bindings is limited separately with one block per set
+		VkDescriptorPoolInlineUniformBlockCreateInfoEXT inlineUniformBlockCI{};
+		if (inlineUniformBlocks)
+		{
+			inlineUniformBlockCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_INLINE_UNIFORM_BLOCK_CREATE_INFO_EXT;
+			inlineUniformBlockCI.maxInlineUniformBlockBindings = layoutClass.setsPerPool;
+			descriptorPoolCI.pNext = &inlineUniformBlockCI;
+		}
+		descriptorPoolCI.flags = poolFlags;
+		descriptorPoolCI.maxSets = layoutClass.setsPerPool;
+		descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		descriptorPoolCI.pPoolSizes = poolSizes.data();
+		VkDescriptorPool pool;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &pool));
+		// The next pool of the class holds twice as many sets
+		layoutClass.setsPerPool = std::min(layoutClass.setsPerPool * 2, maxSetsPerPool);
+		return pool;
+	}
+
+	// Pool to continue allocating from, a reset pool is preferred over creating a new one
+	VkDescriptorPool DescriptorAllocator::nextPool(LayoutClass &layoutClass)
+	{
+		if (!layoutClass.freePools.empty())
+		{
+			VkDescriptorPool pool = layoutClass.freePools.back();
+			layoutClass.freePools.pop_back();
+			return pool;
+		}
+		return createPool(layoutClass);
+	}
+
+	/**
+	* Allocate a descriptor set, a new pool is started if the current one of the layout class is exhausted
+	*
+	* @param layout Layout of the set
+	* @param descriptorSet Pointer to the handle of the allocated set
+	* @param layoutClass Class the pools are taken from, see addLayoutClass()
+	* @param variableDescriptorCount Descriptor count of a variable sized last binding, zero if the layout doesn't have one
+	*
+	* @return VK_SUCCESS or the error of the allocation from a new pool, in which case the layout doesn't fit the layout class
+	*/
+	VkResult DescriptorAllocator::allocate(VkDescriptorSetLayout layout, VkDescriptorSet *descriptorSet, uint32_t layoutClass, uint32_t variableDescriptorCount)
+	{
+		assert(layoutClass < layoutClasses.size());
+		LayoutClass &target = layoutClasses[layoutClass];
+		if (target.currentPool == VK_NULL_HANDLE)
+		{
+			target.currentPool = nextPool(target);
+		}
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = target.currentPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+		VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo{};
+		if (variableDescriptorCount > 0)
+		{
+			variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+			variableCountInfo.descriptorSetCount = 1;
+			variableCountInfo.pDescriptorCounts = &variableDescriptorCount;
+			allocInfo.pNext = &variableCountInfo;
+		}
+		VkResult result = vkAllocateDescriptorSets(device, &allocInfo, descriptorSet);
+		if ((result == VK_ERROR_OUT_OF_POOL_MEMORY) || (result == VK_ERROR_FRAGMENTED_POOL))
+		{
+			target.fullPools.push_back(target.currentPool);
+			target.currentPool = nextPool(target);
+			allocInfo.descriptorPool = target.currentPool;
+			result = vkAllocateDescriptorSets(device, &allocInfo, descriptorSet);
+		}
+		return result;
+	}
+
+	/**
+	* Reset all pools, all sets allocated from the allocator become invalid
+	*
+	* @note The sets must not be in use by the device anymore, for transient sets that means the fence of the frame has been waited on
+	*/
+	void DescriptorAllocator::reset()
+	{
+		for (auto &layoutClass : layoutClasses)
+		{
+			if (layoutClass.currentPool != VK_NULL_HANDLE)
+			{
+				layoutClass.fullPools.push_back(layoutClass.currentPool);
+				layoutClass.currentPool = VK_NULL_HANDLE;
+			}
+			for (auto pool : layoutClass.fullPools)
+			{
+				VK_CHECK_RESULT(vkResetDescriptorPool(device, pool, 0));
+				layoutClass.freePools.push_back(pool);
+			}
+			layoutClass.fullPools.clear();
+		}
+	}
+
+	/** @brief Number of pools created by the allocator over all layout classes */
+	uint32_t DescriptorAllocator::getPoolCount() const
+	{
+		size_t count = 0;
+		for (auto &layoutClass : layoutClasses)
+		{
+			count += layoutClass.fullPools.size() + layoutClass.freePools.size() + ((layoutClass.currentPool != VK_NULL_HANDLE) ? 1 : 0);
+		}
+		return static_cast<uint32_t>(count);
+	}
+
+	DescriptorBinding DescriptorBinding::buffer(uint32_t binding, VkDescriptorType type, const VkDescriptorBufferInfo &bufferInfo)
+	{
+		DescriptorBinding descriptorBinding;
+		descriptorBinding.binding = binding;
+		descriptorBinding.type = type;
+		descriptorBinding.bufferInfo = bufferInfo;
+		return descriptorBinding;
+	}
+
+	DescriptorBinding DescriptorBinding::image(uint32_t binding, VkDescriptorType type, const VkDescriptorImageInfo &imageInfo)
+	{
+		DescriptorBinding descriptorBinding;
+		descriptorBinding.binding = binding;
+		descriptorBinding.type = type;
+		descriptorBinding.imageInfo = imageInfo;
+		return descriptorBinding;
+	}
+
+	bool DescriptorBinding::operator==(const DescriptorBinding &other) const
+	{
+		return (binding == other.binding) && (type == other.type) &&
+			(bufferInfo.buffer == other.bufferInfo.buffer) && (bufferInfo.offset == other.bufferInfo.offset) && (bufferInfo.range == other.bufferInfo.range) &&
+			(imageInfo.sampler == other.imageInfo.sampler) && (imageInfo.imageView == other.imageInfo.imageView) && (imageInfo.imageLayout == other.imageInfo.imageLayout);
+	}
+
+	bool DescriptorSetCache::Key::operator==(const Key &other) const
+	{
+		return (layout == other.layout) && (bindings == other.bindings);
+	}
+
+	size_t DescriptorSetCache::KeyHash::operator()(const Key &key) const
+	{
+		// FNV-1a over the handles and values that identify the contents
+		uint64_t hash = 14695981039346656037ull;
+		auto combine = [&hash](uint64_t value) {
+			hash ^= value;
+			hash *= 1099511628211ull;
+		};
+		combine((uint64_t)key.layout);
+		for (auto &binding : key.bindings)
+		{
+			combine(binding.binding);
+			combine(binding.type);
+			combine((uint64_t)binding.bufferInfo.buffer);
+			combine(binding.bufferInfo.offset);
+			combine(binding.bufferInfo.range);
+			combine((uint64_t)binding.imageInfo.sampler);
+			combine((uint64_t)binding.imageInfo.imageView);
+			combine(binding.imageInfo.imageLayout);
+		}
+		return static_cast<size_t>(hash);
+	}
+
+	DescriptorSetCache::DescriptorSetCache(VkDevice device, DescriptorAllocator &allocator) : device(device), allocator(allocator) {}
+
+	/**
+	* Get a set with the given layout and bindings, allocating and writing it if no such set has been requested before
+	*
+	* @param layout Layout of the set
+	* @param bindings Contents of the set, one entry per binding (single descriptors only)
+	* @param layoutClass Layout class of the allocator new sets are allocated from
+	*
+	* @return Handle of the set, VK_NULL_HANDLE if it couldn't be allocated
+	*/
+	VkDescriptorSet DescriptorSetCache::get(VkDescriptorSetLayout layout, const std::vector<DescriptorBinding> &bindings, uint32_t layoutClass)
+	{
+		Key key{ layout, bindings };
+		auto cached = sets.find(key);
+		if (cached != sets.end())
+		{
+			return cached->second;
+		}
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		if (allocator.allocate(layout, &descriptorSet, layoutClass) != VK_SUCCESS)
+		{
+			return VK_NULL_HANDLE;
+		}
+		std::vector<VkWriteDescriptorSet> writes(bindings.size());
+		for (size_t i = 0; i < bindings.size(); i++)
+		{
+			const DescriptorBinding &binding = bindings[i];
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = descriptorSet;
+			writes[i].dstBinding = binding.binding;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = binding.type;
+			switch (binding.type)
+			{
+			case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+			case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+			case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+			case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+				writes[i].pBufferInfo = &binding.bufferInfo;
+				break;
+			default:
+				writes[i].pImageInfo = &binding.imageInfo;
+				break;
+			}
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+		sets.emplace(std::move(key), descriptorSet);
+		return descriptorSet;
+	}
+
+	/** @brief Forget all cached sets, they are not freed but released with the next reset of the allocator */
+	void DescriptorSetCache::clear()
+	{
+		sets.clear();
+	}
+
+	/** @brief Number of cached sets */
+	size_t DescriptorSetCache::size() const
+	{
+		return sets.size();
+	}
+}
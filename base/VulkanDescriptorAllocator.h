@@ -0,0 +1,117 @@
+/*
+* Descriptor set allocation
+*
+* Allocates descriptor sets from lists of descriptor pools that grow on demand instead of pools sized up front, with cheap resets for
+* transient per-frame sets and a cache that reuses sets with identical contents
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* Growing descriptor pool allocator
+	*
+	* Usage:
+	*	vks::DescriptorAllocator allocator(device);
+	*	VK_CHECK_RESULT(allocator.allocate(descriptorSetLayout, &descriptorSet));
+	*	// Transient sets, with one allocator per frame in flight
+	*	frameAllocators[currentFrame].reset();	// After the fence of the frame has been waited on
+	*	frameAllocators[currentFrame].allocate(descriptorSetLayout, &descriptorSet);
+	*
+	* Pools are created per layout class, a class describes how many descriptors of each type a pool holds per set (see PoolSizeRatio), so
+	* layouts with similar contents should share a class. A pool that runs out is kept until reset() and allocation continues in a new one,
+	* which holds twice the sets of the previous one up to maxSetsPerPool.
+	*
+	* @note The ratio of VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK_EXT is the block size in bytes, pools of such a class allow one block per set
+	* @note Sets can't be freed individually, reset() releases all sets of the allocator at once and keeps the pools for reuse
+	*/
+	class DescriptorAllocator
+	{
+	public:
+		/** @brief Number of descriptors of a type per set in the pools of a layout class */
+		struct PoolSizeRatio {
+			VkDescriptorType type;
+			float ratio;
+		};
+
+		/** @brief Upper limit for the set count of a single pool */
+		static const uint32_t maxSetsPerPool = 4096;
+
+		DescriptorAllocator(VkDevice device, const std::vector<PoolSizeRatio> &ratios = defaultRatios(), uint32_t initialSetsPerPool = 32, VkDescriptorPoolCreateFlags poolFlags = 0);
+		~DescriptorAllocator();
+		static std::vector<PoolSizeRatio> defaultRatios();
+		uint32_t addLayoutClass(const std::vector<PoolSizeRatio> &ratios, uint32_t initialSetsPerPool = 32);
+		VkResult allocate(VkDescriptorSetLayout layout, VkDescriptorSet *descriptorSet, uint32_t layoutClass = 0, uint32_t variableDescriptorCount = 0);
+		void reset();
+		uint32_t getPoolCount() const;
+	private:
+		struct LayoutClass {
+			std::vector<PoolSizeRatio> ratios;
+			uint32_t setsPerPool;
+			VkDescriptorPool currentPool = VK_NULL_HANDLE;
+			// Pools that ran out since the last reset
+			std::vector<VkDescriptorPool> fullPools;
+			// Pools that have been reset and can be used again
+			std::vector<VkDescriptorPool> freePools;
+		};
+		VkDevice device;
+		VkDescriptorPoolCreateFlags poolFlags;
+		std::vector<LayoutClass> layoutClasses;
+		VkDescriptorPool createPool(LayoutClass &layoutClass);
+		VkDescriptorPool nextPool(LayoutClass &layoutClass);
+	};
+
+	/**
+	* Binding of a cached descriptor set, only the info matching the descriptor type is used
+	*/
+	struct DescriptorBinding {
+		uint32_t binding = 0;
+		VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		VkDescriptorBufferInfo bufferInfo{};
+		VkDescriptorImageInfo imageInfo{};
+
+		static DescriptorBinding buffer(uint32_t binding, VkDescriptorType type, const VkDescriptorBufferInfo &bufferInfo);
+		static DescriptorBinding image(uint32_t binding, VkDescriptorType type, const VkDescriptorImageInfo &imageInfo);
+		bool operator==(const DescriptorBinding &other) const;
+	};
+
+	/**
+	* Cache of descriptor sets keyed by their layout and binding contents
+	*
+	* Usage:
+	*	vks::DescriptorSetCache cache(device, allocator);
+	*	VkDescriptorSet set = cache.get(layout, { vks::DescriptorBinding::buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, buffer.descriptor) });
+	*
+	* Sets are allocated and written the first time a combination is requested and returned as is afterwards
+	*
+	* @note clear() has to be called whenever the allocator is reset, and when a resource referenced by cached sets is destroyed
+	*/
+	class DescriptorSetCache
+	{
+	public:
+		DescriptorSetCache(VkDevice device, DescriptorAllocator &allocator);
+		VkDescriptorSet get(VkDescriptorSetLayout layout, const std::vector<DescriptorBinding> &bindings, uint32_t layoutClass = 0);
+		void clear();
+		size_t size() const;
+	private:
+		struct Key {
+			VkDescriptorSetLayout layout;
+			std::vector<DescriptorBinding> bindings;
+			bool operator==(const Key &other) const;
+		};
+		struct KeyHash {
+			size_t operator()(const Key &key) const;
+		};
+		VkDevice device;
+		DescriptorAllocator &allocator;
+		std::unordered_map<Key, VkDescriptorSet, KeyHash> sets;
+	};
+}
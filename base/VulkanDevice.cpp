@@ -13,10 +13,34 @@
 #define VK_ENABLE_BETA_EXTENSIONS
 #endif
 #include <VulkanDevice.h>
+#include "VulkanDebug.h"
+#include "VulkanTrace.h"
+#include <iterator>
 #include <unordered_set>
 
 namespace vks
 {	
+	namespace
+	{
+		/** @brief Default debug name of a buffer made from its main usage and its size, so captures can tell buffers apart */
+		void setDefaultBufferName(VkDevice device, VkBuffer buffer, VkBufferUsageFlags usageFlags, VkDeviceSize size)
+		{
+			if (!vks::debugutils::active)
+			{
+				return;
+			}
+			std::string usage = "buffer";
+			if (usageFlags & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) usage = "vertex buffer";
+			else if (usageFlags & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) usage = "index buffer";
+			else if (usageFlags & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT) usage = "indirect buffer";
+			else if (usageFlags & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) usage = "uniform buffer";
+			else if (usageFlags & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) usage = "storage buffer";
+			else if (usageFlags == VK_BUFFER_USAGE_TRANSFER_SRC_BIT) usage = "staging buffer";
+			const std::string name = usage + " (" + std::to_string(size) + " bytes)";
+			vks::debugutils::setObjectName(device, VK_OBJECT_TYPE_BUFFER, (uint64_t)buffer, name.c_str());
+		}
+	}
+
 	/**
 	* Default constructor
 	*
@@ -34,6 +58,7 @@ namespace vks
 		vkGetPhysicalDeviceFeatures(physicalDevice, &features);
 		// Memory properties are used regularly for creating all kinds of buffers
 		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		memoryTracker.init(physicalDevice, memoryProperties);
 		// Queue family properties, used for setting up requested queues upon device creation
 		uint32_t queueFamilyCount;
 		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
@@ -64,6 +89,33 @@ namespace vks
 	*/
 	VulkanDevice::~VulkanDevice()
 	{
+		// The owner has to wait for the device to become idle before destroying it
+		releaseDeferredDestructions();
+		if (stagingRing)
+		{
+			delete stagingRing;
+		}
+		if (samplerCache)
+		{
+			delete samplerCache;
+		}
+		if (memoryAllocator)
+		{
+			delete memoryAllocator;
+		}
+		if (mappedRangeBatch)
+		{
+			delete mappedRangeBatch;
+		}
+		if (memoryTracker.getAllocationCount() > 0)
+		{
+			std::cerr << "Device destroyed with " << memoryTracker.getAllocationCount() << " tracked device memory allocation(s) still in use:\n";
+			memoryTracker.printStatistics();
+		}
+		if (flushTimelineSemaphore)
+		{
+			vkDestroySemaphore(logicalDevice, flushTimelineSemaphore, nullptr);
+		}
 		if (commandPool)
 		{
 			vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
@@ -308,6 +360,51 @@ namespace vks
 		// Create a default command pool for graphics command buffers
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
 
+		// If timeline semaphores have been requested, command buffer flushes signal a timeline semaphore instead of creating a fence for each submission
+		if (std::find_if(deviceExtensions.begin(), deviceExtensions.end(), [](const char* ext) { return strcmp(ext, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0; }) != deviceExtensions.end())
+		{
+			vkWaitSemaphoresKHR = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(logicalDevice, "vkWaitSemaphoresKHR"));
+			vkGetSemaphoreCounterValueKHR = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(vkGetDeviceProcAddr(logicalDevice, "vkGetSemaphoreCounterValueKHR"));
+			enableTimelineSemaphores = (vkWaitSemaphoresKHR != nullptr) && (vkGetSemaphoreCounterValueKHR != nullptr);
+			if (enableTimelineSemaphores)
+			{
+				flushTimelineSemaphore = createTimelineSemaphore();
+			}
+		}
+
+		// Render targets request their framebuffer compression and read back the compression that has been applied if image compression control has been requested
+		if (std::find_if(deviceExtensions.begin(), deviceExtensions.end(), [](const char* ext) { return strcmp(ext, VK_EXT_IMAGE_COMPRESSION_CONTROL_EXTENSION_NAME) == 0; }) != deviceExtensions.end())
+		{
+			vkGetImageSubresourceLayout2EXT = reinterpret_cast<PFN_vkGetImageSubresourceLayout2EXT>(vkGetDeviceProcAddr(logicalDevice, "vkGetImageSubresourceLayout2EXT"));
+			enableImageCompressionControl = (vkGetImageSubresourceLayout2EXT != nullptr);
+		}
+
+		// Shader statistics (e.g. instruction and register counts) of pipelines, reported by benchmarks
+		if (std::find_if(deviceExtensions.begin(), deviceExtensions.end(), [](const char* ext) { return strcmp(ext, VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME) == 0; }) != deviceExtensions.end())
+		{
+			vkGetPipelineExecutablePropertiesKHR = reinterpret_cast<PFN_vkGetPipelineExecutablePropertiesKHR>(vkGetDeviceProcAddr(logicalDevice, "vkGetPipelineExecutablePropertiesKHR"));
+			vkGetPipelineExecutableStatisticsKHR = reinterpret_cast<PFN_vkGetPipelineExecutableStatisticsKHR>(vkGetDeviceProcAddr(logicalDevice, "vkGetPipelineExecutableStatisticsKHR"));
+			enablePipelineExecutableInfo = (vkGetPipelineExecutablePropertiesKHR != nullptr) && (vkGetPipelineExecutableStatisticsKHR != nullptr);
+		}
+
+		// Buffer device addresses are core in Vulkan 1.2, the KHR entry point is only returned if the extension has been enabled
+		vkGetBufferDeviceAddressKHR = reinterpret_cast<PFN_vkGetBufferDeviceAddressKHR>(vkGetDeviceProcAddr(logicalDevice, "vkGetBufferDeviceAddressKHR"));
+		if (!vkGetBufferDeviceAddressKHR)
+		{
+			vkGetBufferDeviceAddressKHR = reinterpret_cast<PFN_vkGetBufferDeviceAddressKHR>(vkGetDeviceProcAddr(logicalDevice, "vkGetBufferDeviceAddress"));
+		}
+
+		if (enableMemoryAllocator)
+		{
+			memoryAllocator = new vks::MemoryAllocator(logicalDevice, physicalDevice);
+			memoryAllocator->tracker = &memoryTracker;
+		}
+
+		if (batchMappedRangeFlushes)
+		{
+			mappedRangeBatch = new vks::MappedRangeBatch(logicalDevice, properties.limits.nonCoherentAtomSize);
+		}
+
 		return result;
 	}
 
@@ -329,6 +426,7 @@ namespace vks
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, buffer));
+		setDefaultBufferName(logicalDevice, *buffer, usageFlags, size);
 
 		// Create the memory backing up the buffer handle
 		VkMemoryRequirements memReqs;
@@ -388,6 +486,7 @@ namespace vks
 		// Create the buffer handle
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
+		setDefaultBufferName(logicalDevice, buffer->buffer, usageFlags, size);
 
 		// Create the memory backing up the buffer handle
 		VkMemoryRequirements memReqs;
@@ -396,6 +495,15 @@ namespace vks
 		memAlloc.allocationSize = memReqs.size;
 		// Find a memory type index that fits the properties of the buffer
 		memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+		const VkMemoryPropertyFlags typeFlags = memoryProperties.memoryTypes[memAlloc.memoryTypeIndex].propertyFlags;
+		const bool hostVisible = (typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+		const bool hostCoherent = (typeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+		// Flushes are widened to whole non-coherent atoms, which must not reach past the end of the memory object
+		if (hostVisible && !hostCoherent)
+		{
+			const VkDeviceSize atomSize = std::max(properties.limits.nonCoherentAtomSize, (VkDeviceSize)1);
+			memAlloc.allocationSize = (memAlloc.allocationSize + atomSize - 1) / atomSize * atomSize;
+		}
 		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
 		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
 		if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
@@ -403,29 +511,236 @@ namespace vks
 			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
 			memAlloc.pNext = &allocFlagsInfo;
 		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
+		// Device address buffers need the allocate flag on their memory object, so they always get a dedicated allocation
+		if (memoryAllocator && !(usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT))
+		{
+			VK_CHECK_RESULT(memoryAllocator->allocate(memReqs, memAlloc.memoryTypeIndex, true, &buffer->allocation));
+			buffer->memory = buffer->allocation.memory;
+			buffer->allocator = memoryAllocator;
+		}
+		else
+		{
+			// Transfer source only host visible buffers are staging buffers
+			const bool staging = (usageFlags == VK_BUFFER_USAGE_TRANSFER_SRC_BIT) && (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			VK_CHECK_RESULT(allocateMemory(memAlloc, staging ? vks::MemoryCategory::Staging : vks::MemoryCategory::Buffer, &buffer->memory));
+			buffer->tracker = &memoryTracker;
+		}
 
 		buffer->alignment = memReqs.alignment;
 		buffer->size = size;
 		buffer->usageFlags = usageFlags;
 		buffer->memoryPropertyFlags = memoryPropertyFlags;
+		buffer->hostCoherent = hostCoherent;
+		buffer->flushBatch = (hostVisible && !hostCoherent) ? mappedRangeBatch : nullptr;
 
-		// If a pointer to the buffer data has been passed, map the buffer and copy over the data
+		// Host visible buffers stay mapped for their whole lifetime, so map() and unmap() don't need to call into the driver
+		if (hostVisible)
+		{
+			if (buffer->allocator)
+			{
+				// Sub-allocated host visible memory is persistently mapped by the allocator
+				buffer->hostMapping = buffer->allocation.mapped;
+			}
+			else
+			{
+				VK_CHECK_RESULT(vkMapMemory(logicalDevice, buffer->memory, 0, VK_WHOLE_SIZE, 0, &buffer->hostMapping));
+			}
+		}
+
+		// If a pointer to the buffer data has been passed, copy over the data
 		if (data != nullptr)
 		{
 			VK_CHECK_RESULT(buffer->map());
 			memcpy(buffer->mapped, data, size);
-			if ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
-				buffer->flush();
-
+			// The initial data is flushed right away, the buffer may be used before the next batched flush
+			buffer->flush();
 			buffer->unmap();
 		}
 
+		// Host visible buffers are handed out mapped
+		if (hostVisible)
+		{
+			VK_CHECK_RESULT(buffer->map());
+		}
+
 		// Initialize a default descriptor that covers the whole buffer size
 		buffer->setupDescriptor();
 
 		// Attach the memory to the buffer object
-		return buffer->bind();
+		VkResult result = buffer->bind();
+		if ((result == VK_SUCCESS) && (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT))
+		{
+			buffer->deviceAddress = getBufferDeviceAddress(buffer->buffer);
+		}
+		return result;
+	}
+
+	/**
+	* Create a buffer that shaders access through its device address (e.g. from a push constant block), with the address stored in the buffer
+	*
+	* @param usageFlags Usage flag bit mask for the buffer, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT is added
+	* @param memoryPropertyFlags Memory properties for this buffer (i.e. device local, host visible, coherent)
+	* @param buffer Pointer to a vk::Vulkan buffer object, see vks::Buffer::getDeviceAddress()
+	* @param size Size of the buffer in bytes
+	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+	*
+	* @return VK_SUCCESS if the buffer has been created
+	*
+	* @note Requires the bufferDeviceAddress feature to be enabled. Device address buffers get dedicated memory allocations.
+	*/
+	VkResult VulkanDevice::createDeviceAddressBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data)
+	{
+		assert(vkGetBufferDeviceAddressKHR);
+		return createBuffer(usageFlags | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, memoryPropertyFlags, buffer, size, data);
+	}
+
+	/**
+	* Get the device address of a buffer created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+	*
+	* @return Device address of the buffer, 0 if the bufferDeviceAddress feature isn't enabled
+	*/
+	VkDeviceAddress VulkanDevice::getBufferDeviceAddress(VkBuffer buffer) const
+	{
+		if (!vkGetBufferDeviceAddressKHR)
+		{
+			return 0;
+		}
+		VkBufferDeviceAddressInfoKHR bufferDeviceAddressInfo{};
+		bufferDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+		bufferDeviceAddressInfo.buffer = buffer;
+		return vkGetBufferDeviceAddressKHR(logicalDevice, &bufferDeviceAddressInfo);
+	}
+
+	/**
+	* Allocate and bind the memory for an image
+	*
+	* @param image Image to allocate the memory for
+	* @param memoryPropertyFlags Memory properties for the image's memory (device local, host visible, etc.)
+	* @param memory Pointer to the memory handle the image is bound to
+	* @param allocation Pointer to the allocation that receives the sub-allocated range, left empty if the memory allocator is not enabled
+	* @param linear (Optional) Set to true for images with linear tiling (Defaults to false)
+	*
+	* @return VK_SUCCESS if the memory has been allocated and bound
+	*
+	* @note Release the memory with freeMemory()
+	*/
+	VkResult VulkanDevice::allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceMemory *memory, vks::MemoryAllocation *allocation, bool linear)
+	{
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(logicalDevice, image, &memReqs);
+		const uint32_t memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+		if (memoryAllocator)
+		{
+			VkResult result = memoryAllocator->allocate(memReqs, memoryTypeIndex, linear, allocation);
+			if (result != VK_SUCCESS)
+			{
+				return result;
+			}
+			*memory = allocation->memory;
+			return vkBindImageMemory(logicalDevice, image, allocation->memory, allocation->offset);
+		}
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = memoryTypeIndex;
+		VkResult result = allocateMemory(memAlloc, vks::MemoryCategory::Image, memory);
+		if (result != VK_SUCCESS)
+		{
+			return result;
+		}
+		return vkBindImageMemory(logicalDevice, image, *memory, 0);
+	}
+
+	/** @brief Release memory that has been allocated with allocateImageMemory() */
+	void VulkanDevice::freeMemory(VkDeviceMemory memory, vks::MemoryAllocation &allocation)
+	{
+		if (allocation.memory != VK_NULL_HANDLE)
+		{
+			memoryAllocator->free(allocation);
+		}
+		else
+		{
+			freeMemory(memory);
+		}
+	}
+
+	/**
+	* Allocate device memory and register it with the memory tracker
+	*
+	* @param allocateInfo Allocation parameters passed to vkAllocateMemory
+	* @param category Category the memory is tracked under
+	* @param memory Pointer to the memory handle acquired by the function
+	*
+	* @return VK_SUCCESS or the error returned by vkAllocateMemory
+	*
+	* @note Release the memory with freeMemory()
+	*/
+	VkResult VulkanDevice::allocateMemory(const VkMemoryAllocateInfo &allocateInfo, vks::MemoryCategory category, VkDeviceMemory *memory)
+	{
+		VkResult result = vkAllocateMemory(logicalDevice, &allocateInfo, nullptr, memory);
+		if (result == VK_SUCCESS)
+		{
+			memoryTracker.add(*memory, category, allocateInfo.allocationSize, allocateInfo.memoryTypeIndex);
+		}
+		return result;
+	}
+
+	/** @brief Release memory that has been allocated with allocateMemory() */
+	void VulkanDevice::freeMemory(VkDeviceMemory memory)
+	{
+		if (memory != VK_NULL_HANDLE)
+		{
+			memoryTracker.remove(memory);
+			vkFreeMemory(logicalDevice, memory, nullptr);
+		}
+	}
+
+	/**
+	* Flush the ranges written to mapped non-coherent buffers since the last call with a single vkFlushMappedMemoryRanges call
+	*
+	* @return VK_SUCCESS if there was nothing to flush, otherwise the result of the flush
+	*
+	* @note Call once per frame before the submission that reads the buffers marked with vks::Buffer::markDirty(), the example base does this
+	* before its own submissions
+	*/
+	VkResult VulkanDevice::flushMappedRanges()
+	{
+		if (!mappedRangeBatch)
+		{
+			return VK_SUCCESS;
+		}
+		return mappedRangeBatch->flush();
+	}
+
+	/**
+	* Get the device's staging ring, creating it on first use
+	*
+	* @note Uploads recorded into the ring are submitted before the next command buffer flushed on the default command pool, frame submissions of the example base do the same
+	*
+	* @return Pointer to the staging ring
+	*/
+	vks::StagingRing *VulkanDevice::getStagingRing()
+	{
+		if (!stagingRing)
+		{
+			VkQueue queue;
+			vkGetDeviceQueue(logicalDevice, queueFamilyIndices.graphics, 0, &queue);
+			stagingRing = new vks::StagingRing(this, queue, stagingRingSize);
+		}
+		return stagingRing;
+	}
+
+	/**
+	* Get the device's sampler cache, creating it on first use
+	*
+	* @return Pointer to the sampler cache, whose samplers stay valid until they have been released or the device is destroyed
+	*/
+	vks::SamplerCache *VulkanDevice::getSamplerCache()
+	{
+		if (!samplerCache)
+		{
+			samplerCache = new vks::SamplerCache(logicalDevice);
+		}
+		return samplerCache;
 	}
 
 	/**
@@ -516,10 +831,11 @@ namespace vks
 	* @param free (Optional) Free the command buffer once it has been submitted (Defaults to true)
 	*
 	* @note The queue that the command buffer is submitted to must be from the same family index as the pool it was allocated from
-	* @note Uses a fence to ensure command buffer has finished executing
+	* @note Uses a fence (or the flush timeline semaphore if timeline semaphores are enabled) to ensure command buffer has finished executing
 	*/
 	void VulkanDevice::flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, VkCommandPool pool, bool free)
 	{
+		VKS_TRACE_SCOPE("flushCommandBuffer");
 		if (commandBuffer == VK_NULL_HANDLE)
 		{
 			return;
@@ -527,18 +843,46 @@ namespace vks
 
 		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 
+		// Pending staged uploads are submitted first, so the flushed commands can use the uploaded resources
+		// Both submissions are made under the queue lock, so no other thread can submit between them
+		std::unique_lock<std::recursive_mutex> queueLock(queueMutex);
+		if (stagingRing && (pool == commandPool))
+		{
+			stagingRing->submit();
+		}
+
 		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffer;
-		// Create fence to ensure that the command buffer has finished executing
-		VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-		VkFence fence;
-		VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence));
-		// Submit to the queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
-		// Wait for the fence to signal that command buffer has finished executing
-		VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
-		vkDestroyFence(logicalDevice, fence, nullptr);
+		if (enableTimelineSemaphores)
+		{
+			// Signal the next value on the timeline and wait for exactly that point instead of creating a fence
+			// The value is taken and submitted under the queue lock, so concurrent flushes (e.g. from loading threads) signal increasing values in submission order
+			uint64_t signalValue;
+			VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+			timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineSubmitInfo.signalSemaphoreValueCount = 1;
+			timelineSubmitInfo.pSignalSemaphoreValues = &signalValue;
+			submitInfo.pNext = &timelineSubmitInfo;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &flushTimelineSemaphore;
+			signalValue = ++flushTimelineValue;
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+			queueLock.unlock();
+			waitTimelineSemaphore(flushTimelineSemaphore, signalValue);
+		}
+		else
+		{
+			// Create fence to ensure that the command buffer has finished executing
+			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+			VkFence fence;
+			VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence));
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+			queueLock.unlock();
+			// Wait for the fence to signal that command buffer has finished executing
+			VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			vkDestroyFence(logicalDevice, fence, nullptr);
+		}
 		if (free)
 		{
 			vkFreeCommandBuffers(logicalDevice, pool, 1, &commandBuffer);
@@ -550,6 +894,133 @@ namespace vks
 		return flushCommandBuffer(commandBuffer, queue, commandPool, free);
 	}
 
+	/**
+	* Submit command buffers to a queue of the device
+	*
+	* @note All queue operations of the framework and the examples go through this (or hold queueMutex), as uploads may be submitted from other threads
+	*/
+	VkResult VulkanDevice::queueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *submits, VkFence fence)
+	{
+		std::lock_guard<std::recursive_mutex> guard(queueMutex);
+		return vkQueueSubmit(queue, submitCount, submits, fence);
+	}
+
+	/** @brief Submit sparse binding operations to a queue of the device, see queueSubmit() */
+	VkResult VulkanDevice::queueBindSparse(VkQueue queue, uint32_t bindInfoCount, const VkBindSparseInfo *bindInfos, VkFence fence)
+	{
+		std::lock_guard<std::recursive_mutex> guard(queueMutex);
+		return vkQueueBindSparse(queue, bindInfoCount, bindInfos, fence);
+	}
+
+	/** @brief Wait for a queue of the device to become idle, see queueSubmit() */
+	VkResult VulkanDevice::queueWaitIdle(VkQueue queue)
+	{
+		std::lock_guard<std::recursive_mutex> guard(queueMutex);
+		return vkQueueWaitIdle(queue);
+	}
+
+	/**
+	* Create a timeline semaphore
+	*
+	* @param initialValue (Optional) Initial counter value of the semaphore (Defaults to 0)
+	*
+	* @note Requires VK_KHR_timeline_semaphore to be enabled on the device
+	*
+	* @return A handle to the created semaphore
+	*/
+	VkSemaphore VulkanDevice::createTimelineSemaphore(uint64_t initialValue)
+	{
+		assert(enableTimelineSemaphores);
+		VkSemaphoreTypeCreateInfoKHR semaphoreTypeCI{};
+		semaphoreTypeCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		semaphoreTypeCI.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		semaphoreTypeCI.initialValue = initialValue;
+		VkSemaphoreCreateInfo semaphoreCI = vks::initializers::semaphoreCreateInfo();
+		semaphoreCI.pNext = &semaphoreTypeCI;
+		VkSemaphore semaphore;
+		VK_CHECK_RESULT(vkCreateSemaphore(logicalDevice, &semaphoreCI, nullptr, &semaphore));
+		return semaphore;
+	}
+
+	/**
+	* Wait on the host until a timeline semaphore has reached (at least) the given value
+	*
+	* @param semaphore Timeline semaphore to wait on
+	* @param value Counter value to wait for
+	* @param (Optional) timeout Timeout in nanoseconds (Defaults to DEFAULT_FENCE_TIMEOUT)
+	*/
+	void VulkanDevice::waitTimelineSemaphore(VkSemaphore semaphore, uint64_t value, uint64_t timeout)
+	{
+		VkSemaphoreWaitInfoKHR waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &semaphore;
+		waitInfo.pValues = &value;
+		VK_CHECK_RESULT(vkWaitSemaphoresKHR(logicalDevice, &waitInfo, timeout));
+	}
+
+	/**
+	* Get the current counter value of a timeline semaphore without blocking
+	*
+	* @param semaphore Timeline semaphore to query
+	*
+	* @return Current counter value of the semaphore
+	*/
+	uint64_t VulkanDevice::getTimelineSemaphoreValue(VkSemaphore semaphore)
+	{
+		uint64_t value = 0;
+		VK_CHECK_RESULT(vkGetSemaphoreCounterValueKHR(logicalDevice, semaphore, &value));
+		return value;
+	}
+
+	/**
+	* Destroy resources once the GPU has finished the most recent work that may use them, instead of waiting for the device to become idle
+	*
+	* @param destroy Function destroying the resources, called from releaseDeferredDestructions() (capture the handles by value)
+	*
+	* @note Uses deferredDestructionValue, which the frame loop sets to the value of the frame being recorded
+	*/
+	void VulkanDevice::deferDestruction(std::function<void()> destroy)
+	{
+		deferDestruction(deferredDestructionValue, destroy);
+	}
+
+	/**
+	* Destroy resources once the work tagged with the given value has finished
+	*
+	* @param retireValue Value of the last frame (or timeline signal) that may use the resources, has to be from the same counter as the values passed to releaseDeferredDestructions()
+	* @param destroy Function destroying the resources, called from releaseDeferredDestructions() (capture the handles by value)
+	*/
+	void VulkanDevice::deferDestruction(uint64_t retireValue, std::function<void()> destroy)
+	{
+		DeferredDestruction deferred;
+		deferred.retireValue = retireValue;
+		deferred.destroy = destroy;
+		// Kept sorted by value, values are usually increasing so this appends
+		auto it = deferredDestructions.end();
+		while ((it != deferredDestructions.begin()) && (std::prev(it)->retireValue > retireValue))
+		{
+			--it;
+		}
+		deferredDestructions.insert(it, deferred);
+	}
+
+	/**
+	* Run the deferred destruction of all resources whose work has finished
+	*
+	* @param (Optional) completedValue Value of the last frame (or timeline signal) the GPU has finished, work is assumed to finish in order (Defaults to all, e.g. after waiting for the device)
+	*/
+	void VulkanDevice::releaseDeferredDestructions(uint64_t completedValue)
+	{
+		while (!deferredDestructions.empty() && (deferredDestructions.front().retireValue <= completedValue))
+		{
+			// Taken out first, as the function may defer further destructions
+			std::function<void()> destroy = deferredDestructions.front().destroy;
+			deferredDestructions.pop_front();
+			destroy();
+		}
+	}
+
 	/**
 	* Check if an extension is supported by the (physical device)
 	*
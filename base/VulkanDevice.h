@@ -11,11 +11,19 @@
 #pragma once
 
 #include "VulkanBuffer.h"
+#include "VulkanMappedRangeBatch.h"
+#include "VulkanMemoryAllocator.h"
+#include "VulkanMemoryTracker.h"
+#include "VulkanSamplerCache.h"
+#include "VulkanStagingRing.h"
 #include "VulkanTools.h"
 #include "vulkan/vulkan.h"
 #include <algorithm>
 #include <assert.h>
+#include <deque>
 #include <exception>
+#include <functional>
+#include <mutex>
 
 namespace vks
 {
@@ -41,6 +49,50 @@ struct VulkanDevice
 	VkCommandPool commandPool = VK_NULL_HANDLE;
 	/** @brief Set to true when the debug marker extension is detected */
 	bool enableDebugMarkers = false;
+	/** @brief Set to true when VK_KHR_timeline_semaphore has been enabled at device creation */
+	bool enableTimelineSemaphores = false;
+	/** @brief Timeline semaphore signaled by command buffer flushes (only valid if timeline semaphores are enabled) */
+	VkSemaphore flushTimelineSemaphore = VK_NULL_HANDLE;
+	/** @brief Last value that has been submitted for signaling the flush timeline semaphore */
+	uint64_t flushTimelineValue = 0;
+	/** @brief Serializes all queue operations of the framework and the examples, queue access has to be externally synchronized and uploads may be submitted from other threads (recursive, so a flush can submit the staging ring while holding it) */
+	std::recursive_mutex queueMutex;
+	PFN_vkWaitSemaphoresKHR vkWaitSemaphoresKHR = nullptr;
+	PFN_vkGetSemaphoreCounterValueKHR vkGetSemaphoreCounterValueKHR = nullptr;
+	/** @brief Set to true when VK_EXT_image_compression_control has been enabled at device creation, see vks::createAttachmentImage */
+	bool enableImageCompressionControl = false;
+	PFN_vkGetImageSubresourceLayout2EXT vkGetImageSubresourceLayout2EXT = nullptr;
+	/** @brief Set to true when VK_KHR_pipeline_executable_properties has been enabled at device creation, pipelines created with VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR can then report their shader statistics */
+	bool enablePipelineExecutableInfo = false;
+	PFN_vkGetPipelineExecutablePropertiesKHR vkGetPipelineExecutablePropertiesKHR = nullptr;
+	PFN_vkGetPipelineExecutableStatisticsKHR vkGetPipelineExecutableStatisticsKHR = nullptr;
+	/** @brief Only available if the bufferDeviceAddress feature has been enabled (VK_KHR_buffer_device_address or Vulkan 1.2) */
+	PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR = nullptr;
+	/** @brief Set to true before creating the logical device to sub-allocate buffer and texture memory from larger blocks */
+	bool enableMemoryAllocator = false;
+	/** @brief Memory sub-allocator, only valid if enabled at device creation */
+	vks::MemoryAllocator *memoryAllocator = nullptr;
+	/** @brief Set to false before creating the logical device to flush writes to non-coherent buffers immediately instead of once per frame, see flushMappedRanges() */
+	bool batchMappedRangeFlushes = true;
+	/** @brief Ranges written to mapped non-coherent buffers since the last flushMappedRanges(), only valid if batching is enabled at device creation */
+	vks::MappedRangeBatch *mappedRangeBatch = nullptr;
+	/** @brief Tracks the device memory allocated through this device by category, allocations still tracked at destruction are reported as leaks */
+	vks::MemoryTracker memoryTracker;
+	/** @brief Size of the staging ring buffer in bytes (must be set before the ring is first used) */
+	VkDeviceSize stagingRingSize = 32 * 1024 * 1024;
+	/** @brief Staging ring for batched uploads, created on first use by getStagingRing() */
+	vks::StagingRing *stagingRing = nullptr;
+	/** @brief Samplers shared by all users requesting the same sampler state, created on first use by getSamplerCache() */
+	vks::SamplerCache *samplerCache = nullptr;
+	/** @brief Resource destruction waiting for the GPU to finish the work that may use the resources, see deferDestruction() */
+	struct DeferredDestruction
+	{
+		uint64_t retireValue;
+		std::function<void()> destroy;
+	};
+	std::deque<DeferredDestruction> deferredDestructions;
+	/** @brief Frame (or timeline) value of the most recent work that may use resources deferred without an explicit value, set by the frame loop */
+	uint64_t deferredDestructionValue = 0;
 	/** @brief Contains queue family indices */
 	struct
 	{
@@ -59,12 +111,30 @@ struct VulkanDevice
 	VkResult        createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char *> enabledExtensions, void *pNextChain, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
 	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data = nullptr);
 	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr);
+	VkResult        createDeviceAddressBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr);
+	VkDeviceAddress getBufferDeviceAddress(VkBuffer buffer) const;
+	VkResult        allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceMemory *memory, vks::MemoryAllocation *allocation, bool linear = false);
+	void            freeMemory(VkDeviceMemory memory, vks::MemoryAllocation &allocation);
+	VkResult        allocateMemory(const VkMemoryAllocateInfo &allocateInfo, vks::MemoryCategory category, VkDeviceMemory *memory);
+	void            freeMemory(VkDeviceMemory memory);
+	VkResult        flushMappedRanges();
+	vks::StagingRing *getStagingRing();
+	vks::SamplerCache *getSamplerCache();
 	void            copyBuffer(vks::Buffer *src, vks::Buffer *dst, VkQueue queue, VkBufferCopy *copyRegion = nullptr);
 	VkCommandPool   createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags createFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 	VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, VkCommandPool pool, bool begin = false);
 	VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, bool begin = false);
 	void            flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, VkCommandPool pool, bool free = true);
 	void            flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free = true);
+	VkResult        queueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *submits, VkFence fence);
+	VkResult        queueBindSparse(VkQueue queue, uint32_t bindInfoCount, const VkBindSparseInfo *bindInfos, VkFence fence);
+	VkResult        queueWaitIdle(VkQueue queue);
+	VkSemaphore     createTimelineSemaphore(uint64_t initialValue = 0);
+	void            waitTimelineSemaphore(VkSemaphore semaphore, uint64_t value, uint64_t timeout = DEFAULT_FENCE_TIMEOUT);
+	uint64_t        getTimelineSemaphoreValue(VkSemaphore semaphore);
+	void            deferDestruction(std::function<void()> destroy);
+	void            deferDestruction(uint64_t retireValue, std::function<void()> destroy);
+	void            releaseDeferredDestructions(uint64_t completedValue = UINT64_MAX);
 	bool            extensionSupported(std::string extension);
 	VkFormat        getSupportedDepthFormat(bool checkSamplingSupport);
 };
@@ -0,0 +1,808 @@
+/*
+* Realtime environment probes
+*
+* Captures the scene into a cube map at each probe's position with a single multiview pass and filters it into an irradiance and a
+* prefiltered environment cube on the compute queue, updating a budgeted number of steps per frame so reflections follow dynamic scenes
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanEnvironmentProbes.h"
+#include "VulkanDevice.h"
+#include "VulkanIBLGenerator.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace vks
+{
+	const uint32_t EnvironmentProbes::captureDim;
+	const uint32_t EnvironmentProbes::irradianceDim;
+	const uint32_t EnvironmentProbes::prefilteredDim;
+	const VkFormat EnvironmentProbes::captureFormat;
+
+	namespace
+	{
+		// Work group size of the filter shaders in x and y
+		const uint32_t cubeGroupSize = 8;
+		// Prefiltered levels smaller than this are filtered by a single step
+		const uint32_t minStepDim = 32;
+		// Submissions in flight per queue
+		const uint32_t slotCount = 2;
+
+		struct IrradiancePushConstants {
+			float deltaPhi;
+			float deltaTheta;
+		};
+
+		struct PrefilterPushConstants {
+			float roughness;
+			uint32_t numSamples;
+		};
+
+		uint32_t getMipLevels(uint32_t dim)
+		{
+			return static_cast<uint32_t>(std::floor(std::log2(dim))) + 1;
+		}
+	}
+
+	/**
+	* Create the probes, their capture and output images and the filter pipelines
+	*
+	* @param device Device to create the probes on
+	* @param queue Graphics queue the captures are submitted to, the filters are submitted to the device's compute queue
+	* @param shadersPath Shader directory containing the SPIR-V files of the "base/*.comp" shaders (e.g. getShadersPath())
+	* @param probeCount Number of probes, all placed at the origin until moved with setPosition()
+	* @param drawFunction Records the scene into the capture pass of a probe
+	*/
+	EnvironmentProbes::EnvironmentProbes(vks::VulkanDevice *device, VkQueue queue, const std::string &shadersPath, uint32_t probeCount, DrawFunction drawFunction) : device(device), graphicsQueue(queue), drawFunction(drawFunction)
+	{
+		assert(probeCount > 0);
+		captureMipLevels = getMipLevels(captureDim);
+		irradianceMipLevels = getMipLevels(irradianceDim);
+		prefilteredMipLevels = getMipLevels(prefilteredDim);
+
+		// The irradiance cube is small and filtered by one step, the large levels of the prefiltered cube get a step each
+		filterSteps.push_back({ true, 0, irradianceMipLevels });
+		for (uint32_t m = 0; m < prefilteredMipLevels; m++)
+		{
+			if ((prefilteredDim >> m) < minStepDim)
+			{
+				filterSteps.push_back({ false, m, prefilteredMipLevels - m });
+				break;
+			}
+			filterSteps.push_back({ false, m, 1 });
+		}
+
+		vkGetDeviceQueue(device->logicalDevice, device->queueFamilyIndices.compute, 0, &computeQueue);
+		queueFamilyIndices.push_back(device->queueFamilyIndices.graphics);
+		if (device->queueFamilyIndices.compute != device->queueFamilyIndices.graphics)
+		{
+			queueFamilyIndices.push_back(device->queueFamilyIndices.compute);
+		}
+
+		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(device->physicalDevice, &depthFormat);
+		assert(validDepthFormat);
+
+		createRenderPass();
+		createDepthAttachment();
+		createPipelines(shadersPath);
+
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.minLod = 0.0f;
+		samplerCI.maxLod = static_cast<float>(captureMipLevels);
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &captureSampler));
+
+		// Each output has a descriptor set per mip level of both cubes
+		const uint32_t setCount = probeCount * 2 * (irradianceMipLevels + prefilteredMipLevels);
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, setCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+
+		probes.resize(probeCount);
+		for (Probe &probe : probes)
+		{
+			createProbe(probe);
+		}
+		clearOutputs();
+
+		graphicsCommandPool = device->createCommandPool(device->queueFamilyIndices.graphics);
+		computeCommandPool = device->createCommandPool(device->queueFamilyIndices.compute);
+		VkSemaphoreCreateInfo semaphoreCI = vks::initializers::semaphoreCreateInfo();
+		VkFenceCreateInfo fenceCI = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+		graphicsSlots.resize(slotCount);
+		computeSlots.resize(slotCount);
+		for (SubmitSlot &slot : graphicsSlots)
+		{
+			slot.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, graphicsCommandPool);
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceCI, nullptr, &slot.fence));
+			VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCI, nullptr, &slot.semaphore));
+		}
+		for (SubmitSlot &slot : computeSlots)
+		{
+			slot.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, computeCommandPool);
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceCI, nullptr, &slot.fence));
+		}
+	}
+
+	EnvironmentProbes::~EnvironmentProbes()
+	{
+		// Wait for the captures and filters still in flight
+		for (const SubmitSlot &slot : graphicsSlots)
+		{
+			VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+			vkDestroyFence(device->logicalDevice, slot.fence, nullptr);
+			vkDestroySemaphore(device->logicalDevice, slot.semaphore, nullptr);
+		}
+		for (const SubmitSlot &slot : computeSlots)
+		{
+			VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+			vkDestroyFence(device->logicalDevice, slot.fence, nullptr);
+		}
+		vkDestroyCommandPool(device->logicalDevice, graphicsCommandPool, nullptr);
+		vkDestroyCommandPool(device->logicalDevice, computeCommandPool, nullptr);
+		for (Probe &probe : probes)
+		{
+			destroyProbe(probe);
+		}
+		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		vkDestroySampler(device->logicalDevice, captureSampler, nullptr);
+		vkDestroyPipeline(device->logicalDevice, irradiancePipeline, nullptr);
+		vkDestroyPipeline(device->logicalDevice, prefilterPipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		vkDestroyShaderModule(device->logicalDevice, irradianceModule, nullptr);
+		vkDestroyShaderModule(device->logicalDevice, prefilterModule, nullptr);
+		vkDestroyRenderPass(device->logicalDevice, renderPass, nullptr);
+		vkDestroyImageView(device->logicalDevice, depthView, nullptr);
+		vkDestroyImage(device->logicalDevice, depthImage, nullptr);
+		device->freeMemory(depthMemory, depthAllocation);
+	}
+
+	/** @brief Create the multiview render pass rendering all six faces of a capture */
+	void EnvironmentProbes::createRenderPass()
+	{
+		std::array<VkAttachmentDescription, 2> attachments = {};
+		// The capture's base level is the source of the mip chain blits
+		attachments[0].format = captureFormat;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		// The depth attachment is shared by all probes and not needed after the pass
+		attachments[1].format = depthFormat;
+		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorReference;
+		subpass.pDepthStencilAttachment = &depthReference;
+
+		// Several probes may be captured in a row, each reusing the depth attachment of the previous one
+		std::array<VkSubpassDependency, 2> dependencies{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+		// The base level is read by the blits generating the mip chain
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		// All six faces are rendered by the single subpass, they see the same scene from the same position so they're correlated
+		const uint32_t viewMask = 0b00111111;
+		const uint32_t correlationMask = 0b00111111;
+
+		VkRenderPassMultiviewCreateInfo renderPassMultiviewCI{};
+		renderPassMultiviewCI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+		renderPassMultiviewCI.subpassCount = 1;
+		renderPassMultiviewCI.pViewMasks = &viewMask;
+		renderPassMultiviewCI.correlationMaskCount = 1;
+		renderPassMultiviewCI.pCorrelationMasks = &correlationMask;
+
+		VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+		renderPassCI.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassCI.pAttachments = attachments.data();
+		renderPassCI.subpassCount = 1;
+		renderPassCI.pSubpasses = &subpass;
+		renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassCI.pDependencies = dependencies.data();
+		renderPassCI.pNext = &renderPassMultiviewCI;
+		VK_CHECK_RESULT(vkCreateRenderPass(device->logicalDevice, &renderPassCI, nullptr, &renderPass));
+	}
+
+	/** @brief Create the layered depth attachment with one layer per face */
+	void EnvironmentProbes::createDepthAttachment()
+	{
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = depthFormat;
+		imageCI.extent = { captureDim, captureDim, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 6;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &depthImage));
+		VK_CHECK_RESULT(device->allocateImageMemory(depthImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthMemory, &depthAllocation));
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewCI.format = depthFormat;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 6 };
+		if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT)
+		{
+			viewCI.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		viewCI.image = depthImage;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &depthView));
+	}
+
+	/** @brief Load the filter shaders of vks::IBLGenerator and create their pipelines */
+	void EnvironmentProbes::createPipelines(const std::string &shadersPath)
+	{
+#if defined(__ANDROID__)
+		irradianceModule = vks::tools::loadShader(androidApp->activity->assetManager, (shadersPath + "base/irradiancecube.comp.spv").c_str(), device->logicalDevice);
+		prefilterModule = vks::tools::loadShader(androidApp->activity->assetManager, (shadersPath + "base/prefilterenvmap.comp.spv").c_str(), device->logicalDevice);
+#else
+		irradianceModule = vks::tools::loadShader((shadersPath + "base/irradiancecube.comp.spv").c_str(), device->logicalDevice);
+		prefilterModule = vks::tools::loadShader((shadersPath + "base/prefilterenvmap.comp.spv").c_str(), device->logicalDevice);
+#endif
+		if ((irradianceModule == VK_NULL_HANDLE) || (prefilterModule == VK_NULL_HANDLE))
+		{
+			vks::tools::exitFatal("Could not load the environment probe filter shaders from " + shadersPath + "base/", -1);
+		}
+
+		// Same layout as the filters of vks::IBLGenerator, binding 2 isn't used by them
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Capture cube map
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Mip level written by the dispatch, all faces of a cube as an array
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		static_assert(sizeof(IrradiancePushConstants) == sizeof(PrefilterPushConstants), "Both cube shaders use the same push constant range");
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PrefilterPushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCI.stage.pName = "main";
+		pipelineCI.stage.module = irradianceModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &irradiancePipeline));
+		pipelineCI.stage.module = prefilterModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &prefilterPipeline));
+	}
+
+	/** @brief Create the capture image, its views, framebuffer and uniform buffer, and both outputs of a probe */
+	void EnvironmentProbes::createProbe(Probe &probe)
+	{
+		// Rendered to by the graphics queue and sampled by the compute queue
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = captureFormat;
+		imageCI.extent = { captureDim, captureDim, 1 };
+		imageCI.mipLevels = captureMipLevels;
+		imageCI.arrayLayers = 6;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+		if (queueFamilyIndices.size() > 1)
+		{
+			imageCI.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			imageCI.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+			imageCI.pQueueFamilyIndices = queueFamilyIndices.data();
+		}
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &probe.captureImage));
+		VK_CHECK_RESULT(device->allocateImageMemory(probe.captureImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &probe.captureMemory, &probe.captureAllocation));
+
+		// Multiview attachments need one layer per view, the faces are rendered through a 2D array view
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewCI.format = captureFormat;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6 };
+		viewCI.image = probe.captureImage;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &probe.captureAttachmentView));
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
+		viewCI.subresourceRange.levelCount = captureMipLevels;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &probe.captureCubeView));
+
+		VkImageView attachments[2] = { probe.captureAttachmentView, depthView };
+		VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+		framebufferCI.renderPass = renderPass;
+		framebufferCI.attachmentCount = 2;
+		framebufferCI.pAttachments = attachments;
+		framebufferCI.width = captureDim;
+		framebufferCI.height = captureDim;
+		// With multiview the layers are selected by the view mask, the framebuffer itself has a single layer
+		framebufferCI.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device->logicalDevice, &framebufferCI, nullptr, &probe.framebuffer));
+
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &probe.uniformBuffer, sizeof(CaptureUniforms)));
+		VK_CHECK_RESULT(probe.uniformBuffer.map());
+
+		for (Output &output : probe.outputs)
+		{
+			createOutputTexture(output.irradianceCube, vks::IBLGenerator::irradianceFormat, irradianceDim, irradianceMipLevels);
+			createOutputTexture(output.prefilteredCube, vks::IBLGenerator::prefilteredFormat, prefilteredDim, prefilteredMipLevels);
+			createOutputDescriptorSets(probe, output);
+		}
+	}
+
+	/** @brief Create an output cube written by the compute queue and sampled by the graphics queue */
+	void EnvironmentProbes::createOutputTexture(vks::TextureCubeMap &texture, VkFormat format, uint32_t dim, uint32_t mipLevels)
+	{
+		texture.device = device;
+		texture.width = dim;
+		texture.height = dim;
+		texture.mipLevels = mipLevels;
+		texture.layerCount = 6;
+		texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = format;
+		imageCI.extent = { dim, dim, 1 };
+		imageCI.mipLevels = mipLevels;
+		imageCI.arrayLayers = 6;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		// Transfer destination for the initial clear
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+		if (queueFamilyIndices.size() > 1)
+		{
+			imageCI.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			imageCI.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+			imageCI.pQueueFamilyIndices = queueFamilyIndices.data();
+		}
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &texture.image));
+		VK_CHECK_RESULT(device->allocateImageMemory(texture.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture.deviceMemory, &texture.allocation));
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
+		viewCI.format = format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 6 };
+		viewCI.image = texture.image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &texture.view));
+
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.minLod = 0.0f;
+		samplerCI.maxLod = static_cast<float>(mipLevels);
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &texture.sampler));
+		texture.updateDescriptor();
+	}
+
+	/** @brief Create the storage views and descriptor sets of the mip levels of an output */
+	void EnvironmentProbes::createOutputDescriptorSets(Probe &probe, Output &output)
+	{
+		VkDescriptorImageInfo captureDescriptor = vks::initializers::descriptorImageInfo(captureSampler, probe.captureCubeView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		const vks::TextureCubeMap *textures[2] = { &output.irradianceCube, &output.prefilteredCube };
+		const VkFormat formats[2] = { vks::IBLGenerator::irradianceFormat, vks::IBLGenerator::prefilteredFormat };
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			for (uint32_t m = 0; m < textures[i]->mipLevels; m++)
+			{
+				// Cube views can't be storage images, the faces are written as the layers of an array
+				VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+				viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+				viewCI.format = formats[i];
+				viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, m, 1, 0, 6 };
+				viewCI.image = textures[i]->image;
+				VkImageView view;
+				VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &view));
+				output.mipViews.push_back(view);
+
+				VkDescriptorSet descriptorSet;
+				VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+				VkDescriptorImageInfo storageDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL);
+				std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+					vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &captureDescriptor),
+					vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &storageDescriptor),
+				};
+				vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+				output.descriptorSets.push_back(descriptorSet);
+			}
+		}
+	}
+
+	/** @brief Clear all outputs to black, so they can be sampled before the first update of their probe has completed */
+	void EnvironmentProbes::clearOutputs()
+	{
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		const VkClearColorValue clearColor = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		for (Probe &probe : probes)
+		{
+			for (Output &output : probe.outputs)
+			{
+				for (const vks::TextureCubeMap *texture : { &output.irradianceCube, &output.prefilteredCube })
+				{
+					const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture->mipLevels, 0, 6 };
+					vks::tools::insertImageMemoryBarrier(commandBuffer, texture->image, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+						VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
+					vkCmdClearColorImage(commandBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &subresourceRange);
+					vks::tools::insertImageMemoryBarrier(commandBuffer, texture->image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+						VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, subresourceRange);
+				}
+			}
+		}
+		device->flushCommandBuffer(commandBuffer, graphicsQueue, true);
+	}
+
+	void EnvironmentProbes::destroyProbe(Probe &probe)
+	{
+		for (Output &output : probe.outputs)
+		{
+			for (VkImageView view : output.mipViews)
+			{
+				vkDestroyImageView(device->logicalDevice, view, nullptr);
+			}
+			output.irradianceCube.destroy();
+			output.prefilteredCube.destroy();
+		}
+		probe.uniformBuffer.destroy();
+		vkDestroyFramebuffer(device->logicalDevice, probe.framebuffer, nullptr);
+		vkDestroyImageView(device->logicalDevice, probe.captureAttachmentView, nullptr);
+		vkDestroyImageView(device->logicalDevice, probe.captureCubeView, nullptr);
+		vkDestroyImage(device->logicalDevice, probe.captureImage, nullptr);
+		device->freeMemory(probe.captureMemory, probe.captureAllocation);
+	}
+
+	/** @brief Check if a compute submission has finished, slots are only reused once their previous submission has finished */
+	bool EnvironmentProbes::isSubmissionComplete(uint64_t submission) const
+	{
+		for (const SubmitSlot &slot : computeSlots)
+		{
+			if (slot.submission == submission)
+			{
+				return vkGetFenceStatus(device->logicalDevice, slot.fence) == VK_SUCCESS;
+			}
+		}
+		return true;
+	}
+
+	/** @brief Wait for the slot's previous submission and begin its command buffer */
+	void EnvironmentProbes::beginSlot(SubmitSlot &slot)
+	{
+		VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+		VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &slot.fence));
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(slot.commandBuffer, &cmdBufInfo));
+	}
+
+	/** @brief Begin a compute command buffer, its first barrier orders the steps after those of earlier submissions, which waited for the captures they filter */
+	void EnvironmentProbes::beginComputeSlot(SubmitSlot &slot)
+	{
+		beginSlot(slot);
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(slot.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	/** @brief Record the capture of a probe's surroundings into its cube map and the generation of the cube map's mip chain */
+	void EnvironmentProbes::recordCapture(VkCommandBuffer commandBuffer, uint32_t probeIndex)
+	{
+		Probe &probe = probes[probeIndex];
+
+		// The last capture of the probe has been filtered, so its uniform buffer isn't in use anymore
+		CaptureUniforms uniforms;
+		const glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, settings.zNear, settings.zFar);
+		// Directions and up vectors matching "Cube Map Face Selection" in the Vulkan specification, with y pointing down in framebuffer space
+		const glm::vec3 directions[6] = { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+		const glm::vec3 ups[6] = { glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) };
+		for (uint32_t face = 0; face < 6; face++)
+		{
+			uniforms.viewProjection[face] = projection * glm::lookAt(probe.position, probe.position + directions[face], ups[face]);
+		}
+		uniforms.position = glm::vec4(probe.position, 1.0f);
+		memcpy(probe.uniformBuffer.mapped, &uniforms, sizeof(uniforms));
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.framebuffer = probe.framebuffer;
+		renderPassBeginInfo.renderArea.extent.width = captureDim;
+		renderPassBeginInfo.renderArea.extent.height = captureDim;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)captureDim, (float)captureDim, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(captureDim, captureDim, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		drawFunction(commandBuffer, probeIndex);
+		vkCmdEndRenderPass(commandBuffer);
+
+		// Each level is blitted from the previous one, all faces at once
+		for (uint32_t m = 1; m < captureMipLevels; m++)
+		{
+			const VkImageSubresourceRange mipRange = { VK_IMAGE_ASPECT_COLOR_BIT, m, 1, 0, 6 };
+			vks::tools::insertImageMemoryBarrier(commandBuffer, probe.captureImage, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, mipRange);
+			VkImageBlit blit{};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, m - 1, 0, 6 };
+			blit.srcOffsets[1] = { int32_t(captureDim >> (m - 1)), int32_t(captureDim >> (m - 1)), 1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, m, 0, 6 };
+			blit.dstOffsets[1] = { int32_t(captureDim >> m), int32_t(captureDim >> m), 1 };
+			vkCmdBlitImage(commandBuffer, probe.captureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, probe.captureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+			vks::tools::insertImageMemoryBarrier(commandBuffer, probe.captureImage, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, mipRange);
+		}
+		// The filters on the compute queue wait for the semaphore signaled by this submission, which makes the writes visible to them
+		const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, captureMipLevels, 0, 6 };
+		vks::tools::insertImageMemoryBarrier(commandBuffer, probe.captureImage, VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, subresourceRange);
+	}
+
+	/** @brief Record a filter step of a probe into its back output */
+	void EnvironmentProbes::recordFilterStep(VkCommandBuffer commandBuffer, Probe &probe, uint32_t stepIndex)
+	{
+		Output &output = probe.outputs[1 - probe.readIndex];
+		const FilterStep &step = filterSteps[stepIndex];
+		const VkImageSubresourceRange irradianceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, irradianceMipLevels, 0, 6 };
+		const VkImageSubresourceRange prefilteredRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, prefilteredMipLevels, 0, 6 };
+
+		// The first step of an update transitions the whole output, its last reads by the graphics queue happened before the capture
+		if (stepIndex == 0)
+		{
+			vks::tools::insertImageMemoryBarrier(commandBuffer, output.irradianceCube.image, 0, VK_ACCESS_SHADER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, irradianceRange);
+			vks::tools::insertImageMemoryBarrier(commandBuffer, output.prefilteredCube.image, 0, VK_ACCESS_SHADER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, prefilteredRange);
+		}
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, step.irradiance ? irradiancePipeline : prefilterPipeline);
+		for (uint32_t m = step.firstMip; m < step.firstMip + step.mipCount; m++)
+		{
+			uint32_t size;
+			VkDescriptorSet descriptorSet;
+			if (step.irradiance)
+			{
+				IrradiancePushConstants pushConstants = { settings.irradianceDeltaPhi, settings.irradianceDeltaTheta };
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+				size = std::max(irradianceDim >> m, 1u);
+				descriptorSet = output.descriptorSets[m];
+			}
+			else
+			{
+				PrefilterPushConstants pushConstants = { (float)m / (float)(prefilteredMipLevels - 1), settings.prefilteredSamples };
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+				size = std::max(prefilteredDim >> m, 1u);
+				descriptorSet = output.descriptorSets[irradianceMipLevels + m];
+			}
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			// One dispatch per mip level, z selects the cube face
+			const uint32_t groupCount = (size + cubeGroupSize - 1) / cubeGroupSize;
+			vkCmdDispatch(commandBuffer, groupCount, groupCount, 6);
+		}
+
+		// The outputs are swapped by the host once the submission's fence has been signaled, the graphics queue samples them after that
+		if (stepIndex + 1 == filterSteps.size())
+		{
+			vks::tools::insertImageMemoryBarrier(commandBuffer, output.irradianceCube.image, VK_ACCESS_SHADER_WRITE_BIT, 0,
+				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, irradianceRange);
+			vks::tools::insertImageMemoryBarrier(commandBuffer, output.prefilteredCube.image, VK_ACCESS_SHADER_WRITE_BIT, 0,
+				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, prefilteredRange);
+		}
+	}
+
+	/**
+	* Swap the outputs of finished probe updates, then record and submit the next steps within the budget of Settings::stepsPerFrame
+	*
+	* @note Waits for the submissions of the update before the last one, which have usually finished
+	*/
+	void EnvironmentProbes::update()
+	{
+		statistics.captures = 0;
+		statistics.filterSteps = 0;
+
+		for (Probe &probe : probes)
+		{
+			if (probe.swapPending && isSubmissionComplete(probe.lastSubmission))
+			{
+				probe.readIndex = 1 - probe.readIndex;
+				probe.swapPending = false;
+				statistics.completedUpdates++;
+			}
+		}
+
+		SubmitSlot &graphicsSlot = graphicsSlots[frame % slotCount];
+		SubmitSlot &computeSlot = computeSlots[frame % slotCount];
+		bool graphicsRecording = false;
+		bool computeRecording = false;
+		uint32_t budget = std::max(settings.stepsPerFrame, 1u);
+		// Probes skipped in a row as their last update hasn't been swapped yet
+		uint32_t skipped = 0;
+		while ((budget > 0) && (skipped < probes.size()))
+		{
+			Probe &probe = probes[currentProbe];
+			if (probe.step == 0)
+			{
+				// The capture would overwrite the source of filters that may still be running, and the back output is still to be swapped
+				if (probe.swapPending)
+				{
+					currentProbe = (currentProbe + 1) % static_cast<uint32_t>(probes.size());
+					skipped++;
+					continue;
+				}
+				if (!graphicsRecording)
+				{
+					beginSlot(graphicsSlot);
+					graphicsRecording = true;
+				}
+				recordCapture(graphicsSlot.commandBuffer, currentProbe);
+				statistics.captures++;
+				probe.step++;
+			}
+			else
+			{
+				if (!computeRecording)
+				{
+					beginComputeSlot(computeSlot);
+					computeRecording = true;
+				}
+				recordFilterStep(computeSlot.commandBuffer, probe, probe.step - 1);
+				statistics.filterSteps++;
+				probe.step++;
+				if (probe.step > filterSteps.size())
+				{
+					probe.step = 0;
+					probe.swapPending = true;
+					probe.lastSubmission = computeSubmissions + 1;
+					currentProbe = (currentProbe + 1) % static_cast<uint32_t>(probes.size());
+				}
+			}
+			skipped = 0;
+			budget--;
+		}
+
+		if (graphicsRecording)
+		{
+			VK_CHECK_RESULT(vkEndCommandBuffer(graphicsSlot.commandBuffer));
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &graphicsSlot.commandBuffer;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &graphicsSlot.semaphore;
+			VK_CHECK_RESULT(device->queueSubmit(graphicsQueue, 1, &submitInfo, graphicsSlot.fence));
+		}
+		// The capture's semaphore is always waited on by this update's compute submission, as a binary semaphore can't be signaled twice
+		if (graphicsRecording && !computeRecording)
+		{
+			beginComputeSlot(computeSlot);
+			computeRecording = true;
+		}
+		if (computeRecording)
+		{
+			VK_CHECK_RESULT(vkEndCommandBuffer(computeSlot.commandBuffer));
+			const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &computeSlot.commandBuffer;
+			if (graphicsRecording)
+			{
+				submitInfo.waitSemaphoreCount = 1;
+				submitInfo.pWaitSemaphores = &graphicsSlot.semaphore;
+				submitInfo.pWaitDstStageMask = &waitStage;
+			}
+			VK_CHECK_RESULT(device->queueSubmit(computeQueue, 1, &submitInfo, computeSlot.fence));
+			computeSlot.submission = ++computeSubmissions;
+		}
+		frame++;
+	}
+
+	void EnvironmentProbes::setPosition(uint32_t probe, const glm::vec3 &position)
+	{
+		assert(probe < probes.size());
+		// Used by the probe's next capture
+		probes[probe].position = position;
+	}
+
+	const glm::vec3 &EnvironmentProbes::getPosition(uint32_t probe) const
+	{
+		return probes[probe].position;
+	}
+
+	uint32_t EnvironmentProbes::getProbeCount() const
+	{
+		return static_cast<uint32_t>(probes.size());
+	}
+
+	/** @brief Index of the output (0 or 1) to sample for a probe, may change with each update() */
+	uint32_t EnvironmentProbes::getReadIndex(uint32_t probe) const
+	{
+		return probes[probe].readIndex;
+	}
+
+	const vks::TextureCubeMap &EnvironmentProbes::getIrradianceCube(uint32_t probe, uint32_t index) const
+	{
+		return probes[probe].outputs[index].irradianceCube;
+	}
+
+	const vks::TextureCubeMap &EnvironmentProbes::getPrefilteredCube(uint32_t probe, uint32_t index) const
+	{
+		return probes[probe].outputs[index].prefilteredCube;
+	}
+
+	/** @brief Uniform buffer with the CaptureUniforms of a probe, to be bound by the capture pipelines */
+	const VkDescriptorBufferInfo &EnvironmentProbes::getCaptureDescriptor(uint32_t probe) const
+	{
+		return probes[probe].uniformBuffer.descriptor;
+	}
+
+	VkRenderPass EnvironmentProbes::getRenderPass() const
+	{
+		return renderPass;
+	}
+
+	uint32_t EnvironmentProbes::getPrefilteredMipLevels() const
+	{
+		return prefilteredMipLevels;
+	}
+
+	void EnvironmentProbes::setSettings(const Settings &settings)
+	{
+		this->settings = settings;
+	}
+
+	const EnvironmentProbes::Settings &EnvironmentProbes::getSettings() const
+	{
+		return settings;
+	}
+
+	const EnvironmentProbes::Statistics &EnvironmentProbes::getStatistics() const
+	{
+		return statistics;
+	}
+}
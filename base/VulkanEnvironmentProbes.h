@@ -0,0 +1,197 @@
+/*
+* Realtime environment probes
+*
+* Captures the scene into a cube map at each probe's position with a single multiview pass and filters it into an irradiance and a
+* prefiltered environment cube on the compute queue, updating a budgeted number of steps per frame so reflections follow dynamic scenes
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+#include "VulkanTexture.h"
+#include "VulkanMemoryAllocator.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Dynamic image based lighting probes, filtered with the "base/irradiancecube.comp" and "base/prefilterenvmap.comp" compute shaders
+	*
+	* Usage:
+	*	// Requires VK_KHR_multiview with the multiview feature enabled
+	*	probes.reset(new vks::EnvironmentProbes(vulkanDevice, queue, getShadersPath(), 2, [this](VkCommandBuffer commandBuffer, uint32_t probe) { drawProbeScene(commandBuffer, probe); }));
+	*	probes->setPosition(0, glm::vec3(-4.0f, 0.0f, 0.0f));
+	*	// Capture pipelines are created for getRenderPass() and read the face matrices from getCaptureDescriptor(probe), indexed by gl_ViewIndex
+	*	// Descriptor sets are created for both outputs of each probe (getIrradianceCube(probe, index) and getPrefilteredCube(probe, index))
+	*	// Per frame, before submitting the command buffers sampling the probes
+	*	probes->update();
+	*	// Then bind the descriptor set of the output index getReadIndex(probe)
+	*
+	* A probe update is split into steps: the capture into the probe's cube map (graphics queue), the irradiance cube and (groups of) mip
+	* levels of the prefiltered cube (compute queue). update() records up to Settings::stepsPerFrame of these steps for the probes in round
+	* robin order, so a single update is spread over several frames and each frame costs about the same. The capture is rendered through
+	* the draw function into all six faces at once with a multiview render pass (the view index is the face), its mip chain is generated
+	* with blits and used as the source of the filters. The captures of a frame are submitted to the graphics queue, signaling a semaphore
+	* the frame's compute submission waits on. Filters write the output that isn't read by the graphics queue, the outputs are swapped by the
+	* first update() after the compute submission with a probe's last step has finished. Until then the probe isn't captured again.
+	*
+	* @note Images shared between the queues are created with VK_SHARING_MODE_CONCURRENT if the graphics and compute queue families differ
+	* @note Both outputs are cleared to black at construction, so probes are black until their first update has completed
+	* @note The capture of the next update waits for all graphics work submitted before it, so update() must be called before the frame's
+	* submission and the command buffers must select the output with getReadIndex() after it
+	*/
+	class EnvironmentProbes
+	{
+	public:
+		/** @brief Records the scene into the multiview capture pass with the viewport and scissor already set */
+		typedef std::function<void(VkCommandBuffer commandBuffer, uint32_t probe)> DrawFunction;
+
+		static const uint32_t captureDim = 128;
+		static const uint32_t irradianceDim = 16;
+		static const uint32_t prefilteredDim = 128;
+		static const VkFormat captureFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+		struct Settings {
+			// Capture and filter steps recorded per update, limits the cost of a frame
+			uint32_t stepsPerFrame = 2;
+			// Sampling deltas of the irradiance convolution in radians, coarser than those of vks::IBLGenerator as the capture is small
+			float irradianceDeltaPhi = 6.28318531f / 64.0f;
+			float irradianceDeltaTheta = 1.57079633f / 16.0f;
+			uint32_t prefilteredSamples = 32;
+			// Clip planes of the capture
+			float zNear = 0.1f;
+			float zFar = 256.0f;
+		};
+
+		struct Statistics {
+			// Steps recorded by the last update
+			uint32_t captures = 0;
+			uint32_t filterSteps = 0;
+			// Probe updates completed (and swapped) since construction
+			uint64_t completedUpdates = 0;
+		};
+
+		/** @brief Layout of the uniform buffer read by the capture pipelines */
+		struct CaptureUniforms {
+			// Projection and view of the cube map faces in the face order of Vulkan (+X, -X, +Y, -Y, +Z, -Z)
+			glm::mat4 viewProjection[6];
+			glm::vec4 position;
+		};
+
+	private:
+		struct Output {
+			vks::TextureCubeMap irradianceCube;
+			vks::TextureCubeMap prefilteredCube;
+			// Storage views and descriptor sets of the mip levels, those of the irradiance cube first
+			std::vector<VkImageView> mipViews;
+			std::vector<VkDescriptorSet> descriptorSets;
+		};
+		struct Probe {
+			glm::vec3 position = glm::vec3(0.0f);
+			VkImage captureImage = VK_NULL_HANDLE;
+			VkDeviceMemory captureMemory = VK_NULL_HANDLE;
+			vks::MemoryAllocation captureAllocation{};
+			// Base level of all faces rendered by the multiview pass
+			VkImageView captureAttachmentView = VK_NULL_HANDLE;
+			// All levels of the capture sampled by the filters
+			VkImageView captureCubeView = VK_NULL_HANDLE;
+			VkFramebuffer framebuffer = VK_NULL_HANDLE;
+			vks::Buffer uniformBuffer;
+			Output outputs[2];
+			// Output sampled by the graphics queue, filters write the other one
+			uint32_t readIndex = 0;
+			// Next step of the probe's update, 0 is the capture and i > 0 is filter step i - 1
+			uint32_t step = 0;
+			// Set once all steps have been submitted, the outputs are swapped once the compute submission has finished
+			bool swapPending = false;
+			uint64_t lastSubmission = 0;
+		};
+		struct FilterStep {
+			bool irradiance;
+			uint32_t firstMip;
+			uint32_t mipCount;
+		};
+		struct SubmitSlot {
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			// Signaled by the graphics submission and waited on by the compute submission of the same update
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+			// Number of the compute submission that last used the slot
+			uint64_t submission = 0;
+		};
+		vks::VulkanDevice *device;
+		VkQueue graphicsQueue;
+		VkQueue computeQueue = VK_NULL_HANDLE;
+		DrawFunction drawFunction;
+		Settings settings;
+		Statistics statistics;
+		std::vector<Probe> probes;
+		std::vector<FilterStep> filterSteps;
+		uint32_t captureMipLevels;
+		uint32_t irradianceMipLevels;
+		uint32_t prefilteredMipLevels;
+		uint32_t currentProbe = 0;
+		VkFormat depthFormat;
+		VkImage depthImage = VK_NULL_HANDLE;
+		VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+		vks::MemoryAllocation depthAllocation{};
+		VkImageView depthView = VK_NULL_HANDLE;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkSampler captureSampler = VK_NULL_HANDLE;
+		VkShaderModule irradianceModule = VK_NULL_HANDLE;
+		VkShaderModule prefilterModule = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline irradiancePipeline = VK_NULL_HANDLE;
+		VkPipeline prefilterPipeline = VK_NULL_HANDLE;
+		VkCommandPool graphicsCommandPool = VK_NULL_HANDLE;
+		VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+		std::vector<SubmitSlot> graphicsSlots;
+		std::vector<SubmitSlot> computeSlots;
+		uint32_t frame = 0;
+		uint64_t computeSubmissions = 0;
+		std::vector<uint32_t> queueFamilyIndices;
+		void createRenderPass();
+		void createDepthAttachment();
+		void createPipelines(const std::string &shadersPath);
+		void createProbe(Probe &probe);
+		void createOutputTexture(vks::TextureCubeMap &texture, VkFormat format, uint32_t dim, uint32_t mipLevels);
+		void createOutputDescriptorSets(Probe &probe, Output &output);
+		void clearOutputs();
+		void destroyProbe(Probe &probe);
+		bool isSubmissionComplete(uint64_t submission) const;
+		void beginSlot(SubmitSlot &slot);
+		void beginComputeSlot(SubmitSlot &slot);
+		void recordCapture(VkCommandBuffer commandBuffer, uint32_t probeIndex);
+		void recordFilterStep(VkCommandBuffer commandBuffer, Probe &probe, uint32_t stepIndex);
+	public:
+		EnvironmentProbes(vks::VulkanDevice *device, VkQueue queue, const std::string &shadersPath, uint32_t probeCount, DrawFunction drawFunction);
+		~EnvironmentProbes();
+		void update();
+		void setPosition(uint32_t probe, const glm::vec3 &position);
+		const glm::vec3 &getPosition(uint32_t probe) const;
+		uint32_t getProbeCount() const;
+		uint32_t getReadIndex(uint32_t probe) const;
+		const vks::TextureCubeMap &getIrradianceCube(uint32_t probe, uint32_t index) const;
+		const vks::TextureCubeMap &getPrefilteredCube(uint32_t probe, uint32_t index) const;
+		const VkDescriptorBufferInfo &getCaptureDescriptor(uint32_t probe) const;
+		VkRenderPass getRenderPass() const;
+		uint32_t getPrefilteredMipLevels() const;
+		void setSettings(const Settings &settings);
+		const Settings &getSettings() const;
+		const Statistics &getStatistics() const;
+	};
+}
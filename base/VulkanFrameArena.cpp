@@ -0,0 +1,268 @@
+/*
+* Per-frame linear allocator
+*
+* Bump allocator for transient CPU allocations made while recording and submitting a frame (barrier arrays, descriptor writes, submit
+* infos, etc.), together with an STL allocator adaptor and a counter of global heap allocations to check that the frame loop doesn't
+* allocate (only with VKS_COUNT_ALLOCATIONS, as counting replaces the global allocation functions)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanFrameArena.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+
+#if defined(VKS_COUNT_ALLOCATIONS)
+namespace
+{
+	std::atomic<uint64_t> heapAllocationCount(0);
+
+	void *countedAllocation(std::size_t size)
+	{
+		heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+		return std::malloc(size > 0 ? size : 1);
+	}
+
+#if defined(__cpp_aligned_new)
+	void *countedAlignedAllocation(std::size_t size, std::size_t alignment)
+	{
+		heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+#if defined(_WIN32)
+		return _aligned_malloc(size > 0 ? size : 1, alignment);
+#else
+		void *memory = nullptr;
+		if (posix_memalign(&memory, std::max(alignment, sizeof(void*)), size > 0 ? size : 1) != 0)
+		{
+			return nullptr;
+		}
+		return memory;
+#endif
+	}
+
+	void alignedFree(void *memory)
+	{
+#if defined(_WIN32)
+		_aligned_free(memory);
+#else
+		std::free(memory);
+#endif
+	}
+#endif
+}
+
+// The global allocation functions are replaced to count heap allocations, memory still comes from malloc
+// Only built with VKS_COUNT_ALLOCATIONS, so applications linking the base library keep their own (or the default) allocation functions
+void *operator new(std::size_t size)
+{
+	void *memory = countedAllocation(size);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocation(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocation(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+
+#if defined(__cpp_aligned_new)
+// Over-aligned types are allocated with the aligned variants, which have to be replaced together with their deallocation functions
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+	void *memory = countedAlignedAllocation(size, static_cast<std::size_t>(alignment));
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return countedAlignedAllocation(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return countedAlignedAllocation(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept
+{
+	alignedFree(memory);
+}
+
+void operator delete[](void *memory, std::align_val_t) noexcept
+{
+	alignedFree(memory);
+}
+
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept
+{
+	alignedFree(memory);
+}
+
+void operator delete[](void *memory, std::size_t, std::align_val_t) noexcept
+{
+	alignedFree(memory);
+}
+
+void operator delete(void *memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	alignedFree(memory);
+}
+
+void operator delete[](void *memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	alignedFree(memory);
+}
+#endif
+#endif
+
+namespace vks
+{
+	/** @param blockSize Size of the first block in bytes, later blocks are at least as large */
+	FrameArena::FrameArena(size_t blockSize)
+	{
+		addBlock(blockSize);
+	}
+
+	FrameArena::~FrameArena()
+	{
+		for (auto& block : blocks)
+		{
+			delete[] block.data;
+		}
+	}
+
+	void FrameArena::addBlock(size_t size)
+	{
+		Block block;
+		block.data = new uint8_t[size];
+		block.size = size;
+		blocks.push_back(block);
+		offset = 0;
+	}
+
+	/**
+	* Allocate memory that stays valid until the next reset()
+	*
+	* @param size Size of the allocation in bytes
+	* @param alignment Alignment of the allocation, has to be a power of two
+	*/
+	void *FrameArena::allocate(size_t size, size_t alignment)
+	{
+		Block *block = &blocks.back();
+		size_t alignedOffset = (offset + alignment - 1) & ~(alignment - 1);
+		if (alignedOffset + size > block->size)
+		{
+			// Block data is aligned for any type, so a fresh block can take the allocation at its start
+			addBlock(std::max(blocks.front().size, size));
+			block = &blocks.back();
+			alignedOffset = 0;
+		}
+		offset = alignedOffset + size;
+		usedBytes += size;
+		peakBytes = std::max(peakBytes, usedBytes);
+		return block->data + alignedOffset;
+	}
+
+	/**
+	* Release all allocations
+	*
+	* If the allocations didn't fit into one block, the blocks are replaced by one that can hold them all, so the next frame with the
+	* same allocations doesn't need any additional block
+	*/
+	void FrameArena::reset()
+	{
+		if (blocks.size() > 1)
+		{
+			const size_t capacity = getCapacity();
+			for (auto& block : blocks)
+			{
+				delete[] block.data;
+			}
+			blocks.clear();
+			addBlock(capacity);
+		}
+		offset = 0;
+		usedBytes = 0;
+	}
+
+	size_t FrameArena::getCapacity() const
+	{
+		size_t capacity = 0;
+		for (auto& block : blocks)
+		{
+			capacity += block.size;
+		}
+		return capacity;
+	}
+
+	uint64_t getHeapAllocationCount()
+	{
+#if defined(VKS_COUNT_ALLOCATIONS)
+		return heapAllocationCount.load(std::memory_order_relaxed);
+#else
+		return 0;
+#endif
+	}
+
+	bool countsHeapAllocations()
+	{
+#if defined(VKS_COUNT_ALLOCATIONS)
+		return true;
+#else
+		return false;
+#endif
+	}
+}
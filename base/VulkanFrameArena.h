@@ -0,0 +1,95 @@
+/*
+* Per-frame linear allocator
+*
+* Bump allocator for transient CPU allocations made while recording and submitting a frame (barrier arrays, descriptor writes, submit
+* infos, etc.), together with an STL allocator adaptor and a counter of global heap allocations to check that the frame loop doesn't
+* allocate (only with VKS_COUNT_ALLOCATIONS, as counting replaces the global allocation functions)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vks
+{
+	/**
+	* Linear allocator whose memory is released all at once with reset()
+	*
+	* Usage:
+	*	vks::FrameVector<VkWriteDescriptorSet> writeDescriptorSets(frameArena);
+	*	writeDescriptorSets.reserve(2);
+	*	writeDescriptorSets.push_back(...);
+	*
+	* Allocations are taken from the current block, a new block is allocated if it's full. reset() replaces several blocks by a single
+	* one that can hold all of them, so after a few frames the arena serves every frame from one block without touching the heap.
+	*
+	* @note Freeing memory is a no-op, so growing containers leave their old buffers behind until the reset, reserve them up front
+	* @note Not thread safe
+	*/
+	class FrameArena
+	{
+	private:
+		struct Block
+		{
+			uint8_t *data;
+			size_t size;
+		};
+		// The current block is the last one
+		std::vector<Block> blocks;
+		size_t offset = 0;
+		size_t usedBytes = 0;
+		size_t peakBytes = 0;
+		void addBlock(size_t size);
+	public:
+		explicit FrameArena(size_t blockSize = 64 * 1024);
+		~FrameArena();
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+		void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+		void reset();
+		/** @brief Bytes allocated since the last reset */
+		size_t getUsedBytes() const { return usedBytes; }
+		/** @brief Most bytes allocated between two resets */
+		size_t getPeakBytes() const { return peakBytes; }
+		/** @brief Bytes held by the arena's blocks */
+		size_t getCapacity() const;
+	};
+
+	/** @brief STL allocator taking its memory from a vks::FrameArena, implicitly constructible from the arena */
+	template<typename T>
+	class FrameAllocator
+	{
+	public:
+		typedef T value_type;
+		FrameArena *arena;
+
+		FrameAllocator(FrameArena &arena) : arena(&arena) {}
+		template<typename U>
+		FrameAllocator(const FrameAllocator<U> &other) : arena(other.arena) {}
+
+		T *allocate(size_t count)
+		{
+			return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T*, size_t) {}
+
+		template<typename U>
+		bool operator==(const FrameAllocator<U> &other) const { return arena == other.arena; }
+		template<typename U>
+		bool operator!=(const FrameAllocator<U> &other) const { return arena != other.arena; }
+	};
+
+	/** @brief Vector in frame arena memory, only valid until the arena is reset */
+	template<typename T>
+	using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+	/** @brief Number of global operator new calls since the start of the application, from any thread (always 0 without VKS_COUNT_ALLOCATIONS) */
+	uint64_t getHeapAllocationCount();
+	/** @brief True if the base library was built with VKS_COUNT_ALLOCATIONS and counts heap allocations */
+	bool countsHeapAllocations();
+}
@@ -10,6 +10,7 @@
 
 #include <algorithm>
 #include <iterator>
+#include <string>
 #include <vector>
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
@@ -17,6 +18,118 @@
 
 namespace vks
 {
+	/**
+	* @brief Framebuffer compression requested for and applied to an attachment image (VK_EXT_image_compression_control)
+	*/
+	struct ImageCompression
+	{
+		/** @brief Compression requested at image creation */
+		VkImageCompressionFlagsEXT requested = VK_IMAGE_COMPRESSION_DEFAULT_EXT;
+		/** @brief Compression applied by the implementation: VK_IMAGE_COMPRESSION_DEFAULT_EXT (no fixed-rate compression), VK_IMAGE_COMPRESSION_FIXED_RATE_EXPLICIT_EXT or VK_IMAGE_COMPRESSION_DISABLED_EXT */
+		VkImageCompressionFlagsEXT flags = VK_IMAGE_COMPRESSION_DEFAULT_EXT;
+		/** @brief Bits per component of an applied fixed-rate compression */
+		VkImageCompressionFixedRateFlagsEXT fixedRateFlags = VK_IMAGE_COMPRESSION_FIXED_RATE_NONE_EXT;
+		/** @brief Set if the applied compression has been read back from the device */
+		bool queried = false;
+
+		/**
+		* @brief Returns the applied compression as text, e.g. "fixed-rate 2 bpc"
+		*/
+		std::string toString() const
+		{
+			if (!queried)
+			{
+				return "unknown";
+			}
+			if (flags & VK_IMAGE_COMPRESSION_DISABLED_EXT)
+			{
+				return "disabled";
+			}
+			if (fixedRateFlags != VK_IMAGE_COMPRESSION_FIXED_RATE_NONE_EXT)
+			{
+				// Bit n is a rate of n + 1 bits per component
+				uint32_t bitsPerComponent = 1;
+				while (!(fixedRateFlags & (1u << (bitsPerComponent - 1))))
+				{
+					bitsPerComponent++;
+				}
+				return "fixed-rate " + std::to_string(bitsPerComponent) + " bpc";
+			}
+			return "lossless";
+		}
+	};
+
+	/**
+	* @brief Returns the compression to request for an attachment that has to stay lossless (e.g. positions, normals or depth read by later passes), a fixed-rate request falls back to the default compression
+	*/
+	inline VkImageCompressionFlagsEXT getLosslessCompression(VkImageCompressionFlagsEXT compression)
+	{
+		return (compression & (VK_IMAGE_COMPRESSION_FIXED_RATE_DEFAULT_EXT | VK_IMAGE_COMPRESSION_FIXED_RATE_EXPLICIT_EXT)) ? VK_IMAGE_COMPRESSION_DEFAULT_EXT : compression;
+	}
+
+	/**
+	* Create an attachment image with the requested framebuffer compression and read back the compression that has been applied
+	*
+	* Without VK_EXT_image_compression_control (see VulkanDevice::enableImageCompressionControl) the image is created with the implementation's default compression.
+	* Fixed-rate compression is lossy, so it should only be requested for intermediate targets where quality allows (e.g. blur or occlusion targets). If the
+	* implementation runs out of fixed-rate compression resources the image is created with the default compression instead.
+	*
+	* @param device Device to create the image on
+	* @param imageCreateInfo Image to create
+	* @param compression Compression to request (VK_IMAGE_COMPRESSION_DEFAULT_EXT, VK_IMAGE_COMPRESSION_FIXED_RATE_DEFAULT_EXT or VK_IMAGE_COMPRESSION_DISABLED_EXT)
+	* @param image Pointer to the image handle
+	* @param (Optional) appliedCompression Pointer to the compression that has been applied to the image
+	*
+	* @return VkResult of the image creation
+	*/
+	inline VkResult createAttachmentImage(vks::VulkanDevice *device, const VkImageCreateInfo &imageCreateInfo, VkImageCompressionFlagsEXT compression, VkImage *image, vks::ImageCompression *appliedCompression = nullptr)
+	{
+		VkImageCreateInfo imageCI = imageCreateInfo;
+		VkImageCompressionControlEXT compressionControl{};
+		if (device->enableImageCompressionControl)
+		{
+			compressionControl.sType = VK_STRUCTURE_TYPE_IMAGE_COMPRESSION_CONTROL_EXT;
+			compressionControl.pNext = imageCI.pNext;
+			compressionControl.flags = compression;
+			imageCI.pNext = &compressionControl;
+		}
+		VkResult result = vkCreateImage(device->logicalDevice, &imageCI, nullptr, image);
+		if ((result == VK_ERROR_COMPRESSION_EXHAUSTED_EXT) && (compression & VK_IMAGE_COMPRESSION_FIXED_RATE_DEFAULT_EXT))
+		{
+			compression = VK_IMAGE_COMPRESSION_DEFAULT_EXT;
+			compressionControl.flags = compression;
+			result = vkCreateImage(device->logicalDevice, &imageCI, nullptr, image);
+		}
+		if (appliedCompression)
+		{
+			*appliedCompression = {};
+			appliedCompression->requested = compression;
+		}
+		if ((result == VK_SUCCESS) && appliedCompression && device->enableImageCompressionControl)
+		{
+			VkImageCompressionPropertiesEXT compressionProperties{};
+			compressionProperties.sType = VK_STRUCTURE_TYPE_IMAGE_COMPRESSION_PROPERTIES_EXT;
+			VkSubresourceLayout2EXT subresourceLayout{};
+			subresourceLayout.sType = VK_STRUCTURE_TYPE_SUBRESOURCE_LAYOUT_2_EXT;
+			subresourceLayout.pNext = &compressionProperties;
+			VkImageSubresource2EXT subresource{};
+			subresource.sType = VK_STRUCTURE_TYPE_IMAGE_SUBRESOURCE_2_EXT;
+			if (imageCI.usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
+			{
+				subresource.imageSubresource.aspectMask = (imageCI.format == VK_FORMAT_S8_UINT) ? VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_DEPTH_BIT;
+			}
+			else
+			{
+				subresource.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			}
+			device->vkGetImageSubresourceLayout2EXT(device->logicalDevice, *image, &subresource, &subresourceLayout);
+			appliedCompression->flags = compressionProperties.imageCompressionFlags;
+			appliedCompression->fixedRateFlags = compressionProperties.imageCompressionFixedRateFlags;
+			appliedCompression->queried = true;
+		}
+		return result;
+	}
+
 	/**
 	* @brief Encapsulates a single frame buffer attachment 
 	*/
@@ -28,6 +141,7 @@ namespace vks
 		VkFormat format;
 		VkImageSubresourceRange subresourceRange;
 		VkAttachmentDescription description;
+		vks::ImageCompression compression;
 
 		/**
 		* @brief Returns true if the attachment has a depth component
@@ -81,6 +195,8 @@ namespace vks
 		VkFormat format;
 		VkImageUsageFlags usage;
 		VkSampleCountFlagBits imageSampleCount = VK_SAMPLE_COUNT_1_BIT;
+		/** @brief Framebuffer compression to request if VK_EXT_image_compression_control is enabled, see vks::createAttachmentImage */
+		VkImageCompressionFlagsEXT compression = VK_IMAGE_COMPRESSION_DEFAULT_EXT;
 	};
 
 	/**
@@ -179,7 +295,7 @@ namespace vks
 			VkMemoryRequirements memReqs;
 
 			// Create image for this attachment
-			VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &image, nullptr, &attachment.image));
+			VK_CHECK_RESULT(vks::createAttachmentImage(vulkanDevice, image, createinfo.compression, &attachment.image, &attachment.compression));
 			vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, attachment.image, &memReqs);
 			memAlloc.allocationSize = memReqs.size;
 			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
@@ -255,9 +371,12 @@ namespace vks
 		/**
 		* Creates a default render pass setup with one sub pass
 		*
+		* @param (Optional) viewMask Views of a multiview render pass, e.g. 0b11 to render a G-buffer for both eyes of a stereo pair with a single draw
+		* per object. The attachments need a layer per view and the shaders select per-view data with gl_ViewIndex. Requires the multiview feature (Defaults to 0, no multiview)
+		*
 		* @return VK_SUCCESS if all resources have been created successfully
 		*/
-		VkResult createRenderPass()
+		VkResult createRenderPass(uint32_t viewMask = 0)
 		{
 			std::vector<VkAttachmentDescription> attachmentDescriptions;
 			for (auto& attachment : attachments)
@@ -315,12 +434,13 @@ namespace vks
 			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
+			// Also makes depth writes visible to shaders sampling the depth attachment
 			dependencies[1].srcSubpass = 0;
 			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
 			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 			// Create render pass
@@ -332,6 +452,18 @@ namespace vks
 			renderPassInfo.pSubpasses = &subpass;
 			renderPassInfo.dependencyCount = 2;
 			renderPassInfo.pDependencies = dependencies.data();
+
+			// Draws are broadcast to all views of the mask, views are assumed to be correlated (e.g. the eyes of a stereo pair)
+			VkRenderPassMultiviewCreateInfo renderPassMultiviewInfo{};
+			renderPassMultiviewInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+			renderPassMultiviewInfo.subpassCount = 1;
+			renderPassMultiviewInfo.pViewMasks = &viewMask;
+			renderPassMultiviewInfo.correlationMaskCount = 1;
+			renderPassMultiviewInfo.pCorrelationMasks = &viewMask;
+			if (viewMask != 0)
+			{
+				renderPassInfo.pNext = &renderPassMultiviewInfo;
+			}
 			VK_CHECK_RESULT(vkCreateRenderPass(vulkanDevice->logicalDevice, &renderPassInfo, nullptr, &renderPass));
 
 			std::vector<VkImageView> attachmentViews;
@@ -357,7 +489,8 @@ namespace vks
 			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachmentViews.size());
 			framebufferInfo.width = width;
 			framebufferInfo.height = height;
-			framebufferInfo.layers = maxLayers;
+			// Multiview render passes select the layers through the view mask and require a single framebuffer layer
+			framebufferInfo.layers = (viewMask != 0) ? 1 : maxLayers;
 			VK_CHECK_RESULT(vkCreateFramebuffer(vulkanDevice->logicalDevice, &framebufferInfo, nullptr, &framebuffer));
 
 			return VK_SUCCESS;
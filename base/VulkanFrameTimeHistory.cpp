@@ -0,0 +1,169 @@
+/*
+* Rolling frame time history
+*
+* Keeps the CPU frame times, GPU frame times and GPU profiler scope times of the most recent frames in fixed size rings and
+* summarizes them with min, average, max and percentiles, for the frame time graphs of the UI overlay
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanFrameTimeHistory.h"
+#include <algorithm>
+
+namespace vks
+{
+	void FrameTimeHistory::Series::add(float value)
+	{
+		if (values.size() < capacity)
+		{
+			values.push_back(value);
+			return;
+		}
+		values[head] = value;
+		head = (head + 1) % capacity;
+	}
+
+	/** @brief Resize the ring, keeping the most recent values that still fit */
+	void FrameTimeHistory::Series::setCapacity(uint32_t capacity)
+	{
+		std::vector<float> ordered(values.size());
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			ordered[i] = values[(head + i) % values.size()];
+		}
+		if (ordered.size() > capacity)
+		{
+			ordered.erase(ordered.begin(), ordered.begin() + (ordered.size() - capacity));
+		}
+		values.swap(ordered);
+		head = 0;
+		this->capacity = capacity;
+	}
+
+	uint32_t FrameTimeHistory::Series::count() const
+	{
+		return static_cast<uint32_t>(values.size());
+	}
+
+	const float *FrameTimeHistory::Series::data() const
+	{
+		return values.data();
+	}
+
+	uint32_t FrameTimeHistory::Series::getOffset() const
+	{
+		return head;
+	}
+
+	/**
+	* Min, average, max and nearest rank percentiles of the values in the window
+	*
+	* @note Sorts a copy of the values, so it should only be called for series that are displayed
+	*/
+	FrameTimeHistory::Summary FrameTimeHistory::Series::summarize() const
+	{
+		Summary summary;
+		if (values.empty())
+		{
+			return summary;
+		}
+		std::vector<float> sorted(values);
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0.0;
+		for (float value : sorted)
+		{
+			sum += value;
+		}
+		auto percentile = [&sorted](float p) {
+			const size_t rank = static_cast<size_t>(p * static_cast<float>(sorted.size() - 1) + 0.5f);
+			return sorted[std::min(rank, sorted.size() - 1)];
+		};
+		summary.min = sorted.front();
+		summary.max = sorted.back();
+		summary.average = static_cast<float>(sum / static_cast<double>(sorted.size()));
+		summary.p50 = percentile(0.50f);
+		summary.p95 = percentile(0.95f);
+		summary.p99 = percentile(0.99f);
+		return summary;
+	}
+
+	/** @param window Number of frames kept per series */
+	FrameTimeHistory::FrameTimeHistory(uint32_t window) : window(std::max(window, 1u))
+	{
+		cpuFrames.name = "CPU frame";
+		cpuFrames.setCapacity(this->window);
+		gpuFrames.name = "GPU frame";
+		gpuFrames.setCapacity(this->window);
+	}
+
+	/** @brief Change the number of frames kept, the most recent frames of each series are kept */
+	void FrameTimeHistory::setWindow(uint32_t window)
+	{
+		this->window = std::max(window, 1u);
+		cpuFrames.setCapacity(this->window);
+		gpuFrames.setCapacity(this->window);
+		for (auto &scope : gpuScopes)
+		{
+			scope.setCapacity(this->window);
+		}
+	}
+
+	uint32_t FrameTimeHistory::getWindow() const
+	{
+		return window;
+	}
+
+	void FrameTimeHistory::addCpuFrame(double milliseconds)
+	{
+		cpuFrames.add(static_cast<float>(milliseconds));
+	}
+
+	/**
+	* Add the profiler scopes of a collected command buffer
+	*
+	* @param scopes Names and times of the scopes in milliseconds (see vks::GpuProfiler::results), frames without scopes are ignored
+	* @param offsets Start of each scope relative to the first one (see vks::GpuProfiler::resultOffsets)
+	*/
+	void FrameTimeHistory::addGpuFrame(const std::vector<std::pair<std::string, double>> &scopes, const std::vector<double> &offsets)
+	{
+		if (scopes.empty())
+		{
+			return;
+		}
+		double frameEnd = 0.0;
+		for (size_t i = 0; i < scopes.size(); i++)
+		{
+			const double offset = (i < offsets.size()) ? offsets[i] : 0.0;
+			frameEnd = std::max(frameEnd, offset + scopes[i].second);
+		}
+		gpuFrames.add(static_cast<float>(frameEnd));
+		for (auto &scope : scopes)
+		{
+			auto series = std::find_if(gpuScopes.begin(), gpuScopes.end(), [&scope](const Series &series) { return series.name == scope.first; });
+			if (series == gpuScopes.end())
+			{
+				gpuScopes.push_back(Series());
+				series = gpuScopes.end() - 1;
+				series->name = scope.first;
+				series->setCapacity(window);
+			}
+			series->add(static_cast<float>(scope.second));
+		}
+	}
+
+	const FrameTimeHistory::Series &FrameTimeHistory::getCpuFrames() const
+	{
+		return cpuFrames;
+	}
+
+	const FrameTimeHistory::Series &FrameTimeHistory::getGpuFrames() const
+	{
+		return gpuFrames;
+	}
+
+	/** @brief Series of each profiler scope name, in the order the names were first seen */
+	const std::vector<FrameTimeHistory::Series> &FrameTimeHistory::getGpuScopes() const
+	{
+		return gpuScopes;
+	}
+}
@@ -0,0 +1,79 @@
+/*
+* Rolling frame time history
+*
+* Keeps the CPU frame times, GPU frame times and GPU profiler scope times of the most recent frames in fixed size rings and
+* summarizes them with min, average, max and percentiles, for the frame time graphs of the UI overlay
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace vks
+{
+	/**
+	* Frame times of a window of recent frames
+	*
+	* Usage:
+	*	frameTimes.addCpuFrame(frameTimer * 1000.0);
+	*	// After vks::GpuProfiler::collect()
+	*	frameTimes.addGpuFrame(gpuProfiler.results, gpuProfiler.resultOffsets);
+	*	...
+	*	UIOverlay.frameTimeGraph("CPU frame", frameTimes.getCpuFrames());
+	*
+	* The GPU frame time is the span from the start of the first to the end of the last profiler scope, so nested scopes aren't counted twice.
+	* Each profiler scope gets a series of its own, identified by its name, which only advances in frames that recorded the scope.
+	*/
+	class FrameTimeHistory
+	{
+	public:
+		struct Summary {
+			float min = 0.0f;
+			float average = 0.0f;
+			float max = 0.0f;
+			float p50 = 0.0f;
+			float p95 = 0.0f;
+			float p99 = 0.0f;
+		};
+
+		/** @brief Ring of the times of one series in milliseconds */
+		class Series
+		{
+		private:
+			friend class FrameTimeHistory;
+			std::vector<float> values;
+			// Next value to overwrite once the ring is full
+			uint32_t head = 0;
+			uint32_t capacity = 0;
+			void add(float value);
+			void setCapacity(uint32_t capacity);
+		public:
+			std::string name;
+			/** @brief Number of values, at most the window size */
+			uint32_t count() const;
+			/** @brief Values in the order they were stored, the oldest one is at getOffset() */
+			const float *data() const;
+			uint32_t getOffset() const;
+			Summary summarize() const;
+		};
+
+		explicit FrameTimeHistory(uint32_t window = 300);
+		void setWindow(uint32_t window);
+		uint32_t getWindow() const;
+		void addCpuFrame(double milliseconds);
+		void addGpuFrame(const std::vector<std::pair<std::string, double>> &scopes, const std::vector<double> &offsets);
+		const Series &getCpuFrames() const;
+		const Series &getGpuFrames() const;
+		const std::vector<Series> &getGpuScopes() const;
+	private:
+		uint32_t window;
+		Series cpuFrames;
+		Series gpuFrames;
+		std::vector<Series> gpuScopes;
+	};
+}
@@ -0,0 +1,113 @@
+/*
+* Shared geometry pool
+*
+* Sub-allocates the vertices and indices of many meshes from one large vertex buffer and one large index buffer, so a single
+* buffer binding serves the draws of all meshes in the pool (and a single indirect draw can cover several of them)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanGeometryPool.h"
+#include "VulkanDevice.h"
+#include <assert.h>
+
+namespace vks
+{
+	/**
+	* @param device Device to create the buffers on
+	* @param vertexCapacity Size of the vertex buffer in bytes
+	* @param indexCapacity Size of the index buffer in bytes
+	* @param usage (Optional) Additional usage of both buffers, e.g. storage and device address usage for vertex pulling or meshlets
+	*/
+	GeometryPool::GeometryPool(vks::VulkanDevice *device, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity, VkBufferUsageFlags usage) : device(device), usage(usage)
+	{
+		assert((vertexCapacity > 0) && (indexCapacity > 0));
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&vertexBuffer,
+			vertexCapacity));
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&indexBuffer,
+			indexCapacity));
+	}
+
+	GeometryPool::~GeometryPool()
+	{
+		vertexBuffer.destroy();
+		indexBuffer.destroy();
+	}
+
+	/**
+	* Allocate the vertex and index ranges of a mesh
+	*
+	* @param vertexCount Number of vertices
+	* @param vertexStride Size of a vertex in bytes, the range starts at a multiple of it
+	* @param indexCount Number of 32 bit indices
+	* @param range Receives the offsets of the mesh, left untouched if the mesh doesn't fit
+	*
+	* @return False if the vertices or the indices don't fit into the remaining space of the pool
+	*/
+	bool GeometryPool::allocate(uint32_t vertexCount, uint32_t vertexStride, uint32_t indexCount, Range &range)
+	{
+		assert(vertexStride > 0);
+		const VkDeviceSize firstVertex = (statistics.vertexBytes + vertexStride - 1) / vertexStride;
+		const VkDeviceSize vertexEnd = (firstVertex + vertexCount) * vertexStride;
+		const VkDeviceSize indexEnd = (static_cast<VkDeviceSize>(statistics.indexCount) + indexCount) * sizeof(uint32_t);
+		// The first vertex is added to 32 bit indices
+		if ((vertexEnd > vertexBuffer.size) || (indexEnd > indexBuffer.size) || (firstVertex + vertexCount > UINT32_MAX))
+		{
+			statistics.failedAllocations++;
+			return false;
+		}
+		range.vertexOffset = firstVertex * vertexStride;
+		range.firstVertex = static_cast<uint32_t>(firstVertex);
+		range.firstIndex = statistics.indexCount;
+		statistics.vertexBytes = vertexEnd;
+		statistics.indexCount += indexCount;
+		statistics.ranges++;
+		return true;
+	}
+
+	/** @brief Bind the vertex buffer to binding 0 and the index buffer, both at offset 0 */
+	void GeometryPool::bind(VkCommandBuffer commandBuffer) const
+	{
+		const VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, &offset);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+
+	VkBuffer GeometryPool::getVertexBuffer() const
+	{
+		return vertexBuffer.buffer;
+	}
+
+	VkBuffer GeometryPool::getIndexBuffer() const
+	{
+		return indexBuffer.buffer;
+	}
+
+	/** @brief Device address of the vertex buffer, 0 unless the pool has been created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT */
+	VkDeviceAddress GeometryPool::getVertexBufferAddress() const
+	{
+		return vertexBuffer.deviceAddress;
+	}
+
+	/** @brief Device address of the index buffer, 0 unless the pool has been created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT */
+	VkDeviceAddress GeometryPool::getIndexBufferAddress() const
+	{
+		return indexBuffer.deviceAddress;
+	}
+
+	VkBufferUsageFlags GeometryPool::getUsage() const
+	{
+		return usage;
+	}
+
+	const GeometryPool::Statistics &GeometryPool::getStatistics() const
+	{
+		return statistics;
+	}
+}
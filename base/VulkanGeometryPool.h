@@ -0,0 +1,81 @@
+/*
+* Shared geometry pool
+*
+* Sub-allocates the vertices and indices of many meshes from one large vertex buffer and one large index buffer, so a single
+* buffer binding serves the draws of all meshes in the pool (and a single indirect draw can cover several of them)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Linear allocator for vertex and index ranges of device local buffers
+	*
+	* Usage:
+	*	geometryPool.reset(new vks::GeometryPool(vulkanDevice, 64 * 1024 * 1024, 16 * 1024 * 1024));
+	*	vks::GeometryPool::Range range;
+	*	if (geometryPool->allocate(vertexCount, sizeof(Vertex), indexCount, range)) {
+	*		// Rebase the indices by range.firstVertex and offset the first indices of the draws by range.firstIndex
+	*		stagingRing->copyToBuffer(vertices, vertexCount * sizeof(Vertex), geometryPool->getVertexBuffer(), range.vertexOffset);
+	*		stagingRing->copyToBuffer(indices, indexCount * sizeof(uint32_t), geometryPool->getIndexBuffer(), range.firstIndex * sizeof(uint32_t));
+	*	}
+	*	// Once per command buffer for all meshes in the pool
+	*	geometryPool->bind(commandBuffer);
+	*
+	* Vertex ranges start at a multiple of their stride, so meshes with different vertex layouts can share the pool and a range's first
+	* vertex can be added to its indices. Indices are 32 bit.
+	*
+	* @note Ranges are not freed, the pool must outlive all meshes allocated from it
+	* @note allocate() returns false if a range doesn't fit, callers fall back to buffers of their own
+	*/
+	class GeometryPool
+	{
+	public:
+		/** @brief Range of a mesh in the pool's buffers */
+		struct Range {
+			// Byte offset of the first vertex in the vertex buffer
+			VkDeviceSize vertexOffset = 0;
+			// Index of the first vertex in units of the range's stride, added to the mesh's indices
+			uint32_t firstVertex = 0;
+			// Index of the first index in the index buffer, added to the first indices of the mesh's draws
+			uint32_t firstIndex = 0;
+		};
+
+		struct Statistics {
+			// Bytes allocated from the vertex buffer (including alignment padding)
+			VkDeviceSize vertexBytes = 0;
+			// Indices allocated from the index buffer
+			uint32_t indexCount = 0;
+			uint32_t ranges = 0;
+			// Allocations that didn't fit into the pool
+			uint32_t failedAllocations = 0;
+		};
+
+	private:
+		vks::VulkanDevice *device;
+		vks::Buffer vertexBuffer;
+		vks::Buffer indexBuffer;
+		VkBufferUsageFlags usage;
+		Statistics statistics;
+	public:
+		GeometryPool(vks::VulkanDevice *device, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity, VkBufferUsageFlags usage = 0);
+		~GeometryPool();
+		bool allocate(uint32_t vertexCount, uint32_t vertexStride, uint32_t indexCount, Range &range);
+		void bind(VkCommandBuffer commandBuffer) const;
+		VkBuffer getVertexBuffer() const;
+		VkBuffer getIndexBuffer() const;
+		VkDeviceAddress getVertexBufferAddress() const;
+		VkDeviceAddress getIndexBufferAddress() const;
+		VkBufferUsageFlags getUsage() const;
+		const Statistics &getStatistics() const;
+	};
+}
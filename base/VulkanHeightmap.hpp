@@ -12,6 +12,7 @@
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
 #include "VulkanBuffer.h"
+#include "VulkanMappedFile.hpp"
 #include <ktx.h>
 #include <ktxvulkan.h>
 
@@ -26,6 +27,17 @@ namespace vks
 
 		vks::VulkanDevice *device = nullptr;
 		VkQueue copyQueue = VK_NULL_HANDLE;
+
+		/** @brief Callback for ktxTexture_IterateLoadLevelFaces that copies the first mip level into the height data */
+		static KTX_error_code copyHeightData(int miplevel, int face, int width, int height, int depth, ktx_uint32_t faceLodSize, void *pixels, void *userdata)
+		{
+			if (miplevel == 0)
+			{
+				HeightMap *heightMap = static_cast<HeightMap*>(userdata);
+				memcpy(heightMap->heightdata, pixels, std::min(static_cast<size_t>(faceLodSize), heightMap->dim * heightMap->dim * sizeof(uint16_t)));
+			}
+			return KTX_SUCCESS;
+		}
 	public:
 		enum Topology { topologyTriangles, topologyQuads };
 
@@ -76,27 +88,18 @@ namespace vks
 			assert(device);
 			assert(copyQueue != VK_NULL_HANDLE);
 
-			ktxResult result;
+			// The file is mapped and only the first mip level is copied into the height data, without loading the whole ktx into host memory
+			vks::MappedFile file;
+			if (!file.open(filename)) {
+				vks::tools::exitFatal("Could not load heightmap from " + filename, -1);
+			}
 			ktxTexture* ktxTexture;
-#if defined(__ANDROID__)
-			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-			assert(asset);
-			size_t size = AAsset_getLength(asset);
-			assert(size > 0);
-			void *textureData = malloc(size);
-			AAsset_read(asset, textureData, size);
-			AAsset_close(asset);
-			result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target);
-			free(textureData);
-#else
-			result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-#endif
+			ktxResult result = ktxTexture_CreateFromMemory(reinterpret_cast<const ktx_uint8_t*>(file.data), file.size, KTX_TEXTURE_CREATE_NO_FLAGS, &ktxTexture);
 			assert(result == KTX_SUCCESS);
-			ktx_size_t ktxSize = ktxTexture_GetImageSize(ktxTexture, 0);
-			ktx_uint8_t* ktxImage = ktxTexture_GetData(ktxTexture);
 			dim = ktxTexture->baseWidth;
 			heightdata = new uint16_t[dim * dim];
-			memcpy(heightdata, ktxImage, ktxSize);
+			result = ktxTexture_IterateLoadLevelFaces(ktxTexture, copyHeightData, this);
+			assert(result == KTX_SUCCESS);
 			this->scale = dim / patchsize;
 			ktxTexture_Destroy(ktxTexture);
 
@@ -0,0 +1,643 @@
+/*
+* Image based lighting generator
+*
+* Generates the BRDF lookup table, irradiance cube and prefiltered environment cube for image based lighting with compute shaders, and
+* caches them in ktx files next to the environment map, so later runs with the same environment map and settings only load them
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanIBLGenerator.h"
+#include "VulkanDevice.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <ktx.h>
+
+namespace vks
+{
+	const VkFormat IBLGenerator::brdfLutFormat;
+	const VkFormat IBLGenerator::irradianceFormat;
+	const VkFormat IBLGenerator::prefilteredFormat;
+	const uint32_t IBLGenerator::version;
+	const uint32_t IBLGenerator::shCoefficientCount;
+	const uint32_t IBLGenerator::shSourceDim;
+
+	namespace
+	{
+		// OpenGL internal formats of the ktx files (GL_RGBA16F and GL_RGBA32F)
+		const uint32_t glInternalformatRGBA16F = 0x881A;
+		const uint32_t glInternalformatRGBA32F = 0x8814;
+		// Work group sizes of the shaders in x and y
+		const uint32_t brdfLutGroupSize = 16;
+		const uint32_t cubeGroupSize = 8;
+		// Key/value entry of the cache files holding the cache key
+		const char *cacheKeyName = "vks.IBLGenerator.key";
+
+		struct IrradiancePushConstants {
+			float deltaPhi;
+			float deltaTheta;
+		};
+
+		struct PrefilterPushConstants {
+			float roughness;
+			uint32_t numSamples;
+		};
+
+		const uint64_t hashOffsetBasis = 14695981039346656037ULL;
+
+		// 64 bit FNV-1a hash, continuing from hash
+		uint64_t hashData(uint64_t hash, const void *data, size_t size)
+		{
+			const uint8_t *bytes = static_cast<const uint8_t*>(data);
+			for (size_t i = 0; i < size; i++) {
+				hash ^= bytes[i];
+				hash *= 1099511628211ULL;
+			}
+			return hash;
+		}
+
+		// Hash of a file's contents, 0 if the file can't be read
+		uint64_t hashFile(const std::string &filename)
+		{
+			vks::MappedFile file;
+			if (!file.open(filename)) {
+				return 0;
+			}
+			return hashData(hashOffsetBasis, file.data, file.size);
+		}
+
+		uint32_t getMipLevels(uint32_t dim)
+		{
+			return static_cast<uint32_t>(std::floor(std::log2(dim))) + 1;
+		}
+	}
+
+	/**
+	* Load the shaders and create the compute pipelines
+	*
+	* @param device Device to create the pipelines and textures on
+	* @param queue Queue the generation is submitted to, it has to support compute
+	* @param shadersPath Shader directory containing the SPIR-V files of the "base/*.comp" shaders (e.g. getShadersPath())
+	*/
+	IBLGenerator::IBLGenerator(vks::VulkanDevice *device, VkQueue queue, const std::string &shadersPath) : device(device), queue(queue)
+	{
+#if defined(__ANDROID__)
+		brdfLutModule = vks::tools::loadShader(androidApp->activity->assetManager, (shadersPath + "base/genbrdflut.comp.spv").c_str(), device->logicalDevice);
+		irradianceModule = vks::tools::loadShader(androidApp->activity->assetManager, (shadersPath + "base/irradiancecube.comp.spv").c_str(), device->logicalDevice);
+		prefilterModule = vks::tools::loadShader(androidApp->activity->assetManager, (shadersPath + "base/prefilterenvmap.comp.spv").c_str(), device->logicalDevice);
+		irradianceSHModule = vks::tools::loadShader(androidApp->activity->assetManager, (shadersPath + "base/irradiancesh.comp.spv").c_str(), device->logicalDevice);
+#else
+		brdfLutModule = vks::tools::loadShader((shadersPath + "base/genbrdflut.comp.spv").c_str(), device->logicalDevice);
+		irradianceModule = vks::tools::loadShader((shadersPath + "base/irradiancecube.comp.spv").c_str(), device->logicalDevice);
+		prefilterModule = vks::tools::loadShader((shadersPath + "base/prefilterenvmap.comp.spv").c_str(), device->logicalDevice);
+		irradianceSHModule = vks::tools::loadShader((shadersPath + "base/irradiancesh.comp.spv").c_str(), device->logicalDevice);
+#endif
+		if ((brdfLutModule == VK_NULL_HANDLE) || (irradianceModule == VK_NULL_HANDLE) || (prefilterModule == VK_NULL_HANDLE) || (irradianceSHModule == VK_NULL_HANDLE))
+		{
+			vks::tools::exitFatal("Could not load the image based lighting shaders from " + shadersPath + "base/", -1);
+		}
+
+		// All shaders share one layout, the BRDF lookup table doesn't use the environment map
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Environment cube map
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Mip level written by the dispatch, all faces of a cube as an array
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Spherical harmonics coefficients
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		static_assert(sizeof(IrradiancePushConstants) == sizeof(PrefilterPushConstants), "Both cube shaders use the same push constant range");
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PrefilterPushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCI.stage.pName = "main";
+		pipelineCI.stage.module = irradianceModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &irradiancePipeline));
+		pipelineCI.stage.module = prefilterModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &prefilterPipeline));
+		pipelineCI.stage.module = irradianceSHModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &irradianceSHPipeline));
+		// The BRDF lookup table pipeline depends on the sample count and is created by generate()
+	}
+
+	IBLGenerator::~IBLGenerator()
+	{
+		if (brdfLutPipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, brdfLutPipeline, nullptr);
+		}
+		if (irradiancePipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, irradiancePipeline, nullptr);
+		}
+		if (prefilterPipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, prefilterPipeline, nullptr);
+		}
+		if (irradianceSHPipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, irradianceSHPipeline, nullptr);
+		}
+		if (pipelineLayout)
+		{
+			vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		}
+		if (descriptorSetLayout)
+		{
+			vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		}
+		if (brdfLutModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, brdfLutModule, nullptr);
+		}
+		if (irradianceModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, irradianceModule, nullptr);
+		}
+		if (prefilterModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, prefilterModule, nullptr);
+		}
+		if (irradianceSHModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, irradianceSHModule, nullptr);
+		}
+	}
+
+	/** @brief (Re)create the BRDF lookup table pipeline if the sample count it was specialized for changed */
+	void IBLGenerator::createBrdfLutPipeline()
+	{
+		if (brdfLutPipeline && (brdfLutPipelineSamples == settings.brdfLutSamples))
+		{
+			return;
+		}
+		if (brdfLutPipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, brdfLutPipeline, nullptr);
+		}
+		VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
+		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(uint32_t), &settings.brdfLutSamples);
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCI.stage.pName = "main";
+		pipelineCI.stage.module = brdfLutModule;
+		pipelineCI.stage.pSpecializationInfo = &specializationInfo;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &brdfLutPipeline));
+		brdfLutPipelineSamples = settings.brdfLutSamples;
+	}
+
+	/** @brief Create the clamping sampler used by all image based lighting textures */
+	VkSampler IBLGenerator::createSampler(uint32_t mipLevels) const
+	{
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.minLod = 0.0f;
+		samplerCI.maxLod = static_cast<float>(mipLevels);
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VkSampler sampler;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &sampler));
+		return sampler;
+	}
+
+	/** @brief Create the image, view and sampler of a texture that is written by the compute shaders */
+	void IBLGenerator::createTexture(vks::Texture &texture, const Target &target) const
+	{
+		const bool cube = (target.layerCount == 6);
+		texture.device = device;
+		texture.width = target.dim;
+		texture.height = target.dim;
+		texture.mipLevels = target.mipLevels;
+		texture.layerCount = target.layerCount;
+		texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = target.format;
+		imageCI.extent = { target.dim, target.dim, 1 };
+		imageCI.mipLevels = target.mipLevels;
+		imageCI.arrayLayers = target.layerCount;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		// Transfer source for writing the cache file
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageCI.flags = cube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &texture.image));
+		VK_CHECK_RESULT(device->allocateImageMemory(texture.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture.deviceMemory, &texture.allocation));
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = cube ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = target.format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, target.mipLevels, 0, target.layerCount };
+		viewCI.image = texture.image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &texture.view));
+
+		texture.sampler = createSampler(target.mipLevels);
+		texture.updateDescriptor();
+	}
+
+	/** @brief Create the storage view of a texture's mip level and allocate the descriptor set of its dispatch */
+	VkDescriptorSet IBLGenerator::createMipDescriptorSet(VkDescriptorPool descriptorPool, const vks::TextureCubeMap &environmentCube, const vks::Texture &texture, const Target &target, uint32_t mipLevel, std::vector<VkImageView> &views) const
+	{
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		// Cube views can't be storage images, the faces are written as the layers of an array
+		viewCI.viewType = (target.layerCount == 6) ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = target.format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevel, 1, 0, target.layerCount };
+		viewCI.image = texture.image;
+		VkImageView view;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &view));
+		views.push_back(view);
+
+		VkDescriptorSet descriptorSet;
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+		VkDescriptorImageInfo environmentDescriptor = environmentCube.descriptor;
+		VkDescriptorImageInfo storageDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &environmentDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &storageDescriptor),
+		};
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		return descriptorSet;
+	}
+
+	/** @brief Check if a cache file exists and matches the cache key and the texture's layout, without loading its image data */
+	bool IBLGenerator::isCacheValid(const std::string &filename, uint64_t key, const Target &target) const
+	{
+		ktxTexture *texture;
+		if (ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_NO_FLAGS, &texture) != KTX_SUCCESS)
+		{
+			return false;
+		}
+		unsigned int valueLen = 0;
+		void *value = nullptr;
+		const bool valid = (ktxHashList_FindValue(&texture->kvDataHead, cacheKeyName, &valueLen, &value) == KTX_SUCCESS)
+			&& (valueLen == sizeof(key)) && (memcmp(value, &key, sizeof(key)) == 0)
+			&& (texture->glInternalformat == target.glInternalformat) && (texture->baseWidth == target.dim) && (texture->baseHeight == target.dim)
+			&& (texture->numLevels == target.mipLevels) && (texture->numFaces == target.layerCount) && (texture->numLayers == 1);
+		ktxTexture_Destroy(texture);
+		return valid;
+	}
+
+	/**
+	* Write a texture that has been read back to its cache file
+	*
+	* @param filename Cache file to (over)write
+	* @param key Cache key stored in the file
+	* @param target Layout of the texture
+	* @param data Tightly packed mip levels, each holding all faces
+	*
+	* @return True if the file was written
+	*/
+	bool IBLGenerator::writeCache(const std::string &filename, uint64_t key, const Target &target, const void *data) const
+	{
+		ktxTextureCreateInfo createInfo{};
+		createInfo.glInternalformat = target.glInternalformat;
+		createInfo.baseWidth = target.dim;
+		createInfo.baseHeight = target.dim;
+		createInfo.baseDepth = 1;
+		createInfo.numDimensions = 2;
+		createInfo.numLevels = target.mipLevels;
+		createInfo.numLayers = 1;
+		createInfo.numFaces = target.layerCount;
+		createInfo.isArray = KTX_FALSE;
+		createInfo.generateMipmaps = KTX_FALSE;
+		ktxTexture *texture;
+		if (ktxTexture_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &texture) != KTX_SUCCESS)
+		{
+			return false;
+		}
+		KTX_error_code result = KTX_SUCCESS;
+		const uint8_t *levelData = static_cast<const uint8_t*>(data);
+		for (uint32_t level = 0; (level < target.mipLevels) && (result == KTX_SUCCESS); level++)
+		{
+			const uint32_t size = std::max(target.dim >> level, 1u);
+			const size_t faceSize = static_cast<size_t>(size) * size * target.texelSize;
+			for (uint32_t face = 0; (face < target.layerCount) && (result == KTX_SUCCESS); face++)
+			{
+				result = ktxTexture_SetImageFromMemory(texture, level, 0, face, levelData + face * faceSize, faceSize);
+			}
+			levelData += target.layerCount * faceSize;
+		}
+		if (result == KTX_SUCCESS)
+		{
+			result = ktxHashList_AddKVPair(&texture->kvDataHead, cacheKeyName, sizeof(key), &key);
+		}
+		if (result == KTX_SUCCESS)
+		{
+			result = ktxTexture_WriteToNamedFile(texture, filename.c_str());
+		}
+		ktxTexture_Destroy(texture);
+		return result == KTX_SUCCESS;
+	}
+
+	/**
+	* Load the image based lighting textures from their cache files or generate them
+	*
+	* @param environmentFile File the environment cube was loaded from, its contents are part of the cache keys and the cache files are stored next to it
+	* @param environmentCube Environment cube map to filter, has to be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	* @param lutBrdf BRDF lookup table (x = dot(N, V), y = roughness) to create
+	* @param irradianceCube Irradiance cube to create
+	* @param prefilteredCube Prefiltered environment cube to create, mip level m is filtered for a roughness of m / (mip levels - 1)
+	*
+	* @note The textures are created in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL and have to be destroyed by the caller
+	*/
+	void IBLGenerator::generate(const std::string &environmentFile, const vks::TextureCubeMap &environmentCube, vks::Texture2D &lutBrdf, vks::TextureCubeMap &irradianceCube, vks::TextureCubeMap &prefilteredCube)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		statistics = Statistics();
+
+		const Target lutTarget = { brdfLutFormat, glInternalformatRGBA16F, 8, settings.brdfLutDim, 1, 1 };
+		const Target irradianceTarget = { irradianceFormat, glInternalformatRGBA32F, 16, settings.irradianceDim, getMipLevels(settings.irradianceDim), 6 };
+		const Target prefilteredTarget = { prefilteredFormat, glInternalformatRGBA16F, 8, settings.prefilteredDim, getMipLevels(settings.prefilteredDim), 6 };
+
+		bool useCache = settings.useCache;
+#if defined(__ANDROID__)
+		useCache = false;
+#endif
+		const size_t separator = environmentFile.find_last_of("/\\");
+		const std::string lutFile = ((separator != std::string::npos) ? environmentFile.substr(0, separator + 1) : std::string()) + "brdflut.ktx";
+		const std::string irradianceFile = environmentFile + ".irradiance.ktx";
+		const std::string prefilteredFile = environmentFile + ".prefiltered.ktx";
+
+		// The keys cover everything the contents of a file depend on
+		uint64_t lutKey = hashData(hashOffsetBasis, &version, sizeof(version));
+		lutKey = hashData(lutKey, &lutTarget, sizeof(lutTarget));
+		lutKey = hashData(lutKey, &settings.brdfLutSamples, sizeof(settings.brdfLutSamples));
+		uint64_t irradianceKey = 0;
+		uint64_t prefilteredKey = 0;
+		if (useCache)
+		{
+			const uint64_t environmentHash = hashFile(environmentFile);
+			irradianceKey = hashData(hashOffsetBasis, &version, sizeof(version));
+			irradianceKey = hashData(irradianceKey, &environmentHash, sizeof(environmentHash));
+			irradianceKey = hashData(irradianceKey, &irradianceTarget, sizeof(irradianceTarget));
+			irradianceKey = hashData(irradianceKey, &settings.irradianceDeltaPhi, sizeof(settings.irradianceDeltaPhi));
+			irradianceKey = hashData(irradianceKey, &settings.irradianceDeltaTheta, sizeof(settings.irradianceDeltaTheta));
+			prefilteredKey = hashData(hashOffsetBasis, &version, sizeof(version));
+			prefilteredKey = hashData(prefilteredKey, &environmentHash, sizeof(environmentHash));
+			prefilteredKey = hashData(prefilteredKey, &prefilteredTarget, sizeof(prefilteredTarget));
+			prefilteredKey = hashData(prefilteredKey, &settings.prefilteredSamples, sizeof(settings.prefilteredSamples));
+
+			statistics.brdfLutCached = isCacheValid(lutFile, lutKey, lutTarget);
+			// Without the environment map's contents the key isn't unique
+			statistics.irradianceCached = (environmentHash != 0) && isCacheValid(irradianceFile, irradianceKey, irradianceTarget);
+			statistics.prefilteredCached = (environmentHash != 0) && isCacheValid(prefilteredFile, prefilteredKey, prefilteredTarget);
+		}
+
+		if (statistics.brdfLutCached)
+		{
+			lutBrdf.loadFromFile(lutFile, brdfLutFormat, device, queue);
+			// Texture2D uses a repeating sampler, the lookup table has to be clamped to its edges
+			vkDestroySampler(device->logicalDevice, lutBrdf.sampler, nullptr);
+			lutBrdf.sampler = createSampler(1);
+			lutBrdf.updateDescriptor();
+		}
+		if (statistics.irradianceCached)
+		{
+			irradianceCube.loadFromFile(irradianceFile, irradianceFormat, device, queue);
+		}
+		if (statistics.prefilteredCached)
+		{
+			prefilteredCube.loadFromFile(prefilteredFile, prefilteredFormat, device, queue);
+		}
+
+		struct Job {
+			vks::Texture *texture;
+			const Target *target;
+			std::string filename;
+			uint64_t key;
+			vks::Buffer readback;
+			std::vector<VkDescriptorSet> descriptorSets;
+		};
+		std::vector<Job> jobs;
+		if (!statistics.brdfLutCached)
+		{
+			jobs.push_back({ &lutBrdf, &lutTarget, lutFile, lutKey });
+		}
+		if (!statistics.irradianceCached)
+		{
+			jobs.push_back({ &irradianceCube, &irradianceTarget, irradianceFile, irradianceKey });
+		}
+		if (!statistics.prefilteredCached)
+		{
+			jobs.push_back({ &prefilteredCube, &prefilteredTarget, prefilteredFile, prefilteredKey });
+		}
+
+		if (!jobs.empty())
+		{
+			uint32_t setCount = 0;
+			for (const Job &job : jobs)
+			{
+				setCount += job.target->mipLevels;
+			}
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount),
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, setCount);
+			VkDescriptorPool descriptorPool;
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+			std::vector<VkImageView> views;
+
+			if (!statistics.brdfLutCached)
+			{
+				createBrdfLutPipeline();
+			}
+			for (Job &job : jobs)
+			{
+				createTexture(*job.texture, *job.target);
+				for (uint32_t m = 0; m < job.target->mipLevels; m++)
+				{
+					job.descriptorSets.push_back(createMipDescriptorSet(descriptorPool, environmentCube, *job.texture, *job.target, m, views));
+				}
+				if (useCache)
+				{
+					VkDeviceSize size = 0;
+					for (uint32_t m = 0; m < job.target->mipLevels; m++)
+					{
+						const VkDeviceSize levelSize = std::max(job.target->dim >> m, 1u);
+						size += levelSize * levelSize * job.target->texelSize * job.target->layerCount;
+					}
+					VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &job.readback, size));
+				}
+			}
+
+			// All textures are generated (and read back) by a single submission
+			VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			for (Job &job : jobs)
+			{
+				const Target &target = *job.target;
+				const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, target.mipLevels, 0, target.layerCount };
+				vks::tools::insertImageMemoryBarrier(commandBuffer, job.texture->image, 0, VK_ACCESS_SHADER_WRITE_BIT,
+					VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, subresourceRange);
+
+				const bool lut = (job.texture == &lutBrdf);
+				const uint32_t groupSize = lut ? brdfLutGroupSize : cubeGroupSize;
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lut ? brdfLutPipeline : ((job.texture == &irradianceCube) ? irradiancePipeline : prefilterPipeline));
+				for (uint32_t m = 0; m < target.mipLevels; m++)
+				{
+					if (job.texture == &irradianceCube)
+					{
+						IrradiancePushConstants pushConstants = { settings.irradianceDeltaPhi, settings.irradianceDeltaTheta };
+						vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+					}
+					else if (job.texture == &prefilteredCube)
+					{
+						PrefilterPushConstants pushConstants = { (float)m / (float)(target.mipLevels - 1), settings.prefilteredSamples };
+						vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+					}
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &job.descriptorSets[m], 0, nullptr);
+					// One dispatch per mip level, z selects the cube face
+					const uint32_t size = std::max(target.dim >> m, 1u);
+					const uint32_t groupCount = (size + groupSize - 1) / groupSize;
+					vkCmdDispatch(commandBuffer, groupCount, groupCount, target.layerCount);
+				}
+
+				if (job.readback.buffer)
+				{
+					vks::tools::insertImageMemoryBarrier(commandBuffer, job.texture->image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+						VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
+					// Mip levels are packed one after the other, each holding all faces
+					std::vector<VkBufferImageCopy> copyRegions;
+					VkDeviceSize offset = 0;
+					for (uint32_t m = 0; m < target.mipLevels; m++)
+					{
+						const uint32_t size = std::max(target.dim >> m, 1u);
+						VkBufferImageCopy copyRegion = {};
+						copyRegion.bufferOffset = offset;
+						copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, m, 0, target.layerCount };
+						copyRegion.imageExtent = { size, size, 1 };
+						copyRegions.push_back(copyRegion);
+						offset += static_cast<VkDeviceSize>(size) * size * target.texelSize * target.layerCount;
+					}
+					vkCmdCopyImageToBuffer(commandBuffer, job.texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, job.readback.buffer, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+					vks::tools::insertImageMemoryBarrier(commandBuffer, job.texture->image, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+						VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, subresourceRange);
+				}
+				else
+				{
+					vks::tools::insertImageMemoryBarrier(commandBuffer, job.texture->image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+						VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, subresourceRange);
+				}
+			}
+			if (useCache)
+			{
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+			device->flushCommandBuffer(commandBuffer, queue, true);
+
+			for (Job &job : jobs)
+			{
+				if (job.readback.buffer)
+				{
+					VK_CHECK_RESULT(job.readback.map());
+					if (!writeCache(job.filename, job.key, *job.target, job.readback.mapped))
+					{
+						std::cerr << "Could not write image based lighting cache file \"" << job.filename << "\"\n";
+					}
+					job.readback.destroy();
+				}
+			}
+			for (VkImageView view : views)
+			{
+				vkDestroyImageView(device->logicalDevice, view, nullptr);
+			}
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		}
+
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		statistics.time = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+	}
+
+	/**
+	* Project an environment cube into the spherical harmonics coefficients of its irradiance
+	*
+	* @param environmentCube Environment cube map to project, has to be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	* @param coefficients Receives the rgb coefficients (w is zero) in the order of the basis functions Y00, Y1-1, Y10, Y11, Y2-2, Y2-1, Y20, Y21, Y22
+	*
+	* @note Waits for the dispatch to finish, the coefficients are read back through a host visible buffer
+	*/
+	void IBLGenerator::generateIrradianceSH(const vks::TextureCubeMap &environmentCube, glm::vec4 coefficients[shCoefficientCount])
+	{
+		vks::Buffer coefficientBuffer;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &coefficientBuffer, sizeof(glm::vec4) * shCoefficientCount));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VkDescriptorPool descriptorPool;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+		VkDescriptorSet descriptorSet;
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+		VkDescriptorImageInfo environmentDescriptor = environmentCube.descriptor;
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &environmentDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &coefficientBuffer.descriptor),
+		};
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		// Coarser levels are accurate enough for the low frequencies of the irradiance and keep the single work group's loop short
+		int32_t lod = 0;
+		while ((lod + 1 < static_cast<int32_t>(environmentCube.mipLevels)) && ((environmentCube.width >> lod) > shSourceDim))
+		{
+			lod++;
+		}
+		int32_t pushConstants[2] = { lod, 0 };
+
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, irradianceSHPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), pushConstants);
+		vkCmdDispatch(commandBuffer, 1, 1, 1);
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		device->flushCommandBuffer(commandBuffer, queue, true);
+
+		VK_CHECK_RESULT(coefficientBuffer.map());
+		memcpy(coefficients, coefficientBuffer.mapped, sizeof(glm::vec4) * shCoefficientCount);
+		coefficientBuffer.destroy();
+		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+	}
+
+	void IBLGenerator::setSettings(const Settings &settings)
+	{
+		this->settings = settings;
+	}
+
+	const IBLGenerator::Settings &IBLGenerator::getSettings() const
+	{
+		return settings;
+	}
+
+	const IBLGenerator::Statistics &IBLGenerator::getStatistics() const
+	{
+		return statistics;
+	}
+}
@@ -0,0 +1,125 @@
+/*
+* Image based lighting generator
+*
+* Generates the BRDF lookup table, irradiance cube and prefiltered environment cube for image based lighting with compute shaders, and
+* caches them in ktx files next to the environment map, so later runs with the same environment map and settings only load them
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanTexture.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Generator for the image based lighting textures using the "base/genbrdflut.comp", "base/irradiancecube.comp", "base/prefilterenvmap.comp"
+	* and "base/irradiancesh.comp" compute shaders
+	*
+	* Usage:
+	*	textures.environmentCube.loadFromFile(getAssetPath() + "textures/hdr/pisa_cube.ktx", VK_FORMAT_R16G16B16A16_SFLOAT, vulkanDevice, queue);
+	*	vks::IBLGenerator iblGenerator(vulkanDevice, queue, getShadersPath());
+	*	iblGenerator.generate(getAssetPath() + "textures/hdr/pisa_cube.ktx", textures.environmentCube, textures.lutBrdf, textures.irradianceCube, textures.prefilteredCube);
+	*	// The generator can be destroyed once generate() has returned, the textures are owned (and destroyed) by the caller
+	*	// Optional: Spherical harmonics instead of the irradiance cube
+	*	iblGenerator.generateIrradianceSH(textures.environmentCube, uniformData.shCoefficients);
+	*
+	* Each cube is generated with one dispatch per mip level that writes all six faces, the face being the z coordinate of the invocation.
+	* Generated textures are read back and written to ktx files named after the environment map ("<environment map>.irradiance.ktx" and
+	* "<environment map>.prefiltered.ktx", the BRDF lookup table doesn't depend on the environment and is stored as "brdflut.ktx" in the same
+	* directory). Each file stores a hash of everything its content depends on as key/value data: the contents of the environment map, the
+	* settings, the format and a version that has to be increased whenever the shaders change. Files whose key doesn't match are regenerated.
+	* generateIrradianceSH() projects the environment into L2 spherical harmonics with a single work group reduction over the mip level with
+	* faces of at most shSourceDim texels. The nine rgb coefficients are already convolved with the cosine lobe and divided by PI, so
+	* evaluating the basis with them (see evaluateSH() in the pbribl and pbrtexture shaders) replaces sampling the irradiance cube.
+	*
+	* @note The BRDF lookup table is stored as rgba16f (with b and a unused), as rg16f storage images need shaderStorageImageExtendedFormats
+	* @note Cache files are neither read nor written on Android, where assets are read from the apk
+	* @note Writing a cache file waits for the generation to finish, the first run is therefore slightly slower than generating without cache
+	*/
+	class IBLGenerator
+	{
+	public:
+		struct Settings {
+			uint32_t brdfLutDim = 512;
+			uint32_t brdfLutSamples = 1024;
+			uint32_t irradianceDim = 64;
+			// Sampling deltas of the irradiance convolution in radians
+			float irradianceDeltaPhi = 6.28318531f / 180.0f;
+			float irradianceDeltaTheta = 1.57079633f / 64.0f;
+			uint32_t prefilteredDim = 512;
+			uint32_t prefilteredSamples = 32;
+			// Load the textures from and write them to the cache files
+			bool useCache = true;
+		};
+
+		struct Statistics {
+			// Textures loaded from their cache file by the last generate() call
+			bool brdfLutCached = false;
+			bool irradianceCached = false;
+			bool prefilteredCached = false;
+			// Time taken by the last generate() call in milliseconds, including loading or writing the cache files
+			double time = 0.0;
+		};
+
+	private:
+		struct Target {
+			VkFormat format;
+			uint32_t glInternalformat;
+			uint32_t texelSize;
+			uint32_t dim;
+			uint32_t mipLevels;
+			uint32_t layerCount;
+		};
+		vks::VulkanDevice *device;
+		VkQueue queue;
+		Settings settings;
+		Statistics statistics;
+		VkShaderModule brdfLutModule = VK_NULL_HANDLE;
+		VkShaderModule irradianceModule = VK_NULL_HANDLE;
+		VkShaderModule prefilterModule = VK_NULL_HANDLE;
+		VkShaderModule irradianceSHModule = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline brdfLutPipeline = VK_NULL_HANDLE;
+		VkPipeline irradiancePipeline = VK_NULL_HANDLE;
+		VkPipeline prefilterPipeline = VK_NULL_HANDLE;
+		VkPipeline irradianceSHPipeline = VK_NULL_HANDLE;
+		// Sample count the BRDF lookup table pipeline was specialized for
+		uint32_t brdfLutPipelineSamples = 0;
+		void createBrdfLutPipeline();
+		VkSampler createSampler(uint32_t mipLevels) const;
+		void createTexture(vks::Texture &texture, const Target &target) const;
+		VkDescriptorSet createMipDescriptorSet(VkDescriptorPool descriptorPool, const vks::TextureCubeMap &environmentCube, const vks::Texture &texture, const Target &target, uint32_t mipLevel, std::vector<VkImageView> &views) const;
+		bool isCacheValid(const std::string &filename, uint64_t key, const Target &target) const;
+		bool writeCache(const std::string &filename, uint64_t key, const Target &target, const void *data) const;
+	public:
+		static const VkFormat brdfLutFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+		static const VkFormat irradianceFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+		static const VkFormat prefilteredFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+		// Part of every cache key, increase it whenever a change to the shaders changes their results
+		static const uint32_t version = 1;
+		static const uint32_t shCoefficientCount = 9;
+		// Faces of the environment mip level projected into spherical harmonics are at most this large
+		static const uint32_t shSourceDim = 64;
+
+		IBLGenerator(vks::VulkanDevice *device, VkQueue queue, const std::string &shadersPath);
+		~IBLGenerator();
+		void generate(const std::string &environmentFile, const vks::TextureCubeMap &environmentCube, vks::Texture2D &lutBrdf, vks::TextureCubeMap &irradianceCube, vks::TextureCubeMap &prefilteredCube);
+		void generateIrradianceSH(const vks::TextureCubeMap &environmentCube, glm::vec4 coefficients[shCoefficientCount]);
+		void setSettings(const Settings &settings);
+		const Settings &getSettings() const;
+		const Statistics &getStatistics() const;
+	};
+}
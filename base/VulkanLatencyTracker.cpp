@@ -0,0 +1,110 @@
+/*
+* Input to present latency measurement
+*
+* Timestamps input events, assigns them to the frame that consumes them and measures the time until that frame has been presented,
+* using VK_KHR_present_id and VK_KHR_present_wait if enabled and the return of vkQueuePresentKHR otherwise
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanLatencyTracker.h"
+#include "VulkanTrace.h"
+
+namespace vks
+{
+	namespace
+	{
+		// Pending presents of frames that never complete (e.g. dropped by the presentation engine) are discarded beyond this
+		const size_t maxPendingPresents = 16;
+	}
+
+	/**
+	* @param device Logical device the swap chain has been created on
+	* @param presentWait True if VK_KHR_present_id and VK_KHR_present_wait and their features have been enabled on the device
+	*/
+	void LatencyTracker::setup(VkDevice device, bool presentWait)
+	{
+		this->device = device;
+		vkWaitForPresentKHR = presentWait ? reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device, "vkWaitForPresentKHR")) : nullptr;
+	}
+
+	/** @brief Record an input event, only the earliest event before a frame is kept as that frame's input */
+	void LatencyTracker::inputEvent()
+	{
+		if (pendingInput == 0)
+		{
+			pendingInput = Tracer::now();
+		}
+	}
+
+	/** @brief Assign the input events handled so far to the frame that is about to be recorded */
+	void LatencyTracker::beginFrame()
+	{
+		frameInput = pendingInput;
+		pendingInput = 0;
+	}
+
+	/**
+	* Called when the frame is presented
+	*
+	* @return Present id to pass with VkPresentIdKHR if present wait is enabled, 0 otherwise
+	*/
+	uint64_t LatencyTracker::presentFrame(VkSwapchainKHR swapChain)
+	{
+		if (!presentWaitEnabled())
+		{
+			if (frameInput != 0)
+			{
+				samples.push_back(static_cast<double>(Tracer::now() - frameInput) / 1000000.0);
+				frameInput = 0;
+			}
+			return 0;
+		}
+		const uint64_t presentId = nextPresentId++;
+		if (frameInput != 0)
+		{
+			if (pendingPresents.size() >= maxPendingPresents)
+			{
+				pendingPresents.pop_front();
+			}
+			pendingPresents.push_back({ swapChain, presentId, frameInput });
+			frameInput = 0;
+		}
+		return presentId;
+	}
+
+	/**
+	* Measure the presents of frames with input that have completed since the last call
+	*
+	* @param swapChain Current swap chain, presents to earlier (possibly destroyed) swap chains are dropped without being waited for
+	*/
+	void LatencyTracker::update(VkSwapchainKHR swapChain)
+	{
+		while (!pendingPresents.empty())
+		{
+			const PendingPresent &present = pendingPresents.front();
+			if (present.swapChain != swapChain)
+			{
+				pendingPresents.pop_front();
+				continue;
+			}
+			const VkResult result = vkWaitForPresentKHR(device, present.swapChain, present.presentId, 0);
+			if (result == VK_TIMEOUT)
+			{
+				// Presents complete in order
+				return;
+			}
+			if (result == VK_SUCCESS)
+			{
+				samples.push_back(static_cast<double>(Tracer::now() - present.inputTime) / 1000000.0);
+			}
+			// Presents that can't complete anymore (VK_ERROR_OUT_OF_DATE_KHR) are dropped
+			pendingPresents.pop_front();
+		}
+	}
+
+	void LatencyTracker::clearSamples()
+	{
+		samples.clear();
+	}
+}
@@ -0,0 +1,73 @@
+/*
+* Input to present latency measurement
+*
+* Timestamps input events, assigns them to the frame that consumes them and measures the time until that frame has been presented,
+* using VK_KHR_present_id and VK_KHR_present_wait if enabled and the return of vkQueuePresentKHR otherwise
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	/**
+	* Latency between the first input event handled before a frame and the presentation of that frame
+	*
+	* Usage:
+	*	// In the window system's event handlers
+	*	latencyTracker.inputEvent();
+	*	// Before recording a frame, after the events have been handled
+	*	latencyTracker.beginFrame();
+	*	// When presenting, chain the returned present id into VkPresentInfoKHR with VkPresentIdKHR if present wait is enabled
+	*	uint64_t presentId = latencyTracker.presentFrame(swapChain);
+	*	// Once per frame, collects the presents that have completed
+	*	latencyTracker.update(swapChain);
+	*
+	* With present wait, completed presents are polled once per frame (vkWaitForPresentKHR without a timeout), so a measurement may be late by
+	* up to one frame. Without it, the latency ends when vkQueuePresentKHR returns, which doesn't include the time the image waits for the
+	* GPU and the presentation engine.
+	*
+	* @note Input events arriving while a frame is recorded count towards the next frame
+	*/
+	class LatencyTracker
+	{
+	private:
+		struct PendingPresent {
+			VkSwapchainKHR swapChain;
+			uint64_t presentId;
+			uint64_t inputTime;
+		};
+		VkDevice device = VK_NULL_HANDLE;
+		PFN_vkWaitForPresentKHR vkWaitForPresentKHR = nullptr;
+		// Earliest input event not consumed by a frame yet, 0 if there is none
+		uint64_t pendingInput = 0;
+		// Earliest input event consumed by the frame being recorded
+		uint64_t frameInput = 0;
+		uint64_t nextPresentId = 1;
+		std::deque<PendingPresent> pendingPresents;
+		std::vector<double> samples;
+	public:
+		void setup(VkDevice device, bool presentWait);
+		/** @brief True if presents are tagged with present ids and waited for with VK_KHR_present_wait */
+		bool presentWaitEnabled() const
+		{
+			return vkWaitForPresentKHR != nullptr;
+		}
+		void inputEvent();
+		void beginFrame();
+		uint64_t presentFrame(VkSwapchainKHR swapChain);
+		void update(VkSwapchainKHR swapChain);
+		/** @brief Input to present latencies in milliseconds in the order the presents completed */
+		const std::vector<double> &getSamples() const
+		{
+			return samples;
+		}
+		void clearSamples();
+	};
+}
@@ -0,0 +1,133 @@
+/*
+* Read-only file mapping
+*
+* Maps a whole file into memory (or on Android, the buffer of an asset) so loaders can read from it without copying it into heap memory first
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include "VulkanTools.h"
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace vks
+{
+	/**
+	* Read-only memory mapping of a whole file
+	*
+	* @note On Android the file is opened as an asset from the apk, uncompressed assets are mapped directly by the asset manager
+	*/
+	class MappedFile
+	{
+	private:
+#if defined(__ANDROID__)
+		AAsset* asset = nullptr;
+#elif defined(_WIN32)
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+#else
+		int fd = -1;
+#endif
+	public:
+		/** @brief Start of the mapped file contents, nullptr if no file is mapped */
+		const char* data = nullptr;
+		size_t size = 0;
+
+		MappedFile() {};
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile()
+		{
+			close();
+		}
+
+		/** @brief Map the given file, returns false if the file can't be opened or is empty */
+		bool open(const std::string& filename)
+		{
+			close();
+#if defined(__ANDROID__)
+			asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_BUFFER);
+			if (!asset) {
+				return false;
+			}
+			data = static_cast<const char*>(AAsset_getBuffer(asset));
+			size = static_cast<size_t>(AAsset_getLength(asset));
+#elif defined(_WIN32)
+			file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE) {
+				return false;
+			}
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || (fileSize.QuadPart == 0)) {
+				close();
+				return false;
+			}
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping == nullptr) {
+				close();
+				return false;
+			}
+			data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			size = static_cast<size_t>(fileSize.QuadPart);
+#else
+			fd = ::open(filename.c_str(), O_RDONLY);
+			if (fd < 0) {
+				return false;
+			}
+			struct stat fileStat;
+			if ((fstat(fd, &fileStat) != 0) || (fileStat.st_size == 0)) {
+				close();
+				return false;
+			}
+			void* mappedData = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			data = (mappedData != MAP_FAILED) ? static_cast<const char*>(mappedData) : nullptr;
+			size = static_cast<size_t>(fileStat.st_size);
+#endif
+			if (!data || (size == 0)) {
+				close();
+				return false;
+			}
+			return true;
+		}
+
+		void close()
+		{
+#if defined(__ANDROID__)
+			if (asset) {
+				AAsset_close(asset);
+				asset = nullptr;
+			}
+#elif defined(_WIN32)
+			if (data) {
+				UnmapViewOfFile(data);
+			}
+			if (mapping != nullptr) {
+				CloseHandle(mapping);
+				mapping = nullptr;
+			}
+			if (file != INVALID_HANDLE_VALUE) {
+				CloseHandle(file);
+				file = INVALID_HANDLE_VALUE;
+			}
+#else
+			if (data) {
+				munmap(const_cast<char*>(data), size);
+			}
+			if (fd >= 0) {
+				::close(fd);
+				fd = -1;
+			}
+#endif
+			data = nullptr;
+			size = 0;
+		}
+	};
+}
@@ -0,0 +1,100 @@
+/*
+* Batched flushes of mapped non-coherent memory
+*
+* Collects the ranges written to mapped non-coherent memory and flushes them with a single vkFlushMappedMemoryRanges call, with
+* overlapping and adjacent ranges merged and all ranges aligned to nonCoherentAtomSize
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMappedRangeBatch.h"
+#include <algorithm>
+
+namespace vks
+{
+	/**
+	* @param device Logical device the memory objects have been allocated from
+	* @param nonCoherentAtomSize Flush granularity of the physical device (VkPhysicalDeviceLimits::nonCoherentAtomSize)
+	*/
+	MappedRangeBatch::MappedRangeBatch(VkDevice device, VkDeviceSize nonCoherentAtomSize) : device(device), nonCoherentAtomSize(std::max(nonCoherentAtomSize, (VkDeviceSize)1))
+	{
+	}
+
+	/**
+	* Add a written range of a mapped memory object to the next flush
+	*
+	* @param memory Memory object the range belongs to
+	* @param offset Byte offset of the range from the start of the memory object
+	* @param size Size of the range in bytes, VK_WHOLE_SIZE for the rest of the memory object
+	*/
+	void MappedRangeBatch::add(VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size)
+	{
+		if ((memory == VK_NULL_HANDLE) || (size == 0))
+		{
+			return;
+		}
+		Range range;
+		range.memory = memory;
+		range.begin = offset / nonCoherentAtomSize * nonCoherentAtomSize;
+		range.end = (size == VK_WHOLE_SIZE) ? UINT64_MAX : (offset + size + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize;
+		std::lock_guard<std::mutex> guard(lock);
+		ranges.push_back(range);
+		statistics.rangesAdded++;
+	}
+
+	/**
+	* Flush all ranges added since the last flush with one vkFlushMappedMemoryRanges call
+	*
+	* @return VK_SUCCESS if there was nothing to flush, otherwise the result of vkFlushMappedMemoryRanges
+	*/
+	VkResult MappedRangeBatch::flush()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (ranges.empty())
+		{
+			return VK_SUCCESS;
+		}
+		std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return (a.memory != b.memory) ? (a.memory < b.memory) : (a.begin < b.begin); });
+		// Ranges of the same memory object that overlap or touch are merged
+		std::vector<Range> merged;
+		merged.reserve(ranges.size());
+		for (const Range& range : ranges)
+		{
+			if (!merged.empty() && (merged.back().memory == range.memory) && (range.begin <= merged.back().end))
+			{
+				merged.back().end = std::max(merged.back().end, range.end);
+			}
+			else
+			{
+				merged.push_back(range);
+			}
+		}
+		mappedRanges.resize(merged.size());
+		for (size_t i = 0; i < merged.size(); i++)
+		{
+			VkMappedMemoryRange& mappedRange = mappedRanges[i];
+			mappedRange = {};
+			mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			mappedRange.memory = merged[i].memory;
+			mappedRange.offset = merged[i].begin;
+			mappedRange.size = (merged[i].end == UINT64_MAX) ? VK_WHOLE_SIZE : merged[i].end - merged[i].begin;
+		}
+		ranges.clear();
+		statistics.rangesFlushed += mappedRanges.size();
+		statistics.flushCalls++;
+		return vkFlushMappedMemoryRanges(device, static_cast<uint32_t>(mappedRanges.size()), mappedRanges.data());
+	}
+
+	/** @brief True if no ranges have been added since the last flush */
+	bool MappedRangeBatch::empty()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return ranges.empty();
+	}
+
+	MappedRangeBatch::Statistics MappedRangeBatch::getStatistics()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return statistics;
+	}
+}
@@ -0,0 +1,64 @@
+/*
+* Batched flushes of mapped non-coherent memory
+*
+* Collects the ranges written to mapped non-coherent memory and flushes them with a single vkFlushMappedMemoryRanges call, with
+* overlapping and adjacent ranges merged and all ranges aligned to nonCoherentAtomSize
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	/**
+	* Dirty range tracker for mapped non-coherent memory
+	*
+	* Usage:
+	*	// Writing to a persistently mapped buffer (see vks::Buffer::markDirty())
+	*	memcpy(static_cast<char*>(buffer.mapped) + offset, data, size);
+	*	buffer.markDirty(size, offset);
+	*	// Once per frame, before the submission reading the buffers
+	*	vulkanDevice->flushMappedRanges();
+	*
+	* Ranges are widened to multiples of nonCoherentAtomSize, so the memory objects must be allocated in whole atoms (the memory allocator
+	* and VulkanDevice::createBuffer do this for non-coherent memory). A range of VK_WHOLE_SIZE covers the memory from its offset to the end.
+	*
+	* @note Adding ranges and flushing is internally synchronized, so worker threads may mark the ranges they write
+	*/
+	class MappedRangeBatch
+	{
+	public:
+		struct Statistics {
+			// Ranges added since the batch was created
+			uint64_t rangesAdded = 0;
+			// Ranges passed to vkFlushMappedMemoryRanges after merging
+			uint64_t rangesFlushed = 0;
+			uint64_t flushCalls = 0;
+		};
+
+	private:
+		struct Range {
+			VkDeviceMemory memory;
+			VkDeviceSize begin;
+			// UINT64_MAX for ranges reaching to the end of the memory object
+			VkDeviceSize end;
+		};
+		VkDevice device;
+		VkDeviceSize nonCoherentAtomSize;
+		std::mutex lock;
+		std::vector<Range> ranges;
+		std::vector<VkMappedMemoryRange> mappedRanges;
+		Statistics statistics;
+	public:
+		MappedRangeBatch(VkDevice device, VkDeviceSize nonCoherentAtomSize);
+		void add(VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size);
+		VkResult flush();
+		bool empty();
+		Statistics getStatistics();
+	};
+}
@@ -0,0 +1,393 @@
+/*
+* Vulkan device memory sub-allocator
+*
+* Hands out aligned ranges from large VkDeviceMemory blocks instead of doing one allocation per resource
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMemoryAllocator.h"
+#include <algorithm>
+
+namespace vks
+{
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	/**
+	* @param device Logical device to allocate the memory blocks from
+	* @param physicalDevice Physical device used to read memory types, heap sizes and limits
+	*/
+	MemoryAllocator::MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice) : device(device)
+	{
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		nonCoherentAtomSize = std::max(properties.limits.nonCoherentAtomSize, (VkDeviceSize)1);
+		pools.resize(memoryProperties.memoryTypeCount * 2);
+	}
+
+	/** @brief Release all memory blocks, resources still using memory from the allocator must have been destroyed before */
+	MemoryAllocator::~MemoryAllocator()
+	{
+		for (auto& pool : pools)
+		{
+			for (auto& block : pool.blocks)
+			{
+				if (block.allocationCount > 0)
+				{
+					std::cerr << "Memory allocator destroyed with " << block.allocationCount << " allocation(s) still in use\n";
+				}
+				if (block.memory != VK_NULL_HANDLE)
+				{
+					if (tracker)
+					{
+						tracker->remove(block.memory);
+					}
+					vkFreeMemory(device, block.memory, nullptr);
+				}
+			}
+		}
+	}
+
+	/** @brief Size of the regular blocks allocated for the given memory type */
+	VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryTypeIndex) const
+	{
+		const VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+		return (heapSize <= 1024ULL * 1024 * 1024) ? std::min(preferredBlockSize, heapSize / 8) : preferredBlockSize;
+	}
+
+	VkResult MemoryAllocator::createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated, Block& block)
+	{
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = size;
+		memAlloc.memoryTypeIndex = memoryTypeIndex;
+		VkResult result = vkAllocateMemory(device, &memAlloc, nullptr, &block.memory);
+		if (result != VK_SUCCESS)
+		{
+			return result;
+		}
+		// Host visible blocks stay mapped for their whole lifetime, as a memory object can't be mapped more than once at a time
+		if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		{
+			result = vkMapMemory(device, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mapped);
+			if (result != VK_SUCCESS)
+			{
+				vkFreeMemory(device, block.memory, nullptr);
+				block.memory = VK_NULL_HANDLE;
+				return result;
+			}
+		}
+		block.size = size;
+		block.dedicated = dedicated;
+		block.allocationCount = 0;
+		block.freeRanges.clear();
+		block.freeRanges[0] = size;
+		return VK_SUCCESS;
+	}
+
+	// Best fit search of the block's free ranges, on success the range is removed from the free list
+	bool MemoryAllocator::allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+	{
+		auto best = block.freeRanges.end();
+		for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); it++)
+		{
+			const VkDeviceSize alignedOffset = alignUp(it->first, alignment);
+			if ((alignedOffset + size <= it->first + it->second) && ((best == block.freeRanges.end()) || (it->second < best->second)))
+			{
+				best = it;
+			}
+		}
+		if (best == block.freeRanges.end())
+		{
+			return false;
+		}
+		const VkDeviceSize rangeOffset = best->first;
+		const VkDeviceSize rangeEnd = best->first + best->second;
+		offset = alignUp(rangeOffset, alignment);
+		block.freeRanges.erase(best);
+		// Padding in front of the aligned offset and the remainder behind the allocation stay available
+		if (offset > rangeOffset)
+		{
+			block.freeRanges[rangeOffset] = offset - rangeOffset;
+		}
+		if (offset + size < rangeEnd)
+		{
+			block.freeRanges[offset + size] = rangeEnd - (offset + size);
+		}
+		block.allocationCount++;
+		return true;
+	}
+
+	/**
+	* Allocate a range of device memory
+	*
+	* @param memoryRequirements Size, alignment and memory type bits of the resource
+	* @param memoryTypeIndex Memory type to allocate from
+	* @param linear True for buffers and linear tiling images, false for optimal tiling images
+	* @param allocation Pointer to the allocation that receives the memory, offset and (if host visible) mapped address
+	* @param excludedBlockIndex (Optional) Block of the pool that must not be used, for moving a resource out of its block. No new block is allocated
+	* then, the resource is placed in the fullest existing block it fits into (Defaults to none)
+	*
+	* @return VK_SUCCESS if the memory has been allocated, otherwise the error returned by vkAllocateMemory (VK_ERROR_OUT_OF_DEVICE_MEMORY if no
+	* other block has room with an excluded block)
+	*/
+	VkResult MemoryAllocator::allocate(const VkMemoryRequirements& memoryRequirements, uint32_t memoryTypeIndex, bool linear, MemoryAllocation* allocation, uint32_t excludedBlockIndex)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		const VkMemoryPropertyFlags propertyFlags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+		VkDeviceSize alignment = std::max(memoryRequirements.alignment, (VkDeviceSize)1);
+		VkDeviceSize size = memoryRequirements.size;
+		// Ranges of non-coherent memory are flushed and invalidated in multiples of nonCoherentAtomSize, so they must not share an atom with their neighbours
+		if ((propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+		{
+			alignment = alignUp(alignment, nonCoherentAtomSize);
+			size = alignUp(size, nonCoherentAtomSize);
+		}
+
+		const uint32_t poolIndex = memoryTypeIndex * 2 + (linear ? 0 : 1);
+		Pool& pool = pools[poolIndex];
+		const VkDeviceSize blockSize = getBlockSize(memoryTypeIndex);
+		const bool dedicated = size > blockSize / 2;
+
+		VkDeviceSize offset = 0;
+		uint32_t blockIndex = UINT32_MAX;
+		if (!dedicated && (excludedBlockIndex == UINT32_MAX))
+		{
+			for (uint32_t i = 0; i < pool.blocks.size(); i++)
+			{
+				Block& block = pool.blocks[i];
+				if ((block.memory != VK_NULL_HANDLE) && !block.dedicated && allocateFromBlock(block, size, alignment, offset))
+				{
+					blockIndex = i;
+					break;
+				}
+			}
+		}
+		else if (!dedicated)
+		{
+			// Fill the fullest blocks first, so moved resources don't spread out over blocks that are about to be emptied as well
+			std::vector<uint32_t> candidates;
+			for (uint32_t i = 0; i < pool.blocks.size(); i++)
+			{
+				if ((i != excludedBlockIndex) && (pool.blocks[i].memory != VK_NULL_HANDLE) && !pool.blocks[i].dedicated)
+				{
+					candidates.push_back(i);
+				}
+			}
+			std::sort(candidates.begin(), candidates.end(), [this, &pool](uint32_t a, uint32_t b) { return getUsedBytes(pool.blocks[a]) > getUsedBytes(pool.blocks[b]); });
+			for (uint32_t i : candidates)
+			{
+				if (allocateFromBlock(pool.blocks[i], size, alignment, offset))
+				{
+					blockIndex = i;
+					break;
+				}
+			}
+		}
+
+		if ((blockIndex == UINT32_MAX) && (excludedBlockIndex != UINT32_MAX))
+		{
+			return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+		}
+
+		// No free range large enough, reuse a released block slot or add a new one
+		if (blockIndex == UINT32_MAX)
+		{
+			auto freeSlot = std::find_if(pool.blocks.begin(), pool.blocks.end(), [](const Block& block) { return block.memory == VK_NULL_HANDLE; });
+			if (freeSlot == pool.blocks.end())
+			{
+				pool.blocks.push_back(Block());
+				freeSlot = pool.blocks.end() - 1;
+			}
+			Block& block = *freeSlot;
+			VkResult result = createBlock(memoryTypeIndex, dedicated ? size : blockSize, dedicated, block);
+			if (result != VK_SUCCESS)
+			{
+				return result;
+			}
+			if (tracker)
+			{
+				tracker->add(block.memory, linear ? MemoryCategory::Buffer : MemoryCategory::Image, block.size, memoryTypeIndex);
+			}
+			blockIndex = static_cast<uint32_t>(std::distance(pool.blocks.begin(), freeSlot));
+			allocateFromBlock(block, size, alignment, offset);
+		}
+
+		const Block& block = pool.blocks[blockIndex];
+		allocation->memory = block.memory;
+		allocation->offset = offset;
+		allocation->size = size;
+		allocation->mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+		allocation->memoryTypeIndex = memoryTypeIndex;
+		allocation->poolIndex = poolIndex;
+		allocation->blockIndex = blockIndex;
+		return VK_SUCCESS;
+	}
+
+	/** @brief Return the allocation's range to its block, the allocation is reset afterwards */
+	void MemoryAllocator::free(MemoryAllocation& allocation)
+	{
+		if (allocation.memory == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> guard(lock);
+		Block& block = pools[allocation.poolIndex].blocks[allocation.blockIndex];
+		assert(block.memory == allocation.memory);
+		block.allocationCount--;
+		if (block.dedicated && (block.allocationCount == 0))
+		{
+			if (tracker)
+			{
+				tracker->remove(block.memory);
+			}
+			vkFreeMemory(device, block.memory, nullptr);
+			block = Block();
+		}
+		else
+		{
+			VkDeviceSize offset = allocation.offset;
+			VkDeviceSize size = allocation.size;
+			// Merge with the adjacent free ranges
+			auto next = block.freeRanges.lower_bound(offset);
+			if ((next != block.freeRanges.end()) && (next->first == offset + size))
+			{
+				size += next->second;
+				next = block.freeRanges.erase(next);
+			}
+			if (next != block.freeRanges.begin())
+			{
+				auto prev = std::prev(next);
+				if (prev->first + prev->second == offset)
+				{
+					offset = prev->first;
+					size += prev->second;
+					block.freeRanges.erase(prev);
+				}
+			}
+			block.freeRanges[offset] = size;
+		}
+		allocation = MemoryAllocation();
+	}
+
+	VkDeviceSize MemoryAllocator::getUsedBytes(const Block& block) const
+	{
+		VkDeviceSize freeBytes = 0;
+		for (auto& range : block.freeRanges)
+		{
+			freeBytes += range.second;
+		}
+		return block.size - freeBytes;
+	}
+
+	/**
+	* Release regular blocks without any allocations
+	*
+	* @param sparePerPool (Optional) Number of empty blocks kept per pool, so a resource freed and created again doesn't allocate a new block (Defaults to 1)
+	*
+	* @return Number of blocks released
+	*/
+	uint32_t MemoryAllocator::releaseEmptyBlocks(uint32_t sparePerPool)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		uint32_t released = 0;
+		for (auto& pool : pools)
+		{
+			uint32_t spare = 0;
+			for (auto& block : pool.blocks)
+			{
+				if ((block.memory == VK_NULL_HANDLE) || block.dedicated || (block.allocationCount > 0))
+				{
+					continue;
+				}
+				if (spare < sparePerPool)
+				{
+					spare++;
+					continue;
+				}
+				if (tracker)
+				{
+					tracker->remove(block.memory);
+				}
+				// Unmapped implicitly, the slot is reused by the next block of the pool
+				vkFreeMemory(device, block.memory, nullptr);
+				block = Block();
+				released++;
+			}
+		}
+		return released;
+	}
+
+	/** @brief Get the usage of all allocated blocks */
+	std::vector<MemoryBlockUsage> MemoryAllocator::getBlockUsage()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		std::vector<MemoryBlockUsage> usage;
+		for (uint32_t poolIndex = 0; poolIndex < pools.size(); poolIndex++)
+		{
+			const uint32_t memoryTypeIndex = poolIndex / 2;
+			for (uint32_t blockIndex = 0; blockIndex < pools[poolIndex].blocks.size(); blockIndex++)
+			{
+				const Block& block = pools[poolIndex].blocks[blockIndex];
+				if (block.memory == VK_NULL_HANDLE)
+				{
+					continue;
+				}
+				MemoryBlockUsage blockUsage;
+				blockUsage.poolIndex = poolIndex;
+				blockUsage.blockIndex = blockIndex;
+				blockUsage.memoryTypeIndex = memoryTypeIndex;
+				blockUsage.size = block.size;
+				blockUsage.usedBytes = getUsedBytes(block);
+				blockUsage.allocationCount = block.allocationCount;
+				blockUsage.dedicated = block.dedicated;
+				blockUsage.hostVisible = (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+				usage.push_back(blockUsage);
+			}
+		}
+		return usage;
+	}
+
+	/** @brief Gather usage and fragmentation statistics over all blocks */
+	MemoryStatistics MemoryAllocator::getStatistics()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		MemoryStatistics stats;
+		VkDeviceSize freeBytes = 0;
+		for (auto& pool : pools)
+		{
+			for (auto& block : pool.blocks)
+			{
+				if (block.memory == VK_NULL_HANDLE)
+				{
+					continue;
+				}
+				stats.blockCount++;
+				stats.allocationCount += block.allocationCount;
+				stats.blockBytes += block.size;
+				stats.freeRangeCount += static_cast<uint32_t>(block.freeRanges.size());
+				for (auto& range : block.freeRanges)
+				{
+					freeBytes += range.second;
+					stats.largestFreeRange = std::max(stats.largestFreeRange, range.second);
+				}
+			}
+		}
+		stats.usedBytes = stats.blockBytes - freeBytes;
+		stats.fragmentation = (freeBytes > 0) ? 1.0 - (double)stats.largestFreeRange / (double)freeBytes : 0.0;
+		return stats;
+	}
+
+	/** @brief Print the allocator statistics to the console */
+	void MemoryAllocator::printStatistics()
+	{
+		MemoryStatistics stats = getStatistics();
+		const double MiB = 1024.0 * 1024.0;
+		std::cout << "Memory allocator: " << stats.allocationCount << " allocation(s) in " << stats.blockCount << " block(s), "
+			<< (double)stats.usedBytes / MiB << " of " << (double)stats.blockBytes / MiB << " MiB used, "
+			<< stats.freeRangeCount << " free range(s), largest " << (double)stats.largestFreeRange / MiB << " MiB, fragmentation " << stats.fragmentation * 100.0 << "%\n";
+	}
+}
@@ -0,0 +1,114 @@
+/*
+* Vulkan device memory sub-allocator
+*
+* Hands out aligned ranges from large VkDeviceMemory blocks instead of doing one allocation per resource
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <mutex>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanMemoryTracker.h"
+
+namespace vks
+{
+	/** @brief Range of device memory handed out by the memory allocator */
+	struct MemoryAllocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		/** @brief Host address of the start of the allocation if the memory is host visible (blocks are persistently mapped), nullptr otherwise */
+		void* mapped = nullptr;
+		uint32_t memoryTypeIndex = 0;
+		/** @brief Internal block reference, only valid if memory is set */
+		uint32_t poolIndex = 0;
+		uint32_t blockIndex = 0;
+	};
+
+	/** @brief Usage and fragmentation of the memory allocator's blocks */
+	struct MemoryStatistics
+	{
+		uint32_t blockCount = 0;
+		uint32_t allocationCount = 0;
+		uint32_t freeRangeCount = 0;
+		/** @brief Size of all device memory blocks */
+		VkDeviceSize blockBytes = 0;
+		/** @brief Size of all ranges handed out to resources */
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize largestFreeRange = 0;
+		/** @brief 0.0 if all free memory is in a single range, approaching 1.0 the more the free memory is split up into small ranges */
+		double fragmentation = 0.0;
+	};
+
+	/** @brief Usage of a single device memory block of the memory allocator, see MemoryAllocator::getBlockUsage() */
+	struct MemoryBlockUsage
+	{
+		uint32_t poolIndex = 0;
+		uint32_t blockIndex = 0;
+		uint32_t memoryTypeIndex = 0;
+		VkDeviceSize size = 0;
+		VkDeviceSize usedBytes = 0;
+		uint32_t allocationCount = 0;
+		bool dedicated = false;
+		bool hostVisible = false;
+	};
+
+	/**
+	* Block based device memory sub-allocator
+	*
+	* Keeps a pool of blocks per memory type, each block manages its free ranges in an offset ordered free list (best fit with coalescing on free)
+	* Linear (buffers, linear images) and optimal tiling resources are placed in separate pools so bufferImageGranularity never applies
+	* Resources larger than half the block size get a block of their own that is released as soon as the resource is freed
+	* Regular blocks that became empty are kept until releaseEmptyBlocks() is called (see vks::MemoryDefragmenter)
+	*
+	* @note Allocation and freeing are internally synchronized
+	*/
+	class MemoryAllocator
+	{
+	private:
+		struct Block
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			void* mapped = nullptr;
+			bool dedicated = false;
+			uint32_t allocationCount = 0;
+			// Free ranges (offset, size), adjacent ranges are always merged
+			std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+		};
+		struct Pool
+		{
+			std::vector<Block> blocks;
+		};
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		VkDeviceSize nonCoherentAtomSize = 1;
+		// Two pools per memory type: linear resources at 2n, optimal tiling images at 2n+1
+		std::vector<Pool> pools;
+		std::mutex lock;
+		VkResult createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated, Block& block);
+		bool allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+		VkDeviceSize getUsedBytes(const Block& block) const;
+	public:
+		/** @brief Default size of a device memory block in bytes, smaller heaps use an eighth of the heap size instead */
+		VkDeviceSize preferredBlockSize = 64 * 1024 * 1024;
+		/** @brief Optional tracker the device memory blocks are registered with (as buffers for linear and images for optimal tiling pools) */
+		vks::MemoryTracker* tracker = nullptr;
+
+		MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice);
+		~MemoryAllocator();
+		VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+		VkResult allocate(const VkMemoryRequirements& memoryRequirements, uint32_t memoryTypeIndex, bool linear, MemoryAllocation* allocation, uint32_t excludedBlockIndex = UINT32_MAX);
+		void free(MemoryAllocation& allocation);
+		uint32_t releaseEmptyBlocks(uint32_t sparePerPool = 1);
+		std::vector<MemoryBlockUsage> getBlockUsage();
+		MemoryStatistics getStatistics();
+		void printStatistics();
+	};
+}
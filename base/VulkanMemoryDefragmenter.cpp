@@ -0,0 +1,450 @@
+/*
+* Incremental device memory defragmentation
+*
+* Moves resources out of sparsely used blocks of the memory allocator with GPU copies within a per-frame time budget, so the emptied blocks
+* can be released and the memory used by long running sessions that keep loading and releasing assets stays flat
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMemoryDefragmenter.h"
+#include "VulkanDevice.h"
+#include "VulkanTexture.h"
+#include <algorithm>
+#include <chrono>
+
+namespace vks
+{
+	/**
+	* @param device Device whose memory allocator the resources have been sub-allocated from (has to be enabled)
+	* @param queue Queue the copies are submitted to, the examples' graphics queue so the copies are ordered with the frames
+	*/
+	MemoryDefragmenter::MemoryDefragmenter(vks::VulkanDevice* device, VkQueue queue) : device(device), queue(queue)
+	{
+		assert(device->memoryAllocator);
+		commandPool = device->createCommandPool(device->queueFamilyIndices.graphics);
+		commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool);
+		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
+		VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceCreateInfo, nullptr, &fence));
+	}
+
+	/** @brief Waits for copies still in flight and destroys their resources, the registered resources stay where they are */
+	MemoryDefragmenter::~MemoryDefragmenter()
+	{
+		if (copiesInFlight)
+		{
+			VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &fence, VK_TRUE, UINT64_MAX));
+		}
+		for (const Move& move : moves)
+		{
+			destroyMove(move);
+		}
+		vkDestroyFence(device->logicalDevice, fence, nullptr);
+		vkDestroyCommandPool(device->logicalDevice, commandPool, nullptr);
+	}
+
+	/**
+	* Register a buffer that may be moved
+	*
+	* @param buffer Buffer created by vks::VulkanDevice::createBuffer, has to stay valid until it is unregistered
+	* @param moved (Optional) Called by finishMoves() after the buffer's handles and descriptor have been replaced
+	*
+	* @return Handle to unregister the buffer with, 0 if the buffer can't be moved (own memory, host visible, device address or no transfer source usage)
+	*/
+	uint32_t MemoryDefragmenter::registerBuffer(vks::Buffer* buffer, std::function<void()> moved)
+	{
+		if ((buffer->allocator != device->memoryAllocator) || (buffer->allocation.memory == VK_NULL_HANDLE) || !(buffer->usageFlags & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) ||
+			(buffer->usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) || (buffer->memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+		{
+			return 0;
+		}
+		Resource resource;
+		resource.buffer = buffer;
+		resource.moved = moved;
+		resources[nextHandle] = resource;
+		return nextHandle++;
+	}
+
+	/**
+	* Register an image that may be moved
+	*
+	* @param image Pointers to the image's handles and the create infos to create the copy with (copied without their pNext chains)
+	*
+	* @return Handle to unregister the image with, 0 if the image can't be moved (own memory, host visible, undefined layout or no transfer source usage)
+	*/
+	uint32_t MemoryDefragmenter::registerImage(const MovableImage& image)
+	{
+		assert(image.image && image.memory && image.allocation);
+		const VkMemoryPropertyFlags propertyFlags = device->memoryProperties.memoryTypes[image.allocation->memoryTypeIndex].propertyFlags;
+		if ((image.allocation->memory == VK_NULL_HANDLE) || !(image.imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) ||
+			(image.layout == VK_IMAGE_LAYOUT_UNDEFINED) || (propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+		{
+			return 0;
+		}
+		Resource resource;
+		resource.image = image;
+		resource.image.imageCreateInfo.pNext = nullptr;
+		resource.image.imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		resource.image.viewCreateInfo.pNext = nullptr;
+		resource.moved = image.moved;
+		resources[nextHandle] = resource;
+		return nextHandle++;
+	}
+
+	/**
+	* Register a texture that may be moved, its descriptor is updated when it has been moved
+	*
+	* @param texture Texture loaded with the memory allocator enabled, has to stay valid until it is unregistered
+	* @param imageCreateInfo Create info the texture's image has been created with
+	* @param viewCreateInfo Create info the texture's view has been created with
+	* @param moved (Optional) Called by finishMoves() after the texture's handles and descriptor have been replaced
+	*/
+	uint32_t MemoryDefragmenter::registerTexture(vks::Texture* texture, const VkImageCreateInfo& imageCreateInfo, const VkImageViewCreateInfo& viewCreateInfo, std::function<void()> moved)
+	{
+		MovableImage image;
+		image.image = &texture->image;
+		image.view = &texture->view;
+		image.memory = &texture->deviceMemory;
+		image.allocation = &texture->allocation;
+		image.layout = texture->imageLayout;
+		image.imageCreateInfo = imageCreateInfo;
+		image.viewCreateInfo = viewCreateInfo;
+		image.moved = [texture, moved]() {
+			texture->updateDescriptor();
+			if (moved)
+			{
+				moved();
+			}
+		};
+		return registerImage(image);
+	}
+
+	/** @brief Remove a resource before it is destroyed, waits for its copy if one is in flight */
+	void MemoryDefragmenter::unregister(uint32_t handle)
+	{
+		auto resource = resources.find(handle);
+		if (resource == resources.end())
+		{
+			return;
+		}
+		for (Move& move : moves)
+		{
+			if ((move.handle == handle) && !move.cancelled)
+			{
+				// The copy still reads the resource the owner is about to destroy
+				VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &fence, VK_TRUE, UINT64_MAX));
+				move.cancelled = true;
+			}
+		}
+		resources.erase(resource);
+	}
+
+	// Least used block that can be emptied: device local, all allocations registered and enough room for them in the other blocks of its pool
+	bool MemoryDefragmenter::findBlock(MemoryBlockUsage& block)
+	{
+		const std::vector<MemoryBlockUsage> blocks = device->memoryAllocator->getBlockUsage();
+		std::map<std::pair<uint32_t, uint32_t>, uint32_t> registeredAllocations;
+		for (auto& entry : resources)
+		{
+			const vks::MemoryAllocation* allocation = entry.second.buffer ? &entry.second.buffer->allocation : entry.second.image.allocation;
+			if (allocation->memory != VK_NULL_HANDLE)
+			{
+				registeredAllocations[{ allocation->poolIndex, allocation->blockIndex }]++;
+			}
+		}
+		std::map<uint32_t, VkDeviceSize> poolFreeBytes;
+		for (const MemoryBlockUsage& usage : blocks)
+		{
+			if (!usage.dedicated)
+			{
+				poolFreeBytes[usage.poolIndex] += usage.size - usage.usedBytes;
+			}
+		}
+
+		float lowestUsage = settings.maxBlockUsage;
+		bool found = false;
+		for (const MemoryBlockUsage& usage : blocks)
+		{
+			if (usage.dedicated || usage.hostVisible || (usage.allocationCount == 0) || (registeredAllocations[{ usage.poolIndex, usage.blockIndex }] != usage.allocationCount))
+			{
+				continue;
+			}
+			const float blockUsage = static_cast<float>(usage.usedBytes) / static_cast<float>(usage.size);
+			const VkDeviceSize otherFreeBytes = poolFreeBytes[usage.poolIndex] - (usage.size - usage.usedBytes);
+			if ((blockUsage <= lowestUsage) && (otherFreeBytes >= usage.usedBytes))
+			{
+				lowestUsage = blockUsage;
+				block = usage;
+				found = true;
+			}
+		}
+		return found;
+	}
+
+	bool MemoryDefragmenter::moveBuffer(uint32_t handle, Resource& resource, uint32_t excludedBlockIndex, Move& move)
+	{
+		vks::Buffer* buffer = resource.buffer;
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(buffer->usageFlags, buffer->size);
+		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &move.buffer));
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(device->logicalDevice, move.buffer, &memReqs);
+		assert(memReqs.memoryTypeBits & (1 << buffer->allocation.memoryTypeIndex));
+		if (device->memoryAllocator->allocate(memReqs, buffer->allocation.memoryTypeIndex, true, &move.allocation, excludedBlockIndex) != VK_SUCCESS)
+		{
+			vkDestroyBuffer(device->logicalDevice, move.buffer, nullptr);
+			return false;
+		}
+		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, move.buffer, move.allocation.memory, move.allocation.offset));
+		VkBufferCopy copyRegion{ 0, 0, buffer->size };
+		vkCmdCopyBuffer(commandBuffer, buffer->buffer, move.buffer, 1, &copyRegion);
+		move.handle = handle;
+		return true;
+	}
+
+	bool MemoryDefragmenter::moveImage(uint32_t handle, Resource& resource, uint32_t excludedBlockIndex, Move& move)
+	{
+		const MovableImage& image = resource.image;
+		const VkImageCreateInfo& imageCreateInfo = image.imageCreateInfo;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &move.image));
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, move.image, &memReqs);
+		assert(memReqs.memoryTypeBits & (1 << image.allocation->memoryTypeIndex));
+		const bool linear = (image.allocation->poolIndex % 2) == 0;
+		if (device->memoryAllocator->allocate(memReqs, image.allocation->memoryTypeIndex, linear, &move.allocation, excludedBlockIndex) != VK_SUCCESS)
+		{
+			vkDestroyImage(device->logicalDevice, move.image, nullptr);
+			return false;
+		}
+		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, move.image, move.allocation.memory, move.allocation.offset));
+		if (image.view)
+		{
+			VkImageViewCreateInfo viewCreateInfo = image.viewCreateInfo;
+			viewCreateInfo.image = move.image;
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &move.view));
+		}
+
+		VkImageAspectFlags aspectMask = image.view ? image.viewCreateInfo.subresourceRange.aspectMask : static_cast<VkImageAspectFlags>(VK_IMAGE_ASPECT_COLOR_BIT);
+		// Views of depth stencil images may only cover the depth aspect, the copy needs both
+		if ((aspectMask & VK_IMAGE_ASPECT_DEPTH_BIT) && vks::tools::formatHasStencil(imageCreateInfo.format))
+		{
+			aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		const VkImageSubresourceRange subresourceRange = { aspectMask, 0, imageCreateInfo.mipLevels, 0, imageCreateInfo.arrayLayers };
+		std::vector<VkImageCopy> copyRegions(imageCreateInfo.mipLevels);
+		for (uint32_t level = 0; level < imageCreateInfo.mipLevels; level++)
+		{
+			VkImageCopy& copyRegion = copyRegions[level];
+			copyRegion.srcSubresource = { aspectMask, level, 0, imageCreateInfo.arrayLayers };
+			copyRegion.dstSubresource = copyRegion.srcSubresource;
+			copyRegion.extent.width = std::max(1u, imageCreateInfo.extent.width >> level);
+			copyRegion.extent.height = std::max(1u, imageCreateInfo.extent.height >> level);
+			copyRegion.extent.depth = std::max(1u, imageCreateInfo.extent.depth >> level);
+		}
+		vks::tools::setImageLayout(commandBuffer, *image.image, image.layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresourceRange);
+		vks::tools::setImageLayout(commandBuffer, move.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		vkCmdCopyImage(commandBuffer, *image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, move.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+		vks::tools::setImageLayout(commandBuffer, *image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image.layout, subresourceRange);
+		vks::tools::setImageLayout(commandBuffer, move.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, image.layout, subresourceRange);
+		move.handle = handle;
+		return true;
+	}
+
+	// Destroys the copy of a move that hasn't been swapped in
+	void MemoryDefragmenter::destroyMove(const Move& move)
+	{
+		vks::MemoryAllocation allocation = move.allocation;
+		if (move.view != VK_NULL_HANDLE)
+		{
+			vkDestroyImageView(device->logicalDevice, move.view, nullptr);
+		}
+		if (move.image != VK_NULL_HANDLE)
+		{
+			vkDestroyImage(device->logicalDevice, move.image, nullptr);
+		}
+		if (move.buffer != VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(device->logicalDevice, move.buffer, nullptr);
+		}
+		device->memoryAllocator->free(allocation);
+	}
+
+	/**
+	* Release the emptied blocks and submit the copies of the next resources to move
+	*
+	* @note Does nothing while the copies of the previous step are in flight, call finishMoves() once hasCompletedMoves() returns true
+	*/
+	void MemoryDefragmenter::step()
+	{
+		if (copiesInFlight)
+		{
+			return;
+		}
+		const auto tStart = std::chrono::high_resolution_clock::now();
+		statistics.blocksReleased += device->memoryAllocator->releaseEmptyBlocks();
+
+		MemoryBlockUsage block;
+		if (resources.empty() || !findBlock(block))
+		{
+			statistics.idleSteps++;
+			return;
+		}
+
+		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+		// Buffers have no layout transitions, a global barrier makes the writes of earlier submissions available to the copies
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		VkDeviceSize bytes = 0;
+		for (auto& entry : resources)
+		{
+			Resource& resource = entry.second;
+			const vks::MemoryAllocation& allocation = resource.buffer ? resource.buffer->allocation : *resource.image.allocation;
+			if ((allocation.memory == VK_NULL_HANDLE) || (allocation.poolIndex != block.poolIndex) || (allocation.blockIndex != block.blockIndex))
+			{
+				continue;
+			}
+			// At least one resource is moved per step, however large it is
+			const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			if (!moves.empty() && ((bytes + allocation.size > settings.maxBytesPerStep) || (elapsed > settings.stepBudget)))
+			{
+				break;
+			}
+			const VkDeviceSize size = allocation.size;
+			Move move;
+			if (!(resource.buffer ? moveBuffer(entry.first, resource, block.blockIndex, move) : moveImage(entry.first, resource, block.blockIndex, move)))
+			{
+				// The other blocks are too fragmented for the resource
+				break;
+			}
+			moves.push_back(move);
+			bytes += size;
+		}
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+		if (moves.empty())
+		{
+			statistics.idleSteps++;
+			return;
+		}
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		VK_CHECK_RESULT(device->queueSubmit(queue, 1, &submitInfo, fence));
+		copiesInFlight = true;
+	}
+
+	/** @brief True if the copies submitted by the last step have finished, finishMoves() then won't block */
+	bool MemoryDefragmenter::hasCompletedMoves() const
+	{
+		return copiesInFlight && (vkGetFenceStatus(device->logicalDevice, fence) == VK_SUCCESS);
+	}
+
+	/**
+	* Replace the handles of the moved resources with their copies and call their callbacks, waits for the copies if they haven't finished
+	*
+	* @note Command buffers and descriptor sets referencing the moved resources have to be rebuilt or rewritten afterwards (see the moved callbacks),
+	* the old resources are released through the device's deferred destruction once the frames that may use them have finished
+	*/
+	void MemoryDefragmenter::finishMoves()
+	{
+		if (!copiesInFlight)
+		{
+			return;
+		}
+		VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &fence, VK_TRUE, UINT64_MAX));
+		VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &fence));
+		copiesInFlight = false;
+
+		VkDevice logicalDevice = device->logicalDevice;
+		vks::MemoryAllocator* allocator = device->memoryAllocator;
+		std::vector<std::function<void()>> callbacks;
+		for (const Move& move : moves)
+		{
+			if (move.cancelled)
+			{
+				destroyMove(move);
+				continue;
+			}
+			Resource& resource = resources[move.handle];
+			vks::MemoryAllocation oldAllocation;
+			if (resource.buffer)
+			{
+				vks::Buffer* buffer = resource.buffer;
+				const VkBuffer oldBuffer = buffer->buffer;
+				oldAllocation = buffer->allocation;
+				buffer->buffer = move.buffer;
+				buffer->memory = move.allocation.memory;
+				buffer->allocation = move.allocation;
+				buffer->descriptor.buffer = move.buffer;
+				device->deferDestruction([logicalDevice, allocator, oldBuffer, oldAllocation]() mutable {
+					vkDestroyBuffer(logicalDevice, oldBuffer, nullptr);
+					allocator->free(oldAllocation);
+				});
+			}
+			else
+			{
+				MovableImage& image = resource.image;
+				const VkImage oldImage = *image.image;
+				const VkImageView oldView = image.view ? *image.view : VK_NULL_HANDLE;
+				oldAllocation = *image.allocation;
+				*image.image = move.image;
+				if (image.view)
+				{
+					*image.view = move.view;
+				}
+				*image.memory = move.allocation.memory;
+				*image.allocation = move.allocation;
+				device->deferDestruction([logicalDevice, allocator, oldImage, oldView, oldAllocation]() mutable {
+					if (oldView != VK_NULL_HANDLE)
+					{
+						vkDestroyImageView(logicalDevice, oldView, nullptr);
+					}
+					vkDestroyImage(logicalDevice, oldImage, nullptr);
+					allocator->free(oldAllocation);
+				});
+			}
+			statistics.moves++;
+			statistics.bytesMoved += oldAllocation.size;
+			if (resource.moved)
+			{
+				callbacks.push_back(resource.moved);
+			}
+		}
+		moves.clear();
+		// Called once all handles have been replaced, as callbacks may write descriptors of several moved resources
+		for (auto& callback : callbacks)
+		{
+			callback();
+		}
+	}
+
+	void MemoryDefragmenter::setSettings(const Settings& settings)
+	{
+		this->settings = settings;
+	}
+
+	const MemoryDefragmenter::Settings& MemoryDefragmenter::getSettings() const
+	{
+		return settings;
+	}
+
+	const MemoryDefragmenter::Statistics& MemoryDefragmenter::getStatistics() const
+	{
+		return statistics;
+	}
+
+	/** @brief Print the number of moves and released blocks to the console */
+	void MemoryDefragmenter::printStatistics() const
+	{
+		const double MiB = 1024.0 * 1024.0;
+		std::cout << "Memory defragmenter: " << statistics.moves << " move(s), " << (double)statistics.bytesMoved / MiB << " MiB moved, "
+			<< statistics.blocksReleased << " block(s) released, " << resources.size() << " movable resource(s)\n";
+	}
+}
@@ -0,0 +1,135 @@
+/*
+* Incremental device memory defragmentation
+*
+* Moves resources out of sparsely used blocks of the memory allocator with GPU copies within a per-frame time budget, so the emptied blocks
+* can be released and the memory used by long running sessions that keep loading and releasing assets stays flat
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+#include "VulkanMemoryAllocator.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+	class Texture;
+
+	/**
+	* Defragmenter for the buffers and images sub-allocated by the device's memory allocator
+	*
+	* Usage:
+	*	vks::MemoryDefragmenter defragmenter(vulkanDevice, queue);
+	*	uint32_t handle = defragmenter.registerBuffer(&vertexBuffer);
+	*	uint32_t textureHandle = defragmenter.registerTexture(&texture, imageCreateInfo, viewCreateInfo, [&]() { updateDescriptorSets(); });
+	*	// Once per frame, outside of command buffer recording
+	*	if (defragmenter.hasCompletedMoves()) {
+	*		// Wait for the frames in flight, which may still use the old resources
+	*		defragmenter.finishMoves();
+	*		buildCommandBuffers();
+	*	}
+	*	defragmenter.step();
+	*	// Before destroying a registered resource
+	*	defragmenter.unregister(handle);
+	*
+	* Resources are registered with pointers to the handles their owner uses, a move replaces these in place. step() picks the least used
+	* device local block whose allocations all belong to registered resources, creates a copy of these resources in the other blocks of the
+	* pool (fullest first) and submits the copies. Each step spends at most Settings::stepBudget milliseconds of CPU time and copies at most
+	* Settings::maxBytesPerStep bytes, a block may take several steps to be emptied. Once the copies have finished, finishMoves() swaps the
+	* handles, calls the resources' callbacks (to rewrite descriptor sets that reference them) and releases the old resources through the
+	* device's deferred destruction. Emptied blocks are released at the next step.
+	*
+	* @note Registered resources must not be written by the GPU after they've been uploaded, writes between step() and finishMoves() would be lost
+	* @note Host visible memory (mapped by its users), dedicated blocks and buffers with device addresses are never moved
+	* @note Buffers need VK_BUFFER_USAGE_TRANSFER_SRC_BIT and images VK_IMAGE_USAGE_TRANSFER_SRC_BIT, the copies are created with the same usage
+	*/
+	class MemoryDefragmenter
+	{
+	public:
+		struct Settings {
+			// CPU time in milliseconds a step may spend creating resources and recording copies
+			float stepBudget = 0.5f;
+			// Upper limit of the bytes copied per step, limits the GPU time of a step
+			VkDeviceSize maxBytesPerStep = 16 * 1024 * 1024;
+			// Blocks using more than this fraction of their size aren't emptied
+			float maxBlockUsage = 0.5f;
+		};
+
+		struct Statistics {
+			uint64_t moves = 0;
+			VkDeviceSize bytesMoved = 0;
+			uint32_t blocksReleased = 0;
+			// Steps that found no block to empty, or no room for its resources in the other blocks
+			uint64_t idleSteps = 0;
+		};
+
+		/** @brief Image registered with registerImage(), the pointers have to stay valid until the image is unregistered */
+		struct MovableImage {
+			VkImage* image = nullptr;
+			VkImageView* view = nullptr;
+			VkDeviceMemory* memory = nullptr;
+			vks::MemoryAllocation* allocation = nullptr;
+			// Layout the image is in between frames, copies transition it from and back to this layout
+			VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			// Create info of the image, the copy is created with it
+			VkImageCreateInfo imageCreateInfo{};
+			// Create info of the view, its image is replaced with the copy (optional, the view isn't recreated if view is nullptr)
+			VkImageViewCreateInfo viewCreateInfo{};
+			// Called by finishMoves() after the handles have been replaced, e.g. to update descriptor sets
+			std::function<void()> moved;
+		};
+
+	private:
+		struct Resource {
+			vks::Buffer* buffer = nullptr;
+			MovableImage image;
+			std::function<void()> moved;
+		};
+		struct Move {
+			uint32_t handle;
+			// Set if the resource has been unregistered while its copy was in flight
+			bool cancelled = false;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			vks::MemoryAllocation allocation{};
+		};
+		vks::VulkanDevice* device;
+		VkQueue queue;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		std::map<uint32_t, Resource> resources;
+		uint32_t nextHandle = 1;
+		// Moves of the submitted copies, only one step is in flight at a time
+		std::vector<Move> moves;
+		bool copiesInFlight = false;
+		Settings settings;
+		Statistics statistics;
+		bool findBlock(MemoryBlockUsage& block);
+		bool moveBuffer(uint32_t handle, Resource& resource, uint32_t excludedBlockIndex, Move& move);
+		bool moveImage(uint32_t handle, Resource& resource, uint32_t excludedBlockIndex, Move& move);
+		void destroyMove(const Move& move);
+	public:
+		MemoryDefragmenter(vks::VulkanDevice* device, VkQueue queue);
+		~MemoryDefragmenter();
+		uint32_t registerBuffer(vks::Buffer* buffer, std::function<void()> moved = nullptr);
+		uint32_t registerImage(const MovableImage& image);
+		uint32_t registerTexture(vks::Texture* texture, const VkImageCreateInfo& imageCreateInfo, const VkImageViewCreateInfo& viewCreateInfo, std::function<void()> moved = nullptr);
+		void unregister(uint32_t handle);
+		void step();
+		bool hasCompletedMoves() const;
+		void finishMoves();
+		void setSettings(const Settings& settings);
+		const Settings& getSettings() const;
+		const Statistics& getStatistics() const;
+		void printStatistics() const;
+	};
+}
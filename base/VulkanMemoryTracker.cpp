@@ -0,0 +1,170 @@
+/*
+* Device memory usage tracking
+*
+* Keeps track of the device memory objects allocated by the framework per category and reads the heap budgets reported by VK_EXT_memory_budget
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMemoryTracker.h"
+#include <algorithm>
+#include <iostream>
+
+namespace vks
+{
+	void MemoryTracker::init(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceMemoryProperties &memoryProperties)
+	{
+		this->physicalDevice = physicalDevice;
+		this->memoryProperties = memoryProperties;
+	}
+
+	/** @brief Register a device memory object of the given memory type */
+	void MemoryTracker::add(VkDeviceMemory memory, MemoryCategory category, VkDeviceSize size, uint32_t memoryTypeIndex)
+	{
+		if (memory == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> guard(lock);
+		Allocation allocation = { category, size, memoryProperties.memoryTypes[memoryTypeIndex].heapIndex };
+		allocations[memory] = allocation;
+		categoryBytes[static_cast<uint32_t>(category)] += size;
+		categoryCounts[static_cast<uint32_t>(category)]++;
+		totalBytes += size;
+		peakBytes = std::max(peakBytes, totalBytes);
+	}
+
+	/** @brief Unregister a device memory object before it's freed, memory that isn't tracked is ignored */
+	void MemoryTracker::remove(VkDeviceMemory memory)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto it = allocations.find(memory);
+		if (it == allocations.end())
+		{
+			return;
+		}
+		categoryBytes[static_cast<uint32_t>(it->second.category)] -= it->second.size;
+		categoryCounts[static_cast<uint32_t>(it->second.category)]--;
+		totalBytes -= it->second.size;
+		allocations.erase(it);
+	}
+
+	VkDeviceSize MemoryTracker::getBytes(MemoryCategory category)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return categoryBytes[static_cast<uint32_t>(category)];
+	}
+
+	uint32_t MemoryTracker::getCount(MemoryCategory category)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return categoryCounts[static_cast<uint32_t>(category)];
+	}
+
+	VkDeviceSize MemoryTracker::getTotalBytes()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return totalBytes;
+	}
+
+	/** @brief Highest number of tracked bytes allocated at the same time */
+	VkDeviceSize MemoryTracker::getPeakBytes()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return peakBytes;
+	}
+
+	uint32_t MemoryTracker::getAllocationCount()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return static_cast<uint32_t>(allocations.size());
+	}
+
+	bool MemoryTracker::budgetSupported() const
+	{
+		return vkGetPhysicalDeviceMemoryProperties2KHR != nullptr;
+	}
+
+	/**
+	* Get the tracked size and (if supported) the driver reported usage and budget of all memory heaps
+	*
+	* @note The budget is queried from the driver on every call, don't call this more than once per frame
+	*/
+	std::vector<MemoryHeapUsage> MemoryTracker::getHeapUsage()
+	{
+		std::vector<MemoryHeapUsage> heaps(memoryProperties.memoryHeapCount);
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+		{
+			heaps[i].size = memoryProperties.memoryHeaps[i].size;
+			heaps[i].deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		}
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			for (auto &allocation : allocations)
+			{
+				heaps[allocation.second.heapIndex].tracked += allocation.second.size;
+			}
+		}
+		if (budgetSupported())
+		{
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+			budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+			VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+			memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+			memoryProperties2.pNext = &budgetProperties;
+			vkGetPhysicalDeviceMemoryProperties2KHR(physicalDevice, &memoryProperties2);
+			for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+			{
+				heaps[i].usage = budgetProperties.heapUsage[i];
+				heaps[i].budget = budgetProperties.heapBudget[i];
+			}
+		}
+		return heaps;
+	}
+
+	const char *MemoryTracker::categoryName(MemoryCategory category)
+	{
+		switch (category)
+		{
+		case MemoryCategory::Buffer:
+			return "buffers";
+		case MemoryCategory::Image:
+			return "images";
+		case MemoryCategory::Staging:
+			return "staging";
+		case MemoryCategory::AccelerationStructure:
+			return "acceleration structures";
+		default:
+			return "other";
+		}
+	}
+
+	/** @brief Print the tracked memory per category and the usage of all heaps to the console, heaps used beyond their budget are flagged */
+	void MemoryTracker::printStatistics()
+	{
+		const double MiB = 1024.0 * 1024.0;
+		std::cout << "Device memory: " << getAllocationCount() << " tracked allocation(s), " << (double)getTotalBytes() / MiB << " MiB (peak " << (double)getPeakBytes() / MiB << " MiB)\n";
+		for (uint32_t i = 0; i < memoryCategoryCount; i++)
+		{
+			const MemoryCategory category = static_cast<MemoryCategory>(i);
+			if (getCount(category) > 0)
+			{
+				std::cout << "\t" << categoryName(category) << ": " << (double)getBytes(category) / MiB << " MiB in " << getCount(category) << " allocation(s)\n";
+			}
+		}
+		std::vector<MemoryHeapUsage> heaps = getHeapUsage();
+		for (size_t i = 0; i < heaps.size(); i++)
+		{
+			std::cout << "\theap " << i << (heaps[i].deviceLocal ? " (device local)" : "") << ": " << (double)heaps[i].tracked / MiB << " MiB tracked";
+			if (budgetSupported())
+			{
+				std::cout << ", " << (double)heaps[i].usage / MiB << " of " << (double)heaps[i].budget / MiB << " MiB budget used";
+				if (heaps[i].usage > heaps[i].budget)
+				{
+					std::cout << " (over budget)";
+				}
+			}
+			std::cout << ", size " << (double)heaps[i].size / MiB << " MiB\n";
+		}
+	}
+}
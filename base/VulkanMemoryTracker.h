@@ -0,0 +1,83 @@
+/*
+* Device memory usage tracking
+*
+* Keeps track of the device memory objects allocated by the framework per category and reads the heap budgets reported by VK_EXT_memory_budget
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	enum class MemoryCategory : uint32_t
+	{
+		Buffer = 0,
+		Image = 1,
+		Staging = 2,
+		AccelerationStructure = 3,
+		Other = 4
+	};
+	const uint32_t memoryCategoryCount = 5;
+
+	/** @brief Usage of a memory heap, usage and budget are only valid if the memory budget extension is enabled */
+	struct MemoryHeapUsage
+	{
+		VkDeviceSize size = 0;
+		/** @brief Size of the tracked allocations on this heap */
+		VkDeviceSize tracked = 0;
+		/** @brief Memory used by the process on this heap as reported by the driver, including allocations that aren't tracked */
+		VkDeviceSize usage = 0;
+		/** @brief Estimate of the memory the process can use on this heap without causing paging */
+		VkDeviceSize budget = 0;
+		bool deviceLocal = false;
+	};
+
+	/**
+	* Tracks device memory objects by category
+	*
+	* Memory allocated by vks::VulkanDevice (buffers, images, memory allocator blocks) and the acceleration structures of the ray tracing base
+	* is registered automatically, memory allocated directly with vkAllocateMemory only shows up in the driver reported heap usage
+	*
+	* @note Adding and removing allocations is internally synchronized
+	*/
+	class MemoryTracker
+	{
+	private:
+		struct Allocation
+		{
+			MemoryCategory category;
+			VkDeviceSize size;
+			uint32_t heapIndex;
+		};
+		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+		std::mutex lock;
+		std::unordered_map<VkDeviceMemory, Allocation> allocations;
+		VkDeviceSize categoryBytes[memoryCategoryCount] = {};
+		uint32_t categoryCounts[memoryCategoryCount] = {};
+		VkDeviceSize totalBytes = 0;
+		VkDeviceSize peakBytes = 0;
+	public:
+		/** @brief Set if VK_EXT_memory_budget has been enabled, heap usage and budgets are read through this */
+		PFN_vkGetPhysicalDeviceMemoryProperties2KHR vkGetPhysicalDeviceMemoryProperties2KHR = nullptr;
+
+		void init(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceMemoryProperties &memoryProperties);
+		void add(VkDeviceMemory memory, MemoryCategory category, VkDeviceSize size, uint32_t memoryTypeIndex);
+		void remove(VkDeviceMemory memory);
+		VkDeviceSize getBytes(MemoryCategory category);
+		uint32_t getCount(MemoryCategory category);
+		VkDeviceSize getTotalBytes();
+		VkDeviceSize getPeakBytes();
+		uint32_t getAllocationCount();
+		bool budgetSupported() const;
+		std::vector<MemoryHeapUsage> getHeapUsage();
+		static const char *categoryName(MemoryCategory category);
+		void printStatistics();
+	};
+}
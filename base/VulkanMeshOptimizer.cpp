@@ -0,0 +1,810 @@
+/*
+* Mesh optimization
+*
+* Reorders the triangles of indexed triangle lists for the post-transform vertex cache and for less overdraw,
+* and the vertices for linear vertex fetch, and simplifies them for levels of detail, in the spirit of meshoptimizer (https://github.com/zeux/meshoptimizer)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMeshOptimizer.h"
+#include <algorithm>
+#include <unordered_map>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+namespace vks
+{
+	namespace meshoptimizer
+	{
+		// Vertex score of Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+		static float vertexScore(int32_t cachePosition, uint32_t remainingTriangles)
+		{
+			if (remainingTriangles == 0)
+			{
+				return -1.0f;
+			}
+			float score = 0.0f;
+			if (cachePosition >= 0)
+			{
+				// Vertices of the last triangle get a fixed score, so the next triangle doesn't always share an edge with it
+				if (cachePosition < 3)
+				{
+					score = 0.75f;
+				}
+				else
+				{
+					score = powf(1.0f - (float)(cachePosition - 3) / (float)(vertexCacheSize - 3), 1.5f);
+				}
+			}
+			// Vertices with few triangles left are preferred, so no lone triangles are left behind
+			score += 2.0f / sqrtf((float)remainingTriangles);
+			return score;
+		}
+
+		/**
+		* Reorder the triangles for the post-transform vertex cache
+		*
+		* Greedily emits the triangle with the highest score, the sum of the scores of its vertices that depend on their position in a simulated
+		* LRU cache and on how many of their triangles are left
+		*
+		* @param indices Triangle list to reorder in place, all indices must be lower than vertexCount
+		*/
+		void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+		{
+			const size_t triangleCount = indexCount / 3;
+			if (triangleCount < 2)
+			{
+				return;
+			}
+
+			// Triangles using each vertex, the first remainingTriangles[v] entries of a vertex are the triangles that haven't been emitted
+			std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+			for (size_t i = 0; i < triangleCount * 3; i++)
+			{
+				remainingTriangles[indices[i]]++;
+			}
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remainingTriangles[v];
+			}
+			std::vector<uint32_t> adjacency(triangleCount * 3);
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < triangleCount * 3; i++)
+			{
+				adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			std::vector<float> vertexScores(vertexCount);
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				vertexScores[v] = vertexScore(-1, remainingTriangles[v]);
+			}
+			std::vector<float> triangleScores(triangleCount);
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+			}
+
+			std::vector<bool> emitted(triangleCount, false);
+			std::vector<uint32_t> output;
+			output.reserve(triangleCount * 3);
+			std::vector<uint32_t> cache;
+			std::vector<uint32_t> newCache;
+			cache.reserve(vertexCacheSize + 3);
+			newCache.reserve(vertexCacheSize + 3);
+
+			uint32_t bestTriangle = static_cast<uint32_t>(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+			size_t cursor = 0;
+			for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+			{
+				if (bestTriangle == UINT32_MAX)
+				{
+					// No triangle using a cached vertex is left, continue with the next triangle in input order
+					while (emitted[cursor])
+					{
+						cursor++;
+					}
+					bestTriangle = static_cast<uint32_t>(cursor);
+				}
+				const uint32_t* triangle = &indices[bestTriangle * 3];
+				output.insert(output.end(), triangle, triangle + 3);
+				emitted[bestTriangle] = true;
+
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					const uint32_t v = triangle[k];
+					uint32_t* triangles = &adjacency[adjacencyOffsets[v]];
+					for (uint32_t i = 0; i < remainingTriangles[v]; i++)
+					{
+						if (triangles[i] == bestTriangle)
+						{
+							std::swap(triangles[i], triangles[remainingTriangles[v] - 1]);
+							remainingTriangles[v]--;
+							break;
+						}
+					}
+				}
+
+				// The triangle's vertices move to the front of the cache, the vertices moved beyond its size fall out
+				newCache.clear();
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					if (std::find(newCache.begin(), newCache.end(), triangle[k]) == newCache.end())
+					{
+						newCache.push_back(triangle[k]);
+					}
+				}
+				const size_t triangleVertexCount = newCache.size();
+				for (uint32_t v : cache)
+				{
+					if (std::find(newCache.begin(), newCache.begin() + triangleVertexCount, v) == newCache.begin() + triangleVertexCount)
+					{
+						newCache.push_back(v);
+					}
+				}
+				for (size_t i = 0; i < newCache.size(); i++)
+				{
+					const uint32_t v = newCache[i];
+					const int32_t position = (i < vertexCacheSize) ? static_cast<int32_t>(i) : -1;
+					const float score = vertexScore(position, remainingTriangles[v]);
+					const float delta = score - vertexScores[v];
+					vertexScores[v] = score;
+					for (uint32_t j = 0; j < remainingTriangles[v]; j++)
+					{
+						triangleScores[adjacency[adjacencyOffsets[v] + j]] += delta;
+					}
+				}
+				if (newCache.size() > vertexCacheSize)
+				{
+					newCache.resize(vertexCacheSize);
+				}
+				cache.swap(newCache);
+
+				bestTriangle = UINT32_MAX;
+				float bestScore = -1.0f;
+				for (uint32_t v : cache)
+				{
+					for (uint32_t j = 0; j < remainingTriangles[v]; j++)
+					{
+						const uint32_t t = adjacency[adjacencyOffsets[v] + j];
+						if (triangleScores[t] > bestScore)
+						{
+							bestScore = triangleScores[t];
+							bestTriangle = t;
+						}
+					}
+				}
+			}
+			std::copy(output.begin(), output.end(), indices);
+		}
+
+		/**
+		* Reorder clusters of triangles so those likely to occlude others come first
+		*
+		* The triangle list is split into clusters where the order jumps to a new part of the mesh (all vertices of a triangle miss the cache),
+		* so the vertex cache efficiency is mostly kept. Clusters facing away from the mesh center are drawn first, as they're the ones in front
+		* when seen from outside of the mesh.
+		*
+		* @note Run after optimizeVertexCache
+		* @param positions First position (three floats), positionStride bytes apart for each vertex
+		*/
+		void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount)
+		{
+			const size_t triangleCount = indexCount / 3;
+			if (triangleCount < 2)
+			{
+				return;
+			}
+			auto position = [positions, positionStride](uint32_t v) {
+				return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + v * positionStride);
+			};
+
+			const uint32_t cacheSize = 16;
+			std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+			uint32_t time = cacheSize + 1;
+			std::vector<uint32_t> clusterStarts;
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				uint32_t misses = 0;
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					const uint32_t v = indices[t * 3 + k];
+					if (time - cacheTimestamps[v] > cacheSize)
+					{
+						cacheTimestamps[v] = time++;
+						misses++;
+					}
+				}
+				if ((t == 0) || (misses == 3))
+				{
+					clusterStarts.push_back(static_cast<uint32_t>(t));
+				}
+			}
+			if (clusterStarts.size() < 2)
+			{
+				return;
+			}
+
+			struct Cluster
+			{
+				uint32_t firstTriangle;
+				uint32_t triangleCount;
+				float centroid[3];
+				float normal[3];
+				float sortKey;
+			};
+			std::vector<Cluster> clusters(clusterStarts.size());
+			float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+			float meshArea = 0.0f;
+			for (size_t c = 0; c < clusters.size(); c++)
+			{
+				Cluster& cluster = clusters[c];
+				cluster.firstTriangle = clusterStarts[c];
+				cluster.triangleCount = static_cast<uint32_t>(((c + 1 < clusterStarts.size()) ? clusterStarts[c + 1] : triangleCount) - clusterStarts[c]);
+				float area = 0.0f;
+				for (uint32_t i = 0; i < 3; i++)
+				{
+					cluster.centroid[i] = 0.0f;
+					cluster.normal[i] = 0.0f;
+				}
+				for (uint32_t t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; t++)
+				{
+					const float* p0 = position(indices[t * 3]);
+					const float* p1 = position(indices[t * 3 + 1]);
+					const float* p2 = position(indices[t * 3 + 2]);
+					const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+					const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+					// The cross product's length is twice the triangle's area, so the sum is an area weighted normal
+					const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+					const float triangleArea = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					for (uint32_t i = 0; i < 3; i++)
+					{
+						cluster.normal[i] += n[i];
+						cluster.centroid[i] += (p0[i] + p1[i] + p2[i]) * triangleArea / 3.0f;
+					}
+					area += triangleArea;
+				}
+				for (uint32_t i = 0; i < 3; i++)
+				{
+					meshCentroid[i] += cluster.centroid[i];
+					cluster.centroid[i] = (area > 0.0f) ? cluster.centroid[i] / area : 0.0f;
+				}
+				meshArea += area;
+			}
+			if (meshArea <= 0.0f)
+			{
+				return;
+			}
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				meshCentroid[i] /= meshArea;
+			}
+			for (Cluster& cluster : clusters)
+			{
+				const float length = sqrtf(cluster.normal[0] * cluster.normal[0] + cluster.normal[1] * cluster.normal[1] + cluster.normal[2] * cluster.normal[2]);
+				cluster.sortKey = 0.0f;
+				if (length > 0.0f)
+				{
+					for (uint32_t i = 0; i < 3; i++)
+					{
+						cluster.sortKey += (cluster.centroid[i] - meshCentroid[i]) * cluster.normal[i] / length;
+					}
+				}
+			}
+			std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+			std::vector<uint32_t> output;
+			output.reserve(triangleCount * 3);
+			for (const Cluster& cluster : clusters)
+			{
+				output.insert(output.end(), indices + cluster.firstTriangle * 3, indices + (cluster.firstTriangle + cluster.triangleCount) * 3);
+			}
+			std::copy(output.begin(), output.end(), indices);
+		}
+
+		/**
+		* Renumber the vertices in the order they're first used by the indices, so vertex fetch reads memory (mostly) linearly
+		*
+		* @param indices Indices to rewrite in place
+		* @return Table with the new index of each vertex, vertices that aren't used are moved to the end
+		*/
+		std::vector<uint32_t> optimizeVertexFetchRemap(uint32_t* indices, size_t indexCount, size_t vertexCount)
+		{
+			std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+			uint32_t nextVertex = 0;
+			for (size_t i = 0; i < indexCount; i++)
+			{
+				uint32_t& newIndex = remap[indices[i]];
+				if (newIndex == UINT32_MAX)
+				{
+					newIndex = nextVertex++;
+				}
+				indices[i] = newIndex;
+			}
+			for (uint32_t& newIndex : remap)
+			{
+				if (newIndex == UINT32_MAX)
+				{
+					newIndex = nextVertex++;
+				}
+			}
+			return remap;
+		}
+
+		/** @brief Average number of vertices transformed per triangle with a FIFO post-transform cache of the given size (between 0.5 and 3) */
+		float averageCacheMissRatio(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+		{
+			const size_t triangleCount = indexCount / 3;
+			if (triangleCount == 0)
+			{
+				return 0.0f;
+			}
+			std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+			uint32_t time = cacheSize + 1;
+			size_t misses = 0;
+			for (size_t i = 0; i < triangleCount * 3; i++)
+			{
+				if (time - cacheTimestamps[indices[i]] > cacheSize)
+				{
+					cacheTimestamps[indices[i]] = time++;
+					misses++;
+				}
+			}
+			return (float)misses / (float)triangleCount;
+		}
+
+		static void triangleNormal(const float* p0, const float* p1, const float* p2, double* n)
+		{
+			const double e1[3] = { (double)p1[0] - p0[0], (double)p1[1] - p0[1], (double)p1[2] - p0[2] };
+			const double e2[3] = { (double)p2[0] - p0[0], (double)p2[1] - p0[1], (double)p2[2] - p0[2] };
+			n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+			n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+			n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		}
+
+		// Bounding sphere (Ritter's approximation) and normal cone of a finished meshlet
+		static void computeMeshletBounds(Meshlet& meshlet, const std::vector<uint32_t>& meshletVertices, const std::vector<uint8_t>& meshletTriangles, const float* positions, size_t positionStride)
+		{
+			auto position = [&](uint32_t localVertex) {
+				return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + meshletVertices[meshlet.vertexOffset + localVertex] * positionStride);
+			};
+			auto distance2 = [](const float* a, const float* b) {
+				return (a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]);
+			};
+			// Start with the two vertices furthest apart along a pass from the first vertex, then grow the sphere to contain all vertices
+			const float* first = position(0);
+			const float* a = first;
+			for (uint32_t i = 1; i < meshlet.vertexCount; i++)
+			{
+				if (distance2(position(i), first) > distance2(a, first))
+				{
+					a = position(i);
+				}
+			}
+			const float* b = a;
+			for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+			{
+				if (distance2(position(i), a) > distance2(b, a))
+				{
+					b = position(i);
+				}
+			}
+			float center[3] = { (a[0] + b[0]) * 0.5f, (a[1] + b[1]) * 0.5f, (a[2] + b[2]) * 0.5f };
+			float radius = sqrtf(distance2(a, b)) * 0.5f;
+			for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+			{
+				const float* p = position(i);
+				const float d = sqrtf(distance2(p, center));
+				if (d > radius)
+				{
+					const float newRadius = (radius + d) * 0.5f;
+					const float shift = (newRadius - radius) / d;
+					for (uint32_t k = 0; k < 3; k++)
+					{
+						center[k] += (p[k] - center[k]) * shift;
+					}
+					radius = newRadius;
+				}
+			}
+			memcpy(meshlet.center, center, sizeof(center));
+			meshlet.radius = radius;
+
+			// The cone axis is the average triangle normal, the cutoff is derived from the normal deviating most from it
+			std::vector<float> normals;
+			float axis[3] = { 0.0f, 0.0f, 0.0f };
+			for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+			{
+				const uint8_t* triangle = &meshletTriangles[meshlet.triangleOffset + t * 3];
+				double n[3];
+				triangleNormal(position(triangle[0]), position(triangle[1]), position(triangle[2]), n);
+				const double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				if (length <= 0.0)
+				{
+					continue;
+				}
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					normals.push_back((float)(n[k] / length));
+					axis[k] += normals.back();
+				}
+			}
+			meshlet.coneAxis[0] = meshlet.coneAxis[1] = meshlet.coneAxis[2] = 0.0f;
+			meshlet.coneCutoff = 1.0f;
+			const float axisLength = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+			if (axisLength <= 0.0f)
+			{
+				return;
+			}
+			float minDot = 1.0f;
+			for (size_t i = 0; i < normals.size(); i += 3)
+			{
+				minDot = std::min(minDot, (normals[i] * axis[0] + normals[i + 1] * axis[1] + normals[i + 2] * axis[2]) / axisLength);
+			}
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				meshlet.coneAxis[k] = axis[k] / axisLength;
+			}
+			// Normals spread over more than a hemisphere can't be culled as a whole
+			meshlet.coneCutoff = (minDot <= 0.0f) ? 1.0f : sqrtf(1.0f - minDot * minDot);
+		}
+
+		/**
+		* Split a triangle list into meshlets of at most meshletMaxVertices vertices and meshletMaxTriangles triangles, in triangle order
+		*
+		* Run optimizeVertexCache first, so consecutive triangles share vertices and the meshlets are compact
+		*
+		* @param meshlets Meshlets appended with offsets into meshletVertices and meshletTriangles
+		* @param meshletVertices Vertex indices (into the source vertices) appended for each meshlet
+		* @param meshletTriangles Three local vertex indices appended per triangle
+		*/
+		void buildMeshlets(const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint8_t>& meshletTriangles)
+		{
+			// Local index of each vertex in the current meshlet, 0xff if it's not part of it
+			std::vector<uint8_t> localIndices(vertexCount, 0xff);
+			Meshlet meshlet = {};
+			meshlet.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+			meshlet.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+			auto finishMeshlet = [&]() {
+				for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+				{
+					localIndices[meshletVertices[meshlet.vertexOffset + i]] = 0xff;
+				}
+				computeMeshletBounds(meshlet, meshletVertices, meshletTriangles, positions, positionStride);
+				meshlets.push_back(meshlet);
+				meshlet = {};
+				meshlet.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+				meshlet.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+			};
+			for (size_t t = 0; t + 2 < indexCount; t += 3)
+			{
+				uint32_t newVertices = 0;
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					newVertices += (localIndices[indices[t + k]] == 0xff) ? 1 : 0;
+				}
+				// Degenerate triangles may count a vertex twice, which only makes the meshlet end a bit early
+				if ((meshlet.vertexCount + newVertices > meshletMaxVertices) || (meshlet.triangleCount + 1 > meshletMaxTriangles))
+				{
+					finishMeshlet();
+				}
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					const uint32_t v = indices[t + k];
+					if (localIndices[v] == 0xff)
+					{
+						localIndices[v] = static_cast<uint8_t>(meshlet.vertexCount++);
+						meshletVertices.push_back(v);
+					}
+					meshletTriangles.push_back(localIndices[v]);
+				}
+				meshlet.triangleCount++;
+			}
+			if (meshlet.triangleCount > 0)
+			{
+				finishMeshlet();
+			}
+		}
+
+		// Symmetric 4x4 matrix of the squared distance to a set of planes (Garland and Heckbert)
+		struct Quadric
+		{
+			double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+			// Sum of the plane weights, the error is normalized by it so it's a squared distance
+			double weight;
+
+			void addPlane(double a, double b, double c, double d, double weight)
+			{
+				a2 += weight * a * a; ab += weight * a * b; ac += weight * a * c; ad += weight * a * d;
+				b2 += weight * b * b; bc += weight * b * c; bd += weight * b * d;
+				c2 += weight * c * c; cd += weight * c * d;
+				d2 += weight * d * d;
+				this->weight += weight;
+			}
+
+			void add(const Quadric& other)
+			{
+				a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+				b2 += other.b2; bc += other.bc; bd += other.bd;
+				c2 += other.c2; cd += other.cd;
+				d2 += other.d2;
+				weight += other.weight;
+			}
+
+			double error(const float* p) const
+			{
+				const double x = p[0], y = p[1], z = p[2];
+				const double e = a2 * x * x + b2 * y * y + c2 * z * z + 2.0 * (ab * x * y + ac * x * z + bc * y * z + ad * x + bd * y + cd * z) + d2;
+				return (weight > 0.0) ? std::max(e, 0.0) / weight : 0.0;
+			}
+		};
+
+		/**
+		* Simplify a triangle list by collapsing edges, keeping the vertices (only indices are changed) so all levels of detail share one vertex buffer
+		*
+		* Collapses are ordered by their quadric error and stop at the target index count or at the target error. Vertices on open borders and
+		* attribute seams (vertices with the same position) are never moved, collapses that would flip triangles are rejected.
+		*
+		* @param destination Output indices, must have room for indexCount indices (may not alias indices)
+		* @param targetError Maximum error relative to the extent of the mesh (e.g. 0.01 for 1%)
+		* @param resultError Optional, error of the result relative to the extent of the mesh
+		* @return Number of indices written to destination
+		*/
+		size_t simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, size_t targetIndexCount, float targetError, float* resultError)
+		{
+			auto position = [positions, positionStride](uint32_t v) {
+				return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + v * positionStride);
+			};
+			std::vector<uint32_t> result(indices, indices + (indexCount / 3) * 3);
+			if (resultError)
+			{
+				*resultError = 0.0f;
+			}
+			if ((result.size() <= targetIndexCount) || (vertexCount == 0))
+			{
+				std::copy(result.begin(), result.end(), destination);
+				return result.size();
+			}
+
+			// Extent of the used vertices, errors are relative to it
+			float minPos[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float maxPos[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (uint32_t index : result)
+			{
+				const float* p = position(index);
+				for (uint32_t i = 0; i < 3; i++)
+				{
+					minPos[i] = std::min(minPos[i], p[i]);
+					maxPos[i] = std::max(maxPos[i], p[i]);
+				}
+			}
+			const float extent = std::max(std::max(maxPos[0] - minPos[0], maxPos[1] - minPos[1]), maxPos[2] - minPos[2]);
+			if (extent <= 0.0f)
+			{
+				std::copy(result.begin(), result.end(), destination);
+				return result.size();
+			}
+
+			// Vertices with the same position are welded for finding borders, the duplicates themselves are seams
+			struct PositionHash
+			{
+				size_t operator()(const std::pair<uint64_t, uint32_t>& key) const { return std::hash<uint64_t>()(key.first * 31 + key.second); }
+			};
+			std::unordered_map<std::pair<uint64_t, uint32_t>, uint32_t, PositionHash> positionMap;
+			std::vector<uint32_t> welded(vertexCount);
+			std::vector<bool> locked(vertexCount, false);
+			for (uint32_t v = 0; v < vertexCount; v++)
+			{
+				uint32_t bits[3];
+				memcpy(bits, position(v), sizeof(bits));
+				const std::pair<uint64_t, uint32_t> key(((uint64_t)bits[0] << 32) | bits[1], bits[2]);
+				auto it = positionMap.find(key);
+				if (it == positionMap.end())
+				{
+					positionMap[key] = v;
+					welded[v] = v;
+				}
+				else
+				{
+					welded[v] = it->second;
+					locked[v] = true;
+					locked[it->second] = true;
+				}
+			}
+			// Edges used by a single triangle are borders
+			std::unordered_map<uint64_t, uint32_t> edgeCounts;
+			for (size_t t = 0; t < result.size(); t += 3)
+			{
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					const uint32_t a = welded[result[t + k]];
+					const uint32_t b = welded[result[t + (k + 1) % 3]];
+					edgeCounts[((uint64_t)std::min(a, b) << 32) | std::max(a, b)]++;
+				}
+			}
+			for (size_t t = 0; t < result.size(); t += 3)
+			{
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					const uint32_t a = result[t + k];
+					const uint32_t b = result[t + (k + 1) % 3];
+					if (edgeCounts[((uint64_t)std::min(welded[a], welded[b]) << 32) | std::max(welded[a], welded[b])] == 1)
+					{
+						locked[a] = true;
+						locked[b] = true;
+					}
+				}
+			}
+
+			// Area weighted planes of the triangles around each vertex, positions are scaled by the extent so errors are relative
+			std::vector<Quadric> quadrics(vertexCount);
+			memset(quadrics.data(), 0, quadrics.size() * sizeof(Quadric));
+			const double invExtent = 1.0 / extent;
+			for (size_t t = 0; t < result.size(); t += 3)
+			{
+				const float* p0 = position(result[t]);
+				double n[3];
+				triangleNormal(p0, position(result[t + 1]), position(result[t + 2]), n);
+				const double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				if (length <= 0.0)
+				{
+					continue;
+				}
+				n[0] /= length; n[1] /= length; n[2] /= length;
+				// Plane in extent scaled space, the normal doesn't change and the distance scales
+				const double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]) * invExtent;
+				const double weight = length * 0.5 * invExtent * invExtent;
+				Quadric quadric = {};
+				quadric.addPlane(n[0], n[1], n[2], d, weight);
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					quadrics[result[t + k]].add(quadric);
+				}
+			}
+			auto collapseError = [&](uint32_t from, uint32_t to) {
+				Quadric quadric = quadrics[from];
+				quadric.add(quadrics[to]);
+				const float* p = position(to);
+				const float scaled[3] = { (float)(p[0] * invExtent), (float)(p[1] * invExtent), (float)(p[2] * invExtent) };
+				return quadric.error(scaled);
+			};
+
+			struct Collapse
+			{
+				uint32_t from;
+				uint32_t to;
+				double error;
+			};
+			const double errorLimit = (double)targetError * (double)targetError;
+			double maxError = 0.0;
+			std::vector<Collapse> collapses;
+			std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+			std::vector<uint32_t> vertexTriangles;
+			std::vector<uint32_t> collapseTarget(vertexCount);
+			std::vector<bool> touched(vertexCount);
+			while (result.size() > targetIndexCount)
+			{
+				collapses.clear();
+				for (size_t t = 0; t < result.size(); t += 3)
+				{
+					for (uint32_t k = 0; k < 3; k++)
+					{
+						const uint32_t a = result[t + k];
+						const uint32_t b = result[t + (k + 1) % 3];
+						if (!locked[a])
+						{
+							collapses.push_back({ a, b, collapseError(a, b) });
+						}
+						if (!locked[b])
+						{
+							collapses.push_back({ b, a, collapseError(b, a) });
+						}
+					}
+				}
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+				// Triangles around each vertex for the flip test
+				std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+				for (uint32_t index : result)
+				{
+					triangleOffsets[index + 1]++;
+				}
+				for (size_t v = 0; v < vertexCount; v++)
+				{
+					triangleOffsets[v + 1] += triangleOffsets[v];
+				}
+				vertexTriangles.resize(result.size());
+				std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+				for (size_t i = 0; i < result.size(); i++)
+				{
+					vertexTriangles[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+				}
+
+				for (uint32_t v = 0; v < vertexCount; v++)
+				{
+					collapseTarget[v] = v;
+				}
+				std::fill(touched.begin(), touched.end(), false);
+				size_t remainingIndices = result.size();
+				uint32_t collapseCount = 0;
+				for (const Collapse& collapse : collapses)
+				{
+					if ((collapse.error > errorLimit) || (remainingIndices <= targetIndexCount))
+					{
+						break;
+					}
+					if (touched[collapse.from] || touched[collapse.to])
+					{
+						continue;
+					}
+					// Reject the collapse if a remaining triangle around the moved vertex would flip
+					bool flips = false;
+					uint32_t removedTriangles = 0;
+					for (uint32_t i = triangleOffsets[collapse.from]; (i < triangleOffsets[collapse.from + 1]) && !flips; i++)
+					{
+						const uint32_t* triangle = &result[vertexTriangles[i] * 3];
+						if ((triangle[0] == collapse.to) || (triangle[1] == collapse.to) || (triangle[2] == collapse.to))
+						{
+							removedTriangles++;
+							continue;
+						}
+						const float* p[3];
+						const float* q[3];
+						for (uint32_t k = 0; k < 3; k++)
+						{
+							p[k] = position(triangle[k]);
+							q[k] = position((triangle[k] == collapse.from) ? collapse.to : triangle[k]);
+						}
+						double before[3], after[3];
+						triangleNormal(p[0], p[1], p[2], before);
+						triangleNormal(q[0], q[1], q[2], after);
+						flips = (before[0] * after[0] + before[1] * after[1] + before[2] * after[2]) <= 0.0;
+					}
+					if (flips)
+					{
+						continue;
+					}
+					collapseTarget[collapse.from] = collapse.to;
+					quadrics[collapse.to].add(quadrics[collapse.from]);
+					maxError = std::max(maxError, collapse.error);
+					// The triangles around the moved vertex change, so their vertices can't be collapsed again in this pass
+					for (uint32_t i = triangleOffsets[collapse.from]; i < triangleOffsets[collapse.from + 1]; i++)
+					{
+						const uint32_t* triangle = &result[vertexTriangles[i] * 3];
+						touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+					}
+					remainingIndices -= removedTriangles * 3;
+					collapseCount++;
+				}
+				if (collapseCount == 0)
+				{
+					break;
+				}
+
+				size_t writeIndex = 0;
+				for (size_t t = 0; t < result.size(); t += 3)
+				{
+					const uint32_t a = collapseTarget[result[t]];
+					const uint32_t b = collapseTarget[result[t + 1]];
+					const uint32_t c = collapseTarget[result[t + 2]];
+					if ((a != b) && (b != c) && (a != c))
+					{
+						result[writeIndex++] = a;
+						result[writeIndex++] = b;
+						result[writeIndex++] = c;
+					}
+				}
+				result.resize(writeIndex);
+			}
+
+			if (resultError)
+			{
+				*resultError = (float)sqrt(maxError);
+			}
+			std::copy(result.begin(), result.end(), destination);
+			return result.size();
+		}
+	}
+}
@@ -0,0 +1,59 @@
+/*
+* Mesh optimization
+*
+* Reorders the triangles of indexed triangle lists for the post-transform vertex cache and for less overdraw,
+* and the vertices for linear vertex fetch, and simplifies them for levels of detail, in the spirit of meshoptimizer (https://github.com/zeux/meshoptimizer)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace vks
+{
+	namespace meshoptimizer
+	{
+		/** @brief Size of the simulated post-transform cache used by the optimizations */
+		const uint32_t vertexCacheSize = 32;
+
+		/** @brief Meshlet limits, suited for mesh shaders with 32 or 64 threads per workgroup */
+		const uint32_t meshletMaxVertices = 64;
+		const uint32_t meshletMaxTriangles = 124;
+
+		/** @brief Range of a meshlet in the vertex and triangle arrays of buildMeshlets, with its bounding sphere and normal cone */
+		struct Meshlet
+		{
+			float center[3];
+			float radius;
+			// The meshlet faces away from a viewer at v if dot(normalize(center - v), coneAxis) >= coneCutoff, 1 disables the cone test
+			float coneAxis[3];
+			float coneCutoff;
+			uint32_t vertexOffset;
+			uint32_t triangleOffset;
+			uint32_t vertexCount;
+			uint32_t triangleCount;
+		};
+
+		void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+		void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount);
+		std::vector<uint32_t> optimizeVertexFetchRemap(uint32_t* indices, size_t indexCount, size_t vertexCount);
+		float averageCacheMissRatio(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 16);
+		void buildMeshlets(const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint8_t>& meshletTriangles);
+		size_t simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+		/** @brief Reorder the vertices with the remap table returned by optimizeVertexFetchRemap */
+		template <typename T>
+		void remapVertices(std::vector<T>& vertices, const std::vector<uint32_t>& remap)
+		{
+			std::vector<T> remapped(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++) {
+				remapped[remap[i]] = vertices[i];
+			}
+			vertices.swap(remapped);
+		}
+	}
+}
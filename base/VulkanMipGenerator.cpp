@@ -0,0 +1,281 @@
+/*
+* Compute shader mip map generator
+*
+* Generates the mip chain of an image with a single pass compute downsampler that writes up to five levels per dispatch
+* An alternative to a chain of image blits that works for formats without blit support and can run on a compute queue
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMipGenerator.h"
+#include "VulkanDevice.h"
+#include "VulkanTexture.h"
+
+namespace vks
+{
+	const uint32_t MipGenerator::levelsPerDispatch;
+
+	static void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageSubresourceRange subresourceRange, VkImageLayout oldImageLayout, VkImageLayout newImageLayout, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
+	{
+		VkImageMemoryBarrier imageMemoryBarrier = vks::initializers::imageMemoryBarrier();
+		imageMemoryBarrier.oldLayout = oldImageLayout;
+		imageMemoryBarrier.newLayout = newImageLayout;
+		imageMemoryBarrier.srcAccessMask = srcAccessMask;
+		imageMemoryBarrier.dstAccessMask = dstAccessMask;
+		imageMemoryBarrier.image = image;
+		imageMemoryBarrier.subresourceRange = subresourceRange;
+		vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	}
+
+	/**
+	* @param device Device to create the compute pipeline on
+	* @param shaderFile SPIR-V file of the "base/mipgen.comp" shader
+	* @param apiVersion Vulkan API version the instance has been created with
+	*
+	* @note If the device doesn't meet the requirements or the shader can't be loaded, no pipeline is created and isSupported() returns false
+	*/
+	MipGenerator::MipGenerator(vks::VulkanDevice *device, const std::string &shaderFile, uint32_t apiVersion) : device(device)
+	{
+		// Subgroup operations are core in Vulkan 1.1 and need to be supported by both the instance and the device
+		if ((apiVersion < VK_API_VERSION_1_1) || (device->properties.apiVersion < VK_API_VERSION_1_1) || !device->enabledFeatures.shaderStorageImageWriteWithoutFormat)
+		{
+			return;
+		}
+		VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+		subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+		VkPhysicalDeviceProperties2 deviceProperties2{};
+		deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		deviceProperties2.pNext = &subgroupProperties;
+		vkGetPhysicalDeviceProperties2(device->physicalDevice, &deviceProperties2);
+		if (!(subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) || !(subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_QUAD_BIT) || (subgroupProperties.subgroupSize < 4))
+		{
+			return;
+		}
+
+#if defined(__ANDROID__)
+		shaderModule = vks::tools::loadShader(androidApp->activity->assetManager, shaderFile.c_str(), device->logicalDevice);
+#else
+		shaderModule = vks::tools::loadShader(shaderFile.c_str(), device->logicalDevice);
+#endif
+		if (shaderModule == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		// Source texels are averaged by sampling between them with linear filtering
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.maxLod = 0.0f;
+		samplerCreateInfo.maxAnisotropy = 1.0f;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1, levelsPerDispatch),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCI.stage.module = shaderModule;
+		pipelineCI.stage.pName = "main";
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline));
+
+		supported = true;
+	}
+
+	MipGenerator::~MipGenerator()
+	{
+		releaseTransientResources();
+		if (pipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+		}
+		if (pipelineLayout)
+		{
+			vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		}
+		if (descriptorSetLayout)
+		{
+			vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		}
+		if (sampler)
+		{
+			vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		}
+		if (shaderModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, shaderModule, nullptr);
+		}
+	}
+
+	/** @brief True if the device meets the requirements of the compute downsampler and its pipeline has been created */
+	bool MipGenerator::isSupported() const
+	{
+		return supported;
+	}
+
+	/** @brief True if mip maps of the given format can be generated, the format needs to support sampling with linear filtering and storage image writes */
+	bool MipGenerator::isFormatSupported(VkFormat format) const
+	{
+		if (!supported)
+		{
+			return false;
+		}
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+		const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+		return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
+	}
+
+	VkImageView MipGenerator::createView(VkImage image, VkFormat format, uint32_t level, uint32_t layerCount)
+	{
+		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewCreateInfo.format = format;
+		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, layerCount };
+		viewCreateInfo.image = image;
+		VkImageView view;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
+		transientViews.push_back(view);
+		return view;
+	}
+
+	/**
+	* Record the generation of all mip levels of an image from its first level
+	*
+	* @param commandBuffer Command buffer to record into, the queue it is submitted to has to support compute
+	* @param image Image to generate the mip levels for, its first level has to contain the source data
+	* @param format Format of the image
+	* @param width Width of the first level
+	* @param height Height of the first level
+	* @param mipLevels Number of mip levels to generate, including the first level
+	* @param layerCount Number of array layers (6 for cubemaps), all layers are generated in the same dispatches
+	* @param oldImageLayout Current layout of the first level, the contents of the other levels are discarded
+	* @param newImageLayout Layout of all levels once the mip chain has been generated
+	*
+	* @note Image views and descriptors used by the commands have to be released with releaseTransientResources() once the command buffer has finished executing
+	* @note When submitting to another queue family than the one that wrote the first level, the image has to be concurrent or its ownership has to be transferred
+	*/
+	void MipGenerator::generate(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t layerCount, VkImageLayout oldImageLayout, VkImageLayout newImageLayout)
+	{
+		if (!isFormatSupported(format))
+		{
+			vks::tools::exitFatal("Compute mip map generation is not supported for format " + std::to_string(format) + " on this device", -1);
+		}
+
+		// All levels stay in the general layout while they are written and read by the dispatches
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, layerCount };
+		imageBarrier(commandBuffer, image, subresourceRange, oldImageLayout, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		if (mipLevels > 1)
+		{
+			VkImageSubresourceRange mipSubresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels - 1, 0, layerCount };
+			imageBarrier(commandBuffer, image, mipSubresourceRange, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		}
+
+		uint32_t dispatchCount = (mipLevels + levelsPerDispatch - 2) / levelsPerDispatch;
+		if (dispatchCount > 0)
+		{
+			VkDescriptorPool descriptorPool;
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, dispatchCount),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, dispatchCount * levelsPerDispatch),
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, dispatchCount);
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
+			transientPools.push_back(descriptorPool);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+			for (uint32_t srcLevel = 0; srcLevel + 1 < mipLevels; srcLevel += levelsPerDispatch)
+			{
+				uint32_t levelCount = std::min(levelsPerDispatch, mipLevels - srcLevel - 1);
+
+				VkDescriptorSet descriptorSet;
+				VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+
+				VkDescriptorImageInfo srcDescriptor = { sampler, createView(image, format, srcLevel, layerCount), VK_IMAGE_LAYOUT_GENERAL };
+				// Unused slots of the last dispatch point at its last level, the shader doesn't write to them
+				std::vector<VkDescriptorImageInfo> dstDescriptors(levelsPerDispatch);
+				for (uint32_t i = 0; i < levelsPerDispatch; i++)
+				{
+					dstDescriptors[i] = (i < levelCount) ? VkDescriptorImageInfo{ VK_NULL_HANDLE, createView(image, format, srcLevel + 1 + i, layerCount), VK_IMAGE_LAYOUT_GENERAL } : dstDescriptors[levelCount - 1];
+				}
+				std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+					vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &srcDescriptor),
+					vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, dstDescriptors.data(), levelsPerDispatch),
+				};
+				vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &levelCount);
+				// Each workgroup writes a 16x16 tile of the first destination level
+				uint32_t dstWidth = std::max(1u, width >> (srcLevel + 1));
+				uint32_t dstHeight = std::max(1u, height >> (srcLevel + 1));
+				vkCmdDispatch(commandBuffer, (dstWidth + 15) / 16, (dstHeight + 15) / 16, layerCount);
+
+				// The last level written is the source of the next dispatch
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+		}
+
+		subresourceRange.levelCount = mipLevels;
+		imageBarrier(commandBuffer, image, subresourceRange, VK_IMAGE_LAYOUT_GENERAL, newImageLayout, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	}
+
+	/**
+	* Generate all mip levels of a texture from its first level and wait for them to finish
+	*
+	* @param texture Texture to generate the mip levels for, its mipLevels and layerCount members determine the levels and layers that are generated
+	* @param format Format of the texture's image
+	* @param queue Queue to submit to, any queue supporting compute (e.g. a dedicated compute queue)
+	* @param (Optional) commandPool Command pool for the queue's family (defaults to the device's graphics command pool)
+	* @param (Optional) newImageLayout Layout of the texture after generation (defaults to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	*/
+	void MipGenerator::generate(vks::Texture &texture, VkFormat format, VkQueue queue, VkCommandPool commandPool, VkImageLayout newImageLayout)
+	{
+		if (commandPool == VK_NULL_HANDLE)
+		{
+			commandPool = device->commandPool;
+		}
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool, true);
+		generate(commandBuffer, texture.image, format, texture.width, texture.height, texture.mipLevels, texture.layerCount, texture.imageLayout, newImageLayout);
+		device->flushCommandBuffer(commandBuffer, queue, commandPool);
+		releaseTransientResources();
+		texture.imageLayout = newImageLayout;
+		texture.updateDescriptor();
+	}
+
+	/** @brief Destroy the image views and descriptor pools of all recorded generations, the command buffers have to have finished executing */
+	void MipGenerator::releaseTransientResources()
+	{
+		for (auto view : transientViews)
+		{
+			vkDestroyImageView(device->logicalDevice, view, nullptr);
+		}
+		transientViews.clear();
+		for (auto pool : transientPools)
+		{
+			vkDestroyDescriptorPool(device->logicalDevice, pool, nullptr);
+		}
+		transientPools.clear();
+	}
+}
@@ -0,0 +1,55 @@
+/*
+* Compute shader mip map generator
+*
+* Generates the mip chain of an image with a single pass compute downsampler that writes up to five levels per dispatch
+* An alternative to a chain of image blits that works for formats without blit support and can run on a compute queue
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+	class Texture;
+
+	/**
+	* Mip map generator using the GLSL "base/mipgen.comp" compute shader
+	*
+	* Level 0 of an image is reduced in groups of up to five mip levels, the second level of each group is reduced with subgroup quad operations
+	* and the remaining levels through shared memory
+	*
+	* @note Requires a Vulkan 1.1 instance, subgroup quad operations in compute shaders and the shaderStorageImageWriteWithoutFormat feature
+	* @note Images need to be created with VK_IMAGE_USAGE_STORAGE_BIT and VK_IMAGE_USAGE_SAMPLED_BIT
+	*/
+	class MipGenerator
+	{
+	private:
+		static const uint32_t levelsPerDispatch = 5;
+		vks::VulkanDevice *device;
+		bool supported = false;
+		VkShaderModule shaderModule = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		// Image views and descriptor pools of recorded dispatches, released by releaseTransientResources()
+		std::vector<VkImageView> transientViews;
+		std::vector<VkDescriptorPool> transientPools;
+		VkImageView createView(VkImage image, VkFormat format, uint32_t level, uint32_t layerCount);
+	public:
+		MipGenerator(vks::VulkanDevice *device, const std::string &shaderFile, uint32_t apiVersion);
+		~MipGenerator();
+		bool isSupported() const;
+		bool isFormatSupported(VkFormat format) const;
+		void generate(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t layerCount, VkImageLayout oldImageLayout, VkImageLayout newImageLayout);
+		void generate(vks::Texture &texture, VkFormat format, VkQueue queue, VkCommandPool commandPool = VK_NULL_HANDLE, VkImageLayout newImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		void releaseTransientResources();
+	};
+}
@@ -0,0 +1,499 @@
+/*
+* Software occlusion culling
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanOcclusionCuller.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include "threadpool.hpp"
+
+// SIMD paths of the coverage masks and box tests, the scalar loops handle platforms without them
+#if defined(__AVX__)
+#define VKS_OCCLUSION_AVX
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VKS_OCCLUSION_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define VKS_OCCLUSION_NEON
+#include <arm_neon.h>
+#endif
+
+namespace vks
+{
+	namespace
+	{
+		// Vertices closer to the eye than this (in clip space w) can't be projected, boxes with such corners are always visible
+		const float minW = 1e-5f;
+		const uint32_t fullMask = 0xffffffffu;
+
+#if defined(VKS_OCCLUSION_NEON)
+		uint32_t laneMask(uint32x4_t lanes)
+		{
+			return (vgetq_lane_u32(lanes, 0) & 1u) | (vgetq_lane_u32(lanes, 1) & 2u) | (vgetq_lane_u32(lanes, 2) & 4u) | (vgetq_lane_u32(lanes, 3) & 8u);
+		}
+#endif
+	}
+
+	/**
+	* Create an occlusion culler with a depth buffer of the given size, rounded up to whole tiles
+	*
+	* @note The buffer only needs a fraction of the screen's resolution, its aspect ratio should match the projection's
+	*/
+	OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height)
+	{
+		resize(width, height);
+	}
+
+	void OcclusionCuller::resize(uint32_t width, uint32_t height)
+	{
+		assert((width > 0) && (height > 0));
+		tilesX = (width + tileWidth - 1) / tileWidth;
+		tilesY = (height + tileHeight - 1) / tileHeight;
+		// Tile coordinates of the triangles are stored in 16 bits
+		assert((tilesX <= 0xffff) && (tilesY <= 0xffff));
+		this->width = tilesX * tileWidth;
+		this->height = tilesY * tileHeight;
+		tileMasks.assign(tilesX * tilesY, 0);
+		tileDepths.assign(tilesX * tilesY, 1.0f);
+		tileMaskDepths.assign(tilesX * tilesY, 0.0f);
+	}
+
+	/** @brief Start a new frame with the given view projection matrix, removes all occluders and clears the depth buffer */
+	void OcclusionCuller::begin(const glm::mat4 &viewProjection)
+	{
+		this->viewProjection = viewProjection;
+		occluders.clear();
+		firstTriangles.clear();
+		statistics = {};
+		std::fill(tileMasks.begin(), tileMasks.end(), 0);
+		std::fill(tileDepths.begin(), tileDepths.end(), 1.0f);
+		std::fill(tileMaskDepths.begin(), tileMaskDepths.end(), 0.0f);
+	}
+
+	/**
+	* Add an indexed triangle list to be rasterized by the next render()
+	*
+	* @param positions Pointer to the x component of the first vertex's position
+	* @param positionStride Distance between two positions in bytes
+	* @param indices Triangle list indices
+	* @param indexCount Number of indices
+	* @param transform Model matrix of the occluder
+	*
+	* @note The vertex and index data is only referenced and has to stay valid until render() returns
+	* @note Occluders are rasterized in the order they were added, adding the closest ones first rejects more triangles early
+	*/
+	void OcclusionCuller::addOccluder(const float *positions, uint32_t positionStride, const uint32_t *indices, uint32_t indexCount, const glm::mat4 &transform)
+	{
+		assert(positions && indices);
+		const size_t firstTriangle = firstTriangles.empty() ? 0 : firstTriangles.back() + occluders.back().indexCount / 3;
+		occluders.push_back({ positions, positionStride, indices, indexCount, transform });
+		firstTriangles.push_back(firstTriangle);
+	}
+
+	/**
+	* Rasterize all occluders added since the last begin() into the depth buffer
+	*
+	* @param threadPool Optional thread pool, triangle setup and rasterization are split across its workers
+	*/
+	void OcclusionCuller::render(ThreadPool *threadPool)
+	{
+		const size_t triangleCount = occluders.empty() ? 0 : firstTriangles.back() + occluders.back().indexCount / 3;
+		triangles.resize(triangleCount * 2);
+		if (threadPool)
+		{
+			threadPool->parallelFor(occluders.size(), 1, [this](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					setupTriangles(i);
+				}
+			});
+			threadPool->parallelFor(tilesY, 0, [this](size_t begin, size_t end) {
+				rasterizeBand(static_cast<uint32_t>(begin), static_cast<uint32_t>(end) - 1);
+			});
+		}
+		else
+		{
+			for (size_t i = 0; i < occluders.size(); i++) {
+				setupTriangles(i);
+			}
+			rasterizeBand(0, tilesY - 1);
+		}
+		statistics.occluderTriangles = static_cast<uint32_t>(triangleCount);
+		statistics.rasterizedTriangles = static_cast<uint32_t>(std::count_if(triangles.begin(), triangles.end(), [](const Triangle &triangle) { return triangle.valid; }));
+	}
+
+	// Clip the triangles of an occluder against the near plane, project them to the screen and set up their edge functions and depth planes
+	void OcclusionCuller::setupTriangles(size_t occluderIndex)
+	{
+		const Occluder &occluder = occluders[occluderIndex];
+		const glm::mat4 mvp = viewProjection * occluder.transform;
+		const char *positions = reinterpret_cast<const char*>(occluder.positions);
+		for (uint32_t t = 0; t < occluder.indexCount / 3; t++)
+		{
+			// Each triangle has two slots, as clipping against the near plane can turn it into a quad
+			Triangle *slots = &triangles[(firstTriangles[occluderIndex] + t) * 2];
+			slots[0].valid = false;
+			slots[1].valid = false;
+			glm::vec4 clip[3];
+			for (uint32_t v = 0; v < 3; v++)
+			{
+				const float *position = reinterpret_cast<const float*>(positions + occluder.indices[t * 3 + v] * occluder.positionStride);
+				clip[v] = mvp * glm::vec4(position[0], position[1], position[2], 1.0f);
+			}
+			if ((clip[0].z >= 0.0f) && (clip[1].z >= 0.0f) && (clip[2].z >= 0.0f))
+			{
+				setupTriangle(slots[0], clip[0], clip[1], clip[2]);
+				continue;
+			}
+			// Sutherland-Hodgman against z >= 0 (the near plane with zero to one depth), one plane leaves at most four vertices
+			glm::vec4 polygon[4];
+			uint32_t vertexCount = 0;
+			for (uint32_t v = 0; v < 3; v++)
+			{
+				const glm::vec4 &a = clip[v];
+				const glm::vec4 &b = clip[(v + 1) % 3];
+				if (a.z >= 0.0f)
+				{
+					polygon[vertexCount++] = a;
+				}
+				if ((a.z >= 0.0f) != (b.z >= 0.0f))
+				{
+					polygon[vertexCount++] = a + (b - a) * (a.z / (a.z - b.z));
+				}
+			}
+			if (vertexCount >= 3)
+			{
+				setupTriangle(slots[0], polygon[0], polygon[1], polygon[2]);
+			}
+			if (vertexCount == 4)
+			{
+				setupTriangle(slots[1], polygon[0], polygon[2], polygon[3]);
+			}
+		}
+	}
+
+	// Project a triangle in front of the near plane to the screen, it stays invalid if it's degenerate or off screen
+	void OcclusionCuller::setupTriangle(Triangle &triangle, const glm::vec4 &clip0, const glm::vec4 &clip1, const glm::vec4 &clip2) const
+	{
+		const glm::vec4 *clip[3] = { &clip0, &clip1, &clip2 };
+		float x[3], y[3], z[3];
+		for (uint32_t v = 0; v < 3; v++)
+		{
+			// Only reached by vertices of non perspective projections that lie behind the eye
+			if (clip[v]->w <= minW)
+			{
+				return;
+			}
+			x[v] = (clip[v]->x / clip[v]->w * 0.5f + 0.5f) * width;
+			y[v] = (clip[v]->y / clip[v]->w * 0.5f + 0.5f) * height;
+			z[v] = clip[v]->z / clip[v]->w;
+		}
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (fabsf(area) < 1e-8f)
+		{
+			return;
+		}
+		// Occluders are rasterized double sided, back faces of closed meshes are hidden by the front faces anyway
+		if (area < 0.0f)
+		{
+			std::swap(x[1], x[2]);
+			std::swap(y[1], y[2]);
+			std::swap(z[1], z[2]);
+			area = -area;
+		}
+		const float minX = std::max(std::min({ x[0], x[1], x[2] }), 0.0f);
+		const float maxX = std::min(std::max({ x[0], x[1], x[2] }), static_cast<float>(width - 1));
+		const float minY = std::max(std::min({ y[0], y[1], y[2] }), 0.0f);
+		const float maxY = std::min(std::max({ y[0], y[1], y[2] }), static_cast<float>(height - 1));
+		if ((minX > maxX) || (minY > maxY))
+		{
+			return;
+		}
+		triangle.minTileX = static_cast<uint16_t>(static_cast<uint32_t>(minX) / tileWidth);
+		triangle.maxTileX = static_cast<uint16_t>(static_cast<uint32_t>(maxX) / tileWidth);
+		triangle.minTileY = static_cast<uint16_t>(static_cast<uint32_t>(minY) / tileHeight);
+		triangle.maxTileY = static_cast<uint16_t>(static_cast<uint32_t>(maxY) / tileHeight);
+		// Edge i runs from vertex i to vertex i + 1, points inside the triangle have non-negative values for all edges
+		for (uint32_t e = 0; e < 3; e++)
+		{
+			const uint32_t n = (e + 1) % 3;
+			triangle.edgeA[e] = y[e] - y[n];
+			triangle.edgeB[e] = x[n] - x[e];
+			triangle.edgeC[e] = x[e] * y[n] - x[n] * y[e];
+		}
+		const float dx1 = x[1] - x[0], dy1 = y[1] - y[0], dz1 = z[1] - z[0];
+		const float dx2 = x[2] - x[0], dy2 = y[2] - y[0], dz2 = z[2] - z[0];
+		triangle.depthA = (dz1 * dy2 - dz2 * dy1) / area;
+		triangle.depthB = (dx1 * dz2 - dx2 * dz1) / area;
+		triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+		triangle.minDepth = std::min({ z[0], z[1], z[2] });
+		triangle.maxDepth = std::max({ z[0], z[1], z[2] });
+		triangle.valid = true;
+	}
+
+	// Rasterize all triangles into the tile rows [firstTileRow, lastTileRow], bands don't overlap so they can be rasterized concurrently
+	void OcclusionCuller::rasterizeBand(uint32_t firstTileRow, uint32_t lastTileRow)
+	{
+		for (const Triangle &triangle : triangles)
+		{
+			if (triangle.valid && (triangle.maxTileY >= firstTileRow) && (triangle.minTileY <= lastTileRow))
+			{
+				rasterizeTriangle(triangle, std::max<uint32_t>(firstTileRow, triangle.minTileY), std::min<uint32_t>(lastTileRow, triangle.maxTileY));
+			}
+		}
+	}
+
+	void OcclusionCuller::rasterizeTriangle(const Triangle &triangle, uint32_t firstTileRow, uint32_t lastTileRow)
+	{
+		for (uint32_t tileY = firstTileRow; tileY <= lastTileRow; tileY++)
+		{
+			for (uint32_t tileX = triangle.minTileX; tileX <= triangle.maxTileX; tileX++)
+			{
+				const uint32_t tile = tileY * tilesX + tileX;
+				// The depth plane is linear, so its range over the tile is spanned by the tile's corners
+				const float x0 = static_cast<float>(tileX * tileWidth), x1 = x0 + tileWidth;
+				const float y0 = static_cast<float>(tileY * tileHeight), y1 = y0 + tileHeight;
+				const float depth00 = triangle.depthA * x0 + triangle.depthB * y0 + triangle.depthC;
+				const float depth10 = triangle.depthA * x1 + triangle.depthB * y0 + triangle.depthC;
+				const float depth01 = triangle.depthA * x0 + triangle.depthB * y1 + triangle.depthC;
+				const float depth11 = triangle.depthA * x1 + triangle.depthB * y1 + triangle.depthC;
+				const float minDepth = std::max(std::min({ depth00, depth10, depth01, depth11 }), triangle.minDepth);
+				const float maxDepth = std::min(std::max({ depth00, depth10, depth01, depth11 }), triangle.maxDepth);
+				if (minDepth >= tileDepths[tile])
+				{
+					continue;
+				}
+				const uint32_t mask = coverageMask(triangle, tileX, tileY);
+				if (mask == 0)
+				{
+					continue;
+				}
+				if (mask == fullMask)
+				{
+					tileDepths[tile] = std::min(tileDepths[tile], maxDepth);
+				}
+				else
+				{
+					tileMasks[tile] |= mask;
+					tileMaskDepths[tile] = std::max(tileMaskDepths[tile], maxDepth);
+					if (tileMasks[tile] == fullMask)
+					{
+						tileDepths[tile] = std::min(tileDepths[tile], tileMaskDepths[tile]);
+						tileMasks[tile] = 0;
+						tileMaskDepths[tile] = 0.0f;
+					}
+				}
+				// A working layer behind the whole tile can't make it any closer, start over with the next triangle
+				if (tileMaskDepths[tile] >= tileDepths[tile])
+				{
+					tileMasks[tile] = 0;
+					tileMaskDepths[tile] = 0.0f;
+				}
+			}
+		}
+	}
+
+	// Coverage of the tile's pixel centers, bit row * tileWidth + column is set if the pixel is inside the triangle
+	uint32_t OcclusionCuller::coverageMask(const Triangle &triangle, uint32_t tileX, uint32_t tileY) const
+	{
+		const float x = static_cast<float>(tileX * tileWidth) + 0.5f;
+		const float y = static_cast<float>(tileY * tileHeight) + 0.5f;
+		uint32_t mask = 0;
+#if defined(VKS_OCCLUSION_AVX)
+		const __m256 columns = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+		__m256 edges[3], stepsY[3];
+		for (uint32_t e = 0; e < 3; e++)
+		{
+			const __m256 a = _mm256_set1_ps(triangle.edgeA[e]);
+			edges[e] = _mm256_add_ps(_mm256_mul_ps(a, columns), _mm256_set1_ps(triangle.edgeA[e] * x + triangle.edgeB[e] * y + triangle.edgeC[e]));
+			stepsY[e] = _mm256_set1_ps(triangle.edgeB[e]);
+		}
+		for (uint32_t row = 0; row < tileHeight; row++)
+		{
+			__m256 inside = _mm256_cmp_ps(edges[0], _mm256_setzero_ps(), _CMP_GE_OQ);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(edges[1], _mm256_setzero_ps(), _CMP_GE_OQ));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(edges[2], _mm256_setzero_ps(), _CMP_GE_OQ));
+			mask |= static_cast<uint32_t>(_mm256_movemask_ps(inside)) << (row * tileWidth);
+			for (uint32_t e = 0; e < 3; e++)
+			{
+				edges[e] = _mm256_add_ps(edges[e], stepsY[e]);
+			}
+		}
+#elif defined(VKS_OCCLUSION_SSE)
+		const __m128 columns = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+		__m128 edges[3], stepsX[3], stepsY[3];
+		for (uint32_t e = 0; e < 3; e++)
+		{
+			const __m128 a = _mm_set1_ps(triangle.edgeA[e]);
+			edges[e] = _mm_add_ps(_mm_mul_ps(a, columns), _mm_set1_ps(triangle.edgeA[e] * x + triangle.edgeB[e] * y + triangle.edgeC[e]));
+			stepsX[e] = _mm_set1_ps(triangle.edgeA[e] * 4.0f);
+			stepsY[e] = _mm_set1_ps(triangle.edgeB[e]);
+		}
+		for (uint32_t row = 0; row < tileHeight; row++)
+		{
+			for (uint32_t half = 0; half < 2; half++)
+			{
+				const __m128 e0 = half ? _mm_add_ps(edges[0], stepsX[0]) : edges[0];
+				const __m128 e1 = half ? _mm_add_ps(edges[1], stepsX[1]) : edges[1];
+				const __m128 e2 = half ? _mm_add_ps(edges[2], stepsX[2]) : edges[2];
+				__m128 inside = _mm_cmpge_ps(e0, _mm_setzero_ps());
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(e1, _mm_setzero_ps()));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(e2, _mm_setzero_ps()));
+				mask |= static_cast<uint32_t>(_mm_movemask_ps(inside)) << (row * tileWidth + half * 4);
+			}
+			for (uint32_t e = 0; e < 3; e++)
+			{
+				edges[e] = _mm_add_ps(edges[e], stepsY[e]);
+			}
+		}
+#elif defined(VKS_OCCLUSION_NEON)
+		const float columnValues[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+		const float32x4_t columns = vld1q_f32(columnValues);
+		float32x4_t edges[3];
+		for (uint32_t e = 0; e < 3; e++)
+		{
+			edges[e] = vmlaq_n_f32(vdupq_n_f32(triangle.edgeA[e] * x + triangle.edgeB[e] * y + triangle.edgeC[e]), columns, triangle.edgeA[e]);
+		}
+		for (uint32_t row = 0; row < tileHeight; row++)
+		{
+			for (uint32_t half = 0; half < 2; half++)
+			{
+				uint32x4_t inside = vdupq_n_u32(0xffffffff);
+				for (uint32_t e = 0; e < 3; e++)
+				{
+					const float32x4_t edge = half ? vaddq_f32(edges[e], vdupq_n_f32(triangle.edgeA[e] * 4.0f)) : edges[e];
+					inside = vandq_u32(inside, vcgeq_f32(edge, vdupq_n_f32(0.0f)));
+				}
+				mask |= laneMask(inside) << (row * tileWidth + half * 4);
+			}
+			for (uint32_t e = 0; e < 3; e++)
+			{
+				edges[e] = vaddq_f32(edges[e], vdupq_n_f32(triangle.edgeB[e]));
+			}
+		}
+#else
+		for (uint32_t row = 0; row < tileHeight; row++)
+		{
+			for (uint32_t column = 0; column < tileWidth; column++)
+			{
+				bool inside = true;
+				for (uint32_t e = 0; (e < 3) && inside; e++)
+				{
+					inside = triangle.edgeA[e] * (x + column) + triangle.edgeB[e] * (y + row) + triangle.edgeC[e] >= 0.0f;
+				}
+				mask |= (inside ? 1u : 0u) << (row * tileWidth + column);
+			}
+		}
+#endif
+		return mask;
+	}
+
+	/**
+	* Test an axis aligned box against the depth buffer
+	*
+	* @param min, max Box corners in model space
+	* @param transform Model matrix of the box
+	*
+	* @return False if the box is completely hidden by the occluders or outside of the screen, boxes crossing the near plane are always visible
+	*/
+	bool OcclusionCuller::testAABB(const glm::vec3 &min, const glm::vec3 &max, const glm::mat4 &transform) const
+	{
+		const glm::mat4 mvp = viewProjection * transform;
+		float minX = static_cast<float>(width), maxX = 0.0f;
+		float minY = static_cast<float>(height), maxY = 0.0f;
+		float nearDepth = 1.0f;
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			const glm::vec4 clip = mvp * glm::vec4((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z, 1.0f);
+			if ((clip.w <= minW) || (clip.z < 0.0f))
+			{
+				return true;
+			}
+			const float x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+			const float y = (clip.y / clip.w * 0.5f + 0.5f) * height;
+			minX = std::min(minX, x);
+			maxX = std::max(maxX, x);
+			minY = std::min(minY, y);
+			maxY = std::max(maxY, y);
+			nearDepth = std::min(nearDepth, clip.z / clip.w);
+		}
+		if ((maxX < 0.0f) || (maxY < 0.0f) || (minX >= width) || (minY >= height))
+		{
+			return false;
+		}
+		const uint32_t minTileX = static_cast<uint32_t>(std::max(minX, 0.0f)) / tileWidth;
+		const uint32_t maxTileX = static_cast<uint32_t>(std::min(maxX, static_cast<float>(width - 1))) / tileWidth;
+		const uint32_t minTileY = static_cast<uint32_t>(std::max(minY, 0.0f)) / tileHeight;
+		const uint32_t maxTileY = static_cast<uint32_t>(std::min(maxY, static_cast<float>(height - 1))) / tileHeight;
+		// Visible if the box's nearest point is in front of the farthest depth of any tile it covers
+		for (uint32_t tileY = minTileY; tileY <= maxTileY; tileY++)
+		{
+			const float *depths = &tileDepths[tileY * tilesX];
+			uint32_t tileX = minTileX;
+#if defined(VKS_OCCLUSION_AVX)
+			const __m256 near8 = _mm256_set1_ps(nearDepth);
+			for (; tileX + 8 <= maxTileX + 1; tileX += 8)
+			{
+				if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(depths + tileX), near8, _CMP_GE_OQ)) != 0)
+				{
+					return true;
+				}
+			}
+#endif
+#if defined(VKS_OCCLUSION_SSE)
+			const __m128 near4 = _mm_set1_ps(nearDepth);
+			for (; tileX + 4 <= maxTileX + 1; tileX += 4)
+			{
+				if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(depths + tileX), near4)) != 0)
+				{
+					return true;
+				}
+			}
+#elif defined(VKS_OCCLUSION_NEON)
+			const float32x4_t near4 = vdupq_n_f32(nearDepth);
+			for (; tileX + 4 <= maxTileX + 1; tileX += 4)
+			{
+				if (laneMask(vcgeq_f32(vld1q_f32(depths + tileX), near4)) != 0)
+				{
+					return true;
+				}
+			}
+#endif
+			for (; tileX <= maxTileX; tileX++)
+			{
+				if (depths[tileX] >= nearDepth)
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	uint32_t OcclusionCuller::getWidth() const
+	{
+		return width;
+	}
+
+	uint32_t OcclusionCuller::getHeight() const
+	{
+		return height;
+	}
+
+	/** @brief Farthest depth of a tile, e.g. for visualizing the buffer */
+	float OcclusionCuller::getTileDepth(uint32_t tileX, uint32_t tileY) const
+	{
+		assert((tileX < tilesX) && (tileY < tilesY));
+		return tileDepths[tileY * tilesX + tileX];
+	}
+
+	const OcclusionCuller::Statistics &OcclusionCuller::getStatistics() const
+	{
+		return statistics;
+	}
+}
@@ -0,0 +1,107 @@
+/*
+* Software occlusion culling
+*
+* Rasterizes selected occluders into a low resolution masked depth buffer on the CPU and tests bounding boxes against it, so occluded
+* objects can be skipped while recording the frame that uses the same view (without the frame of latency of GPU queries)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	class ThreadPool;
+
+	/**
+	* Masked software occlusion culler
+	*
+	* Usage:
+	*	vks::OcclusionCuller occlusionCuller(256, 128);
+	*	// Per frame, with the matrices the frame is rendered with
+	*	occlusionCuller.begin(camera.matrices.perspective * camera.matrices.view);
+	*	occlusionCuller.addOccluder(&vertices[0].pos.x, sizeof(vkglTF::Vertex), indices.data(), indexCount, modelMatrix);
+	*	occlusionCuller.render(&threadPool);		// E.g. in a job, while other command buffers are recorded
+	*	bool visible = occlusionCuller.testAABB(min, max, modelMatrix);
+	*
+	* The depth buffer is split into tiles of 8x4 pixels (one row per SIMD register with AVX, two with SSE or NEON). Instead of a depth per
+	* pixel every tile stores a coverage mask and two depths: the farthest depth of the whole tile and the farthest depth of the pixels
+	* covered by the mask. A triangle adds its pixels to the mask and pushes the mask's depth back if needed, once the mask is full the tile's
+	* depth becomes the mask's. Depth bounds only ever get closer where something has been drawn, so tests never report visible objects as occluded.
+	*
+	* Triangles are set up in parallel over the occluders and rasterized in parallel over bands of tile rows, so no tile is written by two threads.
+	* Tests only read the buffer and can run concurrently from any number of threads.
+	*
+	* @note Occluders should be closed, solid meshes (or conservative simplifications of them), triangles crossing the near plane are clipped
+	* @note Depth follows the projection's convention of 0 = near, 1 = far (GLM_FORCE_DEPTH_ZERO_TO_ONE)
+	*/
+	class OcclusionCuller
+	{
+	public:
+		static const uint32_t tileWidth = 8;
+		static const uint32_t tileHeight = 4;
+
+		/** @brief Triangles added and rasterized (not rejected as degenerate, off screen or behind the near plane, a clipped triangle may add two) by the last render() */
+		struct Statistics {
+			uint32_t occluderTriangles = 0;
+			uint32_t rasterizedTriangles = 0;
+		};
+
+		OcclusionCuller(uint32_t width = 256, uint32_t height = 128);
+		void resize(uint32_t width, uint32_t height);
+		void begin(const glm::mat4 &viewProjection);
+		void addOccluder(const float *positions, uint32_t positionStride, const uint32_t *indices, uint32_t indexCount, const glm::mat4 &transform);
+		void render(ThreadPool *threadPool = nullptr);
+		bool testAABB(const glm::vec3 &min, const glm::vec3 &max, const glm::mat4 &transform) const;
+		uint32_t getWidth() const;
+		uint32_t getHeight() const;
+		float getTileDepth(uint32_t tileX, uint32_t tileY) const;
+		const Statistics &getStatistics() const;
+	private:
+		struct Occluder {
+			const float *positions;
+			uint32_t positionStride;
+			const uint32_t *indices;
+			uint32_t indexCount;
+			glm::mat4 transform;
+		};
+		// Screen space triangle with counter clockwise winding, edge functions and depth plane
+		struct Triangle {
+			float edgeA[3];
+			float edgeB[3];
+			float edgeC[3];
+			// Depth = depthA * x + depthB * y + depthC
+			float depthA, depthB, depthC;
+			float minDepth, maxDepth;
+			uint16_t minTileX, minTileY, maxTileX, maxTileY;
+			bool valid;
+		};
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t tilesX = 0;
+		uint32_t tilesY = 0;
+		glm::mat4 viewProjection = glm::mat4(1.0f);
+		std::vector<Occluder> occluders;
+		// Index of each occluder's first triangle, the triangles of triangle i are stored at 2 * i and 2 * i + 1 (if clipped to a quad)
+		std::vector<size_t> firstTriangles;
+		std::vector<Triangle> triangles;
+		// Per tile: coverage mask of the working layer, farthest depth of the tile and of the working layer
+		std::vector<uint32_t> tileMasks;
+		std::vector<float> tileDepths;
+		std::vector<float> tileMaskDepths;
+		Statistics statistics;
+		void setupTriangles(size_t occluder);
+		void setupTriangle(Triangle &triangle, const glm::vec4 &clip0, const glm::vec4 &clip1, const glm::vec4 &clip2) const;
+		void rasterizeBand(uint32_t firstTileRow, uint32_t lastTileRow);
+		void rasterizeTriangle(const Triangle &triangle, uint32_t firstTileRow, uint32_t lastTileRow);
+		uint32_t coverageMask(const Triangle &triangle, uint32_t tileX, uint32_t tileY) const;
+	};
+}
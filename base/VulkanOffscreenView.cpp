@@ -0,0 +1,307 @@
+/*
+* Cached offscreen view
+*
+* Color and depth target for a secondary view (planar reflections, effect passes) sized as a fraction of the main view, that is only
+* rendered again when the view's camera or scene changed, optionally at a lower rate than the main view
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanOffscreenView.h"
+#include "VulkanDevice.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace vks
+{
+	/**
+	* @param device Device to create the targets on
+	* @param colorFormat Format of the color target, needs to support color attachment and sampled image usage
+	* @param depthFormat Format of the depth target
+	* @param scale Size of the targets relative to the size passed to resize()
+	*
+	* @note No targets are created before the first call to resize()
+	*/
+	OffscreenView::OffscreenView(vks::VulkanDevice *device, VkFormat colorFormat, VkFormat depthFormat, float scale) : device(device), colorFormat(colorFormat), depthFormat(depthFormat), scale(std::max(scale, 0.0f))
+	{
+		std::array<VkAttachmentDescription, 2> attachmentDescriptions = {};
+		attachmentDescriptions[0].format = colorFormat;
+		attachmentDescriptions[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachmentDescriptions[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachmentDescriptions[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachmentDescriptions[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachmentDescriptions[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachmentDescriptions[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachmentDescriptions[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		attachmentDescriptions[1].format = depthFormat;
+		attachmentDescriptions[1].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachmentDescriptions[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachmentDescriptions[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachmentDescriptions[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachmentDescriptions[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachmentDescriptions[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachmentDescriptions[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpassDescription = {};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = 1;
+		subpassDescription.pColorAttachments = &colorReference;
+		subpassDescription.pDepthStencilAttachment = &depthReference;
+
+		// Rendering waits for the reads of earlier frames, which may still sample the previous contents, and later reads wait for the rendering
+		std::array<VkSubpassDependency, 2> dependencies;
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+		renderPassCI.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+		renderPassCI.pAttachments = attachmentDescriptions.data();
+		renderPassCI.subpassCount = 1;
+		renderPassCI.pSubpasses = &subpassDescription;
+		renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassCI.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vkCreateRenderPass(device->logicalDevice, &renderPassCI, nullptr, &renderPass));
+
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.maxAnisotropy = 1.0f;
+		samplerCI.maxLod = 1.0f;
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &sampler));
+	}
+
+	OffscreenView::~OffscreenView()
+	{
+		destroyTargets();
+		vkDestroyRenderPass(device->logicalDevice, renderPass, nullptr);
+		vkDestroySampler(device->logicalDevice, sampler, nullptr);
+	}
+
+	void OffscreenView::createAttachment(Attachment &attachment, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectMask)
+	{
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = format;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = usage;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &attachment.image));
+		VK_CHECK_RESULT(device->allocateImageMemory(attachment.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &attachment.memory, &attachment.allocation));
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = format;
+		viewCI.subresourceRange = { aspectMask, 0, 1, 0, 1 };
+		viewCI.image = attachment.image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &attachment.view));
+	}
+
+	/** @brief Release the targets once the frames in flight that may use them have finished (see vks::VulkanDevice::deferDestruction) */
+	void OffscreenView::destroyTargets()
+	{
+		if (frameBuffer == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		vks::VulkanDevice *vulkanDevice = device;
+		const Attachment oldColor = color;
+		const Attachment oldDepth = depth;
+		const VkFramebuffer oldFrameBuffer = frameBuffer;
+		device->deferDestruction([vulkanDevice, oldColor, oldDepth, oldFrameBuffer]() {
+			vkDestroyFramebuffer(vulkanDevice->logicalDevice, oldFrameBuffer, nullptr);
+			for (Attachment attachment : { oldColor, oldDepth })
+			{
+				vkDestroyImageView(vulkanDevice->logicalDevice, attachment.view, nullptr);
+				vkDestroyImage(vulkanDevice->logicalDevice, attachment.image, nullptr);
+				vulkanDevice->freeMemory(attachment.memory, attachment.allocation);
+			}
+		});
+		color = Attachment();
+		depth = Attachment();
+		frameBuffer = VK_NULL_HANDLE;
+		descriptor = VkDescriptorImageInfo{};
+		valid = false;
+	}
+
+	/**
+	* Fit the targets to the size of the main view
+	*
+	* @param viewWidth Width of the main view, the targets are scaled by getScale()
+	* @param viewHeight Height of the main view
+	*
+	* @return True if the targets have been recreated, descriptors using getDescriptor() and command buffers recording the view have to be updated
+	*/
+	bool OffscreenView::resize(uint32_t viewWidth, uint32_t viewHeight)
+	{
+		const uint32_t newWidth = std::max(static_cast<uint32_t>(std::lround(static_cast<float>(viewWidth) * scale)), 1u);
+		const uint32_t newHeight = std::max(static_cast<uint32_t>(std::lround(static_cast<float>(viewHeight) * scale)), 1u);
+		if ((frameBuffer != VK_NULL_HANDLE) && (newWidth == width) && (newHeight == height))
+		{
+			return false;
+		}
+		destroyTargets();
+		width = newWidth;
+		height = newHeight;
+
+		VkImageAspectFlags depthAspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT)
+		{
+			depthAspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		createAttachment(color, colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+		createAttachment(depth, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthAspectMask);
+
+		VkImageView attachments[2] = { color.view, depth.view };
+		VkFramebufferCreateInfo frameBufferCI = vks::initializers::framebufferCreateInfo();
+		frameBufferCI.renderPass = renderPass;
+		frameBufferCI.attachmentCount = 2;
+		frameBufferCI.pAttachments = attachments;
+		frameBufferCI.width = width;
+		frameBufferCI.height = height;
+		frameBufferCI.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device->logicalDevice, &frameBufferCI, nullptr, &frameBuffer));
+
+		descriptor = { sampler, color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		return true;
+	}
+
+	/** @brief Size of the targets relative to the main view, takes effect with the next resize() */
+	void OffscreenView::setScale(float scale)
+	{
+		this->scale = std::max(scale, 0.0f);
+	}
+
+	float OffscreenView::getScale() const
+	{
+		return scale;
+	}
+
+	/** @brief Render the view at most every n-th frame, the main view reprojects the older contents in between */
+	void OffscreenView::setUpdateInterval(uint32_t frames)
+	{
+		updateInterval = std::max(frames, 1u);
+	}
+
+	uint32_t OffscreenView::getUpdateInterval() const
+	{
+		return updateInterval;
+	}
+
+	/** @brief Mark the contents as out of date, e.g. if the scene rendered by the view is animated */
+	void OffscreenView::invalidate()
+	{
+		invalidated = true;
+	}
+
+	/**
+	* Decide whether the view has to be rendered this frame, call once per frame
+	*
+	* @param viewProjection View projection matrix of the view for this frame
+	*
+	* @return True if the view's command buffer needs to be submitted this frame, its uniforms then have to be updated for viewProjection
+	*/
+	bool OffscreenView::update(const glm::mat4 &viewProjection)
+	{
+		frameCount++;
+		framesSinceRender++;
+		const bool changed = invalidated || (viewProjection != renderedViewProjection);
+		if (valid && (!changed || (framesSinceRender < updateInterval)))
+		{
+			return false;
+		}
+		renderedViewProjection = viewProjection;
+		invalidated = false;
+		valid = true;
+		framesSinceRender = 0;
+		renderCount++;
+		return true;
+	}
+
+	/** @brief View projection matrix the current contents have been rendered with, for looking them up from the main view */
+	const glm::mat4 &OffscreenView::getRenderedViewProjection() const
+	{
+		return renderedViewProjection;
+	}
+
+	/** @brief Begin the view's render pass and set the viewport and scissor to the whole target */
+	void OffscreenView::beginRenderPass(VkCommandBuffer commandBuffer, const VkClearColorValue &clearColor)
+	{
+		VkClearValue clearValues[2];
+		clearValues[0].color = clearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.framebuffer = frameBuffer;
+		renderPassBeginInfo.renderArea.extent = { width, height };
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport(static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
+
+	void OffscreenView::endRenderPass(VkCommandBuffer commandBuffer)
+	{
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	VkRenderPass OffscreenView::getRenderPass() const
+	{
+		return renderPass;
+	}
+
+	uint32_t OffscreenView::getWidth() const
+	{
+		return width;
+	}
+
+	uint32_t OffscreenView::getHeight() const
+	{
+		return height;
+	}
+
+	/** @brief Sampler, color target view and shader read layout, changes when resize() recreates the targets */
+	VkDescriptorImageInfo &OffscreenView::getDescriptor()
+	{
+		return descriptor;
+	}
+
+	/** @brief Fraction of the frames since the last resetStatistics() the view has been rendered in */
+	float OffscreenView::getRenderedFraction() const
+	{
+		return (frameCount > 0) ? static_cast<float>(static_cast<double>(renderCount) / static_cast<double>(frameCount)) : 0.0f;
+	}
+
+	void OffscreenView::resetStatistics()
+	{
+		frameCount = 0;
+		renderCount = 0;
+	}
+}
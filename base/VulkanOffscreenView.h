@@ -0,0 +1,98 @@
+/*
+* Cached offscreen view
+*
+* Color and depth target for a secondary view (planar reflections, effect passes) sized as a fraction of the main view, that is only
+* rendered again when the view's camera or scene changed, optionally at a lower rate than the main view
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanMemoryAllocator.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Offscreen color and depth target of a secondary view with a render pass, a sampler and a descriptor for reading the color target
+	*
+	* Usage:
+	*	vks::OffscreenView view(vulkanDevice, VK_FORMAT_R8G8B8A8_UNORM, depthFormat, 0.5f);
+	*	view.resize(width, height);	// and again in windowResized(), re-record the view's command buffer and update its descriptors if it returns true
+	*	// Record the view into a command buffer of its own, between view.beginRenderPass(commandBuffer, clearColor) and view.endRenderPass(commandBuffer)
+	*	// Per frame, with the view projection of the secondary view
+	*	if (animating) view.invalidate();
+	*	if (view.update(viewProjection)) {
+	*		// Update the view's uniforms and submit its command buffer before the frame's command buffer
+	*	}
+	*	// Sample the color target with getRenderedViewProjection() instead of the current view projection, so that contents that are
+	*	// a few frames old are reprojected to the current view
+	*
+	* The contents are rendered again when the view projection differs from the one they were rendered with or invalidate() has been
+	* called, but no more often than every getUpdateInterval() frames. The first update after a resize always renders.
+	*
+	* @note The color target is in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL after the render pass, the render pass dependencies make rendering
+	* wait for earlier fragment shader reads and later fragment shader reads wait for the rendering, as long as everything is submitted to the same queue
+	*/
+	class OffscreenView
+	{
+	private:
+		struct Attachment {
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			vks::MemoryAllocation allocation{};
+			VkImageView view = VK_NULL_HANDLE;
+		};
+		vks::VulkanDevice *device;
+		VkFormat colorFormat;
+		VkFormat depthFormat;
+		float scale;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		Attachment color;
+		Attachment depth;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFramebuffer frameBuffer = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkDescriptorImageInfo descriptor{};
+		uint32_t updateInterval = 1;
+		// The contents are missing (after a resize) or out of date
+		bool valid = false;
+		bool invalidated = false;
+		uint32_t framesSinceRender = 0;
+		glm::mat4 renderedViewProjection = glm::mat4(1.0f);
+		// Frames passed to update() and frames rendered since the last resetStatistics()
+		uint64_t frameCount = 0;
+		uint64_t renderCount = 0;
+		void createAttachment(Attachment &attachment, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectMask);
+		void destroyTargets();
+	public:
+		OffscreenView(vks::VulkanDevice *device, VkFormat colorFormat, VkFormat depthFormat, float scale = 0.5f);
+		~OffscreenView();
+		bool resize(uint32_t viewWidth, uint32_t viewHeight);
+		void setScale(float scale);
+		float getScale() const;
+		void setUpdateInterval(uint32_t frames);
+		uint32_t getUpdateInterval() const;
+		void invalidate();
+		bool update(const glm::mat4 &viewProjection);
+		const glm::mat4 &getRenderedViewProjection() const;
+		void beginRenderPass(VkCommandBuffer commandBuffer, const VkClearColorValue &clearColor);
+		void endRenderPass(VkCommandBuffer commandBuffer);
+		VkRenderPass getRenderPass() const;
+		uint32_t getWidth() const;
+		uint32_t getHeight() const;
+		VkDescriptorImageInfo &getDescriptor();
+		float getRenderedFraction() const;
+		void resetStatistics();
+	};
+}
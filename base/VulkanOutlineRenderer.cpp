@@ -0,0 +1,480 @@
+/*
+* Screen space outline renderer
+*
+* Draws outlines and selection highlights around objects from an object id mask, using a jump flood distance transform so outlines of
+* any width cost a fixed number of compute passes, independent of the complexity and number of the outlined objects
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanOutlineRenderer.h"
+#include "VulkanDevice.h"
+#include "VulkanStartupReport.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace vks
+{
+	const VkFormat OutlineRenderer::maskFormat;
+	const VkFormat OutlineRenderer::distanceFormat;
+
+	// Work group size of the seed and jump flood shaders in both dimensions
+	static const uint32_t jumpFloodGroupSize = 8;
+
+	/**
+	* @param device Device to create the pipelines and images on
+	* @param renderPass Render pass the outlines are drawn in by draw()
+	* @param pipelineCache Pipeline cache used for creating the pipelines
+	* @param shaderPath Path of the SPIR-V files of the outline shaders, e.g. getShadersPath() + "base/"
+	* @param rasterizationSamples Sample count of the render pass
+	* @param subpass Index of the subpass of the render pass the outlines are drawn in
+	*/
+	OutlineRenderer::OutlineRenderer(vks::VulkanDevice *device, VkRenderPass renderPass, VkPipelineCache pipelineCache, const std::string &shaderPath, VkSampleCountFlagBits rasterizationSamples, uint32_t subpass) : device(device)
+	{
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.maxLod = 0.0f;
+		samplerCreateInfo.maxAnisotropy = 1.0f;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+
+		// Default palette, ids without a color set are drawn in the first id's color
+		const std::array<glm::vec4, 4> palette = {
+			glm::vec4(1.0f, 0.6f, 0.1f, 1.0f),
+			glm::vec4(0.2f, 0.6f, 1.0f, 1.0f),
+			glm::vec4(0.3f, 0.9f, 0.3f, 1.0f),
+			glm::vec4(0.9f, 0.2f, 0.7f, 1.0f),
+		};
+		for (uint32_t id = 0; id < maxIds; id++)
+		{
+			uniformData.colors[id] = palette[(id == 0) ? 0 : (id - 1) % palette.size()];
+		}
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffer,
+			sizeof(UniformData)));
+		VK_CHECK_RESULT(uniformBuffer.map());
+		updateUniformBuffer();
+
+		// The id mask is cleared to 0 (no object) and read by the compute passes and the composite afterwards
+		VkAttachmentDescription attachmentDescription{};
+		attachmentDescription.format = maskFormat;
+		attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkSubpassDescription subpassDescription{};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = 1;
+		subpassDescription.pColorAttachments = &colorReference;
+		std::array<VkSubpassDependency, 2> dependencies{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+		renderPassCI.attachmentCount = 1;
+		renderPassCI.pAttachments = &attachmentDescription;
+		renderPassCI.subpassCount = 1;
+		renderPassCI.pSubpasses = &subpassDescription;
+		renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassCI.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vkCreateRenderPass(device->logicalDevice, &renderPassCI, nullptr, &maskRenderPass));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Id mask
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Distance image read by a jump flood pass
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Distance image written by the pass
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &computeSetLayout));
+		setLayoutBindings = {
+			// Binding 0: Id mask
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			// Binding 1: Result of the jump flood passes
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+			// Binding 2: Colors and settings
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+		};
+		descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &compositeSetLayout));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 6),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 5);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+		const std::array<VkDescriptorSetLayout, 3> computeSetLayouts = { computeSetLayout, computeSetLayout, computeSetLayout };
+		std::array<VkDescriptorSet, 3> computeSets;
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, computeSetLayouts.data(), static_cast<uint32_t>(computeSetLayouts.size()));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, computeSets.data()));
+		seedSet = computeSets[0];
+		jumpFloodSets[0] = computeSets[1];
+		jumpFloodSets[1] = computeSets[2];
+		const std::array<VkDescriptorSetLayout, 2> compositeSetLayouts = { compositeSetLayout, compositeSetLayout };
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, compositeSetLayouts.data(), static_cast<uint32_t>(compositeSetLayouts.size()));
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, compositeSets));
+
+		// Seed and jump flood passes
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(JumpFloodPushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&computeSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &computePipelineLayout));
+		const std::array<std::pair<std::string, VkPipeline*>, 2> computePipelines = { {
+			{ "outlineseed.comp.spv", &seedPipeline },
+			{ "outlinejumpflood.comp.spv", &jumpFloodPipeline },
+		} };
+		for (const auto &computePipeline : computePipelines)
+		{
+			const std::string filename = shaderPath + computePipeline.first;
+			VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(computePipelineLayout, 0);
+			computePipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			computePipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			computePipelineCI.stage.pName = "main";
+#if defined(__ANDROID__)
+			computePipelineCI.stage.module = vks::tools::loadShader(androidApp->activity->assetManager, filename.c_str(), device->logicalDevice);
+#else
+			computePipelineCI.stage.module = vks::tools::loadShader(filename.c_str(), device->logicalDevice);
+#endif
+			assert(computePipelineCI.stage.module != VK_NULL_HANDLE);
+			{
+				VKS_STARTUP_SCOPE(vks::StartupReport::Pipeline, "outline jump flood");
+				VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCI, nullptr, computePipeline.second));
+			}
+			vkDestroyShaderModule(device->logicalDevice, computePipelineCI.stage.module, nullptr);
+		}
+
+		// Fullscreen composite, blended over the scene
+		pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&compositeSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &compositePipelineLayout));
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_TRUE);
+		blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+		blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_ALWAYS);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(rasterizationSamples, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+		const std::array<std::pair<VkShaderStageFlagBits, std::string>, 2> stages = { {
+			{ VK_SHADER_STAGE_VERTEX_BIT, "outline.vert.spv" },
+			{ VK_SHADER_STAGE_FRAGMENT_BIT, "outline.frag.spv" },
+		} };
+		for (size_t i = 0; i < stages.size(); i++)
+		{
+			const std::string filename = shaderPath + stages[i].second;
+			shaderStages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			shaderStages[i].stage = stages[i].first;
+			shaderStages[i].pName = "main";
+#if defined(__ANDROID__)
+			shaderStages[i].module = vks::tools::loadShader(androidApp->activity->assetManager, filename.c_str(), device->logicalDevice);
+#else
+			shaderStages[i].module = vks::tools::loadShader(filename.c_str(), device->logicalDevice);
+#endif
+			assert(shaderStages[i].module != VK_NULL_HANDLE);
+		}
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(compositePipelineLayout, renderPass, 0);
+		pipelineCI.pVertexInputState = &vertexInputState;
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		pipelineCI.subpass = subpass;
+		{
+			VKS_STARTUP_SCOPE(vks::StartupReport::Pipeline, "outline composite");
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &compositePipeline));
+		}
+		for (const VkPipelineShaderStageCreateInfo &shaderStage : shaderStages)
+		{
+			vkDestroyShaderModule(device->logicalDevice, shaderStage.module, nullptr);
+		}
+	}
+
+	OutlineRenderer::~OutlineRenderer()
+	{
+		destroyTargets();
+		vkDestroyPipeline(device->logicalDevice, compositePipeline, nullptr);
+		vkDestroyPipeline(device->logicalDevice, jumpFloodPipeline, nullptr);
+		vkDestroyPipeline(device->logicalDevice, seedPipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, compositePipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, computePipelineLayout, nullptr);
+		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, compositeSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, computeSetLayout, nullptr);
+		vkDestroyRenderPass(device->logicalDevice, maskRenderPass, nullptr);
+		vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		uniformBuffer.destroy();
+	}
+
+	void OutlineRenderer::createImage(Image &image, VkFormat format, VkImageUsageFlags usage)
+	{
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = format;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = usage;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &image.image));
+		VK_CHECK_RESULT(device->allocateImageMemory(image.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &image.memory, &image.allocation));
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		viewCI.image = image.image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &image.view));
+	}
+
+	void OutlineRenderer::destroyImage(Image &image)
+	{
+		if (image.view)
+		{
+			vkDestroyImageView(device->logicalDevice, image.view, nullptr);
+		}
+		if (image.image)
+		{
+			vkDestroyImage(device->logicalDevice, image.image, nullptr);
+			device->freeMemory(image.memory, image.allocation);
+		}
+		image = Image();
+	}
+
+	void OutlineRenderer::destroyTargets()
+	{
+		if (maskFramebuffer)
+		{
+			vkDestroyFramebuffer(device->logicalDevice, maskFramebuffer, nullptr);
+			maskFramebuffer = VK_NULL_HANDLE;
+		}
+		destroyImage(mask);
+		destroyImage(distances[0]);
+		destroyImage(distances[1]);
+	}
+
+	void OutlineRenderer::updateUniformBuffer()
+	{
+		uniformData.width = settings.width;
+		uniformData.fillOpacity = settings.fillOpacity;
+		memcpy(uniformBuffer.mapped, &uniformData, sizeof(UniformData));
+	}
+
+	/**
+	* Create the id mask and distance images for the size of the render target, replacing the previous ones (e.g. after a resize)
+	*
+	* @note The previous images must not be in use anymore, command buffers recorded before have to be recorded again
+	*/
+	void OutlineRenderer::resize(uint32_t width, uint32_t height)
+	{
+		destroyTargets();
+		this->width = std::max(width, 1u);
+		this->height = std::max(height, 1u);
+		createImage(mask, maskFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+		createImage(distances[0], distanceFormat, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+		createImage(distances[1], distanceFormat, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+		VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+		framebufferCI.renderPass = maskRenderPass;
+		framebufferCI.attachmentCount = 1;
+		framebufferCI.pAttachments = &mask.view;
+		framebufferCI.width = this->width;
+		framebufferCI.height = this->height;
+		framebufferCI.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device->logicalDevice, &framebufferCI, nullptr, &maskFramebuffer));
+
+		VkDescriptorImageInfo maskDescriptor = { sampler, mask.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		VkDescriptorImageInfo distanceDescriptors[2] = {
+			{ sampler, distances[0].view, VK_IMAGE_LAYOUT_GENERAL },
+			{ sampler, distances[1].view, VK_IMAGE_LAYOUT_GENERAL },
+		};
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			// The seed pass doesn't read a distance image, the binding is written so the set is complete
+			vks::initializers::writeDescriptorSet(seedSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &maskDescriptor),
+			vks::initializers::writeDescriptorSet(seedSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &distanceDescriptors[1]),
+			vks::initializers::writeDescriptorSet(seedSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &distanceDescriptors[0]),
+		};
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(jumpFloodSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &maskDescriptor));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(jumpFloodSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &distanceDescriptors[i]));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(jumpFloodSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &distanceDescriptors[1 - i]));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compositeSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &maskDescriptor));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compositeSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &distanceDescriptors[i]));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(compositeSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffer.descriptor));
+		}
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	/** @brief Set the outline and fill color of an object id, the alpha channel scales the opacity */
+	void OutlineRenderer::setColor(uint32_t id, const glm::vec4 &color)
+	{
+		assert(id < maxIds);
+		uniformData.colors[id] = color;
+		updateUniformBuffer();
+	}
+
+	/**
+	* Change the outline width and fill opacity
+	*
+	* @note The number of jump flood passes depends on the width, command buffers with generate() have to be recorded again if getPassCount() changed
+	*/
+	void OutlineRenderer::setSettings(const Settings &settings)
+	{
+		this->settings = settings;
+		this->settings.width = std::max(settings.width, 0.0f);
+		updateUniformBuffer();
+	}
+
+	const OutlineRenderer::Settings &OutlineRenderer::getSettings() const
+	{
+		return settings;
+	}
+
+	/** @brief Number of compute passes recorded by generate() for the current width, including the seed pass */
+	uint32_t OutlineRenderer::getPassCount() const
+	{
+		uint32_t passCount = 2;
+		for (uint32_t step = 1; static_cast<float>(step) < settings.width; step *= 2)
+		{
+			passCount++;
+		}
+		return passCount;
+	}
+
+	/** @brief Render pass of the id mask, for creating the pipelines that draw into it */
+	VkRenderPass OutlineRenderer::getMaskRenderPass() const
+	{
+		return maskRenderPass;
+	}
+
+	/** @brief Begin the render pass of the id mask, with the viewport and scissor set to the whole mask */
+	void OutlineRenderer::beginMask(VkCommandBuffer commandBuffer)
+	{
+		VkClearValue clearValue{};
+		clearValue.color.uint32[0] = 0;
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = maskRenderPass;
+		renderPassBeginInfo.framebuffer = maskFramebuffer;
+		renderPassBeginInfo.renderArea.extent = { width, height };
+		renderPassBeginInfo.clearValueCount = 1;
+		renderPassBeginInfo.pClearValues = &clearValue;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport(static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
+
+	void OutlineRenderer::endMask(VkCommandBuffer commandBuffer)
+	{
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	/**
+	* Record the seed and jump flood passes building the distances to the border of the id mask, outside of a render pass
+	*
+	* @note Must be recorded after endMask(), the distances are ready for draw() in the same command buffer without further barriers
+	*/
+	void OutlineRenderer::generate(VkCommandBuffer commandBuffer)
+	{
+		// Both distance images are overwritten, the composite of a previous frame may still read them
+		std::array<VkImageMemoryBarrier, 2> imageBarriers;
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			imageBarriers[i] = vks::initializers::imageMemoryBarrier();
+			imageBarriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageBarriers[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			imageBarriers[i].srcAccessMask = 0;
+			imageBarriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			imageBarriers[i].image = distances[i].image;
+			imageBarriers[i].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		}
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+
+		const uint32_t groupCountX = (width + jumpFloodGroupSize - 1) / jumpFloodGroupSize;
+		const uint32_t groupCountY = (height + jumpFloodGroupSize - 1) / jumpFloodGroupSize;
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, seedPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &seedSet, 0, nullptr);
+		vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		// Steps from the power of two at or above the width down to a single pixel, so distances up to the width are found
+		uint32_t step = 1;
+		while (static_cast<float>(step) < settings.width)
+		{
+			step *= 2;
+		}
+		resultIndex = 0;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, jumpFloodPipeline);
+		for (; step > 0; step /= 2)
+		{
+			JumpFloodPushConstants pushConstants{ static_cast<int32_t>(step) };
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &jumpFloodSets[resultIndex], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(JumpFloodPushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+			resultIndex = 1 - resultIndex;
+			const VkPipelineStageFlags dstStage = (step > 1) ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStage, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+	}
+
+	/**
+	* Draw the outlines and fills over the scene, inside of the render pass passed to the constructor
+	*
+	* @note Uses the viewport and scissor set by the application, which have to cover the same area as the id mask
+	*/
+	void OutlineRenderer::draw(VkCommandBuffer commandBuffer)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipelineLayout, 0, 1, &compositeSets[resultIndex], 0, nullptr);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	}
+}
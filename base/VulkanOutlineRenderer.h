@@ -0,0 +1,125 @@
+/*
+* Screen space outline renderer
+*
+* Draws outlines and selection highlights around objects from an object id mask, using a jump flood distance transform so outlines of
+* any width cost a fixed number of compute passes, independent of the complexity and number of the outlined objects
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+#include "VulkanMemoryAllocator.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Outline renderer using the "base/outlineseed.comp", "base/outlinejumpflood.comp", "base/outline.vert" and "base/outline.frag" shaders
+	*
+	* Usage:
+	*	vks::OutlineRenderer outlines(vulkanDevice, renderPass, pipelineCache, getShadersPath() + "base/");
+	*	outlines.resize(width, height);	// and again on resize
+	*	// Create the pipeline for the id mask with outlines.getMaskRenderPass(), its fragment shader writes the object's id (1 to maxIds - 1) as uint
+	*	// Per frame, outside of a render pass
+	*	outlines.beginMask(commandBuffer);
+	*	// Draw the selected objects with the mask pipeline
+	*	outlines.endMask(commandBuffer);
+	*	outlines.generate(commandBuffer);
+	*	// Inside the render pass passed to the constructor, after the scene
+	*	outlines.draw(commandBuffer);
+	*
+	* The seed pass marks the pixels on the border of the id mask (inside an object with a neighbour outside of it), each jump flood pass then
+	* propagates the nearest border pixel to the pixels at a halving step distance. Outlines only need distances up to their width, so the
+	* passes start at the power of two step above the width: an outline of w pixels takes ceil(log2(w)) + 2 passes (including the seed pass).
+	* The composite pass draws pixels outside of the mask that are within the outline width of a border pixel in the color of that pixel's id,
+	* with an antialiased edge, and tints pixels inside of the mask with the fill opacity.
+	*
+	* @note The id mask has no depth attachment, so outlines surround the whole silhouette of an object, including parts hidden by other geometry
+	* @note The composite pipeline blends with the alpha of the outline colors, the render pass passed to the constructor needs a color attachment at location 0
+	*/
+	class OutlineRenderer
+	{
+	public:
+		static const uint32_t maxIds = 16;
+		static const VkFormat maskFormat = VK_FORMAT_R8_UINT;
+		static const VkFormat distanceFormat = VK_FORMAT_R32_UINT;
+
+		struct Settings {
+			// Outline width in pixels
+			float width = 4.0f;
+			// Opacity of the id's color over the pixels of the mask, 0 to only draw outlines
+			float fillOpacity = 0.0f;
+		};
+
+	private:
+		struct JumpFloodPushConstants {
+			int32_t step;
+		};
+		struct UniformData {
+			glm::vec4 colors[maxIds];
+			float width;
+			float fillOpacity;
+		};
+		struct Image {
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			vks::MemoryAllocation allocation{};
+		};
+		vks::VulkanDevice *device;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		Settings settings;
+		UniformData uniformData{};
+		vks::Buffer uniformBuffer;
+		Image mask;
+		// Ping pong images of the jump flood passes, storing the position of the nearest border pixel as x | (y << 16)
+		Image distances[2];
+		// Index of the distance image holding the result of the last generate()
+		uint32_t resultIndex = 0;
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkRenderPass maskRenderPass = VK_NULL_HANDLE;
+		VkFramebuffer maskFramebuffer = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout computeSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout compositeSetLayout = VK_NULL_HANDLE;
+		// Seed pass writing the first distance image, and jump flood passes reading one distance image and writing the other
+		VkDescriptorSet seedSet = VK_NULL_HANDLE;
+		VkDescriptorSet jumpFloodSets[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+		// Composite reading either distance image
+		VkDescriptorSet compositeSets[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+		VkPipelineLayout computePipelineLayout = VK_NULL_HANDLE;
+		VkPipelineLayout compositePipelineLayout = VK_NULL_HANDLE;
+		VkPipeline seedPipeline = VK_NULL_HANDLE;
+		VkPipeline jumpFloodPipeline = VK_NULL_HANDLE;
+		VkPipeline compositePipeline = VK_NULL_HANDLE;
+		void createImage(Image &image, VkFormat format, VkImageUsageFlags usage);
+		void destroyImage(Image &image);
+		void destroyTargets();
+		void updateUniformBuffer();
+	public:
+		OutlineRenderer(vks::VulkanDevice *device, VkRenderPass renderPass, VkPipelineCache pipelineCache, const std::string &shaderPath, VkSampleCountFlagBits rasterizationSamples = VK_SAMPLE_COUNT_1_BIT, uint32_t subpass = 0);
+		~OutlineRenderer();
+		void resize(uint32_t width, uint32_t height);
+		void setColor(uint32_t id, const glm::vec4 &color);
+		void setSettings(const Settings &settings);
+		const Settings &getSettings() const;
+		uint32_t getPassCount() const;
+		VkRenderPass getMaskRenderPass() const;
+		void beginMask(VkCommandBuffer commandBuffer);
+		void endMask(VkCommandBuffer commandBuffer);
+		void generate(VkCommandBuffer commandBuffer);
+		void draw(VkCommandBuffer commandBuffer);
+	};
+}
@@ -0,0 +1,159 @@
+/*
+* Parallel secondary command buffer recording
+*
+* Splits a draw list across the workers of a thread pool, records the parts into secondary command buffers from per-thread, per-frame
+* command pools and executes them in draw list order inside the primary command buffer's render pass
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanParallelRecorder.h"
+#include <algorithm>
+
+namespace vks
+{
+	/**
+	* @param device Logical device to create the command pools on
+	* @param queueFamilyIndex Queue family the primary command buffers are submitted to
+	* @param threadPool Pool whose workers record the command buffers
+	* @param frameCount Number of frames in flight, the resources of a frame are reused once its submission has finished
+	*/
+	ParallelCommandRecorder::ParallelCommandRecorder(VkDevice device, uint32_t queueFamilyIndex, vks::ThreadPool &threadPool, uint32_t frameCount) : device(device), queueFamilyIndex(queueFamilyIndex), threadPool(threadPool)
+	{
+		frames.resize(std::max(frameCount, 1u));
+	}
+
+	ParallelCommandRecorder::~ParallelCommandRecorder()
+	{
+		// Destroying the pools also frees their command buffers
+		for (auto &frame : frames)
+		{
+			for (auto &thread : frame)
+			{
+				vkDestroyCommandPool(device, thread.commandPool, nullptr);
+			}
+		}
+	}
+
+	/**
+	* Start recording a new frame, resets the command pools of the frame and clears the list of command buffers to execute
+	*
+	* @note The previous submission of the frame's command buffers must have finished executing
+	*/
+	void ParallelCommandRecorder::beginFrame(uint32_t frameIndex)
+	{
+		assert(frameIndex < frames.size());
+		currentFrame = frameIndex;
+		std::vector<ThreadResources> &threads = frames[currentFrame];
+		// One pool per worker plus one for the recording thread, the thread count of the pool may have changed since the last frame
+		const size_t threadCount = threadPool.getThreadCount() + 1;
+		for (size_t i = threads.size(); i < threadCount; i++)
+		{
+			ThreadResources thread;
+			VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+			cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &thread.commandPool));
+			threads.push_back(thread);
+		}
+		// Resetting a whole pool is cheaper than resetting its command buffers one by one
+		for (auto &thread : threads)
+		{
+			if (thread.usedCommandBuffers > 0)
+			{
+				VK_CHECK_RESULT(vkResetCommandPool(device, thread.commandPool, 0));
+				thread.usedCommandBuffers = 0;
+			}
+		}
+		commandBuffers.clear();
+		statistics.recordedCommandBuffers = 0;
+	}
+
+	/**
+	* Record a draw list of count draws into secondary command buffers on the workers of the thread pool and wait for them
+	*
+	* The draw list is split into ranges of grainSize draws, each range is recorded into a command buffer of its own and the command buffers are
+	* appended to the execution list in draw list order. A grainSize of 0 splits the list into about two ranges per thread.
+	*
+	* @param inheritanceInfo Render pass, subpass and framebuffer the command buffers are executed in
+	* @param function Called for every range with the range's command buffer, concurrently on different threads
+	*/
+	void ParallelCommandRecorder::record(size_t count, size_t grainSize, const VkCommandBufferInheritanceInfo &inheritanceInfo, const RecordFunction &function)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		if (grainSize == 0)
+		{
+			grainSize = std::max(count / ((threadPool.getThreadCount() + 1) * 2), (size_t)1);
+		}
+		const size_t rangeCount = (count + grainSize - 1) / grainSize;
+		RecordJob job = { count, grainSize, commandBuffers.size(), &inheritanceInfo, &function };
+		commandBuffers.resize(commandBuffers.size() + rangeCount);
+		// Every range writes its own slot of the execution list, so the order doesn't depend on which worker finishes first
+		vks::JobCounter counter;
+		threadPool.addJobs(static_cast<uint32_t>(rangeCount), [this, &job](uint32_t range) {
+			return [this, &job, range] { recordRange(job, range); };
+		}, &counter);
+		threadPool.wait(counter);
+		statistics.recordedCommandBuffers += static_cast<uint32_t>(rangeCount);
+		statistics.allocatedCommandBuffers = 0;
+		for (auto &frame : frames)
+		{
+			for (auto &thread : frame)
+			{
+				statistics.allocatedCommandBuffers += static_cast<uint32_t>(thread.commandBuffers.size());
+			}
+		}
+	}
+
+	void ParallelCommandRecorder::recordRange(const RecordJob &job, size_t range)
+	{
+		// Only the calling thread uses its pool during this frame
+		ThreadResources &thread = frames[currentFrame][threadPool.getWorkerIndex()];
+		if (thread.usedCommandBuffers == thread.commandBuffers.size())
+		{
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(thread.commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+			VkCommandBuffer commandBuffer;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
+			thread.commandBuffers.push_back(commandBuffer);
+		}
+		VkCommandBuffer commandBuffer = thread.commandBuffers[thread.usedCommandBuffers++];
+
+		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		commandBufferBeginInfo.pInheritanceInfo = job.inheritanceInfo;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+		const size_t begin = range * job.grainSize;
+		(*job.function)(commandBuffer, begin, std::min(begin + job.grainSize, job.count));
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+		commandBuffers[job.firstCommandBuffer + range] = commandBuffer;
+	}
+
+	/** @brief Append a secondary command buffer recorded outside of the recorder (e.g. the UI overlay) to the execution list */
+	void ParallelCommandRecorder::add(VkCommandBuffer commandBuffer)
+	{
+		commandBuffers.push_back(commandBuffer);
+	}
+
+	/** @brief Execute all command buffers of the current frame in order, the primary command buffer must be inside a render pass started with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS */
+	void ParallelCommandRecorder::executeCommands(VkCommandBuffer primaryCommandBuffer)
+	{
+		if (!commandBuffers.empty())
+		{
+			vkCmdExecuteCommands(primaryCommandBuffer, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+		}
+	}
+
+	const std::vector<VkCommandBuffer> &ParallelCommandRecorder::getCommandBuffers() const
+	{
+		return commandBuffers;
+	}
+
+	const ParallelCommandRecorder::Statistics &ParallelCommandRecorder::getStatistics() const
+	{
+		return statistics;
+	}
+}
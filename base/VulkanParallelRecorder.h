@@ -0,0 +1,83 @@
+/*
+* Parallel secondary command buffer recording
+*
+* Splits a draw list across the workers of a thread pool, records the parts into secondary command buffers from per-thread, per-frame
+* command pools and executes them in draw list order inside the primary command buffer's render pass
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <functional>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "threadpool.hpp"
+
+namespace vks
+{
+	/**
+	* Records secondary command buffers for a render pass on the workers of a thread pool
+	*
+	* Each frame in flight has a command pool per worker (and one for the recording thread, which helps out while waiting), so no two
+	* threads ever record from the same pool. beginFrame() resets all pools of a frame at once, command buffers are reused afterwards.
+	*
+	* Typical use for a frame:
+	*	recorder.beginFrame(frameIndex);
+	*	recorder.record(drawCount, 0, inheritanceInfo, [&](VkCommandBuffer commandBuffer, size_t begin, size_t end) { ... });
+	*	recorder.add(uiCommandBuffer);
+	*	recorder.executeCommands(primaryCommandBuffer);
+	*
+	* @note The record function is called concurrently for different ranges and has to set all state (pipelines, viewport, etc.) it needs,
+	* secondary command buffers don't inherit state from the primary command buffer or from each other
+	* @note The recorder itself is not synchronized, all functions have to be called from the same thread
+	*/
+	class ParallelCommandRecorder
+	{
+	public:
+		/** @brief Records the draws [begin, end) of the draw list into the command buffer, which has already been begun */
+		typedef std::function<void(VkCommandBuffer commandBuffer, size_t begin, size_t end)> RecordFunction;
+
+		struct Statistics {
+			/** @brief Secondary command buffers recorded by the recorder in the current frame */
+			uint32_t recordedCommandBuffers = 0;
+			/** @brief Secondary command buffers allocated from all pools of all frames */
+			uint32_t allocatedCommandBuffers = 0;
+		};
+
+		ParallelCommandRecorder(VkDevice device, uint32_t queueFamilyIndex, vks::ThreadPool &threadPool, uint32_t frameCount);
+		~ParallelCommandRecorder();
+		void beginFrame(uint32_t frameIndex);
+		void record(size_t count, size_t grainSize, const VkCommandBufferInheritanceInfo &inheritanceInfo, const RecordFunction &function);
+		void add(VkCommandBuffer commandBuffer);
+		void executeCommands(VkCommandBuffer primaryCommandBuffer);
+		const std::vector<VkCommandBuffer> &getCommandBuffers() const;
+		const Statistics &getStatistics() const;
+	private:
+		struct ThreadResources {
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			// Command buffers of the pool, the first usedCommandBuffers ones have been handed out since the last reset
+			std::vector<VkCommandBuffer> commandBuffers;
+			uint32_t usedCommandBuffers = 0;
+		};
+		// Arguments of a record() call shared by all of its jobs
+		struct RecordJob {
+			size_t count;
+			size_t grainSize;
+			size_t firstCommandBuffer;
+			const VkCommandBufferInheritanceInfo *inheritanceInfo;
+			const RecordFunction *function;
+		};
+		VkDevice device;
+		uint32_t queueFamilyIndex;
+		vks::ThreadPool &threadPool;
+		// Per frame resources of each thread, indexed by the thread pool's worker index
+		std::vector<std::vector<ThreadResources>> frames;
+		uint32_t currentFrame = 0;
+		// Secondary command buffers of the current frame in execution order
+		std::vector<VkCommandBuffer> commandBuffers;
+		Statistics statistics;
+		void recordRange(const RecordJob &job, size_t range);
+	};
+}
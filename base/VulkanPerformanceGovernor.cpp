@@ -0,0 +1,354 @@
+/*
+* Thermal and power aware performance governor
+*
+* Picks a performance level from the device's thermal status (AThermal on Android) and the frame time headroom, each level limiting
+* the frame rate, the dynamic resolution scale and the effect quality, with hysteresis so long running sessions settle on a level
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanPerformanceGovernor.h"
+#include "VulkanTrace.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#if defined(__ANDROID__)
+#include <dlfcn.h>
+#include "VulkanAndroid.h"
+#endif
+
+namespace vks
+{
+	namespace
+	{
+		// Seconds between thermal status polls and frame time headroom checks
+		const double pollInterval = 1.0;
+		// Consecutive intervals over the frame budget before the level is raised, and well under the budget of the level below before it's lowered again
+		const uint32_t raiseIntervals = 3;
+		const uint32_t lowerIntervals = 20;
+		// Over the budget means 10 percent above it, well under means below 75 percent of the lower level's (tighter) budget
+		const double overBudget = 1.1;
+		const double underBudget = 0.75;
+		// Seconds a level has to be held before it may be lowered
+		const double minLevelTime = 30.0;
+		// Frame budget of levels without a frame limit
+		const double defaultFrameBudget = 1000.0 / 60.0;
+
+#if defined(__ANDROID__)
+		// AThermal is only available from API level 30 on, so it's loaded at runtime instead of linked against (see android/thermal.h)
+		typedef void *(*PFN_AThermal_acquireManager)();
+		typedef void (*PFN_AThermal_releaseManager)(void *manager);
+		typedef int32_t (*PFN_AThermal_getCurrentThermalStatus)(void *manager);
+
+		struct ThermalFunctions {
+			PFN_AThermal_acquireManager acquireManager = nullptr;
+			PFN_AThermal_releaseManager releaseManager = nullptr;
+			PFN_AThermal_getCurrentThermalStatus getCurrentThermalStatus = nullptr;
+		};
+
+		const ThermalFunctions &thermalFunctions()
+		{
+			static ThermalFunctions functions = [] {
+				ThermalFunctions loaded;
+				void *libAndroid = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+				if (libAndroid) {
+					loaded.acquireManager = reinterpret_cast<PFN_AThermal_acquireManager>(dlsym(libAndroid, "AThermal_acquireManager"));
+					loaded.releaseManager = reinterpret_cast<PFN_AThermal_releaseManager>(dlsym(libAndroid, "AThermal_releaseManager"));
+					loaded.getCurrentThermalStatus = reinterpret_cast<PFN_AThermal_getCurrentThermalStatus>(dlsym(libAndroid, "AThermal_getCurrentThermalStatus"));
+				}
+				if (!loaded.acquireManager || !loaded.releaseManager || !loaded.getCurrentThermalStatus) {
+					loaded = ThermalFunctions();
+				}
+				return loaded;
+			}();
+			return functions;
+		}
+#endif
+
+		/** @brief Level for a thermal status, light throttling is left to the frame time headroom */
+		PerformanceGovernor::Level thermalStatusLevel(int32_t status)
+		{
+			if (status >= 4) {
+				return PerformanceGovernor::Minimal;
+			}
+			if (status == 3) {
+				return PerformanceGovernor::Reduced;
+			}
+			if (status == 2) {
+				return PerformanceGovernor::Balanced;
+			}
+			return PerformanceGovernor::Full;
+		}
+	}
+
+	PerformanceGovernor::~PerformanceGovernor()
+	{
+#if defined(__ANDROID__)
+		if (thermalManager) {
+			thermalFunctions().releaseManager(thermalManager);
+		}
+#endif
+	}
+
+	/**
+	* Start governing, the Full level keeps the limits the user asked for and the other levels tighten them
+	*
+	* @param frameLimit Frame limiter target in milliseconds the levels are limited to at least, 0 for no limit
+	* @param maxScale Maximum dynamic resolution scale the levels are limited to at most
+	*/
+	void PerformanceGovernor::setup(double frameLimit, float maxScale)
+	{
+		policies[Full].frameLimit = frameLimit;
+		policies[Full].maxScale = maxScale;
+		policies[Full].quality = maxQuality;
+		policies[Balanced].frameLimit = std::max(frameLimit, 1000.0 / 60.0);
+		policies[Balanced].maxScale = std::min(maxScale, 0.85f);
+		policies[Balanced].quality = 1;
+		policies[Reduced].frameLimit = std::max(frameLimit, 1000.0 / 40.0);
+		policies[Reduced].maxScale = std::min(maxScale, 0.7f);
+		policies[Reduced].quality = 1;
+		policies[Minimal].frameLimit = std::max(frameLimit, 1000.0 / 30.0);
+		policies[Minimal].maxScale = std::min(maxScale, 0.5f);
+		policies[Minimal].quality = 0;
+#if defined(__ANDROID__)
+		if (!thermalManager && thermalFunctions().acquireManager) {
+			thermalManager = thermalFunctions().acquireManager();
+		}
+		if (!thermalManager) {
+			LOGW("AThermal is not available, the performance governor only uses the frame time headroom");
+		}
+#endif
+		thermalStatus = pollThermalStatus();
+		thermalLevel = thermalStatusLevel(thermalStatus);
+		headroomLevel = Full;
+		level = Full;
+		levelTime = 0.0;
+		current = LevelMetrics();
+		current.entered = 1;
+		totals = std::array<LevelMetrics, levelCount>();
+		lastUpdate = 0;
+		active = true;
+		// A device that's already hot starts at the level its thermal status asks for
+		if (thermalLevel != Full) {
+			enterLevel(thermalLevel);
+		}
+	}
+
+	bool PerformanceGovernor::isActive() const
+	{
+		return active;
+	}
+
+	/**
+	* Account a frame and change the level at the end of a poll interval if the thermal status or the frame time headroom ask for it
+	*
+	* @param frameTime Time in milliseconds the frame took to record and submit, without the frame limiter's sleep
+	* @return True if the level changed, the caller applies the new policy
+	*/
+	bool PerformanceGovernor::update(double frameTime)
+	{
+		if (!active) {
+			return false;
+		}
+		const uint64_t now = Tracer::now();
+		const double elapsed = (lastUpdate != 0) ? static_cast<double>(now - lastUpdate) / 1000000000.0 : 0.0;
+		lastUpdate = now;
+		levelTime += elapsed;
+		current.time += elapsed;
+		current.frames++;
+		current.frameTimeSum += frameTime;
+		current.frameTimeMax = std::max(current.frameTimeMax, frameTime);
+		intervalTime += elapsed;
+		intervalFrameTimeSum += frameTime;
+		intervalFrames++;
+		if (intervalTime < pollInterval) {
+			return false;
+		}
+		endInterval();
+		const Level target = std::max(thermalLevel, headroomLevel);
+		if (target == level) {
+			return false;
+		}
+		if (target > level) {
+			enterLevel(target);
+			return true;
+		}
+		// Lower one level at a time, and only once the current one has been held for a while
+		if (levelTime < minLevelTime) {
+			return false;
+		}
+		enterLevel(static_cast<Level>(level - 1));
+		return true;
+	}
+
+	PerformanceGovernor::Level PerformanceGovernor::getLevel() const
+	{
+		return level;
+	}
+
+	const PerformanceGovernor::Policy &PerformanceGovernor::getPolicy() const
+	{
+		return policies[level];
+	}
+
+	int32_t PerformanceGovernor::getThermalStatus() const
+	{
+		return thermalStatus;
+	}
+
+	const char *PerformanceGovernor::levelName(Level level)
+	{
+		switch (level) {
+		case Full:
+			return "full";
+		case Balanced:
+			return "balanced";
+		case Reduced:
+			return "reduced";
+		case Minimal:
+			return "minimal";
+		}
+		return "unknown";
+	}
+
+	/** @brief Names of the AThermalStatus values */
+	const char *PerformanceGovernor::thermalStatusName(int32_t status)
+	{
+		switch (status) {
+		case 0:
+			return "none";
+		case 1:
+			return "light";
+		case 2:
+			return "moderate";
+		case 3:
+			return "severe";
+		case 4:
+			return "critical";
+		case 5:
+			return "emergency";
+		case 6:
+			return "shutdown";
+		}
+		return "unavailable";
+	}
+
+	/** @brief Print the time spent at each level and its frame times over the whole session */
+	void PerformanceGovernor::printSummary() const
+	{
+		if (!active) {
+			return;
+		}
+		std::array<LevelMetrics, levelCount> session = totals;
+		session[level].time += current.time;
+		session[level].frames += current.frames;
+		session[level].frameTimeSum += current.frameTimeSum;
+		session[level].frameTimeMax = std::max(session[level].frameTimeMax, current.frameTimeMax);
+		session[level].entered += current.entered;
+		double sessionTime = 0.0;
+		for (auto &metrics : session) {
+			sessionTime += metrics.time;
+		}
+		for (uint32_t i = 0; i < levelCount; i++) {
+			const LevelMetrics &metrics = session[i];
+			if (metrics.entered == 0) {
+				continue;
+			}
+			std::stringstream message;
+			message << std::fixed << std::setprecision(1) << levelName(static_cast<Level>(i)) << ": " << metrics.time << " s ("
+				<< ((sessionTime > 0.0) ? metrics.time * 100.0 / sessionTime : 0.0) << "%), entered " << metrics.entered << " times, " << metrics.frames << " frames";
+			if (metrics.frames > 0) {
+				message << std::setprecision(2) << ", " << metrics.frameTimeSum / static_cast<double>(metrics.frames) << " ms average / " << metrics.frameTimeMax << " ms max frame time";
+			}
+			logLevel(message.str());
+		}
+	}
+
+	/** @return Current AThermalStatus, -1 if it isn't available */
+	int32_t PerformanceGovernor::pollThermalStatus()
+	{
+#if defined(__ANDROID__)
+		if (thermalManager) {
+			return thermalFunctions().getCurrentThermalStatus(thermalManager);
+		}
+#endif
+		return -1;
+	}
+
+	double PerformanceGovernor::frameBudget(Level level) const
+	{
+		return (policies[level].frameLimit > 0.0) ? policies[level].frameLimit : defaultFrameBudget;
+	}
+
+	/** @brief Poll the thermal status and update the headroom level from the frame times of the interval */
+	void PerformanceGovernor::endInterval()
+	{
+		const int32_t status = pollThermalStatus();
+		if ((status != thermalStatus) && (status >= 0)) {
+			logLevel(std::string("thermal status changed to ") + thermalStatusName(status));
+		}
+		thermalStatus = status;
+		thermalLevel = thermalStatusLevel(status);
+
+		const double averageFrameTime = intervalFrameTimeSum / static_cast<double>(std::max(intervalFrames, 1u));
+		if (averageFrameTime > frameBudget(level) * overBudget) {
+			intervalsOverBudget++;
+			intervalsUnderBudget = 0;
+		}
+		else if ((level > Full) && (averageFrameTime < frameBudget(static_cast<Level>(level - 1)) * underBudget)) {
+			intervalsUnderBudget++;
+			intervalsOverBudget = 0;
+		}
+		else {
+			intervalsOverBudget = 0;
+			intervalsUnderBudget = 0;
+		}
+		if ((intervalsOverBudget >= raiseIntervals) && (level < Minimal)) {
+			headroomLevel = static_cast<Level>(level + 1);
+			intervalsOverBudget = 0;
+		}
+		if ((intervalsUnderBudget >= lowerIntervals) && (headroomLevel > Full)) {
+			headroomLevel = static_cast<Level>(headroomLevel - 1);
+			intervalsUnderBudget = 0;
+		}
+
+		intervalTime = 0.0;
+		intervalFrameTimeSum = 0.0;
+		intervalFrames = 0;
+	}
+
+	/** @brief Switch to a level, logging the metrics of the level that's left */
+	void PerformanceGovernor::enterLevel(Level newLevel)
+	{
+		std::stringstream message;
+		message << std::fixed << std::setprecision(1) << levelName(level) << " -> " << levelName(newLevel) << " (thermal status " << thermalStatusName(thermalStatus)
+			<< ", frame time headroom asks for " << levelName(headroomLevel) << "), " << levelName(level) << " was held for " << current.time << " s, " << current.frames << " frames";
+		if (current.frames > 0) {
+			message << std::setprecision(2) << ", " << current.frameTimeSum / static_cast<double>(current.frames) << " ms average / " << current.frameTimeMax << " ms max frame time";
+		}
+		logLevel(message.str());
+
+		LevelMetrics &total = totals[level];
+		total.time += current.time;
+		total.frames += current.frames;
+		total.frameTimeSum += current.frameTimeSum;
+		total.frameTimeMax = std::max(total.frameTimeMax, current.frameTimeMax);
+		total.entered += current.entered;
+		current = LevelMetrics();
+		current.entered = 1;
+		level = newLevel;
+		levelTime = 0.0;
+		intervalsOverBudget = 0;
+		intervalsUnderBudget = 0;
+	}
+
+	void PerformanceGovernor::logLevel(const std::string &message) const
+	{
+#if defined(__ANDROID__)
+		LOGI("Performance governor: %s", message.c_str());
+#else
+		std::cout << "Performance governor: " << message << "\n";
+#endif
+	}
+}
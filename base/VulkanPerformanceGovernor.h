@@ -0,0 +1,103 @@
+/*
+* Thermal and power aware performance governor
+*
+* Picks a performance level from the device's thermal status (AThermal on Android) and the frame time headroom, each level limiting
+* the frame rate, the dynamic resolution scale and the effect quality, with hysteresis so long running sessions settle on a level
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace vks
+{
+	/**
+	* Performance levels driven by the thermal status and the frame time headroom
+	*
+	* Usage:
+	*	// Once, with the frame limit and maximum render scale the user asked for
+	*	governor.setup(settings.frameLimit, dynamicResolution.maxScale);
+	*	// Every frame, with the time the frame took without the frame limiter's sleep
+	*	if (governor.update(frameWorkTime)) {
+	*		const PerformanceGovernor::Policy &policy = governor.getPolicy();
+	*		// Apply policy.frameLimit, policy.maxScale and policy.quality
+	*	}
+	*
+	* The level is the higher of the thermal level (the thermal status, polled once per interval) and the headroom level (raised when
+	* the frames exceed the level's frame budget for a few intervals in a row, lowered when they stay well below it for much longer).
+	* Raising the level takes effect right away, lowering it requires the level to have been held for a minimum time, so a device
+	* that cools down at a lower level doesn't return to the level that heated it up every few seconds.
+	*
+	* @note Without AThermal (platforms other than Android, Android before API level 30) only the frame time headroom is used
+	*/
+	class PerformanceGovernor
+	{
+	public:
+		enum Level : uint32_t { Full = 0, Balanced = 1, Reduced = 2, Minimal = 3 };
+		static const uint32_t levelCount = 4;
+		/** @brief Highest effect quality, passed at the Full level */
+		static const uint32_t maxQuality = 2;
+
+		/** @brief Limits applied at a level */
+		struct Policy {
+			// Frame limiter target in milliseconds, 0 for no limit
+			double frameLimit = 0.0;
+			// Upper limit of the dynamic resolution scale
+			float maxScale = 1.0f;
+			// Effect quality from 0 (lowest) to maxQuality
+			uint32_t quality = maxQuality;
+		};
+
+		~PerformanceGovernor();
+		void setup(double frameLimit, float maxScale);
+		bool isActive() const;
+		bool update(double frameTime);
+		Level getLevel() const;
+		const Policy &getPolicy() const;
+		/** @brief Thermal status of the last poll, from 0 (none) to 6 (shutdown), -1 if unavailable */
+		int32_t getThermalStatus() const;
+		static const char *levelName(Level level);
+		static const char *thermalStatusName(int32_t status);
+		void printSummary() const;
+	private:
+		struct LevelMetrics {
+			double time = 0.0;
+			uint64_t frames = 0;
+			double frameTimeSum = 0.0;
+			double frameTimeMax = 0.0;
+			uint32_t entered = 0;
+		};
+		bool active = false;
+		std::array<Policy, levelCount> policies;
+		Level level = Full;
+		// Level the thermal status asks for, and the level the frame time headroom asks for
+		Level thermalLevel = Full;
+		Level headroomLevel = Full;
+		int32_t thermalStatus = -1;
+		// Time spent at the current level, and the metrics of the current level since it was entered
+		double levelTime = 0.0;
+		LevelMetrics current;
+		// Totals of all visits of each level
+		std::array<LevelMetrics, levelCount> totals;
+		// Frames of the current poll interval
+		double intervalTime = 0.0;
+		double intervalFrameTimeSum = 0.0;
+		uint32_t intervalFrames = 0;
+		// Consecutive intervals over and well under the frame budget
+		uint32_t intervalsOverBudget = 0;
+		uint32_t intervalsUnderBudget = 0;
+		// AThermalManager, only on Android
+		void *thermalManager = nullptr;
+		// Wall clock time of the last update, see vks::Tracer::now()
+		uint64_t lastUpdate = 0;
+		int32_t pollThermalStatus();
+		double frameBudget(Level level) const;
+		void endInterval();
+		void enterLevel(Level newLevel);
+		void logLevel(const std::string &message) const;
+	};
+}
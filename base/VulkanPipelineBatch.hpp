@@ -0,0 +1,193 @@
+/*
+* Batched pipeline creation
+*
+* Compiles a set of graphics and compute pipelines in parallel on the workers of a shared vks::ThreadPool
+*
+* Pipelines using deferred stages of a vks::ShaderModuleCache are first created from the pipeline cache with the module identifiers alone,
+* modules are only created for the pipelines that miss the cache
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "threadpool.hpp"
+#include "VulkanShaderModuleCache.h"
+#include "VulkanStartupReport.h"
+
+namespace vks
+{
+	/**
+	* Collects pipeline create infos and builds them concurrently against a shared pipeline cache
+	*
+	* @note All structures referenced by the create infos (shader stages, states, etc.) must stay valid until build() returns,
+	* so unlike with direct pipeline creation, a single create info can't be modified in place between two add() calls
+	*/
+	class PipelineBatch
+	{
+	private:
+		struct GraphicsJob {
+			VkGraphicsPipelineCreateInfo createInfo;
+			VkPipeline* pipeline;
+			VkResult result;
+			// Copy of the stages if they have to be resolved by the shader module cache
+			std::vector<VkPipelineShaderStageCreateInfo> stages;
+		};
+		struct ComputeJob {
+			VkComputePipelineCreateInfo createInfo;
+			VkPipeline* pipeline;
+			VkResult result;
+		};
+		VkDevice device;
+		VkPipelineCache pipelineCache;
+		std::vector<GraphicsJob> graphicsJobs;
+		std::vector<ComputeJob> computeJobs;
+		vks::ThreadPool* threadPool;
+		vks::ShaderModuleCache* shaderModuleCache;
+
+		void createGraphicsPipeline(uint32_t index)
+		{
+			GraphicsJob& job = graphicsJobs[index];
+			if (job.result == VK_NOT_READY) {
+				VKS_STARTUP_SCOPE(vks::StartupReport::Pipeline, "batched graphics pipeline " + std::to_string(index));
+				job.result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &job.createInfo, nullptr, job.pipeline);
+			}
+		}
+
+		void createComputePipeline(uint32_t index)
+		{
+			ComputeJob& job = computeJobs[index];
+			if (job.result == VK_NOT_READY) {
+				VKS_STARTUP_SCOPE(vks::StartupReport::Pipeline, "batched compute pipeline " + std::to_string(index));
+				job.result = vkCreateComputePipelines(device, pipelineCache, 1, &job.createInfo, nullptr, job.pipeline);
+			}
+		}
+
+		// Create all pipelines that haven't been created yet (result still VK_NOT_READY)
+		void createPending()
+		{
+			uint32_t pendingCount = 0;
+			for (auto& job : graphicsJobs) {
+				pendingCount += (job.result == VK_NOT_READY) ? 1 : 0;
+			}
+			for (auto& job : computeJobs) {
+				pendingCount += (job.result == VK_NOT_READY) ? 1 : 0;
+			}
+			if (pendingCount == 0) {
+				return;
+			}
+			// Nothing to gain from handing a single pipeline to the workers
+			if (pendingCount == 1 || !threadPool || (threadPool->getThreadCount() == 0)) {
+				for (uint32_t i = 0; i < graphicsJobs.size(); i++) {
+					createGraphicsPipeline(i);
+				}
+				for (uint32_t i = 0; i < computeJobs.size(); i++) {
+					createComputePipeline(i);
+				}
+			}
+			else {
+				// Pipeline compile times vary a lot, every pipeline is a job of its own so idle workers can take over pending ones
+				// Only this batch's jobs are waited for, the pool may be busy with other work (the calling thread helps out meanwhile)
+				vks::JobCounter counter;
+				threadPool->addJobs(static_cast<uint32_t>(graphicsJobs.size()), [this](uint32_t index) {
+					return [this, index] {
+						createGraphicsPipeline(index);
+					};
+				}, &counter);
+				threadPool->addJobs(static_cast<uint32_t>(computeJobs.size()), [this](uint32_t index) {
+					return [this, index] {
+						createComputePipeline(index);
+					};
+				}, &counter);
+				threadPool->wait(counter);
+			}
+		}
+	public:
+		/**
+		* @param device Logical device to create the pipelines on
+		* @param pipelineCache Pipeline cache shared by all worker threads (pipeline caches are internally synchronized)
+		* @param (Optional) threadPool Pool whose workers compile the pipelines (e.g. VulkanExampleBase::getThreadPool()), the pipelines are created on the calling thread if none is passed
+		* @param (Optional) shaderModuleCache Cache that created deferred shader stages used by the pipelines
+		*/
+		PipelineBatch(VkDevice device, VkPipelineCache pipelineCache, vks::ThreadPool* threadPool = nullptr, vks::ShaderModuleCache* shaderModuleCache = nullptr)
+			: device(device), pipelineCache(pipelineCache), threadPool(threadPool), shaderModuleCache(shaderModuleCache) {}
+
+		/** @brief Queue a graphics pipeline for creation, the handle is written to pipeline once build() has finished */
+		void add(const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline* pipeline)
+		{
+			graphicsJobs.push_back({ createInfo, pipeline, VK_NOT_READY, {} });
+		}
+
+		/** @brief Queue a compute pipeline for creation, the handle is written to pipeline once build() has finished */
+		void add(const VkComputePipelineCreateInfo& createInfo, VkPipeline* pipeline)
+		{
+			computeJobs.push_back({ createInfo, pipeline, VK_NOT_READY });
+		}
+
+		/** @brief Number of pipelines queued for creation */
+		size_t size() const
+		{
+			return graphicsJobs.size() + computeJobs.size();
+		}
+
+		/**
+		* Create all queued pipelines and return once all of them are ready
+		*
+		* @note Creation results are checked with VK_CHECK_RESULT on the calling thread
+		*/
+		void build()
+		{
+			if (size() == 0) {
+				return;
+			}
+			// Pipelines with deferred stages may only be created from the pipeline cache, which returns VK_PIPELINE_COMPILE_REQUIRED on a miss
+			bool deferred = false;
+			if (shaderModuleCache) {
+				for (auto& job : graphicsJobs) {
+					if (shaderModuleCache->hasDeferredModules(job.createInfo.pStages, job.createInfo.stageCount)) {
+						job.stages.assign(job.createInfo.pStages, job.createInfo.pStages + job.createInfo.stageCount);
+						job.createInfo.pStages = job.stages.data();
+						job.createInfo.flags |= VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT;
+						deferred = true;
+					}
+				}
+				for (auto& job : computeJobs) {
+					if (shaderModuleCache->hasDeferredModules(&job.createInfo.stage, 1)) {
+						job.createInfo.flags |= VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT;
+						deferred = true;
+					}
+				}
+			}
+			createPending();
+			if (deferred) {
+				// Modules are created on the calling thread, only for the cache misses, which are then compiled as usual
+				for (auto& job : graphicsJobs) {
+					if (job.result == VK_PIPELINE_COMPILE_REQUIRED) {
+						shaderModuleCache->resolveModules(job.stages.data(), job.createInfo.stageCount);
+						job.createInfo.flags &= ~VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT;
+						job.result = VK_NOT_READY;
+					}
+				}
+				for (auto& job : computeJobs) {
+					if (job.result == VK_PIPELINE_COMPILE_REQUIRED) {
+						shaderModuleCache->resolveModules(&job.createInfo.stage, 1);
+						job.createInfo.flags &= ~VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT;
+						job.result = VK_NOT_READY;
+					}
+				}
+				createPending();
+			}
+			for (auto& job : graphicsJobs) {
+				VK_CHECK_RESULT(job.result);
+			}
+			for (auto& job : computeJobs) {
+				VK_CHECK_RESULT(job.result);
+			}
+			graphicsJobs.clear();
+			computeJobs.clear();
+		}
+	};
+}
@@ -0,0 +1,281 @@
+/*
+* Post processing stack
+*
+* Single fullscreen pass applying exposure, tone mapping, color grading, vignette and dithering in a configurable order, drawn straight
+* into the render pass that presents the image instead of one pass and intermediate image per effect
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanPostProcess.h"
+#include "VulkanDevice.h"
+#include "VulkanStartupReport.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+
+namespace vks
+{
+	const uint32_t PostProcessStack::maxEffectCount;
+
+	/**
+	* @param device Device to create the pipeline and resources on
+	* @param queue Queue used to upload the identity color grading table
+	* @param renderPass Render pass the stack is drawn in, usually the one writing the swapchain image
+	* @param pipelineCache Pipeline cache used for creating the pipeline
+	* @param vertexShaderFile SPIR-V file of the "base/postprocess.vert" shader
+	* @param fragmentShaderFile SPIR-V file of the "base/postprocess.frag" shader
+	* @param subpass Index of the subpass of the render pass the stack is drawn in
+	*/
+	PostProcessStack::PostProcessStack(vks::VulkanDevice *device, VkQueue queue, VkRenderPass renderPass, VkPipelineCache pipelineCache, const std::string &vertexShaderFile, const std::string &fragmentShaderFile, uint32_t subpass) : device(device)
+	{
+		effectOrder = { Exposure, Tonemap, ColorGrading, Vignette, Dither };
+
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffer, sizeof(UniformData)));
+		VK_CHECK_RESULT(uniformBuffer.map());
+
+		// The input is read with nearest filtering at pixel centers, the lookup table is interpolated between its entries
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.maxLod = 0.0f;
+		samplerCreateInfo.maxAnisotropy = 1.0f;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &inputSampler));
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &lutSampler));
+
+		createIdentityLut(queue);
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+		VkDescriptorImageInfo lutDescriptor = { lutSampler, identityLutView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &lutDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffer.descriptor),
+		};
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		// Fullscreen triangle generated from the vertex index, without blending or depth testing
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStages[0].pName = "main";
+		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderStages[1].pName = "main";
+#if defined(__ANDROID__)
+		shaderStages[0].module = vks::tools::loadShader(androidApp->activity->assetManager, vertexShaderFile.c_str(), device->logicalDevice);
+		shaderStages[1].module = vks::tools::loadShader(androidApp->activity->assetManager, fragmentShaderFile.c_str(), device->logicalDevice);
+#else
+		shaderStages[0].module = vks::tools::loadShader(vertexShaderFile.c_str(), device->logicalDevice);
+		shaderStages[1].module = vks::tools::loadShader(fragmentShaderFile.c_str(), device->logicalDevice);
+#endif
+		assert((shaderStages[0].module != VK_NULL_HANDLE) && (shaderStages[1].module != VK_NULL_HANDLE));
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
+		pipelineCI.pVertexInputState = &vertexInputState;
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		pipelineCI.subpass = subpass;
+		VKS_STARTUP_SCOPE(vks::StartupReport::Pipeline, "post process");
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		for (const VkPipelineShaderStageCreateInfo &shaderStage : shaderStages)
+		{
+			vkDestroyShaderModule(device->logicalDevice, shaderStage.module, nullptr);
+		}
+
+		updateUniformBuffer();
+	}
+
+	PostProcessStack::~PostProcessStack()
+	{
+		vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		vkDestroySampler(device->logicalDevice, inputSampler, nullptr);
+		vkDestroySampler(device->logicalDevice, lutSampler, nullptr);
+		vkDestroyImageView(device->logicalDevice, identityLutView, nullptr);
+		vkDestroyImage(device->logicalDevice, identityLut, nullptr);
+		device->freeMemory(identityLutMemory, identityLutAllocation);
+		uniformBuffer.destroy();
+	}
+
+	void PostProcessStack::createIdentityLut(VkQueue queue)
+	{
+		std::vector<uint8_t> texels(lutSize * lutSize * lutSize * 4);
+		for (uint32_t b = 0; b < lutSize; b++)
+		{
+			for (uint32_t g = 0; g < lutSize; g++)
+			{
+				for (uint32_t r = 0; r < lutSize; r++)
+				{
+					uint8_t *texel = &texels[((b * lutSize + g) * lutSize + r) * 4];
+					texel[0] = static_cast<uint8_t>((r * 255) / (lutSize - 1));
+					texel[1] = static_cast<uint8_t>((g * 255) / (lutSize - 1));
+					texel[2] = static_cast<uint8_t>((b * 255) / (lutSize - 1));
+					texel[3] = 255;
+				}
+			}
+		}
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, texels.size(), texels.data()));
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_3D;
+		imageCI.format = VK_FORMAT_R8G8B8A8_UNORM;
+		imageCI.extent = { lutSize, lutSize, lutSize };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &identityLut));
+		VK_CHECK_RESULT(device->allocateImageMemory(identityLut, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &identityLutMemory, &identityLutAllocation));
+
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vks::tools::setImageLayout(copyCmd, identityLut, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		VkBufferImageCopy copyRegion{};
+		copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.imageExtent = imageCI.extent;
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer.buffer, identityLut, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+		vks::tools::setImageLayout(copyCmd, identityLut, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		device->flushCommandBuffer(copyCmd, queue, true);
+		stagingBuffer.destroy();
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_3D;
+		viewCI.format = imageCI.format;
+		viewCI.image = identityLut;
+		viewCI.subresourceRange = subresourceRange;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &identityLutView));
+	}
+
+	/**
+	* Set the image the stack reads, e.g. the HDR color target of the scene pass
+	*
+	* @param view View of the input image, it's read at the pixel positions of the target so it should have the size of the target
+	* A 2D array view with a layer per view if the stack uses the "base/postprocessmultiview.frag" shader
+	* @param layout Layout of the input image while the stack is drawn, e.g. VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	*
+	* @note Command buffers using the previous input must not be pending
+	*/
+	void PostProcessStack::setInput(VkImageView view, VkImageLayout layout)
+	{
+		VkDescriptorImageInfo inputDescriptor = { inputSampler, view, layout };
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &inputDescriptor);
+		vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+		hasInput = true;
+	}
+
+	/**
+	* Replace the identity color grading table
+	*
+	* @param view View of a 3D image in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, indexed by red (x), green (y) and blue (z)
+	* @param size Number of entries per dimension, used to sample at the entry centers
+	*/
+	void PostProcessStack::setColorGradingLut(VkImageView view, uint32_t size)
+	{
+		VkDescriptorImageInfo lutDescriptor = { lutSampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &lutDescriptor);
+		vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+		lutSize = std::max(size, 2u);
+		updateUniformBuffer();
+	}
+
+	/** @brief Set the enabled effects in the order they are applied, effects not in the list are skipped */
+	void PostProcessStack::setEffectOrder(const std::vector<Effect> &effects)
+	{
+		effectOrder.assign(effects.begin(), effects.begin() + std::min(effects.size(), static_cast<size_t>(maxEffectCount)));
+		updateUniformBuffer();
+	}
+
+	const std::vector<PostProcessStack::Effect> &PostProcessStack::getEffectOrder() const
+	{
+		return effectOrder;
+	}
+
+	bool PostProcessStack::isEnabled(Effect effect) const
+	{
+		return std::find(effectOrder.begin(), effectOrder.end(), effect) != effectOrder.end();
+	}
+
+	/** @brief Upload the effect order and the current settings, call after changing settings */
+	void PostProcessStack::updateUniformBuffer()
+	{
+		UniformData uniformData{};
+		for (size_t i = 0; i < effectOrder.size(); i++)
+		{
+			uniformData.effects[i] = effectOrder[i];
+		}
+		uniformData.effectCount = static_cast<int32_t>(effectOrder.size());
+		uniformData.exposure = settings.exposure;
+		uniformData.colorGradingStrength = settings.colorGradingStrength;
+		uniformData.lutSize = static_cast<float>(lutSize);
+		uniformData.vignetteIntensity = settings.vignetteIntensity;
+		uniformData.vignetteRadius = settings.vignetteRadius;
+		uniformData.ditherStrength = settings.ditherStrength;
+		memcpy(uniformBuffer.mapped, &uniformData, sizeof(UniformData));
+	}
+
+	/**
+	* Draw the stack as a fullscreen triangle into the current subpass
+	*
+	* @note Viewport and scissor have to be set before, they select the part of the target (and input) that is written
+	*/
+	void PostProcessStack::draw(VkCommandBuffer commandBuffer)
+	{
+		if (!hasInput)
+		{
+			return;
+		}
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	}
+}
@@ -0,0 +1,109 @@
+/*
+* Post processing stack
+*
+* Single fullscreen pass applying exposure, tone mapping, color grading, vignette and dithering in a configurable order, drawn straight
+* into the render pass that presents the image instead of one pass and intermediate image per effect
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+#include "VulkanMemoryAllocator.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Post processing uber pass using the "base/postprocess.vert" and "base/postprocess.frag" shaders
+	*
+	* Usage:
+	*	vks::PostProcessStack postProcess(vulkanDevice, queue, renderPass, pipelineCache, getShadersPath() + "base/postprocess.vert.spv", getShadersPath() + "base/postprocess.frag.spv");
+	*	postProcess.setInput(hdrColor.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);	// and again when the input is recreated
+	*	postProcess.setEffectOrder({ vks::PostProcessStack::Exposure, vks::PostProcessStack::Tonemap, vks::PostProcessStack::Dither });
+	*	// Inside the render pass passed to the constructor, e.g. before drawing the UI
+	*	postProcess.draw(commandBuffer);
+	*
+	* The effects run in the order passed to setEffectOrder(), each one on the output of the previous one in registers, so changing the order or
+	* the enabled effects only updates a uniform buffer: no pipeline has to be rebuilt and no command buffer has to be recorded again.
+	* Color grading uses a 3D lookup table in the [0, 1] range, so it should come after tone mapping. Without setColorGradingLut() an identity
+	* table is used.
+	*
+	* Stereo rendering: the stack can be drawn in a multiview render pass, which runs it once for all views. Pass the
+	* "base/postprocessmultiview.frag" shader and a 2D array view with a layer per view to setInput(), each view then reads its own layer.
+	*
+	* @note The pipeline uses dynamic viewport and scissor state
+	*/
+	class PostProcessStack
+	{
+	public:
+		enum Effect : int32_t {
+			Exposure = 0,
+			// ACES filmic curve (Narkowicz fit)
+			Tonemap = 1,
+			ColorGrading = 2,
+			Vignette = 3,
+			// Breaks up banding when quantizing to the 8 bit target
+			Dither = 4,
+		};
+		static const uint32_t maxEffectCount = 8;
+
+		struct Settings {
+			float exposure = 1.0f;
+			// Blend between the input and the graded color
+			float colorGradingStrength = 1.0f;
+			float vignetteIntensity = 0.35f;
+			// Distance from the center (1 = corner) where the vignette starts
+			float vignetteRadius = 0.5f;
+			// Noise amplitude in output units, one 8 bit step by default
+			float ditherStrength = 1.0f / 255.0f;
+		} settings;
+
+	private:
+		// Matches the uniform block of postprocess.frag (std140)
+		struct UniformData {
+			int32_t effects[maxEffectCount];
+			int32_t effectCount;
+			float exposure;
+			float colorGradingStrength;
+			float lutSize;
+			float vignetteIntensity;
+			float vignetteRadius;
+			float ditherStrength;
+		};
+		vks::VulkanDevice *device;
+		std::vector<Effect> effectOrder;
+		vks::Buffer uniformBuffer;
+		// Identity lookup table used until setColorGradingLut() is called
+		VkImage identityLut = VK_NULL_HANDLE;
+		VkDeviceMemory identityLutMemory = VK_NULL_HANDLE;
+		vks::MemoryAllocation identityLutAllocation{};
+		VkImageView identityLutView = VK_NULL_HANDLE;
+		uint32_t lutSize = 16;
+		VkSampler inputSampler = VK_NULL_HANDLE;
+		VkSampler lutSampler = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		bool hasInput = false;
+		void createIdentityLut(VkQueue queue);
+	public:
+		PostProcessStack(vks::VulkanDevice *device, VkQueue queue, VkRenderPass renderPass, VkPipelineCache pipelineCache, const std::string &vertexShaderFile, const std::string &fragmentShaderFile, uint32_t subpass = 0);
+		~PostProcessStack();
+		void setInput(VkImageView view, VkImageLayout layout);
+		void setColorGradingLut(VkImageView view, uint32_t size);
+		void setEffectOrder(const std::vector<Effect> &effects);
+		const std::vector<Effect> &getEffectOrder() const;
+		bool isEnabled(Effect effect) const;
+		void updateUniformBuffer();
+		void draw(VkCommandBuffer commandBuffer);
+	};
+}
@@ -0,0 +1,282 @@
+/*
+* GPU profiler
+*
+* Measures GPU execution times of named scopes inside command buffers using timestamp queries
+* and optionally collects pipeline statistics (shader invocation counts, etc.) per command buffer
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <utility>
+#include "vulkan/vulkan.h"
+#include "VulkanDebug.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* Timestamp query based GPU profiler
+	*
+	* Uses one query pool per command buffer slot (e.g. one per swap chain image / draw command buffer), so it works with
+	* command buffers that are recorded once as well as with command buffers that are re-recorded every frame
+	*
+	* Usage:
+	* - reset() right after beginning a command buffer (must be outside of a render pass)
+	* - beginScope() / endScope() around the passes to measure (scopes may be nested)
+	* - beginStatistics() / endStatistics() around the work to collect pipeline statistics for (optional, both outside of a render pass)
+	* - collect() once the command buffer's last submission has finished execution, results are then stored in results and statistics
+	*/
+	class GpuProfiler
+	{
+	private:
+		struct Slot {
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			VkQueryPool statisticsQueryPool = VK_NULL_HANDLE;
+			bool statisticsRecorded = false;
+			// Names of the scopes in the order they were recorded, scope n uses queries 2n (begin) and 2n+1 (end)
+			std::vector<std::string> scopeNames;
+			std::vector<uint32_t> openScopes;
+		};
+		VkDevice device = VK_NULL_HANDLE;
+		std::vector<Slot> slots;
+		uint32_t maxScopes = 0;
+		double timestampPeriod = 1.0;
+		uint64_t timestampMask = ~0ULL;
+		// Query results read by collect(), kept to not allocate every frame
+		std::vector<uint64_t> queryData;
+		std::vector<uint64_t> statisticsData;
+		// Only statistics that don't depend on optional shader stage features are queried
+		const VkQueryPipelineStatisticFlags statisticFlags =
+			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+	public:
+		/** @brief True if the graphics queue supports timestamps and the profiler has been prepared */
+		bool supported = false;
+		/** @brief GPU time in milliseconds for each scope of the most recently collected command buffer (in recording order) */
+		std::vector<std::pair<std::string, double>> results;
+		/** @brief Start of each scope in results in milliseconds after the start of the first one, for placing the scopes on a timeline */
+		std::vector<double> resultOffsets;
+		/** @brief True if pipeline statistics queries are enabled on the device and have been requested in prepare() */
+		bool statisticsSupported = false;
+		/** @brief Pipeline statistics of the most recently collected command buffer, in the order of statisticNames(), empty if not available */
+		std::vector<uint64_t> statistics;
+
+		/** @brief Names of the collected pipeline statistics */
+		static const std::vector<std::string>& statisticNames()
+		{
+			static const std::vector<std::string> names = { "input assembly vertices", "input assembly primitives", "vertex shader invocations", "clipping invocations", "clipping primitives", "fragment shader invocations", "compute shader invocations" };
+			return names;
+		}
+
+		/**
+		* Create the timestamp query pools
+		*
+		* @param vulkanDevice Device to create the query pools on
+		* @param slotCount Number of command buffers that can be profiled independently
+		* @param (Optional) maxScopeCount Maximum number of scopes per command buffer (Defaults to 32)
+		* @param (Optional) pipelineStatistics Also create pipeline statistics queries, requires the pipelineStatisticsQuery feature to be enabled (Defaults to false)
+		*/
+		void prepare(vks::VulkanDevice* vulkanDevice, uint32_t slotCount, uint32_t maxScopeCount = 32, bool pipelineStatistics = false)
+		{
+			destroy();
+			device = vulkanDevice->logicalDevice;
+			const uint32_t timestampValidBits = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits;
+			supported = (timestampValidBits > 0) && (vulkanDevice->properties.limits.timestampPeriod > 0.0f);
+			statisticsSupported = pipelineStatistics && vulkanDevice->enabledFeatures.pipelineStatisticsQuery;
+			if (!supported && !statisticsSupported) {
+				return;
+			}
+			maxScopes = maxScopeCount;
+			timestampPeriod = vulkanDevice->properties.limits.timestampPeriod;
+			timestampMask = (timestampValidBits >= 64) ? ~0ULL : ((1ULL << timestampValidBits) - 1);
+			slots.resize(slotCount);
+			VkQueryPoolCreateInfo queryPoolCI{};
+			queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolCI.queryCount = maxScopes * 2;
+			VkQueryPoolCreateInfo statisticsQueryPoolCI{};
+			statisticsQueryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			statisticsQueryPoolCI.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			statisticsQueryPoolCI.pipelineStatistics = statisticFlags;
+			statisticsQueryPoolCI.queryCount = 1;
+			for (auto& slot : slots) {
+				if (supported) {
+					VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCI, nullptr, &slot.queryPool));
+				}
+				if (statisticsSupported) {
+					VK_CHECK_RESULT(vkCreateQueryPool(device, &statisticsQueryPoolCI, nullptr, &slot.statisticsQueryPool));
+				}
+			}
+			// Queries must have been reset once before their results can be read, even if they are unavailable
+			VkCommandBuffer cmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			for (auto& slot : slots) {
+				if (supported) {
+					vkCmdResetQueryPool(cmdBuffer, slot.queryPool, 0, maxScopes * 2);
+				}
+				if (statisticsSupported) {
+					vkCmdResetQueryPool(cmdBuffer, slot.statisticsQueryPool, 0, 1);
+				}
+			}
+			VkQueue queue;
+			vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
+			vulkanDevice->flushCommandBuffer(cmdBuffer, queue);
+		}
+
+		/** @brief Destroy all query pools */
+		void destroy()
+		{
+			for (auto& slot : slots) {
+				if (slot.queryPool != VK_NULL_HANDLE) {
+					vkDestroyQueryPool(device, slot.queryPool, nullptr);
+				}
+				if (slot.statisticsQueryPool != VK_NULL_HANDLE) {
+					vkDestroyQueryPool(device, slot.statisticsQueryPool, nullptr);
+				}
+			}
+			slots.clear();
+			results.clear();
+			resultOffsets.clear();
+			statistics.clear();
+			supported = false;
+			statisticsSupported = false;
+		}
+
+		/** @brief Reset the queries of a slot, must be recorded at the start of the command buffer and outside of a render pass */
+		void reset(VkCommandBuffer commandBuffer, uint32_t slotIndex)
+		{
+			if (slots.empty()) {
+				return;
+			}
+			Slot& slot = slots[slotIndex];
+			if (supported) {
+				vkCmdResetQueryPool(commandBuffer, slot.queryPool, 0, maxScopes * 2);
+			}
+			if (statisticsSupported) {
+				vkCmdResetQueryPool(commandBuffer, slot.statisticsQueryPool, 0, 1);
+			}
+			slot.scopeNames.clear();
+			slot.openScopes.clear();
+			slot.statisticsRecorded = false;
+		}
+
+		/** @brief Start collecting pipeline statistics, must be recorded outside of a render pass */
+		void beginStatistics(VkCommandBuffer commandBuffer, uint32_t slotIndex)
+		{
+			if (!statisticsSupported) {
+				return;
+			}
+			vkCmdBeginQuery(commandBuffer, slots[slotIndex].statisticsQueryPool, 0, 0);
+		}
+
+		/** @brief Stop collecting pipeline statistics, must be recorded outside of a render pass */
+		void endStatistics(VkCommandBuffer commandBuffer, uint32_t slotIndex)
+		{
+			if (!statisticsSupported) {
+				return;
+			}
+			vkCmdEndQuery(commandBuffer, slots[slotIndex].statisticsQueryPool, 0);
+			slots[slotIndex].statisticsRecorded = true;
+		}
+
+		/** @brief Write the start timestamp of a named scope, the scope is also a debug utils label for capture tools */
+		void beginScope(VkCommandBuffer commandBuffer, uint32_t slotIndex, const std::string& name)
+		{
+			// Labels are emitted regardless of timestamp support and the scope limit, so they stay balanced with endScope()
+			vks::debugutils::cmdBeginLabel(commandBuffer, name.c_str(), glm::vec4(0.4f, 0.6f, 1.0f, 1.0f));
+			if (!supported) {
+				return;
+			}
+			Slot& slot = slots[slotIndex];
+			if (slot.scopeNames.size() >= maxScopes) {
+				std::cerr << "GPU profiler scope limit of " << maxScopes << " reached, scope \"" << name << "\" is ignored\n";
+				return;
+			}
+			const uint32_t scopeIndex = static_cast<uint32_t>(slot.scopeNames.size());
+			slot.scopeNames.push_back(name);
+			slot.openScopes.push_back(scopeIndex);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.queryPool, scopeIndex * 2);
+		}
+
+		/** @brief Write the end timestamp of the most recently opened scope */
+		void endScope(VkCommandBuffer commandBuffer, uint32_t slotIndex)
+		{
+			vks::debugutils::cmdEndLabel(commandBuffer);
+			if (!supported) {
+				return;
+			}
+			Slot& slot = slots[slotIndex];
+			if (slot.openScopes.empty()) {
+				return;
+			}
+			const uint32_t scopeIndex = slot.openScopes.back();
+			slot.openScopes.pop_back();
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.queryPool, scopeIndex * 2 + 1);
+		}
+
+		/**
+		* Read back the timestamps of a slot's last execution
+		*
+		* @note The command buffer of the slot must not be pending execution
+		*
+		* @return True if results for at least one scope were available
+		*/
+		bool collect(uint32_t slotIndex)
+		{
+			results.clear();
+			resultOffsets.clear();
+			statistics.clear();
+			if (slots.empty()) {
+				return false;
+			}
+			const Slot& slot = slots[slotIndex];
+			if (statisticsSupported && slot.statisticsRecorded) {
+				// The statistics values are followed by the query's availability
+				const size_t statisticCount = statisticNames().size();
+				statisticsData.resize(statisticCount + 1);
+				VkResult result = vkGetQueryPoolResults(device, slot.statisticsQueryPool, 0, 1, statisticsData.size() * sizeof(uint64_t), statisticsData.data(), statisticsData.size() * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+				if ((result != VK_SUCCESS) && (result != VK_NOT_READY)) {
+					VK_CHECK_RESULT(result);
+				}
+				if (statisticsData[statisticCount] != 0) {
+					statistics.assign(statisticsData.begin(), statisticsData.begin() + statisticCount);
+				}
+			}
+			if (!supported || slot.scopeNames.empty()) {
+				return false;
+			}
+			const uint32_t queryCount = static_cast<uint32_t>(slot.scopeNames.size()) * 2;
+			// Each query returns its value followed by its availability
+			queryData.resize(queryCount * 2);
+			VkResult result = vkGetQueryPoolResults(device, slot.queryPool, 0, queryCount, queryData.size() * sizeof(uint64_t), queryData.data(), sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+			if ((result != VK_SUCCESS) && (result != VK_NOT_READY)) {
+				VK_CHECK_RESULT(result);
+			}
+			uint64_t firstBegin = 0;
+			for (size_t i = 0; i < slot.scopeNames.size(); i++) {
+				const uint64_t* begin = &queryData[i * 4];
+				const uint64_t* end = &queryData[i * 4 + 2];
+				if ((begin[1] == 0) || (end[1] == 0)) {
+					continue;
+				}
+				if (results.empty()) {
+					firstBegin = begin[0];
+				}
+				const uint64_t ticks = (end[0] - begin[0]) & timestampMask;
+				results.push_back(std::make_pair(slot.scopeNames[i], static_cast<double>(ticks) * timestampPeriod / 1000000.0));
+				resultOffsets.push_back(static_cast<double>((begin[0] - firstBegin) & timestampMask) * timestampPeriod / 1000000.0);
+			}
+			return !results.empty();
+		}
+	};
+}
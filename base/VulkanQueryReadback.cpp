@@ -0,0 +1,161 @@
+/*
+* Non-blocking query readback
+*
+* Copies the results of occlusion, pipeline statistics or timestamp queries into a persistently mapped host buffer on the GPU timeline,
+* so they can be read frames later without waiting for the queries in vkGetQueryPoolResults
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanQueryReadback.h"
+#include "VulkanDevice.h"
+#include <cstring>
+#include <assert.h>
+
+namespace vks
+{
+	/**
+	* @param device Device to create the query pools and the result buffer on
+	* @param queryType Type of the queries, VK_QUERY_TYPE_PIPELINE_STATISTICS requires the pipelineStatisticsQuery feature to be enabled
+	* @param queryCount Number of queries per slot
+	* @param slotCount Number of slots, usually the number of command buffers recording queries
+	* @param pipelineStatistics Statistics to collect for VK_QUERY_TYPE_PIPELINE_STATISTICS queries, results are in the order of the flag bits
+	*/
+	QueryReadback::QueryReadback(vks::VulkanDevice *device, VkQueryType queryType, uint32_t queryCount, uint32_t slotCount, VkQueryPipelineStatisticFlags pipelineStatistics) : device(device), queryType(queryType), queryCount(queryCount)
+	{
+		assert((queryCount > 0) && (slotCount > 0));
+		valuesPerQuery = 1;
+		if (queryType == VK_QUERY_TYPE_PIPELINE_STATISTICS)
+		{
+			assert(pipelineStatistics != 0);
+			valuesPerQuery = 0;
+			for (VkQueryPipelineStatisticFlags flags = pipelineStatistics; flags != 0; flags &= flags - 1)
+			{
+				valuesPerQuery++;
+			}
+		}
+		slotSize = sizeof(uint64_t) * (valuesPerQuery + 1) * queryCount;
+
+		queryPools.resize(slotCount);
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = queryType;
+		queryPoolInfo.queryCount = queryCount;
+		queryPoolInfo.pipelineStatistics = (queryType == VK_QUERY_TYPE_PIPELINE_STATISTICS) ? pipelineStatistics : 0;
+		for (auto &queryPool : queryPools)
+		{
+			VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolInfo, nullptr, &queryPool));
+		}
+
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&buffer,
+			slotSize * slotCount));
+		VK_CHECK_RESULT(buffer.map());
+		// Zero availability until a slot's results have been copied
+		memset(buffer.mapped, 0, slotSize * slotCount);
+	}
+
+	QueryReadback::~QueryReadback()
+	{
+		for (auto &queryPool : queryPools)
+		{
+			vkDestroyQueryPool(device->logicalDevice, queryPool, nullptr);
+		}
+		buffer.destroy();
+	}
+
+	/** @brief Reset all queries of a slot, must be recorded outside of a render pass before the queries are used */
+	void QueryReadback::reset(VkCommandBuffer commandBuffer, uint32_t slot)
+	{
+		vkCmdResetQueryPool(commandBuffer, queryPools[slot], 0, queryCount);
+	}
+
+	void QueryReadback::begin(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t query, VkQueryControlFlags flags)
+	{
+		assert(query < queryCount);
+		vkCmdBeginQuery(commandBuffer, queryPools[slot], query, flags);
+	}
+
+	void QueryReadback::end(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t query)
+	{
+		assert(query < queryCount);
+		vkCmdEndQuery(commandBuffer, queryPools[slot], query);
+	}
+
+	void QueryReadback::writeTimestamp(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t query, VkPipelineStageFlagBits stage)
+	{
+		assert((queryType == VK_QUERY_TYPE_TIMESTAMP) && (query < queryCount));
+		vkCmdWriteTimestamp(commandBuffer, stage, queryPools[slot], query);
+	}
+
+	/**
+	* Copy the results of all queries of a slot into its region of the host buffer
+	*
+	* @note Must be recorded outside of a render pass after all queries of the slot have ended
+	*/
+	void QueryReadback::copyResults(VkCommandBuffer commandBuffer, uint32_t slot)
+	{
+		// The GPU waits for the queries, the host only reads the copy after the submission has finished
+		vkCmdCopyQueryPoolResults(
+			commandBuffer,
+			queryPools[slot],
+			0,
+			queryCount,
+			buffer.buffer,
+			slotSize * slot,
+			sizeof(uint64_t) * (valuesPerQuery + 1),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.buffer = buffer.buffer;
+		bufferBarrier.offset = slotSize * slot;
+		bufferBarrier.size = slotSize;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+	}
+
+	/**
+	* Results of the last completed submission of a slot
+	*
+	* @param slot Slot whose last submission has finished execution
+	* @param results Receives getValuesPerQuery() values per query, left untouched if the results are not available
+	*
+	* @return True if the results of all queries have been available
+	*/
+	bool QueryReadback::getResults(uint32_t slot, std::vector<uint64_t> &results) const
+	{
+		const uint64_t *data = reinterpret_cast<const uint64_t*>(static_cast<const uint8_t*>(buffer.mapped) + slotSize * slot);
+		for (uint32_t query = 0; query < queryCount; query++)
+		{
+			if (data[query * (valuesPerQuery + 1) + valuesPerQuery] == 0)
+			{
+				return false;
+			}
+		}
+		results.resize(queryCount * valuesPerQuery);
+		for (uint32_t query = 0; query < queryCount; query++)
+		{
+			memcpy(&results[query * valuesPerQuery], &data[query * (valuesPerQuery + 1)], sizeof(uint64_t) * valuesPerQuery);
+		}
+		return true;
+	}
+
+	VkQueryPool QueryReadback::getQueryPool(uint32_t slot) const
+	{
+		return queryPools[slot];
+	}
+
+	uint32_t QueryReadback::getSlotCount() const
+	{
+		return static_cast<uint32_t>(queryPools.size());
+	}
+
+	/** @brief Number of result values per query, the number of enabled statistics for pipeline statistics queries and 1 otherwise */
+	uint32_t QueryReadback::getValuesPerQuery() const
+	{
+		return valuesPerQuery;
+	}
+}
@@ -0,0 +1,68 @@
+/*
+* Non-blocking query readback
+*
+* Copies the results of occlusion, pipeline statistics or timestamp queries into a persistently mapped host buffer on the GPU timeline,
+* so they can be read frames later without waiting for the queries in vkGetQueryPoolResults
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Query pools with one slot per command buffer (e.g. per swap chain image or frame in flight)
+	*
+	* Usage:
+	*	queries.reset(new vks::QueryReadback(vulkanDevice, VK_QUERY_TYPE_OCCLUSION, 2, static_cast<uint32_t>(drawCmdBuffers.size())));
+	*	// Recording, reset() and copyResults() outside of a render pass
+	*	queries->reset(commandBuffer, i);
+	*	queries->begin(commandBuffer, i, 0);
+	*	...
+	*	queries->end(commandBuffer, i, 0);
+	*	queries->copyResults(commandBuffer, i);
+	*	// After prepareFrame() has waited for the last submission of the command buffer
+	*	queries->getResults(currentBuffer, results);
+	*
+	* Each slot has a query pool of its own, so recording and submitting a command buffer doesn't touch the queries of command buffers that
+	* may still be in flight. copyResults() copies the results of all queries of a slot with their availability into the slot's region of
+	* the host buffer with vkCmdCopyQueryPoolResults. The wait for the queries happens on the GPU timeline, the host reads the copy of a
+	* slot's last completed submission, which is one slot count of frames old.
+	*
+	* @note A slot's results must only be read once its last submission has finished execution, like vks::GpuProfiler::collect()
+	* @note getResults() returns false until every query of a slot has been written by a completed submission
+	*/
+	class QueryReadback
+	{
+	private:
+		vks::VulkanDevice *device;
+		VkQueryType queryType;
+		uint32_t queryCount;
+		// Query pool per slot
+		std::vector<VkQueryPool> queryPools;
+		// Values per query (number of enabled statistics for pipeline statistics queries) followed by the availability value
+		uint32_t valuesPerQuery;
+		VkDeviceSize slotSize;
+		vks::Buffer buffer;
+	public:
+		QueryReadback(vks::VulkanDevice *device, VkQueryType queryType, uint32_t queryCount, uint32_t slotCount, VkQueryPipelineStatisticFlags pipelineStatistics = 0);
+		~QueryReadback();
+		void reset(VkCommandBuffer commandBuffer, uint32_t slot);
+		void begin(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t query, VkQueryControlFlags flags = 0);
+		void end(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t query);
+		void writeTimestamp(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t query, VkPipelineStageFlagBits stage);
+		void copyResults(VkCommandBuffer commandBuffer, uint32_t slot);
+		bool getResults(uint32_t slot, std::vector<uint64_t> &results) const;
+		VkQueryPool getQueryPool(uint32_t slot) const;
+		uint32_t getSlotCount() const;
+		uint32_t getValuesPerQuery() const;
+	};
+}
@@ -0,0 +1,267 @@
+/*
+* GPU radix sort
+*
+* Stable key/value sort of 32 bit keys in compute shaders, for sorting particles by depth, items by bin or points along a space filling curve
+* without reading them back to the host
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanRadixSort.h"
+#include "VulkanDevice.h"
+#include <algorithm>
+
+namespace vks
+{
+	const uint32_t RadixSort::radixBits;
+	const uint32_t RadixSort::blockSize;
+
+	/**
+	* @param device Device to create the compute pipelines on
+	* @param histogramShaderFile SPIR-V file of the "base/radixsort_histogram.comp" shader
+	* @param scanShaderFile SPIR-V file of the "base/radixsort_scan.comp" shader
+	* @param scatterShaderFile SPIR-V file of the "base/radixsort_scatter.comp" shader
+	* @param apiVersion Vulkan API version the instance has been created with
+	*
+	* @note If the device doesn't meet the requirements or a shader can't be loaded, no pipelines are created and isSupported() returns false
+	*/
+	RadixSort::RadixSort(vks::VulkanDevice *device, const std::string &histogramShaderFile, const std::string &scanShaderFile, const std::string &scatterShaderFile, uint32_t apiVersion) : device(device)
+	{
+		// Subgroup operations are core in Vulkan 1.1 and need to be supported by both the instance and the device
+		if ((apiVersion < VK_API_VERSION_1_1) || (device->properties.apiVersion < VK_API_VERSION_1_1))
+		{
+			return;
+		}
+		VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+		subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+		VkPhysicalDeviceProperties2 deviceProperties2{};
+		deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		deviceProperties2.pNext = &subgroupProperties;
+		vkGetPhysicalDeviceProperties2(device->physicalDevice, &deviceProperties2);
+		// The shaders keep the sums of up to 64 subgroups per work group
+		if (!(subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) || !(subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT) || (subgroupProperties.subgroupSize < 4))
+		{
+			return;
+		}
+
+#if defined(__ANDROID__)
+		histogramModule = vks::tools::loadShader(androidApp->activity->assetManager, histogramShaderFile.c_str(), device->logicalDevice);
+		scanModule = vks::tools::loadShader(androidApp->activity->assetManager, scanShaderFile.c_str(), device->logicalDevice);
+		scatterModule = vks::tools::loadShader(androidApp->activity->assetManager, scatterShaderFile.c_str(), device->logicalDevice);
+#else
+		histogramModule = vks::tools::loadShader(histogramShaderFile.c_str(), device->logicalDevice);
+		scanModule = vks::tools::loadShader(scanShaderFile.c_str(), device->logicalDevice);
+		scatterModule = vks::tools::loadShader(scatterShaderFile.c_str(), device->logicalDevice);
+#endif
+		if ((histogramModule == VK_NULL_HANDLE) || (scanModule == VK_NULL_HANDLE) || (scatterModule == VK_NULL_HANDLE))
+		{
+			return;
+		}
+
+		// Source keys and values, destination keys and values, block histograms
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings;
+		for (uint32_t binding = 0; binding < 5; binding++)
+		{
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, binding));
+		}
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCI.stage.pName = "main";
+		pipelineCI.stage.module = histogramModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &histogramPipeline));
+		pipelineCI.stage.module = scanModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &scanPipeline));
+		pipelineCI.stage.module = scatterModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &scatterPipeline));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+		VkDescriptorSetLayout setLayouts[2] = { descriptorSetLayout, descriptorSetLayout };
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, setLayouts, 2);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, descriptorSets));
+
+		supported = true;
+	}
+
+	RadixSort::~RadixSort()
+	{
+		destroyBuffers();
+		if (histogramPipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, histogramPipeline, nullptr);
+		}
+		if (scanPipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, scanPipeline, nullptr);
+		}
+		if (scatterPipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, scatterPipeline, nullptr);
+		}
+		if (pipelineLayout)
+		{
+			vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		}
+		if (descriptorPool)
+		{
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		}
+		if (descriptorSetLayout)
+		{
+			vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		}
+		if (histogramModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, histogramModule, nullptr);
+		}
+		if (scanModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, scanModule, nullptr);
+		}
+		if (scatterModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, scatterModule, nullptr);
+		}
+	}
+
+	void RadixSort::destroyBuffers()
+	{
+		scratchKeys.destroy();
+		scratchValues.destroy();
+		blockHistograms.destroy();
+		scratchKeys = vks::Buffer();
+		scratchValues = vks::Buffer();
+		blockHistograms = vks::Buffer();
+		keys = VK_NULL_HANDLE;
+		values = VK_NULL_HANDLE;
+		maxCount = 0;
+	}
+
+	/** @brief True if the device supports the subgroup operations and all pipelines have been created */
+	bool RadixSort::isSupported() const
+	{
+		return supported;
+	}
+
+	/**
+	* Set the buffers to sort, allocating the scratch buffers for up to maxCount elements
+	*
+	* @param keys Buffer with at least maxCount 32 bit keys
+	* @param values Buffer with at least maxCount 32 bit values, reordered along with the keys (e.g. element indices)
+	* @param maxCount Maximum number of elements passed to record()
+	*
+	* @note Command buffers recorded with the previous buffers must not be in use anymore
+	*/
+	void RadixSort::setBuffers(VkBuffer keys, VkBuffer values, uint32_t maxCount)
+	{
+		if (!supported)
+		{
+			return;
+		}
+		destroyBuffers();
+		this->keys = keys;
+		this->values = values;
+		this->maxCount = std::max(maxCount, 1u);
+		const uint32_t blockCount = (this->maxCount + blockSize - 1) / blockSize;
+		const VkDeviceSize size = sizeof(uint32_t) * this->maxCount;
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &scratchKeys, size));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &scratchValues, size));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &blockHistograms, sizeof(uint32_t) * (1 << radixBits) * blockCount));
+
+		VkDescriptorBufferInfo keysDescriptor = { keys, 0, size };
+		VkDescriptorBufferInfo valuesDescriptor = { values, 0, size };
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			// Even passes read the sorted buffers and write the scratch buffers, odd passes the other way round
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, (i == 0) ? &keysDescriptor : &scratchKeys.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, (i == 0) ? &valuesDescriptor : &scratchValues.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, (i == 0) ? &scratchKeys.descriptor : &keysDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, (i == 0) ? &scratchValues.descriptor : &valuesDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &blockHistograms.descriptor),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+	}
+
+	/**
+	* Record the sort of the first count elements of the buffers passed to setBuffers(), outside of a render pass
+	*
+	* @param commandBuffer Command buffer on a compute capable queue
+	* @param count Number of elements to sort, at most the maxCount passed to setBuffers()
+	* @param keyBits Number of significant (lowest) key bits, the other bits are ignored
+	* @param dstStageMask Stages that read the sorted keys or values after the sort
+	* @param dstAccessMask Accesses of those stages, e.g. VK_ACCESS_INDEX_READ_BIT for drawing sorted element indices
+	*
+	* @note Key and value writes from compute shaders are made visible by record(), other writes (e.g. transfers) need a barrier before it
+	* @note The sorted keys and values end up in the passed buffers, an odd number of passes ends with a copy from the scratch buffers
+	*/
+	void RadixSort::record(VkCommandBuffer commandBuffer, uint32_t count, uint32_t keyBits, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+	{
+		if (!supported || (keys == VK_NULL_HANDLE) || (count < 2))
+		{
+			return;
+		}
+		count = std::min(count, maxCount);
+		const uint32_t passCount = (std::min(keyBits, 32u) + radixBits - 1) / radixBits;
+		const uint32_t blockCount = (count + blockSize - 1) / blockSize;
+
+		// Also orders this sort after the previous one reusing the scratch buffers
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		PushConstants pushConstants{};
+		pushConstants.count = count;
+		for (uint32_t pass = 0; pass < passCount; pass++)
+		{
+			pushConstants.shift = pass * radixBits;
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[pass % 2], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, histogramPipeline);
+			vkCmdDispatch(commandBuffer, blockCount, 1, 1);
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, scanPipeline);
+			vkCmdDispatch(commandBuffer, 1, 1, 1);
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, scatterPipeline);
+			vkCmdDispatch(commandBuffer, blockCount, 1, 1);
+			if (pass < passCount - 1)
+			{
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+		}
+
+		VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		if ((passCount % 2) == 1)
+		{
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			VkBufferCopy copyRegion = { 0, 0, sizeof(uint32_t) * count };
+			vkCmdCopyBuffer(commandBuffer, scratchKeys.buffer, keys, 1, &copyRegion);
+			vkCmdCopyBuffer(commandBuffer, scratchValues.buffer, values, 1, &copyRegion);
+			srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		}
+		memoryBarrier.dstAccessMask = dstAccessMask;
+		vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+}
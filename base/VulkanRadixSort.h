@@ -0,0 +1,76 @@
+/*
+* GPU radix sort
+*
+* Stable key/value sort of 32 bit keys in compute shaders, for sorting particles by depth, items by bin or points along a space filling curve
+* without reading them back to the host
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Least significant digit radix sort using the "base/radixsort_histogram.comp", "base/radixsort_scan.comp" and "base/radixsort_scatter.comp" compute shaders
+	*
+	* Usage:
+	*	vks::RadixSort radixSort(vulkanDevice, getShadersPath() + "base/radixsort_histogram.comp.spv", getShadersPath() + "base/radixsort_scan.comp.spv", getShadersPath() + "base/radixsort_scatter.comp.spv", apiVersion);
+	*	radixSort.setBuffers(keys.buffer, values.buffer, maxCount);	// and again when the buffers are recreated
+	*	// Outside of a render pass, e.g. with 16 bit depth keys
+	*	radixSort.record(commandBuffer, count, 16, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+	*
+	* Every pass sorts the keys by radixBits of their bits with three dispatches: digit counts per block of blockSize keys, a single work group
+	* prefix sum of those counts giving each block's output offset per digit, and a scatter that sorts each block by the digit in shared memory
+	* before writing it, so the writes of a digit are contiguous. The block level prefix sums use subgroup arithmetic.
+	* Sorting fewer key bits needs fewer passes, padding elements can be keyed with 0xffffffff to sort them behind all others.
+	*
+	* @note Requires a Vulkan 1.1 instance and subgroup arithmetic operations in compute shaders
+	* @note Keys and values need VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, and VK_BUFFER_USAGE_TRANSFER_DST_BIT if an odd number of passes is recorded
+	*/
+	class RadixSort
+	{
+	private:
+		struct PushConstants {
+			uint32_t shift;
+			uint32_t count;
+		};
+		vks::VulkanDevice *device;
+		bool supported = false;
+		uint32_t maxCount = 0;
+		VkBuffer keys = VK_NULL_HANDLE;
+		VkBuffer values = VK_NULL_HANDLE;
+		// Destination of every other pass
+		vks::Buffer scratchKeys;
+		vks::Buffer scratchValues;
+		vks::Buffer blockHistograms;
+		VkShaderModule histogramModule = VK_NULL_HANDLE;
+		VkShaderModule scanModule = VK_NULL_HANDLE;
+		VkShaderModule scatterModule = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		// Passes from the sorted buffers to the scratch buffers and back
+		VkDescriptorSet descriptorSets[2] = {};
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline histogramPipeline = VK_NULL_HANDLE;
+		VkPipeline scanPipeline = VK_NULL_HANDLE;
+		VkPipeline scatterPipeline = VK_NULL_HANDLE;
+		void destroyBuffers();
+	public:
+		static const uint32_t radixBits = 4;
+		static const uint32_t blockSize = 256;
+
+		RadixSort(vks::VulkanDevice *device, const std::string &histogramShaderFile, const std::string &scanShaderFile, const std::string &scatterShaderFile, uint32_t apiVersion);
+		~RadixSort();
+		bool isSupported() const;
+		void setBuffers(VkBuffer keys, VkBuffer values, uint32_t maxCount);
+		void record(VkCommandBuffer commandBuffer, uint32_t count, uint32_t keyBits = 32, VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VkAccessFlags dstAccessMask = VK_ACCESS_SHADER_READ_BIT);
+	};
+}
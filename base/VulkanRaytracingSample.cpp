@@ -7,6 +7,8 @@
 */
 
 #include "VulkanRaytracingSample.h"
+#include "VulkanglTFModel.h"
+#include <map>
 
 void VulkanRaytracingSample::updateRenderPass()
 {
@@ -126,7 +128,7 @@ VulkanRaytracingSample::ScratchBuffer VulkanRaytracingSample::createScratchBuffe
 	memoryAllocateInfo.pNext = &memoryAllocateFlagsInfo;
 	memoryAllocateInfo.allocationSize = memoryRequirements.size;
 	memoryAllocateInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memoryAllocateInfo, nullptr, &scratchBuffer.memory));
+	VK_CHECK_RESULT(vulkanDevice->allocateMemory(memoryAllocateInfo, vks::MemoryCategory::AccelerationStructure, &scratchBuffer.memory));
 	VK_CHECK_RESULT(vkBindBufferMemory(vulkanDevice->logicalDevice, scratchBuffer.handle, scratchBuffer.memory, 0));
 	// Buffer device address
 	VkBufferDeviceAddressInfoKHR bufferDeviceAddresInfo{};
@@ -139,7 +141,7 @@ VulkanRaytracingSample::ScratchBuffer VulkanRaytracingSample::createScratchBuffe
 void VulkanRaytracingSample::deleteScratchBuffer(ScratchBuffer& scratchBuffer)
 {
 	if (scratchBuffer.memory != VK_NULL_HANDLE) {
-		vkFreeMemory(vulkanDevice->logicalDevice, scratchBuffer.memory, nullptr);
+		vulkanDevice->freeMemory(scratchBuffer.memory);
 	}
 	if (scratchBuffer.handle != VK_NULL_HANDLE) {
 		vkDestroyBuffer(vulkanDevice->logicalDevice, scratchBuffer.handle, nullptr);
@@ -164,7 +166,7 @@ void VulkanRaytracingSample::createAccelerationStructure(AccelerationStructure&
 	memoryAllocateInfo.pNext = &memoryAllocateFlagsInfo;
 	memoryAllocateInfo.allocationSize = memoryRequirements.size;
 	memoryAllocateInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memoryAllocateInfo, nullptr, &accelerationStructure.memory));
+	VK_CHECK_RESULT(vulkanDevice->allocateMemory(memoryAllocateInfo, vks::MemoryCategory::AccelerationStructure, &accelerationStructure.memory));
 	VK_CHECK_RESULT(vkBindBufferMemory(vulkanDevice->logicalDevice, accelerationStructure.buffer, accelerationStructure.memory, 0));
 	// Acceleration structure
 	VkAccelerationStructureCreateInfoKHR accelerationStructureCreate_info{};
@@ -182,11 +184,463 @@ void VulkanRaytracingSample::createAccelerationStructure(AccelerationStructure&
 
 void VulkanRaytracingSample::deleteAccelerationStructure(AccelerationStructure& accelerationStructure)
 {
-	vkFreeMemory(device, accelerationStructure.memory, nullptr);
+	vulkanDevice->freeMemory(accelerationStructure.memory);
 	vkDestroyBuffer(device, accelerationStructure.buffer, nullptr);
 	vkDestroyAccelerationStructureKHR(device, accelerationStructure.handle, nullptr);
 }
 
+void VulkanRaytracingSample::buildBottomLevelAccelerationStructures(std::vector<BottomLevelAccelerationStructureInput>& inputs, VkBuildAccelerationStructureFlagsKHR flags)
+{
+	const uint32_t count = static_cast<uint32_t>(inputs.size());
+	const bool compact = (flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR) != 0;
+	// Power of two as required by the specification
+	const VkDeviceSize scratchAlignment = std::max<VkDeviceSize>(accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment, 1);
+	AccelerationStructureBuildStats& stats = accelerationStructureBuildStats;
+	stats = {};
+	stats.count = count;
+
+	// Create the structures and place the scratch memory of all builds in one buffer, the builds of a single call may run concurrently so they can't overlap
+	std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildGeometryInfos(count);
+	std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> buildRangeInfos(count);
+	std::vector<VkDeviceSize> scratchOffsets(count);
+	for (uint32_t i = 0; i < count; i++) {
+		BottomLevelAccelerationStructureInput& input = inputs[i];
+		assert(input.geometries.size() == input.buildRanges.size());
+		VkAccelerationStructureBuildGeometryInfoKHR& buildGeometryInfo = buildGeometryInfos[i];
+		buildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+		buildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+		buildGeometryInfo.flags = flags;
+		buildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+		buildGeometryInfo.geometryCount = static_cast<uint32_t>(input.geometries.size());
+		buildGeometryInfo.pGeometries = input.geometries.data();
+
+		std::vector<uint32_t> maxPrimitiveCounts;
+		for (const VkAccelerationStructureBuildRangeInfoKHR& buildRange : input.buildRanges) {
+			maxPrimitiveCounts.push_back(buildRange.primitiveCount);
+		}
+		VkAccelerationStructureBuildSizesInfoKHR buildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+		vkGetAccelerationStructureBuildSizesKHR(device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildGeometryInfo, maxPrimitiveCounts.data(), &buildSizesInfo);
+		createAccelerationStructure(*input.accelerationStructure, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, buildSizesInfo);
+		buildGeometryInfo.dstAccelerationStructure = input.accelerationStructure->handle;
+		buildRangeInfos[i] = input.buildRanges.data();
+
+		scratchOffsets[i] = (stats.scratchSize + scratchAlignment - 1) & ~(scratchAlignment - 1);
+		stats.scratchSize = scratchOffsets[i] + buildSizesInfo.buildScratchSize;
+		stats.buildSize += buildSizesInfo.accelerationStructureSize;
+	}
+
+	// Additional space so the start can be aligned, the buffer's device address doesn't have to be
+	ScratchBuffer scratchBuffer = createScratchBuffer(stats.scratchSize + scratchAlignment);
+	const VkDeviceAddress scratchAddress = (scratchBuffer.deviceAddress + scratchAlignment - 1) & ~(scratchAlignment - 1);
+	for (uint32_t i = 0; i < count; i++) {
+		buildGeometryInfos[i].scratchData.deviceAddress = scratchAddress + scratchOffsets[i];
+	}
+
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	if (compact) {
+		VkQueryPoolCreateInfo queryPoolCreateInfo{};
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+		queryPoolCreateInfo.queryCount = count;
+		VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &queryPool));
+	}
+
+	VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	if (compact) {
+		vkCmdResetQueryPool(commandBuffer, queryPool, 0, count);
+	}
+	vkCmdBuildAccelerationStructuresKHR(commandBuffer, count, buildGeometryInfos.data(), buildRangeInfos.data());
+	if (compact) {
+		// The compacted sizes are only known once the builds have finished
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		std::vector<VkAccelerationStructureKHR> handles(count);
+		for (uint32_t i = 0; i < count; i++) {
+			handles[i] = inputs[i].accelerationStructure->handle;
+		}
+		vkCmdWriteAccelerationStructuresPropertiesKHR(commandBuffer, count, handles.data(), VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, queryPool, 0);
+	}
+	vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+	deleteScratchBuffer(scratchBuffer);
+
+	if (compact) {
+		std::vector<VkDeviceSize> compactedSizes(count);
+		VK_CHECK_RESULT(vkGetQueryPoolResults(device, queryPool, 0, count, count * sizeof(VkDeviceSize), compactedSizes.data(), sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+		vkDestroyQueryPool(device, queryPool, nullptr);
+
+		// Copy into structures of the compacted size and release the ones that were built
+		std::vector<AccelerationStructure> compactedStructures(count);
+		commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		for (uint32_t i = 0; i < count; i++) {
+			VkAccelerationStructureBuildSizesInfoKHR compactedSizeInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+			compactedSizeInfo.accelerationStructureSize = compactedSizes[i];
+			createAccelerationStructure(compactedStructures[i], VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, compactedSizeInfo);
+			VkCopyAccelerationStructureInfoKHR copyInfo{};
+			copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+			copyInfo.src = inputs[i].accelerationStructure->handle;
+			copyInfo.dst = compactedStructures[i].handle;
+			copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+			vkCmdCopyAccelerationStructureKHR(commandBuffer, &copyInfo);
+			stats.compactedSize += compactedSizes[i];
+		}
+		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+		for (uint32_t i = 0; i < count; i++) {
+			deleteAccelerationStructure(*inputs[i].accelerationStructure);
+			*inputs[i].accelerationStructure = compactedStructures[i];
+		}
+	} else {
+		stats.compactedSize = stats.buildSize;
+	}
+
+	const double KiB = 1024.0;
+	std::cout << "Bottom level acceleration structures: " << count << " built with " << (double)stats.scratchSize / KiB << " KiB scratch memory, " << (double)stats.buildSize / KiB << " KiB";
+	if (compact) {
+		std::cout << " compacted to " << (double)stats.compactedSize / KiB << " KiB (" << (stats.buildSize > 0 ? 100.0 * (double)stats.compactedSize / (double)stats.buildSize : 100.0) << "%)";
+	}
+	std::cout << "\n";
+}
+
+// Build and refit have to use the same flags
+static const VkBuildAccelerationStructureFlagsKHR dynamicBottomLevelBuildFlags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+// The top level structure is built from scratch every frame, so build speed matters more than for the bottom level ones
+static const VkBuildAccelerationStructureFlagsKHR dynamicTopLevelBuildFlags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR;
+
+static VkAccelerationStructureGeometryKHR instancesGeometry(VkDeviceAddress instanceDataAddress)
+{
+	VkAccelerationStructureGeometryKHR geometry = vks::initializers::accelerationStructureGeometryKHR();
+	geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+	geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+	geometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+	geometry.geometry.instances.arrayOfPointers = VK_FALSE;
+	geometry.geometry.instances.data.deviceAddress = instanceDataAddress;
+	return geometry;
+}
+
+void VulkanRaytracingSample::createDynamicTopLevelAccelerationStructure(DynamicTopLevelAccelerationStructure& accelerationStructure, uint32_t maxInstanceCount)
+{
+	accelerationStructure.maxInstanceCount = maxInstanceCount;
+	accelerationStructure.instanceCount = 0;
+	// Host visible, the instances are read once per build so moving them to device local memory first isn't worth a copy
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&accelerationStructure.instanceBuffer,
+		std::max(maxInstanceCount, 1u) * sizeof(VkAccelerationStructureInstanceKHR)));
+	VK_CHECK_RESULT(accelerationStructure.instanceBuffer.map());
+	accelerationStructure.instances = static_cast<VkAccelerationStructureInstanceKHR*>(accelerationStructure.instanceBuffer.mapped);
+
+	// Sized for the maximum instance count, builds with fewer instances can reuse the structure
+	VkAccelerationStructureGeometryKHR geometry = instancesGeometry(getBufferDeviceAddress(accelerationStructure.instanceBuffer.buffer));
+	VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+	buildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+	buildGeometryInfo.flags = dynamicTopLevelBuildFlags;
+	buildGeometryInfo.geometryCount = 1;
+	buildGeometryInfo.pGeometries = &geometry;
+	VkAccelerationStructureBuildSizesInfoKHR buildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+	vkGetAccelerationStructureBuildSizesKHR(device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildGeometryInfo, &maxInstanceCount, &buildSizesInfo);
+	createAccelerationStructure(accelerationStructure.accelerationStructure, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, buildSizesInfo);
+
+	const VkDeviceSize scratchAlignment = std::max<VkDeviceSize>(accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment, 1);
+	accelerationStructure.scratchBuffer = createScratchBuffer(buildSizesInfo.buildScratchSize + scratchAlignment);
+	accelerationStructure.scratchAddress = (accelerationStructure.scratchBuffer.deviceAddress + scratchAlignment - 1) & ~(scratchAlignment - 1);
+}
+
+void VulkanRaytracingSample::deleteDynamicTopLevelAccelerationStructure(DynamicTopLevelAccelerationStructure& accelerationStructure)
+{
+	deleteAccelerationStructure(accelerationStructure.accelerationStructure);
+	deleteScratchBuffer(accelerationStructure.scratchBuffer);
+	accelerationStructure.instanceBuffer.destroy();
+	accelerationStructure = {};
+}
+
+/*
+	Records a full build of the top level acceleration structure from the first instanceCount entries of the mapped instance buffer
+	Bottom level builds and refits recorded before are finished first, the structure is then ready to be read by the shaders
+*/
+void VulkanRaytracingSample::recordTopLevelAccelerationStructureBuild(VkCommandBuffer commandBuffer, DynamicTopLevelAccelerationStructure& accelerationStructure)
+{
+	assert(accelerationStructure.instanceCount <= accelerationStructure.maxInstanceCount);
+	const VkPipelineStageFlags shaderStages = rayQueryOnly ? (VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT) : VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+
+	VkAccelerationStructureGeometryKHR geometry = instancesGeometry(getBufferDeviceAddress(accelerationStructure.instanceBuffer.buffer));
+	VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+	buildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+	buildGeometryInfo.flags = dynamicTopLevelBuildFlags;
+	buildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+	buildGeometryInfo.dstAccelerationStructure = accelerationStructure.accelerationStructure.handle;
+	buildGeometryInfo.geometryCount = 1;
+	buildGeometryInfo.pGeometries = &geometry;
+	buildGeometryInfo.scratchData.deviceAddress = accelerationStructure.scratchAddress;
+
+	VkAccelerationStructureBuildRangeInfoKHR buildRange{};
+	buildRange.primitiveCount = accelerationStructure.instanceCount;
+	const VkAccelerationStructureBuildRangeInfoKHR* buildRangeInfo = &buildRange;
+
+	// The instances written by the host are made visible by the queue submission, the previous build may still be read by the last frame's rays
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+	memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | shaderStages, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &buildGeometryInfo, &buildRangeInfo);
+	memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+	memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, shaderStages, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+/*
+	Creates the structure and its scratch buffer for the geometries and ranges of the input, the first recordBottomLevelAccelerationStructureUpdates() builds it
+*/
+void VulkanRaytracingSample::createDynamicBottomLevelAccelerationStructure(DynamicBottomLevelAccelerationStructure& accelerationStructure)
+{
+	assert(accelerationStructure.geometries.size() == accelerationStructure.buildRanges.size());
+	VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+	buildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+	buildGeometryInfo.flags = dynamicBottomLevelBuildFlags;
+	buildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+	buildGeometryInfo.geometryCount = static_cast<uint32_t>(accelerationStructure.geometries.size());
+	buildGeometryInfo.pGeometries = accelerationStructure.geometries.data();
+	std::vector<uint32_t> maxPrimitiveCounts;
+	for (const VkAccelerationStructureBuildRangeInfoKHR& buildRange : accelerationStructure.buildRanges) {
+		maxPrimitiveCounts.push_back(buildRange.primitiveCount);
+	}
+	VkAccelerationStructureBuildSizesInfoKHR buildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+	vkGetAccelerationStructureBuildSizesKHR(device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildGeometryInfo, maxPrimitiveCounts.data(), &buildSizesInfo);
+	createAccelerationStructure(accelerationStructure.accelerationStructure, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, buildSizesInfo);
+
+	const VkDeviceSize scratchAlignment = std::max<VkDeviceSize>(accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment, 1);
+	accelerationStructure.scratchBuffer = createScratchBuffer(std::max(buildSizesInfo.buildScratchSize, buildSizesInfo.updateScratchSize) + scratchAlignment);
+	accelerationStructure.scratchAddress = (accelerationStructure.scratchBuffer.deviceAddress + scratchAlignment - 1) & ~(scratchAlignment - 1);
+	accelerationStructure.built = false;
+	accelerationStructure.updatesSinceBuild = 0;
+}
+
+void VulkanRaytracingSample::deleteDynamicBottomLevelAccelerationStructure(DynamicBottomLevelAccelerationStructure& accelerationStructure)
+{
+	deleteAccelerationStructure(accelerationStructure.accelerationStructure);
+	deleteScratchBuffer(accelerationStructure.scratchBuffer);
+	accelerationStructure.scratchBuffer = {};
+	accelerationStructure.built = false;
+}
+
+/*
+	Records one vkCmdBuildAccelerationStructuresKHR call that refits the structures in place, or builds those that weren't built yet, reached
+	their rebuild interval or had a rebuild requested
+	Writes to the vertex data (e.g. compute skinning) have to be made visible to VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR by the caller
+*/
+void VulkanRaytracingSample::recordBottomLevelAccelerationStructureUpdates(VkCommandBuffer commandBuffer, const std::vector<DynamicBottomLevelAccelerationStructure*>& accelerationStructures)
+{
+	if (accelerationStructures.empty()) {
+		return;
+	}
+	const VkPipelineStageFlags shaderStages = rayQueryOnly ? (VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT) : VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+
+	std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildGeometryInfos;
+	std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> buildRangeInfos;
+	for (DynamicBottomLevelAccelerationStructure* accelerationStructure : accelerationStructures) {
+		const bool update = accelerationStructure->built && !accelerationStructure->rebuildRequested && (accelerationStructure->updatesSinceBuild < accelerationStructure->rebuildInterval);
+		VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+		buildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+		buildGeometryInfo.flags = dynamicBottomLevelBuildFlags;
+		buildGeometryInfo.mode = update ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+		// Refits are done in place
+		buildGeometryInfo.srcAccelerationStructure = update ? accelerationStructure->accelerationStructure.handle : VK_NULL_HANDLE;
+		buildGeometryInfo.dstAccelerationStructure = accelerationStructure->accelerationStructure.handle;
+		buildGeometryInfo.geometryCount = static_cast<uint32_t>(accelerationStructure->geometries.size());
+		buildGeometryInfo.pGeometries = accelerationStructure->geometries.data();
+		buildGeometryInfo.scratchData.deviceAddress = accelerationStructure->scratchAddress;
+		buildGeometryInfos.push_back(buildGeometryInfo);
+		buildRangeInfos.push_back(accelerationStructure->buildRanges.data());
+
+		if (update) {
+			accelerationStructure->updatesSinceBuild++;
+			accelerationStructure->updateCount++;
+		} else {
+			accelerationStructure->updatesSinceBuild = 0;
+			accelerationStructure->buildCount++;
+			accelerationStructure->built = true;
+			accelerationStructure->rebuildRequested = false;
+		}
+	}
+
+	// Refits read the result of the last build or refit, which may also still be traced against by the last frame
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+	memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | shaderStages, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	vkCmdBuildAccelerationStructuresKHR(commandBuffer, static_cast<uint32_t>(buildGeometryInfos.size()), buildGeometryInfos.data(), buildRangeInfos.data());
+	// Finished before the top level build that references them and the rays that traverse them
+	memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+	memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | shaderStages, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void VulkanRaytracingSample::createSceneAccelerationStructures(SceneAccelerationStructures& sceneAccelerationStructures, vkglTF::Model& model, const glm::mat4& transform)
+{
+	VkDeviceOrHostAddressConstKHR vertexBufferDeviceAddress{};
+	VkDeviceOrHostAddressConstKHR indexBufferDeviceAddress{};
+	vertexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(model.vertices.buffer);
+	indexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(model.indices.buffer);
+
+	// Nodes using the same glTF mesh share its vertices and indices, so the index range of the first primitive identifies a unique mesh
+	std::map<std::pair<uint32_t, uint32_t>, uint32_t> meshIndices;
+	std::vector<BottomLevelAccelerationStructureInput> inputs;
+	std::vector<uint32_t> firstGeometries;
+	std::vector<SceneGeometryData> geometryData;
+	std::vector<std::pair<vkglTF::Node*, uint32_t>> meshNodes;
+	for (vkglTF::Node* node : model.linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		std::vector<const vkglTF::Primitive*> primitives;
+		for (const vkglTF::Primitive* primitive : node->mesh->primitives) {
+			if (primitive->indexCount > 0) {
+				primitives.push_back(primitive);
+			}
+		}
+		if (primitives.empty()) {
+			continue;
+		}
+		const std::pair<uint32_t, uint32_t> key(primitives.front()->firstIndex, static_cast<uint32_t>(primitives.size()));
+		auto meshIndex = meshIndices.find(key);
+		if (meshIndex == meshIndices.end()) {
+			meshIndex = meshIndices.insert(std::make_pair(key, static_cast<uint32_t>(inputs.size()))).first;
+			firstGeometries.push_back(static_cast<uint32_t>(geometryData.size()));
+			BottomLevelAccelerationStructureInput input{};
+			for (const vkglTF::Primitive* primitive : primitives) {
+				// There are no any hit shaders, alpha tested materials are traced as opaque
+				VkAccelerationStructureGeometryKHR geometry = vks::initializers::accelerationStructureGeometryKHR();
+				geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+				geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+				geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+				geometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+				geometry.geometry.triangles.vertexData = vertexBufferDeviceAddress;
+				geometry.geometry.triangles.maxVertex = model.vertices.count - 1;
+				geometry.geometry.triangles.vertexStride = model.vertexLayout.stride;
+				geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+				geometry.geometry.triangles.indexData = indexBufferDeviceAddress;
+				input.geometries.push_back(geometry);
+
+				VkAccelerationStructureBuildRangeInfoKHR buildRange{};
+				buildRange.primitiveCount = primitive->indexCount / 3;
+				buildRange.primitiveOffset = primitive->firstIndex * sizeof(uint32_t);
+				input.buildRanges.push_back(buildRange);
+
+				SceneGeometryData data{};
+				data.baseColorFactor = primitive->material.baseColorFactor;
+				data.firstIndex = primitive->firstIndex;
+				data.materialIndex = static_cast<uint32_t>(&primitive->material - model.materials.data());
+				geometryData.push_back(data);
+			}
+			inputs.push_back(input);
+		}
+		meshNodes.push_back(std::make_pair(node, meshIndex->second));
+	}
+	assert(!inputs.empty());
+
+	sceneAccelerationStructures.bottomLevelAS.resize(inputs.size());
+	for (size_t i = 0; i < inputs.size(); i++) {
+		inputs[i].accelerationStructure = &sceneAccelerationStructures.bottomLevelAS[i];
+	}
+	buildBottomLevelAccelerationStructures(inputs);
+
+	// One instance per node and mesh instance, the custom index points to the mesh's first geometry
+	std::vector<VkAccelerationStructureInstanceKHR> instances;
+	for (const std::pair<vkglTF::Node*, uint32_t>& meshNode : meshNodes) {
+		const vkglTF::Node* node = meshNode.first;
+		const std::vector<glm::mat4> instanceMatrices = node->instanceMatrices.empty() ? std::vector<glm::mat4>{ glm::mat4(1.0f) } : node->instanceMatrices;
+		for (const glm::mat4& instanceMatrix : instanceMatrices) {
+			// Row major 3x4 matrix
+			const glm::mat3x4 rows = glm::mat3x4(glm::transpose(transform * node->worldMatrix * instanceMatrix));
+			VkAccelerationStructureInstanceKHR instance{};
+			memcpy(&instance.transform, &rows, sizeof(VkTransformMatrixKHR));
+			// Custom indices have 24 bits
+			assert(firstGeometries[meshNode.second] < (1u << 24));
+			instance.instanceCustomIndex = firstGeometries[meshNode.second];
+			instance.mask = 0xFF;
+			instance.instanceShaderBindingTableRecordOffset = 0;
+			// The transform may mirror the geometry (e.g. to flip the y axis), which also flips the winding
+			instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+			instance.accelerationStructureReference = sceneAccelerationStructures.bottomLevelAS[meshNode.second].deviceAddress;
+			instances.push_back(instance);
+		}
+	}
+	sceneAccelerationStructures.instanceCount = static_cast<uint32_t>(instances.size());
+
+	vks::Buffer instancesBuffer;
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&instancesBuffer,
+		instances.size() * sizeof(VkAccelerationStructureInstanceKHR),
+		instances.data()));
+
+	VkAccelerationStructureGeometryKHR instancesGeometry = vks::initializers::accelerationStructureGeometryKHR();
+	instancesGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+	instancesGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+	instancesGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+	instancesGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
+	instancesGeometry.geometry.instances.data.deviceAddress = getBufferDeviceAddress(instancesBuffer.buffer);
+
+	VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = vks::initializers::accelerationStructureBuildGeometryInfoKHR();
+	buildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+	buildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+	buildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+	buildGeometryInfo.geometryCount = 1;
+	buildGeometryInfo.pGeometries = &instancesGeometry;
+	VkAccelerationStructureBuildSizesInfoKHR buildSizesInfo = vks::initializers::accelerationStructureBuildSizesInfoKHR();
+	vkGetAccelerationStructureBuildSizesKHR(device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildGeometryInfo, &sceneAccelerationStructures.instanceCount, &buildSizesInfo);
+	createAccelerationStructure(sceneAccelerationStructures.topLevelAS, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, buildSizesInfo);
+
+	const VkDeviceSize scratchAlignment = std::max<VkDeviceSize>(accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment, 1);
+	ScratchBuffer scratchBuffer = createScratchBuffer(buildSizesInfo.buildScratchSize + scratchAlignment);
+	buildGeometryInfo.dstAccelerationStructure = sceneAccelerationStructures.topLevelAS.handle;
+	buildGeometryInfo.scratchData.deviceAddress = (scratchBuffer.deviceAddress + scratchAlignment - 1) & ~(scratchAlignment - 1);
+
+	VkAccelerationStructureBuildRangeInfoKHR buildRange{};
+	buildRange.primitiveCount = sceneAccelerationStructures.instanceCount;
+	const VkAccelerationStructureBuildRangeInfoKHR* buildRangeInfo = &buildRange;
+	VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &buildGeometryInfo, &buildRangeInfo);
+	vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+	deleteScratchBuffer(scratchBuffer);
+	instancesBuffer.destroy();
+
+	// Geometry data is only read by the shaders, so it's uploaded to device local memory
+	vks::Buffer stagingBuffer;
+	const VkDeviceSize geometryBufferSize = geometryData.size() * sizeof(SceneGeometryData);
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingBuffer,
+		geometryBufferSize,
+		geometryData.data()));
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&sceneAccelerationStructures.geometryBuffer,
+		geometryBufferSize));
+	vulkanDevice->copyBuffer(&stagingBuffer, &sceneAccelerationStructures.geometryBuffer, queue);
+	stagingBuffer.destroy();
+
+	std::cout << "Scene acceleration structures: " << inputs.size() << " unique meshes, " << sceneAccelerationStructures.instanceCount << " instances\n";
+}
+
+void VulkanRaytracingSample::deleteSceneAccelerationStructures(SceneAccelerationStructures& sceneAccelerationStructures)
+{
+	for (AccelerationStructure& accelerationStructure : sceneAccelerationStructures.bottomLevelAS) {
+		deleteAccelerationStructure(accelerationStructure);
+	}
+	sceneAccelerationStructures.bottomLevelAS.clear();
+	if (sceneAccelerationStructures.topLevelAS.handle != VK_NULL_HANDLE) {
+		deleteAccelerationStructure(sceneAccelerationStructures.topLevelAS);
+	}
+	sceneAccelerationStructures.topLevelAS = {};
+	sceneAccelerationStructures.geometryBuffer.destroy();
+	sceneAccelerationStructures.instanceCount = 0;
+}
+
 uint64_t VulkanRaytracingSample::getBufferDeviceAddress(VkBuffer buffer)
 {
 	VkBufferDeviceAddressInfoKHR bufferDeviceAI{};
@@ -201,7 +655,7 @@ void VulkanRaytracingSample::createStorageImage(VkFormat format, VkExtent3D exte
 	if (storageImage.image != VK_NULL_HANDLE) {
 		vkDestroyImageView(device, storageImage.view, nullptr);
 		vkDestroyImage(device, storageImage.image, nullptr);
-		vkFreeMemory(device, storageImage.memory, nullptr);
+		vulkanDevice->freeMemory(storageImage.memory);
 		storageImage = {};
 	}
 
@@ -222,7 +676,7 @@ void VulkanRaytracingSample::createStorageImage(VkFormat format, VkExtent3D exte
 	VkMemoryAllocateInfo memoryAllocateInfo = vks::initializers::memoryAllocateInfo();
 	memoryAllocateInfo.allocationSize = memReqs.size;
 	memoryAllocateInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memoryAllocateInfo, nullptr, &storageImage.memory));
+	VK_CHECK_RESULT(vulkanDevice->allocateMemory(memoryAllocateInfo, vks::MemoryCategory::Image, &storageImage.memory));
 	VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, storageImage.image, storageImage.memory, 0));
 
 	VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
@@ -249,7 +703,7 @@ void VulkanRaytracingSample::deleteStorageImage()
 {
 	vkDestroyImageView(vulkanDevice->logicalDevice, storageImage.view, nullptr);
 	vkDestroyImage(vulkanDevice->logicalDevice, storageImage.image, nullptr);
-	vkFreeMemory(vulkanDevice->logicalDevice, storageImage.memory, nullptr);
+	vulkanDevice->freeMemory(storageImage.memory);
 }
 
 void VulkanRaytracingSample::prepare()
@@ -257,6 +711,8 @@ void VulkanRaytracingSample::prepare()
 	VulkanExampleBase::prepare();
 	// Get properties and features
 	rayTracingPipelineProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
+	accelerationStructureProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+	rayTracingPipelineProperties.pNext = &accelerationStructureProperties;
 	VkPhysicalDeviceProperties2 deviceProperties2{};
 	deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
 	deviceProperties2.pNext = &rayTracingPipelineProperties;
@@ -277,6 +733,8 @@ void VulkanRaytracingSample::prepare()
 	vkCmdTraceRaysKHR = reinterpret_cast<PFN_vkCmdTraceRaysKHR>(vkGetDeviceProcAddr(device, "vkCmdTraceRaysKHR"));
 	vkGetRayTracingShaderGroupHandlesKHR = reinterpret_cast<PFN_vkGetRayTracingShaderGroupHandlesKHR>(vkGetDeviceProcAddr(device, "vkGetRayTracingShaderGroupHandlesKHR"));
 	vkCreateRayTracingPipelinesKHR = reinterpret_cast<PFN_vkCreateRayTracingPipelinesKHR>(vkGetDeviceProcAddr(device, "vkCreateRayTracingPipelinesKHR"));
+	vkCmdWriteAccelerationStructuresPropertiesKHR = reinterpret_cast<PFN_vkCmdWriteAccelerationStructuresPropertiesKHR>(vkGetDeviceProcAddr(device, "vkCmdWriteAccelerationStructuresPropertiesKHR"));
+	vkCmdCopyAccelerationStructureKHR = reinterpret_cast<PFN_vkCmdCopyAccelerationStructureKHR>(vkGetDeviceProcAddr(device, "vkCmdCopyAccelerationStructureKHR"));
 	// Update the render pass to keep the color attachment contents, so we can draw the UI on top of the ray traced output
 	if (!rayQueryOnly) {
 		updateRenderPass();
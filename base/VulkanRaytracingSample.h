@@ -12,6 +12,12 @@
 #include "vulkanexamplebase.h"
 #include "VulkanTools.h"
 #include "VulkanDevice.h"
+#include "VulkanShaderBindingTable.h"
+
+namespace vkglTF
+{
+	class Model;
+}
 
 class VulkanRaytracingSample : public VulkanExampleBase
 {
@@ -30,9 +36,12 @@ public:
 	PFN_vkCmdTraceRaysKHR vkCmdTraceRaysKHR;
 	PFN_vkGetRayTracingShaderGroupHandlesKHR vkGetRayTracingShaderGroupHandlesKHR;
 	PFN_vkCreateRayTracingPipelinesKHR vkCreateRayTracingPipelinesKHR;
+	PFN_vkCmdWriteAccelerationStructuresPropertiesKHR vkCmdWriteAccelerationStructuresPropertiesKHR;
+	PFN_vkCmdCopyAccelerationStructureKHR vkCmdCopyAccelerationStructureKHR;
 
 	// Available features and properties
 	VkPhysicalDeviceRayTracingPipelinePropertiesKHR  rayTracingPipelineProperties{};
+	VkPhysicalDeviceAccelerationStructurePropertiesKHR accelerationStructureProperties{};
 	VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures{};
 
 	// Enabled features and properties
@@ -56,6 +65,79 @@ public:
 		VkBuffer buffer;
 	};
 
+	// Geometries of one bottom level acceleration structure built by buildBottomLevelAccelerationStructures()
+	struct BottomLevelAccelerationStructureInput {
+		// Created by the build, replaced by the compacted copy if compaction is enabled
+		AccelerationStructure* accelerationStructure = nullptr;
+		std::vector<VkAccelerationStructureGeometryKHR> geometries;
+		// One range per geometry
+		std::vector<VkAccelerationStructureBuildRangeInfoKHR> buildRanges;
+	};
+
+	// Sizes of the acceleration structures created by the last buildBottomLevelAccelerationStructures() call
+	struct AccelerationStructureBuildStats {
+		uint32_t count = 0;
+		VkDeviceSize scratchSize = 0;
+		// Sum of the sizes right after the build
+		VkDeviceSize buildSize = 0;
+		// Sum of the sizes after compaction, same as buildSize without compaction
+		VkDeviceSize compactedSize = 0;
+	} accelerationStructureBuildStats;
+
+	// Top level acceleration structure that is rebuilt every frame from the instances written by the host, see recordTopLevelAccelerationStructureBuild()
+	struct DynamicTopLevelAccelerationStructure {
+		AccelerationStructure accelerationStructure{};
+		// Persistently mapped, written by the host before recording the build
+		vks::Buffer instanceBuffer;
+		VkAccelerationStructureInstanceKHR* instances = nullptr;
+		uint32_t instanceCount = 0;
+		uint32_t maxInstanceCount = 0;
+		// Kept between builds so the per frame build doesn't allocate
+		ScratchBuffer scratchBuffer{};
+		VkDeviceAddress scratchAddress = 0;
+	};
+
+	// Bottom level acceleration structure for deforming geometry that is refit instead of rebuilt, see recordBottomLevelAccelerationStructureUpdates()
+	struct DynamicBottomLevelAccelerationStructure {
+		AccelerationStructure accelerationStructure{};
+		// Vertex data is read again by every refit, so it has to stay valid, the topology must not change
+		std::vector<VkAccelerationStructureGeometryKHR> geometries;
+		std::vector<VkAccelerationStructureBuildRangeInfoKHR> buildRanges;
+		// Sized for both builds and refits
+		ScratchBuffer scratchBuffer{};
+		VkDeviceAddress scratchAddress = 0;
+		// Refits get slower to trace the further the geometry moves away from the state of the last build, so the structure is built
+		// again after rebuildInterval refits (0 = always build) or if rebuildRequested is set, e.g. when the animation changes
+		uint32_t rebuildInterval = 60;
+		bool rebuildRequested = false;
+		uint32_t updatesSinceBuild = 0;
+		bool built = false;
+		// Counters for displaying the refit/build ratio
+		uint32_t updateCount = 0;
+		uint32_t buildCount = 0;
+	};
+
+	// Data of one primitive of a glTF mesh, matches the std430 layout of the geometry buffer read by the hit shaders
+	struct SceneGeometryData {
+		glm::vec4 baseColorFactor;
+		// Start of the primitive's triangles in the model's index buffer, the indices already include the vertex offset
+		uint32_t firstIndex;
+		// Index into the model's materials
+		uint32_t materialIndex;
+		uint32_t padding[2];
+	};
+
+	// Acceleration structures of a vkglTF model built by createSceneAccelerationStructures()
+	struct SceneAccelerationStructures {
+		// One per unique mesh, with one geometry per primitive, shared by all nodes using the mesh
+		std::vector<AccelerationStructure> bottomLevelAS;
+		// One instance per mesh node (and per EXT_mesh_gpu_instancing instance of the node)
+		AccelerationStructure topLevelAS{};
+		// SceneGeometryData of all unique meshes, the entry for a hit is at gl_InstanceCustomIndexEXT + gl_GeometryIndexEXT
+		vks::Buffer geometryBuffer;
+		uint32_t instanceCount = 0;
+	};
+
 	// Holds information for a storage image that the ray tracing shaders output to
 	struct StorageImage {
 		VkDeviceMemory memory = VK_NULL_HANDLE;
@@ -78,10 +160,28 @@ public:
 	void deleteScratchBuffer(ScratchBuffer& scratchBuffer);
 	void createAccelerationStructure(AccelerationStructure& accelerationStructure, VkAccelerationStructureTypeKHR type, VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo);
 	void deleteAccelerationStructure(AccelerationStructure& accelerationStructure);
+	// Builds all bottom level acceleration structures with a single vkCmdBuildAccelerationStructuresKHR call that shares one scratch buffer
+	// With VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR in flags, the structures are then copied into ones of their compacted size
+	void buildBottomLevelAccelerationStructures(std::vector<BottomLevelAccelerationStructureInput>& inputs, VkBuildAccelerationStructureFlagsKHR flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR);
+	// Dynamic acceleration structures, the record functions are meant to be called for each frame's command buffer before tracing rays
+	// Neither double buffers its data, so the frame recording them must not overlap with the previous one (see VulkanExampleBase::submitFrame)
+	void createDynamicTopLevelAccelerationStructure(DynamicTopLevelAccelerationStructure& accelerationStructure, uint32_t maxInstanceCount);
+	void deleteDynamicTopLevelAccelerationStructure(DynamicTopLevelAccelerationStructure& accelerationStructure);
+	void recordTopLevelAccelerationStructureBuild(VkCommandBuffer commandBuffer, DynamicTopLevelAccelerationStructure& accelerationStructure);
+	void createDynamicBottomLevelAccelerationStructure(DynamicBottomLevelAccelerationStructure& accelerationStructure);
+	void deleteDynamicBottomLevelAccelerationStructure(DynamicBottomLevelAccelerationStructure& accelerationStructure);
+	void recordBottomLevelAccelerationStructureUpdates(VkCommandBuffer commandBuffer, const std::vector<DynamicBottomLevelAccelerationStructure*>& accelerationStructures);
+	// Builds one bottom level acceleration structure per unique mesh of the model and a top level one instancing them with the node transforms
+	// The model needs acceleration structure build input, device address and storage buffer usage (see vkglTF::memoryPropertyFlags) and
+	// must not be loaded with FileLoadingFlags::PreTransformVertices, otherwise meshes can't be shared and every node gets its own structure
+	void createSceneAccelerationStructures(SceneAccelerationStructures& sceneAccelerationStructures, vkglTF::Model& model, const glm::mat4& transform = glm::mat4(1.0f));
+	void deleteSceneAccelerationStructures(SceneAccelerationStructures& sceneAccelerationStructures);
 	uint64_t getBufferDeviceAddress(VkBuffer buffer);
 	void createStorageImage(VkFormat format, VkExtent3D extent);
 	void deleteStorageImage();
 	VkStridedDeviceAddressRegionKHR getSbtEntryStridedDeviceAddressRegion(VkBuffer buffer, uint32_t handleCount);
+	// Creates a table for one region holding handleCount handles without inline data
+	// Use vks::ShaderBindingTableBuilder to pack all regions into one buffer or to store data in the records
 	void createShaderBindingTable(ShaderBindingTable& shaderBindingTable, uint32_t handleCount);
 	// Draw the ImGUI UI overlay using a render pass
 	void drawUI(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer);
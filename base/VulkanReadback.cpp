@@ -0,0 +1,279 @@
+/*
+* Asynchronous image readback
+*
+* Copies images into persistently mapped host buffers on the GPU timeline and hands the results to a worker thread once their fence
+* has been signaled, so saving screenshots or image sequences doesn't stall rendering
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanReadback.h"
+#include "VulkanDevice.h"
+#include <fstream>
+#include <assert.h>
+
+namespace vks
+{
+	namespace
+	{
+		// Size of a texel for the color formats that can be read back, 0 for unsupported formats
+		uint32_t texelSize(VkFormat format)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_R8G8B8A8_UNORM:
+			case VK_FORMAT_R8G8B8A8_SRGB:
+			case VK_FORMAT_R8G8B8A8_SNORM:
+			case VK_FORMAT_B8G8R8A8_UNORM:
+			case VK_FORMAT_B8G8R8A8_SRGB:
+			case VK_FORMAT_B8G8R8A8_SNORM:
+			case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+			case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+			case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+			case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+				return 4;
+			case VK_FORMAT_R16G16B16A16_SFLOAT:
+			case VK_FORMAT_R16G16B16A16_UNORM:
+				return 8;
+			case VK_FORMAT_R32G32B32A32_SFLOAT:
+				return 16;
+			default:
+				return 0;
+			}
+		}
+	}
+
+	/**
+	* @param device Device to create the readback buffers on
+	* @param queue Queue the copies are submitted to, must be from the graphics queue family
+	* @param slotCount Maximum number of readbacks in flight
+	*/
+	ReadbackRing::ReadbackRing(vks::VulkanDevice *device, VkQueue queue, uint32_t slotCount) : device(device), queue(queue), slots(slotCount)
+	{
+		assert(slotCount > 0);
+		// Cached memory makes reading the data on the host a lot faster, but isn't necessarily coherent
+		VkBool32 cached = VK_FALSE;
+		device->getMemoryType(~0u, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &cached);
+		memoryPropertyFlags = cached ? (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT) : (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		commandPool = device->createCommandPool(device->queueFamilyIndices.graphics);
+		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
+		for (uint32_t i = 0; i < slotCount; i++)
+		{
+			slots[i].commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool);
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceCreateInfo, nullptr, &slots[i].fence));
+			freeSlots.push_back(i);
+		}
+		thread = std::thread(&ReadbackRing::run, this);
+	}
+
+	/** @brief Finish all pending readbacks, including their callbacks, and release the slots */
+	ReadbackRing::~ReadbackRing()
+	{
+		flush();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		condition.notify_all();
+		thread.join();
+		for (auto &slot : slots)
+		{
+			vkDestroyFence(device->logicalDevice, slot.fence, nullptr);
+			if (slot.buffer.buffer != VK_NULL_HANDLE)
+			{
+				slot.buffer.unmap();
+				slot.buffer.destroy();
+			}
+		}
+		vkDestroyCommandPool(device->logicalDevice, commandPool, nullptr);
+	}
+
+	/**
+	* Copy an image into a readback slot and run a callback with the data once the copy has finished
+	*
+	* @param image Image to read back, requires VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+	* @param layout Layout of the image when the copy executes, it's transitioned back to this layout afterwards
+	* @param format Format of the image, has to be a color format supported by the ring
+	* @param width Width of the image
+	* @param height Height of the image
+	* @param callback Function called by the worker thread with the image data
+	* @param waitSemaphore (Optional) Semaphore signaled by the submission that renders the image, the copy waits for it at the transfer stage
+	* @param signalSemaphore (Optional) Semaphore signaled after the copy, e.g. the one waited on by presentation
+	*
+	* @note Blocks while all slots are in use
+	*/
+	void ReadbackRing::capture(VkImage image, VkImageLayout layout, VkFormat format, uint32_t width, uint32_t height, Callback callback, VkSemaphore waitSemaphore, VkSemaphore signalSemaphore)
+	{
+		const uint32_t bytesPerTexel = texelSize(format);
+		assert(bytesPerTexel > 0);
+
+		uint32_t index;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this] { return !freeSlots.empty(); });
+			index = freeSlots.front();
+			freeSlots.pop_front();
+		}
+		Slot &slot = slots[index];
+
+		// Buffers only grow, so a slot can be reused for any image up to its largest size
+		const VkDeviceSize size = static_cast<VkDeviceSize>(width) * height * bytesPerTexel;
+		if (slot.buffer.size < size)
+		{
+			if (slot.buffer.buffer != VK_NULL_HANDLE)
+			{
+				slot.buffer.unmap();
+				slot.buffer.destroy();
+			}
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryPropertyFlags, &slot.buffer, size));
+			VK_CHECK_RESULT(slot.buffer.map());
+		}
+
+		slot.image.width = width;
+		slot.image.height = height;
+		slot.image.rowPitch = static_cast<VkDeviceSize>(width) * bytesPerTexel;
+		slot.image.format = format;
+		slot.image.index = captureCount++;
+		slot.image.data = static_cast<const uint8_t*>(slot.buffer.mapped);
+		slot.callback = callback;
+
+		VkCommandBufferBeginInfo beginInfo = vks::initializers::commandBufferBeginInfo();
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(slot.commandBuffer, &beginInfo));
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		// Writes to the image are made available by the wait semaphore or previous submissions
+		vks::tools::insertImageMemoryBarrier(slot.commandBuffer, image, 0, VK_ACCESS_TRANSFER_READ_BIT, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, subresourceRange);
+		VkBufferImageCopy region{};
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.imageExtent = { width, height, 1 };
+		vkCmdCopyImageToBuffer(slot.commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer.buffer, 1, &region);
+		vks::tools::insertImageMemoryBarrier(slot.commandBuffer, image, VK_ACCESS_TRANSFER_READ_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, subresourceRange);
+		// Make the copy visible to host reads after the fence wait
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.buffer = slot.buffer.buffer;
+		bufferBarrier.size = size;
+		vkCmdPipelineBarrier(slot.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		VK_CHECK_RESULT(vkEndCommandBuffer(slot.commandBuffer));
+
+		const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &slot.commandBuffer;
+		if (waitSemaphore != VK_NULL_HANDLE)
+		{
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &waitSemaphore;
+			submitInfo.pWaitDstStageMask = &waitStage;
+		}
+		if (signalSemaphore != VK_NULL_HANDLE)
+		{
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &signalSemaphore;
+		}
+		VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &slot.fence));
+		VK_CHECK_RESULT(device->queueSubmit(queue, 1, &submitInfo, slot.fence));
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			submitted.push_back(index);
+		}
+		condition.notify_all();
+	}
+
+	/** @brief Wait until all submitted readbacks have been passed to their callbacks */
+	void ReadbackRing::flush()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [this] { return freeSlots.size() == slots.size(); });
+	}
+
+	/** @brief True if the readback buffers use host cached memory */
+	bool ReadbackRing::hostCached() const
+	{
+		return (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0;
+	}
+
+	// Worker thread, waits for the copies in submission order and runs their callbacks
+	void ReadbackRing::run()
+	{
+		while (true)
+		{
+			uint32_t index;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this] { return stop || !submitted.empty(); });
+				if (submitted.empty())
+				{
+					return;
+				}
+				index = submitted.front();
+			}
+			Slot &slot = slots[index];
+			VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+			if (!(memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+			{
+				VK_CHECK_RESULT(slot.buffer.invalidate());
+			}
+			if (slot.callback)
+			{
+				slot.callback(slot.image);
+			}
+			slot.callback = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				submitted.pop_front();
+				freeSlots.push_back(index);
+			}
+			condition.notify_all();
+		}
+	}
+
+	/**
+	* Write an 8 bit RGBA or BGRA image to a binary PPM file
+	*
+	* @return False if the format can't be written or the file couldn't be created
+	*/
+	bool ReadbackRing::writePPM(const std::string &fileName, const Image &image)
+	{
+		bool swizzle;
+		switch (image.format)
+		{
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+		case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+			swizzle = false;
+			break;
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			swizzle = true;
+			break;
+		default:
+			return false;
+		}
+		std::ofstream file(fileName, std::ios::out | std::ios::binary);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		file << "P6\n" << image.width << "\n" << image.height << "\n" << 255 << "\n";
+		// Convert a row at a time so the file is written in large blocks
+		std::vector<char> row(image.width * 3);
+		for (uint32_t y = 0; y < image.height; y++)
+		{
+			const uint8_t *src = image.data + y * image.rowPitch;
+			for (uint32_t x = 0; x < image.width; x++)
+			{
+				row[x * 3 + 0] = src[x * 4 + (swizzle ? 2 : 0)];
+				row[x * 3 + 1] = src[x * 4 + 1];
+				row[x * 3 + 2] = src[x * 4 + (swizzle ? 0 : 2)];
+			}
+			file.write(row.data(), row.size());
+		}
+		return file.good();
+	}
+}
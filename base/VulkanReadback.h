@@ -0,0 +1,90 @@
+/*
+* Asynchronous image readback
+*
+* Copies images into persistently mapped host buffers on the GPU timeline and hands the results to a worker thread once their fence
+* has been signaled, so saving screenshots or image sequences doesn't stall rendering
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Ring of readback slots, each with a command buffer, a fence and a host buffer
+	*
+	* Usage:
+	*	vks::ReadbackRing readback(vulkanDevice, queue);
+	*	// After the frame's submission, before it's presented
+	*	readback.capture(swapChain.images[currentBuffer], VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, swapChain.colorFormat, width, height,
+	*		[](const vks::ReadbackRing::Image &image) { vks::ReadbackRing::writePPM("screenshot.ppm", image); }, sceneComplete, renderComplete);
+	*
+	* capture() records and submits the copy and returns immediately. A worker thread waits for the copy's fence, then runs the callback
+	* with the mapped data (e.g. encoding and writing a file) and frees the slot. capture() only blocks if all slots are still in use,
+	* which throttles continuous capture to the speed of the callback instead of dropping frames.
+	*
+	* @note Callbacks run on the worker thread, in capture order
+	*/
+	class ReadbackRing
+	{
+	public:
+		/** @brief Read back texels, only valid during the callback */
+		struct Image
+		{
+			const uint8_t *data;
+			uint32_t width;
+			uint32_t height;
+			// Bytes between the starts of two rows
+			VkDeviceSize rowPitch;
+			VkFormat format;
+			// Number of the capture, counting from 0
+			uint64_t index;
+		};
+		typedef std::function<void(const Image &image)> Callback;
+
+		ReadbackRing(vks::VulkanDevice *device, VkQueue queue, uint32_t slotCount = 3);
+		~ReadbackRing();
+		void capture(VkImage image, VkImageLayout layout, VkFormat format, uint32_t width, uint32_t height, Callback callback,
+			VkSemaphore waitSemaphore = VK_NULL_HANDLE, VkSemaphore signalSemaphore = VK_NULL_HANDLE);
+		void flush();
+		bool hostCached() const;
+		static bool writePPM(const std::string &fileName, const Image &image);
+	private:
+		struct Slot
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			vks::Buffer buffer;
+			Image image{};
+			Callback callback;
+		};
+		vks::VulkanDevice *device;
+		VkQueue queue;
+		VkCommandPool commandPool;
+		VkMemoryPropertyFlags memoryPropertyFlags;
+		std::vector<Slot> slots;
+		uint64_t captureCount = 0;
+		// Slots are submitted in order, the worker processes them in the same order
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<uint32_t> submitted;
+		std::deque<uint32_t> freeSlots;
+		bool stop = false;
+		std::thread thread;
+		void run();
+	};
+}
@@ -0,0 +1,1156 @@
+/*
+* Render graph
+*
+* Passes declare the images they read and write, the graph orders them, derives the image barriers, merges passes into subpasses of a
+* single render pass where possible and aliases the memory of transient images whose lifetimes don't overlap
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanRenderGraph.h"
+#include "VulkanDebug.h"
+#include "VulkanDevice.h"
+#include <algorithm>
+
+namespace vks
+{
+	const RenderGraph::ImageHandle RenderGraph::invalidImage;
+
+	static const VkAccessFlags writeAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	void RenderGraph::Pass::addUse(ImageHandle image, Access access, VkPipelineStageFlags stages, const VkClearValue *clearValue)
+	{
+		Use use = {};
+		use.image = image;
+		use.access = access;
+		// Shader accesses default to the stage the pass type usually accesses images from
+		use.stages = (stages != 0) ? stages : static_cast<VkPipelineStageFlags>((type == PassType::Compute) ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		use.clear = (clearValue != nullptr);
+		if (clearValue)
+		{
+			use.clearValue = *clearValue;
+		}
+		uses.push_back(use);
+	}
+
+	/** @brief Render to the image as a color attachment, keeping its current contents */
+	void RenderGraph::Pass::writeColor(ImageHandle image)
+	{
+		addUse(image, Access::ColorAttachment, 0, nullptr);
+	}
+
+	/** @brief Render to the image as a color attachment, cleared if this is the first write of the image in the graph */
+	void RenderGraph::Pass::writeColor(ImageHandle image, VkClearColorValue clearValue)
+	{
+		VkClearValue value;
+		value.color = clearValue;
+		addUse(image, Access::ColorAttachment, 0, &value);
+	}
+
+	void RenderGraph::Pass::writeDepth(ImageHandle image)
+	{
+		addUse(image, Access::DepthAttachment, 0, nullptr);
+	}
+
+	void RenderGraph::Pass::writeDepth(ImageHandle image, VkClearDepthStencilValue clearValue)
+	{
+		VkClearValue value;
+		value.depthStencil = clearValue;
+		addUse(image, Access::DepthAttachment, 0, &value);
+	}
+
+	/** @brief Read the image as an input attachment, lets the pass merge with the pass writing the image into one render pass */
+	void RenderGraph::Pass::readInput(ImageHandle image)
+	{
+		addUse(image, Access::InputAttachment, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, nullptr);
+	}
+
+	void RenderGraph::Pass::readSampled(ImageHandle image, VkPipelineStageFlags stages)
+	{
+		addUse(image, Access::Sampled, stages, nullptr);
+	}
+
+	void RenderGraph::Pass::readStorage(ImageHandle image, VkPipelineStageFlags stages)
+	{
+		addUse(image, Access::StorageRead, stages, nullptr);
+	}
+
+	void RenderGraph::Pass::writeStorage(ImageHandle image, VkPipelineStageFlags stages)
+	{
+		addUse(image, Access::StorageWrite, stages, nullptr);
+	}
+
+	/**
+	* @param device Device to create the images and render passes on
+	* @param width Width of the images and render passes sized relative to the graph
+	* @param height Height of the images and render passes sized relative to the graph
+	*/
+	RenderGraph::RenderGraph(vks::VulkanDevice *device, uint32_t width, uint32_t height) : device(device)
+	{
+		extent = { width, height };
+	}
+
+	RenderGraph::~RenderGraph()
+	{
+		destroyCompiledState();
+	}
+
+	/** @brief Declare a transient image, which is created by compile() and only valid while the graph uses it */
+	RenderGraph::ImageHandle RenderGraph::createImage(const std::string &name, const ImageInfo &info)
+	{
+		Image image;
+		image.name = name;
+		image.format = info.format;
+		image.width = info.width;
+		image.height = info.height;
+		image.scale = info.scale;
+		image.samples = info.samples;
+		image.usage = info.usage;
+		images.push_back(image);
+		return static_cast<ImageHandle>(images.size() - 1);
+	}
+
+	/**
+	* Import an image owned by the application (e.g. a swap chain image or a texture used after the graph)
+	*
+	* @param initialLayout Layout of the image when the graph is executed, VK_IMAGE_LAYOUT_UNDEFINED discards the contents
+	* @param finalLayout Layout the image is transitioned to at the end of the graph
+	*/
+	RenderGraph::ImageHandle RenderGraph::importImage(const std::string &name, VkImage image, VkImageView view, VkFormat format, uint32_t width, uint32_t height, VkImageLayout initialLayout, VkImageLayout finalLayout)
+	{
+		Image importedImage;
+		importedImage.name = name;
+		importedImage.format = format;
+		importedImage.width = width;
+		importedImage.height = height;
+		importedImage.imported = true;
+		importedImage.initialLayout = initialLayout;
+		importedImage.finalLayout = finalLayout;
+		importedImage.image = image;
+		importedImage.view = view;
+		images.push_back(importedImage);
+		return static_cast<ImageHandle>(images.size() - 1);
+	}
+
+	/**
+	* Replace an imported image (e.g. with the current swap chain image) before recording the graph
+	*
+	* @param width Width of the new image, zero keeps the current size, which is the case if the image only changes between frames
+	* @note The image must keep its format, the size may only change together with resize() for images sharing a render pass
+	*/
+	void RenderGraph::setImportedImage(ImageHandle handle, VkImage image, VkImageView view, uint32_t width, uint32_t height)
+	{
+		assert(images[handle].imported);
+		images[handle].image = image;
+		images[handle].view = view;
+		if (width > 0)
+		{
+			images[handle].width = width;
+			images[handle].height = height;
+		}
+	}
+
+	/** @brief Keep a transient image alive after the graph, e.g. to sample it outside the graph, and transition it to finalLayout at the end of the graph */
+	void RenderGraph::markOutput(ImageHandle handle, VkImageLayout finalLayout)
+	{
+		images[handle].output = true;
+		if (!images[handle].imported)
+		{
+			images[handle].finalLayout = finalLayout;
+			images[handle].usage |= (finalLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) ? VK_IMAGE_USAGE_SAMPLED_BIT : 0;
+		}
+	}
+
+	/**
+	* Add a pass, the returned pass is used to declare the images it reads and writes
+	*
+	* @param function Records the pass's commands, for graphics passes inside the subpass given by the context
+	*/
+	RenderGraph::Pass &RenderGraph::addPass(const std::string &name, PassType type, ExecuteFunction function)
+	{
+		std::unique_ptr<Pass> pass(new Pass());
+		pass->name = name;
+		pass->type = type;
+		pass->function = function;
+		passes.push_back(std::move(pass));
+		return *passes.back();
+	}
+
+	bool RenderGraph::isDepthFormat(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	bool RenderGraph::isWrite(Access access)
+	{
+		return (access == Access::ColorAttachment) || (access == Access::DepthAttachment) || (access == Access::StorageWrite);
+	}
+
+	bool RenderGraph::isAttachment(Access access)
+	{
+		return (access == Access::ColorAttachment) || (access == Access::DepthAttachment) || (access == Access::InputAttachment);
+	}
+
+	RenderGraph::ImageState RenderGraph::getUseState(const Pass::Use &use) const
+	{
+		const bool depth = isDepthFormat(images[use.image].format);
+		ImageState state;
+		state.write = isWrite(use.access);
+		switch (use.access)
+		{
+		case Access::ColorAttachment:
+			state.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			state.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			state.access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			break;
+		case Access::DepthAttachment:
+			state.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			state.stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			state.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			break;
+		case Access::InputAttachment:
+			state.layout = depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			state.stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			state.access = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+			break;
+		case Access::Sampled:
+			state.layout = depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			state.stages = use.stages;
+			state.access = VK_ACCESS_SHADER_READ_BIT;
+			break;
+		case Access::StorageRead:
+			state.layout = VK_IMAGE_LAYOUT_GENERAL;
+			state.stages = use.stages;
+			state.access = VK_ACCESS_SHADER_READ_BIT;
+			break;
+		case Access::StorageWrite:
+			state.layout = VK_IMAGE_LAYOUT_GENERAL;
+			state.stages = use.stages;
+			state.access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			break;
+		}
+		return state;
+	}
+
+	/** @brief State of an image after a group: layout of the last use, stages and write accesses of all uses in the group */
+	RenderGraph::ImageState RenderGraph::getGroupState(const Group &group, ImageHandle handle) const
+	{
+		ImageState groupState;
+		for (uint32_t passIndex : group.passes)
+		{
+			for (auto &use : passes[passIndex]->uses)
+			{
+				if (use.image != handle)
+				{
+					continue;
+				}
+				const ImageState state = getUseState(use);
+				groupState.layout = state.layout;
+				groupState.stages |= state.stages;
+				groupState.access |= state.access & writeAccessMask;
+				groupState.write |= state.write;
+			}
+		}
+		return groupState;
+	}
+
+	VkExtent2D RenderGraph::getImageExtent(const Image &image) const
+	{
+		if (image.width > 0)
+		{
+			return { image.width, image.height };
+		}
+		return { std::max((uint32_t)(extent.width * image.scale), 1u), std::max((uint32_t)(extent.height * image.scale), 1u) };
+	}
+
+	bool RenderGraph::sameExtent(const Image &a, const Image &b) const
+	{
+		const VkExtent2D extentA = getImageExtent(a);
+		const VkExtent2D extentB = getImageExtent(b);
+		return (extentA.width == extentB.width) && (extentA.height == extentB.height);
+	}
+
+	// Passes are needed if they write an imported or output image, or an image read by a needed pass
+	void RenderGraph::cullPasses()
+	{
+		std::vector<bool> neededImages(images.size(), false);
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			neededImages[i] = images[i].imported || images[i].output;
+		}
+		for (size_t i = passes.size(); i-- > 0;)
+		{
+			Pass &pass = *passes[i];
+			bool writes = false;
+			bool needed = false;
+			for (auto &use : pass.uses)
+			{
+				if (isWrite(use.access))
+				{
+					writes = true;
+					needed |= neededImages[use.image];
+				}
+			}
+			// Passes without image writes may have other side effects (e.g. buffer writes) and are always kept
+			pass.culled = writes && !needed;
+			if (pass.culled)
+			{
+				continue;
+			}
+			for (auto &use : pass.uses)
+			{
+				// Attachments written without a clear keep contents of earlier passes, so their writers are needed too
+				if (!isWrite(use.access) || !use.clear)
+				{
+					neededImages[use.image] = true;
+				}
+			}
+		}
+	}
+
+	/*
+		Topological sort of the passes that haven't been culled
+		Reads depend on the last write of an image and writes on the last write and all reads since, ties are broken by declaration order
+	*/
+	void RenderGraph::sortPasses()
+	{
+		const size_t passCount = passes.size();
+		std::vector<std::vector<uint32_t>> successors(passCount);
+		std::vector<uint32_t> predecessorCount(passCount, 0);
+		std::vector<uint32_t> lastWriter(images.size(), UINT32_MAX);
+		std::vector<std::vector<uint32_t>> readers(images.size());
+		auto addEdge = [&](uint32_t from, uint32_t to) {
+			if ((from != to) && (std::find(successors[from].begin(), successors[from].end(), to) == successors[from].end()))
+			{
+				successors[from].push_back(to);
+				predecessorCount[to]++;
+			}
+		};
+		for (uint32_t i = 0; i < passCount; i++)
+		{
+			if (passes[i]->culled)
+			{
+				continue;
+			}
+			for (auto &use : passes[i]->uses)
+			{
+				if (lastWriter[use.image] != UINT32_MAX)
+				{
+					addEdge(lastWriter[use.image], i);
+				}
+				if (isWrite(use.access))
+				{
+					for (uint32_t reader : readers[use.image])
+					{
+						addEdge(reader, i);
+					}
+				}
+			}
+			// Update the image states after all uses of the pass, a pass reading and writing an image doesn't depend on itself
+			for (auto &use : passes[i]->uses)
+			{
+				if (isWrite(use.access))
+				{
+					lastWriter[use.image] = i;
+					readers[use.image].clear();
+				}
+				else
+				{
+					readers[use.image].push_back(i);
+				}
+			}
+		}
+		passOrder.clear();
+		std::vector<bool> scheduled(passCount, false);
+		for (;;)
+		{
+			uint32_t next = UINT32_MAX;
+			for (uint32_t i = 0; i < passCount; i++)
+			{
+				if (!passes[i]->culled && !scheduled[i] && (predecessorCount[i] == 0))
+				{
+					next = i;
+					break;
+				}
+			}
+			if (next == UINT32_MAX)
+			{
+				break;
+			}
+			scheduled[next] = true;
+			passOrder.push_back(next);
+			for (uint32_t successor : successors[next])
+			{
+				predecessorCount[successor]--;
+			}
+		}
+	}
+
+	/*
+		A graphics pass can become the next subpass of a render pass if all of its attachments have the same size as the render pass
+		and every image it shares with earlier subpasses is only used as an attachment, so the dependency can be expressed by region
+	*/
+	bool RenderGraph::canMerge(const Group &group, const Pass &pass) const
+	{
+		if (!group.graphics || (pass.type != PassType::Graphics) || group.attachments.empty())
+		{
+			return false;
+		}
+		const Image &groupImage = images[group.attachments.front()];
+		bool hasAttachment = false;
+		for (auto &use : pass.uses)
+		{
+			if (isAttachment(use.access))
+			{
+				hasAttachment = true;
+				if (!sameExtent(images[use.image], groupImage) || (images[use.image].samples != groupImage.samples))
+				{
+					return false;
+				}
+			}
+			for (uint32_t passIndex : group.passes)
+			{
+				for (auto &groupUse : passes[passIndex]->uses)
+				{
+					if ((groupUse.image == use.image) && (!isAttachment(groupUse.access) || !isAttachment(use.access)))
+					{
+						return false;
+					}
+				}
+			}
+		}
+		return hasAttachment;
+	}
+
+	void RenderGraph::buildGroups()
+	{
+		groups.clear();
+		for (uint32_t passIndex : passOrder)
+		{
+			Pass &pass = *passes[passIndex];
+			if (groups.empty() || !canMerge(groups.back(), pass))
+			{
+				Group group;
+				group.graphics = (pass.type == PassType::Graphics);
+				groups.push_back(group);
+			}
+			Group &group = groups.back();
+			pass.group = static_cast<uint32_t>(groups.size() - 1);
+			pass.subpass = static_cast<uint32_t>(group.passes.size());
+			group.passes.push_back(passIndex);
+			if (group.graphics)
+			{
+				for (auto &use : pass.uses)
+				{
+					if (isAttachment(use.access) && (std::find(group.attachments.begin(), group.attachments.end(), use.image) == group.attachments.end()))
+					{
+						group.attachments.push_back(use.image);
+					}
+				}
+			}
+		}
+	}
+
+	void RenderGraph::computeLifetimes()
+	{
+		for (auto &image : images)
+		{
+			image.firstGroup = UINT32_MAX;
+			image.lastGroup = 0;
+			// Usage flags are derived again from the passes that haven't been culled
+			if (!image.imported)
+			{
+				image.usage &= ~(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+			}
+		}
+		for (uint32_t g = 0; g < groups.size(); g++)
+		{
+			for (uint32_t passIndex : groups[g].passes)
+			{
+				for (auto &use : passes[passIndex]->uses)
+				{
+					Image &image = images[use.image];
+					image.firstGroup = std::min(image.firstGroup, g);
+					image.lastGroup = std::max(image.lastGroup, g);
+					switch (use.access)
+					{
+					case Access::ColorAttachment:
+						image.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+						break;
+					case Access::DepthAttachment:
+						image.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+						break;
+					case Access::InputAttachment:
+						image.usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+						break;
+					case Access::Sampled:
+						image.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+						break;
+					case Access::StorageRead:
+					case Access::StorageWrite:
+						image.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+						break;
+					}
+				}
+			}
+		}
+		// Outputs are read after the graph and must not share memory with any other image
+		for (auto &image : images)
+		{
+			if (image.output && (image.firstGroup != UINT32_MAX))
+			{
+				image.firstGroup = 0;
+				image.lastGroup = static_cast<uint32_t>(groups.size());
+			}
+		}
+	}
+
+	/*
+		Greedy interval assignment: images are placed from large to small into the first block none of whose images is used
+		at the same time, a block's memory is as large as its largest image and all of its images are bound at offset zero
+	*/
+	void RenderGraph::assignMemoryBlocks()
+	{
+		std::vector<VkMemoryRequirements> memReqs(images.size());
+		std::vector<uint32_t> transientImages;
+		for (uint32_t i = 0; i < images.size(); i++)
+		{
+			if (!images[i].imported && (images[i].image != VK_NULL_HANDLE))
+			{
+				vkGetImageMemoryRequirements(device->logicalDevice, images[i].image, &memReqs[i]);
+				transientImages.push_back(i);
+				statistics.transientImageBytes += memReqs[i].size;
+			}
+		}
+		std::stable_sort(transientImages.begin(), transientImages.end(), [&memReqs](uint32_t a, uint32_t b) { return memReqs[a].size > memReqs[b].size; });
+		memoryBlocks.clear();
+		for (uint32_t imageIndex : transientImages)
+		{
+			Image &image = images[imageIndex];
+			image.memoryBlock = UINT32_MAX;
+			for (uint32_t b = 0; b < memoryBlocks.size(); b++)
+			{
+				MemoryBlock &block = memoryBlocks[b];
+				if ((block.memoryTypeBits & memReqs[imageIndex].memoryTypeBits) == 0)
+				{
+					continue;
+				}
+				bool overlaps = false;
+				for (uint32_t other : block.images)
+				{
+					overlaps |= (images[other].firstGroup <= image.lastGroup) && (image.firstGroup <= images[other].lastGroup);
+				}
+				if (!overlaps)
+				{
+					image.memoryBlock = b;
+					break;
+				}
+			}
+			if (image.memoryBlock == UINT32_MAX)
+			{
+				memoryBlocks.push_back(MemoryBlock());
+				image.memoryBlock = static_cast<uint32_t>(memoryBlocks.size() - 1);
+			}
+			MemoryBlock &block = memoryBlocks[image.memoryBlock];
+			block.size = std::max(block.size, memReqs[imageIndex].size);
+			block.memoryTypeBits &= memReqs[imageIndex].memoryTypeBits;
+			block.images.push_back(imageIndex);
+		}
+	}
+
+	void RenderGraph::createTransientImages()
+	{
+		statistics.transientImageBytes = 0;
+		statistics.allocatedBytes = 0;
+		for (auto &image : images)
+		{
+			if (image.imported || (image.firstGroup == UINT32_MAX))
+			{
+				continue;
+			}
+			const VkExtent2D imageExtent = getImageExtent(image);
+			VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+			imageCI.imageType = VK_IMAGE_TYPE_2D;
+			imageCI.format = image.format;
+			imageCI.extent = { imageExtent.width, imageExtent.height, 1 };
+			imageCI.mipLevels = 1;
+			imageCI.arrayLayers = 1;
+			imageCI.samples = image.samples;
+			imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCI.usage = image.usage;
+			imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &image.image));
+			vks::debugutils::setObjectName(device->logicalDevice, VK_OBJECT_TYPE_IMAGE, (uint64_t)image.image, image.name.c_str());
+		}
+
+		assignMemoryBlocks();
+
+		for (auto &block : memoryBlocks)
+		{
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = block.size;
+			memAlloc.memoryTypeIndex = device->getMemoryType(block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(device->allocateMemory(memAlloc, vks::MemoryCategory::Image, &block.memory));
+			statistics.allocatedBytes += block.size;
+			for (uint32_t imageIndex : block.images)
+			{
+				Image &image = images[imageIndex];
+				VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image.image, block.memory, 0));
+				VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+				viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewCI.format = image.format;
+				viewCI.subresourceRange.aspectMask = isDepthFormat(image.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+				viewCI.subresourceRange.levelCount = 1;
+				viewCI.subresourceRange.layerCount = 1;
+				viewCI.image = image.image;
+				VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &image.view));
+				vks::debugutils::setObjectName(device->logicalDevice, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)image.view, image.name.c_str());
+			}
+		}
+
+		for (auto &group : groups)
+		{
+			if (!group.attachments.empty())
+			{
+				group.extent = getImageExtent(images[group.attachments.front()]);
+			}
+			else
+			{
+				group.extent = extent;
+			}
+		}
+	}
+
+	void RenderGraph::destroyTransientImages()
+	{
+		for (auto &image : images)
+		{
+			if (!image.imported)
+			{
+				vkDestroyImageView(device->logicalDevice, image.view, nullptr);
+				vkDestroyImage(device->logicalDevice, image.image, nullptr);
+				image.view = VK_NULL_HANDLE;
+				image.image = VK_NULL_HANDLE;
+			}
+		}
+		for (auto &block : memoryBlocks)
+		{
+			device->freeMemory(block.memory);
+		}
+		memoryBlocks.clear();
+	}
+
+	void RenderGraph::createRenderPasses()
+	{
+		for (uint32_t g = 0; g < groups.size(); g++)
+		{
+			Group &group = groups[g];
+			if (!group.graphics || group.attachments.empty())
+			{
+				continue;
+			}
+			std::vector<VkAttachmentDescription> attachmentDescriptions(group.attachments.size());
+			group.clearValues.assign(group.attachments.size(), VkClearValue());
+			for (size_t a = 0; a < group.attachments.size(); a++)
+			{
+				const ImageHandle handle = group.attachments[a];
+				const Image &image = images[handle];
+				// First and last use of the attachment inside the render pass
+				const Pass::Use *firstUse = nullptr;
+				const Pass::Use *lastUse = nullptr;
+				for (uint32_t passIndex : group.passes)
+				{
+					for (auto &use : passes[passIndex]->uses)
+					{
+						if (use.image == handle)
+						{
+							firstUse = firstUse ? firstUse : &use;
+							lastUse = &use;
+						}
+					}
+				}
+				// Contents are valid if the image has been written before or is imported with its contents
+				const bool validContents = (image.firstGroup < g) || (image.imported && (image.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED));
+				// Contents are needed after the render pass if the image is used later or outlives the graph
+				const bool usedLater = (image.lastGroup > g) || image.imported || image.output;
+				VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				if (isWrite(firstUse->access) && firstUse->clear)
+				{
+					loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+					group.clearValues[a] = firstUse->clearValue;
+				}
+				else if (validContents)
+				{
+					loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+				}
+				const VkAttachmentStoreOp storeOp = usedLater ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				const bool stencil = vks::tools::formatHasStencil(image.format);
+				VkAttachmentDescription &description = attachmentDescriptions[a];
+				description = {};
+				description.format = image.format;
+				description.samples = image.samples;
+				description.loadOp = loadOp;
+				description.storeOp = storeOp;
+				description.stencilLoadOp = stencil ? loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				description.stencilStoreOp = stencil ? storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				// Layout transitions happen in the barriers before the render pass
+				description.initialLayout = getUseState(*firstUse).layout;
+				description.finalLayout = getUseState(*lastUse).layout;
+			}
+
+			struct SubpassReferences {
+				std::vector<VkAttachmentReference> color;
+				std::vector<VkAttachmentReference> input;
+				VkAttachmentReference depth;
+				bool hasDepth = false;
+				std::vector<uint32_t> preserve;
+			};
+			std::vector<SubpassReferences> references(group.passes.size());
+			std::vector<VkSubpassDescription> subpassDescriptions(group.passes.size());
+			std::vector<VkSubpassDependency> dependencies;
+			for (uint32_t s = 0; s < group.passes.size(); s++)
+			{
+				const Pass &pass = *passes[group.passes[s]];
+				SubpassReferences &refs = references[s];
+				for (auto &use : pass.uses)
+				{
+					const uint32_t attachment = static_cast<uint32_t>(std::find(group.attachments.begin(), group.attachments.end(), use.image) - group.attachments.begin());
+					VkAttachmentReference reference = { attachment, getUseState(use).layout };
+					if (use.access == Access::ColorAttachment)
+					{
+						refs.color.push_back(reference);
+					}
+					else if (use.access == Access::DepthAttachment)
+					{
+						refs.depth = reference;
+						refs.hasDepth = true;
+					}
+					else if (use.access == Access::InputAttachment)
+					{
+						refs.input.push_back(reference);
+					}
+				}
+				// Depend on every earlier subpass that uses one of the pass's images with at least one of them writing
+				for (uint32_t earlier = 0; earlier < s; earlier++)
+				{
+					VkSubpassDependency dependency = {};
+					dependency.srcSubpass = earlier;
+					dependency.dstSubpass = s;
+					dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+					for (auto &earlierUse : passes[group.passes[earlier]]->uses)
+					{
+						for (auto &use : pass.uses)
+						{
+							if ((earlierUse.image == use.image) && (isWrite(earlierUse.access) || isWrite(use.access)))
+							{
+								const ImageState src = getUseState(earlierUse);
+								const ImageState dst = getUseState(use);
+								dependency.srcStageMask |= src.stages;
+								dependency.srcAccessMask |= src.access & writeAccessMask;
+								dependency.dstStageMask |= dst.stages;
+								dependency.dstAccessMask |= dst.access;
+							}
+						}
+					}
+					if (dependency.srcStageMask != 0)
+					{
+						dependencies.push_back(dependency);
+					}
+				}
+			}
+			// Attachments used before and after a subpass that doesn't use them have to be preserved by it
+			for (uint32_t a = 0; a < group.attachments.size(); a++)
+			{
+				uint32_t firstSubpass = UINT32_MAX, lastSubpass = 0;
+				std::vector<bool> used(group.passes.size(), false);
+				for (uint32_t s = 0; s < group.passes.size(); s++)
+				{
+					for (auto &use : passes[group.passes[s]]->uses)
+					{
+						if (use.image == group.attachments[a])
+						{
+							used[s] = true;
+							firstSubpass = std::min(firstSubpass, s);
+							lastSubpass = std::max(lastSubpass, s);
+						}
+					}
+				}
+				for (uint32_t s = firstSubpass + 1; s < lastSubpass; s++)
+				{
+					if (!used[s])
+					{
+						references[s].preserve.push_back(a);
+					}
+				}
+			}
+			for (uint32_t s = 0; s < group.passes.size(); s++)
+			{
+				SubpassReferences &refs = references[s];
+				VkSubpassDescription &description = subpassDescriptions[s];
+				description = {};
+				description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+				description.colorAttachmentCount = static_cast<uint32_t>(refs.color.size());
+				description.pColorAttachments = refs.color.data();
+				description.inputAttachmentCount = static_cast<uint32_t>(refs.input.size());
+				description.pInputAttachments = refs.input.data();
+				description.pDepthStencilAttachment = refs.hasDepth ? &refs.depth : nullptr;
+				description.preserveAttachmentCount = static_cast<uint32_t>(refs.preserve.size());
+				description.pPreserveAttachments = refs.preserve.data();
+			}
+
+			VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+			renderPassCI.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+			renderPassCI.pAttachments = attachmentDescriptions.data();
+			renderPassCI.subpassCount = static_cast<uint32_t>(subpassDescriptions.size());
+			renderPassCI.pSubpasses = subpassDescriptions.data();
+			renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size());
+			renderPassCI.pDependencies = dependencies.data();
+			VK_CHECK_RESULT(vkCreateRenderPass(device->logicalDevice, &renderPassCI, nullptr, &group.renderPass));
+			statistics.renderPassCount++;
+		}
+	}
+
+	void RenderGraph::addBarrier(Group &group, ImageHandle handle, const ImageState &src, const ImageState &dst)
+	{
+		// Reads after reads in the same layout don't need to be synchronized
+		if ((src.layout == dst.layout) && !src.write && !dst.write)
+		{
+			return;
+		}
+		const Image &image = images[handle];
+		VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+		barrier.oldLayout = src.layout;
+		barrier.newLayout = dst.layout;
+		// Write after read hazards only need an execution dependency
+		barrier.srcAccessMask = src.write ? (src.access & writeAccessMask) : 0;
+		barrier.dstAccessMask = dst.access;
+		barrier.image = image.image;
+		barrier.subresourceRange.aspectMask = isDepthFormat(image.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+		if (vks::tools::formatHasStencil(image.format))
+		{
+			barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.layerCount = 1;
+		group.barriers.push_back(barrier);
+		group.barrierImages.push_back(handle);
+		group.srcStageMask |= (src.stages != 0) ? src.stages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		group.dstStageMask |= (dst.stages != 0) ? dst.stages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		statistics.barrierCount++;
+	}
+
+	/*
+		Barriers before each group transition the images from their state after their previous use to the state of their first use in the group
+		The first use of a transient image in the frame discards its contents and waits for the image that used the memory before, which is
+		the previous image of its memory block in this frame or the last one of the block in the previous frame
+	*/
+	void RenderGraph::buildBarriers()
+	{
+		statistics.barrierCount = 0;
+		// State of each image after each group it's used in
+		std::vector<std::vector<ImageState>> groupStates(groups.size(), std::vector<ImageState>(images.size()));
+		for (uint32_t g = 0; g < groups.size(); g++)
+		{
+			for (uint32_t i = 0; i < images.size(); i++)
+			{
+				if ((images[i].firstGroup <= g) && (g <= images[i].lastGroup))
+				{
+					groupStates[g][i] = getGroupState(groups[g], i);
+				}
+			}
+		}
+		// Final state of each image in the frame
+		std::vector<ImageState> finalStates(images.size());
+		for (uint32_t i = 0; i < images.size(); i++)
+		{
+			for (uint32_t g = 0; g < groups.size(); g++)
+			{
+				if (groupStates[g][i].stages != 0)
+				{
+					finalStates[i] = groupStates[g][i];
+				}
+			}
+			if (images[i].output || images[i].imported)
+			{
+				finalStates[i].layout = images[i].finalLayout;
+			}
+		}
+
+		std::vector<ImageState> currentStates(images.size());
+		std::vector<bool> used(images.size(), false);
+		for (uint32_t i = 0; i < images.size(); i++)
+		{
+			if (images[i].imported)
+			{
+				// Previous accesses of imported images are not known, so the first use waits for all of them
+				currentStates[i].layout = images[i].initialLayout;
+				currentStates[i].stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+				currentStates[i].access = VK_ACCESS_MEMORY_WRITE_BIT;
+				currentStates[i].write = true;
+				used[i] = true;
+			}
+		}
+		for (uint32_t g = 0; g < groups.size(); g++)
+		{
+			Group &group = groups[g];
+			group.barriers.clear();
+			group.barrierImages.clear();
+			group.srcStageMask = 0;
+			group.dstStageMask = 0;
+			std::vector<bool> handled(images.size(), false);
+			for (uint32_t passIndex : group.passes)
+			{
+				for (auto &use : passes[passIndex]->uses)
+				{
+					if (handled[use.image])
+					{
+						continue;
+					}
+					handled[use.image] = true;
+					ImageState src = currentStates[use.image];
+					if (!used[use.image])
+					{
+						// Wait for the previous image of the memory block
+						const Image &image = images[use.image];
+						const MemoryBlock &block = memoryBlocks[image.memoryBlock];
+						uint32_t previous = UINT32_MAX;
+						for (uint32_t other : block.images)
+						{
+							if ((images[other].lastGroup < image.firstGroup) && ((previous == UINT32_MAX) || (images[other].lastGroup > images[previous].lastGroup)))
+							{
+								previous = other;
+							}
+						}
+						if (previous == UINT32_MAX)
+						{
+							for (uint32_t other : block.images)
+							{
+								if ((previous == UINT32_MAX) || (images[other].lastGroup > images[previous].lastGroup))
+								{
+									previous = other;
+								}
+							}
+						}
+						src = finalStates[previous];
+						src.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+						// Make sure the previous accesses are waited for, even if they were reads
+						src.write = true;
+						used[use.image] = true;
+					}
+					addBarrier(group, use.image, src, getUseState(use));
+				}
+			}
+			for (uint32_t i = 0; i < images.size(); i++)
+			{
+				if (handled[i])
+				{
+					currentStates[i] = groupStates[g][i];
+				}
+			}
+		}
+
+		finalBarriers = Group();
+		for (uint32_t i = 0; i < images.size(); i++)
+		{
+			if ((images[i].imported || images[i].output) && (images[i].firstGroup != UINT32_MAX))
+			{
+				ImageState dst;
+				dst.layout = images[i].finalLayout;
+				dst.stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+				dst.access = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+				dst.write = true;
+				addBarrier(finalBarriers, i, currentStates[i], dst);
+			}
+		}
+	}
+
+	/**
+	* Order and merge the passes, create the transient images and render passes and prepare the barriers
+	*
+	* Can be called again after adding passes or images, which rebuilds all objects created by the graph
+	*/
+	void RenderGraph::compile()
+	{
+		destroyCompiledState();
+		statistics = Statistics();
+		for (auto &pass : passes)
+		{
+			pass->group = UINT32_MAX;
+			pass->subpass = 0;
+		}
+		cullPasses();
+		sortPasses();
+		buildGroups();
+		computeLifetimes();
+		createTransientImages();
+		createRenderPasses();
+		buildBarriers();
+		statistics.passCount = static_cast<uint32_t>(passOrder.size());
+		statistics.culledPasses = static_cast<uint32_t>(passes.size() - passOrder.size());
+		compiled = true;
+	}
+
+	/**
+	* Change the size of the images sized relative to the graph, render passes (and the pipelines created for them) stay valid
+	*
+	* @note The device must be idle, imported images of the graph's size have to be replaced with setImportedImage() before
+	*/
+	void RenderGraph::resize(uint32_t width, uint32_t height)
+	{
+		extent = { width, height };
+		if (!compiled)
+		{
+			return;
+		}
+		destroyFramebuffers();
+		destroyTransientImages();
+		createTransientImages();
+		buildBarriers();
+	}
+
+	VkFramebuffer RenderGraph::getFramebuffer(const Group &group)
+	{
+		std::vector<uint64_t> key;
+		key.push_back((uint64_t)group.renderPass);
+		std::vector<VkImageView> views;
+		for (ImageHandle handle : group.attachments)
+		{
+			views.push_back(images[handle].view);
+			key.push_back((uint64_t)images[handle].view);
+		}
+		auto it = framebuffers.find(key);
+		if (it != framebuffers.end())
+		{
+			return it->second;
+		}
+		VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+		framebufferCI.renderPass = group.renderPass;
+		framebufferCI.attachmentCount = static_cast<uint32_t>(views.size());
+		framebufferCI.pAttachments = views.data();
+		framebufferCI.width = group.extent.width;
+		framebufferCI.height = group.extent.height;
+		framebufferCI.layers = 1;
+		VkFramebuffer framebuffer;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device->logicalDevice, &framebufferCI, nullptr, &framebuffer));
+		framebuffers[key] = framebuffer;
+		return framebuffer;
+	}
+
+	void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const Group &group)
+	{
+		if (group.barriers.empty())
+		{
+			return;
+		}
+		// Imported images may have been replaced since the barriers have been built
+		std::vector<VkImageMemoryBarrier> barriers = group.barriers;
+		for (size_t i = 0; i < barriers.size(); i++)
+		{
+			barriers[i].image = images[group.barrierImages[i]].image;
+		}
+		vkCmdPipelineBarrier(commandBuffer, group.srcStageMask, group.dstStageMask, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+	}
+
+	/** @brief Record all passes with their barriers and render passes into the command buffer, which must not be inside a render pass */
+	void RenderGraph::execute(VkCommandBuffer commandBuffer)
+	{
+		assert(compiled);
+		// Each pass is a debug utils label, so captures show the graph's pass names
+		const glm::vec4 passLabelColor(0.5f, 0.8f, 0.4f, 1.0f);
+		for (auto &group : groups)
+		{
+			recordBarriers(commandBuffer, group);
+			PassContext context = { group.renderPass, 0, group.extent };
+			if (group.renderPass == VK_NULL_HANDLE)
+			{
+				for (uint32_t passIndex : group.passes)
+				{
+					vks::debugutils::cmdBeginLabel(commandBuffer, passes[passIndex]->name.c_str(), passLabelColor);
+					passes[passIndex]->function(commandBuffer, context);
+					vks::debugutils::cmdEndLabel(commandBuffer);
+				}
+				continue;
+			}
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = group.renderPass;
+			renderPassBeginInfo.framebuffer = getFramebuffer(group);
+			renderPassBeginInfo.renderArea.extent = group.extent;
+			renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(group.clearValues.size());
+			renderPassBeginInfo.pClearValues = group.clearValues.data();
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			for (uint32_t s = 0; s < group.passes.size(); s++)
+			{
+				if (s > 0)
+				{
+					vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+				}
+				context.subpass = s;
+				vks::debugutils::cmdBeginLabel(commandBuffer, passes[group.passes[s]]->name.c_str(), passLabelColor);
+				passes[group.passes[s]]->function(commandBuffer, context);
+				vks::debugutils::cmdEndLabel(commandBuffer);
+			}
+			vkCmdEndRenderPass(commandBuffer);
+		}
+		recordBarriers(commandBuffer, finalBarriers);
+	}
+
+	VkImage RenderGraph::getImage(ImageHandle handle) const
+	{
+		return images[handle].image;
+	}
+
+	/** @brief View of an image, transient images only have a view after compile() and only if they're used by a pass */
+	VkImageView RenderGraph::getView(ImageHandle handle) const
+	{
+		return images[handle].view;
+	}
+
+	/** @brief Render pass a graphics pass is recorded in, VK_NULL_HANDLE for culled passes and passes without attachments */
+	VkRenderPass RenderGraph::getRenderPass(const Pass &pass) const
+	{
+		return (pass.group != UINT32_MAX) ? groups[pass.group].renderPass : VK_NULL_HANDLE;
+	}
+
+	uint32_t RenderGraph::getSubpass(const Pass &pass) const
+	{
+		return pass.subpass;
+	}
+
+	const RenderGraph::Statistics &RenderGraph::getStatistics() const
+	{
+		return statistics;
+	}
+
+	void RenderGraph::destroyFramebuffers()
+	{
+		for (auto &framebuffer : framebuffers)
+		{
+			vkDestroyFramebuffer(device->logicalDevice, framebuffer.second, nullptr);
+		}
+		framebuffers.clear();
+	}
+
+	void RenderGraph::destroyCompiledState()
+	{
+		destroyFramebuffers();
+		destroyTransientImages();
+		for (auto &group : groups)
+		{
+			vkDestroyRenderPass(device->logicalDevice, group.renderPass, nullptr);
+		}
+		groups.clear();
+		passOrder.clear();
+		compiled = false;
+	}
+}
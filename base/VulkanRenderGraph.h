@@ -0,0 +1,230 @@
+/*
+* Render graph
+*
+* Passes declare the images they read and write, the graph orders them, derives the image barriers, merges passes into subpasses of a
+* single render pass where possible and aliases the memory of transient images whose lifetimes don't overlap
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <string>
+#include <memory>
+#include <functional>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Frame graph of graphics and compute passes working on images
+	*
+	* Usage:
+	*	vks::RenderGraph graph(vulkanDevice, width, height);
+	*	auto albedo = graph.createImage("albedo", { VK_FORMAT_R8G8B8A8_UNORM });
+	*	auto depth = graph.createImage("depth", { depthFormat });
+	*	auto output = graph.importImage("output", image, view, VK_FORMAT_R8G8B8A8_UNORM, width, height, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	*	auto& gbuffer = graph.addPass("gbuffer", vks::RenderGraph::PassType::Graphics, [&](VkCommandBuffer commandBuffer, const vks::RenderGraph::PassContext& context) { ... });
+	*	gbuffer.writeColor(albedo, clearColor);
+	*	gbuffer.writeDepth(depth, clearDepth);
+	*	auto& composition = graph.addPass("composition", vks::RenderGraph::PassType::Graphics, ...);
+	*	composition.readInput(albedo);
+	*	composition.writeColor(output);
+	*	graph.compile();
+	*	// Create pipelines with graph.getRenderPass(gbuffer) and graph.getSubpass(gbuffer)
+	*	graph.execute(drawCmdBuffer);
+	*
+	* Passes are ordered by their dependencies (declaration order among passes that write the same image), passes that don't contribute to an
+	* imported image or an image marked as output are culled. Consecutive graphics passes with attachments of the same size are merged into one
+	* render pass if the later ones only read images written inside the render pass as input attachments.
+	*
+	* Transient images are only valid between their first and last use in the graph, so images used in disjoint parts of the frame share memory.
+	* Attachments are only stored if they're read later, cleared on their first use if a clear value is given and DONT_CARE loaded otherwise.
+	*
+	* @note Imported images are expected to be in their initial layout when the graph is executed and are left in their final layout
+	* @note Transient images are shared by all frames in flight, execute() must be recorded for one queue and frames are ordered on it
+	*/
+	class RenderGraph
+	{
+	public:
+		typedef uint32_t ImageHandle;
+		static const ImageHandle invalidImage = UINT32_MAX;
+
+		struct ImageInfo {
+			VkFormat format;
+			/** @brief Size in texels, if zero the size is the graph's extent multiplied by scale */
+			uint32_t width = 0;
+			uint32_t height = 0;
+			float scale = 1.0f;
+			VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+			/** @brief Usage flags in addition to the ones derived from the passes (e.g. for pipelines outside the graph sampling the image) */
+			VkImageUsageFlags usage = 0;
+			ImageInfo(VkFormat format) : format(format) {}
+		};
+
+		enum class PassType { Graphics, Compute };
+
+		/** @brief Render pass state of a pass, passed to the pass's execute function */
+		struct PassContext {
+			VkRenderPass renderPass;
+			uint32_t subpass;
+			VkExtent2D extent;
+		};
+
+		typedef std::function<void(VkCommandBuffer commandBuffer, const PassContext &context)> ExecuteFunction;
+
+		enum class Access {
+			ColorAttachment,
+			DepthAttachment,
+			InputAttachment,
+			Sampled,
+			StorageRead,
+			StorageWrite
+		};
+
+		class Pass
+		{
+		public:
+			void writeColor(ImageHandle image);
+			void writeColor(ImageHandle image, VkClearColorValue clearValue);
+			void writeDepth(ImageHandle image);
+			void writeDepth(ImageHandle image, VkClearDepthStencilValue clearValue);
+			void readInput(ImageHandle image);
+			void readSampled(ImageHandle image, VkPipelineStageFlags stages = 0);
+			void readStorage(ImageHandle image, VkPipelineStageFlags stages = 0);
+			void writeStorage(ImageHandle image, VkPipelineStageFlags stages = 0);
+		private:
+			friend class RenderGraph;
+			struct Use {
+				ImageHandle image;
+				Access access;
+				VkPipelineStageFlags stages;
+				bool clear;
+				VkClearValue clearValue;
+			};
+			std::string name;
+			PassType type;
+			ExecuteFunction function;
+			std::vector<Use> uses;
+			// Set by compile()
+			bool culled = false;
+			uint32_t group = UINT32_MAX;
+			uint32_t subpass = 0;
+			void addUse(ImageHandle image, Access access, VkPipelineStageFlags stages, const VkClearValue *clearValue);
+		};
+
+		struct Statistics {
+			uint32_t passCount = 0;
+			uint32_t culledPasses = 0;
+			uint32_t renderPassCount = 0;
+			uint32_t barrierCount = 0;
+			/** @brief Memory of all transient images if every image had memory of its own */
+			VkDeviceSize transientImageBytes = 0;
+			/** @brief Memory actually allocated for the transient images */
+			VkDeviceSize allocatedBytes = 0;
+		};
+
+		RenderGraph(vks::VulkanDevice *device, uint32_t width, uint32_t height);
+		~RenderGraph();
+		ImageHandle createImage(const std::string &name, const ImageInfo &info);
+		ImageHandle importImage(const std::string &name, VkImage image, VkImageView view, VkFormat format, uint32_t width, uint32_t height, VkImageLayout initialLayout, VkImageLayout finalLayout);
+		void setImportedImage(ImageHandle handle, VkImage image, VkImageView view, uint32_t width = 0, uint32_t height = 0);
+		void markOutput(ImageHandle handle, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		Pass &addPass(const std::string &name, PassType type, ExecuteFunction function);
+		void compile();
+		void resize(uint32_t width, uint32_t height);
+		void execute(VkCommandBuffer commandBuffer);
+		VkImage getImage(ImageHandle handle) const;
+		VkImageView getView(ImageHandle handle) const;
+		VkRenderPass getRenderPass(const Pass &pass) const;
+		uint32_t getSubpass(const Pass &pass) const;
+		const Statistics &getStatistics() const;
+	private:
+		// Layout, stages and accesses of an image at a point of the frame
+		struct ImageState {
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags stages = 0;
+			VkAccessFlags access = 0;
+			bool write = false;
+		};
+		struct Image {
+			std::string name;
+			VkFormat format;
+			uint32_t width = 0, height = 0;
+			float scale = 1.0f;
+			VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+			VkImageUsageFlags usage = 0;
+			bool imported = false;
+			bool output = false;
+			VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			// Lifetime in render pass groups, set by compile()
+			uint32_t firstGroup = UINT32_MAX;
+			uint32_t lastGroup = 0;
+			// Memory block shared with other transient images, UINT32_MAX for imported images
+			uint32_t memoryBlock = UINT32_MAX;
+		};
+		struct MemoryBlock {
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memoryTypeBits = UINT32_MAX;
+			std::vector<uint32_t> images;
+		};
+		// Passes executed together, a render pass with a subpass per graphics pass or a single compute pass
+		struct Group {
+			std::vector<uint32_t> passes;
+			bool graphics = false;
+			VkExtent2D extent = {};
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+			std::vector<ImageHandle> attachments;
+			std::vector<VkClearValue> clearValues;
+			// Barriers recorded before the group
+			std::vector<VkImageMemoryBarrier> barriers;
+			std::vector<ImageHandle> barrierImages;
+			VkPipelineStageFlags srcStageMask = 0;
+			VkPipelineStageFlags dstStageMask = 0;
+		};
+		vks::VulkanDevice *device;
+		VkExtent2D extent;
+		std::vector<Image> images;
+		std::vector<std::unique_ptr<Pass>> passes;
+		std::vector<uint32_t> passOrder;
+		std::vector<Group> groups;
+		std::vector<MemoryBlock> memoryBlocks;
+		// Barriers transitioning outputs and imported images to their final layout at the end of the graph
+		Group finalBarriers;
+		// Framebuffers by render pass and attachment views, imported images may change between frames
+		std::map<std::vector<uint64_t>, VkFramebuffer> framebuffers;
+		Statistics statistics;
+		bool compiled = false;
+		static bool isDepthFormat(VkFormat format);
+		static bool isWrite(Access access);
+		static bool isAttachment(Access access);
+		ImageState getUseState(const Pass::Use &use) const;
+		ImageState getGroupState(const Group &group, ImageHandle handle) const;
+		VkExtent2D getImageExtent(const Image &image) const;
+		bool sameExtent(const Image &a, const Image &b) const;
+		void cullPasses();
+		void sortPasses();
+		bool canMerge(const Group &group, const Pass &pass) const;
+		void buildGroups();
+		void computeLifetimes();
+		void assignMemoryBlocks();
+		void createTransientImages();
+		void destroyTransientImages();
+		void createRenderPasses();
+		void buildBarriers();
+		void addBarrier(Group &group, ImageHandle handle, const ImageState &src, const ImageState &dst);
+		VkFramebuffer getFramebuffer(const Group &group);
+		void recordBarriers(VkCommandBuffer commandBuffer, const Group &group);
+		void destroyFramebuffers();
+		void destroyCompiledState();
+	};
+}
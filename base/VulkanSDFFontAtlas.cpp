@@ -0,0 +1,609 @@
+/*
+* Signed distance field font atlas
+*
+* Builds a signed distance field atlas from a TrueType font at runtime: glyphs are rasterized at a multiple of the atlas resolution, turned
+* into distance fields by a jump flood distance transform in compute shaders and packed into the pages of an array texture on demand
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanSDFFontAtlas.h"
+#include "VulkanDevice.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// The imgui sources compile their own (static) copy of stb_truetype
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "imstb_truetype.h"
+
+namespace vks
+{
+	const VkFormat SDFFontAtlas::format;
+
+	namespace
+	{
+		// Packed position of the nearest outline texel (x in the low, y in the high 16 bits)
+		const VkFormat jumpFloodFormat = VK_FORMAT_R32_UINT;
+		// Work group size of the shaders in x and y
+		const uint32_t groupSize = 8;
+
+		// Shared by all three shaders
+		struct PushConstants {
+			// Atlas texel origin (xy) and size (zw) of the glyph written by the resolve pass
+			glm::ivec4 target;
+			int32_t page;
+			// Glyph of the batch (jump flood layer) resolved
+			int32_t layer;
+			int32_t oversampling;
+			// Jump flood step in source texels
+			int32_t step;
+			float spread;
+		};
+	}
+
+	/**
+	* Load the font, create the atlas and the compute pipelines
+	*
+	* @param device Device to create the atlas on
+	* @param queue Queue the glyphs are generated on, it has to support compute
+	* @param shadersPath Shader directory containing the SPIR-V files of the "base/sdf*.comp" shaders (e.g. getShadersPath())
+	* @param fontFilename TrueType font to generate the glyphs from
+	* @param settings Sizes of the atlas and the glyphs, fixed for the lifetime of the atlas
+	*/
+	SDFFontAtlas::SDFFontAtlas(vks::VulkanDevice *device, VkQueue queue, const std::string &shadersPath, const std::string &fontFilename, const Settings &settings) : device(device), queue(queue), settings(settings)
+	{
+		// stb_truetype reads the glyph outlines from the font data, the file stays mapped until the atlas is destroyed
+		fontInfo.reset(new stbtt_fontinfo());
+		if (!fontFile.open(fontFilename))
+		{
+			vks::tools::exitFatal("Could not open the font file \"" + fontFilename + "\"", -1);
+		}
+		const unsigned char *fontData = reinterpret_cast<const unsigned char*>(fontFile.data);
+		if (!stbtt_InitFont(fontInfo.get(), fontData, stbtt_GetFontOffsetForIndex(fontData, 0)))
+		{
+			vks::tools::exitFatal("Could not load the font file \"" + fontFilename + "\"", -1);
+		}
+		fontScale = stbtt_ScaleForPixelHeight(fontInfo.get(), settings.fontSize);
+		int fontAscent, fontDescent, fontLineGap;
+		stbtt_GetFontVMetrics(fontInfo.get(), &fontAscent, &fontDescent, &fontLineGap);
+		ascent = static_cast<float>(fontAscent) * fontScale;
+		lineHeight = static_cast<float>(fontAscent - fontDescent + fontLineGap) * fontScale;
+
+		pages.resize(settings.pageCount);
+		createAtlas();
+		createJumpFloodImages();
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &coverageBuffer, static_cast<VkDeviceSize>(settings.sourceDim) * settings.sourceDim * settings.batchSize));
+		VK_CHECK_RESULT(coverageBuffer.map());
+		createPipelines(shadersPath);
+
+		// Pages are cleared to the distance value of empty texels, the jump flood images stay in the general layout
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		const VkImageSubresourceRange atlasRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, settings.pageCount };
+		vks::tools::insertImageMemoryBarrier(commandBuffer, texture.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, atlasRange);
+		VkClearColorValue clearColor = {};
+		vkCmdClearColorImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &atlasRange);
+		vks::tools::insertImageMemoryBarrier(commandBuffer, texture.image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, atlasRange);
+		const VkImageSubresourceRange jumpFloodRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, settings.batchSize };
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			vks::tools::insertImageMemoryBarrier(commandBuffer, jumpFloodImages[i], 0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, jumpFloodRange);
+		}
+		device->flushCommandBuffer(commandBuffer, queue, true);
+	}
+
+	SDFFontAtlas::~SDFFontAtlas()
+	{
+		texture.destroy();
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			vkDestroyImageView(device->logicalDevice, jumpFloodViews[i], nullptr);
+			vkDestroyImage(device->logicalDevice, jumpFloodImages[i], nullptr);
+			device->freeMemory(jumpFloodMemory[i], jumpFloodAllocations[i]);
+		}
+		coverageBuffer.destroy();
+		vkDestroyPipeline(device->logicalDevice, seedPipeline, nullptr);
+		vkDestroyPipeline(device->logicalDevice, jumpFloodPipeline, nullptr);
+		vkDestroyPipeline(device->logicalDevice, resolvePipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		vkDestroyShaderModule(device->logicalDevice, seedModule, nullptr);
+		vkDestroyShaderModule(device->logicalDevice, jumpFloodModule, nullptr);
+		vkDestroyShaderModule(device->logicalDevice, resolveModule, nullptr);
+	}
+
+	/** @brief Create the array texture holding the pages, sampled and written through a single view */
+	void SDFFontAtlas::createAtlas()
+	{
+		texture.device = device;
+		texture.width = settings.pageDim;
+		texture.height = settings.pageDim;
+		texture.mipLevels = 1;
+		texture.layerCount = settings.pageCount;
+		texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = format;
+		imageCI.extent = { settings.pageDim, settings.pageDim, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = settings.pageCount;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		// Transfer destination for clearing evicted pages
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &texture.image));
+		VK_CHECK_RESULT(device->allocateImageMemory(texture.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture.deviceMemory, &texture.allocation));
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewCI.format = format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, settings.pageCount };
+		viewCI.image = texture.image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &texture.view));
+
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.minLod = 0.0f;
+		samplerCI.maxLod = 1.0f;
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &texture.sampler));
+		texture.updateDescriptor();
+	}
+
+	/** @brief Create the jump flood ping-pong images, one layer per glyph of a batch */
+	void SDFFontAtlas::createJumpFloodImages()
+	{
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = jumpFloodFormat;
+		imageCI.extent = { settings.sourceDim, settings.sourceDim, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = settings.batchSize;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewCI.format = jumpFloodFormat;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, settings.batchSize };
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &jumpFloodImages[i]));
+			VK_CHECK_RESULT(device->allocateImageMemory(jumpFloodImages[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &jumpFloodMemory[i], &jumpFloodAllocations[i]));
+			viewCI.image = jumpFloodImages[i];
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &jumpFloodViews[i]));
+		}
+	}
+
+	/** @brief Load the shaders, create the compute pipelines and the descriptor sets of both jump flood directions */
+	void SDFFontAtlas::createPipelines(const std::string &shadersPath)
+	{
+#if defined(__ANDROID__)
+		seedModule = vks::tools::loadShader(androidApp->activity->assetManager, (shadersPath + "base/sdfseed.comp.spv").c_str(), device->logicalDevice);
+		jumpFloodModule = vks::tools::loadShader(androidApp->activity->assetManager, (shadersPath + "base/sdfjumpflood.comp.spv").c_str(), device->logicalDevice);
+		resolveModule = vks::tools::loadShader(androidApp->activity->assetManager, (shadersPath + "base/sdfresolve.comp.spv").c_str(), device->logicalDevice);
+#else
+		seedModule = vks::tools::loadShader((shadersPath + "base/sdfseed.comp.spv").c_str(), device->logicalDevice);
+		jumpFloodModule = vks::tools::loadShader((shadersPath + "base/sdfjumpflood.comp.spv").c_str(), device->logicalDevice);
+		resolveModule = vks::tools::loadShader((shadersPath + "base/sdfresolve.comp.spv").c_str(), device->logicalDevice);
+#endif
+		if ((seedModule == VK_NULL_HANDLE) || (jumpFloodModule == VK_NULL_HANDLE) || (resolveModule == VK_NULL_HANDLE))
+		{
+			vks::tools::exitFatal("Could not load the distance field shaders from " + shadersPath + "base/", -1);
+		}
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Coverage of the rasterized glyphs
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Jump flood image read by the pass
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Jump flood image written by the pass
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3: Atlas pages
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCI.stage.pName = "main";
+		pipelineCI.stage.module = seedModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &seedPipeline));
+		pipelineCI.stage.module = jumpFloodModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &jumpFloodPipeline));
+		pipelineCI.stage.module = resolveModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &resolvePipeline));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 6),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSets[i]));
+			VkDescriptorImageInfo inputDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, jumpFloodViews[i], VK_IMAGE_LAYOUT_GENERAL);
+			VkDescriptorImageInfo outputDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, jumpFloodViews[1 - i], VK_IMAGE_LAYOUT_GENERAL);
+			VkDescriptorImageInfo atlasDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, texture.view, VK_IMAGE_LAYOUT_GENERAL);
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &coverageBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &inputDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &outputDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3, &atlasDescriptor),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+	}
+
+	/**
+	* Find room for a glyph's rectangle, evicting the least recently used page if no page has room left
+	*
+	* @param width Width of the rectangle in atlas texels
+	* @param height Height of the rectangle in atlas texels
+	* @param pageIndex Page the rectangle was placed on
+	* @param position Top left corner of the rectangle on the page
+	* @param clearedPages Pages evicted by the current request, they have to be cleared before glyphs are written to them
+	*
+	* @return False if all pages with room are in use by the current request
+	*/
+	bool SDFFontAtlas::allocate(uint32_t width, uint32_t height, uint32_t &pageIndex, glm::ivec2 &position, std::vector<uint32_t> &clearedPages)
+	{
+		// One texel between the rectangles, so filtering at their edges doesn't pick up a neighbour
+		const uint32_t paddedWidth = width + 1;
+		const uint32_t paddedHeight = height + 1;
+		auto place = [&](uint32_t index) {
+			Page &page = pages[index];
+			if (page.cursorX + paddedWidth > settings.pageDim)
+			{
+				page.cursorX = 0;
+				page.cursorY += page.rowHeight;
+				page.rowHeight = 0;
+			}
+			if (page.cursorY + paddedHeight > settings.pageDim)
+			{
+				return false;
+			}
+			position = glm::ivec2(static_cast<int>(page.cursorX), static_cast<int>(page.cursorY));
+			page.cursorX += paddedWidth;
+			page.rowHeight = std::max(page.rowHeight, paddedHeight);
+			page.lastUse = requestCount;
+			pageIndex = index;
+			return true;
+		};
+		for (uint32_t i = 0; i < settings.pageCount; i++)
+		{
+			// Starting a new row on a full page leaves its cursor at the bottom, so later attempts fail right away
+			if (place(i))
+			{
+				return true;
+			}
+		}
+		uint32_t leastRecentlyUsed = settings.pageCount;
+		for (uint32_t i = 0; i < settings.pageCount; i++)
+		{
+			if ((pages[i].lastUse < requestCount) && ((leastRecentlyUsed == settings.pageCount) || (pages[i].lastUse < pages[leastRecentlyUsed].lastUse)))
+			{
+				leastRecentlyUsed = i;
+			}
+		}
+		if (leastRecentlyUsed == settings.pageCount)
+		{
+			return false;
+		}
+		evict(leastRecentlyUsed);
+		clearedPages.push_back(leastRecentlyUsed);
+		return place(leastRecentlyUsed);
+	}
+
+	/** @brief Remove all glyphs of a page and reset its packing state */
+	void SDFFontAtlas::evict(uint32_t pageIndex)
+	{
+		Page &page = pages[pageIndex];
+		for (uint32_t codepoint : page.codepoints)
+		{
+			glyphs.erase(codepoint);
+		}
+		page = Page();
+		statistics.evictedPages++;
+	}
+
+	/**
+	* Rasterize a batch of glyphs and write their distance fields to the atlas
+	*
+	* @param batch Glyphs to generate, at most Settings::batchSize
+	* @param clearedPages Pages to clear before the glyphs are written
+	*/
+	void SDFFontAtlas::generate(const std::vector<PendingGlyph> &batch, const std::vector<uint32_t> &clearedPages)
+	{
+		// Each glyph is rasterized into its own layer, offset by the padding so the distance field can extend beyond its outline
+		const size_t layerSize = static_cast<size_t>(settings.sourceDim) * settings.sourceDim;
+		uint8_t *coverage = static_cast<uint8_t*>(coverageBuffer.mapped);
+		memset(coverage, 0, layerSize * batch.size());
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			const PendingGlyph &glyph = batch[i];
+			const uint32_t padding = settings.spread * glyph.oversampling;
+			const float scale = fontScale * static_cast<float>(glyph.oversampling);
+			stbtt_MakeGlyphBitmap(fontInfo.get(), coverage + i * layerSize + padding * settings.sourceDim + padding, glyph.x1 - glyph.x0, glyph.y1 - glyph.y0, static_cast<int>(settings.sourceDim), scale, scale, glyph.glyphIndex);
+		}
+
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		const VkImageSubresourceRange atlasRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, settings.pageCount };
+		// Waits for all earlier submissions sampling the atlas
+		vks::tools::insertImageMemoryBarrier(commandBuffer, texture.image, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, atlasRange);
+		if (!clearedPages.empty())
+		{
+			VkClearColorValue clearColor = {};
+			std::vector<VkImageSubresourceRange> clearRanges;
+			for (uint32_t page : clearedPages)
+			{
+				clearRanges.push_back({ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, page, 1 });
+			}
+			vkCmdClearColorImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, static_cast<uint32_t>(clearRanges.size()), clearRanges.data());
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		VkMemoryBarrier passBarrier = vks::initializers::memoryBarrier();
+		passBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		passBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		PushConstants pushConstants = {};
+		pushConstants.spread = static_cast<float>(settings.spread);
+		const uint32_t sourceGroupCount = (settings.sourceDim + groupSize - 1) / groupSize;
+		const uint32_t layerCount = static_cast<uint32_t>(batch.size());
+
+		// The seed pass writes image 0, each jump flood pass reads the image written by the previous one
+		uint32_t current = 0;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, seedPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[1], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+		vkCmdDispatch(commandBuffer, sourceGroupCount, sourceGroupCount, layerCount);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, jumpFloodPipeline);
+		for (uint32_t step = settings.sourceDim / 2; step > 0; step /= 2)
+		{
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &passBarrier, 0, nullptr, 0, nullptr);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[current], 0, nullptr);
+			pushConstants.step = static_cast<int32_t>(step);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, sourceGroupCount, sourceGroupCount, layerCount);
+			current = 1 - current;
+		}
+
+		// One dispatch per glyph over its rectangle in the atlas
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &passBarrier, 0, nullptr, 0, nullptr);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, resolvePipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[current], 0, nullptr);
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			const PendingGlyph &glyph = batch[i];
+			pushConstants.target = glyph.target;
+			pushConstants.page = static_cast<int32_t>(glyphs[glyph.codepoint].page);
+			pushConstants.layer = static_cast<int32_t>(i);
+			pushConstants.oversampling = static_cast<int32_t>(glyph.oversampling);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, (glyph.target.z + groupSize - 1) / groupSize, (glyph.target.w + groupSize - 1) / groupSize, 1);
+		}
+
+		vks::tools::insertImageMemoryBarrier(commandBuffer, texture.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, atlasRange);
+		// The coverage buffer is reused by the next batch, so the submission is waited on
+		device->flushCommandBuffer(commandBuffer, queue, true);
+	}
+
+	/** @brief Make the glyphs of an utf-8 string resident, see request(const std::vector<uint32_t>&) */
+	bool SDFFontAtlas::request(const std::string &text)
+	{
+		return request(decodeUTF8(text));
+	}
+
+	/**
+	* Make glyphs resident in the atlas, generating the missing ones
+	*
+	* @param codepoints Unicode codepoints of the glyphs, duplicates are fine
+	*
+	* @return False if some of the glyphs didn't fit into the atlas (see Statistics::failedGlyphs)
+	*/
+	bool SDFFontAtlas::request(const std::vector<uint32_t> &codepoints)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		requestCount++;
+
+		// Resident glyphs are stamped first, so their pages aren't evicted in favour of the missing ones
+		for (uint32_t codepoint : codepoints)
+		{
+			auto it = glyphs.find(codepoint);
+			if ((it != glyphs.end()) && (it->second.size.x > 0.0f))
+			{
+				pages[it->second.page].lastUse = requestCount;
+			}
+		}
+
+		bool complete = true;
+		std::vector<PendingGlyph> pending;
+		std::vector<uint32_t> clearedPages;
+		for (uint32_t codepoint : codepoints)
+		{
+			if (glyphs.find(codepoint) != glyphs.end())
+			{
+				continue;
+			}
+			const int glyphIndex = stbtt_FindGlyphIndex(fontInfo.get(), static_cast<int>(codepoint));
+			int advanceWidth, leftSideBearing;
+			stbtt_GetGlyphHMetrics(fontInfo.get(), glyphIndex, &advanceWidth, &leftSideBearing);
+			Glyph glyph = {};
+			glyph.advance = static_cast<float>(advanceWidth) * fontScale;
+			// Glyphs without an outline (e.g. spaces) only advance the pen and take no room in the atlas
+			if (stbtt_IsGlyphEmpty(fontInfo.get(), glyphIndex))
+			{
+				glyphs[codepoint] = glyph;
+				continue;
+			}
+
+			// Highest oversampling up to the setting at which the padded glyph fits into the source images
+			PendingGlyph pendingGlyph = {};
+			pendingGlyph.codepoint = codepoint;
+			pendingGlyph.glyphIndex = glyphIndex;
+			pendingGlyph.oversampling = std::max(settings.oversampling, 1u);
+			uint32_t width, height;
+			for (;;)
+			{
+				const float scale = fontScale * static_cast<float>(pendingGlyph.oversampling);
+				stbtt_GetGlyphBitmapBox(fontInfo.get(), glyphIndex, scale, scale, &pendingGlyph.x0, &pendingGlyph.y0, &pendingGlyph.x1, &pendingGlyph.y1);
+				const float oversampling = static_cast<float>(pendingGlyph.oversampling);
+				width = static_cast<uint32_t>(std::ceil(static_cast<float>(pendingGlyph.x1 - pendingGlyph.x0) / oversampling)) + 2 * settings.spread;
+				height = static_cast<uint32_t>(std::ceil(static_cast<float>(pendingGlyph.y1 - pendingGlyph.y0) / oversampling)) + 2 * settings.spread;
+				if (((width * pendingGlyph.oversampling <= settings.sourceDim) && (height * pendingGlyph.oversampling <= settings.sourceDim)) || (pendingGlyph.oversampling == 1))
+				{
+					break;
+				}
+				pendingGlyph.oversampling--;
+			}
+
+			uint32_t pageIndex;
+			glm::ivec2 position;
+			if ((width > settings.sourceDim) || (height > settings.sourceDim) || (width >= settings.pageDim) || (height >= settings.pageDim)
+				|| !allocate(width, height, pageIndex, position, clearedPages))
+			{
+				statistics.failedGlyphs++;
+				complete = false;
+				continue;
+			}
+			const float pageDim = static_cast<float>(settings.pageDim);
+			glyph.page = pageIndex;
+			glyph.uv = glm::vec4(position.x / pageDim, position.y / pageDim, (position.x + width) / pageDim, (position.y + height) / pageDim);
+			glyph.offset = glm::vec2(static_cast<float>(pendingGlyph.x0) / pendingGlyph.oversampling - settings.spread, static_cast<float>(pendingGlyph.y0) / pendingGlyph.oversampling - settings.spread);
+			glyph.size = glm::vec2(static_cast<float>(width), static_cast<float>(height));
+			glyphs[codepoint] = glyph;
+			pages[pageIndex].codepoints.push_back(codepoint);
+			pendingGlyph.target = glm::ivec4(position.x, position.y, static_cast<int>(width), static_cast<int>(height));
+			pending.push_back(pendingGlyph);
+		}
+
+		if (!pending.empty())
+		{
+			// Pages evicted by this request are cleared by its first batch
+			for (size_t first = 0; first < pending.size(); first += settings.batchSize)
+			{
+				const size_t last = std::min(first + settings.batchSize, pending.size());
+				generate(std::vector<PendingGlyph>(pending.begin() + first, pending.begin() + last), (first == 0) ? clearedPages : std::vector<uint32_t>());
+			}
+			statistics.generatedGlyphs += static_cast<uint32_t>(pending.size());
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			statistics.generationTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		}
+		statistics.residentGlyphs = static_cast<uint32_t>(glyphs.size());
+		return complete;
+	}
+
+	/** @brief Metrics and atlas location of a glyph, nullptr if it isn't resident */
+	const SDFFontAtlas::Glyph *SDFFontAtlas::getGlyph(uint32_t codepoint) const
+	{
+		auto it = glyphs.find(codepoint);
+		return (it != glyphs.end()) ? &it->second : nullptr;
+	}
+
+	/** @brief Adjustment of the pen advance between two glyphs in atlas texels */
+	float SDFFontAtlas::getKerning(uint32_t first, uint32_t second) const
+	{
+		return static_cast<float>(stbtt_GetCodepointKernAdvance(fontInfo.get(), static_cast<int>(first), static_cast<int>(second))) * fontScale;
+	}
+
+	/** @brief Distance from the top of a line to the baseline in atlas texels */
+	float SDFFontAtlas::getAscent() const
+	{
+		return ascent;
+	}
+
+	/** @brief Distance between the baselines of two lines in atlas texels */
+	float SDFFontAtlas::getLineHeight() const
+	{
+		return lineHeight;
+	}
+
+	const vks::Texture2DArray &SDFFontAtlas::getTexture() const
+	{
+		return texture;
+	}
+
+	const SDFFontAtlas::Settings &SDFFontAtlas::getSettings() const
+	{
+		return settings;
+	}
+
+	const SDFFontAtlas::Statistics &SDFFontAtlas::getStatistics() const
+	{
+		return statistics;
+	}
+
+	/** @brief Unicode codepoints of an utf-8 string, invalid sequences are replaced with U+FFFD */
+	std::vector<uint32_t> SDFFontAtlas::decodeUTF8(const std::string &text)
+	{
+		std::vector<uint32_t> codepoints;
+		size_t i = 0;
+		while (i < text.size())
+		{
+			const uint8_t lead = static_cast<uint8_t>(text[i]);
+			uint32_t codepoint;
+			uint32_t length;
+			if (lead < 0x80)
+			{
+				codepoint = lead;
+				length = 1;
+			}
+			else if ((lead & 0xE0) == 0xC0)
+			{
+				codepoint = lead & 0x1F;
+				length = 2;
+			}
+			else if ((lead & 0xF0) == 0xE0)
+			{
+				codepoint = lead & 0x0F;
+				length = 3;
+			}
+			else if ((lead & 0xF8) == 0xF0)
+			{
+				codepoint = lead & 0x07;
+				length = 4;
+			}
+			else
+			{
+				codepoints.push_back(0xFFFD);
+				i++;
+				continue;
+			}
+			uint32_t n = 1;
+			for (; (n < length) && (i + n < text.size()) && ((static_cast<uint8_t>(text[i + n]) & 0xC0) == 0x80); n++)
+			{
+				codepoint = (codepoint << 6) | (static_cast<uint8_t>(text[i + n]) & 0x3F);
+			}
+			codepoints.push_back((n == length) ? codepoint : 0xFFFD);
+			i += n;
+		}
+		return codepoints;
+	}
+}
@@ -0,0 +1,167 @@
+/*
+* Signed distance field font atlas
+*
+* Builds a signed distance field atlas from a TrueType font at runtime: glyphs are rasterized at a multiple of the atlas resolution, turned
+* into distance fields by a jump flood distance transform in compute shaders and packed into the pages of an array texture on demand
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+#include "VulkanTexture.h"
+#include "VulkanMappedFile.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+struct stbtt_fontinfo;
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Signed distance field font atlas generated with the "base/sdfseed.comp", "base/sdfjumpflood.comp" and "base/sdfresolve.comp" compute shaders
+	*
+	* Usage:
+	*	fontAtlas.reset(new vks::SDFFontAtlas(vulkanDevice, queue, getShadersPath(), getAssetPath() + "Roboto-Medium.ttf", vks::SDFFontAtlas::Settings()));
+	*	// Make all glyphs of an utf-8 string resident, generating the missing ones
+	*	fontAtlas->request(text);
+	*	for (uint32_t codepoint : vks::SDFFontAtlas::decodeUTF8(text)) {
+	*		const vks::SDFFontAtlas::Glyph *glyph = fontAtlas->getGlyph(codepoint);
+	*		// Quad from pen + glyph->offset with glyph->size, sampling glyph->uv of layer glyph->page of getTexture()
+	*	}
+	*
+	* Missing glyphs are rasterized with stb_truetype at Settings::oversampling times the atlas resolution into a host visible buffer, a batch
+	* of up to Settings::batchSize glyphs at a time. The seed pass marks the texels on the outline of each glyph, the jump flood passes (with
+	* steps halving from half the source size down to one texel) propagate the nearest outline texel to every texel and the resolve pass writes
+	* the signed distance at the center of each atlas texel, mapped to [0, 1] with 0.5 on the outline, into the glyph's rectangle.
+	* Glyphs are packed into the pages (array layers) of the atlas in rows. Each request() stamps the pages it uses, if no page has room for a
+	* new glyph the least recently used page is cleared and all of its glyphs are evicted, to be generated again when they are requested.
+	*
+	* @note The atlas is stored as rgba8 (with the distance in all channels), as r8 storage images need shaderStorageImageExtendedFormats
+	* @note request() waits for the generation to finish, command buffers using glyphs of evicted pages have to be rebuilt after it
+	* @note Glyphs that don't fit once all pages are used by the current request are skipped and counted in Statistics::failedGlyphs
+	*/
+	class SDFFontAtlas
+	{
+	public:
+		static const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+
+		struct Settings {
+			// Pixel height (ascent to descent) of the font in atlas texels
+			float fontSize = 36.0f;
+			// Distance in atlas texels that maps to the range of the distance field, also the padding around each glyph
+			uint32_t spread = 6;
+			// Resolution of the rasterized glyphs relative to the atlas, lowered for glyphs that wouldn't fit into the source images
+			uint32_t oversampling = 8;
+			// Size of the (square) jump flood source images
+			uint32_t sourceDim = 512;
+			// Glyphs rasterized and transformed per submission
+			uint32_t batchSize = 8;
+			uint32_t pageDim = 512;
+			uint32_t pageCount = 4;
+		};
+
+		struct Glyph {
+			// Array layer of the atlas
+			uint32_t page;
+			// Normalized texture coordinates of the glyph's rectangle (x0, y0, x1, y1)
+			glm::vec4 uv;
+			// Offset of the rectangle's top left corner from the pen position on the baseline and its size, in atlas texels (y pointing down)
+			glm::vec2 offset;
+			glm::vec2 size;
+			float advance;
+		};
+
+		struct Statistics {
+			// Glyphs currently in the atlas
+			uint32_t residentGlyphs = 0;
+			// Totals since construction
+			uint32_t generatedGlyphs = 0;
+			uint32_t evictedPages = 0;
+			uint32_t failedGlyphs = 0;
+			// Time taken by the last request() call that generated glyphs in milliseconds
+			double generationTime = 0.0;
+		};
+
+	private:
+		struct Page {
+			// Row packing state, in atlas texels
+			uint32_t cursorX = 0;
+			uint32_t cursorY = 0;
+			uint32_t rowHeight = 0;
+			// Number of the last request() that used a glyph of the page
+			uint64_t lastUse = 0;
+			std::vector<uint32_t> codepoints;
+		};
+		struct PendingGlyph {
+			uint32_t codepoint;
+			int glyphIndex;
+			uint32_t oversampling;
+			// Bitmap box at the source resolution
+			int x0, y0, x1, y1;
+			glm::ivec4 target;
+		};
+		vks::VulkanDevice *device;
+		VkQueue queue;
+		Settings settings;
+		Statistics statistics;
+		vks::MappedFile fontFile;
+		std::unique_ptr<stbtt_fontinfo> fontInfo;
+		float fontScale;
+		float ascent;
+		float lineHeight;
+		std::unordered_map<uint32_t, Glyph> glyphs;
+		std::vector<Page> pages;
+		uint64_t requestCount = 0;
+		// Sampled by the text and written by the resolve pass through the same view
+		vks::Texture2DArray texture;
+		// Jump flood ping-pong images with the packed position of the nearest outline texel
+		VkImage jumpFloodImages[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+		VkDeviceMemory jumpFloodMemory[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+		vks::MemoryAllocation jumpFloodAllocations[2]{};
+		VkImageView jumpFloodViews[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+		// Coverage of the rasterized glyphs, one byte per texel and sourceDim * sourceDim bytes per glyph of the batch
+		vks::Buffer coverageBuffer;
+		VkShaderModule seedModule = VK_NULL_HANDLE;
+		VkShaderModule jumpFloodModule = VK_NULL_HANDLE;
+		VkShaderModule resolveModule = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		// Set i reads jump flood image i and writes the other one
+		VkDescriptorSet descriptorSets[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline seedPipeline = VK_NULL_HANDLE;
+		VkPipeline jumpFloodPipeline = VK_NULL_HANDLE;
+		VkPipeline resolvePipeline = VK_NULL_HANDLE;
+		void createAtlas();
+		void createJumpFloodImages();
+		void createPipelines(const std::string &shadersPath);
+		bool allocate(uint32_t width, uint32_t height, uint32_t &pageIndex, glm::ivec2 &position, std::vector<uint32_t> &clearedPages);
+		void evict(uint32_t pageIndex);
+		void generate(const std::vector<PendingGlyph> &batch, const std::vector<uint32_t> &clearedPages);
+	public:
+		SDFFontAtlas(vks::VulkanDevice *device, VkQueue queue, const std::string &shadersPath, const std::string &fontFilename, const Settings &settings);
+		~SDFFontAtlas();
+		bool request(const std::string &text);
+		bool request(const std::vector<uint32_t> &codepoints);
+		const Glyph *getGlyph(uint32_t codepoint) const;
+		float getKerning(uint32_t first, uint32_t second) const;
+		float getAscent() const;
+		float getLineHeight() const;
+		const vks::Texture2DArray &getTexture() const;
+		const Settings &getSettings() const;
+		const Statistics &getStatistics() const;
+		static std::vector<uint32_t> decodeUTF8(const std::string &text);
+	};
+}
@@ -0,0 +1,140 @@
+/*
+* Sampler cache
+*
+* Hands out one shared VkSampler per distinct sampler state, so textures with the same filtering and addressing don't each create a
+* sampler object of their own
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanSamplerCache.h"
+#include <cstring>
+#include <assert.h>
+
+namespace vks
+{
+	/** @brief Compares all members of the create infos that affect the sampler's state */
+	bool SamplerCache::Key::operator==(const Key &other) const
+	{
+		const VkSamplerCreateInfo &a = createInfo;
+		const VkSamplerCreateInfo &b = other.createInfo;
+		return (a.flags == b.flags) && (a.magFilter == b.magFilter) && (a.minFilter == b.minFilter) && (a.mipmapMode == b.mipmapMode)
+			&& (a.addressModeU == b.addressModeU) && (a.addressModeV == b.addressModeV) && (a.addressModeW == b.addressModeW)
+			&& (a.mipLodBias == b.mipLodBias) && (a.anisotropyEnable == b.anisotropyEnable) && (a.maxAnisotropy == b.maxAnisotropy)
+			&& (a.compareEnable == b.compareEnable) && (a.compareOp == b.compareOp) && (a.minLod == b.minLod) && (a.maxLod == b.maxLod)
+			&& (a.borderColor == b.borderColor) && (a.unnormalizedCoordinates == b.unnormalizedCoordinates);
+	}
+
+	size_t SamplerCache::KeyHash::operator()(const Key &key) const
+	{
+		// FNV-1a over the members compared by Key::operator==
+		uint64_t hash = 14695981039346656037ull;
+		auto combine = [&hash](uint64_t value) {
+			hash ^= value;
+			hash *= 1099511628211ull;
+		};
+		auto combineFloat = [&combine](float value) {
+			// Positive and negative zero compare equal, so they must hash equal
+			uint32_t bits = 0;
+			if (value != 0.0f)
+			{
+				memcpy(&bits, &value, sizeof(bits));
+			}
+			combine(bits);
+		};
+		const VkSamplerCreateInfo &createInfo = key.createInfo;
+		combine(createInfo.flags);
+		combine(createInfo.magFilter);
+		combine(createInfo.minFilter);
+		combine(createInfo.mipmapMode);
+		combine(createInfo.addressModeU);
+		combine(createInfo.addressModeV);
+		combine(createInfo.addressModeW);
+		combineFloat(createInfo.mipLodBias);
+		combine(createInfo.anisotropyEnable);
+		combineFloat(createInfo.maxAnisotropy);
+		combine(createInfo.compareEnable);
+		combine(createInfo.compareOp);
+		combineFloat(createInfo.minLod);
+		combineFloat(createInfo.maxLod);
+		combine(createInfo.borderColor);
+		combine(createInfo.unnormalizedCoordinates);
+		return static_cast<size_t>(hash);
+	}
+
+	SamplerCache::SamplerCache(VkDevice device) : device(device)
+	{
+	}
+
+	SamplerCache::~SamplerCache()
+	{
+		for (auto &entry : entries)
+		{
+			vkDestroySampler(device, entry.second.sampler, nullptr);
+		}
+	}
+
+	/**
+	* Get a sampler with the given state, creating it if there is no live sampler with that state
+	*
+	* @param createInfo Sampler state, must not have a pNext chain
+	*
+	* @return Sampler owned by the cache, to be passed to release() once it's no longer used
+	*/
+	VkSampler SamplerCache::get(const VkSamplerCreateInfo &createInfo)
+	{
+		assert(createInfo.pNext == nullptr);
+		Key key;
+		key.createInfo = createInfo;
+		auto it = entries.find(key);
+		if (it != entries.end())
+		{
+			hits++;
+			it->second.references++;
+			return it->second.sampler;
+		}
+		Entry entry;
+		entry.references = 1;
+		VK_CHECK_RESULT(vkCreateSampler(device, &createInfo, nullptr, &entry.sampler));
+		entries[key] = entry;
+		keys[entry.sampler] = key;
+		return entry.sampler;
+	}
+
+	/**
+	* Release a reference to a sampler returned by get(), destroying it if it was the last one
+	*
+	* @note The sampler must no longer be used by pending command buffers once its last reference is released
+	*
+	* @return False if the sampler hasn't been created by the cache (or has already been destroyed by it)
+	*/
+	bool SamplerCache::release(VkSampler sampler)
+	{
+		auto key = keys.find(sampler);
+		if (key == keys.end())
+		{
+			return false;
+		}
+		auto entry = entries.find(key->second);
+		assert(entry != entries.end());
+		if (--entry->second.references == 0)
+		{
+			vkDestroySampler(device, sampler, nullptr);
+			entries.erase(entry);
+			keys.erase(key);
+		}
+		return true;
+	}
+
+	/** @brief Number of live samplers created by the cache */
+	uint32_t SamplerCache::getSamplerCount() const
+	{
+		return static_cast<uint32_t>(entries.size());
+	}
+
+	/** @brief Number of requests that have been served by a live sampler, i.e. the sampler objects saved */
+	uint32_t SamplerCache::getHitCount() const
+	{
+		return hits;
+	}
+}
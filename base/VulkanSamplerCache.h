@@ -0,0 +1,65 @@
+/*
+* Sampler cache
+*
+* Hands out one shared VkSampler per distinct sampler state, so textures with the same filtering and addressing don't each create a
+* sampler object of their own
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <unordered_map>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* Reference counted cache of samplers keyed by their create info
+	*
+	* Usage:
+	*	texture.sampler = vulkanDevice->getSamplerCache()->get(samplerCreateInfo);
+	*	...
+	*	vulkanDevice->getSamplerCache()->release(texture.sampler);
+	*
+	* Samplers are owned by the cache, callers must not destroy them. Every get() adds a reference to the sampler and every release()
+	* removes one, the sampler is destroyed once the last reference has been released. This keeps the number of live samplers well below
+	* maxSamplerAllocationCount even for scenes with thousands of textures. Create infos with a pNext chain (e.g. sampler YCbCr conversion
+	* or reduction modes) aren't cached, as their state can't be compared.
+	*
+	* @note release() returns false for samplers that haven't been created by the cache, so owners of textures that may have had their
+	* sampler replaced can destroy it themselves (see vks::Texture::destroy())
+	* @note The device's cache (see VulkanDevice::getSamplerCache()) is destroyed with the device, which also destroys samplers that have
+	* not been released
+	*/
+	class SamplerCache
+	{
+	private:
+		struct Key {
+			VkSamplerCreateInfo createInfo;
+			bool operator==(const Key &other) const;
+		};
+		struct KeyHash {
+			size_t operator()(const Key &key) const;
+		};
+		struct Entry {
+			VkSampler sampler;
+			// Number of get() calls that haven't been matched by a release() yet
+			uint32_t references;
+		};
+		VkDevice device;
+		std::unordered_map<Key, Entry, KeyHash> entries;
+		// Key of each live sampler, for release()
+		std::unordered_map<VkSampler, Key> keys;
+		// Number of get() calls that have been served by a live sampler
+		uint32_t hits = 0;
+	public:
+		explicit SamplerCache(VkDevice device);
+		~SamplerCache();
+		VkSampler get(const VkSamplerCreateInfo &createInfo);
+		bool release(VkSampler sampler);
+		uint32_t getSamplerCount() const;
+		uint32_t getHitCount() const;
+	};
+}
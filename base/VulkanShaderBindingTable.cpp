@@ -0,0 +1,185 @@
+/*
+* Shader binding table builder
+*
+* Packs the raygen, miss, hit and callable regions of a ray tracing pipeline's shader binding table into a single buffer, with records
+* that can carry inline data (e.g. per geometry material parameters) right behind the shader group handle
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanShaderBindingTable.h"
+#include "VulkanDevice.h"
+#include <algorithm>
+#include <cstring>
+#include <assert.h>
+
+namespace vks
+{
+	namespace
+	{
+		VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+	}
+
+	/**
+	* @param device Device the ray tracing pipeline was created on
+	* @param properties Ray tracing pipeline properties of the physical device, used for the handle size and the alignments
+	*/
+	ShaderBindingTableBuilder::ShaderBindingTableBuilder(vks::VulkanDevice *device, const VkPhysicalDeviceRayTracingPipelinePropertiesKHR &properties) : device(device), properties(properties)
+	{
+		vkGetRayTracingShaderGroupHandlesKHR = reinterpret_cast<PFN_vkGetRayTracingShaderGroupHandlesKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetRayTracingShaderGroupHandlesKHR"));
+		vkGetBufferDeviceAddressKHR = reinterpret_cast<PFN_vkGetBufferDeviceAddressKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetBufferDeviceAddressKHR"));
+	}
+
+	ShaderBindingTableBuilder::~ShaderBindingTableBuilder()
+	{
+		destroy();
+	}
+
+	/**
+	* Append a record to a region, records are stored in the order they are added
+	*
+	* @param region Region the record is added to
+	* @param groupIndex Index of the shader group in the pipeline's pGroups whose handle starts the record
+	* @param data (Optional) Inline data stored behind the handle, laid out as the shader's shaderRecordEXT block expects it
+	* @param dataSize (Optional) Size of the inline data in bytes
+	*
+	* @return Index of the record inside its region
+	*/
+	uint32_t ShaderBindingTableBuilder::addRecord(Region region, uint32_t groupIndex, const void *data, uint32_t dataSize)
+	{
+		Record record{};
+		record.groupIndex = groupIndex;
+		if (data && dataSize > 0) {
+			const uint8_t *bytes = static_cast<const uint8_t*>(data);
+			record.data.assign(bytes, bytes + dataSize);
+		}
+		records[region].push_back(record);
+		return static_cast<uint32_t>(records[region].size() - 1);
+	}
+
+	/**
+	* Fetch the shader group handles of the pipeline and write all records into a new buffer, replacing the previous one
+	*
+	* @param pipeline Ray tracing pipeline the records refer to
+	* @param groupCount Number of shader groups the pipeline was created with
+	*/
+	void ShaderBindingTableBuilder::build(VkPipeline pipeline, uint32_t groupCount)
+	{
+		destroy();
+
+		const uint32_t handleSize = properties.shaderGroupHandleSize;
+		std::vector<uint8_t> handles(groupCount * handleSize);
+		VK_CHECK_RESULT(vkGetRayTracingShaderGroupHandlesKHR(device->logicalDevice, pipeline, 0, groupCount, static_cast<size_t>(handles.size()), handles.data()));
+
+		// Lay out the regions
+		VkDeviceSize size = 0;
+		for (uint32_t i = 0; i < regionCount; i++) {
+			size_t dataSize = 0;
+			for (auto& record : records[i]) {
+				dataSize = std::max(dataSize, record.data.size());
+			}
+			const VkDeviceSize recordAlignment = (i == Raygen) ? properties.shaderGroupBaseAlignment : properties.shaderGroupHandleAlignment;
+			regionStrides[i] = alignUp(handleSize + dataSize, recordAlignment);
+			assert(records[i].empty() || regionStrides[i] <= properties.maxShaderGroupStride);
+			regionOffsets[i] = size;
+			size += alignUp(regionStrides[i] * records[i].size(), properties.shaderGroupBaseAlignment);
+		}
+		if (size == 0) {
+			return;
+		}
+
+		// Buffer addresses only need to meet the buffer's memory alignment, so leave room to move the start to the base alignment
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&buffer,
+			size + properties.shaderGroupBaseAlignment));
+		VK_CHECK_RESULT(buffer.map());
+
+		VkBufferDeviceAddressInfoKHR bufferDeviceAddressInfo{};
+		bufferDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+		bufferDeviceAddressInfo.buffer = buffer.buffer;
+		const VkDeviceAddress address = vkGetBufferDeviceAddressKHR(device->logicalDevice, &bufferDeviceAddressInfo);
+		baseAddress = alignUp(address, properties.shaderGroupBaseAlignment);
+		baseOffset = baseAddress - address;
+
+		// Write the records, padding between them stays zero
+		uint8_t *base = static_cast<uint8_t*>(buffer.mapped) + baseOffset;
+		memset(buffer.mapped, 0, static_cast<size_t>(size + properties.shaderGroupBaseAlignment));
+		for (uint32_t i = 0; i < regionCount; i++) {
+			for (size_t j = 0; j < records[i].size(); j++) {
+				const Record &record = records[i][j];
+				assert(record.groupIndex < groupCount);
+				uint8_t *dst = base + regionOffsets[i] + regionStrides[i] * j;
+				memcpy(dst, handles.data() + record.groupIndex * handleSize, handleSize);
+				if (!record.data.empty()) {
+					memcpy(dst + handleSize, record.data.data(), record.data.size());
+				}
+			}
+		}
+	}
+
+	/**
+	* Replace the inline data of a record in the built table
+	*
+	* @param region Region of the record
+	* @param recordIndex Index returned by addRecord()
+	* @param data Inline data
+	* @param dataSize Size of the inline data, must not exceed the largest data size of the region at build time
+	*/
+	void ShaderBindingTableBuilder::updateRecordData(Region region, uint32_t recordIndex, const void *data, uint32_t dataSize)
+	{
+		assert(buffer.mapped && recordIndex < records[region].size());
+		assert(properties.shaderGroupHandleSize + dataSize <= regionStrides[region]);
+		const uint8_t *bytes = static_cast<const uint8_t*>(data);
+		records[region][recordIndex].data.assign(bytes, bytes + dataSize);
+		uint8_t *dst = static_cast<uint8_t*>(buffer.mapped) + baseOffset + regionOffsets[region] + regionStrides[region] * recordIndex;
+		memcpy(dst + properties.shaderGroupHandleSize, data, dataSize);
+	}
+
+	/**
+	* Get the strided address region to pass to vkCmdTraceRaysKHR
+	*
+	* @param region Region to get
+	* @param firstRecord (Optional) First record of the region, selects the record for the raygen region
+	*
+	* @return Region starting at firstRecord, or an empty region if it has no records
+	*/
+	VkStridedDeviceAddressRegionKHR ShaderBindingTableBuilder::getRegion(Region region, uint32_t firstRecord) const
+	{
+		VkStridedDeviceAddressRegionKHR stridedDeviceAddressRegion{};
+		if (baseAddress == 0 || firstRecord >= records[region].size()) {
+			return stridedDeviceAddressRegion;
+		}
+		const uint32_t recordCount = (region == Raygen) ? 1 : static_cast<uint32_t>(records[region].size()) - firstRecord;
+		stridedDeviceAddressRegion.deviceAddress = baseAddress + regionOffsets[region] + regionStrides[region] * firstRecord;
+		stridedDeviceAddressRegion.stride = regionStrides[region];
+		stridedDeviceAddressRegion.size = regionStrides[region] * recordCount;
+		return stridedDeviceAddressRegion;
+	}
+
+	uint32_t ShaderBindingTableBuilder::getRecordCount(Region region) const
+	{
+		return static_cast<uint32_t>(records[region].size());
+	}
+
+	/** @brief Size of the built table without the alignment padding in front of it */
+	VkDeviceSize ShaderBindingTableBuilder::getSize() const
+	{
+		return (baseAddress == 0) ? 0 : buffer.size - properties.shaderGroupBaseAlignment;
+	}
+
+	/** @brief Release the buffer, the records are kept so the table can be built again (e.g. for a recreated pipeline) */
+	void ShaderBindingTableBuilder::destroy()
+	{
+		if (buffer.buffer) {
+			buffer.destroy();
+			buffer = vks::Buffer();
+		}
+		baseAddress = 0;
+		baseOffset = 0;
+	}
+}
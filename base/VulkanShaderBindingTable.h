@@ -0,0 +1,83 @@
+/*
+* Shader binding table builder
+*
+* Packs the raygen, miss, hit and callable regions of a ray tracing pipeline's shader binding table into a single buffer, with records
+* that can carry inline data (e.g. per geometry material parameters) right behind the shader group handle
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Shader binding table with one strided region per shader stage, all stored in one buffer
+	*
+	* Usage:
+	*	vks::ShaderBindingTableBuilder sbt(vulkanDevice, rayTracingPipelineProperties);
+	*	sbt.addRecord(vks::ShaderBindingTableBuilder::Raygen, 0);
+	*	sbt.addRecord(vks::ShaderBindingTableBuilder::Miss, 1);
+	*	// One hit record per geometry, reached with instanceShaderBindingTableRecordOffset + geometry index * sbtRecordStride (1)
+	*	for (auto& material : materials) {
+	*		sbt.addRecord(vks::ShaderBindingTableBuilder::Hit, 2, &material, sizeof(material));
+	*	}
+	*	sbt.build(pipeline, groupCount);
+	*	VkStridedDeviceAddressRegionKHR raygen = sbt.getRegion(vks::ShaderBindingTableBuilder::Raygen);
+	*	...
+	*	vkCmdTraceRaysKHR(commandBuffer, &raygen, &miss, &hit, &callable, width, height, 1);
+	*
+	* All records of a region share one stride: the handle size plus the largest inline data of the region, aligned to shaderGroupHandleAlignment.
+	* Every region starts at a multiple of shaderGroupBaseAlignment. Raygen records are additionally padded to shaderGroupBaseAlignment, as a raygen
+	* region holds exactly one record, so each of them can be selected with getRegion(Raygen, recordIndex).
+	* Inline data is read in the shaders through a shaderRecordEXT buffer block (GLSL) or [[vk::shader_record_ext]] (HLSL) with std430 layout.
+	*
+	* @note The buffer stays mapped, updateRecordData() changes the data of a record in place, the caller has to make sure the GPU isn't using it
+	*/
+	class ShaderBindingTableBuilder
+	{
+	public:
+		enum Region : uint32_t {
+			Raygen = 0,
+			Miss = 1,
+			Hit = 2,
+			Callable = 3,
+		};
+		static const uint32_t regionCount = 4;
+
+	private:
+		struct Record {
+			uint32_t groupIndex;
+			std::vector<uint8_t> data;
+		};
+		vks::VulkanDevice *device;
+		VkPhysicalDeviceRayTracingPipelinePropertiesKHR properties;
+		PFN_vkGetRayTracingShaderGroupHandlesKHR vkGetRayTracingShaderGroupHandlesKHR;
+		PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR;
+		std::vector<Record> records[regionCount];
+		// Offsets of the regions from the aligned start of the buffer
+		VkDeviceSize regionOffsets[regionCount]{};
+		VkDeviceSize regionStrides[regionCount]{};
+		// Buffer device address rounded up to shaderGroupBaseAlignment
+		VkDeviceAddress baseAddress = 0;
+		VkDeviceSize baseOffset = 0;
+		vks::Buffer buffer;
+	public:
+		ShaderBindingTableBuilder(vks::VulkanDevice *device, const VkPhysicalDeviceRayTracingPipelinePropertiesKHR &properties);
+		~ShaderBindingTableBuilder();
+		uint32_t addRecord(Region region, uint32_t groupIndex, const void *data = nullptr, uint32_t dataSize = 0);
+		void build(VkPipeline pipeline, uint32_t groupCount);
+		void updateRecordData(Region region, uint32_t recordIndex, const void *data, uint32_t dataSize);
+		VkStridedDeviceAddressRegionKHR getRegion(Region region, uint32_t firstRecord = 0) const;
+		uint32_t getRecordCount(Region region) const;
+		VkDeviceSize getSize() const;
+		void destroy();
+	};
+}
@@ -0,0 +1,177 @@
+/*
+* Shader module cache
+*
+* Shares shader modules between pipelines loading the same SPIR-V and, with VK_EXT_shader_module_identifier, defers module creation
+* until a pipeline actually has to be compiled
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanShaderModuleCache.h"
+#include <cstring>
+#include <assert.h>
+
+namespace vks
+{
+	/**
+	* @param device Logical device to create the modules on
+	* @param moduleIdentifiers Allow deferred stages, requires VK_EXT_shader_module_identifier and the shaderModuleIdentifier and pipelineCreationCacheControl features to be enabled
+	*/
+	ShaderModuleCache::ShaderModuleCache(VkDevice device, bool moduleIdentifiers) : device(device)
+	{
+		if (moduleIdentifiers)
+		{
+			vkGetShaderModuleCreateInfoIdentifierEXT = reinterpret_cast<PFN_vkGetShaderModuleCreateInfoIdentifierEXT>(vkGetDeviceProcAddr(device, "vkGetShaderModuleCreateInfoIdentifierEXT"));
+		}
+	}
+
+	ShaderModuleCache::~ShaderModuleCache()
+	{
+		release();
+	}
+
+	// FNV-1a, only used to tell different versions of the same file apart
+	uint64_t ShaderModuleCache::hash(const char *code, size_t size)
+	{
+		uint64_t value = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++)
+		{
+			value ^= static_cast<uint8_t>(code[i]);
+			value *= 1099511628211ull;
+		}
+		return value;
+	}
+
+	VkShaderModuleCreateInfo ShaderModuleCache::moduleCreateInfo(const Entry &entry) const
+	{
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = entry.code.size() * sizeof(uint32_t);
+		createInfo.pCode = entry.code.data();
+		return createInfo;
+	}
+
+	void ShaderModuleCache::createModule(Entry &entry)
+	{
+		if (entry.module == VK_NULL_HANDLE)
+		{
+			VkShaderModuleCreateInfo createInfo = moduleCreateInfo(entry);
+			VK_CHECK_RESULT(vkCreateShaderModule(device, &createInfo, nullptr, &entry.module));
+		}
+	}
+
+	/**
+	* Get a shader stage for a SPIR-V file, creating its module on the first request
+	*
+	* @param fileName Name of the file the code was read from, part of the cache key
+	* @param code SPIR-V code
+	* @param size Size of the code in bytes
+	* @param stage Stage the shader is used for
+	* @param deferModule Return a stage that only references the module by its identifier if module identifiers are enabled, see resolveModules()
+	*
+	* @return Stage with the "main" entry point, the module is owned by the cache
+	*/
+	VkPipelineShaderStageCreateInfo ShaderModuleCache::getStage(const std::string &fileName, const char *code, size_t size, VkShaderStageFlagBits stage, bool deferModule)
+	{
+		assert((size > 0) && (size % sizeof(uint32_t) == 0));
+		Entry &entry = entries[std::make_pair(fileName, hash(code, size))];
+		if (entry.code.empty())
+		{
+			entry.code.resize(size / sizeof(uint32_t));
+			memcpy(entry.code.data(), code, size);
+		}
+
+		VkPipelineShaderStageCreateInfo shaderStage{};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = stage;
+		shaderStage.pName = "main";
+
+		// There's nothing left to save once the module exists
+		if (deferModule && vkGetShaderModuleCreateInfoIdentifierEXT && (entry.module == VK_NULL_HANDLE))
+		{
+			if (deferredEntries.find(&entry.identifierInfo) == deferredEntries.end())
+			{
+				VkShaderModuleCreateInfo createInfo = moduleCreateInfo(entry);
+				entry.identifier.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_IDENTIFIER_EXT;
+				vkGetShaderModuleCreateInfoIdentifierEXT(device, &createInfo, &entry.identifier);
+				entry.identifierInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_MODULE_IDENTIFIER_CREATE_INFO_EXT;
+				entry.identifierInfo.identifierSize = entry.identifier.identifierSize;
+				entry.identifierInfo.pIdentifier = entry.identifier.identifier;
+				deferredEntries[&entry.identifierInfo] = &entry;
+			}
+			// An identifier size of zero means the implementation can't identify this module
+			if (entry.identifierInfo.identifierSize > 0)
+			{
+				shaderStage.pNext = &entry.identifierInfo;
+				return shaderStage;
+			}
+		}
+
+		createModule(entry);
+		shaderStage.module = entry.module;
+		return shaderStage;
+	}
+
+	/** @brief True if any of the stages is a deferred stage of this cache without a module */
+	bool ShaderModuleCache::hasDeferredModules(const VkPipelineShaderStageCreateInfo *stages, uint32_t stageCount) const
+	{
+		for (uint32_t i = 0; i < stageCount; i++)
+		{
+			if ((stages[i].module == VK_NULL_HANDLE) && (deferredEntries.find(stages[i].pNext) != deferredEntries.end()))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	* Replace the identifiers of deferred stages with their modules, creating them if necessary
+	*
+	* Called for pipelines that couldn't be created from the pipeline cache with identifiers alone (VK_PIPELINE_COMPILE_REQUIRED),
+	* other stages are left unchanged
+	*/
+	void ShaderModuleCache::resolveModules(VkPipelineShaderStageCreateInfo *stages, uint32_t stageCount)
+	{
+		for (uint32_t i = 0; i < stageCount; i++)
+		{
+			if (stages[i].module != VK_NULL_HANDLE)
+			{
+				continue;
+			}
+			auto deferred = deferredEntries.find(stages[i].pNext);
+			if (deferred != deferredEntries.end())
+			{
+				createModule(*deferred->second);
+				stages[i].module = deferred->second->module;
+				stages[i].pNext = nullptr;
+			}
+		}
+	}
+
+	/** @brief Destroy all modules and forget their code, pipelines created from them stay valid */
+	void ShaderModuleCache::release()
+	{
+		for (auto &entry : entries)
+		{
+			if (entry.second.module != VK_NULL_HANDLE)
+			{
+				vkDestroyShaderModule(device, entry.second.module, nullptr);
+			}
+		}
+		entries.clear();
+		deferredEntries.clear();
+	}
+
+	/** @brief Number of distinct shaders loaded since the last release() */
+	size_t ShaderModuleCache::size() const
+	{
+		return entries.size();
+	}
+
+	/** @brief True if deferred stages can be created */
+	bool ShaderModuleCache::moduleIdentifiersEnabled() const
+	{
+		return vkGetShaderModuleCreateInfoIdentifierEXT != nullptr;
+	}
+}
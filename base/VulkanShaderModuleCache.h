@@ -0,0 +1,67 @@
+/*
+* Shader module cache
+*
+* Shares shader modules between pipelines loading the same SPIR-V and, with VK_EXT_shader_module_identifier, defers module creation
+* until a pipeline actually has to be compiled
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* Cache of shader modules keyed by file name and content hash
+	*
+	* Usage:
+	*	vks::ShaderModuleCache cache(device);
+	*	// Both pipelines share a single module
+	*	shaderStagesA[0] = cache.getStage("mesh.vert.spv", code.data(), code.size(), VK_SHADER_STAGE_VERTEX_BIT);
+	*	shaderStagesB[0] = cache.getStage("mesh.vert.spv", code.data(), code.size(), VK_SHADER_STAGE_VERTEX_BIT);
+	*	// Create the pipelines, then free the modules
+	*	cache.release();
+	*
+	* A file that changed on disk (e.g. after a shader hot reload) hashes differently and gets a module of its own.
+	*
+	* With module identifiers enabled, getStage() can return deferred stages that only reference the module by its identifier. Pipelines
+	* using them have to be created through a vks::PipelineBatch set up with the cache, which first tries to create them from the pipeline
+	* cache alone and only creates the modules for the pipelines that miss it (see resolveModules()).
+	*
+	* @note Modules and deferred stages are invalid after release(), it should be called once the pipelines using them have been created
+	*/
+	class ShaderModuleCache
+	{
+	public:
+		ShaderModuleCache(VkDevice device, bool moduleIdentifiers = false);
+		~ShaderModuleCache();
+		VkPipelineShaderStageCreateInfo getStage(const std::string &fileName, const char *code, size_t size, VkShaderStageFlagBits stage, bool deferModule = false);
+		bool hasDeferredModules(const VkPipelineShaderStageCreateInfo *stages, uint32_t stageCount) const;
+		void resolveModules(VkPipelineShaderStageCreateInfo *stages, uint32_t stageCount);
+		void release();
+		size_t size() const;
+		bool moduleIdentifiersEnabled() const;
+	private:
+		struct Entry {
+			std::vector<uint32_t> code;
+			VkShaderModule module = VK_NULL_HANDLE;
+			VkShaderModuleIdentifierEXT identifier{};
+			VkPipelineShaderStageModuleIdentifierCreateInfoEXT identifierInfo{};
+		};
+		VkDevice device;
+		PFN_vkGetShaderModuleCreateInfoIdentifierEXT vkGetShaderModuleCreateInfoIdentifierEXT = nullptr;
+		// Map nodes don't move, so deferred stages can point at the identifier infos of their entries
+		std::map<std::pair<std::string, uint64_t>, Entry> entries;
+		std::unordered_map<const void*, Entry*> deferredEntries;
+		static uint64_t hash(const char *code, size_t size);
+		VkShaderModuleCreateInfo moduleCreateInfo(const Entry &entry) const;
+		void createModule(Entry &entry);
+	};
+}
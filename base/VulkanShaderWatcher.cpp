@@ -0,0 +1,238 @@
+/*
+* Shader hot reload
+*
+* Watches the sources of loaded SPIR-V shaders, recompiles changed ones on a background thread with the SDK's command line compilers and
+* has the pipelines using them rebuilt between frames
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanShaderWatcher.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+
+namespace vks
+{
+	/**
+	* @param language Language of the shader sources, selects the compiler
+	* @param pollInterval Time in milliseconds between checks of the source files
+	*/
+	ShaderWatcher::ShaderWatcher(Language language, uint32_t pollInterval) : language(language), pollInterval(pollInterval)
+	{
+		thread = std::thread(&ShaderWatcher::run, this);
+	}
+
+	/** @brief Stop watching, waits for a running compilation to finish */
+	ShaderWatcher::~ShaderWatcher()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		condition.notify_one();
+		thread.join();
+	}
+
+	bool ShaderWatcher::getModificationTime(const std::string &fileName, time_t &time)
+	{
+		struct stat fileStat;
+		if (stat(fileName.c_str(), &fileStat) != 0)
+		{
+			return false;
+		}
+		time = fileStat.st_mtime;
+		return true;
+	}
+
+	/**
+	* Watch the sources of a set of SPIR-V files
+	*
+	* @param spirvFiles SPIR-V files loaded for the pipelines, files without a source next to them are ignored
+	* @param rebuild Called by update() after any of the files has been recompiled, recreates the pipelines using them
+	*/
+	void ShaderWatcher::watch(const std::vector<std::string> &spirvFiles, std::function<void()> rebuild)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Group group{};
+		group.rebuild = rebuild;
+		for (auto &spirvFile : spirvFiles)
+		{
+			const std::string extension = ".spv";
+			if ((spirvFile.size() <= extension.size()) || (spirvFile.compare(spirvFile.size() - extension.size(), extension.size(), extension) != 0))
+			{
+				continue;
+			}
+			auto existing = shaderIndices.find(spirvFile);
+			if (existing != shaderIndices.end())
+			{
+				group.shaders.push_back(existing->second);
+				continue;
+			}
+			Shader shader{};
+			shader.spirvFile = spirvFile;
+			shader.sourceFile = spirvFile.substr(0, spirvFile.size() - extension.size());
+			if (!getModificationTime(shader.sourceFile, shader.sourceTime))
+			{
+				continue;
+			}
+			shaderIndices[spirvFile] = shaders.size();
+			group.shaders.push_back(shaders.size());
+			shaders.push_back(shader);
+		}
+		if (!group.shaders.empty())
+		{
+			groups.push_back(group);
+		}
+	}
+
+	/** @brief True if shaders have been recompiled since the last update() */
+	bool ShaderWatcher::hasPendingReloads()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return !compiledShaders.empty();
+	}
+
+	/**
+	* Call the rebuild functions of all groups with shaders recompiled since the last call, each function is only called once
+	*
+	* @return True if any pipelines have been rebuilt
+	*
+	* @note Has to be called while none of the pipelines are in use by the device, e.g. after waiting for the device to become idle
+	*/
+	bool ShaderWatcher::update()
+	{
+		std::vector<std::function<void()>> rebuilds;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto &group : groups)
+			{
+				for (size_t shader : group.shaders)
+				{
+					if (std::find(compiledShaders.begin(), compiledShaders.end(), shader) != compiledShaders.end())
+					{
+						rebuilds.push_back(group.rebuild);
+						break;
+					}
+				}
+			}
+			compiledShaders.clear();
+		}
+		// Called without holding the lock, rebuilding may load shaders and watch them again
+		for (auto &rebuild : rebuilds)
+		{
+			rebuild();
+		}
+		return !rebuilds.empty();
+	}
+
+	std::string ShaderWatcher::getCompileCommand(const std::string &sourceFile, const std::string &outputFile) const
+	{
+		std::string binDir;
+		if (const char *sdkDir = std::getenv("VULKAN_SDK"))
+		{
+			binDir = std::string(sdkDir) + "/bin/";
+		}
+		auto hasStage = [&sourceFile](const char *stage) {
+			return sourceFile.find(stage) != std::string::npos;
+		};
+		const bool rayTracing = hasStage(".rgen") || hasStage(".rchit") || hasStage(".rmiss") || hasStage(".rahit") || hasStage(".rint") || hasStage(".rcall");
+		if (language == Language::GLSL)
+		{
+			return "\"" + binDir + "glslangValidator\" -V \"" + sourceFile + "\" -o \"" + outputFile + "\"" + (rayTracing ? " --target-env vulkan1.2" : "");
+		}
+		// Same profiles and options as data/shaders/hlsl/compile.py
+		std::string profile = "vs_6_1";
+		if (hasStage(".frag"))
+		{
+			profile = "ps_6_1";
+		}
+		else if (hasStage(".comp"))
+		{
+			profile = "cs_6_1";
+		}
+		else if (hasStage(".geom"))
+		{
+			profile = "gs_6_1";
+		}
+		else if (hasStage(".tesc"))
+		{
+			profile = "hs_6_1";
+		}
+		else if (hasStage(".tese"))
+		{
+			profile = "ds_6_1";
+		}
+		else if (rayTracing)
+		{
+			profile = "lib_6_3";
+		}
+		return "\"" + binDir + "dxc\" -spirv -T " + profile + " -E main -fspv-extension=SPV_KHR_ray_tracing -fspv-extension=SPV_KHR_multiview -fspv-extension=SPV_KHR_shader_draw_parameters -fspv-extension=SPV_EXT_descriptor_indexing" +
+			(rayTracing ? " -fspv-target-env=vulkan1.2" : "") + " \"" + sourceFile + "\" -Fo \"" + outputFile + "\"";
+	}
+
+	// Compile into a temporary file first, so a failed compilation leaves the last working SPIR-V in place
+	bool ShaderWatcher::compile(const Shader &shader) const
+	{
+		const std::string tempFile = shader.spirvFile + ".tmp";
+		std::string command = getCompileCommand(shader.sourceFile, tempFile);
+#if defined(_WIN32)
+		// cmd.exe strips the outer quotes of a command line starting with a quote
+		command = "\"" + command + "\"";
+#endif
+		std::cout << "Recompiling " << shader.sourceFile << "\n";
+		if (std::system(command.c_str()) != 0)
+		{
+			std::cerr << "Shader compilation failed, keeping " << shader.spirvFile << "\n";
+			std::remove(tempFile.c_str());
+			return false;
+		}
+		std::remove(shader.spirvFile.c_str());
+		if (std::rename(tempFile.c_str(), shader.spirvFile.c_str()) != 0)
+		{
+			std::cerr << "Could not replace " << shader.spirvFile << "\n";
+			return false;
+		}
+		return true;
+	}
+
+	void ShaderWatcher::run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (!stop)
+		{
+			condition.wait_for(lock, std::chrono::milliseconds(pollInterval));
+			if (stop)
+			{
+				break;
+			}
+			// Files are checked and compiled without holding the lock, shaders are never removed so the indices stay valid
+			std::vector<Shader> current = shaders;
+			lock.unlock();
+			std::vector<std::pair<size_t, time_t>> changed;
+			std::vector<size_t> compiled;
+			for (size_t i = 0; i < current.size(); i++)
+			{
+				time_t sourceTime;
+				if (getModificationTime(current[i].sourceFile, sourceTime) && (sourceTime != current[i].sourceTime))
+				{
+					changed.push_back({ i, sourceTime });
+					if (compile(current[i]))
+					{
+						compiled.push_back(i);
+					}
+				}
+			}
+			lock.lock();
+			// Failed compilations aren't retried until the source changes again
+			for (auto &change : changed)
+			{
+				shaders[change.first].sourceTime = change.second;
+			}
+			compiledShaders.insert(compiledShaders.end(), compiled.begin(), compiled.end());
+		}
+	}
+}
@@ -0,0 +1,79 @@
+/*
+* Shader hot reload
+*
+* Watches the sources of loaded SPIR-V shaders, recompiles changed ones on a background thread with the SDK's command line compilers and
+* has the pipelines using them rebuilt between frames
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <time.h>
+
+namespace vks
+{
+	/**
+	* Background shader recompilation
+	*
+	* Usage:
+	*	vks::ShaderWatcher watcher(vks::ShaderWatcher::Language::GLSL);
+	*	// After creating pipelines, with the SPIR-V files they were created from
+	*	watcher.watch({ "shaders/glsl/mesh.vert.spv", "shaders/glsl/mesh.frag.spv" }, [&]() { destroyPipelines(); createPipelines(); });
+	*	// Between frames
+	*	if (watcher.hasPendingReloads()) {
+	*		vkDeviceWaitIdle(device);
+	*		watcher.update();
+	*		rebuildCommandBuffers();
+	*	}
+	*
+	* The source of a SPIR-V file is the file without the .spv extension, as written by the shader compile scripts of the repository.
+	* Sources are compiled with glslangValidator (GLSL) or dxc (HLSL) from $VULKAN_SDK/bin, or from the PATH if VULKAN_SDK isn't set.
+	* The SPIR-V file is only replaced if compilation succeeded, the compiler output is written to the console.
+	*
+	* @note Only changes of the source files themselves are detected, not of files included by them
+	*/
+	class ShaderWatcher
+	{
+	public:
+		enum class Language { GLSL, HLSL };
+
+		ShaderWatcher(Language language, uint32_t pollInterval = 500);
+		~ShaderWatcher();
+		void watch(const std::vector<std::string> &spirvFiles, std::function<void()> rebuild);
+		bool hasPendingReloads();
+		bool update();
+	private:
+		struct Shader {
+			std::string spirvFile;
+			std::string sourceFile;
+			time_t sourceTime;
+		};
+		struct Group {
+			std::vector<size_t> shaders;
+			std::function<void()> rebuild;
+		};
+		Language language;
+		uint32_t pollInterval;
+		std::vector<Shader> shaders;
+		std::map<std::string, size_t> shaderIndices;
+		std::vector<Group> groups;
+		// Shaders compiled since the last update()
+		std::vector<size_t> compiledShaders;
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool stop = false;
+		static bool getModificationTime(const std::string &fileName, time_t &time);
+		std::string getCompileCommand(const std::string &sourceFile, const std::string &outputFile) const;
+		bool compile(const Shader &shader) const;
+		void run();
+	};
+}
@@ -0,0 +1,272 @@
+/*
+* Shadow atlas tile allocator
+*
+* Packs the shadow maps of many lights into tiles of a single depth texture, with each light's tile sized by its screen coverage
+* and tiles of lights that haven't changed kept (and not rendered again) from one frame to the next
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanShadowAtlas.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace vks
+{
+	/**
+	* Create a shadow atlas allocator
+	*
+	* @param atlasSize Width and height of the (square) atlas texture in texels, a power of two
+	* @param minTileSize Size of the smallest tile, a power of two
+	* @param maxTileSize Size of the largest tile (for lights covering the whole screen), a power of two of at most atlasSize
+	*/
+	ShadowAtlas::ShadowAtlas(uint32_t atlasSize, uint32_t minTileSize, uint32_t maxTileSize)
+		: atlasSize(atlasSize), minTileSize(minTileSize), maxTileSize(maxTileSize)
+	{
+		assert((atlasSize & (atlasSize - 1)) == 0);
+		assert((minTileSize & (minTileSize - 1)) == 0);
+		assert((maxTileSize & (maxTileSize - 1)) == 0);
+		assert((minTileSize <= maxTileSize) && (maxTileSize <= atlasSize));
+		freeTiles.resize(getLevel(minTileSize) + 1);
+		clear();
+	}
+
+	uint32_t ShadowAtlas::getAtlasSize() const
+	{
+		return atlasSize;
+	}
+
+	uint32_t ShadowAtlas::getLevel(uint32_t size) const
+	{
+		uint32_t level = 0;
+		while ((atlasSize >> level) > size)
+		{
+			level++;
+		}
+		return level;
+	}
+
+	/** @brief Take a free tile of the given size, splitting a larger free tile if there's none of that size */
+	bool ShadowAtlas::allocateTile(uint32_t size, Tile &tile)
+	{
+		const uint32_t level = getLevel(size);
+		int32_t freeLevel = static_cast<int32_t>(level);
+		while ((freeLevel >= 0) && freeTiles[freeLevel].empty())
+		{
+			freeLevel--;
+		}
+		if (freeLevel < 0)
+		{
+			return false;
+		}
+		tile = freeTiles[freeLevel].back();
+		freeTiles[freeLevel].pop_back();
+		// Keep the first quadrant of each split and return the other three to the free list of the next level
+		for (uint32_t splitLevel = static_cast<uint32_t>(freeLevel); splitLevel < level; splitLevel++)
+		{
+			tile.size /= 2;
+			freeTiles[splitLevel + 1].push_back({ tile.x + tile.size, tile.y, tile.size });
+			freeTiles[splitLevel + 1].push_back({ tile.x, tile.y + tile.size, tile.size });
+			freeTiles[splitLevel + 1].push_back({ tile.x + tile.size, tile.y + tile.size, tile.size });
+		}
+		return true;
+	}
+
+	/** @brief Return a tile to the free lists, merging it with its siblings into their parent tile if they are free too */
+	void ShadowAtlas::freeTile(const Tile &tile)
+	{
+		Tile current = tile;
+		uint32_t level = getLevel(current.size);
+		while (level > 0)
+		{
+			const uint32_t parentSize = current.size * 2;
+			const uint32_t parentX = current.x - current.x % parentSize;
+			const uint32_t parentY = current.y - current.y % parentSize;
+			std::vector<Tile> &levelTiles = freeTiles[level];
+			std::vector<size_t> siblings;
+			for (size_t i = 0; i < levelTiles.size(); i++)
+			{
+				const Tile &other = levelTiles[i];
+				if ((other.x - other.x % parentSize == parentX) && (other.y - other.y % parentSize == parentY))
+				{
+					siblings.push_back(i);
+				}
+			}
+			if (siblings.size() < 3)
+			{
+				break;
+			}
+			// Remove back to front so the remaining indices stay valid
+			for (auto it = siblings.rbegin(); it != siblings.rend(); ++it)
+			{
+				levelTiles.erase(levelTiles.begin() + *it);
+			}
+			current = { parentX, parentY, parentSize };
+			level--;
+		}
+		freeTiles[level].push_back(current);
+	}
+
+	/**
+	* Get the tile size for a light from its screen coverage
+	*
+	* @param coverage Screen coverage of the light's volume as returned by getScreenCoverage(), 1 for lights covering the whole screen
+	*
+	* @return Power of two tile size between the minimum and maximum tile size
+	*/
+	uint32_t ShadowAtlas::getTileSize(float coverage) const
+	{
+		const float texels = std::max(coverage, 0.0f) * static_cast<float>(maxTileSize);
+		uint32_t size = minTileSize;
+		while ((size < maxTileSize) && (static_cast<float>(size) < texels))
+		{
+			size *= 2;
+		}
+		return size;
+	}
+
+	/**
+	* Assign the tiles for a frame
+	*
+	* Tiles of lights that are no longer requested or whose size changed are freed before new tiles are allocated
+	*
+	* @param requests Lights that need a shadow map this frame
+	*
+	* @return Tiles of all requested lights
+	*/
+	const std::vector<ShadowAtlas::Allocation>& ShadowAtlas::update(std::vector<Request> requests)
+	{
+		statistics = Statistics();
+
+		// Keep the tiles of lights requesting the same size as before (even if they got a smaller tile as the atlas was full) or one level smaller
+		std::vector<Allocation> retained;
+		std::vector<Request> pending;
+		for (const Request &request : requests)
+		{
+			auto allocation = std::find_if(allocations.begin(), allocations.end(), [&request](const Allocation &allocation) { return allocation.id == request.id; });
+			if ((allocation != allocations.end()) && (allocation->tile.size > 0) && ((request.size == allocation->requestedSize) || ((request.size <= allocation->tile.size) && (request.size * 2 >= allocation->tile.size))))
+			{
+				retained.push_back({ request.id, allocation->tile, request.changed || invalidated, allocation->requestedSize });
+				allocation->tile.size = 0;
+			}
+			else
+			{
+				pending.push_back(request);
+			}
+		}
+		for (const Allocation &allocation : allocations)
+		{
+			if (allocation.tile.size > 0)
+			{
+				freeTile(allocation.tile);
+			}
+		}
+		allocations = retained;
+		invalidated = false;
+
+		// Largest tiles first, so smaller ones fill the space left around them
+		std::stable_sort(pending.begin(), pending.end(), [](const Request &a, const Request &b) { return a.size > b.size; });
+		for (const Request &request : pending)
+		{
+			Allocation allocation{};
+			allocation.id = request.id;
+			allocation.requestedSize = request.size;
+			uint32_t size = std::max(std::min(request.size, maxTileSize), minTileSize);
+			bool allocated = allocateTile(size, allocation.tile);
+			while (!allocated && (size > minTileSize))
+			{
+				size /= 2;
+				allocated = allocateTile(size, allocation.tile);
+			}
+			if (allocated)
+			{
+				allocation.render = true;
+			}
+			else
+			{
+				allocation.tile = Tile();
+				statistics.droppedLights++;
+			}
+			allocations.push_back(allocation);
+		}
+
+		uint64_t usedTexels = 0;
+		for (const Allocation &allocation : allocations)
+		{
+			if (allocation.tile.size == 0)
+			{
+				continue;
+			}
+			statistics.tileCount++;
+			if (allocation.render)
+			{
+				statistics.renderedTiles++;
+			}
+			else
+			{
+				statistics.cachedTiles++;
+			}
+			usedTexels += static_cast<uint64_t>(allocation.tile.size) * allocation.tile.size;
+		}
+		statistics.usage = static_cast<float>(static_cast<double>(usedTexels) / (static_cast<double>(atlasSize) * atlasSize));
+		return allocations;
+	}
+
+	/** @brief Render all kept tiles again with the next update, e.g. after the shadow casting geometry or the atlas contents changed */
+	void ShadowAtlas::invalidate()
+	{
+		invalidated = true;
+	}
+
+	/** @brief Free all tiles, so all lights get new tiles with the next update */
+	void ShadowAtlas::clear()
+	{
+		for (auto &levelTiles : freeTiles)
+		{
+			levelTiles.clear();
+		}
+		freeTiles[0].push_back({ 0, 0, atlasSize });
+		allocations.clear();
+	}
+
+	const ShadowAtlas::Statistics& ShadowAtlas::getStatistics() const
+	{
+		return statistics;
+	}
+
+	/** @brief Returns the normalized offset (xy) and scale (zw) mapping shadow map coordinates to a tile's area of the atlas */
+	glm::vec4 ShadowAtlas::getTileRect(const Tile &tile, uint32_t atlasSize)
+	{
+		const float scale = 1.0f / static_cast<float>(atlasSize);
+		return glm::vec4(static_cast<float>(tile.x) * scale, static_cast<float>(tile.y) * scale, static_cast<float>(tile.size) * scale, static_cast<float>(tile.size) * scale);
+	}
+
+	/**
+	* Estimate the screen coverage of a light from a bounding sphere of its volume
+	*
+	* @param center Center of the bounding sphere in world space
+	* @param radius Radius of the bounding sphere
+	* @param view Camera view matrix
+	* @param projection Camera projection matrix
+	*
+	* @return Projected diameter of the sphere relative to the screen height (clamped to 1), 1 if the camera is inside the sphere and 0 if it's behind the camera
+	*/
+	float ShadowAtlas::getScreenCoverage(const glm::vec3 &center, float radius, const glm::mat4 &view, const glm::mat4 &projection)
+	{
+		const glm::vec3 viewCenter = glm::vec3(view * glm::vec4(center, 1.0f));
+		const float distance = glm::length(viewCenter);
+		if (distance <= radius)
+		{
+			return 1.0f;
+		}
+		// The camera looks along -z in view space
+		if (viewCenter.z > radius)
+		{
+			return 0.0f;
+		}
+		// Tangent of the angle the sphere subtends, relative to the tangent of half the vertical field of view
+		const float tangent = radius / std::sqrt(distance * distance - radius * radius);
+		return std::min(tangent * std::abs(projection[1][1]), 1.0f);
+	}
+}
@@ -0,0 +1,103 @@
+/*
+* Shadow atlas tile allocator
+*
+* Packs the shadow maps of many lights into tiles of a single depth texture, with each light's tile sized by its screen coverage
+* and tiles of lights that haven't changed kept (and not rendered again) from one frame to the next
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include "vulkan/vulkan.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	/**
+	* Allocates square power of two tiles of a shadow atlas to lights
+	*
+	* Usage:
+	*	shadowAtlas.reset(new vks::ShadowAtlas(4096, 64, 1024));
+	*	// Once per frame, with the tile size of each light derived from its screen coverage
+	*	for (light) {
+	*		requests.push_back({ lightIndex, shadowAtlas->getTileSize(vks::ShadowAtlas::getScreenCoverage(center, radius, view, projection)), lightChanged });
+	*	}
+	*	for (const vks::ShadowAtlas::Allocation &allocation : shadowAtlas->update(requests)) {
+	*		// Sample the light's shadow map from allocation.tile, render it if allocation.render is set
+	*	}
+	*
+	* Tiles are managed as a quadtree (a tile of one level splits into four tiles of the next level), so freed tiles merge with their
+	* siblings and the atlas doesn't fragment over time. Tiles are kept as long as a light requests the same size (or one level smaller,
+	* so coverage changes around a size boundary don't reallocate the tile every frame). A tile only needs to be rendered if it's new or
+	* the light (or shadow casting geometry) has changed, so static lights are rendered once and then sampled from the cache.
+	* Lights are allocated largest first, if a light's tile doesn't fit it's halved until it does, down to the minimum tile size.
+	*
+	* @note Lights that don't fit at the minimum tile size get no tile (Allocation::tile.size is 0) and are counted in Statistics::droppedLights
+	*/
+	class ShadowAtlas
+	{
+	public:
+		struct Tile {
+			uint32_t x;
+			uint32_t y;
+			uint32_t size;
+			Tile() : x(0), y(0), size(0) {}
+			Tile(uint32_t x, uint32_t y, uint32_t size) : x(x), y(y), size(size) {}
+		};
+
+		struct Request {
+			// Application defined light identifier, must be unique within a request list
+			uint32_t id;
+			// Requested tile size, a power of two (see getTileSize())
+			uint32_t size;
+			// Set if the light or the geometry it shadows has changed since its tile was last rendered
+			bool changed;
+		};
+
+		struct Allocation {
+			uint32_t id;
+			Tile tile;
+			// Set if the tile has to be rendered (and cleared before), either because it's new or because the light has changed
+			bool render;
+			// Size requested when the tile was allocated, the tile is smaller if the atlas was full
+			uint32_t requestedSize;
+		};
+
+		struct Statistics {
+			uint32_t tileCount = 0;
+			uint32_t renderedTiles = 0;
+			uint32_t cachedTiles = 0;
+			uint32_t droppedLights = 0;
+			// Fraction of the atlas covered by tiles
+			float usage = 0.0f;
+		};
+
+	private:
+		uint32_t atlasSize;
+		uint32_t minTileSize;
+		uint32_t maxTileSize;
+		// Free tiles per quadtree level, level 0 is the whole atlas
+		std::vector<std::vector<Tile>> freeTiles;
+		std::vector<Allocation> allocations;
+		bool invalidated = false;
+		Statistics statistics;
+		uint32_t getLevel(uint32_t size) const;
+		bool allocateTile(uint32_t size, Tile &tile);
+		void freeTile(const Tile &tile);
+	public:
+		ShadowAtlas(uint32_t atlasSize, uint32_t minTileSize, uint32_t maxTileSize);
+		uint32_t getAtlasSize() const;
+		uint32_t getTileSize(float coverage) const;
+		const std::vector<Allocation>& update(std::vector<Request> requests);
+		void invalidate();
+		void clear();
+		const Statistics& getStatistics() const;
+		static glm::vec4 getTileRect(const Tile &tile, uint32_t atlasSize);
+		static float getScreenCoverage(const glm::vec3 &center, float radius, const glm::mat4 &view, const glm::mat4 &projection);
+	};
+}
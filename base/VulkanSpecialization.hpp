@@ -0,0 +1,267 @@
+/*
+* Specialization constants
+*
+* Builds specialization map entries from a list of constant types at compile time, and pipeline variants for all combinations of a
+* small set of feature flags passed as boolean specialization constants
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstring>
+#include <assert.h>
+#include <type_traits>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanPipelineBatch.hpp"
+
+namespace vks
+{
+	namespace specialization
+	{
+		/*
+			Compile time layout of a list of constants, each one aligned to its size like in a C++ struct
+		*/
+		template<size_t Offset, typename... Types>
+		struct Layout;
+
+		template<size_t Offset>
+		struct Layout<Offset>
+		{
+			static const size_t size = Offset;
+			static void getEntries(VkSpecializationMapEntry*, uint32_t) {}
+		};
+
+		template<size_t Offset, typename T, typename... Rest>
+		struct Layout<Offset, T, Rest...>
+		{
+			static_assert(std::is_arithmetic<T>::value && ((sizeof(T) == 4) || (sizeof(T) == 8)), "Specialization constants have to be 32 or 64 bit scalars (VkBool32 for booleans)");
+			typedef T type;
+			static const size_t offset = (Offset + alignof(T) - 1) / alignof(T) * alignof(T);
+			typedef Layout<offset + sizeof(T), Rest...> next;
+			static const size_t size = next::size;
+			static void getEntries(VkSpecializationMapEntry* entries, uint32_t constantID)
+			{
+				entries[0] = vks::initializers::specializationMapEntry(constantID, static_cast<uint32_t>(offset), sizeof(T));
+				next::getEntries(entries + 1, constantID + 1);
+			}
+		};
+
+		/* Layout of the constant at Index */
+		template<uint32_t Index, typename L>
+		struct Element
+		{
+			typedef typename Element<Index - 1, typename L::next>::layout layout;
+		};
+
+		template<typename L>
+		struct Element<0, L>
+		{
+			typedef L layout;
+		};
+	}
+
+	/**
+	* Data and map entries of a list of specialization constants with consecutive constant ids
+	*
+	* Usage:
+	*	// layout (constant_id = 0) const int LIGHTING_MODEL = 0;
+	*	// layout (constant_id = 1) const float PARAM_TOON_DESATURATION = 0.0f;
+	*	vks::SpecializationConstants<int32_t, float> constants;
+	*	constants.set<0>(lightingModel);
+	*	constants.set<1>(0.5f);
+	*	shaderStage.pSpecializationInfo = constants.getInfo();
+	*
+	* Offsets and sizes are computed from the types at compile time, so the map entries can't get out of sync with the data
+	*/
+	template<typename... Types>
+	class SpecializationConstants
+	{
+	private:
+		typedef specialization::Layout<0, Types...> layout;
+		alignas(8) uint8_t data[layout::size > 0 ? layout::size : 1];
+		VkSpecializationMapEntry entries[sizeof...(Types) > 0 ? sizeof...(Types) : 1];
+		VkSpecializationInfo specializationInfo;
+		void setupInfo()
+		{
+			specializationInfo = vks::initializers::specializationInfo(count, entries, layout::size, data);
+		}
+	public:
+		/** @brief Number of constants */
+		static const uint32_t count = sizeof...(Types);
+		/** @brief Size of the constant data in bytes */
+		static const size_t size = layout::size;
+		/** @brief Type of the constant at Index */
+		template<uint32_t Index>
+		using Type = typename specialization::Element<Index, layout>::layout::type;
+
+		/** @param firstConstantID Constant id of the first constant, the following ones use consecutive ids */
+		explicit SpecializationConstants(uint32_t firstConstantID = 0)
+		{
+			memset(data, 0, sizeof(data));
+			layout::getEntries(entries, firstConstantID);
+			setupInfo();
+		}
+
+		// The info points into the object itself
+		SpecializationConstants(const SpecializationConstants& other)
+		{
+			*this = other;
+		}
+
+		SpecializationConstants& operator=(const SpecializationConstants& other)
+		{
+			memcpy(data, other.data, sizeof(data));
+			memcpy(entries, other.entries, sizeof(entries));
+			setupInfo();
+			return *this;
+		}
+
+		/** @brief Set the value of the constant at Index */
+		template<uint32_t Index>
+		void set(Type<Index> value)
+		{
+			static_assert(Index < sizeof...(Types), "Constant index out of range");
+			memcpy(data + specialization::Element<Index, layout>::layout::offset, &value, sizeof(value));
+		}
+
+		/** @brief Set the value of a constant selected at run-time, T has to match its type in size */
+		template<typename T>
+		void set(uint32_t index, T value)
+		{
+			assert((index < count) && (entries[index].size == sizeof(T)));
+			memcpy(data + entries[index].offset, &value, sizeof(value));
+		}
+
+		/** @brief Get the value of the constant at Index */
+		template<uint32_t Index>
+		Type<Index> get() const
+		{
+			static_assert(Index < sizeof...(Types), "Constant index out of range");
+			Type<Index> value;
+			memcpy(&value, data + specialization::Element<Index, layout>::layout::offset, sizeof(value));
+			return value;
+		}
+
+		/** @brief Specialization info for a shader stage, valid while the object exists */
+		const VkSpecializationInfo* getInfo() const
+		{
+			return &specializationInfo;
+		}
+	};
+
+	namespace specialization
+	{
+		/* SpecializationConstants with FlagCount VkBool32 constants in front of Types */
+		template<uint32_t FlagCount, typename... Types>
+		struct FlagConstants
+		{
+			typedef typename FlagConstants<FlagCount - 1, VkBool32, Types...>::type type;
+		};
+
+		template<typename... Types>
+		struct FlagConstants<0, Types...>
+		{
+			typedef SpecializationConstants<Types...> type;
+		};
+	}
+
+	/**
+	* Graphics pipelines for all combinations of a set of feature flags
+	*
+	* Usage:
+	*	// layout (constant_id = 0) const bool NORMAL_MAP = false;
+	*	// layout (constant_id = 1) const bool ALPHA_MASK = false;
+	*	// layout (constant_id = 2) const float ALPHA_MASK_CUTOFF = 0.0f;
+	*	vks::PipelineVariants<2, float> variants(device);
+	*	variants.setShared<0>(0.5f);
+	*	vks::PipelineBatch batch(device, pipelineCache);
+	*	variants.add(batch, pipelineCI, VK_SHADER_STAGE_FRAGMENT_BIT);
+	*	batch.build();
+	*	// When drawing
+	*	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, variants.get(normalMapFlag | alphaMaskFlag));
+	*
+	* Flag i of a variant index is passed as VkBool32 constant firstConstantID + i, the constants listed by Types follow the flags and
+	* are the same for all variants. Branches on the flags are resolved when the pipelines are compiled, so shaders can select features
+	* per material without any cost at run-time.
+	*
+	* @note The variants keep the structures passed to the batch, they have to exist until the batch has been built
+	*/
+	template<uint32_t FlagCount, typename... Types>
+	class PipelineVariants
+	{
+	public:
+		static_assert(FlagCount <= 8, "Every flag doubles the number of pipelines");
+		/** @brief Number of pipelines, one for each combination of flags */
+		static const uint32_t variantCount = 1u << FlagCount;
+		typedef typename specialization::FlagConstants<FlagCount, Types...>::type Constants;
+	private:
+		VkDevice device;
+		std::vector<Constants> constants;
+		std::vector<std::vector<VkPipelineShaderStageCreateInfo>> stages;
+		std::vector<VkPipeline> pipelines;
+	public:
+		/** @param firstConstantID Constant id of the first flag */
+		explicit PipelineVariants(VkDevice device, uint32_t firstConstantID = 0)
+			: device(device), constants(variantCount, Constants(firstConstantID)), stages(variantCount), pipelines(variantCount, VK_NULL_HANDLE)
+		{
+			for (uint32_t variant = 0; variant < variantCount; variant++) {
+				for (uint32_t flag = 0; flag < FlagCount; flag++) {
+					constants[variant].set(flag, static_cast<VkBool32>((variant & (1u << flag)) ? VK_TRUE : VK_FALSE));
+				}
+			}
+		}
+
+		PipelineVariants(const PipelineVariants&) = delete;
+		PipelineVariants& operator=(const PipelineVariants&) = delete;
+
+		~PipelineVariants()
+		{
+			for (auto pipeline : pipelines) {
+				if (pipeline != VK_NULL_HANDLE) {
+					vkDestroyPipeline(device, pipeline, nullptr);
+				}
+			}
+		}
+
+		/** @brief Set a constant following the flags for all variants */
+		template<uint32_t Index>
+		void setShared(typename Constants::template Type<FlagCount + Index> value)
+		{
+			for (auto& variantConstants : constants) {
+				variantConstants.template set<FlagCount + Index>(value);
+			}
+		}
+
+		/**
+		* Queue all variants of a pipeline for creation
+		*
+		* @param batch Batch to add the pipelines to, see vks::PipelineBatch
+		* @param createInfo Create info of the pipeline, copied for every variant
+		* @param specializedStages Stages that get the variant's constants, replacing their own specialization info
+		*/
+		void add(vks::PipelineBatch& batch, const VkGraphicsPipelineCreateInfo& createInfo, VkShaderStageFlags specializedStages)
+		{
+			for (uint32_t variant = 0; variant < variantCount; variant++) {
+				stages[variant].assign(createInfo.pStages, createInfo.pStages + createInfo.stageCount);
+				for (auto& stage : stages[variant]) {
+					if (stage.stage & specializedStages) {
+						stage.pSpecializationInfo = constants[variant].getInfo();
+					}
+				}
+				VkGraphicsPipelineCreateInfo variantCreateInfo = createInfo;
+				variantCreateInfo.pStages = stages[variant].data();
+				batch.add(variantCreateInfo, &pipelines[variant]);
+			}
+		}
+
+		/** @brief Pipeline for a combination of flags, bit i selects flag i */
+		VkPipeline get(uint32_t flags) const
+		{
+			assert(flags < variantCount);
+			return pipelines[flags];
+		}
+	};
+}
@@ -0,0 +1,441 @@
+/*
+* Persistent staging ring buffer
+*
+* Stages upload data in a persistently mapped host visible ring buffer and batches the transfer commands of many uploads into a single submission
+* Uploads are submitted to a dedicated transfer queue if the device has one, including the required queue family ownership transfers
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanStagingRing.h"
+#include "VulkanDevice.h"
+#include "VulkanTrace.h"
+
+namespace vks
+{
+	/**
+	* @param device Device to create the ring buffer on
+	* @param graphicsQueue Queue the uploaded resources are used on, must be from the graphics queue family
+	* @param size Size of the ring buffer in bytes
+	*
+	* @note A dedicated transfer queue is used if the device has been created with a separate transfer queue family
+	*/
+	StagingRing::StagingRing(vks::VulkanDevice *device, VkQueue graphicsQueue, VkDeviceSize size) : device(device), graphicsQueue(graphicsQueue), capacity(size)
+	{
+		graphicsQueueFamily = device->queueFamilyIndices.graphics;
+		transferQueueFamily = device->queueFamilyIndices.transfer;
+		if (transferQueueFamily != graphicsQueueFamily)
+		{
+			vkGetDeviceQueue(device->logicalDevice, transferQueueFamily, 0, &transferQueue);
+			transferCommandPool = device->createCommandPool(transferQueueFamily);
+		}
+		else
+		{
+			transferQueue = graphicsQueue;
+			transferCommandPool = device->commandPool;
+		}
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, capacity));
+		VK_CHECK_RESULT(buffer.map());
+	}
+
+	/** @brief Wait for all uploads to finish and release the ring buffer */
+	StagingRing::~StagingRing()
+	{
+		flush();
+		for (auto fence : freeFences)
+		{
+			vkDestroyFence(device->logicalDevice, fence, nullptr);
+		}
+		for (auto semaphore : freeSemaphores)
+		{
+			vkDestroySemaphore(device->logicalDevice, semaphore, nullptr);
+		}
+		if (usesTransferQueue())
+		{
+			vkDestroyCommandPool(device->logicalDevice, transferCommandPool, nullptr);
+		}
+		buffer.unmap();
+		buffer.destroy();
+	}
+
+	/** @brief True if uploads run on a dedicated transfer queue */
+	bool StagingRing::usesTransferQueue() const
+	{
+		return transferQueueFamily != graphicsQueueFamily;
+	}
+
+	// Start of the oldest region still in use, false if no part of the ring is in use
+	bool StagingRing::getTail(VkDeviceSize &tail) const
+	{
+		for (auto &batch : inFlight)
+		{
+			if (batch.hasRegions)
+			{
+				tail = batch.begin;
+				return true;
+			}
+		}
+		if (pending.hasRegions)
+		{
+			tail = pending.begin;
+			return true;
+		}
+		return false;
+	}
+
+	bool StagingRing::reserve(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset)
+	{
+		VkDeviceSize tail;
+		if (!getTail(tail))
+		{
+			// Ring is empty, start over at the beginning to keep the largest possible contiguous range free
+			head = 0;
+			offset = 0;
+		}
+		else
+		{
+			offset = (head + alignment - 1) / alignment * alignment;
+			if (head > tail)
+			{
+				// Free space is behind the head and in front of the tail, wrap around if the region doesn't fit behind the head
+				if (offset + size > capacity)
+				{
+					if (size > tail)
+					{
+						return false;
+					}
+					offset = 0;
+				}
+			}
+			else if ((head == tail) || (offset + size > tail))
+			{
+				return false;
+			}
+		}
+		head = offset + size;
+		if (!pending.hasRegions)
+		{
+			pending.hasRegions = true;
+			pending.begin = offset;
+		}
+		pending.end = head;
+		return true;
+	}
+
+	// Release the resources of submissions that have finished, optionally waiting for the oldest one
+	void StagingRing::retire(bool wait)
+	{
+		while (!inFlight.empty())
+		{
+			Batch &batch = inFlight.front();
+			if (vkGetFenceStatus(device->logicalDevice, batch.fence) != VK_SUCCESS)
+			{
+				if (!wait)
+				{
+					break;
+				}
+				VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &batch.fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+				wait = false;
+			}
+			vkFreeCommandBuffers(device->logicalDevice, transferCommandPool, 1, &batch.commandBuffer);
+			if (batch.acquireCommandBuffer != VK_NULL_HANDLE)
+			{
+				vkFreeCommandBuffers(device->logicalDevice, device->commandPool, 1, &batch.acquireCommandBuffer);
+			}
+			if (batch.semaphore != VK_NULL_HANDLE)
+			{
+				freeSemaphores.push_back(batch.semaphore);
+			}
+			VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &batch.fence));
+			freeFences.push_back(batch.fence);
+			completedToken = batch.token;
+			for (auto &dedicatedBuffer : batch.dedicatedBuffers)
+			{
+				dedicatedBuffer.unmap();
+				dedicatedBuffer.destroy();
+			}
+			inFlight.pop_front();
+		}
+	}
+
+	/**
+	* Reserve a region of the ring without copying into it, so upload data can be written (or converted) directly into the mapped memory
+	*
+	* @param size Size of the region in bytes
+	* @param (Optional) alignment Alignment of the region's offset (Defaults to 16, which satisfies buffer and image copies of all uncompressed formats)
+	*
+	* @return Buffer, offset and host pointer of the region, the data must be written before the next submit()
+	*
+	* @note Allocating may submit the uploads recorded so far to make room, so fetch the command buffer with getCommandBuffer() afterwards
+	*/
+	StagingRing::Region StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		// Data that doesn't fit into the ring gets a staging buffer of its own that is released with the batch
+		if (size > capacity)
+		{
+			vks::Buffer dedicatedBuffer;
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &dedicatedBuffer, size));
+			VK_CHECK_RESULT(dedicatedBuffer.map());
+			pending.dedicatedBuffers.push_back(dedicatedBuffer);
+			getCommandBuffer();
+			return { dedicatedBuffer.buffer, 0, dedicatedBuffer.mapped };
+		}
+		retire(false);
+		VkDeviceSize offset;
+		while (!reserve(size, alignment, offset))
+		{
+			if (pending.hasRegions)
+			{
+				submit();
+			}
+			else
+			{
+				retire(true);
+			}
+		}
+		getCommandBuffer();
+		return { buffer.buffer, offset, static_cast<char*>(buffer.mapped) + offset };
+	}
+
+	/**
+	* Copy data into the ring
+	*
+	* @param data Pointer to the data to stage
+	* @param size Size of the data in bytes
+	* @param (Optional) alignment Alignment of the region's offset (Defaults to 16, which satisfies buffer and image copies of all uncompressed formats)
+	*
+	* @return Buffer and offset of the staged data, valid as a copy source in the command buffer returned by getCommandBuffer() until the next submit()
+	*
+	* @note Staging may submit the uploads recorded so far to make room, so fetch the command buffer with getCommandBuffer() after staging
+	*/
+	StagingRing::Region StagingRing::stage(const void *data, VkDeviceSize size, VkDeviceSize alignment)
+	{
+		Region region = allocate(size, alignment);
+		memcpy(region.data, data, size);
+		return region;
+	}
+
+	/** @brief Command buffer of the current batch, transfer commands reading from staged regions are recorded into it */
+	VkCommandBuffer StagingRing::getCommandBuffer()
+	{
+		if (pending.commandBuffer == VK_NULL_HANDLE)
+		{
+			pending.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, transferCommandPool, true);
+		}
+		return pending.commandBuffer;
+	}
+
+	VkCommandBuffer StagingRing::getAcquireCommandBuffer()
+	{
+		if (pending.acquireCommandBuffer == VK_NULL_HANDLE)
+		{
+			pending.acquireCommandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, device->commandPool, true);
+		}
+		return pending.acquireCommandBuffer;
+	}
+
+	/**
+	* Hand a buffer written by the current batch over to the graphics queue
+	*
+	* @note Only records ownership transfer barriers with a dedicated transfer queue, otherwise the batch's final memory barrier makes the writes visible
+	*/
+	void StagingRing::releaseBuffer(VkBuffer dstBuffer, VkDeviceSize offset, VkDeviceSize size)
+	{
+		if (!usesTransferQueue())
+		{
+			return;
+		}
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcQueueFamilyIndex = transferQueueFamily;
+		bufferBarrier.dstQueueFamilyIndex = graphicsQueueFamily;
+		bufferBarrier.buffer = dstBuffer;
+		bufferBarrier.offset = offset;
+		bufferBarrier.size = size;
+		// Release on the transfer queue
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(getCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		// Matching acquire on the graphics queue
+		bufferBarrier.srcAccessMask = 0;
+		bufferBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(getAcquireCommandBuffer(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+	}
+
+	/**
+	* Transition an image written by the current batch to its final layout and hand it over to the graphics queue
+	*
+	* @param image Image to release
+	* @param subresourceRange Subresources that have been written
+	* @param oldImageLayout Layout the image has been written in (usually VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+	* @param newImageLayout Layout the image is used in on the graphics queue
+	*/
+	void StagingRing::releaseImage(VkImage image, VkImageSubresourceRange subresourceRange, VkImageLayout oldImageLayout, VkImageLayout newImageLayout)
+	{
+		if (!usesTransferQueue())
+		{
+			vks::tools::setImageLayout(getCommandBuffer(), image, oldImageLayout, newImageLayout, subresourceRange);
+			return;
+		}
+		// The layout transition is part of the ownership transfer, so both barriers have to specify the same layouts
+		VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+		imageBarrier.srcQueueFamilyIndex = transferQueueFamily;
+		imageBarrier.dstQueueFamilyIndex = graphicsQueueFamily;
+		imageBarrier.image = image;
+		imageBarrier.subresourceRange = subresourceRange;
+		imageBarrier.oldLayout = oldImageLayout;
+		imageBarrier.newLayout = newImageLayout;
+		// Release on the transfer queue
+		imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageBarrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(getCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+		// Matching acquire on the graphics queue
+		imageBarrier.srcAccessMask = 0;
+		imageBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(getAcquireCommandBuffer(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+	}
+
+	/**
+	* Stage data and record its copy into a buffer
+	*
+	* @param data Pointer to the data to upload
+	* @param size Size of the data in bytes
+	* @param dstBuffer Buffer to copy the data to, must have been created with VK_BUFFER_USAGE_TRANSFER_DST_BIT
+	* @param (Optional) dstOffset Offset into the destination buffer (Defaults to 0)
+	*/
+	void StagingRing::copyToBuffer(const void *data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset)
+	{
+		// Large uploads are split up, so they don't need a dedicated staging buffer and can overlap with earlier submissions
+		const VkDeviceSize chunkSize = std::max(capacity / 2, (VkDeviceSize)1);
+		for (VkDeviceSize copied = 0; copied < size; copied += chunkSize)
+		{
+			const VkDeviceSize copySize = std::min(chunkSize, size - copied);
+			Region region = stage(static_cast<const char*>(data) + copied, copySize, 4);
+			VkBufferCopy copyRegion = { region.offset, dstOffset + copied, copySize };
+			vkCmdCopyBuffer(getCommandBuffer(), region.buffer, dstBuffer, 1, &copyRegion);
+			// Released per chunk, as staging the next chunk may submit the current batch
+			releaseBuffer(dstBuffer, dstOffset + copied, copySize);
+		}
+	}
+
+	/** @brief True if uploads have been recorded that haven't been submitted yet */
+	bool StagingRing::hasPendingUploads() const
+	{
+		return pending.commandBuffer != VK_NULL_HANDLE;
+	}
+
+	/** @brief Token of the batch that currently recorded uploads will be submitted with (or of the last submitted batch if nothing is pending) */
+	uint64_t StagingRing::getPendingToken()
+	{
+		return hasPendingUploads() ? nextToken : nextToken - 1;
+	}
+
+	/** @brief True if the uploads of the batch with the given token (and all earlier ones) have finished, including their acquire on the graphics queue */
+	bool StagingRing::isComplete(uint64_t token)
+	{
+		retire(false);
+		return token <= completedToken;
+	}
+
+	/** @brief Wait on the host until the batch with the given token has finished, submitting it first if it is still pending */
+	void StagingRing::wait(uint64_t token)
+	{
+		if (token >= nextToken)
+		{
+			submit();
+		}
+		while ((completedToken < token) && !inFlight.empty())
+		{
+			retire(true);
+		}
+	}
+
+	/**
+	* Submit all uploads recorded since the last submission without waiting for them to finish
+	*
+	* @return Completion token of the submitted batch, see isComplete() and wait()
+	*/
+	uint64_t StagingRing::submit()
+	{
+		VKS_TRACE_SCOPE("StagingRing::submit");
+		// The release and acquire submissions are made under the queue lock, so no other submission can be placed between them
+		std::lock_guard<std::recursive_mutex> queueLock(device->queueMutex);
+		if (pending.commandBuffer == VK_NULL_HANDLE)
+		{
+			return nextToken - 1;
+		}
+		if (!usesTransferQueue())
+		{
+			// Make the transfer writes visible to all later commands on the queue
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			vkCmdPipelineBarrier(pending.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(pending.commandBuffer));
+
+		if (freeFences.empty())
+		{
+			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+			VkFence fence;
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceInfo, nullptr, &fence));
+			freeFences.push_back(fence);
+		}
+		pending.fence = freeFences.back();
+		freeFences.pop_back();
+
+		pending.token = nextToken++;
+
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &pending.commandBuffer;
+		if (usesTransferQueue())
+		{
+			// The transfer submission signals a semaphore that the acquire submission on the graphics queue waits on
+			// Only the acquire barriers wait for the uploads, the graphics queue keeps rendering until it reaches them
+			if (freeSemaphores.empty())
+			{
+				VkSemaphoreCreateInfo semaphoreCI = vks::initializers::semaphoreCreateInfo();
+				VkSemaphore semaphore;
+				VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCI, nullptr, &semaphore));
+				freeSemaphores.push_back(semaphore);
+			}
+			pending.semaphore = freeSemaphores.back();
+			freeSemaphores.pop_back();
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &pending.semaphore;
+			VK_CHECK_RESULT(device->queueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE));
+
+			const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			VkSubmitInfo acquireSubmitInfo = vks::initializers::submitInfo();
+			acquireSubmitInfo.waitSemaphoreCount = 1;
+			acquireSubmitInfo.pWaitSemaphores = &pending.semaphore;
+			acquireSubmitInfo.pWaitDstStageMask = &waitStageMask;
+			if (pending.acquireCommandBuffer != VK_NULL_HANDLE)
+			{
+				VK_CHECK_RESULT(vkEndCommandBuffer(pending.acquireCommandBuffer));
+				acquireSubmitInfo.commandBufferCount = 1;
+				acquireSubmitInfo.pCommandBuffers = &pending.acquireCommandBuffer;
+			}
+			VK_CHECK_RESULT(device->queueSubmit(graphicsQueue, 1, &acquireSubmitInfo, pending.fence));
+		}
+		else
+		{
+			VK_CHECK_RESULT(device->queueSubmit(graphicsQueue, 1, &submitInfo, pending.fence));
+		}
+		const uint64_t token = pending.token;
+		inFlight.push_back(pending);
+		pending = Batch();
+		return token;
+	}
+
+	/** @brief Submit all recorded uploads and wait until all of them have finished */
+	void StagingRing::flush()
+	{
+		VKS_TRACE_SCOPE("StagingRing::flush");
+		submit();
+		while (!inFlight.empty())
+		{
+			retire(true);
+		}
+	}
+}
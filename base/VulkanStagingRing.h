@@ -0,0 +1,95 @@
+/*
+* Persistent staging ring buffer
+*
+* Stages upload data in a persistently mapped host visible ring buffer and batches the transfer commands of many uploads into a single submission
+* Uploads are submitted to a dedicated transfer queue if the device has one, including the required queue family ownership transfers
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Ring buffer for staging uploads
+	*
+	* Upload data is copied into the ring with stage(), or written directly into a region reserved with allocate(), and the transfer commands reading from it are recorded into getCommandBuffer()
+	* Resources written by these commands are handed over to the graphics queue with releaseBuffer() / releaseImage()
+	* All uploads recorded since the last submit() are submitted together, the ring regions of a submission are reused once it has finished
+	*
+	* With a dedicated transfer queue, the copies run on the transfer queue and a small acquire submission on the graphics queue waits for them
+	* on a semaphore, so uploads overlap with rendering instead of stalling the graphics queue
+	*
+	* @note Commands recorded into getCommandBuffer() must be supported by the transfer queue (copies and barriers, no blits)
+	*/
+	class StagingRing
+	{
+	private:
+		struct Batch {
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			// Ownership acquire barriers recorded on the graphics queue (only used with a dedicated transfer queue)
+			VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			uint64_t token = 0;
+			bool hasRegions = false;
+			VkDeviceSize begin = 0;
+			VkDeviceSize end = 0;
+			// Staging buffers for uploads that don't fit into the ring
+			std::vector<vks::Buffer> dedicatedBuffers;
+		};
+		vks::VulkanDevice *device;
+		VkQueue graphicsQueue;
+		VkQueue transferQueue;
+		uint32_t graphicsQueueFamily;
+		uint32_t transferQueueFamily;
+		// Command pool for the transfer queue family, the device's default pool is used if there is no dedicated transfer queue
+		VkCommandPool transferCommandPool;
+		vks::Buffer buffer;
+		VkDeviceSize capacity;
+		VkDeviceSize head = 0;
+		Batch pending;
+		std::deque<Batch> inFlight;
+		std::vector<VkFence> freeFences;
+		std::vector<VkSemaphore> freeSemaphores;
+		uint64_t nextToken = 1;
+		uint64_t completedToken = 0;
+		bool getTail(VkDeviceSize &tail) const;
+		bool reserve(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset);
+		void retire(bool wait);
+		VkCommandBuffer getAcquireCommandBuffer();
+	public:
+		/** @brief Location of staged data */
+		struct Region {
+			VkBuffer buffer;
+			VkDeviceSize offset;
+			// Host pointer to the region's mapped memory
+			void *data;
+		};
+
+		StagingRing(vks::VulkanDevice *device, VkQueue graphicsQueue, VkDeviceSize size);
+		~StagingRing();
+		bool usesTransferQueue() const;
+		Region allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+		Region stage(const void *data, VkDeviceSize size, VkDeviceSize alignment = 16);
+		VkCommandBuffer getCommandBuffer();
+		void releaseBuffer(VkBuffer dstBuffer, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+		void releaseImage(VkImage image, VkImageSubresourceRange subresourceRange, VkImageLayout oldImageLayout, VkImageLayout newImageLayout);
+		void copyToBuffer(const void *data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0);
+		bool hasPendingUploads() const;
+		uint64_t getPendingToken();
+		bool isComplete(uint64_t token);
+		void wait(uint64_t token);
+		uint64_t submit();
+		void flush();
+	};
+}
@@ -0,0 +1,154 @@
+/*
+* Startup time report
+*
+* Records the durations of the startup phases of an example, the assets it loads and the pipelines it creates, and prints a ranked
+* breakdown once the first frame has been rendered
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanStartupReport.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace vks
+{
+	namespace
+	{
+		struct Entry {
+			uint64_t duration = 0;
+			uint32_t count = 0;
+		};
+
+		struct ReportState {
+			std::mutex mutex;
+			// Merged entries per category and name
+			std::map<std::pair<int, std::string>, Entry> entries;
+			uint64_t startTime = 0;
+		};
+
+		ReportState &state()
+		{
+			static ReportState reportState;
+			return reportState;
+		}
+
+		const char *categoryNames[] = { "Phases", "Assets", "Shaders", "Pipelines" };
+		const char *categoryKeys[] = { "phase", "asset", "shader", "pipeline" };
+	}
+
+	std::atomic<bool> StartupReport::active{ false };
+
+	/** @brief Start recording, the total startup time is measured from this point */
+	void StartupReport::start()
+	{
+		ReportState &reportState = state();
+		{
+			std::lock_guard<std::mutex> lock(reportState.mutex);
+			reportState.entries.clear();
+			reportState.startTime = Tracer::now();
+		}
+		active.store(true, std::memory_order_release);
+	}
+
+	/**
+	* Add an entry with explicit times (see vks::Tracer::now())
+	*
+	* @param category Category the entry is ranked in
+	* @param name Name of the entry, durations of entries with the same category and name are summed up
+	*/
+	void StartupReport::add(Category category, const std::string &name, uint64_t begin, uint64_t end)
+	{
+		if (!isActive())
+		{
+			return;
+		}
+		ReportState &reportState = state();
+		std::lock_guard<std::mutex> lock(reportState.mutex);
+		Entry &entry = reportState.entries[std::make_pair(static_cast<int>(category), name)];
+		entry.duration += end - begin;
+		entry.count++;
+	}
+
+	/**
+	* Stop recording and print the entries of each category ranked by duration
+	*
+	* @param filename If set, the entries are also saved to this file as comma separated values
+	*/
+	void StartupReport::finish(const std::string &filename)
+	{
+		if (!active.exchange(false))
+		{
+			return;
+		}
+		ReportState &reportState = state();
+		std::lock_guard<std::mutex> lock(reportState.mutex);
+		const uint64_t total = Tracer::now() - reportState.startTime;
+
+		struct RankedEntry {
+			int category;
+			std::string name;
+			Entry entry;
+		};
+		std::vector<RankedEntry> ranked;
+		for (auto &entry : reportState.entries)
+		{
+			ranked.push_back({ entry.first.first, entry.first.second, entry.second });
+		}
+		std::stable_sort(ranked.begin(), ranked.end(), [](const RankedEntry &a, const RankedEntry &b) {
+			return (a.category != b.category) ? (a.category < b.category) : (a.entry.duration > b.entry.duration);
+		});
+
+		auto milliseconds = [](uint64_t duration) {
+			return static_cast<double>(duration) / 1000000.0;
+		};
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "Startup took " << milliseconds(total) << " ms until the first frame was rendered\n";
+		int category = -1;
+		for (auto &entry : ranked)
+		{
+			if (entry.category != category)
+			{
+				category = entry.category;
+				uint64_t categoryTotal = 0;
+				for (auto &other : ranked)
+				{
+					categoryTotal += (other.category == category) ? other.entry.duration : 0;
+				}
+				std::cout << categoryNames[category] << " (" << milliseconds(categoryTotal) << " ms):\n";
+			}
+			std::cout << std::setw(10) << milliseconds(entry.entry.duration) << " ms " << std::setw(6) << 100.0 * static_cast<double>(entry.entry.duration) / static_cast<double>(std::max(total, (uint64_t)1)) << "%  " << entry.name;
+			if (entry.entry.count > 1)
+			{
+				std::cout << " (" << entry.entry.count << "x)";
+			}
+			std::cout << "\n";
+		}
+		std::cout << std::defaultfloat;
+
+		if (!filename.empty())
+		{
+			std::ofstream file(filename, std::ios::out);
+			if (!file.is_open())
+			{
+				std::cerr << "Could not write startup report to " << filename << "\n";
+				return;
+			}
+			file << std::fixed << std::setprecision(3);
+			file << "category,name,count,milliseconds\n";
+			file << "total,startup,1," << milliseconds(total) << "\n";
+			for (auto &entry : ranked)
+			{
+				std::string name = entry.name;
+				std::replace(name.begin(), name.end(), ',', ';');
+				file << categoryKeys[entry.category] << "," << name << "," << entry.entry.count << "," << milliseconds(entry.entry.duration) << "\n";
+			}
+			std::cout << "Saved startup report to " << filename << "\n";
+		}
+	}
+}
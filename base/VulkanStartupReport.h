@@ -0,0 +1,81 @@
+/*
+* Startup time report
+*
+* Records the durations of the startup phases of an example, the assets it loads and the pipelines it creates, and prints a ranked
+* breakdown once the first frame has been rendered
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "VulkanTrace.h"
+
+namespace vks
+{
+	/**
+	* Durations of everything that happens between start() and finish()
+	*
+	* Usage:
+	*	vks::StartupReport::start();
+	*	{
+	*		VKS_STARTUP_SCOPE(vks::StartupReport::Phase, "loadAssets");
+	*		...
+	*	}
+	*	vks::StartupReport::finish("startup.csv");
+	*
+	* Entries with the same category and name are merged and counted. Phases may contain other entries (e.g. the asset loads of a
+	* prepare phase), so the durations of the categories don't add up to the total startup time.
+	*
+	* @note Recording is thread safe, assets loaded by worker threads are reported with their own durations
+	* @note Nothing is recorded after finish(), so loads at run time don't show up in the report
+	*/
+	class StartupReport
+	{
+	private:
+		static std::atomic<bool> active;
+	public:
+		enum Category { Phase = 0, Asset = 1, Shader = 2, Pipeline = 3 };
+		static void start();
+		/** @brief True between start() and finish() */
+		static bool isActive()
+		{
+			return active.load(std::memory_order_relaxed);
+		}
+		static void add(Category category, const std::string &name, uint64_t begin, uint64_t end);
+		static void finish(const std::string &filename = "");
+	};
+
+	/** @brief Records the lifetime of the object as an entry of the startup report if the report is active */
+	class StartupScope
+	{
+	private:
+		StartupReport::Category category;
+		std::string name;
+		uint64_t begin = 0;
+	public:
+		StartupScope(StartupReport::Category category, const std::string &name) : category(category)
+		{
+			if (StartupReport::isActive())
+			{
+				this->name = name;
+				begin = Tracer::now();
+			}
+		}
+		~StartupScope()
+		{
+			if (begin != 0)
+			{
+				StartupReport::add(category, name, begin, Tracer::now());
+			}
+		}
+		StartupScope(const StartupScope &) = delete;
+		StartupScope &operator=(const StartupScope &) = delete;
+	};
+}
+
+/** @brief Reports the rest of the enclosing block as an entry of the given category and name (a std::string or string literal) */
+#define VKS_STARTUP_SCOPE(category, name) vks::StartupScope VKS_TRACE_CONCAT(startupScope, __LINE__)(category, name)
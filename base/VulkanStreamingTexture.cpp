@@ -0,0 +1,364 @@
+/*
+* Streaming sparse texture
+*
+* Partially resident texture whose pages are bound and uploaded on demand from GPU feedback, within a fixed device memory budget
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanStreamingTexture.h"
+#include "VulkanDevice.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace vks
+{
+	/**
+	* Create the sparse image, bind and upload its mip tail and allocate the page memory
+	*
+	* @param device Device to create the texture on
+	* @param queue Queue used for sparse binding and page uploads, needs to support sparse binding and transfer operations
+	* @param width Width of the first mip level
+	* @param height Height of the first mip level
+	* @param format Uncompressed format of the texture
+	* @param texelSize Size of a texel of the format in bytes
+	* @param memoryBudget Device memory available to pages outside of the mip tail
+	* @param pageLoader Callback providing the texel data of pages and mip tail levels
+	*/
+	StreamingTexture::StreamingTexture(vks::VulkanDevice *device, VkQueue queue, uint32_t width, uint32_t height, VkFormat format, uint32_t texelSize, VkDeviceSize memoryBudget, PageLoader pageLoader)
+		: width(width), height(height), format(format), device(device), queue(queue), texelSize(texelSize), pageLoader(pageLoader)
+	{
+		if (!device->enabledFeatures.sparseBinding || !device->enabledFeatures.sparseResidencyImage2D) {
+			vks::tools::exitFatal("Streaming textures require the sparseBinding and sparseResidencyImage2D features", -1);
+		}
+
+		mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height)))) + 1;
+
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.mipLevels = mipLevels;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { width, height, 1 };
+		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCreateInfo.flags = VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
+		if (memReqs.size > device->properties.limits.sparseAddressSpaceSize) {
+			vks::tools::exitFatal("Streaming texture exceeds the sparse address space size", -1);
+		}
+
+		uint32_t sparseMemoryReqsCount = 0;
+		vkGetImageSparseMemoryRequirements(device->logicalDevice, image, &sparseMemoryReqsCount, nullptr);
+		std::vector<VkSparseImageMemoryRequirements> sparseMemoryReqs(sparseMemoryReqsCount);
+		vkGetImageSparseMemoryRequirements(device->logicalDevice, image, &sparseMemoryReqsCount, sparseMemoryReqs.data());
+		auto colorReqs = std::find_if(sparseMemoryReqs.begin(), sparseMemoryReqs.end(), [](const VkSparseImageMemoryRequirements &reqs) {
+			return (reqs.formatProperties.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT) != 0;
+		});
+		if (colorReqs == sparseMemoryReqs.end()) {
+			vks::tools::exitFatal("Streaming texture format doesn't support sparse residency", -1);
+		}
+		const VkSparseImageMemoryRequirements sparseMemoryReq = *colorReqs;
+
+		// Every page uses one sparse block of memory
+		pageExtent = sparseMemoryReq.formatProperties.imageGranularity;
+		pageSize = memReqs.alignment;
+		mipTailStart = std::min(sparseMemoryReq.imageMipTailFirstLod, mipLevels);
+		pageCountX = (width + pageExtent.width - 1) / pageExtent.width;
+		pageCountY = (height + pageExtent.height - 1) / pageExtent.height;
+
+		for (uint32_t level = 0; level < mipTailStart; level++) {
+			const uint32_t levelWidth = std::max(width >> level, 1u);
+			const uint32_t levelHeight = std::max(height >> level, 1u);
+			const uint32_t countX = (levelWidth + pageExtent.width - 1) / pageExtent.width;
+			const uint32_t countY = (levelHeight + pageExtent.height - 1) / pageExtent.height;
+			levelFirstPage.push_back(static_cast<uint32_t>(pages.size()));
+			levelPageCountX.push_back(countX);
+			levelPageCountY.push_back(countY);
+			for (uint32_t y = 0; y < countY; y++) {
+				for (uint32_t x = 0; x < countX; x++) {
+					Page page;
+					page.mipLevel = level;
+					page.offset = { static_cast<int32_t>(x * pageExtent.width), static_cast<int32_t>(y * pageExtent.height), 0 };
+					page.extent.width = std::min(pageExtent.width, levelWidth - x * pageExtent.width);
+					page.extent.height = std::min(pageExtent.height, levelHeight - y * pageExtent.height);
+					page.extent.depth = 1;
+					pages.push_back(page);
+				}
+			}
+		}
+		statistics.pageCount = static_cast<uint32_t>(pages.size());
+
+		// Page memory is a single allocation of the budget, split into page sized slots
+		const uint32_t memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		const uint32_t slotCount = std::max(static_cast<uint32_t>(std::min<VkDeviceSize>(memoryBudget / pageSize, pages.size())), 1u);
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		memAllocInfo.allocationSize = slotCount * pageSize;
+		memAllocInfo.memoryTypeIndex = memoryTypeIndex;
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &pageMemory));
+		for (uint32_t slot = slotCount; slot > 0; slot--) {
+			freeSlots.push_back(slot - 1);
+		}
+
+		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
+		VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceCreateInfo, nullptr, &bindFence));
+
+		// The mip tail stays resident for the lifetime of the texture, so there always is a level to fall back to
+		if (mipTailStart < mipLevels) {
+			memAllocInfo.allocationSize = sparseMemoryReq.imageMipTailSize;
+			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &mipTailMemory));
+			VkSparseMemoryBind mipTailBind{};
+			mipTailBind.resourceOffset = sparseMemoryReq.imageMipTailOffset;
+			mipTailBind.size = sparseMemoryReq.imageMipTailSize;
+			mipTailBind.memory = mipTailMemory;
+			VkSparseImageOpaqueMemoryBindInfo opaqueBindInfo{};
+			opaqueBindInfo.image = image;
+			opaqueBindInfo.bindCount = 1;
+			opaqueBindInfo.pBinds = &mipTailBind;
+			VkBindSparseInfo bindSparseInfo = vks::initializers::bindSparseInfo();
+			bindSparseInfo.imageOpaqueBindCount = 1;
+			bindSparseInfo.pImageOpaqueBinds = &opaqueBindInfo;
+			VK_CHECK_RESULT(device->queueBindSparse(queue, 1, &bindSparseInfo, bindFence));
+			VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &bindFence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &bindFence));
+			statistics.residentBytes = sparseMemoryReq.imageMipTailSize;
+		}
+
+		std::vector<VkBufferImageCopy> regions;
+		std::vector<uint8_t> data;
+		for (uint32_t level = mipTailStart; level < mipLevels; level++) {
+			VkBufferImageCopy region{};
+			region.bufferOffset = data.size();
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+			region.imageExtent = { std::max(width >> level, 1u), std::max(height >> level, 1u), 1 };
+			data.resize(data.size() + region.imageExtent.width * region.imageExtent.height * texelSize);
+			pageLoader(level, region.imageOffset, region.imageExtent, &data[region.bufferOffset]);
+			regions.push_back(region);
+		}
+		upload(regions, data);
+
+		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+		viewCreateInfo.image = image;
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = format;
+		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
+
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.maxLod = static_cast<float>(mipLevels);
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+
+		descriptor.sampler = sampler;
+		descriptor.imageView = view;
+		descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&feedbackBuffer,
+			pageCountX * pageCountY * sizeof(uint32_t)));
+		VK_CHECK_RESULT(feedbackBuffer.map());
+		resetFeedback();
+	}
+
+	StreamingTexture::~StreamingTexture()
+	{
+		feedbackBuffer.destroy();
+		vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		vkDestroyImageView(device->logicalDevice, view, nullptr);
+		vkDestroyImage(device->logicalDevice, image, nullptr);
+		vkFreeMemory(device->logicalDevice, pageMemory, nullptr);
+		if (mipTailMemory != VK_NULL_HANDLE) {
+			vkFreeMemory(device->logicalDevice, mipTailMemory, nullptr);
+		}
+		vkDestroyFence(device->logicalDevice, bindFence, nullptr);
+	}
+
+	uint32_t StreamingTexture::getPageIndex(uint32_t mipLevel, uint32_t x, uint32_t y) const
+	{
+		// Non power of two levels may have fewer pages than the first level's page grid shifted down
+		const uint32_t countX = levelPageCountX[mipLevel];
+		return levelFirstPage[mipLevel] + std::min(y, levelPageCountY[mipLevel] - 1) * countX + std::min(x, countX - 1);
+	}
+
+	void StreamingTexture::resetFeedback()
+	{
+		memset(feedbackBuffer.mapped, 0xFF, pageCountX * pageCountY * sizeof(uint32_t));
+	}
+
+	void StreamingTexture::upload(const std::vector<VkBufferImageCopy> &regions, const std::vector<uint8_t> &data)
+	{
+		const bool initialUpload = (updateIndex == 0);
+		if (regions.empty() && !initialUpload) {
+			return;
+		}
+		vks::Buffer stagingBuffer;
+		if (!regions.empty()) {
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&stagingBuffer,
+				data.size(),
+				(void*)data.data()));
+		}
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		// Pages are written in the general layout so already resident levels stay valid while being sampled
+		VkImageMemoryBarrier imageMemoryBarrier = vks::initializers::imageMemoryBarrier();
+		imageMemoryBarrier.image = image;
+		imageMemoryBarrier.subresourceRange = subresourceRange;
+		imageMemoryBarrier.oldLayout = initialUpload ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.srcAccessMask = initialUpload ? 0 : VK_ACCESS_SHADER_READ_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		if (!regions.empty()) {
+			vkCmdCopyBufferToImage(copyCmd, stagingBuffer.buffer, image, VK_IMAGE_LAYOUT_GENERAL, static_cast<uint32_t>(regions.size()), regions.data());
+		}
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		device->flushCommandBuffer(copyCmd, queue);
+		if (!regions.empty()) {
+			stagingBuffer.destroy();
+		}
+	}
+
+	/**
+	* Make the pages requested through the feedback buffer resident and reset the feedback
+	*
+	* @note Binds memory and uploads pages synchronously on the texture's queue, no submitted work may use the texture or write the feedback buffer while this runs
+	*/
+	void StreamingTexture::update()
+	{
+		const uint64_t frame = ++updateIndex;
+		statistics.requestedPages = 0;
+		statistics.uploadedPages = 0;
+		statistics.evictedPages = 0;
+		statistics.budgetLimitedPages = 0;
+
+		// Every page requested for a level also needs the coarser pages covering it, so sampling can fall back
+		std::vector<uint32_t> requests;
+		const uint32_t *requestedLevels = static_cast<const uint32_t*>(feedbackBuffer.mapped);
+		for (uint32_t y = 0; y < pageCountY; y++) {
+			for (uint32_t x = 0; x < pageCountX; x++) {
+				const uint32_t requestedLevel = requestedLevels[y * pageCountX + x];
+				for (uint32_t level = requestedLevel; level < mipTailStart; level++) {
+					const uint32_t pageIndex = getPageIndex(level, x >> level, y >> level);
+					Page &page = pages[pageIndex];
+					if (page.lastRequested == frame) {
+						continue;
+					}
+					page.lastRequested = frame;
+					statistics.requestedPages++;
+					if (page.slot == UINT32_MAX) {
+						requests.push_back(pageIndex);
+					}
+				}
+			}
+		}
+		resetFeedback();
+
+		// Coarse levels first, they cover larger parts of the texture and serve as fallback for the finer ones
+		std::stable_sort(requests.begin(), requests.end(), [this](uint32_t a, uint32_t b) {
+			return pages[a].mipLevel > pages[b].mipLevel;
+		});
+		if (requests.size() > maxUploadsPerUpdate) {
+			requests.resize(maxUploadsPerUpdate);
+		}
+
+		// Pages not requested in this update are evicted in least recently requested order once the budget is used up
+		std::vector<uint32_t> evictionCandidates;
+		if (requests.size() > freeSlots.size()) {
+			for (uint32_t i = 0; i < static_cast<uint32_t>(pages.size()); i++) {
+				if ((pages[i].slot != UINT32_MAX) && (pages[i].lastRequested < frame)) {
+					evictionCandidates.push_back(i);
+				}
+			}
+			std::sort(evictionCandidates.begin(), evictionCandidates.end(), [this](uint32_t a, uint32_t b) {
+				return pages[a].lastRequested < pages[b].lastRequested;
+			});
+		}
+
+		std::vector<VkSparseImageMemoryBind> binds;
+		std::vector<VkBufferImageCopy> regions;
+		std::vector<uint8_t> data;
+		size_t nextCandidate = 0;
+		for (size_t i = 0; i < requests.size(); i++) {
+			if (freeSlots.empty()) {
+				if (nextCandidate == evictionCandidates.size()) {
+					statistics.budgetLimitedPages = static_cast<uint32_t>(requests.size() - i);
+					break;
+				}
+				Page &evicted = pages[evictionCandidates[nextCandidate++]];
+				VkSparseImageMemoryBind unbind{};
+				unbind.subresource = { VK_IMAGE_ASPECT_COLOR_BIT, evicted.mipLevel, 0 };
+				unbind.offset = evicted.offset;
+				unbind.extent = evicted.extent;
+				unbind.memory = VK_NULL_HANDLE;
+				binds.push_back(unbind);
+				freeSlots.push_back(evicted.slot);
+				evicted.slot = UINT32_MAX;
+				statistics.evictedPages++;
+			}
+			Page &page = pages[requests[i]];
+			page.slot = freeSlots.back();
+			freeSlots.pop_back();
+			VkSparseImageMemoryBind bind{};
+			bind.subresource = { VK_IMAGE_ASPECT_COLOR_BIT, page.mipLevel, 0 };
+			bind.offset = page.offset;
+			bind.extent = page.extent;
+			bind.memory = pageMemory;
+			bind.memoryOffset = page.slot * pageSize;
+			binds.push_back(bind);
+
+			VkBufferImageCopy region{};
+			region.bufferOffset = data.size();
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, page.mipLevel, 0, 1 };
+			region.imageOffset = page.offset;
+			region.imageExtent = page.extent;
+			data.resize(data.size() + page.extent.width * page.extent.height * texelSize);
+			pageLoader(page.mipLevel, page.offset, page.extent, &data[region.bufferOffset]);
+			regions.push_back(region);
+			statistics.uploadedPages++;
+		}
+
+		if (!binds.empty()) {
+			VkSparseImageMemoryBindInfo imageBindInfo{};
+			imageBindInfo.image = image;
+			imageBindInfo.bindCount = static_cast<uint32_t>(binds.size());
+			imageBindInfo.pBinds = binds.data();
+			VkBindSparseInfo bindSparseInfo = vks::initializers::bindSparseInfo();
+			bindSparseInfo.imageBindCount = 1;
+			bindSparseInfo.pImageBinds = &imageBindInfo;
+			VK_CHECK_RESULT(device->queueBindSparse(queue, 1, &bindSparseInfo, bindFence));
+			VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &bindFence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &bindFence));
+		}
+		upload(regions, data);
+
+		const VkDeviceSize mipTailBytes = statistics.residentBytes - statistics.residentPages * pageSize;
+		statistics.residentPages += statistics.uploadedPages - statistics.evictedPages;
+		statistics.residentBytes = mipTailBytes + statistics.residentPages * pageSize;
+	}
+
+	const StreamingTexture::Statistics &StreamingTexture::getStatistics() const
+	{
+		return statistics;
+	}
+}
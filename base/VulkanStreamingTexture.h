@@ -0,0 +1,105 @@
+/*
+* Streaming sparse texture
+*
+* Partially resident texture whose pages are bound and uploaded on demand from GPU feedback, within a fixed device memory budget
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <functional>
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Sparse residency texture streamed from GPU feedback
+	*
+	* The image is split into pages of the format's sparse block size. Shaders sampling the texture write the finest mip level they need for each
+	* page of the first level into the feedback buffer, update() reads these requests back, binds and uploads the missing pages (coarse levels first)
+	* and evicts the least recently requested pages once the memory budget is used up. The mip tail is always resident.
+	*
+	* Feedback contract for the shader (requires the fragmentStoresAndAtomics feature):
+	*	layout (binding = n) buffer Feedback { uint requestedLevel[]; };
+	*	uvec2 page = min(uvec2(clamp(uv, 0.0, 1.0) * vec2(pageCountX, pageCountY)), uvec2(pageCountX, pageCountY) - 1);
+	*	atomicMin(requestedLevel[page.y * pageCountX + page.x], uint(max(textureQueryLod(sampler, uv).x, 0.0)));
+	* Non-resident texels read as zero, so shaders should fall back to coarser levels with sparseTextureClampARB (GL_ARB_sparse_texture_clamp)
+	*
+	* @note The mip tail and all pages are device local memory, page memory is sub-allocated from a single allocation of the budget's size
+	* @note Only single layer 2D textures of uncompressed formats are supported
+	*/
+	class StreamingTexture
+	{
+	public:
+		/** @brief Writes the texels of a region of a mip level into data (tightly packed, extent.width * extent.height texels) */
+		typedef std::function<void(uint32_t mipLevel, VkOffset3D offset, VkExtent3D extent, void *data)> PageLoader;
+
+		struct Statistics {
+			uint32_t pageCount = 0;
+			uint32_t residentPages = 0;
+			uint32_t requestedPages = 0;
+			uint32_t uploadedPages = 0;
+			uint32_t evictedPages = 0;
+			/** @brief Requested pages that couldn't be made resident because the budget is used by pages requested in the same update */
+			uint32_t budgetLimitedPages = 0;
+			VkDeviceSize residentBytes = 0;
+		};
+
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		/** @brief The image stays in the general layout so uploads don't need to transition the whole image */
+		VkDescriptorImageInfo descriptor;
+		/** @brief Host visible storage buffer with one requested mip level per page of the first level (UINT32_MAX if none), see class description */
+		vks::Buffer feedbackBuffer;
+		uint32_t width, height, mipLevels;
+		VkFormat format;
+		/** @brief Size of a page in texels */
+		VkExtent3D pageExtent;
+		/** @brief Number of pages of the first mip level, the size of the feedback grid */
+		uint32_t pageCountX, pageCountY;
+		/** @brief First mip level of the mip tail */
+		uint32_t mipTailStart;
+		/** @brief Maximum number of pages uploaded per update, limits the time spent in update() */
+		uint32_t maxUploadsPerUpdate = 64;
+
+		StreamingTexture(vks::VulkanDevice *device, VkQueue queue, uint32_t width, uint32_t height, VkFormat format, uint32_t texelSize, VkDeviceSize memoryBudget, PageLoader pageLoader);
+		~StreamingTexture();
+		void update();
+		const Statistics &getStatistics() const;
+	private:
+		struct Page {
+			uint32_t mipLevel;
+			VkOffset3D offset;
+			VkExtent3D extent;
+			// Index of the page's slot in the page memory, UINT32_MAX if not resident
+			uint32_t slot = UINT32_MAX;
+			uint64_t lastRequested = 0;
+		};
+		vks::VulkanDevice *device;
+		VkQueue queue;
+		uint32_t texelSize;
+		PageLoader pageLoader;
+		std::vector<Page> pages;
+		// Index of the first page and page counts for each mip level outside of the mip tail
+		std::vector<uint32_t> levelFirstPage;
+		std::vector<uint32_t> levelPageCountX;
+		std::vector<uint32_t> levelPageCountY;
+		VkDeviceSize pageSize;
+		VkDeviceMemory pageMemory = VK_NULL_HANDLE;
+		std::vector<uint32_t> freeSlots;
+		VkDeviceMemory mipTailMemory = VK_NULL_HANDLE;
+		VkFence bindFence = VK_NULL_HANDLE;
+		uint64_t updateIndex = 0;
+		Statistics statistics;
+		uint32_t getPageIndex(uint32_t mipLevel, uint32_t x, uint32_t y) const;
+		void resetFeedback();
+		void upload(const std::vector<VkBufferImageCopy> &regions, const std::vector<uint8_t> &data);
+	};
+}
@@ -197,6 +197,62 @@ void VulkanSwapChain::initSurface(uint32_t width, uint32_t height)
 
 }
 
+/**
+* Render into a ring of images owned by the swap chain instead of presenting to a surface, so examples run without a window system or compositor
+*
+* @param queue Queue the frames are submitted to, acquiring and presenting images submit the semaphore signal and wait to it
+* @param queueFamilyIndex Family of the queue, used as queueNodeIndex
+*
+* @note Call after connect() instead of initSurface(), images don't have to wait for a display so acquiring never blocks
+*/
+void VulkanSwapChain::initOffscreen(VkQueue queue, uint32_t queueFamilyIndex)
+{
+	offscreen = true;
+	offscreenQueue = queue;
+	queueNodeIndex = queueFamilyIndex;
+	// The format most surfaces prefer, so examples render the same way they do on screen
+	colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
+	colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+	const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, colorFormat, &formatProperties);
+	if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures)
+	{
+		colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	}
+}
+
+/**
+* Create the swap chain for all physical devices of the logical device's device group, each device acquiring, rendering to and presenting its own instance of the images
+*
+* @note Call after connect() if VK_KHR_device_group has been enabled, acquire with the mask of the device rendering the frame and present with VkDeviceGroupPresentInfoKHR
+*/
+void VulkanSwapChain::initDeviceGroup()
+{
+	fpAcquireNextImage2KHR = reinterpret_cast<PFN_vkAcquireNextImage2KHR>(vkGetDeviceProcAddr(device, "vkAcquireNextImage2KHR"));
+	fpGetDeviceGroupPresentCapabilitiesKHR = reinterpret_cast<PFN_vkGetDeviceGroupPresentCapabilitiesKHR>(vkGetDeviceProcAddr(device, "vkGetDeviceGroupPresentCapabilitiesKHR"));
+	fpGetDeviceGroupSurfacePresentModesKHR = reinterpret_cast<PFN_vkGetDeviceGroupSurfacePresentModesKHR>(vkGetDeviceProcAddr(device, "vkGetDeviceGroupSurfacePresentModesKHR"));
+}
+
+/** @brief Get the devices that can present each device's images and the local and remote present modes supported by the surface */
+void VulkanSwapChain::queryDeviceGroupPresentCapabilities()
+{
+	deviceGroupPresentModes = 0;
+	deviceGroupPresentMasks.clear();
+	if (!fpGetDeviceGroupPresentCapabilitiesKHR || !fpGetDeviceGroupSurfacePresentModesKHR || !fpAcquireNextImage2KHR)
+	{
+		return;
+	}
+	VkDeviceGroupPresentCapabilitiesKHR capabilities{};
+	capabilities.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_PRESENT_CAPABILITIES_KHR;
+	VK_CHECK_RESULT(fpGetDeviceGroupPresentCapabilitiesKHR(device, &capabilities));
+	VkDeviceGroupPresentModeFlagsKHR surfaceModes = 0;
+	VK_CHECK_RESULT(fpGetDeviceGroupSurfacePresentModesKHR(device, surface, &surfaceModes));
+	// Sum and split instance presentation combine images of several devices, which alternate frame rendering doesn't need
+	deviceGroupPresentModes = capabilities.modes & surfaceModes & (VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR | VK_DEVICE_GROUP_PRESENT_MODE_REMOTE_BIT_KHR);
+	deviceGroupPresentMasks.assign(capabilities.presentMask, capabilities.presentMask + VK_MAX_DEVICE_GROUP_SIZE);
+}
+
 /**
 * Set instance, physical and logical device to use for the swapchain and get all required function pointers
 * 
@@ -228,9 +284,18 @@ void VulkanSwapChain::connect(VkInstance instance, VkPhysicalDevice physicalDevi
 * @param width Pointer to the width of the swapchain (may be adjusted to fit the requirements of the swapchain)
 * @param height Pointer to the height of the swapchain (may be adjusted to fit the requirements of the swapchain)
 * @param vsync (Optional) Can be used to force vsync-ed rendering (by using VK_PRESENT_MODE_FIFO_KHR as presentation mode)
+* @param retired (Optional) Receives the old swap chain and its image views instead of destroying them, release them with destroy() once no frame in flight uses them anymore
+*
+* @note requestedPresentMode and requestedImageCount take precedence over the vsync based selection if set
 */
-void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool fullscreen)
+void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool fullscreen, RetiredSwapChain* retired)
 {
+	if (offscreen)
+	{
+		createOffscreen(*width, *height, retired);
+		return;
+	}
+
 	// Store the current swap chain handle so we can use it later on to ease up recreation
 	VkSwapchainKHR oldSwapchain = swapChain;
 
@@ -270,9 +335,21 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 	// This mode waits for the vertical blank ("v-sync")
 	VkPresentModeKHR swapchainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
 
+	// An explicitly requested present mode is used if the surface supports it, otherwise we fall back to FIFO
+	if (requestedPresentMode != VK_PRESENT_MODE_MAX_ENUM_KHR)
+	{
+		if (std::find(presentModes.begin(), presentModes.end(), requestedPresentMode) != presentModes.end())
+		{
+			swapchainPresentMode = requestedPresentMode;
+		}
+		else
+		{
+			std::cerr << "Requested present mode " << vks::tools::presentModeString(requestedPresentMode) << " is not supported by the surface, falling back to " << vks::tools::presentModeString(swapchainPresentMode) << "\n";
+		}
+	}
 	// If v-sync is not requested, try to find a mailbox mode
 	// It's the lowest latency non-tearing present mode available
-	if (!vsync)
+	else if (!vsync)
 	{
 		for (size_t i = 0; i < presentModeCount; i++)
 		{
@@ -301,6 +378,10 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 		desiredNumberOfSwapchainImages = surfCaps.minImageCount;
 	}
 #endif
+	if (requestedImageCount > 0)
+	{
+		desiredNumberOfSwapchainImages = std::max(requestedImageCount, surfCaps.minImageCount);
+	}
 	if ((surfCaps.maxImageCount > 0) && (desiredNumberOfSwapchainImages > surfCaps.maxImageCount))
 	{
 		desiredNumberOfSwapchainImages = surfCaps.maxImageCount;
@@ -336,6 +417,15 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 
 	VkSwapchainCreateInfoKHR swapchainCI = {};
 	swapchainCI.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+	// Let the devices of a device group present their own images (local) or have them presented by another device (remote)
+	queryDeviceGroupPresentCapabilities();
+	VkDeviceGroupSwapchainCreateInfoKHR deviceGroupSwapchainCI{};
+	if (deviceGroupPresentModes != 0)
+	{
+		deviceGroupSwapchainCI.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_SWAPCHAIN_CREATE_INFO_KHR;
+		deviceGroupSwapchainCI.modes = deviceGroupPresentModes;
+		swapchainCI.pNext = &deviceGroupSwapchainCI;
+	}
 	swapchainCI.surface = surface;
 	swapchainCI.minImageCount = desiredNumberOfSwapchainImages;
 	swapchainCI.imageFormat = colorFormat;
@@ -347,6 +437,7 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 	swapchainCI.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	swapchainCI.queueFamilyIndexCount = 0;
 	swapchainCI.presentMode = swapchainPresentMode;
+	presentMode = swapchainPresentMode;
 	// Setting oldSwapChain to the saved handle of the previous swapchain aids in resource reuse and makes sure that we can still present already acquired images
 	swapchainCI.oldSwapchain = oldSwapchain;
 	// Setting clipped to VK_TRUE allows the implementation to discard rendering outside of the surface area
@@ -367,7 +458,17 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 
 	// If an existing swap chain is re-created, destroy the old swap chain
 	// This also cleans up all the presentable images
-	if (oldSwapchain != VK_NULL_HANDLE) 
+	if ((oldSwapchain != VK_NULL_HANDLE) && retired)
+	{
+		// The old swap chain stays valid for presenting images acquired before the recreation
+		retired->swapChain = oldSwapchain;
+		retired->views.clear();
+		for (uint32_t i = 0; i < imageCount; i++)
+		{
+			retired->views.push_back(buffers[i].view);
+		}
+	}
+	else if (oldSwapchain != VK_NULL_HANDLE)
 	{ 
 		for (uint32_t i = 0; i < imageCount; i++)
 		{
@@ -411,20 +512,135 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 	}
 }
 
+/**
+* Create the offscreen images at the given size, replacing (or retiring) the current ones
+*
+* @note Like swap chain images they are in an undefined layout until first rendered to, and support color attachment and transfer usage
+*/
+void VulkanSwapChain::createOffscreen(uint32_t width, uint32_t height, RetiredSwapChain* retired)
+{
+	if (retired)
+	{
+		retired->views.clear();
+		retired->images.clear();
+		retired->memory.clear();
+		for (uint32_t i = 0; i < static_cast<uint32_t>(buffers.size()); i++)
+		{
+			retired->views.push_back(buffers[i].view);
+			retired->images.push_back(images[i]);
+			retired->memory.push_back(offscreenMemory[i]);
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0; i < static_cast<uint32_t>(buffers.size()); i++)
+		{
+			vkDestroyImageView(device, buffers[i].view, nullptr);
+			vkDestroyImage(device, images[i], nullptr);
+			vkFreeMemory(device, offscreenMemory[i], nullptr);
+		}
+	}
+
+	// Nothing is waiting for a display, so the images are only needed for the frames in flight
+	imageCount = (requestedImageCount > 0) ? requestedImageCount : 3;
+	presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+	nextOffscreenImage = 0;
+	images.resize(imageCount);
+	buffers.resize(imageCount);
+	offscreenMemory.resize(imageCount);
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		VkImageCreateInfo imageCI = {};
+		imageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = colorFormat;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &images[i]));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, images[i], &memReqs);
+		uint32_t memoryTypeIndex = UINT32_MAX;
+		for (uint32_t j = 0; j < memoryProperties.memoryTypeCount; j++)
+		{
+			if ((memReqs.memoryTypeBits & (1 << j)) && (memoryProperties.memoryTypes[j].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+			{
+				memoryTypeIndex = j;
+				break;
+			}
+		}
+		if (memoryTypeIndex == UINT32_MAX)
+		{
+			vks::tools::exitFatal("Could not find a device local memory type for the offscreen images!", -1);
+		}
+		VkMemoryAllocateInfo memAlloc = {};
+		memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = memoryTypeIndex;
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreenMemory[i]));
+		VK_CHECK_RESULT(vkBindImageMemory(device, images[i], offscreenMemory[i], 0));
+
+		VkImageViewCreateInfo colorAttachmentView = {};
+		colorAttachmentView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		colorAttachmentView.format = colorFormat;
+		colorAttachmentView.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+		colorAttachmentView.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		colorAttachmentView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		colorAttachmentView.image = images[i];
+		buffers[i].image = images[i];
+		VK_CHECK_RESULT(vkCreateImageView(device, &colorAttachmentView, nullptr, &buffers[i].view));
+	}
+}
+
 /** 
 * Acquires the next image in the swap chain
 *
 * @param presentCompleteSemaphore (Optional) Semaphore that is signaled when the image is ready for use
 * @param imageIndex Pointer to the image index that will be increased if the next image could be acquired
+* @param deviceMask (Optional) Physical devices of the device group the image is acquired for, 0 acquires it for the first device (see initDeviceGroup())
 *
 * @note The function will always wait until the next image has been acquired by setting timeout to UINT64_MAX
 *
 * @return VkResult of the image acquisition
 */
-VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t *imageIndex)
+VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t *imageIndex, uint32_t deviceMask)
 {
+	if (offscreen)
+	{
+		// Images are handed out in order, the caller waits for the frame that last used one before rendering to it again
+		*imageIndex = nextOffscreenImage;
+		nextOffscreenImage = (nextOffscreenImage + 1) % imageCount;
+		if (presentCompleteSemaphore == VK_NULL_HANDLE)
+		{
+			return VK_SUCCESS;
+		}
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &presentCompleteSemaphore;
+		return vkQueueSubmit(offscreenQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
 	// By setting timeout to UINT64_MAX we will always wait until the next image has been acquired or an actual error is thrown
 	// With that we don't have to handle VK_NOT_READY
+	if ((deviceMask != 0) && (deviceGroupPresentModes != 0))
+	{
+		VkAcquireNextImageInfoKHR acquireInfo{};
+		acquireInfo.sType = VK_STRUCTURE_TYPE_ACQUIRE_NEXT_IMAGE_INFO_KHR;
+		acquireInfo.swapchain = swapChain;
+		acquireInfo.timeout = UINT64_MAX;
+		acquireInfo.semaphore = presentCompleteSemaphore;
+		acquireInfo.deviceMask = deviceMask;
+		return fpAcquireNextImage2KHR(device, &acquireInfo, imageIndex);
+	}
 	return fpAcquireNextImageKHR(device, swapChain, UINT64_MAX, presentCompleteSemaphore, (VkFence)nullptr, imageIndex);
 }
 
@@ -434,14 +650,30 @@ VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore,
 * @param queue Presentation queue for presenting the image
 * @param imageIndex Index of the swapchain image to queue for presentation
 * @param waitSemaphore (Optional) Semaphore that is waited on before the image is presented (only used if != VK_NULL_HANDLE)
+* @param pNext (Optional) Structures chained into the present info (e.g. VkPresentIdKHR)
 *
 * @return VkResult of the queue presentation
 */
-VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore)
+VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore, const void* pNext)
 {
+	if (offscreen)
+	{
+		// Nothing is presented, but the semaphore has to be waited on so it can be signaled again
+		if (waitSemaphore == VK_NULL_HANDLE)
+		{
+			return VK_SUCCESS;
+		}
+		const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &waitSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStageMask;
+		return vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.pNext = NULL;
+	presentInfo.pNext = pNext;
 	presentInfo.swapchainCount = 1;
 	presentInfo.pSwapchains = &swapChain;
 	presentInfo.pImageIndices = &imageIndex;
@@ -455,11 +687,49 @@ VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSem
 }
 
 
+/**
+* Destroy a swap chain retired by create()
+*
+* @param retired Old swap chain and image views, must not be used by any pending work
+*/
+void VulkanSwapChain::destroy(const RetiredSwapChain& retired)
+{
+	for (auto view : retired.views)
+	{
+		vkDestroyImageView(device, view, nullptr);
+	}
+	for (auto image : retired.images)
+	{
+		vkDestroyImage(device, image, nullptr);
+	}
+	for (auto memory : retired.memory)
+	{
+		vkFreeMemory(device, memory, nullptr);
+	}
+	if (retired.swapChain != VK_NULL_HANDLE)
+	{
+		fpDestroySwapchainKHR(device, retired.swapChain, nullptr);
+	}
+}
+
 /**
 * Destroy and free Vulkan resources used for the swapchain
 */
 void VulkanSwapChain::cleanup()
 {
+	if (offscreen)
+	{
+		for (uint32_t i = 0; i < static_cast<uint32_t>(buffers.size()); i++)
+		{
+			vkDestroyImageView(device, buffers[i].view, nullptr);
+			vkDestroyImage(device, images[i], nullptr);
+			vkFreeMemory(device, offscreenMemory[i], nullptr);
+		}
+		buffers.clear();
+		images.clear();
+		offscreenMemory.clear();
+		return;
+	}
 	if (swapChain != VK_NULL_HANDLE)
 	{
 		for (uint32_t i = 0; i < imageCount; i++)
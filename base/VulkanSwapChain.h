@@ -32,13 +32,22 @@ typedef struct _SwapChainBuffers {
 	VkImageView view;
 } SwapChainBuffer;
 
+// Swap chain replaced by create() that may still be in use by frames in flight
+struct RetiredSwapChain {
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+	std::vector<VkImageView> views;
+	// Images and their memory in offscreen mode, which owns them instead of a swap chain
+	std::vector<VkImage> images;
+	std::vector<VkDeviceMemory> memory;
+};
+
 class VulkanSwapChain
 {
 private: 
 	VkInstance instance;
 	VkDevice device;
 	VkPhysicalDevice physicalDevice;
-	VkSurfaceKHR surface;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
 	// Function pointers
 	PFN_vkGetPhysicalDeviceSurfaceSupportKHR fpGetPhysicalDeviceSurfaceSupportKHR;
 	PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR fpGetPhysicalDeviceSurfaceCapabilitiesKHR; 
@@ -49,6 +58,17 @@ private:
 	PFN_vkGetSwapchainImagesKHR fpGetSwapchainImagesKHR;
 	PFN_vkAcquireNextImageKHR fpAcquireNextImageKHR;
 	PFN_vkQueuePresentKHR fpQueuePresentKHR;
+	// Only loaded if VK_KHR_device_group has been enabled on the device, see initDeviceGroup()
+	PFN_vkAcquireNextImage2KHR fpAcquireNextImage2KHR = nullptr;
+	PFN_vkGetDeviceGroupPresentCapabilitiesKHR fpGetDeviceGroupPresentCapabilitiesKHR = nullptr;
+	PFN_vkGetDeviceGroupSurfacePresentModesKHR fpGetDeviceGroupSurfacePresentModesKHR = nullptr;
+	void queryDeviceGroupPresentCapabilities();
+	// Offscreen mode, a ring of images owned by the swap chain replaces the surface, acquire and present only signal and wait on the queue
+	bool offscreen = false;
+	VkQueue offscreenQueue = VK_NULL_HANDLE;
+	uint32_t nextOffscreenImage = 0;
+	std::vector<VkDeviceMemory> offscreenMemory;
+	void createOffscreen(uint32_t width, uint32_t height, RetiredSwapChain* retired);
 public:
 	VkFormat colorFormat;
 	VkColorSpaceKHR colorSpace;
@@ -57,6 +77,16 @@ public:
 	std::vector<VkImage> images;
 	std::vector<SwapChainBuffer> buffers;
 	uint32_t queueNodeIndex = UINT32_MAX;
+	// Present mode to use if supported by the surface, VK_PRESENT_MODE_MAX_ENUM_KHR selects it based on the vsync argument of create()
+	VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+	// Minimum number of swap chain images to request (clamped to the surface limits), 0 requests one more than the surface minimum
+	uint32_t requestedImageCount = 0;
+	// Present mode selected by the last call to create()
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	// Device group present modes the swap chain has been created with (local and/or remote), 0 without a device group
+	VkDeviceGroupPresentModeFlagsKHR deviceGroupPresentModes = 0;
+	// Physical devices each device of the group can present images from (bit mask per device index), empty without a device group
+	std::vector<uint32_t> deviceGroupPresentMasks;
 
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
 	void initSurface(void* platformHandle, void* platformWindow);
@@ -76,9 +106,14 @@ public:
 	void createDirect2DisplaySurface(uint32_t width, uint32_t height);
 #endif
 #endif
+	void initOffscreen(VkQueue queue, uint32_t queueFamilyIndex);
+	void initDeviceGroup();
+	/** @brief True if the images are rendered without a surface, see initOffscreen() */
+	bool isOffscreen() const { return offscreen; }
 	void connect(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device);
-	void create(uint32_t* width, uint32_t* height, bool vsync = false, bool fullscreen = false);
-	VkResult acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t* imageIndex);
-	VkResult queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore = VK_NULL_HANDLE);
+	void create(uint32_t* width, uint32_t* height, bool vsync = false, bool fullscreen = false, RetiredSwapChain* retired = nullptr);
+	void destroy(const RetiredSwapChain& retired);
+	VkResult acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t* imageIndex, uint32_t deviceMask = 0);
+	VkResult queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore = VK_NULL_HANDLE, const void* pNext = nullptr);
 	void cleanup();
 };
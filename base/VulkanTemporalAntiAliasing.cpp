@@ -0,0 +1,301 @@
+/*
+* Temporal anti-aliasing
+*
+* Resolves a scene rendered with a sub-pixel jitter that changes every frame (see Camera::setJitter) against the reprojected history
+* of the previous frames, which anti-aliases geometry and shading edges at the cost of one compute pass instead of multisampled targets
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTemporalAntiAliasing.h"
+#include "VulkanDevice.h"
+#include <cstring>
+
+namespace vks
+{
+	const VkFormat TemporalAntiAliasing::format;
+
+	// Work group size of the resolve shader in both dimensions
+	static const uint32_t taaGroupSize = 16;
+
+	/**
+	* @param device Device to create the compute pipeline on
+	* @param shaderFile SPIR-V file of the "base/taa.comp" shader
+	*
+	* @note If the image format can't be used as a storage image or the shader can't be loaded, no pipeline is created and isSupported() returns false
+	*/
+	TemporalAntiAliasing::TemporalAntiAliasing(vks::VulkanDevice *device, const std::string &shaderFile) : device(device)
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+		if ((formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) == 0)
+		{
+			return;
+		}
+
+#if defined(__ANDROID__)
+		shaderModule = vks::tools::loadShader(androidApp->activity->assetManager, shaderFile.c_str(), device->logicalDevice);
+#else
+		shaderModule = vks::tools::loadShader(shaderFile.c_str(), device->logicalDevice);
+#endif
+		if (shaderModule == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffer,
+			sizeof(UniformData)));
+		VK_CHECK_RESULT(uniformBuffer.map());
+
+		// The history is fetched between texels, and the output is sampled by the pass presenting it
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.maxLod = 1.0f;
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &sampler));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Settings
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Color of the current frame
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Velocity of the current frame
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3: Output of the previous frame
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			// Binding 4: Output
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCI.stage.pName = "main";
+		pipelineCI.stage.module = shaderModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline));
+
+		supported = true;
+	}
+
+	TemporalAntiAliasing::~TemporalAntiAliasing()
+	{
+		destroyImages();
+		if (pipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+		}
+		if (pipelineLayout)
+		{
+			vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		}
+		if (descriptorSetLayout)
+		{
+			vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		}
+		if (sampler)
+		{
+			vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		}
+		if (shaderModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, shaderModule, nullptr);
+		}
+		uniformBuffer.destroy();
+	}
+
+	void TemporalAntiAliasing::destroyImages()
+	{
+		if (descriptorPool)
+		{
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+			descriptorPool = VK_NULL_HANDLE;
+			descriptorSet = VK_NULL_HANDLE;
+		}
+		for (Image *image : { &output, &history })
+		{
+			if (image->image)
+			{
+				vkDestroyImageView(device->logicalDevice, image->view, nullptr);
+				vkDestroyImage(device->logicalDevice, image->image, nullptr);
+				device->freeMemory(image->memory, image->allocation);
+				*image = Image();
+			}
+		}
+		outputDescriptor = VkDescriptorImageInfo{};
+	}
+
+	/** @brief True if the image format is supported and the pipeline has been created */
+	bool TemporalAntiAliasing::isSupported() const
+	{
+		return supported;
+	}
+
+	/**
+	* Create the output and history images for a given size, replacing the previous ones (e.g. after a resize), the history starts empty
+	*
+	* @param width Width of the color input and the output
+	* @param height Height of the color input and the output
+	* @param colorDescriptor Color of the current frame, read with texel fetches
+	* @param velocityDescriptor Velocity (rg) of the current frame, may be larger than the color input (see update())
+	* @param queue Queue used to transition the new images to VK_IMAGE_LAYOUT_GENERAL
+	*
+	* @note The previous images must not be in use anymore, descriptors referring to the output have to be updated
+	*/
+	void TemporalAntiAliasing::create(uint32_t width, uint32_t height, const VkDescriptorImageInfo &colorDescriptor, const VkDescriptorImageInfo &velocityDescriptor, VkQueue queue)
+	{
+		if (!supported)
+		{
+			return;
+		}
+		destroyImages();
+		this->width = width;
+		this->height = height;
+		hasHistory = false;
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = format;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		for (Image *image : { &output, &history })
+		{
+			imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | ((image == &output) ? (VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT) : 0);
+			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &image->image));
+			VK_CHECK_RESULT(device->allocateImageMemory(image->image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &image->memory, &image->allocation));
+			viewCI.image = image->image;
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &image->view));
+		}
+		outputDescriptor = { sampler, output.view, VK_IMAGE_LAYOUT_GENERAL };
+
+		// Clear both images, so the output can be presented before the first resolve and no uninitialized values get into the history
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		const VkClearColorValue clearColor = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		for (Image *image : { &output, &history })
+		{
+			vks::tools::setImageLayout(commandBuffer, image->image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresourceRange);
+			vkCmdClearColorImage(commandBuffer, image->image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresourceRange);
+		}
+		device->flushCommandBuffer(commandBuffer, queue);
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+
+		VkDescriptorImageInfo inputDescriptors[2] = { colorDescriptor, velocityDescriptor };
+		VkDescriptorImageInfo historyDescriptor = { sampler, history.view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo storageDescriptor = { VK_NULL_HANDLE, output.view, VK_IMAGE_LAYOUT_GENERAL };
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &inputDescriptors[0]),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &inputDescriptors[1]),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &historyDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 4, &storageDescriptor),
+		};
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	/**
+	* Pass the state of the frame that's about to be submitted, call this once per frame
+	*
+	* @param velocityScale Part of the velocity image covering the color input in texture coordinates, e.g. if the scene is rendered to a region of a larger G-Buffer
+	* @param sceneChanged True if the history doesn't match the current frame anymore (e.g. after a camera cut or a change of settings), discards the history
+	*
+	* @note The uniform buffer is host coherent and updated in place, like the uniform buffers of the examples
+	*/
+	void TemporalAntiAliasing::update(const glm::vec2 &velocityScale, bool sceneChanged)
+	{
+		if (!supported)
+		{
+			return;
+		}
+		uniformData.velocityScale = velocityScale;
+		uniformData.feedbackMin = settings.feedbackMin;
+		uniformData.feedbackMax = settings.feedbackMax;
+		uniformData.reset = (!hasHistory || sceneChanged) ? 1 : 0;
+		memcpy(uniformBuffer.mapped, &uniformData, sizeof(UniformData));
+		hasHistory = true;
+	}
+
+	/**
+	* Record the resolve and the history update, outside of a render pass
+	*
+	* @note The output is visible to fragment shader reads afterwards
+	*/
+	void TemporalAntiAliasing::record(VkCommandBuffer commandBuffer)
+	{
+		if (!supported || (output.image == VK_NULL_HANDLE))
+		{
+			return;
+		}
+
+		// The history copy of the previous frame, and the previous frame's reads of the output are done before it's overwritten
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdDispatch(commandBuffer, (width + taaGroupSize - 1) / taaGroupSize, (height + taaGroupSize - 1) / taaGroupSize, 1);
+
+		// The output becomes the next frame's history
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		VkImageCopy copyRegion{};
+		copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.extent = { width, height, 1 };
+		vkCmdCopyImage(commandBuffer, output.image, VK_IMAGE_LAYOUT_GENERAL, history.image, VK_IMAGE_LAYOUT_GENERAL, 1, &copyRegion);
+
+		// Make the output visible to the pass presenting it
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	/** @brief Change the settings, they apply from the next update() on */
+	void TemporalAntiAliasing::setSettings(const Settings &settings)
+	{
+		this->settings = settings;
+	}
+
+	const TemporalAntiAliasing::Settings &TemporalAntiAliasing::getSettings() const
+	{
+		return settings;
+	}
+
+	/** @brief Combined image sampler descriptor of the rgba16f output with a linear sampler, in VK_IMAGE_LAYOUT_GENERAL */
+	const VkDescriptorImageInfo &TemporalAntiAliasing::getOutputDescriptor() const
+	{
+		return outputDescriptor;
+	}
+}
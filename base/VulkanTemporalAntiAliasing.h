@@ -0,0 +1,103 @@
+/*
+* Temporal anti-aliasing
+*
+* Resolves a scene rendered with a sub-pixel jitter that changes every frame (see Camera::setJitter) against the reprojected history
+* of the previous frames, which anti-aliases geometry and shading edges at the cost of one compute pass instead of multisampled targets
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+#include "VulkanMemoryAllocator.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Temporal anti-aliasing resolve using the "base/taa.comp" compute shader
+	*
+	* Usage:
+	*	vks::TemporalAntiAliasing taa(vulkanDevice, getShadersPath() + "base/taa.comp.spv");
+	*	taa.create(width, height, colorDescriptor, velocityDescriptor, queue);	// and again on resize
+	*	// Per frame, before submitting
+	*	camera.setJitter(Camera::jitterSequence(frame), renderWidth, renderHeight);
+	*	// Render the scene with camera.matrices.jitteredPerspective and write the motion since the previous frame to the velocity image
+	*	taa.update(velocityScale, sceneChanged);
+	*	// Per command buffer, after the pass writing the color input
+	*	taa.record(commandBuffer);
+	*	// Sample getOutputDescriptor() to present the anti-aliased image
+	*
+	* The velocity image stores the screen space motion of each pixel in texture coordinates (current minus previous position, computed
+	* from unjittered matrices). The output image is copied to the history after the resolve, so the next frame can read it while the
+	* output is being sampled. Passing sceneChanged to update() (or the first frame after create()) discards the history.
+	*
+	* @note The color and velocity inputs have to be in the layout of their descriptors and written before record() with a dependency on the compute shader stage
+	* @note Settings are read from the uniform buffer at execution time
+	*/
+	class TemporalAntiAliasing
+	{
+	public:
+		struct Settings {
+			// Share of the history kept where it differs strongly from the current frame
+			float feedbackMin = 0.88f;
+			// Share of the history kept where it matches the current frame, higher values converge smoother but react slower
+			float feedbackMax = 0.97f;
+		};
+
+	private:
+		struct UniformData {
+			glm::vec2 velocityScale;
+			float feedbackMin;
+			float feedbackMax;
+			uint32_t reset;
+		};
+		struct Image {
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			vks::MemoryAllocation allocation{};
+		};
+		vks::VulkanDevice *device;
+		bool supported = false;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		Settings settings;
+		UniformData uniformData{};
+		bool hasHistory = false;
+		// Written by the resolve, and its copy read by the next frame's resolve
+		Image output;
+		Image history;
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkDescriptorImageInfo outputDescriptor{};
+		vks::Buffer uniformBuffer;
+		VkShaderModule shaderModule = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		void destroyImages();
+	public:
+		static const VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+		TemporalAntiAliasing(vks::VulkanDevice *device, const std::string &shaderFile);
+		~TemporalAntiAliasing();
+		bool isSupported() const;
+		void create(uint32_t width, uint32_t height, const VkDescriptorImageInfo &colorDescriptor, const VkDescriptorImageInfo &velocityDescriptor, VkQueue queue);
+		void update(const glm::vec2 &velocityScale, bool sceneChanged);
+		void record(VkCommandBuffer commandBuffer);
+		void setSettings(const Settings &settings);
+		const Settings &getSettings() const;
+		const VkDescriptorImageInfo &getOutputDescriptor() const;
+	};
+}
@@ -0,0 +1,368 @@
+/*
+* Temporal accumulation and spatial denoising
+*
+* Accumulates the noisy output of a ray tracer over frames, reprojecting the history with the camera motion, and smooths what's left
+* with an edge stopping a-trous wavelet filter, so samples tracing a single stochastic ray per pixel converge to a usable image
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTemporalDenoiser.h"
+#include "VulkanDevice.h"
+#include <algorithm>
+#include <cstring>
+
+namespace vks
+{
+	const VkFormat TemporalDenoiser::format;
+
+	// Work group size of both shaders in both dimensions
+	static const uint32_t denoiserGroupSize = 8;
+	// Step sizes double with every iteration, five iterations cover a 61x61 pixel footprint
+	static const uint32_t maxFilterIterations = 5;
+
+	/**
+	* @param device Device to create the compute pipelines on
+	* @param accumulateShaderFile SPIR-V file of the "base/temporalaccumulate.comp" shader
+	* @param filterShaderFile SPIR-V file of the "base/atrousfilter.comp" shader
+	*
+	* @note If the image format can't be used as a storage image or a shader can't be loaded, no pipelines are created and isSupported() returns false
+	*/
+	TemporalDenoiser::TemporalDenoiser(vks::VulkanDevice *device, const std::string &accumulateShaderFile, const std::string &filterShaderFile) : device(device)
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+		if ((formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) == 0)
+		{
+			return;
+		}
+
+#if defined(__ANDROID__)
+		accumulateModule = vks::tools::loadShader(androidApp->activity->assetManager, accumulateShaderFile.c_str(), device->logicalDevice);
+		filterModule = vks::tools::loadShader(androidApp->activity->assetManager, filterShaderFile.c_str(), device->logicalDevice);
+#else
+		accumulateModule = vks::tools::loadShader(accumulateShaderFile.c_str(), device->logicalDevice);
+		filterModule = vks::tools::loadShader(filterShaderFile.c_str(), device->logicalDevice);
+#endif
+		if ((accumulateModule == VK_NULL_HANDLE) || (filterModule == VK_NULL_HANDLE))
+		{
+			return;
+		}
+
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffer,
+			sizeof(UniformData)));
+		VK_CHECK_RESULT(uniformBuffer.map());
+
+		// Both passes share one layout, each pass only uses some of the bindings
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Camera matrices and settings
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Input color (noisy color for the accumulation, the previous iteration's result for the filter)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Guide (normal and distance) of the current frame
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3: Output color
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			// Binding 4: Accumulated color of the previous frame
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			// Binding 5: Guide of the previous frame
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+			// Binding 6: Final (rgba8) output written by the last filter iteration
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 6),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCI.stage.pName = "main";
+		pipelineCI.stage.module = accumulateModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &accumulatePipeline));
+		pipelineCI.stage.module = filterModule;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &filterPipeline));
+
+		supported = true;
+	}
+
+	TemporalDenoiser::~TemporalDenoiser()
+	{
+		destroyImages();
+		if (accumulatePipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, accumulatePipeline, nullptr);
+		}
+		if (filterPipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, filterPipeline, nullptr);
+		}
+		if (pipelineLayout)
+		{
+			vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		}
+		if (descriptorSetLayout)
+		{
+			vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		}
+		if (accumulateModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, accumulateModule, nullptr);
+		}
+		if (filterModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, filterModule, nullptr);
+		}
+		uniformBuffer.destroy();
+	}
+
+	void TemporalDenoiser::destroyImages()
+	{
+		if (descriptorPool)
+		{
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+			descriptorPool = VK_NULL_HANDLE;
+		}
+		for (Image &image : images)
+		{
+			if (image.image)
+			{
+				vkDestroyImageView(device->logicalDevice, image.view, nullptr);
+				vkDestroyImage(device->logicalDevice, image.image, nullptr);
+				device->freeMemory(image.memory, image.allocation);
+				image = Image();
+			}
+		}
+		colorDescriptor = VkDescriptorImageInfo{};
+		guideDescriptor = VkDescriptorImageInfo{};
+	}
+
+	/** @brief True if the image format is supported and both pipelines have been created */
+	bool TemporalDenoiser::isSupported() const
+	{
+		return supported;
+	}
+
+	/**
+	* Create the images for a given size, replacing the previous ones (e.g. after a resize), the history starts empty
+	*
+	* @param width Width of the ray traced image
+	* @param height Height of the ray traced image
+	* @param outputView View of the rgba8 storage image the denoised result is written to, in VK_IMAGE_LAYOUT_GENERAL while record() runs
+	* @param queue Queue used to transition the new images to VK_IMAGE_LAYOUT_GENERAL
+	*
+	* @note The previous images must not be in use anymore, descriptors referring to the color and guide image have to be updated
+	*/
+	void TemporalDenoiser::create(uint32_t width, uint32_t height, VkImageView outputView, VkQueue queue)
+	{
+		if (!supported)
+		{
+			return;
+		}
+		destroyImages();
+		this->width = width;
+		this->height = height;
+		hasPrevFrame = false;
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = format;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		// The history is updated by copying the current frame's images
+		imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		for (Image &image : images)
+		{
+			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &image.image));
+			VK_CHECK_RESULT(device->allocateImageMemory(image.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &image.memory, &image.allocation));
+			viewCI.image = image.image;
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &image.view));
+		}
+		colorDescriptor = { VK_NULL_HANDLE, images[Color].view, VK_IMAGE_LAYOUT_GENERAL };
+		guideDescriptor = { VK_NULL_HANDLE, images[Guide].view, VK_IMAGE_LAYOUT_GENERAL };
+
+		// Clear all images, so no uninitialized values (which might be NaNs) get into the history
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		const VkClearColorValue clearColor = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		for (Image &image : images)
+		{
+			vks::tools::setImageLayout(commandBuffer, image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresourceRange);
+			vkCmdClearColorImage(commandBuffer, image.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresourceRange);
+		}
+		device->flushCommandBuffer(commandBuffer, queue);
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, setCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount * 6),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, setCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+		std::vector<VkDescriptorSetLayout> setLayouts(setCount, descriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, setLayouts.data(), setCount);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, descriptorSets));
+
+		// Input and output color of the accumulation pass and the three filter configurations
+		const uint32_t inputs[setCount] = { Color, Accumulated, Filter0, Filter1 };
+		const uint32_t outputs[setCount] = { Accumulated, Filter0, Filter1, Filter0 };
+		for (uint32_t i = 0; i < setCount; i++)
+		{
+			VkDescriptorImageInfo inputDescriptor = { VK_NULL_HANDLE, images[inputs[i]].view, VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorImageInfo outputDescriptor = { VK_NULL_HANDLE, images[outputs[i]].view, VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorImageInfo historyDescriptor = { VK_NULL_HANDLE, images[History].view, VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorImageInfo historyGuideDescriptor = { VK_NULL_HANDLE, images[HistoryGuide].view, VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorImageInfo finalOutputDescriptor = { VK_NULL_HANDLE, outputView, VK_IMAGE_LAYOUT_GENERAL };
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &inputDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &guideDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3, &outputDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 4, &historyDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 5, &historyGuideDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 6, &finalOutputDescriptor),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+	}
+
+	/**
+	* Pass the camera of the frame that's about to be submitted, call this once per frame
+	*
+	* @param view View matrix the ray tracer uses for this frame
+	* @param projection Projection matrix the ray tracer uses for this frame
+	* @param sceneChanged True if anything but the camera changed the image (e.g. a moving light), discards the history
+	*
+	* @note The uniform buffer is host coherent and updated in place, like the uniform buffers of the examples
+	*/
+	void TemporalDenoiser::update(const glm::mat4 &view, const glm::mat4 &projection, bool sceneChanged)
+	{
+		if (!supported)
+		{
+			return;
+		}
+		if (!hasPrevFrame)
+		{
+			prevView = view;
+			prevProjection = projection;
+		}
+		const bool cameraMoved = (view != prevView) || (projection != prevProjection);
+
+		uniformData.viewInverse = glm::inverse(view);
+		uniformData.projInverse = glm::inverse(projection);
+		uniformData.prevViewProjection = prevProjection * prevView;
+		uniformData.prevCameraPos = glm::inverse(prevView)[3];
+		uniformData.reset = (!hasPrevFrame || sceneChanged) ? 1 : 0;
+		uniformData.maxHistoryLength = std::max(cameraMoved ? std::min(settings.maxMotionHistoryLength, settings.maxHistoryLength) : settings.maxHistoryLength, 1u);
+		uniformData.phiNormal = settings.phiNormal;
+		uniformData.phiDepth = settings.phiDepth;
+		uniformData.phiColor = settings.phiColor;
+		memcpy(uniformBuffer.mapped, &uniformData, sizeof(UniformData));
+
+		prevView = view;
+		prevProjection = projection;
+		hasPrevFrame = true;
+	}
+
+	/**
+	* Record the accumulation and filter passes and the history update, outside of a render pass
+	*
+	* @note The ray tracing writes to the color and guide image are made visible by this, the output is visible to transfer, compute and fragment shader reads afterwards
+	*/
+	void TemporalDenoiser::record(VkCommandBuffer commandBuffer)
+	{
+		if (!supported || (images[Color].image == VK_NULL_HANDLE))
+		{
+			return;
+		}
+
+		// Ray tracing results of this frame and the history copies of the previous one
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		const uint32_t groupCountX = (width + denoiserGroupSize - 1) / denoiserGroupSize;
+		const uint32_t groupCountY = (height + denoiserGroupSize - 1) / denoiserGroupSize;
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, accumulatePipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[0], 0, nullptr);
+		vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		// Without filtering a single pass with a step size of zero copies the accumulated image to the output
+		const uint32_t iterations = std::min(settings.filterIterations, maxFilterIterations);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, filterPipeline);
+		for (uint32_t i = 0; i < std::max(iterations, 1u); i++)
+		{
+			// Reads the accumulated image first, then alternates between the two intermediate images
+			const uint32_t set = (i == 0) ? 1 : ((i % 2 == 1) ? 2 : 3);
+			PushConstants pushConstants{};
+			pushConstants.stepSize = (iterations == 0) ? 0 : (1 << i);
+			pushConstants.finalPass = (i + 1 >= iterations) ? 1 : 0;
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[set], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+			if (!pushConstants.finalPass)
+			{
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+		}
+
+		// The accumulated image and the guide become the next frame's history
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		VkImageCopy copyRegion{};
+		copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.extent = { width, height, 1 };
+		vkCmdCopyImage(commandBuffer, images[Accumulated].image, VK_IMAGE_LAYOUT_GENERAL, images[History].image, VK_IMAGE_LAYOUT_GENERAL, 1, &copyRegion);
+		vkCmdCopyImage(commandBuffer, images[Guide].image, VK_IMAGE_LAYOUT_GENERAL, images[HistoryGuide].image, VK_IMAGE_LAYOUT_GENERAL, 1, &copyRegion);
+
+		// Make the output visible to its consumers and keep the next frame's ray tracing from overwriting images that are still being read
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	/** @brief Change the settings, a changed number of filter iterations only applies to command buffers recorded afterwards */
+	void TemporalDenoiser::setSettings(const Settings &settings)
+	{
+		this->settings = settings;
+	}
+
+	const TemporalDenoiser::Settings &TemporalDenoiser::getSettings() const
+	{
+		return settings;
+	}
+
+	/** @brief Descriptor of the rgba16f storage image the ray tracer writes its noisy color to */
+	const VkDescriptorImageInfo &TemporalDenoiser::getColorDescriptor() const
+	{
+		return colorDescriptor;
+	}
+
+	/** @brief Descriptor of the rgba16f storage image the ray tracer writes the world space normal (xyz) and hit distance (w, negative for misses) to */
+	const VkDescriptorImageInfo &TemporalDenoiser::getGuideDescriptor() const
+	{
+		return guideDescriptor;
+	}
+}
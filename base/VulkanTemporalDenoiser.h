@@ -0,0 +1,146 @@
+/*
+* Temporal accumulation and spatial denoising
+*
+* Accumulates the noisy output of a ray tracer over frames, reprojecting the history with the camera motion, and smooths what's left
+* with an edge stopping a-trous wavelet filter, so samples tracing a single stochastic ray per pixel converge to a usable image
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+#include "VulkanMemoryAllocator.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Denoiser for ray traced images using the "base/temporalaccumulate.comp" and "base/atrousfilter.comp" compute shaders
+	*
+	* Usage:
+	*	vks::TemporalDenoiser denoiser(vulkanDevice, getShadersPath() + "base/temporalaccumulate.comp.spv", getShadersPath() + "base/atrousfilter.comp.spv");
+	*	denoiser.create(width, height, storageImage.view, queue);	// and again on resize
+	*	// The ray generation shader writes its radiance to getColorDescriptor() and the hit's normal and distance to getGuideDescriptor()
+	*	// Per frame, before submitting
+	*	denoiser.update(camera.matrices.view, camera.matrices.perspective, sceneChanged);
+	*	// Per command buffer, after vkCmdTraceRaysKHR
+	*	denoiser.record(commandBuffer);
+	*	// The output image now holds the denoised result
+	*
+	* The guide image stores the world space normal of the primary hit in xyz and the distance along the camera ray in w, negative for rays
+	* that didn't hit anything. The accumulation pass reconstructs each pixel's world position from it, projects it with the previous
+	* frame's camera and blends in the bilinearly filtered history of the taps whose normal and distance match. Pixels without matching
+	* history restart their accumulation. The number of accumulated samples is kept in the alpha channel and capped lower while the camera
+	* moves, so view dependent effects such as reflections don't lag behind. Anything else that changes the image (lights, settings, a
+	* resize) has to pass sceneChanged to update(), which discards the history.
+	* The filter then runs up to five 5x5 a-trous iterations with doubling step sizes, weighting taps by normal, distance and luminance
+	* similarity. The luminance tolerance shrinks with the number of accumulated samples, so converged pixels are left almost untouched.
+	*
+	* @note All images stay in VK_IMAGE_LAYOUT_GENERAL, the output image has to be in that layout when record() is called
+	* @note The output image needs to be an rgba8 storage image, e.g. the storage image of vks::VulkanRaytracingSample
+	* @note Settings are read from the denoiser's uniform buffer at execution time, except for the filter iterations, which are recorded
+	*/
+	class TemporalDenoiser
+	{
+	public:
+		struct Settings {
+			// Maximum number of accumulated samples while the camera doesn't move, 1 disables accumulation
+			uint32_t maxHistoryLength = 256;
+			// Maximum number of accumulated samples while the camera moves
+			uint32_t maxMotionHistoryLength = 16;
+			// A-trous iterations, 0 disables the spatial filter
+			uint32_t filterIterations = 4;
+			// Exponent of the normal weight
+			float phiNormal = 64.0f;
+			// Relative distance difference at which the depth weight drops to 1/e
+			float phiDepth = 0.05f;
+			// Luminance difference at which the color weight of a single sample drops to 1/e
+			float phiColor = 4.0f;
+		};
+
+	private:
+		struct UniformData {
+			glm::mat4 viewInverse;
+			glm::mat4 projInverse;
+			glm::mat4 prevViewProjection;
+			glm::vec4 prevCameraPos;
+			uint32_t reset;
+			uint32_t maxHistoryLength;
+			float phiNormal;
+			float phiDepth;
+			float phiColor;
+		};
+		struct PushConstants {
+			// Distance between the filter taps in pixels, 0 for copying the input to the output without filtering
+			int32_t stepSize;
+			// Writing the result to the output image instead of the next intermediate image
+			uint32_t finalPass;
+		};
+		struct Image {
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			vks::MemoryAllocation allocation{};
+		};
+		enum ImageIndex : uint32_t {
+			// Written by the ray tracer
+			Color = 0,
+			Guide = 1,
+			// Output of the accumulation pass, input of the filter
+			Accumulated = 2,
+			// Copies of the accumulated and guide image of the previous frame
+			History = 3,
+			HistoryGuide = 4,
+			// Ping pong images of the filter iterations
+			Filter0 = 5,
+			Filter1 = 6,
+		};
+		static const uint32_t imageCount = 7;
+		// Accumulation and three filter configurations: accumulated -> filter 0, filter 0 -> filter 1, filter 1 -> filter 0
+		static const uint32_t setCount = 4;
+		vks::VulkanDevice *device;
+		bool supported = false;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		Settings settings;
+		UniformData uniformData{};
+		bool hasPrevFrame = false;
+		glm::mat4 prevView = glm::mat4(1.0f);
+		glm::mat4 prevProjection = glm::mat4(1.0f);
+		Image images[imageCount];
+		VkDescriptorImageInfo colorDescriptor{};
+		VkDescriptorImageInfo guideDescriptor{};
+		vks::Buffer uniformBuffer;
+		VkShaderModule accumulateModule = VK_NULL_HANDLE;
+		VkShaderModule filterModule = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSets[setCount]{};
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline accumulatePipeline = VK_NULL_HANDLE;
+		VkPipeline filterPipeline = VK_NULL_HANDLE;
+		void destroyImages();
+	public:
+		static const VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+		TemporalDenoiser(vks::VulkanDevice *device, const std::string &accumulateShaderFile, const std::string &filterShaderFile);
+		~TemporalDenoiser();
+		bool isSupported() const;
+		void create(uint32_t width, uint32_t height, VkImageView outputView, VkQueue queue);
+		void update(const glm::mat4 &view, const glm::mat4 &projection, bool sceneChanged);
+		void record(VkCommandBuffer commandBuffer);
+		void setSettings(const Settings &settings);
+		const Settings &getSettings() const;
+		const VkDescriptorImageInfo &getColorDescriptor() const;
+		const VkDescriptorImageInfo &getGuideDescriptor() const;
+	};
+}
@@ -0,0 +1,649 @@
+/*
+* Streaming terrain clipmap
+*
+* Pages height and normal tiles of a terrain from a tiled file into a clipmap texture array with one layer per detail level centered
+* on the camera, so terrains much larger than the available device memory render with a fixed memory footprint and upload cost per frame
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTerrainClipmap.h"
+#include "VulkanDevice.h"
+#include "VulkanStagingRing.h"
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <ktx.h>
+
+namespace vks
+{
+	const uint32_t TerrainClipmap::maxLevels;
+	const uint32_t TerrainClipmap::tileSize;
+	const uint32_t TerrainClipmap::tilesPerSide;
+	const uint32_t TerrainClipmap::clipSize;
+	const int32_t TerrainClipmap::borderExtension;
+	const VkFormat TerrainClipmap::heightFormat;
+	const VkFormat TerrainClipmap::normalFormat;
+	const size_t TerrainClipmap::tileHeightBytes;
+	const size_t TerrainClipmap::tileNormalBytes;
+	const size_t TerrainClipmap::tileBytes;
+
+	namespace
+	{
+		const uint32_t tileFileMagic = 0x54544b56; // "VKTT"
+		const uint32_t tileFileVersion = 1;
+		// Tiles start at a page boundary of the mapped file
+		const size_t tileDataOffset = 4096;
+
+		struct TileFileHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint32_t tileSize;
+			uint32_t width;
+			uint32_t levelCount;
+			float texelSize;
+			float heightScale;
+			uint32_t reserved;
+			uint64_t sourceHash;
+		};
+
+		// 64 bit FNV-1a hash of a file's contents, 0 if the file can't be read
+		uint64_t hashFile(const std::string &filename)
+		{
+			vks::MappedFile file;
+			if (!file.open(filename)) {
+				return 0;
+			}
+			uint64_t hash = 14695981039346656037ULL;
+			for (size_t i = 0; i < file.size; i++) {
+				hash ^= static_cast<uint8_t>(file.data[i]);
+				hash *= 1099511628211ULL;
+			}
+			return hash;
+		}
+
+		bool isEmpty(const glm::ivec4 &rect)
+		{
+			return (rect.x > rect.z) || (rect.y > rect.w);
+		}
+
+		/** @brief Callback for ktxTexture_IterateLoadLevelFaces that copies the first mip level of an r16 texture */
+		KTX_error_code copyHeightData(int miplevel, int face, int width, int height, int depth, ktx_uint32_t faceLodSize, void *pixels, void *userdata)
+		{
+			if (miplevel == 0) {
+				std::vector<uint16_t> *heights = static_cast<std::vector<uint16_t>*>(userdata);
+				if (faceLodSize < heights->size() * sizeof(uint16_t)) {
+					return KTX_FILE_DATA_ERROR;
+				}
+				memcpy(heights->data(), pixels, heights->size() * sizeof(uint16_t));
+			}
+			return KTX_SUCCESS;
+		}
+	}
+
+	/**
+	* Open (or create) the tiled file of a height map, create the clipmap images and load the coarsest level
+	*
+	* @param device Device to create the images on
+	* @param queue Queue used to initialize the images
+	* @param heightMapFile Square r16 ktx height map the tiles are created from
+	* @param texelSize World space distance between two height samples of the first level
+	* @param heightScale World space height of the full r16 range, used for the normals
+	* @param framesInFlight Number of frames the application may record ahead of the GPU
+	*/
+	TerrainClipmap::TerrainClipmap(vks::VulkanDevice *device, VkQueue queue, const std::string &heightMapFile, float texelSize, float heightScale, uint32_t framesInFlight)
+		: device(device), texelSize(texelSize), heightScale(heightScale), reuseDelay(framesInFlight + 2), frame(framesInFlight + 2)
+	{
+		const uint64_t sourceHash = hashFile(heightMapFile);
+		const std::string tileFilename = heightMapFile + ".tiles";
+		bool loaded = false;
+#if !defined(__ANDROID__)
+		loaded = loadTileFile(tileFilename, sourceHash);
+#endif
+		if (!loaded) {
+			if (!convertHeightMap(heightMapFile, sourceHash)) {
+				vks::tools::exitFatal("Could not create terrain tiles from " + heightMapFile, -1);
+			}
+#if !defined(__ANDROID__)
+			// Tiles are read from the mapped file from now on, the ones in memory are only kept if the file can't be written
+			std::ofstream file(tileFilename, std::ios::binary | std::ios::trunc);
+			if (file.is_open()) {
+				file.write(tileMemory.data(), tileMemory.size());
+			}
+			if (!file.good()) {
+				std::cerr << "Could not write terrain tile file \"" << tileFilename << "\"\n";
+			}
+			file.close();
+			if (file.good() && loadTileFile(tileFilename, sourceHash)) {
+				std::vector<char>().swap(tileMemory);
+			}
+#endif
+		}
+
+		for (Level &level : levels) {
+			level.slots.reset(new Slot[tilesPerSide * tilesPerSide]);
+			for (uint32_t i = 0; i < tilesPerSide * tilesPerSide; i++) {
+				level.slots[i].data.resize(tileBytes);
+			}
+		}
+		for (uint32_t i = 0; i < maxLevels; i++) {
+			levelRegions[i] = glm::ivec4(0, 0, -1, -1);
+		}
+
+		createImage(heightImage, heightFormat);
+		createImage(normalImage, normalFormat);
+		VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, static_cast<uint32_t>(levels.size()) };
+		const VkClearColorValue clearColor = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		for (Image *image : { &heightImage, &normalImage }) {
+			vks::tools::setImageLayout(commandBuffer, image->image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresourceRange);
+			vkCmdClearColorImage(commandBuffer, image->image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresourceRange);
+		}
+		device->flushCommandBuffer(commandBuffer, queue);
+
+		// Tiles wrap around, the layer index is clamped
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.maxLod = 0.0f;
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &sampler));
+		heightDescriptor = { sampler, heightImage.view, VK_IMAGE_LAYOUT_GENERAL };
+		normalDescriptor = { sampler, normalImage.view, VK_IMAGE_LAYOUT_GENERAL };
+
+		// The coarsest level covers the whole terrain and is the fallback for everything that hasn't been streamed in yet
+		const uint32_t coarsest = static_cast<uint32_t>(levels.size()) - 1;
+		Level &level = levels[coarsest];
+		for (uint32_t y = 0; y < level.tileCount; y++) {
+			for (uint32_t x = 0; x < level.tileCount; x++) {
+				const glm::ivec2 tile(x, y);
+				Slot &slot = getSlot(coarsest, tile);
+				slot.tile = tile;
+				memcpy(slot.data.data(), tileData + getTileOffset(coarsest, tile), tileBytes);
+				uploadTile(coarsest, slot);
+			}
+		}
+		vks::StagingRing *stagingRing = device->getStagingRing();
+		stagingRing->wait(stagingRing->getPendingToken());
+		for (uint32_t i = 0; i < tilesPerSide * tilesPerSide; i++) {
+			if (level.slots[i].state == Uploading) {
+				level.slots[i].state = Resident;
+			}
+		}
+		updateRegion(coarsest, glm::ivec2(0));
+
+		// Streaming runs in the background, it doesn't need to take performance cores from the threads recording the frame
+		threadPool.setThreadCount(2, CoreClass::Efficiency);
+	}
+
+	TerrainClipmap::~TerrainClipmap()
+	{
+		// Jobs write into the slots, and uploads still waiting in the staging ring refer to the images
+		threadPool.wait();
+		device->getStagingRing()->flush();
+		for (Image *image : { &heightImage, &normalImage }) {
+			if (image->image) {
+				vkDestroyImageView(device->logicalDevice, image->view, nullptr);
+				vkDestroyImage(device->logicalDevice, image->image, nullptr);
+				device->freeMemory(image->memory, image->allocation);
+			}
+		}
+		if (sampler) {
+			vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		}
+	}
+
+	/** @brief Map the tiles of a file written by an earlier run, returns false if it doesn't exist or doesn't match the height map and parameters */
+	bool TerrainClipmap::loadTileFile(const std::string &filename, uint64_t sourceHash)
+	{
+		if (!tileFile.open(filename)) {
+			return false;
+		}
+		if (!setTileData(tileFile.data, tileFile.size, sourceHash)) {
+			tileFile.close();
+			return false;
+		}
+		return true;
+	}
+
+	/** @brief Set up the levels from the header of the tiled file contents, returns false if they don't match the height map and parameters */
+	bool TerrainClipmap::setTileData(const char *data, size_t size, uint64_t sourceHash)
+	{
+		if (size < tileDataOffset) {
+			return false;
+		}
+		TileFileHeader header;
+		memcpy(&header, data, sizeof(header));
+		if ((header.magic != tileFileMagic) || (header.version != tileFileVersion) || (header.tileSize != tileSize) || (header.texelSize != texelSize)
+			|| (header.heightScale != heightScale) || (header.sourceHash != sourceHash) || (header.levelCount == 0) || (header.levelCount > maxLevels)) {
+			return false;
+		}
+
+		levels.clear();
+		levels.resize(header.levelCount);
+		size_t tileCount = 0;
+		for (uint32_t i = 0; i < header.levelCount; i++) {
+			Level &level = levels[i];
+			level.width = (i == 0) ? header.width : (levels[i - 1].width + 1) / 2;
+			level.tileCount = (level.width + tileSize - 1) / tileSize;
+			level.firstTile = tileCount;
+			tileCount += level.tileCount * level.tileCount;
+		}
+		if ((levels.back().tileCount > tilesPerSide) || (size < tileDataOffset + tileCount * tileBytes)) {
+			levels.clear();
+			return false;
+		}
+		width = header.width;
+		tileData = data;
+		return true;
+	}
+
+	/**
+	* Build the tiled file contents in memory from the first mip level of the height map
+	*
+	* Each level is a 2x2 box filtered copy of the previous one, normals are derived per level from central differences of its heights
+	*/
+	bool TerrainClipmap::convertHeightMap(const std::string &heightMapFile, uint64_t sourceHash)
+	{
+		vks::MappedFile file;
+		if (!file.open(heightMapFile)) {
+			return false;
+		}
+		ktxTexture *ktxTexture;
+		if (ktxTexture_CreateFromMemory(reinterpret_cast<const ktx_uint8_t*>(file.data), file.size, KTX_TEXTURE_CREATE_NO_FLAGS, &ktxTexture) != KTX_SUCCESS) {
+			return false;
+		}
+		const uint32_t dim = ktxTexture->baseWidth;
+		std::vector<uint16_t> heights(dim * dim);
+		const bool valid = (ktxTexture->baseHeight == dim) && (ktxTexture_GetImageSize(ktxTexture, 0) == heights.size() * sizeof(uint16_t))
+			&& (ktxTexture_IterateLoadLevelFaces(ktxTexture, copyHeightData, &heights) == KTX_SUCCESS);
+		ktxTexture_Destroy(ktxTexture);
+		if (!valid) {
+			return false;
+		}
+
+		// Add levels until the coarsest one fits into a single clipmap layer
+		uint32_t levelCount = 1;
+		size_t tileCount = 0;
+		for (uint32_t levelWidth = dim; ; levelWidth = (levelWidth + 1) / 2, levelCount++) {
+			const uint32_t levelTiles = (levelWidth + tileSize - 1) / tileSize;
+			tileCount += levelTiles * levelTiles;
+			if (levelTiles <= tilesPerSide) {
+				break;
+			}
+		}
+		if (levelCount > maxLevels) {
+			std::cerr << "Height map \"" << heightMapFile << "\" needs more than " << maxLevels << " clipmap levels\n";
+			return false;
+		}
+
+		tileMemory.assign(tileDataOffset + tileCount * tileBytes, 0);
+		TileFileHeader header{};
+		header.magic = tileFileMagic;
+		header.version = tileFileVersion;
+		header.tileSize = tileSize;
+		header.width = dim;
+		header.levelCount = levelCount;
+		header.texelSize = texelSize;
+		header.heightScale = heightScale;
+		header.sourceHash = sourceHash;
+		memcpy(tileMemory.data(), &header, sizeof(header));
+
+		char *tile = tileMemory.data() + tileDataOffset;
+		uint32_t levelWidth = dim;
+		std::vector<int8_t> normals;
+		for (uint32_t level = 0; level < levelCount; level++) {
+			auto height = [&](int32_t x, int32_t y) {
+				x = std::max(0, std::min(x, static_cast<int32_t>(levelWidth) - 1));
+				y = std::max(0, std::min(y, static_cast<int32_t>(levelWidth) - 1));
+				return heights[y * levelWidth + x];
+			};
+			const float spacing = texelSize * static_cast<float>(1 << level);
+			const float gradientScale = heightScale / (65535.0f * 2.0f * spacing);
+			normals.resize(levelWidth * levelWidth * 2);
+			for (int32_t y = 0; y < static_cast<int32_t>(levelWidth); y++) {
+				for (int32_t x = 0; x < static_cast<int32_t>(levelWidth); x++) {
+					const float dx = (static_cast<float>(height(x + 1, y)) - static_cast<float>(height(x - 1, y))) * gradientScale;
+					const float dz = (static_cast<float>(height(x, y + 1)) - static_cast<float>(height(x, y - 1))) * gradientScale;
+					const glm::vec3 normal = glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+					normals[(y * levelWidth + x) * 2] = static_cast<int8_t>(std::round(normal.x * 127.0f));
+					normals[(y * levelWidth + x) * 2 + 1] = static_cast<int8_t>(std::round(normal.z * 127.0f));
+				}
+			}
+
+			// Tiles crossing the border of the level repeat its edge texels
+			const uint32_t levelTiles = (levelWidth + tileSize - 1) / tileSize;
+			for (uint32_t ty = 0; ty < levelTiles; ty++) {
+				for (uint32_t tx = 0; tx < levelTiles; tx++) {
+					uint16_t *tileHeights = reinterpret_cast<uint16_t*>(tile);
+					int8_t *tileNormals = reinterpret_cast<int8_t*>(tile + tileHeightBytes);
+					for (uint32_t y = 0; y < tileSize; y++) {
+						const uint32_t sy = std::min(ty * tileSize + y, levelWidth - 1);
+						for (uint32_t x = 0; x < tileSize; x++) {
+							const uint32_t sx = std::min(tx * tileSize + x, levelWidth - 1);
+							tileHeights[y * tileSize + x] = heights[sy * levelWidth + sx];
+							tileNormals[(y * tileSize + x) * 2] = normals[(sy * levelWidth + sx) * 2];
+							tileNormals[(y * tileSize + x) * 2 + 1] = normals[(sy * levelWidth + sx) * 2 + 1];
+						}
+					}
+					tile += tileBytes;
+				}
+			}
+
+			if (level + 1 < levelCount) {
+				const uint32_t nextWidth = (levelWidth + 1) / 2;
+				std::vector<uint16_t> nextHeights(nextWidth * nextWidth);
+				for (int32_t y = 0; y < static_cast<int32_t>(nextWidth); y++) {
+					for (int32_t x = 0; x < static_cast<int32_t>(nextWidth); x++) {
+						const uint32_t sum = height(x * 2, y * 2) + height(x * 2 + 1, y * 2) + height(x * 2, y * 2 + 1) + height(x * 2 + 1, y * 2 + 1);
+						nextHeights[y * nextWidth + x] = static_cast<uint16_t>((sum + 2) / 4);
+					}
+				}
+				heights.swap(nextHeights);
+				levelWidth = nextWidth;
+			}
+		}
+
+		return setTileData(tileMemory.data(), tileMemory.size(), sourceHash);
+	}
+
+	void TerrainClipmap::createImage(Image &image, VkFormat format)
+	{
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = format;
+		imageCI.extent = { clipSize, clipSize, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = static_cast<uint32_t>(levels.size());
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &image.image));
+		VK_CHECK_RESULT(device->allocateImageMemory(image.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &image.memory, &image.allocation));
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewCI.format = format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, imageCI.arrayLayers };
+		viewCI.image = image.image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &image.view));
+	}
+
+	size_t TerrainClipmap::getTileOffset(uint32_t level, glm::ivec2 tile) const
+	{
+		return tileDataOffset + (levels[level].firstTile + tile.y * levels[level].tileCount + tile.x) * tileBytes;
+	}
+
+	/** @brief Slot a tile is stored in, the window wraps around in both directions */
+	TerrainClipmap::Slot &TerrainClipmap::getSlot(uint32_t level, glm::ivec2 tile) const
+	{
+		return levels[level].slots[(tile.y % tilesPerSide) * tilesPerSide + (tile.x % tilesPerSide)];
+	}
+
+	/** @brief Tile of the current window that belongs into a slot, -1 if the window reaches past the level */
+	glm::ivec2 TerrainClipmap::getDesiredTile(uint32_t level, uint32_t slotX, uint32_t slotY) const
+	{
+		const Level &l = levels[level];
+		const int32_t n = static_cast<int32_t>(tilesPerSide);
+		const glm::ivec2 tile(
+			l.origin.x + ((static_cast<int32_t>(slotX) - l.origin.x) % n + n) % n,
+			l.origin.y + ((static_cast<int32_t>(slotY) - l.origin.y) % n + n) % n);
+		if ((tile.x >= static_cast<int32_t>(l.tileCount)) || (tile.y >= static_cast<int32_t>(l.tileCount))) {
+			return glm::ivec2(-1);
+		}
+		return tile;
+	}
+
+	/** @brief True if all tiles of an inclusive tile rectangle have been uploaded */
+	bool TerrainClipmap::isResident(uint32_t level, const glm::ivec4 &rect) const
+	{
+		for (int32_t y = rect.y; y <= rect.w; y++) {
+			for (int32_t x = rect.x; x <= rect.z; x++) {
+				const Slot &slot = getSlot(level, glm::ivec2(x, y));
+				if ((slot.tile != glm::ivec2(x, y)) || (slot.state.load(std::memory_order_acquire) != Resident)) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	/** @brief Stage a loaded tile and record its copies into the slot's texels of the level's layers */
+	void TerrainClipmap::uploadTile(uint32_t level, Slot &slot)
+	{
+		vks::StagingRing *stagingRing = device->getStagingRing();
+		VkBufferImageCopy copyRegion{};
+		copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, level, 1 };
+		copyRegion.imageOffset = { static_cast<int32_t>((slot.tile.x % tilesPerSide) * tileSize), static_cast<int32_t>((slot.tile.y % tilesPerSide) * tileSize), 0 };
+		copyRegion.imageExtent = { tileSize, tileSize, 1 };
+		const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, level, 1 };
+		// Released per image, as staging the normals may submit the batch holding the height copy
+		vks::StagingRing::Region region = stagingRing->stage(slot.data.data(), tileHeightBytes, 4);
+		copyRegion.bufferOffset = region.offset;
+		vkCmdCopyBufferToImage(stagingRing->getCommandBuffer(), region.buffer, heightImage.image, VK_IMAGE_LAYOUT_GENERAL, 1, &copyRegion);
+		stagingRing->releaseImage(heightImage.image, subresourceRange, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+		region = stagingRing->stage(slot.data.data() + tileHeightBytes, tileNormalBytes, 4);
+		copyRegion.bufferOffset = region.offset;
+		vkCmdCopyBufferToImage(stagingRing->getCommandBuffer(), region.buffer, normalImage.image, VK_IMAGE_LAYOUT_GENERAL, 1, &copyRegion);
+		stagingRing->releaseImage(normalImage.image, subresourceRange, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+		slot.uploadToken = stagingRing->getPendingToken();
+		slot.state = Uploading;
+		statistics.uploadedTiles++;
+		statistics.uploadedBytes += tileBytes;
+	}
+
+	/**
+	* Find the resident part of a level's window
+	*
+	* Keeps what's left of the previous region inside the new window (those tiles keep their slots), or starts at the camera's tile,
+	* and grows it by whole rows and columns of resident tiles
+	*/
+	void TerrainClipmap::updateRegion(uint32_t level, glm::ivec2 cameraTile)
+	{
+		Level &l = levels[level];
+		const glm::ivec4 target(l.origin, glm::min(l.origin + glm::ivec2(tilesPerSide - 1), glm::ivec2(l.tileCount - 1)));
+		glm::ivec4 rect = target;
+		if (!isResident(level, target)) {
+			rect = glm::ivec4(glm::max(glm::ivec2(l.validTiles), glm::ivec2(target)), glm::min(glm::ivec2(l.validTiles.z, l.validTiles.w), glm::ivec2(target.z, target.w)));
+			if (isEmpty(rect) || !isResident(level, rect)) {
+				const glm::ivec2 seed = glm::clamp(cameraTile, glm::ivec2(target), glm::ivec2(target.z, target.w));
+				rect = glm::ivec4(seed, seed);
+				if (!isResident(level, rect)) {
+					rect = glm::ivec4(0, 0, -1, -1);
+				}
+			}
+			bool grown = !isEmpty(rect);
+			while (grown) {
+				grown = false;
+				if ((rect.x > target.x) && isResident(level, glm::ivec4(rect.x - 1, rect.y, rect.x - 1, rect.w))) {
+					rect.x--;
+					grown = true;
+				}
+				if ((rect.z < target.z) && isResident(level, glm::ivec4(rect.z + 1, rect.y, rect.z + 1, rect.w))) {
+					rect.z++;
+					grown = true;
+				}
+				if ((rect.y > target.y) && isResident(level, glm::ivec4(rect.x, rect.y - 1, rect.z, rect.y - 1))) {
+					rect.y--;
+					grown = true;
+				}
+				if ((rect.w < target.w) && isResident(level, glm::ivec4(rect.x, rect.w + 1, rect.z, rect.w + 1))) {
+					rect.w++;
+					grown = true;
+				}
+			}
+		}
+		l.validTiles = rect;
+
+		if (isEmpty(rect)) {
+			levelRegions[level] = glm::ivec4(0, 0, -1, -1);
+			return;
+		}
+		const int32_t lastTile = static_cast<int32_t>(l.tileCount) - 1;
+		const int32_t lastTexel = static_cast<int32_t>(l.width) - 1;
+		glm::ivec4 &region = levelRegions[level];
+		region.x = (rect.x == 0) ? -borderExtension : rect.x * tileSize;
+		region.y = (rect.y == 0) ? -borderExtension : rect.y * tileSize;
+		region.z = (rect.z == lastTile) ? borderExtension : std::min((rect.z + 1) * static_cast<int32_t>(tileSize) - 1, lastTexel);
+		region.w = (rect.w == lastTile) ? borderExtension : std::min((rect.w + 1) * static_cast<int32_t>(tileSize) - 1, lastTexel);
+	}
+
+	/**
+	* Move the level windows to the camera, start reading and uploading missing tiles and update the resident regions, call this once per frame
+	*
+	* @param cameraPosition World space position of the camera, the terrain is centered at the origin of the xz plane
+	*/
+	void TerrainClipmap::update(const glm::vec3 &cameraPosition)
+	{
+		frame++;
+		statistics.uploadedTiles = 0;
+		const uint32_t levelCount = static_cast<uint32_t>(levels.size());
+		const uint32_t slotCount = tilesPerSide * tilesPerSide;
+		vks::StagingRing *stagingRing = device->getStagingRing();
+
+		struct Request {
+			uint32_t level;
+			Slot *slot;
+			glm::ivec2 tile;
+			float distance;
+		};
+		std::vector<Request> loads;
+		std::vector<Request> uploads;
+		uint32_t pendingLoads = 0;
+		glm::ivec2 cameraTiles[maxLevels];
+
+		const glm::vec2 cameraTexel = (glm::vec2(cameraPosition.x, cameraPosition.z) - getOrigin()) / texelSize + 0.5f;
+		for (uint32_t i = 0; i < levelCount; i++) {
+			Level &level = levels[i];
+			const glm::vec2 levelTexel = cameraTexel / static_cast<float>(1 << i) - 0.5f;
+			const glm::vec2 cameraTile = levelTexel / static_cast<float>(tileSize);
+			cameraTiles[i] = glm::ivec2(glm::floor(cameraTile));
+			// The window is centered on the camera, and stays inside the level
+			const int32_t maxOrigin = std::max(static_cast<int32_t>(level.tileCount) - static_cast<int32_t>(tilesPerSide), 0);
+			level.origin = glm::clamp(glm::ivec2(glm::floor(cameraTile - static_cast<float>(tilesPerSide) / 2.0f + 0.5f)), glm::ivec2(0), glm::ivec2(maxOrigin));
+
+			for (uint32_t s = 0; s < slotCount; s++) {
+				Slot &slot = level.slots[s];
+				const glm::ivec2 desired = getDesiredTile(i, s % tilesPerSide, s / tilesPerSide);
+				uint32_t state = slot.state.load(std::memory_order_acquire);
+				if ((state == Uploading) && stagingRing->isComplete(slot.uploadToken)) {
+					state = Resident;
+					slot.state = Resident;
+				}
+				if (state == Loading) {
+					pendingLoads++;
+					continue;
+				}
+				if (slot.tile != desired) {
+					// The slot's contents may still be read by frames in flight
+					if (state != Empty) {
+						slot.evictedFrame = frame;
+					}
+					slot.state = Empty;
+					slot.tile = glm::ivec2(-1);
+					state = Empty;
+				}
+				if (desired.x < 0) {
+					continue;
+				}
+				const float distance = glm::length(glm::vec2(desired) + 0.5f - cameraTile);
+				if ((state == Empty) && (frame - slot.evictedFrame >= reuseDelay)) {
+					loads.push_back({ i, &slot, desired, distance });
+				}
+				else if (state == Loaded) {
+					uploads.push_back({ i, &slot, desired, distance });
+				}
+			}
+		}
+
+		// Coarse levels first, as they cover more of the terrain per tile, then the tiles closest to the camera
+		auto priority = [](const Request &a, const Request &b) {
+			return (a.level != b.level) ? (a.level > b.level) : (a.distance < b.distance);
+		};
+		std::sort(loads.begin(), loads.end(), priority);
+		std::sort(uploads.begin(), uploads.end(), priority);
+
+		for (size_t i = 0; (i < loads.size()) && (pendingLoads < settings.maxPendingLoads); i++, pendingLoads++) {
+			Slot *slot = loads[i].slot;
+			slot->tile = loads[i].tile;
+			slot->state = Loading;
+			const char *source = tileData + getTileOffset(loads[i].level, loads[i].tile);
+			threadPool.addJob([slot, source] {
+				memcpy(slot->data.data(), source, tileBytes);
+				slot->state.store(Loaded, std::memory_order_release);
+			});
+		}
+		for (size_t i = 0; (i < uploads.size()) && (i < settings.maxUploadsPerFrame); i++) {
+			uploadTile(uploads[i].level, *uploads[i].slot);
+		}
+
+		statistics.residentTiles = 0;
+		statistics.pendingTiles = 0;
+		for (uint32_t i = 0; i < levelCount; i++) {
+			updateRegion(i, cameraTiles[i]);
+			for (uint32_t s = 0; s < slotCount; s++) {
+				const uint32_t state = levels[i].slots[s].state.load(std::memory_order_relaxed);
+				if (state == Resident) {
+					statistics.residentTiles++;
+				}
+				else if (state != Empty) {
+					statistics.pendingTiles++;
+				}
+			}
+		}
+	}
+
+	void TerrainClipmap::setSettings(const Settings &settings)
+	{
+		this->settings = settings;
+	}
+
+	const TerrainClipmap::Settings &TerrainClipmap::getSettings() const
+	{
+		return settings;
+	}
+
+	const TerrainClipmap::Statistics &TerrainClipmap::getStatistics() const
+	{
+		return statistics;
+	}
+
+	/** @brief Inclusive texel rectangles (x, y, z, w = min x, min y, max x, max y) of the resident part of each level, empty if x > z */
+	const glm::ivec4 *TerrainClipmap::getLevelRegions() const
+	{
+		return levelRegions;
+	}
+
+	uint32_t TerrainClipmap::getLevelCount() const
+	{
+		return static_cast<uint32_t>(levels.size());
+	}
+
+	/** @brief Number of height samples per side of the first level */
+	uint32_t TerrainClipmap::getWidth() const
+	{
+		return width;
+	}
+
+	/** @brief World space xz position of the first height sample, the terrain is centered at the origin */
+	glm::vec2 TerrainClipmap::getOrigin() const
+	{
+		return glm::vec2(-0.5f * static_cast<float>(width) * texelSize);
+	}
+
+	const VkDescriptorImageInfo &TerrainClipmap::getHeightDescriptor() const
+	{
+		return heightDescriptor;
+	}
+
+	const VkDescriptorImageInfo &TerrainClipmap::getNormalDescriptor() const
+	{
+		return normalDescriptor;
+	}
+}
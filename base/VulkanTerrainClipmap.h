@@ -0,0 +1,165 @@
+/*
+* Streaming terrain clipmap
+*
+* Pages height and normal tiles of a terrain from a tiled file into a clipmap texture array with one layer per detail level centered
+* on the camera, so terrains much larger than the available device memory render with a fixed memory footprint and upload cost per frame
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanMemoryAllocator.h"
+#include "VulkanMappedFile.hpp"
+#include "threadpool.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Height and normal clipmap of a terrain, streamed from disk around the camera
+	*
+	* Usage:
+	*	vks::TerrainClipmap clipmap(vulkanDevice, queue, getAssetPath() + "textures/terrain_heightmap_r16.ktx", texelSize, heightScale, settings.framesInFlight);
+	*	// Bind getHeightDescriptor() and getNormalDescriptor() as sampler2DArray
+	*	// Per frame, before submitting
+	*	clipmap.update(cameraPosition);
+	*	memcpy(uniformData.clipRegions, clipmap.getLevelRegions(), sizeof(glm::ivec4) * vks::TerrainClipmap::maxLevels);
+	*
+	* The tiled file is created from the r16 height map on first use and stored next to it as "<heightmap>.tiles". It holds a pyramid of
+	* levels, each halving the resolution of the previous one, cut into tiles of tileSize x tileSize heights (r16 unorm) and normals (rg8 snorm,
+	* the x and z components of the normal with y pointing up). Levels are added until the coarsest one fits into a single clipmap layer.
+	* Each layer of the clipmap holds a window of tilesPerSide x tilesPerSide tiles of its level around the camera. The window is addressed
+	* toroidally: a tile is stored at its level coordinates modulo the window size, so moving the window only replaces the tiles that enter it
+	* and the texture coordinate of a texel is its level coordinate divided by clipSize (with a repeating sampler).
+	* Tiles are read from the memory mapped file on a worker thread (so page faults don't stall the render thread), uploaded through the
+	* device's staging ring with a per frame budget (coarse levels and tiles close to the camera first) and only used once their upload has
+	* completed. getLevelRegions() returns the texel rectangle of each level whose tiles are all resident, shaders use the finest level that
+	* contains a position and blend to the next coarser one towards its border. The coarsest level is loaded by the constructor and always valid.
+	*
+	* @note Texel i of level l covers the level 0 texels i * 2^l to (i + 1) * 2^l - 1, so the clipmap texture coordinate of a continuous level 0
+	* texel position p (with texel centers at integers) is (p + 0.5) / (2^l * clipSize)
+	* @note Region edges on the border of the terrain are moved out by borderExtension, shaders clamp the positions to the terrain instead
+	* @note Slots are only overwritten framesInFlight + 2 updates after they have been removed from the regions, as frames still in flight may read them
+	*/
+	class TerrainClipmap
+	{
+	public:
+		static const uint32_t maxLevels = 8;
+		static const uint32_t tileSize = 128;
+		static const uint32_t tilesPerSide = 4;
+		static const uint32_t clipSize = tileSize * tilesPerSide;
+		static const int32_t borderExtension = 1 << 20;
+		static const VkFormat heightFormat = VK_FORMAT_R16_UNORM;
+		static const VkFormat normalFormat = VK_FORMAT_R8G8_SNORM;
+
+		struct Settings {
+			// Tiles uploaded per update, limits the transfer cost of a frame
+			uint32_t maxUploadsPerFrame = 8;
+			// Tiles read by the worker threads at the same time
+			uint32_t maxPendingLoads = 32;
+		};
+
+		struct Statistics {
+			uint32_t residentTiles = 0;
+			// Tiles being read, waiting for or in the middle of their upload
+			uint32_t pendingTiles = 0;
+			// Tiles uploaded by the last update
+			uint32_t uploadedTiles = 0;
+			uint64_t uploadedBytes = 0;
+		};
+
+	private:
+		enum TileState : uint32_t {
+			Empty = 0,
+			// Read by a worker thread into the slot's data
+			Loading = 1,
+			Loaded = 2,
+			// Copy recorded into the staging ring, waiting for uploadToken
+			Uploading = 3,
+			Resident = 4,
+		};
+		struct Slot {
+			// Tile held by (or being loaded into) the slot, -1 if none
+			glm::ivec2 tile = glm::ivec2(-1);
+			std::atomic<uint32_t> state{ Empty };
+			uint64_t uploadToken = 0;
+			uint32_t evictedFrame = 0;
+			std::vector<char> data;
+		};
+		struct Level {
+			uint32_t width = 0;
+			uint32_t tileCount = 0;
+			size_t firstTile = 0;
+			// Window origin in tiles
+			glm::ivec2 origin = glm::ivec2(0);
+			// Inclusive tile rectangle of the resident part of the window, empty if x > z
+			glm::ivec4 validTiles = glm::ivec4(0, 0, -1, -1);
+			std::unique_ptr<Slot[]> slots;
+		};
+		struct Image {
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			vks::MemoryAllocation allocation{};
+		};
+		vks::VulkanDevice *device;
+		Settings settings;
+		Statistics statistics;
+		float texelSize;
+		float heightScale;
+		uint32_t width = 0;
+		uint32_t reuseDelay;
+		uint32_t frame;
+		std::vector<Level> levels;
+		glm::ivec4 levelRegions[maxLevels];
+		// Tile data is read from the mapped file, or from memory if it couldn't be written (e.g. into the apk's assets on Android)
+		vks::MappedFile tileFile;
+		std::vector<char> tileMemory;
+		const char *tileData = nullptr;
+		Image heightImage;
+		Image normalImage;
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkDescriptorImageInfo heightDescriptor{};
+		VkDescriptorImageInfo normalDescriptor{};
+		vks::ThreadPool threadPool;
+		bool loadTileFile(const std::string &filename, uint64_t sourceHash);
+		bool setTileData(const char *data, size_t size, uint64_t sourceHash);
+		bool convertHeightMap(const std::string &heightMapFile, uint64_t sourceHash);
+		void createImage(Image &image, VkFormat format);
+		size_t getTileOffset(uint32_t level, glm::ivec2 tile) const;
+		Slot &getSlot(uint32_t level, glm::ivec2 tile) const;
+		glm::ivec2 getDesiredTile(uint32_t level, uint32_t slotX, uint32_t slotY) const;
+		bool isResident(uint32_t level, const glm::ivec4 &rect) const;
+		void uploadTile(uint32_t level, Slot &slot);
+		void updateRegion(uint32_t level, glm::ivec2 cameraTile);
+	public:
+		static const size_t tileHeightBytes = tileSize * tileSize * sizeof(uint16_t);
+		static const size_t tileNormalBytes = tileSize * tileSize * 2;
+		static const size_t tileBytes = tileHeightBytes + tileNormalBytes;
+
+		TerrainClipmap(vks::VulkanDevice *device, VkQueue queue, const std::string &heightMapFile, float texelSize, float heightScale, uint32_t framesInFlight);
+		~TerrainClipmap();
+		void update(const glm::vec3 &cameraPosition);
+		void setSettings(const Settings &settings);
+		const Settings &getSettings() const;
+		const Statistics &getStatistics() const;
+		const glm::ivec4 *getLevelRegions() const;
+		uint32_t getLevelCount() const;
+		uint32_t getWidth() const;
+		glm::vec2 getOrigin() const;
+		const VkDescriptorImageInfo &getHeightDescriptor() const;
+		const VkDescriptorImageInfo &getNormalDescriptor() const;
+	};
+}
@@ -7,6 +7,8 @@
 */
 
 #include <VulkanTexture.h>
+#include "VulkanDebug.h"
+#include "VulkanStartupReport.h"
 
 namespace vks
 {
@@ -17,39 +19,92 @@ namespace vks
 		descriptor.imageLayout = imageLayout;
 	}
 
+	/**
+	* Write the texture's combined image sampler descriptor into a descriptor buffer (VK_EXT_descriptor_buffer)
+	*
+	* @param vkGetDescriptorEXT Function pointer of the extension
+	* @param descriptorSize Size of a combined image sampler descriptor (see VkPhysicalDeviceDescriptorBufferPropertiesEXT)
+	* @param target Mapped location of the descriptor in the buffer
+	*/
+	void Texture::getDescriptorEXT(PFN_vkGetDescriptorEXT vkGetDescriptorEXT, size_t descriptorSize, void *target) const
+	{
+		VkDescriptorGetInfoEXT descriptorInfo{};
+		descriptorInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+		descriptorInfo.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorInfo.data.pCombinedImageSampler = &descriptor;
+		vkGetDescriptorEXT(device->logicalDevice, &descriptorInfo, descriptorSize, target);
+	}
+
 	void Texture::destroy()
 	{
 		vkDestroyImageView(device->logicalDevice, view, nullptr);
 		vkDestroyImage(device->logicalDevice, image, nullptr);
-		if (sampler)
+		// Samplers are shared through the device's sampler cache, unless they have been replaced by the application
+		if (sampler && !device->getSamplerCache()->release(sampler))
 		{
 			vkDestroySampler(device->logicalDevice, sampler, nullptr);
 		}
-		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		device->freeMemory(deviceMemory, allocation);
 	}
 
-	ktxResult Texture::loadKTXFile(std::string filename, ktxTexture **target)
+	/** @brief Name the image and view for capture tools and validation messages, does nothing without VK_EXT_debug_utils */
+	void Texture::setDebugName(const std::string &name)
 	{
-		ktxResult result = KTX_SUCCESS;
-#if defined(__ANDROID__)
-		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-		if (!asset) {
-			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
-		}
-		size_t size = AAsset_getLength(asset);
-		assert(size > 0);
-		ktx_uint8_t *textureData = new ktx_uint8_t[size];
-		AAsset_read(asset, textureData, size);
-		AAsset_close(asset);
-		result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target);
-		delete[] textureData;
-#else
-		if (!vks::tools::fileExists(filename)) {
+		vks::debugutils::setObjectName(device->logicalDevice, VK_OBJECT_TYPE_IMAGE, (uint64_t)image, name.c_str());
+		vks::debugutils::setObjectName(device->logicalDevice, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)view, name.c_str());
+	}
+
+	/**
+	* Open a ktx file without loading its image data
+	*
+	* @param filename File to load
+	* @param target Pointer to the ktx texture that is created for the file
+	* @param file Mapping of the file, the ktx texture reads its image data from it so it has to stay open until the images have been loaded
+	*
+	* @note Image data is loaded while iterating with ktxTexture_IterateLoadLevelFaces, which only keeps a single mip level in host memory at a time
+	*/
+	ktxResult Texture::loadKTXFile(std::string filename, ktxTexture **target, vks::MappedFile &file)
+	{
+		if (!file.open(filename)) {
 			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
 		}
-		result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target);			
-#endif		
-		return result;
+		return ktxTexture_CreateFromMemory(reinterpret_cast<const ktx_uint8_t*>(file.data), file.size, KTX_TEXTURE_CREATE_NO_FLAGS, target);
+	}
+
+	struct KTXUploadInfo
+	{
+		vks::StagingRing *stagingRing;
+		VkImage image;
+		// Non-array cubemaps pass each face separately, arrays pass all layers of a mip level at once
+		bool separateFaces;
+		uint32_t layerCount;
+	};
+
+	/** @brief Callback for ktxTexture_IterateLoadLevelFaces that stages the image data of a mip level and records its copy into the staging ring */
+	static KTX_error_code uploadLevelFace(int miplevel, int face, int width, int height, int depth, ktx_uint32_t faceLodSize, void *pixels, void *userdata)
+	{
+		KTXUploadInfo *uploadInfo = static_cast<KTXUploadInfo*>(userdata);
+		vks::StagingRing::Region stagingRegion = uploadInfo->stagingRing->stage(pixels, faceLodSize);
+
+		VkBufferImageCopy bufferCopyRegion = {};
+		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		bufferCopyRegion.imageSubresource.mipLevel = miplevel;
+		bufferCopyRegion.imageSubresource.baseArrayLayer = uploadInfo->separateFaces ? face : 0;
+		bufferCopyRegion.imageSubresource.layerCount = uploadInfo->separateFaces ? 1 : uploadInfo->layerCount;
+		bufferCopyRegion.imageExtent.width = width;
+		bufferCopyRegion.imageExtent.height = height;
+		bufferCopyRegion.imageExtent.depth = depth;
+		bufferCopyRegion.bufferOffset = stagingRegion.offset;
+
+		// Staging may have submitted the previous batch, so the command buffer has to be fetched after stage()
+		vkCmdCopyBufferToImage(
+			uploadInfo->stagingRing->getCommandBuffer(),
+			stagingRegion.buffer,
+			uploadInfo->image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1,
+			&bufferCopyRegion);
+		return KTX_SUCCESS;
 	}
 
 	/**
@@ -58,236 +113,71 @@ namespace vks
 	* @param filename File to load (supports .ktx)
 	* @param format Vulkan format of the image data stored in the file
 	* @param device Vulkan device to create the texture on
-	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
+	* @param copyQueue Ignored, see the upload note of vks::Texture
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-	* @param (Optional) forceLinear Force linear tiling (not advised, defaults to false)
 	*
+	* @note Textures are always uploaded to optimal tiled device local images, use StreamingTexture2D for textures that are updated every frame
 	*/
-	void Texture2D::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout, bool forceLinear)
+	void Texture2D::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
 	{
+		VKS_STARTUP_SCOPE(vks::StartupReport::Asset, filename);
+		vks::MappedFile file;
 		ktxTexture* ktxTexture;
-		ktxResult result = loadKTXFile(filename, &ktxTexture);
+		ktxResult result = loadKTXFile(filename, &ktxTexture, file);
 		assert(result == KTX_SUCCESS);
 
 		this->device = device;
 		width = ktxTexture->baseWidth;
 		height = ktxTexture->baseHeight;
 		mipLevels = ktxTexture->numLevels;
+		layerCount = 1;
 
-		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
-
-		// Get device properties for the requested texture format
-		VkFormatProperties formatProperties;
-		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
-
-		// Only use linear tiling if requested (and supported by the device)
-		// Support for linear tiling is mostly limited, so prefer to use
-		// optimal tiling instead
-		// On most implementations linear tiling will only support a very
-		// limited amount of formats and features (mip maps, cubemaps, arrays, etc.)
-		VkBool32 useStaging = !forceLinear;
-
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-
-		// Use a separate command buffer for texture loading
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		if (useStaging)
+		// Create optimal tiled target image
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.mipLevels = mipLevels;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { width, height, 1 };
+		imageCreateInfo.usage = imageUsageFlags;
+		// Ensure that the TRANSFER_DST bit is set for staging
+		if (!(imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
 		{
-			// Create a host-visible staging buffer that contains the raw image data
-			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingMemory;
-
-			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-			bufferCreateInfo.size = ktxTextureSize;
-			// This buffer is used as a transfer source for the buffer copy
-			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-			// Get memory requirements for the staging buffer (alignment, memory type bits)
-			vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-			// Get memory type index for a host visible buffer
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-			VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-			// Copy texture data into staging buffer
-			uint8_t *data;
-			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-			memcpy(data, ktxTextureData, ktxTextureSize);
-			vkUnmapMemory(device->logicalDevice, stagingMemory);
-
-			// Setup buffer copy regions for each mip level
-			std::vector<VkBufferImageCopy> bufferCopyRegions;
-
-			for (uint32_t i = 0; i < mipLevels; i++)
-			{
-				ktx_size_t offset;
-				KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
-				assert(result == KTX_SUCCESS);
-
-				VkBufferImageCopy bufferCopyRegion = {};
-				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				bufferCopyRegion.imageSubresource.mipLevel = i;
-				bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-				bufferCopyRegion.imageSubresource.layerCount = 1;
-				bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
-				bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
-				bufferCopyRegion.imageExtent.depth = 1;
-				bufferCopyRegion.bufferOffset = offset;
-
-				bufferCopyRegions.push_back(bufferCopyRegion);
-			}
-
-			// Create optimal tiled target image
-			VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-			imageCreateInfo.format = format;
-			imageCreateInfo.mipLevels = mipLevels;
-			imageCreateInfo.arrayLayers = 1;
-			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageCreateInfo.extent = { width, height, 1 };
-			imageCreateInfo.usage = imageUsageFlags;
-			// Ensure that the TRANSFER_DST bit is set for staging
-			if (!(imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
-			{
-				imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-			}
-			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-
-			vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-			VkImageSubresourceRange subresourceRange = {};
-			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			subresourceRange.baseMipLevel = 0;
-			subresourceRange.levelCount = mipLevels;
-			subresourceRange.layerCount = 1;
-
-			// Image barrier for optimal image (target)
-			// Optimal image will be used as destination for the copy
-			vks::tools::setImageLayout(
-				copyCmd,
-				image,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				subresourceRange);
-
-			// Copy mip levels from staging buffer
-			vkCmdCopyBufferToImage(
-				copyCmd,
-				stagingBuffer,
-				image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				static_cast<uint32_t>(bufferCopyRegions.size()),
-				bufferCopyRegions.data()
-			);
-
-			// Change texture image layout to shader read after all mip levels have been copied
-			this->imageLayout = imageLayout;
-			vks::tools::setImageLayout(
-				copyCmd,
-				image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				imageLayout,
-				subresourceRange);
-
-			device->flushCommandBuffer(copyCmd, copyQueue);
-
-			// Clean up staging resources
-			vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-			vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+			imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		}
-		else
-		{
-			// Prefer using optimal tiling, as linear tiling 
-			// may support only a small set of features 
-			// depending on implementation (e.g. no mip maps, only one layer, etc.)
-
-			// Check if this support is supported for linear tiling
-			assert(formatProperties.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
-
-			VkImage mappableImage;
-			VkDeviceMemory mappableMemory;
-
-			VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-			imageCreateInfo.format = format;
-			imageCreateInfo.extent = { width, height, 1 };
-			imageCreateInfo.mipLevels = 1;
-			imageCreateInfo.arrayLayers = 1;
-			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-			imageCreateInfo.tiling = VK_IMAGE_TILING_LINEAR;
-			imageCreateInfo.usage = imageUsageFlags;
-			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-
-			// Load mip map level 0 to linear tiling image
-			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &mappableImage));
-
-			// Get memory requirements for this image 
-			// like size and alignment
-			vkGetImageMemoryRequirements(device->logicalDevice, mappableImage, &memReqs);
-			// Set memory allocation size to required memory size
-			memAllocInfo.allocationSize = memReqs.size;
-
-			// Get memory type that can be mapped to host memory
-			memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-			// Allocate host memory
-			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &mappableMemory));
-
-			// Bind allocated image for use
-			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, mappableImage, mappableMemory, 0));
-
-			// Get sub resource layout
-			// Mip map count, array layer, etc.
-			VkImageSubresource subRes = {};
-			subRes.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			subRes.mipLevel = 0;
-
-			VkSubresourceLayout subResLayout;
-			void *data;
-
-			// Get sub resources layout 
-			// Includes row pitch, size offsets, etc.
-			vkGetImageSubresourceLayout(device->logicalDevice, mappableImage, &subRes, &subResLayout);
-
-			// Map image memory
-			VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, mappableMemory, 0, memReqs.size, 0, &data));
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-			// Copy image data into memory
-			memcpy(data, ktxTextureData, memReqs.size);
+		VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &deviceMemory, &allocation));
 
-			vkUnmapMemory(device->logicalDevice, mappableMemory);
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = mipLevels;
+		subresourceRange.layerCount = 1;
 
-			// Linear tiled images don't need to be staged
-			// and can be directly used as textures
-			image = mappableImage;
-			deviceMemory = mappableMemory;
-			this->imageLayout = imageLayout;
+		// Image barrier for optimal image (target)
+		// Optimal image will be used as destination for the copy
+		vks::StagingRing *stagingRing = device->getStagingRing();
+		vks::tools::setImageLayout(
+			stagingRing->getCommandBuffer(),
+			image,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			subresourceRange);
 
-			// Setup image memory barrier
-			vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, imageLayout);
+		// Stream the mip levels from the file into the staging ring, only one level is held in host memory at a time
+		KTXUploadInfo uploadInfo = { stagingRing, image, false, 1 };
+		result = ktxTexture_IterateLoadLevelFaces(ktxTexture, uploadLevelFace, &uploadInfo);
+		assert(result == KTX_SUCCESS);
 
-			device->flushCommandBuffer(copyCmd, copyQueue);
-		}
+		// Change texture image layout to shader read after all mip levels have been copied
+		this->imageLayout = imageLayout;
+		stagingRing->releaseImage(image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout);
 
 		ktxTexture_Destroy(ktxTexture);
 
@@ -303,13 +193,13 @@ namespace vks
 		samplerCreateInfo.mipLodBias = 0.0f;
 		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 		samplerCreateInfo.minLod = 0.0f;
-		// Max level-of-detail should match mip level count
-		samplerCreateInfo.maxLod = (useStaging) ? (float)mipLevels : 0.0f;
+		// The view limits the mip levels, so textures with different mip counts share the sampler
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
 		// Only enable anisotropic filtering if enabled on the device
 		samplerCreateInfo.maxAnisotropy = device->enabledFeatures.samplerAnisotropy ? device->properties.limits.maxSamplerAnisotropy : 1.0f;
 		samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
 		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->getSamplerCache()->get(samplerCreateInfo);
 
 		// Create image view
 		// Textures are not directly accessed by the shaders and
@@ -320,12 +210,12 @@ namespace vks
 		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 		viewCreateInfo.format = format;
 		viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-		// Linear tiling usually won't support mip maps
-		// Only set mip map count if optimal tiling is used
-		viewCreateInfo.subresourceRange.levelCount = (useStaging) ? mipLevels : 1;
+		viewCreateInfo.subresourceRange.levelCount = mipLevels;
 		viewCreateInfo.image = image;
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
 
+		setDebugName(filename);
+
 		// Update descriptor image info member that can be used for setting up descriptor sets
 		updateDescriptor();
 	}
@@ -339,7 +229,7 @@ namespace vks
 	* @param height Height of the texture to create
 	* @param format Vulkan format of the image data stored in the file
 	* @param device Vulkan device to create the texture on
-	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
+	* @param copyQueue Ignored, see the upload note of vks::Texture
 	* @param (Optional) filter Texture filtering for the sampler (defaults to VK_FILTER_LINEAR)
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
@@ -352,40 +242,48 @@ namespace vks
 		width = texWidth;
 		height = texHeight;
 		mipLevels = 1;
+		layerCount = 1;
 
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-
-		// Use a separate command buffer for texture loading
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		// Create a host-visible staging buffer that contains the raw image data
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = bufferSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+		// Copy texture data into the device's staging ring, the upload is submitted together with other pending uploads
+		vks::StagingRing::Region stagingRegion = device->getStagingRing()->stage(buffer, bufferSize);
+		fromStagingRegion(stagingRegion, format, filter, imageUsageFlags, imageLayout);
+	}
 
-		// Get memory requirements for the staging buffer (alignment, memory type bits)
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
+	/**
+	* Creates an RGBA 2D texture from a buffer of tightly packed 8 bit RGB pixels
+	*
+	* @param buffer Buffer containing the RGB pixels, three bytes each
+	* @param width Width of the texture to create
+	* @param height Height of the texture to create
+	* @param device Vulkan device to create the texture on
+	* @param copyQueue Ignored, see the upload note of vks::Texture
+	* @param (Optional) filter Texture filtering for the sampler (defaults to VK_FILTER_LINEAR)
+	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
+	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	*
+	* @note The pixels are expanded to VK_FORMAT_R8G8B8A8_UNORM with opaque alpha directly in the staging ring, as most devices don't support sampling RGB formats
+	*/
+	void Texture2D::fromRGBBuffer(const void* buffer, uint32_t texWidth, uint32_t texHeight, vks::VulkanDevice *device, VkQueue copyQueue, VkFilter filter, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	{
+		assert(buffer);
 
-		memAllocInfo.allocationSize = memReqs.size;
-		// Get memory type index for a host visible buffer
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		this->device = device;
+		width = texWidth;
+		height = texHeight;
+		mipLevels = 1;
+		layerCount = 1;
 
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+		const size_t pixelCount = static_cast<size_t>(width) * height;
+		vks::StagingRing::Region stagingRegion = device->getStagingRing()->allocate(pixelCount * 4);
+		vks::tools::expandRGBToRGBA(static_cast<const uint8_t*>(buffer), static_cast<uint8_t*>(stagingRegion.data), pixelCount);
+		fromStagingRegion(stagingRegion, VK_FORMAT_R8G8B8A8_UNORM, filter, imageUsageFlags, imageLayout);
+	}
 
-		// Copy texture data into staging buffer
-		uint8_t *data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-		memcpy(data, buffer, bufferSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+	/** @brief Creates the image, sampler and view of a single level 2D texture and records its upload from a staged region */
+	void Texture2D::fromStagingRegion(const vks::StagingRing::Region &stagingRegion, VkFormat format, VkFilter filter, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	{
+		vks::StagingRing *stagingRing = device->getStagingRing();
+		VkCommandBuffer copyCmd = stagingRing->getCommandBuffer();
 
 		VkBufferImageCopy bufferCopyRegion = {};
 		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -395,7 +293,7 @@ namespace vks
 		bufferCopyRegion.imageExtent.width = width;
 		bufferCopyRegion.imageExtent.height = height;
 		bufferCopyRegion.imageExtent.depth = 1;
-		bufferCopyRegion.bufferOffset = 0;
+		bufferCopyRegion.bufferOffset = stagingRegion.offset;
 
 		// Create optimal tiled target image
 		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
@@ -416,13 +314,7 @@ namespace vks
 		}
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-		memAllocInfo.allocationSize = memReqs.size;
-
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+		VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &deviceMemory, &allocation));
 
 		VkImageSubresourceRange subresourceRange = {};
 		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -442,7 +334,7 @@ namespace vks
 		// Copy mip levels from staging buffer
 		vkCmdCopyBufferToImage(
 			copyCmd,
-			stagingBuffer,
+			stagingRegion.buffer,
 			image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1,
@@ -450,19 +342,9 @@ namespace vks
 		);
 
 		// Change texture image layout to shader read after all mip levels have been copied
+		// With a dedicated transfer queue this also hands the image over to the graphics queue
 		this->imageLayout = imageLayout;
-		vks::tools::setImageLayout(
-			copyCmd,
-			image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			imageLayout,
-			subresourceRange);
-
-		device->flushCommandBuffer(copyCmd, copyQueue);
-
-		// Clean up staging resources
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+		stagingRing->releaseImage(image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout);
 
 		// Create sampler
 		VkSamplerCreateInfo samplerCreateInfo = {};
@@ -478,7 +360,7 @@ namespace vks
 		samplerCreateInfo.minLod = 0.0f;
 		samplerCreateInfo.maxLod = 0.0f;
 		samplerCreateInfo.maxAnisotropy = 1.0f;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->getSamplerCache()->get(samplerCreateInfo);
 
 		// Create image view
 		VkImageViewCreateInfo viewCreateInfo = {};
@@ -495,87 +377,329 @@ namespace vks
 		updateDescriptor();
 	}
 
+	/** @brief Size of a texel in bytes for the uncompressed color formats supported by StreamingTexture2D, 0 for other formats */
+	static VkDeviceSize streamingTexelSize(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R8_UNORM:
+			return 1;
+		case VK_FORMAT_R8G8_UNORM:
+		case VK_FORMAT_R16_UNORM:
+		case VK_FORMAT_R16_SFLOAT:
+			return 2;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+		case VK_FORMAT_R16G16_SFLOAT:
+		case VK_FORMAT_R32_SFLOAT:
+			return 4;
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			return 8;
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
 	/**
-	* Load a 2D texture array including all mip levels
+	* Check if a format can be streamed on a device
 	*
-	* @param filename File to load (supports .ktx)
-	* @param format Vulkan format of the image data stored in the file
-	* @param device Vulkan device to create the texture on
-	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
-	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
-	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	* @note VK_FORMAT_G8_B8R8_2PLANE_420_UNORM also requires the samplerYcbcrConversion feature, which has to be enabled by the application
+	*/
+	bool StreamingTexture2D::isFormatSupported(vks::VulkanDevice *device, VkFormat format)
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+		VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+		if (format == VK_FORMAT_G8_B8R8_2PLANE_420_UNORM)
+		{
+			if (device->properties.apiVersion < VK_API_VERSION_1_1)
+			{
+				return false;
+			}
+			// Either chroma sample location has to be supported by the conversion
+			if (!(formatProperties.optimalTilingFeatures & (VK_FORMAT_FEATURE_MIDPOINT_CHROMA_SAMPLES_BIT | VK_FORMAT_FEATURE_COSITED_CHROMA_SAMPLES_BIT)))
+			{
+				return false;
+			}
+		}
+		else if (streamingTexelSize(format) == 0)
+		{
+			return false;
+		}
+		return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
+	}
+
+	/**
+	* Create a streaming texture, its images and staging slots
 	*
+	* @param format Uncompressed color format or VK_FORMAT_G8_B8R8_2PLANE_420_UNORM (NV12), the data passed to update() has to be tightly packed texels of this format
+	* @param texWidth Width of the texture (has to be even for NV12)
+	* @param texHeight Height of the texture (has to be even for NV12)
+	* @param slotCount Number of staging slots and images, usually one per command buffer that records an upload
+	* @param device Vulkan device to create the texture on
+	* @param (Optional) filter Texture filtering for the sampler (defaults to VK_FILTER_LINEAR)
+	* @param (Optional) imageUsageFlags Usage flags for the texture's images (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 	*/
-	void Texture2DArray::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	void StreamingTexture2D::create(VkFormat format, uint32_t texWidth, uint32_t texHeight, uint32_t slotCount, vks::VulkanDevice *device, VkFilter filter, VkImageUsageFlags imageUsageFlags)
 	{
-		ktxTexture* ktxTexture;
-		ktxResult result = loadKTXFile(filename, &ktxTexture);
-		assert(result == KTX_SUCCESS);
+		assert(slotCount > 0);
+		if (!isFormatSupported(device, format))
+		{
+			vks::tools::exitFatal("Format " + std::to_string(format) + " is not supported for streaming textures", -1);
+		}
 
 		this->device = device;
-		width = ktxTexture->baseWidth;
-		height = ktxTexture->baseHeight;
-		layerCount = ktxTexture->numLayers;
-		mipLevels = ktxTexture->numLevels;
+		this->slotCount = slotCount;
+		this->format = format;
+		width = texWidth;
+		height = texHeight;
+		mipLevels = 1;
+		layerCount = 1;
+		VkDeviceSize texelSize;
+		if (format == VK_FORMAT_G8_B8R8_2PLANE_420_UNORM)
+		{
+			assert((width % 2 == 0) && (height % 2 == 0));
+			// Full resolution luma plane followed by the half resolution chroma plane with two bytes per texel, the chroma plane starts at a multiple of four bytes as required for copies
+			texelSize = 2;
+			imageSize = static_cast<VkDeviceSize>(width) * height + static_cast<VkDeviceSize>(width / 2) * (height / 2) * 2;
+		}
+		else
+		{
+			texelSize = streamingTexelSize(format);
+			imageSize = static_cast<VkDeviceSize>(width) * height * texelSize;
+		}
+		// Copies from buffers must start at a multiple of the texel size, and of four bytes
+		const VkDeviceSize alignment = std::max(std::max(texelSize, (VkDeviceSize)4), device->properties.limits.optimalBufferCopyOffsetAlignment);
+		slotSize = (imageSize + alignment - 1) / alignment * alignment;
 
-		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+		// The staging slots stay mapped for the lifetime of the texture
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, slotSize * slotCount));
+		VK_CHECK_RESULT(stagingBuffer.map());
 
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = filter;
+		samplerCreateInfo.minFilter = filter;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
+		samplerCreateInfo.minLod = 0.0f;
+		samplerCreateInfo.maxLod = 0.0f;
+		samplerCreateInfo.maxAnisotropy = 1.0f;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 
-		// Create a host-visible staging buffer that contains the raw image data
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
+		VkSamplerYcbcrConversionInfo ycbcrConversionInfo{};
+		if (format == VK_FORMAT_G8_B8R8_2PLANE_420_UNORM)
+		{
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+			const VkFormatFeatureFlags formatFeatures = formatProperties.optimalTilingFeatures;
+			// Video decoders usually output BT.709 narrow range with chroma samples located between the luma samples
+			const VkChromaLocation chromaLocation = (formatFeatures & VK_FORMAT_FEATURE_MIDPOINT_CHROMA_SAMPLES_BIT) ? VK_CHROMA_LOCATION_MIDPOINT : VK_CHROMA_LOCATION_COSITED_EVEN;
+			VkSamplerYcbcrConversionCreateInfo conversionCreateInfo{};
+			conversionCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO;
+			conversionCreateInfo.format = format;
+			conversionCreateInfo.ycbcrModel = VK_SAMPLER_YCBCR_MODEL_CONVERSION_YCBCR_709;
+			conversionCreateInfo.ycbcrRange = VK_SAMPLER_YCBCR_RANGE_ITU_NARROW;
+			conversionCreateInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+			conversionCreateInfo.xChromaOffset = chromaLocation;
+			conversionCreateInfo.yChromaOffset = chromaLocation;
+			conversionCreateInfo.chromaFilter = (formatFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_YCBCR_CONVERSION_LINEAR_FILTER_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+			conversionCreateInfo.forceExplicitReconstruction = VK_FALSE;
+			// Loaded through the device, as the Vulkan 1.1 entry points aren't exported by all loaders
+			PFN_vkCreateSamplerYcbcrConversion vkCreateSamplerYcbcrConversion = reinterpret_cast<PFN_vkCreateSamplerYcbcrConversion>(vkGetDeviceProcAddr(device->logicalDevice, "vkCreateSamplerYcbcrConversion"));
+			VK_CHECK_RESULT(vkCreateSamplerYcbcrConversion(device->logicalDevice, &conversionCreateInfo, nullptr, &ycbcrConversion));
+			ycbcrConversionInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO;
+			ycbcrConversionInfo.conversion = ycbcrConversion;
+			// Samplers with a conversion are not shared through the sampler cache, as they have to be immutable samplers of the descriptor set layout
+			samplerCreateInfo.pNext = &ycbcrConversionInfo;
+			if (!(formatFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_YCBCR_CONVERSION_SEPARATE_RECONSTRUCTION_FILTER_BIT))
+			{
+				samplerCreateInfo.minFilter = conversionCreateInfo.chromaFilter;
+				samplerCreateInfo.magFilter = conversionCreateInfo.chromaFilter;
+			}
+			VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		}
+		else
+		{
+			sampler = device->getSamplerCache()->get(samplerCreateInfo);
+		}
+
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { width, height, 1 };
+		imageCreateInfo.usage = imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = ktxTextureSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		// The images can be sampled before their first upload has been recorded, so they start out in the shader read layout
+		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+		viewCreateInfo.pNext = (ycbcrConversion != VK_NULL_HANDLE) ? &ycbcrConversionInfo : nullptr;
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = format;
+		viewCreateInfo.subresourceRange = subresourceRange;
 
-		// Get memory requirements for the staging buffer (alignment, memory type bits)
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
+		slotImages.resize(slotCount);
+		for (SlotImage &slotImage : slotImages)
+		{
+			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &slotImage.image));
+			VK_CHECK_RESULT(device->allocateImageMemory(slotImage.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &slotImage.memory, &slotImage.allocation));
+			device->getStagingRing()->releaseImage(slotImage.image, subresourceRange, VK_IMAGE_LAYOUT_UNDEFINED, imageLayout);
+			viewCreateInfo.image = slotImage.image;
+			VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &slotImage.view));
+			slotImage.descriptor.sampler = sampler;
+			slotImage.descriptor.imageView = slotImage.view;
+			slotImage.descriptor.imageLayout = imageLayout;
+		}
 
-		memAllocInfo.allocationSize = memReqs.size;
-		// Get memory type index for a host visible buffer
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		// The texture's own members refer to the first slot, for code that only handles single image textures
+		image = slotImages[0].image;
+		view = slotImages[0].view;
+		deviceMemory = slotImages[0].memory;
+		updateDescriptor();
+	}
 
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+	void StreamingTexture2D::destroy()
+	{
+		for (SlotImage &slotImage : slotImages)
+		{
+			vkDestroyImageView(device->logicalDevice, slotImage.view, nullptr);
+			vkDestroyImage(device->logicalDevice, slotImage.image, nullptr);
+			device->freeMemory(slotImage.memory, slotImage.allocation);
+		}
+		slotImages.clear();
+		if (ycbcrConversion != VK_NULL_HANDLE)
+		{
+			vkDestroySampler(device->logicalDevice, sampler, nullptr);
+			PFN_vkDestroySamplerYcbcrConversion vkDestroySamplerYcbcrConversion = reinterpret_cast<PFN_vkDestroySamplerYcbcrConversion>(vkGetDeviceProcAddr(device->logicalDevice, "vkDestroySamplerYcbcrConversion"));
+			vkDestroySamplerYcbcrConversion(device->logicalDevice, ycbcrConversion, nullptr);
+			ycbcrConversion = VK_NULL_HANDLE;
+		}
+		else if (!device->getSamplerCache()->release(sampler))
+		{
+			vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		}
+		stagingBuffer.unmap();
+		stagingBuffer.destroy();
+	}
 
-		// Copy texture data into staging buffer
-		uint8_t *data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+	/**
+	* Host pointer to a staging slot, for writing the next contents of the texture directly (e.g. from a video decoder)
+	*
+	* @note The slot must not be written while a command buffer that uploads it is still executing
+	*/
+	void *StreamingTexture2D::getSlotData(uint32_t slot)
+	{
+		assert(slot < slotCount);
+		return static_cast<uint8_t*>(stagingBuffer.mapped) + slot * slotSize;
+	}
 
-		// Setup buffer copy regions for each layer including all of its miplevels
-		std::vector<VkBufferImageCopy> bufferCopyRegions;
+	/** @brief Copy the next contents of the texture (getImageSize() bytes of tightly packed texels) into a staging slot */
+	void StreamingTexture2D::update(uint32_t slot, const void *data)
+	{
+		memcpy(getSlotData(slot), data, imageSize);
+	}
 
-		for (uint32_t layer = 0; layer < layerCount; layer++)
+	/**
+	* Record the copy of a staging slot into the slot's image, outside of a render pass and before the commands sampling it
+	*
+	* @note The memory is host coherent, so writes made to the slot before the command buffer is submitted are visible to the copy
+	*/
+	void StreamingTexture2D::recordUpload(VkCommandBuffer commandBuffer, uint32_t slot)
+	{
+		assert(slot < slotCount);
+		const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+		// The whole image is replaced, so the previous contents are discarded, the copy only has to wait for earlier reads of this slot's image to finish
+		VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+		imageBarrier.image = slotImages[slot].image;
+		imageBarrier.subresourceRange = subresourceRange;
+		imageBarrier.srcAccessMask = 0;
+		imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+		VkBufferImageCopy bufferCopyRegions[2] = {};
+		uint32_t regionCount = 1;
+		bufferCopyRegions[0].imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		bufferCopyRegions[0].imageExtent = { width, height, 1 };
+		bufferCopyRegions[0].bufferOffset = slot * slotSize;
+		if (format == VK_FORMAT_G8_B8R8_2PLANE_420_UNORM)
 		{
-			for (uint32_t level = 0; level < mipLevels; level++)
-			{
-				ktx_size_t offset;
-				KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, level, layer, 0, &offset);
-				assert(result == KTX_SUCCESS);
-
-				VkBufferImageCopy bufferCopyRegion = {};
-				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				bufferCopyRegion.imageSubresource.mipLevel = level;
-				bufferCopyRegion.imageSubresource.baseArrayLayer = layer;
-				bufferCopyRegion.imageSubresource.layerCount = 1;
-				bufferCopyRegion.imageExtent.width = ktxTexture->baseWidth >> level;
-				bufferCopyRegion.imageExtent.height = ktxTexture->baseHeight >> level;
-				bufferCopyRegion.imageExtent.depth = 1;
-				bufferCopyRegion.bufferOffset = offset;
-
-				bufferCopyRegions.push_back(bufferCopyRegion);
-			}
+			// Planes are copied separately, the chroma plane follows the luma plane in the slot
+			bufferCopyRegions[0].imageSubresource.aspectMask = VK_IMAGE_ASPECT_PLANE_0_BIT;
+			bufferCopyRegions[1].imageSubresource = { VK_IMAGE_ASPECT_PLANE_1_BIT, 0, 0, 1 };
+			bufferCopyRegions[1].imageExtent = { width / 2, height / 2, 1 };
+			bufferCopyRegions[1].bufferOffset = slot * slotSize + static_cast<VkDeviceSize>(width) * height;
+			regionCount = 2;
 		}
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.buffer, slotImages[slot].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regionCount, bufferCopyRegions);
+
+		imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageBarrier.newLayout = imageLayout;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+	}
+
+	/** @brief Descriptor of the image a slot is uploaded into, to be used by the commands recorded after recordUpload() for that slot */
+	const VkDescriptorImageInfo &StreamingTexture2D::getDescriptor(uint32_t slot) const
+	{
+		assert(slot < slotCount);
+		return slotImages[slot].descriptor;
+	}
+
+	/** @brief Size of the texture's contents in bytes, as expected by update() */
+	VkDeviceSize StreamingTexture2D::getImageSize() const
+	{
+		return imageSize;
+	}
+
+	/** @brief True if the sampler converts from Y'CbCr, it then has to be used as an immutable sampler */
+	bool StreamingTexture2D::usesYcbcrConversion() const
+	{
+		return ycbcrConversion != VK_NULL_HANDLE;
+	}
+
+	/**
+	* Load a 2D texture array including all mip levels
+	*
+	* @param filename File to load (supports .ktx)
+	* @param format Vulkan format of the image data stored in the file
+	* @param device Vulkan device to create the texture on
+	* @param copyQueue Ignored, see the upload note of vks::Texture
+	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
+	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	*
+	*/
+	void Texture2DArray::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	{
+		VKS_STARTUP_SCOPE(vks::StartupReport::Asset, filename);
+		vks::MappedFile file;
+		ktxTexture* ktxTexture;
+		ktxResult result = loadKTXFile(filename, &ktxTexture, file);
+		assert(result == KTX_SUCCESS);
+
+		this->device = device;
+		width = ktxTexture->baseWidth;
+		height = ktxTexture->baseHeight;
+		layerCount = ktxTexture->numLayers;
+		mipLevels = ktxTexture->numLevels;
 
 		// Create optimal tiled target image
 		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
@@ -597,16 +721,7 @@ namespace vks
 
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-		// Use a separate command buffer for texture loading
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &deviceMemory, &allocation));
 
 		// Image barrier for optimal image (target)
 		// Set initial layout for all array layers (faces) of the optimal (target) tiled texture
@@ -616,32 +731,22 @@ namespace vks
 		subresourceRange.levelCount = mipLevels;
 		subresourceRange.layerCount = layerCount;
 
+		vks::StagingRing *stagingRing = device->getStagingRing();
 		vks::tools::setImageLayout(
-			copyCmd,
+			stagingRing->getCommandBuffer(),
 			image,
 			VK_IMAGE_LAYOUT_UNDEFINED,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			subresourceRange);
 
-		// Copy the layers and mip levels from the staging buffer to the optimal tiled image
-		vkCmdCopyBufferToImage(
-			copyCmd,
-			stagingBuffer,
-			image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			static_cast<uint32_t>(bufferCopyRegions.size()),
-			bufferCopyRegions.data());
+		// Stream the layers and mip levels from the file into the staging ring, only one mip level is held in host memory at a time
+		KTXUploadInfo uploadInfo = { stagingRing, image, false, layerCount };
+		result = ktxTexture_IterateLoadLevelFaces(ktxTexture, uploadLevelFace, &uploadInfo);
+		assert(result == KTX_SUCCESS);
 
-		// Change texture image layout to shader read after all faces have been copied
+		// Change texture image layout to shader read after all layers have been copied
 		this->imageLayout = imageLayout;
-		vks::tools::setImageLayout(
-			copyCmd,
-			image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			imageLayout,
-			subresourceRange);
-
-		device->flushCommandBuffer(copyCmd, copyQueue);
+		stagingRing->releaseImage(image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout);
 
 		// Create sampler
 		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
@@ -656,9 +761,10 @@ namespace vks
 		samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
 		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 		samplerCreateInfo.minLod = 0.0f;
-		samplerCreateInfo.maxLod = (float)mipLevels;
+		// The view limits the mip levels, so textures with different mip counts share the sampler
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
 		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->getSamplerCache()->get(samplerCreateInfo);
 
 		// Create image view
 		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
@@ -670,10 +776,9 @@ namespace vks
 		viewCreateInfo.image = image;
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
 
-		// Clean up staging resources
 		ktxTexture_Destroy(ktxTexture);
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+
+		setDebugName(filename);
 
 		// Update descriptor image info member that can be used for setting up descriptor sets
 		updateDescriptor();
@@ -685,80 +790,24 @@ namespace vks
 	* @param filename File to load (supports .ktx)
 	* @param format Vulkan format of the image data stored in the file
 	* @param device Vulkan device to create the texture on
-	* @param copyQueue Queue used for the texture staging copy commands (must support transfer)
+	* @param copyQueue Ignored, see the upload note of vks::Texture
 	* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
 	* @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
 	*
 	*/
 	void TextureCubeMap::loadFromFile(std::string filename, VkFormat format, vks::VulkanDevice *device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
 	{
+		VKS_STARTUP_SCOPE(vks::StartupReport::Asset, filename);
+		vks::MappedFile file;
 		ktxTexture* ktxTexture;
-		ktxResult result = loadKTXFile(filename, &ktxTexture);
+		ktxResult result = loadKTXFile(filename, &ktxTexture, file);
 		assert(result == KTX_SUCCESS);
 
 		this->device = device;
 		width = ktxTexture->baseWidth;
 		height = ktxTexture->baseHeight;
 		mipLevels = ktxTexture->numLevels;
-
-		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
-
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-
-		// Create a host-visible staging buffer that contains the raw image data
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = ktxTextureSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		// Get memory requirements for the staging buffer (alignment, memory type bits)
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-
-		memAllocInfo.allocationSize = memReqs.size;
-		// Get memory type index for a host visible buffer
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		// Copy texture data into staging buffer
-		uint8_t *data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
-
-		// Setup buffer copy regions for each face including all of its mip levels
-		std::vector<VkBufferImageCopy> bufferCopyRegions;
-
-		for (uint32_t face = 0; face < 6; face++)
-		{
-			for (uint32_t level = 0; level < mipLevels; level++)
-			{
-				ktx_size_t offset;
-				KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, level, 0, face, &offset);
-				assert(result == KTX_SUCCESS);
-
-				VkBufferImageCopy bufferCopyRegion = {};
-				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				bufferCopyRegion.imageSubresource.mipLevel = level;
-				bufferCopyRegion.imageSubresource.baseArrayLayer = face;
-				bufferCopyRegion.imageSubresource.layerCount = 1;
-				bufferCopyRegion.imageExtent.width = ktxTexture->baseWidth >> level;
-				bufferCopyRegion.imageExtent.height = ktxTexture->baseHeight >> level;
-				bufferCopyRegion.imageExtent.depth = 1;
-				bufferCopyRegion.bufferOffset = offset;
-
-				bufferCopyRegions.push_back(bufferCopyRegion);
-			}
-		}
+		layerCount = 6;
 
 		// Create optimal tiled target image
 		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
@@ -784,16 +833,7 @@ namespace vks
 
 		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-		// Use a separate command buffer for texture loading
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &deviceMemory, &allocation));
 
 		// Image barrier for optimal image (target)
 		// Set initial layout for all array layers (faces) of the optimal (target) tiled texture
@@ -803,32 +843,22 @@ namespace vks
 		subresourceRange.levelCount = mipLevels;
 		subresourceRange.layerCount = 6;
 
+		vks::StagingRing *stagingRing = device->getStagingRing();
 		vks::tools::setImageLayout(
-			copyCmd,
+			stagingRing->getCommandBuffer(),
 			image,
 			VK_IMAGE_LAYOUT_UNDEFINED,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			subresourceRange);
 
-		// Copy the cube map faces from the staging buffer to the optimal tiled image
-		vkCmdCopyBufferToImage(
-			copyCmd,
-			stagingBuffer,
-			image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			static_cast<uint32_t>(bufferCopyRegions.size()),
-			bufferCopyRegions.data());
+		// Stream the cube map faces from the file into the staging ring, only one mip level is held in host memory at a time
+		KTXUploadInfo uploadInfo = { stagingRing, image, true, 6 };
+		result = ktxTexture_IterateLoadLevelFaces(ktxTexture, uploadLevelFace, &uploadInfo);
+		assert(result == KTX_SUCCESS);
 
 		// Change texture image layout to shader read after all faces have been copied
 		this->imageLayout = imageLayout;
-		vks::tools::setImageLayout(
-			copyCmd,
-			image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			imageLayout,
-			subresourceRange);
-
-		device->flushCommandBuffer(copyCmd, copyQueue);
+		stagingRing->releaseImage(image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout);
 
 		// Create sampler
 		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
@@ -843,9 +873,10 @@ namespace vks
 		samplerCreateInfo.anisotropyEnable = device->enabledFeatures.samplerAnisotropy;
 		samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
 		samplerCreateInfo.minLod = 0.0f;
-		samplerCreateInfo.maxLod = (float)mipLevels;
+		// The view limits the mip levels, so textures with different mip counts share the sampler
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
 		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		sampler = device->getSamplerCache()->get(samplerCreateInfo);
 
 		// Create image view
 		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
@@ -857,10 +888,9 @@ namespace vks
 		viewCreateInfo.image = image;
 		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
 
-		// Clean up staging resources
 		ktxTexture_Destroy(ktxTexture);
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+
+		setDebugName(filename);
 
 		// Update descriptor image info member that can be used for setting up descriptor sets
 		updateDescriptor();
@@ -20,6 +20,7 @@
 
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
+#include "VulkanMappedFile.hpp"
 #include "VulkanTools.h"
 
 #if defined(__ANDROID__)
@@ -28,6 +29,15 @@
 
 namespace vks
 {
+/**
+* @brief Base class of the texture types
+*
+* @note Texture data is uploaded through the device's staging ring (vks::StagingRing), the copyQueue argument of the loading functions
+* is ignored. The copies go to a transfer queue of a separate queue family if the device has one (followed by a queue family ownership
+* transfer to the graphics queue), otherwise to the graphics queue. The texture only becomes visible to the GPU after the next
+* stagingRing->submit(), which prepareFrame() and flushCommandBuffer() (with the device's default command pool) do before their own
+* submissions. Work submitted to a queue directly has to call it first.
+*/
 class Texture
 {
   public:
@@ -35,6 +45,7 @@ class Texture
 	VkImage               image;
 	VkImageLayout         imageLayout;
 	VkDeviceMemory        deviceMemory;
+	vks::MemoryAllocation allocation;
 	VkImageView           view;
 	uint32_t              width, height;
 	uint32_t              mipLevels;
@@ -43,8 +54,10 @@ class Texture
 	VkSampler             sampler;
 
 	void      updateDescriptor();
+	void      getDescriptorEXT(PFN_vkGetDescriptorEXT vkGetDescriptorEXT, size_t descriptorSize, void *target) const;
 	void      destroy();
-	ktxResult loadKTXFile(std::string filename, ktxTexture **target);
+	void      setDebugName(const std::string &name);
+	ktxResult loadKTXFile(std::string filename, ktxTexture **target, vks::MappedFile &file);
 };
 
 class Texture2D : public Texture
@@ -56,8 +69,7 @@ class Texture2D : public Texture
 	    vks::VulkanDevice *device,
 	    VkQueue            copyQueue,
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
-	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-	    bool               forceLinear     = false);
+	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	void fromBuffer(
 	    void *             buffer,
 	    VkDeviceSize       bufferSize,
@@ -69,6 +81,83 @@ class Texture2D : public Texture
 	    VkFilter           filter          = VK_FILTER_LINEAR,
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	void fromRGBBuffer(
+	    const void *       buffer,
+	    uint32_t           texWidth,
+	    uint32_t           texHeight,
+	    vks::VulkanDevice *device,
+	    VkQueue            copyQueue,
+	    VkFilter           filter          = VK_FILTER_LINEAR,
+	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  private:
+	void fromStagingRegion(
+	    const vks::StagingRing::Region &stagingRegion,
+	    VkFormat                        format,
+	    VkFilter                        filter,
+	    VkImageUsageFlags               imageUsageFlags,
+	    VkImageLayout                   imageLayout);
+};
+
+/**
+* Single level 2D texture that is updated from host memory every frame (video, camera images)
+*
+* The texture has one optimal tiled device local image per slot, its contents are written into the slot's part of a persistently mapped staging
+* buffer and copied into the slot's image by commands recorded with recordUpload(), so there is no staging allocation per update and an upload
+* never has to wait for other frames still sampling the texture. Slots are reused once the command buffer recording their upload has finished,
+* which the example base waits for on the command buffer's fence in prepareFrame(), so a frame is displayed one frame after it has been written.
+*
+* Usage:
+*	texture.create(VK_FORMAT_R8G8B8A8_UNORM, width, height, static_cast<uint32_t>(drawCmdBuffers.size()), vulkanDevice);
+*	// Record texture.recordUpload(drawCmdBuffers[i], i) outside of the render pass that samples texture.getDescriptor(i)
+*	// Per frame, after prepareFrame() has waited for the command buffer's previous submission
+*	texture.update(currentBuffer, pixels);
+*
+* Video frames in VK_FORMAT_G8_B8R8_2PLANE_420_UNORM (NV12, a full resolution luma plane followed by a half resolution interleaved chroma plane)
+* are converted to RGB by the sampler through a sampler Y'CbCr conversion, so they are uploaded as decoded without color conversion on the CPU.
+* This requires a Vulkan 1.1 device with the samplerYcbcrConversion feature enabled, and the sampler has to be set as the immutable sampler of
+* the descriptor set layout binding.
+*
+* @note Each update replaces the whole image, the previous contents are discarded
+*/
+class StreamingTexture2D : public Texture
+{
+  public:
+	void  create(
+	     VkFormat           format,
+	     uint32_t           texWidth,
+	     uint32_t           texHeight,
+	     uint32_t           slotCount,
+	     vks::VulkanDevice *device,
+	     VkFilter           filter          = VK_FILTER_LINEAR,
+	     VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT);
+	void  destroy();
+	void *getSlotData(uint32_t slot);
+	void  update(uint32_t slot, const void *data);
+	void  recordUpload(VkCommandBuffer commandBuffer, uint32_t slot);
+	const VkDescriptorImageInfo &getDescriptor(uint32_t slot) const;
+	VkDeviceSize getImageSize() const;
+	bool  usesYcbcrConversion() const;
+
+	static bool isFormatSupported(vks::VulkanDevice *device, VkFormat format);
+
+  private:
+	struct SlotImage
+	{
+		VkImage               image = VK_NULL_HANDLE;
+		VkDeviceMemory        memory = VK_NULL_HANDLE;
+		vks::MemoryAllocation allocation;
+		VkImageView           view = VK_NULL_HANDLE;
+		VkDescriptorImageInfo descriptor;
+	};
+	std::vector<SlotImage>   slotImages;
+	vks::Buffer              stagingBuffer;
+	VkDeviceSize             imageSize = 0;
+	VkDeviceSize             slotSize  = 0;
+	uint32_t                 slotCount = 0;
+	VkFormat                 format = VK_FORMAT_UNDEFINED;
+	VkSamplerYcbcrConversion ycbcrConversion = VK_NULL_HANDLE;
 };
 
 class Texture2DArray : public Texture
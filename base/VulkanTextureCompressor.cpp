@@ -0,0 +1,408 @@
+/*
+* Compute shader texture block compressor
+*
+* Encodes uncompressed RGBA8 images (e.g. decoded png and jpg files) into block compressed formats on the GPU at load time, so they take
+* four to eight times less memory and sampling bandwidth without converting the source files offline
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTextureCompressor.h"
+#include "VulkanDevice.h"
+#include <fstream>
+
+namespace vks
+{
+	const uint32_t TextureCompressor::cacheMagic;
+	const uint32_t TextureCompressor::cacheVersion;
+
+	// Encoder selected in the shader, has to match texturecompress.comp
+	enum CompressionMode : uint32_t
+	{
+		ModeBC1 = 0,
+		ModeBC3 = 1,
+		ModeBC5 = 2,
+		ModeBC7 = 3,
+		ModeETC2RGB = 4,
+		ModeETC2RGBA = 5
+	};
+
+	struct PushConstants
+	{
+		uint32_t mode;
+		uint32_t level;
+		uint32_t width;
+		uint32_t height;
+		uint32_t blocksX;
+		uint32_t blocksY;
+		// In 32 bit words
+		uint32_t outputOffset;
+	};
+
+	static bool getMode(VkFormat format, uint32_t &mode)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+			mode = ModeBC1;
+			return true;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+			mode = ModeBC3;
+			return true;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			mode = ModeBC5;
+			return true;
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+			mode = ModeBC7;
+			return true;
+		case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+			mode = ModeETC2RGB;
+			return true;
+		case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+			mode = ModeETC2RGBA;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	/**
+	* @param device Device to create the compute pipeline on
+	* @param shaderFile SPIR-V file of the "base/texturecompress.comp" shader
+	* @param highQuality Select BC7 for all images on devices with BC support, instead of BC1 for opaque and BC3 for transparent images
+	*
+	* @note If the device has neither BC nor ETC2 compression enabled or the shader can't be loaded, no pipeline is created and isSupported() returns false
+	*/
+	TextureCompressor::TextureCompressor(vks::VulkanDevice *device, const std::string &shaderFile, bool highQuality) : device(device), highQuality(highQuality)
+	{
+		if (!device->enabledFeatures.textureCompressionBC && !device->enabledFeatures.textureCompressionETC2)
+		{
+			return;
+		}
+
+#if defined(__ANDROID__)
+		shaderModule = vks::tools::loadShader(androidApp->activity->assetManager, shaderFile.c_str(), device->logicalDevice);
+#else
+		shaderModule = vks::tools::loadShader(shaderFile.c_str(), device->logicalDevice);
+#endif
+		if (shaderModule == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		// Texels are fetched without filtering
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+		samplerCreateInfo.maxAnisotropy = 1.0f;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCI.stage.module = shaderModule;
+		pipelineCI.stage.pName = "main";
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline));
+
+		supported = true;
+	}
+
+	TextureCompressor::~TextureCompressor()
+	{
+		releaseTransientResources();
+		if (pipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+		}
+		if (pipelineLayout)
+		{
+			vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		}
+		if (descriptorSetLayout)
+		{
+			vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		}
+		if (sampler)
+		{
+			vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		}
+		if (shaderModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, shaderModule, nullptr);
+		}
+	}
+
+	/** @brief True if a block compression feature is enabled on the device and the compute pipeline has been created */
+	bool TextureCompressor::isSupported() const
+	{
+		return supported;
+	}
+
+	/** @brief True if the compressor can encode the format and the device supports sampling it with linear filtering */
+	bool TextureCompressor::isFormatSupported(VkFormat format) const
+	{
+		uint32_t mode;
+		if (!supported || !getMode(format, mode))
+		{
+			return false;
+		}
+		const bool etc2 = (mode == ModeETC2RGB) || (mode == ModeETC2RGBA);
+		if ((etc2 && !device->enabledFeatures.textureCompressionETC2) || (!etc2 && !device->enabledFeatures.textureCompressionBC))
+		{
+			return false;
+		}
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+		const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
+	}
+
+	/**
+	* Compressed format for a color image on this device, VK_FORMAT_UNDEFINED if none is supported
+	*
+	* BC formats are preferred over ETC2, as desktop devices that also expose ETC2 often decompress it in the driver
+	*/
+	VkFormat TextureCompressor::getFormat(bool hasAlpha) const
+	{
+		const VkFormat candidates[] = {
+			highQuality ? VK_FORMAT_BC7_UNORM_BLOCK : (hasAlpha ? VK_FORMAT_BC3_UNORM_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK),
+			hasAlpha ? VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK : VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK,
+		};
+		for (VkFormat format : candidates)
+		{
+			if (isFormatSupported(format))
+			{
+				return format;
+			}
+		}
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	/** @brief Size of a 4x4 block of the format in bytes, 0 for formats the compressor can't encode */
+	uint32_t TextureCompressor::getBlockSize(VkFormat format)
+	{
+		uint32_t mode;
+		if (!getMode(format, mode))
+		{
+			return 0;
+		}
+		return ((mode == ModeBC1) || (mode == ModeETC2RGB)) ? 8 : 16;
+	}
+
+	VkDeviceSize TextureCompressor::getLevelSize(VkFormat format, uint32_t width, uint32_t height, uint32_t layerCount)
+	{
+		return static_cast<VkDeviceSize>((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format) * layerCount;
+	}
+
+	VkDeviceSize TextureCompressor::getImageSize(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t layerCount)
+	{
+		VkDeviceSize size = 0;
+		for (uint32_t level = 0; level < mipLevels; level++)
+		{
+			size += getLevelSize(format, std::max(width >> level, 1u), std::max(height >> level, 1u), layerCount);
+		}
+		return size;
+	}
+
+	/**
+	* Record the compression of all mip levels and layers of an RGBA8 image into a buffer
+	*
+	* @param commandBuffer Command buffer to record into, the queue it is submitted to has to support compute
+	* @param sourceImage Image with the uncompressed mip chain, has to be created with VK_IMAGE_USAGE_SAMPLED_BIT in VK_FORMAT_R8G8B8A8_UNORM
+	* @param sourceImageLayout Current layout of all levels of the source image, which is left in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	* @param width Width of the first level
+	* @param height Height of the first level
+	* @param mipLevels Number of mip levels to compress
+	* @param layerCount Number of array layers
+	* @param format Compressed format, needs to be supported (see isFormatSupported())
+	* @param buffer Storage buffer the blocks are written to, laid out like CompressedImage::data, needs getImageSize() bytes from bufferOffset
+	* @param bufferOffset Offset of the first block in the buffer, has to be a multiple of four
+	*
+	* The blocks are made available to transfer reads (e.g. vkCmdCopyBufferToImage into the compressed image) and the host
+	*
+	* @note Image views and descriptors used by the commands have to be released with releaseTransientResources() once the command buffer has finished executing
+	*/
+	void TextureCompressor::compress(VkCommandBuffer commandBuffer, VkImage sourceImage, VkImageLayout sourceImageLayout, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t layerCount, VkFormat format, VkBuffer buffer, VkDeviceSize bufferOffset)
+	{
+		uint32_t mode;
+		if (!isFormatSupported(format) || !getMode(format, mode))
+		{
+			vks::tools::exitFatal("Texture compression is not supported for format " + std::to_string(format) + " on this device", -1);
+		}
+		assert(bufferOffset % 4 == 0);
+
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, layerCount };
+		if (sourceImageLayout != VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		{
+			VkImageMemoryBarrier imageMemoryBarrier = vks::initializers::imageMemoryBarrier();
+			imageMemoryBarrier.oldLayout = sourceImageLayout;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageMemoryBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			imageMemoryBarrier.image = sourceImage;
+			imageMemoryBarrier.subresourceRange = subresourceRange;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		}
+
+		VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		viewCreateInfo.subresourceRange = subresourceRange;
+		viewCreateInfo.image = sourceImage;
+		VkImageView view;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
+		transientViews.push_back(view);
+
+		VkDescriptorPool descriptorPool;
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
+		transientPools.push_back(descriptorPool);
+
+		VkDescriptorSet descriptorSet;
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+		VkDescriptorImageInfo imageInfo = vks::initializers::descriptorImageInfo(sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkDescriptorBufferInfo bufferInfo = { buffer, 0, VK_WHOLE_SIZE };
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageInfo),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &bufferInfo),
+		};
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		VkDeviceSize offset = bufferOffset;
+		for (uint32_t level = 0; level < mipLevels; level++)
+		{
+			PushConstants pushConstants{};
+			pushConstants.mode = mode;
+			pushConstants.level = level;
+			pushConstants.width = std::max(width >> level, 1u);
+			pushConstants.height = std::max(height >> level, 1u);
+			pushConstants.blocksX = (pushConstants.width + 3) / 4;
+			pushConstants.blocksY = (pushConstants.height + 3) / 4;
+			pushConstants.outputOffset = static_cast<uint32_t>(offset / 4);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+			// One invocation per block, 8x8 blocks per workgroup
+			vkCmdDispatch(commandBuffer, (pushConstants.blocksX + 7) / 8, (pushConstants.blocksY + 7) / 8, layerCount);
+			offset += getLevelSize(format, pushConstants.width, pushConstants.height, layerCount);
+		}
+
+		VkBufferMemoryBarrier bufferMemoryBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+		bufferMemoryBarrier.buffer = buffer;
+		bufferMemoryBarrier.offset = bufferOffset;
+		bufferMemoryBarrier.size = offset - bufferOffset;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+	}
+
+	/** @brief Release the image views and descriptor pools of all recorded compressions, the command buffers they were recorded to must have finished executing */
+	void TextureCompressor::releaseTransientResources()
+	{
+		for (auto view : transientViews)
+		{
+			vkDestroyImageView(device->logicalDevice, view, nullptr);
+		}
+		for (auto pool : transientPools)
+		{
+			vkDestroyDescriptorPool(device->logicalDevice, pool, nullptr);
+		}
+		transientViews.clear();
+		transientPools.clear();
+	}
+
+	/**
+	* Load a compressed image from a texture cache file written by writeCache
+	*
+	* @param filename Texture cache file
+	* @param sourceHash Hash of the encoded source image, the cache is stale if it changed
+	* @param image Compressed image to load into
+	*
+	* @return False if there is no valid cache for the source, or if it holds a format this compressor wouldn't select on this device
+	*/
+	bool TextureCompressor::readCache(const std::string &filename, uint64_t sourceHash, CompressedImage &image) const
+	{
+#if defined(__ANDROID__)
+		return false;
+#else
+		std::ifstream file(filename, std::ios::binary);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		uint32_t header[8];
+		uint64_t hash = 0, size = 0;
+		file.read(reinterpret_cast<char*>(header), sizeof(header));
+		file.read(reinterpret_cast<char*>(&hash), sizeof(hash));
+		file.read(reinterpret_cast<char*>(&size), sizeof(size));
+		if (!file.good() || (header[0] != cacheMagic) || (header[1] != cacheVersion) || (hash != sourceHash))
+		{
+			return false;
+		}
+		image.format = static_cast<VkFormat>(header[2]);
+		image.width = header[3];
+		image.height = header[4];
+		image.mipLevels = header[5];
+		image.layerCount = header[6];
+		image.hasAlpha = header[7] != 0;
+		if ((image.format != getFormat(image.hasAlpha)) || (size != getImageSize(image.format, image.width, image.height, image.mipLevels, image.layerCount)))
+		{
+			return false;
+		}
+		image.data.resize(static_cast<size_t>(size));
+		file.read(reinterpret_cast<char*>(image.data.data()), size);
+		if (!file.good())
+		{
+			image.data.clear();
+			return false;
+		}
+		return true;
+#endif
+	}
+
+	/** @brief Store a compressed image in a texture cache file, so later loads of the same source image can skip decoding and compressing it */
+	void TextureCompressor::writeCache(const std::string &filename, uint64_t sourceHash, const CompressedImage &image) const
+	{
+#if !defined(__ANDROID__)
+		const uint32_t header[8] = { cacheMagic, cacheVersion, static_cast<uint32_t>(image.format), image.width, image.height, image.mipLevels, image.layerCount, image.hasAlpha ? 1u : 0u };
+		const uint64_t size = image.data.size();
+		std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+		if (file.is_open())
+		{
+			file.write(reinterpret_cast<const char*>(header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(&sourceHash), sizeof(sourceHash));
+			file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+			file.write(reinterpret_cast<const char*>(image.data.data()), image.data.size());
+		}
+		if (!file.good())
+		{
+			std::cerr << "Could not write texture cache file \"" << filename << "\"\n";
+		}
+#endif
+	}
+}
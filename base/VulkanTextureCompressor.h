@@ -0,0 +1,79 @@
+/*
+* Compute shader texture block compressor
+*
+* Encodes uncompressed RGBA8 images (e.g. decoded png and jpg files) into block compressed formats on the GPU at load time, so they take
+* four to eight times less memory and sampling bandwidth without converting the source files offline
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/** @brief Block compressed image with all mip levels, level after level (each with all of its layers) without padding */
+	struct CompressedImage
+	{
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipLevels = 0;
+		uint32_t layerCount = 1;
+		// Set if the source had texels that aren't fully opaque, selects the format for the image
+		bool hasAlpha = false;
+		std::vector<uint8_t> data;
+	};
+
+	/**
+	* Texture block compressor using the GLSL "base/texturecompress.comp" compute shader
+	*
+	* One invocation encodes one 4x4 block of a mip level of the source image into a storage buffer, from which the blocks are copied into the
+	* compressed image (or read back to be stored in a texture cache). Supported formats:
+	*	- BC1 (RGB, 8:1) and BC3 (RGBA, 4:1) with endpoints along the principal axis of the block
+	*	- BC5 (two channels, 2:1 to RG8), e.g. for normal maps of shaders that reconstruct z
+	*	- BC7 (RGBA, 4:1) in mode 6 only, higher quality than BC1 and BC3 for color and alpha
+	*	- ETC2 RGB8 (8:1) in the individual and differential modes and ETC2 RGBA8 (4:1) with an EAC alpha block, for mobile devices
+	*
+	* Encoders are single pass and favor speed over quality, they are meant as a replacement for uncompressed textures, not for offline encoders
+	*
+	* @note BC formats require the textureCompressionBC feature, ETC2 formats the textureCompressionETC2 feature to be enabled
+	* @note ASTC isn't supported, devices with ASTC support nearly always support ETC2 too
+	*/
+	class TextureCompressor
+	{
+	private:
+		static const uint32_t cacheMagic = 0x43545856;
+		static const uint32_t cacheVersion = 1;
+		vks::VulkanDevice *device;
+		bool highQuality;
+		bool supported = false;
+		VkShaderModule shaderModule = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		// Image views and descriptor pools of recorded dispatches, released by releaseTransientResources()
+		std::vector<VkImageView> transientViews;
+		std::vector<VkDescriptorPool> transientPools;
+	public:
+		TextureCompressor(vks::VulkanDevice *device, const std::string &shaderFile, bool highQuality = true);
+		~TextureCompressor();
+		bool isSupported() const;
+		bool isFormatSupported(VkFormat format) const;
+		VkFormat getFormat(bool hasAlpha) const;
+		static uint32_t getBlockSize(VkFormat format);
+		static VkDeviceSize getLevelSize(VkFormat format, uint32_t width, uint32_t height, uint32_t layerCount);
+		static VkDeviceSize getImageSize(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t layerCount);
+		void compress(VkCommandBuffer commandBuffer, VkImage sourceImage, VkImageLayout sourceImageLayout, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t layerCount, VkFormat format, VkBuffer buffer, VkDeviceSize bufferOffset);
+		void releaseTransientResources();
+		bool readCache(const std::string &filename, uint64_t sourceHash, CompressedImage &image) const;
+		void writeCache(const std::string &filename, uint64_t sourceHash, const CompressedImage &image) const;
+	};
+}
@@ -8,6 +8,17 @@
 
 #include "VulkanTools.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VKS_EXPAND_RGB_NEON
+#elif defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <tmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#define VKS_EXPAND_RGB_SSSE3
+#endif
+
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 // iOS & macOS: VulkanExampleBase::getAssetPath() implemented externally to allow access to Objective-C components
 const std::string getAssetPath()
@@ -77,6 +88,22 @@ namespace vks
 			}
 		}
 
+		std::string presentModeString(VkPresentModeKHR presentMode)
+		{
+			switch (presentMode)
+			{
+#define STR(r) case VK_PRESENT_MODE_ ##r ##_KHR: return #r
+				STR(IMMEDIATE);
+				STR(MAILBOX);
+				STR(FIFO);
+				STR(FIFO_RELAXED);
+				STR(SHARED_DEMAND_REFRESH);
+				STR(SHARED_CONTINUOUS_REFRESH);
+#undef STR
+			default: return "UNKNOWN_PRESENT_MODE";
+			}
+		}
+
 		VkBool32 getSupportedDepthFormat(VkPhysicalDevice physicalDevice, VkFormat *depthFormat)
 		{
 			// Since all depth formats may be optional, we need to find a suitable depth format to use
@@ -130,6 +157,21 @@ namespace vks
 			return false;
 		}
 
+		VkFormat getSupportedColorAttachmentFormat(VkPhysicalDevice physicalDevice, const std::vector<VkFormat>& formats)
+		{
+			const VkFormatFeatureFlags features = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+			for (auto& format : formats)
+			{
+				VkFormatProperties formatProps;
+				vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProps);
+				if ((formatProps.optimalTilingFeatures & features) == features)
+				{
+					return format;
+				}
+			}
+			return VK_FORMAT_UNDEFINED;
+		}
+
 		// Create an image memory barrier for changing the layout of
 		// an image and put it into an active command buffer
 		// See chapter 11.4 "Image Layout" for details
@@ -245,6 +287,43 @@ namespace vks
 				break;
 			}
 
+			// Stage masks of zero are derived from the access masks, so the barrier only waits for and blocks the stages accessing the image
+			// Shader accesses may come from any stage of any pipeline using the image, as do accesses of layouts not handled above
+			auto getStageMask = [](VkImageLayout layout, VkAccessFlags accessMask, VkPipelineStageFlags emptyStageMask) -> VkPipelineStageFlags {
+				const VkAccessFlags knownAccessMask = VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+					| VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+				if ((accessMask & ~knownAccessMask) || ((accessMask == 0) && (layout != VK_IMAGE_LAYOUT_UNDEFINED)))
+				{
+					return VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+				}
+				VkPipelineStageFlags stageMask = 0;
+				if (accessMask & VK_ACCESS_HOST_WRITE_BIT)
+				{
+					stageMask |= VK_PIPELINE_STAGE_HOST_BIT;
+				}
+				if (accessMask & (VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT))
+				{
+					stageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+				}
+				if (accessMask & VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT)
+				{
+					stageMask |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+				}
+				if (accessMask & VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT)
+				{
+					stageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+				}
+				return stageMask ? stageMask : emptyStageMask;
+			};
+			if (srcStageMask == 0)
+			{
+				srcStageMask = getStageMask(oldImageLayout, imageMemoryBarrier.srcAccessMask, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+			}
+			if (dstStageMask == 0)
+			{
+				dstStageMask = getStageMask(newImageLayout, imageMemoryBarrier.dstAccessMask, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+			}
+
 			// Put barrier inside setup command buffer
 			vkCmdPipelineBarrier(
 				cmdbuffer,
@@ -388,6 +467,39 @@ namespace vks
 		}
 #endif
 
+#if defined(__ANDROID__)
+		std::vector<char> loadShaderCode(AAssetManager* assetManager, const char *fileName)
+		{
+			std::vector<char> shaderCode;
+			AAsset* asset = AAssetManager_open(assetManager, fileName, AASSET_MODE_STREAMING);
+			if (asset)
+			{
+				shaderCode.resize(AAsset_getLength(asset));
+				AAsset_read(asset, shaderCode.data(), shaderCode.size());
+				AAsset_close(asset);
+			}
+			return shaderCode;
+		}
+#else
+		std::vector<char> loadShaderCode(const char *fileName)
+		{
+			std::vector<char> shaderCode;
+			std::ifstream is(fileName, std::ios::binary | std::ios::in | std::ios::ate);
+			if (is.is_open())
+			{
+				shaderCode.resize(static_cast<size_t>(is.tellg()));
+				is.seekg(0, std::ios::beg);
+				is.read(shaderCode.data(), shaderCode.size());
+				is.close();
+			}
+			else
+			{
+				std::cerr << "Error: Could not open shader file \"" << fileName << "\"" << "\n";
+			}
+			return shaderCode;
+		}
+#endif
+
 		bool fileExists(const std::string &filename)
 		{
 			std::ifstream f(filename.c_str());
@@ -399,5 +511,83 @@ namespace vks
 	        return (value + alignment - 1) & ~(alignment - 1);
         }
 
+#if defined(VKS_EXPAND_RGB_SSSE3)
+		// The SSSE3 path is compiled for the function only and selected at runtime, so the base library doesn't require SSSE3
+#if defined(__GNUC__) || defined(__clang__)
+		__attribute__((target("ssse3")))
+#endif
+		static size_t expandRGBToRGBASSSE3(const uint8_t *rgb, uint8_t *rgba, size_t pixelCount)
+		{
+			// Spreads four RGB pixels (12 bytes) over four RGBA pixels, the alpha bytes are zeroed and then set by the or
+			const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+			const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+			size_t i = 0;
+			// 16 pixels per iteration, read as three 16 byte loads without reading past the end of the source
+			for (; i + 16 <= pixelCount; i += 16)
+			{
+				const uint8_t *src = rgb + i * 3;
+				__m128i *dst = reinterpret_cast<__m128i*>(rgba + i * 4);
+				const __m128i in0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+				const __m128i in1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+				const __m128i in2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+				_mm_storeu_si128(dst + 0, _mm_or_si128(_mm_shuffle_epi8(in0, shuffle), alpha));
+				_mm_storeu_si128(dst + 1, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(in1, in0, 12), shuffle), alpha));
+				_mm_storeu_si128(dst + 2, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(in2, in1, 8), shuffle), alpha));
+				_mm_storeu_si128(dst + 3, _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(in2, 4), shuffle), alpha));
+			}
+			return i;
+		}
+
+		static bool cpuSupportsSSSE3()
+		{
+#if defined(_MSC_VER)
+			int cpuInfo[4];
+			__cpuid(cpuInfo, 1);
+			return (cpuInfo[2] & (1 << 9)) != 0;
+#else
+			return __builtin_cpu_supports("ssse3");
+#endif
+		}
+#endif
+
+		/**
+		* Expand RGB pixels to RGBA, e.g. directly into mapped staging memory, as most devices don't support sampling three component formats
+		*
+		* @param rgb Source pixels, three bytes each
+		* @param rgba Destination for the pixels, four bytes each, must not overlap the source
+		* @param pixelCount Number of pixels to expand
+		*/
+		void expandRGBToRGBA(const uint8_t *rgb, uint8_t *rgba, size_t pixelCount)
+		{
+			size_t i = 0;
+#if defined(VKS_EXPAND_RGB_NEON)
+			// vld3 deinterleaves 16 pixels into one register per channel, vst4 interleaves them again with the alpha register
+			uint8x16x4_t pixels;
+			pixels.val[3] = vdupq_n_u8(0xff);
+			for (; i + 16 <= pixelCount; i += 16)
+			{
+				const uint8x16x3_t channels = vld3q_u8(rgb + i * 3);
+				pixels.val[0] = channels.val[0];
+				pixels.val[1] = channels.val[1];
+				pixels.val[2] = channels.val[2];
+				vst4q_u8(rgba + i * 4, pixels);
+			}
+#elif defined(VKS_EXPAND_RGB_SSSE3)
+			static const bool hasSSSE3 = cpuSupportsSSSE3();
+			if (hasSSSE3)
+			{
+				i = expandRGBToRGBASSSE3(rgb, rgba, pixelCount);
+			}
+#endif
+			// Remaining pixels (or all of them without SIMD support)
+			for (; i < pixelCount; i++)
+			{
+				rgba[i * 4 + 0] = rgb[i * 3 + 0];
+				rgba[i * 4 + 1] = rgb[i * 3 + 1];
+				rgba[i * 4 + 2] = rgb[i * 3 + 2];
+				rgba[i * 4 + 3] = 0xff;
+			}
+		}
+
 	}
 }
@@ -75,24 +75,31 @@ namespace vks
 		/** @brief Returns the device type as a string */
 		std::string physicalDeviceTypeString(VkPhysicalDeviceType type);
 
+		/** @brief Returns the present mode as a string */
+		std::string presentModeString(VkPresentModeKHR presentMode);
+
 		// Selected a suitable supported depth format starting with 32 bit down to 16 bit
 		// Returns false if none of the depth formats in the list is supported by the device
 		VkBool32 getSupportedDepthFormat(VkPhysicalDevice physicalDevice, VkFormat *depthFormat);
 
 		// Returns tru a given format support LINEAR filtering
 		VkBool32 formatIsFilterable(VkPhysicalDevice physicalDevice, VkFormat format, VkImageTiling tiling);
+		// Returns the first format of the list that can be rendered to and sampled with optimal tiling, VK_FORMAT_UNDEFINED if none can
+		VkFormat getSupportedColorAttachmentFormat(VkPhysicalDevice physicalDevice, const std::vector<VkFormat>& formats);
 		// Returns true if a given format has a stencil part
 		VkBool32 formatHasStencil(VkFormat format);
 
 		// Put an image memory barrier for setting an image layout on the sub resource into the given command buffer
+		// Stage masks of zero are derived from the layouts' accesses (e.g. transfer for transfer layouts), shader accesses wait for all commands
+		// For batching several transitions into one barrier see vks::BarrierBatcher
 		void setImageLayout(
 			VkCommandBuffer cmdbuffer,
 			VkImage image,
 			VkImageLayout oldImageLayout,
 			VkImageLayout newImageLayout,
 			VkImageSubresourceRange subresourceRange,
-			VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-			VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+			VkPipelineStageFlags srcStageMask = 0,
+			VkPipelineStageFlags dstStageMask = 0);
 		// Uses a fixed sub resource layout with first mip level and layer
 		void setImageLayout(
 			VkCommandBuffer cmdbuffer,
@@ -100,8 +107,8 @@ namespace vks
 			VkImageAspectFlags aspectMask,
 			VkImageLayout oldImageLayout,
 			VkImageLayout newImageLayout,
-			VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-			VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+			VkPipelineStageFlags srcStageMask = 0,
+			VkPipelineStageFlags dstStageMask = 0);
 
 		/** @brief Insert an image memory barrier into the command buffer */
 		void insertImageMemoryBarrier(
@@ -125,10 +132,19 @@ namespace vks
 #else
 		VkShaderModule loadShader(const char *fileName, VkDevice device);
 #endif
+		// Read the code of a SPIR-V shader (binary) without creating a module, returns an empty vector if the file can't be read
+#if defined(__ANDROID__)
+		std::vector<char> loadShaderCode(AAssetManager* assetManager, const char *fileName);
+#else
+		std::vector<char> loadShaderCode(const char *fileName);
+#endif
 
 		/** @brief Checks if a file exists */
 		bool fileExists(const std::string &filename);
 
 		uint32_t alignedSize(uint32_t value, uint32_t alignment);
+
+		/** @brief Expands tightly packed 8 bit RGB pixels to RGBA with opaque alpha, using SSSE3 or NEON shuffles where available */
+		void expandRGBToRGBA(const uint8_t *rgb, uint8_t *rgba, size_t pixelCount);
 	}
 }
@@ -0,0 +1,228 @@
+/*
+* CPU trace recorder
+*
+* Records named CPU scopes of all threads into per-thread buffers and saves them as a Chrome trace event JSON file, which can be
+* opened in chrome://tracing or ui.perfetto.dev. GPU scopes measured by vks::GpuProfiler can be merged into the same timeline.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanTrace.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vks
+{
+	namespace
+	{
+		struct Scope {
+			const char *name;
+			uint64_t begin;
+			uint64_t end;
+		};
+
+		struct GpuScope {
+			std::string name;
+			uint64_t begin;
+			uint64_t end;
+		};
+
+		/** @brief Scopes of one thread, only written by that thread */
+		struct ThreadBuffer {
+			uint32_t threadId = 0;
+			std::string name;
+			std::vector<Scope> scopes;
+			// Number of written scopes, published with release semantics so save() can read them while the thread keeps recording
+			std::atomic<uint32_t> count{ 0 };
+			std::atomic<uint32_t> dropped{ 0 };
+		};
+
+		struct TraceState {
+			// Guards the list of buffers, the thread names and the GPU scopes
+			std::mutex mutex;
+			std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+			std::vector<GpuScope> gpuScopes;
+			uint32_t eventsPerThread = 0;
+			uint64_t startTime = 0;
+		};
+
+		TraceState &state()
+		{
+			static TraceState traceState;
+			return traceState;
+		}
+
+		// Buffer of the calling thread, nullptr until it records its first scope
+		thread_local ThreadBuffer *threadBuffer = nullptr;
+		// Name set before the thread's buffer was created
+		thread_local std::string pendingThreadName;
+
+		ThreadBuffer *getThreadBuffer()
+		{
+			if (!threadBuffer)
+			{
+				TraceState &traceState = state();
+				std::lock_guard<std::mutex> lock(traceState.mutex);
+				std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+				buffer->threadId = static_cast<uint32_t>(traceState.buffers.size()) + 1;
+				buffer->name = pendingThreadName.empty() ? ("thread " + std::to_string(buffer->threadId)) : pendingThreadName;
+				buffer->scopes.resize(traceState.eventsPerThread);
+				threadBuffer = buffer.get();
+				traceState.buffers.push_back(std::move(buffer));
+			}
+			return threadBuffer;
+		}
+
+		std::string jsonString(const std::string &value)
+		{
+			std::string escaped = "\"";
+			for (auto c : value)
+			{
+				if ((c == '"') || (c == '\\'))
+				{
+					escaped += '\\';
+				}
+				escaped += c;
+			}
+			return escaped + "\"";
+		}
+	}
+
+	std::atomic<bool> Tracer::active{ false };
+
+	/**
+	* Start recording scopes, the timeline of the trace starts at this point
+	*
+	* @param eventsPerThread Number of scopes each thread can record, further scopes are dropped
+	*/
+	void Tracer::start(uint32_t eventsPerThread)
+	{
+		TraceState &traceState = state();
+		{
+			std::lock_guard<std::mutex> lock(traceState.mutex);
+			traceState.eventsPerThread = eventsPerThread;
+			traceState.startTime = now();
+		}
+		active.store(true, std::memory_order_release);
+	}
+
+	/** @brief Current time in nanoseconds, the clock used for all scopes */
+	uint64_t Tracer::now()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	/** @brief Name of the calling thread in the trace, can be set before tracing has been started */
+	void Tracer::setThreadName(const std::string &name)
+	{
+		if (threadBuffer)
+		{
+			std::lock_guard<std::mutex> lock(state().mutex);
+			threadBuffer->name = name;
+		}
+		else
+		{
+			pendingThreadName = name;
+		}
+	}
+
+	/**
+	* Add a scope of the calling thread with explicit times (see now()), e.g. for work that doesn't fit into a block
+	*
+	* @param name Name of the scope, the pointer must stay valid until the trace has been saved
+	*/
+	void Tracer::addScope(const char *name, uint64_t begin, uint64_t end)
+	{
+		if (!isActive())
+		{
+			return;
+		}
+		ThreadBuffer *buffer = getThreadBuffer();
+		const uint32_t index = buffer->count.load(std::memory_order_relaxed);
+		if (index >= buffer->scopes.size())
+		{
+			buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		buffer->scopes[index] = { name, begin, end };
+		buffer->count.store(index + 1, std::memory_order_release);
+	}
+
+	/**
+	* Add a scope to the GPU track of the trace
+	*
+	* @param begin Start of the scope on the clock of now(), GPU timestamps need to be translated to it by the caller
+	*/
+	void Tracer::addGpuScope(const std::string &name, uint64_t begin, uint64_t end)
+	{
+		if (!isActive())
+		{
+			return;
+		}
+		TraceState &traceState = state();
+		std::lock_guard<std::mutex> lock(traceState.mutex);
+		traceState.gpuScopes.push_back({ name, begin, end });
+	}
+
+	/**
+	* Write all scopes recorded so far as Chrome trace event JSON
+	*
+	* @note Threads may keep recording while the trace is saved, scopes finished after a thread's buffer has been written aren't included
+	*
+	* @return False if the file couldn't be written
+	*/
+	bool Tracer::save(const std::string &filename)
+	{
+		TraceState &traceState = state();
+		std::lock_guard<std::mutex> lock(traceState.mutex);
+		std::ofstream file(filename, std::ios::out);
+		if (!file.is_open())
+		{
+			std::cerr << "Could not write trace to " << filename << "\n";
+			return false;
+		}
+		// Timestamps are in microseconds relative to the start of the trace
+		auto timestamp = [&traceState](uint64_t time) {
+			return static_cast<double>(static_cast<int64_t>(time - traceState.startTime)) / 1000.0;
+		};
+		file << std::fixed << std::setprecision(3);
+		file << "{\"traceEvents\":[\n";
+		file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"CPU\"}}";
+		uint64_t recorded = 0;
+		uint64_t dropped = 0;
+		for (auto &buffer : traceState.buffers)
+		{
+			file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":" << jsonString(buffer->name) << "}}";
+			const uint32_t count = buffer->count.load(std::memory_order_acquire);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const Scope &scope = buffer->scopes[i];
+				file << ",\n{\"name\":" << jsonString(scope.name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << timestamp(scope.begin) << ",\"dur\":" << static_cast<double>(scope.end - scope.begin) / 1000.0 << "}";
+			}
+			recorded += count;
+			dropped += buffer->dropped.load(std::memory_order_relaxed);
+		}
+		if (!traceState.gpuScopes.empty())
+		{
+			file << ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+			file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":2,\"tid\":1,\"args\":{\"name\":\"graphics queue\"}}";
+			for (auto &scope : traceState.gpuScopes)
+			{
+				file << ",\n{\"name\":" << jsonString(scope.name) << ",\"ph\":\"X\",\"pid\":2,\"tid\":1,\"ts\":" << timestamp(scope.begin) << ",\"dur\":" << static_cast<double>(scope.end - scope.begin) / 1000.0 << "}";
+			}
+		}
+		file << "\n],\n\"displayTimeUnit\":\"ms\",\n\"otherData\":{\"droppedScopes\":" << dropped << "}}\n";
+		std::cout << "Saved " << recorded << " CPU and " << traceState.gpuScopes.size() << " GPU scopes to " << filename;
+		if (dropped > 0)
+		{
+			std::cout << " (" << dropped << " scopes dropped, buffers were full)";
+		}
+		std::cout << "\n";
+		return true;
+	}
+}
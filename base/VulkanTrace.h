@@ -0,0 +1,85 @@
+/*
+* CPU trace recorder
+*
+* Records named CPU scopes of all threads into per-thread buffers and saves them as a Chrome trace event JSON file, which can be
+* opened in chrome://tracing or ui.perfetto.dev. GPU scopes measured by vks::GpuProfiler can be merged into the same timeline.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace vks
+{
+	/**
+	* Timeline of CPU scopes, recorded while tracing is active
+	*
+	* Usage:
+	*	vks::Tracer::start();
+	*	...
+	*	{
+	*		VKS_TRACE_SCOPE("updateUniformBuffers");
+	*		...
+	*	}
+	*	...
+	*	vks::Tracer::save("trace.json");
+	*
+	* Each thread appends its scopes to a fixed size buffer of its own, so recording takes no locks after a thread's first scope.
+	* Buffers are created on first use and kept after their thread has exited, so scopes of short lived threads (e.g. asynchronous
+	* loaders) are part of the trace. Scopes that don't fit into their thread's buffer are dropped and counted.
+	*
+	* @note Scope names must be string literals (or otherwise outlive the tracer), only their pointer is stored
+	* @note While tracing isn't active, a scope costs one relaxed atomic load
+	*/
+	class Tracer
+	{
+	private:
+		static std::atomic<bool> active;
+	public:
+		static void start(uint32_t eventsPerThread = 65536);
+		/** @brief True if scopes are being recorded */
+		static bool isActive()
+		{
+			return active.load(std::memory_order_relaxed);
+		}
+		static uint64_t now();
+		static void setThreadName(const std::string &name);
+		static void addScope(const char *name, uint64_t begin, uint64_t end);
+		static void addGpuScope(const std::string &name, uint64_t begin, uint64_t end);
+		static bool save(const std::string &filename);
+	};
+
+	/** @brief Records the lifetime of the object as a scope of the calling thread if tracing is active */
+	class TraceScope
+	{
+	private:
+		const char *name;
+		uint64_t begin = 0;
+	public:
+		explicit TraceScope(const char *name) : name(name)
+		{
+			if (Tracer::isActive())
+			{
+				begin = Tracer::now();
+			}
+		}
+		~TraceScope()
+		{
+			if (begin != 0)
+			{
+				Tracer::addScope(name, begin, Tracer::now());
+			}
+		}
+		TraceScope(const TraceScope &) = delete;
+		TraceScope &operator=(const TraceScope &) = delete;
+	};
+}
+
+#define VKS_TRACE_CONCAT_INNER(a, b) a##b
+#define VKS_TRACE_CONCAT(a, b) VKS_TRACE_CONCAT_INNER(a, b)
+/** @brief Traces the rest of the enclosing block as a scope with the given name (a string literal) */
+#define VKS_TRACE_SCOPE(name) vks::TraceScope VKS_TRACE_CONCAT(traceScope, __LINE__)(name)
@@ -8,6 +8,7 @@
 */
 
 #include "VulkanUIOverlay.h"
+#include "VulkanStartupReport.h"
 
 namespace vks 
 {
@@ -285,7 +286,7 @@ namespace vks
 			pipelineRenderingCreateInfo.colorAttachmentCount = 1;
 			pipelineRenderingCreateInfo.pColorAttachmentFormats = &colorFormat;
 			pipelineRenderingCreateInfo.depthAttachmentFormat = depthFormat;
-			pipelineRenderingCreateInfo.stencilAttachmentFormat = depthFormat;
+			pipelineRenderingCreateInfo.stencilAttachmentFormat = vks::tools::formatHasStencil(depthFormat) ? depthFormat : VK_FORMAT_UNDEFINED;
 			pipelineCreateInfo.pNext = &pipelineRenderingCreateInfo;
 		}
 #endif
@@ -307,50 +308,123 @@ namespace vks
 
 		pipelineCreateInfo.pVertexInputState = &vertexInputState;
 
+		VKS_STARTUP_SCOPE(vks::StartupReport::Pipeline, "UI overlay");
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 	}
 
 	/** Update vertex and index buffer containing the imGui elements when required */
+	/** Set the number of buffer pairs, one for each command buffer that draws the overlay (the buffers must not be in use) */
+	void UIOverlay::setBufferCount(uint32_t count)
+	{
+		for (size_t i = count; i < drawBuffers.size(); i++) {
+			drawBuffers[i].vertexBuffer.unmap();
+			drawBuffers[i].vertexBuffer.destroy();
+			drawBuffers[i].indexBuffer.unmap();
+			drawBuffers[i].indexBuffer.destroy();
+			drawBuffers[i].indirectBuffer.unmap();
+			drawBuffers[i].indirectBuffer.destroy();
+		}
+		drawBuffers.resize(count);
+	}
+
+	/**
+	* Get the draw commands of the current ImGui frame
+	*
+	* @return True if the number or the scissors of the draw commands changed or the buffers are too small, the buffers then have to be grown
+	* with allocateBuffers() and the command buffers have to be rebuilt. Otherwise only the buffer contents (including the index ranges of the
+	* indirect draws) change, which upload() writes without re-recording.
+	*/
 	bool UIOverlay::update()
 	{
 		ImDrawData* imDrawData = ImGui::GetDrawData();
-		bool updateCmdBuffers = false;
-
 		if (!imDrawData) { return false; };
 
-		// Note: Alignment is done inside buffer creation
-		VkDeviceSize vertexBufferSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
-		VkDeviceSize indexBufferSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
+		std::vector<DrawCommand> commands;
+		uint32_t firstIndex = 0;
+		int32_t vertexOffset = 0;
+		for (int32_t i = 0; i < imDrawData->CmdListsCount; i++)
+		{
+			const ImDrawList* cmd_list = imDrawData->CmdLists[i];
+			for (int32_t j = 0; j < cmd_list->CmdBuffer.Size; j++)
+			{
+				const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[j];
+				DrawCommand command{};
+				command.scissor.offset.x = std::max((int32_t)(pcmd->ClipRect.x), 0);
+				command.scissor.offset.y = std::max((int32_t)(pcmd->ClipRect.y), 0);
+				command.scissor.extent.width = (uint32_t)(pcmd->ClipRect.z - pcmd->ClipRect.x);
+				command.scissor.extent.height = (uint32_t)(pcmd->ClipRect.w - pcmd->ClipRect.y);
+				command.indexCount = pcmd->ElemCount;
+				command.firstIndex = firstIndex;
+				command.vertexOffset = vertexOffset;
+				commands.push_back(command);
+				firstIndex += pcmd->ElemCount;
+			}
+			vertexOffset += cmd_list->VtxBuffer.Size;
+		}
+
+		vertexDataSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
+		indexDataSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
 
-		// Update buffers only if vertex or index count has been changed compared to current buffer size
-		if ((vertexBufferSize == 0) || (indexBufferSize == 0)) {
-			return false;
+		bool changed = (commands.size() != drawCommands.size());
+		for (size_t i = 0; !changed && (i < commands.size()); i++) {
+			changed = memcmp(&commands[i].scissor, &drawCommands[i].scissor, sizeof(VkRect2D)) != 0;
+		}
+		drawCommands.swap(commands);
+		return changed || needsAllocation();
+	}
+
+	/** True if any of the buffers is too small for the draw data of the last update() */
+	bool UIOverlay::needsAllocation() const
+	{
+		for (auto& buffers : drawBuffers) {
+			if ((buffers.vertexBuffer.size < vertexDataSize) || (buffers.indexBuffer.size < indexDataSize) || (buffers.indirectBuffer.size < drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand))) {
+				return true;
+			}
 		}
+		return false;
+	}
 
-		// Vertex buffer
-		if ((vertexBuffer.buffer == VK_NULL_HANDLE) || (vertexCount != imDrawData->TotalVtxCount)) {
-			vertexBuffer.unmap();
-			vertexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &vertexBuffer, vertexBufferSize));
-			vertexCount = imDrawData->TotalVtxCount;
-			vertexBuffer.unmap();
-			vertexBuffer.map();
-			updateCmdBuffers = true;
+	/** Grow the buffers that are too small for the current draw data, doubling their size so they're rarely reallocated (the buffers must not be in use) */
+	void UIOverlay::allocateBuffers()
+	{
+		for (auto& buffers : drawBuffers) {
+			if (buffers.vertexBuffer.size < vertexDataSize) {
+				VkDeviceSize size = std::max<VkDeviceSize>(buffers.vertexBuffer.size * 2, vertexDataSize);
+				buffers.vertexBuffer.unmap();
+				buffers.vertexBuffer.destroy();
+				VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &buffers.vertexBuffer, size));
+				buffers.vertexBuffer.map();
+			}
+			if (buffers.indexBuffer.size < indexDataSize) {
+				VkDeviceSize size = std::max<VkDeviceSize>(buffers.indexBuffer.size * 2, indexDataSize);
+				buffers.indexBuffer.unmap();
+				buffers.indexBuffer.destroy();
+				VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &buffers.indexBuffer, size));
+				buffers.indexBuffer.map();
+			}
+			const VkDeviceSize indirectDataSize = drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand);
+			if (buffers.indirectBuffer.size < indirectDataSize) {
+				VkDeviceSize size = std::max<VkDeviceSize>(buffers.indirectBuffer.size * 2, indirectDataSize);
+				buffers.indirectBuffer.unmap();
+				buffers.indirectBuffer.destroy();
+				VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &buffers.indirectBuffer, size));
+				buffers.indirectBuffer.map();
+			}
 		}
+	}
 
-		// Index buffer
-		if ((indexBuffer.buffer == VK_NULL_HANDLE) || (indexCount < imDrawData->TotalIdxCount)) {
-			indexBuffer.unmap();
-			indexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &indexBuffer, indexBufferSize));
-			indexCount = imDrawData->TotalIdxCount;
-			indexBuffer.map();
-			updateCmdBuffers = true;
+	/** Write the vertices, indices and draw index ranges of the current ImGui frame to the buffers of a command buffer that is no longer in use */
+	void UIOverlay::upload(uint32_t bufferIndex)
+	{
+		ImDrawData* imDrawData = ImGui::GetDrawData();
+		if ((!imDrawData) || (bufferIndex >= drawBuffers.size()) || (vertexDataSize == 0) || (indexDataSize == 0)) {
+			return;
 		}
+		DrawBuffers& buffers = drawBuffers[bufferIndex];
+		assert((buffers.vertexBuffer.size >= vertexDataSize) && (buffers.indexBuffer.size >= indexDataSize) && (buffers.indirectBuffer.size >= drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand)));
 
-		// Upload data
-		ImDrawVert* vtxDst = (ImDrawVert*)vertexBuffer.mapped;
-		ImDrawIdx* idxDst = (ImDrawIdx*)indexBuffer.mapped;
+		ImDrawVert* vtxDst = (ImDrawVert*)buffers.vertexBuffer.mapped;
+		ImDrawIdx* idxDst = (ImDrawIdx*)buffers.indexBuffer.mapped;
 
 		for (int n = 0; n < imDrawData->CmdListsCount; n++) {
 			const ImDrawList* cmd_list = imDrawData->CmdLists[n];
@@ -360,20 +434,25 @@ namespace vks
 			idxDst += cmd_list->IdxBuffer.Size;
 		}
 
-		// Flush to make writes visible to GPU
-		vertexBuffer.flush();
-		indexBuffer.flush();
+		VkDrawIndexedIndirectCommand* drawDst = (VkDrawIndexedIndirectCommand*)buffers.indirectBuffer.mapped;
+		for (size_t i = 0; i < drawCommands.size(); i++) {
+			drawDst[i].indexCount = drawCommands[i].indexCount;
+			drawDst[i].instanceCount = 1;
+			drawDst[i].firstIndex = drawCommands[i].firstIndex;
+			drawDst[i].vertexOffset = drawCommands[i].vertexOffset;
+			drawDst[i].firstInstance = 0;
+		}
 
-		return updateCmdBuffers;
+		// Flushed to make the writes visible to the GPU with the next batched flush (see VulkanDevice::flushMappedRanges())
+		buffers.vertexBuffer.markDirty(vertexDataSize);
+		buffers.indexBuffer.markDirty(indexDataSize);
+		buffers.indirectBuffer.markDirty(drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand));
 	}
 
-	void UIOverlay::draw(const VkCommandBuffer commandBuffer)
+	/** Record the draw commands from the last update() using the buffers at bufferIndex, which upload() fills before each submission */
+	void UIOverlay::draw(const VkCommandBuffer commandBuffer, uint32_t bufferIndex)
 	{
-		ImDrawData* imDrawData = ImGui::GetDrawData();
-		int32_t vertexOffset = 0;
-		int32_t indexOffset = 0;
-
-		if ((!imDrawData) || (imDrawData->CmdListsCount == 0)) {
+		if (drawCommands.empty() || (bufferIndex >= drawBuffers.size()) || (drawBuffers[bufferIndex].vertexBuffer.buffer == VK_NULL_HANDLE)) {
 			return;
 		}
 
@@ -387,25 +466,13 @@ namespace vks
 		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 
 		VkDeviceSize offsets[1] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &drawBuffers[bufferIndex].vertexBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, drawBuffers[bufferIndex].indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
 
-		for (int32_t i = 0; i < imDrawData->CmdListsCount; i++)
-		{
-			const ImDrawList* cmd_list = imDrawData->CmdLists[i];
-			for (int32_t j = 0; j < cmd_list->CmdBuffer.Size; j++)
-			{
-				const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[j];
-				VkRect2D scissorRect;
-				scissorRect.offset.x = std::max((int32_t)(pcmd->ClipRect.x), 0);
-				scissorRect.offset.y = std::max((int32_t)(pcmd->ClipRect.y), 0);
-				scissorRect.extent.width = (uint32_t)(pcmd->ClipRect.z - pcmd->ClipRect.x);
-				scissorRect.extent.height = (uint32_t)(pcmd->ClipRect.w - pcmd->ClipRect.y);
-				vkCmdSetScissor(commandBuffer, 0, 1, &scissorRect);
-				vkCmdDrawIndexed(commandBuffer, pcmd->ElemCount, 1, indexOffset, vertexOffset, 0);
-				indexOffset += pcmd->ElemCount;
-			}
-			vertexOffset += cmd_list->VtxBuffer.Size;
+		// The index ranges are read from the indirect buffer, which upload() rewrites for every submission
+		for (size_t i = 0; i < drawCommands.size(); i++) {
+			vkCmdSetScissor(commandBuffer, 0, 1, &drawCommands[i].scissor);
+			vkCmdDrawIndexedIndirect(commandBuffer, drawBuffers[bufferIndex].indirectBuffer.buffer, i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
 		}
 	}
 
@@ -417,8 +484,7 @@ namespace vks
 
 	void UIOverlay::freeResources()
 	{
-		vertexBuffer.destroy();
-		indexBuffer.destroy();
+		setBufferCount(0);
 		vkDestroyImageView(device->logicalDevice, fontView, nullptr);
 		vkDestroyImage(device->logicalDevice, fontImage, nullptr);
 		vkFreeMemory(device->logicalDevice, fontMemory, nullptr);
@@ -514,4 +580,21 @@ namespace vks
 		ImGui::TextV(formatstr, args);
 		va_end(args);
 	}
+
+	/**
+	* Plot the times of a frame time series from zero to slightly above their maximum, annotated with min, average, max and percentiles
+	*
+	* @note The vertex count of the graph only changes while the window fills, afterwards new values don't rebuild command buffers
+	*/
+	void UIOverlay::frameTimeGraph(const vks::FrameTimeHistory::Series& series, float width)
+	{
+		if (series.count() == 0) {
+			return;
+		}
+		const vks::FrameTimeHistory::Summary summary = series.summarize();
+		ImGui::Text("%s: %.2f ms avg, %.2f min, %.2f max", series.name.c_str(), summary.average, summary.min, summary.max);
+		ImGui::Text("p50 %.2f, p95 %.2f, p99 %.2f ms", summary.p50, summary.p95, summary.p99);
+		const std::string label = "##" + series.name;
+		ImGui::PlotLines(label.c_str(), series.data(), static_cast<int>(series.count()), static_cast<int>(series.getOffset()), nullptr, 0.0f, std::max(summary.max * 1.25f, 0.001f), ImVec2(width, 40.0f * scale));
+	}
 }
@@ -21,6 +21,7 @@
 #include "VulkanDebug.h"
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
+#include "VulkanFrameTimeHistory.h"
 
 #include "../external/imgui/imgui.h"
 
@@ -39,10 +40,24 @@ namespace vks
 		VkSampleCountFlagBits rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 		uint32_t subpass = 0;
 
-		vks::Buffer vertexBuffer;
-		vks::Buffer indexBuffer;
-		int32_t vertexCount = 0;
-		int32_t indexCount = 0;
+		// One pair per command buffer (swapchain image), so a frame's UI can be written while other frames are still in flight
+		struct DrawBuffers {
+			vks::Buffer vertexBuffer;
+			vks::Buffer indexBuffer;
+			// Index ranges of the draw commands, drawn indirectly so they can change (e.g. with the digits of a frame time) without re-recording
+			vks::Buffer indirectBuffer;
+		};
+		std::vector<DrawBuffers> drawBuffers;
+		// Draw commands of the current ImGui frame, the command buffers only need to be re-recorded if their number or scissors change
+		struct DrawCommand {
+			VkRect2D scissor;
+			uint32_t indexCount;
+			uint32_t firstIndex;
+			int32_t vertexOffset;
+		};
+		std::vector<DrawCommand> drawCommands;
+		VkDeviceSize vertexDataSize = 0;
+		VkDeviceSize indexDataSize = 0;
 
 		std::vector<VkPipelineShaderStageCreateInfo> shaders;
 
@@ -72,8 +87,12 @@ namespace vks
 		void preparePipeline(const VkPipelineCache pipelineCache, const VkRenderPass renderPass, const VkFormat colorFormat, const VkFormat depthFormat);
 		void prepareResources();
 
+		void setBufferCount(uint32_t count);
 		bool update();
-		void draw(const VkCommandBuffer commandBuffer);
+		bool needsAllocation() const;
+		void allocateBuffers();
+		void upload(uint32_t bufferIndex);
+		void draw(const VkCommandBuffer commandBuffer, uint32_t bufferIndex);
 		void resize(uint32_t width, uint32_t height);
 
 		void freeResources();
@@ -89,5 +108,6 @@ namespace vks
 		bool button(const char* caption);
 		bool colorPicker(const char* caption, float* color);
 		void text(const char* formatstr, ...);
+		void frameTimeGraph(const vks::FrameTimeHistory::Series& series, float width);
 	};
 }
@@ -0,0 +1,134 @@
+/*
+* Per-frame uniform ring allocator
+*
+* Hands out aligned slices of a persistently mapped uniform buffer for transient per-draw data, one region per frame in flight, and
+* returns the dynamic offsets to bind them with a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanUniformRing.h"
+#include "VulkanDevice.h"
+#include <algorithm>
+#include <stdexcept>
+#include <assert.h>
+
+namespace vks
+{
+	/**
+	* @param device Device to create the buffer on
+	* @param frameSize Bytes available to each frame, rounded up to the allocation alignment
+	* @param frameCount Number of frames that may be in flight, each gets a region of its own
+	* @param usage Buffer usage, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT also aligns allocations for dynamic storage buffer descriptors
+	*/
+	UniformRing::UniformRing(vks::VulkanDevice *device, VkDeviceSize frameSize, uint32_t frameCount, VkBufferUsageFlags usage) : device(device), frameCount(std::max(frameCount, 1u))
+	{
+		const VkPhysicalDeviceLimits &limits = device->properties.limits;
+		alignment = std::max(limits.minUniformBufferOffsetAlignment, (VkDeviceSize)16);
+		if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+		{
+			alignment = std::max(alignment, limits.minStorageBufferOffsetAlignment);
+		}
+		// Regions start at aligned offsets
+		this->frameSize = (std::max(frameSize, alignment) + alignment - 1) & ~(alignment - 1);
+		// Dynamic offsets are 32 bit
+		assert(this->frameSize * this->frameCount <= UINT32_MAX);
+		VK_CHECK_RESULT(device->createBuffer(
+			usage,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&buffer,
+			this->frameSize * this->frameCount));
+		VK_CHECK_RESULT(buffer.map());
+	}
+
+	UniformRing::~UniformRing()
+	{
+		buffer.destroy();
+	}
+
+	/**
+	* Size of a region that can hold a number of allocations on any device
+	*
+	* @param allocationCount Number of allocations per frame
+	* @param allocationSize Size of each allocation, rounded up to maxAlignment
+	*/
+	VkDeviceSize UniformRing::requiredFrameSize(uint32_t allocationCount, VkDeviceSize allocationSize)
+	{
+		return allocationCount * ((allocationSize + maxAlignment - 1) & ~(maxAlignment - 1));
+	}
+
+	/**
+	* Rewind the region of a frame, invalidating all allocations previously made from it
+	*
+	* @param frameIndex Frame in flight index, less than the frame count passed at construction
+	*/
+	void UniformRing::beginFrame(uint32_t frameIndex)
+	{
+		assert(frameIndex < frameCount);
+		currentFrame = frameIndex;
+		head = currentFrame * frameSize;
+		statistics.usedBytes = 0;
+		statistics.allocations = 0;
+	}
+
+	/**
+	* Allocate an aligned slice from the current frame's region
+	*
+	* @param size Size of the slice in bytes
+	*
+	* @return Host pointer and dynamic offset of the slice
+	*/
+	UniformRing::Allocation UniformRing::allocate(VkDeviceSize size)
+	{
+		const VkDeviceSize alignedSize = (std::max(size, (VkDeviceSize)1) + alignment - 1) & ~(alignment - 1);
+		const VkDeviceSize regionEnd = (currentFrame + 1) * frameSize;
+		if (head + alignedSize > regionEnd)
+		{
+			throw std::runtime_error("Uniform ring frame region of " + std::to_string(frameSize) + " bytes exhausted");
+		}
+		Allocation allocation;
+		allocation.data = static_cast<uint8_t*>(buffer.mapped) + head;
+		allocation.offset = static_cast<uint32_t>(head);
+		head += alignedSize;
+		statistics.usedBytes += alignedSize;
+		statistics.peakBytes = std::max(statistics.peakBytes, statistics.usedBytes);
+		statistics.allocations++;
+		return allocation;
+	}
+
+	/**
+	* Descriptor for binding the ring as a dynamic uniform (or storage) buffer
+	*
+	* @param range Size of the slices bound through the descriptor, the dynamic offset selects the slice
+	*/
+	VkDescriptorBufferInfo UniformRing::getDescriptor(VkDeviceSize range) const
+	{
+		VkDescriptorBufferInfo descriptor{};
+		descriptor.buffer = buffer.buffer;
+		descriptor.offset = 0;
+		descriptor.range = range;
+		return descriptor;
+	}
+
+	VkBuffer UniformRing::getBuffer() const
+	{
+		return buffer.buffer;
+	}
+
+	/** @brief Alignment of all allocations and dynamic offsets */
+	VkDeviceSize UniformRing::getAlignment() const
+	{
+		return alignment;
+	}
+
+	/** @brief Bytes available to each frame */
+	VkDeviceSize UniformRing::getFrameSize() const
+	{
+		return frameSize;
+	}
+
+	const UniformRing::Statistics &UniformRing::getStatistics() const
+	{
+		return statistics;
+	}
+}
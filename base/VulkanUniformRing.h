@@ -0,0 +1,94 @@
+/*
+* Per-frame uniform ring allocator
+*
+* Hands out aligned slices of a persistently mapped uniform buffer for transient per-draw data, one region per frame in flight, and
+* returns the dynamic offsets to bind them with a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstring>
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Linear allocator for per-frame uniform data
+	*
+	* Usage:
+	*	uniformRing.reset(new vks::UniformRing(vulkanDevice, vks::UniformRing::requiredFrameSize(objectCount, sizeof(ObjectData)), settings.framesInFlight));
+	*	// Dynamic uniform buffer descriptor covering one slice
+	*	VkDescriptorBufferInfo descriptor = uniformRing->getDescriptor(sizeof(ObjectData));
+	*	// Per frame, after prepareFrame() has waited for the frame slot
+	*	uniformRing->beginFrame(currentFrame);
+	*	uint32_t dynamicOffset = uniformRing->push(objectData);
+	*	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &dynamicOffset);
+	*
+	* The buffer is split into one region per frame in flight. beginFrame() rewinds the region of a frame, so data is written directly into
+	* the memory the GPU reads, without a host side copy or flush. Allocations are aligned to minUniformBufferOffsetAlignment (and to
+	* minStorageBufferOffsetAlignment if the ring is also used as a storage buffer).
+	*
+	* @note The GPU must have finished the previous frame that used a region before beginFrame() rewinds it, e.g. by passing the frame in
+	* flight index after prepareFrame() has waited for its fence
+	* @note Allocations exceeding the frame's region throw a std::runtime_error, see Statistics::peakBytes to size the regions
+	*/
+	class UniformRing
+	{
+	public:
+		/** @brief Upper limit of minUniformBufferOffsetAlignment and minStorageBufferOffsetAlignment guaranteed by the specification */
+		static const VkDeviceSize maxAlignment = 256;
+
+		/** @brief Slice of the current frame's region */
+		struct Allocation {
+			// Host pointer to the slice, valid until the frame's region is rewound
+			void *data;
+			// Offset of the slice in the buffer, passed as the dynamic offset
+			uint32_t offset;
+		};
+
+		struct Statistics {
+			// Bytes allocated from the current frame's region (including alignment padding)
+			VkDeviceSize usedBytes = 0;
+			// Most bytes allocated by a single frame
+			VkDeviceSize peakBytes = 0;
+			// Allocations made by the current frame
+			uint32_t allocations = 0;
+		};
+
+	private:
+		vks::VulkanDevice *device;
+		vks::Buffer buffer;
+		VkDeviceSize alignment;
+		VkDeviceSize frameSize;
+		uint32_t frameCount;
+		uint32_t currentFrame = 0;
+		// Next free byte of the current frame's region, relative to the start of the buffer
+		VkDeviceSize head = 0;
+		Statistics statistics;
+	public:
+		UniformRing(vks::VulkanDevice *device, VkDeviceSize frameSize, uint32_t frameCount, VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+		~UniformRing();
+		static VkDeviceSize requiredFrameSize(uint32_t allocationCount, VkDeviceSize allocationSize);
+		void beginFrame(uint32_t frameIndex);
+		Allocation allocate(VkDeviceSize size);
+		/** @brief Copies data into a new slice of the current frame's region and returns its dynamic offset */
+		template<typename T>
+		uint32_t push(const T &data)
+		{
+			Allocation allocation = allocate(sizeof(T));
+			memcpy(allocation.data, &data, sizeof(T));
+			return allocation.offset;
+		}
+		VkDescriptorBufferInfo getDescriptor(VkDeviceSize range) const;
+		VkBuffer getBuffer() const;
+		VkDeviceSize getAlignment() const;
+		VkDeviceSize getFrameSize() const;
+		const Statistics &getStatistics() const;
+	};
+}
@@ -0,0 +1,441 @@
+/*
+* Scene voxelizer
+*
+* Voxelizes triangle geometry (e.g. a glTF scene) into a clipmap of 3D textures centered on the camera with conservative rasterization,
+* so occlusion, global illumination approximations and particle collisions can query the scene with a single texture fetch per position
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanVoxelizer.h"
+#include "VulkanDevice.h"
+#include "VulkanglTFModel.h"
+#include "VulkanStartupReport.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+
+namespace vks
+{
+	const VkFormat Voxelizer::format;
+
+	/**
+	* @param device Device to create the voxel texture and pipeline on, with the geometryShader and fragmentStoresAndAtomics features enabled
+	* @param pipelineCache Pipeline cache used for creating the pipeline
+	* @param shaderFile Path of the "base/voxelize" shaders without extensions, ".vert.spv", ".geom.spv" and ".frag.spv" are appended
+	* @param resolution Number of voxels along each axis of a level
+	* @param levelCount Number of clipmap levels, limited to maxLevels and by the maximum 3D image size of the device
+	* @param extent World space size of the finest level, each further level doubles it
+	* @param conservativeRasterization Voxelize with overestimating conservative rasterization, requires VK_EXT_conservative_rasterization to be enabled
+	* @param snapVoxels Distance in voxels of a level the origins are snapped to
+	*
+	* @note If a required feature isn't enabled, the format can't be used as a storage image or the shaders can't be loaded, isSupported() returns false
+	*/
+	Voxelizer::Voxelizer(vks::VulkanDevice *device, VkPipelineCache pipelineCache, const std::string &shaderFile, uint32_t resolution, uint32_t levelCount, float extent, bool conservativeRasterization, uint32_t snapVoxels)
+		: device(device), conservativeRasterization(conservativeRasterization), resolution(resolution), snapVoxels(std::max(snapVoxels, 1u))
+	{
+		assert((resolution > 0) && (levelCount > 0) && (extent > 0.0f));
+		if (!device->enabledFeatures.geometryShader || !device->enabledFeatures.fragmentStoresAndAtomics)
+		{
+			return;
+		}
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+		const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+		if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures)
+		{
+			return;
+		}
+		levelCount = std::min({ levelCount, maxLevels, device->properties.limits.maxImageDimension3D / resolution });
+		if (levelCount == 0)
+		{
+			return;
+		}
+
+		std::array<VkPipelineShaderStageCreateInfo, 3> shaderStages{};
+		const std::array<std::pair<VkShaderStageFlagBits, const char*>, 3> stages = { {
+			{ VK_SHADER_STAGE_VERTEX_BIT, ".vert.spv" },
+			{ VK_SHADER_STAGE_GEOMETRY_BIT, ".geom.spv" },
+			{ VK_SHADER_STAGE_FRAGMENT_BIT, ".frag.spv" },
+		} };
+		bool shadersLoaded = true;
+		for (size_t i = 0; i < stages.size(); i++)
+		{
+			const std::string filename = shaderFile + stages[i].second;
+			shaderStages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			shaderStages[i].stage = stages[i].first;
+			shaderStages[i].pName = "main";
+#if defined(__ANDROID__)
+			shaderStages[i].module = vks::tools::loadShader(androidApp->activity->assetManager, filename.c_str(), device->logicalDevice);
+#else
+			shaderStages[i].module = vks::tools::loadShader(filename.c_str(), device->logicalDevice);
+#endif
+			shadersLoaded &= (shaderStages[i].module != VK_NULL_HANDLE);
+		}
+		if (!shadersLoaded)
+		{
+			for (const VkPipelineShaderStageCreateInfo &shaderStage : shaderStages)
+			{
+				if (shaderStage.module)
+				{
+					vkDestroyShaderModule(device->logicalDevice, shaderStage.module, nullptr);
+				}
+			}
+			return;
+		}
+
+		levels.resize(levelCount);
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			levels[level].voxelSize = extent * static_cast<float>(1u << level) / static_cast<float>(resolution);
+		}
+
+		// All levels stacked along z in one image, so shaders can select the level by the texture coordinate without dynamic descriptor indexing
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_3D;
+		imageCI.format = format;
+		imageCI.extent = { resolution, resolution, resolution * levelCount };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &image));
+		VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memory, &allocation));
+		VkMemoryRequirements memoryRequirements;
+		vkGetImageMemoryRequirements(device->logicalDevice, image, &memoryRequirements);
+		statistics.memorySize = memoryRequirements.size;
+		statistics.voxelCount = resolution * resolution * resolution * levelCount;
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_3D;
+		viewCI.format = format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		viewCI.image = image;
+		VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &view));
+
+		// Linear filtering for smooth occlusion, shaders clamp coordinates to the texel centers of a level so neighboring levels don't bleed in
+		VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.maxLod = 0.0f;
+		samplerCreateInfo.maxAnisotropy = 1.0f;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+		VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+		descriptor = { sampler, view, VK_IMAGE_LAYOUT_GENERAL };
+
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&clearBuffer,
+			static_cast<VkDeviceSize>(resolution) * resolution * resolution * 4));
+
+		// The voxels are written with image stores, so the render pass has no attachments and only defines the rasterization area
+		VkSubpassDescription subpassDescription{};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+		renderPassCI.subpassCount = 1;
+		renderPassCI.pSubpasses = &subpassDescription;
+		VK_CHECK_RESULT(vkCreateRenderPass(device->logicalDevice, &renderPassCI, nullptr, &renderPass));
+
+		VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+		framebufferCI.renderPass = renderPass;
+		framebufferCI.attachmentCount = 0;
+		framebufferCI.width = resolution;
+		framebufferCI.height = resolution;
+		framebufferCI.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device->logicalDevice, &framebufferCI, nullptr, &framebuffer));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+		VkDescriptorImageInfo storageDescriptor = { VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL };
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, &storageDescriptor);
+		vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		// Both faces are voxelized, without depth test
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineRasterizationConservativeStateCreateInfoEXT conservativeRasterStateCI{};
+		if (conservativeRasterization)
+		{
+			conservativeRasterStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_CONSERVATIVE_STATE_CREATE_INFO_EXT;
+			conservativeRasterStateCI.conservativeRasterizationMode = VK_CONSERVATIVE_RASTERIZATION_MODE_OVERESTIMATE_EXT;
+			conservativeRasterStateCI.extraPrimitiveOverestimationSize = 0.0f;
+			rasterizationState.pNext = &conservativeRasterStateCI;
+		}
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(0, nullptr);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_ALWAYS);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Color });
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		{
+			VKS_STARTUP_SCOPE(vks::StartupReport::Pipeline, "voxelize");
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		}
+		for (const VkPipelineShaderStageCreateInfo &shaderStage : shaderStages)
+		{
+			vkDestroyShaderModule(device->logicalDevice, shaderStage.module, nullptr);
+		}
+
+		supported = true;
+	}
+
+	Voxelizer::~Voxelizer()
+	{
+		if (pipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+		}
+		if (pipelineLayout)
+		{
+			vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		}
+		if (descriptorPool)
+		{
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		}
+		if (descriptorSetLayout)
+		{
+			vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		}
+		if (framebuffer)
+		{
+			vkDestroyFramebuffer(device->logicalDevice, framebuffer, nullptr);
+		}
+		if (renderPass)
+		{
+			vkDestroyRenderPass(device->logicalDevice, renderPass, nullptr);
+		}
+		clearBuffer.destroy();
+		if (sampler)
+		{
+			vkDestroySampler(device->logicalDevice, sampler, nullptr);
+		}
+		if (view)
+		{
+			vkDestroyImageView(device->logicalDevice, view, nullptr);
+		}
+		if (image)
+		{
+			vkDestroyImage(device->logicalDevice, image, nullptr);
+			device->freeMemory(memory, allocation);
+		}
+	}
+
+	/** @brief True if the required features are enabled and the voxelization pipeline has been created */
+	bool Voxelizer::isSupported() const
+	{
+		return supported;
+	}
+
+	/** @brief True if triangles are voxelized with conservative rasterization */
+	bool Voxelizer::isConservative() const
+	{
+		return supported && conservativeRasterization;
+	}
+
+	void Voxelizer::setUpdateMode(UpdateMode updateMode)
+	{
+		this->updateMode = updateMode;
+	}
+
+	Voxelizer::UpdateMode Voxelizer::getUpdateMode() const
+	{
+		return updateMode;
+	}
+
+	/** @brief Voxelize all levels with the next record(), e.g. after the scene has changed in incremental mode */
+	void Voxelizer::invalidate()
+	{
+		for (Level &level : levels)
+		{
+			level.valid = false;
+		}
+	}
+
+	/** @brief Origin of a level centered on a position, snapped to the level's snap distance */
+	glm::vec3 Voxelizer::getLevelOrigin(uint32_t level, const glm::vec3 &center) const
+	{
+		const float voxelSize = levels[level].voxelSize;
+		const float snapSize = voxelSize * static_cast<float>(snapVoxels);
+		return glm::floor(center / snapSize) * snapSize - glm::vec3(voxelSize * static_cast<float>(resolution / 2));
+	}
+
+	/**
+	* Record the voxelization of the levels that need an update, outside of a render pass
+	*
+	* @param commandBuffer Command buffer to record to
+	* @param center World space position the levels are centered on, usually the camera position
+	* @param drawScene Called once per voxelized level to draw the geometry, see the class notes
+	* @param model Transforms the vertices to world space
+	*/
+	void Voxelizer::record(VkCommandBuffer commandBuffer, const glm::vec3 &center, const std::function<void(VkCommandBuffer)> &drawScene, const glm::mat4 &model)
+	{
+		statistics.updatedLevels = 0;
+		if (!supported)
+		{
+			return;
+		}
+
+		const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+		imageBarrier.image = image;
+		imageBarrier.subresourceRange = subresourceRange;
+
+		if (!initialized)
+		{
+			vkCmdFillBuffer(commandBuffer, clearBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			imageBarrier.srcAccessMask = 0;
+			imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 1, &imageBarrier);
+			invalidate();
+			initialized = true;
+		}
+
+		// Levels whose origin moved (or that have never been voxelized), in incremental mode plus the next level in round robin order
+		const uint32_t levelCount = static_cast<uint32_t>(levels.size());
+		std::vector<uint32_t> updateLevels;
+		std::vector<glm::vec3> updateOrigins;
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			const glm::vec3 origin = getLevelOrigin(level, center);
+			if ((updateMode == UpdateMode::EveryFrame) || !levels[level].valid || (origin != levels[level].origin) || (level == nextLevel))
+			{
+				updateLevels.push_back(level);
+				updateOrigins.push_back(origin);
+			}
+		}
+		nextLevel = (nextLevel + 1) % levelCount;
+
+		// Previous reads of the levels (and writes of a previous voxelization) have to finish before they are cleared
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+		std::vector<VkBufferImageCopy> copyRegions;
+		for (uint32_t level : updateLevels)
+		{
+			VkBufferImageCopy copyRegion{};
+			copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			copyRegion.imageOffset = { 0, 0, static_cast<int32_t>(level * resolution) };
+			copyRegion.imageExtent = { resolution, resolution, resolution };
+			copyRegions.push_back(copyRegion);
+		}
+		vkCmdCopyBufferToImage(commandBuffer, clearBuffer.buffer, image, VK_IMAGE_LAYOUT_GENERAL, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+
+		imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.framebuffer = framebuffer;
+		renderPassBeginInfo.renderArea.extent = { resolution, resolution };
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport(static_cast<float>(resolution), static_cast<float>(resolution), 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(resolution, resolution, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		for (size_t i = 0; i < updateLevels.size(); i++)
+		{
+			Level &level = levels[updateLevels[i]];
+			level.origin = updateOrigins[i];
+			level.valid = true;
+			PushConstants pushConstants{};
+			pushConstants.model = model;
+			pushConstants.origin = glm::vec4(level.origin, level.voxelSize);
+			pushConstants.level = updateLevels[i];
+			pushConstants.resolution = resolution;
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &pushConstants);
+			drawScene(commandBuffer);
+		}
+		vkCmdEndRenderPass(commandBuffer);
+
+		imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+		statistics.updatedLevels = static_cast<uint32_t>(updateLevels.size());
+	}
+
+	/** @brief Origins and voxel sizes of the levels as of the last record(), for the shaders reading the voxels */
+	Voxelizer::ShaderData Voxelizer::getShaderData() const
+	{
+		ShaderData shaderData{};
+		for (size_t level = 0; level < levels.size(); level++)
+		{
+			shaderData.levels[level] = glm::vec4(levels[level].origin, levels[level].voxelSize);
+		}
+		shaderData.resolution = resolution;
+		shaderData.levelCount = static_cast<uint32_t>(levels.size());
+		return shaderData;
+	}
+
+	/** @brief Descriptor of the voxel texture in VK_IMAGE_LAYOUT_GENERAL with a linear clamp to edge sampler */
+	const VkDescriptorImageInfo &Voxelizer::getDescriptor() const
+	{
+		return descriptor;
+	}
+
+	VkImage Voxelizer::getImage() const
+	{
+		return image;
+	}
+
+	uint32_t Voxelizer::getResolution() const
+	{
+		return resolution;
+	}
+
+	uint32_t Voxelizer::getLevelCount() const
+	{
+		return static_cast<uint32_t>(levels.size());
+	}
+
+	const Voxelizer::Statistics &Voxelizer::getStatistics() const
+	{
+		return statistics;
+	}
+}
@@ -0,0 +1,141 @@
+/*
+* Scene voxelizer
+*
+* Voxelizes triangle geometry (e.g. a glTF scene) into a clipmap of 3D textures centered on the camera with conservative rasterization,
+* so occlusion, global illumination approximations and particle collisions can query the scene with a single texture fetch per position
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+#include "VulkanMemoryAllocator.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* Voxel clipmap built with the "base/voxelize.vert", "base/voxelize.geom" and "base/voxelize.frag" shaders
+	*
+	* Usage:
+	*	// With the geometryShader and fragmentStoresAndAtomics features and (optionally) VK_EXT_conservative_rasterization enabled
+	*	vks::Voxelizer voxelizer(vulkanDevice, pipelineCache, getShadersPath() + "base/voxelize", 64, 4, 4.0f, conservativeRasterizationEnabled);
+	*	// Per frame, outside of a render pass
+	*	voxelizer.record(commandBuffer, cameraPosition, [&](VkCommandBuffer commandBuffer) {
+	*		scene.bindBuffers(commandBuffer);
+	*		scene.draw(commandBuffer);
+	*	});
+	*	// Bind getDescriptor() as sampler3D and pass getShaderData() to the shaders querying the voxels
+	*
+	* Level l covers a cube of extent * 2^l with resolution^3 voxels, so every level has the same number of voxels at twice the size of the
+	* previous level's voxels. The levels are stacked along z in a single RGBA8 3D texture (level l starts at slice l * resolution), each
+	* voxel stores the color of the geometry in rgb and its occupancy in a. A position is looked up in the finest level containing it:
+	*	uvw = (position - origin[l].xyz) / (origin[l].w * resolution), texture coordinate (uvw.x, uvw.y, (uvw.z + l) / levelCount)
+	* Level origins are snapped to a multiple of snapVoxels voxels of the level, so a level only moves (and is voxelized again) once the center
+	* has moved by that distance. The geometry shader projects each triangle along the axis its normal is closest to, and conservative rasterization
+	* makes sure triangles thinner than a voxel (e.g. seen edge on) still cover every voxel they touch.
+	*
+	* In UpdateMode::EveryFrame all levels are voxelized every frame, for scenes with moving geometry. In UpdateMode::Incremental a level is only
+	* voxelized if its origin moved, plus one further level per frame in round robin order, so dynamic geometry shows up with a delay of at most
+	* levelCount frames and static scenes cost about one level per frame. invalidate() voxelizes all levels with the next record().
+	*
+	* @note The draw callback is called once per voxelized level with the voxelization pipeline bound, it has to bind the vertex and index buffers
+	* and issue the draws. Vertices are read in the vkglTF::Vertex layout (position and color), in world space unless a model matrix is passed
+	* to record(). Node transforms aren't applied, glTF models have to be loaded with vkglTF::FileLoadingFlags::PreTransformVertices
+	* @note Without conservative rasterization thin triangles can leave holes in the voxels
+	* @note The voxels are in VK_IMAGE_LAYOUT_GENERAL, the reads of fragment and compute shaders after record() don't need further barriers
+	*/
+	class Voxelizer
+	{
+	public:
+		static const uint32_t maxLevels = 8;
+		static const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+
+		enum class UpdateMode {
+			EveryFrame = 0,
+			Incremental = 1,
+		};
+
+		/** @brief Clipmap parameters for shaders, matches the layout of a std140 uniform block with the same members */
+		struct ShaderData {
+			// xyz = world space origin (minimum corner) of each level, w = voxel size of the level
+			glm::vec4 levels[maxLevels];
+			uint32_t resolution;
+			uint32_t levelCount;
+			uint32_t padding[2];
+		};
+
+		struct Statistics {
+			// Levels voxelized by the last record()
+			uint32_t updatedLevels = 0;
+			uint32_t voxelCount = 0;
+			VkDeviceSize memorySize = 0;
+		};
+
+	private:
+		struct PushConstants {
+			glm::mat4 model;
+			// xyz = level origin, w = voxel size
+			glm::vec4 origin;
+			uint32_t level;
+			uint32_t resolution;
+		};
+		struct Level {
+			glm::vec3 origin = glm::vec3(0.0f);
+			float voxelSize = 0.0f;
+			bool valid = false;
+		};
+		vks::VulkanDevice *device;
+		bool supported = false;
+		bool conservativeRasterization;
+		uint32_t resolution;
+		uint32_t snapVoxels;
+		UpdateMode updateMode = UpdateMode::Incremental;
+		uint32_t nextLevel = 0;
+		bool initialized = false;
+		std::vector<Level> levels;
+		Statistics statistics;
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		vks::MemoryAllocation allocation{};
+		VkImageView view = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkDescriptorImageInfo descriptor{};
+		// Zeros copied into a level before it's voxelized, as clears can only target whole subresources
+		vks::Buffer clearBuffer;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		glm::vec3 getLevelOrigin(uint32_t level, const glm::vec3 &center) const;
+	public:
+		Voxelizer(vks::VulkanDevice *device, VkPipelineCache pipelineCache, const std::string &shaderFile, uint32_t resolution, uint32_t levelCount, float extent, bool conservativeRasterization, uint32_t snapVoxels = 8);
+		~Voxelizer();
+		bool isSupported() const;
+		bool isConservative() const;
+		void setUpdateMode(UpdateMode updateMode);
+		UpdateMode getUpdateMode() const;
+		void invalidate();
+		void record(VkCommandBuffer commandBuffer, const glm::vec3 &center, const std::function<void(VkCommandBuffer)> &drawScene, const glm::mat4 &model = glm::mat4(1.0f));
+		ShaderData getShaderData() const;
+		const VkDescriptorImageInfo &getDescriptor() const;
+		VkImage getImage() const;
+		uint32_t getResolution() const;
+		uint32_t getLevelCount() const;
+		const Statistics &getStatistics() const;
+	};
+}
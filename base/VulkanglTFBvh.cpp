@@ -0,0 +1,812 @@
+/*
+* Bounding volume hierarchy for glTF models
+*
+* World space bounding box hierarchy over the primitives of a vkglTF::Model for CPU culling, picking and light assignment, built with
+* binned surface area heuristic splits and refitted when nodes move
+* Triangle hierarchy over the same model's world space triangles, flattened for stackless traversal in shaders
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanglTFBvh.h"
+#include "VulkanglTFModel.h"
+#include "threadpool.hpp"
+#include "frustum.hpp"
+#include <algorithm>
+#include <assert.h>
+
+namespace vkglTF
+{
+	// Bins per axis evaluated for the surface area heuristic
+	static const uint32_t binCount = 16;
+	// Leaves with at most this many items are kept if splitting isn't cheaper, larger ones are always split
+	static const uint32_t maxLeafItems = 4;
+	// Cost of visiting an inner node relative to testing an item
+	static const float traversalCost = 1.0f;
+	// Subtrees with more items are built as jobs of their own
+	static const uint32_t parallelBuildItems = 1024;
+
+	enum FrustumResult { Outside, Intersecting, Inside };
+
+	static float surfaceArea(const glm::vec3 &min, const glm::vec3 &max)
+	{
+		const glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	static FrustumResult classifyBox(const vks::Frustum &frustum, const glm::vec3 &min, const glm::vec3 &max)
+	{
+		// Plane distance of the box center, plus and minus the largest extent along the plane normal
+		const glm::vec3 center = (min + max) * 0.5f;
+		const glm::vec3 extent = (max - min) * 0.5f;
+		FrustumResult result = Inside;
+		for (const glm::vec4 &plane : frustum.planes)
+		{
+			const float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			const float radius = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+			if (distance + radius <= 0.0f)
+			{
+				return Outside;
+			}
+			if (distance - radius <= 0.0f)
+			{
+				result = Intersecting;
+			}
+		}
+		return result;
+	}
+
+	static bool overlapsSphere(const glm::vec3 &min, const glm::vec3 &max, const glm::vec3 &center, float radius)
+	{
+		const glm::vec3 offset = glm::clamp(center, min, max) - center;
+		return glm::dot(offset, offset) <= radius * radius;
+	}
+
+	// Entry distance of the ray into the box, or false if it misses the box within [0, maxDistance]
+	static bool intersectBox(const glm::vec3 &min, const glm::vec3 &max, const glm::vec3 &origin, const glm::vec3 &inverseDirection, float maxDistance, float &distance)
+	{
+		const glm::vec3 t0 = (min - origin) * inverseDirection;
+		const glm::vec3 t1 = (max - origin) * inverseDirection;
+		const glm::vec3 tNear = glm::min(t0, t1);
+		const glm::vec3 tFar = glm::max(t0, t1);
+		const float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		distance = entry;
+		return entry <= exit;
+	}
+
+	/*
+		Binned SAH split of a range of entries along the axis with the lowest cost, shared by both hierarchies
+		bounds(index, min, max) returns the box of an entry, the cost is the sum of the children's surface area times their entry count
+		Returns false if the centroids of all entries are the same and no split plane separates them
+	*/
+	template <typename Bounds>
+	static bool findBinnedSplit(const uint32_t *indices, uint32_t count, const glm::vec3 *centroids, const Bounds &bounds, const glm::vec3 &centroidMin, const glm::vec3 &centroidMax, uint32_t &axis, float &position, float &cost)
+	{
+		struct Bin {
+			glm::vec3 min = glm::vec3(FLT_MAX);
+			glm::vec3 max = glm::vec3(-FLT_MAX);
+			uint32_t count = 0;
+		};
+		bool found = false;
+		cost = FLT_MAX;
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			const float extent = centroidMax[a] - centroidMin[a];
+			if (extent <= 0.0f)
+			{
+				continue;
+			}
+			Bin bins[binCount];
+			const float scale = binCount / extent;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const uint32_t index = indices[i];
+				const uint32_t bin = std::min(static_cast<uint32_t>((centroids[index][a] - centroidMin[a]) * scale), binCount - 1);
+				glm::vec3 min, max;
+				bounds(index, min, max);
+				bins[bin].min = glm::min(bins[bin].min, min);
+				bins[bin].max = glm::max(bins[bin].max, max);
+				bins[bin].count++;
+			}
+			// Cost of the entries left of each split plane, then the right side is swept and combined
+			float leftCost[binCount - 1];
+			Bin left;
+			for (uint32_t b = 0; b < binCount - 1; b++)
+			{
+				left.min = glm::min(left.min, bins[b].min);
+				left.max = glm::max(left.max, bins[b].max);
+				left.count += bins[b].count;
+				leftCost[b] = (left.count > 0) ? surfaceArea(left.min, left.max) * left.count : 0.0f;
+			}
+			Bin right;
+			for (uint32_t b = binCount - 1; b > 0; b--)
+			{
+				right.min = glm::min(right.min, bins[b].min);
+				right.max = glm::max(right.max, bins[b].max);
+				right.count += bins[b].count;
+				if ((right.count == 0) || (right.count == count))
+				{
+					continue;
+				}
+				const float splitCost = leftCost[b - 1] + surfaceArea(right.min, right.max) * right.count;
+				if (splitCost < cost)
+				{
+					cost = splitCost;
+					axis = a;
+					position = centroidMin[a] + b / scale;
+					found = true;
+				}
+			}
+		}
+		return found;
+	}
+
+	/**
+	* @param model Loaded model, the BVH keeps a reference to it and its nodes
+	*/
+	SceneBvh::SceneBvh(vkglTF::Model &model) : model(model)
+	{
+	}
+
+	/**
+	* Collects the primitives of all mesh nodes and builds the hierarchy from their world space bounds
+	*
+	* @param threadPool (Optional) Pool to build large subtrees on in parallel
+	*
+	* @note Uses the world matrices cached by the last Model::updateNodes() pass
+	*/
+	void SceneBvh::build(vks::ThreadPool *threadPool)
+	{
+		items.clear();
+		for (Node *node : model.linearNodes)
+		{
+			if (!node->mesh)
+			{
+				continue;
+			}
+			for (Primitive *primitive : node->mesh->primitives)
+			{
+				items.push_back({ node, primitive, glm::vec3(0.0f), glm::vec3(0.0f) });
+			}
+		}
+		const uint32_t itemCount = static_cast<uint32_t>(items.size());
+		centroids.resize(itemCount);
+		itemMatrices.resize(itemCount);
+		for (uint32_t i = 0; i < itemCount; i++)
+		{
+			updateItemBounds(i);
+		}
+
+		itemIndices.resize(itemCount);
+		for (uint32_t i = 0; i < itemCount; i++)
+		{
+			itemIndices[i] = i;
+		}
+		itemLeaves.assign(itemCount, 0);
+		// A binary tree with at least one item per leaf has at most 2n - 1 nodes
+		nodes.assign(std::max(2 * itemCount, 2u) - 1, BvhNode{ glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX), 0, 0, 0 });
+		nodeCount = 1;
+		if (itemCount > 0)
+		{
+			buildNode({ 0, 0, itemCount }, threadPool);
+		}
+		nodes.resize(nodeCount);
+		dirtyNodes.assign(nodes.size(), 0);
+	}
+
+	/**
+	* Updates the bounds of items whose node moved since the last build() or refit() and of their ancestors, the tree structure is kept
+	*
+	* @return True if any item moved
+	*
+	* @note Refitting lets the tree quality degrade if items move far from where they were at build time, call build() again in that case
+	*/
+	bool SceneBvh::refit()
+	{
+		bool changed = false;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(items.size()); i++)
+		{
+			if (items[i].node->worldMatrix != itemMatrices[i])
+			{
+				updateItemBounds(i);
+				dirtyNodes[itemLeaves[i]] = 1;
+				changed = true;
+			}
+		}
+		if (!changed)
+		{
+			return false;
+		}
+		// Children come after their parents, so a reverse pass refits every node after its children
+		for (uint32_t i = static_cast<uint32_t>(nodes.size()); i-- > 0;)
+		{
+			if (!dirtyNodes[i])
+			{
+				continue;
+			}
+			dirtyNodes[i] = 0;
+			BvhNode &node = nodes[i];
+			node.min = glm::vec3(FLT_MAX);
+			node.max = glm::vec3(-FLT_MAX);
+			if (node.count > 0)
+			{
+				for (uint32_t j = node.first; j < node.first + node.count; j++)
+				{
+					node.min = glm::min(node.min, items[itemIndices[j]].min);
+					node.max = glm::max(node.max, items[itemIndices[j]].max);
+				}
+			}
+			else
+			{
+				node.min = glm::min(nodes[node.first].min, nodes[node.first + 1].min);
+				node.max = glm::max(nodes[node.first].max, nodes[node.first + 1].max);
+			}
+			if (i > 0)
+			{
+				dirtyNodes[node.parent] = 1;
+			}
+		}
+		return true;
+	}
+
+	/**
+	* Collects the indices of all items whose box is at least partially inside the frustum
+	*/
+	void SceneBvh::queryFrustum(const vks::Frustum &frustum, std::vector<uint32_t> &items) const
+	{
+		queryFrustums(&frustum, 1, &items);
+	}
+
+	/**
+	* Collects the visible items of several frustums (e.g. shadow cascades or cube map faces) in a single traversal
+	*
+	* Subtrees completely inside a frustum are added without further tests for that frustum
+	*
+	* @param frustums Frustums to test, at most maxFrustums
+	* @param frustumCount Number of frustums
+	* @param items Receives the item indices visible in frustums[i] in items[i]
+	*/
+	void SceneBvh::queryFrustums(const vks::Frustum *frustums, uint32_t frustumCount, std::vector<uint32_t> *items) const
+	{
+		assert(frustumCount <= maxFrustums);
+		for (uint32_t f = 0; f < frustumCount; f++)
+		{
+			items[f].clear();
+		}
+		if ((frustumCount == 0) || this->items.empty())
+		{
+			return;
+		}
+		struct Entry {
+			uint32_t node;
+			// Frustums that may see the node and the ones it's completely inside of
+			uint32_t active;
+			uint32_t inside;
+		};
+		std::vector<Entry> stack;
+		stack.push_back({ 0, (frustumCount == 32) ? UINT32_MAX : ((1u << frustumCount) - 1), 0 });
+		while (!stack.empty())
+		{
+			Entry entry = stack.back();
+			stack.pop_back();
+			const BvhNode &node = nodes[entry.node];
+			for (uint32_t f = 0; f < frustumCount; f++)
+			{
+				const uint32_t bit = 1u << f;
+				if ((entry.active & ~entry.inside) & bit)
+				{
+					const FrustumResult result = classifyBox(frustums[f], node.min, node.max);
+					if (result == Outside)
+					{
+						entry.active &= ~bit;
+					}
+					else if (result == Inside)
+					{
+						entry.inside |= bit;
+					}
+				}
+			}
+			if (entry.active == 0)
+			{
+				continue;
+			}
+			if (node.count == 0)
+			{
+				stack.push_back({ node.first, entry.active, entry.inside });
+				stack.push_back({ node.first + 1, entry.active, entry.inside });
+				continue;
+			}
+			for (uint32_t j = node.first; j < node.first + node.count; j++)
+			{
+				const uint32_t index = itemIndices[j];
+				const Item &item = this->items[index];
+				for (uint32_t f = 0; f < frustumCount; f++)
+				{
+					const uint32_t bit = 1u << f;
+					if ((entry.active & bit) && ((entry.inside & bit) || (classifyBox(frustums[f], item.min, item.max) != Outside)))
+					{
+						items[f].push_back(index);
+					}
+				}
+			}
+		}
+	}
+
+	/**
+	* Collects the indices of all items whose box overlaps the sphere
+	*/
+	void SceneBvh::querySphere(const glm::vec3 &center, float radius, std::vector<uint32_t> &items) const
+	{
+		items.clear();
+		if (this->items.empty())
+		{
+			return;
+		}
+		std::vector<uint32_t> stack;
+		stack.push_back(0);
+		while (!stack.empty())
+		{
+			const BvhNode &node = nodes[stack.back()];
+			stack.pop_back();
+			if (!overlapsSphere(node.min, node.max, center, radius))
+			{
+				continue;
+			}
+			if (node.count == 0)
+			{
+				stack.push_back(node.first);
+				stack.push_back(node.first + 1);
+				continue;
+			}
+			for (uint32_t j = node.first; j < node.first + node.count; j++)
+			{
+				const Item &item = this->items[itemIndices[j]];
+				if (overlapsSphere(item.min, item.max, center, radius))
+				{
+					items.push_back(itemIndices[j]);
+				}
+			}
+		}
+	}
+
+	/**
+	* Sphere query for many spheres, e.g. assigning point lights to the items they affect
+	*
+	* @param spheres Spheres with the center in xyz and the radius in w
+	* @param sphereCount Number of spheres
+	* @param items Receives the item indices overlapping spheres[i] in items[i]
+	* @param threadPool (Optional) Pool to spread the queries across
+	*/
+	void SceneBvh::querySpheres(const glm::vec4 *spheres, size_t sphereCount, std::vector<uint32_t> *items, vks::ThreadPool *threadPool) const
+	{
+		auto query = [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				querySphere(glm::vec3(spheres[i]), spheres[i].w, items[i]);
+			}
+		};
+		if (threadPool)
+		{
+			threadPool->parallelFor(sphereCount, 16, query);
+		}
+		else
+		{
+			query(0, sphereCount);
+		}
+	}
+
+	/**
+	* Finds the nearest item box hit by the ray, children are visited front to back and skipped if they start behind the nearest hit so far
+	*
+	* @return True if an item was hit
+	*/
+	bool SceneBvh::raycast(const Ray &ray, RayHit &hit) const
+	{
+		hit.item = invalidItem;
+		hit.distance = ray.maxDistance;
+		if (items.empty())
+		{
+			return false;
+		}
+		const glm::vec3 inverseDirection = 1.0f / ray.direction;
+		float distance;
+		if (!intersectBox(nodes[0].min, nodes[0].max, ray.origin, inverseDirection, hit.distance, distance))
+		{
+			return false;
+		}
+		struct Entry {
+			uint32_t node;
+			float distance;
+		};
+		std::vector<Entry> stack;
+		stack.push_back({ 0, distance });
+		while (!stack.empty())
+		{
+			const Entry entry = stack.back();
+			stack.pop_back();
+			if (entry.distance > hit.distance)
+			{
+				continue;
+			}
+			const BvhNode &node = nodes[entry.node];
+			if (node.count > 0)
+			{
+				for (uint32_t j = node.first; j < node.first + node.count; j++)
+				{
+					const Item &item = items[itemIndices[j]];
+					if (intersectBox(item.min, item.max, ray.origin, inverseDirection, hit.distance, distance) && ((hit.item == invalidItem) || (distance < hit.distance)))
+					{
+						hit.item = itemIndices[j];
+						hit.distance = distance;
+					}
+				}
+				continue;
+			}
+			float distances[2];
+			bool hits[2];
+			for (uint32_t c = 0; c < 2; c++)
+			{
+				const BvhNode &child = nodes[node.first + c];
+				hits[c] = intersectBox(child.min, child.max, ray.origin, inverseDirection, hit.distance, distances[c]);
+			}
+			// The nearer child is pushed last so it's visited first
+			const uint32_t nearChild = (hits[0] && hits[1] && (distances[1] < distances[0])) ? 1 : 0;
+			const uint32_t farChild = 1 - nearChild;
+			if (hits[farChild])
+			{
+				stack.push_back({ node.first + farChild, distances[farChild] });
+			}
+			if (hits[nearChild])
+			{
+				stack.push_back({ node.first + nearChild, distances[nearChild] });
+			}
+		}
+		return hit.item != invalidItem;
+	}
+
+	/**
+	* Casts many rays, e.g. for picking with several pointers or visibility probes
+	*
+	* @param rays Rays to cast
+	* @param rayCount Number of rays
+	* @param hits Receives the nearest hit of rays[i] in hits[i]
+	* @param threadPool (Optional) Pool to spread the rays across
+	*/
+	void SceneBvh::raycast(const Ray *rays, size_t rayCount, RayHit *hits, vks::ThreadPool *threadPool) const
+	{
+		auto cast = [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				raycast(rays[i], hits[i]);
+			}
+		};
+		if (threadPool)
+		{
+			threadPool->parallelFor(rayCount, 64, cast);
+		}
+		else
+		{
+			cast(0, rayCount);
+		}
+	}
+
+	const std::vector<SceneBvh::Item> &SceneBvh::getItems() const
+	{
+		return items;
+	}
+
+	/** @brief World space bounds of all items, min is larger than max if the model has no items */
+	void SceneBvh::getBounds(glm::vec3 &min, glm::vec3 &max) const
+	{
+		min = nodes.empty() ? glm::vec3(FLT_MAX) : nodes[0].min;
+		max = nodes.empty() ? glm::vec3(-FLT_MAX) : nodes[0].max;
+	}
+
+	void SceneBvh::updateItemBounds(uint32_t index)
+	{
+		Item &item = items[index];
+		const glm::mat4 &matrix = item.node->worldMatrix;
+		const Primitive::Dimensions &dimensions = item.primitive->dimensions;
+		// Primitives without positions have inverted bounds, they're treated as a point at the node's origin
+		const bool valid = glm::all(glm::lessThanEqual(dimensions.min, dimensions.max));
+		const glm::vec3 center = valid ? (dimensions.min + dimensions.max) * 0.5f : glm::vec3(0.0f);
+		const glm::vec3 extent = valid ? (dimensions.max - dimensions.min) * 0.5f : glm::vec3(0.0f);
+		// The transformed box is centered at the transformed center, its extent along each axis is the sum of the absolute projected extents
+		const glm::vec3 worldCenter = glm::vec3(matrix * glm::vec4(center, 1.0f));
+		glm::vec3 worldExtent(0.0f);
+		for (uint32_t column = 0; column < 3; column++)
+		{
+			worldExtent += glm::abs(glm::vec3(matrix[column])) * extent[column];
+		}
+		item.min = worldCenter - worldExtent;
+		item.max = worldCenter + worldExtent;
+		centroids[index] = worldCenter;
+		itemMatrices[index] = matrix;
+	}
+
+	/**
+	* Finds the binned SAH split of a range of items along the axis with the lowest cost
+	*
+	* @return False if the centroids of all items are the same and no split plane separates them
+	*/
+	bool SceneBvh::findSplit(uint32_t begin, uint32_t end, const glm::vec3 &centroidMin, const glm::vec3 &centroidMax, uint32_t &axis, float &position, float &cost) const
+	{
+		const std::vector<Item> &items = this->items;
+		return findBinnedSplit(itemIndices.data() + begin, end - begin, centroids.data(), [&](uint32_t index, glm::vec3 &min, glm::vec3 &max) {
+			min = items[index].min;
+			max = items[index].max;
+		}, centroidMin, centroidMax, axis, position, cost);
+	}
+
+	void SceneBvh::buildNode(const BuildTask &task, vks::ThreadPool *threadPool)
+	{
+		BvhNode &node = nodes[task.node];
+		node.min = glm::vec3(FLT_MAX);
+		node.max = glm::vec3(-FLT_MAX);
+		glm::vec3 centroidMin(FLT_MAX);
+		glm::vec3 centroidMax(-FLT_MAX);
+		for (uint32_t i = task.begin; i < task.end; i++)
+		{
+			const uint32_t index = itemIndices[i];
+			node.min = glm::min(node.min, items[index].min);
+			node.max = glm::max(node.max, items[index].max);
+			centroidMin = glm::min(centroidMin, centroids[index]);
+			centroidMax = glm::max(centroidMax, centroids[index]);
+		}
+
+		const uint32_t count = task.end - task.begin;
+		uint32_t axis = 0;
+		float position = 0.0f;
+		float cost = FLT_MAX;
+		uint32_t middle = task.begin;
+		if (count > 1)
+		{
+			const bool split = findSplit(task.begin, task.end, centroidMin, centroidMax, axis, position, cost);
+			// Relative to the parent's area, as the heuristic compares the expected cost of testing the items against splitting them
+			const float area = surfaceArea(node.min, node.max);
+			const float splitCost = traversalCost + ((area > 0.0f) ? cost / area : static_cast<float>(count));
+			if (split && ((count > maxLeafItems) || (splitCost < static_cast<float>(count))))
+			{
+				const std::vector<glm::vec3> &centroids = this->centroids;
+				middle = static_cast<uint32_t>(std::partition(itemIndices.begin() + task.begin, itemIndices.begin() + task.end, [&](uint32_t index) {
+					return centroids[index][axis] < position;
+				}) - itemIndices.begin());
+			}
+			// Items with identical centroids are split in halves to keep leaves small
+			if (((middle == task.begin) || (middle == task.end)) && (count > maxLeafItems))
+			{
+				middle = task.begin + count / 2;
+			}
+		}
+
+		if ((middle == task.begin) || (middle == task.end))
+		{
+			node.first = task.begin;
+			node.count = count;
+			for (uint32_t i = task.begin; i < task.end; i++)
+			{
+				itemLeaves[itemIndices[i]] = task.node;
+			}
+			return;
+		}
+
+		const uint32_t firstChild = nodeCount.fetch_add(2);
+		node.first = firstChild;
+		node.count = 0;
+		nodes[firstChild].parent = task.node;
+		nodes[firstChild + 1].parent = task.node;
+		const BuildTask left = { firstChild, task.begin, middle };
+		const BuildTask right = { firstChild + 1, middle, task.end };
+		if (threadPool && (threadPool->getThreadCount() > 0) && (middle - task.begin > parallelBuildItems))
+		{
+			vks::JobCounter counter;
+			threadPool->addJob([this, left, threadPool]() { buildNode(left, threadPool); }, &counter);
+			buildNode(right, threadPool);
+			threadPool->wait(counter);
+		}
+		else
+		{
+			buildNode(left, threadPool);
+			buildNode(right, threadPool);
+		}
+	}
+
+	/**
+	* Collects the triangles of all mesh nodes (and of their EXT_mesh_gpu_instancing instances) in world space and builds the flattened hierarchy
+	*
+	* @param model Model loaded with FileLoadingFlags::KeepHostGeometry
+	* @param transform (Optional) Transform applied on top of the node matrices, e.g. to flip the y axis
+	*/
+	void TriangleBvh::build(vkglTF::Model &model, const glm::mat4 &transform)
+	{
+		const std::vector<Vertex> &vertices = model.hostGeometry.vertices;
+		const std::vector<uint32_t> &indices = model.hostGeometry.indices;
+		assert(!indices.empty() && "Model needs to be loaded with FileLoadingFlags::KeepHostGeometry");
+
+		std::vector<Triangle> sourceTriangles;
+		std::vector<TriangleNormals> sourceNormals;
+		std::vector<glm::vec3> triangleMins;
+		std::vector<glm::vec3> triangleMaxs;
+		std::vector<glm::vec3> centroids;
+		for (vkglTF::Node *node : model.linearNodes)
+		{
+			if (!node->mesh)
+			{
+				continue;
+			}
+			const glm::mat4 nodeMatrix = transform * node->getMatrix();
+			std::vector<glm::mat4> matrices;
+			if (node->instanceMatrices.empty())
+			{
+				matrices.push_back(nodeMatrix);
+			}
+			for (const glm::mat4 &instanceMatrix : node->instanceMatrices)
+			{
+				matrices.push_back(nodeMatrix * instanceMatrix);
+			}
+			for (const glm::mat4 &matrix : matrices)
+			{
+				const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(matrix)));
+				auto transformNormal = [&normalMatrix](const glm::vec3 &normal) {
+					const glm::vec3 transformed = normalMatrix * normal;
+					const float length = glm::length(transformed);
+					return glm::vec4((length > 0.0f) ? transformed / length : transformed, 0.0f);
+				};
+				for (Primitive *primitive : node->mesh->primitives)
+				{
+					const uint32_t materialIndex = static_cast<uint32_t>(&primitive->material - model.materials.data());
+					// First indices of pooled models include the model's offset in the pool, the host indices don't
+					const uint32_t firstIndex = primitive->firstIndex - model.geometryPoolRange.firstIndex;
+					for (uint32_t i = 0; i + 2 < primitive->indexCount; i += 3)
+					{
+						const Vertex &vertex0 = vertices[indices[firstIndex + i]];
+						const Vertex &vertex1 = vertices[indices[firstIndex + i + 1]];
+						const Vertex &vertex2 = vertices[indices[firstIndex + i + 2]];
+						Triangle triangle{};
+						triangle.v0 = glm::vec3(matrix * glm::vec4(vertex0.pos, 1.0f));
+						triangle.v1 = glm::vec3(matrix * glm::vec4(vertex1.pos, 1.0f));
+						triangle.v2 = glm::vec3(matrix * glm::vec4(vertex2.pos, 1.0f));
+						triangle.materialIndex = materialIndex;
+						sourceTriangles.push_back(triangle);
+						sourceNormals.push_back({ transformNormal(vertex0.normal), transformNormal(vertex1.normal), transformNormal(vertex2.normal) });
+						const glm::vec3 min = glm::min(glm::min(triangle.v0, triangle.v1), triangle.v2);
+						const glm::vec3 max = glm::max(glm::max(triangle.v0, triangle.v1), triangle.v2);
+						triangleMins.push_back(min);
+						triangleMaxs.push_back(max);
+						centroids.push_back((min + max) * 0.5f);
+					}
+				}
+			}
+		}
+
+		const uint32_t triangleCount = static_cast<uint32_t>(sourceTriangles.size());
+		nodes.clear();
+		triangles.clear();
+		triangleNormals.clear();
+		depth = 0;
+		if (triangleCount == 0)
+		{
+			return;
+		}
+		assert(triangleCount < (1u << 28));
+		std::vector<uint32_t> triangleIndices(triangleCount);
+		for (uint32_t i = 0; i < triangleCount; i++)
+		{
+			triangleIndices[i] = i;
+		}
+		nodes.reserve(2 * triangleCount - 1);
+		triangles.reserve(triangleCount);
+		triangleNormals.reserve(triangleCount);
+		// Index of the second child of every inner node, the first one directly follows its parent
+		std::vector<uint32_t> rightChildren;
+		rightChildren.reserve(2 * triangleCount - 1);
+
+		// Nodes are emitted in depth first order by always continuing with the left child, large meshes would overflow a recursive build
+		std::vector<BuildTask> tasks;
+		tasks.push_back({ 0, triangleCount, 0, 1, false });
+		while (!tasks.empty())
+		{
+			const BuildTask task = tasks.back();
+			tasks.pop_back();
+			const uint32_t index = static_cast<uint32_t>(nodes.size());
+			if (task.right)
+			{
+				rightChildren[task.parent] = index;
+			}
+			depth = std::max(depth, task.depth);
+
+			Node node{ glm::vec3(FLT_MAX), 0, glm::vec3(-FLT_MAX), 0 };
+			glm::vec3 centroidMin(FLT_MAX);
+			glm::vec3 centroidMax(-FLT_MAX);
+			for (uint32_t i = task.begin; i < task.end; i++)
+			{
+				const uint32_t triangle = triangleIndices[i];
+				node.min = glm::min(node.min, triangleMins[triangle]);
+				node.max = glm::max(node.max, triangleMaxs[triangle]);
+				centroidMin = glm::min(centroidMin, centroids[triangle]);
+				centroidMax = glm::max(centroidMax, centroids[triangle]);
+			}
+
+			const uint32_t count = task.end - task.begin;
+			uint32_t middle = task.begin;
+			if (count > 1)
+			{
+				uint32_t axis = 0;
+				float position = 0.0f;
+				float cost = FLT_MAX;
+				const bool split = findBinnedSplit(triangleIndices.data() + task.begin, count, centroids.data(), [&](uint32_t triangle, glm::vec3 &min, glm::vec3 &max) {
+					min = triangleMins[triangle];
+					max = triangleMaxs[triangle];
+				}, centroidMin, centroidMax, axis, position, cost);
+				const float area = surfaceArea(node.min, node.max);
+				const float splitCost = traversalCost + ((area > 0.0f) ? cost / area : static_cast<float>(count));
+				if (split && ((count > maxLeafTriangles) || (splitCost < static_cast<float>(count))))
+				{
+					middle = static_cast<uint32_t>(std::partition(triangleIndices.begin() + task.begin, triangleIndices.begin() + task.end, [&](uint32_t triangle) {
+						return centroids[triangle][axis] < position;
+					}) - triangleIndices.begin());
+				}
+				// Triangles with identical centroids are split in halves to keep leaves small
+				if (((middle == task.begin) || (middle == task.end)) && (count > maxLeafTriangles))
+				{
+					middle = task.begin + count / 2;
+				}
+			}
+
+			if ((middle == task.begin) || (middle == task.end))
+			{
+				assert(count <= maxLeafTriangles);
+				node.triangles = (static_cast<uint32_t>(triangles.size()) << 4) | count;
+				for (uint32_t i = task.begin; i < task.end; i++)
+				{
+					triangles.push_back(sourceTriangles[triangleIndices[i]]);
+					triangleNormals.push_back(sourceNormals[triangleIndices[i]]);
+				}
+				nodes.push_back(node);
+				rightChildren.push_back(0);
+				continue;
+			}
+
+			nodes.push_back(node);
+			rightChildren.push_back(0);
+			tasks.push_back({ middle, task.end, index, task.depth + 1, true });
+			tasks.push_back({ task.begin, middle, index, task.depth + 1, false });
+		}
+
+		// Parents come before their children, so a forward pass can pass the skip indices down
+		nodes[0].skipIndex = static_cast<uint32_t>(nodes.size());
+		for (uint32_t i = 0; i < static_cast<uint32_t>(nodes.size()); i++)
+		{
+			if (nodes[i].triangles != 0)
+			{
+				continue;
+			}
+			nodes[i + 1].skipIndex = rightChildren[i];
+			nodes[rightChildren[i]].skipIndex = nodes[i].skipIndex;
+		}
+	}
+
+	const std::vector<TriangleBvh::Node> &TriangleBvh::getNodes() const
+	{
+		return nodes;
+	}
+
+	/** @brief Triangles in leaf order, each leaf owns a contiguous range */
+	const std::vector<TriangleBvh::Triangle> &TriangleBvh::getTriangles() const
+	{
+		return triangles;
+	}
+
+	/** @brief Normals of getTriangles() in the same order */
+	const std::vector<TriangleBvh::TriangleNormals> &TriangleBvh::getTriangleNormals() const
+	{
+		return triangleNormals;
+	}
+
+	/** @brief Number of nodes on the longest path from the root to a leaf */
+	uint32_t TriangleBvh::getDepth() const
+	{
+		return depth;
+	}
+}
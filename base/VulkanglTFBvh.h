@@ -0,0 +1,199 @@
+/*
+* Bounding volume hierarchy for glTF models
+*
+* World space bounding box hierarchy over the primitives of a vkglTF::Model for CPU culling, picking and light assignment, built with
+* binned surface area heuristic splits and refitted when nodes move
+* Triangle hierarchy over the same model's world space triangles, flattened for stackless traversal in shaders
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <float.h>
+#include <stdint.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	class ThreadPool;
+	class Frustum;
+}
+
+namespace vkglTF
+{
+	class Model;
+	struct Node;
+	struct Primitive;
+
+	/**
+	* Scene BVH over all primitives of a model's mesh nodes
+	*
+	* Usage:
+	*	vkglTF::SceneBvh bvh(model);
+	*	bvh.build(&threadPool);
+	*	// Per frame, after model.updateAnimation() or model.updateNodes()
+	*	bvh.refit();
+	*	bvh.queryFrustum(frustum, visibleItems);
+	*	bvh.raycast(rays, rayCount, hits, &threadPool);
+	*	// Item indices refer to getItems(), e.g. getItems()[visibleItems[i]].node
+	*
+	* Every item is one primitive of one node with the world space box enclosing the primitive's bounds transformed by the node's world matrix.
+	* Queries test these boxes, so ray hits are the entry points of boxes and not of triangles. Skinned primitives use their bind pose bounds.
+	*
+	* @note The node hierarchy is fixed at build(), nodes or meshes added to the model later need another build()
+	*/
+	class SceneBvh
+	{
+	public:
+		struct Item {
+			Node *node;
+			Primitive *primitive;
+			glm::vec3 min;
+			glm::vec3 max;
+		};
+
+		struct Ray {
+			glm::vec3 origin;
+			glm::vec3 direction;
+			float maxDistance = FLT_MAX;
+		};
+
+		struct RayHit {
+			/** @brief Index of the nearest item hit, invalidItem if the ray doesn't hit any */
+			uint32_t item;
+			/** @brief Distance along the ray direction (in units of its length) to the box entry, zero if the origin is inside the box */
+			float distance;
+		};
+
+		static const uint32_t invalidItem = UINT32_MAX;
+		/** @brief Maximum number of frustums of one queryFrustums() call */
+		static const uint32_t maxFrustums = 32;
+
+		SceneBvh(vkglTF::Model &model);
+		void build(vks::ThreadPool *threadPool = nullptr);
+		bool refit();
+		void queryFrustum(const vks::Frustum &frustum, std::vector<uint32_t> &items) const;
+		void queryFrustums(const vks::Frustum *frustums, uint32_t frustumCount, std::vector<uint32_t> *items) const;
+		void querySphere(const glm::vec3 &center, float radius, std::vector<uint32_t> &items) const;
+		void querySpheres(const glm::vec4 *spheres, size_t sphereCount, std::vector<uint32_t> *items, vks::ThreadPool *threadPool = nullptr) const;
+		bool raycast(const Ray &ray, RayHit &hit) const;
+		void raycast(const Ray *rays, size_t rayCount, RayHit *hits, vks::ThreadPool *threadPool = nullptr) const;
+		const std::vector<Item> &getItems() const;
+		void getBounds(glm::vec3 &min, glm::vec3 &max) const;
+	private:
+		// Children are allocated after their parent, so nodes with a larger index are never ancestors of nodes with a smaller one
+		struct BvhNode {
+			glm::vec3 min;
+			glm::vec3 max;
+			// Index of the first child of an inner node (the second one follows it) or of the first entry in itemIndices of a leaf
+			uint32_t first;
+			// Number of items of a leaf, zero for inner nodes
+			uint32_t count;
+			uint32_t parent;
+		};
+		// Node of the hierarchy that still has to be split, with its range in itemIndices
+		struct BuildTask {
+			uint32_t node;
+			uint32_t begin;
+			uint32_t end;
+		};
+		vkglTF::Model &model;
+		std::vector<Item> items;
+		// Items of the leaves, each leaf owns a contiguous range
+		std::vector<uint32_t> itemIndices;
+		// Leaf of every item
+		std::vector<uint32_t> itemLeaves;
+		std::vector<BvhNode> nodes;
+		std::atomic<uint32_t> nodeCount{ 0 };
+		// Nodes whose bounds need to be recomputed by refit()
+		std::vector<uint8_t> dirtyNodes;
+		std::vector<glm::vec3> centroids;
+		// World matrix the bounds of each item were computed with
+		std::vector<glm::mat4> itemMatrices;
+		void updateItemBounds(uint32_t index);
+		void buildNode(const BuildTask &task, vks::ThreadPool *threadPool);
+		bool findSplit(uint32_t begin, uint32_t end, const glm::vec3 &centroidMin, const glm::vec3 &centroidMax, uint32_t &axis, float &position, float &cost) const;
+	};
+
+	/**
+	* Triangle BVH over the world space triangles of a model's mesh nodes, laid out for shader traversal without a stack
+	*
+	* Usage:
+	*	model.loadFromFile(filename, vulkanDevice, queue, vkglTF::FileLoadingFlags::KeepHostGeometry);
+	*	vkglTF::TriangleBvh bvh;
+	*	bvh.build(model);
+	*	// Upload getNodes(), getTriangles() and getTriangleNormals() into storage buffers
+	*
+	* Nodes are stored in depth first order, so the first child of an inner node directly follows it, and every node has a skip index pointing
+	* to the next node that isn't a descendant (the node count for the last ones). A shader walks the array with a single index:
+	*	uint index = 0;
+	*	while (index < nodeCount) {
+	*		if (the ray hits nodes[index]'s box) {
+	*			test the (nodes[index].triangles & 0xF) triangles starting at (nodes[index].triangles >> 4), if any
+	*			index = leaf ? nodes[index].skipIndex : index + 1;
+	*		} else {
+	*			index = nodes[index].skipIndex;
+	*		}
+	*	}
+	* Children aren't visited front to back, a closest hit search relies on shrinking the ray's maximum distance to cull boxes.
+	*
+	* @note The model needs to be loaded with FileLoadingFlags::KeepHostGeometry and without PreTransformVertices, as the node matrices are applied
+	* @note Uses the world matrices cached by the last Model::updateNodes() pass, skinned and morphed positions are not applied
+	*/
+	class TriangleBvh
+	{
+	public:
+		// Layouts below match std430 storage buffers in the shaders
+		struct Node {
+			glm::vec3 min;
+			uint32_t skipIndex;
+			glm::vec3 max;
+			// First triangle << 4 | triangle count of a leaf, zero for inner nodes
+			uint32_t triangles;
+		};
+
+		struct Triangle {
+			glm::vec3 v0;
+			// Index into the model's materials
+			uint32_t materialIndex;
+			glm::vec3 v1;
+			float padding0;
+			glm::vec3 v2;
+			float padding1;
+		};
+
+		// World space vertex normals of a triangle, kept apart from the positions that traversal reads
+		struct TriangleNormals {
+			glm::vec4 n0;
+			glm::vec4 n1;
+			glm::vec4 n2;
+		};
+
+		/** @brief Leaves never hold more triangles, the count needs to fit into the low four bits of Node::triangles */
+		static const uint32_t maxLeafTriangles = 4;
+
+		void build(vkglTF::Model &model, const glm::mat4 &transform = glm::mat4(1.0f));
+		const std::vector<Node> &getNodes() const;
+		const std::vector<Triangle> &getTriangles() const;
+		const std::vector<TriangleNormals> &getTriangleNormals() const;
+		uint32_t getDepth() const;
+	private:
+		struct BuildTask {
+			uint32_t begin;
+			uint32_t end;
+			uint32_t parent;
+			uint32_t depth;
+			bool right;
+		};
+		std::vector<Node> nodes;
+		std::vector<Triangle> triangles;
+		std::vector<TriangleNormals> triangleNormals;
+		uint32_t depth = 0;
+	};
+}
@@ -0,0 +1,559 @@
+/*
+* GPU culling for glTF models
+*
+* Culls the flattened draw list of a vkglTF::Model (see Model::prepareIndirectDraw) in a compute shader against the view frustum and a
+* hierarchical depth buffer of the previous frame, selects the level of detail of every visible draw and writes compacted indirect commands
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <array>
+#include <algorithm>
+#include "VulkanglTFCulling.h"
+#include "VulkanglTFModel.h"
+#include "VulkanDevice.h"
+#include "frustum.hpp"
+
+namespace vkglTF
+{
+	// Work group size of the culling shader
+	static const uint32_t cullGroupSize = 64;
+
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (alignment > 1) ? (value + alignment - 1) / alignment * alignment : value;
+	}
+
+	/**
+	* @param device Device to create the compute pipeline and buffers on
+	* @param model Loaded model, its draw list is fixed at construction
+	* @param shaderFile SPIR-V file of the "base/cull.comp" shader
+	* @param slotCount Number of command and count buffer sets, e.g. the number of async compute slots or frames in flight
+	*
+	* @note If the model has no draws or the shader can't be loaded, no resources are created and isSupported() returns false
+	*/
+	GpuCulling::GpuCulling(vks::VulkanDevice *device, vkglTF::Model &model, const std::string &shaderFile, uint32_t slotCount) : device(device), model(model)
+	{
+		model.prepareIndirectDraw();
+		const Model::IndirectDraw &indirect = model.indirect;
+		const uint32_t lastGroup = Model::IndirectDraw::groupCount - 1;
+		drawCount = indirect.firstDraw[lastGroup] + indirect.drawCount[lastGroup];
+		if ((drawCount == 0) || (slotCount == 0))
+		{
+			return;
+		}
+		compact = indirect.vkCmdDrawIndexedIndirectCountKHR != nullptr;
+
+#if defined(__ANDROID__)
+		shaderModule = vks::tools::loadShader(androidApp->activity->assetManager, shaderFile.c_str(), device->logicalDevice);
+#else
+		shaderModule = vks::tools::loadShader(shaderFile.c_str(), device->logicalDevice);
+#endif
+		if (shaderModule == VK_NULL_HANDLE)
+		{
+			return;
+		}
+
+		// Depth at the far plane never occludes anything
+		float farDepth = 1.0f;
+		emptyPyramid.fromBuffer(&farDepth, sizeof(farDepth), VK_FORMAT_R32_SFLOAT, 1, 1, device, VK_NULL_HANDLE, VK_FILTER_NEAREST);
+
+		slots.resize(slotCount);
+		for (auto &slot : slots)
+		{
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&slot.commands,
+				drawCount * sizeof(VkDrawIndexedIndirectCommand)));
+			// Counts are reset with a fill before every culling pass
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&slot.counts,
+				Model::IndirectDraw::groupCount * sizeof(uint32_t)));
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&slot.uniformBuffer,
+				sizeof(UniformData)));
+			VK_CHECK_RESULT(slot.uniformBuffer.map());
+			slot.depthPyramid = emptyPyramid.descriptor;
+			slot.uniformData.drawCount = drawCount;
+			slot.uniformData.compact = compact ? 1 : 0;
+			for (uint32_t group = 0; group < Model::IndirectDraw::groupCount; group++)
+			{
+				slot.uniformData.firstDraw[group] = indirect.firstDraw[group];
+			}
+			slot.uniformData.firstDraw[Model::IndirectDraw::groupCount] = drawCount;
+			slot.uniformData.firstSequence[Model::IndirectDraw::groupCount] = 1;
+		}
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 7),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 8),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 9),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8 * slotCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, slotCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, slotCount),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, slotCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+
+		for (auto &slot : slots)
+		{
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &slot.descriptorSet));
+			updateDescriptorSet(slot);
+		}
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCI.stage.module = shaderModule;
+		pipelineCI.stage.pName = "main";
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline));
+
+		supported = true;
+	}
+
+	GpuCulling::~GpuCulling()
+	{
+		for (auto &slot : slots)
+		{
+			slot.commands.destroy();
+			slot.counts.destroy();
+			slot.uniformBuffer.destroy();
+			slot.sequences.destroy();
+			slot.preprocess.destroy();
+		}
+		generated.materialShaderGroups.destroy();
+		if (generated.indirectCommandsLayout)
+		{
+			generated.vkDestroyIndirectCommandsLayoutNV(device->logicalDevice, generated.indirectCommandsLayout, nullptr);
+		}
+		if (supported)
+		{
+			emptyPyramid.destroy();
+		}
+		if (pipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+		}
+		if (pipelineLayout)
+		{
+			vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		}
+		if (descriptorPool)
+		{
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		}
+		if (descriptorSetLayout)
+		{
+			vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		}
+		if (shaderModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, shaderModule, nullptr);
+		}
+	}
+
+	void GpuCulling::updateDescriptorSet(Slot &slot)
+	{
+		Model::IndirectDraw &indirect = model.indirect;
+		// The sequence bindings are only accessed with generated commands, until then they alias buffers of the right type
+		VkDescriptorBufferInfo &sequences = generated.enabled ? slot.sequences.descriptor : slot.commands.descriptor;
+		VkDescriptorBufferInfo &materialShaderGroups = generated.enabled ? generated.materialShaderGroups.descriptor : indirect.drawData.descriptor;
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(slot.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &indirect.transforms.descriptor),
+			vks::initializers::writeDescriptorSet(slot.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &indirect.drawData.descriptor),
+			vks::initializers::writeDescriptorSet(slot.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &indirect.lods.descriptor),
+			vks::initializers::writeDescriptorSet(slot.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &indirect.bounds.descriptor),
+			vks::initializers::writeDescriptorSet(slot.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &slot.commands.descriptor),
+			vks::initializers::writeDescriptorSet(slot.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &slot.counts.descriptor),
+			vks::initializers::writeDescriptorSet(slot.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 6, &slot.uniformBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(slot.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7, &slot.depthPyramid),
+			vks::initializers::writeDescriptorSet(slot.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8, &sequences),
+			vks::initializers::writeDescriptorSet(slot.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 9, &materialShaderGroups),
+		};
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	bool GpuCulling::isSupported() const
+	{
+		return supported;
+	}
+
+	/**
+	* Update the view a slot is culled for
+	*
+	* @param errorPerDistance Simplification error allowed per unit of distance for the level of detail selection (see Primitive::selectLod), zero always selects the full detail level
+	*
+	* @note Must only be called for a slot whose last culling pass has finished
+	*/
+	void GpuCulling::update(uint32_t slot, const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &viewPos, float errorPerDistance)
+	{
+		if (!supported)
+		{
+			return;
+		}
+		Slot &target = slots[slot];
+		vks::Frustum frustum;
+		frustum.update(projection * view);
+		for (uint32_t i = 0; i < 6; i++)
+		{
+			target.uniformData.frustumPlanes[i] = frustum.planes[i];
+		}
+		target.uniformData.viewPos = glm::vec4(viewPos, 1.0f);
+		target.uniformData.errorPerDistance = errorPerDistance;
+		memcpy(target.uniformBuffer.mapped, &target.uniformData, sizeof(UniformData));
+	}
+
+	/**
+	* Set the depth pyramid a slot's draws are tested against, a null view disables occlusion culling
+	*
+	* @param view View of all levels of the pyramid, in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL when the culling pass runs
+	* @param sampler Sampler with nearest filtering and clamp to edge addressing
+	* @param width Width of the pyramid's first level
+	* @param height Height of the pyramid's first level
+	* @param levelCount Number of levels in the view
+	* @param viewProjection View projection matrix the depth of the pyramid was rendered with
+	*
+	* @note Must only be called for a slot whose last culling pass has finished, the descriptor set is only updated if the view changes
+	*/
+	void GpuCulling::setDepthPyramid(uint32_t slot, VkImageView view, VkSampler sampler, uint32_t width, uint32_t height, uint32_t levelCount, const glm::mat4 &viewProjection)
+	{
+		if (!supported)
+		{
+			return;
+		}
+		Slot &target = slots[slot];
+		VkDescriptorImageInfo depthPyramid = { sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		if (view == VK_NULL_HANDLE)
+		{
+			depthPyramid = emptyPyramid.descriptor;
+		}
+		if ((depthPyramid.imageView != target.depthPyramid.imageView) || (depthPyramid.sampler != target.depthPyramid.sampler))
+		{
+			target.depthPyramid = depthPyramid;
+			updateDescriptorSet(target);
+		}
+		target.uniformData.occlusionViewProjection = viewProjection;
+		target.uniformData.pyramid = glm::vec4((float)width, (float)height, (float)levelCount, (view != VK_NULL_HANDLE) ? 1.0f : 0.0f);
+		memcpy(target.uniformBuffer.mapped, &target.uniformData, sizeof(UniformData));
+	}
+
+	/**
+	* Record the culling pass of a slot, outside of a render pass
+	*
+	* The previous draws from the slot's buffers must have finished or be ordered before this pass (a semaphore with async compute), the commands
+	* are ready for indirect draws recorded after it on the same queue. With async compute on a different queue family, register the slot's buffers
+	* with VulkanExampleBase::addAsyncComputeBuffer() for the ownership transfer.
+	*/
+	void GpuCulling::record(VkCommandBuffer commandBuffer, uint32_t slot)
+	{
+		if (!supported)
+		{
+			return;
+		}
+		Slot &target = slots[slot];
+
+		// Draws reading the previous contents of the buffers have to finish before they're overwritten
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = 0;
+		memoryBarrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdFillBuffer(commandBuffer, target.counts.buffer, 0, VK_WHOLE_SIZE, 0);
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer = target.counts.buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &target.descriptorSet, 0, nullptr);
+		vkCmdDispatch(commandBuffer, (drawCount + cullGroupSize - 1) / cullGroupSize, 1, 1);
+
+		// Generated commands read their sequences like indirect commands (without a separate preprocess pass)
+		VkBufferMemoryBarrier bufferBarriers[2] = { bufferBarrier, bufferBarrier };
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			bufferBarriers[i].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarriers[i].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		}
+		bufferBarriers[0].buffer = generated.enabled ? target.sequences.buffer : target.commands.buffer;
+		bufferBarriers[1].buffer = target.counts.buffer;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, 2, bufferBarriers, 0, nullptr);
+	}
+
+	/** @brief Indirect commands of a slot in the layout of the model's commands, see Model::drawIndirect */
+	VkBuffer GpuCulling::getCommandBuffer(uint32_t slot) const
+	{
+		return supported ? slots[slot].commands.buffer : model.indirect.commands.buffer;
+	}
+
+	/** @brief Draw count per alpha mode group of a slot */
+	VkBuffer GpuCulling::getCountBuffer(uint32_t slot) const
+	{
+		return supported ? slots[slot].counts.buffer : model.indirect.counts.buffer;
+	}
+
+	/**
+	* Let the culling pass write device generated commands (VK_NV_device_generated_commands) that bind the shader group of each draw's material
+	*
+	* @param pipeline Graphics pipeline with one shader group per shader permutation, see createShaderGroupPipeline()
+	* @param pipelineLayout Layout of the pipeline, with a push constant range of two uints (transform and material index) at pushConstantOffset
+	* @param materialShaderGroups Shader group index of every material of the model
+	* @param pushConstantStages Stages of the push constant range
+	* @param pushConstantOffset Offset of the transform and material index in the push constant range
+	*
+	* @return False if the extension isn't enabled or the draws exceed its limits, the slots keep their indirect commands then
+	*
+	* @note Must be called before the first culling pass, the slots are drawn with drawGenerated() afterwards (the count buffers change their layout)
+	*/
+	bool GpuCulling::enableGeneratedCommands(VkPipeline pipeline, VkPipelineLayout pipelineLayout, const std::vector<uint32_t> &materialShaderGroups, VkShaderStageFlags pushConstantStages, uint32_t pushConstantOffset)
+	{
+		if (!supported || generated.enabled)
+		{
+			return generated.enabled;
+		}
+		assert(materialShaderGroups.size() == model.materials.size());
+
+		// Only available if the extension has been enabled on the device
+		generated.vkCreateIndirectCommandsLayoutNV = reinterpret_cast<PFN_vkCreateIndirectCommandsLayoutNV>(vkGetDeviceProcAddr(device->logicalDevice, "vkCreateIndirectCommandsLayoutNV"));
+		generated.vkDestroyIndirectCommandsLayoutNV = reinterpret_cast<PFN_vkDestroyIndirectCommandsLayoutNV>(vkGetDeviceProcAddr(device->logicalDevice, "vkDestroyIndirectCommandsLayoutNV"));
+		generated.vkGetGeneratedCommandsMemoryRequirementsNV = reinterpret_cast<PFN_vkGetGeneratedCommandsMemoryRequirementsNV>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetGeneratedCommandsMemoryRequirementsNV"));
+		generated.vkCmdExecuteGeneratedCommandsNV = reinterpret_cast<PFN_vkCmdExecuteGeneratedCommandsNV>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdExecuteGeneratedCommandsNV"));
+		if (!generated.vkCreateIndirectCommandsLayoutNV || !generated.vkDestroyIndirectCommandsLayoutNV || !generated.vkGetGeneratedCommandsMemoryRequirementsNV || !generated.vkCmdExecuteGeneratedCommandsNV)
+		{
+			return false;
+		}
+
+		VkPhysicalDeviceDeviceGeneratedCommandsPropertiesNV generatedCommandsProperties{};
+		generatedCommandsProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DEVICE_GENERATED_COMMANDS_PROPERTIES_NV;
+		VkPhysicalDeviceProperties2 deviceProperties2{};
+		deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		deviceProperties2.pNext = &generatedCommandsProperties;
+		vkGetPhysicalDeviceProperties2(device->physicalDevice, &deviceProperties2);
+
+		const Model::IndirectDraw &indirect = model.indirect;
+		const uint32_t groupCount = Model::IndirectDraw::groupCount;
+		for (uint32_t group = 0; group < groupCount; group++)
+		{
+			if (indirect.drawCount[group] > generatedCommandsProperties.maxIndirectSequenceCount)
+			{
+				return false;
+			}
+		}
+
+		// Shader group, transform and material index and draw of a sequence, all in one interleaved stream
+		std::array<VkIndirectCommandsLayoutTokenNV, 3> tokens{};
+		for (auto &token : tokens)
+		{
+			token.sType = VK_STRUCTURE_TYPE_INDIRECT_COMMANDS_LAYOUT_TOKEN_NV;
+			token.stream = 0;
+		}
+		tokens[0].tokenType = VK_INDIRECT_COMMANDS_TOKEN_TYPE_SHADER_GROUP_NV;
+		tokens[0].offset = offsetof(Sequence, shaderGroup);
+		tokens[1].tokenType = VK_INDIRECT_COMMANDS_TOKEN_TYPE_PUSH_CONSTANT_NV;
+		tokens[1].offset = offsetof(Sequence, transformIndex);
+		tokens[1].pushconstantPipelineLayout = pipelineLayout;
+		tokens[1].pushconstantShaderStageFlags = pushConstantStages;
+		tokens[1].pushconstantOffset = pushConstantOffset;
+		tokens[1].pushconstantSize = 2 * sizeof(uint32_t);
+		tokens[2].tokenType = VK_INDIRECT_COMMANDS_TOKEN_TYPE_DRAW_INDEXED_NV;
+		tokens[2].offset = offsetof(Sequence, draw);
+		const uint32_t streamStride = sizeof(Sequence);
+		VkIndirectCommandsLayoutCreateInfoNV indirectCommandsLayoutCI{};
+		indirectCommandsLayoutCI.sType = VK_STRUCTURE_TYPE_INDIRECT_COMMANDS_LAYOUT_CREATE_INFO_NV;
+		indirectCommandsLayoutCI.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		indirectCommandsLayoutCI.tokenCount = static_cast<uint32_t>(tokens.size());
+		indirectCommandsLayoutCI.pTokens = tokens.data();
+		indirectCommandsLayoutCI.streamCount = 1;
+		indirectCommandsLayoutCI.pStreamStrides = &streamStride;
+		VK_CHECK_RESULT(generated.vkCreateIndirectCommandsLayoutNV(device->logicalDevice, &indirectCommandsLayoutCI, nullptr, &generated.indirectCommandsLayout));
+
+		// Every group is executed separately (to keep the alpha mode order), so its sequences and count need to start at aligned offsets
+		const VkDeviceSize streamAlignment = std::max(generatedCommandsProperties.minIndirectCommandsBufferOffsetAlignment, streamStride);
+		assert(streamAlignment % streamStride == 0);
+		generated.countStride = static_cast<uint32_t>(alignUp(sizeof(uint32_t), generatedCommandsProperties.minSequencesCountBufferOffsetAlignment));
+		uint32_t sequenceCount = 0;
+		VkDeviceSize preprocessSize = 0;
+		VkDeviceSize preprocessAlignment = 1;
+		for (uint32_t group = 0; group < groupCount; group++)
+		{
+			generated.firstSequence[group] = static_cast<uint32_t>(alignUp(sequenceCount * streamStride, streamAlignment) / streamStride);
+			sequenceCount = generated.firstSequence[group] + indirect.drawCount[group];
+
+			VkGeneratedCommandsMemoryRequirementsInfoNV memoryRequirementsInfo{};
+			memoryRequirementsInfo.sType = VK_STRUCTURE_TYPE_GENERATED_COMMANDS_MEMORY_REQUIREMENTS_INFO_NV;
+			memoryRequirementsInfo.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			memoryRequirementsInfo.pipeline = pipeline;
+			memoryRequirementsInfo.indirectCommandsLayout = generated.indirectCommandsLayout;
+			memoryRequirementsInfo.maxSequencesCount = std::max(indirect.drawCount[group], 1u);
+			VkMemoryRequirements2 memoryRequirements{};
+			memoryRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+			generated.vkGetGeneratedCommandsMemoryRequirementsNV(device->logicalDevice, &memoryRequirementsInfo, &memoryRequirements);
+			generated.preprocessOffset[group] = alignUp(preprocessSize, memoryRequirements.memoryRequirements.alignment);
+			generated.preprocessSize[group] = memoryRequirements.memoryRequirements.size;
+			preprocessSize = generated.preprocessOffset[group] + generated.preprocessSize[group];
+			preprocessAlignment = std::max(preprocessAlignment, memoryRequirements.memoryRequirements.alignment);
+		}
+
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&generated.materialShaderGroups,
+			materialShaderGroups.size() * sizeof(uint32_t),
+			(void*)materialShaderGroups.data()));
+
+		for (auto &slot : slots)
+		{
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&slot.sequences,
+				sequenceCount * sizeof(Sequence)));
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&slot.preprocess,
+				alignUp(preprocessSize, preprocessAlignment)));
+			// Counts at the aligned stride of the sequence count buffer offsets
+			slot.counts.destroy();
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&slot.counts,
+				groupCount * generated.countStride));
+			slot.uniformData.generatedCommands = 1;
+			for (uint32_t group = 0; group < groupCount; group++)
+			{
+				slot.uniformData.firstSequence[group] = generated.firstSequence[group];
+			}
+			slot.uniformData.firstSequence[groupCount] = generated.countStride / sizeof(uint32_t);
+			memcpy(slot.uniformBuffer.mapped, &slot.uniformData, sizeof(UniformData));
+		}
+
+		generated.pipeline = pipeline;
+		generated.pipelineLayout = pipelineLayout;
+		generated.enabled = true;
+		for (auto &slot : slots)
+		{
+			updateDescriptorSet(slot);
+		}
+		return true;
+	}
+
+	bool GpuCulling::generatedCommandsEnabled() const
+	{
+		return generated.enabled;
+	}
+
+	/**
+	* Draw the visible draws of a slot with the commands generated by its last culling pass, inside a render pass
+	*
+	* Binds the shader group pipeline, the model's vertex and index buffers and its indirect draw descriptor set (at bindSet, followed by the
+	* bindless materials with RenderFlags::BindImages), the render flags select the alpha mode groups as for Model::drawIndirect
+	*/
+	void GpuCulling::drawGenerated(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t renderFlags, uint32_t bindSet)
+	{
+		assert(generated.enabled);
+		const Slot &target = slots[slot];
+		const Model::IndirectDraw &indirect = model.indirect;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, generated.pipeline);
+		model.bindVertexBuffers(commandBuffer);
+		vkCmdBindIndexBuffer(commandBuffer, model.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, generated.pipelineLayout, bindSet, 1, &indirect.descriptorSet, 0, nullptr);
+		if ((renderFlags & RenderFlags::BindImages) && model.bindless.prepared)
+		{
+			model.bindBindless(commandBuffer, generated.pipelineLayout, bindSet + 1);
+		}
+
+		uint32_t firstGroup = 0;
+		uint32_t lastGroup = Model::IndirectDraw::groupCount - 1;
+		if (renderFlags & RenderFlags::RenderOpaqueNodes)
+		{
+			firstGroup = lastGroup = Material::ALPHAMODE_OPAQUE;
+		}
+		if (renderFlags & RenderFlags::RenderAlphaMaskedNodes)
+		{
+			firstGroup = lastGroup = Material::ALPHAMODE_MASK;
+		}
+		if (renderFlags & RenderFlags::RenderAlphaBlendedNodes)
+		{
+			firstGroup = lastGroup = Material::ALPHAMODE_BLEND;
+		}
+		for (uint32_t group = firstGroup; group <= lastGroup; group++)
+		{
+			if (indirect.drawCount[group] == 0)
+			{
+				continue;
+			}
+			VkIndirectCommandsStreamNV stream{ target.sequences.buffer, generated.firstSequence[group] * sizeof(Sequence) };
+			VkGeneratedCommandsInfoNV generatedCommandsInfo{};
+			generatedCommandsInfo.sType = VK_STRUCTURE_TYPE_GENERATED_COMMANDS_INFO_NV;
+			generatedCommandsInfo.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			generatedCommandsInfo.pipeline = generated.pipeline;
+			generatedCommandsInfo.indirectCommandsLayout = generated.indirectCommandsLayout;
+			generatedCommandsInfo.streamCount = 1;
+			generatedCommandsInfo.pStreams = &stream;
+			generatedCommandsInfo.sequencesCount = indirect.drawCount[group];
+			generatedCommandsInfo.preprocessBuffer = target.preprocess.buffer;
+			generatedCommandsInfo.preprocessOffset = generated.preprocessOffset[group];
+			generatedCommandsInfo.preprocessSize = generated.preprocessSize[group];
+			generatedCommandsInfo.sequencesCountBuffer = target.counts.buffer;
+			generatedCommandsInfo.sequencesCountOffset = group * generated.countStride;
+			generated.vkCmdExecuteGeneratedCommandsNV(commandBuffer, VK_FALSE, &generatedCommandsInfo);
+		}
+	}
+
+	/**
+	* Create a graphics pipeline that can be bound by device generated commands, with one shader group per set of shader stages
+	*
+	* All groups share the state of pipelineCI (its stages are replaced by the first group), its vertex input and tessellation state are used for every group.
+	* Requires VK_NV_device_generated_commands with the deviceGeneratedCommands feature enabled.
+	*/
+	VkResult GpuCulling::createShaderGroupPipeline(VkDevice device, VkPipelineCache pipelineCache, VkGraphicsPipelineCreateInfo pipelineCI, const std::vector<std::vector<VkPipelineShaderStageCreateInfo>> &shaderGroups, VkPipeline *pipeline)
+	{
+		assert(!shaderGroups.empty());
+		std::vector<VkGraphicsShaderGroupCreateInfoNV> groups(shaderGroups.size());
+		for (size_t i = 0; i < shaderGroups.size(); i++)
+		{
+			groups[i].sType = VK_STRUCTURE_TYPE_GRAPHICS_SHADER_GROUP_CREATE_INFO_NV;
+			groups[i].stageCount = static_cast<uint32_t>(shaderGroups[i].size());
+			groups[i].pStages = shaderGroups[i].data();
+			groups[i].pVertexInputState = pipelineCI.pVertexInputState;
+			groups[i].pTessellationState = pipelineCI.pTessellationState;
+		}
+		VkGraphicsPipelineShaderGroupsCreateInfoNV shaderGroupsCI{};
+		shaderGroupsCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_SHADER_GROUPS_CREATE_INFO_NV;
+		shaderGroupsCI.pNext = pipelineCI.pNext;
+		shaderGroupsCI.groupCount = static_cast<uint32_t>(groups.size());
+		shaderGroupsCI.pGroups = groups.data();
+		pipelineCI.pNext = &shaderGroupsCI;
+		pipelineCI.flags |= VK_PIPELINE_CREATE_INDIRECT_BINDABLE_BIT_NV;
+		pipelineCI.stageCount = groups[0].stageCount;
+		pipelineCI.pStages = groups[0].pStages;
+		return vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, pipeline);
+	}
+}
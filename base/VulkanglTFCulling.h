@@ -0,0 +1,146 @@
+/*
+* GPU culling for glTF models
+*
+* Culls the flattened draw list of a vkglTF::Model (see Model::prepareIndirectDraw) in a compute shader against the view frustum and a
+* hierarchical depth buffer of the previous frame, selects the level of detail of every visible draw and writes compacted indirect commands
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+#include "VulkanTexture.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	struct VulkanDevice;
+}
+
+namespace vkglTF
+{
+	class Model;
+
+	/**
+	* Compute culling pass using the GLSL "base/cull.comp" compute shader
+	*
+	* Usage:
+	*	vkglTF::GpuCulling culling(vulkanDevice, model, getShadersPath() + "base/cull.comp.spv", slotCount);
+	*	// Per frame, outside of a render pass (on the graphics queue or on the async compute queue, see VulkanExampleBase::prepareAsyncCompute)
+	*	culling.update(slot, camera.matrices.perspective, camera.matrices.view, camera.position, errorPerDistance);
+	*	culling.setDepthPyramid(slot, pyramidView, pyramidSampler, pyramidWidth, pyramidHeight, pyramidLevels, previousViewProjection);
+	*	culling.record(commandBuffer, slot);
+	*	// In the render pass
+	*	model.drawIndirect(commandBuffer, renderFlags, pipelineLayout, 0, culling.getCommandBuffer(slot), culling.getCountBuffer(slot));
+	*
+	* Every slot has its own commands and counts, so the draws of one slot can be culled while the graphics queue draws another one. The commands are
+	* compacted per alpha mode group if the device supports VK_KHR_draw_indirect_count, otherwise culled draws keep their place with an instance
+	* count of zero.
+	*
+	* Occlusion culling is skipped while no depth pyramid is set. The pyramid is expected to hold the farthest depth (standard 0 = near depth range)
+	* of the texels each of its texels covers, the view projection matrix passed with it is the one the depth was rendered with.
+	*
+	* Device generated commands (VK_NV_device_generated_commands) let the culling pass also select the pipeline of every draw, so materials with
+	* different shader permutations are drawn without bucketing them on the host:
+	*	// Every shader permutation is a shader group of one pipeline, all sharing the same state and pipeline layout
+	*	vkglTF::GpuCulling::createShaderGroupPipeline(device, pipelineCache, pipelineCI, { opaqueStages, maskedStages, emissiveStages }, &pipeline);
+	*	// Shader group of every material of the model
+	*	culling.enableGeneratedCommands(pipeline, pipelineLayout, materialShaderGroups);
+	*	// In the render pass, instead of model.drawIndirect
+	*	culling.drawGenerated(commandBuffer, slot, renderFlags);
+	* Each visible draw is written as a sequence binding its material's shader group, pushing its transform and material index and drawing its
+	* level of detail. The extension and its deviceGeneratedCommands feature have to be enabled on the device.
+	*
+	* @note The model's indirect draw path is prepared by the constructor if it hasn't been already, changes of the node transforms are picked up the same way
+	* @note With async compute on a different queue family the depth pyramid needs to be created with concurrent sharing between both families
+	*/
+	class GpuCulling
+	{
+	private:
+		// Uniform block of a slot, see cull.comp
+		struct UniformData {
+			glm::mat4 occlusionViewProjection;
+			glm::vec4 frustumPlanes[6];
+			glm::vec4 viewPos;
+			// x = width, y = height, z = level count of the depth pyramid, w = 1 if occlusion culling is enabled
+			glm::vec4 pyramid;
+			float errorPerDistance;
+			uint32_t drawCount;
+			uint32_t compact;
+			uint32_t generatedCommands;
+			uint32_t firstDraw[4];
+			// First sequence of each group, the last element is the stride of the counts in uints
+			uint32_t firstSequence[4];
+		};
+		// Matches the sequences of cull.comp and the tokens of the indirect commands layout
+		struct Sequence {
+			uint32_t shaderGroup;
+			uint32_t transformIndex;
+			uint32_t materialIndex;
+			VkDrawIndexedIndirectCommand draw;
+		};
+		struct Slot {
+			vks::Buffer commands;
+			vks::Buffer counts;
+			vks::Buffer uniformBuffer;
+			UniformData uniformData{};
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			VkDescriptorImageInfo depthPyramid{};
+			// Generated commands only
+			vks::Buffer sequences;
+			vks::Buffer preprocess;
+		};
+		// Device generated commands, see enableGeneratedCommands()
+		struct GeneratedCommands {
+			bool enabled = false;
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+			VkIndirectCommandsLayoutNV indirectCommandsLayout = VK_NULL_HANDLE;
+			vks::Buffer materialShaderGroups;
+			// Stride of the group counts in bytes, for the count buffer offset alignment
+			uint32_t countStride = sizeof(uint32_t);
+			uint32_t firstSequence[3]{};
+			VkDeviceSize preprocessOffset[3]{};
+			VkDeviceSize preprocessSize[3]{};
+			PFN_vkCreateIndirectCommandsLayoutNV vkCreateIndirectCommandsLayoutNV = nullptr;
+			PFN_vkDestroyIndirectCommandsLayoutNV vkDestroyIndirectCommandsLayoutNV = nullptr;
+			PFN_vkGetGeneratedCommandsMemoryRequirementsNV vkGetGeneratedCommandsMemoryRequirementsNV = nullptr;
+			PFN_vkCmdExecuteGeneratedCommandsNV vkCmdExecuteGeneratedCommandsNV = nullptr;
+		} generated;
+		vks::VulkanDevice *device;
+		vkglTF::Model &model;
+		bool supported = false;
+		bool compact = false;
+		uint32_t drawCount = 0;
+		std::vector<Slot> slots;
+		// Bound in place of the depth pyramid while none is set
+		vks::Texture2D emptyPyramid;
+		VkShaderModule shaderModule = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		void updateDescriptorSet(Slot &slot);
+	public:
+		GpuCulling(vks::VulkanDevice *device, vkglTF::Model &model, const std::string &shaderFile, uint32_t slotCount = 1);
+		~GpuCulling();
+		bool isSupported() const;
+		void update(uint32_t slot, const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &viewPos, float errorPerDistance = 0.0f);
+		void setDepthPyramid(uint32_t slot, VkImageView view, VkSampler sampler, uint32_t width, uint32_t height, uint32_t levelCount, const glm::mat4 &viewProjection);
+		void record(VkCommandBuffer commandBuffer, uint32_t slot);
+		VkBuffer getCommandBuffer(uint32_t slot) const;
+		VkBuffer getCountBuffer(uint32_t slot) const;
+		bool enableGeneratedCommands(VkPipeline pipeline, VkPipelineLayout pipelineLayout, const std::vector<uint32_t> &materialShaderGroups, VkShaderStageFlags pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, uint32_t pushConstantOffset = 0);
+		bool generatedCommandsEnabled() const;
+		void drawGenerated(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t renderFlags = 0, uint32_t bindSet = 0);
+		static VkResult createShaderGroupPipeline(VkDevice device, VkPipelineCache pipelineCache, VkGraphicsPipelineCreateInfo pipelineCI, const std::vector<std::vector<VkPipelineShaderStageCreateInfo>> &shaderGroups, VkPipeline *pipeline);
+	};
+}
@@ -12,11 +12,32 @@
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 
 #include "VulkanglTFModel.h"
+#include "threadpool.hpp"
+#include "VulkanMipGenerator.h"
+#include "VulkanTextureCompressor.h"
+#include "VulkanGeometryPool.h"
+#include "VulkanMappedFile.hpp"
+#include "VulkanMeshOptimizer.h"
+#include "VulkanStartupReport.h"
+#include <unordered_map>
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <glm/gtc/packing.hpp>
 
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
 uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor;
+bool vkglTF::inlineMaterialConstants = false;
+vks::MipGenerator *vkglTF::mipGenerator = nullptr;
+vks::TextureCompressor *vkglTF::textureCompressor = nullptr;
+vks::GeometryPool *vkglTF::geometryPool = nullptr;
+uint32_t vkglTF::lodLevelCount = 4;
+float vkglTF::lodTargetError = 0.02f;
+float vkglTF::animationFrameRate = 30.0f;
+float vkglTF::animationTolerance = 0.0005f;
+uint32_t vkglTF::textureArrayMaxSize = 1024;
 
 /*
 	We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
@@ -41,1415 +62,4552 @@ bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::s
 
 
 /*
-	glTF texture loading class
+	Image loading function used when loading a file, only keeps the encoded image data so images can be decoded in parallel after parsing
 */
-
-void vkglTF::Texture::updateDescriptor()
+bool loadImageDataFuncDeferred(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
 {
-	descriptor.sampler = sampler;
-	descriptor.imageView = view;
-	descriptor.imageLayout = imageLayout;
+	// KTX files will be handled by our own code
+	if (image->uri.find_last_of(".") != std::string::npos) {
+		if (image->uri.substr(image->uri.find_last_of(".") + 1) == "ktx") {
+			return true;
+		}
+	}
+
+	image->image.assign(bytes, bytes + size);
+	static_cast<std::vector<int>*>(userData)->push_back(imageIndex);
+	return true;
 }
 
-void vkglTF::Texture::destroy()
+/*
+	Start of the data of a buffer view, buffers mapped by LoadState::loadMappedFile are read directly from the mapped files
+	mappedBuffers may be null for models that weren't loaded from a file
+*/
+static const unsigned char* bufferViewData(const tinygltf::Model& model, const std::vector<const unsigned char*>* mappedBuffers, const tinygltf::BufferView& view)
 {
-	if (device)
-	{
-		vkDestroyImageView(device->logicalDevice, view, nullptr);
-		vkDestroyImage(device->logicalDevice, image, nullptr);
-		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
-		vkDestroySampler(device->logicalDevice, sampler, nullptr);
+	const size_t buffer = static_cast<size_t>(view.buffer);
+	if (mappedBuffers && (buffer < mappedBuffers->size()) && (*mappedBuffers)[buffer]) {
+		return (*mappedBuffers)[buffer] + view.byteOffset;
 	}
+	return model.buffers[buffer].data.data() + view.byteOffset;
 }
 
-void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue)
+/*
+	Runs job(i) for all i in [0, count) spread across the workers of the thread pool, or on the calling thread if no pool is passed
+*/
+static void parallelFor(vks::ThreadPool* threadPool, size_t count, const std::function<void(size_t)>& job)
 {
-	this->device = device;
-
-	bool isKtx = false;
-	// Image points to an external ktx file
-	if (gltfimage.uri.find_last_of(".") != std::string::npos) {
-		if (gltfimage.uri.substr(gltfimage.uri.find_last_of(".") + 1) == "ktx") {
-			isKtx = true;
+	if (!threadPool || (threadPool->getThreadCount() == 0)) {
+		for (size_t i = 0; i < count; i++) {
+			job(i);
 		}
+		return;
 	}
+	// Items (images, meshes) vary a lot in cost, so every item is a job of its own for idle workers to steal
+	threadPool->parallelFor(count, 1, [&job](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			job(i);
+		}
+	});
+}
 
-	VkFormat format;
+/*
+	Reads the float accessor of an EXT_mesh_gpu_instancing attribute, returns false if the attribute isn't present or not stored as floats
+*/
+static bool readInstanceAttribute(const tinygltf::Model& model, const std::vector<const unsigned char*>* mappedBuffers, const tinygltf::Value& attributes, const char* name, int components, std::vector<float>& values)
+{
+	if (!attributes.Has(name)) {
+		return false;
+	}
+	const int accessorIndex = attributes.Get(name).Get<int>();
+	if ((accessorIndex < 0) || (accessorIndex >= static_cast<int>(model.accessors.size()))) {
+		return false;
+	}
+	const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+	if ((accessor.bufferView < 0) || (accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT) || (tinygltf::GetNumComponentsInType(accessor.type) != components)) {
+		return false;
+	}
+	const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+	const int stride = accessor.ByteStride(view);
+	if (stride <= 0) {
+		return false;
+	}
+	const unsigned char* data = bufferViewData(model, mappedBuffers, view) + accessor.byteOffset;
+	values.resize(accessor.count * components);
+	for (size_t i = 0; i < accessor.count; i++) {
+		memcpy(&values[i * components], data + i * stride, components * sizeof(float));
+	}
+	return true;
+}
 
-	if (!isKtx) {
-		// Texture was loaded using STB_Image
+/*
+	Builds the instance transforms of a node from the TRANSLATION, ROTATION and SCALE attributes of EXT_mesh_gpu_instancing
+*/
+static void readInstanceMatrices(const tinygltf::Model& model, const std::vector<const unsigned char*>* mappedBuffers, const tinygltf::Value& attributes, std::vector<glm::mat4>& matrices)
+{
+	std::vector<float> translations, rotations, scales;
+	size_t count = 0;
+	if (readInstanceAttribute(model, mappedBuffers, attributes, "TRANSLATION", 3, translations)) {
+		count = std::max(count, translations.size() / 3);
+	}
+	if (readInstanceAttribute(model, mappedBuffers, attributes, "ROTATION", 4, rotations)) {
+		count = std::max(count, rotations.size() / 4);
+	}
+	if (readInstanceAttribute(model, mappedBuffers, attributes, "SCALE", 3, scales)) {
+		count = std::max(count, scales.size() / 3);
+	}
+	matrices.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		const glm::vec3 translation = (i < translations.size() / 3) ? glm::make_vec3(&translations[i * 3]) : glm::vec3(0.0f);
+		// glTF stores quaternions as x, y, z, w like glm::make_quat
+		const glm::quat rotation = (i < rotations.size() / 4) ? glm::make_quat(&rotations[i * 4]) : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		const glm::vec3 scale = (i < scales.size() / 3) ? glm::make_vec3(&scales[i * 3]) : glm::vec3(1.0f);
+		matrices[i] = glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale);
+	}
+}
 
-		unsigned char* buffer = nullptr;
-		VkDeviceSize bufferSize = 0;
-		bool deleteBuffer = false;
-		if (gltfimage.component == 3) {
-			// Most devices don't support RGB only on Vulkan so convert if necessary
-			// TODO: Check actual format support and transform only if required
-			bufferSize = gltfimage.width * gltfimage.height * 4;
-			buffer = new unsigned char[bufferSize];
-			unsigned char* rgba = buffer;
-			unsigned char* rgb = &gltfimage.image[0];
-			for (size_t i = 0; i < gltfimage.width * gltfimage.height; ++i) {
-				for (int32_t j = 0; j < 3; ++j) {
-					rgba[j] = rgb[j];
-				}
-				rgba += 4;
-				rgb += 3;
-			}
-			deleteBuffer = true;
+/*
+	Reads a vec3 morph target attribute for the vertices of a primitive, sparse accessors (with or without a buffer view) are expanded
+	Returns false if the accessor can't be read, e.g. for quantized attributes, targets then don't move that attribute
+*/
+static bool readMorphAttribute(const tinygltf::Model& model, const std::vector<const unsigned char*>* mappedBuffers, int accessorIndex, size_t vertexCount, std::vector<glm::vec3>& values)
+{
+	if ((accessorIndex < 0) || (accessorIndex >= static_cast<int>(model.accessors.size()))) {
+		return false;
+	}
+	const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+	if ((accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT) || (accessor.type != TINYGLTF_TYPE_VEC3) || (accessor.count < vertexCount)) {
+		return false;
+	}
+	values.assign(vertexCount, glm::vec3(0.0f));
+	if (accessor.bufferView > -1) {
+		const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+		const int stride = accessor.ByteStride(view);
+		if (stride <= 0) {
+			return false;
 		}
-		else {
-			buffer = &gltfimage.image[0];
-			bufferSize = gltfimage.image.size();
+		const unsigned char* data = bufferViewData(model, mappedBuffers, view) + accessor.byteOffset;
+		for (size_t i = 0; i < vertexCount; i++) {
+			memcpy(&values[i].x, data + i * stride, sizeof(glm::vec3));
 		}
+	}
+	if (accessor.sparse.isSparse) {
+		const int viewCount = static_cast<int>(model.bufferViews.size());
+		if ((accessor.sparse.indices.bufferView < 0) || (accessor.sparse.indices.bufferView >= viewCount) || (accessor.sparse.values.bufferView < 0) || (accessor.sparse.values.bufferView >= viewCount)) {
+			return false;
+		}
+		const unsigned char* indices = bufferViewData(model, mappedBuffers, model.bufferViews[accessor.sparse.indices.bufferView]) + accessor.sparse.indices.byteOffset;
+		const float* sparseValues = reinterpret_cast<const float*>(bufferViewData(model, mappedBuffers, model.bufferViews[accessor.sparse.values.bufferView]) + accessor.sparse.values.byteOffset);
+		for (int i = 0; i < accessor.sparse.count; i++) {
+			uint32_t index = 0;
+			switch (accessor.sparse.indices.componentType) {
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+				index = reinterpret_cast<const uint32_t*>(indices)[i];
+				break;
+			case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+				index = reinterpret_cast<const uint16_t*>(indices)[i];
+				break;
+			default:
+				index = indices[i];
+				break;
+			}
+			if (index < vertexCount) {
+				values[index] = glm::make_vec3(&sparseValues[i * 3]);
+			}
+		}
+	}
+	return true;
+}
 
-		format = VK_FORMAT_R8G8B8A8_UNORM;
-
-		VkFormatProperties formatProperties;
+/*
+	World matrix of an instance of the instanced draw path
+*/
+static glm::mat4 instanceWorldMatrix(const vkglTF::Model::InstanceSource& source)
+{
+	return (source.instance >= 0) ? source.node->worldMatrix * source.node->instanceMatrices[source.instance] : source.node->worldMatrix;
+}
 
-		width = gltfimage.width;
-		height = gltfimage.height;
-		mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+/*
+	Returns true if the material's primitives aren't drawn with the alpha mode selected by the render flags
+*/
+static bool skipMaterial(const vkglTF::Material& material, uint32_t renderFlags)
+{
+	bool skip = false;
+	if (renderFlags & vkglTF::RenderFlags::RenderOpaqueNodes) {
+		skip = (material.alphaMode != vkglTF::Material::ALPHAMODE_OPAQUE);
+	}
+	if (renderFlags & vkglTF::RenderFlags::RenderAlphaMaskedNodes) {
+		skip = (material.alphaMode != vkglTF::Material::ALPHAMODE_MASK);
+	}
+	if (renderFlags & vkglTF::RenderFlags::RenderAlphaBlendedNodes) {
+		skip = (material.alphaMode != vkglTF::Material::ALPHAMODE_BLEND);
+	}
+	return skip;
+}
 
-		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+/*
+	Vertex pulling format of a vertex attribute format used by the full or compact vertex layouts
+*/
+static vkglTF::Model::VertexFetchFormat vertexFetchFormat(VkFormat format)
+{
+	switch (format) {
+		case VK_FORMAT_R32G32_SFLOAT:
+			return vkglTF::Model::VertexFetchFormat::R32G32Sfloat;
+		case VK_FORMAT_R32G32B32_SFLOAT:
+			return vkglTF::Model::VertexFetchFormat::R32G32B32Sfloat;
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			return vkglTF::Model::VertexFetchFormat::R32G32B32A32Sfloat;
+		case VK_FORMAT_R16G16_SFLOAT:
+			return vkglTF::Model::VertexFetchFormat::R16G16Sfloat;
+		case VK_FORMAT_R16G16B16A16_SNORM:
+			return vkglTF::Model::VertexFetchFormat::R16G16B16A16Snorm;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+			return vkglTF::Model::VertexFetchFormat::R8G8B8A8Unorm;
+		case VK_FORMAT_R8G8B8A8_USCALED:
+			return vkglTF::Model::VertexFetchFormat::R8G8B8A8Uscaled;
+		default:
+			return vkglTF::Model::VertexFetchFormat::None;
+	}
+}
 
-		VkMemoryAllocateInfo memAllocInfo{};
-		memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		VkMemoryRequirements memReqs{};
+/*
+	Model cache file helpers
+*/
+static const uint32_t cacheMagic = 0x43474b56; // "VKGC"
+static const uint32_t cacheVersion = 5;
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
+static std::string getCacheFilename(const std::string& filename)
+{
+	return filename + ".cache";
+}
 
-		VkBufferCreateInfo bufferCreateInfo{};
-		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferCreateInfo.size = bufferSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+static std::string getTextureCacheFilename(const std::string& path, const std::string& uri)
+{
+	return path + "/" + uri + ".texcache";
+}
 
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, buffer, bufferSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+// 64 bit FNV-1a hash
+static uint64_t hashData(const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
 
-		VkImageCreateInfo imageCreateInfo{};
-		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageCreateInfo.format = format;
-		imageCreateInfo.mipLevels = mipLevels;
-		imageCreateInfo.arrayLayers = 1;
-		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageCreateInfo.extent = { width, height, 1 };
-		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+// Hash of a file's contents, 0 if the file can't be read
+static uint64_t hashFile(const std::string& filename)
+{
+	vks::MappedFile file;
+	if (!file.open(filename)) {
+		return 0;
+	}
+	return hashData(file.data, file.size);
+}
 
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+static bool isEmbeddedUri(const std::string& uri)
+{
+	return uri.empty() || (uri.compare(0, 5, "data:") == 0);
+}
 
-		VkImageSubresourceRange subresourceRange = {};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.levelCount = 1;
-		subresourceRange.layerCount = 1;
+static bool isKtxUri(const std::string& uri)
+{
+	return (uri.find_last_of(".") != std::string::npos) && (uri.substr(uri.find_last_of(".") + 1) == "ktx");
+}
 
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = 0;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
+/*
+	Images are only compressed if a compressor has been set and is supported by the device
+*/
+static bool compressTexturesEnabled(uint32_t fileLoadingFlags)
+{
+	return (fileLoadingFlags & vkglTF::FileLoadingFlags::CompressTextures) && !(fileLoadingFlags & vkglTF::FileLoadingFlags::DontLoadImages) && vkglTF::textureCompressor && vkglTF::textureCompressor->isSupported();
+}
 
-		VkBufferImageCopy bufferCopyRegion = {};
-		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		bufferCopyRegion.imageSubresource.mipLevel = 0;
-		bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-		bufferCopyRegion.imageSubresource.layerCount = 1;
-		bufferCopyRegion.imageExtent.width = width;
-		bufferCopyRegion.imageExtent.height = height;
-		bufferCopyRegion.imageExtent.depth = 1;
+/*
+	Descriptor buffers are filled once in finishLoading, so they can't pick up the images that are swapped in later
+*/
+static bool lazyImagesEnabled(uint32_t fileLoadingFlags)
+{
+	return (fileLoadingFlags & vkglTF::FileLoadingFlags::LazyImages) && !(fileLoadingFlags & (vkglTF::FileLoadingFlags::DontLoadImages | vkglTF::FileLoadingFlags::DescriptorBuffers));
+}
 
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+class CacheWriter {
+public:
+	std::vector<char> data;
+	template<typename T> void write(const T& value)
+	{
+		const char* bytes = reinterpret_cast<const char*>(&value);
+		data.insert(data.end(), bytes, bytes + sizeof(T));
+	}
+	void writeString(const std::string& value)
+	{
+		write<uint32_t>(static_cast<uint32_t>(value.size()));
+		data.insert(data.end(), value.begin(), value.end());
+	}
+	template<typename T> void writeVector(const std::vector<T>& values)
+	{
+		write<uint64_t>(values.size());
+		const char* bytes = reinterpret_cast<const char*>(values.data());
+		data.insert(data.end(), bytes, bytes + values.size() * sizeof(T));
+	}
+	void align(size_t alignment)
+	{
+		data.resize((data.size() + alignment - 1) / alignment * alignment, 0);
+	}
+};
 
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+// Bounds checked reads from a memory mapped cache file, failed is set on the first read past the end
+class CacheReader {
+public:
+	const char* data;
+	size_t size;
+	size_t offset = 0;
+	bool failed = false;
+	CacheReader(const char* data, size_t size) : data(data), size(size) {};
+	template<typename T> T read()
+	{
+		T value{};
+		if (!failed && (sizeof(T) <= size - offset)) {
+			memcpy(&value, data + offset, sizeof(T));
+			offset += sizeof(T);
 		}
+		else {
+			failed = true;
+		}
+		return value;
+	}
+	std::string readString()
+	{
+		uint32_t length = read<uint32_t>();
+		const char* bytes = static_cast<const char*>(readBlob(length));
+		return bytes ? std::string(bytes, length) : std::string();
+	}
+	template<typename T> void readVector(std::vector<T>& values)
+	{
+		uint64_t count = read<uint64_t>();
+		if (failed || (count > (size - offset) / sizeof(T))) {
+			failed = true;
+			return;
+		}
+		values.resize(static_cast<size_t>(count));
+		memcpy(values.data(), data + offset, static_cast<size_t>(count) * sizeof(T));
+		offset += static_cast<size_t>(count) * sizeof(T);
+	}
+	const void* readBlob(size_t bytes)
+	{
+		if (failed || (bytes > size - offset)) {
+			failed = true;
+			return nullptr;
+		}
+		const void* blob = data + offset;
+		offset += bytes;
+		return blob;
+	}
+	void align(size_t alignment)
+	{
+		offset = std::min(size, (offset + alignment - 1) / alignment * alignment);
+	}
+};
 
-		device->flushCommandBuffer(copyCmd, copyQueue, true);
-
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
-		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-		VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		for (uint32_t i = 1; i < mipLevels; i++) {
-			VkImageBlit imageBlit{};
+/*
+	Intermediate data of a model load
+*/
+struct vkglTF::Model::LoadState {
+	// Vertices and (zero based) indices of a single glTF primitive
+	struct PrimitiveData {
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		glm::vec3 posMin{};
+		glm::vec3 posMax{};
+		int material = -1;
+		// Levels of detail with index ranges relative to the primitive's indices, which contain the indices of all levels
+		std::vector<Primitive::Lod> lods;
+		// Meshlets of the full detail level, with vertex indices relative to the primitive's vertices
+		std::vector<vks::meshoptimizer::Meshlet> meshlets;
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint8_t> meshletTriangles;
+		// Sparse deltas of each morph target, with vertex indices relative to the primitive's vertices
+		std::vector<std::vector<MorphDelta>> morphTargets;
+	};
+	struct MeshData {
+		std::vector<PrimitiveData> primitives;
+		// Mesh of the first node without a skin that loaded the primitives, other nodes using the mesh share its vertices and indices
+		const Mesh* sharedMesh = nullptr;
+	};
 
-			imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.srcSubresource.layerCount = 1;
-			imageBlit.srcSubresource.mipLevel = i - 1;
-			imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
-			imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
-			imageBlit.srcOffsets[1].z = 1;
+	std::string filename;
+	uint32_t fileLoadingFlags = 0;
+	// Thread pool of the load, also used to decode lazily loaded images (see Model::LazyImages)
+	vks::ThreadPool* threadPool = nullptr;
+	bool fileLoaded = false;
+	std::string error;
+	tinygltf::Model gltfModel;
+	// Images whose encoded data still needs to be decoded
+	std::vector<int> deferredImages;
+	// With FileLoadingFlags::CompressTextures: hash of each image's encoded data and the images loaded from the texture cache, indexed like gltfModel.images
+	std::vector<uint64_t> imageHashes;
+	std::vector<vks::CompressedImage> compressedImages;
+	// Files mapped by loadMappedFile, the glTF (or .glb) file and external .bin files
+	std::vector<std::unique_ptr<vks::MappedFile>> mappedFiles;
+	// Start of each buffer of gltfModel in the mapped files, nullptr for buffers loaded by tinygltf (data URIs)
+	std::vector<const unsigned char*> mappedBuffers;
+	// Primitive data per glTF mesh, indexed like gltfModel.meshes
+	std::vector<MeshData> meshes;
+	std::vector<uint32_t> indexBuffer;
+	std::vector<Vertex> vertexBuffer;
+	// Set when loading from the cache, vertices and indices are then read directly from the mapped cache file
+	vks::MappedFile cacheFile;
+	const Vertex* cachedVertices = nullptr;
+	const uint32_t* cachedIndices = nullptr;
+	size_t cachedVertexCount = 0;
+	size_t cachedIndexCount = 0;
+	// Meshlets of all primitives, uploaded by finishLoading (see Model::Meshlets)
+	std::vector<MeshletData> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+	// Morph target deltas of all primitives, uploaded by finishLoading (see Model::MorphTargets)
+	std::vector<MorphDelta> morphDeltas;
+
+	bool loadMappedFile(tinygltf::TinyGLTF &gltfContext, const std::string &baseDir, std::string &error, std::string &warning);
+	static void extractMesh(const tinygltf::Mesh &mesh, const tinygltf::Model &model, const std::vector<const unsigned char*> *mappedBuffers, MeshData &meshData, uint32_t fileLoadingFlags = 0);
+	static void processPrimitive(PrimitiveData &primitiveData, bool optimize, uint32_t lodLevels, bool generateMeshlets);
+	static void generateTangents(PrimitiveData &primitiveData);
+};
 
-			imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlit.dstSubresource.layerCount = 1;
-			imageBlit.dstSubresource.mipLevel = i;
-			imageBlit.dstOffsets[1].x = int32_t(width >> i);
-			imageBlit.dstOffsets[1].y = int32_t(height >> i);
-			imageBlit.dstOffsets[1].z = 1;
+// Extracts the vertex and index data of all primitives of a mesh, only reads from the glTF model so meshes can be extracted in parallel
+// Triangle list primitives are optimized and get levels of detail and meshlets if requested by the file loading flags
+void vkglTF::Model::LoadState::extractMesh(const tinygltf::Mesh &mesh, const tinygltf::Model &model, const std::vector<const unsigned char*> *mappedBuffers, MeshData &meshData, uint32_t fileLoadingFlags)
+{
+	VKS_TRACE_SCOPE("vkglTF::extractMesh");
+	const bool optimize = (fileLoadingFlags & FileLoadingFlags::OptimizeMeshes) != 0;
+	const uint32_t lodLevels = (fileLoadingFlags & FileLoadingFlags::GenerateLods) ? lodLevelCount : 1;
+	const bool generateMeshlets = (fileLoadingFlags & FileLoadingFlags::GenerateMeshlets) != 0;
+	for (size_t j = 0; j < mesh.primitives.size(); j++) {
+		const tinygltf::Primitive &primitive = mesh.primitives[j];
+		if (primitive.indices < 0) {
+			continue;
+		}
+		PrimitiveData primitiveData;
+		primitiveData.material = primitive.material;
+		bool hasSkin = false;
+		const bool triangleList = (primitive.mode == TINYGLTF_MODE_TRIANGLES) || (primitive.mode == -1);
+		bool tangentsMissing = false;
+		// Vertices
+		{
+			const float *bufferPos = nullptr;
+			const float *bufferNormals = nullptr;
+			const float *bufferTexCoords = nullptr;
+			const float* bufferColors = nullptr;
+			const float *bufferTangents = nullptr;
+			uint32_t numColorComponents;
+			const uint16_t *bufferJoints = nullptr;
+			const float *bufferWeights = nullptr;
+
+			// Position attribute is required
+			assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
+
+			const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
+			const tinygltf::BufferView &posView = model.bufferViews[posAccessor.bufferView];
+			bufferPos = reinterpret_cast<const float *>(bufferViewData(model, mappedBuffers, posView) + posAccessor.byteOffset);
+			primitiveData.posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
+			primitiveData.posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
+
+			if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
+				const tinygltf::Accessor &normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
+				const tinygltf::BufferView &normView = model.bufferViews[normAccessor.bufferView];
+				bufferNormals = reinterpret_cast<const float *>(bufferViewData(model, mappedBuffers, normView) + normAccessor.byteOffset);
+			}
 
-			VkImageSubresourceRange mipSubRange = {};
-			mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			mipSubRange.baseMipLevel = i;
-			mipSubRange.levelCount = 1;
-			mipSubRange.layerCount = 1;
+			if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
+				const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
+				const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
+				bufferTexCoords = reinterpret_cast<const float *>(bufferViewData(model, mappedBuffers, uvView) + uvAccessor.byteOffset);
+			}
 
+			if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
 			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = 0;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				const tinygltf::Accessor& colorAccessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
+				const tinygltf::BufferView& colorView = model.bufferViews[colorAccessor.bufferView];
+				// Color buffer are either of type vec3 or vec4
+				numColorComponents = colorAccessor.type == TINYGLTF_PARAMETER_TYPE_FLOAT_VEC3 ? 3 : 4;
+				bufferColors = reinterpret_cast<const float*>(bufferViewData(model, mappedBuffers, colorView) + colorAccessor.byteOffset);
 			}
 
-			vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
-
+			if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
 			{
-				VkImageMemoryBarrier imageMemoryBarrier{};
-				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				imageMemoryBarrier.image = image;
-				imageMemoryBarrier.subresourceRange = mipSubRange;
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				const tinygltf::Accessor &tangentAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
+				const tinygltf::BufferView &tangentView = model.bufferViews[tangentAccessor.bufferView];
+				bufferTangents = reinterpret_cast<const float *>(bufferViewData(model, mappedBuffers, tangentView) + tangentAccessor.byteOffset);
 			}
-		}
 
-		subresourceRange.levelCount = mipLevels;
-		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			// Skinning
+			// Joints
+			if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
+				const tinygltf::Accessor &jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
+				const tinygltf::BufferView &jointView = model.bufferViews[jointAccessor.bufferView];
+				bufferJoints = reinterpret_cast<const uint16_t *>(bufferViewData(model, mappedBuffers, jointView) + jointAccessor.byteOffset);
+			}
 
-		{
-			VkImageMemoryBarrier imageMemoryBarrier{};
-			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			imageMemoryBarrier.image = image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
+			if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
+				const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
+				const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
+				bufferWeights = reinterpret_cast<const float *>(bufferViewData(model, mappedBuffers, uvView) + uvAccessor.byteOffset);
+			}
 
-        if (deleteBuffer) {
-            delete[] buffer;
-        }
+			hasSkin = (bufferJoints && bufferWeights);
+			tangentsMissing = (fileLoadingFlags & FileLoadingFlags::GenerateTangents) && triangleList && !bufferTangents && bufferNormals && bufferTexCoords;
+
+			primitiveData.vertices.reserve(posAccessor.count);
+			for (size_t v = 0; v < posAccessor.count; v++) {
+				Vertex vert{};
+				vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * 3]), 1.0f);
+				vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * 3]) : glm::vec3(0.0f)));
+				vert.uv = bufferTexCoords ? glm::make_vec2(&bufferTexCoords[v * 2]) : glm::vec3(0.0f);
+				if (bufferColors) {
+					switch (numColorComponents) {
+						case 3: 
+							vert.color = glm::vec4(glm::make_vec3(&bufferColors[v * 3]), 1.0f);
+						case 4:
+							vert.color = glm::make_vec4(&bufferColors[v * 4]);
+					}
+				}
+				else {
+					vert.color = glm::vec4(1.0f);
+				}
+				vert.tangent = bufferTangents ? glm::vec4(glm::make_vec4(&bufferTangents[v * 4])) : glm::vec4(0.0f);
+				vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * 4])) : glm::vec4(0.0f);
+				vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * 4]) : glm::vec4(0.0f);
+				primitiveData.vertices.push_back(vert);
+			}
+		}
+		// Morph targets, only the vertices a target moves are kept
+		for (const std::map<std::string, int> &target : primitive.targets) {
+			const size_t vertexCount = primitiveData.vertices.size();
+			std::vector<glm::vec3> positions, normals, tangents;
+			auto readAttribute = [&](const char *name, std::vector<glm::vec3> &values) {
+				auto attribute = target.find(name);
+				if ((attribute == target.end()) || !readMorphAttribute(model, mappedBuffers, attribute->second, vertexCount, values)) {
+					values.clear();
+				}
+			};
+			readAttribute("POSITION", positions);
+			readAttribute("NORMAL", normals);
+			readAttribute("TANGENT", tangents);
+			std::vector<MorphDelta> deltas;
+			for (size_t v = 0; v < vertexCount; v++) {
+				const glm::vec3 position = positions.empty() ? glm::vec3(0.0f) : positions[v];
+				const glm::vec3 normal = normals.empty() ? glm::vec3(0.0f) : normals[v];
+				const glm::vec3 tangent = tangents.empty() ? glm::vec3(0.0f) : tangents[v];
+				if ((position == glm::vec3(0.0f)) && (normal == glm::vec3(0.0f)) && (tangent == glm::vec3(0.0f))) {
+					continue;
+				}
+				MorphDelta delta;
+				delta.vertex = static_cast<uint32_t>(v);
+				memcpy(delta.position, &position.x, sizeof(delta.position));
+				memcpy(delta.normal, &normal.x, sizeof(delta.normal));
+				memcpy(delta.tangent, &tangent.x, sizeof(delta.tangent));
+				deltas.push_back(delta);
+			}
+			primitiveData.morphTargets.push_back(std::move(deltas));
+		}
+		// Indices
+		{
+			const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
+			const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
+			// Indices are read straight from the buffer, accessor offsets are aligned to the component size
+			const unsigned char *data = bufferViewData(model, mappedBuffers, bufferView) + accessor.byteOffset;
+
+			primitiveData.indices.reserve(accessor.count);
+			switch (accessor.componentType) {
+			case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
+				const uint32_t *buf = reinterpret_cast<const uint32_t*>(data);
+				primitiveData.indices.insert(primitiveData.indices.end(), buf, buf + accessor.count);
+				break;
+			}
+			case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
+				const uint16_t *buf = reinterpret_cast<const uint16_t*>(data);
+				primitiveData.indices.insert(primitiveData.indices.end(), buf, buf + accessor.count);
+				break;
+			}
+			case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
+				const uint8_t *buf = data;
+				primitiveData.indices.insert(primitiveData.indices.end(), buf, buf + accessor.count);
+				break;
+			}
+			default:
+				std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
+				continue;
+			}
+		}
+		// Tangents are generated before the vertices are reordered, meshes are extracted in parallel so this runs on the load's thread pool
+		if (tangentsMissing) {
+			generateTangents(primitiveData);
+		}
+		if ((optimize || (lodLevels > 1) || generateMeshlets) && triangleList) {
+			processPrimitive(primitiveData, optimize, lodLevels, generateMeshlets);
+		}
+		meshData.primitives.push_back(primitiveData);
+	}
+}
+
+/*
+	Generates the tangents of a triangle list primitive the way MikkTSpace does, so normal maps baked against MikkTSpace match:
+	Each triangle's tangent and bitangent are derived from its texture coordinate gradients, projected onto the tangent plane of each corner's
+	normal and accumulated weighted by the corner angle. The per vertex sums are orthonormalized against the normal, w is the bitangent sign
+	Vertices used by triangles of both handedness (mirrored texture coordinates) are split so each side gets its own tangent frame
+*/
+void vkglTF::Model::LoadState::generateTangents(PrimitiveData &primitiveData)
+{
+	std::vector<uint32_t> &indices = primitiveData.indices;
+	std::vector<Vertex> &vertices = primitiveData.vertices;
+	const size_t triangleCount = indices.size() / 3;
+	for (uint32_t index : indices) {
+		if (index >= vertices.size()) {
+			return;
+		}
+	}
+
+	// Handedness of the texture coordinate mapping of each triangle
+	auto triangleSign = [&](size_t triangle) {
+		const glm::vec2 uv0 = vertices[indices[triangle * 3]].uv;
+		const glm::vec2 duv1 = vertices[indices[triangle * 3 + 1]].uv - uv0;
+		const glm::vec2 duv2 = vertices[indices[triangle * 3 + 2]].uv - uv0;
+		return (duv1.x * duv2.y - duv2.x * duv1.y) < 0.0f ? -1.0f : 1.0f;
+	};
+
+	// Split vertices shared by triangles of opposite handedness, the first handedness seen keeps the original vertex
+	// Morph target deltas reference the original vertex indices, so primitives with targets keep their vertices
+	if (primitiveData.morphTargets.empty()) {
+		const size_t originalVertexCount = vertices.size();
+		std::vector<int8_t> vertexSign(originalVertexCount, 0);
+		std::vector<uint32_t> mirrored(originalVertexCount, UINT32_MAX);
+		for (size_t t = 0; t < triangleCount; t++) {
+			const int8_t sign = triangleSign(t) < 0.0f ? -1 : 1;
+			for (size_t c = 0; c < 3; c++) {
+				uint32_t &index = indices[t * 3 + c];
+				if (vertexSign[index] == 0) {
+					vertexSign[index] = sign;
+				}
+				else if (vertexSign[index] != sign) {
+					if (mirrored[index] == UINT32_MAX) {
+						mirrored[index] = static_cast<uint32_t>(vertices.size());
+						vertices.push_back(vertices[index]);
+					}
+					index = mirrored[index];
+				}
+			}
+		}
+	}
+
+	std::vector<glm::vec3> tangents(vertices.size(), glm::vec3(0.0f));
+	std::vector<glm::vec3> bitangents(vertices.size(), glm::vec3(0.0f));
+	for (size_t t = 0; t < triangleCount; t++) {
+		const uint32_t triangle[3] = { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+		const glm::vec3 p0 = glm::vec3(vertices[triangle[0]].pos);
+		const glm::vec3 e1 = glm::vec3(vertices[triangle[1]].pos) - p0;
+		const glm::vec3 e2 = glm::vec3(vertices[triangle[2]].pos) - p0;
+		const glm::vec2 duv1 = vertices[triangle[1]].uv - vertices[triangle[0]].uv;
+		const glm::vec2 duv2 = vertices[triangle[2]].uv - vertices[triangle[0]].uv;
+		const float determinant = duv1.x * duv2.y - duv2.x * duv1.y;
+		// Degenerate texture coordinates don't contribute, the vertices fall back to an arbitrary frame below
+		if (std::abs(determinant) < 1e-12f) {
+			continue;
+		}
+		const glm::vec3 faceTangent = (e1 * duv2.y - e2 * duv1.y) / determinant;
+		const glm::vec3 faceBitangent = (e2 * duv1.x - e1 * duv2.x) / determinant;
+		for (uint32_t c = 0; c < 3; c++) {
+			const Vertex &vertex = vertices[triangle[c]];
+			const glm::vec3 toNext = glm::vec3(vertices[triangle[(c + 1) % 3]].pos) - glm::vec3(vertex.pos);
+			const glm::vec3 toPrevious = glm::vec3(vertices[triangle[(c + 2) % 3]].pos) - glm::vec3(vertex.pos);
+			const float lengths = glm::length(toNext) * glm::length(toPrevious);
+			if (lengths <= 0.0f) {
+				continue;
+			}
+			const float angle = std::acos(glm::clamp(glm::dot(toNext, toPrevious) / lengths, -1.0f, 1.0f));
+			const glm::vec3 n = vertex.normal;
+			const glm::vec3 tangent = faceTangent - n * glm::dot(n, faceTangent);
+			const glm::vec3 bitangent = faceBitangent - n * glm::dot(n, faceBitangent);
+			if (glm::dot(tangent, tangent) > 0.0f) {
+				tangents[triangle[c]] += glm::normalize(tangent) * angle;
+			}
+			if (glm::dot(bitangent, bitangent) > 0.0f) {
+				bitangents[triangle[c]] += glm::normalize(bitangent) * angle;
+			}
+		}
+	}
+
+	for (size_t v = 0; v < vertices.size(); v++) {
+		const glm::vec3 n = vertices[v].normal;
+		glm::vec3 tangent = tangents[v] - n * glm::dot(n, tangents[v]);
+		if (glm::dot(tangent, tangent) < 1e-20f) {
+			// Any vector perpendicular to the normal
+			tangent = (std::abs(n.x) > 0.9f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+			tangent -= n * glm::dot(n, tangent);
+		}
+		tangent = glm::normalize(tangent);
+		const float sign = (glm::dot(glm::cross(n, tangent), bitangents[v]) < 0.0f) ? -1.0f : 1.0f;
+		vertices[v].tangent = glm::vec4(tangent, sign);
+	}
+}
+
+/*
+	Optimizes the primitive's triangle order and generates simplified levels of detail, appended to its indices
+	Every level is simplified from the previous one with half its index count as the target, until the error limit stops the simplification
+	Meshlets are built from the full detail level last, so they use the final vertex order
+*/
+void vkglTF::Model::LoadState::processPrimitive(PrimitiveData &primitiveData, bool optimize, uint32_t lodLevels, bool generateMeshlets)
+{
+	std::vector<uint32_t> &indices = primitiveData.indices;
+	std::vector<Vertex> &vertices = primitiveData.vertices;
+	if ((indices.size() < 6) || vertices.empty()) {
+		return;
+	}
+	for (uint32_t index : indices) {
+		if (index >= vertices.size()) {
+			return;
+		}
+	}
+	const float *positions = &vertices[0].pos.x;
+	if (optimize || generateMeshlets) {
+		// Meshlets are filled in triangle order, the vertex cache order keeps the triangles of a meshlet close together
+		vks::meshoptimizer::optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+	}
+	if (optimize) {
+		vks::meshoptimizer::optimizeOverdraw(indices.data(), indices.size(), positions, sizeof(Vertex), vertices.size());
+	}
+	if (lodLevels > 1) {
+		const glm::vec3 size = primitiveData.posMax - primitiveData.posMin;
+		const float extent = std::max(std::max(size.x, size.y), size.z);
+		const uint32_t baseIndexCount = static_cast<uint32_t>(indices.size());
+		primitiveData.lods.push_back({ 0, baseIndexCount, 0.0f });
+		std::vector<uint32_t> source(indices);
+		std::vector<uint32_t> lodIndices(indices.size());
+		float error = 0.0f;
+		for (uint32_t level = 1; level < lodLevels; level++) {
+			const size_t targetIndexCount = std::max<size_t>((source.size() / 6) * 3, 3);
+			float levelError = 0.0f;
+			const size_t lodIndexCount = vks::meshoptimizer::simplify(lodIndices.data(), source.data(), source.size(), positions, sizeof(Vertex), vertices.size(), targetIndexCount, lodTargetError, &levelError);
+			// Stop once the error limit keeps the simplification from making real progress
+			if ((lodIndexCount == 0) || (lodIndexCount > (source.size() * 9) / 10)) {
+				break;
+			}
+			vks::meshoptimizer::optimizeVertexCache(lodIndices.data(), lodIndexCount, vertices.size());
+			// Each level is simplified from the previous one, so the errors add up
+			error += levelError * extent;
+			primitiveData.lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lodIndexCount), error });
+			indices.insert(indices.end(), lodIndices.begin(), lodIndices.begin() + lodIndexCount);
+			source.assign(lodIndices.begin(), lodIndices.begin() + lodIndexCount);
+		}
+		if (primitiveData.lods.size() < 2) {
+			primitiveData.lods.clear();
+		}
+	}
+	if (optimize) {
+		// The remap covers the indices of all levels, so they keep sharing the vertices
+		const std::vector<uint32_t> remap = vks::meshoptimizer::optimizeVertexFetchRemap(indices.data(), indices.size(), vertices.size());
+		vks::meshoptimizer::remapVertices(vertices, remap);
+	}
+	if (generateMeshlets) {
+		const size_t baseIndexCount = primitiveData.lods.empty() ? indices.size() : primitiveData.lods[0].indexCount;
+		vks::meshoptimizer::buildMeshlets(indices.data(), baseIndexCount, &vertices[0].pos.x, sizeof(Vertex), vertices.size(), primitiveData.meshlets, primitiveData.meshletVertices, primitiveData.meshletTriangles);
+	}
+}
+
+/*
+	Uploads stb_image decoded glTF images into the layers of one RGBA image and generates the mip chains of all layers
+	All images must have the same size, RGB images are expanded to RGBA while being written to the staging buffer
+	Returns the usage flags the image has been created with
+*/
+static VkImageUsageFlags uploadImageLayers(vks::VulkanDevice *device, VkQueue copyQueue, const std::vector<const tinygltf::Image*> &gltfimages, VkImage &image, VkDeviceMemory &deviceMemory, vks::MemoryAllocation &allocation, uint32_t &mipLevels, VkImageLayout &imageLayout)
+{
+	const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+	const uint32_t width = static_cast<uint32_t>(gltfimages[0]->width);
+	const uint32_t height = static_cast<uint32_t>(gltfimages[0]->height);
+	const uint32_t layerCount = static_cast<uint32_t>(gltfimages.size());
+
+	// Most devices don't support RGB only on Vulkan, so RGB images are expanded to RGBA
+	// TODO: Check actual format support and transform only if required
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+	const VkDeviceSize layerSize = pixelCount * 4;
+	VkDeviceSize bufferSize = layerSize * layerCount;
+
+	VkFormatProperties formatProperties;
+
+	mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+
+	// Mip levels are generated with image blits unless a compute mip generator has been set that supports the format
+	bool useMipGenerator = vkglTF::mipGenerator && vkglTF::mipGenerator->isFormatSupported(format);
+
+	vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+	assert(useMipGenerator || (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT));
+	assert(useMipGenerator || (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT));
+
+	VkMemoryAllocateInfo memAllocInfo{};
+	memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	VkMemoryRequirements memReqs{};
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingMemory;
+
+	VkBufferCreateInfo bufferCreateInfo{};
+	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCreateInfo.size = bufferSize;
+	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+	vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
+	memAllocInfo.allocationSize = memReqs.size;
+	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+	VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+
+	uint8_t* data;
+	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
+	for (uint32_t layer = 0; layer < layerCount; layer++) {
+		const tinygltf::Image &gltfimage = *gltfimages[layer];
+		assert((static_cast<uint32_t>(gltfimage.width) == width) && (static_cast<uint32_t>(gltfimage.height) == height));
+		uint8_t *layerData = data + layerSize * layer;
+		if (gltfimage.component == 3) {
+			vks::tools::expandRGBToRGBA(&gltfimage.image[0], layerData, pixelCount);
+		}
+		else {
+			memcpy(layerData, &gltfimage.image[0], std::min(static_cast<size_t>(layerSize), gltfimage.image.size()));
+		}
+	}
+	vkUnmapMemory(device->logicalDevice, stagingMemory);
+
+	VkImageCreateInfo imageCreateInfo{};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.format = format;
+	imageCreateInfo.mipLevels = mipLevels;
+	imageCreateInfo.arrayLayers = layerCount;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.extent = { width, height, 1 };
+	imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (useMipGenerator) {
+		imageCreateInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+	}
+	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+	VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &deviceMemory, &allocation));
+
+	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+	VkImageSubresourceRange subresourceRange = {};
+	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	subresourceRange.levelCount = 1;
+	subresourceRange.layerCount = layerCount;
+
+	{
+		VkImageMemoryBarrier imageMemoryBarrier{};
+		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageMemoryBarrier.srcAccessMask = 0;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.image = image;
+		imageMemoryBarrier.subresourceRange = subresourceRange;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	}
+
+	VkBufferImageCopy bufferCopyRegion = {};
+	bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	bufferCopyRegion.imageSubresource.mipLevel = 0;
+	bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+	bufferCopyRegion.imageSubresource.layerCount = layerCount;
+	bufferCopyRegion.imageExtent.width = width;
+	bufferCopyRegion.imageExtent.height = height;
+	bufferCopyRegion.imageExtent.depth = 1;
+
+	vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+
+	{
+		VkImageMemoryBarrier imageMemoryBarrier{};
+		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		imageMemoryBarrier.image = image;
+		imageMemoryBarrier.subresourceRange = subresourceRange;
+		vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	}
+
+	device->flushCommandBuffer(copyCmd, copyQueue, true);
+
+	vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+	vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
 
-		device->flushCommandBuffer(blitCmd, copyQueue, true);
+	// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
+	VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	if (useMipGenerator) {
+		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vkglTF::mipGenerator->generate(blitCmd, image, format, width, height, mipLevels, layerCount, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, imageLayout);
 	}
 	else {
-		// Texture is stored in an external ktx file
-		std::string filename = path + "/" + gltfimage.uri;
+		for (uint32_t i = 1; i < mipLevels; i++) {
+			VkImageBlit imageBlit{};
 
-		ktxTexture* ktxTexture;
+			imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			imageBlit.srcSubresource.layerCount = layerCount;
+			imageBlit.srcSubresource.mipLevel = i - 1;
+			imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
+			imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
+			imageBlit.srcOffsets[1].z = 1;
 
-		ktxResult result = KTX_SUCCESS;
-#if defined(__ANDROID__)
-		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-		if (!asset) {
-			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
+			imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			imageBlit.dstSubresource.layerCount = layerCount;
+			imageBlit.dstSubresource.mipLevel = i;
+			imageBlit.dstOffsets[1].x = int32_t(width >> i);
+			imageBlit.dstOffsets[1].y = int32_t(height >> i);
+			imageBlit.dstOffsets[1].z = 1;
+
+			VkImageSubresourceRange mipSubRange = {};
+			mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			mipSubRange.baseMipLevel = i;
+			mipSubRange.levelCount = 1;
+			mipSubRange.layerCount = layerCount;
+
+			{
+				VkImageMemoryBarrier imageMemoryBarrier{};
+				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				imageMemoryBarrier.srcAccessMask = 0;
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				imageMemoryBarrier.image = image;
+				imageMemoryBarrier.subresourceRange = mipSubRange;
+				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+			}
+
+			vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+
+			{
+				VkImageMemoryBarrier imageMemoryBarrier{};
+				imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+				imageMemoryBarrier.image = image;
+				imageMemoryBarrier.subresourceRange = mipSubRange;
+				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+			}
 		}
-		size_t size = AAsset_getLength(asset);
-		assert(size > 0);
-		ktx_uint8_t* textureData = new ktx_uint8_t[size];
-		AAsset_read(asset, textureData, size);
-		AAsset_close(asset);
-		result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-		delete[] textureData;
-#else
-		if (!vks::tools::fileExists(filename)) {
-			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
+
+		subresourceRange.levelCount = mipLevels;
+		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		{
+			VkImageMemoryBarrier imageMemoryBarrier{};
+			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			imageMemoryBarrier.image = image;
+			imageMemoryBarrier.subresourceRange = subresourceRange;
+			vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+		}
+	}
+
+	device->flushCommandBuffer(blitCmd, copyQueue, true);
+	if (useMipGenerator) {
+		vkglTF::mipGenerator->releaseTransientResources();
+	}
+	return imageCreateInfo.usage;
+}
+
+/*
+	Compresses a decoded 8 bit glTF image with vkglTF::textureCompressor, returns false for images it can't compress (with compressedImage left empty)
+	The mip chain is generated uncompressed first, the blocks of all levels are read back so they can be stored in the texture cache
+*/
+static bool compressImage(vks::VulkanDevice *device, VkQueue copyQueue, const tinygltf::Image &gltfimage, vks::CompressedImage &compressedImage)
+{
+	VKS_TRACE_SCOPE("vkglTF::compressImage");
+	if (isKtxUri(gltfimage.uri) || gltfimage.image.empty() || (gltfimage.bits != 8) || (gltfimage.component < 3)) {
+		return false;
+	}
+	const uint32_t width = static_cast<uint32_t>(gltfimage.width);
+	const uint32_t height = static_cast<uint32_t>(gltfimage.height);
+	bool hasAlpha = false;
+	if (gltfimage.component == 4) {
+		for (size_t i = 3; i < gltfimage.image.size(); i += 4) {
+			if (gltfimage.image[i] != 255) {
+				hasAlpha = true;
+				break;
+			}
+		}
+	}
+	const VkFormat format = vkglTF::textureCompressor->getFormat(hasAlpha);
+	if (format == VK_FORMAT_UNDEFINED) {
+		return false;
+	}
+
+	VkImage image;
+	VkDeviceMemory deviceMemory;
+	vks::MemoryAllocation allocation;
+	uint32_t mipLevels;
+	VkImageLayout imageLayout;
+	uploadImageLayers(device, copyQueue, { &gltfimage }, image, deviceMemory, allocation, mipLevels, imageLayout);
+
+	const VkDeviceSize size = vks::TextureCompressor::getImageSize(format, width, height, mipLevels, 1);
+	VkBuffer buffer;
+	VkDeviceMemory bufferMemory;
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size, &buffer, &bufferMemory));
+	VkCommandBuffer compressCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	vkglTF::textureCompressor->compress(compressCmd, image, imageLayout, width, height, mipLevels, 1, format, buffer, 0);
+	device->flushCommandBuffer(compressCmd, copyQueue, true);
+	vkglTF::textureCompressor->releaseTransientResources();
+
+	compressedImage.format = format;
+	compressedImage.width = width;
+	compressedImage.height = height;
+	compressedImage.mipLevels = mipLevels;
+	compressedImage.layerCount = 1;
+	compressedImage.hasAlpha = hasAlpha;
+	compressedImage.data.resize(static_cast<size_t>(size));
+	void *data;
+	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, bufferMemory, 0, size, 0, &data));
+	memcpy(compressedImage.data.data(), data, static_cast<size_t>(size));
+	vkUnmapMemory(device->logicalDevice, bufferMemory);
+
+	vkDestroyBuffer(device->logicalDevice, buffer, nullptr);
+	vkFreeMemory(device->logicalDevice, bufferMemory, nullptr);
+	vkDestroyImage(device->logicalDevice, image, nullptr);
+	device->freeMemory(deviceMemory, allocation);
+	return true;
+}
+
+/*
+	Sampler shared by all glTF textures through the device's sampler cache
+	The LOD isn't clamped to the mip count of a texture, so textures with different sizes get the same sampler
+*/
+static VkSampler textureSampler(vks::VulkanDevice *device)
+{
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+	samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+	samplerInfo.maxAnisotropy = 8.0f;
+	samplerInfo.anisotropyEnable = VK_TRUE;
+	return device->getSamplerCache()->get(samplerInfo);
+}
+
+/*
+	glTF texture loading class
+*/
+
+void vkglTF::Texture::updateDescriptor()
+{
+	descriptor.sampler = sampler;
+	descriptor.imageView = view;
+	descriptor.imageLayout = imageLayout;
+}
+
+/*
+	Writes the combined image sampler descriptor of the texture to a mapped location of a descriptor buffer (VK_EXT_descriptor_buffer)
+*/
+void vkglTF::Texture::getDescriptorEXT(PFN_vkGetDescriptorEXT vkGetDescriptorEXT, size_t descriptorSize, void* target) const
+{
+	VkDescriptorGetInfoEXT descriptorInfo{};
+	descriptorInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+	descriptorInfo.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorInfo.data.pCombinedImageSampler = &descriptor;
+	vkGetDescriptorEXT(device->logicalDevice, &descriptorInfo, descriptorSize, target);
+}
+
+// The image of a texture array layer is owned by the model
+void vkglTF::Texture::destroy()
+{
+	if (device)
+	{
+		vkDestroyImageView(device->logicalDevice, view, nullptr);
+		device->getSamplerCache()->release(sampler);
+		if (textureArray < 0) {
+			vkDestroyImage(device->logicalDevice, image, nullptr);
+			device->freeMemory(deviceMemory, allocation);
+		}
+	}
+}
+
+/*
+	Creates a 2D view of the texture's mip chain in its array layer and updates the descriptor
+*/
+void vkglTF::Texture::createView(VkFormat format)
+{
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseArrayLayer = arrayLayer;
+	viewInfo.subresourceRange.layerCount = 1;
+	viewInfo.subresourceRange.levelCount = mipLevels;
+	VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewInfo, nullptr, &view));
+	this->format = format;
+	updateDescriptor();
+}
+
+void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue)
+{
+	this->device = device;
+	layerCount = 1;
+
+	bool isKtx = false;
+	// Image points to an external ktx file
+	if (gltfimage.uri.find_last_of(".") != std::string::npos) {
+		if (gltfimage.uri.substr(gltfimage.uri.find_last_of(".") + 1) == "ktx") {
+			isKtx = true;
+		}
+	}
+
+	VkFormat format;
+
+	if (!isKtx) {
+		// Texture was loaded using STB_Image
+		format = VK_FORMAT_R8G8B8A8_UNORM;
+		width = gltfimage.width;
+		height = gltfimage.height;
+		usage = uploadImageLayers(device, copyQueue, { &gltfimage }, image, deviceMemory, allocation, mipLevels, imageLayout);
+	}
+	else {
+		// Texture is stored in an external ktx file
+		std::string filename = path + "/" + gltfimage.uri;
+
+		ktxTexture* ktxTexture;
+
+		ktxResult result = KTX_SUCCESS;
+#if defined(__ANDROID__)
+		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+		if (!asset) {
+			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
+		}
+		size_t size = AAsset_getLength(asset);
+		assert(size > 0);
+		ktx_uint8_t* textureData = new ktx_uint8_t[size];
+		AAsset_read(asset, textureData, size);
+		AAsset_close(asset);
+		result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+		delete[] textureData;
+#else
+		if (!vks::tools::fileExists(filename)) {
+			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
+		}
+		result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+#endif		
+		assert(result == KTX_SUCCESS);
+
+		this->device = device;
+		width = ktxTexture->baseWidth;
+		height = ktxTexture->baseHeight;
+		mipLevels = ktxTexture->numLevels;
+
+		ktx_uint8_t* ktxTextureData = ktxTexture_GetData(ktxTexture);
+		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+		// @todo: Use ktxTexture_GetVkFormat(ktxTexture)
+		format = VK_FORMAT_R8G8B8A8_UNORM;
+
+		// Get device properties for the requested texture format
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+
+		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingMemory;
+
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
+		bufferCreateInfo.size = ktxTextureSize;
+		// This buffer is used as a transfer source for the buffer copy
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+
+		uint8_t* data;
+		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
+		memcpy(data, ktxTextureData, ktxTextureSize);
+		vkUnmapMemory(device->logicalDevice, stagingMemory);
+
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		for (uint32_t i = 0; i < mipLevels; i++)
+		{
+			ktx_size_t offset;
+			KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
+			assert(result == KTX_SUCCESS);
+			VkBufferImageCopy bufferCopyRegion = {};
+			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferCopyRegion.imageSubresource.mipLevel = i;
+			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+			bufferCopyRegion.imageSubresource.layerCount = 1;
+			bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
+			bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
+			bufferCopyRegion.imageExtent.depth = 1;
+			bufferCopyRegion.bufferOffset = offset;
+			bufferCopyRegions.push_back(bufferCopyRegion);
+		}
+
+		// Create optimal tiled target image
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.mipLevels = mipLevels;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { width, height, 1 };
+		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		usage = imageCreateInfo.usage;
+		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+
+		VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &deviceMemory, &allocation));
+
+		VkImageSubresourceRange subresourceRange = {};
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		subresourceRange.baseMipLevel = 0;
+		subresourceRange.levelCount = mipLevels;
+		subresourceRange.layerCount = 1;
+
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		device->flushCommandBuffer(copyCmd, copyQueue);
+		this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+
+		ktxTexture_Destroy(ktxTexture);
+	}
+
+	sampler = textureSampler(device);
+	createView(format);
+}
+
+/*
+	Uploads a block compressed image with all of its mip levels (see FileLoadingFlags::CompressTextures)
+*/
+void vkglTF::Texture::fromCompressedImage(const vks::CompressedImage &compressedImage, vks::VulkanDevice *device, VkQueue copyQueue)
+{
+	this->device = device;
+	width = compressedImage.width;
+	height = compressedImage.height;
+	mipLevels = compressedImage.mipLevels;
+	layerCount = 1;
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingMemory;
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, compressedImage.data.size(), &stagingBuffer, &stagingMemory, (void*)compressedImage.data.data()));
+
+	VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.format = compressedImage.format;
+	imageCreateInfo.mipLevels = mipLevels;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.extent = { width, height, 1 };
+	imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	usage = imageCreateInfo.usage;
+	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+	VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &deviceMemory, &allocation));
+
+	// Levels are stored one after another without padding
+	std::vector<VkBufferImageCopy> bufferCopyRegions;
+	VkDeviceSize offset = 0;
+	for (uint32_t level = 0; level < mipLevels; level++) {
+		VkBufferImageCopy bufferCopyRegion = {};
+		bufferCopyRegion.bufferOffset = offset;
+		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		bufferCopyRegion.imageSubresource.mipLevel = level;
+		bufferCopyRegion.imageSubresource.layerCount = 1;
+		bufferCopyRegion.imageExtent.width = std::max(width >> level, 1u);
+		bufferCopyRegion.imageExtent.height = std::max(height >> level, 1u);
+		bufferCopyRegion.imageExtent.depth = 1;
+		bufferCopyRegions.push_back(bufferCopyRegion);
+		offset += vks::TextureCompressor::getLevelSize(compressedImage.format, bufferCopyRegion.imageExtent.width, bufferCopyRegion.imageExtent.height, 1);
+	}
+
+	VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+	vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+	device->flushCommandBuffer(copyCmd, copyQueue);
+	imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+	vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+
+	sampler = textureSampler(device);
+	createView(compressedImage.format);
+}
+
+/*
+	glTF material
+*/
+void vkglTF::Material::createDescriptorSet(vks::DescriptorAllocator* descriptorAllocator, uint32_t layoutClass, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags)
+{
+	VK_CHECK_RESULT(descriptorAllocator->allocate(descriptorSetLayout, &descriptorSet, layoutClass));
+	VkWriteDescriptorSet writeDescriptorSets[3];
+	uint32_t writeCount = getDescriptorWrites(descriptorSet, descriptorBindingFlags, writeDescriptorSets);
+	// The constants follow the image bindings, whether the normal map has been written or not
+	const Constants constants = getConstants();
+	VkWriteDescriptorSetInlineUniformBlockEXT writeInlineUniformBlock{};
+	if (descriptorBindingFlags & DescriptorBindingFlags::MaterialConstants) {
+		VkWriteDescriptorSet& writeDescriptorSet = writeDescriptorSets[writeCount++];
+		writeDescriptorSet = {};
+		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writeDescriptorSet.dstSet = descriptorSet;
+		writeDescriptorSet.dstBinding = ((descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) ? 1 : 0) + ((descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) ? 1 : 0);
+		if (inlineMaterialConstants) {
+			// The data is written into the set itself, the descriptor count is its size in bytes
+			writeInlineUniformBlock.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_INLINE_UNIFORM_BLOCK_EXT;
+			writeInlineUniformBlock.dataSize = sizeof(Constants);
+			writeInlineUniformBlock.pData = &constants;
+			writeDescriptorSet.pNext = &writeInlineUniformBlock;
+			writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK_EXT;
+			writeDescriptorSet.descriptorCount = sizeof(Constants);
+		} else {
+			writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			writeDescriptorSet.descriptorCount = 1;
+			writeDescriptorSet.pBufferInfo = &constantsDescriptor;
+		}
+	}
+	vkUpdateDescriptorSets(device->logicalDevice, writeCount, writeDescriptorSets, 0, nullptr);
+}
+
+/*
+	Material factors as read by shaders through DescriptorBindingFlags::MaterialConstants
+*/
+vkglTF::Material::Constants vkglTF::Material::getConstants() const
+{
+	Constants constants{};
+	constants.baseColorFactor = baseColorFactor;
+	constants.metallicFactor = metallicFactor;
+	constants.roughnessFactor = roughnessFactor;
+	constants.alphaCutoff = alphaCutoff;
+	constants.alphaMode = static_cast<uint32_t>(alphaMode);
+	return constants;
+}
+
+/*
+	Fills up to two writes for the material's images in the bindings of descriptorSetLayoutImage and returns their number
+	dstSet is ignored for push descriptors
+*/
+uint32_t vkglTF::Material::getDescriptorWrites(VkDescriptorSet dstSet, uint32_t descriptorBindingFlags, VkWriteDescriptorSet* writeDescriptorSets) const
+{
+	uint32_t writeCount = 0;
+	auto addWrite = [&](const VkDescriptorImageInfo* imageInfo) {
+		VkWriteDescriptorSet& writeDescriptorSet = writeDescriptorSets[writeCount];
+		writeDescriptorSet = {};
+		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writeDescriptorSet.descriptorCount = 1;
+		writeDescriptorSet.dstSet = dstSet;
+		writeDescriptorSet.dstBinding = writeCount;
+		writeDescriptorSet.pImageInfo = imageInfo;
+		writeCount++;
+	};
+	if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
+		addWrite(&baseColorTexture->descriptor);
+	}
+	if (normalTexture && descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
+		addWrite(&normalTexture->descriptor);
+	}
+	return writeCount;
+}
+
+
+/*
+	glTF primitive
+*/
+void vkglTF::Primitive::setDimensions(glm::vec3 min, glm::vec3 max) {
+	dimensions.min = min;
+	dimensions.max = max;
+	dimensions.size = max - min;
+	dimensions.center = (min + max) / 2.0f;
+	dimensions.radius = glm::distance(min, max) / 2.0f;
+}
+
+/*
+	Returns the coarsest level of detail whose error is acceptable at the given distance (both in model units)
+	errorPerDistance is the error allowed per unit of distance, e.g. the size of a pixel at a distance of one for screen space errors below a pixel
+*/
+uint32_t vkglTF::Primitive::selectLod(float distance, float errorPerDistance) const
+{
+	uint32_t level = 0;
+	for (uint32_t i = 1; i < static_cast<uint32_t>(lods.size()); i++) {
+		if (lods[i].error <= distance * errorPerDistance) {
+			level = i;
+		}
+	}
+	return level;
+}
+
+/*
+	glTF mesh
+	Meshes created without a buffer keep their uniform block on the host until Model::prepareMeshUniforms assigns them a range of the shared buffer
+*/
+vkglTF::Mesh::Mesh(vks::VulkanDevice *device, glm::mat4 matrix, bool createBuffer) {
+	this->device = device;
+	this->uniformBlock.matrix = matrix;
+	if (!createBuffer) {
+		return;
+	}
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		sizeof(uniformBlock),
+		&uniformBuffer.buffer,
+		&uniformBuffer.memory,
+		&uniformBlock));
+	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, uniformBuffer.memory, 0, sizeof(uniformBlock), 0, &uniformBuffer.mapped));
+	uniformBuffer.descriptor = { uniformBuffer.buffer, 0, sizeof(uniformBlock) };
+};
+
+vkglTF::Mesh::~Mesh() {
+	// Ranges of the model's shared buffer have no memory of their own
+	if (uniformBuffer.memory != VK_NULL_HANDLE) {
+		vkDestroyBuffer(device->logicalDevice, uniformBuffer.buffer, nullptr);
+		vkFreeMemory(device->logicalDevice, uniformBuffer.memory, nullptr);
+	}
+    for(auto primitive : primitives)
+    {
+        delete primitive;
+    }
+}
+
+/*
+	glTF node
+*/
+glm::mat4 vkglTF::Node::localMatrix() {
+	return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
+}
+
+/*
+	Returns the world matrix cached by the last Model::updateNodes() pass
+*/
+glm::mat4 vkglTF::Node::getMatrix() {
+	return worldMatrix;
+}
+
+/*
+	Uploads the node's mesh matrices from the cached world matrices of the node and its skin's joints
+	The joint palette is written straight into the persistently mapped uniform buffer, only the joints of the skin are touched
+	Only reads the world matrices, so meshes of different nodes can be updated in parallel
+	Meshes that don't have a buffer yet (while loading) only update their host copy, meshes with a single copy ignore the frame index
+*/
+void vkglTF::Node::update(uint32_t frameIndex) {
+	if (mesh) {
+		const glm::mat4 &m = worldMatrix;
+		Mesh::UniformBlock *mapped = mesh->uniformBuffer.mapped ? reinterpret_cast<Mesh::UniformBlock*>(static_cast<char*>(mesh->uniformBuffer.mapped) + mesh->uniformBuffer.frameStride * frameIndex) : &mesh->uniformBlock;
+		mesh->uniformBlock.matrix = m;
+		mapped->matrix = m;
+		if (skin) {
+			// Update join matrices
+			const glm::mat4 inverseTransform = glm::inverse(m);
+			const size_t jointCount = std::min(skin->joints.size(), static_cast<size_t>(Mesh::maxJointCount));
+			for (size_t i = 0; i < jointCount; i++) {
+				mapped->jointMatrix[i] = inverseTransform * (skin->joints[i]->worldMatrix * skin->inverseBindMatrices[i]);
+			}
+			mesh->uniformBlock.jointcount = (float)jointCount;
+			mapped->jointcount = mesh->uniformBlock.jointcount;
+		}
+	}
+}
+
+vkglTF::Node::~Node() {
+	if (mesh) {
+		delete mesh;
+	}
+	for (auto& child : children) {
+		delete child;
+	}
+}
+
+/*
+	glTF default vertex layout with easy Vulkan mapping functions
+*/
+
+VkVertexInputBindingDescription vkglTF::Vertex::vertexInputBindingDescription;
+std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::vertexInputAttributeDescriptions;
+VkPipelineVertexInputStateCreateInfo vkglTF::Vertex::pipelineVertexInputStateCreateInfo;
+
+VkVertexInputBindingDescription vkglTF::Vertex::inputBindingDescription(uint32_t binding) {
+	return VkVertexInputBindingDescription({ binding, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX });
+}
+
+VkVertexInputAttributeDescription vkglTF::Vertex::inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component) {
+	switch (component) {
+		case VertexComponent::Position: 
+			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos) });
+		case VertexComponent::Normal:
+			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal) });
+		case VertexComponent::UV:
+			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv) });
+		case VertexComponent::Color:
+			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vertex, color) });
+		case VertexComponent::Tangent:
+			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vertex, tangent)} );
+		case VertexComponent::Joint0:
+			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vertex, joint0) });
+		case VertexComponent::Weight0:
+			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vertex, weight0) });
+		default:
+			return VkVertexInputAttributeDescription({});
+	}
+}
+
+std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components) {
+	std::vector<VkVertexInputAttributeDescription> result;
+	uint32_t location = 0;
+	for (VertexComponent component : components) {
+		result.push_back(Vertex::inputAttributeDescription(binding, location, component));
+		location++;
+	}
+	return result;
+}
+
+/** @brief Returns the default pipeline vertex input state create info structure for the requested vertex components */
+VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputState(const std::vector<VertexComponent> components) {
+	vertexInputBindingDescription = Vertex::inputBindingDescription(0);
+	Vertex::vertexInputAttributeDescriptions = Vertex::inputAttributeDescriptions(0, components);
+	pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
+	pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &Vertex::vertexInputBindingDescription;
+	pipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(Vertex::vertexInputAttributeDescriptions.size());
+	pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = Vertex::vertexInputAttributeDescriptions.data();
+	return &pipelineVertexInputStateCreateInfo;
+}
+
+vkglTF::Texture* vkglTF::Model::getTexture(uint32_t index)
+{
+
+	if (index < textures.size()) {
+		return &textures[index];
+	}
+	return nullptr;
+}
+
+void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
+{
+	createSolidTexture(emptyTexture, 0x00000000, transferQueue);
+}
+
+/*
+	Creates a 1x1 texture of a single color, packed as 0xAABBGGRR
+*/
+void vkglTF::Model::createSolidTexture(vkglTF::Texture& texture, uint32_t color, VkQueue transferQueue)
+{
+	texture.device = device;
+	texture.width = 1;
+	texture.height = 1;
+	texture.layerCount = 1;
+	texture.mipLevels = 1;
+
+	size_t bufferSize = texture.width * texture.height * 4;
+	unsigned char* buffer = new unsigned char[bufferSize];
+	buffer[0] = static_cast<unsigned char>(color & 0xFF);
+	buffer[1] = static_cast<unsigned char>((color >> 8) & 0xFF);
+	buffer[2] = static_cast<unsigned char>((color >> 16) & 0xFF);
+	buffer[3] = static_cast<unsigned char>((color >> 24) & 0xFF);
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingMemory;
+	VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
+	bufferCreateInfo.size = bufferSize;
+	// This buffer is used as a transfer source for the buffer copy
+	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+
+	VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+	VkMemoryRequirements memReqs;
+	vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
+	memAllocInfo.allocationSize = memReqs.size;
+	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+	VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+
+	// Copy texture data into staging buffer
+	uint8_t* data;
+	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
+	memcpy(data, buffer, bufferSize);
+	vkUnmapMemory(device->logicalDevice, stagingMemory);
+	delete[] buffer;
+
+	VkBufferImageCopy bufferCopyRegion = {};
+	bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	bufferCopyRegion.imageSubresource.layerCount = 1;
+	bufferCopyRegion.imageExtent.width = texture.width;
+	bufferCopyRegion.imageExtent.height = texture.height;
+	bufferCopyRegion.imageExtent.depth = 1;
+
+	// Create optimal tiled target image
+	VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+	imageCreateInfo.mipLevels = 1;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.extent = { texture.width, texture.height, 1 };
+	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &texture.image));
+
+	VK_CHECK_RESULT(device->allocateImageMemory(texture.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture.deviceMemory, &texture.allocation));
+
+	VkImageSubresourceRange subresourceRange{};
+	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	subresourceRange.baseMipLevel = 0;
+	subresourceRange.levelCount = 1;
+	subresourceRange.layerCount = 1;
+
+	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+	vkCmdCopyBufferToImage(copyCmd, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+	vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+	device->flushCommandBuffer(copyCmd, transferQueue);
+	texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	// Clean up staging resources
+	vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+	vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+
+	VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
+	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
+	samplerCreateInfo.maxAnisotropy = 1.0f;
+	texture.sampler = device->getSamplerCache()->get(samplerCreateInfo);
+
+	VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
+	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+	viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	viewCreateInfo.subresourceRange.levelCount = 1;
+	viewCreateInfo.image = texture.image;
+	VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &texture.view));
+
+	texture.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	texture.descriptor.imageView = texture.view;
+	texture.descriptor.sampler = texture.sampler;
+}
+
+/*
+	glTF model loading and rendering class
+*/
+vkglTF::Model::~Model()
+{
+	unregisterDefragmentation();
+	delete loadState;
+	if (lazyImages.state) {
+		// The decoding thread still uses the load state
+		lazyImages.decoding.wait();
+		delete lazyImages.state;
+	}
+	lazyImages.colorPlaceholder.destroy();
+	lazyImages.normalPlaceholder.destroy();
+	// Buffers of pooled models are owned by the pool
+	if (!geometryPoolRange.pool) {
+		vkDestroyBuffer(device->logicalDevice, vertices.buffer, nullptr);
+		vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
+		vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
+		vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
+	}
+	for (auto texture : textures) {
+		texture.destroy();
+	}
+	for (auto &textureArray : textureArrays) {
+		vkDestroyImageView(device->logicalDevice, textureArray.view, nullptr);
+		vkDestroyImage(device->logicalDevice, textureArray.image, nullptr);
+		device->freeMemory(textureArray.deviceMemory, textureArray.allocation);
+	}
+	for (auto node : nodes) {
+		delete node;
+	}
+    for (auto skin : skins) {
+        delete skin;
+    }
+	if (descriptorSetLayoutUbo != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutUbo, nullptr);
+		descriptorSetLayoutUbo = VK_NULL_HANDLE;
+	}
+	if (descriptorSetLayoutImage != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutImage, nullptr);
+		descriptorSetLayoutImage = VK_NULL_HANDLE;
+	}
+	delete descriptorAllocator;
+	meshUniforms.buffer.destroy();
+	materialConstants.destroy();
+	if (indirect.prepared) {
+		indirect.commands.destroy();
+		indirect.counts.destroy();
+		indirect.drawData.destroy();
+		indirect.lods.destroy();
+		indirect.bounds.destroy();
+		indirect.transforms.destroy();
+		vkDestroyDescriptorPool(device->logicalDevice, indirect.descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, indirect.descriptorSetLayout, nullptr);
+	}
+	vertexLayout.constants.destroy();
+	positions.destroy();
+	morphTargets.deltas.destroy();
+	if (bindless.prepared) {
+		bindless.materials.destroy();
+		vkDestroyDescriptorPool(device->logicalDevice, bindless.descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, bindless.descriptorSetLayout, nullptr);
+	}
+	instancing.instances.destroy();
+	meshlets.meshlets.destroy();
+	meshlets.vertices.destroy();
+	meshlets.triangles.destroy();
+	if (meshlets.prepared) {
+		vkDestroyDescriptorPool(device->logicalDevice, meshlets.descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, meshlets.descriptorSetLayout, nullptr);
+	}
+	if (descriptorBuffers.prepared) {
+		descriptorBuffers.nodes.destroy();
+		descriptorBuffers.materials.destroy();
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorBuffers.nodeLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorBuffers.materialLayout, nullptr);
+	}
+	if (pushDescriptors.prepared) {
+		vkDestroyDescriptorSetLayout(device->logicalDevice, pushDescriptors.materialLayout, nullptr);
+	}
+	emptyTexture.destroy();
+}
+
+void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, uint32_t nodeIndex, const tinygltf::Model &model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale)
+{
+	vkglTF::Node *newNode = new Node{};
+	newNode->index = nodeIndex;
+	newNode->parent = parent;
+	newNode->name = node.name;
+	newNode->skinIndex = node.skin;
+	newNode->matrix = glm::mat4(1.0f);
+
+	// Generate local node matrix
+	glm::vec3 translation = glm::vec3(0.0f);
+	if (node.translation.size() == 3) {
+		translation = glm::make_vec3(node.translation.data());
+		newNode->translation = translation;
+	}
+	glm::mat4 rotation = glm::mat4(1.0f);
+	if (node.rotation.size() == 4) {
+		glm::quat q = glm::make_quat(node.rotation.data());
+		newNode->rotation = glm::mat4(q);
+	}
+	glm::vec3 scale = glm::vec3(1.0f);
+	if (node.scale.size() == 3) {
+		scale = glm::make_vec3(node.scale.data());
+		newNode->scale = scale;
+	}
+	if (node.matrix.size() == 16) {
+		newNode->matrix = glm::make_mat4x4(node.matrix.data());
+		if (globalscale != 1.0f) {
+			//newNode->matrix = glm::scale(newNode->matrix, glm::vec3(globalscale));
+		}
+	};
+
+	// Instances of the node's mesh
+	auto instancingExtension = node.extensions.find("EXT_mesh_gpu_instancing");
+	if ((instancingExtension != node.extensions.end()) && instancingExtension->second.Has("attributes")) {
+		readInstanceMatrices(model, loadState ? &loadState->mappedBuffers : nullptr, instancingExtension->second.Get("attributes"), newNode->instanceMatrices);
+	}
+
+	// Node with children
+	if (node.children.size() > 0) {
+		for (auto i = 0; i < node.children.size(); i++) {
+			loadNode(newNode, model.nodes[node.children[i]], node.children[i], model, indexBuffer, vertexBuffer, globalscale);
+		}
+	}
+
+	// Node contains mesh data
+	if (node.mesh > -1) {
+		const tinygltf::Mesh &mesh = model.meshes[node.mesh];
+		// Primitives are extracted up front for all meshes when loading a file, nodes loaded outside of a file load extract them here
+		LoadState::MeshData localMeshData;
+		const LoadState::MeshData *meshData = &localMeshData;
+		if (loadState && (static_cast<size_t>(node.mesh) < loadState->meshes.size())) {
+			meshData = &loadState->meshes[node.mesh];
+		}
+		else {
+			LoadState::extractMesh(mesh, model, loadState ? &loadState->mappedBuffers : nullptr, localMeshData, loadState ? loadState->fileLoadingFlags : 0);
+		}
+		// Meshes loaded with a file get their range of the shared uniform buffer in finishLoading
+		Mesh *newMesh = new Mesh(device, newNode->matrix, loadState == nullptr);
+		newMesh->name = mesh.name;
+		// Pre-transformed vertices are unique to their node, and skinned or morphed ones are written per node by compute skinning
+		bool morphed = false;
+		for (const LoadState::PrimitiveData &primitiveData : meshData->primitives) {
+			morphed |= !primitiveData.morphTargets.empty();
+		}
+		const bool shareable = loadState && (meshData != &localMeshData) && (node.skin < 0) && !morphed && !(loadState->fileLoadingFlags & FileLoadingFlags::PreTransformVertices);
+		if (shareable && meshData->sharedMesh) {
+			for (const Primitive *source : meshData->sharedMesh->primitives) {
+				Primitive *newPrimitive = new Primitive(source->firstIndex, source->indexCount, source->material);
+				newPrimitive->lods = source->lods;
+				newPrimitive->firstVertex = source->firstVertex;
+				newPrimitive->vertexCount = source->vertexCount;
+				newPrimitive->firstMeshlet = source->firstMeshlet;
+				newPrimitive->meshletCount = source->meshletCount;
+				newPrimitive->setDimensions(source->dimensions.min, source->dimensions.max);
+				newMesh->primitives.push_back(newPrimitive);
+			}
+		}
+		else {
+			for (const LoadState::PrimitiveData &primitiveData : meshData->primitives) {
+				uint32_t indexStart = static_cast<uint32_t>(indexBuffer.size());
+				uint32_t vertexStart = static_cast<uint32_t>(vertexBuffer.size());
+				vertexBuffer.insert(vertexBuffer.end(), primitiveData.vertices.begin(), primitiveData.vertices.end());
+				for (uint32_t index : primitiveData.indices) {
+					indexBuffer.push_back(index + vertexStart);
+				}
+				const uint32_t indexCount = primitiveData.lods.empty() ? static_cast<uint32_t>(primitiveData.indices.size()) : primitiveData.lods[0].indexCount;
+				Primitive *newPrimitive = new Primitive(indexStart, indexCount, primitiveData.material > -1 ? materials[primitiveData.material] : materials.back());
+				for (Primitive::Lod lod : primitiveData.lods) {
+					lod.firstIndex += indexStart;
+					newPrimitive->lods.push_back(lod);
+				}
+				newPrimitive->firstVertex = vertexStart;
+				newPrimitive->vertexCount = static_cast<uint32_t>(primitiveData.vertices.size());
+				if (loadState && !primitiveData.meshlets.empty()) {
+					// Meshlet vertices index the model's vertex buffer
+					newPrimitive->firstMeshlet = static_cast<uint32_t>(loadState->meshlets.size());
+					newPrimitive->meshletCount = static_cast<uint32_t>(primitiveData.meshlets.size());
+					const uint32_t vertexOffset = static_cast<uint32_t>(loadState->meshletVertices.size());
+					const uint32_t triangleOffset = static_cast<uint32_t>(loadState->meshletTriangles.size());
+					for (const vks::meshoptimizer::Meshlet &meshlet : primitiveData.meshlets) {
+						MeshletData data{};
+						data.sphere = glm::vec4(glm::make_vec3(meshlet.center), meshlet.radius);
+						data.cone = glm::vec4(glm::make_vec3(meshlet.coneAxis), meshlet.coneCutoff);
+						data.vertexOffset = meshlet.vertexOffset + vertexOffset;
+						data.triangleOffset = meshlet.triangleOffset + triangleOffset;
+						data.vertexCount = meshlet.vertexCount;
+						data.triangleCount = meshlet.triangleCount;
+						loadState->meshlets.push_back(data);
+					}
+					for (uint32_t index : primitiveData.meshletVertices) {
+						loadState->meshletVertices.push_back(index + vertexStart);
+					}
+					loadState->meshletTriangles.insert(loadState->meshletTriangles.end(), primitiveData.meshletTriangles.begin(), primitiveData.meshletTriangles.end());
+				}
+				if (loadState) {
+					for (const std::vector<MorphDelta> &deltas : primitiveData.morphTargets) {
+						const Primitive::MorphTarget target = { static_cast<uint32_t>(loadState->morphDeltas.size()), static_cast<uint32_t>(deltas.size()) };
+						loadState->morphDeltas.insert(loadState->morphDeltas.end(), deltas.begin(), deltas.end());
+						newPrimitive->morphTargets.push_back(target);
+					}
+				}
+				newPrimitive->setDimensions(primitiveData.posMin, primitiveData.posMax);
+				newMesh->primitives.push_back(newPrimitive);
+			}
+			if (shareable) {
+				loadState->meshes[node.mesh].sharedMesh = newMesh;
+			}
+		}
+		newNode->mesh = newMesh;
+		// Initial morph weights, the node's weights override the mesh's default weights
+		size_t targetCount = 0;
+		for (const Primitive *primitive : newMesh->primitives) {
+			targetCount = std::max(targetCount, primitive->morphTargets.size());
+		}
+		if (targetCount > 0) {
+			const std::vector<double> &weights = node.weights.empty() ? mesh.weights : node.weights;
+			newNode->morphWeights.assign(targetCount, 0.0f);
+			for (size_t i = 0; i < std::min(weights.size(), targetCount); i++) {
+				newNode->morphWeights[i] = static_cast<float>(weights[i]);
+			}
+		}
+		// Nodes loaded after the model has been set up get their descriptor set right away
+		if (!loadState && descriptorAllocator && (descriptorSetLayoutUbo != VK_NULL_HANDLE) && !pushDescriptors.noDescriptorSets) {
+			prepareMeshDescriptor(newMesh, descriptorSetLayoutUbo);
+		}
+	}
+	if (parent) {
+		parent->children.push_back(newNode);
+	} else {
+		nodes.push_back(newNode);
+	}
+	linearNodes.push_back(newNode);
+}
+
+void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
+{
+	for (tinygltf::Skin &source : gltfModel.skins) {
+		Skin *newSkin = new Skin{};
+		newSkin->name = source.name;
+				
+		// Find skeleton root node
+		if (source.skeleton > -1) {
+			newSkin->skeletonRoot = nodeFromIndex(source.skeleton);
+		}
+
+		// Find joint nodes
+		for (int jointIndex : source.joints) {
+			Node* node = nodeFromIndex(jointIndex);
+			if (node) {
+				newSkin->joints.push_back(nodeFromIndex(jointIndex));
+			}
+		}
+
+		// Get inverse bind matrices from buffer
+		if (source.inverseBindMatrices > -1) {
+			const tinygltf::Accessor &accessor = gltfModel.accessors[source.inverseBindMatrices];
+			const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
+			newSkin->inverseBindMatrices.resize(accessor.count);
+			memcpy(newSkin->inverseBindMatrices.data(), bufferViewData(gltfModel, loadState ? &loadState->mappedBuffers : nullptr, bufferView) + accessor.byteOffset, accessor.count * sizeof(glm::mat4));
+		}
+
+		skins.push_back(newSkin);
+	}
+}
+
+void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
+{
+	VKS_TRACE_SCOPE("vkglTF::loadImages");
+	// Materials may already reference the textures, so they are uploaded in place
+	textures.resize(gltfModel.images.size());
+	std::vector<bool> arrayLayers(gltfModel.images.size(), false);
+	const bool compressTextures = loadState && compressTexturesEnabled(loadState->fileLoadingFlags) && (loadState->compressedImages.size() == gltfModel.images.size());
+	if (loadState && (loadState->fileLoadingFlags & FileLoadingFlags::TextureArrays) && !compressTextures) {
+		// Group the decoded 8 bit images of the same size into the layers of shared array images
+		std::map<std::pair<int, int>, std::vector<uint32_t>> sizeGroups;
+		for (size_t i = 0; i < gltfModel.images.size(); i++) {
+			const tinygltf::Image &gltfimage = gltfModel.images[i];
+			if (isKtxUri(gltfimage.uri) || gltfimage.image.empty() || (gltfimage.bits != 8) || (gltfimage.component < 3)) {
+				continue;
+			}
+			if (static_cast<uint32_t>(std::max(gltfimage.width, gltfimage.height)) > textureArrayMaxSize) {
+				continue;
+			}
+			sizeGroups[std::make_pair(gltfimage.width, gltfimage.height)].push_back(static_cast<uint32_t>(i));
+		}
+		const size_t maxLayers = device->properties.limits.maxImageArrayLayers;
+		for (auto &sizeGroup : sizeGroups) {
+			const std::vector<uint32_t> &imageIndices = sizeGroup.second;
+			for (size_t first = 0; first < imageIndices.size(); first += maxLayers) {
+				const size_t count = std::min(imageIndices.size() - first, maxLayers);
+				// Single images keep an image of their own
+				if (count < 2) {
+					continue;
+				}
+				std::vector<const tinygltf::Image*> layerImages(count);
+				for (size_t layer = 0; layer < count; layer++) {
+					layerImages[layer] = &gltfModel.images[imageIndices[first + layer]];
+				}
+				TextureArray textureArray{};
+				textureArray.width = static_cast<uint32_t>(sizeGroup.first.first);
+				textureArray.height = static_cast<uint32_t>(sizeGroup.first.second);
+				textureArray.layerCount = static_cast<uint32_t>(count);
+				VkImageLayout imageLayout;
+				uploadImageLayers(device, transferQueue, layerImages, textureArray.image, textureArray.deviceMemory, textureArray.allocation, textureArray.mipLevels, imageLayout);
+
+				VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
+				viewInfo.image = textureArray.image;
+				viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+				viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+				viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, textureArray.mipLevels, 0, textureArray.layerCount };
+				VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewInfo, nullptr, &textureArray.view));
+				textureArrays.push_back(textureArray);
+
+				for (uint32_t layer = 0; layer < textureArray.layerCount; layer++) {
+					const uint32_t index = imageIndices[first + layer];
+					Texture &texture = textures[index];
+					texture.device = device;
+					texture.image = textureArray.image;
+					texture.deviceMemory = textureArray.deviceMemory;
+					texture.width = textureArray.width;
+					texture.height = textureArray.height;
+					texture.mipLevels = textureArray.mipLevels;
+					texture.layerCount = 1;
+					texture.imageLayout = imageLayout;
+					texture.textureArray = static_cast<int32_t>(textureArrays.size() - 1);
+					texture.arrayLayer = layer;
+					texture.sampler = textureSampler(device);
+					texture.createView(VK_FORMAT_R8G8B8A8_UNORM);
+					arrayLayers[index] = true;
+				}
+			}
+		}
+	}
+	for (size_t i = 0; i < gltfModel.images.size(); i++) {
+		if (arrayLayers[i]) {
+			continue;
+		}
+		if (compressTextures) {
+			tinygltf::Image &gltfimage = gltfModel.images[i];
+			vks::CompressedImage &compressedImage = loadState->compressedImages[i];
+			// Images that weren't loaded from the texture cache are compressed now and added to it
+			if (compressedImage.data.empty() && compressImage(device, transferQueue, gltfimage, compressedImage)
+				&& (loadState->fileLoadingFlags & FileLoadingFlags::UseCache) && !isEmbeddedUri(gltfimage.uri)) {
+				vkglTF::textureCompressor->writeCache(getTextureCacheFilename(path, gltfimage.uri), loadState->imageHashes[i], compressedImage);
+			}
+			if (!compressedImage.data.empty()) {
+				textures[i].fromCompressedImage(compressedImage, device, transferQueue);
+				compressedImage.data.clear();
+				compressedImage.data.shrink_to_fit();
+				continue;
+			}
+		}
+		textures[i].fromglTfImage(gltfModel.images[i], path, device, transferQueue);
+	}
+	// Create an empty texture to be used for empty material images, lazily loaded images already created it in finishLoading
+	if (!emptyTexture.device) {
+		createEmptyTexture(transferQueue);
+	}
+}
+
+void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
+{
+	for (tinygltf::Material &mat : gltfModel.materials) {
+		vkglTF::Material material(device);
+		if (mat.values.find("baseColorTexture") != mat.values.end()) {
+			material.baseColorTexture = getTexture(gltfModel.textures[mat.values["baseColorTexture"].TextureIndex()].source);
+		}
+		// Metallic roughness workflow
+		if (mat.values.find("metallicRoughnessTexture") != mat.values.end()) {
+			material.metallicRoughnessTexture = getTexture(gltfModel.textures[mat.values["metallicRoughnessTexture"].TextureIndex()].source);
+		}
+		if (mat.values.find("roughnessFactor") != mat.values.end()) {
+			material.roughnessFactor = static_cast<float>(mat.values["roughnessFactor"].Factor());
+		}
+		if (mat.values.find("metallicFactor") != mat.values.end()) {
+			material.metallicFactor = static_cast<float>(mat.values["metallicFactor"].Factor());
+		}
+		if (mat.values.find("baseColorFactor") != mat.values.end()) {
+			material.baseColorFactor = glm::make_vec4(mat.values["baseColorFactor"].ColorFactor().data());
+		}				
+		if (mat.additionalValues.find("normalTexture") != mat.additionalValues.end()) {
+			material.normalTexture = getTexture(gltfModel.textures[mat.additionalValues["normalTexture"].TextureIndex()].source);
+		} else {
+			material.normalTexture = &emptyTexture;
+		}
+		if (mat.additionalValues.find("emissiveTexture") != mat.additionalValues.end()) {
+			material.emissiveTexture = getTexture(gltfModel.textures[mat.additionalValues["emissiveTexture"].TextureIndex()].source);
+		}
+		if (mat.additionalValues.find("occlusionTexture") != mat.additionalValues.end()) {
+			material.occlusionTexture = getTexture(gltfModel.textures[mat.additionalValues["occlusionTexture"].TextureIndex()].source);
+		}
+		if (mat.additionalValues.find("alphaMode") != mat.additionalValues.end()) {
+			tinygltf::Parameter param = mat.additionalValues["alphaMode"];
+			if (param.string_value == "BLEND") {
+				material.alphaMode = Material::ALPHAMODE_BLEND;
+			}
+			if (param.string_value == "MASK") {
+				material.alphaMode = Material::ALPHAMODE_MASK;
+			}
+		}
+		if (mat.additionalValues.find("alphaCutoff") != mat.additionalValues.end()) {
+			material.alphaCutoff = static_cast<float>(mat.additionalValues["alphaCutoff"].Factor());
+		}
+		material.doubleSided = mat.doubleSided;
+
+		materials.push_back(material);
+	}
+	// Push a default material at the end of the list for meshes with no material assigned
+	materials.push_back(Material(device));
+}
+
+void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
+{
+	for (tinygltf::Animation &anim : gltfModel.animations) {
+		vkglTF::Animation animation{};
+		animation.name = anim.name;
+		if (anim.name.empty()) {
+			animation.name = std::to_string(animations.size());
+		}
+
+		// Samplers
+		for (auto &samp : anim.samplers) {
+			vkglTF::AnimationSampler sampler{};
+
+			if (samp.interpolation == "LINEAR") {
+				sampler.interpolation = AnimationSampler::InterpolationType::LINEAR;
+			}
+			if (samp.interpolation == "STEP") {
+				sampler.interpolation = AnimationSampler::InterpolationType::STEP;
+			}
+			if (samp.interpolation == "CUBICSPLINE") {
+				sampler.interpolation = AnimationSampler::InterpolationType::CUBICSPLINE;
+			}
+
+			// Read sampler input time values
+			{
+				const tinygltf::Accessor &accessor = gltfModel.accessors[samp.input];
+				const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
+				const unsigned char *data = bufferViewData(gltfModel, loadState ? &loadState->mappedBuffers : nullptr, bufferView) + accessor.byteOffset;
+
+				assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
+
+				float *buf = new float[accessor.count];
+				memcpy(buf, data, accessor.count * sizeof(float));
+				for (size_t index = 0; index < accessor.count; index++) {
+					sampler.inputs.push_back(buf[index]);
+				}
+                delete[] buf;
+				for (auto input : sampler.inputs) {
+					if (input < animation.start) {
+						animation.start = input;
+					};
+					if (input > animation.end) {
+						animation.end = input;
+					}
+				}
+			}
+
+			// Read sampler output T/R/S values 
+			{
+				const tinygltf::Accessor &accessor = gltfModel.accessors[samp.output];
+				const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
+				const unsigned char *data = bufferViewData(gltfModel, loadState ? &loadState->mappedBuffers : nullptr, bufferView) + accessor.byteOffset;
+
+				assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
+
+				switch (accessor.type) {
+				case TINYGLTF_TYPE_VEC3: {
+					glm::vec3 *buf = new glm::vec3[accessor.count];
+					memcpy(buf, data, accessor.count * sizeof(glm::vec3));
+					for (size_t index = 0; index < accessor.count; index++) {
+						sampler.outputsVec4.push_back(glm::vec4(buf[index], 0.0f));
+					}
+                    delete[] buf;
+                    break;
+				}
+				case TINYGLTF_TYPE_VEC4: {
+					glm::vec4 *buf = new glm::vec4[accessor.count];
+					memcpy(buf, data, accessor.count * sizeof(glm::vec4));
+					for (size_t index = 0; index < accessor.count; index++) {
+						sampler.outputsVec4.push_back(buf[index]);
+					}
+                    delete[] buf;
+                    break;
+				}
+				case TINYGLTF_TYPE_SCALAR: {
+					// Morph weights
+					const float *buf = reinterpret_cast<const float*>(data);
+					sampler.outputs.assign(buf, buf + accessor.count);
+					break;
+				}
+				default: {
+					std::cout << "unknown type" << std::endl;
+					break;
+				}
+				}
+			}
+
+			animation.samplers.push_back(sampler);
 		}
-		result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-#endif		
-		assert(result == KTX_SUCCESS);
 
-		this->device = device;
-		width = ktxTexture->baseWidth;
-		height = ktxTexture->baseHeight;
-		mipLevels = ktxTexture->numLevels;
+		// Channels
+		for (auto &source: anim.channels) {
+			vkglTF::AnimationChannel channel{};
 
-		ktx_uint8_t* ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
-		// @todo: Use ktxTexture_GetVkFormat(ktxTexture)
-		format = VK_FORMAT_R8G8B8A8_UNORM;
+			if (source.target_path == "rotation") {
+				channel.path = AnimationChannel::PathType::ROTATION;
+			}
+			if (source.target_path == "translation") {
+				channel.path = AnimationChannel::PathType::TRANSLATION;
+			}
+			if (source.target_path == "scale") {
+				channel.path = AnimationChannel::PathType::SCALE;
+			}
+			if (source.target_path == "weights") {
+				channel.path = AnimationChannel::PathType::WEIGHTS;
+			}
+			channel.samplerIndex = source.sampler;
+			channel.node = nodeFromIndex(source.target_node);
+			if (!channel.node) {
+				continue;
+			}
+			if ((channel.path == AnimationChannel::PathType::WEIGHTS) && channel.node->morphWeights.empty()) {
+				continue;
+			}
 
-		// Get device properties for the requested texture format
-		VkFormatProperties formatProperties;
-		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+			animation.channels.push_back(channel);
+		}
 
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
+		animations.push_back(animation);
+	}
+}
 
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = ktxTextureSize;
-		// This buffer is used as a transfer source for the buffer copy
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+/*
+	Smallest-three quaternion packing, the largest component is dropped and restored from the unit length
+	The other three components lie within [-1/sqrt(2), 1/sqrt(2)] and are stored with 15 bits each
+*/
+static vkglTF::AnimationSampler::PackedQuaternion packQuaternion(glm::vec4 q)
+{
+	const float range = 0.70710678f;
+	uint32_t largest = 0;
+	for (uint32_t i = 1; i < 4; i++) {
+		if (fabs(q[i]) > fabs(q[largest])) {
+			largest = i;
+		}
+	}
+	// q and -q are the same rotation, the dropped component is always positive
+	if (q[largest] < 0.0f) {
+		q = -q;
+	}
+	vkglTF::AnimationSampler::PackedQuaternion packed;
+	for (uint32_t i = 0, j = 0; i < 4; i++) {
+		if (i != largest) {
+			const float value = std::min(std::max((q[i] + range) / (2.0f * range), 0.0f), 1.0f);
+			packed.data[j++] = static_cast<uint16_t>(value * 32767.0f + 0.5f);
+		}
+	}
+	packed.data[0] |= static_cast<uint16_t>((largest & 2) << 14);
+	packed.data[1] |= static_cast<uint16_t>((largest & 1) << 15);
+	return packed;
+}
 
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+static glm::vec4 unpackQuaternion(const vkglTF::AnimationSampler::PackedQuaternion &packed)
+{
+	const float range = 0.70710678f;
+	const uint32_t largest = ((packed.data[0] >> 14) & 2) | (packed.data[1] >> 15);
+	glm::vec4 q;
+	float sum = 0.0f;
+	for (uint32_t i = 0, j = 0; i < 4; i++) {
+		if (i != largest) {
+			q[i] = (static_cast<float>(packed.data[j++] & 0x7fff) / 32767.0f) * 2.0f * range - range;
+			sum += q[i] * q[i];
+		}
+	}
+	q[largest] = sqrt(std::max(1.0f - sum, 0.0f));
+	return q;
+}
 
-		uint8_t* data;
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
+/* Normalized linear interpolation of quaternions stored as (x, y, z, w), along the shorter arc */
+static glm::vec4 nlerpQuaternion(const glm::vec4 &q1, const glm::vec4 &q2, float u)
+{
+	const glm::vec4 target = (glm::dot(q1, q2) < 0.0f) ? -q2 : q2;
+	return glm::normalize(glm::mix(q1, target, u));
+}
 
-		std::vector<VkBufferImageCopy> bufferCopyRegions;
-		for (uint32_t i = 0; i < mipLevels; i++)
-		{
-			ktx_size_t offset;
-			KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
-			assert(result == KTX_SUCCESS);
-			VkBufferImageCopy bufferCopyRegion = {};
-			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			bufferCopyRegion.imageSubresource.mipLevel = i;
-			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-			bufferCopyRegion.imageSubresource.layerCount = 1;
-			bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
-			bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
-			bufferCopyRegion.imageExtent.depth = 1;
-			bufferCopyRegion.bufferOffset = offset;
-			bufferCopyRegions.push_back(bufferCopyRegion);
+/*
+	Evaluates a sampler's source keys at a time within its range, cubic spline outputs store an in-tangent, the value and an out-tangent per key
+*/
+static glm::vec4 evaluateSampler(const vkglTF::AnimationSampler &sampler, float time, bool rotation, uint32_t &key)
+{
+	if (!sampler.findKey(time, key)) {
+		const bool cubicSpline = (sampler.interpolation == vkglTF::AnimationSampler::InterpolationType::CUBICSPLINE);
+		const size_t index = (time <= sampler.inputs.front()) ? 0 : sampler.inputs.size() - 1;
+		return sampler.outputsVec4[cubicSpline ? index * 3 + 1 : index];
+	}
+	const float interval = sampler.inputs[key + 1] - sampler.inputs[key];
+	const float u = (interval > 0.0f) ? std::min(std::max(0.0f, time - sampler.inputs[key]) / interval, 1.0f) : 0.0f;
+	if (sampler.interpolation == vkglTF::AnimationSampler::InterpolationType::CUBICSPLINE) {
+		const glm::vec4 &v0 = sampler.outputsVec4[key * 3 + 1];
+		const glm::vec4 &b0 = sampler.outputsVec4[key * 3 + 2];
+		const glm::vec4 &a1 = sampler.outputsVec4[(key + 1) * 3];
+		const glm::vec4 &v1 = sampler.outputsVec4[(key + 1) * 3 + 1];
+		const float u2 = u * u;
+		const float u3 = u2 * u;
+		const glm::vec4 value = (2.0f * u3 - 3.0f * u2 + 1.0f) * v0 + (u3 - 2.0f * u2 + u) * interval * b0 + (-2.0f * u3 + 3.0f * u2) * v1 + (u3 - u2) * interval * a1;
+		return rotation ? glm::normalize(value) : value;
+	}
+	const glm::vec4 &v0 = sampler.outputsVec4[key];
+	const glm::vec4 &v1 = sampler.outputsVec4[key + 1];
+	return rotation ? nlerpQuaternion(v0, v1, u) : glm::mix(v0, v1, u);
+}
+
+/*
+	Converts the linear and cubic spline translation, rotation and scale samplers of all animations into compact fixed-rate tracks
+	Each sampler is evaluated once per frame at animationFrameRate. Starting at the first frame, the interval to the next kept key is extended
+	for as long as interpolating across it reproduces all frames in between within animationTolerance, so constant and linear sections collapse
+	into single intervals. Samplers shared by channels of different kinds, weights and step samplers and tracks of one or more than 65535 frames are kept.
+*/
+void vkglTF::Model::compactAnimations()
+{
+	for (Animation &animation : animations) {
+		// Path of the channels using each sampler, -1 if unused and -2 if used by channels of different kinds
+		std::vector<int32_t> samplerPaths(animation.samplers.size(), -1);
+		for (const AnimationChannel &channel : animation.channels) {
+			int32_t &path = samplerPaths[channel.samplerIndex];
+			path = ((path == -1) || (path == channel.path)) ? channel.path : -2;
 		}
+		for (size_t i = 0; i < animation.samplers.size(); i++) {
+			AnimationSampler &sampler = animation.samplers[i];
+			const int32_t path = samplerPaths[i];
+			if ((path < 0) || (path == AnimationChannel::PathType::WEIGHTS) || (sampler.interpolation == AnimationSampler::InterpolationType::STEP) || (sampler.inputs.size() < 2)) {
+				continue;
+			}
+			const bool cubicSpline = (sampler.interpolation == AnimationSampler::InterpolationType::CUBICSPLINE);
+			if (sampler.outputsVec4.size() < (cubicSpline ? sampler.inputs.size() * 3 : sampler.inputs.size())) {
+				continue;
+			}
+			const float start = sampler.inputs.front();
+			const float duration = sampler.inputs.back() - start;
+			const uint32_t frameCount = static_cast<uint32_t>(ceil(duration * animationFrameRate)) + 1;
+			if ((frameCount < 2) || (frameCount > UINT16_MAX)) {
+				continue;
+			}
+			const bool rotation = (path == AnimationChannel::PathType::ROTATION);
+
+			// The last frame is clamped to the end of the sampler
+			std::vector<glm::vec4> frames(frameCount);
+			uint32_t key = 0;
+			for (uint32_t frame = 0; frame < frameCount; frame++) {
+				frames[frame] = evaluateSampler(sampler, std::min(start + frame / animationFrameRate, sampler.inputs.back()), rotation, key);
+				if (rotation && (frame > 0) && (glm::dot(frames[frame], frames[frame - 1]) < 0.0f)) {
+					frames[frame] = -frames[frame];
+				}
+			}
 
-		// Create optimal tiled target image
-		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageCreateInfo.format = format;
-		imageCreateInfo.mipLevels = mipLevels;
-		imageCreateInfo.arrayLayers = 1;
-		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageCreateInfo.extent = { width, height, 1 };
-		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+			AnimationSampler::CompactTrack track;
+			track.start = start;
+			track.frameRate = animationFrameRate;
+			track.frameCount = frameCount;
+			track.keyFrames.push_back(0);
+			uint32_t first = 0;
+			while (first < frameCount - 1) {
+				uint32_t last = first + 1;
+				for (uint32_t candidate = last + 1; candidate < frameCount; candidate++) {
+					bool withinTolerance = true;
+					for (uint32_t frame = first + 1; (frame < candidate) && withinTolerance; frame++) {
+						const float u = static_cast<float>(frame - first) / static_cast<float>(candidate - first);
+						const glm::vec4 value = rotation ? nlerpQuaternion(frames[first], frames[candidate], u) : glm::mix(frames[first], frames[candidate], u);
+						const glm::vec4 error = glm::abs(value - frames[frame]);
+						withinTolerance = std::max(std::max(error.x, error.y), std::max(error.z, error.w)) <= animationTolerance;
+					}
+					if (!withinTolerance) {
+						break;
+					}
+					last = candidate;
+				}
+				track.keyFrames.push_back(static_cast<uint16_t>(last));
+				first = last;
+			}
+			track.frameKeys.resize(frameCount);
+			for (size_t k = 0; k < track.keyFrames.size(); k++) {
+				const uint32_t end = (k + 1 < track.keyFrames.size()) ? track.keyFrames[k + 1] : frameCount;
+				std::fill(track.frameKeys.begin() + track.keyFrames[k], track.frameKeys.begin() + end, static_cast<uint16_t>(std::min(k, track.keyFrames.size() - 2)));
+			}
+			for (uint16_t frame : track.keyFrames) {
+				if (rotation) {
+					track.rotations.push_back(packQuaternion(frames[frame]));
+				} else {
+					track.values.push_back(glm::vec3(frames[frame]));
+				}
+			}
 
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+			sampler.compactTrack = std::move(track);
+			std::vector<float>().swap(sampler.inputs);
+			std::vector<glm::vec4>().swap(sampler.outputsVec4);
+		}
+	}
+}
 
-		VkImageSubresourceRange subresourceRange = {};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.baseMipLevel = 0;
-		subresourceRange.levelCount = mipLevels;
-		subresourceRange.layerCount = 1;
+/*
+	Decodes the images collected while parsing, images are independent of each other so they are spread across the thread pool's workers
+	Only touches the given load state, so it can run on a background thread for FileLoadingFlags::LazyImages
+*/
+void vkglTF::Model::decodeImages(LoadState &state, vks::ThreadPool* threadPool)
+{
+	VKS_TRACE_SCOPE("vkglTF::decodeImages");
+	tinygltf::Model &gltfModel = state.gltfModel;
+	const std::vector<int> &deferredImages = state.deferredImages;
+	std::vector<std::string> errors(deferredImages.size());
+	const bool compressTextures = compressTexturesEnabled(state.fileLoadingFlags);
+	if (compressTextures) {
+		state.imageHashes.resize(gltfModel.images.size());
+		state.compressedImages.resize(gltfModel.images.size());
+	}
+	parallelFor(threadPool, deferredImages.size(), [&](size_t i) {
+		tinygltf::Image &image = gltfModel.images[deferredImages[i]];
+		std::vector<unsigned char> encodedData;
+		encodedData.swap(image.image);
+		if (compressTextures) {
+			// Images compressed by an earlier load are read from the texture cache instead of being decoded
+			const uint64_t hash = hashData(encodedData.data(), encodedData.size());
+			state.imageHashes[deferredImages[i]] = hash;
+			if ((state.fileLoadingFlags & FileLoadingFlags::UseCache) && !isEmbeddedUri(image.uri)
+				&& vkglTF::textureCompressor->readCache(getTextureCacheFilename(path, image.uri), hash, state.compressedImages[deferredImages[i]])) {
+				return;
+			}
+		}
+		std::string warning;
+		if (!tinygltf::LoadImageData(&image, deferredImages[i], &errors[i], &warning, 0, 0, encodedData.data(), static_cast<int>(encodedData.size()), nullptr) && errors[i].empty()) {
+			errors[i] = "Could not decode image " + std::to_string(deferredImages[i]) + "\n";
+		}
+	});
+	for (auto &error : errors) {
+		if (!error.empty()) {
+			state.fileLoaded = false;
+			state.error += error;
+		}
+	}
+	state.deferredImages.clear();
+}
 
-		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
-		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-		device->flushCommandBuffer(copyCmd, copyQueue);
-		this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+/*
+	Loads the glTF file of the load state without copying its buffers into heap memory
+	The file and all external .bin files are memory mapped. For binary glTF (.glb) files the JSON and BIN chunks are located here, so only
+	the JSON is passed to tinygltf, with every buffer that isn't a data URI replaced by a one byte placeholder. Accessors then read straight
+	from the mapped files through mappedBuffers. Images stored in buffer views are pointed at a placeholder view while tinygltf parses the
+	file and get their encoded data from the mapped file afterwards
+*/
+bool vkglTF::Model::LoadState::loadMappedFile(tinygltf::TinyGLTF &gltfContext, const std::string &baseDir, std::string &error, std::string &warning)
+{
+	const uint32_t glbMagic = 0x46546C67;
+	const uint32_t glbChunkJson = 0x4E4F534A;
+	const uint32_t glbChunkBin = 0x004E4942;
+	const char *placeholderUri = "data:application/octet-stream;base64,AA==";
+
+	vks::MappedFile *file = new vks::MappedFile();
+	mappedFiles.emplace_back(file);
+	if (!file->open(filename)) {
+		error = "Could not open the glTF file \"" + filename + "\"\n";
+		return false;
+	}
+	const unsigned char *bytes = reinterpret_cast<const unsigned char*>(file->data);
+	const char *json = file->data;
+	size_t jsonSize = file->size;
+	const unsigned char *binChunk = nullptr;
+	size_t binChunkSize = 0;
+
+	uint32_t magic = 0;
+	if (file->size >= sizeof(magic)) {
+		memcpy(&magic, bytes, sizeof(magic));
+	}
+	if (magic == glbMagic) {
+		// 12 byte header (magic, version, length) followed by chunks with an 8 byte header (length, type)
+		uint32_t header[3];
+		if (file->size < sizeof(header)) {
+			error = "Invalid glTF binary \"" + filename + "\"\n";
+			return false;
+		}
+		memcpy(header, bytes, sizeof(header));
+		if ((header[1] != 2) || (header[2] > file->size)) {
+			error = "Unsupported glTF binary version or invalid length in \"" + filename + "\"\n";
+			return false;
+		}
+		json = nullptr;
+		jsonSize = 0;
+		size_t offset = sizeof(header);
+		while (offset + 8 <= header[2]) {
+			uint32_t chunk[2];
+			memcpy(chunk, bytes + offset, sizeof(chunk));
+			offset += sizeof(chunk);
+			if (chunk[0] > header[2] - offset) {
+				break;
+			}
+			if ((chunk[1] == glbChunkJson) && !json) {
+				json = file->data + offset;
+				jsonSize = chunk[0];
+			}
+			else if ((chunk[1] == glbChunkBin) && !binChunk) {
+				binChunk = bytes + offset;
+				binChunkSize = chunk[0];
+			}
+			offset += chunk[0];
+		}
+		if (!json) {
+			error = "Missing JSON chunk in glTF binary \"" + filename + "\"\n";
+			return false;
+		}
+	}
 
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+	nlohmann::json document = nlohmann::json::parse(json, json + jsonSize, nullptr, false);
+	if (document.is_discarded() || !document.is_object()) {
+		error = "Could not parse the JSON of \"" + filename + "\"\n";
+		return false;
+	}
 
-		ktxTexture_Destroy(ktxTexture);
+	// Point buffers at the mapped files
+	int placeholderBuffer = -1;
+	auto buffers = document.find("buffers");
+	if ((buffers != document.end()) && buffers->is_array()) {
+		for (size_t i = 0; i < buffers->size(); i++) {
+			nlohmann::json &buffer = (*buffers)[i];
+			if (!buffer.is_object()) {
+				mappedBuffers.push_back(nullptr);
+				continue;
+			}
+			const std::string uri = buffer.value("uri", std::string());
+			const size_t byteLength = buffer.value("byteLength", size_t(0));
+			const unsigned char *data = nullptr;
+			size_t size = 0;
+			if (uri.empty()) {
+				// The BIN chunk of a .glb file
+				data = binChunk;
+				size = binChunkSize;
+			}
+			else if (!tinygltf::IsDataURI(uri)) {
+				vks::MappedFile *bufferFile = new vks::MappedFile();
+				mappedFiles.emplace_back(bufferFile);
+				if (bufferFile->open(baseDir + "/" + tinygltf::dlib::urldecode(uri))) {
+					data = reinterpret_cast<const unsigned char*>(bufferFile->data);
+					size = bufferFile->size;
+				}
+			}
+			if (!data && !tinygltf::IsDataURI(uri)) {
+				error = "Could not load buffer " + std::to_string(i) + " of \"" + filename + "\"\n";
+				return false;
+			}
+			if (data && (byteLength > size)) {
+				error = "Buffer " + std::to_string(i) + " of \"" + filename + "\" exceeds its data\n";
+				return false;
+			}
+			if (data) {
+				buffer["uri"] = placeholderUri;
+				buffer["byteLength"] = 1;
+				placeholderBuffer = static_cast<int>(i);
+			}
+			mappedBuffers.push_back(data);
+		}
 	}
 
-	VkSamplerCreateInfo samplerInfo{};
-	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerInfo.magFilter = VK_FILTER_LINEAR;
-	samplerInfo.minFilter = VK_FILTER_LINEAR;
-	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-	samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
-	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-	samplerInfo.maxAnisotropy = 1.0;
-	samplerInfo.anisotropyEnable = VK_FALSE;
-	samplerInfo.maxLod = (float)mipLevels;
-	samplerInfo.maxAnisotropy = 8.0f;
-	samplerInfo.anisotropyEnable = VK_TRUE;
-	VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerInfo, nullptr, &sampler));
+	// tinygltf passes the buffer view data of images to the image loader, so these are redirected to a placeholder view
+	std::vector<std::pair<size_t, int>> imageBufferViews;
+	auto bufferViews = document.find("bufferViews");
+	auto images = document.find("images");
+	if ((placeholderBuffer > -1) && (bufferViews != document.end()) && bufferViews->is_array() && (images != document.end()) && images->is_array()) {
+		const int placeholderView = static_cast<int>(bufferViews->size());
+		for (size_t i = 0; i < images->size(); i++) {
+			nlohmann::json &image = (*images)[i];
+			if (!image.is_object() || !image.count("bufferView") || !image["bufferView"].is_number_integer()) {
+				continue;
+			}
+			const int view = image["bufferView"].get<int>();
+			if ((view < 0) || (view >= placeholderView) || !(*bufferViews)[view].is_object()) {
+				continue;
+			}
+			const int buffer = (*bufferViews)[view].value("buffer", -1);
+			if ((buffer < 0) || (static_cast<size_t>(buffer) >= mappedBuffers.size()) || !mappedBuffers[buffer]) {
+				continue;
+			}
+			image["bufferView"] = placeholderView;
+			imageBufferViews.push_back(std::make_pair(i, view));
+		}
+		if (!imageBufferViews.empty()) {
+			nlohmann::json view = nlohmann::json::object();
+			view["buffer"] = placeholderBuffer;
+			view["byteLength"] = 1;
+			bufferViews->push_back(view);
+		}
+	}
 
-	VkImageViewCreateInfo viewInfo{};
-	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	viewInfo.image = image;
-	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	viewInfo.format = format;
-	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	viewInfo.subresourceRange.layerCount = 1;
-	viewInfo.subresourceRange.levelCount = mipLevels;
-	VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewInfo, nullptr, &view));
+	const std::string jsonString = document.dump();
+	if (!gltfContext.LoadASCIIFromString(&gltfModel, &error, &warning, jsonString.c_str(), static_cast<unsigned int>(jsonString.size()), baseDir)) {
+		return false;
+	}
 
-	descriptor.sampler = sampler;
-	descriptor.imageView = view;
-	descriptor.imageLayout = imageLayout;
+	// Restore the buffer views of the redirected images and hand their encoded data to the image decoding
+	if (!imageBufferViews.empty()) {
+		gltfModel.bufferViews.pop_back();
+		for (auto &imageBufferView : imageBufferViews) {
+			tinygltf::Image &image = gltfModel.images[imageBufferView.first];
+			const tinygltf::BufferView &view = gltfModel.bufferViews[imageBufferView.second];
+			image.bufferView = imageBufferView.second;
+			if (!image.image.empty()) {
+				const unsigned char *data = bufferViewData(gltfModel, &mappedBuffers, view);
+				image.image.assign(data, data + view.byteLength);
+			}
+		}
+	}
+	return true;
 }
 
 /*
-	glTF material
+	CPU stage of loading a glTF file: parses the file, decodes images, extracts the primitives of all meshes and builds the node hierarchy
+	Image decoding and primitive extraction run across the workers of the thread pool (if passed)
+	Doesn't use any queue, the results are uploaded by finishLoading
 */
-void vkglTF::Material::createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags)
+void vkglTF::Model::parseFile(std::string filename, uint32_t fileLoadingFlags, float scale, vks::ThreadPool* threadPool)
 {
-	VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-	descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	descriptorSetAllocInfo.descriptorPool = descriptorPool;
-	descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
-	descriptorSetAllocInfo.descriptorSetCount = 1;
-	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &descriptorSet));
-	std::vector<VkDescriptorImageInfo> imageDescriptors{};
-	std::vector<VkWriteDescriptorSet> writeDescriptorSets{};
-	if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
-		imageDescriptors.push_back(baseColorTexture->descriptor);
-		VkWriteDescriptorSet writeDescriptorSet{};
-		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.dstSet = descriptorSet;
-		writeDescriptorSet.dstBinding = static_cast<uint32_t>(writeDescriptorSets.size());
-		writeDescriptorSet.pImageInfo = &baseColorTexture->descriptor;
-		writeDescriptorSets.push_back(writeDescriptorSet);
+	VKS_TRACE_SCOPE("vkglTF::parseFile");
+	VKS_STARTUP_SCOPE(vks::StartupReport::Asset, filename + " (parse)");
+	delete loadState;
+	loadState = new LoadState();
+	loadState->filename = filename;
+	loadState->fileLoadingFlags = fileLoadingFlags;
+	loadState->threadPool = threadPool;
+
+	size_t pos = filename.find_last_of('/');
+	path = filename.substr(0, pos);
+
+	if ((fileLoadingFlags & FileLoadingFlags::UseCache) && loadFromCache(filename, scale, threadPool)) {
+		if (fileLoadingFlags & FileLoadingFlags::CompactAnimations) {
+			compactAnimations();
+		}
+		return;
 	}
-	if (normalTexture && descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
-		imageDescriptors.push_back(normalTexture->descriptor);
-		VkWriteDescriptorSet writeDescriptorSet{};
-		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.dstSet = descriptorSet;
-		writeDescriptorSet.dstBinding = static_cast<uint32_t>(writeDescriptorSets.size());
-		writeDescriptorSet.pImageInfo = &normalTexture->descriptor;
-		writeDescriptorSets.push_back(writeDescriptorSet);
+
+	tinygltf::Model &gltfModel = loadState->gltfModel;
+	tinygltf::TinyGLTF gltfContext;
+	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
+		gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
+	} else {
+		gltfContext.SetImageLoader(loadImageDataFuncDeferred, &loadState->deferredImages);
 	}
-	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
-}
+#if defined(__ANDROID__)
+	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
+	// We let tinygltf handle this, by passing the asset manager of our app
+	tinygltf::asset_manager = androidApp->activity->assetManager;
+#endif
 
+	std::string error, warning;
 
-/*
-	glTF primitive
-*/
-void vkglTF::Primitive::setDimensions(glm::vec3 min, glm::vec3 max) {
-	dimensions.min = min;
-	dimensions.max = max;
-	dimensions.size = max - min;
-	dimensions.center = (min + max) / 2.0f;
-	dimensions.radius = glm::distance(min, max) / 2.0f;
-}
+	// Text (.gltf) and binary (.glb) files are both mapped, buffers are read from the mapping instead of being copied
+	loadState->fileLoaded = loadState->loadMappedFile(gltfContext, path, error, warning);
+	if (!loadState->fileLoaded) {
+		loadState->error = error;
+		return;
+	}
 
-/*
-	glTF mesh
-*/
-vkglTF::Mesh::Mesh(vks::VulkanDevice *device, glm::mat4 matrix) {
-	this->device = device;
-	this->uniformBlock.matrix = matrix;
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		sizeof(uniformBlock),
-		&uniformBuffer.buffer,
-		&uniformBuffer.memory,
-		&uniformBlock));
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, uniformBuffer.memory, 0, sizeof(uniformBlock), 0, &uniformBuffer.mapped));
-	uniformBuffer.descriptor = { uniformBuffer.buffer, 0, sizeof(uniformBlock) };
-};
+	if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+		// Lazily loaded images are decoded after finishLoading
+		if (!lazyImagesEnabled(fileLoadingFlags)) {
+			decodeImages(*loadState, threadPool);
+			if (!loadState->fileLoaded) {
+				return;
+			}
+		}
+		// The textures are uploaded by finishLoading, but materials already reference them
+		textures.resize(gltfModel.images.size());
+	}
 
-vkglTF::Mesh::~Mesh() {
-	vkDestroyBuffer(device->logicalDevice, uniformBuffer.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, uniformBuffer.memory, nullptr);
-    for(auto primitive : primitives)
-    {
-        delete primitive;
-    }
-}
+	loadState->meshes.resize(gltfModel.meshes.size());
+	parallelFor(threadPool, gltfModel.meshes.size(), [&](size_t i) {
+		LoadState::extractMesh(gltfModel.meshes[i], gltfModel, &loadState->mappedBuffers, loadState->meshes[i], fileLoadingFlags);
+	});
 
-/*
-	glTF node
-*/
-glm::mat4 vkglTF::Node::localMatrix() {
-	return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
-}
+	std::vector<uint32_t> &indexBuffer = loadState->indexBuffer;
+	std::vector<Vertex> &vertexBuffer = loadState->vertexBuffer;
 
-glm::mat4 vkglTF::Node::getMatrix() {
-	glm::mat4 m = localMatrix();
-	vkglTF::Node *p = parent;
-	while (p) {
-		m = p->localMatrix() * m;
-		p = p->parent;
+	loadMaterials(gltfModel);
+	const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+	for (size_t i = 0; i < scene.nodes.size(); i++) {
+		const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
+		loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
 	}
-	return m;
-}
+	loadState->meshes.clear();
+	if (gltfModel.animations.size() > 0) {
+		loadAnimations(gltfModel);
+	}
+	loadSkins(gltfModel);
 
-void vkglTF::Node::update() {
-	if (mesh) {
-		glm::mat4 m = getMatrix();
-		if (skin) {
-			mesh->uniformBlock.matrix = m;
-			// Update join matrices
-			glm::mat4 inverseTransform = glm::inverse(m);
-			for (size_t i = 0; i < skin->joints.size(); i++) {
-				vkglTF::Node *jointNode = skin->joints[i];
-				glm::mat4 jointMat = jointNode->getMatrix() * skin->inverseBindMatrices[i];
-				jointMat = inverseTransform * jointMat;
-				mesh->uniformBlock.jointMatrix[i] = jointMat;
-			}
-			mesh->uniformBlock.jointcount = (float)skin->joints.size();
-			memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
-		} else {
-			memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
+	// Assign skins
+	for (auto node : linearNodes) {
+		if (node->skinIndex > -1) {
+			node->skin = skins[node->skinIndex];
 		}
 	}
+	// Initial pose
+	flattenNodes();
+	updateNodes();
 
-	for (auto& child : children) {
-		child->update();
+	// Pre-Calculations for requested features
+	if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
+		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+		const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
+		const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
+		// Vertices shared by several nodes are only processed once
+		std::vector<bool> processed(vertexBuffer.size(), false);
+		for (Node* node : linearNodes) {
+			if (node->mesh) {
+				const glm::mat4 localMatrix = node->getMatrix();
+				for (Primitive* primitive : node->mesh->primitives) {
+					if ((primitive->vertexCount == 0) || processed[primitive->firstVertex]) {
+						continue;
+					}
+					std::fill(processed.begin() + primitive->firstVertex, processed.begin() + primitive->firstVertex + primitive->vertexCount, true);
+					for (uint32_t i = 0; i < primitive->vertexCount; i++) {
+						Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
+						// Pre-transform vertex positions by node-hierarchy
+						if (preTransform) {
+							vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
+							vertex.normal = glm::normalize(glm::mat3(localMatrix) * vertex.normal);
+						}
+						// Flip Y-Axis of vertex positions
+						if (flipY) {
+							vertex.pos.y *= -1.0f;
+							vertex.normal.y *= -1.0f;
+						}
+						// Pre-Multiply vertex colors with material base color
+						if (preMultiplyColor) {
+							vertex.color = primitive->material.baseColorFactor * vertex.color;
+						}
+					}
+					// Morph target deltas are directions, transformed like the normals
+					for (const Primitive::MorphTarget &target : primitive->morphTargets) {
+						for (uint32_t i = 0; i < target.deltaCount; i++) {
+							MorphDelta &delta = loadState->morphDeltas[target.firstDelta + i];
+							float *vectors[3] = { delta.position, delta.normal, delta.tangent };
+							for (float *vector : vectors) {
+								glm::vec3 value = glm::make_vec3(vector);
+								if (preTransform) {
+									value = glm::mat3(localMatrix) * value;
+								}
+								if (flipY) {
+									value.y *= -1.0f;
+								}
+								memcpy(vector, &value.x, sizeof(glm::vec3));
+							}
+						}
+					}
+				}
+			}
+		}
 	}
-}
 
-vkglTF::Node::~Node() {
-	if (mesh) {
-		delete mesh;
+	for (auto extension : gltfModel.extensionsUsed) {
+		if (extension == "KHR_materials_pbrSpecularGlossiness") {
+			std::cout << "Required extension: " << extension;
+			metallicRoughnessWorkflow = false;
+		}
 	}
-	for (auto& child : children) {
-		delete child;
+
+	if (fileLoadingFlags & FileLoadingFlags::UseCache) {
+		writeCache(filename, scale);
+	}
+	// The cache stores the source keys, so the tracks are compacted after writing it
+	if (fileLoadingFlags & FileLoadingFlags::CompactAnimations) {
+		compactAnimations();
 	}
 }
 
 /*
-	glTF default vertex layout with easy Vulkan mapping functions
+	Layout of the model cache file (all values in native byte order, the cache is only valid for the build that wrote it):
+	- Header: magic, version, vertex size, file loading flags, lod settings, scale, hash of the glTF file
+	- External buffers with their hashes, the cache is stale if any of them (or the glTF file) changed
+	- Workflow flag, image uris (images are still decoded from their source files), materials
+	- Nodes in linearNodes order with their instance transforms, meshes and primitives (including levels of detail), root node ids, skins, animations
+	- Vertex and index data (16 byte aligned), uploaded straight from the mapped file
+	Nodes are referenced by their position in linearNodes, textures by their index (-1 for none, -2 for the empty texture)
 */
+void vkglTF::Model::writeCache(const std::string &filename, float scale)
+{
+	VKS_TRACE_SCOPE("vkglTF::writeCache");
+#if !defined(__ANDROID__)
+	const tinygltf::Model &gltfModel = loadState->gltfModel;
+	// Morph targets aren't stored in the cache either
+	if (!loadState->morphDeltas.empty()) {
+		return;
+	}
+	// Embedded images would have to be stored in the cache too, models using them are always loaded from the glTF file
+	for (auto &image : gltfModel.images) {
+		if ((image.bufferView != -1) || isEmbeddedUri(image.uri)) {
+			return;
+		}
+	}
 
-VkVertexInputBindingDescription vkglTF::Vertex::vertexInputBindingDescription;
-std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::vertexInputAttributeDescriptions;
-VkPipelineVertexInputStateCreateInfo vkglTF::Vertex::pipelineVertexInputStateCreateInfo;
+	CacheWriter writer;
+	writer.write<uint32_t>(cacheMagic);
+	writer.write<uint32_t>(cacheVersion);
+	writer.write<uint32_t>(sizeof(Vertex));
+	writer.write<uint32_t>(loadState->fileLoadingFlags & ~FileLoadingFlags::UseCache);
+	writer.write<uint32_t>(lodLevelCount);
+	writer.write<float>(lodTargetError);
+	writer.write<float>(scale);
+	writer.write<uint64_t>(hashFile(filename));
+
+	std::vector<std::string> bufferUris;
+	for (auto &buffer : gltfModel.buffers) {
+		if (!isEmbeddedUri(buffer.uri)) {
+			bufferUris.push_back(buffer.uri);
+		}
+	}
+	writer.write<uint32_t>(static_cast<uint32_t>(bufferUris.size()));
+	for (auto &uri : bufferUris) {
+		writer.writeString(uri);
+		writer.write<uint64_t>(hashFile(path + "/" + uri));
+	}
 
-VkVertexInputBindingDescription vkglTF::Vertex::inputBindingDescription(uint32_t binding) {
-	return VkVertexInputBindingDescription({ binding, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX });
-}
+	writer.write<uint8_t>(metallicRoughnessWorkflow ? 1 : 0);
 
-VkVertexInputAttributeDescription vkglTF::Vertex::inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component) {
-	switch (component) {
-		case VertexComponent::Position: 
-			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos) });
-		case VertexComponent::Normal:
-			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal) });
-		case VertexComponent::UV:
-			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv) });
-		case VertexComponent::Color:
-			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vertex, color) });
-		case VertexComponent::Tangent:
-			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vertex, tangent)} );
-		case VertexComponent::Joint0:
-			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vertex, joint0) });
-		case VertexComponent::Weight0:
-			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vertex, weight0) });
-		default:
-			return VkVertexInputAttributeDescription({});
+	writer.write<uint32_t>(static_cast<uint32_t>(gltfModel.images.size()));
+	for (auto &image : gltfModel.images) {
+		writer.writeString(image.uri);
 	}
-}
 
-std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components) {
-	std::vector<VkVertexInputAttributeDescription> result;
-	uint32_t location = 0;
-	for (VertexComponent component : components) {
-		result.push_back(Vertex::inputAttributeDescription(binding, location, component));
-		location++;
+	auto textureId = [this](const Texture *texture) -> int32_t {
+		if (texture == &emptyTexture) {
+			return -2;
+		}
+		if (!texture || textures.empty() || (texture < textures.data()) || (texture >= textures.data() + textures.size())) {
+			return -1;
+		}
+		return static_cast<int32_t>(texture - textures.data());
+	};
+	writer.write<uint32_t>(static_cast<uint32_t>(materials.size()));
+	for (auto &material : materials) {
+		writer.write<int32_t>(material.alphaMode);
+		writer.write<float>(material.alphaCutoff);
+		writer.write<int32_t>(material.doubleSided ? 1 : 0);
+		writer.write<float>(material.metallicFactor);
+		writer.write<float>(material.roughnessFactor);
+		writer.write<glm::vec4>(material.baseColorFactor);
+		writer.write<int32_t>(textureId(material.baseColorTexture));
+		writer.write<int32_t>(textureId(material.metallicRoughnessTexture));
+		writer.write<int32_t>(textureId(material.normalTexture));
+		writer.write<int32_t>(textureId(material.occlusionTexture));
+		writer.write<int32_t>(textureId(material.emissiveTexture));
 	}
-	return result;
-}
 
-/** @brief Returns the default pipeline vertex input state create info structure for the requested vertex components */
-VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputState(const std::vector<VertexComponent> components) {
-	vertexInputBindingDescription = Vertex::inputBindingDescription(0);
-	Vertex::vertexInputAttributeDescriptions = Vertex::inputAttributeDescriptions(0, components);
-	pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
-	pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &Vertex::vertexInputBindingDescription;
-	pipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(Vertex::vertexInputAttributeDescriptions.size());
-	pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = Vertex::vertexInputAttributeDescriptions.data();
-	return &pipelineVertexInputStateCreateInfo;
-}
+	std::unordered_map<const Node*, int32_t> nodeIds;
+	for (size_t i = 0; i < linearNodes.size(); i++) {
+		nodeIds[linearNodes[i]] = static_cast<int32_t>(i);
+	}
+	auto nodeId = [&nodeIds](const Node *node) -> int32_t {
+		auto it = nodeIds.find(node);
+		return (it != nodeIds.end()) ? it->second : -1;
+	};
+	writer.write<uint32_t>(static_cast<uint32_t>(linearNodes.size()));
+	for (auto node : linearNodes) {
+		writer.write<uint32_t>(node->index);
+		writer.write<int32_t>(nodeId(node->parent));
+		writer.write<uint32_t>(static_cast<uint32_t>(node->children.size()));
+		for (auto child : node->children) {
+			writer.write<int32_t>(nodeId(child));
+		}
+		writer.writeString(node->name);
+		writer.write<int32_t>(node->skinIndex);
+		writer.write<glm::vec3>(node->translation);
+		writer.write<glm::vec3>(node->scale);
+		writer.write<glm::quat>(node->rotation);
+		writer.write<glm::mat4>(node->matrix);
+		writer.writeVector(node->instanceMatrices);
+		writer.write<uint8_t>(node->mesh ? 1 : 0);
+		if (node->mesh) {
+			writer.writeString(node->mesh->name);
+			writer.write<uint32_t>(static_cast<uint32_t>(node->mesh->primitives.size()));
+			for (auto primitive : node->mesh->primitives) {
+				writer.write<uint32_t>(primitive->firstIndex);
+				writer.write<uint32_t>(primitive->indexCount);
+				writer.write<uint32_t>(primitive->firstVertex);
+				writer.write<uint32_t>(primitive->vertexCount);
+				writer.write<uint32_t>(static_cast<uint32_t>(&primitive->material - materials.data()));
+				writer.write<glm::vec3>(primitive->dimensions.min);
+				writer.write<glm::vec3>(primitive->dimensions.max);
+				writer.writeVector(primitive->lods);
+				writer.write<uint32_t>(primitive->firstMeshlet);
+				writer.write<uint32_t>(primitive->meshletCount);
+			}
+		}
+	}
+	writer.write<uint32_t>(static_cast<uint32_t>(nodes.size()));
+	for (auto node : nodes) {
+		writer.write<int32_t>(nodeId(node));
+	}
 
-vkglTF::Texture* vkglTF::Model::getTexture(uint32_t index)
-{
+	writer.write<uint32_t>(static_cast<uint32_t>(skins.size()));
+	for (auto skin : skins) {
+		writer.writeString(skin->name);
+		writer.write<int32_t>(nodeId(skin->skeletonRoot));
+		writer.write<uint32_t>(static_cast<uint32_t>(skin->joints.size()));
+		for (auto joint : skin->joints) {
+			writer.write<int32_t>(nodeId(joint));
+		}
+		writer.writeVector(skin->inverseBindMatrices);
+	}
 
-	if (index < textures.size()) {
-		return &textures[index];
+	writer.write<uint32_t>(static_cast<uint32_t>(animations.size()));
+	for (auto &animation : animations) {
+		writer.writeString(animation.name);
+		writer.write<float>(animation.start);
+		writer.write<float>(animation.end);
+		writer.write<uint32_t>(static_cast<uint32_t>(animation.samplers.size()));
+		for (auto &sampler : animation.samplers) {
+			writer.write<int32_t>(sampler.interpolation);
+			writer.writeVector(sampler.inputs);
+			writer.writeVector(sampler.outputsVec4);
+		}
+		writer.write<uint32_t>(static_cast<uint32_t>(animation.channels.size()));
+		for (auto &channel : animation.channels) {
+			writer.write<int32_t>(channel.path);
+			writer.write<int32_t>(nodeId(channel.node));
+			writer.write<uint32_t>(channel.samplerIndex);
+		}
 	}
-	return nullptr;
+
+	writer.write<uint64_t>(loadState->vertexBuffer.size());
+	writer.write<uint64_t>(loadState->indexBuffer.size());
+	writer.align(16);
+	const char *vertexData = reinterpret_cast<const char*>(loadState->vertexBuffer.data());
+	writer.data.insert(writer.data.end(), vertexData, vertexData + loadState->vertexBuffer.size() * sizeof(Vertex));
+	writer.align(16);
+	const char *indexData = reinterpret_cast<const char*>(loadState->indexBuffer.data());
+	writer.data.insert(writer.data.end(), indexData, indexData + loadState->indexBuffer.size() * sizeof(uint32_t));
+	writer.writeVector(loadState->meshlets);
+	writer.writeVector(loadState->meshletVertices);
+	writer.writeVector(loadState->meshletTriangles);
+
+	std::ofstream cacheFile(getCacheFilename(filename), std::ios::binary | std::ios::trunc);
+	if (cacheFile.is_open()) {
+		cacheFile.write(writer.data.data(), writer.data.size());
+	}
+	if (!cacheFile.good()) {
+		std::cerr << "Could not write glTF cache file \"" << getCacheFilename(filename) << "\"\n";
+	}
+#endif
 }
 
-void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
+// Release everything a failed cache load has created and start over with an empty load state
+void vkglTF::Model::discardCachedLoad()
 {
-	emptyTexture.device = device;
-	emptyTexture.width = 1;
-	emptyTexture.height = 1;
-	emptyTexture.layerCount = 1;
-	emptyTexture.mipLevels = 1;
-
-	size_t bufferSize = emptyTexture.width * emptyTexture.height * 4;
-	unsigned char* buffer = new unsigned char[bufferSize];
-	memset(buffer, 0, bufferSize);
+	for (auto node : linearNodes) {
+		// Nodes delete their children, which are deleted through linearNodes here
+		node->children.clear();
+		delete node;
+	}
+	for (auto skin : skins) {
+		delete skin;
+	}
+	nodes.clear();
+	linearNodes.clear();
+	flattenedNodes.clear();
+	skins.clear();
+	animations.clear();
+	materials.clear();
+	textures.clear();
+	metallicRoughnessWorkflow = true;
+
+	const std::string filename = loadState->filename;
+	const uint32_t fileLoadingFlags = loadState->fileLoadingFlags;
+	vks::ThreadPool* threadPool = loadState->threadPool;
+	delete loadState;
+	loadState = new LoadState();
+	loadState->filename = filename;
+	loadState->fileLoadingFlags = fileLoadingFlags;
+	loadState->threadPool = threadPool;
+}
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingMemory;
-	VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-	bufferCreateInfo.size = bufferSize;
-	// This buffer is used as a transfer source for the buffer copy
-	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+/*
+	Loads the processed model from the cache file written by writeCache, returns false (with nothing loaded) if there is no valid cache for the file and flags
+*/
+bool vkglTF::Model::loadFromCache(const std::string &filename, float scale, vks::ThreadPool* threadPool)
+{
+	VKS_TRACE_SCOPE("vkglTF::loadFromCache");
+#if defined(__ANDROID__)
+	return false;
+#else
+	vks::MappedFile &cacheFile = loadState->cacheFile;
+	if (!cacheFile.open(getCacheFilename(filename))) {
+		return false;
+	}
+	CacheReader reader(cacheFile.data, cacheFile.size);
+	const uint32_t fileLoadingFlags = loadState->fileLoadingFlags;
+	if ((reader.read<uint32_t>() != cacheMagic) || (reader.read<uint32_t>() != cacheVersion) || (reader.read<uint32_t>() != sizeof(Vertex))
+		|| (reader.read<uint32_t>() != (fileLoadingFlags & ~FileLoadingFlags::UseCache)) || (reader.read<uint32_t>() != lodLevelCount) || (reader.read<float>() != lodTargetError)
+		|| (reader.read<float>() != scale) || (reader.read<uint64_t>() != hashFile(filename))) {
+		cacheFile.close();
+		return false;
+	}
+	const uint32_t bufferCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; (i < bufferCount) && !reader.failed; i++) {
+		const std::string uri = reader.readString();
+		if (reader.read<uint64_t>() != hashFile(path + "/" + uri)) {
+			cacheFile.close();
+			return false;
+		}
+	}
+	if (reader.failed) {
+		cacheFile.close();
+		return false;
+	}
 
-	VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-	VkMemoryRequirements memReqs;
-	vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-	VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
+	metallicRoughnessWorkflow = reader.read<uint8_t>() != 0;
 
-	// Copy texture data into staging buffer
-	uint8_t* data;
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-	memcpy(data, buffer, bufferSize);
-	vkUnmapMemory(device->logicalDevice, stagingMemory);
+	std::vector<std::string> imageUris(reader.read<uint32_t>());
+	for (auto &uri : imageUris) {
+		uri = reader.readString();
+	}
+	const bool loadImages = !(fileLoadingFlags & FileLoadingFlags::DontLoadImages);
+	if (loadImages) {
+		textures.resize(imageUris.size());
+	}
 
-	VkBufferImageCopy bufferCopyRegion = {};
-	bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	bufferCopyRegion.imageSubresource.layerCount = 1;
-	bufferCopyRegion.imageExtent.width = emptyTexture.width;
-	bufferCopyRegion.imageExtent.height = emptyTexture.height;
-	bufferCopyRegion.imageExtent.depth = 1;
+	auto texturePointer = [this](int32_t id) -> Texture* {
+		return (id == -2) ? &emptyTexture : ((id >= 0) ? getTexture(static_cast<uint32_t>(id)) : nullptr);
+	};
+	const uint32_t materialCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; (i < materialCount) && !reader.failed; i++) {
+		Material material(device);
+		material.alphaMode = static_cast<Material::AlphaMode>(reader.read<int32_t>());
+		material.alphaCutoff = reader.read<float>();
+		material.doubleSided = reader.read<int32_t>() != 0;
+		material.metallicFactor = reader.read<float>();
+		material.roughnessFactor = reader.read<float>();
+		material.baseColorFactor = reader.read<glm::vec4>();
+		material.baseColorTexture = texturePointer(reader.read<int32_t>());
+		material.metallicRoughnessTexture = texturePointer(reader.read<int32_t>());
+		material.normalTexture = texturePointer(reader.read<int32_t>());
+		material.occlusionTexture = texturePointer(reader.read<int32_t>());
+		material.emissiveTexture = texturePointer(reader.read<int32_t>());
+		materials.push_back(material);
+	}
+	if (materials.empty()) {
+		reader.failed = true;
+	}
 
-	// Create optimal tiled target image
-	VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-	imageCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-	imageCreateInfo.mipLevels = 1;
-	imageCreateInfo.arrayLayers = 1;
-	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageCreateInfo.extent = { emptyTexture.width, emptyTexture.height, 1 };
-	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &emptyTexture.image));
+	// Nodes are created up front, so they can be linked by id
+	const uint32_t nodeCount = reader.failed ? 0 : reader.read<uint32_t>();
+	if (nodeCount > (reader.size - reader.offset)) {
+		reader.failed = true;
+	}
+	else {
+		for (uint32_t i = 0; i < nodeCount; i++) {
+			linearNodes.push_back(new Node{});
+		}
+	}
+	auto nodePointer = [this, &reader](int32_t id) -> Node* {
+		if (id < -1 || id >= static_cast<int32_t>(linearNodes.size())) {
+			reader.failed = true;
+		}
+		return ((id >= 0) && !reader.failed) ? linearNodes[id] : nullptr;
+	};
+	for (auto node : linearNodes) {
+		if (reader.failed) {
+			break;
+		}
+		node->index = reader.read<uint32_t>();
+		node->parent = nodePointer(reader.read<int32_t>());
+		const uint32_t childCount = reader.read<uint32_t>();
+		for (uint32_t i = 0; (i < childCount) && !reader.failed; i++) {
+			Node *child = nodePointer(reader.read<int32_t>());
+			if (child) {
+				node->children.push_back(child);
+			}
+		}
+		node->name = reader.readString();
+		node->skinIndex = reader.read<int32_t>();
+		node->translation = reader.read<glm::vec3>();
+		node->scale = reader.read<glm::vec3>();
+		node->rotation = reader.read<glm::quat>();
+		node->matrix = reader.read<glm::mat4>();
+		reader.readVector(node->instanceMatrices);
+		if (reader.read<uint8_t>() && !reader.failed) {
+			Mesh *mesh = new Mesh(device, node->matrix, false);
+			node->mesh = mesh;
+			mesh->name = reader.readString();
+			const uint32_t primitiveCount = reader.read<uint32_t>();
+			for (uint32_t i = 0; (i < primitiveCount) && !reader.failed; i++) {
+				const uint32_t firstIndex = reader.read<uint32_t>();
+				const uint32_t indexCount = reader.read<uint32_t>();
+				const uint32_t firstVertex = reader.read<uint32_t>();
+				const uint32_t vertexCount = reader.read<uint32_t>();
+				const uint32_t materialIndex = std::min(reader.read<uint32_t>(), static_cast<uint32_t>(materials.size() - 1));
+				const glm::vec3 posMin = reader.read<glm::vec3>();
+				const glm::vec3 posMax = reader.read<glm::vec3>();
+				Primitive *primitive = new Primitive(firstIndex, indexCount, materials[materialIndex]);
+				reader.readVector(primitive->lods);
+				primitive->firstMeshlet = reader.read<uint32_t>();
+				primitive->meshletCount = reader.read<uint32_t>();
+				primitive->firstVertex = firstVertex;
+				primitive->vertexCount = vertexCount;
+				primitive->setDimensions(posMin, posMax);
+				mesh->primitives.push_back(primitive);
+			}
+		}
+	}
+	const uint32_t rootCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; (i < rootCount) && !reader.failed; i++) {
+		Node *node = nodePointer(reader.read<int32_t>());
+		if (node) {
+			nodes.push_back(node);
+		}
+	}
 
-	vkGetImageMemoryRequirements(device->logicalDevice, emptyTexture.image, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &emptyTexture.deviceMemory));
-	VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, emptyTexture.image, emptyTexture.deviceMemory, 0));
+	const uint32_t skinCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; (i < skinCount) && !reader.failed; i++) {
+		Skin *skin = new Skin{};
+		skins.push_back(skin);
+		skin->name = reader.readString();
+		skin->skeletonRoot = nodePointer(reader.read<int32_t>());
+		const uint32_t jointCount = reader.read<uint32_t>();
+		for (uint32_t j = 0; (j < jointCount) && !reader.failed; j++) {
+			Node *joint = nodePointer(reader.read<int32_t>());
+			if (joint) {
+				skin->joints.push_back(joint);
+			}
+		}
+		reader.readVector(skin->inverseBindMatrices);
+	}
 
-	VkImageSubresourceRange subresourceRange{};
-	subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	subresourceRange.baseMipLevel = 0;
-	subresourceRange.levelCount = 1;
-	subresourceRange.layerCount = 1;
+	const uint32_t animationCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; (i < animationCount) && !reader.failed; i++) {
+		Animation animation{};
+		animation.name = reader.readString();
+		animation.start = reader.read<float>();
+		animation.end = reader.read<float>();
+		const uint32_t samplerCount = reader.read<uint32_t>();
+		for (uint32_t j = 0; (j < samplerCount) && !reader.failed; j++) {
+			AnimationSampler sampler{};
+			sampler.interpolation = static_cast<AnimationSampler::InterpolationType>(reader.read<int32_t>());
+			reader.readVector(sampler.inputs);
+			reader.readVector(sampler.outputsVec4);
+			animation.samplers.push_back(sampler);
+		}
+		const uint32_t channelCount = reader.read<uint32_t>();
+		for (uint32_t j = 0; (j < channelCount) && !reader.failed; j++) {
+			AnimationChannel channel{};
+			channel.path = static_cast<AnimationChannel::PathType>(reader.read<int32_t>());
+			channel.node = nodePointer(reader.read<int32_t>());
+			channel.samplerIndex = reader.read<uint32_t>();
+			if (channel.node) {
+				animation.channels.push_back(channel);
+			}
+		}
+		animations.push_back(animation);
+	}
 
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-	vkCmdCopyBufferToImage(copyCmd, stagingBuffer, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-	device->flushCommandBuffer(copyCmd, transferQueue);
-	emptyTexture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	// Vertices and indices stay in the mapped file and are uploaded from there by finishLoading
+	const uint64_t vertexCount = reader.read<uint64_t>();
+	const uint64_t indexCount = reader.read<uint64_t>();
+	reader.align(16);
+	loadState->cachedVertices = static_cast<const Vertex*>(reader.readBlob(static_cast<size_t>(vertexCount * sizeof(Vertex))));
+	reader.align(16);
+	loadState->cachedIndices = static_cast<const uint32_t*>(reader.readBlob(static_cast<size_t>(indexCount * sizeof(uint32_t))));
+	loadState->cachedVertexCount = static_cast<size_t>(vertexCount);
+	loadState->cachedIndexCount = static_cast<size_t>(indexCount);
+	reader.readVector(loadState->meshlets);
+	reader.readVector(loadState->meshletVertices);
+	reader.readVector(loadState->meshletTriangles);
+
+	// Images are decoded from their source files, the same way as when parsing the glTF file
+	if (!reader.failed && loadImages) {
+		for (size_t i = 0; i < imageUris.size(); i++) {
+			tinygltf::Image image;
+			image.uri = imageUris[i];
+			if (!isKtxUri(image.uri)) {
+				vks::MappedFile imageFile;
+				if (!imageFile.open(path + "/" + image.uri)) {
+					reader.failed = true;
+					break;
+				}
+				image.image.assign(imageFile.data, imageFile.data + imageFile.size);
+				loadState->deferredImages.push_back(static_cast<int>(i));
+			}
+			loadState->gltfModel.images.push_back(image);
+		}
+	}
 
-	// Clean up staging resources
-	vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+	if (reader.failed) {
+		std::cerr << "glTF cache file \"" << getCacheFilename(filename) << "\" is invalid, loading from the glTF file\n";
+		discardCachedLoad();
+		return false;
+	}
 
-	VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
-	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
-	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
-	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
-	samplerCreateInfo.maxAnisotropy = 1.0f;
-	VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCreateInfo, nullptr, &emptyTexture.sampler));
+	loadState->fileLoaded = true;
+	if (loadImages && !lazyImagesEnabled(fileLoadingFlags)) {
+		decodeImages(*loadState, threadPool);
+	}
 
-	VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
-	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	viewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-	viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-	viewCreateInfo.subresourceRange.levelCount = 1;
-	viewCreateInfo.image = emptyTexture.image;
-	VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &emptyTexture.view));
+	for (auto node : linearNodes) {
+		// Assign skins
+		if ((node->skinIndex > -1) && (static_cast<size_t>(node->skinIndex) < skins.size())) {
+			node->skin = skins[node->skinIndex];
+		}
+	}
+	// Initial pose
+	flattenNodes();
+	updateNodes();
+	return true;
+#endif
+}
 
-	emptyTexture.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	emptyTexture.descriptor.imageView = emptyTexture.view;
-	emptyTexture.descriptor.sampler = emptyTexture.sampler;
+void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale, vks::ThreadPool* threadPool)
+{
+	this->device = device;
+	parseFile(filename, fileLoadingFlags, scale, threadPool);
+	finishLoading(transferQueue);
 }
 
 /*
-	glTF model loading and rendering class
+	Starts loading a glTF file in the background, image decoding and primitive extraction are spread across the thread pool's workers (if passed)
+	Once the returned future is ready, finishLoading has to be called on the thread that owns the transfer queue to upload the model
+	The model must not be used or destroyed before that
 */
-vkglTF::Model::~Model()
+std::future<void> vkglTF::Model::loadFromFileAsync(std::string filename, vks::VulkanDevice *device, uint32_t fileLoadingFlags, float scale, vks::ThreadPool* threadPool)
 {
-	vkDestroyBuffer(device->logicalDevice, vertices.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
-	for (auto texture : textures) {
-		texture.destroy();
-	}
-	for (auto node : nodes) {
-		delete node;
-	}
-    for (auto skin : skins) {
-        delete skin;
-    }
-	if (descriptorSetLayoutUbo != VK_NULL_HANDLE) {
-		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutUbo, nullptr);
-		descriptorSetLayoutUbo = VK_NULL_HANDLE;
-	}
-	if (descriptorSetLayoutImage != VK_NULL_HANDLE) {
-		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutImage, nullptr);
-		descriptorSetLayoutImage = VK_NULL_HANDLE;
-	}
-	vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
-	emptyTexture.destroy();
+	this->device = device;
+	return std::async(std::launch::async, [this, filename, fileLoadingFlags, scale, threadPool]() {
+		vks::Tracer::setThreadName("glTF loader");
+		parseFile(filename, fileLoadingFlags, scale, threadPool);
+	});
 }
 
-void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, uint32_t nodeIndex, const tinygltf::Model &model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale)
+/*
+	GPU stage of loading a glTF file: uploads the images, vertices and indices prepared by parseFile in one go and sets up the descriptors
+*/
+void vkglTF::Model::finishLoading(VkQueue transferQueue)
 {
-	vkglTF::Node *newNode = new Node{};
-	newNode->index = nodeIndex;
-	newNode->parent = parent;
-	newNode->name = node.name;
-	newNode->skinIndex = node.skin;
-	newNode->matrix = glm::mat4(1.0f);
+	VKS_TRACE_SCOPE("vkglTF::finishLoading");
+	assert(loadState);
+	VKS_STARTUP_SCOPE(vks::StartupReport::Asset, loadState->filename + " (upload)");
+	if (!loadState->fileLoaded) {
+		const std::string filename = loadState->filename;
+		const std::string error = loadState->error;
+		delete loadState;
+		loadState = nullptr;
+		// TODO: throw
+		vks::tools::exitFatal("Could not load glTF file \"" + filename + "\": " + error, -1);
+		return;
+	}
 
-	// Generate local node matrix
-	glm::vec3 translation = glm::vec3(0.0f);
-	if (node.translation.size() == 3) {
-		translation = glm::make_vec3(node.translation.data());
-		newNode->translation = translation;
+	const bool lazyImagesLoad = lazyImagesEnabled(loadState->fileLoadingFlags);
+	if (lazyImagesLoad) {
+		// Materials sample the placeholders until updateLazyImages() swaps in the decoded images
+		createEmptyTexture(transferQueue);
+		createSolidTexture(lazyImages.colorPlaceholder, 0xFF808080, transferQueue);
+		createSolidTexture(lazyImages.normalPlaceholder, 0xFFFF8080, transferQueue);
+		textures.resize(loadState->gltfModel.images.size());
+		for (auto &texture : textures) {
+			texture.descriptor = lazyImages.colorPlaceholder.descriptor;
+		}
+		for (auto &material : materials) {
+			if (material.normalTexture && (material.normalTexture != &emptyTexture)) {
+				material.normalTexture->descriptor = lazyImages.normalPlaceholder.descriptor;
+			}
+		}
 	}
-	glm::mat4 rotation = glm::mat4(1.0f);
-	if (node.rotation.size() == 4) {
-		glm::quat q = glm::make_quat(node.rotation.data());
-		newNode->rotation = glm::mat4(q);
+	else if (!(loadState->fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+		loadImages(loadState->gltfModel, device, transferQueue);
 	}
-	glm::vec3 scale = glm::vec3(1.0f);
-	if (node.scale.size() == 3) {
-		scale = glm::make_vec3(node.scale.data());
-		newNode->scale = scale;
+
+	const Vertex *vertexData = loadState->vertexBuffer.data();
+	const uint32_t *indexData = loadState->indexBuffer.data();
+	size_t vertexCount = loadState->vertexBuffer.size();
+	size_t indexCount = loadState->indexBuffer.size();
+	if (loadState->cachedVertices) {
+		vertexData = loadState->cachedVertices;
+		indexData = loadState->cachedIndices;
+		vertexCount = loadState->cachedVertexCount;
+		indexCount = loadState->cachedIndexCount;
 	}
-	if (node.matrix.size() == 16) {
-		newNode->matrix = glm::make_mat4x4(node.matrix.data());
-		if (globalscale != 1.0f) {
-			//newNode->matrix = glm::scale(newNode->matrix, glm::vec3(globalscale));
-		}
-	};
 
-	// Node with children
-	if (node.children.size() > 0) {
-		for (auto i = 0; i < node.children.size(); i++) {
-			loadNode(newNode, model.nodes[node.children[i]], node.children[i], model, indexBuffer, vertexBuffer, globalscale);
-		}
+	// Static batches are appended to the indices, so they are uploaded (and pooled) together with the primitives' ranges
+	std::vector<uint32_t> batchedIndices;
+	if ((loadState->fileLoadingFlags & FileLoadingFlags::StaticBatching) && (loadState->fileLoadingFlags & FileLoadingFlags::PreTransformVertices)) {
+		buildStaticBatches(indexData, indexCount, batchedIndices);
+		indexData = batchedIndices.data();
+		indexCount = batchedIndices.size();
 	}
 
-	// Node contains mesh data
-	if (node.mesh > -1) {
-		const tinygltf::Mesh mesh = model.meshes[node.mesh];
-		Mesh *newMesh = new Mesh(device, newNode->matrix);
-		newMesh->name = mesh.name;
-		for (size_t j = 0; j < mesh.primitives.size(); j++) {
-			const tinygltf::Primitive &primitive = mesh.primitives[j];
-			if (primitive.indices < 0) {
-				continue;
+	std::vector<uint8_t> compactVertices;
+	if (loadState->fileLoadingFlags & FileLoadingFlags::CompactVertices) {
+		packVertices(vertexData, vertexCount, compactVertices);
+	}
+
+	size_t vertexBufferSize = vertexLayout.compact ? compactVertices.size() : vertexCount * sizeof(Vertex);
+	size_t indexBufferSize = indexCount * sizeof(uint32_t);
+	indices.count = static_cast<uint32_t>(indexCount);
+	vertices.count = static_cast<uint32_t>(vertexCount);
+
+	assert((vertexBufferSize > 0) && (indexBufferSize > 0));
+
+	// Mesh shaders fetch the vertices of meshlets from a storage buffer
+	const VkBufferUsageFlags meshletUsage = loadState->meshlets.empty() ? 0 : VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	// Vertex pulling shaders read the vertices through the buffer's device address
+	const VkBufferUsageFlags vertexPullingUsage = (loadState->fileLoadingFlags & FileLoadingFlags::VertexPulling) ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT : 0;
+	const VkBufferUsageFlags deviceAddressUsage = (loadState->fileLoadingFlags & FileLoadingFlags::DeviceAddresses) ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT : 0;
+
+	const VkBufferUsageFlags vertexUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags | meshletUsage | vertexPullingUsage | deviceAddressUsage;
+	const VkBufferUsageFlags indexUsage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags | deviceAddressUsage;
+
+	// Sub-allocate from the geometry pool if it has been set, supports the model's buffer usage and has enough space left
+	// The position stream is indexed with the model's own indices, so models with separate positions aren't pooled
+	const VkBufferUsageFlags poolUsage = (vertexUsage | indexUsage) & ~(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	vks::GeometryPool::Range poolRange;
+	const bool usePool = geometryPool && !(loadState->fileLoadingFlags & FileLoadingFlags::SeparatePositions) && ((poolUsage & ~geometryPool->getUsage()) == 0)
+		&& geometryPool->allocate(static_cast<uint32_t>(vertexCount), vertexLayout.stride, static_cast<uint32_t>(indexCount), poolRange);
+	const uint32_t *uploadIndexData = indexData;
+	std::vector<uint32_t> rebasedIndices;
+	if (usePool) {
+		geometryPoolRange.pool = geometryPool;
+		geometryPoolRange.firstVertex = poolRange.firstVertex;
+		geometryPoolRange.firstIndex = poolRange.firstIndex;
+		vertices.buffer = geometryPool->getVertexBuffer();
+		vertices.memory = VK_NULL_HANDLE;
+		indices.buffer = geometryPool->getIndexBuffer();
+		indices.memory = VK_NULL_HANDLE;
+		vertices.deviceAddress = geometryPool->getVertexBufferAddress();
+		indices.deviceAddress = geometryPool->getIndexBufferAddress();
+		// Rebase the indices to the model's vertex range, so all draws (including indirect and meshlet draws) address the pool's buffers without a vertex offset
+		if (poolRange.firstVertex != 0) {
+			rebasedIndices.resize(indexCount);
+			for (size_t i = 0; i < indexCount; i++) {
+				rebasedIndices[i] = indexData[i] + poolRange.firstVertex;
 			}
-			uint32_t indexStart = static_cast<uint32_t>(indexBuffer.size());
-			uint32_t vertexStart = static_cast<uint32_t>(vertexBuffer.size());
-			uint32_t indexCount = 0;
-			uint32_t vertexCount = 0;
-			glm::vec3 posMin{};
-			glm::vec3 posMax{};
-			bool hasSkin = false;
-			// Vertices
-			{
-				const float *bufferPos = nullptr;
-				const float *bufferNormals = nullptr;
-				const float *bufferTexCoords = nullptr;
-				const float* bufferColors = nullptr;
-				const float *bufferTangents = nullptr;
-				uint32_t numColorComponents;
-				const uint16_t *bufferJoints = nullptr;
-				const float *bufferWeights = nullptr;
-
-				// Position attribute is required
-				assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
-
-				const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
-				const tinygltf::BufferView &posView = model.bufferViews[posAccessor.bufferView];
-				bufferPos = reinterpret_cast<const float *>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
-				posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
-				posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
-
-				if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-					const tinygltf::Accessor &normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-					const tinygltf::BufferView &normView = model.bufferViews[normAccessor.bufferView];
-					bufferNormals = reinterpret_cast<const float *>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
+			uploadIndexData = rebasedIndices.data();
+			for (uint32_t &index : loadState->meshletVertices) {
+				index += poolRange.firstVertex;
+			}
+		}
+		for (auto node : linearNodes) {
+			if (node->mesh) {
+				for (Primitive *primitive : node->mesh->primitives) {
+					primitive->firstIndex += poolRange.firstIndex;
+					for (Primitive::Lod &lod : primitive->lods) {
+						lod.firstIndex += poolRange.firstIndex;
+					}
 				}
+			}
+		}
+		for (StaticBatch &batch : staticBatching.batches) {
+			batch.firstIndex += poolRange.firstIndex;
+		}
+		// Compact vertices need the model's constant vertex in the second binding, so only models with the full layout rely on the pool's binding
+		buffersBound = !vertexLayout.compact;
+	}
+	else {
+		// Create device local buffers
+		// Vertex buffer
+		VK_CHECK_RESULT(device->createBuffer(
+			vertexUsage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			vertexBufferSize,
+			&vertices.buffer,
+			&vertices.memory));
+		// Index buffer
+		VK_CHECK_RESULT(device->createBuffer(
+			indexUsage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			indexBufferSize,
+			&indices.buffer,
+			&indices.memory));
+		vertices.deviceAddress = (vertexUsage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ? device->getBufferDeviceAddress(vertices.buffer) : 0;
+		indices.deviceAddress = (indexUsage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ? device->getBufferDeviceAddress(indices.buffer) : 0;
+	}
 
-				if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferTexCoords = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-				}
+	// Upload through the device's staging ring, the copies are submitted together with other pending uploads before the buffers are first used
+	vks::StagingRing *stagingRing = device->getStagingRing();
+	stagingRing->copyToBuffer(vertexLayout.compact ? static_cast<const void*>(compactVertices.data()) : vertexData, vertexBufferSize, vertices.buffer, poolRange.vertexOffset);
+	stagingRing->copyToBuffer(uploadIndexData, indexBufferSize, indices.buffer, poolRange.firstIndex * sizeof(uint32_t));
+
+	if (!loadState->morphDeltas.empty()) {
+		morphTargets.deltaCount = static_cast<uint32_t>(loadState->morphDeltas.size());
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&morphTargets.deltas,
+			loadState->morphDeltas.size() * sizeof(MorphDelta)));
+		stagingRing->copyToBuffer(loadState->morphDeltas.data(), morphTargets.deltas.size, morphTargets.deltas.buffer);
+	}
 
-				if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
-				{
-					const tinygltf::Accessor& colorAccessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
-					const tinygltf::BufferView& colorView = model.bufferViews[colorAccessor.bufferView];
-					// Color buffer are either of type vec3 or vec4
-					numColorComponents = colorAccessor.type == TINYGLTF_PARAMETER_TYPE_FLOAT_VEC3 ? 3 : 4;
-					bufferColors = reinterpret_cast<const float*>(&(model.buffers[colorView.buffer].data[colorAccessor.byteOffset + colorView.byteOffset]));
-				}
+	if (loadState->fileLoadingFlags & FileLoadingFlags::VertexPulling) {
+		prepareVertexPulling();
+	}
 
-				if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
-				{
-					const tinygltf::Accessor &tangentAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
-					const tinygltf::BufferView &tangentView = model.bufferViews[tangentAccessor.bufferView];
-					bufferTangents = reinterpret_cast<const float *>(&(model.buffers[tangentView.buffer].data[tangentAccessor.byteOffset + tangentView.byteOffset]));
-				}
+	if (loadState->fileLoadingFlags & FileLoadingFlags::SeparatePositions) {
+		std::vector<glm::vec3> positionData(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++) {
+			positionData[i] = vertexData[i].pos;
+		}
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&positions,
+			vertexCount * sizeof(glm::vec3)));
+		stagingRing->copyToBuffer(positionData.data(), positions.size, positions.buffer);
+	}
 
-				// Skinning
-				// Joints
-				if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
-					const tinygltf::BufferView &jointView = model.bufferViews[jointAccessor.bufferView];
-					bufferJoints = reinterpret_cast<const uint16_t *>(&(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]));
-				}
+	if (loadState->fileLoadingFlags & FileLoadingFlags::KeepHostGeometry) {
+		hostGeometry.vertices.assign(vertexData, vertexData + vertexCount);
+		hostGeometry.indices.assign(indexData, indexData + indexCount);
+	}
 
-				if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
-					const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
-					const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-					bufferWeights = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-				}
+	if (!loadState->meshlets.empty()) {
+		// Triangles are read as 32 bit words by the shaders
+		loadState->meshletTriangles.resize((loadState->meshletTriangles.size() + 3) & ~static_cast<size_t>(3), 0);
+		meshlets.count = static_cast<uint32_t>(loadState->meshlets.size());
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshlets.meshlets, loadState->meshlets.size() * sizeof(MeshletData)));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshlets.vertices, loadState->meshletVertices.size() * sizeof(uint32_t)));
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshlets.triangles, loadState->meshletTriangles.size()));
+		stagingRing->copyToBuffer(loadState->meshlets.data(), meshlets.meshlets.size, meshlets.meshlets.buffer);
+		stagingRing->copyToBuffer(loadState->meshletVertices.data(), meshlets.vertices.size, meshlets.vertices.buffer);
+		stagingRing->copyToBuffer(loadState->meshletTriangles.data(), meshlets.triangles.size, meshlets.triangles.buffer);
+	}
 
-				hasSkin = (bufferJoints && bufferWeights);
-
-				vertexCount = static_cast<uint32_t>(posAccessor.count);
-
-				for (size_t v = 0; v < posAccessor.count; v++) {
-					Vertex vert{};
-					vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * 3]), 1.0f);
-					vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * 3]) : glm::vec3(0.0f)));
-					vert.uv = bufferTexCoords ? glm::make_vec2(&bufferTexCoords[v * 2]) : glm::vec3(0.0f);
-					if (bufferColors) {
-						switch (numColorComponents) {
-							case 3: 
-								vert.color = glm::vec4(glm::make_vec3(&bufferColors[v * 3]), 1.0f);
-							case 4:
-								vert.color = glm::make_vec4(&bufferColors[v * 4]);
-						}
-					}
-					else {
-						vert.color = glm::vec4(1.0f);
-					}
-					vert.tangent = bufferTangents ? glm::vec4(glm::make_vec4(&bufferTangents[v * 4])) : glm::vec4(0.0f);
-					vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * 4])) : glm::vec4(0.0f);
-					vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * 4]) : glm::vec4(0.0f);
-					vertexBuffer.push_back(vert);
-				}
-			}
-			// Indices
-			{
-				const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
-				const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
+	getSceneDimensions();
+	// The extension's functions are only returned if it has been enabled on the device
+	const bool useDescriptorBuffers = (loadState->fileLoadingFlags & FileLoadingFlags::DescriptorBuffers) && (vkGetDeviceProcAddr(device->logicalDevice, "vkGetDescriptorEXT") != nullptr);
+	// Descriptor buffers address the uniform blocks by their device address
+	prepareMeshUniforms(useDescriptorBuffers ? VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT : 0);
 
-				indexCount = static_cast<uint32_t>(accessor.count);
+	// Setup descriptors
+	uint32_t uboCount{ 0 };
+	uint32_t imageCount{ 0 };
+	for (auto node : linearNodes) {
+		if (node->mesh) {
+			uboCount += (node->mesh->uniformBuffer.frameStride != 0) ? framesInFlight : 1;
+		}
+	}
+	for (auto material : materials) {
+		if (material.baseColorTexture != nullptr) {
+			imageCount++;
+		}
+	}
+	// The first pool of each layout class fits all sets of the file, further pools are only created for nodes loaded later
+	float imagesPerMaterial = 0.0f;
+	if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
+		imagesPerMaterial += 1.0f;
+	}
+	if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
+		imagesPerMaterial += 1.0f;
+	}
+	std::vector<vks::DescriptorAllocator::PoolSizeRatio> materialRatios = { { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, std::max(imagesPerMaterial, 1.0f) } };
+	if (descriptorBindingFlags & DescriptorBindingFlags::MaterialConstants) {
+		if (inlineMaterialConstants) {
+			materialRatios.push_back({ VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK_EXT, static_cast<float>(sizeof(Material::Constants)) });
+		} else {
+			materialRatios.push_back({ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f });
+		}
+	}
+	descriptorAllocator = new vks::DescriptorAllocator(device->logicalDevice, { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f } }, std::max(uboCount, 1u));
+	descriptorLayoutClasses.nodes = 0;
+	descriptorLayoutClasses.materials = descriptorAllocator->addLayoutClass(materialRatios, std::max(imageCount, 1u));
 
-				switch (accessor.componentType) {
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-					uint32_t *buf = new uint32_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint32_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-                    delete[] buf;
-					break;
-				}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-					uint16_t *buf = new uint16_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint16_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-                    delete[] buf;
-                    break;
-				}
-				case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-					uint8_t *buf = new uint8_t[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint8_t));
-					for (size_t index = 0; index < accessor.count; index++) {
-						indexBuffer.push_back(buf[index] + vertexStart);
-					}
-                    delete[] buf;
-                    break;
-				}
-				default:
-					std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
-					return;
+	// Descriptors for per-node uniform buffers
+	{
+		// Layout is global, so only create if it hasn't already been created before
+		if (descriptorSetLayoutUbo == VK_NULL_HANDLE) {
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+			};
+			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
+			descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+			descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
+			descriptorLayoutCI.pBindings = setLayoutBindings.data();
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutUbo));
+		}
+		if (useDescriptorBuffers) {
+			prepareDescriptorBuffers();
+		}
+		if ((loadState->fileLoadingFlags & FileLoadingFlags::PushDescriptors) && !descriptorBuffers.prepared) {
+			pushDescriptors.noDescriptorSets = preparePushDescriptors();
+		}
+		if (!descriptorBuffers.prepared && !pushDescriptors.noDescriptorSets) {
+			for (auto node : nodes) {
+				prepareNodeDescriptor(node, descriptorSetLayoutUbo);
+			}
+		}
+	}
+
+	// Descriptors for per-material images
+	{
+		// Layout is global, so only create if it hasn't already been created before
+		if (descriptorSetLayoutImage == VK_NULL_HANDLE) {
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+			if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
+				setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(setLayoutBindings.size())));
+			}
+			if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
+				setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(setLayoutBindings.size())));
+			}
+			if (descriptorBindingFlags & DescriptorBindingFlags::MaterialConstants) {
+				if (inlineMaterialConstants) {
+					setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK_EXT, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(setLayoutBindings.size()), sizeof(Material::Constants)));
+				} else {
+					setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(setLayoutBindings.size())));
 				}
 			}
-			Primitive *newPrimitive = new Primitive(indexStart, indexCount, primitive.material > -1 ? materials[primitive.material] : materials.back());
-			newPrimitive->firstVertex = vertexStart;
-			newPrimitive->vertexCount = vertexCount;
-			newPrimitive->setDimensions(posMin, posMax);
-			newMesh->primitives.push_back(newPrimitive);
+			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
+			descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+			descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
+			descriptorLayoutCI.pBindings = setLayoutBindings.data();
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutImage));
+		}
+		if ((descriptorBindingFlags & DescriptorBindingFlags::MaterialConstants) && !inlineMaterialConstants && !descriptorBuffers.prepared && !pushDescriptors.noDescriptorSets) {
+			prepareMaterialConstants();
+		}
+		for (auto& material : materials) {
+			if ((material.baseColorTexture != nullptr) && !descriptorBuffers.prepared && !pushDescriptors.noDescriptorSets) {
+				material.createDescriptorSet(descriptorAllocator, descriptorLayoutClasses.materials, vkglTF::descriptorSetLayoutImage, descriptorBindingFlags);
+			}
 		}
-		newNode->mesh = newMesh;
 	}
-	if (parent) {
-		parent->children.push_back(newNode);
-	} else {
-		nodes.push_back(newNode);
+
+	if (lazyImagesLoad) {
+		// The geometry has been uploaded, only the images are kept for decoding
+		std::vector<LoadState::MeshData>().swap(loadState->meshes);
+		std::vector<uint32_t>().swap(loadState->indexBuffer);
+		std::vector<Vertex>().swap(loadState->vertexBuffer);
+		std::vector<MeshletData>().swap(loadState->meshlets);
+		std::vector<uint32_t>().swap(loadState->meshletVertices);
+		std::vector<uint8_t>().swap(loadState->meshletTriangles);
+		std::vector<MorphDelta>().swap(loadState->morphDeltas);
+		loadState->cachedVertices = nullptr;
+		loadState->cachedIndices = nullptr;
+		loadState->cacheFile.close();
+		lazyImages.state = loadState;
+		loadState = nullptr;
+		LoadState *state = lazyImages.state;
+		lazyImages.decoding = std::async(std::launch::async, [this, state]() {
+			vks::Tracer::setThreadName("glTF image decoder");
+			decodeImages(*state, state->threadPool);
+		});
+		return;
 	}
-	linearNodes.push_back(newNode);
+
+	delete loadState;
+	loadState = nullptr;
 }
 
-void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
+/*
+	Uploads the lazily loaded images once the background thread has decoded them (see Model::LazyImages)
+	Returns true if the images have been swapped in, command buffers using the model then need to be rebuilt
+	The previous material descriptor sets are left untouched for command buffers still in flight, they are released with the model
+*/
+bool vkglTF::Model::updateLazyImages(VkQueue transferQueue)
 {
-	for (tinygltf::Skin &source : gltfModel.skins) {
-		Skin *newSkin = new Skin{};
-		newSkin->name = source.name;
-				
-		// Find skeleton root node
-		if (source.skeleton > -1) {
-			newSkin->skeletonRoot = nodeFromIndex(source.skeleton);
+	if (!hasPendingImages() || (lazyImages.decoding.wait_for(std::chrono::seconds(0)) != std::future_status::ready)) {
+		return false;
+	}
+	VKS_TRACE_SCOPE("vkglTF::updateLazyImages");
+	lazyImages.decoding.get();
+	LoadState *state = lazyImages.state;
+	lazyImages.state = nullptr;
+	if (!state->fileLoaded) {
+		// Keep the placeholders, the model is still usable without its images
+		std::cerr << "Could not decode images of glTF file \"" << state->filename << "\": " << state->error << "\n";
+		delete state;
+		return false;
+	}
+	VKS_STARTUP_SCOPE(vks::StartupReport::Asset, state->filename + " (lazy images)");
+	// loadImages reads the load flags (e.g. TextureArrays) from the load state
+	loadState = state;
+	loadImages(state->gltfModel, device, transferQueue);
+	loadState = nullptr;
+	delete state;
+	if (!pushDescriptors.noDescriptorSets) {
+		for (auto &material : materials) {
+			if (material.baseColorTexture != nullptr) {
+				material.createDescriptorSet(descriptorAllocator, descriptorLayoutClasses.materials, vkglTF::descriptorSetLayoutImage, descriptorBindingFlags);
+			}
 		}
+	}
+	return true;
+}
+
+/*
+	True while lazily loaded images are still being decoded or waiting to be uploaded
+*/
+bool vkglTF::Model::hasPendingImages() const
+{
+	return lazyImages.state != nullptr;
+}
 
-		// Find joint nodes
-		for (int jointIndex : source.joints) {
-			Node* node = nodeFromIndex(jointIndex);
-			if (node) {
-				newSkin->joints.push_back(nodeFromIndex(jointIndex));
-			}
-		}
+void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
+{
+	bindVertexBuffers(commandBuffer);
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	buffersBound = true;
+}
 
-		// Get inverse bind matrices from buffer
-		if (source.inverseBindMatrices > -1) {
-			const tinygltf::Accessor &accessor = gltfModel.accessors[source.inverseBindMatrices];
-			const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-			const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
-			newSkin->inverseBindMatrices.resize(accessor.count);
-			memcpy(newSkin->inverseBindMatrices.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::mat4));
-		}
+/*
+	Bind the model's vertex buffer (or another buffer with the same layout) to binding 0, and for compact vertices the constant vertex to binding 1
+*/
+void vkglTF::Model::bindVertexBuffers(VkCommandBuffer commandBuffer, VkBuffer vertexBuffer)
+{
+	const VkDeviceSize offsets[2] = {0, 0};
+	const VkBuffer buffers[2] = { vertexBuffer ? vertexBuffer : vertices.buffer, vertexLayout.constants.buffer };
+	vkCmdBindVertexBuffers(commandBuffer, 0, vertexLayout.compact ? 2 : 1, buffers, offsets);
+}
 
-		skins.push_back(newSkin);
+/*
+	Bind the position stream and the index buffer for depth only passes, falls back to the full vertices if the model has no position stream
+	Unlike bindBuffers() this doesn't mark the buffers as bound, so a following draw() without RenderFlags::PositionsOnly binds the full vertices again
+*/
+void vkglTF::Model::bindPositionBuffers(VkCommandBuffer commandBuffer)
+{
+	if (positions.buffer) {
+		const VkDeviceSize offsets[1] = {0};
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &positions.buffer, offsets);
+	}
+	else {
+		bindVertexBuffers(commandBuffer);
 	}
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 }
 
-void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
+/*
+	Returns the pipeline vertex input state with only the position at location 0, matching the buffer bound by bindPositionBuffers()
+*/
+VkPipelineVertexInputStateCreateInfo* vkglTF::Model::getPositionInputState()
 {
-	for (tinygltf::Image &image : gltfModel.images) {
-		vkglTF::Texture texture;
-		texture.fromglTfImage(image, path, device, transferQueue);
-		textures.push_back(texture);
-	}
-	// Create an empty texture to be used for empty material images
-	createEmptyTexture(transferQueue);
+	// The position is the first component of both the full and the compact layout
+	positionInputBinding = { 0, positions.buffer ? static_cast<uint32_t>(sizeof(glm::vec3)) : vertexLayout.stride, VK_VERTEX_INPUT_RATE_VERTEX };
+	positionInputAttribute = { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 };
+	positionInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	positionInputState.vertexBindingDescriptionCount = 1;
+	positionInputState.pVertexBindingDescriptions = &positionInputBinding;
+	positionInputState.vertexAttributeDescriptionCount = 1;
+	positionInputState.pVertexAttributeDescriptions = &positionInputAttribute;
+	return &positionInputState;
 }
 
-void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
+/*
+	Returns the pipeline vertex input state for the requested vertex components in the model's vertex layout
+	Equal to Vertex::getPipelineVertexInputState unless the model has been loaded with FileLoadingFlags::CompactVertices
+*/
+VkPipelineVertexInputStateCreateInfo* vkglTF::Model::getPipelineVertexInputState(const std::vector<VertexComponent> components)
 {
-	for (tinygltf::Material &mat : gltfModel.materials) {
-		vkglTF::Material material(device);
-		if (mat.values.find("baseColorTexture") != mat.values.end()) {
-			material.baseColorTexture = getTexture(gltfModel.textures[mat.values["baseColorTexture"].TextureIndex()].source);
-		}
-		// Metallic roughness workflow
-		if (mat.values.find("metallicRoughnessTexture") != mat.values.end()) {
-			material.metallicRoughnessTexture = getTexture(gltfModel.textures[mat.values["metallicRoughnessTexture"].TextureIndex()].source);
-		}
-		if (mat.values.find("roughnessFactor") != mat.values.end()) {
-			material.roughnessFactor = static_cast<float>(mat.values["roughnessFactor"].Factor());
-		}
-		if (mat.values.find("metallicFactor") != mat.values.end()) {
-			material.metallicFactor = static_cast<float>(mat.values["metallicFactor"].Factor());
+	if (!vertexLayout.compact) {
+		return Vertex::getPipelineVertexInputState(components);
+	}
+	vertexInputBindingDescriptions[0] = { 0, vertexLayout.stride, VK_VERTEX_INPUT_RATE_VERTEX };
+	vertexInputBindingDescriptions[1] = { 1, 0, VK_VERTEX_INPUT_RATE_VERTEX };
+	vertexInputAttributeDescriptions.clear();
+	bool constantsUsed = false;
+	uint32_t location = 0;
+	for (VertexComponent component : components) {
+		const uint32_t index = static_cast<uint32_t>(component);
+		if (vertexLayout.formats[index] != VK_FORMAT_UNDEFINED) {
+			vertexInputAttributeDescriptions.push_back({ location, 0, vertexLayout.formats[index], vertexLayout.offsets[index] });
 		}
-		if (mat.values.find("baseColorFactor") != mat.values.end()) {
-			material.baseColorFactor = glm::make_vec4(mat.values["baseColorFactor"].ColorFactor().data());
-		}				
-		if (mat.additionalValues.find("normalTexture") != mat.additionalValues.end()) {
-			material.normalTexture = getTexture(gltfModel.textures[mat.additionalValues["normalTexture"].TextureIndex()].source);
-		} else {
-			material.normalTexture = &emptyTexture;
+		else {
+			vertexInputAttributeDescriptions.push_back({ location, 1, VK_FORMAT_R8G8B8A8_UNORM, vertexLayout.constantOffsets[index] });
+			constantsUsed = true;
 		}
-		if (mat.additionalValues.find("emissiveTexture") != mat.additionalValues.end()) {
-			material.emissiveTexture = getTexture(gltfModel.textures[mat.additionalValues["emissiveTexture"].TextureIndex()].source);
+		location++;
+	}
+	// The constant binding is always bound, but only declared if an attribute reads from it
+	pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = constantsUsed ? 2 : 1;
+	pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = vertexInputBindingDescriptions;
+	pipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributeDescriptions.size());
+	pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = vertexInputAttributeDescriptions.data();
+	return &pipelineVertexInputStateCreateInfo;
+}
+
+/*
+	Choose the compact vertex layout for the model and quantize the vertices into it
+	Color is only stored if any vertex has a color other than white, joints and weights only if any vertex is skinned
+	Models with joint indices beyond 255, or on devices that can't fetch uscaled8 vertex data, keep the full layout if they're skinned
+*/
+void vkglTF::Model::packVertices(const Vertex *vertexData, size_t vertexCount, std::vector<uint8_t> &packed)
+{
+	bool hasColor = false;
+	bool hasSkin = false;
+	bool jointsFit = true;
+	for (size_t i = 0; i < vertexCount; i++) {
+		const Vertex &vertex = vertexData[i];
+		hasColor = hasColor || (vertex.color != glm::vec4(1.0f));
+		if (vertex.weight0 != glm::vec4(0.0f)) {
+			hasSkin = true;
+			jointsFit = jointsFit && glm::all(glm::lessThanEqual(vertex.joint0, glm::vec4(255.0f)));
 		}
-		if (mat.additionalValues.find("occlusionTexture") != mat.additionalValues.end()) {
-			material.occlusionTexture = getTexture(gltfModel.textures[mat.additionalValues["occlusionTexture"].TextureIndex()].source);
+	}
+	if (hasSkin) {
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, VK_FORMAT_R8G8B8A8_USCALED, &formatProperties);
+		if (!jointsFit || !(formatProperties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT)) {
+			return;
 		}
-		if (mat.additionalValues.find("alphaMode") != mat.additionalValues.end()) {
-			tinygltf::Parameter param = mat.additionalValues["alphaMode"];
-			if (param.string_value == "BLEND") {
-				material.alphaMode = Material::ALPHAMODE_BLEND;
-			}
-			if (param.string_value == "MASK") {
-				material.alphaMode = Material::ALPHAMODE_MASK;
-			}
+	}
+
+	const uint32_t positionIndex = static_cast<uint32_t>(VertexComponent::Position);
+	const uint32_t normalIndex = static_cast<uint32_t>(VertexComponent::Normal);
+	const uint32_t uvIndex = static_cast<uint32_t>(VertexComponent::UV);
+	const uint32_t tangentIndex = static_cast<uint32_t>(VertexComponent::Tangent);
+	const uint32_t colorIndex = static_cast<uint32_t>(VertexComponent::Color);
+	const uint32_t jointIndex = static_cast<uint32_t>(VertexComponent::Joint0);
+	const uint32_t weightIndex = static_cast<uint32_t>(VertexComponent::Weight0);
+	VertexLayout &layout = vertexLayout;
+	uint32_t offset = 0;
+	auto addComponent = [&layout, &offset](uint32_t index, VkFormat format, uint32_t size) {
+		layout.offsets[index] = offset;
+		layout.formats[index] = format;
+		offset += size;
+	};
+	for (uint32_t i = 0; i < 7; i++) {
+		layout.formats[i] = VK_FORMAT_UNDEFINED;
+	}
+	addComponent(positionIndex, VK_FORMAT_R32G32B32_SFLOAT, 12);
+	addComponent(normalIndex, VK_FORMAT_R16G16B16A16_SNORM, 8);
+	addComponent(uvIndex, VK_FORMAT_R16G16_SFLOAT, 4);
+	addComponent(tangentIndex, VK_FORMAT_R16G16B16A16_SNORM, 8);
+	if (hasColor) {
+		addComponent(colorIndex, VK_FORMAT_R8G8B8A8_UNORM, 4);
+	}
+	if (hasSkin) {
+		addComponent(jointIndex, VK_FORMAT_R8G8B8A8_USCALED, 4);
+		addComponent(weightIndex, VK_FORMAT_R8G8B8A8_UNORM, 4);
+	}
+	layout.stride = offset;
+	layout.compact = true;
+
+	// Constant vertex: white color followed by zero joints and weights
+	const uint8_t constants[8] = { 255, 255, 255, 255, 0, 0, 0, 0 };
+	layout.constantOffsets[colorIndex] = 0;
+	layout.constantOffsets[jointIndex] = 4;
+	layout.constantOffsets[weightIndex] = 4;
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &layout.constants, sizeof(constants)));
+	device->getStagingRing()->copyToBuffer(constants, sizeof(constants), layout.constants.buffer);
+
+	packed.resize(vertexCount * layout.stride);
+	for (size_t i = 0; i < vertexCount; i++) {
+		const Vertex &vertex = vertexData[i];
+		uint8_t *dst = packed.data() + i * layout.stride;
+		const uint64_t normal = glm::packSnorm4x16(glm::vec4(vertex.normal, 0.0f));
+		const uint32_t uv = glm::packHalf2x16(vertex.uv);
+		const uint64_t tangent = glm::packSnorm4x16(vertex.tangent);
+		memcpy(dst + layout.offsets[positionIndex], &vertex.pos, 12);
+		memcpy(dst + layout.offsets[normalIndex], &normal, 8);
+		memcpy(dst + layout.offsets[uvIndex], &uv, 4);
+		memcpy(dst + layout.offsets[tangentIndex], &tangent, 8);
+		if (hasColor) {
+			const uint32_t color = glm::packUnorm4x8(vertex.color);
+			memcpy(dst + layout.offsets[colorIndex], &color, 4);
 		}
-		if (mat.additionalValues.find("alphaCutoff") != mat.additionalValues.end()) {
-			material.alphaCutoff = static_cast<float>(mat.additionalValues["alphaCutoff"].Factor());
+		if (hasSkin) {
+			const uint8_t joints[4] = { (uint8_t)vertex.joint0.x, (uint8_t)vertex.joint0.y, (uint8_t)vertex.joint0.z, (uint8_t)vertex.joint0.w };
+			const uint32_t weights = glm::packUnorm4x8(vertex.weight0);
+			memcpy(dst + layout.offsets[jointIndex], joints, 4);
+			memcpy(dst + layout.offsets[weightIndex], &weights, 4);
 		}
-
-		materials.push_back(material);
 	}
-	// Push a default material at the end of the list for meshes with no material assigned
-	materials.push_back(Material(device));
 }
 
-void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
+void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, VkPipeline *boundPipeline)
 {
-	for (tinygltf::Animation &anim : gltfModel.animations) {
-		vkglTF::Animation animation{};
-		animation.name = anim.name;
-		if (anim.name.empty()) {
-			animation.name = std::to_string(animations.size());
+	if (node->mesh && !node->occluded) {
+		if ((renderFlags & RenderFlags::UseDescriptorBuffers) && (descriptorBuffers.nodeSet != DescriptorBuffers::noSet)) {
+			const uint32_t bufferIndex = 0;
+			const VkDeviceSize descriptorOffset = node->mesh->uniformBuffer.descriptorOffset + descriptorBuffers.nodesFrameSize * currentFrame;
+			descriptorBuffers.vkCmdSetDescriptorBufferOffsetsEXT(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, descriptorBuffers.nodeSet, 1, &bufferIndex, &descriptorOffset);
 		}
-
-		// Samplers
-		for (auto &samp : anim.samplers) {
-			vkglTF::AnimationSampler sampler{};
-
-			if (samp.interpolation == "LINEAR") {
-				sampler.interpolation = AnimationSampler::InterpolationType::LINEAR;
-			}
-			if (samp.interpolation == "STEP") {
-				sampler.interpolation = AnimationSampler::InterpolationType::STEP;
-			}
-			if (samp.interpolation == "CUBICSPLINE") {
-				sampler.interpolation = AnimationSampler::InterpolationType::CUBICSPLINE;
-			}
-
-			// Read sampler input time values
-			{
-				const tinygltf::Accessor &accessor = gltfModel.accessors[samp.input];
-				const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
-
-				assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
-
-				float *buf = new float[accessor.count];
-				memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(float));
-				for (size_t index = 0; index < accessor.count; index++) {
-					sampler.inputs.push_back(buf[index]);
-				}
-                delete[] buf;
-				for (auto input : sampler.inputs) {
-					if (input < animation.start) {
-						animation.start = input;
-					};
-					if (input > animation.end) {
-						animation.end = input;
+		if ((renderFlags & RenderFlags::UsePushDescriptors) && (pushDescriptors.nodeDataStages != 0)) {
+			const PushNodeData nodeData = { node->mesh->uniformBlock.matrix, node->index };
+			vkCmdPushConstants(commandBuffer, pipelineLayout, pushDescriptors.nodeDataStages, pushDescriptors.nodeDataOffset, sizeof(PushNodeData), &nodeData);
+		}
+		for (Primitive* primitive : node->mesh->primitives) {
+			const vkglTF::Material& material = primitive->material;
+			if (!skipMaterial(material, renderFlags)) {
+				if ((renderFlags & RenderFlags::BindMaterialPipelines) && (material.pipeline != VK_NULL_HANDLE) && (!boundPipeline || (*boundPipeline != material.pipeline))) {
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipeline);
+					if (boundPipeline) {
+						*boundPipeline = material.pipeline;
 					}
 				}
-			}
-
-			// Read sampler output T/R/S values 
-			{
-				const tinygltf::Accessor &accessor = gltfModel.accessors[samp.output];
-				const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-				const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
-
-				assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
-
-				switch (accessor.type) {
-				case TINYGLTF_TYPE_VEC3: {
-					glm::vec3 *buf = new glm::vec3[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec3));
-					for (size_t index = 0; index < accessor.count; index++) {
-						sampler.outputsVec4.push_back(glm::vec4(buf[index], 0.0f));
+				if (renderFlags & RenderFlags::BindImages) {
+					if (renderFlags & RenderFlags::UseDescriptorBuffers) {
+						const uint32_t bufferIndex = 1;
+						descriptorBuffers.vkCmdSetDescriptorBufferOffsetsEXT(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &bufferIndex, &material.descriptorOffset);
 					}
-                    delete[] buf;
-                    break;
-				}
-				case TINYGLTF_TYPE_VEC4: {
-					glm::vec4 *buf = new glm::vec4[accessor.count];
-					memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec4));
-					for (size_t index = 0; index < accessor.count; index++) {
-						sampler.outputsVec4.push_back(buf[index]);
+					else if (renderFlags & RenderFlags::UsePushDescriptors) {
+						pushMaterialDescriptors(commandBuffer, material, pipelineLayout, bindImageSet);
+					}
+					else {
+						vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
 					}
-                    delete[] buf;
-                    break;
-				}
-				default: {
-					std::cout << "unknown type" << std::endl;
-					break;
 				}
+				uint32_t firstIndex = primitive->firstIndex;
+				uint32_t indexCount = primitive->indexCount;
+				if (lodSelection.enabled && !primitive->lods.empty()) {
+					// Errors are in model units, scaled by the node's (largest) scale like the distance
+					const glm::mat4 &worldMatrix = node->worldMatrix;
+					const float scale = std::max(std::max(glm::length(glm::vec3(worldMatrix[0])), glm::length(glm::vec3(worldMatrix[1]))), glm::length(glm::vec3(worldMatrix[2])));
+					const glm::vec3 center = glm::vec3(worldMatrix * glm::vec4(primitive->dimensions.center, 1.0f));
+					const float distance = std::max(glm::distance(center, lodSelection.viewPos) - primitive->dimensions.radius * scale, 0.0f) / std::max(scale, FLT_MIN);
+					const Primitive::Lod &lod = primitive->lods[primitive->selectLod(distance, lodSelection.errorPerDistance)];
+					firstIndex = lod.firstIndex;
+					indexCount = lod.indexCount;
 				}
+				vkCmdDrawIndexed(commandBuffer, indexCount, 1, firstIndex, 0, 0);
 			}
-
-			animation.samplers.push_back(sampler);
-		}
-
-		// Channels
-		for (auto &source: anim.channels) {
-			vkglTF::AnimationChannel channel{};
-
-			if (source.target_path == "rotation") {
-				channel.path = AnimationChannel::PathType::ROTATION;
-			}
-			if (source.target_path == "translation") {
-				channel.path = AnimationChannel::PathType::TRANSLATION;
-			}
-			if (source.target_path == "scale") {
-				channel.path = AnimationChannel::PathType::SCALE;
-			}
-			if (source.target_path == "weights") {
-				std::cout << "weights not yet supported, skipping channel" << std::endl;
-				continue;
-			}
-			channel.samplerIndex = source.sampler;
-			channel.node = nodeFromIndex(source.target_node);
-			if (!channel.node) {
-				continue;
-			}
-
-			animation.channels.push_back(channel);
 		}
+	}
+	for (auto& child : node->children) {
+		drawNode(child, commandBuffer, renderFlags, pipelineLayout, bindImageSet, boundPipeline);
+	}
+}
 
-		animations.push_back(animation);
+void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+{
+	if (renderFlags & RenderFlags::PullVertices) {
+		bindVertexFetch(commandBuffer, pipelineLayout);
+	}
+	else if (renderFlags & RenderFlags::PositionsOnly) {
+		bindPositionBuffers(commandBuffer);
+	}
+	else if (!buffersBound) {
+		bindVertexBuffers(commandBuffer);
+		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	for (auto& node : nodes) {
+		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet, &boundPipeline);
 	}
 }
 
-void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
+/*
+	Draw a range of the root nodes (and their children), e.g. a part of the scene recorded by vks::ParallelCommandRecorder:
+	recorder.record(model.nodes.size(), 0, inheritanceInfo, [&](VkCommandBuffer commandBuffer, size_t begin, size_t end) { ...; model.drawNodes(commandBuffer, begin, end - begin); });
+	Always binds the vertex and index buffers, as every secondary command buffer starts without bound buffers
+*/
+void vkglTF::Model::drawNodes(VkCommandBuffer commandBuffer, size_t firstNode, size_t nodeCount, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
 {
-	tinygltf::Model gltfModel;
-	tinygltf::TinyGLTF gltfContext;
-	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
-		gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
-	} else {
-		gltfContext.SetImageLoader(loadImageDataFunc, nullptr);
+	if (renderFlags & RenderFlags::PullVertices) {
+		bindVertexFetch(commandBuffer, pipelineLayout);
 	}
-#if defined(__ANDROID__)
-	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
-	// We let tinygltf handle this, by passing the asset manager of our app
-	tinygltf::asset_manager = androidApp->activity->assetManager;
-#endif
-	size_t pos = filename.find_last_of('/');
-	path = filename.substr(0, pos);
+	else if (renderFlags & RenderFlags::PositionsOnly) {
+		bindPositionBuffers(commandBuffer);
+	}
+	else {
+		bindVertexBuffers(commandBuffer);
+		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+	const size_t lastNode = std::min(firstNode + nodeCount, nodes.size());
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	for (size_t i = firstNode; i < lastNode; i++) {
+		drawNode(nodes[i], commandBuffer, renderFlags, pipelineLayout, bindImageSet, &boundPipeline);
+	}
+}
 
-	std::string error, warning;
+/*
+	Enable distance based level of detail selection in drawNode() for primitives with generated levels of detail (see Primitive::selectLod)
+	The view position is in world space, drawNode() selects the level of each primitive from the distance to its bounding sphere
+*/
+void vkglTF::Model::setLodSelection(bool enabled, glm::vec3 viewPos, float errorPerDistance)
+{
+	lodSelection.enabled = enabled;
+	lodSelection.viewPos = viewPos;
+	lodSelection.errorPerDistance = errorPerDistance;
+}
 
-	this->device = device;
+/*
+	Test the meshes of all nodes against the depth buffer of a software occlusion culler, drawNode() skips the occluded ones until the next call
+	The bounds of a mesh are its primitives' dimensions under the node's world matrix (see updateNodes()) and transform, the model matrix of the draw
+	The culler has to be rendered with the view projection the model is drawn with, nodes with several instances are never culled
+	Returns the number of occluded nodes
+*/
+uint32_t vkglTF::Model::cullOccluded(const vks::OcclusionCuller &occlusionCuller, const glm::mat4 &transform)
+{
+	uint32_t occludedCount = 0;
+	for (Node *node : linearNodes) {
+		node->occluded = false;
+		if (!node->mesh || node->mesh->primitives.empty() || !node->instanceMatrices.empty()) {
+			continue;
+		}
+		glm::vec3 min(FLT_MAX);
+		glm::vec3 max(-FLT_MAX);
+		for (Primitive *primitive : node->mesh->primitives) {
+			min = glm::min(min, primitive->dimensions.min);
+			max = glm::max(max, primitive->dimensions.max);
+		}
+		node->occluded = !occlusionCuller.testAABB(min, max, transform * node->worldMatrix);
+		if (node->occluded) {
+			occludedCount++;
+		}
+	}
+	return occludedCount;
+}
 
-#if defined(__ANDROID__)
-	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
-	// We let tinygltf handle this, by passing the asset manager of our app
-	tinygltf::asset_manager = androidApp->activity->assetManager;
-#endif
-	bool fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
+// Draw all nodes again after cullOccluded()
+void vkglTF::Model::clearOccluded()
+{
+	for (Node *node : linearNodes) {
+		node->occluded = false;
+	}
+}
 
-	std::vector<uint32_t> indexBuffer;
-	std::vector<Vertex> vertexBuffer;
+/*
+	Draw the model once per placement matrix with the indirect path, e.g. to fill a scene with copies of it at the cost of one draw call
+	per alpha mode group. Must be called before prepareIndirectDraw(), animations and skins are shared by all copies
+*/
+void vkglTF::Model::setIndirectPlacements(const std::vector<glm::mat4> &placements)
+{
+	assert(!indirect.prepared);
+	indirect.placements = placements;
+}
 
-	if (fileLoaded) {
-		if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
-			loadImages(gltfModel, device, transferQueue);
-		}
-		loadMaterials(gltfModel);
-		const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
-		for (size_t i = 0; i < scene.nodes.size(); i++) {
-			const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
-			loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
-		}
-		if (gltfModel.animations.size() > 0) {
-			loadAnimations(gltfModel);
-		}
-		loadSkins(gltfModel);
+/*
+	World matrix of an indirect transform
+*/
+static glm::mat4 indirectWorldMatrix(const vkglTF::Model::IndirectDraw &indirect, const vkglTF::Model::IndirectTransform &source)
+{
+	const glm::mat4 worldMatrix = instanceWorldMatrix({ source.node, source.instance });
+	return indirect.placements.empty() ? worldMatrix : indirect.placements[source.placement] * worldMatrix;
+}
 
-		for (auto node : linearNodes) {
-			// Assign skins
-			if (node->skinIndex > -1) {
-				node->skin = skins[node->skinIndex];
-			}
-			// Initial pose
-			if (node->mesh) {
-				node->update();
-			}
-		}
-	}
-	else {
-		// TODO: throw
-		vks::tools::exitFatal("Could not load glTF file \"" + filename + "\": " + error, -1);
+/*
+	Build the buffers for drawIndirect(): one indexed indirect command per primitive (per placement and EXT_mesh_gpu_instancing instance),
+	the per-draw transform and material indices and the world matrices of all mesh nodes, and a descriptor set with the transforms (binding 0), draw data (binding 1) and levels of detail (binding 2) storage buffers
+	additionalUsage is added to the command, count and draw data buffers, e.g. storage buffer usage for a culling shader rewriting the commands
+	VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT is also added to the transforms, for shaders reading them by address (see getSceneAddresses())
+	Requires the drawIndirectFirstInstance feature, multiDrawIndirect and VK_KHR_draw_indirect_count are used if they're enabled
+*/
+void vkglTF::Model::prepareIndirectDraw(VkBufferUsageFlags additionalUsage)
+{
+	if (indirect.prepared) {
 		return;
 	}
+	if (flattenedNodes.size() != linearNodes.size()) {
+		flattenNodes();
+	}
 
-	// Pre-Calculations for requested features
-	if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
-		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
-		const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
-		const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
-		for (Node* node : linearNodes) {
-			if (node->mesh) {
-				const glm::mat4 localMatrix = node->getMatrix();
-				for (Primitive* primitive : node->mesh->primitives) {
-					for (uint32_t i = 0; i < primitive->vertexCount; i++) {
-						Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
-						// Pre-transform vertex positions by node-hierarchy
-						if (preTransform) {
-							vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
-							vertex.normal = glm::normalize(glm::mat3(localMatrix) * vertex.normal);
-						}
-						// Flip Y-Axis of vertex positions
-						if (flipY) {
-							vertex.pos.y *= -1.0f;
-							vertex.normal.y *= -1.0f;
+	std::vector<glm::mat4> transforms;
+	std::vector<VkDrawIndexedIndirectCommand> groupCommands[IndirectDraw::groupCount];
+	std::vector<IndirectDrawData> groupDrawData[IndirectDraw::groupCount];
+	std::vector<glm::vec4> groupBounds[IndirectDraw::groupCount];
+	// Levels of detail of all draws, primitives without generated levels have a single one
+	std::vector<IndirectLod> lods;
+	// The levels of detail of a primitive are shared by all its draws
+	std::unordered_map<Primitive*, uint32_t> primitiveLods;
+	const uint32_t placementCount = std::max(static_cast<uint32_t>(indirect.placements.size()), 1u);
+	for (uint32_t placement = 0; placement < placementCount; placement++) {
+		for (Node *node : flattenedNodes) {
+			if (!node->mesh) {
+				continue;
+			}
+			const int32_t instanceCount = static_cast<int32_t>(node->instanceMatrices.size());
+			for (int32_t instance = (instanceCount > 0) ? 0 : -1; instance < instanceCount; instance++) {
+				const uint32_t transformIndex = static_cast<uint32_t>(indirect.transformSources.size());
+				indirect.transformSources.push_back({ node, instance, placement });
+				transforms.push_back(indirectWorldMatrix(indirect, indirect.transformSources.back()));
+				for (Primitive *primitive : node->mesh->primitives) {
+					if (primitive->indexCount == 0) {
+						continue;
+					}
+					const uint32_t group = static_cast<uint32_t>(primitive->material.alphaMode);
+					VkDrawIndexedIndirectCommand command{};
+					command.indexCount = primitive->indexCount;
+					command.instanceCount = 1;
+					command.firstIndex = primitive->firstIndex;
+					groupCommands[group].push_back(command);
+					IndirectDrawData drawData{};
+					drawData.transformIndex = transformIndex;
+					drawData.materialIndex = static_cast<uint32_t>(&primitive->material - materials.data());
+					auto primitiveLod = primitiveLods.find(primitive);
+					if (primitiveLod == primitiveLods.end()) {
+						primitiveLod = primitiveLods.emplace(primitive, static_cast<uint32_t>(lods.size())).first;
+						if (primitive->lods.empty()) {
+							lods.push_back({ primitive->firstIndex, primitive->indexCount, 0.0f, 0.0f });
 						}
-						// Pre-Multiply vertex colors with material base color
-						if (preMultiplyColor) {
-							vertex.color = primitive->material.baseColorFactor * vertex.color;
+						for (const Primitive::Lod &lod : primitive->lods) {
+							lods.push_back({ lod.firstIndex, lod.indexCount, lod.error, 0.0f });
 						}
 					}
+					drawData.firstLod = primitiveLod->second;
+					drawData.lodCount = primitive->lods.empty() ? 1 : static_cast<uint32_t>(primitive->lods.size());
+					groupDrawData[group].push_back(drawData);
+					groupBounds[group].push_back(glm::vec4(primitive->dimensions.center, primitive->dimensions.radius));
 				}
 			}
 		}
 	}
 
-	for (auto extension : gltfModel.extensionsUsed) {
-		if (extension == "KHR_materials_pbrSpecularGlossiness") {
-			std::cout << "Required extension: " << extension;
-			metallicRoughnessWorkflow = false;
-		}
+	// Groups are stored one after another, so the draws of all groups are a single contiguous range
+	std::vector<VkDrawIndexedIndirectCommand> commands;
+	std::vector<IndirectDrawData> drawData;
+	std::vector<glm::vec4> bounds;
+	for (uint32_t group = 0; group < IndirectDraw::groupCount; group++) {
+		indirect.firstDraw[group] = static_cast<uint32_t>(commands.size());
+		indirect.drawCount[group] = static_cast<uint32_t>(groupCommands[group].size());
+		commands.insert(commands.end(), groupCommands[group].begin(), groupCommands[group].end());
+		drawData.insert(drawData.end(), groupDrawData[group].begin(), groupDrawData[group].end());
+		bounds.insert(bounds.end(), groupBounds[group].begin(), groupBounds[group].end());
+	}
+	for (uint32_t i = 0; i < static_cast<uint32_t>(commands.size()); i++) {
+		commands[i].firstInstance = i;
+	}
+	// Empty buffers aren't allowed
+	if (commands.empty()) {
+		commands.push_back(VkDrawIndexedIndirectCommand{});
+		drawData.push_back(IndirectDrawData{});
+		bounds.push_back(glm::vec4(0.0f));
+	}
+	if (transforms.empty()) {
+		transforms.push_back(glm::mat4(1.0f));
+	}
+	if (lods.empty()) {
+		lods.push_back(IndirectLod{});
 	}
 
-	size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
-	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
-	indices.count = static_cast<uint32_t>(indexBuffer.size());
-	vertices.count = static_cast<uint32_t>(vertexBuffer.size());
-
-	assert((vertexBufferSize > 0) && (indexBufferSize > 0));
-
-	struct StagingBuffer {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-	} vertexStaging, indexStaging;
-
-	// Create staging buffers
-	// Vertex data
+	// Commands, counts and draw data are static unless rewritten on the device, they're uploaded through the staging ring like the vertices
 	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		vertexBufferSize,
-		&vertexStaging.buffer,
-		&vertexStaging.memory,
-		vertexBuffer.data()));
-	// Index data
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | additionalUsage,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&indirect.commands,
+		commands.size() * sizeof(VkDrawIndexedIndirectCommand)));
 	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		indexBufferSize,
-		&indexStaging.buffer,
-		&indexStaging.memory,
-		indexBuffer.data()));
-
-	// Create device local buffers
-	// Vertex buffer
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | additionalUsage,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&indirect.counts,
+		sizeof(indirect.drawCount)));
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | additionalUsage,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&indirect.drawData,
+		drawData.size() * sizeof(IndirectDrawData)));
 	VK_CHECK_RESULT(device->createBuffer(
-	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		vertexBufferSize,
-		&vertices.buffer,
-		&vertices.memory));
-	// Index buffer
+		&indirect.lods,
+		lods.size() * sizeof(IndirectLod)));
 	VK_CHECK_RESULT(device->createBuffer(
-	    VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		indexBufferSize,
-		&indices.buffer,
-		&indices.memory));
+		&indirect.bounds,
+		bounds.size() * sizeof(glm::vec4)));
+	vks::StagingRing *stagingRing = device->getStagingRing();
+	stagingRing->copyToBuffer(commands.data(), indirect.commands.size, indirect.commands.buffer);
+	stagingRing->copyToBuffer(lods.data(), indirect.lods.size, indirect.lods.buffer);
+	stagingRing->copyToBuffer(bounds.data(), indirect.bounds.size, indirect.bounds.buffer);
+	stagingRing->copyToBuffer(indirect.drawCount, indirect.counts.size, indirect.counts.buffer);
+	stagingRing->copyToBuffer(drawData.data(), indirect.drawData.size, indirect.drawData.buffer);
+
+	// Transforms change with animations and are written by the host
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | (additionalUsage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT),
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&indirect.transforms,
+		transforms.size() * sizeof(glm::mat4),
+		transforms.data()));
+	VK_CHECK_RESULT(indirect.transforms.map());
+
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+	};
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &indirect.descriptorSetLayout));
+	std::vector<VkDescriptorPoolSize> poolSizes = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
+	};
+	VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &indirect.descriptorPool));
+	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(indirect.descriptorPool, &indirect.descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &indirect.descriptorSet));
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(indirect.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &indirect.transforms.descriptor),
+		vks::initializers::writeDescriptorSet(indirect.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &indirect.drawData.descriptor),
+		vks::initializers::writeDescriptorSet(indirect.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &indirect.lods.descriptor),
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 
-	// Copy from staging buffers
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	// Only returned if the extension has been enabled on the device
+	indirect.vkCmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+	indirect.prepared = true;
+}
 
-	VkBufferCopy copyRegion = {};
+/*
+	Draw all primitives (or those of the alpha mode selected by renderFlags) with as few indirect draw calls as possible
+	Binds the descriptor set of the indirect draw buffers to bindSet of the pipeline layout, per-material descriptor sets can't be bound per draw,
+	so with RenderFlags::BindImages the bindless material set (see prepareBindless()) is bound to bindSet + 1 and the shaders index it with
+	the draw's material index
+	commandsBuffer and countsBuffer replace the model's commands and counts with ones in the same layout written elsewhere (e.g. by vkglTF::GpuCulling)
+*/
+void vkglTF::Model::drawIndirect(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindSet, VkBuffer commandsBuffer, VkBuffer countsBuffer)
+{
+	assert(indirect.prepared);
+	if (commandsBuffer == VK_NULL_HANDLE) {
+		commandsBuffer = indirect.commands.buffer;
+	}
+	if (countsBuffer == VK_NULL_HANDLE) {
+		countsBuffer = indirect.counts.buffer;
+	}
+	if (renderFlags & RenderFlags::PullVertices) {
+		bindVertexFetch(commandBuffer, pipelineLayout);
+	}
+	else if (renderFlags & RenderFlags::PositionsOnly) {
+		bindPositionBuffers(commandBuffer);
+	}
+	else if (!buffersBound) {
+		bindVertexBuffers(commandBuffer);
+		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+	if (pipelineLayout != VK_NULL_HANDLE) {
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindSet, 1, &indirect.descriptorSet, 0, nullptr);
+		if ((renderFlags & RenderFlags::BindImages) && bindless.prepared) {
+			bindBindless(commandBuffer, pipelineLayout, bindSet + 1);
+		}
+	}
+	uint32_t firstGroup = 0;
+	uint32_t lastGroup = IndirectDraw::groupCount - 1;
+	if (renderFlags & RenderFlags::RenderOpaqueNodes) {
+		firstGroup = lastGroup = Material::ALPHAMODE_OPAQUE;
+	}
+	if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
+		firstGroup = lastGroup = Material::ALPHAMODE_MASK;
+	}
+	if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
+		firstGroup = lastGroup = Material::ALPHAMODE_BLEND;
+	}
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	if (indirect.vkCmdDrawIndexedIndirectCountKHR) {
+		// The device side counts may be lower than the group sizes (e.g. after culling)
+		for (uint32_t group = firstGroup; group <= lastGroup; group++) {
+			if (indirect.drawCount[group] > 0) {
+				indirect.vkCmdDrawIndexedIndirectCountKHR(commandBuffer, commandsBuffer, indirect.firstDraw[group] * stride, countsBuffer, group * sizeof(uint32_t), indirect.drawCount[group], stride);
+			}
+		}
+		return;
+	}
+	const uint32_t firstDraw = indirect.firstDraw[firstGroup];
+	const uint32_t drawCount = indirect.firstDraw[lastGroup] + indirect.drawCount[lastGroup] - firstDraw;
+	if (drawCount == 0) {
+		return;
+	}
+	if (device->enabledFeatures.multiDrawIndirect) {
+		vkCmdDrawIndexedIndirect(commandBuffer, commandsBuffer, firstDraw * stride, drawCount, stride);
+	}
+	else {
+		// Without multi draw indirect, every draw needs its own call
+		for (uint32_t i = 0; i < drawCount; i++) {
+			vkCmdDrawIndexedIndirect(commandBuffer, commandsBuffer, (firstDraw + i) * stride, 1, stride);
+		}
+	}
+}
 
-	copyRegion.size = vertexBufferSize;
-	vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
+/*
+	Create the bindless material descriptor set: the parameters of all materials in a storage buffer (binding 0) and all textures of the model
+	followed by the empty texture in a variable sized combined image sampler array (binding 1), both visible to the fragment shader
+	Requires VK_EXT_descriptor_indexing with runtimeDescriptorArray, descriptorBindingVariableDescriptorCount and (for indices that differ
+	within a draw) shaderSampledImageArrayNonUniformIndexing enabled on the device, see the descriptorindexing example
+	additionalUsage is added to the material parameter buffer, e.g. VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT for getSceneAddresses()
+*/
+void vkglTF::Model::prepareBindless(VkBufferUsageFlags additionalUsage)
+{
+	if (bindless.prepared) {
+		return;
+	}
+	const int32_t emptyTextureIndex = static_cast<int32_t>(textures.size());
+	auto textureIndex = [this, emptyTextureIndex](const vkglTF::Texture *texture) -> int32_t {
+		if (texture == nullptr) {
+			return -1;
+		}
+		if (texture == &emptyTexture) {
+			return emptyTextureIndex;
+		}
+		return static_cast<int32_t>(texture - textures.data());
+	};
+	std::vector<BindlessMaterial> materialData(materials.size());
+	for (size_t i = 0; i < materials.size(); i++) {
+		const vkglTF::Material &material = materials[i];
+		BindlessMaterial &data = materialData[i];
+		data.baseColorFactor = material.baseColorFactor;
+		data.metallicFactor = material.metallicFactor;
+		data.roughnessFactor = material.roughnessFactor;
+		data.alphaCutoff = material.alphaCutoff;
+		data.alphaMode = static_cast<uint32_t>(material.alphaMode);
+		data.baseColorTexture = textureIndex(material.baseColorTexture);
+		data.metallicRoughnessTexture = textureIndex(material.metallicRoughnessTexture);
+		data.normalTexture = textureIndex(material.normalTexture);
+		data.occlusionTexture = textureIndex(material.occlusionTexture);
+		data.emissiveTexture = textureIndex(material.emissiveTexture);
+		data.specularGlossinessTexture = textureIndex(material.specularGlossinessTexture);
+		data.diffuseTexture = textureIndex(material.diffuseTexture);
+		data.padding = 0;
+	}
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | additionalUsage,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&bindless.materials,
+		materialData.size() * sizeof(BindlessMaterial)));
+	device->getStagingRing()->copyToBuffer(materialData.data(), bindless.materials.size, bindless.materials.buffer);
+
+	std::vector<VkDescriptorImageInfo> textureDescriptors;
+	textureDescriptors.reserve(textures.size() + 1);
+	for (auto &texture : textures) {
+		textureDescriptors.push_back(texture.descriptor);
+	}
+	textureDescriptors.push_back(emptyTexture.descriptor);
+	const uint32_t textureCount = static_cast<uint32_t>(textureDescriptors.size());
 
-	copyRegion.size = indexBufferSize;
-	vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
+	// The texture array is the last binding, so its size can be chosen when allocating the set
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1, textureCount),
+	};
+	std::vector<VkDescriptorBindingFlagsEXT> bindingFlags = {
+		0,
+		VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT
+	};
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT setLayoutBindingFlags{};
+	setLayoutBindingFlags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	setLayoutBindingFlags.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	setLayoutBindingFlags.pBindingFlags = bindingFlags.data();
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	descriptorLayoutCI.pNext = &setLayoutBindingFlags;
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &bindless.descriptorSetLayout));
 
-	device->flushCommandBuffer(copyCmd, transferQueue, true);
+	std::vector<VkDescriptorPoolSize> poolSizes = {
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCount),
+	};
+	VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &bindless.descriptorPool));
+
+	VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableDescriptorCountAllocInfo{};
+	variableDescriptorCountAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+	variableDescriptorCountAllocInfo.descriptorSetCount = 1;
+	variableDescriptorCountAllocInfo.pDescriptorCounts = &textureCount;
+	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(bindless.descriptorPool, &bindless.descriptorSetLayout, 1);
+	allocInfo.pNext = &variableDescriptorCountAllocInfo;
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &bindless.descriptorSet));
+
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(bindless.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &bindless.materials.descriptor),
+		vks::initializers::writeDescriptorSet(bindless.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, textureDescriptors.data(), textureCount),
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	bindless.prepared = true;
+}
 
-	vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+/* Bind the bindless material set once per pass instead of a material descriptor set per primitive */
+void vkglTF::Model::bindBindless(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t bindSet)
+{
+	assert(bindless.prepared);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindSet, 1, &bindless.descriptorSet, 0, nullptr);
+}
 
-	getSceneDimensions();
+/*
+	Create the meshlet descriptor set (see Model::Meshlets) and the list of meshlet draws, for models loaded with FileLoadingFlags::GenerateMeshlets
+	The transforms are those of the indirect draw path, which is prepared if it hasn't been already
+	Requires VK_EXT_mesh_shader with taskShader and meshShader enabled on the device, see the meshshader example
+	@note Compact vertex layouts can't be read by the mesh shaders, no descriptor set is created for them
+*/
+void vkglTF::Model::prepareMeshlets()
+{
+	if (meshlets.prepared) {
+		return;
+	}
+	if ((meshlets.count == 0) || vertexLayout.compact) {
+		std::cerr << "Model has no meshlets that can be drawn with mesh shaders, load it with FileLoadingFlags::GenerateMeshlets and without CompactVertices\n";
+		return;
+	}
+	prepareIndirectDraw();
 
-	// Setup descriptors
-	uint32_t uboCount{ 0 };
-	uint32_t imageCount{ 0 };
-	for (auto node : linearNodes) {
-		if (node->mesh) {
-			uboCount++;
+	std::vector<MeshletDraw> groupDraws[IndirectDraw::groupCount];
+	for (size_t i = 0; i < indirect.transformSources.size(); i++) {
+		for (Primitive *primitive : indirect.transformSources[i].node->mesh->primitives) {
+			if (primitive->meshletCount == 0) {
+				continue;
+			}
+			MeshletDraw draw{};
+			draw.transformIndex = static_cast<uint32_t>(i);
+			draw.materialIndex = static_cast<uint32_t>(&primitive->material - materials.data());
+			draw.firstMeshlet = primitive->firstMeshlet;
+			draw.meshletCount = primitive->meshletCount;
+			groupDraws[primitive->material.alphaMode].push_back(draw);
 		}
 	}
-	for (auto material : materials) {
-		if (material.baseColorTexture != nullptr) {
-			imageCount++;
-		}
+	for (uint32_t group = 0; group < IndirectDraw::groupCount; group++) {
+		meshlets.firstDraw[group] = static_cast<uint32_t>(meshlets.draws.size());
+		meshlets.drawCount[group] = static_cast<uint32_t>(groupDraws[group].size());
+		meshlets.draws.insert(meshlets.draws.end(), groupDraws[group].begin(), groupDraws[group].end());
 	}
+
+	const VkShaderStageFlags stages = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, 0),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, 1),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, 2),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, 3),
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, 4),
+	};
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &meshlets.descriptorSetLayout));
 	std::vector<VkDescriptorPoolSize> poolSizes = {
-		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uboCount },
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),
 	};
-	if (imageCount > 0) {
-		if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
-			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
+	VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &meshlets.descriptorPool));
+	VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(meshlets.descriptorPool, &meshlets.descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &meshlets.descriptorSet));
+	VkDescriptorBufferInfo vertexDescriptor = { vertices.buffer, 0, VK_WHOLE_SIZE };
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(meshlets.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &meshlets.meshlets.descriptor),
+		vks::initializers::writeDescriptorSet(meshlets.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &meshlets.vertices.descriptor),
+		vks::initializers::writeDescriptorSet(meshlets.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &meshlets.triangles.descriptor),
+		vks::initializers::writeDescriptorSet(meshlets.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &vertexDescriptor),
+		vks::initializers::writeDescriptorSet(meshlets.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &indirect.transforms.descriptor),
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+	// Only returned if the extension has been enabled on the device
+	meshlets.vkCmdDrawMeshTasksEXT = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdDrawMeshTasksEXT"));
+	meshlets.prepared = meshlets.vkCmdDrawMeshTasksEXT != nullptr;
+}
+
+/*
+	Draw the meshlets of all primitives (or those of the alpha mode selected by renderFlags) with a pipeline using task and mesh shaders
+	The meshlet set is bound to bindSet of the pipeline layout, each draw passes its MeshletDraw as push constants to the task and mesh stages
+	With RenderFlags::BindImages the bindless material set (see prepareBindless()) is bound to bindSet + 1
+*/
+void vkglTF::Model::drawMeshlets(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindSet)
+{
+	if (!meshlets.prepared || (pipelineLayout == VK_NULL_HANDLE)) {
+		return;
+	}
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindSet, 1, &meshlets.descriptorSet, 0, nullptr);
+	if ((renderFlags & RenderFlags::BindImages) && bindless.prepared) {
+		bindBindless(commandBuffer, pipelineLayout, bindSet + 1);
+	}
+	uint32_t firstGroup = 0;
+	uint32_t lastGroup = IndirectDraw::groupCount - 1;
+	if (renderFlags & RenderFlags::RenderOpaqueNodes) {
+		firstGroup = lastGroup = Material::ALPHAMODE_OPAQUE;
+	}
+	if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
+		firstGroup = lastGroup = Material::ALPHAMODE_MASK;
+	}
+	if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
+		firstGroup = lastGroup = Material::ALPHAMODE_BLEND;
+	}
+	for (uint32_t i = meshlets.firstDraw[firstGroup]; i < meshlets.firstDraw[lastGroup] + meshlets.drawCount[lastGroup]; i++) {
+		const MeshletDraw &draw = meshlets.draws[i];
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, 0, sizeof(MeshletDraw), &draw);
+		meshlets.vkCmdDrawMeshTasksEXT(commandBuffer, (draw.meshletCount + Meshlets::meshletsPerTask - 1) / Meshlets::meshletsPerTask, 1, 1);
+	}
+}
+
+/*
+	Build the instance buffer for drawInstanced(): primitives with the same index range and material are batched in the order of their first use,
+	with one instance per node using them (or per EXT_mesh_gpu_instancing instance of the node)
+*/
+void vkglTF::Model::prepareInstancing()
+{
+	if (instancing.prepared) {
+		return;
+	}
+	if (flattenedNodes.size() != linearNodes.size()) {
+		flattenNodes();
+	}
+
+	std::map<std::tuple<uint32_t, uint32_t, const Material*>, size_t> batchIndices;
+	std::vector<std::vector<InstanceSource>> batchSources;
+	for (Node *node : flattenedNodes) {
+		if (!node->mesh) {
+			continue;
 		}
-		if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
-			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
+		for (Primitive *primitive : node->mesh->primitives) {
+			if (primitive->indexCount == 0) {
+				continue;
+			}
+			const std::tuple<uint32_t, uint32_t, const Material*> key(primitive->firstIndex, primitive->indexCount, &primitive->material);
+			auto batch = batchIndices.find(key);
+			if (batch == batchIndices.end()) {
+				batch = batchIndices.emplace(key, instancing.batches.size()).first;
+				instancing.batches.push_back({ primitive, 0, 0 });
+				batchSources.emplace_back();
+			}
+			std::vector<InstanceSource> &sources = batchSources[batch->second];
+			if (node->instanceMatrices.empty()) {
+				sources.push_back({ node, -1 });
+			}
+			for (size_t i = 0; i < node->instanceMatrices.size(); i++) {
+				sources.push_back({ node, static_cast<int32_t>(i) });
+			}
 		}
 	}
-	VkDescriptorPoolCreateInfo descriptorPoolCI{};
-	descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-	descriptorPoolCI.pPoolSizes = poolSizes.data();
-	descriptorPoolCI.maxSets = uboCount + imageCount;
-	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
 
-	// Descriptors for per-node uniform buffers
-	{
-		// Layout is global, so only create if it hasn't already been created before
-		if (descriptorSetLayoutUbo == VK_NULL_HANDLE) {
-			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
-			};
-			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
-			descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-			descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
-			descriptorLayoutCI.pBindings = setLayoutBindings.data();
-			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutUbo));
-		}
-		for (auto node : nodes) {
-			prepareNodeDescriptor(node, descriptorSetLayoutUbo);
+	std::vector<glm::mat4> matrices;
+	for (size_t i = 0; i < instancing.batches.size(); i++) {
+		instancing.batches[i].firstInstance = static_cast<uint32_t>(instancing.sources.size());
+		instancing.batches[i].instanceCount = static_cast<uint32_t>(batchSources[i].size());
+		for (const InstanceSource &source : batchSources[i]) {
+			instancing.sources.push_back(source);
+			matrices.push_back(instanceWorldMatrix(source));
 		}
 	}
+	// Empty buffers aren't allowed
+	if (matrices.empty()) {
+		matrices.push_back(glm::mat4(1.0f));
+	}
 
-	// Descriptors for per-material images
-	{
-		// Layout is global, so only create if it hasn't already been created before
-		if (descriptorSetLayoutImage == VK_NULL_HANDLE) {
-			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
-			if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
-				setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(setLayoutBindings.size())));
-			}
-			if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
-				setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(setLayoutBindings.size())));
-			}
-			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
-			descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-			descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
-			descriptorLayoutCI.pBindings = setLayoutBindings.data();
-			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutImage));
+	// Host visible like the indirect transforms, as animated nodes update their instances every frame
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&instancing.instances,
+		matrices.size() * sizeof(glm::mat4),
+		matrices.data()));
+	VK_CHECK_RESULT(instancing.instances.map());
+	instancing.prepared = true;
+}
+
+/*
+	Returns the model's vertex input state for the requested vertex components with the per-instance world matrix added at Instancing::binding,
+	read as four vec4 attributes at the locations following the components
+*/
+VkPipelineVertexInputStateCreateInfo* vkglTF::Model::getInstancedVertexInputState(const std::vector<VertexComponent> components)
+{
+	const VkPipelineVertexInputStateCreateInfo *vertexInputState = getPipelineVertexInputState(components);
+	const uint32_t bindingCount = vertexInputState->vertexBindingDescriptionCount;
+	for (uint32_t i = 0; i < bindingCount; i++) {
+		instancing.inputBindings[i] = vertexInputState->pVertexBindingDescriptions[i];
+	}
+	instancing.inputBindings[bindingCount] = { Instancing::binding, sizeof(glm::mat4), VK_VERTEX_INPUT_RATE_INSTANCE };
+	instancing.inputAttributes.assign(vertexInputState->pVertexAttributeDescriptions, vertexInputState->pVertexAttributeDescriptions + vertexInputState->vertexAttributeDescriptionCount);
+	const uint32_t location = static_cast<uint32_t>(components.size());
+	for (uint32_t column = 0; column < 4; column++) {
+		instancing.inputAttributes.push_back({ location + column, Instancing::binding, VK_FORMAT_R32G32B32A32_SFLOAT, column * static_cast<uint32_t>(sizeof(glm::vec4)) });
+	}
+	instancing.inputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	instancing.inputState.vertexBindingDescriptionCount = bindingCount + 1;
+	instancing.inputState.pVertexBindingDescriptions = instancing.inputBindings;
+	instancing.inputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(instancing.inputAttributes.size());
+	instancing.inputState.pVertexAttributeDescriptions = instancing.inputAttributes.data();
+	return &instancing.inputState;
+}
+
+/*
+	Draw every batch of primitives (or those of the alpha mode selected by renderFlags) with a single instanced draw, for pipelines created with
+	getInstancedVertexInputState(). Level of detail selection doesn't apply, as the instances of a batch are at different distances.
+	Skinned nodes are drawn as single instances, but their joint matrices aren't applied
+*/
+void vkglTF::Model::drawInstanced(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+{
+	assert(instancing.prepared);
+	if (renderFlags & RenderFlags::PositionsOnly) {
+		bindPositionBuffers(commandBuffer);
+	}
+	else if (!buffersBound) {
+		bindVertexBuffers(commandBuffer);
+		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+	const VkDeviceSize offsets[1] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, Instancing::binding, 1, &instancing.instances.buffer, offsets);
+	const Material *boundMaterial = nullptr;
+	for (const InstanceBatch &batch : instancing.batches) {
+		const Material &material = batch.primitive->material;
+		if (skipMaterial(material, renderFlags)) {
+			continue;
 		}
-		for (auto& material : materials) {
-			if (material.baseColorTexture != nullptr) {
-				material.createDescriptorSet(descriptorPool, vkglTF::descriptorSetLayoutImage, descriptorBindingFlags);
+		if ((renderFlags & RenderFlags::BindImages) && (&material != boundMaterial)) {
+			if (renderFlags & RenderFlags::UsePushDescriptors) {
+				pushMaterialDescriptors(commandBuffer, material, pipelineLayout, bindImageSet);
+			}
+			else {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
 			}
+			boundMaterial = &material;
 		}
+		vkCmdDrawIndexed(commandBuffer, batch.primitive->indexCount, batch.instanceCount, batch.primitive->firstIndex, 0, batch.firstInstance);
 	}
 }
 
-void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
+/*
+	Merges the index ranges of all primitives sharing a material into one range per material (see Model::StaticBatching)
+	batchedIndices receives the model's indices followed by the ranges of the batches
+*/
+void vkglTF::Model::buildStaticBatches(const uint32_t *indexData, size_t indexCount, std::vector<uint32_t> &batchedIndices)
 {
-	const VkDeviceSize offsets[1] = {0};
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-	buffersBound = true;
+	staticBatching.batches.clear();
+	staticBatching.primitiveCount = 0;
+
+	// Primitives of each material in node order
+	std::vector<std::pair<Material*, std::vector<const Primitive*>>> groups;
+	std::unordered_map<const Material*, size_t> groupIndices;
+	size_t batchedIndexCount = 0;
+	for (Node *node : linearNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		for (const Primitive *primitive : node->mesh->primitives) {
+			if (primitive->indexCount == 0) {
+				continue;
+			}
+			auto group = groupIndices.find(&primitive->material);
+			if (group == groupIndices.end()) {
+				group = groupIndices.insert(std::make_pair(&primitive->material, groups.size())).first;
+				groups.push_back(std::make_pair(&primitive->material, std::vector<const Primitive*>()));
+			}
+			groups[group->second].second.push_back(primitive);
+			batchedIndexCount += primitive->indexCount;
+			staticBatching.primitiveCount++;
+		}
+	}
+	std::stable_sort(groups.begin(), groups.end(), [](const std::pair<Material*, std::vector<const Primitive*>> &a, const std::pair<Material*, std::vector<const Primitive*>> &b) {
+		return a.first->alphaMode < b.first->alphaMode;
+	});
+
+	batchedIndices.reserve(indexCount + batchedIndexCount);
+	batchedIndices.assign(indexData, indexData + indexCount);
+	for (auto &group : groups) {
+		StaticBatch batch;
+		batch.material = group.first;
+		batch.firstIndex = static_cast<uint32_t>(batchedIndices.size());
+		for (const Primitive *primitive : group.second) {
+			batchedIndices.insert(batchedIndices.end(), indexData + primitive->firstIndex, indexData + primitive->firstIndex + primitive->indexCount);
+		}
+		batch.indexCount = static_cast<uint32_t>(batchedIndices.size()) - batch.firstIndex;
+		staticBatching.batches.push_back(batch);
+	}
 }
 
-void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
+/*
+	Draw the static batches of a model loaded with FileLoadingFlags::StaticBatching, one draw per material
+	Accepts the same render flags as draw(), with RenderFlags::UsePushDescriptors an identity node matrix is pushed for all batches
+*/
+void vkglTF::Model::drawStaticBatches(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
 {
-	if (node->mesh) {
-		for (Primitive* primitive : node->mesh->primitives) {
-			bool skip = false;
-			const vkglTF::Material& material = primitive->material;
-			if (renderFlags & RenderFlags::RenderOpaqueNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_OPAQUE);
-			}
-			if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_MASK);
+	if (renderFlags & RenderFlags::PullVertices) {
+		bindVertexFetch(commandBuffer, pipelineLayout);
+	}
+	else if (renderFlags & RenderFlags::PositionsOnly) {
+		bindPositionBuffers(commandBuffer);
+	}
+	else if (!buffersBound) {
+		bindVertexBuffers(commandBuffer);
+		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+	if ((renderFlags & RenderFlags::UsePushDescriptors) && (pushDescriptors.nodeDataStages != 0)) {
+		const PushNodeData nodeData = { glm::mat4(1.0f), 0 };
+		vkCmdPushConstants(commandBuffer, pipelineLayout, pushDescriptors.nodeDataStages, pushDescriptors.nodeDataOffset, sizeof(PushNodeData), &nodeData);
+	}
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	for (const StaticBatch &batch : staticBatching.batches) {
+		const Material &material = *batch.material;
+		if (skipMaterial(material, renderFlags)) {
+			continue;
+		}
+		if ((renderFlags & RenderFlags::BindMaterialPipelines) && (material.pipeline != VK_NULL_HANDLE) && (material.pipeline != boundPipeline)) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipeline);
+			boundPipeline = material.pipeline;
+		}
+		if (renderFlags & RenderFlags::BindImages) {
+			if (renderFlags & RenderFlags::UseDescriptorBuffers) {
+				const uint32_t bufferIndex = 1;
+				descriptorBuffers.vkCmdSetDescriptorBufferOffsetsEXT(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &bufferIndex, &material.descriptorOffset);
 			}
-			if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
-				skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
+			else if (renderFlags & RenderFlags::UsePushDescriptors) {
+				pushMaterialDescriptors(commandBuffer, material, pipelineLayout, bindImageSet);
 			}
-			if (!skip) {
-				if (renderFlags & RenderFlags::BindImages) {
-					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
-				}
-				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+			else {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
 			}
 		}
-	}
-	for (auto& child : node->children) {
-		drawNode(child, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
-	}
-}
-
-void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
-{
-	if (!buffersBound) {
-		const VkDeviceSize offsets[1] = {0};
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-	}
-	for (auto& node : nodes) {
-		drawNode(node, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
+		vkCmdDrawIndexed(commandBuffer, batch.indexCount, 1, batch.firstIndex, 0, 0);
 	}
 }
 
@@ -1484,7 +4642,151 @@ void vkglTF::Model::getSceneDimensions()
 	dimensions.radius = glm::distance(dimensions.min, dimensions.max) / 2.0f;
 }
 
-void vkglTF::Model::updateAnimation(uint32_t index, float time)
+/*
+	Orders all nodes so that parents come before their children (linearNodes has children first), the order doesn't change after loading
+*/
+void vkglTF::Model::flattenNodes()
+{
+	flattenedNodes.clear();
+	flattenedNodes.reserve(linearNodes.size());
+	flattenedNodes.insert(flattenedNodes.end(), nodes.begin(), nodes.end());
+	// The vector is its own queue, children are appended while their parents are visited
+	for (size_t i = 0; i < flattenedNodes.size(); i++) {
+		Node *node = flattenedNodes[i];
+		flattenedNodes.insert(flattenedNodes.end(), node->children.begin(), node->children.end());
+	}
+}
+
+/*
+	Updates the cached world matrices of all nodes in a single top-down pass and uploads the mesh matrices that changed
+	Only nodes that are dirty or below a node whose world matrix changed are recalculated
+	With a thread pool the joint palettes and mesh matrices are computed on its workers, the hierarchy pass itself stays serial as it's cheap
+*/
+void vkglTF::Model::updateNodes(vks::ThreadPool* threadPool)
+{
+	// Nodes added with loadNode after loading aren't part of the pass order yet
+	if (flattenedNodes.size() != linearNodes.size()) {
+		flattenNodes();
+	}
+	for (Node *node : flattenedNodes) {
+		node->worldChanged = node->dirty || (node->parent && node->parent->worldChanged);
+		if (node->worldChanged) {
+			node->worldMatrix = node->parent ? node->parent->worldMatrix * node->localMatrix() : node->localMatrix();
+			node->dirty = false;
+		}
+	}
+	std::vector<Node*> changedMeshNodes;
+	for (Node *node : flattenedNodes) {
+		if (!node->mesh) {
+			continue;
+		}
+		bool changed = node->worldChanged;
+		if (node->skin) {
+			for (size_t i = 0; (i < node->skin->joints.size()) && !changed; i++) {
+				changed = node->skin->joints[i]->worldChanged;
+			}
+		}
+		// Every frame copy of the uniform block has to be written once after a change, one per pass
+		if (changed) {
+			node->mesh->pendingFrames = (node->mesh->uniformBuffer.frameStride != 0) ? framesInFlight : 1;
+		}
+		if (node->mesh->pendingFrames > 0) {
+			node->mesh->pendingFrames--;
+			changedMeshNodes.push_back(node);
+		}
+	}
+	const uint32_t frameIndex = currentFrame;
+	if (threadPool) {
+		threadPool->parallelFor(changedMeshNodes.size(), 4, [&changedMeshNodes, frameIndex](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				changedMeshNodes[i]->update(frameIndex);
+			}
+		});
+	}
+	else {
+		for (Node *node : changedMeshNodes) {
+			node->update(frameIndex);
+		}
+	}
+	if (meshUniforms.buffer.buffer != VK_NULL_HANDLE) {
+		flushMeshUniforms(changedMeshNodes);
+	}
+	if (indirect.prepared) {
+		glm::mat4 *transforms = static_cast<glm::mat4*>(indirect.transforms.mapped);
+		for (size_t i = 0; i < indirect.transformSources.size(); i++) {
+			if (indirect.transformSources[i].node->worldChanged) {
+				transforms[i] = indirectWorldMatrix(indirect, indirect.transformSources[i]);
+			}
+		}
+	}
+	if (instancing.prepared) {
+		glm::mat4 *instances = static_cast<glm::mat4*>(instancing.instances.mapped);
+		for (size_t i = 0; i < instancing.sources.size(); i++) {
+			if (instancing.sources[i].node->worldChanged) {
+				instances[i] = instanceWorldMatrix(instancing.sources[i]);
+			}
+		}
+	}
+}
+
+/*
+	glTF animation sampler
+*/
+
+/*
+	Finds the key starting the interval [inputs[key], inputs[key + 1]] that contains the time, returns false if the time is outside of the sampler's keys
+	The key of the previous lookup and the one after it are checked first, so playback costs constant time per frame independent of the clip length,
+	any other time (seeking, looping) is found with a binary search
+*/
+bool vkglTF::AnimationSampler::findKey(float time, uint32_t &key) const
+{
+	if ((inputs.size() < 2) || (time < inputs.front()) || (time > inputs.back())) {
+		return false;
+	}
+	const uint32_t lastKey = static_cast<uint32_t>(inputs.size()) - 2;
+	if (key <= lastKey) {
+		if ((time >= inputs[key]) && (time <= inputs[key + 1])) {
+			return true;
+		}
+		if ((key < lastKey) && (time >= inputs[key + 1]) && (time <= inputs[key + 2])) {
+			key++;
+			return true;
+		}
+	}
+	// The first input after the time ends the interval
+	const size_t upper = std::upper_bound(inputs.begin(), inputs.end(), time) - inputs.begin();
+	key = static_cast<uint32_t>(std::min(upper, inputs.size() - 1) - 1);
+	return true;
+}
+
+/*
+	Samples a compact track, the frame's entry in frameKeys is the interval to interpolate, returns false if the time is outside of the track
+	Rotations are returned as (x, y, z, w)
+*/
+bool vkglTF::AnimationSampler::CompactTrack::sample(float time, glm::vec4 &value) const
+{
+	const float position = (time - start) * frameRate;
+	if ((keyFrames.size() < 2) || (position < 0.0f) || (position > static_cast<float>(frameCount - 1))) {
+		return false;
+	}
+	const float frame = position;
+	const uint32_t key = frameKeys[static_cast<uint32_t>(frame)];
+	const float firstFrame = keyFrames[key];
+	const float u = std::min(std::max(0.0f, (frame - firstFrame) / (keyFrames[key + 1] - firstFrame)), 1.0f);
+	if (!rotations.empty()) {
+		value = nlerpQuaternion(unpackQuaternion(rotations[key]), unpackQuaternion(rotations[key + 1]), u);
+	} else {
+		value = glm::vec4(glm::mix(values[key], values[key + 1], u), 0.0f);
+	}
+	return true;
+}
+
+/*
+	Samples the animation at the given time and updates the node hierarchy and mesh matrices
+	With a thread pool the channels are sampled and the joint palettes computed on its workers, a channel only writes its own property of its node
+	Different models can also be updated from different jobs at the same time, as the update only touches the model's own data
+*/
+void vkglTF::Model::updateAnimation(uint32_t index, float time, vks::ThreadPool* threadPool)
 {
 	if (index > static_cast<uint32_t>(animations.size()) - 1) {
 		std::cout << "No animation with index " << index << std::endl;
@@ -1492,53 +4794,107 @@ void vkglTF::Model::updateAnimation(uint32_t index, float time)
 	}
 	Animation &animation = animations[index];
 
-	bool updated = false;
-	for (auto& channel : animation.channels) {
+	// Returns true if the channel changed its node
+	auto sampleChannel = [&animation, time](AnimationChannel &channel) -> bool {
 		vkglTF::AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
-		if (sampler.inputs.size() > sampler.outputsVec4.size()) {
-			continue;
+		if (!sampler.compactTrack.empty()) {
+			glm::vec4 value;
+			if (!sampler.compactTrack.sample(time, value)) {
+				return false;
+			}
+			switch (channel.path) {
+			case vkglTF::AnimationChannel::PathType::TRANSLATION:
+				channel.node->translation = glm::vec3(value);
+				break;
+			case vkglTF::AnimationChannel::PathType::SCALE:
+				channel.node->scale = glm::vec3(value);
+				break;
+			case vkglTF::AnimationChannel::PathType::ROTATION:
+				channel.node->rotation = glm::quat(value.w, value.x, value.y, value.z);
+				break;
+			default:
+				return false;
+			}
+			return true;
+		}
+		// Weights channels have one scalar output per morph target and key, cubic spline keys also store an in- and an out-tangent per target
+		const size_t targetCount = channel.node->morphWeights.size();
+		const bool cubicSpline = (sampler.interpolation == AnimationSampler::InterpolationType::CUBICSPLINE);
+		const size_t weightStride = cubicSpline ? targetCount * 3 : targetCount;
+		const size_t outputCount = (channel.path == vkglTF::AnimationChannel::PathType::WEIGHTS) ? sampler.outputs.size() / std::max(weightStride, (size_t)1) : sampler.outputsVec4.size();
+		if ((sampler.inputs.size() > outputCount) || !sampler.findKey(time, channel.key)) {
+			return false;
+		}
+		const uint32_t i = channel.key;
+		const float interval = sampler.inputs[i + 1] - sampler.inputs[i];
+		// Step interpolation holds the value of the interval's first key
+		float u = 0.0f;
+		if ((sampler.interpolation != AnimationSampler::InterpolationType::STEP) && (interval > 0.0f)) {
+			u = std::min(std::max(0.0f, time - sampler.inputs[i]) / interval, 1.0f);
+		}
+		switch (channel.path) {
+		case vkglTF::AnimationChannel::PathType::TRANSLATION: {
+			glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
+			channel.node->translation = glm::vec3(trans);
+			break;
+		}
+		case vkglTF::AnimationChannel::PathType::SCALE: {
+			glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
+			channel.node->scale = glm::vec3(trans);
+			break;
+		}
+		case vkglTF::AnimationChannel::PathType::ROTATION: {
+			glm::quat q1;
+			q1.x = sampler.outputsVec4[i].x;
+			q1.y = sampler.outputsVec4[i].y;
+			q1.z = sampler.outputsVec4[i].z;
+			q1.w = sampler.outputsVec4[i].w;
+			glm::quat q2;
+			q2.x = sampler.outputsVec4[i + 1].x;
+			q2.y = sampler.outputsVec4[i + 1].y;
+			q2.z = sampler.outputsVec4[i + 1].z;
+			q2.w = sampler.outputsVec4[i + 1].w;
+			channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
+			break;
+		}
+		case vkglTF::AnimationChannel::PathType::WEIGHTS: {
+			const size_t valueOffset = cubicSpline ? targetCount : 0;
+			for (size_t target = 0; target < targetCount; target++) {
+				const float w1 = sampler.outputs[i * weightStride + valueOffset + target];
+				const float w2 = sampler.outputs[(i + 1) * weightStride + valueOffset + target];
+				channel.node->morphWeights[target] = w1 + (w2 - w1) * u;
+			}
+			// Weights don't change the node's transform, they're applied by the morph target pass of vkglTF::ComputeSkinning
+			return false;
+		}
 		}
+		return true;
+	};
 
-		for (auto i = 0; i < sampler.inputs.size() - 1; i++) {
-			if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-				float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-				if (u <= 1.0f) {
-					switch (channel.path) {
-					case vkglTF::AnimationChannel::PathType::TRANSLATION: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->translation = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::SCALE: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->scale = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::ROTATION: {
-						glm::quat q1;
-						q1.x = sampler.outputsVec4[i].x;
-						q1.y = sampler.outputsVec4[i].y;
-						q1.z = sampler.outputsVec4[i].z;
-						q1.w = sampler.outputsVec4[i].w;
-						glm::quat q2;
-						q2.x = sampler.outputsVec4[i + 1].x;
-						q2.y = sampler.outputsVec4[i + 1].y;
-						q2.z = sampler.outputsVec4[i + 1].z;
-						q2.w = sampler.outputsVec4[i + 1].w;
-						channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
-						break;
-					}
-					}
-					updated = true;
-				}
+	// Nodes are marked afterwards as several channels may target the same node
+	std::vector<uint8_t> sampled(animation.channels.size(), 0);
+	if (threadPool) {
+		threadPool->parallelFor(animation.channels.size(), 64, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				sampled[i] = sampleChannel(animation.channels[i]) ? 1 : 0;
 			}
+		});
+	}
+	else {
+		for (size_t i = 0; i < animation.channels.size(); i++) {
+			sampled[i] = sampleChannel(animation.channels[i]) ? 1 : 0;
 		}
 	}
-	if (updated) {
-		for (auto &node : nodes) {
-			node->update();
+	bool updated = false;
+	for (size_t i = 0; i < animation.channels.size(); i++) {
+		if (sampled[i]) {
+			animation.channels[i].node->dirty = true;
+			updated = true;
 		}
 	}
+	if (updated) {
+		updateNodes(threadPool);
+	}
 }
 
 /*
@@ -1569,26 +4925,487 @@ vkglTF::Node* vkglTF::Model::nodeFromIndex(uint32_t index) {
 	return nodeFound;
 }
 
-void vkglTF::Model::prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout) {
-	if (node->mesh) {
-		VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-		descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		descriptorSetAllocInfo.descriptorPool = descriptorPool;
-		descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
-		descriptorSetAllocInfo.descriptorSetCount = 1;
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &node->mesh->uniformBuffer.descriptorSet));
-
+/*
+	Allocates one descriptor set per frame copy of the mesh's uniform block
+*/
+void vkglTF::Model::prepareMeshDescriptor(vkglTF::Mesh* mesh, VkDescriptorSetLayout descriptorSetLayout) {
+	const uint32_t frameCount = (mesh->uniformBuffer.frameStride != 0) ? framesInFlight : 1;
+	mesh->uniformBuffer.descriptorSets.resize(frameCount);
+	for (uint32_t frame = 0; frame < frameCount; frame++) {
+		VK_CHECK_RESULT(descriptorAllocator->allocate(descriptorSetLayout, &mesh->uniformBuffer.descriptorSets[frame], descriptorLayoutClasses.nodes));
+
+		VkDescriptorBufferInfo bufferInfo = mesh->uniformBuffer.descriptor;
+		bufferInfo.offset += mesh->uniformBuffer.frameStride * frame;
 		VkWriteDescriptorSet writeDescriptorSet{};
 		writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.dstSet = node->mesh->uniformBuffer.descriptorSet;
+		writeDescriptorSet.dstSet = mesh->uniformBuffer.descriptorSets[frame];
 		writeDescriptorSet.dstBinding = 0;
-		writeDescriptorSet.pBufferInfo = &node->mesh->uniformBuffer.descriptor;
+		writeDescriptorSet.pBufferInfo = &bufferInfo;
 
 		vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
 	}
+	mesh->uniformBuffer.descriptorSet = mesh->uniformBuffer.descriptorSets[0];
+}
+
+void vkglTF::Model::prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout) {
+	if (node->mesh) {
+		prepareMeshDescriptor(node->mesh, descriptorSetLayout);
+	}
 	for (auto& child : node->children) {
 		prepareNodeDescriptor(child, descriptorSetLayout);
 	}
 }
+
+/*
+	Packs the uniform blocks of all meshes that don't have a buffer of their own into one persistently mapped buffer
+	The buffer holds framesInFlight copies of all ranges, one after the other, the mesh descriptors point at the first one
+	The memory doesn't have to be host coherent, writes done by Node::update are made visible by flushMeshUniforms
+*/
+void vkglTF::Model::prepareMeshUniforms(VkBufferUsageFlags additionalUsage)
+{
+	std::vector<Mesh*> meshes;
+	for (Node *node : linearNodes) {
+		if (node->mesh && (node->mesh->uniformBuffer.buffer == VK_NULL_HANDLE)) {
+			meshes.push_back(node->mesh);
+		}
+	}
+	if (meshes.empty()) {
+		return;
+	}
+	const VkPhysicalDeviceLimits &limits = device->properties.limits;
+	const VkDeviceSize alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.nonCoherentAtomSize);
+	meshUniforms.stride = (sizeof(Mesh::UniformBlock) + alignment - 1) / alignment * alignment;
+	meshUniforms.frameSize = meshUniforms.stride * meshes.size();
+	const uint32_t frameCount = std::max(framesInFlight, 1u);
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | additionalUsage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &meshUniforms.buffer, meshUniforms.frameSize * frameCount));
+	VK_CHECK_RESULT(meshUniforms.buffer.map());
+	for (size_t i = 0; i < meshes.size(); i++) {
+		Mesh *mesh = meshes[i];
+		const VkDeviceSize offset = meshUniforms.stride * i;
+		mesh->uniformBuffer.buffer = meshUniforms.buffer.buffer;
+		mesh->uniformBuffer.descriptor = { meshUniforms.buffer.buffer, offset, sizeof(Mesh::UniformBlock) };
+		mesh->uniformBuffer.mapped = static_cast<char*>(meshUniforms.buffer.mapped) + offset;
+		mesh->uniformBuffer.frameStride = (frameCount > 1) ? meshUniforms.frameSize : 0;
+		for (uint32_t frame = 0; frame < frameCount; frame++) {
+			memcpy(static_cast<char*>(mesh->uniformBuffer.mapped) + meshUniforms.frameSize * frame, &mesh->uniformBlock, sizeof(Mesh::UniformBlock));
+		}
+	}
+	meshUniforms.buffer.flush();
+}
+
+/*
+	Packs the constants of all materials into one buffer, every material's descriptor points at its own range
+	The constants don't change after loading, so the buffer is filled once
+*/
+void vkglTF::Model::prepareMaterialConstants()
+{
+	if (materials.empty()) {
+		return;
+	}
+	const VkDeviceSize alignment = device->properties.limits.minUniformBufferOffsetAlignment;
+	const VkDeviceSize stride = (sizeof(Material::Constants) + alignment - 1) / alignment * alignment;
+	std::vector<uint8_t> data(stride * materials.size());
+	for (size_t i = 0; i < materials.size(); i++) {
+		const Material::Constants constants = materials[i].getConstants();
+		memcpy(data.data() + stride * i, &constants, sizeof(Material::Constants));
+	}
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &materialConstants, data.size(), data.data()));
+	for (size_t i = 0; i < materials.size(); i++) {
+		materials[i].constantsDescriptor = { materialConstants.buffer, stride * i, sizeof(Material::Constants) };
+	}
+}
+
+/*
+	Flushes the shared uniform buffer ranges of the meshes of the given nodes in the copy of the current frame, neighbouring ranges are merged
+	All ranges go out with a single vkFlushMappedMemoryRanges call (together with the other ranges marked on the device so far), as the
+	animation update usually happens right before the submission
+*/
+void vkglTF::Model::flushMeshUniforms(const std::vector<Node*> &changedMeshNodes)
+{
+	std::vector<VkDeviceSize> offsets;
+	for (Node *node : changedMeshNodes) {
+		if (node->mesh->uniformBuffer.memory == VK_NULL_HANDLE) {
+			offsets.push_back(node->mesh->uniformBuffer.descriptor.offset + node->mesh->uniformBuffer.frameStride * currentFrame);
+		}
+	}
+	if (offsets.empty()) {
+		return;
+	}
+	std::sort(offsets.begin(), offsets.end());
+	VkDeviceSize rangeStart = offsets[0];
+	VkDeviceSize rangeEnd = offsets[0] + meshUniforms.stride;
+	for (size_t i = 1; i <= offsets.size(); i++) {
+		if ((i < offsets.size()) && (offsets[i] == rangeEnd)) {
+			rangeEnd += meshUniforms.stride;
+			continue;
+		}
+		meshUniforms.buffer.markDirty(rangeEnd - rangeStart, rangeStart);
+		if (i < offsets.size()) {
+			rangeStart = offsets[i];
+			rangeEnd = offsets[i] + meshUniforms.stride;
+		}
+	}
+	VK_CHECK_RESULT(device->flushMappedRanges());
+}
+
+/*
+	Creates the node and material descriptor buffers and writes the descriptors of all meshes that use the shared uniform buffer and all
+	materials with images, called by finishLoading for FileLoadingFlags::DescriptorBuffers
+	Returns false (and descriptor sets are used) if the functions of VK_EXT_descriptor_buffer or VK_KHR_buffer_device_address aren't available
+*/
+bool vkglTF::Model::prepareDescriptorBuffers()
+{
+	VkDevice logicalDevice = device->logicalDevice;
+	PFN_vkGetDescriptorSetLayoutSizeEXT vkGetDescriptorSetLayoutSizeEXT = reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(vkGetDeviceProcAddr(logicalDevice, "vkGetDescriptorSetLayoutSizeEXT"));
+	PFN_vkGetDescriptorSetLayoutBindingOffsetEXT vkGetDescriptorSetLayoutBindingOffsetEXT = reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(vkGetDeviceProcAddr(logicalDevice, "vkGetDescriptorSetLayoutBindingOffsetEXT"));
+	PFN_vkGetDescriptorEXT vkGetDescriptorEXT = reinterpret_cast<PFN_vkGetDescriptorEXT>(vkGetDeviceProcAddr(logicalDevice, "vkGetDescriptorEXT"));
+	descriptorBuffers.vkCmdBindDescriptorBuffersEXT = reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>(vkGetDeviceProcAddr(logicalDevice, "vkCmdBindDescriptorBuffersEXT"));
+	descriptorBuffers.vkCmdSetDescriptorBufferOffsetsEXT = reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>(vkGetDeviceProcAddr(logicalDevice, "vkCmdSetDescriptorBufferOffsetsEXT"));
+	if (!vkGetDescriptorSetLayoutSizeEXT || !vkGetDescriptorSetLayoutBindingOffsetEXT || !vkGetDescriptorEXT || !device->vkGetBufferDeviceAddressKHR || !descriptorBuffers.vkCmdBindDescriptorBuffersEXT || !descriptorBuffers.vkCmdSetDescriptorBufferOffsetsEXT) {
+		return false;
+	}
+
+	VkPhysicalDeviceDescriptorBufferPropertiesEXT descriptorBufferProperties{};
+	descriptorBufferProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT;
+	VkPhysicalDeviceProperties2 deviceProperties2{};
+	deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	deviceProperties2.pNext = &descriptorBufferProperties;
+	vkGetPhysicalDeviceProperties2(device->physicalDevice, &deviceProperties2);
+
+	// Same bindings as descriptorSetLayoutUbo and descriptorSetLayoutImage
+	std::vector<VkDescriptorSetLayoutBinding> nodeBindings = {
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+	};
+	std::vector<VkDescriptorSetLayoutBinding> materialBindings{};
+	if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
+		materialBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(materialBindings.size())));
+	}
+	if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
+		materialBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(materialBindings.size())));
+	}
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
+	descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descriptorLayoutCI.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+	descriptorLayoutCI.bindingCount = static_cast<uint32_t>(nodeBindings.size());
+	descriptorLayoutCI.pBindings = nodeBindings.data();
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(logicalDevice, &descriptorLayoutCI, nullptr, &descriptorBuffers.nodeLayout));
+	descriptorLayoutCI.bindingCount = static_cast<uint32_t>(materialBindings.size());
+	descriptorLayoutCI.pBindings = materialBindings.data();
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(logicalDevice, &descriptorLayoutCI, nullptr, &descriptorBuffers.materialLayout));
+
+	// Every node and material takes the size of its layout, rounded up to the offset alignment
+	const VkDeviceSize alignment = descriptorBufferProperties.descriptorBufferOffsetAlignment;
+	VkDeviceSize nodeStride = 0;
+	VkDeviceSize materialStride = 0;
+	vkGetDescriptorSetLayoutSizeEXT(logicalDevice, descriptorBuffers.nodeLayout, &nodeStride);
+	vkGetDescriptorSetLayoutSizeEXT(logicalDevice, descriptorBuffers.materialLayout, &materialStride);
+	nodeStride = std::max((nodeStride + alignment - 1) / alignment * alignment, alignment);
+	materialStride = std::max((materialStride + alignment - 1) / alignment * alignment, alignment);
+
+	std::vector<Mesh*> meshes;
+	for (Node *node : linearNodes) {
+		if (node->mesh && (node->mesh->uniformBuffer.memory == VK_NULL_HANDLE) && (node->mesh->uniformBuffer.buffer != VK_NULL_HANDLE)) {
+			meshes.push_back(node->mesh);
+		}
+	}
+	std::vector<Material*> imageMaterials;
+	for (auto& material : materials) {
+		if (material.baseColorTexture != nullptr) {
+			imageMaterials.push_back(&material);
+		}
+	}
+
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&descriptorBuffers.nodes,
+		nodeStride * std::max(meshes.size(), static_cast<size_t>(1)) * std::max(framesInFlight, 1u)));
+	// Combined image samplers need both usages
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&descriptorBuffers.materials,
+		materialStride * std::max(imageMaterials.size(), static_cast<size_t>(1))));
+	VK_CHECK_RESULT(descriptorBuffers.nodes.map());
+	VK_CHECK_RESULT(descriptorBuffers.materials.map());
+
+	descriptorBuffers.nodesAddress = descriptorBuffers.nodes.getDeviceAddress();
+	descriptorBuffers.materialsAddress = descriptorBuffers.materials.getDeviceAddress();
+
+	// Node uniform blocks are ranges of the shared mesh uniform buffer, the descriptors of each frame copy follow the ones of the previous frame
+	descriptorBuffers.nodesFrameSize = nodeStride * meshes.size();
+	if (!meshes.empty()) {
+		VkDeviceSize bindingOffset = 0;
+		vkGetDescriptorSetLayoutBindingOffsetEXT(logicalDevice, descriptorBuffers.nodeLayout, 0, &bindingOffset);
+		const VkDeviceAddress uniformsAddress = meshUniforms.buffer.getDeviceAddress();
+		for (uint32_t frame = 0; frame < std::max(framesInFlight, 1u); frame++) {
+			for (size_t i = 0; i < meshes.size(); i++) {
+				Mesh *mesh = meshes[i];
+				mesh->uniformBuffer.descriptorOffset = nodeStride * i;
+				VkDescriptorAddressInfoEXT addressInfo{};
+				addressInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT;
+				addressInfo.address = uniformsAddress + mesh->uniformBuffer.descriptor.offset + mesh->uniformBuffer.frameStride * frame;
+				addressInfo.range = mesh->uniformBuffer.descriptor.range;
+				addressInfo.format = VK_FORMAT_UNDEFINED;
+				VkDescriptorGetInfoEXT descriptorInfo{};
+				descriptorInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+				descriptorInfo.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				descriptorInfo.data.pUniformBuffer = &addressInfo;
+				vkGetDescriptorEXT(logicalDevice, &descriptorInfo, descriptorBufferProperties.uniformBufferDescriptorSize, static_cast<char*>(descriptorBuffers.nodes.mapped) + descriptorBuffers.nodesFrameSize * frame + mesh->uniformBuffer.descriptorOffset + bindingOffset);
+			}
+		}
+	}
+
+	// Material images in the binding order of descriptorSetLayoutImage
+	std::vector<VkDeviceSize> bindingOffsets(materialBindings.size());
+	for (uint32_t i = 0; i < static_cast<uint32_t>(materialBindings.size()); i++) {
+		vkGetDescriptorSetLayoutBindingOffsetEXT(logicalDevice, descriptorBuffers.materialLayout, i, &bindingOffsets[i]);
+	}
+	const size_t imageDescriptorSize = descriptorBufferProperties.combinedImageSamplerDescriptorSize;
+	for (size_t i = 0; i < imageMaterials.size(); i++) {
+		Material *material = imageMaterials[i];
+		material->descriptorOffset = materialStride * i;
+		char *target = static_cast<char*>(descriptorBuffers.materials.mapped) + material->descriptorOffset;
+		uint32_t binding = 0;
+		if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
+			material->baseColorTexture->getDescriptorEXT(vkGetDescriptorEXT, imageDescriptorSize, target + bindingOffsets[binding++]);
+		}
+		if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
+			if (material->normalTexture) {
+				material->normalTexture->getDescriptorEXT(vkGetDescriptorEXT, imageDescriptorSize, target + bindingOffsets[binding]);
+			}
+			binding++;
+		}
+	}
+
+	descriptorBuffers.prepared = true;
+	return true;
+}
+
+/*
+	Binds the node (buffer index 0) and material (buffer index 1) descriptor buffers for draws with RenderFlags::UseDescriptorBuffers
+	Replaces all descriptor buffers bound to the command buffer, so descriptor buffers of the application have to go into the same call
+*/
+void vkglTF::Model::bindDescriptorBuffers(VkCommandBuffer commandBuffer)
+{
+	assert(descriptorBuffers.prepared);
+	VkDescriptorBufferBindingInfoEXT bindingInfos[2]{};
+	bindingInfos[0].sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
+	bindingInfos[0].address = descriptorBuffers.nodesAddress;
+	bindingInfos[0].usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT;
+	bindingInfos[1].sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
+	bindingInfos[1].address = descriptorBuffers.materialsAddress;
+	bindingInfos[1].usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT;
+	descriptorBuffers.vkCmdBindDescriptorBuffersEXT(commandBuffer, 2, bindingInfos);
+}
+
+/*
+	Creates the push descriptor layout for the material images and gets vkCmdPushDescriptorSetKHR for draws with RenderFlags::UsePushDescriptors
+	Returns false if VK_KHR_push_descriptor hasn't been enabled, the model has to be drawn with descriptor sets then
+*/
+bool vkglTF::Model::preparePushDescriptors()
+{
+	if (pushDescriptors.prepared) {
+		return true;
+	}
+	// The extension's functions are only returned if it has been enabled on the device
+	pushDescriptors.vkCmdPushDescriptorSetKHR = reinterpret_cast<PFN_vkCmdPushDescriptorSetKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdPushDescriptorSetKHR"));
+	if (!pushDescriptors.vkCmdPushDescriptorSetKHR) {
+		return false;
+	}
+	// Same bindings as descriptorSetLayoutImage
+	std::vector<VkDescriptorSetLayoutBinding> materialBindings{};
+	if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
+		materialBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(materialBindings.size())));
+	}
+	if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
+		materialBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, static_cast<uint32_t>(materialBindings.size())));
+	}
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
+	descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descriptorLayoutCI.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+	descriptorLayoutCI.bindingCount = static_cast<uint32_t>(materialBindings.size());
+	descriptorLayoutCI.pBindings = materialBindings.data();
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &pushDescriptors.materialLayout));
+	pushDescriptors.prepared = true;
+	return true;
+}
+
+/*
+	Records the material's image descriptors into the command buffer, the image descriptors are copied at record time
+	Materials without a base color texture have no image set, like with descriptor sets nothing is pushed for them
+*/
+void vkglTF::Model::pushMaterialDescriptors(VkCommandBuffer commandBuffer, const Material& material, VkPipelineLayout pipelineLayout, uint32_t set)
+{
+	assert(pushDescriptors.prepared);
+	if (material.baseColorTexture == nullptr) {
+		return;
+	}
+	VkWriteDescriptorSet writeDescriptorSets[2];
+	const uint32_t writeCount = material.getDescriptorWrites(VK_NULL_HANDLE, descriptorBindingFlags, writeDescriptorSets);
+	pushDescriptors.vkCmdPushDescriptorSetKHR(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, set, writeCount, writeDescriptorSets);
+}
+
+/*
+	Describe the vertex layout of the model for vertex pulling and get the device address of its vertex buffer, see Model::VertexPulling
+	Leaves vertexPulling unprepared if the bufferDeviceAddress feature isn't available
+*/
+void vkglTF::Model::prepareVertexPulling()
+{
+	if (vertices.deviceAddress == 0) {
+		std::cerr << "Vertex pulling requires the bufferDeviceAddress feature\n";
+		return;
+	}
+
+	VertexFetch &fetch = vertexPulling.fetch;
+	fetch.vertices = vertices.deviceAddress;
+	fetch.stride = vertexLayout.stride;
+	fetch.formats = 0;
+	for (uint32_t i = 0; i < 7; i++) {
+		VkFormat format = vertexLayout.formats[i];
+		uint32_t offset = vertexLayout.offsets[i];
+		if (!vertexLayout.compact) {
+			const VkVertexInputAttributeDescription attribute = Vertex::inputAttributeDescription(0, 0, static_cast<VertexComponent>(i));
+			format = attribute.format;
+			offset = attribute.offset;
+		}
+		// The shaders read 32 bit words
+		assert(offset % 4 == 0);
+		fetch.offsets[i] = offset;
+		fetch.formats |= static_cast<uint32_t>(vertexFetchFormat(format)) << (i * 4);
+	}
+	vertexPulling.prepared = true;
+}
+
+/*
+	Bind the index buffer and push the vertex fetch block for draws with RenderFlags::PullVertices
+*/
+void vkglTF::Model::bindVertexFetch(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+{
+	assert(vertexPulling.prepared && (pipelineLayout != VK_NULL_HANDLE));
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, vertexPulling.pushConstantStages, vertexPulling.pushConstantOffset, sizeof(VertexFetch), &vertexPulling.fetch);
+}
+
+/*
+	Device addresses of the model's buffers for a root push constant block, see Model::SceneAddresses
+	Addresses of buffers that don't exist or weren't created with device address usage are 0
+*/
+vkglTF::Model::SceneAddresses vkglTF::Model::getSceneAddresses() const
+{
+	SceneAddresses addresses{};
+	addresses.vertices = vertices.deviceAddress;
+	addresses.indices = indices.deviceAddress;
+	addresses.materials = bindless.materials.deviceAddress;
+	addresses.transforms = indirect.transforms.deviceAddress;
+	addresses.drawData = indirect.drawData.deviceAddress;
+	return addresses;
+}
+
+/*
+	Registers the textures owning their image with a memory defragmenter, so they can be moved out of sparsely used memory blocks
+	Models with bindless or descriptor buffer materials aren't registered, as these hold copies of the texture descriptors, and neither are models
+	with lazily loaded images still pending. Returns the number of textures registered
+*/
+uint32_t vkglTF::Model::registerDefragmentation(vks::MemoryDefragmenter *defragmenter)
+{
+	unregisterDefragmentation();
+	if (bindless.prepared || descriptorBuffers.prepared || hasPendingImages()) {
+		return 0;
+	}
+	defragmentation.defragmenter = defragmenter;
+	for (Texture &texture : textures) {
+		if ((texture.textureArray >= 0) || (texture.allocation.memory == VK_NULL_HANDLE) || !(texture.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+			continue;
+		}
+		vks::MemoryDefragmenter::MovableImage image;
+		image.image = &texture.image;
+		image.view = &texture.view;
+		image.memory = &texture.deviceMemory;
+		image.allocation = &texture.allocation;
+		image.layout = texture.imageLayout;
+		image.imageCreateInfo = vks::initializers::imageCreateInfo();
+		image.imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		image.imageCreateInfo.format = texture.format;
+		image.imageCreateInfo.mipLevels = texture.mipLevels;
+		image.imageCreateInfo.arrayLayers = texture.layerCount;
+		image.imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		image.imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image.imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		image.imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		image.imageCreateInfo.extent = { texture.width, texture.height, 1 };
+		image.imageCreateInfo.usage = texture.usage;
+		// Same view as createView()
+		image.viewCreateInfo = vks::initializers::imageViewCreateInfo();
+		image.viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		image.viewCreateInfo.format = texture.format;
+		image.viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, texture.arrayLayer, 1 };
+		Texture *movedTexture = &texture;
+		image.moved = [this, movedTexture]() {
+			movedTexture->updateDescriptor();
+			for (Material &material : materials) {
+				if ((material.descriptorSet == VK_NULL_HANDLE) || ((material.baseColorTexture != movedTexture) && (material.normalTexture != movedTexture))) {
+					continue;
+				}
+				VkWriteDescriptorSet writeDescriptorSets[2];
+				const uint32_t writeCount = material.getDescriptorWrites(material.descriptorSet, descriptorBindingFlags, writeDescriptorSets);
+				vkUpdateDescriptorSets(device->logicalDevice, writeCount, writeDescriptorSets, 0, nullptr);
+			}
+		};
+		const uint32_t handle = defragmenter->registerImage(image);
+		if (handle != 0) {
+			defragmentation.handles.push_back(handle);
+		}
+	}
+	return static_cast<uint32_t>(defragmentation.handles.size());
+}
+
+void vkglTF::Model::unregisterDefragmentation()
+{
+	if (defragmentation.defragmenter) {
+		for (uint32_t handle : defragmentation.handles) {
+			defragmentation.defragmenter->unregister(handle);
+		}
+	}
+	defragmentation.defragmenter = nullptr;
+	defragmentation.handles.clear();
+}
+
+/*
+	Approximate device memory used by the model: its geometry (unless it's in a geometry pool), texture images and the largest per-model buffers
+	Sizes are the memory requirements of the resources, so sub-allocation padding and descriptor pools aren't included
+*/
+VkDeviceSize vkglTF::Model::getDeviceMemorySize() const
+{
+	VkDeviceSize size = 0;
+	if (!geometryPoolRange.pool) {
+		VkMemoryRequirements memReqs;
+		if (vertices.buffer != VK_NULL_HANDLE) {
+			vkGetBufferMemoryRequirements(device->logicalDevice, vertices.buffer, &memReqs);
+			size += memReqs.size;
+		}
+		if (indices.buffer != VK_NULL_HANDLE) {
+			vkGetBufferMemoryRequirements(device->logicalDevice, indices.buffer, &memReqs);
+			size += memReqs.size;
+		}
+	}
+	for (const Texture &texture : textures) {
+		if ((texture.image != VK_NULL_HANDLE) && (texture.textureArray < 0)) {
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device->logicalDevice, texture.image, &memReqs);
+			size += memReqs.size;
+		}
+	}
+	for (const TextureArray &textureArray : textureArrays) {
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device->logicalDevice, textureArray.image, &memReqs);
+		size += memReqs.size;
+	}
+	const vks::Buffer *buffers[] = { &positions, &morphTargets.deltas, &meshUniforms.buffer, &meshlets.meshlets, &meshlets.vertices, &meshlets.triangles, &indirect.transforms, &indirect.drawData, &bindless.materials };
+	for (const vks::Buffer *buffer : buffers) {
+		size += buffer->size;
+	}
+	return size;
+}
@@ -12,9 +12,13 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <future>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanOcclusionCuller.h"
+#include "VulkanMemoryDefragmenter.h"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
@@ -35,17 +39,52 @@
 #include <android/asset_manager.h>
 #endif
 
+namespace vks
+{
+	class ThreadPool;
+	class MipGenerator;
+	class GeometryPool;
+	class TextureCompressor;
+	struct CompressedImage;
+}
+
 namespace vkglTF
 {
 	enum DescriptorBindingFlags {
 		ImageBaseColor = 0x00000001,
-		ImageNormalMap = 0x00000002
+		ImageNormalMap = 0x00000002,
+		// Material::Constants in the binding following the images, only for material descriptor sets (not with descriptor buffers or push descriptors)
+		MaterialConstants = 0x00000004
 	};
 
 	extern VkDescriptorSetLayout descriptorSetLayoutImage;
 	extern VkDescriptorSetLayout descriptorSetLayoutUbo;
 	extern VkMemoryPropertyFlags memoryPropertyFlags;
 	extern uint32_t descriptorBindingFlags;
+	/*
+		Store the material constants of DescriptorBindingFlags::MaterialConstants as inline uniform blocks in the material sets instead of ranges of a uniform buffer
+		Requires VK_EXT_inline_uniform_block (core in Vulkan 1.3) with the inlineUniformBlock feature enabled, shaders declare the same uniform block for both
+	*/
+	extern bool inlineMaterialConstants;
+	/* Optional compute mip generator used instead of image blits for textures loaded from jpg and png files */
+	extern vks::MipGenerator *mipGenerator;
+	/* Compute block compressor for textures loaded from jpg and png files with FileLoadingFlags::CompressTextures, images stay uncompressed while it isn't set or supported */
+	extern vks::TextureCompressor *textureCompressor;
+	/*
+		Optional geometry pool the vertices and indices of models finishing their load while it is set are sub-allocated from, so one buffer binding
+		serves the draws of all of them. The pool needs the buffer usage of the models' loading flags (e.g. storage and device address usage for
+		vertex pulling) and must outlive the models. Indices are rebased to the model's range, so models whose vertices are processed outside of
+		the draw functions (compute skinning, ray tracing geometry) must not be loaded into a pool. Models with separate positions keep buffers of their own.
+	*/
+	extern vks::GeometryPool *geometryPool;
+	/* Number of levels of detail (including the full detail level) and the maximum simplification error relative to the size of a primitive for FileLoadingFlags::GenerateLods */
+	extern uint32_t lodLevelCount;
+	extern float lodTargetError;
+	/* Frames per second animations are resampled at and the maximum error of the removed keys (in node units, or quaternion components for rotations) for FileLoadingFlags::CompactAnimations */
+	extern float animationFrameRate;
+	extern float animationTolerance;
+	/* Largest width or height of the images grouped into texture arrays with FileLoadingFlags::TextureArrays */
+	extern uint32_t textureArrayMaxSize;
 
 	struct Node;
 
@@ -57,15 +96,26 @@ namespace vkglTF
 		VkImage image;
 		VkImageLayout imageLayout;
 		VkDeviceMemory deviceMemory;
+		vks::MemoryAllocation allocation;
 		VkImageView view;
 		uint32_t width, height;
 		uint32_t mipLevels;
 		uint32_t layerCount;
 		VkDescriptorImageInfo descriptor;
+		// Shared through the device's sampler cache, released by destroy()
 		VkSampler sampler;
+		// Index of the entry in Model::textureArrays whose image the texture is a layer of, -1 if the texture owns its image
+		int32_t textureArray = -1;
+		uint32_t arrayLayer = 0;
+		// Format of the view and usage the image has been created with, images with transfer source usage can be moved by a memory defragmenter
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkImageUsageFlags usage = 0;
 		void updateDescriptor();
+		void getDescriptorEXT(PFN_vkGetDescriptorEXT vkGetDescriptorEXT, size_t descriptorSize, void* target) const;
 		void destroy();
+		void createView(VkFormat format);
 		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue);
+		void fromCompressedImage(const vks::CompressedImage& compressedImage, vks::VulkanDevice* device, VkQueue copyQueue);
 	};
 
 	/*
@@ -76,6 +126,7 @@ namespace vkglTF
 		enum AlphaMode { ALPHAMODE_OPAQUE, ALPHAMODE_MASK, ALPHAMODE_BLEND };
 		AlphaMode alphaMode = ALPHAMODE_OPAQUE;
 		float alphaCutoff = 1.0f;
+		bool doubleSided = false;
 		float metallicFactor = 1.0f;
 		float roughnessFactor = 1.0f;
 		glm::vec4 baseColorFactor = glm::vec4(1.0f);
@@ -85,13 +136,30 @@ namespace vkglTF
 		vkglTF::Texture* occlusionTexture = nullptr;
 		vkglTF::Texture* emissiveTexture = nullptr;
 
-		vkglTF::Texture* specularGlossinessTexture;
-		vkglTF::Texture* diffuseTexture;
+		vkglTF::Texture* specularGlossinessTexture = nullptr;
+		vkglTF::Texture* diffuseTexture = nullptr;
+
+		// Uniform block of DescriptorBindingFlags::MaterialConstants (std140)
+		struct Constants {
+			glm::vec4 baseColorFactor;
+			float metallicFactor;
+			float roughnessFactor;
+			float alphaCutoff;
+			uint32_t alphaMode;
+		};
+		// Range of the model's material constants buffer, unused with inline uniform blocks
+		VkDescriptorBufferInfo constantsDescriptor{};
 
 		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		// Offset of the material's descriptors in the model's material descriptor buffer (see Model::DescriptorBuffers)
+		VkDeviceSize descriptorOffset = 0;
+		// Pipeline bound for the material's primitives with RenderFlags::BindMaterialPipelines (see vkglTF::PipelinePermutations)
+		VkPipeline pipeline = VK_NULL_HANDLE;
 
 		Material(vks::VulkanDevice* device) : device(device) {};
-		void createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
+		void createDescriptorSet(vks::DescriptorAllocator* descriptorAllocator, uint32_t layoutClass, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
+		Constants getConstants() const;
+		uint32_t getDescriptorWrites(VkDescriptorSet dstSet, uint32_t descriptorBindingFlags, VkWriteDescriptorSet* writeDescriptorSets) const;
 	};
 
 	/*
@@ -112,10 +180,43 @@ namespace vkglTF
 			float radius;
 		} dimensions;
 
+		// Levels of detail generated with FileLoadingFlags::GenerateLods, the first one is the primitive itself
+		// Each level is a range of the index buffer using the primitive's vertices, error is the simplification error in model units
+		struct Lod {
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float error;
+		};
+		std::vector<Lod> lods;
+
+		// Meshlets of the full detail level generated with FileLoadingFlags::GenerateMeshlets, a range of the model's meshlets
+		uint32_t firstMeshlet = 0;
+		uint32_t meshletCount = 0;
+
+		// Morph targets of the primitive in the order of the node's morph weights, each a range of the model's sparse deltas (see Model::MorphTargets)
+		struct MorphTarget {
+			uint32_t firstDelta;
+			uint32_t deltaCount;
+		};
+		std::vector<MorphTarget> morphTargets;
+
 		void setDimensions(glm::vec3 min, glm::vec3 max);
+		uint32_t selectLod(float distance, float errorPerDistance) const;
 		Primitive(uint32_t firstIndex, uint32_t indexCount, Material& material) : firstIndex(firstIndex), indexCount(indexCount), material(material) {};
 	};
 
+	/*
+		Morph target displacement of a single vertex, targets only store the vertices they move
+		Matches the layout of the deltas read by the "base/morphtargets.comp" shader
+	*/
+	struct MorphDelta {
+		// Vertex index relative to the primitive's first vertex
+		uint32_t vertex;
+		float position[3];
+		float normal[3];
+		float tangent[3];
+	};
+
 	/*
 		glTF mesh
 	*/
@@ -125,21 +226,34 @@ namespace vkglTF
 		std::vector<Primitive*> primitives;
 		std::string name;
 
+		// Meshes loaded with a file use a range of the model's shared mesh uniform buffer (see Model::MeshUniforms), others own their buffer
 		struct UniformBuffer {
-			VkBuffer buffer;
-			VkDeviceMemory memory;
-			VkDescriptorBufferInfo descriptor;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			// Range of the first frame's copy of the uniform block
+			VkDescriptorBufferInfo descriptor{};
+			// Set of the first frame's copy, same as descriptorSets[0]
 			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-			void* mapped;
+			// Sets of all frame copies of the uniform block (see Model::framesInFlight), indexed by the frame
+			std::vector<VkDescriptorSet> descriptorSets;
+			void* mapped = nullptr;
+			// Distance between the frame copies in the model's shared buffer, 0 for meshes with a single copy
+			VkDeviceSize frameStride = 0;
+			// Offset of the first frame's node descriptor in the model's node descriptor buffer (see Model::DescriptorBuffers)
+			VkDeviceSize descriptorOffset = 0;
 		} uniformBuffer;
+		// Number of frame copies that still hold the matrices from before the last change, written by the next Model::updateNodes() passes
+		uint32_t pendingFrames = 0;
 
+		// Size of the joint palette in the uniform block, joints of larger skins are ignored
+		static const uint32_t maxJointCount = 64;
 		struct UniformBlock {
 			glm::mat4 matrix;
-			glm::mat4 jointMatrix[64]{};
+			glm::mat4 jointMatrix[maxJointCount]{};
 			float jointcount{ 0 };
 		} uniformBlock;
 
-		Mesh(vks::VulkanDevice* device, glm::mat4 matrix);
+		Mesh(vks::VulkanDevice* device, glm::mat4 matrix, bool createBuffer = true);
 		~Mesh();
 	};
 
@@ -168,9 +282,20 @@ namespace vkglTF
 		glm::vec3 translation{};
 		glm::vec3 scale{ 1.0f };
 		glm::quat rotation{};
+		// World matrix cached by Model::updateNodes(), dirty has to be set when the local transform changes
+		glm::mat4 worldMatrix{ 1.0f };
+		bool dirty = true;
+		// Set if the world matrix changed in the last Model::updateNodes() pass
+		bool worldChanged = false;
+		// Set by Model::cullOccluded() if the node's mesh is hidden, drawNode() skips the mesh (but not the children)
+		bool occluded = false;
+		// Transforms of the mesh instances relative to the node from EXT_mesh_gpu_instancing, empty if the node has a single instance
+		std::vector<glm::mat4> instanceMatrices;
+		// Morph target weights of the node's mesh (the node's weights, or the mesh's default weights), animated by weights channels
+		std::vector<float> morphWeights;
 		glm::mat4 localMatrix();
 		glm::mat4 getMatrix();
-		void update();
+		void update(uint32_t frameIndex = 0);
 		~Node();
 	};
 
@@ -178,10 +303,12 @@ namespace vkglTF
 		glTF animation channel
 	*/
 	struct AnimationChannel {
-		enum PathType { TRANSLATION, ROTATION, SCALE };
+		enum PathType { TRANSLATION, ROTATION, SCALE, WEIGHTS };
 		PathType path;
 		Node* node;
 		uint32_t samplerIndex;
+		// Key found by the last lookup, playback usually stays in the same interval or moves to the next one
+		uint32_t key = 0;
 	};
 
 	/*
@@ -192,6 +319,34 @@ namespace vkglTF
 		InterpolationType interpolation;
 		std::vector<float> inputs;
 		std::vector<glm::vec4> outputsVec4;
+		// Scalar outputs of weights channels, one morph weight per target and key (with in- and out-tangents for cubic splines)
+		std::vector<float> outputs;
+		/*
+			Uniformly resampled track replacing the inputs and outputs of translation, rotation and scale samplers, see FileLoadingFlags::CompactAnimations
+			The sampler is evaluated at animationFrameRate frames per second and every frame whose value is reproduced within animationTolerance by
+			interpolating between the frames kept around it is removed. Rotations are stored as smallest-three quaternions in 48 bits, translations
+			and scales as vec3. frameKeys maps every frame of the track to the key starting its interval, so sampling costs O(1) at any time.
+		*/
+		struct PackedQuaternion {
+			// Two bits of the largest component's index in the high bits of the first two values, the other three components in 15 bits each
+			uint16_t data[3];
+		};
+		struct CompactTrack {
+			float start = 0.0f;
+			float frameRate = 0.0f;
+			uint32_t frameCount = 0;
+			// Frame of each key
+			std::vector<uint16_t> keyFrames;
+			// Key starting the interval of each frame
+			std::vector<uint16_t> frameKeys;
+			// Keys of rotation tracks
+			std::vector<PackedQuaternion> rotations;
+			// Keys of translation and scale tracks
+			std::vector<glm::vec3> values;
+			bool empty() const { return keyFrames.empty(); }
+			bool sample(float time, glm::vec4& value) const;
+		} compactTrack;
+		bool findKey(float time, uint32_t& key) const;
 	};
 
 	/*
@@ -233,14 +388,72 @@ namespace vkglTF
 		PreTransformVertices = 0x00000001,
 		PreMultiplyVertexColors = 0x00000002,
 		FlipY = 0x00000004,
-		DontLoadImages = 0x00000008
+		DontLoadImages = 0x00000008,
+		// Store the processed model in an on-disk cache next to the glTF file (<file>.cache) and load from it while the source files are unchanged
+		UseCache = 0x00000010,
+		// Upload the vertices in a quantized layout chosen per model (see Model::VertexLayout), pipelines need to use the model's vertex input state
+		CompactVertices = 0x00000020,
+		// Also upload a tightly packed stream of vertex positions for depth only passes, see RenderFlags::PositionsOnly
+		SeparatePositions = 0x00000040,
+		// Reorder the triangles and vertices of each primitive for the post-transform cache, overdraw and vertex fetch, stored in the cache with UseCache
+		OptimizeMeshes = 0x00000080,
+		// Generate simplified index buffers per primitive (see lodLevelCount and Primitive::lods), stored in the cache with UseCache
+		GenerateLods = 0x00000100,
+		// Split each primitive into meshlets for mesh shader rendering (see Model::prepareMeshlets()), stored in the cache with UseCache
+		GenerateMeshlets = 0x00000200,
+		// Write the node and material descriptors into descriptor buffers instead of allocating descriptor sets (see Model::DescriptorBuffers)
+		// Requires VK_EXT_descriptor_buffer and the bufferDeviceAddress feature to be enabled, descriptor sets are used if the extension isn't
+		DescriptorBuffers = 0x00000400,
+		// Keep a copy of the vertices and indices on the host after the upload (see Model::hostGeometry), e.g. for building BVHs on the CPU
+		KeepHostGeometry = 0x00000800,
+		// Don't allocate node and material descriptor sets, the model is only drawn with RenderFlags::UsePushDescriptors (see Model::PushDescriptors)
+		// Requires VK_KHR_push_descriptor to be enabled, descriptor sets are used if the extension isn't
+		PushDescriptors = 0x00001000,
+		// Also allow shaders to read the vertex buffer through its device address, for draws with RenderFlags::PullVertices (see Model::VertexPulling)
+		// Requires the bufferDeviceAddress feature to be enabled
+		VertexPulling = 0x00002000,
+		// Create the vertex and index buffers with storage and device address usage, for shaders reading them by address (see Model::SceneAddresses)
+		// Requires the bufferDeviceAddress feature to be enabled
+		DeviceAddresses = 0x00004000,
+		// Merge the primitives of all nodes sharing a material into one index range per material, drawn with Model::drawStaticBatches()
+		// Only applied together with PreTransformVertices, as the node transforms need to be baked into the vertices (see Model::StaticBatching)
+		StaticBatching = 0x00008000,
+		// Resample the translation, rotation and scale animation samplers into compact fixed-rate tracks with quantized rotations (see AnimationSampler::CompactTrack)
+		// The cache stores the source keys, weights and step samplers are kept as they are
+		CompactAnimations = 0x00010000,
+		// Upload decoded images of the same size (up to textureArrayMaxSize) as the layers of shared array images (see Model::TextureArray)
+		// Each texture keeps a 2D view of its layer, so material descriptors and shaders are unchanged
+		TextureArrays = 0x00020000,
+		// Decode the images on a background thread after finishLoading, materials sample placeholder textures until Model::updateLazyImages() swaps them in
+		// Ignored with DontLoadImages or DescriptorBuffers (see Model::LazyImages)
+		LazyImages = 0x00040000,
+		// Generate MikkTSpace style tangents for triangle list primitives with normals and texture coordinates but without a TANGENT attribute,
+		// stored in the cache with UseCache. Vertices shared by triangles with mirrored texture coordinates are split (except with morph targets)
+		GenerateTangents = 0x00080000,
+		// Block compress decoded 8 bit images with vkglTF::textureCompressor (BC on desktop, ETC2 on mobile devices), the load queue needs to support compute
+		// With UseCache the compressed images are stored in texture cache files next to the source images (<image>.texcache) and loaded instead of decoding them
+		// Compressed images aren't grouped with TextureArrays
+		CompressTextures = 0x00100000
 	};
 
 	enum RenderFlags {
 		BindImages = 0x00000001,
 		RenderOpaqueNodes = 0x00000002,
 		RenderAlphaMaskedNodes = 0x00000004,
-		RenderAlphaBlendedNodes = 0x00000008
+		RenderAlphaBlendedNodes = 0x00000008,
+		// Bind the position stream instead of the full vertices, for pipelines created with Model::getPositionInputState()
+		PositionsOnly = 0x00000010,
+		// Select materials (with BindImages) and nodes (at DescriptorBuffers::nodeSet) by descriptor buffer offsets instead of binding descriptor sets
+		// The model's descriptor buffers need to be bound with Model::bindDescriptorBuffers() first
+		UseDescriptorBuffers = 0x00000020,
+		// Bind the pipeline of each primitive's material (Material::pipeline) if it differs from the last one bound by the same draw call
+		BindMaterialPipelines = 0x00000040,
+		// Push the node data as push constants and the material images (with BindImages) with vkCmdPushDescriptorSetKHR instead of binding descriptor sets
+		// The model's push descriptors need to be prepared with Model::preparePushDescriptors() first
+		UsePushDescriptors = 0x00000080,
+		// Only bind the index buffer and push the model's vertex layout and vertex buffer address for shaders fetching the vertices themselves
+		// The model needs to be loaded with FileLoadingFlags::VertexPulling, pipelines don't declare any vertex input (see Model::VertexPulling)
+		PullVertices = 0x00000100
 	};
 
 	/*
@@ -248,30 +461,99 @@ namespace vkglTF
 	*/
 	class Model {
 	private:
+		// Intermediate data of a load that is passed from the CPU stage (parseFile) to the GPU upload stage (finishLoading)
+		struct LoadState;
+		LoadState* loadState = nullptr;
 		vkglTF::Texture* getTexture(uint32_t index);
 		vkglTF::Texture emptyTexture;
 		void createEmptyTexture(VkQueue transferQueue);
+		void createSolidTexture(vkglTF::Texture& texture, uint32_t color, VkQueue transferQueue);
+		void parseFile(std::string filename, uint32_t fileLoadingFlags, float scale, vks::ThreadPool* threadPool);
+		void decodeImages(LoadState& state, vks::ThreadPool* threadPool);
+		bool loadFromCache(const std::string& filename, float scale, vks::ThreadPool* threadPool);
+		void writeCache(const std::string& filename, float scale);
+		void discardCachedLoad();
+		void buildStaticBatches(const uint32_t* indexData, size_t indexCount, std::vector<uint32_t>& batchedIndices);
+		void packVertices(const Vertex* vertexData, size_t vertexCount, std::vector<uint8_t>& packed);
+		void flushMeshUniforms(const std::vector<Node*>& changedMeshNodes);
+		bool prepareDescriptorBuffers();
+		void pushMaterialDescriptors(VkCommandBuffer commandBuffer, const Material& material, VkPipelineLayout pipelineLayout, uint32_t set);
+		void prepareMeshDescriptor(vkglTF::Mesh* mesh, VkDescriptorSetLayout descriptorSetLayout);
+		void prepareVertexPulling();
+		void bindVertexFetch(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
 	public:
 		vks::VulkanDevice* device;
-		VkDescriptorPool descriptorPool;
+		// Node and material sets, the pools grow for nodes loaded after the model has been set up
+		vks::DescriptorAllocator* descriptorAllocator = nullptr;
+		struct DescriptorLayoutClasses {
+			uint32_t nodes = 0;
+			uint32_t materials = 0;
+		} descriptorLayoutClasses;
 
 		struct Vertices {
 			int count;
-			VkBuffer buffer;
-			VkDeviceMemory memory;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			// Only set if the buffer has been created with device address usage (FileLoadingFlags::VertexPulling or DeviceAddresses)
+			VkDeviceAddress deviceAddress = 0;
 		} vertices;
 		struct Indices {
 			int count;
-			VkBuffer buffer;
-			VkDeviceMemory memory;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			// Only set if the buffer has been created with device address usage (FileLoadingFlags::DeviceAddresses)
+			VkDeviceAddress deviceAddress = 0;
 		} indices;
 
 		std::vector<Node*> nodes;
 		std::vector<Node*> linearNodes;
+		// All nodes with parents before their children, the order of the top-down world matrix pass
+		std::vector<Node*> flattenedNodes;
 
 		std::vector<Skin*> skins;
 
 		std::vector<Texture> textures;
+		/*
+			Array image shared by the textures of same-size images, loaded with FileLoadingFlags::TextureArrays
+			All layers are uploaded through one staging buffer, live in one allocation and get their mip chains in one pass
+		*/
+		struct TextureArray {
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
+			vks::MemoryAllocation allocation;
+			// View of all layers, for shaders sampling the textures through one sampler2DArray descriptor
+			VkImageView view = VK_NULL_HANDLE;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t mipLevels = 0;
+			uint32_t layerCount = 0;
+		};
+		std::vector<TextureArray> textureArrays;
+		/*
+			Images loaded with FileLoadingFlags::LazyImages
+			finishLoading uploads two 1x1 placeholders and points the descriptors of all textures at them, so the model can be drawn right away.
+			The images are then decoded on a background thread, updateLazyImages() uploads them once decoding has finished and allocates new
+			material descriptor sets, so sets used by command buffers still in flight aren't changed. Command buffers need to be rebuilt afterwards.
+			Descriptors copied from the textures before the swap (e.g. by prepareBindless()) keep referencing the placeholders
+		*/
+		struct LazyImages {
+			// Load state kept alive for the decoding thread, only the glTF images and the mapped files are still used
+			LoadState* state = nullptr;
+			// Shared, so models stay copyable
+			std::shared_future<void> decoding;
+			// Mid grey for color textures and a flat normal for normal maps
+			Texture colorPlaceholder;
+			Texture normalPlaceholder;
+		} lazyImages;
+		/*
+			Textures registered with a memory defragmenter by registerDefragmentation(), unregistered by unregisterDefragmentation() or the destructor
+			Only textures owning an image with transfer source usage are registered (images decoded with stb_image, not texture array layers, ktx
+			or compressed images). When a texture has been moved, the image descriptors of the material descriptor sets using it are rewritten.
+		*/
+		struct Defragmentation {
+			vks::MemoryDefragmenter* defragmenter = nullptr;
+			std::vector<uint32_t> handles;
+		} defragmentation;
 		std::vector<Material> materials;
 		std::vector<Animation> animations;
 
@@ -284,9 +566,364 @@ namespace vkglTF
 		} dimensions;
 
 		bool metallicRoughnessWorkflow = true;
+		// Set for models in a geometry pool (without compact vertices), the pool's buffers are bound once with GeometryPool::bind() or bindBuffers()
 		bool buffersBound = false;
+
+		/*
+			Range of the model in vkglTF::geometryPool if it was set when the model finished loading, vertices and indices then point to the pool's buffers
+			The index values include firstVertex and the primitives' (and LODs') first indices include firstIndex, so draws don't need a vertex offset
+		*/
+		struct GeometryPoolRange {
+			vks::GeometryPool *pool = nullptr;
+			uint32_t firstVertex = 0;
+			uint32_t firstIndex = 0;
+		} geometryPoolRange;
 		std::string path;
 
+		/*
+			Layout of the vertex buffer, the full vkglTF::Vertex unless the model is loaded with FileLoadingFlags::CompactVertices
+			A compact vertex stores the position as floats, normal and tangent as snorm16x4, uv as half floats, and color (unorm8x4), joints (uscaled8x4)
+			and weights (unorm8x4) only if the model has vertex colors or skins. All formats are read as floats, so the shaders don't change.
+			Components that aren't stored are read from a constant vertex (white color, zero joints and weights) in a second binding with zero stride.
+		*/
+		struct VertexLayout {
+			bool compact = false;
+			uint32_t stride = sizeof(Vertex);
+			// Offset and format of each VertexComponent, components with an undefined format are read from the constant binding
+			uint32_t offsets[7]{};
+			VkFormat formats[7]{};
+			uint32_t constantOffsets[7]{};
+			vks::Buffer constants;
+		} vertexLayout;
+		VkVertexInputBindingDescription vertexInputBindingDescriptions[2]{};
+		std::vector<VkVertexInputAttributeDescription> vertexInputAttributeDescriptions;
+		VkPipelineVertexInputStateCreateInfo pipelineVertexInputStateCreateInfo{};
+		// Positions of all vertices (3 floats each) if loaded with FileLoadingFlags::SeparatePositions, skinned and morphed positions aren't applied
+		vks::Buffer positions;
+		VkVertexInputBindingDescription positionInputBinding{};
+		VkVertexInputAttributeDescription positionInputAttribute{};
+		VkPipelineVertexInputStateCreateInfo positionInputState{};
+
+		// Vertices (full vkglTF::Vertex layout) and indices as loaded, only filled if loaded with FileLoadingFlags::KeepHostGeometry
+		// The indices aren't rebased for a geometry pool, subtract geometryPoolRange.firstIndex from the primitives' first indices
+		struct HostGeometry {
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+		} hostGeometry;
+
+		// Distance based LOD selection of drawNode(), see setLodSelection()
+		struct LodSelection {
+			bool enabled = false;
+			glm::vec3 viewPos{};
+			float errorPerDistance = 0.0f;
+		} lodSelection;
+
+		/*
+			Multi draw indirect rendering, see prepareIndirectDraw()
+			All primitives are flattened into one VkDrawIndexedIndirectCommand per primitive, grouped by alpha mode (opaque, masked, blended)
+			The firstInstance of a draw is its index into the draw data buffer, so the shaders find their transform and material with gl_InstanceIndex:
+				layout (set = 0, binding = 0) readonly buffer Transforms { mat4 transforms[]; };
+				layout (set = 0, binding = 1) readonly buffer DrawData { uvec4 drawData[]; };	// x = transform index, y = material index, z = first lod, w = lod count
+				layout (set = 0, binding = 2) readonly buffer Lods { Lod lods[]; };				// struct Lod { uint firstIndex; uint indexCount; float error; float padding; }
+				mat4 model = transforms[drawData[gl_InstanceIndex].x];
+			A culling or LOD compute shader rewrites the commands' index ranges from the lods of their draw, see vkglTF::GpuCulling
+			With placements (see setIndirectPlacements()) the whole model is drawn once per placement matrix, every placement has its own
+			transforms and draws, so culling and LOD selection work per copy
+		*/
+		struct IndirectDrawData {
+			uint32_t transformIndex;
+			uint32_t materialIndex;
+			uint32_t firstLod;
+			uint32_t lodCount;
+		};
+		struct IndirectLod {
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float error;
+			float padding;
+		};
+		// Mesh node (and EXT_mesh_gpu_instancing instance, -1 for the node itself) and placement of an indirect transform
+		struct IndirectTransform {
+			Node *node;
+			int32_t instance;
+			uint32_t placement;
+		};
+		struct IndirectDraw {
+			static const uint32_t groupCount = 3;
+			vks::Buffer commands;
+			// Draw count of each group, read by vkCmdDrawIndexedIndirectCountKHR (and written by GPU culling)
+			vks::Buffer counts;
+			vks::Buffer drawData;
+			vks::Buffer lods;
+			// Model space bounding sphere of each draw's primitive, xyz = center, w = radius
+			vks::Buffer bounds;
+			// World matrices of the mesh nodes, updated by updateNodes()
+			vks::Buffer transforms;
+			std::vector<IndirectTransform> transformSources;
+			// Matrices applied on top of the node world matrices, one copy of the model per matrix (a single identity matrix if empty)
+			std::vector<glm::mat4> placements;
+			uint32_t firstDraw[groupCount]{};
+			uint32_t drawCount[groupCount]{};
+			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+			VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR = nullptr;
+			bool prepared = false;
+		} indirect;
+
+		/*
+			Bindless materials, see prepareBindless()
+			All textures are in one variable sized sampler array and the material parameters in a storage buffer indexed by material index:
+				layout (set = 1, binding = 0) readonly buffer Materials { BindlessMaterial materials[]; };
+				layout (set = 1, binding = 1) uniform sampler2D textures[];
+				vec4 color = texture(textures[nonuniformEXT(materials[materialIndex].baseColorTexture)], inUV);
+			Texture indices of materials without the texture are -1, except for the normal map which defaults to an empty texture
+		*/
+		struct BindlessMaterial {
+			glm::vec4 baseColorFactor;
+			float metallicFactor;
+			float roughnessFactor;
+			float alphaCutoff;
+			uint32_t alphaMode;
+			int32_t baseColorTexture;
+			int32_t metallicRoughnessTexture;
+			int32_t normalTexture;
+			int32_t occlusionTexture;
+			int32_t emissiveTexture;
+			int32_t specularGlossinessTexture;
+			int32_t diffuseTexture;
+			int32_t padding;
+		};
+		struct Bindless {
+			vks::Buffer materials;
+			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+			VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			bool prepared = false;
+		} bindless;
+
+		/*
+			Mesh shader rendering of meshlets, see FileLoadingFlags::GenerateMeshlets and prepareMeshlets()
+			Each primitive is drawn with one task shader workgroup per 32 meshlets, the task shader culls meshlets by their bounding sphere and
+			normal cone and the mesh shader emits the vertices and triangles of the visible ones:
+				layout (set = 1, binding = 0) readonly buffer Meshlets { Meshlet meshlets[]; };		// struct Meshlet { vec4 sphere; vec4 cone; uint vertexOffset; uint triangleOffset; uint vertexCount; uint triangleCount; }
+				layout (set = 1, binding = 1) readonly buffer MeshletVertices { uint meshletVertices[]; };
+				layout (set = 1, binding = 2) readonly buffer MeshletTriangles { uint meshletTriangles[]; };	// Three local vertex indices per triangle, packed as bytes
+				layout (set = 1, binding = 3) readonly buffer Vertices { float vertices[]; };				// Layout of vkglTF::Vertex
+				layout (set = 1, binding = 4) readonly buffer Transforms { mat4 transforms[]; };			// Shared with the indirect draw path
+				layout (push_constant) uniform MeshletDraw { uint transformIndex; uint materialIndex; uint firstMeshlet; uint meshletCount; };
+			The meshlet bounds are in model space, the cone culls the meshlet if dot(normalize(center - viewPos), cone.xyz) >= cone.w
+		*/
+		struct MeshletData {
+			glm::vec4 sphere;
+			glm::vec4 cone;
+			uint32_t vertexOffset;
+			uint32_t triangleOffset;
+			uint32_t vertexCount;
+			uint32_t triangleCount;
+		};
+		struct MeshletDraw {
+			uint32_t transformIndex;
+			uint32_t materialIndex;
+			uint32_t firstMeshlet;
+			uint32_t meshletCount;
+		};
+		struct Meshlets {
+			static const uint32_t meshletsPerTask = 32;
+			vks::Buffer meshlets;
+			vks::Buffer vertices;
+			vks::Buffer triangles;
+			uint32_t count = 0;
+			// Draws of all primitives with meshlets, grouped by alpha mode like the indirect draws
+			std::vector<MeshletDraw> draws;
+			uint32_t firstDraw[IndirectDraw::groupCount]{};
+			uint32_t drawCount[IndirectDraw::groupCount]{};
+			VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+			VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			PFN_vkCmdDrawMeshTasksEXT vkCmdDrawMeshTasksEXT = nullptr;
+			bool prepared = false;
+		} meshlets;
+
+		/*
+			Hardware instancing of repeated meshes, see prepareInstancing()
+			Every primitive is drawn once for all nodes using its mesh (and all their EXT_mesh_gpu_instancing instances), the world matrices
+			of the instances are read from a per-instance vertex buffer at Instancing::binding:
+				layout (location = N) in mat4 instanceMatrix;	// Locations N to N + 3 after the vertex components, see getInstancedVertexInputState()
+			Nodes without a skin that use the same glTF mesh share its vertices and indices unless the vertices are pre-transformed
+		*/
+		struct InstanceBatch {
+			Primitive *primitive;
+			uint32_t firstInstance;
+			uint32_t instanceCount;
+		};
+		// Node of an instance and the index into its instanceMatrices, -1 for the node itself
+		struct InstanceSource {
+			Node *node;
+			int32_t instance;
+		};
+		struct Instancing {
+			static const uint32_t binding = 2;
+			// World matrices of all instances, updated by updateNodes()
+			vks::Buffer instances;
+			std::vector<InstanceSource> sources;
+			std::vector<InstanceBatch> batches;
+			VkVertexInputBindingDescription inputBindings[3]{};
+			std::vector<VkVertexInputAttributeDescription> inputAttributes;
+			VkPipelineVertexInputStateCreateInfo inputState{};
+			bool prepared = false;
+		} instancing;
+
+		/*
+			Morph targets of all primitives loaded with the file, as sparse deltas in one storage buffer
+			Primitive::morphTargets are ranges of the deltas, the node's morphWeights select how much of each target is applied. The targets are
+			blended on the GPU by the compute pre-pass of vkglTF::ComputeSkinning, one dispatch per target with a non-zero weight, so the cost
+			scales with the active targets and the vertices they move. Nodes with morph targets don't share their mesh's vertices.
+			Models with morph targets aren't written to the cache (FileLoadingFlags::UseCache).
+		*/
+		struct MorphTargets {
+			// Storage buffer of all MorphDelta entries, only created if the model has morph targets
+			vks::Buffer deltas;
+			uint32_t deltaCount = 0;
+		} morphTargets;
+
+		/*
+			Static batches of models loaded with FileLoadingFlags::StaticBatching and PreTransformVertices
+			The indices of all primitives sharing a material are copied into one range per material, appended to the model's index buffer after
+			the primitives' own ranges, so drawStaticBatches() records one draw per material instead of one per primitive. The per-primitive
+			draws (and LODs, indirect and meshlet draws) are unaffected. Batches are ordered by alpha mode (opaque, masked, blended), primitives
+			within a blended batch are drawn in node order. Shaders must not apply the node matrices, which are already baked into the vertices.
+		*/
+		struct StaticBatch {
+			Material *material;
+			uint32_t firstIndex;
+			uint32_t indexCount;
+		};
+		struct StaticBatching {
+			std::vector<StaticBatch> batches;
+			// Number of primitives merged into the batches, the draws draw() records for the same geometry
+			uint32_t primitiveCount = 0;
+		} staticBatching;
+
+		/*
+			Uniform blocks of all meshes loaded with the file, packed into one persistently mapped buffer
+			Every mesh's uniform buffer descriptor points at its own range, so shaders and descriptor sets are the same as with one buffer per mesh
+			updateNodes() only flushes the ranges of meshes it changed
+		*/
+		struct MeshUniforms {
+			vks::Buffer buffer;
+			// Size of one mesh's range, aligned for uniform buffer offsets and non-coherent memory flushes
+			VkDeviceSize stride = 0;
+			// Size of one frame's copy of all ranges
+			VkDeviceSize frameSize = 0;
+		} meshUniforms;
+
+		/*
+			Number of copies of the mesh uniform blocks (matrix and joint palette) in the shared buffer, one per frame the CPU records ahead of the GPU
+			Has to be set before loading. updateNodes() writes the copy of currentFrame (and brings the other copies up to date in the following frames),
+			so a frame still in flight keeps reading its own palette. drawNode() selects the copy of currentFrame for RenderFlags::UseDescriptorBuffers,
+			examples binding the mesh descriptor sets themselves use uniformBuffer.descriptorSets[currentFrame]
+		*/
+		uint32_t framesInFlight = 1;
+		// Frame copy written by the next update and selected by the draws recorded after it, has to be less than framesInFlight
+		uint32_t currentFrame = 0;
+
+		// Constants of all materials for DescriptorBindingFlags::MaterialConstants without inline uniform blocks, one aligned range per material
+		vks::Buffer materialConstants;
+
+		/*
+			Descriptor buffers (VK_EXT_descriptor_buffer) holding the node uniform buffer and material image descriptors, see FileLoadingFlags::DescriptorBuffers
+			No descriptor sets are allocated for the nodes and materials of the file, binding one is an offset change recorded by drawNode()
+			Pipelines using them need to be created with VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT and layouts using nodeLayout and materialLayout,
+			which have the same bindings as descriptorSetLayoutUbo and descriptorSetLayoutImage
+		*/
+		struct DescriptorBuffers {
+			static const uint32_t noSet = UINT32_MAX;
+			// Set the node descriptors are selected for by draws with RenderFlags::UseDescriptorBuffers, noSet if the pipelines don't use them
+			uint32_t nodeSet = noSet;
+			VkDescriptorSetLayout nodeLayout = VK_NULL_HANDLE;
+			VkDescriptorSetLayout materialLayout = VK_NULL_HANDLE;
+			// Buffer index 0 when bound with bindDescriptorBuffers()
+			vks::Buffer nodes;
+			// Buffer index 1, also holds the samplers of the combined image samplers
+			vks::Buffer materials;
+			VkDeviceAddress nodesAddress = 0;
+			VkDeviceAddress materialsAddress = 0;
+			// Size of one frame's node descriptors in the node buffer, see framesInFlight
+			VkDeviceSize nodesFrameSize = 0;
+			PFN_vkCmdBindDescriptorBuffersEXT vkCmdBindDescriptorBuffersEXT = nullptr;
+			PFN_vkCmdSetDescriptorBufferOffsetsEXT vkCmdSetDescriptorBufferOffsetsEXT = nullptr;
+			bool prepared = false;
+		} descriptorBuffers;
+
+		/*
+			Per-draw data for draws with RenderFlags::UsePushDescriptors, recorded without any descriptor set allocation or binding
+			The node's world matrix and glTF node index are pushed as push constants (PushNodeData at nodeDataOffset for nodeDataStages):
+				layout (push_constant) uniform PushNode { mat4 matrix; uint index; } node;
+			and the material images as push descriptors at the image set, with the same bindings as descriptorSetLayoutImage
+			Pipeline layouts need a push constant range covering PushNodeData and materialLayout at the image set
+			Skinned nodes still need their uniform block for the joint matrices, set nodeDataStages to 0 if the pipelines don't read the node data
+		*/
+		struct PushNodeData {
+			glm::mat4 matrix;
+			uint32_t index;
+		};
+		struct PushDescriptors {
+			// Created with VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR, a pipeline layout can only contain one of these
+			VkDescriptorSetLayout materialLayout = VK_NULL_HANDLE;
+			VkShaderStageFlags nodeDataStages = VK_SHADER_STAGE_VERTEX_BIT;
+			uint32_t nodeDataOffset = 0;
+			// Set by FileLoadingFlags::PushDescriptors, no node and material descriptor sets have been allocated
+			bool noDescriptorSets = false;
+			PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR = nullptr;
+			bool prepared = false;
+		} pushDescriptors;
+
+		/*
+			Vertex pulling for draws with RenderFlags::PullVertices, see FileLoadingFlags::VertexPulling
+			No vertex buffer is bound, the vertex shader reads the vertices from the model's vertex buffer by its device address. The address and
+			the layout of the vertices are pushed as a VertexFetch block at pushConstantOffset by draw() and drawNodes():
+				layout (buffer_reference, std430, buffer_reference_align = 4) readonly buffer VertexWords { uint words[]; };
+				layout (push_constant) uniform VertexFetch { VertexWords vertices; uint stride; uint formats; uint offsets[7]; } fetch;
+				uint word = fetch.vertices.words[(gl_VertexIndex * fetch.stride + fetch.offsets[component]) / 4];
+			formats holds the VertexFetchFormat of each VertexComponent in 4 bits (Position in the lowest bits), so one pipeline reads both the full
+			and the compact vertex layouts of any model. Components that aren't stored (None) are up to the shader, e.g. white color and zero weights.
+			The indices address the model's whole vertex buffer, so the one address covers all primitives of the model.
+			Pipeline layouts need a push constant range of sizeof(VertexFetch) at pushConstantOffset for pushConstantStages
+		*/
+		enum class VertexFetchFormat : uint32_t { None = 0, R32G32Sfloat = 1, R32G32B32Sfloat = 2, R32G32B32A32Sfloat = 3, R16G16Sfloat = 4, R16G16B16A16Snorm = 5, R8G8B8A8Unorm = 6, R8G8B8A8Uscaled = 7 };
+		struct VertexFetch {
+			VkDeviceAddress vertices;
+			uint32_t stride;
+			uint32_t formats;
+			// Byte offset of each VertexComponent in a vertex, multiples of 4
+			uint32_t offsets[7];
+			uint32_t padding;
+		};
+		struct VertexPulling {
+			VertexFetch fetch{};
+			VkShaderStageFlags pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+			uint32_t pushConstantOffset = 0;
+			bool prepared = false;
+		} vertexPulling;
+
+		/*
+			Device addresses of the model's geometry, material and transform buffers, see getSceneAddresses()
+			Shaders can read all of them through one root push constant block instead of separately bound uniform and storage buffers:
+				layout (push_constant) uniform SceneAddresses { Vertices vertices; Indices indices; Materials materials; Transforms transforms; DrawData drawData; } scene;
+			with buffer_reference types matching vkglTF::Vertex (or VertexFetch), uint indices, BindlessMaterial, mat4 and IndirectDrawData
+			Geometry streamed into new buffers only changes the pushed addresses, no descriptor set needs to be updated
+			The buffers need device address usage: FileLoadingFlags::DeviceAddresses for the vertices and indices, prepareBindless() and
+			prepareIndirectDraw() with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT for the materials, transforms and draw data
+		*/
+		struct SceneAddresses {
+			VkDeviceAddress vertices;
+			VkDeviceAddress indices;
+			VkDeviceAddress materials;
+			VkDeviceAddress transforms;
+			VkDeviceAddress drawData;
+		};
+
 		Model() {};
 		~Model();
 		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale);
@@ -294,15 +931,49 @@ namespace vkglTF
 		void loadImages(tinygltf::Model& gltfModel, vks::VulkanDevice* device, VkQueue transferQueue);
 		void loadMaterials(tinygltf::Model& gltfModel);
 		void loadAnimations(tinygltf::Model& gltfModel);
-		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
+		void compactAnimations();
+		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f, vks::ThreadPool* threadPool = nullptr);
+		std::future<void> loadFromFileAsync(std::string filename, vks::VulkanDevice* device, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f, vks::ThreadPool* threadPool = nullptr);
+		void finishLoading(VkQueue transferQueue);
+		bool updateLazyImages(VkQueue transferQueue);
+		bool hasPendingImages() const;
 		void bindBuffers(VkCommandBuffer commandBuffer);
-		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		void bindVertexBuffers(VkCommandBuffer commandBuffer, VkBuffer vertexBuffer = VK_NULL_HANDLE);
+		VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);
+		void bindPositionBuffers(VkCommandBuffer commandBuffer);
+		VkPipelineVertexInputStateCreateInfo* getPositionInputState();
+		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1, VkPipeline* boundPipeline = nullptr);
 		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		void drawNodes(VkCommandBuffer commandBuffer, size_t firstNode, size_t nodeCount, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		void setLodSelection(bool enabled, glm::vec3 viewPos = glm::vec3(0.0f), float errorPerDistance = 0.0f);
+		uint32_t cullOccluded(const vks::OcclusionCuller &occlusionCuller, const glm::mat4 &transform = glm::mat4(1.0f));
+		void clearOccluded();
+		void setIndirectPlacements(const std::vector<glm::mat4> &placements);
+		void prepareIndirectDraw(VkBufferUsageFlags additionalUsage = 0);
+		void drawIndirect(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindSet = 0, VkBuffer commandsBuffer = VK_NULL_HANDLE, VkBuffer countsBuffer = VK_NULL_HANDLE);
+		void prepareBindless(VkBufferUsageFlags additionalUsage = 0);
+		void bindBindless(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t bindSet = 1);
+		void prepareMeshlets();
+		void drawMeshlets(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindSet = 1);
+		void prepareInstancing();
+		VkPipelineVertexInputStateCreateInfo* getInstancedVertexInputState(const std::vector<VertexComponent> components);
+		void drawInstanced(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		void drawStaticBatches(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		void bindDescriptorBuffers(VkCommandBuffer commandBuffer);
+		bool preparePushDescriptors();
+		SceneAddresses getSceneAddresses() const;
+		VkDeviceSize getDeviceMemorySize() const;
+		uint32_t registerDefragmentation(vks::MemoryDefragmenter* defragmenter);
+		void unregisterDefragmentation();
 		void getNodeDimensions(Node* node, glm::vec3& min, glm::vec3& max);
 		void getSceneDimensions();
-		void updateAnimation(uint32_t index, float time);
+		void flattenNodes();
+		void updateNodes(vks::ThreadPool* threadPool = nullptr);
+		void updateAnimation(uint32_t index, float time, vks::ThreadPool* threadPool = nullptr);
 		Node* findNode(Node* parent, uint32_t index);
 		Node* nodeFromIndex(uint32_t index);
 		void prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout);
+		void prepareMeshUniforms(VkBufferUsageFlags additionalUsage = 0);
+		void prepareMaterialConstants();
 	};
 }
\ No newline at end of file
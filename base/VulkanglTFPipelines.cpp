@@ -0,0 +1,415 @@
+/*
+* Material pipeline permutations for glTF models
+*
+* Creates the graphics pipelines for the alpha mode and double-sidedness permutations of glTF materials on demand, by fast-linking
+* shared VK_EXT_graphics_pipeline_library parts, and replaces them with link time optimized pipelines built on a background thread
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanglTFPipelines.h"
+#include "VulkanglTFModel.h"
+#include "VulkanDevice.h"
+#include "VulkanStartupReport.h"
+
+namespace vkglTF
+{
+	/**
+	* @param device Device to create the pipelines on
+	* @param pipelineCache Pipeline cache used for all parts and pipelines, shared with the background thread (pipeline caches are internally synchronized)
+	* @param pipelineLayout Layout of all permutations
+	* @param renderPass Render pass the pipelines are used in (subpass 0)
+	* @param vertexInputState Vertex input of all permutations, e.g. from vkglTF::Vertex::getPipelineVertexInputState (copied)
+	* @param vertexShaderFile SPIR-V file of the vertex shader
+	* @param fragmentShaderFile SPIR-V file of the fragment shader
+	* @param pipelineLibraries Fast-link the permutations from pipeline libraries (if the device supports VK_EXT_graphics_pipeline_library)
+	* @param alphaMaskCutoff Value of specialization constant 1 of the fragment shader
+	* @param viewportStateNext Optional pNext chain of the viewport state, has to stay valid while the object exists
+	* @param pipelineNext Optional pNext chain of the pipeline create info for state of the pre-rasterization and fragment shader parts (e.g. VkPipelineFragmentShadingRateStateCreateInfoKHR), has to stay valid while the object exists
+	*/
+	PipelinePermutations::PipelinePermutations(vks::VulkanDevice *device, VkPipelineCache pipelineCache, VkPipelineLayout pipelineLayout, VkRenderPass renderPass, const VkPipelineVertexInputStateCreateInfo &vertexInputState,
+		const std::string &vertexShaderFile, const std::string &fragmentShaderFile, bool pipelineLibraries, float alphaMaskCutoff, const void *viewportStateNext, const void *pipelineNext)
+		: device(device), pipelineCache(pipelineCache), pipelineLayout(pipelineLayout), renderPass(renderPass), pipelineLibraries(pipelineLibraries), alphaMaskCutoff(alphaMaskCutoff), viewportStateNext(viewportStateNext), pipelineNext(pipelineNext)
+	{
+		vertexBindings.assign(vertexInputState.pVertexBindingDescriptions, vertexInputState.pVertexBindingDescriptions + vertexInputState.vertexBindingDescriptionCount);
+		vertexAttributes.assign(vertexInputState.pVertexAttributeDescriptions, vertexInputState.pVertexAttributeDescriptions + vertexInputState.vertexAttributeDescriptionCount);
+		this->vertexInputState = vertexInputState;
+		this->vertexInputState.pVertexBindingDescriptions = vertexBindings.data();
+		this->vertexInputState.pVertexAttributeDescriptions = vertexAttributes.data();
+
+		const std::string shaderFiles[2] = { vertexShaderFile, fragmentShaderFile };
+		for (uint32_t i = 0; i < 2; i++)
+		{
+#if defined(__ANDROID__)
+			std::vector<char> code = vks::tools::loadShaderCode(androidApp->activity->assetManager, shaderFiles[i].c_str());
+#else
+			std::vector<char> code = vks::tools::loadShaderCode(shaderFiles[i].c_str());
+#endif
+			assert(!code.empty() && (code.size() % sizeof(uint32_t) == 0));
+			shaderCode[i].resize(code.size() / sizeof(uint32_t));
+			memcpy(shaderCode[i].data(), code.data(), code.size());
+			// Pipeline libraries take the code in the stage create info, complete pipelines need modules
+			if (!pipelineLibraries)
+			{
+				VkShaderModuleCreateInfo moduleCreateInfo{};
+				moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+				moduleCreateInfo.codeSize = code.size();
+				moduleCreateInfo.pCode = shaderCode[i].data();
+				VK_CHECK_RESULT(vkCreateShaderModule(device->logicalDevice, &moduleCreateInfo, nullptr, &shaderModules[i]));
+			}
+		}
+
+		if (pipelineLibraries)
+		{
+			thread = std::thread(&PipelinePermutations::run, this);
+		}
+	}
+
+	/** @brief Waits for the background thread to finish the pipeline it is linking and destroys all pipelines and parts */
+	PipelinePermutations::~PipelinePermutations()
+	{
+		if (thread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stop = true;
+			}
+			condition.notify_one();
+			thread.join();
+		}
+		VkDevice logicalDevice = device->logicalDevice;
+		auto destroy = [logicalDevice](VkPipeline pipeline) {
+			if (pipeline != VK_NULL_HANDLE)
+			{
+				vkDestroyPipeline(logicalDevice, pipeline, nullptr);
+			}
+		};
+		for (auto &permutation : permutations)
+		{
+			destroy(permutation.pipeline);
+			destroy(permutation.optimized);
+		}
+		for (auto pipeline : retiredPipelines)
+		{
+			destroy(pipeline);
+		}
+		destroy(libraries.vertexInput);
+		for (auto pipeline : libraries.preRasterization)
+		{
+			destroy(pipeline);
+		}
+		for (auto pipeline : libraries.fragmentShader)
+		{
+			destroy(pipeline);
+		}
+		for (auto pipeline : libraries.fragmentOutput)
+		{
+			destroy(pipeline);
+		}
+		for (auto shaderModule : shaderModules)
+		{
+			if (shaderModule != VK_NULL_HANDLE)
+			{
+				vkDestroyShaderModule(logicalDevice, shaderModule, nullptr);
+			}
+		}
+	}
+
+	/** @brief Index of the permutation a material is drawn with */
+	uint32_t PipelinePermutations::getPermutation(const Material &material)
+	{
+		return static_cast<uint32_t>(material.alphaMode) * 2 + (material.doubleSided ? 1 : 0);
+	}
+
+	// The state only differs in the parts a permutation depends on, so parts can be shared between permutations
+	void PipelinePermutations::getState(uint32_t permutation, PermutationState &state) const
+	{
+		const Material::AlphaMode alphaMode = static_cast<Material::AlphaMode>(permutation / 2);
+		const bool doubleSided = (permutation % 2) == 1;
+		const bool blend = (alphaMode == Material::ALPHAMODE_BLEND);
+
+		state.inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		state.viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		state.viewportState.pNext = viewportStateNext;
+		state.rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, doubleSided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		state.multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		state.depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, blend ? VK_FALSE : VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		state.blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, blend ? VK_TRUE : VK_FALSE);
+		if (blend)
+		{
+			state.blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+			state.blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+			state.blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+			state.blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			state.blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+			state.blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+		}
+		state.colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &state.blendAttachmentState);
+		state.dynamicStates[0] = VK_DYNAMIC_STATE_VIEWPORT;
+		state.dynamicStates[1] = VK_DYNAMIC_STATE_SCISSOR;
+		state.dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(state.dynamicStates, 2, 0);
+
+		state.specializationConstants.set<0>((alphaMode == Material::ALPHAMODE_MASK) ? VK_TRUE : VK_FALSE);
+		state.specializationConstants.set<1>(alphaMaskCutoff);
+
+		const VkShaderStageFlagBits stageFlags[2] = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			state.moduleCreateInfos[i] = {};
+			state.moduleCreateInfos[i].sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+			state.moduleCreateInfos[i].codeSize = shaderCode[i].size() * sizeof(uint32_t);
+			state.moduleCreateInfos[i].pCode = shaderCode[i].data();
+			state.stages[i] = {};
+			state.stages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			state.stages[i].stage = stageFlags[i];
+			state.stages[i].pName = "main";
+			if (pipelineLibraries)
+			{
+				state.stages[i].pNext = &state.moduleCreateInfos[i];
+			}
+			else
+			{
+				state.stages[i].module = shaderModules[i];
+			}
+		}
+		state.stages[1].pSpecializationInfo = state.specializationConstants.getInfo();
+	}
+
+	// Create the library of one part of the pipeline with the state of a permutation using it
+	VkPipeline PipelinePermutations::createLibrary(VkGraphicsPipelineLibraryFlagsEXT part, uint32_t permutation)
+	{
+		PermutationState state;
+		getState(permutation, state);
+
+		VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+		libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+		libraryInfo.flags = part;
+		if ((part == VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT) || (part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT))
+		{
+			// The library create info declares a non-const pNext
+			libraryInfo.pNext = const_cast<void*>(pipelineNext);
+		}
+
+		VkGraphicsPipelineCreateInfo pipelineCI{};
+		pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineCI.pNext = &libraryInfo;
+		// Retained so the background thread can link the parts with link time optimization
+		pipelineCI.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+		pipelineCI.layout = pipelineLayout;
+		pipelineCI.renderPass = renderPass;
+		switch (part)
+		{
+		case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+			pipelineCI.pVertexInputState = &vertexInputState;
+			pipelineCI.pInputAssemblyState = &state.inputAssemblyState;
+			break;
+		case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+			pipelineCI.stageCount = 1;
+			pipelineCI.pStages = &state.stages[0];
+			pipelineCI.pViewportState = &state.viewportState;
+			pipelineCI.pRasterizationState = &state.rasterizationState;
+			pipelineCI.pDynamicState = &state.dynamicState;
+			break;
+		case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+			pipelineCI.stageCount = 1;
+			pipelineCI.pStages = &state.stages[1];
+			pipelineCI.pDepthStencilState = &state.depthStencilState;
+			pipelineCI.pMultisampleState = &state.multisampleState;
+			break;
+		default:
+			pipelineCI.pColorBlendState = &state.colorBlendState;
+			pipelineCI.pMultisampleState = &state.multisampleState;
+			break;
+		}
+		VkPipeline library = VK_NULL_HANDLE;
+		VKS_STARTUP_SCOPE(vks::StartupReport::Pipeline, "glTF library part " + std::to_string(part) + " of permutation " + std::to_string(permutation));
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &library));
+		return library;
+	}
+
+	// Link the parts of a permutation into an executable pipeline, the parts need to exist
+	VkPipeline PipelinePermutations::link(uint32_t permutation, bool optimize)
+	{
+		const Material::AlphaMode alphaMode = static_cast<Material::AlphaMode>(permutation / 2);
+		const VkPipeline parts[4] = {
+			libraries.vertexInput,
+			libraries.preRasterization[permutation % 2],
+			libraries.fragmentShader[alphaMode],
+			libraries.fragmentOutput[(alphaMode == Material::ALPHAMODE_BLEND) ? 1 : 0]
+		};
+
+		VkPipelineLibraryCreateInfoKHR libraryInfo{};
+		libraryInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+		libraryInfo.libraryCount = 4;
+		libraryInfo.pLibraries = parts;
+
+		VkGraphicsPipelineCreateInfo pipelineCI{};
+		pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineCI.pNext = &libraryInfo;
+		pipelineCI.layout = pipelineLayout;
+		// Fast linking skips all optimization across the parts, link time optimization trades creation time for run-time performance
+		pipelineCI.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VKS_STARTUP_SCOPE(vks::StartupReport::Pipeline, "glTF permutation " + std::to_string(permutation) + (optimize ? " (optimized link)" : " (fast link)"));
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		return pipeline;
+	}
+
+	// Complete pipeline of a permutation, used without pipeline libraries
+	VkPipeline PipelinePermutations::createPipeline(uint32_t permutation)
+	{
+		PermutationState state;
+		getState(permutation, state);
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
+		pipelineCI.pNext = pipelineNext;
+		pipelineCI.pVertexInputState = &vertexInputState;
+		pipelineCI.pInputAssemblyState = &state.inputAssemblyState;
+		pipelineCI.pViewportState = &state.viewportState;
+		pipelineCI.pRasterizationState = &state.rasterizationState;
+		pipelineCI.pMultisampleState = &state.multisampleState;
+		pipelineCI.pDepthStencilState = &state.depthStencilState;
+		pipelineCI.pColorBlendState = &state.colorBlendState;
+		pipelineCI.pDynamicState = &state.dynamicState;
+		pipelineCI.stageCount = 2;
+		pipelineCI.pStages = state.stages;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VKS_STARTUP_SCOPE(vks::StartupReport::Pipeline, "glTF permutation " + std::to_string(permutation));
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		return pipeline;
+	}
+
+	/**
+	* Get the pipeline of a material's permutation, creating it on the first request
+	*
+	* With pipeline libraries the first request creates the parts missing for the permutation and fast-links them, the optimized
+	* pipeline is queued for the background thread. Without, it creates the complete pipeline.
+	*/
+	VkPipeline PipelinePermutations::get(const Material &material)
+	{
+		const uint32_t index = getPermutation(material);
+		Permutation &permutation = permutations[index];
+		if (permutation.pipeline != VK_NULL_HANDLE)
+		{
+			return permutation.pipeline;
+		}
+		if (!pipelineLibraries)
+		{
+			permutation.pipeline = createPipeline(index);
+			return permutation.pipeline;
+		}
+
+		const uint32_t alphaMode = index / 2;
+		const uint32_t blend = (alphaMode == Material::ALPHAMODE_BLEND) ? 1 : 0;
+		if (libraries.vertexInput == VK_NULL_HANDLE)
+		{
+			libraries.vertexInput = createLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, index);
+		}
+		if (libraries.preRasterization[index % 2] == VK_NULL_HANDLE)
+		{
+			libraries.preRasterization[index % 2] = createLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT, index);
+		}
+		if (libraries.fragmentShader[alphaMode] == VK_NULL_HANDLE)
+		{
+			libraries.fragmentShader[alphaMode] = createLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT, index);
+		}
+		if (libraries.fragmentOutput[blend] == VK_NULL_HANDLE)
+		{
+			libraries.fragmentOutput[blend] = createLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, index);
+		}
+		permutation.pipeline = link(index, false);
+
+		// Parts are never changed once created, so the background thread can read them without holding the lock
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			optimizeQueue.push_back(index);
+		}
+		condition.notify_one();
+		return permutation.pipeline;
+	}
+
+	/**
+	* Set the pipelines of all materials of a model, for drawing with RenderFlags::BindMaterialPipelines
+	*
+	* A model can be drawn with several sets of permutations by assigning the set to use before recording the draws
+	*
+	* @note The model is updated by update() until the object is destroyed, so it has to stay valid until then
+	*/
+	void PipelinePermutations::assign(Model &model)
+	{
+		for (auto &material : model.materials)
+		{
+			material.pipeline = get(material);
+		}
+		if (std::find(models.begin(), models.end(), &model) == models.end())
+		{
+			models.push_back(&model);
+		}
+	}
+
+	/**
+	* Replace fast-linked pipelines with their optimized versions once the background thread has linked them, including the
+	* pipelines of the materials of assigned models
+	*
+	* @return True if any pipeline has been replaced, command buffers using the permutations need to be recorded again
+	*/
+	bool PipelinePermutations::update()
+	{
+		const size_t firstRetired = retiredPipelines.size();
+		std::vector<VkPipeline> replacements;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!optimizedPending)
+			{
+				return false;
+			}
+			for (auto &permutation : permutations)
+			{
+				if (permutation.optimized != VK_NULL_HANDLE)
+				{
+					retiredPipelines.push_back(permutation.pipeline);
+					replacements.push_back(permutation.optimized);
+					permutation.pipeline = permutation.optimized;
+					permutation.optimized = VK_NULL_HANDLE;
+				}
+			}
+			optimizedPending = false;
+		}
+		// Only materials still using a replaced pipeline are changed, models may be shared with other permutation sets
+		for (auto model : models)
+		{
+			for (auto &material : model->materials)
+			{
+				for (size_t i = 0; i < replacements.size(); i++)
+				{
+					if (material.pipeline == retiredPipelines[firstRetired + i])
+					{
+						material.pipeline = replacements[i];
+						break;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	void PipelinePermutations::run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			condition.wait(lock, [this] { return stop || !optimizeQueue.empty(); });
+			if (stop)
+			{
+				break;
+			}
+			const uint32_t index = optimizeQueue.front();
+			optimizeQueue.pop_front();
+			lock.unlock();
+			VkPipeline optimized = link(index, true);
+			lock.lock();
+			permutations[index].optimized = optimized;
+			optimizedPending = true;
+		}
+	}
+}
@@ -0,0 +1,136 @@
+/*
+* Material pipeline permutations for glTF models
+*
+* Creates the graphics pipelines for the alpha mode and double-sidedness permutations of glTF materials on demand, by fast-linking
+* shared VK_EXT_graphics_pipeline_library parts, and replaces them with link time optimized pipelines built on a background thread
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanSpecialization.hpp"
+
+namespace vks
+{
+	struct VulkanDevice;
+}
+
+namespace vkglTF
+{
+	class Model;
+	struct Material;
+
+	/**
+	* Pipeline permutations of one shader pair for the materials of glTF models
+	*
+	* Usage:
+	*	vkglTF::PipelinePermutations permutations(vulkanDevice, pipelineCache, pipelineLayout, renderPass, vertexInputState, vertexShaderFile, fragmentShaderFile, pipelineLibraries);
+	*	permutations.assign(model);
+	*	// Command buffers
+	*	model.draw(commandBuffer, vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::BindMaterialPipelines, pipelineLayout);
+	*	// Between frames
+	*	if (permutations.update()) {
+	*		buildCommandBuffers();
+	*	}
+	*
+	* A permutation is selected by the alpha mode and double-sidedness of a material:
+	* - Double-sided materials are drawn without back face culling
+	* - Masked materials get VK_TRUE for the fragment shader's specialization constant 0 and the cutoff for constant 1 (float)
+	* - Blended materials are drawn with alpha blending and without depth writes
+	*
+	* With pipeline libraries, the vertex input, pre-rasterization, fragment shader and fragment output parts are created once per
+	* state they depend on and the first request of a permutation fast-links them, which is cheap enough to do while recording. The
+	* permutation is then linked again with link time optimization on a background thread and update() swaps in the optimized pipeline.
+	* Without pipeline libraries, permutations are created as complete pipelines on their first request.
+	*
+	* Stereo rendering: permutations created for a multiview render pass (or with a VkPipelineRenderingCreateInfo with a view mask as pipelineNext
+	* for dynamic rendering) draw each primitive once for all views, the shaders select the per-view matrices with gl_ViewIndex.
+	*
+	* @note Requires VK_EXT_graphics_pipeline_library and VK_KHR_pipeline_library to be enabled with the graphicsPipelineLibrary feature for pipelineLibraries = true
+	* @note Pipelines replaced by update() may still be in use by command buffers in flight, they are only destroyed with the object
+	*/
+	class PipelinePermutations
+	{
+	public:
+		/** @brief Number of permutations, three alpha modes, single- and double-sided */
+		static const uint32_t permutationCount = 6;
+
+		PipelinePermutations(vks::VulkanDevice *device, VkPipelineCache pipelineCache, VkPipelineLayout pipelineLayout, VkRenderPass renderPass, const VkPipelineVertexInputStateCreateInfo &vertexInputState,
+			const std::string &vertexShaderFile, const std::string &fragmentShaderFile, bool pipelineLibraries, float alphaMaskCutoff = 0.5f, const void *viewportStateNext = nullptr, const void *pipelineNext = nullptr);
+		~PipelinePermutations();
+		static uint32_t getPermutation(const Material &material);
+		VkPipeline get(const Material &material);
+		void assign(Model &model);
+		bool update();
+	private:
+		struct Permutation {
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			// Written by the background thread, swapped in by update()
+			VkPipeline optimized = VK_NULL_HANDLE;
+		};
+		struct LibraryParts {
+			VkPipeline vertexInput = VK_NULL_HANDLE;
+			// Indexed by double-sidedness
+			VkPipeline preRasterization[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+			// Indexed by alpha mode
+			VkPipeline fragmentShader[3] = { VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE };
+			// Indexed by blending
+			VkPipeline fragmentOutput[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+		};
+		// Fixed function state of a permutation, shared by library and complete pipeline creation
+		struct PermutationState {
+			VkPipelineInputAssemblyStateCreateInfo inputAssemblyState;
+			VkPipelineViewportStateCreateInfo viewportState;
+			VkPipelineRasterizationStateCreateInfo rasterizationState;
+			VkPipelineMultisampleStateCreateInfo multisampleState;
+			VkPipelineDepthStencilStateCreateInfo depthStencilState;
+			VkPipelineColorBlendAttachmentState blendAttachmentState;
+			VkPipelineColorBlendStateCreateInfo colorBlendState;
+			VkDynamicState dynamicStates[2];
+			VkPipelineDynamicStateCreateInfo dynamicState;
+			// Alpha mask flag and cutoff
+			vks::SpecializationConstants<VkBool32, float> specializationConstants;
+			VkShaderModuleCreateInfo moduleCreateInfos[2];
+			VkPipelineShaderStageCreateInfo stages[2];
+		};
+		vks::VulkanDevice *device;
+		VkPipelineCache pipelineCache;
+		VkPipelineLayout pipelineLayout;
+		VkRenderPass renderPass;
+		bool pipelineLibraries;
+		float alphaMaskCutoff;
+		const void *viewportStateNext;
+		const void *pipelineNext;
+		std::vector<VkVertexInputBindingDescription> vertexBindings;
+		std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+		VkPipelineVertexInputStateCreateInfo vertexInputState;
+		std::vector<uint32_t> shaderCode[2];
+		// Only used without pipeline libraries, which take the code directly
+		VkShaderModule shaderModules[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+		LibraryParts libraries;
+		Permutation permutations[permutationCount];
+		std::vector<Model*> models;
+		std::vector<VkPipeline> retiredPipelines;
+		// Background linking with link time optimization
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<uint32_t> optimizeQueue;
+		bool optimizedPending = false;
+		bool stop = false;
+		void getState(uint32_t permutation, PermutationState &state) const;
+		VkPipeline createLibrary(VkGraphicsPipelineLibraryFlagsEXT part, uint32_t permutation);
+		VkPipeline link(uint32_t permutation, bool optimize);
+		VkPipeline createPipeline(uint32_t permutation);
+		void run();
+	};
+}
@@ -0,0 +1,234 @@
+/*
+* Streaming residency manager for glTF models
+*
+* Loads glTF models on demand on background threads, makes them resident at frame boundaries and evicts the least recently used ones
+* through the device's deferred destruction queue once the resident models exceed a device memory budget
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanglTFResidency.h"
+#include "VulkanglTFModel.h"
+#include "VulkanDevice.h"
+#include <algorithm>
+#include <chrono>
+#include <assert.h>
+
+namespace vkglTF
+{
+	/**
+	* @param device Device to load the models on
+	* @param transferQueue Queue for the texture uploads and mip generation of Model::finishLoading(), must support graphics operations for the mip blits
+	* @param budget Device memory the resident models may use before the least recently used ones are evicted
+	* @param threadPool (Optional) Thread pool for decoding the images of a model in parallel
+	* @param maxConcurrentLoads (Optional) Number of models whose CPU stage may run at the same time
+	*/
+	ModelResidency::ModelResidency(vks::VulkanDevice *device, VkQueue transferQueue, VkDeviceSize budget, vks::ThreadPool *threadPool, uint32_t maxConcurrentLoads)
+		: device(device), transferQueue(transferQueue), budget(budget), threadPool(threadPool), maxConcurrentLoads(std::max(maxConcurrentLoads, 1u))
+	{
+	}
+
+	/** @brief Waits for loads still running on background threads, resident models are destroyed immediately, so the device must be idle */
+	ModelResidency::~ModelResidency()
+	{
+		for (Entry &entry : entries)
+		{
+			if (entry.loading.valid())
+			{
+				entry.loading.wait();
+			}
+			delete entry.model;
+		}
+	}
+
+	/**
+	* Register a model file, it isn't loaded before its first acquire() or prefetch()
+	*
+	* @return Handle of the model for acquire()
+	*/
+	uint32_t ModelResidency::add(const std::string &filename, uint32_t fileLoadingFlags, float scale)
+	{
+		Entry entry;
+		entry.filename = filename;
+		entry.fileLoadingFlags = fileLoadingFlags;
+		entry.scale = scale;
+		entries.push_back(std::move(entry));
+		return static_cast<uint32_t>(entries.size() - 1);
+	}
+
+	/**
+	* Mark a model as used by the current frame and request it if it isn't resident
+	*
+	* @return The model if it's resident, nullptr while it's being streamed in
+	*/
+	vkglTF::Model *ModelResidency::acquire(uint32_t handle)
+	{
+		assert(handle < entries.size());
+		Entry &entry = entries[handle];
+		entry.lastUsedFrame = currentFrame;
+		if (entry.state == State::NotResident)
+		{
+			entry.state = State::Queued;
+		}
+		return (entry.state == State::Resident) ? entry.model : nullptr;
+	}
+
+	/** @brief The model if it's resident, nullptr otherwise, doesn't mark the model as used */
+	vkglTF::Model *ModelResidency::getModel(uint32_t handle) const
+	{
+		assert(handle < entries.size());
+		return (entries[handle].state == State::Resident) ? entries[handle].model : nullptr;
+	}
+
+	/** @brief Request a model without marking it as used, e.g. for models that are likely to be drawn soon */
+	void ModelResidency::prefetch(uint32_t handle)
+	{
+		assert(handle < entries.size());
+		Entry &entry = entries[handle];
+		if (entry.state == State::NotResident)
+		{
+			entry.state = State::Queued;
+		}
+	}
+
+	/**
+	* Advance streaming at a frame boundary, before recording (or submitting) the commands of the next frame
+	*
+	* @return True if models have become resident or have been evicted, so command buffers drawing them have to be re-recorded
+	*/
+	bool ModelResidency::update()
+	{
+		bool changed = false;
+
+		// GPU stage of the first finished load, one per frame spreads the uploads over several frames
+		for (Entry &entry : entries)
+		{
+			if ((entry.state == State::Loading) && (entry.loading.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+			{
+				entry.loading.get();
+				entry.model->finishLoading(transferQueue);
+				if (defragmenter)
+				{
+					entry.model->registerDefragmentation(defragmenter);
+				}
+				entry.deviceMemorySize = entry.model->getDeviceMemorySize();
+				entry.state = State::Resident;
+				statistics.loadingModels--;
+				statistics.residentModels++;
+				statistics.residentBytes += entry.deviceMemorySize;
+				statistics.loads++;
+				changed = true;
+				break;
+			}
+		}
+
+		// Start the CPU stage of requested loads while loading slots are free
+		for (Entry &entry : entries)
+		{
+			if (statistics.loadingModels >= maxConcurrentLoads)
+			{
+				break;
+			}
+			if (entry.state == State::Queued)
+			{
+				entry.model = new vkglTF::Model();
+				entry.loading = entry.model->loadFromFileAsync(entry.filename, device, entry.fileLoadingFlags, entry.scale, threadPool);
+				entry.state = State::Loading;
+				statistics.loadingModels++;
+			}
+		}
+
+		// Evict the least recently used models that haven't been acquired in this frame until the resident models fit into the budget
+		while (statistics.residentBytes > budget)
+		{
+			Entry *leastRecentlyUsed = nullptr;
+			for (Entry &entry : entries)
+			{
+				if ((entry.state == State::Resident) && (entry.lastUsedFrame < currentFrame) && (!leastRecentlyUsed || (entry.lastUsedFrame < leastRecentlyUsed->lastUsedFrame)))
+				{
+					leastRecentlyUsed = &entry;
+				}
+			}
+			if (!leastRecentlyUsed)
+			{
+				break;
+			}
+			evict(*leastRecentlyUsed);
+			changed = true;
+		}
+
+		currentFrame++;
+		return changed;
+	}
+
+	/**
+	* Evict a model regardless of the budget, e.g. when it won't be drawn again
+	*
+	* @note A model whose CPU stage is running is only evicted once it has finished, so this may wait for a background thread
+	*/
+	void ModelResidency::evict(uint32_t handle)
+	{
+		assert(handle < entries.size());
+		Entry &entry = entries[handle];
+		if (entry.state == State::Loading)
+		{
+			entry.loading.get();
+			// Never uploaded, so no frame can use it
+			delete entry.model;
+			entry.model = nullptr;
+			entry.state = State::NotResident;
+			statistics.loadingModels--;
+		}
+		else if (entry.state == State::Queued)
+		{
+			entry.state = State::NotResident;
+		}
+		else if (entry.state == State::Resident)
+		{
+			evict(entry);
+		}
+	}
+
+	void ModelResidency::evict(Entry &entry)
+	{
+		// Frames recorded up to now may still draw the model, so it's destroyed once they have finished
+		vkglTF::Model *model = entry.model;
+		// Moves of the model's textures can't be swapped in anymore
+		model->unregisterDefragmentation();
+		device->deferDestruction([model]() { delete model; });
+		entry.model = nullptr;
+		entry.state = State::NotResident;
+		statistics.residentModels--;
+		statistics.residentBytes -= entry.deviceMemorySize;
+		statistics.evictions++;
+		entry.deviceMemorySize = 0;
+	}
+
+	ModelResidency::State ModelResidency::getState(uint32_t handle) const
+	{
+		assert(handle < entries.size());
+		return entries[handle].state;
+	}
+
+	/** @brief Register the textures of models becoming resident from now on with the defragmenter, nullptr stops registering them */
+	void ModelResidency::setDefragmenter(vks::MemoryDefragmenter *defragmenter)
+	{
+		this->defragmenter = defragmenter;
+	}
+
+	/** @brief Change the budget, models exceeding a lower budget are evicted by the next update() */
+	void ModelResidency::setBudget(VkDeviceSize budget)
+	{
+		this->budget = budget;
+	}
+
+	VkDeviceSize ModelResidency::getBudget() const
+	{
+		return budget;
+	}
+
+	const ModelResidency::Statistics &ModelResidency::getStatistics() const
+	{
+		return statistics;
+	}
+}
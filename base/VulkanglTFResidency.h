@@ -0,0 +1,114 @@
+/*
+* Streaming residency manager for glTF models
+*
+* Loads glTF models on demand on background threads, makes them resident at frame boundaries and evicts the least recently used ones
+* through the device's deferred destruction queue once the resident models exceed a device memory budget
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <future>
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+	class ThreadPool;
+	class MemoryDefragmenter;
+}
+
+namespace vkglTF
+{
+	class Model;
+
+	/**
+	* Model residency with a device memory budget and least recently used eviction
+	*
+	* Usage:
+	*	residency.reset(new vkglTF::ModelResidency(vulkanDevice, queue, 256 * 1024 * 1024));
+	*	uint32_t handle = residency->add(getAssetPath() + "models/sponza/sponza.gltf", vkglTF::FileLoadingFlags::PreTransformVertices);
+	*	// Per frame, before prepareFrame(), models drawn by the frame are acquired before update() so they aren't evicted
+	*	residency->acquire(handle);
+	*	if (residency->update()) {
+	*		// Models have become resident or have been evicted, re-record command buffers that draw them before submitting them again
+	*	}
+	*	vkglTF::Model *model = residency->getModel(handle);	// nullptr until the model is resident
+	*
+	* acquire() marks a model as used by the current frame and requests it if it's not resident. update() starts the CPU stage of requested
+	* loads (parsing, image decoding, vertex processing) on background threads and runs the GPU stage (Model::finishLoading()) of at most one
+	* finished load, so streaming doesn't stall a frame with several uploads. Geometry is uploaded through the device's staging ring, which
+	* uses a dedicated transfer queue if the device has one.
+	*
+	* When the resident models exceed the budget, the least recently used ones that haven't been acquired in the current frame are evicted.
+	* Evicted models are handed to VulkanDevice::deferDestruction(), so they're destroyed once the frames that may still draw them have
+	* finished, without waiting for the device to become idle.
+	*
+	* @note Models must be acquired every frame they're drawn in (including frames replaying pre-recorded command buffers), or they may be evicted
+	* @note Model pointers are only valid until the update() that evicts the model
+	* @note The budget is a soft limit, models acquired in the current frame are never evicted even if they exceed it
+	* @note With a memory defragmenter set, the textures of models becoming resident are registered with it (see Model::registerDefragmentation())
+	* and unregistered on eviction, so the memory freed by evicted models can be compacted
+	*/
+	class ModelResidency
+	{
+	public:
+		enum class State : uint32_t
+		{
+			NotResident = 0,
+			// Requested and waiting for a free loading slot
+			Queued = 1,
+			// CPU stage running on a background thread
+			Loading = 2,
+			Resident = 3
+		};
+
+		struct Statistics {
+			// Device memory of all resident models, see Model::getDeviceMemorySize()
+			VkDeviceSize residentBytes = 0;
+			uint32_t residentModels = 0;
+			uint32_t loadingModels = 0;
+			uint32_t loads = 0;
+			uint32_t evictions = 0;
+		};
+
+	private:
+		struct Entry {
+			std::string filename;
+			uint32_t fileLoadingFlags;
+			float scale;
+			State state = State::NotResident;
+			vkglTF::Model *model = nullptr;
+			std::future<void> loading;
+			VkDeviceSize deviceMemorySize = 0;
+			uint64_t lastUsedFrame = 0;
+		};
+		vks::VulkanDevice *device;
+		VkQueue transferQueue;
+		VkDeviceSize budget;
+		vks::ThreadPool *threadPool;
+		uint32_t maxConcurrentLoads;
+		vks::MemoryDefragmenter *defragmenter = nullptr;
+		std::vector<Entry> entries;
+		uint64_t currentFrame = 1;
+		Statistics statistics;
+		void evict(Entry &entry);
+	public:
+		ModelResidency(vks::VulkanDevice *device, VkQueue transferQueue, VkDeviceSize budget, vks::ThreadPool *threadPool = nullptr, uint32_t maxConcurrentLoads = 2);
+		~ModelResidency();
+		uint32_t add(const std::string &filename, uint32_t fileLoadingFlags = 0, float scale = 1.0f);
+		vkglTF::Model *acquire(uint32_t handle);
+		vkglTF::Model *getModel(uint32_t handle) const;
+		void prefetch(uint32_t handle);
+		bool update();
+		void evict(uint32_t handle);
+		State getState(uint32_t handle) const;
+		void setDefragmenter(vks::MemoryDefragmenter *defragmenter);
+		void setBudget(VkDeviceSize budget);
+		VkDeviceSize getBudget() const;
+		const Statistics &getStatistics() const;
+	};
+}
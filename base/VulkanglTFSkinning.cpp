@@ -0,0 +1,418 @@
+/*
+* Compute shader skinning for glTF models
+*
+* Skins the vertices of all skinned primitives of a vkglTF::Model once per frame into an output vertex buffer, so every pass (shadows,
+* depth prepass, main pass) draws the skinned meshes as static geometry instead of skinning them again in its vertex shader
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanglTFSkinning.h"
+#include "VulkanglTFModel.h"
+#include "VulkanDevice.h"
+#include <algorithm>
+
+namespace vkglTF
+{
+	// The shader reads and writes the vertices as tightly packed floats
+	static_assert(sizeof(vkglTF::Vertex) == 24 * sizeof(float), "vkglTF::Vertex layout doesn't match the skinning shader");
+
+	/**
+	* @param device Device to create the compute pipelines and buffers on
+	* @param model Loaded model, the skinned and morphed meshes and the size of their joint palettes are fixed at construction
+	* @param shaderFile SPIR-V file of the "base/skinning.comp" shader, the "morphtargets.comp.spv" shader is loaded from the same directory
+	* @param frameCount Number of frames in flight, each frame has its own output vertex buffer and joint palettes
+	* @param additionalUsage Usage flags added to the output vertex buffers, e.g. for reading them in other shaders or building acceleration structures from them
+	*
+	* @note If the model has no skinned or morphed meshes, uses compact vertices or the shaders can't be loaded, no resources are created and isSupported() returns false
+	*/
+	ComputeSkinning::ComputeSkinning(vks::VulkanDevice *device, vkglTF::Model &model, const std::string &shaderFile, uint32_t frameCount, VkBufferUsageFlags additionalUsage) : device(device), model(model)
+	{
+		// The shaders only read and write the full vertex layout
+		if (model.vertexLayout.compact)
+		{
+			return;
+		}
+		for (vkglTF::Node *node : model.linearNodes)
+		{
+			if (!node->mesh)
+			{
+				continue;
+			}
+			bool morphed = false;
+			if ((model.morphTargets.deltas.buffer != VK_NULL_HANDLE) && !node->morphWeights.empty())
+			{
+				for (const vkglTF::Primitive *primitive : node->mesh->primitives)
+				{
+					morphed |= !primitive->morphTargets.empty();
+				}
+			}
+			if (morphed)
+			{
+				morphedNodes.push_back(node);
+			}
+			if (node->skin && !node->skin->joints.empty())
+			{
+				SkinnedNode skinnedNode = { node, jointCount, morphed };
+				skinnedNodes.push_back(skinnedNode);
+				jointCount += static_cast<uint32_t>(node->skin->joints.size());
+			}
+		}
+		if ((skinnedNodes.empty() && morphedNodes.empty()) || (frameCount == 0))
+		{
+			return;
+		}
+
+#if defined(__ANDROID__)
+		shaderModule = vks::tools::loadShader(androidApp->activity->assetManager, shaderFile.c_str(), device->logicalDevice);
+#else
+		shaderModule = vks::tools::loadShader(shaderFile.c_str(), device->logicalDevice);
+#endif
+		if (shaderModule == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		if (!morphedNodes.empty())
+		{
+			const size_t pos = shaderFile.find_last_of('/');
+			const std::string morphShaderFile = ((pos != std::string::npos) ? shaderFile.substr(0, pos + 1) : std::string()) + "morphtargets.comp.spv";
+#if defined(__ANDROID__)
+			morphShaderModule = vks::tools::loadShader(androidApp->activity->assetManager, morphShaderFile.c_str(), device->logicalDevice);
+#else
+			morphShaderModule = vks::tools::loadShader(morphShaderFile.c_str(), device->logicalDevice);
+#endif
+			// Without the shader the meshes are drawn with their base shapes
+			if (morphShaderModule == VK_NULL_HANDLE)
+			{
+				morphedNodes.clear();
+				for (SkinnedNode &skinnedNode : skinnedNodes)
+				{
+					skinnedNode.morphed = false;
+				}
+				if (skinnedNodes.empty())
+				{
+					return;
+				}
+			}
+		}
+
+		// Joint palettes are written by the host every frame, so they're kept in persistently mapped memory
+		const VkDeviceSize alignment = std::max(device->properties.limits.minStorageBufferOffsetAlignment, (VkDeviceSize)1);
+		jointBufferFrameSize = ((std::max(jointCount, 1u) * sizeof(glm::mat4) + alignment - 1) / alignment) * alignment;
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&jointBuffer,
+			jointBufferFrameSize * frameCount));
+		VK_CHECK_RESULT(jointBuffer.map());
+
+		frames.resize(frameCount);
+		const VkDeviceSize vertexBufferSize = static_cast<VkDeviceSize>(model.vertices.count) * sizeof(vkglTF::Vertex);
+		for (auto &frame : frames)
+		{
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | additionalUsage,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&frame.vertexBuffer,
+				vertexBufferSize));
+		}
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+		if (!morphedNodes.empty())
+		{
+			std::vector<VkDescriptorSetLayoutBinding> morphSetLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			};
+			descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(morphSetLayoutBindings);
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorSetLayoutCI, nullptr, &morphDescriptorSetLayout));
+		}
+
+		// Skinning, in place skinning and morph target sets per frame
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8 * frameCount)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3 * frameCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
+
+		VkDescriptorBufferInfo inputDescriptor = { model.vertices.buffer, 0, vertexBufferSize };
+		for (uint32_t i = 0; i < frameCount; i++)
+		{
+			Frame &frame = frames[i];
+			VkDescriptorBufferInfo jointDescriptor = { jointBuffer.buffer, i * jointBufferFrameSize, jointBufferFrameSize };
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &frame.descriptorSet));
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &inputDescriptor),
+				vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &frame.vertexBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &jointDescriptor),
+			};
+			if (!morphedNodes.empty())
+			{
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &frame.inPlaceDescriptorSet));
+				// Each invocation reads its vertex before writing it, so the input can alias the output
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(frame.inPlaceDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &frame.vertexBuffer.descriptor));
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(frame.inPlaceDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &frame.vertexBuffer.descriptor));
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(frame.inPlaceDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &jointDescriptor));
+				VkDescriptorSetAllocateInfo morphAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &morphDescriptorSetLayout, 1);
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &morphAllocInfo, &frame.morphDescriptorSet));
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(frame.morphDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &frame.vertexBuffer.descriptor));
+				writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(frame.morphDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &model.morphTargets.deltas.descriptor));
+			}
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		pipelineCI.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCI.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCI.stage.module = shaderModule;
+		pipelineCI.stage.pName = "main";
+		VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline));
+
+		if (!morphedNodes.empty())
+		{
+			VkPushConstantRange morphPushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(MorphPushConstants), 0);
+			VkPipelineLayoutCreateInfo morphPipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&morphDescriptorSetLayout, 1);
+			morphPipelineLayoutCI.pushConstantRangeCount = 1;
+			morphPipelineLayoutCI.pPushConstantRanges = &morphPushConstantRange;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &morphPipelineLayoutCI, nullptr, &morphPipelineLayout));
+			VkComputePipelineCreateInfo morphPipelineCI = vks::initializers::computePipelineCreateInfo(morphPipelineLayout, 0);
+			morphPipelineCI.stage = pipelineCI.stage;
+			morphPipelineCI.stage.module = morphShaderModule;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, VK_NULL_HANDLE, 1, &morphPipelineCI, nullptr, &morphPipeline));
+		}
+
+		supported = true;
+	}
+
+	ComputeSkinning::~ComputeSkinning()
+	{
+		for (auto &frame : frames)
+		{
+			frame.vertexBuffer.destroy();
+		}
+		jointBuffer.destroy();
+		if (pipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, pipeline, nullptr);
+		}
+		if (pipelineLayout)
+		{
+			vkDestroyPipelineLayout(device->logicalDevice, pipelineLayout, nullptr);
+		}
+		if (morphPipeline)
+		{
+			vkDestroyPipeline(device->logicalDevice, morphPipeline, nullptr);
+		}
+		if (morphPipelineLayout)
+		{
+			vkDestroyPipelineLayout(device->logicalDevice, morphPipelineLayout, nullptr);
+		}
+		if (descriptorPool)
+		{
+			vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
+		}
+		if (descriptorSetLayout)
+		{
+			vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayout, nullptr);
+		}
+		if (morphDescriptorSetLayout)
+		{
+			vkDestroyDescriptorSetLayout(device->logicalDevice, morphDescriptorSetLayout, nullptr);
+		}
+		if (shaderModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, shaderModule, nullptr);
+		}
+		if (morphShaderModule)
+		{
+			vkDestroyShaderModule(device->logicalDevice, morphShaderModule, nullptr);
+		}
+	}
+
+	bool ComputeSkinning::isSupported() const
+	{
+		return supported;
+	}
+
+	/** @brief Write the joint palettes of the frame from the cached world matrices of the model's nodes (see Model::updateNodes) */
+	void ComputeSkinning::update(uint32_t frameIndex)
+	{
+		if (!supported)
+		{
+			return;
+		}
+		glm::mat4 *jointMatrices = reinterpret_cast<glm::mat4*>(static_cast<uint8_t*>(jointBuffer.mapped) + frameIndex * jointBufferFrameSize);
+		for (const SkinnedNode &skinnedNode : skinnedNodes)
+		{
+			const vkglTF::Skin *skin = skinnedNode.node->skin;
+			// Joints are relative to the mesh's node, whose matrix is applied when drawing
+			const glm::mat4 inverseTransform = glm::inverse(skinnedNode.node->worldMatrix);
+			for (size_t i = 0; i < skin->joints.size(); i++)
+			{
+				const glm::mat4 inverseBindMatrix = (i < skin->inverseBindMatrices.size()) ? skin->inverseBindMatrices[i] : glm::mat4(1.0f);
+				jointMatrices[skinnedNode.firstJoint + i] = inverseTransform * skin->joints[i]->worldMatrix * inverseBindMatrix;
+			}
+		}
+	}
+
+	/**
+	* Record the morph target blending and skinning dispatches of the frame, followed by a barrier making the output visible to vertex input
+	*
+	* @note Must be recorded outside of a render pass, before the passes drawing the model with bindBuffers()
+	*/
+	void ComputeSkinning::record(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		if (!supported)
+		{
+			return;
+		}
+		Frame &frame = frames[frameIndex];
+		// Covers the upload of the model's vertices, the initial copy and the last frame's vertex reads of the output buffer
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		if (!frame.initialized)
+		{
+			// Copy all vertices once, the dispatches only overwrite the skinned ones
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			VkBufferCopy copyRegion = {};
+			copyRegion.size = frame.vertexBuffer.size;
+			vkCmdCopyBuffer(commandBuffer, model.vertices.buffer, frame.vertexBuffer.buffer, 1, &copyRegion);
+			frame.initialized = true;
+		}
+		if (!morphedNodes.empty())
+		{
+			// Morph targets accumulate into the output, so the base shapes are restored every frame
+			VkMemoryBarrier restoreBarrier = vks::initializers::memoryBarrier();
+			restoreBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			restoreBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &restoreBarrier, 0, nullptr, 0, nullptr);
+			std::vector<VkBufferCopy> copyRegions;
+			for (const vkglTF::Node *node : morphedNodes)
+			{
+				for (const vkglTF::Primitive *primitive : node->mesh->primitives)
+				{
+					if (!primitive->morphTargets.empty() && (primitive->vertexCount > 0))
+					{
+						const VkDeviceSize offset = static_cast<VkDeviceSize>(primitive->firstVertex) * sizeof(vkglTF::Vertex);
+						VkBufferCopy copyRegion = { offset, offset, static_cast<VkDeviceSize>(primitive->vertexCount) * sizeof(vkglTF::Vertex) };
+						copyRegions.push_back(copyRegion);
+					}
+				}
+			}
+			if (!copyRegions.empty())
+			{
+				vkCmdCopyBuffer(commandBuffer, model.vertices.buffer, frame.vertexBuffer.buffer, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+			}
+		}
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		if (!morphedNodes.empty())
+		{
+			recordMorphTargets(commandBuffer, frame);
+		}
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		for (const SkinnedNode &skinnedNode : skinnedNodes)
+		{
+			// Morphed meshes are skinned from the blended vertices in the output buffer
+			VkDescriptorSet descriptorSet = skinnedNode.morphed ? frame.inPlaceDescriptorSet : frame.descriptorSet;
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			for (const vkglTF::Primitive *primitive : skinnedNode.node->mesh->primitives)
+			{
+				if (primitive->vertexCount == 0)
+				{
+					continue;
+				}
+				PushConstants pushConstants = { primitive->firstVertex, primitive->vertexCount, skinnedNode.firstJoint };
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+				vkCmdDispatch(commandBuffer, (primitive->vertexCount + 63) / 64, 1, 1);
+			}
+		}
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	/**
+	* Record one round of dispatches per target index, adding the weighted deltas of each active target to the output buffer
+	*
+	* @note Targets of a primitive may move the same vertices, so the rounds are separated by barriers, targets with a weight of zero are skipped
+	*/
+	void ComputeSkinning::recordMorphTargets(VkCommandBuffer commandBuffer, Frame &frame)
+	{
+		size_t targetCount = 0;
+		for (const vkglTF::Node *node : morphedNodes)
+		{
+			for (const vkglTF::Primitive *primitive : node->mesh->primitives)
+			{
+				targetCount = std::max(targetCount, primitive->morphTargets.size());
+			}
+		}
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, morphPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, morphPipelineLayout, 0, 1, &frame.morphDescriptorSet, 0, nullptr);
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		for (size_t target = 0; target < targetCount; target++)
+		{
+			bool dispatched = false;
+			for (const vkglTF::Node *node : morphedNodes)
+			{
+				if ((target >= node->morphWeights.size()) || (node->morphWeights[target] == 0.0f))
+				{
+					continue;
+				}
+				for (const vkglTF::Primitive *primitive : node->mesh->primitives)
+				{
+					if ((target >= primitive->morphTargets.size()) || (primitive->morphTargets[target].deltaCount == 0))
+					{
+						continue;
+					}
+					const vkglTF::Primitive::MorphTarget &morphTarget = primitive->morphTargets[target];
+					MorphPushConstants pushConstants = { primitive->firstVertex, morphTarget.firstDelta, morphTarget.deltaCount, node->morphWeights[target] };
+					vkCmdPushConstants(commandBuffer, morphPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MorphPushConstants), &pushConstants);
+					vkCmdDispatch(commandBuffer, (morphTarget.deltaCount + 63) / 64, 1, 1);
+					dispatched = true;
+				}
+			}
+			if (dispatched)
+			{
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+		}
+	}
+
+	/** @brief Bind the frame's skinned vertex buffer and the model's index buffer, Model::draw() then uses them instead of the model's vertex buffer */
+	void ComputeSkinning::bindBuffers(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		if (!supported)
+		{
+			model.bindBuffers(commandBuffer);
+			return;
+		}
+		const VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &frames[frameIndex].vertexBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, model.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		model.buffersBound = true;
+	}
+
+	VkBuffer ComputeSkinning::getVertexBuffer(uint32_t frameIndex) const
+	{
+		return supported ? frames[frameIndex].vertexBuffer.buffer : model.vertices.buffer;
+	}
+}
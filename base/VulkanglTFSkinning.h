@@ -0,0 +1,112 @@
+/*
+* Compute shader skinning for glTF models
+*
+* Skins the vertices of all skinned primitives of a vkglTF::Model once per frame into an output vertex buffer, so every pass (shadows,
+* depth prepass, main pass) draws the skinned meshes as static geometry instead of skinning them again in its vertex shader
+* Morph targets are blended into the same output buffer before skinning
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+}
+
+namespace vkglTF
+{
+	class Model;
+	struct Node;
+
+	/**
+	* Compute skinning pre-pass using the GLSL "base/skinning.comp" and "base/morphtargets.comp" compute shaders
+	*
+	* Usage:
+	*	vkglTF::memoryPropertyFlags |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	*	model.loadFromFile(...);
+	*	vkglTF::ComputeSkinning skinning(vulkanDevice, model, getShadersPath() + "base/skinning.comp.spv", frameCount);
+	*	// Per frame, after updating the animation
+	*	skinning.update(frameIndex);
+	*	skinning.record(commandBuffer, frameIndex);		// outside of a render pass
+	*	skinning.bindBuffers(commandBuffer, frameIndex);	// in each pass, before model.draw()
+	*
+	* Skinned vertices are written in the space of their mesh's node like the vertices of static meshes, so they're drawn with the mesh's node
+	* matrix and without joint matrices. Joint palettes are stored in a storage buffer, so skins aren't limited to Mesh::maxJointCount joints.
+	*
+	* Morph targets (see Model::MorphTargets) are blended with the node's morphWeights as read by record(): the base vertices of the morphed
+	* primitives are copied into the output, then every target with a non-zero weight adds its sparse deltas in a dispatch of its own, and
+	* skinned morphed meshes are skinned in place afterwards. Targets without weight cost nothing, so record() needs to be called every frame.
+	*
+	* @note The model's buffers need to be created with storage buffer and transfer source usage (see vkglTF::memoryPropertyFlags)
+	* @note The output and palette buffers are per frame, update() must only be called for a frame whose last submission has finished
+	* @note To build ray tracing acceleration structures from the output, pass VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR as additional usage
+	*/
+	class ComputeSkinning
+	{
+	private:
+		struct PushConstants {
+			uint32_t firstVertex;
+			uint32_t vertexCount;
+			uint32_t firstJoint;
+		};
+		struct MorphPushConstants {
+			uint32_t firstVertex;
+			uint32_t firstDelta;
+			uint32_t deltaCount;
+			float weight;
+		};
+		// A skinned mesh and the offset of its joint palette
+		struct SkinnedNode {
+			vkglTF::Node *node;
+			uint32_t firstJoint;
+			// Morphed meshes are skinned in place, from the blended vertices in the output buffer
+			bool morphed;
+		};
+		struct Frame {
+			vks::Buffer vertexBuffer;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			// Skinning set reading the output buffer, and morph target set with the output buffer and the model's deltas
+			VkDescriptorSet inPlaceDescriptorSet = VK_NULL_HANDLE;
+			VkDescriptorSet morphDescriptorSet = VK_NULL_HANDLE;
+			// The output buffer is initialized with the model's vertices (including the unskinned ones) by the frame's first record()
+			bool initialized = false;
+		};
+		vks::VulkanDevice *device;
+		vkglTF::Model &model;
+		bool supported = false;
+		std::vector<SkinnedNode> skinnedNodes;
+		// Nodes whose meshes have morph targets
+		std::vector<vkglTF::Node*> morphedNodes;
+		std::vector<Frame> frames;
+		// Joint palettes of all frames, each frame uses a range starting at an aligned offset
+		vks::Buffer jointBuffer;
+		VkDeviceSize jointBufferFrameSize = 0;
+		uint32_t jointCount = 0;
+		VkShaderModule shaderModule = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkShaderModule morphShaderModule = VK_NULL_HANDLE;
+		VkDescriptorSetLayout morphDescriptorSetLayout = VK_NULL_HANDLE;
+		VkPipelineLayout morphPipelineLayout = VK_NULL_HANDLE;
+		VkPipeline morphPipeline = VK_NULL_HANDLE;
+		void recordMorphTargets(VkCommandBuffer commandBuffer, Frame &frame);
+	public:
+		ComputeSkinning(vks::VulkanDevice *device, vkglTF::Model &model, const std::string &shaderFile, uint32_t frameCount, VkBufferUsageFlags additionalUsage = 0);
+		~ComputeSkinning();
+		bool isSupported() const;
+		void update(uint32_t frameIndex);
+		void record(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+		void bindBuffers(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+		VkBuffer getVertexBuffer(uint32_t frameIndex) const;
+	};
+}
@@ -13,6 +13,12 @@
 #include <functional>
 #include <chrono>
 #include <iomanip>
+#include <cmath>
+#include <sstream>
+#include <fstream>
+#include "camera.hpp"
+#include "VulkanProfiler.hpp"
+#include "VulkanFrameArena.h"
 
 namespace vks
 {
@@ -28,9 +34,236 @@ namespace vks
 		uint32_t duration = 10;
 		std::vector<double> frameTimes;
 		std::string filename = "";
+		// Optional machine-readable result file
+		std::string jsonFilename = "";
+		// Frame time budgets (in ms) for which the number of frames exceeding them is reported
+		std::vector<double> frameBudgets = { 16.6, 33.3 };
+		// Width of the frame time histogram buckets in ms
+		double histogramBucketSize = 1.0;
+		// Optional result file (CSV, as written by saveResults) of an earlier run to compare against
+		std::string baselineFilename = "";
+		// Maximum increase of a metric compared to the baseline in percent before it counts as a regression
+		double regressionThreshold = 5.0;
+
+		/*
+			Optional specification making runs reproducible across builds and machines, loaded with loadSpecification()
+			Text file with one entry per line, empty lines and lines starting with # are ignored:
+				timestep <seconds>                       Time step of each frame's animation instead of the measured frame time
+				key <time> <px> <py> <pz> <rx> <ry> <rz> Camera path keyframe (seconds, position, rotation in degrees) in the camera's conventions
+			The animation time restarts with the benchmark phase, so frames show the same scene regardless of how many frames the warm up rendered
+		*/
+		struct Specification {
+			std::string filename = "";
+			// 0 keeps the frame timer's value
+			double timeStep = 0.0;
+			std::vector<Camera::PathKeyframe> cameraPath;
+		} specification;
+		// Number of frames captured at the start of the warm up and replayed in a loop for the rest of the run (see vks::CommandCapture), 0 renders the example's frames
+		uint32_t replayFrames = 0;
+		// Frames that have actually been captured, fewer than replayFrames if the warm up ended first, 0 if the example's submissions couldn't be captured
+		uint32_t capturedFrames = 0;
+		// Frames rendered in the current phase (warm up or benchmark)
+		uint32_t phaseFrame = 0;
+		bool warmingUp = false;
+		// Input to present latencies of the benchmark phase in ms (see vks::LatencyTracker), each frame counts as consuming an input at its start
+		std::vector<double> inputLatencies;
+		// True if the latencies end when the frame's present has completed (VK_KHR_present_wait), false if they end when vkQueuePresentKHR returned
+		bool inputLatencyPresentWait = false;
+
+		struct FrameTimeStats {
+			double min = 0.0;
+			double max = 0.0;
+			double avg = 0.0;
+			double stdDev = 0.0;
+			double p50 = 0.0;
+			double p90 = 0.0;
+			double p99 = 0.0;
+			double p999 = 0.0;
+			std::vector<uint32_t> framesOverBudget;
+			std::vector<uint32_t> histogram;
+		};
 
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
+		// Global heap allocations made while rendering the frames of the benchmark phase (the steady state frame loop should make none), only counted with VKS_COUNT_ALLOCATIONS
+		uint64_t heapAllocations = 0;
+		uint32_t framesWithHeapAllocations = 0;
+
+		// GPU timings of the named profiler scopes, gpuFrameTimes[frame][scope] is negative if a scope has not been measured for that frame
+		vks::GpuProfiler gpuProfiler;
+		std::vector<std::string> gpuScopes;
+		std::vector<std::vector<double>> gpuFrameTimes;
+		// Collect pipeline statistics (shader invocations, primitives, etc.) per frame, requires the pipelineStatisticsQuery feature
+		bool pipelineStatistics = false;
+		// pipelineStatisticsFrames[frame][statistic] in the order of vks::GpuProfiler::statisticNames(), empty for frames without statistics
+		std::vector<std::vector<uint64_t>> pipelineStatisticsFrames;
+		// Tracked device memory per category and driver reported heap usage (name, bytes) at the end of the run
+		std::vector<std::pair<std::string, VkDeviceSize>> memoryUsage;
+		// Results measured by the example itself (e.g. the cost of an operation), reported and compared against the baseline like the frame times, so lower values have to be better
+		// Metrics are added before the run and their values updated in place while rendering, see addMetric()
+		std::vector<std::pair<std::string, double>> metrics;
+
+		// Nearest-rank percentile of an ascending sorted list of values
+		static double percentile(const std::vector<double>& sortedValues, double p) {
+			if (sortedValues.empty()) {
+				return 0.0;
+			}
+			size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * (double)sortedValues.size()));
+			return sortedValues[std::min(std::max(rank, (size_t)1), sortedValues.size()) - 1];
+		}
+
+		FrameTimeStats getFrameTimeStats() const {
+			FrameTimeStats stats;
+			stats.framesOverBudget.resize(frameBudgets.size(), 0);
+			if (frameTimes.empty()) {
+				return stats;
+			}
+			std::vector<double> sorted(frameTimes);
+			std::sort(sorted.begin(), sorted.end());
+			stats.min = sorted.front();
+			stats.max = sorted.back();
+			stats.avg = std::accumulate(sorted.begin(), sorted.end(), 0.0) / (double)sorted.size();
+			double variance = 0.0;
+			for (auto t : sorted) {
+				variance += (t - stats.avg) * (t - stats.avg);
+			}
+			stats.stdDev = std::sqrt(variance / (double)sorted.size());
+			stats.p50 = percentile(sorted, 50.0);
+			stats.p90 = percentile(sorted, 90.0);
+			stats.p99 = percentile(sorted, 99.0);
+			stats.p999 = percentile(sorted, 99.9);
+			stats.histogram.resize(static_cast<size_t>(stats.max / histogramBucketSize) + 1, 0);
+			for (auto t : sorted) {
+				stats.histogram[static_cast<size_t>(t / histogramBucketSize)]++;
+				for (size_t i = 0; i < frameBudgets.size(); i++) {
+					if (t > frameBudgets[i]) {
+						stats.framesOverBudget[i]++;
+					}
+				}
+			}
+			return stats;
+		}
+
+		static std::string jsonString(const std::string& value) {
+			std::string escaped = "\"";
+			for (auto c : value) {
+				if ((c == '"') || (c == '\\')) {
+					escaped += '\\';
+				}
+				escaped += c;
+			}
+			return escaped + "\"";
+		}
+
+		/** @brief Add a metric reported with the results and return its index into metrics, the name should include the unit */
+		size_t addMetric(const std::string& name) {
+			metrics.push_back(std::make_pair(name, 0.0));
+			return metrics.size() - 1;
+		}
+
+		void recordGpuTimes() {
+			std::vector<double> times(gpuScopes.size(), -1.0);
+			for (auto& result : gpuProfiler.results) {
+				auto it = std::find(gpuScopes.begin(), gpuScopes.end(), result.first);
+				size_t index = std::distance(gpuScopes.begin(), it);
+				if (it == gpuScopes.end()) {
+					gpuScopes.push_back(result.first);
+					times.push_back(-1.0);
+				}
+				// Scopes with the same name are accumulated
+				times[index] = std::max(times[index], 0.0) + result.second;
+			}
+			gpuFrameTimes.push_back(times);
+		}
+
+		void recordPipelineStatistics() {
+			if (gpuProfiler.statisticsSupported) {
+				pipelineStatisticsFrames.push_back(gpuProfiler.statistics);
+			}
+		}
+
+		// Average, minimum and maximum per frame value of a pipeline statistic over all frames it has been collected for
+		bool getPipelineStatisticStats(size_t statistic, double &avg, uint64_t &min, uint64_t &max) {
+			double sum = 0.0;
+			uint32_t count = 0;
+			min = std::numeric_limits<uint64_t>::max();
+			max = 0;
+			for (auto& values : pipelineStatisticsFrames) {
+				if (statistic < values.size()) {
+					sum += (double)values[statistic];
+					min = std::min(min, values[statistic]);
+					max = std::max(max, values[statistic]);
+					count++;
+				}
+			}
+			avg = (count > 0) ? sum / (double)count : 0.0;
+			return count > 0;
+		}
+
+		// Average, minimum and maximum GPU time of a scope over all frames it has been measured in
+		bool getGpuScopeStats(size_t scope, double &tAvg, double &tMin, double &tMax) {
+			double tSum = 0.0;
+			uint32_t count = 0;
+			tMin = std::numeric_limits<double>::max();
+			tMax = 0.0;
+			for (auto& times : gpuFrameTimes) {
+				if ((scope < times.size()) && (times[scope] >= 0.0)) {
+					tSum += times[scope];
+					tMin = std::min(tMin, times[scope]);
+					tMax = std::max(tMax, times[scope]);
+					count++;
+				}
+			}
+			tAvg = (count > 0) ? tSum / (double)count : 0.0;
+			return count > 0;
+		}
+
+		bool loadSpecification(const std::string& filename) {
+			std::ifstream file(filename);
+			if (!file.is_open()) {
+				std::cerr << "Could not open benchmark specification " << filename << "\n";
+				return false;
+			}
+			specification = Specification();
+			specification.filename = filename;
+			std::string line;
+			uint32_t lineNumber = 0;
+			while (std::getline(file, line)) {
+				lineNumber++;
+				std::istringstream entry(line);
+				std::string keyword;
+				if (!(entry >> keyword) || (keyword[0] == '#')) {
+					continue;
+				}
+				bool valid = false;
+				if (keyword == "timestep") {
+					valid = (entry >> specification.timeStep) && (specification.timeStep >= 0.0);
+				}
+				else if (keyword == "key") {
+					Camera::PathKeyframe keyframe;
+					valid = (entry >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.rotation.x >> keyframe.rotation.y >> keyframe.rotation.z)
+						&& (specification.cameraPath.empty() || (keyframe.time > specification.cameraPath.back().time));
+					if (valid) {
+						specification.cameraPath.push_back(keyframe);
+					}
+				}
+				if (!valid) {
+					std::cerr << filename << ":" << lineNumber << ": invalid benchmark specification entry \"" << line << "\" (keyframes need increasing times)\n";
+					return false;
+				}
+			}
+			// The path is sampled at the animation time, which only advances with a fixed time step
+			if (!specification.cameraPath.empty() && (specification.timeStep <= 0.0)) {
+				std::cerr << filename << ": benchmark specification with a camera path needs a timestep\n";
+				return false;
+			}
+			return true;
+		}
+
+		/** @brief Animation time of the frame being rendered in the current phase, 0 without a fixed time step */
+		double specificationTime() const {
+			return phaseFrame * specification.timeStep;
+		}
 
 		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
 			active = true;
@@ -45,23 +278,35 @@ namespace vks
 			// Warm up phase to get more stable frame rates
 			{
 				double tMeasured = 0.0;
+				phaseFrame = 0;
+				warmingUp = true;
 				while (tMeasured < (warmup * 1000)) {
 					auto tStart = std::chrono::high_resolution_clock::now();
 					renderFunc();
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 					tMeasured += tDiff;
+					phaseFrame++;
 				};
 			}
 
 			// Benchmark phase
 			{
+				phaseFrame = 0;
+				warmingUp = false;
 				while (runtime < (duration * 1000.0)) {
 					auto tStart = std::chrono::high_resolution_clock::now();
+					const uint64_t allocationsStart = vks::getHeapAllocationCount();
 					renderFunc();
+					const uint64_t frameAllocations = vks::getHeapAllocationCount() - allocationsStart;
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+					heapAllocations += frameAllocations;
+					framesWithHeapAllocations += (frameAllocations > 0) ? 1 : 0;
 					runtime += tDiff;
 					frameTimes.push_back(tDiff);
+					recordGpuTimes();
+					recordPipelineStatistics();
 					frameCount++;
+					phaseFrame++;
 					if (outputFrames != -1 && outputFrames == frameCount) break;
 				};
 				std::cout << "Benchmark finished" << "\n";
@@ -69,10 +314,252 @@ namespace vks
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
 				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				FrameTimeStats stats = getFrameTimeStats();
+				std::cout << "p50    : " << stats.p50 << " ms" << "\n";
+				std::cout << "p90    : " << stats.p90 << " ms" << "\n";
+				std::cout << "p99    : " << stats.p99 << " ms" << "\n";
+				std::cout << "p99.9  : " << stats.p999 << " ms" << "\n";
+				std::cout << "stddev : " << stats.stdDev << " ms" << "\n";
+				if (vks::countsHeapAllocations()) {
+					std::cout << "allocs : " << heapAllocations << " heap allocations (" << ((frameCount > 0) ? (double)heapAllocations / (double)frameCount : 0.0) << " per frame, " << framesWithHeapAllocations << " frames allocating)" << "\n";
+				}
+				else {
+					std::cout << "allocs : not counted (build with VKS_COUNT_ALLOCATIONS)" << "\n";
+				}
+				for (size_t i = 0; i < frameBudgets.size(); i++) {
+					std::cout << "> " << frameBudgets[i] << " ms: " << stats.framesOverBudget[i] << " frames" << "\n";
+				}
+				for (size_t i = 0; i < gpuScopes.size(); i++) {
+					double tAvg, tMin, tMax;
+					if (getGpuScopeStats(i, tAvg, tMin, tMax)) {
+						std::cout << "gpu    : " << gpuScopes[i] << " " << tAvg << " ms avg (" << tMin << " min, " << tMax << " max)" << "\n";
+					}
+				}
+				const std::vector<std::string>& statisticNames = vks::GpuProfiler::statisticNames();
+				for (size_t i = 0; i < statisticNames.size(); i++) {
+					double avg;
+					uint64_t min, max;
+					if (getPipelineStatisticStats(i, avg, min, max)) {
+						std::cout << "stats  : " << statisticNames[i] << " " << avg << " per frame avg (" << min << " min, " << max << " max)" << "\n";
+					}
+				}
+				for (auto& metric : metrics) {
+					std::cout << "metric : " << metric.first << " " << metric.second << "\n";
+				}
+			}
+		}
+
+		/** @brief Store and print the input to present latencies measured during the benchmark phase */
+		void recordInputLatencies(const std::vector<double>& latencies, bool presentWait) {
+			inputLatencies = latencies;
+			inputLatencyPresentWait = presentWait;
+			if (inputLatencies.empty()) {
+				return;
+			}
+			std::vector<double> sorted(inputLatencies);
+			std::sort(sorted.begin(), sorted.end());
+			std::cout << "latency: input to " << (presentWait ? "present " : "present call ") << percentile(sorted, 50.0) << " ms p50, " << percentile(sorted, 90.0) << " ms p90, " << percentile(sorted, 99.0) << " ms p99 (" << sorted.size() << " frames)" << "\n";
+		}
+
+		/** @brief Store and print the device memory usage after the benchmark run, over budget heaps are reported on the console */
+		void recordMemoryUsage(vks::MemoryTracker& memoryTracker) {
+			memoryUsage.clear();
+			memoryUsage.push_back(std::make_pair(std::string("tracked"), memoryTracker.getTotalBytes()));
+			memoryUsage.push_back(std::make_pair(std::string("tracked peak"), memoryTracker.getPeakBytes()));
+			for (uint32_t i = 0; i < vks::memoryCategoryCount; i++) {
+				const vks::MemoryCategory category = static_cast<vks::MemoryCategory>(i);
+				memoryUsage.push_back(std::make_pair(std::string(vks::MemoryTracker::categoryName(category)), memoryTracker.getBytes(category)));
+			}
+			if (memoryTracker.budgetSupported()) {
+				std::vector<vks::MemoryHeapUsage> heaps = memoryTracker.getHeapUsage();
+				for (size_t i = 0; i < heaps.size(); i++) {
+					memoryUsage.push_back(std::make_pair("heap " + std::to_string(i) + " usage", heaps[i].usage));
+					memoryUsage.push_back(std::make_pair("heap " + std::to_string(i) + " budget", heaps[i].budget));
+					if (heaps[i].usage > heaps[i].budget) {
+						std::cout << "memory : heap " << i << " is over budget" << "\n";
+					}
+				}
+			}
+			for (auto& entry : memoryUsage) {
+				std::cout << "memory : " << entry.first << " " << (double)entry.second / (1024.0 * 1024.0) << " MiB" << "\n";
+			}
+		}
+
+		/**
+		* Compare frame time percentiles and GPU scope times against the baseline result file
+		*
+		* @return False if the baseline could not be read or at least one metric regressed beyond the threshold
+		*/
+		bool compareWithBaseline() {
+			std::ifstream baseline(baselineFilename, std::ios::in);
+			if (!baseline.is_open()) {
+				std::cerr << "Could not read benchmark baseline " << baselineFilename << "\n";
+				return false;
+			}
+			// Read the statistics and GPU scope sections of the baseline CSV
+			std::vector<std::pair<std::string, double>> baselineStats, baselineGpuScopes, baselinePipelineStatistics, baselineMetrics;
+			std::string line, section;
+			while (std::getline(baseline, line)) {
+				if (!line.empty() && (line.back() == '\r')) {
+					line.pop_back();
+				}
+				if (line.empty()) {
+					section = "";
+					continue;
+				}
+				if (section.empty()) {
+					section = line.substr(0, line.find(','));
+					continue;
+				}
+				size_t separator = line.find(',');
+				if (separator == std::string::npos) {
+					continue;
+				}
+				const std::string key = line.substr(0, separator);
+				const double value = atof(line.c_str() + separator + 1);
+				if (section == "statistic") {
+					baselineStats.push_back(std::make_pair(key, value));
+				}
+				if (section == "scope") {
+					baselineGpuScopes.push_back(std::make_pair(key, value));
+				}
+				if (section == "pipeline statistic") {
+					baselinePipelineStatistics.push_back(std::make_pair(key, value));
+				}
+				if (section == "metric") {
+					baselineMetrics.push_back(std::make_pair(key, value));
+				}
+			}
+
+			FrameTimeStats stats = getFrameTimeStats();
+			std::vector<std::pair<std::string, double>> currentStats = { { "p50", stats.p50 }, { "p90", stats.p90 }, { "p99", stats.p99 }, { "p99.9", stats.p999 } };
+			std::vector<std::pair<std::string, double>> currentGpuScopes;
+			for (size_t i = 0; i < gpuScopes.size(); i++) {
+				double tAvg, tMin, tMax;
+				if (getGpuScopeStats(i, tAvg, tMin, tMax)) {
+					currentGpuScopes.push_back(std::make_pair(gpuScopes[i], tAvg));
+				}
+			}
+			std::vector<std::pair<std::string, double>> currentPipelineStatistics;
+			for (size_t i = 0; i < vks::GpuProfiler::statisticNames().size(); i++) {
+				double avg;
+				uint64_t min, max;
+				if (getPipelineStatisticStats(i, avg, min, max)) {
+					currentPipelineStatistics.push_back(std::make_pair(vks::GpuProfiler::statisticNames()[i], avg));
+				}
+			}
+
+			bool passed = true;
+			auto compare = [&](const std::vector<std::pair<std::string, double>>& current, const std::vector<std::pair<std::string, double>>& reference, const std::string& prefix, const std::string& unit) {
+				for (auto& metric : current) {
+					auto it = std::find_if(reference.begin(), reference.end(), [&metric](const std::pair<std::string, double>& ref) { return ref.first == metric.first; });
+					if ((it == reference.end()) || (it->second <= 0.0)) {
+						continue;
+					}
+					const double change = (metric.second - it->second) / it->second * 100.0;
+					const bool regressed = change > regressionThreshold;
+					std::cout << (regressed ? "REGRESSION " : "ok         ") << prefix << metric.first << ": " << metric.second << unit << " (baseline " << it->second << unit << ", " << std::showpos << change << std::noshowpos << "%)" << "\n";
+					passed = passed && !regressed;
+				}
+			};
+			std::cout << "Comparing against baseline " << baselineFilename << " (threshold " << regressionThreshold << "%)" << "\n";
+			compare(currentStats, baselineStats, "frame time ", " ms");
+			compare(currentGpuScopes, baselineGpuScopes, "gpu ", " ms");
+			compare(currentPipelineStatistics, baselinePipelineStatistics, "", " per frame");
+			compare(metrics, baselineMetrics, "", "");
+			std::cout << (passed ? "No regressions found" : "Benchmark regressed against baseline") << "\n";
+			return passed;
+		}
+
+		void saveJsonResults() {
+			std::ofstream result(jsonFilename, std::ios::out);
+			if (!result.is_open()) {
+				std::cerr << "Could not write benchmark results to " << jsonFilename << "\n";
+				return;
+			}
+			FrameTimeStats stats = getFrameTimeStats();
+			result << std::fixed << std::setprecision(4);
+			result << "{\n";
+			result << "  \"device\": " << jsonString(deviceProps.deviceName) << ",\n";
+			result << "  \"driverversion\": " << deviceProps.driverVersion << ",\n";
+			result << "  \"duration\": " << runtime << ",\n";
+			result << "  \"frames\": " << frameCount << ",\n";
+			result << "  \"fps\": " << ((runtime > 0.0) ? frameCount / (runtime / 1000.0) : 0.0) << ",\n";
+			if (!inputLatencies.empty()) {
+				std::vector<double> sorted(inputLatencies);
+				std::sort(sorted.begin(), sorted.end());
+				result << "  \"inputlatency\": { \"presentwait\": " << (inputLatencyPresentWait ? "true" : "false") << ", \"frames\": " << sorted.size()
+					<< ", \"p50\": " << percentile(sorted, 50.0) << ", \"p90\": " << percentile(sorted, 90.0) << ", \"p99\": " << percentile(sorted, 99.0) << " },\n";
+			}
+			if (replayFrames > 0) {
+				result << "  \"replay\": { \"frames\": " << replayFrames << ", \"captured\": " << capturedFrames << " },\n";
+			}
+			if (specification.filename != "") {
+				result << "  \"specification\": { \"file\": " << jsonString(specification.filename) << ", \"timestep\": " << specification.timeStep << ", \"keyframes\": " << specification.cameraPath.size() << " },\n";
+			}
+			result << "  \"frametime\": { \"min\": " << stats.min << ", \"max\": " << stats.max << ", \"avg\": " << stats.avg << ", \"stddev\": " << stats.stdDev
+				<< ", \"p50\": " << stats.p50 << ", \"p90\": " << stats.p90 << ", \"p99\": " << stats.p99 << ", \"p99.9\": " << stats.p999 << " },\n";
+			result << "  \"budgets\": [";
+			for (size_t i = 0; i < frameBudgets.size(); i++) {
+				result << (i > 0 ? ", " : "") << "{ \"ms\": " << frameBudgets[i] << ", \"framesover\": " << stats.framesOverBudget[i] << " }";
+			}
+			result << "],\n";
+			if (vks::countsHeapAllocations()) {
+				result << "  \"heapallocations\": { \"total\": " << heapAllocations << ", \"frames\": " << framesWithHeapAllocations << " },\n";
+			}
+			result << "  \"histogram\": { \"bucketsize\": " << histogramBucketSize << ", \"frames\": [";
+			for (size_t i = 0; i < stats.histogram.size(); i++) {
+				result << (i > 0 ? ", " : "") << stats.histogram[i];
 			}
+			result << "] },\n";
+			result << "  \"gpuscopes\": [";
+			bool first = true;
+			for (size_t i = 0; i < gpuScopes.size(); i++) {
+				double tAvg, tMin, tMax;
+				if (getGpuScopeStats(i, tAvg, tMin, tMax)) {
+					result << (first ? "" : ", ") << "{ \"name\": " << jsonString(gpuScopes[i]) << ", \"avg\": " << tAvg << ", \"min\": " << tMin << ", \"max\": " << tMax << " }";
+					first = false;
+				}
+			}
+			result << "],\n";
+			result << "  \"pipelinestatistics\": [";
+			first = true;
+			for (size_t i = 0; i < vks::GpuProfiler::statisticNames().size(); i++) {
+				double avg;
+				uint64_t min, max;
+				if (getPipelineStatisticStats(i, avg, min, max)) {
+					result << (first ? "" : ", ") << "{ \"name\": " << jsonString(vks::GpuProfiler::statisticNames()[i]) << ", \"avg\": " << avg << ", \"min\": " << min << ", \"max\": " << max << " }";
+					first = false;
+				}
+			}
+			result << "],\n";
+			result << "  \"metrics\": [";
+			for (size_t i = 0; i < metrics.size(); i++) {
+				result << (i > 0 ? ", " : "") << "{ \"name\": " << jsonString(metrics[i].first) << ", \"value\": " << metrics[i].second << " }";
+			}
+			result << "],\n";
+			result << "  \"memory\": [";
+			for (size_t i = 0; i < memoryUsage.size(); i++) {
+				result << (i > 0 ? ", " : "") << "{ \"name\": " << jsonString(memoryUsage[i].first) << ", \"bytes\": " << memoryUsage[i].second << " }";
+			}
+			result << "]";
+			if (outputFrameTimes) {
+				result << ",\n  \"frametimes\": [";
+				for (size_t i = 0; i < frameTimes.size(); i++) {
+					result << (i > 0 ? ", " : "") << frameTimes[i];
+				}
+				result << "]";
+			}
+			result << "\n}\n";
 		}
 
 		void saveResults() {
+			if (jsonFilename != "") {
+				saveJsonResults();
+			}
+			if (filename == "") {
+				return;
+			}
 			std::ofstream result(filename, std::ios::out);
 			if (result.is_open()) {
 				result << std::fixed << std::setprecision(4);
@@ -80,10 +567,98 @@ namespace vks
 				result << "device,driverversion,duration (ms),frames,fps" << "\n";
 				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "\n";
 
+				FrameTimeStats stats = getFrameTimeStats();
+				result << "\n" << "statistic,ms" << "\n";
+				result << "min," << stats.min << "\n";
+				result << "max," << stats.max << "\n";
+				result << "avg," << stats.avg << "\n";
+				result << "stddev," << stats.stdDev << "\n";
+				result << "p50," << stats.p50 << "\n";
+				result << "p90," << stats.p90 << "\n";
+				result << "p99," << stats.p99 << "\n";
+				result << "p99.9," << stats.p999 << "\n";
+
+				result << "\n" << "budget (ms),frames over budget" << "\n";
+				for (size_t i = 0; i < frameBudgets.size(); i++) {
+					result << frameBudgets[i] << "," << stats.framesOverBudget[i] << "\n";
+				}
+
+				if (vks::countsHeapAllocations()) {
+					result << "\n" << "heap allocations,count" << "\n";
+					result << "total," << heapAllocations << "\n";
+					result << "frames allocating," << framesWithHeapAllocations << "\n";
+				}
+
+				result << "\n" << "histogram bucket (ms),frames" << "\n";
+				for (size_t i = 0; i < stats.histogram.size(); i++) {
+					result << (double)i * histogramBucketSize << "," << stats.histogram[i] << "\n";
+				}
+
+				if (!gpuScopes.empty()) {
+					result << "\n" << "scope,gpu avg (ms),gpu min (ms),gpu max (ms)" << "\n";
+					for (size_t i = 0; i < gpuScopes.size(); i++) {
+						double tAvg, tMin, tMax;
+						if (getGpuScopeStats(i, tAvg, tMin, tMax)) {
+							result << gpuScopes[i] << "," << tAvg << "," << tMin << "," << tMax << "\n";
+						}
+					}
+				}
+
+				const std::vector<std::string>& statisticNames = vks::GpuProfiler::statisticNames();
+				if (!pipelineStatisticsFrames.empty()) {
+					result << "\n" << "pipeline statistic,avg per frame,min,max" << "\n";
+					for (size_t i = 0; i < statisticNames.size(); i++) {
+						double avg;
+						uint64_t min, max;
+						if (getPipelineStatisticStats(i, avg, min, max)) {
+							result << statisticNames[i] << "," << avg << "," << min << "," << max << "\n";
+						}
+					}
+				}
+
+				if (!metrics.empty()) {
+					result << "\n" << "metric,value" << "\n";
+					for (auto& metric : metrics) {
+						result << metric.first << "," << metric.second << "\n";
+					}
+				}
+
+				if (!memoryUsage.empty()) {
+					result << "\n" << "memory,bytes" << "\n";
+					for (auto& entry : memoryUsage) {
+						result << entry.first << "," << entry.second << "\n";
+					}
+				}
+
 				if (outputFrameTimes) {
-					result << "\n" << "frame,ms" << "\n";
+					result << "\n" << "frame,ms";
+					for (auto& scope : gpuScopes) {
+						result << "," << scope << " (gpu ms)";
+					}
+					if (!pipelineStatisticsFrames.empty()) {
+						for (auto& name : statisticNames) {
+							result << "," << name;
+						}
+					}
+					result << "\n";
 					for (size_t i = 0; i < frameTimes.size(); i++) {
-						result << i << "," << frameTimes[i] << "\n";
+						result << i << "," << frameTimes[i];
+						for (size_t j = 0; j < gpuScopes.size(); j++) {
+							// Leave the column empty if the scope has not been measured for this frame
+							result << ",";
+							if ((i < gpuFrameTimes.size()) && (j < gpuFrameTimes[i].size()) && (gpuFrameTimes[i][j] >= 0.0)) {
+								result << gpuFrameTimes[i][j];
+							}
+						}
+						if (!pipelineStatisticsFrames.empty()) {
+							for (size_t j = 0; j < statisticNames.size(); j++) {
+								result << ",";
+								if ((i < pipelineStatisticsFrames.size()) && (j < pipelineStatisticsFrames[i].size())) {
+									result << pipelineStatisticsFrames[i][j];
+								}
+							}
+						}
+						result << "\n";
 					}
 					double tMin = *std::min_element(frameTimes.begin(), frameTimes.end());
 					double tMax = *std::max_element(frameTimes.begin(), frameTimes.end());
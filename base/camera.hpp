@@ -6,17 +6,29 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <cstdint>
+#include <vector>
 
 class Camera
 {
 private:
 	float fov;
 	float znear, zfar;
+	// Sub-pixel offset of the jittered projection in normalized device coordinates
+	glm::vec2 jitter = glm::vec2(0.0f);
+
+	void updateJitteredPerspective()
+	{
+		// Offsetting clip space x and y by the jitter times w shifts the whole image by the same amount in normalized device coordinates
+		matrices.jitteredPerspective = glm::translate(glm::mat4(1.0f), glm::vec3(jitter, 0.0f)) * matrices.perspective;
+	}
 
 	void updateViewMatrix()
 	{
@@ -64,6 +76,8 @@ public:
 	{
 		glm::mat4 perspective;
 		glm::mat4 view;
+		// Perspective with the sub-pixel offset of setJitter() applied, same as perspective without a jitter
+		glm::mat4 jitteredPerspective;
 	} matrices;
 
 	struct
@@ -96,6 +110,7 @@ public:
 		if (flipY) {
 			matrices.perspective[1][1] *= -1.0f;
 		}
+		updateJitteredPerspective();
 	};
 
 	void updateAspectRatio(float aspect)
@@ -104,6 +119,38 @@ public:
 		if (flipY) {
 			matrices.perspective[1][1] *= -1.0f;
 		}
+		updateJitteredPerspective();
+	}
+
+	// Offset the jittered projection by a sub-pixel amount (in pixels of a target of the given size) for temporal anti-aliasing, a zero offset disables the jitter
+	void setJitter(glm::vec2 pixelOffset, uint32_t targetWidth, uint32_t targetHeight)
+	{
+		jitter = pixelOffset * glm::vec2(2.0f / (float)targetWidth, 2.0f / (float)targetHeight);
+		updateJitteredPerspective();
+	}
+
+	// Current jitter in normalized device coordinates
+	glm::vec2 getJitter()
+	{
+		return jitter;
+	}
+
+	// Sub-pixel offset in [-0.5, 0.5] for a frame, from the first eight points of the Halton (2, 3) sequence, which cover a pixel evenly without repeating patterns within the cycle
+	static glm::vec2 jitterSequence(uint32_t frame)
+	{
+		auto halton = [](uint32_t index, uint32_t base) {
+			float f = 1.0f;
+			float result = 0.0f;
+			while (index > 0) {
+				f /= (float)base;
+				result += f * (float)(index % base);
+				index /= base;
+			}
+			return result;
+		};
+		// The sequence starts at one, its first point (0, 0) would be on the pixel corner
+		const uint32_t index = (frame % 8) + 1;
+		return glm::vec2(halton(index, 2), halton(index, 3)) - glm::vec2(0.5f);
 	}
 
 	void setPosition(glm::vec3 position)
@@ -136,6 +183,47 @@ public:
 		updateViewMatrix();
 	}
 
+	// Keyframe of a camera path, position and rotation (in degrees) follow the conventions of setPosition() and setRotation() for the camera's type
+	struct PathKeyframe
+	{
+		float time;
+		glm::vec3 position;
+		glm::vec3 rotation;
+	};
+
+	// Place the camera on a path of keyframes sorted by time, interpolating linearly between them and clamping to the first and last keyframe
+	void setPathTime(const std::vector<PathKeyframe>& path, float time)
+	{
+		if (path.empty())
+		{
+			return;
+		}
+		size_t next = 0;
+		while ((next < path.size()) && (path[next].time <= time))
+		{
+			next++;
+		}
+		if (next == 0)
+		{
+			position = path.front().position;
+			rotation = path.front().rotation;
+		}
+		else if (next == path.size())
+		{
+			position = path.back().position;
+			rotation = path.back().rotation;
+		}
+		else
+		{
+			const PathKeyframe& from = path[next - 1];
+			const PathKeyframe& to = path[next];
+			const float t = (time - from.time) / (to.time - from.time);
+			position = glm::mix(from.position, to.position, t);
+			rotation = glm::mix(from.rotation, to.rotation, t);
+		}
+		updateViewMatrix();
+	}
+
 	void setRotationSpeed(float rotationSpeed)
 	{
 		this->rotationSpeed = rotationSpeed;
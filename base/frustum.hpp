@@ -6,10 +6,27 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #include <array>
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
 #include <glm/glm.hpp>
 
+// SIMD paths of the batch tests, the scalar loop handles the remaining elements and platforms without them
+#if defined(__AVX__)
+#define VKS_FRUSTUM_AVX
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VKS_FRUSTUM_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define VKS_FRUSTUM_NEON
+#include <arm_neon.h>
+#endif
+
 namespace vks
 {
 	class Frustum
@@ -68,5 +85,196 @@ namespace vks
 			}
 			return true;
 		}
+
+		/**
+		* Test a batch of spheres stored as separate arrays (structure of arrays) against the frustum, with the same result as checkSphere
+		*
+		* @param x, y, z Sphere centers
+		* @param radius Sphere radii
+		* @param count Number of spheres
+		* @param visibility Receives one bit per sphere (bit i % 32 of word i / 32) that is set if the sphere is visible, needs (count + 31) / 32 words
+		*/
+		void checkSpheres(const float *x, const float *y, const float *z, const float *radius, size_t count, uint32_t *visibility) const
+		{
+			memset(visibility, 0, ((count + 31) / 32) * sizeof(uint32_t));
+			size_t i = 0;
+#if defined(VKS_FRUSTUM_AVX)
+			for (; i + 8 <= count; i += 8)
+			{
+				const __m256 px = _mm256_loadu_ps(x + i);
+				const __m256 py = _mm256_loadu_ps(y + i);
+				const __m256 pz = _mm256_loadu_ps(z + i);
+				const __m256 r = _mm256_loadu_ps(radius + i);
+				__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+				for (size_t p = 0; p < planes.size(); p++)
+				{
+					__m256 d = _mm256_add_ps(_mm256_mul_ps(px, _mm256_set1_ps(planes[p].x)), _mm256_mul_ps(py, _mm256_set1_ps(planes[p].y)));
+					d = _mm256_add_ps(d, _mm256_mul_ps(pz, _mm256_set1_ps(planes[p].z)));
+					d = _mm256_add_ps(d, _mm256_add_ps(r, _mm256_set1_ps(planes[p].w)));
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GT_OQ));
+				}
+				visibility[i / 32] |= static_cast<uint32_t>(_mm256_movemask_ps(inside)) << (i % 32);
+			}
+#endif
+#if defined(VKS_FRUSTUM_SSE)
+			for (; i + 4 <= count; i += 4)
+			{
+				const __m128 px = _mm_loadu_ps(x + i);
+				const __m128 py = _mm_loadu_ps(y + i);
+				const __m128 pz = _mm_loadu_ps(z + i);
+				const __m128 r = _mm_loadu_ps(radius + i);
+				__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				for (size_t p = 0; p < planes.size(); p++)
+				{
+					__m128 d = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(planes[p].x)), _mm_mul_ps(py, _mm_set1_ps(planes[p].y)));
+					d = _mm_add_ps(d, _mm_mul_ps(pz, _mm_set1_ps(planes[p].z)));
+					d = _mm_add_ps(d, _mm_add_ps(r, _mm_set1_ps(planes[p].w)));
+					inside = _mm_and_ps(inside, _mm_cmpgt_ps(d, _mm_setzero_ps()));
+				}
+				visibility[i / 32] |= static_cast<uint32_t>(_mm_movemask_ps(inside)) << (i % 32);
+			}
+#elif defined(VKS_FRUSTUM_NEON)
+			for (; i + 4 <= count; i += 4)
+			{
+				const float32x4_t px = vld1q_f32(x + i);
+				const float32x4_t py = vld1q_f32(y + i);
+				const float32x4_t pz = vld1q_f32(z + i);
+				const float32x4_t r = vld1q_f32(radius + i);
+				uint32x4_t inside = vdupq_n_u32(0xffffffff);
+				for (size_t p = 0; p < planes.size(); p++)
+				{
+					float32x4_t d = vaddq_f32(r, vdupq_n_f32(planes[p].w));
+					d = vmlaq_n_f32(d, px, planes[p].x);
+					d = vmlaq_n_f32(d, py, planes[p].y);
+					d = vmlaq_n_f32(d, pz, planes[p].z);
+					inside = vandq_u32(inside, vcgtq_f32(d, vdupq_n_f32(0.0f)));
+				}
+				visibility[i / 32] |= laneMask(inside) << (i % 32);
+			}
+#endif
+			for (; i < count; i++)
+			{
+				bool inside = true;
+				for (size_t p = 0; (p < planes.size()) && inside; p++)
+				{
+					inside = (planes[p].x * x[i]) + (planes[p].y * y[i]) + (planes[p].z * z[i]) + planes[p].w > -radius[i];
+				}
+				visibility[i / 32] |= (inside ? 1u : 0u) << (i % 32);
+			}
+		}
+
+		/**
+		* Test a batch of axis aligned boxes stored as separate arrays (structure of arrays) against the frustum
+		*
+		* A box is culled if it's completely behind one of the planes, so boxes near the corners of the frustum may be reported visible
+		*
+		* @param minX, minY, minZ, maxX, maxY, maxZ Box corners
+		* @param count Number of boxes
+		* @param visibility Receives one bit per box (bit i % 32 of word i / 32) that is set if the box is visible, needs (count + 31) / 32 words
+		*/
+		void checkBoxes(const float *minX, const float *minY, const float *minZ, const float *maxX, const float *maxY, const float *maxZ, size_t count, uint32_t *visibility) const
+		{
+			// The box is outside a plane if its corner furthest along the plane normal is, i.e. dot(n, center) + dot(abs(n), extent) + w <= 0
+			memset(visibility, 0, ((count + 31) / 32) * sizeof(uint32_t));
+			size_t i = 0;
+#if defined(VKS_FRUSTUM_AVX)
+			const __m256 half8 = _mm256_set1_ps(0.5f);
+			for (; i + 8 <= count; i += 8)
+			{
+				const __m256 x0 = _mm256_loadu_ps(minX + i), x1 = _mm256_loadu_ps(maxX + i);
+				const __m256 y0 = _mm256_loadu_ps(minY + i), y1 = _mm256_loadu_ps(maxY + i);
+				const __m256 z0 = _mm256_loadu_ps(minZ + i), z1 = _mm256_loadu_ps(maxZ + i);
+				const __m256 cx = _mm256_mul_ps(_mm256_add_ps(x0, x1), half8), ex = _mm256_mul_ps(_mm256_sub_ps(x1, x0), half8);
+				const __m256 cy = _mm256_mul_ps(_mm256_add_ps(y0, y1), half8), ey = _mm256_mul_ps(_mm256_sub_ps(y1, y0), half8);
+				const __m256 cz = _mm256_mul_ps(_mm256_add_ps(z0, z1), half8), ez = _mm256_mul_ps(_mm256_sub_ps(z1, z0), half8);
+				__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+				for (size_t p = 0; p < planes.size(); p++)
+				{
+					__m256 d = _mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(planes[p].x)), _mm256_mul_ps(cy, _mm256_set1_ps(planes[p].y)));
+					d = _mm256_add_ps(d, _mm256_mul_ps(cz, _mm256_set1_ps(planes[p].z)));
+					d = _mm256_add_ps(d, _mm256_mul_ps(ex, _mm256_set1_ps(fabsf(planes[p].x))));
+					d = _mm256_add_ps(d, _mm256_mul_ps(ey, _mm256_set1_ps(fabsf(planes[p].y))));
+					d = _mm256_add_ps(d, _mm256_mul_ps(ez, _mm256_set1_ps(fabsf(planes[p].z))));
+					d = _mm256_add_ps(d, _mm256_set1_ps(planes[p].w));
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GT_OQ));
+				}
+				visibility[i / 32] |= static_cast<uint32_t>(_mm256_movemask_ps(inside)) << (i % 32);
+			}
+#endif
+#if defined(VKS_FRUSTUM_SSE)
+			const __m128 half4 = _mm_set1_ps(0.5f);
+			for (; i + 4 <= count; i += 4)
+			{
+				const __m128 x0 = _mm_loadu_ps(minX + i), x1 = _mm_loadu_ps(maxX + i);
+				const __m128 y0 = _mm_loadu_ps(minY + i), y1 = _mm_loadu_ps(maxY + i);
+				const __m128 z0 = _mm_loadu_ps(minZ + i), z1 = _mm_loadu_ps(maxZ + i);
+				const __m128 cx = _mm_mul_ps(_mm_add_ps(x0, x1), half4), ex = _mm_mul_ps(_mm_sub_ps(x1, x0), half4);
+				const __m128 cy = _mm_mul_ps(_mm_add_ps(y0, y1), half4), ey = _mm_mul_ps(_mm_sub_ps(y1, y0), half4);
+				const __m128 cz = _mm_mul_ps(_mm_add_ps(z0, z1), half4), ez = _mm_mul_ps(_mm_sub_ps(z1, z0), half4);
+				__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				for (size_t p = 0; p < planes.size(); p++)
+				{
+					__m128 d = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(planes[p].x)), _mm_mul_ps(cy, _mm_set1_ps(planes[p].y)));
+					d = _mm_add_ps(d, _mm_mul_ps(cz, _mm_set1_ps(planes[p].z)));
+					d = _mm_add_ps(d, _mm_mul_ps(ex, _mm_set1_ps(fabsf(planes[p].x))));
+					d = _mm_add_ps(d, _mm_mul_ps(ey, _mm_set1_ps(fabsf(planes[p].y))));
+					d = _mm_add_ps(d, _mm_mul_ps(ez, _mm_set1_ps(fabsf(planes[p].z))));
+					d = _mm_add_ps(d, _mm_set1_ps(planes[p].w));
+					inside = _mm_and_ps(inside, _mm_cmpgt_ps(d, _mm_setzero_ps()));
+				}
+				visibility[i / 32] |= static_cast<uint32_t>(_mm_movemask_ps(inside)) << (i % 32);
+			}
+#elif defined(VKS_FRUSTUM_NEON)
+			for (; i + 4 <= count; i += 4)
+			{
+				const float32x4_t x0 = vld1q_f32(minX + i), x1 = vld1q_f32(maxX + i);
+				const float32x4_t y0 = vld1q_f32(minY + i), y1 = vld1q_f32(maxY + i);
+				const float32x4_t z0 = vld1q_f32(minZ + i), z1 = vld1q_f32(maxZ + i);
+				const float32x4_t cx = vmulq_n_f32(vaddq_f32(x0, x1), 0.5f), ex = vmulq_n_f32(vsubq_f32(x1, x0), 0.5f);
+				const float32x4_t cy = vmulq_n_f32(vaddq_f32(y0, y1), 0.5f), ey = vmulq_n_f32(vsubq_f32(y1, y0), 0.5f);
+				const float32x4_t cz = vmulq_n_f32(vaddq_f32(z0, z1), 0.5f), ez = vmulq_n_f32(vsubq_f32(z1, z0), 0.5f);
+				uint32x4_t inside = vdupq_n_u32(0xffffffff);
+				for (size_t p = 0; p < planes.size(); p++)
+				{
+					float32x4_t d = vdupq_n_f32(planes[p].w);
+					d = vmlaq_n_f32(d, cx, planes[p].x);
+					d = vmlaq_n_f32(d, cy, planes[p].y);
+					d = vmlaq_n_f32(d, cz, planes[p].z);
+					d = vmlaq_n_f32(d, ex, fabsf(planes[p].x));
+					d = vmlaq_n_f32(d, ey, fabsf(planes[p].y));
+					d = vmlaq_n_f32(d, ez, fabsf(planes[p].z));
+					inside = vandq_u32(inside, vcgtq_f32(d, vdupq_n_f32(0.0f)));
+				}
+				visibility[i / 32] |= laneMask(inside) << (i % 32);
+			}
+#endif
+			for (; i < count; i++)
+			{
+				const float cx = (minX[i] + maxX[i]) * 0.5f, ex = (maxX[i] - minX[i]) * 0.5f;
+				const float cy = (minY[i] + maxY[i]) * 0.5f, ey = (maxY[i] - minY[i]) * 0.5f;
+				const float cz = (minZ[i] + maxZ[i]) * 0.5f, ez = (maxZ[i] - minZ[i]) * 0.5f;
+				bool inside = true;
+				for (size_t p = 0; (p < planes.size()) && inside; p++)
+				{
+					inside = (planes[p].x * cx) + (planes[p].y * cy) + (planes[p].z * cz) + (fabsf(planes[p].x) * ex) + (fabsf(planes[p].y) * ey) + (fabsf(planes[p].z) * ez) + planes[p].w > 0.0f;
+				}
+				visibility[i / 32] |= (inside ? 1u : 0u) << (i % 32);
+			}
+		}
+
+		/** @brief Returns true if bit index of a visibility mask written by checkSpheres or checkBoxes is set */
+		static bool isVisible(const uint32_t *visibility, size_t index)
+		{
+			return (visibility[index / 32] & (1u << (index % 32))) != 0;
+		}
+
+	private:
+#if defined(VKS_FRUSTUM_NEON)
+		// Packs the lanes of a comparison result into the low four bits
+		static uint32_t laneMask(uint32x4_t lanes)
+		{
+			return (vgetq_lane_u32(lanes, 0) & 1u) | (vgetq_lane_u32(lanes, 1) & 2u) | (vgetq_lane_u32(lanes, 2) & 4u) | (vgetq_lane_u32(lanes, 3) & 8u);
+		}
+#endif
 	};
 }
@@ -0,0 +1,431 @@
+/*
+* Perlin and fractal noise
+*
+* Scalar evaluation of single samples and batch evaluation of many samples at once in SIMD lanes (AVX2, SSE2 or NEON, float only),
+* both paths return the same values
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdint.h>
+#include <vector>
+
+// SIMD paths of the batch noise evaluation, the scalar evaluation handles the remaining samples and platforms without them
+#if defined(__AVX2__)
+#define NOISE_SIMD_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define NOISE_SIMD_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define NOISE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+namespace vks
+{
+	// Lane operations used by the batch noise evaluation, F holds one float per lane and I one int32 per lane
+	// Comparisons return all bits set in the lanes where they are true, select() takes such a mask
+#if defined(NOISE_SIMD_AVX2)
+	struct NoiseSimdAVX2
+	{
+		typedef __m256 F;
+		typedef __m256i I;
+		static const size_t width = 8;
+		static F load(const float *p) { return _mm256_loadu_ps(p); }
+		static void store(float *p, F v) { _mm256_storeu_ps(p, v); }
+		static F set(float v) { return _mm256_set1_ps(v); }
+		static I seti(int32_t v) { return _mm256_set1_epi32(v); }
+		static F add(F a, F b) { return _mm256_add_ps(a, b); }
+		static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+		static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+		static F div(F a, F b) { return _mm256_div_ps(a, b); }
+		static F floor(F v) { return _mm256_floor_ps(v); }
+		static I toInt(F v) { return _mm256_cvttps_epi32(v); }
+		static I add(I a, I b) { return _mm256_add_epi32(a, b); }
+		static I bitAnd(I a, I b) { return _mm256_and_si256(a, b); }
+		static I bitOr(I a, I b) { return _mm256_or_si256(a, b); }
+		static I equal(I a, I b) { return _mm256_cmpeq_epi32(a, b); }
+		static I less(I a, I b) { return _mm256_cmpgt_epi32(b, a); }
+		static F select(I mask, F a, F b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask)); }
+		static I gather(const uint32_t *table, I index) { return _mm256_i32gather_epi32(reinterpret_cast<const int*>(table), index, 4); }
+	};
+#endif
+#if defined(NOISE_SIMD_SSE)
+	struct NoiseSimdSSE
+	{
+		typedef __m128 F;
+		typedef __m128i I;
+		static const size_t width = 4;
+		static F load(const float *p) { return _mm_loadu_ps(p); }
+		static void store(float *p, F v) { _mm_storeu_ps(p, v); }
+		static F set(float v) { return _mm_set1_ps(v); }
+		static I seti(int32_t v) { return _mm_set1_epi32(v); }
+		static F add(F a, F b) { return _mm_add_ps(a, b); }
+		static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+		static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+		static F div(F a, F b) { return _mm_div_ps(a, b); }
+		// SSE2 has no floor, truncate and correct the negative values that were rounded up
+		static F floor(F v)
+		{
+			const F t = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+			return _mm_sub_ps(t, _mm_and_ps(_mm_cmplt_ps(v, t), _mm_set1_ps(1.0f)));
+		}
+		static I toInt(F v) { return _mm_cvttps_epi32(v); }
+		static I add(I a, I b) { return _mm_add_epi32(a, b); }
+		static I bitAnd(I a, I b) { return _mm_and_si128(a, b); }
+		static I bitOr(I a, I b) { return _mm_or_si128(a, b); }
+		static I equal(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+		static I less(I a, I b) { return _mm_cmplt_epi32(a, b); }
+		static F select(I mask, F a, F b)
+		{
+			const F m = _mm_castsi128_ps(mask);
+			return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+		}
+		// No gather instruction, the lookups are done per lane
+		static I gather(const uint32_t *table, I index)
+		{
+			alignas(16) int32_t i[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(i), index);
+			return _mm_set_epi32(table[i[3]], table[i[2]], table[i[1]], table[i[0]]);
+		}
+	};
+#elif defined(NOISE_SIMD_NEON)
+	struct NoiseSimdNEON
+	{
+		typedef float32x4_t F;
+		typedef int32x4_t I;
+		static const size_t width = 4;
+		static F load(const float *p) { return vld1q_f32(p); }
+		static void store(float *p, F v) { vst1q_f32(p, v); }
+		static F set(float v) { return vdupq_n_f32(v); }
+		static I seti(int32_t v) { return vdupq_n_s32(v); }
+		static F add(F a, F b) { return vaddq_f32(a, b); }
+		static F sub(F a, F b) { return vsubq_f32(a, b); }
+		static F mul(F a, F b) { return vmulq_f32(a, b); }
+		// ARMv7 has no vector division, refine the reciprocal estimate instead
+		static F div(F a, F b)
+		{
+			F r = vrecpeq_f32(b);
+			r = vmulq_f32(r, vrecpsq_f32(b, r));
+			r = vmulq_f32(r, vrecpsq_f32(b, r));
+			return vmulq_f32(a, r);
+		}
+		// Truncate and correct the negative values that were rounded up (vrndmq_f32 is AArch64 only)
+		static F floor(F v)
+		{
+			const F t = vcvtq_f32_s32(vcvtq_s32_f32(v));
+			return vsubq_f32(t, vreinterpretq_f32_u32(vandq_u32(vcltq_f32(v, t), vreinterpretq_u32_f32(vdupq_n_f32(1.0f)))));
+		}
+		static I toInt(F v) { return vcvtq_s32_f32(v); }
+		static I add(I a, I b) { return vaddq_s32(a, b); }
+		static I bitAnd(I a, I b) { return vandq_s32(a, b); }
+		static I bitOr(I a, I b) { return vorrq_s32(a, b); }
+		static I equal(I a, I b) { return vreinterpretq_s32_u32(vceqq_s32(a, b)); }
+		static I less(I a, I b) { return vreinterpretq_s32_u32(vcltq_s32(a, b)); }
+		static F select(I mask, F a, F b) { return vbslq_f32(vreinterpretq_u32_s32(mask), a, b); }
+		// No gather instruction, the lookups are done per lane
+		static I gather(const uint32_t *table, I index)
+		{
+			int32_t i[4];
+			vst1q_s32(i, index);
+			const int32_t values[4] = { static_cast<int32_t>(table[i[0]]), static_cast<int32_t>(table[i[1]]), static_cast<int32_t>(table[i[2]]), static_cast<int32_t>(table[i[3]]) };
+			return vld1q_s32(values);
+		}
+	};
+#endif
+
+	// Translation of Ken Perlin's JAVA implementation (http://mrl.nyu.edu/~perlin/noise/)
+	template <typename T>
+	class PerlinNoise
+	{
+	private:
+		uint32_t permutations[512];
+		T fade(T t)
+		{
+			return t * t * t * (t * (t * (T)6 - (T)15) + (T)10);
+		}
+		T lerp(T t, T a, T b)
+		{
+			return a + t * (b - a);
+		}
+		T grad(int hash, T x, T y, T z)
+		{
+			// Convert LO 4 bits of hash code into 12 gradient directions
+			int h = hash & 15;
+			T u = h < 8 ? x : y;
+			T v = h < 4 ? y : h == 12 || h == 14 ? x : z;
+			return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
+		}
+		// Lane versions of the above, with the same operation order as the scalar ones
+		template <typename S>
+		static typename S::F fadeLanes(typename S::F t)
+		{
+			return S::mul(S::mul(S::mul(t, t), t), S::add(S::mul(t, S::sub(S::mul(t, S::set(6.0f)), S::set(15.0f))), S::set(10.0f)));
+		}
+		template <typename S>
+		static typename S::F lerpLanes(typename S::F t, typename S::F a, typename S::F b)
+		{
+			return S::add(a, S::mul(t, S::sub(b, a)));
+		}
+		template <typename S>
+		static typename S::F gradLanes(typename S::I hash, typename S::F x, typename S::F y, typename S::F z)
+		{
+			typedef typename S::F F;
+			typedef typename S::I I;
+			const I h = S::bitAnd(hash, S::seti(15));
+			const F u = S::select(S::less(h, S::seti(8)), x, y);
+			const F v = S::select(S::less(h, S::seti(4)), y, S::select(S::bitOr(S::equal(h, S::seti(12)), S::equal(h, S::seti(14))), x, z));
+			const F zero = S::set(0.0f);
+			const F su = S::select(S::equal(S::bitAnd(h, S::seti(1)), S::seti(0)), u, S::sub(zero, u));
+			const F sv = S::select(S::equal(S::bitAnd(h, S::seti(2)), S::seti(0)), v, S::sub(zero, v));
+			return S::add(su, sv);
+		}
+		// Batch evaluation in SIMD lanes, only available for float, returns the number of samples evaluated
+		size_t noiseSimd(const float *x, const float *y, const float *z, float *result, size_t count)
+		{
+			size_t i = 0;
+#if defined(NOISE_SIMD_AVX2)
+			for (; i + NoiseSimdAVX2::width <= count; i += NoiseSimdAVX2::width)
+			{
+				NoiseSimdAVX2::store(result + i, noiseLanes<NoiseSimdAVX2>(NoiseSimdAVX2::load(x + i), NoiseSimdAVX2::load(y + i), NoiseSimdAVX2::load(z + i)));
+			}
+#endif
+#if defined(NOISE_SIMD_SSE)
+			for (; i + NoiseSimdSSE::width <= count; i += NoiseSimdSSE::width)
+			{
+				NoiseSimdSSE::store(result + i, noiseLanes<NoiseSimdSSE>(NoiseSimdSSE::load(x + i), NoiseSimdSSE::load(y + i), NoiseSimdSSE::load(z + i)));
+			}
+#elif defined(NOISE_SIMD_NEON)
+			for (; i + NoiseSimdNEON::width <= count; i += NoiseSimdNEON::width)
+			{
+				NoiseSimdNEON::store(result + i, noiseLanes<NoiseSimdNEON>(NoiseSimdNEON::load(x + i), NoiseSimdNEON::load(y + i), NoiseSimdNEON::load(z + i)));
+			}
+#endif
+			return i;
+		}
+		template <typename U>
+		size_t noiseSimd(const U *x, const U *y, const U *z, U *result, size_t count)
+		{
+			return 0;
+		}
+	public:
+		explicit PerlinNoise(uint32_t seed = std::random_device{}())
+		{
+			// Generate random lookup for permutations containing all numbers from 0..255
+			std::vector<uint8_t> plookup;
+			plookup.resize(256);
+			std::iota(plookup.begin(), plookup.end(), 0);
+			std::default_random_engine rndEngine(seed);
+			std::shuffle(plookup.begin(), plookup.end(), rndEngine);
+
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				permutations[i] = permutations[256 + i] = plookup[i];
+			}
+		}
+		// 512 entries, uploaded for the compute shader generator
+		const uint32_t *getPermutations() const
+		{
+			return permutations;
+		}
+		T noise(T x, T y, T z)
+		{
+			// Find unit cube that contains point
+			int32_t X = (int32_t)floor(x) & 255;
+			int32_t Y = (int32_t)floor(y) & 255;
+			int32_t Z = (int32_t)floor(z) & 255;
+			// Find relative x,y,z of point in cube
+			x -= floor(x);
+			y -= floor(y);
+			z -= floor(z);
+
+			// Compute fade curves for each of x,y,z
+			T u = fade(x);
+			T v = fade(y);
+			T w = fade(z);
+
+			// Hash coordinates of the 8 cube corners
+			uint32_t A = permutations[X] + Y;
+			uint32_t AA = permutations[A] + Z;
+			uint32_t AB = permutations[A + 1] + Z;
+			uint32_t B = permutations[X + 1] + Y;
+			uint32_t BA = permutations[B] + Z;
+			uint32_t BB = permutations[B + 1] + Z;
+
+			// And add blended results for 8 corners of the cube;
+			T res = lerp(w, lerp(v,
+				lerp(u, grad(permutations[AA], x, y, z), grad(permutations[BA], x - 1, y, z)), lerp(u, grad(permutations[AB], x, y - 1, z), grad(permutations[BB], x - 1, y - 1, z))),
+				lerp(v, lerp(u, grad(permutations[AA + 1], x, y, z - 1), grad(permutations[BA + 1], x - 1, y, z - 1)), lerp(u, grad(permutations[AB + 1], x, y - 1, z - 1), grad(permutations[BB + 1], x - 1, y - 1, z - 1))));
+			return res;
+		}
+		// Evaluate count samples at once (x, y and z hold one coordinate per sample), in SIMD lanes where available
+		void noise(const T *x, const T *y, const T *z, T *result, size_t count)
+		{
+			size_t i = noiseSimd(x, y, z, result, count);
+			for (; i < count; i++)
+			{
+				result[i] = noise(x[i], y[i], z[i]);
+			}
+		}
+		// Noise of one sample per lane, used by the batch evaluation of this class and FractalNoise
+		template <typename S>
+		typename S::F noiseLanes(typename S::F x, typename S::F y, typename S::F z) const
+		{
+			typedef typename S::F F;
+			typedef typename S::I I;
+			// Find unit cube that contains point
+			const F fx = S::floor(x);
+			const F fy = S::floor(y);
+			const F fz = S::floor(z);
+			const I X = S::bitAnd(S::toInt(fx), S::seti(255));
+			const I Y = S::bitAnd(S::toInt(fy), S::seti(255));
+			const I Z = S::bitAnd(S::toInt(fz), S::seti(255));
+			// Find relative x,y,z of point in cube
+			x = S::sub(x, fx);
+			y = S::sub(y, fy);
+			z = S::sub(z, fz);
+
+			// Compute fade curves for each of x,y,z
+			const F u = fadeLanes<S>(x);
+			const F v = fadeLanes<S>(y);
+			const F w = fadeLanes<S>(z);
+
+			// Hash coordinates of the 8 cube corners
+			const I one = S::seti(1);
+			const I A = S::add(S::gather(permutations, X), Y);
+			const I AA = S::add(S::gather(permutations, A), Z);
+			const I AB = S::add(S::gather(permutations, S::add(A, one)), Z);
+			const I B = S::add(S::gather(permutations, S::add(X, one)), Y);
+			const I BA = S::add(S::gather(permutations, B), Z);
+			const I BB = S::add(S::gather(permutations, S::add(B, one)), Z);
+
+			// And add blended results for 8 corners of the cube
+			const F x1 = S::sub(x, S::set(1.0f));
+			const F y1 = S::sub(y, S::set(1.0f));
+			const F z1 = S::sub(z, S::set(1.0f));
+			return lerpLanes<S>(w, lerpLanes<S>(v,
+				lerpLanes<S>(u, gradLanes<S>(S::gather(permutations, AA), x, y, z), gradLanes<S>(S::gather(permutations, BA), x1, y, z)),
+				lerpLanes<S>(u, gradLanes<S>(S::gather(permutations, AB), x, y1, z), gradLanes<S>(S::gather(permutations, BB), x1, y1, z))),
+				lerpLanes<S>(v,
+				lerpLanes<S>(u, gradLanes<S>(S::gather(permutations, S::add(AA, one)), x, y, z1), gradLanes<S>(S::gather(permutations, S::add(BA, one)), x1, y, z1)),
+				lerpLanes<S>(u, gradLanes<S>(S::gather(permutations, S::add(AB, one)), x, y1, z1), gradLanes<S>(S::gather(permutations, S::add(BB, one)), x1, y1, z1))));
+		}
+	};
+
+	// Fractal noise generator based on perlin noise above
+	template <typename T>
+	class FractalNoise
+	{
+	private:
+		PerlinNoise<float> perlinNoise;
+		uint32_t octaves;
+		T frequency;
+		T amplitude;
+		T persistence;
+		// Octaves of one sample per lane, accumulated in registers
+		template <typename S>
+		void fractalLanes(const float *x, const float *y, const float *z, float *result)
+		{
+			typedef typename S::F F;
+			const F px = S::load(x);
+			const F py = S::load(y);
+			const F pz = S::load(z);
+			F sum = S::set(0.0f);
+			float frequency = 1.0f;
+			float amplitude = 1.0f;
+			float max = 0.0f;
+			for (uint32_t i = 0; i < octaves; i++)
+			{
+				const F f = S::set(frequency);
+				sum = S::add(sum, S::mul(perlinNoise.template noiseLanes<S>(S::mul(px, f), S::mul(py, f), S::mul(pz, f)), S::set(amplitude)));
+				max += amplitude;
+				amplitude *= persistence;
+				frequency *= 2.0f;
+			}
+			sum = S::div(sum, S::set(max));
+			S::store(result, S::div(S::add(sum, S::set(1.0f)), S::set(2.0f)));
+		}
+		// Batch evaluation in SIMD lanes, only available for float, returns the number of samples evaluated
+		size_t noiseSimd(const float *x, const float *y, const float *z, float *result, size_t count)
+		{
+			size_t i = 0;
+#if defined(NOISE_SIMD_AVX2)
+			for (; i + NoiseSimdAVX2::width <= count; i += NoiseSimdAVX2::width)
+			{
+				fractalLanes<NoiseSimdAVX2>(x + i, y + i, z + i, result + i);
+			}
+#endif
+#if defined(NOISE_SIMD_SSE)
+			for (; i + NoiseSimdSSE::width <= count; i += NoiseSimdSSE::width)
+			{
+				fractalLanes<NoiseSimdSSE>(x + i, y + i, z + i, result + i);
+			}
+#elif defined(NOISE_SIMD_NEON)
+			for (; i + NoiseSimdNEON::width <= count; i += NoiseSimdNEON::width)
+			{
+				fractalLanes<NoiseSimdNEON>(x + i, y + i, z + i, result + i);
+			}
+#endif
+			return i;
+		}
+		template <typename U>
+		size_t noiseSimd(const U *x, const U *y, const U *z, U *result, size_t count)
+		{
+			return 0;
+		}
+	public:
+
+		FractalNoise(const PerlinNoise<T> &perlinNoise)
+		{
+			this->perlinNoise = perlinNoise;
+			octaves = 6;
+			persistence = (T)0.5;
+		}
+
+		uint32_t getOctaves() const
+		{
+			return octaves;
+		}
+
+		T getPersistence() const
+		{
+			return persistence;
+		}
+
+		T noise(T x, T y, T z)
+		{
+			T sum = 0;
+			T frequency = (T)1;
+			T amplitude = (T)1;
+			T max = (T)0;
+			for (uint32_t i = 0; i < octaves; i++)
+			{
+				sum += perlinNoise.noise(x * frequency, y * frequency, z * frequency) * amplitude;
+				max += amplitude;
+				amplitude *= persistence;
+				frequency *= (T)2;
+			}
+
+			sum = sum / max;
+			return (sum + (T)1.0) / (T)2.0;
+		}
+
+		// Evaluate count samples at once (x, y and z hold one coordinate per sample), in SIMD lanes where available
+		void noise(const T *x, const T *y, const T *z, T *result, size_t count)
+		{
+			size_t i = noiseSimd(x, y, z, result, count);
+			for (; i < count; i++)
+			{
+				result[i] = noise(x[i], y[i], z[i]);
+			}
+		}
+	};
+}
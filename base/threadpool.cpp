@@ -0,0 +1,308 @@
+/*
+* CPU topology detection and thread placement for the thread pool
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "threadpool.hpp"
+#include <fstream>
+#include <map>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <sys/qos.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace vks
+{
+	namespace
+	{
+		// Cores whose performance is within this ratio of each other are of the same class, so boost clock differences between the cores of a homogeneous CPU don't split it
+		const double performanceClassRatio = 0.85;
+
+#if defined(__linux__)
+		bool readValue(const std::string& filename, uint64_t& value)
+		{
+			std::ifstream file(filename);
+			return static_cast<bool>(file >> value);
+		}
+
+		// First processor of a list like "0-7,16-23", which identifies the group of processors sharing a resource
+		bool readFirstListEntry(const std::string& filename, uint32_t& value)
+		{
+			std::ifstream file(filename);
+			return static_cast<bool>(file >> value);
+		}
+#endif
+	}
+
+	CpuTopology::CpuTopology()
+	{
+		// Relative performance of each processor, turned into classes below
+		std::vector<uint64_t> performance;
+#if defined(_WIN32)
+		DWORD length = 0;
+		GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+		std::vector<uint8_t> buffer(length);
+		if ((length > 0) && GetLogicalProcessorInformationEx(RelationAll, reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data()), &length))
+		{
+			// Processors are numbered 64 per processor group
+			uint32_t cacheDomain = 0;
+			std::vector<std::pair<uint32_t, uint32_t>> processorCaches;
+			uint32_t core = 0;
+			for (DWORD offset = 0; offset < length;)
+			{
+				const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+				if (info->Relationship == RelationProcessorCore)
+				{
+					uint32_t thread = 0;
+					for (WORD group = 0; group < info->Processor.GroupCount; group++)
+					{
+						const GROUP_AFFINITY& affinity = info->Processor.GroupMask[group];
+						for (uint32_t bit = 0; bit < 64; bit++)
+						{
+							if (affinity.Mask & (KAFFINITY(1) << bit))
+							{
+								Processor processor;
+								processor.index = affinity.Group * 64 + bit;
+								processor.core = core;
+								processor.thread = thread++;
+								processors.push_back(processor);
+								// Higher efficiency classes are faster cores
+								performance.push_back(info->Processor.EfficiencyClass);
+							}
+						}
+					}
+					core++;
+				}
+				if ((info->Relationship == RelationCache) && (info->Cache.Level == 3))
+				{
+					const GROUP_AFFINITY& affinity = info->Cache.GroupMask;
+					const uint32_t domain = cacheDomain++;
+					for (uint32_t bit = 0; bit < 64; bit++)
+					{
+						if (affinity.Mask & (KAFFINITY(1) << bit))
+						{
+							processorCaches.push_back(std::make_pair(affinity.Group * 64 + bit, domain));
+						}
+					}
+				}
+				offset += info->Size;
+			}
+			for (auto& processorCache : processorCaches)
+			{
+				for (auto& processor : processors)
+				{
+					if (processor.index == processorCache.first)
+					{
+						processor.cacheDomain = processorCache.second;
+					}
+				}
+			}
+			affinitySupported = true;
+		}
+#elif defined(__linux__)
+		// Also covers Android, sysfs reports the capacity (big.LITTLE) or the maximum frequency of each processor
+		// Only processors the process may run on are considered (e.g. when started with taskset)
+		cpu_set_t available;
+		CPU_ZERO(&available);
+		if (sched_getaffinity(0, sizeof(available), &available) != 0)
+		{
+			const uint32_t count = std::min(std::max(std::thread::hardware_concurrency(), 1u), static_cast<uint32_t>(CPU_SETSIZE));
+			for (uint32_t i = 0; i < count; i++)
+			{
+				CPU_SET(i, &available);
+			}
+		}
+		std::map<uint64_t, uint32_t> cores;
+		for (uint32_t i = 0; i < CPU_SETSIZE; i++)
+		{
+			if (!CPU_ISSET(i, &available))
+			{
+				continue;
+			}
+			const std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(i) + "/";
+			Processor processor;
+			processor.index = i;
+			uint64_t coreId = i, packageId = 0;
+			readValue(path + "topology/core_id", coreId);
+			readValue(path + "topology/physical_package_id", packageId);
+			const uint64_t coreKey = (packageId << 32) | coreId;
+			if (cores.find(coreKey) == cores.end())
+			{
+				const uint32_t core = static_cast<uint32_t>(cores.size());
+				cores[coreKey] = core;
+			}
+			processor.core = cores[coreKey];
+			for (const Processor& other : processors)
+			{
+				if (other.core == processor.core)
+				{
+					processor.thread++;
+				}
+			}
+			readFirstListEntry(path + "cache/index3/shared_cpu_list", processor.cacheDomain);
+			uint64_t value = 0;
+			if (!readValue(path + "cpu_capacity", value))
+			{
+				readValue(path + "cpufreq/cpuinfo_max_freq", value);
+			}
+			processors.push_back(processor);
+			performance.push_back(value);
+		}
+		affinitySupported = true;
+#else
+		// Apple platforms don't expose which logical processor belongs to which core type and don't support affinities, threads are placed with quality of service classes instead
+		const uint32_t count = std::max(std::thread::hardware_concurrency(), 1u);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			Processor processor;
+			processor.index = i;
+			processor.core = i;
+			processors.push_back(processor);
+			performance.push_back(0);
+		}
+#endif
+
+		// Group the processors into classes, starting from the fastest one
+		std::vector<uint64_t> sorted = performance;
+		std::sort(sorted.begin(), sorted.end(), std::greater<uint64_t>());
+		std::vector<uint64_t> classFloors;
+		for (uint64_t value : sorted)
+		{
+			if (classFloors.empty() || (static_cast<double>(value) < static_cast<double>(classFloors.back()) * performanceClassRatio))
+			{
+				classFloors.push_back(value);
+			}
+			else
+			{
+				classFloors.back() = value;
+			}
+		}
+		performanceClassCount = std::max(static_cast<uint32_t>(classFloors.size()), 1u);
+		for (size_t i = 0; i < processors.size(); i++)
+		{
+			uint32_t rank = 0;
+			while ((rank + 1 < classFloors.size()) && (performance[i] < classFloors[rank]))
+			{
+				rank++;
+			}
+			// 0 is the slowest class
+			processors[i].performanceClass = performanceClassCount - 1 - rank;
+		}
+		// Cache domains are numbered by the first processor sharing the cache, renumber them from 0
+		std::map<uint32_t, uint32_t> domains;
+		for (auto& processor : processors)
+		{
+			if (domains.find(processor.cacheDomain) == domains.end())
+			{
+				const uint32_t domain = static_cast<uint32_t>(domains.size());
+				domains[processor.cacheDomain] = domain;
+			}
+			processor.cacheDomain = domains[processor.cacheDomain];
+		}
+	}
+
+	const CpuTopology& CpuTopology::get()
+	{
+		static const CpuTopology topology;
+		return topology;
+	}
+
+	/**
+	* Logical processors of a core class, in the order threads should be pinned to them
+	*
+	* One thread per physical core comes first (SMT siblings after all cores), and the processors of a cache domain (e.g. a CCD) are
+	* kept together so threads working on the same data share their last level cache. Without different core types both classes are all processors.
+	*/
+	std::vector<uint32_t> CpuTopology::getProcessors(CoreClass coreClass) const
+	{
+		std::vector<const Processor*> selected;
+		for (const Processor& processor : processors)
+		{
+			if ((coreClass == CoreClass::Any)
+				|| ((coreClass == CoreClass::Performance) && (processor.performanceClass == performanceClassCount - 1))
+				|| ((coreClass == CoreClass::Efficiency) && (processor.performanceClass == 0)))
+				{
+				selected.push_back(&processor);
+			}
+		}
+		std::stable_sort(selected.begin(), selected.end(), [](const Processor* a, const Processor* b) {
+			if (a->thread != b->thread)
+			{
+				return a->thread < b->thread;
+			}
+			if (a->performanceClass != b->performanceClass)
+			{
+				return a->performanceClass > b->performanceClass;
+			}
+			return a->cacheDomain < b->cacheDomain;
+		});
+		std::vector<uint32_t> indices;
+		for (const Processor* processor : selected)
+		{
+			indices.push_back(processor->index);
+		}
+		return indices;
+	}
+
+	bool CpuTopology::heterogeneous() const
+	{
+		return performanceClassCount > 1;
+	}
+
+	/** @brief Restrict the calling thread to the given logical processors (all if empty) and set its scheduling class where affinities aren't supported */
+	bool CpuTopology::setCurrentThreadAffinity(const std::vector<uint32_t>& processorIndices, CoreClass coreClass)
+	{
+		// Only the Apple scheduler selects cores by class, elsewhere the processor indices already belong to the requested class
+		(void)coreClass;
+#if defined(_WIN32)
+		if (processorIndices.empty())
+		{
+			return true;
+		}
+		// A thread can only be restricted to processors of a single group
+		GROUP_AFFINITY affinity{};
+		affinity.Group = static_cast<WORD>(processorIndices[0] / 64);
+		for (uint32_t index : processorIndices)
+		{
+			if (index / 64 == affinity.Group)
+			{
+				affinity.Mask |= KAFFINITY(1) << (index % 64);
+			}
+		}
+		return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#elif defined(__APPLE__)
+		if (coreClass == CoreClass::Any)
+		{
+			return true;
+		}
+		return pthread_set_qos_class_self_np((coreClass == CoreClass::Performance) ? QOS_CLASS_USER_INTERACTIVE : QOS_CLASS_UTILITY, 0) == 0;
+#elif defined(__linux__)
+		if (processorIndices.empty())
+		{
+			return true;
+		}
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (uint32_t index : processorIndices)
+		{
+			if (index < CPU_SETSIZE)
+			{
+				CPU_SET(index, &set);
+			}
+		}
+		// Pid 0 is the calling thread
+		return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+		return false;
+#endif
+	}
+}
@@ -1,17 +1,27 @@
 /*
-* Basic C++11 based thread pool with per-thread job queues
+* Basic C++11 based work stealing thread pool
 *
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #include <vector>
+#include <algorithm>
 #include <thread>
-#include <queue>
+#include <deque>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <functional>
+#include <memory>
+#include <cstddef>
+#include <type_traits>
+#include <string>
+#include <chrono>
+#include "VulkanTrace.h"
 
 // make_unique is not available in C++11
 // Taken from Herb Sutter's blog (https://herbsutter.com/gotw/_102/)
@@ -23,98 +33,668 @@ std::unique_ptr<T> make_unique(Args&& ...args)
 
 namespace vks
 {
-	class Thread
+	/** @brief Number of unfinished jobs added with this counter, can be waited on with ThreadPool::wait(JobCounter&) */
+	class JobCounter
+	{
+	private:
+		friend class ThreadPool;
+		std::atomic<uint32_t> pending{ 0 };
+	public:
+		bool done() const
+		{
+			return pending.load(std::memory_order_acquire) == 0;
+		}
+	};
+
+	/**
+	* Lock-free work stealing deque (Chase-Lev)
+	*
+	* The owning worker pushes and pops jobs at the bottom, other threads steal the oldest jobs from the top
+	* The ring buffer grows when full, replaced buffers are kept until destruction as thieves may still read from them
+	*/
+	template<typename T>
+	class WorkStealingQueue
+	{
+	private:
+		struct Ring
+		{
+			int64_t capacity;
+			std::unique_ptr<std::atomic<T*>[]> items;
+			explicit Ring(int64_t capacity) : capacity(capacity), items(new std::atomic<T*>[capacity]) {}
+			T* get(int64_t index) const
+			{
+				return items[index & (capacity - 1)].load(std::memory_order_acquire);
+			}
+			void put(int64_t index, T* item)
+			{
+				items[index & (capacity - 1)].store(item, std::memory_order_release);
+			}
+		};
+		std::atomic<int64_t> top{ 0 };
+		std::atomic<int64_t> bottom{ 0 };
+		std::atomic<Ring*> ring;
+		std::vector<std::unique_ptr<Ring>> rings;
+	public:
+		WorkStealingQueue(int64_t capacity = 256)
+		{
+			rings.push_back(make_unique<Ring>(capacity));
+			ring.store(rings.back().get(), std::memory_order_relaxed);
+		}
+
+		// Owner only
+		void push(T* item)
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed);
+			const int64_t t = top.load(std::memory_order_acquire);
+			Ring* r = ring.load(std::memory_order_relaxed);
+			if (b - t > r->capacity - 1)
+			{
+				rings.push_back(make_unique<Ring>(r->capacity * 2));
+				Ring* grown = rings.back().get();
+				for (int64_t i = t; i < b; i++)
+				{
+					grown->put(i, r->get(i));
+				}
+				ring.store(grown, std::memory_order_release);
+				r = grown;
+			}
+			r->put(b, item);
+			bottom.store(b + 1, std::memory_order_release);
+		}
+
+		// Owner only, returns nullptr if the queue is empty
+		T* pop()
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			Ring* r = ring.load(std::memory_order_relaxed);
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_relaxed);
+			if (t > b)
+			{
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+			T* item = r->get(b);
+			if (t == b)
+			{
+				// Last item, race against thieves for it
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					item = nullptr;
+				}
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+			return item;
+		}
+
+		// Any thread, returns nullptr if the queue is empty or the item has been taken by another thread
+		T* steal()
+		{
+			int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t b = bottom.load(std::memory_order_acquire);
+			if (t >= b)
+			{
+				return nullptr;
+			}
+			Ring* r = ring.load(std::memory_order_acquire);
+			T* item = r->get(t);
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				return nullptr;
+			}
+			return item;
+		}
+	};
+
+	/** @brief Type of cores a thread should run on, heterogeneous CPUs (hybrid x86, big.LITTLE, Apple silicon) have faster and more power efficient ones */
+	enum class CoreClass
+	{
+		Any,
+		// Fastest cores, for jobs on the critical path of a frame
+		Performance,
+		// Slowest cores, for background work like streaming and asset loading
+		Efficiency
+	};
+
+	/**
+	* Logical processors of the system, grouped by core type, physical core and last level cache
+	*
+	* Detected once on first use: from sysfs on Linux and Android (cpu_capacity, or the maximum frequency), from GetLogicalProcessorInformationEx
+	* on Windows (EfficiencyClass). Apple platforms don't report core types, threads are steered with quality of service classes there instead
+	*/
+	class CpuTopology
+	{
+	public:
+		struct Processor
+		{
+			uint32_t index = 0;
+			// 0 is the slowest class, all processors have class 0 on homogeneous CPUs
+			uint32_t performanceClass = 0;
+			// Processors sharing the last level cache have the same domain
+			uint32_t cacheDomain = 0;
+			uint32_t core = 0;
+			// SMT thread of the core
+			uint32_t thread = 0;
+		};
+		std::vector<Processor> processors;
+		uint32_t performanceClassCount = 1;
+		// False if threads can't be pinned to processors (Apple platforms)
+		bool affinitySupported = false;
+
+		static const CpuTopology& get();
+		std::vector<uint32_t> getProcessors(CoreClass coreClass) const;
+		bool heterogeneous() const;
+		static bool setCurrentThreadAffinity(const std::vector<uint32_t>& processorIndices, CoreClass coreClass);
+	private:
+		CpuTopology();
+	};
+
+	/**
+	* Thread pool with a work stealing deque per worker
+	*
+	* Jobs added from a worker go to its own deque, jobs added from other threads go to a shared queue, idle workers steal from the others
+	* Threads waiting for jobs to finish run pending jobs in the meantime, so jobs may add and wait for other jobs without deadlocking
+	* Workers can be restricted to a core class and pinned to single processors, see setThreadCount
+	*/
+	class ThreadPool
 	{
 	private:
-		bool destroying = false;
-		std::thread worker;
-		std::queue<std::function<void()>> jobQueue;
-		std::mutex queueMutex;
-		std::condition_variable condition;
+		/*
+			Jobs live in a pooled arena and store small callables inline, so adding a job doesn't allocate
+		*/
+		struct Job
+		{
+			static const size_t storageSize = 64;
+			typename std::aligned_storage<storageSize, alignof(std::max_align_t)>::type storage;
+			void (*invoke)(Job* job);
+			void (*destroy)(Job* job);
+			// Optional counter of the caller, the pool counter is always decremented
+			JobCounter* counter;
+			// Next job in a free list of the arena
+			Job* next;
+		};
+		struct JobCache
+		{
+			Job* head = nullptr;
+			uint32_t count = 0;
+		};
+		static const uint32_t jobBatchSize = 64;
+		struct Worker
+		{
+			WorkStealingQueue<Job> queue;
+			std::thread thread;
+			// Processors the worker may run on, empty for no restriction
+			std::vector<uint32_t> processors;
+			// Written by the worker only, read for statistics
+			std::atomic<uint64_t> jobCount{ 0 };
+			std::atomic<uint64_t> busyNanoseconds{ 0 };
+		};
+		std::vector<std::unique_ptr<Worker>> workers;
+		CoreClass coreClass = CoreClass::Any;
+		std::chrono::steady_clock::time_point statisticsStart = std::chrono::steady_clock::now();
+		// Jobs added from threads that are not workers of this pool
+		std::deque<Job*> sharedQueue;
+		std::mutex sharedQueueMutex;
+		// Jobs not taken by a thread yet, idle workers sleep while this is zero
+		std::atomic<uint32_t> queuedJobs{ 0 };
+		std::atomic<uint32_t> sleepingWorkers{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+		std::atomic<bool> destroying{ false };
+		// Counter of all unfinished jobs of the pool
+		JobCounter poolCounter;
+		// Job arena: blocks of jobBatchSize jobs, free jobs are cached per worker and exchanged in batches through the shared free list
+		std::vector<std::unique_ptr<Job[]>> jobBlocks;
+		std::vector<Job*> freeJobBatches;
+		std::mutex arenaMutex;
+		// One cache per worker plus one shared by all threads outside the pool, which is guarded by externalCacheMutex
+		std::vector<JobCache> jobCaches;
+		std::mutex externalCacheMutex;
+
+		struct WorkerContext
+		{
+			const ThreadPool* pool;
+			uint32_t index;
+		};
+		static WorkerContext& currentContext()
+		{
+			static thread_local WorkerContext context = { nullptr, 0 };
+			return context;
+		}
+
+		// Caller has to hold externalCacheMutex for the external cache
+		Job* allocateJob(JobCache& cache)
+		{
+			if (!cache.head)
+			{
+				std::lock_guard<std::mutex> lock(arenaMutex);
+				if (freeJobBatches.empty())
+				{
+					jobBlocks.push_back(std::unique_ptr<Job[]>(new Job[jobBatchSize]));
+					freeJobBatches.push_back(linkBlock(jobBlocks.back().get()));
+				}
+				cache.head = freeJobBatches.back();
+				cache.count = jobBatchSize;
+				freeJobBatches.pop_back();
+			}
+			Job* job = cache.head;
+			cache.head = job->next;
+			cache.count--;
+			return job;
+		}
 
-		// Loop through all remaining jobs
-		void queueLoop()
+		// Caller has to hold externalCacheMutex for the external cache
+		void releaseJob(JobCache& cache, Job* job)
 		{
-			while (true)
+			job->next = cache.head;
+			cache.head = job;
+			cache.count++;
+			// Threads that mostly run jobs added by others hand surplus jobs back for reuse
+			if (cache.count >= jobBatchSize * 2)
 			{
-				std::function<void()> job;
+				Job* batch = cache.head;
+				Job* last = batch;
+				for (uint32_t i = 1; i < jobBatchSize; i++)
 				{
-					std::unique_lock<std::mutex> lock(queueMutex);
-					condition.wait(lock, [this] { return !jobQueue.empty() || destroying; });
-					if (destroying)
+					last = last->next;
+				}
+				cache.head = last->next;
+				cache.count -= jobBatchSize;
+				last->next = nullptr;
+				std::lock_guard<std::mutex> lock(arenaMutex);
+				freeJobBatches.push_back(batch);
+			}
+		}
+
+		static Job* linkBlock(Job* block)
+		{
+			for (uint32_t i = 0; i < jobBatchSize; i++)
+			{
+				block[i].next = (i + 1 < jobBatchSize) ? &block[i + 1] : nullptr;
+			}
+			return block;
+		}
+
+		template<typename F>
+		static void setJobFunction(Job* job, F&& function)
+		{
+			typedef typename std::decay<F>::type Function;
+			setJobFunction(job, std::forward<F>(function), std::integral_constant<bool, (sizeof(Function) <= Job::storageSize) && (alignof(Function) <= alignof(std::max_align_t))>());
+		}
+
+		template<typename F>
+		static void setJobFunction(Job* job, F&& function, std::true_type /* fitsInline */)
+		{
+			typedef typename std::decay<F>::type Function;
+			new (&job->storage) Function(std::forward<F>(function));
+			job->invoke = [](Job* job) { (*reinterpret_cast<Function*>(&job->storage))(); };
+			job->destroy = [](Job* job) { reinterpret_cast<Function*>(&job->storage)->~Function(); };
+		}
+
+		// Large callables are the only case that still allocates
+		template<typename F>
+		static void setJobFunction(Job* job, F&& function, std::false_type /* fitsInline */)
+		{
+			typedef typename std::decay<F>::type Function;
+			*reinterpret_cast<Function**>(&job->storage) = new Function(std::forward<F>(function));
+			job->invoke = [](Job* job) { (**reinterpret_cast<Function**>(&job->storage))(); };
+			job->destroy = [](Job* job) { delete *reinterpret_cast<Function**>(&job->storage); };
+		}
+
+		Job* findJob(uint32_t workerIndex)
+		{
+			Job* job = nullptr;
+			const uint32_t workerCount = static_cast<uint32_t>(workers.size());
+			if (workerIndex < workerCount)
+			{
+				job = workers[workerIndex]->queue.pop();
+			}
+			if (!job && (queuedJobs.load(std::memory_order_relaxed) > 0))
+			{
+				{
+					std::lock_guard<std::mutex> lock(sharedQueueMutex);
+					if (!sharedQueue.empty())
 					{
-						break;
+						job = sharedQueue.front();
+						sharedQueue.pop_front();
 					}
-					job = jobQueue.front();
 				}
+				for (uint32_t i = 1; !job && (i <= workerCount); i++)
+				{
+					job = workers[(workerIndex + i) % workerCount]->queue.steal();
+				}
+			}
+			if (job)
+			{
+				queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			}
+			return job;
+		}
 
-				job();
+		void execute(Job* job, uint32_t workerIndex)
+		{
+			const bool isWorker = (workerIndex < getThreadCount());
+			const std::chrono::steady_clock::time_point start = isWorker ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+			{
+				VKS_TRACE_SCOPE("job");
+				job->invoke(job);
+			}
+			job->destroy(job);
+			JobCounter* counter = job->counter;
+			// Return the job to the arena before signaling, a waiting thread may destroy the pool right after
+			if (isWorker)
+			{
+				Worker& worker = *workers[workerIndex];
+				worker.busyNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+				worker.jobCount.fetch_add(1, std::memory_order_relaxed);
+				releaseJob(jobCaches[workerIndex], job);
+			}
+			else
+			{
+				std::lock_guard<std::mutex> lock(externalCacheMutex);
+				releaseJob(jobCaches.back(), job);
+			}
+			if (counter)
+			{
+				counter->pending.fetch_sub(1, std::memory_order_release);
+			}
+			poolCounter.pending.fetch_sub(1, std::memory_order_release);
+		}
 
+		void workerLoop(uint32_t index)
+		{
+			currentContext() = { this, index };
+			vks::Tracer::setThreadName("worker " + std::to_string(index));
+			CpuTopology::setCurrentThreadAffinity(workers[index]->processors, coreClass);
+			while (!destroying.load(std::memory_order_acquire))
+			{
+				if (Job* job = findJob(index))
 				{
-					std::lock_guard<std::mutex> lock(queueMutex);
-					jobQueue.pop();
-					condition.notify_one();
+					execute(job, index);
+					continue;
 				}
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				sleepingWorkers.fetch_add(1);
+				sleepCondition.wait(lock, [this] { return (queuedJobs.load() > 0) || destroying.load(); });
+				sleepingWorkers.fetch_sub(1);
 			}
 		}
 
-	public:
-		Thread()
+		// Queue jobs that have been set up, waking up at most one sleeping worker per job
+		void submit(Job** jobs, uint32_t count)
+		{
+			queuedJobs.fetch_add(count);
+			const uint32_t workerIndex = getWorkerIndex();
+			if (workerIndex < getThreadCount())
+			{
+				for (uint32_t i = 0; i < count; i++)
+				{
+					workers[workerIndex]->queue.push(jobs[i]);
+				}
+			}
+			else
+			{
+				std::lock_guard<std::mutex> lock(sharedQueueMutex);
+				sharedQueue.insert(sharedQueue.end(), jobs, jobs + count);
+			}
+			if (sleepingWorkers.load() > 0)
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				if (count == 1)
+				{
+					sleepCondition.notify_one();
+				}
+				else
+				{
+					sleepCondition.notify_all();
+				}
+			}
+		}
+
+		void addRange(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)>& function, JobCounter& counter)
 		{
-			worker = std::thread(&Thread::queueLoop, this);
+			addJob([this, begin, end, grainSize, &function, &counter] {
+				// Keep splitting off the upper half for other workers to steal until the range is small enough
+				size_t rangeEnd = end;
+				while (rangeEnd - begin > grainSize)
+				{
+					const size_t middle = begin + (rangeEnd - begin) / 2;
+					addRange(middle, rangeEnd, grainSize, function, counter);
+					rangeEnd = middle;
+				}
+				function(begin, rangeEnd);
+			}, &counter);
 		}
 
-		~Thread()
+		void stopWorkers()
 		{
-			if (worker.joinable())
+			wait();
 			{
-				wait();
-				queueMutex.lock();
+				std::lock_guard<std::mutex> lock(sleepMutex);
 				destroying = true;
-				condition.notify_one();
-				queueMutex.unlock();
-				worker.join();
 			}
+			sleepCondition.notify_all();
+			for (auto& worker : workers)
+			{
+				worker->thread.join();
+			}
+			workers.clear();
+			destroying = false;
+			// All jobs are free again, every arena block becomes a free batch
+			freeJobBatches.clear();
+			for (auto& block : jobBlocks)
+			{
+				freeJobBatches.push_back(linkBlock(block.get()));
+			}
+			jobCaches.assign(1, JobCache());
 		}
 
-		// Add a new job to the thread's queue
-		void addJob(std::function<void()> function)
+	public:
+		ThreadPool()
 		{
-			std::lock_guard<std::mutex> lock(queueMutex);
-			jobQueue.push(std::move(function));
-			condition.notify_one();
+			jobCaches.resize(1);
 		}
 
-		// Wait until all work items have been finished
-		void wait()
+		~ThreadPool()
 		{
-			std::unique_lock<std::mutex> lock(queueMutex);
-			condition.wait(lock, [this]() { return jobQueue.empty(); });
+			stopWorkers();
 		}
-	};
-	
-	class ThreadPool
-	{
-	public:
-		std::vector<std::unique_ptr<Thread>> threads;
 
-		// Sets the number of threads to be allocated in this pool
-		void setThreadCount(uint32_t count)
+		/**
+		* Sets the number of threads to be allocated in this pool
+		*
+		* @param count Number of worker threads
+		* @param coreClass Type of cores the workers are restricted to, e.g. Efficiency for background streaming (only restricts on heterogeneous CPUs)
+		* @param pinThreads Pin each worker to a single processor of the core class (one per physical core first, then SMT siblings), so the OS can't
+		* migrate it and its caches stay warm. Should not be used with more workers than processors, as pinned workers can't be balanced
+		*/
+		void setThreadCount(uint32_t count, CoreClass coreClass = CoreClass::Any, bool pinThreads = false)
 		{
-			threads.clear();
-			for (auto i = 0; i < count; i++)
+			stopWorkers();
+			this->coreClass = coreClass;
+			jobCaches.assign(count + 1, JobCache());
+			const CpuTopology& topology = CpuTopology::get();
+			std::vector<uint32_t> processors;
+			if (topology.affinitySupported && (pinThreads || topology.heterogeneous()))
 			{
-				threads.push_back(make_unique<Thread>());
+				processors = topology.getProcessors(coreClass);
 			}
+			for (uint32_t i = 0; i < count; i++)
+			{
+				workers.push_back(make_unique<Worker>());
+				if (pinThreads && !processors.empty())
+				{
+					workers[i]->processors.push_back(processors[i % processors.size()]);
+				}
+				else
+				{
+					workers[i]->processors = processors;
+				}
+			}
+			resetWorkerStatistics();
+			// Start the threads after all workers exist, as they steal from each other
+			for (uint32_t i = 0; i < count; i++)
+			{
+				workers[i]->thread = std::thread(&ThreadPool::workerLoop, this, i);
+			}
+		}
+
+		uint32_t getThreadCount() const
+		{
+			return static_cast<uint32_t>(workers.size());
 		}
 
-		// Wait until all threads have finished their work items
+		struct WorkerStatistics
+		{
+			uint64_t jobCount;
+			// Time spent running jobs in milliseconds
+			double busyTime;
+			// Fraction of the time since the last reset the worker spent running jobs
+			float utilization;
+			// Processor the worker is pinned to, -1 if it isn't pinned
+			int32_t processor;
+		};
+
+		// Per worker job counts and utilization since the last call to resetWorkerStatistics (or setThreadCount)
+		std::vector<WorkerStatistics> getWorkerStatistics() const
+		{
+			const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - statisticsStart).count();
+			std::vector<WorkerStatistics> statistics;
+			for (auto& worker : workers)
+			{
+				WorkerStatistics workerStatistics;
+				workerStatistics.jobCount = worker->jobCount.load(std::memory_order_relaxed);
+				workerStatistics.busyTime = worker->busyNanoseconds.load(std::memory_order_relaxed) / 1.0e6;
+				workerStatistics.utilization = (elapsed > 0.0) ? static_cast<float>(std::min(workerStatistics.busyTime / elapsed, 1.0)) : 0.0f;
+				workerStatistics.processor = (worker->processors.size() == 1) ? static_cast<int32_t>(worker->processors[0]) : -1;
+				statistics.push_back(workerStatistics);
+			}
+			return statistics;
+		}
+
+		void resetWorkerStatistics()
+		{
+			for (auto& worker : workers)
+			{
+				worker->jobCount.store(0, std::memory_order_relaxed);
+				worker->busyNanoseconds.store(0, std::memory_order_relaxed);
+			}
+			statisticsStart = std::chrono::steady_clock::now();
+		}
+
+		// Index of the calling worker thread, getThreadCount() for threads that are not part of this pool
+		// Can be used to select per-thread resources (like command pools) in jobs, which may run on any worker
+		uint32_t getWorkerIndex() const
+		{
+			const WorkerContext& context = currentContext();
+			return (context.pool == this) ? context.index : getThreadCount();
+		}
+
+		// Add a new job, counter (optional) is incremented now and decremented once the job has finished
+		template<typename F>
+		void addJob(F&& function, JobCounter* counter = nullptr)
+		{
+			addJobs(1, [&function](uint32_t) -> F&& { return std::forward<F>(function); }, counter);
+		}
+
+		/**
+		* Add count jobs at once, makeJob(i) returns the callable for the i-th job
+		*
+		* Takes the arena and queue locks once for all jobs and wakes up the sleeping workers with a single notification
+		*/
+		template<typename MakeJob>
+		void addJobs(uint32_t count, MakeJob makeJob, JobCounter* counter = nullptr)
+		{
+			if (counter)
+			{
+				counter->pending.fetch_add(count, std::memory_order_relaxed);
+			}
+			poolCounter.pending.fetch_add(count, std::memory_order_relaxed);
+			const uint32_t workerIndex = getWorkerIndex();
+			const bool external = (workerIndex >= getThreadCount());
+			Job* jobs[jobBatchSize];
+			for (uint32_t first = 0; first < count; first += jobBatchSize)
+			{
+				const uint32_t batchCount = std::min(count - first, jobBatchSize);
+				{
+					std::unique_lock<std::mutex> lock(externalCacheMutex, std::defer_lock);
+					if (external)
+					{
+						lock.lock();
+					}
+					for (uint32_t i = 0; i < batchCount; i++)
+					{
+						jobs[i] = allocateJob(jobCaches[workerIndex]);
+					}
+				}
+				for (uint32_t i = 0; i < batchCount; i++)
+				{
+					setJobFunction(jobs[i], makeJob(first + i));
+					jobs[i]->counter = counter;
+				}
+				if (workers.empty())
+				{
+					for (uint32_t i = 0; i < batchCount; i++)
+					{
+						execute(jobs[i], workerIndex);
+					}
+				}
+				else
+				{
+					submit(jobs, batchCount);
+				}
+			}
+		}
+
+		// Wait until all jobs added with the counter have finished, runs pending jobs while waiting
+		void wait(JobCounter& counter)
+		{
+			const uint32_t workerIndex = getWorkerIndex();
+			while (!counter.done())
+			{
+				if (Job* job = findJob(workerIndex))
+				{
+					execute(job, workerIndex);
+				}
+				else
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		// Wait until all work items have been finished, must not be called from a job as it would wait for itself
 		void wait()
 		{
-			for (auto &thread : threads)
+			wait(poolCounter);
+		}
+
+		/**
+		* Run function(begin, end) over sub-ranges of [0, count) on the workers and wait for completion
+		*
+		* The range is split in halves recursively until a part is no larger than grainSize, idle workers steal the larger halves
+		* A grainSize of 0 splits the range into about four parts per thread
+		*/
+		void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& function)
+		{
+			if (count == 0)
+			{
+				return;
+			}
+			if (grainSize == 0)
+			{
+				grainSize = std::max(count / (std::max(getThreadCount(), 1u) * 4), (size_t)1);
+			}
+			if (workers.empty() || (count <= grainSize))
 			{
-				thread->wait();
+				function(0, count);
+				return;
 			}
+			JobCounter counter;
+			addRange(0, count, grainSize, function, counter);
+			wait(counter);
 		}
 	};
 
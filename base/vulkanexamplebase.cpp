@@ -7,6 +7,7 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "threadpool.hpp"
 
 #if (defined(VK_USE_PLATFORM_MACOS_MVK) && defined(VK_EXAMPLE_XCODE_GENERATED))
 #include <Cocoa/Cocoa.h>
@@ -77,6 +78,43 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	}
 #endif
 
+	// Timeline semaphore features are passed to device creation via VkPhysicalDeviceFeatures2
+	if (settings.timelineSemaphores && (std::find(enabledInstanceExtensions.begin(), enabledInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == enabledInstanceExtensions.end()))
+	{
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	}
+
+	// Dynamic rendering features are passed to device creation via VkPhysicalDeviceFeatures2
+	if (settings.dynamicRendering && (std::find(enabledInstanceExtensions.begin(), enabledInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == enabledInstanceExtensions.end()))
+	{
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	}
+
+	// Device memory heap budgets are read with vkGetPhysicalDeviceMemoryProperties2KHR
+	if ((std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) != supportedInstanceExtensions.end())
+		&& (std::find(enabledInstanceExtensions.begin(), enabledInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == enabledInstanceExtensions.end()))
+	{
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	}
+
+	// The physical devices of a device group are enumerated and combined into one logical device with VK_KHR_device_group_creation
+	if (settings.deviceGroup) {
+		if (std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_KHR_DEVICE_GROUP_CREATION_EXTENSION_NAME) != supportedInstanceExtensions.end()) {
+			enabledInstanceExtensions.push_back(VK_KHR_DEVICE_GROUP_CREATION_EXTENSION_NAME);
+		}
+		else {
+			std::cerr << "Device groups are not supported by the instance, rendering on a single device\n";
+			settings.deviceGroup = false;
+		}
+	}
+
+	// Debug utils labels and object names are used by capture tools even without validation
+	if ((std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_EXT_DEBUG_UTILS_EXTENSION_NAME) != supportedInstanceExtensions.end())
+		&& (std::find(enabledInstanceExtensions.begin(), enabledInstanceExtensions.end(), std::string(VK_EXT_DEBUG_UTILS_EXTENSION_NAME)) == enabledInstanceExtensions.end()))
+	{
+		enabledInstanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+	}
+
 	// Enabled requested instance extensions
 	if (enabledInstanceExtensions.size() > 0) 
 	{
@@ -110,7 +148,10 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 		if (settings.validation)
 		{
 			instanceExtensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);	// SRS - Dependency when VK_EXT_DEBUG_MARKER is enabled
-			instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+			if (std::find(instanceExtensions.begin(), instanceExtensions.end(), std::string(VK_EXT_DEBUG_UTILS_EXTENSION_NAME)) == instanceExtensions.end())
+			{
+				instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+			}
 		}
 		instanceCreateInfo.enabledExtensionCount = (uint32_t)instanceExtensions.size();
 		instanceCreateInfo.ppEnabledExtensionNames = instanceExtensions.data();
@@ -148,7 +189,8 @@ void VulkanExampleBase::renderFrame()
 	VulkanExampleBase::prepareFrame();
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	VK_CHECK_RESULT(vulkanDevice->flushMappedRanges());
+	VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
 	VulkanExampleBase::submitFrame();
 }
 
@@ -175,6 +217,10 @@ void VulkanExampleBase::createCommandBuffers()
 			static_cast<uint32_t>(drawCmdBuffers.size()));
 
 	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, drawCmdBuffers.data()));
+	for (size_t i = 0; i < drawCmdBuffers.size(); i++)
+	{
+		vks::debugutils::setObjectName(device, VK_OBJECT_TYPE_COMMAND_BUFFER, (uint64_t)drawCmdBuffers[i], ("draw command buffer " + std::to_string(i)).c_str());
+	}
 }
 
 void VulkanExampleBase::destroyCommandBuffers()
@@ -192,29 +238,210 @@ std::string VulkanExampleBase::getHomeworkShadersPath() const
 	return getAssetPath() + "homework/shaders/" + shaderDir + "/";
 }
 
+// Prepended to the pipeline cache data stored on disk, as the Vulkan cache header does not contain the driver version
+struct PipelineCacheFileHeader {
+	uint32_t magic;
+	uint32_t driverVersion;
+	uint64_t dataSize;
+};
+static const uint32_t pipelineCacheFileMagic = 0x43505356; // "VSPC"
+
+// Directory of the pipeline cache files, the user's cache directory if it can be determined (the working directory otherwise)
+static std::string getPipelineCacheDirectory()
+{
+	std::string directory;
+#if defined(_WIN32)
+	if (const char* localAppData = getenv("LOCALAPPDATA")) {
+		directory = localAppData;
+	}
+#elif defined(__APPLE__)
+	if (const char* home = getenv("HOME")) {
+		directory = std::string(home) + "/Library/Caches";
+	}
+#else
+	if (const char* cacheHome = getenv("XDG_CACHE_HOME")) {
+		directory = cacheHome;
+	}
+	else if (const char* home = getenv("HOME")) {
+		directory = std::string(home) + "/.cache";
+	}
+#endif
+	return directory.empty() ? std::string() : directory + "/vulkan-examples/";
+}
+
+std::string VulkanExampleBase::getPipelineCacheFileName() const
+{
+	// One file per example and device, so examples and GPUs sharing the directory don't replace each other's caches
+	char deviceName[32];
+	snprintf(deviceName, sizeof(deviceName), "_%04x_%04x", deviceProperties.vendorID, deviceProperties.deviceID);
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+	return std::string(androidApp->activity->internalDataPath) + "/" + name + deviceName + ".pipelinecache";
+#else
+	return getPipelineCacheDirectory() + name + deviceName + ".pipelinecache";
+#endif
+}
+
 void VulkanExampleBase::createPipelineCache()
 {
+	std::vector<char> cacheData;
+	if (settings.persistentPipelineCache) {
+		const std::string fileName = getPipelineCacheFileName();
+		std::ifstream is(fileName, std::ios::binary | std::ios::in | std::ios::ate);
+		if (is.is_open()) {
+			const size_t fileSize = static_cast<size_t>(is.tellg());
+			is.seekg(0, std::ios::beg);
+			PipelineCacheFileHeader fileHeader{};
+			VkPipelineCacheHeaderVersionOne cacheHeader{};
+			bool valid = fileSize >= sizeof(fileHeader) + sizeof(cacheHeader);
+			if (valid) {
+				is.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader));
+				valid = (fileHeader.magic == pipelineCacheFileMagic) && (fileHeader.driverVersion == deviceProperties.driverVersion) && (fileHeader.dataSize == fileSize - sizeof(fileHeader));
+			}
+			if (valid) {
+				cacheData.resize(static_cast<size_t>(fileHeader.dataSize));
+				is.read(cacheData.data(), cacheData.size());
+				valid = !is.fail();
+			}
+			if (valid) {
+				// Only pass data to the driver that has been created by the same device (and driver) to avoid undefined behavior with corrupt or foreign caches
+				memcpy(&cacheHeader, cacheData.data(), sizeof(cacheHeader));
+				valid = (cacheHeader.headerSize >= sizeof(cacheHeader)) && (cacheHeader.headerSize <= cacheData.size()) &&
+					(cacheHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE) &&
+					(cacheHeader.vendorID == deviceProperties.vendorID) &&
+					(cacheHeader.deviceID == deviceProperties.deviceID) &&
+					(memcmp(cacheHeader.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0);
+			}
+			if (!valid) {
+				std::cout << "Pipeline cache file \"" << fileName << "\" is invalid or has been created by a different device or driver, ignoring it\n";
+				cacheData.clear();
+			}
+		}
+	}
+
 	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+	pipelineCacheCreateInfo.initialDataSize = cacheData.size();
+	pipelineCacheCreateInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+	VkResult result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache);
+	if ((result != VK_SUCCESS) && !cacheData.empty()) {
+		// Fall back to an empty cache if the implementation rejected the stored data
+		pipelineCacheCreateInfo.initialDataSize = 0;
+		pipelineCacheCreateInfo.pInitialData = nullptr;
+		result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache);
+	}
+	VK_CHECK_RESULT(result);
+}
+
+void VulkanExampleBase::savePipelineCache()
+{
+	if (!settings.persistentPipelineCache || (pipelineCache == VK_NULL_HANDLE)) {
+		return;
+	}
+	size_t dataSize = 0;
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr));
+	if (dataSize == 0) {
+		return;
+	}
+	std::vector<char> cacheData(dataSize);
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, cacheData.data()));
+#if !defined(VK_USE_PLATFORM_ANDROID_KHR)
+	const std::string directory = getPipelineCacheDirectory();
+	if (!directory.empty()) {
+#if defined(_WIN32)
+		CreateDirectoryA(directory.c_str(), nullptr);
+#else
+		// The parent (e.g. ~/.cache) may not exist yet either
+		for (size_t pos = directory.find('/', 1); pos != std::string::npos; pos = directory.find('/', pos + 1)) {
+			mkdir(directory.substr(0, pos).c_str(), 0755);
+		}
+#endif
+	}
+#endif
+	// The cache is written to a temporary file that replaces the old one once complete, so an interrupted write or a second instance never leaves a truncated file behind
+	const std::string fileName = getPipelineCacheFileName();
+	const std::string tempFileName = fileName + ".tmp";
+	{
+		std::ofstream os(tempFileName, std::ios::binary | std::ios::out | std::ios::trunc);
+		if (!os.is_open()) {
+			std::cerr << "Could not write pipeline cache file \"" << tempFileName << "\"\n";
+			return;
+		}
+		PipelineCacheFileHeader fileHeader{};
+		fileHeader.magic = pipelineCacheFileMagic;
+		fileHeader.driverVersion = deviceProperties.driverVersion;
+		fileHeader.dataSize = dataSize;
+		os.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+		os.write(cacheData.data(), dataSize);
+		os.close();
+		if (os.fail()) {
+			std::cerr << "Could not write pipeline cache file \"" << tempFileName << "\"\n";
+			remove(tempFileName.c_str());
+			return;
+		}
+	}
+#if defined(_WIN32)
+	const bool replaced = MoveFileExA(tempFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	const bool replaced = rename(tempFileName.c_str(), fileName.c_str()) == 0;
+#endif
+	if (!replaced) {
+		std::cerr << "Could not replace pipeline cache file \"" << fileName << "\"\n";
+		remove(tempFileName.c_str());
+	}
 }
 
 void VulkanExampleBase::prepare()
 {
+	if (vks::StartupReport::isActive() && (startupPhaseEnd != 0)) {
+		// The window is set up between initVulkan() and prepare() on all platforms
+		vks::StartupReport::add(vks::StartupReport::Phase, "setupWindow", startupPhaseEnd, vks::Tracer::now());
+	}
+	VKS_STARTUP_SCOPE(vks::StartupReport::Phase, "prepare (base)");
 	if (vulkanDevice->enableDebugMarkers) {
 		vks::debugmarker::setup(device);
 	}
-	initSwapchain();
-	createCommandPool();
-	setupSwapChain();
-	createCommandBuffers();
-	createSynchronizationPrimitives();
+	{
+		VKS_STARTUP_SCOPE(vks::StartupReport::Phase, "prepare: swapchain");
+		initSwapchain();
+		createCommandPool();
+		setupSwapChain();
+		createCommandBuffers();
+		createSynchronizationPrimitives();
+		createFrameObjects();
+	}
+	benchmark.gpuProfiler.prepare(vulkanDevice, static_cast<uint32_t>(drawCmdBuffers.size()), 32, benchmark.pipelineStatistics);
+	if (settings.offscreen && (settings.offscreenCaptureInterval > 0)) {
+		offscreenReadback.reset(new vks::ReadbackRing(vulkanDevice, queue));
+	}
+	if ((settings.defragmentBudget > 0.0f) && vulkanDevice->memoryAllocator) {
+		memoryDefragmenter.reset(new vks::MemoryDefragmenter(vulkanDevice, queue));
+		vks::MemoryDefragmenter::Settings defragmenterSettings = memoryDefragmenter->getSettings();
+		defragmenterSettings.stepBudget = settings.defragmentBudget;
+		memoryDefragmenter->setSettings(defragmenterSettings);
+	}
 	setupDepthStencil();
-	setupRenderPass();
-	createPipelineCache();
-	setupFrameBuffer();
+	if (settings.dynamicRendering) {
+		// Pipelines are created against the attachment formats instead of a render pass
+		pipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+		pipelineRenderingCreateInfo.colorAttachmentCount = 1;
+		pipelineRenderingCreateInfo.pColorAttachmentFormats = &swapChain.colorFormat;
+		pipelineRenderingCreateInfo.depthAttachmentFormat = depthFormat;
+		pipelineRenderingCreateInfo.stencilAttachmentFormat = vks::tools::formatHasStencil(depthFormat) ? depthFormat : VK_FORMAT_UNDEFINED;
+	}
+	else {
+		VKS_STARTUP_SCOPE(vks::StartupReport::Phase, "prepare: render pass");
+		setupRenderPass();
+	}
+	{
+		VKS_STARTUP_SCOPE(vks::StartupReport::Phase, "prepare: pipeline cache");
+		createPipelineCache();
+	}
+	if (!settings.dynamicRendering) {
+		setupFrameBuffer();
+	}
 	settings.overlay = settings.overlay && (!benchmark.active);
 	if (settings.overlay) {
+		VKS_STARTUP_SCOPE(vks::StartupReport::Phase, "prepare: UI overlay");
 		UIOverlay.device = vulkanDevice;
 		UIOverlay.queue = queue;
 		UIOverlay.shaders = {
@@ -222,28 +449,161 @@ void VulkanExampleBase::prepare()
 			loadShader(getShadersPath() + "base/uioverlay.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
 		};
 		UIOverlay.prepareResources();
-		UIOverlay.preparePipeline(pipelineCache, renderPass, swapChain.colorFormat, depthFormat);
+		UIOverlay.setBufferCount(swapChain.imageCount);
+		if (settings.overlayPass) {
+			// The overlay pass only has the single sampled color attachment
+			UIOverlay.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+			UIOverlay.subpass = 0;
+			setupOverlayRenderPass();
+			createOverlayFrames();
+			UIOverlay.preparePipeline(pipelineCache, overlayResources.renderPass, swapChain.colorFormat, VK_FORMAT_UNDEFINED);
+		}
+		else {
+			UIOverlay.preparePipeline(pipelineCache, renderPass, swapChain.colorFormat, depthFormat);
+		}
+	}
+	else {
+		settings.overlayPass = false;
 	}
+#if !defined(VK_USE_PLATFORM_ANDROID_KHR)
+	if (settings.shaderHotReload) {
+		shaderWatcher = new vks::ShaderWatcher((shaderDir == "hlsl") ? vks::ShaderWatcher::Language::HLSL : vks::ShaderWatcher::Language::GLSL);
+	}
+#endif
+	// The overlay's pipeline isn't rebuilt on reloads
+	unwatchedShaders.clear();
+	// Everything up to the first frame is the example's part of prepare (assets, pipelines, command buffers)
+	startupPhaseEnd = vks::Tracer::now();
 }
 
-VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileName, VkShaderStageFlagBits stage)
+VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileName, VkShaderStageFlagBits stage, bool deferModule)
 {
-	VkPipelineShaderStageCreateInfo shaderStage = {};
-	shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	shaderStage.stage = stage;
+	VKS_STARTUP_SCOPE(vks::StartupReport::Shader, fileName);
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
-	shaderStage.module = vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
+	std::vector<char> shaderCode = vks::tools::loadShaderCode(androidApp->activity->assetManager, fileName.c_str());
 #else
-	shaderStage.module = vks::tools::loadShader(fileName.c_str(), device);
+	std::vector<char> shaderCode = vks::tools::loadShaderCode(fileName.c_str());
 #endif
-	shaderStage.pName = "main";
-	assert(shaderStage.module != VK_NULL_HANDLE);
-	shaderModules.push_back(shaderStage.module);
+	assert(!shaderCode.empty());
+	VkPipelineShaderStageCreateInfo shaderStage = shaderModuleCache->getStage(fileName, shaderCode.data(), shaderCode.size(), stage, deferModule);
+	// Deferred stages don't have a module (yet)
+	if (shaderStage.module != VK_NULL_HANDLE) {
+		shaderModules.push_back(shaderStage.module);
+	}
+	unwatchedShaders.push_back(fileName);
 	return shaderStage;
 }
 
+vks::ThreadPool* VulkanExampleBase::getThreadPool()
+{
+	if (!threadPoolShared) {
+		threadPoolShared.reset(new vks::ThreadPool());
+		threadPoolShared->setThreadCount(std::max(std::thread::hardware_concurrency(), 1u));
+	}
+	return threadPoolShared.get();
+}
+
+std::string VulkanExampleBase::getShaderVariant(const std::string& fileName) const
+{
+	if (!settings.halfPrecision) {
+		return fileName;
+	}
+	// "pbr.frag.spv" becomes "pbr_fp16.frag.spv"
+	const size_t nameStart = fileName.find_last_of("/\\") + 1;
+	const size_t extension = fileName.find('.', nameStart);
+	if (extension == std::string::npos) {
+		return fileName;
+	}
+	std::string variant = fileName;
+	variant.insert(extension, "_fp16");
+#if !defined(VK_USE_PLATFORM_ANDROID_KHR)
+	// Variants are only provided for some shaders (and only for GLSL)
+	if (!vks::tools::fileExists(variant)) {
+		std::cerr << "No half precision variant of \"" << fileName << "\", using the full precision shader\n";
+		return fileName;
+	}
+#endif
+	return variant;
+}
+
+VkPipelineCreateFlags VulkanExampleBase::getShaderStatisticsPipelineFlags() const
+{
+	return (benchmark.active && vulkanDevice->enablePipelineExecutableInfo) ? VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR : 0;
+}
+
+void VulkanExampleBase::reportShaderStatistics(VkPipeline pipeline, VkShaderStageFlagBits stage, const std::string& name)
+{
+	if (!benchmark.active || !vulkanDevice->enablePipelineExecutableInfo) {
+		return;
+	}
+	VkPipelineInfoKHR pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INFO_KHR;
+	pipelineInfo.pipeline = pipeline;
+	uint32_t executableCount = 0;
+	VK_CHECK_RESULT(vulkanDevice->vkGetPipelineExecutablePropertiesKHR(device, &pipelineInfo, &executableCount, nullptr));
+	std::vector<VkPipelineExecutablePropertiesKHR> executables(executableCount, { VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_PROPERTIES_KHR });
+	VK_CHECK_RESULT(vulkanDevice->vkGetPipelineExecutablePropertiesKHR(device, &pipelineInfo, &executableCount, executables.data()));
+	for (uint32_t i = 0; i < executableCount; i++) {
+		if ((executables[i].stages & stage) == 0) {
+			continue;
+		}
+		VkPipelineExecutableInfoKHR executableInfo{};
+		executableInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INFO_KHR;
+		executableInfo.pipeline = pipeline;
+		executableInfo.executableIndex = i;
+		uint32_t statisticCount = 0;
+		VK_CHECK_RESULT(vulkanDevice->vkGetPipelineExecutableStatisticsKHR(device, &executableInfo, &statisticCount, nullptr));
+		std::vector<VkPipelineExecutableStatisticKHR> statistics(statisticCount, { VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_STATISTIC_KHR });
+		VK_CHECK_RESULT(vulkanDevice->vkGetPipelineExecutableStatisticsKHR(device, &executableInfo, &statisticCount, statistics.data()));
+		for (const VkPipelineExecutableStatisticKHR& statistic : statistics) {
+			double value;
+			switch (statistic.format) {
+			case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_INT64_KHR:
+				value = static_cast<double>(statistic.value.i64);
+				break;
+			case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_UINT64_KHR:
+				value = static_cast<double>(statistic.value.u64);
+				break;
+			case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_FLOAT64_KHR:
+				value = statistic.value.f64;
+				break;
+			default:
+				continue;
+			}
+			// Names are driver specific (e.g. instruction, register or spill counts), metrics of pipelines created again (e.g. on shader reload) are updated in place
+			const std::string metricName = name + " " + executables[i].name + " " + statistic.name;
+			auto metric = std::find_if(benchmark.metrics.begin(), benchmark.metrics.end(), [&metricName](const std::pair<std::string, double>& metric) { return metric.first == metricName; });
+			if (metric == benchmark.metrics.end()) {
+				benchmark.metrics[benchmark.addMetric(metricName)].second = value;
+			}
+			else {
+				metric->second = value;
+			}
+		}
+	}
+}
+
+void VulkanExampleBase::releaseShaderModules()
+{
+	shaderModuleCache->release();
+	shaderModules.clear();
+}
+
+void VulkanExampleBase::watchShaders(std::function<void()> rebuildPipelines)
+{
+	if (shaderWatcher && !reloadingShaders) {
+		shaderWatcher->watch(unwatchedShaders, rebuildPipelines);
+	}
+	unwatchedShaders.clear();
+}
+
 void VulkanExampleBase::nextFrame()
 {
+	VKS_TRACE_SCOPE("nextFrame");
+	const uint64_t startupFrameBegin = vks::StartupReport::isActive() ? vks::Tracer::now() : 0;
+	if ((startupFrameBegin != 0) && (startupPhaseEnd != 0)) {
+		vks::StartupReport::add(vks::StartupReport::Phase, "prepare (example)", startupPhaseEnd, startupFrameBegin);
+	}
 	auto tStart = std::chrono::high_resolution_clock::now();
 	if (viewUpdated)
 	{
@@ -251,8 +611,41 @@ void VulkanExampleBase::nextFrame()
 		viewChanged();
 	}
 
-	render();
+	// Swap pipelines of recompiled shaders between frames
+	if (shaderWatcher && shaderWatcher->hasPendingReloads()) {
+		VKS_TRACE_SCOPE("reloadShaders");
+		vkDeviceWaitIdle(device);
+		reloadingShaders = true;
+		if (shaderWatcher->update()) {
+			buildCommandBuffers();
+		}
+		reloadingShaders = false;
+	}
+
+	// Swap in the resources the defragmenter copied, the frames in flight may still use the old ones in the command buffers rebuilt here
+	if (memoryDefragmenter) {
+		VKS_TRACE_SCOPE("defragment");
+		if (memoryDefragmenter->hasCompletedMoves()) {
+			waitForFramesInFlight();
+			memoryDefragmenter->finishMoves();
+			buildCommandBuffers();
+		}
+		memoryDefragmenter->step();
+	}
+
+	{
+		VKS_TRACE_SCOPE("render");
+		render();
+	}
 	frameCounter++;
+	if (settings.performanceGovernor) {
+		updatePerformanceGovernor(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count());
+	}
+	// Frame limiter, sleeping keeps the CPU (and with it the GPU) idle for the rest of the frame instead of spinning
+	if (settings.frameLimit > 0.0) {
+		VKS_TRACE_SCOPE("frameLimiter");
+		std::this_thread::sleep_until(tStart + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<double, std::milli>(settings.frameLimit)));
+	}
 	auto tEnd = std::chrono::high_resolution_clock::now();
 #if (defined(VK_USE_PLATFORM_IOS_MVK) || (defined(VK_USE_PLATFORM_MACOS_MVK) && !defined(VK_EXAMPLE_XCODE_GENERATED)))
 	// SRS - Calculate tDiff as time between frames vs. rendering time for iOS/macOS displayLink-driven examples project
@@ -291,20 +684,284 @@ void VulkanExampleBase::nextFrame()
 	tPrevEnd = tEnd;
 	
 	// TODO: Cap UI overlay update rates
-	updateOverlay();
+	{
+		VKS_TRACE_SCOPE("updateOverlay");
+		updateOverlay();
+	}
+
+	// The report ends with the first frame, which may still compile pipelines created lazily by the example
+	if (startupFrameBegin != 0) {
+		vks::StartupReport::add(vks::StartupReport::Phase, "first frame", startupFrameBegin, vks::Tracer::now());
+		vks::StartupReport::finish(settings.startupReportFilename);
+	}
+}
+
+/*
+	Print the input to present latency percentiles of the session, presents still pending are waited for first
+*/
+void VulkanExampleBase::printInputLatency()
+{
+	vkDeviceWaitIdle(device);
+	latencyTracker.update(swapChain.swapChain);
+	std::vector<double> sorted(latencyTracker.getSamples());
+	if (sorted.empty()) {
+		std::cout << "No input to present latency measured (no input events)\n";
+		return;
+	}
+	std::sort(sorted.begin(), sorted.end());
+	std::cout << std::fixed << std::setprecision(3) << "Input to " << (latencyTracker.presentWaitEnabled() ? "present" : "present call") << " latency: "
+		<< vks::Benchmark::percentile(sorted, 50.0) << " ms p50, " << vks::Benchmark::percentile(sorted, 90.0) << " ms p90, " << vks::Benchmark::percentile(sorted, 99.0) << " ms p99, "
+		<< sorted.back() << " ms max (" << sorted.size() << " frames)\n";
+}
+
+/*
+	Create the logical device for all physical devices of the selected device's device group, the devices then render the frames in turn (alternate frame rendering)
+	Command buffers and submissions without a device mask execute on all devices, so resources are created and uploaded on every device (multi-instance memory)
+	and only the frame's command buffer and semaphores are masked to the frame's device. Split frame rendering would need the examples to render parts of the
+	image with device render areas, so it isn't supported.
+*/
+void VulkanExampleBase::setupDeviceGroup()
+{
+	// These submit to the graphics queue with their own semaphores or wait on timeline values, which aren't masked to the frame's device
+	if (settings.timelineSemaphores || settings.overlayPass || settings.transferQueue || settings.offscreen) {
+		std::cerr << "Device groups can't be combined with timeline semaphores, the overlay pass, the transfer queue or offscreen mode, rendering on a single device\n";
+		settings.deviceGroup = false;
+		return;
+	}
+	PFN_vkEnumeratePhysicalDeviceGroupsKHR enumeratePhysicalDeviceGroups = reinterpret_cast<PFN_vkEnumeratePhysicalDeviceGroupsKHR>(vkGetInstanceProcAddr(instance, "vkEnumeratePhysicalDeviceGroupsKHR"));
+	if (!enumeratePhysicalDeviceGroups || !vulkanDevice->extensionSupported(VK_KHR_DEVICE_GROUP_EXTENSION_NAME)) {
+		std::cerr << "Device groups are not supported by the selected device, rendering on a single device\n";
+		settings.deviceGroup = false;
+		return;
+	}
+	uint32_t groupCount = 0;
+	VK_CHECK_RESULT(enumeratePhysicalDeviceGroups(instance, &groupCount, nullptr));
+	std::vector<VkPhysicalDeviceGroupPropertiesKHR> groups(groupCount);
+	for (auto& group : groups) {
+		group.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GROUP_PROPERTIES_KHR;
+	}
+	VK_CHECK_RESULT(enumeratePhysicalDeviceGroups(instance, &groupCount, groups.data()));
+	for (auto& group : groups) {
+		const VkPhysicalDevice* begin = group.physicalDevices;
+		const VkPhysicalDevice* end = group.physicalDevices + group.physicalDeviceCount;
+		if ((group.physicalDeviceCount > 1) && (std::find(begin, end, physicalDevice) != end)) {
+			deviceGroup.physicalDevices.assign(begin, end);
+			break;
+		}
+	}
+	if (deviceGroup.physicalDevices.empty()) {
+		std::cerr << "The selected device is not part of a device group with more than one device, rendering on a single device\n";
+		settings.deviceGroup = false;
+		return;
+	}
+	enabledDeviceExtensions.push_back(VK_KHR_DEVICE_GROUP_EXTENSION_NAME);
+	deviceGroup.deviceCount = static_cast<uint32_t>(deviceGroup.physicalDevices.size());
+	deviceGroup.deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_DEVICE_CREATE_INFO_KHR;
+	deviceGroup.deviceCreateInfo.physicalDeviceCount = deviceGroup.deviceCount;
+	deviceGroup.deviceCreateInfo.pPhysicalDevices = deviceGroup.physicalDevices.data();
+	deviceGroup.deviceCreateInfo.pNext = deviceCreatepNextChain;
+	deviceCreatepNextChain = &deviceGroup.deviceCreateInfo;
+	deviceGroup.gpuTime.assign(deviceGroup.deviceCount, 0.0);
+	deviceGroup.frames.assign(deviceGroup.deviceCount, 0);
+	std::cout << "Alternate frame rendering on " << deviceGroup.deviceCount << " devices\n";
+	if (settings.framesInFlight < deviceGroup.deviceCount) {
+		std::cout << "Fewer frames in flight (" << settings.framesInFlight << ") than devices, the devices will render one after another (see --framesinflight)\n";
+	}
+}
+
+/*
+	Select the device rendering the next frame, the devices take turns unless a device's images can't be presented by any device of the group
+	Examples using the base's async compute queue render all frames on the first device without device masks, as their compute submissions aren't masked
+*/
+void VulkanExampleBase::selectFrameDevice()
+{
+	const VkDeviceGroupPresentModeFlagsKHR modes = swapChain.deviceGroupPresentModes;
+	const std::vector<uint32_t>& presentMasks = swapChain.deviceGroupPresentMasks;
+	deviceGroup.frameDevice = 0;
+	deviceGroup.frameDeviceMask = 0;
+	if ((modes == 0) || (asyncCompute.queue != VK_NULL_HANDLE)) {
+		return;
+	}
+	const uint32_t first = static_cast<uint32_t>(frameNumber % deviceGroup.deviceCount);
+	for (uint32_t i = 0; i < deviceGroup.deviceCount; i++) {
+		const uint32_t index = (first + i) % deviceGroup.deviceCount;
+		const uint32_t mask = 1u << index;
+		// A device with a presentation engine presents its own images, the images of other devices are copied to a device that can present them
+		if ((modes & VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR) && (presentMasks[index] & mask)) {
+			deviceGroup.presentMode = VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR;
+		}
+		else if ((modes & VK_DEVICE_GROUP_PRESENT_MODE_REMOTE_BIT_KHR) && std::any_of(presentMasks.begin(), presentMasks.end(), [mask](uint32_t presentMask) { return (presentMask & mask) != 0; })) {
+			deviceGroup.presentMode = VK_DEVICE_GROUP_PRESENT_MODE_REMOTE_BIT_KHR;
+		}
+		else {
+			continue;
+		}
+		deviceGroup.frameDevice = index;
+		deviceGroup.frameDeviceMask = mask;
+		return;
+	}
+}
+
+/*
+	Attribute the GPU time of the acquired image's previous submission to the device that rendered it and mask the frame's submission to the frame's device
+	The profiler's queries are written by the device executing the command buffer, so the collected results are that device's timings
+*/
+void VulkanExampleBase::updateDeviceGroupFrame(uint32_t imageIndex)
+{
+	if (deviceGroup.imageDevices.size() != swapChain.imageCount) {
+		deviceGroup.imageDevices.assign(swapChain.imageCount, UINT32_MAX);
+	}
+	uint32_t& imageDevice = deviceGroup.imageDevices[imageIndex];
+	const std::vector<std::pair<std::string, double>>& results = benchmark.gpuProfiler.results;
+	if ((imageDevice != UINT32_MAX) && !results.empty()) {
+		double frameEnd = 0.0;
+		for (size_t i = 0; i < results.size(); i++) {
+			const double offset = (i < benchmark.gpuProfiler.resultOffsets.size()) ? benchmark.gpuProfiler.resultOffsets[i] : 0.0;
+			frameEnd = std::max(frameEnd, offset + results[i].second);
+		}
+		deviceGroup.gpuTime[imageDevice] += frameEnd;
+		deviceGroup.frames[imageDevice]++;
+	}
+	imageDevice = deviceGroup.frameDevice;
+	if (deviceGroup.frameDeviceMask == 0) {
+		submitInfo.pNext = nullptr;
+		return;
+	}
+	// Matches the single command buffer, wait and signal semaphore of submitInfo
+	deviceGroup.submitInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO_KHR;
+	deviceGroup.submitInfo.waitSemaphoreCount = 1;
+	deviceGroup.submitInfo.pWaitSemaphoreDeviceIndices = &deviceGroup.frameDevice;
+	deviceGroup.submitInfo.commandBufferCount = 1;
+	deviceGroup.submitInfo.pCommandBufferDeviceMasks = &deviceGroup.frameDeviceMask;
+	deviceGroup.submitInfo.signalSemaphoreCount = 1;
+	deviceGroup.submitInfo.pSignalSemaphoreDeviceIndices = &deviceGroup.frameDevice;
+	submitInfo.pNext = &deviceGroup.submitInfo;
+}
+
+/*
+	Per device GPU frame times (for examples with GPU profiler scopes) and the number of frames whose image had to be copied to another device for presentation
+	The peer copies of remote presentation are done by the presentation engine and can't be timed with queries, so only their number is reported
+*/
+void VulkanExampleBase::printDeviceGroupSummary()
+{
+	if (deviceGroup.deviceCount <= 1) {
+		return;
+	}
+	std::cout << "Device group (" << deviceGroup.deviceCount << " devices, alternate frame rendering):\n";
+	for (uint32_t i = 0; i < deviceGroup.deviceCount; i++) {
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(deviceGroup.physicalDevices[i], &properties);
+		std::cout << "  GPU " << i << " (" << properties.deviceName << "): ";
+		if (deviceGroup.frames[i] > 0) {
+			std::cout << std::fixed << std::setprecision(3) << deviceGroup.gpuTime[i] / static_cast<double>(deviceGroup.frames[i]) << " ms GPU average over " << deviceGroup.frames[i] << " frames\n";
+		}
+		else {
+			std::cout << "no GPU profiler results\n";
+		}
+	}
+	std::cout << "  " << deviceGroup.localPresents << " local presents, " << deviceGroup.remotePresents << " remote presents (peer memory copies)\n";
+}
+
+/*
+	Frame of a benchmark run, the overlay is disabled and the camera only follows the specification's path
+	A specification's time step replaces the measured frame time, so animations advance the same way on every run
+	With benchmark.replayFrames, the first frames of the warm up are captured and replayed for the rest of the run without the example's updates
+*/
+void VulkanExampleBase::benchmarkFrame()
+{
+	// Only the latencies of the benchmark phase are reported
+	if (!benchmark.warmingUp && (benchmark.phaseFrame == 0)) {
+		latencyTracker.clearSamples();
+	}
+	// There's no input while benchmarking, the frame's camera and animation update stands in for it
+	latencyTracker.inputEvent();
+	if (benchmark.replayFrames > 0) {
+		if (benchmark.warmingUp && (benchmark.phaseFrame == 0)) {
+			commandCapture.begin(benchmark.replayFrames);
+		}
+		else if (!benchmark.warmingUp && (benchmark.phaseFrame == 0)) {
+			// The warm up may end before all frames have been captured
+			commandCapture.finish();
+			const vks::CommandCapture::Statistics& statistics = commandCapture.getStatistics();
+			benchmark.capturedFrames = statistics.frames;
+			if (commandCapture.isReplaying()) {
+				std::cout << "replay : " << statistics.frames << " captured frames, " << statistics.mappedRanges << " mapped buffer ranges, " << (double)statistics.storedBytes / 1024.0 << " KiB of buffer data" << "\n";
+			}
+			else {
+				std::cout << "replay : the example's frames could not be captured (no command buffers in submitInfo), rendering them instead" << "\n";
+			}
+		}
+		if (commandCapture.isReplaying()) {
+			replayFrame();
+			return;
+		}
+	}
+	const double time = benchmark.specificationTime();
+	if (benchmark.specification.timeStep > 0.0) {
+		frameTimer = static_cast<float>(benchmark.specification.timeStep);
+		if (!paused) {
+			timer = static_cast<float>(fmod(timerSpeed * time, 1.0));
+		}
+	}
+	if (!benchmark.specification.cameraPath.empty()) {
+		camera.setPathTime(benchmark.specification.cameraPath, static_cast<float>(time));
+		viewChanged();
+	}
+	render();
+}
+
+/*
+	Replay of the next captured frame, see vks::CommandCapture
+	The captured buffer contents are restored after the frame's synchronization objects are free, like an example updates its uniform buffers
+*/
+void VulkanExampleBase::replayFrame()
+{
+	VulkanExampleBase::prepareFrame();
+	const std::vector<VkCommandBuffer>& commandBuffers = commandCapture.replayFrame(drawCmdBuffers, currentBuffer);
+	submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+	submitInfo.pCommandBuffers = commandBuffers.data();
+	VK_CHECK_RESULT(vulkanDevice->flushMappedRanges());
+	VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
+	VulkanExampleBase::submitFrame();
 }
 
 void VulkanExampleBase::renderLoop()
 {
+	// All resources have been created at this point, so this shows the memory layout after loading
+	if (vulkanDevice->memoryAllocator) {
+		vulkanDevice->memoryAllocator->printStatistics();
+	}
+	vulkanDevice->memoryTracker.printStatistics();
 // SRS - for non-apple plaforms, handle benchmarking here within VulkanExampleBase::renderLoop()
 //     - for macOS, handle benchmarking within NSApp rendering loop via displayLinkOutputCb()
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 	if (benchmark.active) {
-		benchmark.run([=] { render(); }, vulkanDevice->properties);
+		benchmark.run([=] { benchmarkFrame(); }, vulkanDevice->properties);
 		vkDeviceWaitIdle(device);
-		if (benchmark.filename != "") {
+		latencyTracker.update(swapChain.swapChain);
+		benchmark.recordInputLatencies(latencyTracker.getSamples(), latencyTracker.presentWaitEnabled());
+		benchmark.recordMemoryUsage(vulkanDevice->memoryTracker);
+		if ((benchmark.filename != "") || (benchmark.jsonFilename != "")) {
 			benchmark.saveResults();
 		}
+		if ((benchmark.baselineFilename != "") && !benchmark.compareWithBaseline()) {
+			exitCode = 1;
+		}
+		return;
+	}
+#endif
+#if !(defined(VK_USE_PLATFORM_ANDROID_KHR) || defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
+	// Without a window there are no events to handle, frames are rendered back to back until the frame count has been reached
+	if (settings.offscreen) {
+		lastTimestamp = std::chrono::high_resolution_clock::now();
+		tPrevEnd = lastTimestamp;
+		for (uint32_t frame = 0; (settings.offscreenFrames == 0) || (frame < settings.offscreenFrames); frame++) {
+			nextFrame();
+		}
+		if (offscreenReadback) {
+			offscreenReadback->flush();
+		}
+		vkDeviceWaitIdle(device);
 		return;
 	}
 #endif
@@ -367,6 +1024,13 @@ void VulkanExampleBase::renderLoop()
 			auto tStart = std::chrono::high_resolution_clock::now();
 			render();
 			frameCounter++;
+			if (settings.performanceGovernor) {
+				updatePerformanceGovernor(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count());
+			}
+			// Frame limiter, e.g. the performance governor's target frame rate
+			if (settings.frameLimit > 0.0) {
+				std::this_thread::sleep_until(tStart + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<double, std::milli>(settings.frameLimit)));
+			}
 			auto tEnd = std::chrono::high_resolution_clock::now();
 			auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 			frameTimer = tDiff / 1000.0f;
@@ -681,6 +1345,8 @@ void VulkanExampleBase::updateOverlay()
 
 	ImGui::NewFrame();
 
+	frameTimeHistory.addCpuFrame(frameTimer * 1000.0);
+
 	ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0);
 	ImGui::SetNextWindowPos(ImVec2(10 * UIOverlay.scale, 10 * UIOverlay.scale));
 	ImGui::SetNextWindowSize(ImVec2(0, 0), ImGuiSetCond_FirstUseEver);
@@ -688,6 +1354,55 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::TextUnformatted(title.c_str());
 	ImGui::TextUnformatted(deviceProperties.deviceName);
 	ImGui::Text("%.2f ms/frame (%.1d fps)", (1000.0f / lastFPS), lastFPS);
+	if ((settings.dynamicResolutionTarget > 0.0f) && (renderResolution.renderExtent.width > 0)) {
+		ImGui::Text("%dx%d render resolution (%.2f ms GPU)", renderResolution.renderExtent.width, renderResolution.renderExtent.height, dynamicResolution.gpuTime);
+	}
+	if (deviceGroup.deviceCount > 1) {
+		for (uint32_t i = 0; i < deviceGroup.deviceCount; i++) {
+			const double average = (deviceGroup.frames[i] > 0) ? deviceGroup.gpuTime[i] / static_cast<double>(deviceGroup.frames[i]) : 0.0;
+			ImGui::Text("GPU %d: %.2f ms GPU (%llu frames)", i, average, static_cast<unsigned long long>(deviceGroup.frames[i]));
+		}
+		ImGui::Text("Peer copies for presentation: %llu", static_cast<unsigned long long>(deviceGroup.remotePresents));
+	}
+	if (performanceGovernor.isActive()) {
+		ImGui::Text("Performance level: %s (thermal status %s)", vks::PerformanceGovernor::levelName(performanceGovernor.getLevel()), vks::PerformanceGovernor::thermalStatusName(performanceGovernor.getThermalStatus()));
+	}
+	if (ImGui::CollapsingHeader("Frame times")) {
+		int32_t frameTimeWindow = static_cast<int32_t>(settings.frameTimeWindow);
+		ImGui::PushItemWidth(110.0f * UIOverlay.scale);
+		if (ImGui::SliderInt("Window (frames)", &frameTimeWindow, 30, 1200)) {
+			settings.frameTimeWindow = static_cast<uint32_t>(frameTimeWindow);
+			frameTimeHistory.setWindow(settings.frameTimeWindow);
+		}
+		ImGui::PopItemWidth();
+		const float graphWidth = 250.0f * UIOverlay.scale;
+		UIOverlay.frameTimeGraph(frameTimeHistory.getCpuFrames(), graphWidth);
+		// GPU times are only available for examples recording profiler scopes
+		UIOverlay.frameTimeGraph(frameTimeHistory.getGpuFrames(), graphWidth);
+		for (auto& scope : frameTimeHistory.getGpuScopes()) {
+			UIOverlay.frameTimeGraph(scope, graphWidth);
+		}
+	}
+	if (ImGui::CollapsingHeader("Device memory")) {
+		const float MiB = 1024.0f * 1024.0f;
+		vks::MemoryTracker &memoryTracker = vulkanDevice->memoryTracker;
+		ImGui::Text("%.1f MiB tracked (peak %.1f MiB)", (float)memoryTracker.getTotalBytes() / MiB, (float)memoryTracker.getPeakBytes() / MiB);
+		for (uint32_t i = 0; i < vks::memoryCategoryCount; i++) {
+			const vks::MemoryCategory category = static_cast<vks::MemoryCategory>(i);
+			if (memoryTracker.getCount(category) > 0) {
+				ImGui::Text("%s: %.1f MiB", vks::MemoryTracker::categoryName(category), (float)memoryTracker.getBytes(category) / MiB);
+			}
+		}
+		// Usage and budget as reported by the driver also include memory that isn't tracked
+		if (memoryTracker.budgetSupported()) {
+			std::vector<vks::MemoryHeapUsage> heaps = memoryTracker.getHeapUsage();
+			for (size_t i = 0; i < heaps.size(); i++) {
+				if (heaps[i].deviceLocal) {
+					ImGui::Text("heap %d: %.1f / %.1f MiB%s", (int)i, (float)heaps[i].usage / MiB, (float)heaps[i].budget / MiB, (heaps[i].usage > heaps[i].budget) ? " (over budget)" : "");
+				}
+			}
+		}
+	}
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 5.0f * UIOverlay.scale));
@@ -703,7 +1418,20 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::PopStyleVar();
 	ImGui::Render();
 
-	if (UIOverlay.update() || UIOverlay.updated) {
+	// The vertex, index and indirect draw data is written to the acquired image's buffers in prepareFrame() after waiting for that image's
+	// last submission, so changes that keep the number and scissors of the draw commands (e.g. different digits or lengths of the frame
+	// time text) neither wait for the other frames in flight nor rebuild the command buffers
+	if (settings.overlayPass) {
+		// The overlay pass is recorded every frame, so only growing the buffers has to wait for the overlay passes in flight
+		if (UIOverlay.update() && UIOverlay.needsAllocation()) {
+			VK_CHECK_RESULT(vkWaitForFences(device, static_cast<uint32_t>(overlayResources.fences.size()), overlayResources.fences.data(), VK_TRUE, UINT64_MAX));
+			UIOverlay.allocateBuffers();
+		}
+		UIOverlay.updated = false;
+	}
+	else if (UIOverlay.update() || UIOverlay.updated) {
+		waitForFramesInFlight();
+		UIOverlay.allocateBuffers();
 		buildCommandBuffers();
 		UIOverlay.updated = false;
 	}
@@ -717,20 +1445,215 @@ void VulkanExampleBase::updateOverlay()
 
 void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 {
-	if (settings.overlay && UIOverlay.visible) {
+	if (settings.overlay && UIOverlay.visible && !settings.overlayPass) {
 		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 		const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-		UIOverlay.draw(commandBuffer);
+		// Command buffers are recorded per swapchain image and draw with the overlay buffers of that image
+		auto drawCmdBuffer = std::find(drawCmdBuffers.begin(), drawCmdBuffers.end(), commandBuffer);
+		const uint32_t bufferIndex = (drawCmdBuffer != drawCmdBuffers.end()) ? static_cast<uint32_t>(drawCmdBuffer - drawCmdBuffers.begin()) : currentBuffer;
+		vks::debugutils::cmdBeginLabel(commandBuffer, "UI overlay", glm::vec4(0.9f, 0.9f, 0.9f, 1.0f));
+		UIOverlay.draw(commandBuffer, bufferIndex);
+		vks::debugutils::cmdEndLabel(commandBuffer);
+	}
+}
+
+void VulkanExampleBase::beginSwapchainRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	// Ended in endSwapchainRendering()
+	vks::debugutils::cmdBeginLabel(commandBuffer, "Swapchain rendering", glm::vec4(1.0f, 0.7f, 0.3f, 1.0f));
+	if (!settings.dynamicRendering) {
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.framebuffer = frameBuffers[imageIndex];
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		return;
+	}
+
+	const bool stencil = vks::tools::formatHasStencil(depthFormat);
+	// The previous contents are cleared, the color transition waits for the image acquisition at the color output stage
+	vks::tools::insertImageMemoryBarrier(
+		commandBuffer,
+		swapChain.buffers[imageIndex].image,
+		0,
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+	// The depth image is shared by all frames, so its writes by the previous frame have to be finished
+	vks::tools::insertImageMemoryBarrier(
+		commandBuffer,
+		depthStencil.image,
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		VkImageSubresourceRange{ VK_IMAGE_ASPECT_DEPTH_BIT | (stencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0u), 0, 1, 0, 1 });
+
+	VkRenderingAttachmentInfoKHR colorAttachment{};
+	colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+	colorAttachment.imageView = swapChain.buffers[imageIndex].view;
+	colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.clearValue.color = defaultClearColor;
+
+	VkRenderingAttachmentInfoKHR depthStencilAttachment{};
+	depthStencilAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+	depthStencilAttachment.imageView = depthStencil.view;
+	depthStencilAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthStencilAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthStencilAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	depthStencilAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+	VkRenderingInfoKHR renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+	renderingInfo.renderArea = { 0, 0, width, height };
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachments = &colorAttachment;
+	renderingInfo.pDepthAttachment = &depthStencilAttachment;
+	renderingInfo.pStencilAttachment = stencil ? &depthStencilAttachment : nullptr;
+	vkCmdBeginRenderingKHR(commandBuffer, &renderingInfo);
+}
+
+void VulkanExampleBase::endSwapchainRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	if (!settings.dynamicRendering) {
+		vkCmdEndRenderPass(commandBuffer);
+		vks::debugutils::cmdEndLabel(commandBuffer);
+		return;
+	}
+	vkCmdEndRenderingKHR(commandBuffer);
+	vks::tools::insertImageMemoryBarrier(
+		commandBuffer,
+		swapChain.buffers[imageIndex].image,
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		0,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+	vks::debugutils::cmdEndLabel(commandBuffer);
+}
+
+void VulkanExampleBase::setupPipelineRendering(VkGraphicsPipelineCreateInfo &pipelineCreateInfo)
+{
+	if (settings.dynamicRendering) {
+		// The rendering info is shared, so it can't be put in front of another chain
+		assert((pipelineCreateInfo.pNext == nullptr) || (pipelineCreateInfo.pNext == &pipelineRenderingCreateInfo));
+		pipelineCreateInfo.renderPass = VK_NULL_HANDLE;
+		pipelineCreateInfo.pNext = &pipelineRenderingCreateInfo;
 	}
 }
 
 void VulkanExampleBase::prepareFrame()
 {
+	VKS_TRACE_SCOPE("prepareFrame");
+	latencyTracker.update(swapChain.swapChain);
+	latencyTracker.beginFrame();
+	// Uploads staged since the last frame have to be submitted before the frame's command buffers that use them
+	if (vulkanDevice->stagingRing) {
+		vulkanDevice->stagingRing->submit();
+	}
+	VkSemaphore presentCompleteSemaphore = semaphores.presentComplete;
+	if (!frameObjects.empty()) {
+		// Wait until the GPU has finished the frame that last used this frame's synchronization objects
+		FrameObjects& frame = frameObjects[currentFrame];
+		VKS_TRACE_SCOPE("waitForFrame");
+		if (frameTimeline.semaphore != VK_NULL_HANDLE) {
+			// The timeline value is signaled by a final submission in submitFrame(), the example's submissions stay untouched
+			vulkanDevice->waitTimelineSemaphore(frameTimeline.semaphore, frame.timelineValue, UINT64_MAX);
+			frame.timelineValue = ++frameTimeline.value;
+		}
+		else {
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+			VK_CHECK_RESULT(vkResetFences(device, 1, &frame.fence));
+		}
+		submitInfo.pSignalSemaphores = &frame.renderComplete;
+		presentCompleteSemaphore = frame.presentComplete;
+		submitInfo.pWaitSemaphores = &frame.presentComplete;
+		// Work finishes in submission order, so all frames up to the one that last used this slot are done
+		vulkanDevice->releaseDeferredDestructions(frame.frameNumber);
+		frame.frameNumber = ++frameNumber;
+	}
+	else {
+		// The queue is idle between frames
+		vulkanDevice->releaseDeferredDestructions(frameNumber);
+		++frameNumber;
+	}
+	vulkanDevice->deferredDestructionValue = frameNumber;
 	// Acquire the next image from the swap chain
-	VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
+	VkResult result;
+	{
+		VKS_TRACE_SCOPE("acquireNextImage");
+		if (deviceGroup.deviceCount > 1) {
+			selectFrameDevice();
+		}
+		result = swapChain.acquireNextImage(presentCompleteSemaphore, &currentBuffer, deviceGroup.frameDeviceMask);
+	}
+	if (!frameObjects.empty() && (result != VK_ERROR_OUT_OF_DATE_KHR)) {
+		// The command buffer of the acquired image may still be in use by an older frame, so wait for it before it gets (re)submitted or (re)recorded
+		if (frameTimeline.semaphore != VK_NULL_HANDLE) {
+			uint64_t& imageValue = frameTimeline.imageValues[currentBuffer];
+			vulkanDevice->waitTimelineSemaphore(frameTimeline.semaphore, imageValue, UINT64_MAX);
+			imageValue = frameObjects[currentFrame].timelineValue;
+		}
+		else {
+			VkFence& imageFence = imageFences[currentBuffer];
+			if ((imageFence != VK_NULL_HANDLE) && (imageFence != frameObjects[currentFrame].fence)) {
+				VK_CHECK_RESULT(vkWaitForFences(device, 1, &imageFence, VK_TRUE, UINT64_MAX));
+			}
+			imageFence = frameObjects[currentFrame].fence;
+		}
+	}
+	if (result != VK_ERROR_OUT_OF_DATE_KHR) {
+		// The previous submission of the acquired image's command buffer has finished, so its GPU timings can be read and its overlay buffers written
+		benchmark.gpuProfiler.collect(currentBuffer);
+		frameTimeHistory.addGpuFrame(benchmark.gpuProfiler.results, benchmark.gpuProfiler.resultOffsets);
+		if (vks::Tracer::isActive()) {
+			addTraceGpuScopes(currentBuffer);
+		}
+		if (deviceGroup.deviceCount > 1) {
+			updateDeviceGroupFrame(currentBuffer);
+		}
+		if (settings.dynamicResolutionTarget > 0.0f) {
+			updateDynamicResolution();
+		}
+		if (settings.overlayPass) {
+			// The image's overlay command buffer and buffers may still be in use by the overlay pass of an older frame
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &overlayResources.fences[currentBuffer], VK_TRUE, UINT64_MAX));
+			// The example's submission signals the overlay pass, which then signals presentation
+			submitInfo.pSignalSemaphores = &overlayResources.sceneComplete[currentBuffer];
+			overlayResources.pending = true;
+		}
+		if (settings.overlay) {
+			UIOverlay.upload(currentBuffer);
+		}
+		// Host writes to non-coherent buffers marked so far (e.g. the overlay's vertices) are flushed together
+		VK_CHECK_RESULT(vulkanDevice->flushMappedRanges());
+		// The example submits the image's command buffer right after this
+		if (vks::Tracer::isActive()) {
+			if (traceSubmitTimes.size() <= currentBuffer) {
+				traceSubmitTimes.resize(currentBuffer + 1, 0);
+			}
+			traceSubmitTimes[currentBuffer] = vks::Tracer::now();
+		}
+	}
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE)
 	// SRS - If no longer optimal (VK_SUBOPTIMAL_KHR), wait until submitFrame() in case number of swapchain images will change on resize
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
@@ -746,7 +1669,75 @@ void VulkanExampleBase::prepareFrame()
 
 void VulkanExampleBase::submitFrame()
 {
-	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	VKS_TRACE_SCOPE("submitFrame");
+	if (commandCapture.isCapturing()) {
+		commandCapture.captureFrame(submitInfo, drawCmdBuffers, currentBuffer);
+	}
+	VkSemaphore renderCompleteSemaphore = semaphores.renderComplete;
+	uint64_t frameTimelineValue = 0;
+	if (!frameObjects.empty()) {
+		renderCompleteSemaphore = frameObjects[currentFrame].renderComplete;
+		frameTimelineValue = frameObjects[currentFrame].timelineValue;
+		currentFrame = (currentFrame + 1) % static_cast<uint32_t>(frameObjects.size());
+	}
+	// Presentation and the swap chain's own submissions use the same queue as the example and the loading threads
+	std::unique_lock<std::recursive_mutex> queueLock(vulkanDevice->queueMutex);
+	if (overlayResources.pending) {
+		submitOverlay(renderCompleteSemaphore);
+		overlayResources.pending = false;
+	}
+	if (frameTimeline.semaphore != VK_NULL_HANDLE) {
+		// An empty submission signals the frame's timeline value once all work submitted for the frame has finished
+		VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo{};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timelineSubmitInfo.signalSemaphoreValueCount = 1;
+		timelineSubmitInfo.pSignalSemaphoreValues = &frameTimelineValue;
+		VkSubmitInfo timelineSignalInfo = vks::initializers::submitInfo();
+		timelineSignalInfo.pNext = &timelineSubmitInfo;
+		timelineSignalInfo.signalSemaphoreCount = 1;
+		timelineSignalInfo.pSignalSemaphores = &frameTimeline.semaphore;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &timelineSignalInfo, VK_NULL_HANDLE));
+	}
+	// The frame's transient allocations have been consumed by its submissions
+	frameArena.reset();
+	VkResult result;
+	{
+		VKS_TRACE_SCOPE("queuePresent");
+		VkPresentIdKHR presentIdInfo{};
+		const uint64_t presentId = latencyTracker.presentFrame(swapChain.swapChain);
+		if (presentId != 0) {
+			presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+			presentIdInfo.swapchainCount = 1;
+			presentIdInfo.pPresentIds = &presentId;
+		}
+		const void* presentNext = (presentId != 0) ? &presentIdInfo : nullptr;
+		VkDeviceGroupPresentInfoKHR deviceGroupPresentInfo{};
+		if (deviceGroup.frameDeviceMask != 0) {
+			deviceGroupPresentInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_PRESENT_INFO_KHR;
+			deviceGroupPresentInfo.pNext = presentNext;
+			deviceGroupPresentInfo.swapchainCount = 1;
+			deviceGroupPresentInfo.pDeviceMasks = &deviceGroup.frameDeviceMask;
+			deviceGroupPresentInfo.mode = deviceGroup.presentMode;
+			presentNext = &deviceGroupPresentInfo;
+			if (deviceGroup.presentMode == VK_DEVICE_GROUP_PRESENT_MODE_REMOTE_BIT_KHR) {
+				deviceGroup.remotePresents++;
+			}
+			else {
+				deviceGroup.localPresents++;
+			}
+		}
+		if (offscreenReadback && (frameNumber % settings.offscreenCaptureInterval == 0)) {
+			// The copy waits for the frame instead of the (no-op) present
+			const uint64_t frame = frameNumber;
+			offscreenReadback->capture(swapChain.images[currentBuffer], VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, swapChain.colorFormat, width, height,
+				[frame](const vks::ReadbackRing::Image& image) { vks::ReadbackRing::writePPM("offscreen_" + std::to_string(frame) + ".ppm", image); }, renderCompleteSemaphore);
+			result = VK_SUCCESS;
+		}
+		else {
+			result = swapChain.queuePresent(queue, currentBuffer, renderCompleteSemaphore, presentNext);
+		}
+	}
+	queueLock.unlock();
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		windowResize();
@@ -754,10 +1745,386 @@ void VulkanExampleBase::submitFrame()
 			return;
 		}
 	}
-	else {
-		VK_CHECK_RESULT(result);
+	else {
+		VK_CHECK_RESULT(result);
+	}
+	// With per-frame synchronization objects, waiting is done for the exact frame in prepareFrame()
+	if (frameObjects.empty()) {
+		VKS_TRACE_SCOPE("queueWaitIdle");
+		VK_CHECK_RESULT(vulkanDevice->queueWaitIdle(queue));
+	}
+}
+
+/*
+	Merge the GPU profiler scopes of the last completed submission of an image's command buffer into the trace
+	Without calibrated timestamps the GPU clock can't be related to the CPU clock, so the scopes start at the time the command buffer was
+	submitted and keep their measured offsets and durations. The time the submission waited in the queue isn't visible in the trace.
+*/
+void VulkanExampleBase::addTraceGpuScopes(uint32_t imageIndex)
+{
+	if ((imageIndex >= traceSubmitTimes.size()) || (traceSubmitTimes[imageIndex] == 0)) {
+		return;
+	}
+	const vks::GpuProfiler& profiler = benchmark.gpuProfiler;
+	for (size_t i = 0; i < profiler.results.size(); i++) {
+		const uint64_t begin = traceSubmitTimes[imageIndex] + static_cast<uint64_t>(profiler.resultOffsets[i] * 1000000.0);
+		vks::Tracer::addGpuScope(profiler.results[i].first, begin, begin + static_cast<uint64_t>(profiler.results[i].second * 1000000.0));
+	}
+}
+
+VkFence VulkanExampleBase::getFrameFence() const
+{
+	return (!frameObjects.empty() && (frameTimeline.semaphore == VK_NULL_HANDLE)) ? frameObjects[currentFrame].fence : VK_NULL_HANDLE;
+}
+
+void VulkanExampleBase::waitForFramesInFlight()
+{
+	if (frameObjects.empty()) {
+		return;
+	}
+	if (frameTimeline.semaphore != VK_NULL_HANDLE) {
+		vulkanDevice->waitTimelineSemaphore(frameTimeline.semaphore, frameTimeline.value, UINT64_MAX);
+		return;
+	}
+	for (auto& frame : frameObjects) {
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+	}
+}
+
+void VulkanExampleBase::deferDestruction(std::function<void()> destroy)
+{
+	vulkanDevice->deferDestruction(frameNumber, destroy);
+}
+
+bool VulkanExampleBase::updateRenderResolution()
+{
+	const uint32_t maxDimension = deviceProperties.limits.maxImageDimension2D;
+	const uint32_t maxWidth = (renderResolution.maxExtent.width > 0) ? std::min(renderResolution.maxExtent.width, maxDimension) : maxDimension;
+	const uint32_t maxHeight = (renderResolution.maxExtent.height > 0) ? std::min(renderResolution.maxExtent.height, maxDimension) : maxDimension;
+	// Both dimensions are limited by the same factor to keep the window's aspect ratio
+	const float scale = std::min(renderResolution.scale, std::min((float)maxWidth / (float)std::max(width, 1u), (float)maxHeight / (float)std::max(height, 1u)));
+	VkExtent2D& renderExtent = renderResolution.renderExtent;
+	VkExtent2D& attachmentExtent = renderResolution.attachmentExtent;
+	renderExtent.width = std::min(std::max(static_cast<uint32_t>(width * scale + 0.5f), 1u), maxWidth);
+	renderExtent.height = std::min(std::max(static_cast<uint32_t>(height * scale + 0.5f), 1u), maxHeight);
+	const bool grow = (renderExtent.width > attachmentExtent.width) || (renderExtent.height > attachmentExtent.height);
+	if (grow) {
+		// Round up so enlarging the window in small steps doesn't reallocate on every resize
+		attachmentExtent.width = std::max(attachmentExtent.width, std::min((renderExtent.width + 255) / 256 * 256, maxDimension));
+		attachmentExtent.height = std::max(attachmentExtent.height, std::min((renderExtent.height + 255) / 256 * 256, maxDimension));
+	}
+	renderResolution.uvScale = glm::vec2((float)renderExtent.width / (float)attachmentExtent.width, (float)renderExtent.height / (float)attachmentExtent.height);
+	return grow;
+}
+
+void VulkanExampleBase::waitForPreviousFrames()
+{
+	if (frameObjects.empty()) {
+		return;
+	}
+	// The current frame's slot has already been waited for and isn't submitted yet
+	if (frameTimeline.semaphore != VK_NULL_HANDLE) {
+		vulkanDevice->waitTimelineSemaphore(frameTimeline.semaphore, frameTimeline.value - 1, UINT64_MAX);
+		return;
+	}
+	for (uint32_t i = 0; i < frameObjects.size(); i++) {
+		if (i != currentFrame) {
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &frameObjects[i].fence, VK_TRUE, UINT64_MAX));
+		}
+	}
+}
+
+/*
+	Account the frame with the performance governor and apply its policy if the level changed, the governor is started with the
+	first frame so the example's frame limit and dynamic resolution range (set before prepare) are the limits of its full level
+*/
+void VulkanExampleBase::updatePerformanceGovernor(double frameTime)
+{
+	// Benchmarks measure the example at the limits they were started with
+	if (benchmark.active) {
+		return;
+	}
+	if (!performanceGovernor.isActive()) {
+		performanceGovernor.setup(settings.frameLimit, dynamicResolution.maxScale);
+		applyPerformancePolicy();
+		return;
+	}
+	if (performanceGovernor.update(frameTime)) {
+		applyPerformancePolicy();
+	}
+}
+
+void VulkanExampleBase::applyPerformancePolicy()
+{
+	const vks::PerformanceGovernor::Policy& policy = performanceGovernor.getPolicy();
+	settings.frameLimit = policy.frameLimit;
+	dynamicResolution.maxScale = policy.maxScale;
+	// Only for examples rendering at renderResolution, the dynamic resolution controller scales back up within the new limit by itself
+	if (renderResolution.renderExtent.width > 0) {
+		const float scale = (settings.dynamicResolutionTarget > 0.0f) ? std::min(renderResolution.scale, policy.maxScale) : policy.maxScale;
+		if (std::abs(scale - renderResolution.scale) >= dynamicResolution.step * 0.5f) {
+			waitForPreviousFrames();
+			renderResolution.scale = scale;
+			renderResolutionChanged();
+			dynamicResolution.samples = 0;
+			dynamicResolution.skipSamples = swapChain.imageCount;
+		}
+	}
+	qualityLevelChanged(policy.quality);
+}
+
+void VulkanExampleBase::updateDynamicResolution()
+{
+	const std::vector<std::pair<std::string, double>>& results = benchmark.gpuProfiler.results;
+	if (results.empty()) {
+		return;
+	}
+	if (dynamicResolution.skipSamples > 0) {
+		dynamicResolution.skipSamples--;
+		return;
+	}
+	double gpuTime = 0.0;
+	for (auto& result : results) {
+		gpuTime += result.second;
+	}
+	dynamicResolution.gpuTime = (dynamicResolution.samples == 0) ? gpuTime : (dynamicResolution.gpuTime * 0.9 + gpuTime * 0.1);
+	// Only adjust once the average has settled
+	if (++dynamicResolution.samples < 16) {
+		return;
+	}
+	// Keep the scale while the frame time is between 80 and 100 percent of the target
+	const double target = settings.dynamicResolutionTarget;
+	if ((dynamicResolution.gpuTime <= target) && (dynamicResolution.gpuTime >= target * 0.8)) {
+		return;
+	}
+	// Pixel bound work scales with the area, so aim for 90 percent of the target (which leaves room for work that doesn't scale)
+	float scale = renderResolution.scale * (float)sqrt(target * 0.9 / dynamicResolution.gpuTime);
+	scale = std::round(scale / dynamicResolution.step) * dynamicResolution.step;
+	scale = std::min(std::max(scale, dynamicResolution.minScale), dynamicResolution.maxScale);
+	if (std::abs(scale - renderResolution.scale) < dynamicResolution.step * 0.5f) {
+		return;
+	}
+	// The example records its command buffers again, which may still be used by earlier frames
+	waitForPreviousFrames();
+	renderResolution.scale = scale;
+	renderResolutionChanged();
+	dynamicResolution.samples = 0;
+	dynamicResolution.skipSamples = swapChain.imageCount;
+}
+
+// Records the queue family ownership transfer of the async compute buffers, the release on the source queue's command buffer
+// only uses the source stages and accesses and the acquire on the destination queue's command buffer only the destination ones
+void VulkanExampleBase::recordAsyncComputeTransfer(VkCommandBuffer commandBuffer, const std::vector<AsyncComputeBuffer>& buffers, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, bool toGraphics, bool release)
+{
+	vks::FrameVector<VkBufferMemoryBarrier> barriers(frameArena);
+	barriers.resize(buffers.size());
+	VkPipelineStageFlags stages = 0;
+	for (size_t i = 0; i < buffers.size(); i++) {
+		const AsyncComputeBuffer& buffer = buffers[i];
+		// Compute is the source when transferring to graphics, graphics when transferring back
+		const VkAccessFlags srcAccess = toGraphics ? buffer.computeAccess : buffer.graphicsAccess;
+		const VkAccessFlags dstAccess = toGraphics ? buffer.graphicsAccess : buffer.computeAccess;
+		barriers[i] = vks::initializers::bufferMemoryBarrier();
+		barriers[i].srcAccessMask = release ? srcAccess : 0;
+		barriers[i].dstAccessMask = release ? 0 : dstAccess;
+		barriers[i].srcQueueFamilyIndex = srcQueueFamilyIndex;
+		barriers[i].dstQueueFamilyIndex = dstQueueFamilyIndex;
+		barriers[i].buffer = buffer.buffer;
+		barriers[i].offset = 0;
+		barriers[i].size = VK_WHOLE_SIZE;
+		if (release) {
+			stages |= toGraphics ? buffer.computeStages : buffer.graphicsStages;
+		}
+		else {
+			stages |= toGraphics ? buffer.graphicsStages : buffer.computeStages;
+		}
+	}
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		release ? stages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
+		release ? static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT) : stages,
+		0,
+		0, nullptr,
+		static_cast<uint32_t>(barriers.size()), barriers.data(),
+		0, nullptr);
+}
+
+/**
+* Set up the async compute path
+*
+* Each frame the example records its compute work into the command buffer returned by beginAsyncCompute() and submits it with submitAsyncCompute()
+* before the frame's graphics work. The compute submission writes the buffers of one slot while the graphics submission reads the buffers of the
+* slot written by the previous compute submission, so both queues can run at the same time at the cost of one frame of latency. Readers and writers
+* of a slot are ordered with binary semaphores, and if the compute queue is from a different family the registered buffers are released and acquired
+* by the base class.
+*
+* @note The first frame reads the last slot before compute has written it, so the example has to initialize the buffers of all slots
+* @note One compute submission is expected per graphics submission, otherwise the graphics queue reads a slot whose buffers are owned by compute
+*/
+void VulkanExampleBase::prepareAsyncCompute(uint32_t slotCount)
+{
+	assert(slotCount >= 2);
+	// The VulkanDevice::createLogicalDevice functions finds a compute capable queue and prefers queue families that only support compute
+	asyncCompute.queueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
+	vkGetDeviceQueue(device, asyncCompute.queueFamilyIndex, 0, &asyncCompute.queue);
+
+	VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+	cmdPoolInfo.queueFamilyIndex = asyncCompute.queueFamilyIndex;
+	cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &asyncCompute.commandPool));
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+	asyncCompute.slots.resize(slotCount);
+	for (auto& slot : asyncCompute.slots) {
+		slot.commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, asyncCompute.commandPool);
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &slot.fence));
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &slot.computeComplete));
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &slot.graphicsComplete));
+	}
+	asyncCompute.writeSlot = 0;
+	asyncCompute.readSlot = slotCount - 1;
+}
+
+void VulkanExampleBase::addAsyncComputeBuffer(uint32_t slot, VkBuffer buffer, VkPipelineStageFlags computeStages, VkAccessFlags computeAccess, VkPipelineStageFlags graphicsStages, VkAccessFlags graphicsAccess)
+{
+	assert(slot < asyncCompute.slots.size());
+	AsyncComputeBuffer asyncComputeBuffer = { buffer, computeStages, computeAccess, graphicsStages, graphicsAccess };
+	asyncCompute.slots[slot].buffers.push_back(asyncComputeBuffer);
+}
+
+VkCommandBuffer VulkanExampleBase::beginAsyncCompute()
+{
+	AsyncComputeSlot& slot = asyncCompute.slots[asyncCompute.writeSlot];
+	// The slot's last compute submission has to be finished before its command buffer can be recorded again
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+	VK_CHECK_RESULT(vkResetFences(device, 1, &slot.fence));
+	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+	cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VK_CHECK_RESULT(vkBeginCommandBuffer(slot.commandBuffer, &cmdBufInfo));
+	// Take back the buffers the graphics queue released after reading them
+	if (slot.releasedToCompute && !slot.buffers.empty()) {
+		recordAsyncComputeTransfer(slot.commandBuffer, slot.buffers, vulkanDevice->queueFamilyIndices.graphics, asyncCompute.queueFamilyIndex, false, false);
+	}
+	slot.releasedToCompute = false;
+	return slot.commandBuffer;
+}
+
+void VulkanExampleBase::submitAsyncCompute()
+{
+	AsyncComputeSlot& slot = asyncCompute.slots[asyncCompute.writeSlot];
+	const bool transfer = (vulkanDevice->queueFamilyIndices.graphics != asyncCompute.queueFamilyIndex) && !slot.buffers.empty();
+	if (transfer) {
+		recordAsyncComputeTransfer(slot.commandBuffer, slot.buffers, asyncCompute.queueFamilyIndex, vulkanDevice->queueFamilyIndices.graphics, true, true);
+	}
+	VK_CHECK_RESULT(vkEndCommandBuffer(slot.commandBuffer));
+
+	VkPipelineStageFlags computeStages = 0;
+	for (auto& buffer : slot.buffers) {
+		computeStages |= buffer.computeStages;
+	}
+	if (computeStages == 0) {
+		computeStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	}
+	VkSemaphore waitSemaphores[2];
+	VkPipelineStageFlags waitStages[2];
+	uint32_t waitSemaphoreCount = 0;
+	// Don't overwrite the slot before the graphics queue has finished reading it
+	if (slot.graphicsPending) {
+		waitSemaphores[waitSemaphoreCount] = slot.graphicsComplete;
+		waitStages[waitSemaphoreCount++] = computeStages;
+		slot.graphicsPending = false;
+	}
+	// If no graphics submission consumed the slot's last signal (e.g. a frame was skipped due to a swap chain resize), consume it here as a binary semaphore can't be signaled twice
+	if (slot.computePending) {
+		waitSemaphores[waitSemaphoreCount] = slot.computeComplete;
+		waitStages[waitSemaphoreCount++] = computeStages;
+	}
+	VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
+	computeSubmitInfo.commandBufferCount = 1;
+	computeSubmitInfo.pCommandBuffers = &slot.commandBuffer;
+	computeSubmitInfo.waitSemaphoreCount = waitSemaphoreCount;
+	computeSubmitInfo.pWaitSemaphores = waitSemaphores;
+	computeSubmitInfo.pWaitDstStageMask = waitStages;
+	computeSubmitInfo.signalSemaphoreCount = 1;
+	computeSubmitInfo.pSignalSemaphores = &slot.computeComplete;
+	VK_CHECK_RESULT(vulkanDevice->queueSubmit(asyncCompute.queue, 1, &computeSubmitInfo, slot.fence));
+	slot.computePending = true;
+	slot.releasedToGraphics = transfer;
+
+	// Graphics reads the slot written by the previous submission, so it doesn't have to wait for the one just submitted
+	const uint32_t slotCount = static_cast<uint32_t>(asyncCompute.slots.size());
+	asyncCompute.readSlot = (asyncCompute.writeSlot + slotCount - 1) % slotCount;
+	asyncCompute.writeSlot = (asyncCompute.writeSlot + 1) % slotCount;
+}
+
+void VulkanExampleBase::acquireAsyncComputeBuffers(VkCommandBuffer commandBuffer)
+{
+	AsyncComputeSlot& slot = asyncCompute.slots[asyncCompute.readSlot];
+	if (slot.releasedToGraphics) {
+		recordAsyncComputeTransfer(commandBuffer, slot.buffers, asyncCompute.queueFamilyIndex, vulkanDevice->queueFamilyIndices.graphics, true, false);
+	}
+}
+
+void VulkanExampleBase::releaseAsyncComputeBuffers(VkCommandBuffer commandBuffer)
+{
+	AsyncComputeSlot& slot = asyncCompute.slots[asyncCompute.readSlot];
+	if (slot.releasedToGraphics) {
+		recordAsyncComputeTransfer(commandBuffer, slot.buffers, vulkanDevice->queueFamilyIndices.graphics, asyncCompute.queueFamilyIndex, false, true);
+		slot.releasedToGraphics = false;
+		slot.releasedToCompute = true;
+	}
+}
+
+VkSubmitInfo VulkanExampleBase::getAsyncComputeSubmitInfo()
+{
+	VkSubmitInfo info = submitInfo;
+	if (asyncCompute.slots.empty()) {
+		return info;
+	}
+	AsyncComputeSlot& slot = asyncCompute.slots[asyncCompute.readSlot];
+	asyncCompute.waitSemaphores.assign(submitInfo.pWaitSemaphores, submitInfo.pWaitSemaphores + submitInfo.waitSemaphoreCount);
+	asyncCompute.waitStages.assign(submitInfo.pWaitDstStageMask, submitInfo.pWaitDstStageMask + submitInfo.waitSemaphoreCount);
+	asyncCompute.signalSemaphores.assign(submitInfo.pSignalSemaphores, submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+	if (slot.computePending) {
+		VkPipelineStageFlags graphicsStages = 0;
+		for (auto& buffer : slot.buffers) {
+			graphicsStages |= buffer.graphicsStages;
+		}
+		asyncCompute.waitSemaphores.push_back(slot.computeComplete);
+		asyncCompute.waitStages.push_back((graphicsStages != 0) ? graphicsStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT));
+		slot.computePending = false;
+	}
+	// A slot read by several graphics submissions (no compute submission in between) consumes the previous signal before signaling again
+	if (slot.graphicsPending) {
+		asyncCompute.waitSemaphores.push_back(slot.graphicsComplete);
+		asyncCompute.waitStages.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	}
+	asyncCompute.signalSemaphores.push_back(slot.graphicsComplete);
+	slot.graphicsPending = true;
+	info.waitSemaphoreCount = static_cast<uint32_t>(asyncCompute.waitSemaphores.size());
+	info.pWaitSemaphores = asyncCompute.waitSemaphores.data();
+	info.pWaitDstStageMask = asyncCompute.waitStages.data();
+	info.signalSemaphoreCount = static_cast<uint32_t>(asyncCompute.signalSemaphores.size());
+	info.pSignalSemaphores = asyncCompute.signalSemaphores.data();
+	return info;
+}
+
+void VulkanExampleBase::destroyAsyncCompute()
+{
+	if (asyncCompute.queue == VK_NULL_HANDLE) {
+		return;
+	}
+	VK_CHECK_RESULT(vulkanDevice->queueWaitIdle(asyncCompute.queue));
+	for (auto& slot : asyncCompute.slots) {
+		vkDestroyFence(device, slot.fence, nullptr);
+		vkDestroySemaphore(device, slot.computeComplete, nullptr);
+		vkDestroySemaphore(device, slot.graphicsComplete, nullptr);
 	}
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	asyncCompute.slots.clear();
+	vkDestroyCommandPool(device, asyncCompute.commandPool, nullptr);
+	asyncCompute.commandPool = VK_NULL_HANDLE;
+	asyncCompute.queue = VK_NULL_HANDLE;
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
@@ -783,6 +2150,9 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	commandLineParser.add("help", { "--help" }, 0, "Show help");
 	commandLineParser.add("validation", { "-v", "--validation" }, 0, "Enable validation layers");
 	commandLineParser.add("vsync", { "-vs", "--vsync" }, 0, "Enable V-Sync");
+	commandLineParser.add("presentmode", { "-pm", "--presentmode" }, 1, "Select swapchain present mode (fifo, fiforelaxed, mailbox or immediate)");
+	commandLineParser.add("swapchainimages", { "-si", "--swapchainimages" }, 1, "Set minimum number of swapchain images");
+	commandLineParser.add("framelimit", { "-fl", "--framelimit" }, 1, "Limit frame rate to the given frame time in ms");
 	commandLineParser.add("fullscreen", { "-f", "--fullscreen" }, 0, "Start in fullscreen mode");
 	commandLineParser.add("width", { "-w", "--width" }, 1, "Set window width");
 	commandLineParser.add("height", { "-h", "--height" }, 1, "Set window height");
@@ -795,6 +2165,37 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
 	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
 	commandLineParser.add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
+	commandLineParser.add("benchmarkjsonfile", { "-bj", "--benchjson" }, 1, "Set file name for benchmark results in JSON format");
+	commandLineParser.add("benchmarkbudgets", { "-bb", "--benchbudgets" }, 1, "Set comma separated frame time budgets in ms for benchmark statistics (default 16.6,33.3)");
+	commandLineParser.add("benchmarkbaseline", { "-bbl", "--benchbaseline" }, 1, "Compare benchmark results against a previous result file and exit with an error on regressions");
+	commandLineParser.add("benchmarkpipelinestatistics", { "-bps", "--benchpipelinestats" }, 0, "Collect pipeline statistics (shader invocations, primitives) per frame in benchmark mode");
+	commandLineParser.add("benchmarkthreshold", { "-brt", "--benchthreshold" }, 1, "Set the allowed increase in percent for benchmark baseline comparisons (default 5)");
+	commandLineParser.add("benchmarkspecification", { "-bs", "--benchspec" }, 1, "Load a benchmark specification with a fixed animation time step and a camera path for reproducible runs");
+	commandLineParser.add("benchmarkreplay", { "-brp", "--benchreplay" }, 1, "Capture the submissions and mapped buffer contents of the given number of frames at the start of the warm up and replay them for the rest of the benchmark, measuring the GPU cost without the example's CPU updates");
+	commandLineParser.add("framesinflight", { "-fif", "--framesinflight" }, 1, "Set number of frames processed concurrently by CPU and GPU (default 1)");
+	commandLineParser.add("timelinesemaphores", { "-tls", "--timelinesemaphores" }, 0, "Use timeline semaphores for frame synchronization (if supported)");
+	commandLineParser.add("memoryallocator", { "-ma", "--memoryallocator" }, 0, "Sub-allocate buffer and texture memory from larger memory blocks");
+	commandLineParser.add("defragment", { "-dfg", "--defragment" }, 1, "Move resources out of sparsely used memory blocks with the given CPU time budget in ms per frame, so emptied blocks are released (enables the memory allocator)");
+	commandLineParser.add("transferqueue", { "-tq", "--transferqueue" }, 0, "Upload assets on a dedicated transfer queue (if available)");
+	commandLineParser.add("nopipelinecache", { "-npc", "--nopipelinecache" }, 0, "Don't load or store the pipeline cache on disk");
+	commandLineParser.add("hotreload", { "-hr", "--hotreload" }, 0, "Recompile changed shaders in the background and rebuild their pipelines (needs glslangValidator or dxc)");
+	commandLineParser.add("overlaypass", { "-op", "--overlaypass" }, 0, "Draw the UI overlay in a separate pass recorded every frame");
+	commandLineParser.add("shadermoduleidentifiers", { "-smi", "--shadermoduleidentifiers" }, 0, "Skip shader module creation for pipelines found in the pipeline cache (if supported)");
+	commandLineParser.add("dynamicresolution", { "-dr", "--dynamicresolution" }, 1, "Scale the render resolution to hold the given GPU frame time in ms (for examples supporting it)");
+	commandLineParser.add("frametimewindow", { "-ftw", "--frametimewindow" }, 1, "Number of recent frames the frame time graphs of the UI overlay show (defaults to 300)");
+	commandLineParser.add("stresstest", { "-st", "--stresstest" }, 0, "Step through the workload sizes of examples supporting a stress test and print the timings of each");
+	commandLineParser.add("startupreport", { "-sr", "--startupreport" }, 0, "Print the durations of the startup phases, asset loads and pipeline creations ranked once the first frame has been rendered");
+	commandLineParser.add("startupreportfile", { "-srf", "--startupreportfile" }, 1, "Also save the startup report to the given CSV file (implies --startupreport)");
+	commandLineParser.add("latency", { "-lat", "--latency" }, 0, "Measure the latency from input events to presentation (using VK_KHR_present_wait if supported) and print it at exit");
+	commandLineParser.add("offscreen", { "-os", "--offscreen" }, 0, "Render into offscreen images without a window, presenting is a no-op (for benchmarks on servers without a display or compositor)");
+	commandLineParser.add("offscreenframes", { "-osf", "--offscreenframes" }, 1, "Number of frames to render in offscreen mode outside of benchmarks (default: until terminated)");
+	commandLineParser.add("offscreencapture", { "-osc", "--offscreencapture" }, 1, "Save every n-th offscreen frame as offscreen_<frame>.ppm");
+	commandLineParser.add("devicegroup", { "-dg", "--devicegroup" }, 0, "Render alternate frames on the devices of the selected GPU's device group (VK_KHR_device_group), use with --framesinflight of at least the number of devices");
+	commandLineParser.add("perfgovernor", { "-pg", "--perfgovernor" }, 0, "Adjust the frame limit, render resolution and effect quality to the thermal status (Android) and frame time headroom and log the time spent at each level");
+	commandLineParser.add("lazyloading", { "-ll", "--lazyloading" }, 0, "Render the first frame before the assets have been loaded, with placeholder textures until they are streamed in (for examples supporting it)");
+	commandLineParser.add("trace", { "-tr", "--trace" }, 1, "Record CPU scopes and GPU profiler scopes and save them to the given Chrome trace JSON file at exit (chrome://tracing or ui.perfetto.dev)");
+	commandLineParser.add("halfprecision", { "-hp", "--halfprecision" }, 0, "Use the half precision (fp16) shader variants of examples supporting it if the device supports shaderFloat16 (VK_KHR_shader_float16_int8)");
+	commandLineParser.add("imagecompression", { "-ic", "--imagecompression" }, 1, "Request framebuffer compression for the render targets of examples supporting it (lossless, fixedrate or disabled) and report the applied compression (VK_EXT_image_compression_control)");
 
 	commandLineParser.parse(args);
 	if (commandLineParser.isSet("help")) {
@@ -811,6 +2212,45 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	if (commandLineParser.isSet("vsync")) {
 		settings.vsync = true;
 	}
+	if (commandLineParser.isSet("presentmode")) {
+		const std::string presentMode = commandLineParser.getValueAsString("presentmode", "");
+		const std::unordered_map<std::string, VkPresentModeKHR> presentModes = {
+			{ "fifo", VK_PRESENT_MODE_FIFO_KHR },
+			{ "fiforelaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR },
+			{ "mailbox", VK_PRESENT_MODE_MAILBOX_KHR },
+			{ "immediate", VK_PRESENT_MODE_IMMEDIATE_KHR }
+		};
+		if (presentModes.count(presentMode) > 0) {
+			settings.presentMode = presentModes.at(presentMode);
+		}
+		else {
+			std::cerr << "Unknown present mode \"" << presentMode << "\", using default" << "\n";
+		}
+	}
+	if (commandLineParser.isSet("halfprecision")) {
+		settings.halfPrecision = true;
+	}
+	if (commandLineParser.isSet("imagecompression")) {
+		const std::string imageCompression = commandLineParser.getValueAsString("imagecompression", "");
+		const std::unordered_map<std::string, VkImageCompressionFlagsEXT> imageCompressions = {
+			{ "lossless", VK_IMAGE_COMPRESSION_DEFAULT_EXT },
+			{ "fixedrate", VK_IMAGE_COMPRESSION_FIXED_RATE_DEFAULT_EXT },
+			{ "disabled", VK_IMAGE_COMPRESSION_DISABLED_EXT }
+		};
+		if (imageCompressions.count(imageCompression) > 0) {
+			settings.imageCompressionControl = true;
+			settings.imageCompression = imageCompressions.at(imageCompression);
+		}
+		else {
+			std::cerr << "Unknown image compression \"" << imageCompression << "\", using default" << "\n";
+		}
+	}
+	if (commandLineParser.isSet("swapchainimages")) {
+		settings.swapchainImageCount = std::max(0, commandLineParser.getValueAsInt("swapchainimages", 0));
+	}
+	if (commandLineParser.isSet("framelimit")) {
+		settings.frameLimit = std::max(0.0, atof(commandLineParser.getValueAsString("framelimit", "0").c_str()));
+	}
 	if (commandLineParser.isSet("height")) {
 		height = commandLineParser.getValueAsInt("height", width);
 	}
@@ -848,6 +2288,109 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	if (commandLineParser.isSet("benchmarkframes")) {
 		benchmark.outputFrames = commandLineParser.getValueAsInt("benchmarkframes", benchmark.outputFrames);
 	}
+	if (commandLineParser.isSet("benchmarkjsonfile")) {
+		benchmark.jsonFilename = commandLineParser.getValueAsString("benchmarkjsonfile", benchmark.jsonFilename);
+	}
+	if (commandLineParser.isSet("benchmarkbaseline")) {
+		benchmark.baselineFilename = commandLineParser.getValueAsString("benchmarkbaseline", benchmark.baselineFilename);
+	}
+	if (commandLineParser.isSet("benchmarkpipelinestatistics")) {
+		benchmark.pipelineStatistics = true;
+	}
+	if (commandLineParser.isSet("benchmarkthreshold")) {
+		benchmark.regressionThreshold = atof(commandLineParser.getValueAsString("benchmarkthreshold", "5").c_str());
+	}
+	if (commandLineParser.isSet("benchmarkspecification")) {
+		const std::string filename = commandLineParser.getValueAsString("benchmarkspecification", "");
+		if (!benchmark.loadSpecification(filename)) {
+			vks::tools::exitFatal("Could not load benchmark specification \"" + filename + "\"", -1);
+		}
+	}
+	if (commandLineParser.isSet("benchmarkreplay")) {
+		benchmark.replayFrames = static_cast<uint32_t>(std::max(1, commandLineParser.getValueAsInt("benchmarkreplay", 60)));
+		// The buffers have to be registered when they are mapped, which happens while the example is prepared
+		vks::CommandCapture::enableMappingTracking();
+	}
+	if (commandLineParser.isSet("benchmarkbudgets")) {
+		std::stringstream budgets(commandLineParser.getValueAsString("benchmarkbudgets", ""));
+		std::string budget;
+		benchmark.frameBudgets.clear();
+		while (std::getline(budgets, budget, ',')) {
+			double value = atof(budget.c_str());
+			if (value > 0.0) {
+				benchmark.frameBudgets.push_back(value);
+			}
+		}
+	}
+	if (commandLineParser.isSet("memoryallocator")) {
+		settings.memoryAllocator = true;
+	}
+	if (commandLineParser.isSet("defragment")) {
+		settings.defragmentBudget = std::max(0.0f, static_cast<float>(atof(commandLineParser.getValueAsString("defragment", "0.5").c_str())));
+		settings.memoryAllocator = settings.memoryAllocator || (settings.defragmentBudget > 0.0f);
+	}
+	if (commandLineParser.isSet("transferqueue")) {
+		settings.transferQueue = true;
+	}
+	if (commandLineParser.isSet("framesinflight")) {
+		settings.framesInFlight = std::max(1, commandLineParser.getValueAsInt("framesinflight", settings.framesInFlight));
+	}
+	if (commandLineParser.isSet("timelinesemaphores")) {
+		settings.timelineSemaphores = true;
+	}
+	if (commandLineParser.isSet("nopipelinecache")) {
+		settings.persistentPipelineCache = false;
+	}
+	if (commandLineParser.isSet("hotreload")) {
+		settings.shaderHotReload = true;
+	}
+	if (commandLineParser.isSet("overlaypass")) {
+		settings.overlayPass = true;
+	}
+	if (commandLineParser.isSet("shadermoduleidentifiers")) {
+		settings.shaderModuleIdentifiers = true;
+	}
+	if (commandLineParser.isSet("dynamicresolution")) {
+		settings.dynamicResolutionTarget = std::max(0.0f, (float)atof(commandLineParser.getValueAsString("dynamicresolution", "0").c_str()));
+	}
+	if (commandLineParser.isSet("stresstest")) {
+		settings.stressTest = true;
+	}
+	if (commandLineParser.isSet("frametimewindow")) {
+		settings.frameTimeWindow = std::max(commandLineParser.getValueAsInt("frametimewindow", settings.frameTimeWindow), 1);
+		frameTimeHistory.setWindow(settings.frameTimeWindow);
+	}
+	if (commandLineParser.isSet("lazyloading")) {
+		settings.lazyLoading = true;
+	}
+	if (commandLineParser.isSet("latency")) {
+		settings.measureLatency = true;
+	}
+	if (commandLineParser.isSet("offscreen")) {
+#if (defined(VK_USE_PLATFORM_ANDROID_KHR) || defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK) || defined(VK_USE_PLATFORM_DIRECTFB_EXT))
+		std::cerr << "Offscreen mode is not supported on this platform\n";
+#else
+		settings.offscreen = true;
+		settings.offscreenFrames = static_cast<uint32_t>(std::max(commandLineParser.getValueAsInt("offscreenframes", 0), 0));
+		settings.offscreenCaptureInterval = static_cast<uint32_t>(std::max(commandLineParser.getValueAsInt("offscreencapture", 0), 0));
+#endif
+	}
+	if (commandLineParser.isSet("devicegroup")) {
+		settings.deviceGroup = true;
+	}
+	if (commandLineParser.isSet("perfgovernor")) {
+		settings.performanceGovernor = true;
+	}
+	if (commandLineParser.isSet("trace")) {
+		settings.traceFilename = commandLineParser.getValueAsString("trace", settings.traceFilename);
+		vks::Tracer::setThreadName("main");
+		vks::Tracer::start();
+	}
+	if (commandLineParser.isSet("startupreport") || commandLineParser.isSet("startupreportfile")) {
+		settings.startupReport = true;
+		settings.startupReportFilename = commandLineParser.getValueAsString("startupreportfile", settings.startupReportFilename);
+		vks::StartupReport::start();
+	}
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// Vulkan library is loaded dynamically on Android
@@ -856,9 +2399,13 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 #elif defined(_DIRECT2DISPLAY)
 
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	initWaylandConnection();
+	if (!settings.offscreen) {
+		initWaylandConnection();
+	}
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	initxcbConnection();
+	if (!settings.offscreen) {
+		initxcbConnection();
+	}
 #endif
 
 #if defined(_WIN32)
@@ -873,7 +2420,25 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 
 VulkanExampleBase::~VulkanExampleBase()
 {
+	if (settings.measureLatency && !benchmark.active) {
+		printInputLatency();
+	}
+	performanceGovernor.printSummary();
+	printDeviceGroupSummary();
+	if (memoryDefragmenter) {
+		memoryDefragmenter->printStatistics();
+	}
+	if (!settings.traceFilename.empty()) {
+		vks::Tracer::save(settings.traceFilename);
+	}
+	delete shaderWatcher;
+	// Jobs of the shared pool may still reference the example
+	threadPoolShared.reset();
 	// Clean up Vulkan resources
+	// The render loop waits for the device to become idle before returning, retired swap chains have to be destroyed before the surface
+	vulkanDevice->releaseDeferredDestructions();
+	offscreenReadback.reset();
+	memoryDefragmenter.reset();
 	swapChain.cleanup();
 	if (descriptorPool != VK_NULL_HANDLE)
 	{
@@ -889,14 +2454,12 @@ VulkanExampleBase::~VulkanExampleBase()
 		vkDestroyFramebuffer(device, frameBuffers[i], nullptr);
 	}
 
-	for (auto& shaderModule : shaderModules)
-	{
-		vkDestroyShaderModule(device, shaderModule, nullptr);
-	}
+	delete shaderModuleCache;
 	vkDestroyImageView(device, depthStencil.view, nullptr);
 	vkDestroyImage(device, depthStencil.image, nullptr);
-	vkFreeMemory(device, depthStencil.mem, nullptr);
+	vulkanDevice->freeMemory(depthStencil.mem);
 
+	savePipelineCache();
 	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 
 	vkDestroyCommandPool(device, cmdPool, nullptr);
@@ -906,6 +2469,13 @@ VulkanExampleBase::~VulkanExampleBase()
 	for (auto& fence : waitFences) {
 		vkDestroyFence(device, fence, nullptr);
 	}
+	destroyFrameObjects();
+	destroyAsyncCompute();
+	destroyOverlayFrames();
+	if (overlayResources.renderPass != VK_NULL_HANDLE) {
+		vkDestroyRenderPass(device, overlayResources.renderPass, nullptr);
+	}
+	benchmark.gpuProfiler.destroy();
 
 	if (settings.overlay) {
 		UIOverlay.freeResources();
@@ -934,33 +2504,41 @@ VulkanExampleBase::~VulkanExampleBase()
 	if (dfb)
 		dfb->Release(dfb);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	xdg_toplevel_destroy(xdg_toplevel);
-	xdg_surface_destroy(xdg_surface);
-	wl_surface_destroy(surface);
-	if (keyboard)
-		wl_keyboard_destroy(keyboard);
-	if (pointer)
-		wl_pointer_destroy(pointer);
-	if (seat)
-		wl_seat_destroy(seat);
-	xdg_wm_base_destroy(shell);
-	wl_compositor_destroy(compositor);
-	wl_registry_destroy(registry);
-	wl_display_disconnect(display);
+	if (!settings.offscreen) {
+		xdg_toplevel_destroy(xdg_toplevel);
+		xdg_surface_destroy(xdg_surface);
+		wl_surface_destroy(surface);
+		if (keyboard)
+			wl_keyboard_destroy(keyboard);
+		if (pointer)
+			wl_pointer_destroy(pointer);
+		if (seat)
+			wl_seat_destroy(seat);
+		xdg_wm_base_destroy(shell);
+		wl_compositor_destroy(compositor);
+		wl_registry_destroy(registry);
+		wl_display_disconnect(display);
+	}
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// todo : android cleanup (if required)
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	xcb_destroy_window(connection, window);
-	xcb_disconnect(connection);
+	if (!settings.offscreen) {
+		xcb_destroy_window(connection, window);
+		xcb_disconnect(connection);
+	}
 #endif
 }
 
 bool VulkanExampleBase::initVulkan()
 {
+	VKS_STARTUP_SCOPE(vks::StartupReport::Phase, "initVulkan");
 	VkResult err;
 
 	// Vulkan instance
-	err = createInstance(settings.validation);
+	{
+		VKS_STARTUP_SCOPE(vks::StartupReport::Phase, "initVulkan: createInstance");
+		err = createInstance(settings.validation);
+	}
 	if (err) {
 		vks::tools::exitFatal("Could not create Vulkan instance : \n" + vks::tools::errorString(err), err);
 		return false;
@@ -975,6 +2553,11 @@ bool VulkanExampleBase::initVulkan()
 	{
 		vks::debug::setupDebugging(instance);
 	}
+	// The base class enables debug utils whenever the instance supports it (see createInstance)
+	if (std::find(supportedInstanceExtensions.begin(), supportedInstanceExtensions.end(), VK_EXT_DEBUG_UTILS_EXTENSION_NAME) != supportedInstanceExtensions.end())
+	{
+		vks::debugutils::setup(instance);
+	}
 
 	// Physical device
 	uint32_t gpuCount = 0;
@@ -1030,6 +2613,15 @@ bool VulkanExampleBase::initVulkan()
 	// Derived examples can override this to set actual features (based on above readings) to enable for logical device creation
 	getEnabledFeatures();
 
+	if (benchmark.pipelineStatistics) {
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			enabledFeatures.pipelineStatisticsQuery = VK_TRUE;
+		}
+		else {
+			std::cerr << "Pipeline statistics queries are not supported by the selected device, benchmark will not collect pipeline statistics\n";
+		}
+	}
+
 	// Vulkan device creation
 	// This is handled by a separate class that gets a logical device representation
 	// and encapsulates functions related to a device
@@ -1038,12 +2630,213 @@ bool VulkanExampleBase::initVulkan()
 	// Derived examples can enable extensions based on the list of supported extensions read from the physical device
 	getEnabledExtensions();
 
-	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
+	if (settings.timelineSemaphores) {
+		if (vulkanDevice->extensionSupported(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+			enabledDeviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+			timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+			timelineSemaphoreFeatures.pNext = deviceCreatepNextChain;
+			deviceCreatepNextChain = &timelineSemaphoreFeatures;
+		}
+		else {
+			std::cerr << "Timeline semaphores are not supported by the selected device, falling back to fences\n";
+			settings.timelineSemaphores = false;
+		}
+	}
+
+	// VK_KHR_dynamic_rendering and the extensions it depends on for Vulkan 1.0 devices, unless already enabled by the example
+	if (settings.dynamicRendering) {
+		if (vulkanDevice->extensionSupported(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) {
+			const char* extensions[] = { VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME, VK_KHR_MULTIVIEW_EXTENSION_NAME, VK_KHR_MAINTENANCE2_EXTENSION_NAME };
+			for (const char* extension : extensions) {
+				if (std::find_if(enabledDeviceExtensions.begin(), enabledDeviceExtensions.end(), [extension](const char *enabled) { return strcmp(enabled, extension) == 0; }) == enabledDeviceExtensions.end()) {
+					enabledDeviceExtensions.push_back(extension);
+				}
+			}
+			dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+			dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+			dynamicRenderingFeatures.pNext = deviceCreatepNextChain;
+			deviceCreatepNextChain = &dynamicRenderingFeatures;
+		}
+		else {
+			std::cerr << "Dynamic rendering is not supported by the selected device, falling back to a render pass\n";
+			settings.dynamicRendering = false;
+		}
+	}
+
+	// Lets render targets request lossless or fixed-rate framebuffer compression and read back the compression that has been applied
+	if (settings.imageCompressionControl) {
+		PFN_vkGetPhysicalDeviceFeatures2KHR getFeatures2 = nullptr;
+		if (std::find(enabledInstanceExtensions.begin(), enabledInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) != enabledInstanceExtensions.end()) {
+			getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+		}
+		bool supported = (getFeatures2 != nullptr) && vulkanDevice->extensionSupported(VK_EXT_IMAGE_COMPRESSION_CONTROL_EXTENSION_NAME);
+		if (supported) {
+			imageCompressionControlFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_COMPRESSION_CONTROL_FEATURES_EXT;
+			VkPhysicalDeviceFeatures2KHR features2{};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+			features2.pNext = &imageCompressionControlFeatures;
+			getFeatures2(physicalDevice, &features2);
+			supported = imageCompressionControlFeatures.imageCompressionControl;
+		}
+		if (supported) {
+			enabledDeviceExtensions.push_back(VK_EXT_IMAGE_COMPRESSION_CONTROL_EXTENSION_NAME);
+			imageCompressionControlFeatures.pNext = deviceCreatepNextChain;
+			deviceCreatepNextChain = &imageCompressionControlFeatures;
+		}
+		else {
+			std::cerr << "Image compression control is not supported by the selected device, render targets use the default compression\n";
+			settings.imageCompressionControl = false;
+		}
+	}
+
+	// Half precision arithmetic in shaders, the fp16 variants only compute in half precision and don't need 16 bit storage
+	if (settings.halfPrecision) {
+		PFN_vkGetPhysicalDeviceFeatures2KHR getFeatures2 = nullptr;
+		if (std::find(enabledInstanceExtensions.begin(), enabledInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) != enabledInstanceExtensions.end()) {
+			getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+		}
+		bool supported = (getFeatures2 != nullptr) && vulkanDevice->extensionSupported(VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME);
+		if (supported) {
+			shaderFloat16Int8Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES_KHR;
+			VkPhysicalDeviceFeatures2KHR features2{};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+			features2.pNext = &shaderFloat16Int8Features;
+			getFeatures2(physicalDevice, &features2);
+			supported = shaderFloat16Int8Features.shaderFloat16;
+		}
+		if (supported) {
+			enabledDeviceExtensions.push_back(VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME);
+			// Int8 arithmetic isn't used
+			shaderFloat16Int8Features.shaderInt8 = VK_FALSE;
+			shaderFloat16Int8Features.pNext = deviceCreatepNextChain;
+			deviceCreatepNextChain = &shaderFloat16Int8Features;
+		}
+		else {
+			std::cerr << "Half precision shader arithmetic is not supported by the selected device, using the full precision shaders\n";
+			settings.halfPrecision = false;
+		}
+	}
+
+	// Shader statistics of the pipelines examples report as benchmark metrics, to compare shader variants (e.g. full and half precision) across runs
+	if (benchmark.active) {
+		PFN_vkGetPhysicalDeviceFeatures2KHR getFeatures2 = nullptr;
+		if (std::find(enabledInstanceExtensions.begin(), enabledInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) != enabledInstanceExtensions.end()) {
+			getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+		}
+		if ((getFeatures2 != nullptr) && vulkanDevice->extensionSupported(VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME)) {
+			pipelineExecutablePropertiesFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_EXECUTABLE_PROPERTIES_FEATURES_KHR;
+			VkPhysicalDeviceFeatures2KHR features2{};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+			features2.pNext = &pipelineExecutablePropertiesFeatures;
+			getFeatures2(physicalDevice, &features2);
+			if (pipelineExecutablePropertiesFeatures.pipelineExecutableInfo) {
+				enabledDeviceExtensions.push_back(VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME);
+				pipelineExecutablePropertiesFeatures.pNext = deviceCreatepNextChain;
+				deviceCreatepNextChain = &pipelineExecutablePropertiesFeatures;
+			}
+		}
+	}
+
+	// Report driver side heap usage and budgets along with the tracked allocations if supported
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+	if (std::find(enabledInstanceExtensions.begin(), enabledInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) != enabledInstanceExtensions.end()) {
+		getMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+	}
+	const bool memoryBudget = (getMemoryProperties2 != nullptr) && vulkanDevice->extensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (memoryBudget && (std::find_if(enabledDeviceExtensions.begin(), enabledDeviceExtensions.end(), [](const char *extension) { return strcmp(extension, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0; }) == enabledDeviceExtensions.end())) {
+		enabledDeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+
+	// Module identifiers are only accepted by pipeline creation that fails instead of compiling (pipeline creation cache control)
+	if (settings.shaderModuleIdentifiers) {
+		PFN_vkGetPhysicalDeviceFeatures2KHR getFeatures2 = nullptr;
+		if (std::find(enabledInstanceExtensions.begin(), enabledInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) != enabledInstanceExtensions.end()) {
+			getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+		}
+		bool supported = (getFeatures2 != nullptr) && vulkanDevice->extensionSupported(VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME) && vulkanDevice->extensionSupported(VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME);
+		if (supported) {
+			shaderModuleIdentifierFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT;
+			pipelineCreationCacheControlFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES_EXT;
+			shaderModuleIdentifierFeatures.pNext = &pipelineCreationCacheControlFeatures;
+			VkPhysicalDeviceFeatures2KHR features2{};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+			features2.pNext = &shaderModuleIdentifierFeatures;
+			getFeatures2(physicalDevice, &features2);
+			supported = shaderModuleIdentifierFeatures.shaderModuleIdentifier && pipelineCreationCacheControlFeatures.pipelineCreationCacheControl;
+		}
+		if (supported) {
+			enabledDeviceExtensions.push_back(VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME);
+			enabledDeviceExtensions.push_back(VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME);
+			pipelineCreationCacheControlFeatures.pNext = deviceCreatepNextChain;
+			deviceCreatepNextChain = &shaderModuleIdentifierFeatures;
+		}
+		else {
+			std::cerr << "Shader module identifiers are not supported by the selected device, shader modules are always created\n";
+			settings.shaderModuleIdentifiers = false;
+		}
+	}
+
+	// Present ids and present wait let the latency end when the frame's image has been presented instead of when it was queued
+	bool presentWait = false;
+	// Offscreen images are never presented
+	if ((settings.measureLatency || benchmark.active) && !settings.offscreen) {
+		PFN_vkGetPhysicalDeviceFeatures2KHR getFeatures2 = nullptr;
+		if (std::find(enabledInstanceExtensions.begin(), enabledInstanceExtensions.end(), VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) != enabledInstanceExtensions.end()) {
+			getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+		}
+		presentWait = (getFeatures2 != nullptr) && vulkanDevice->extensionSupported(VK_KHR_PRESENT_ID_EXTENSION_NAME) && vulkanDevice->extensionSupported(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+		if (presentWait) {
+			presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+			presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+			presentIdFeatures.pNext = &presentWaitFeatures;
+			VkPhysicalDeviceFeatures2KHR features2{};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+			features2.pNext = &presentIdFeatures;
+			getFeatures2(physicalDevice, &features2);
+			presentWait = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+		}
+		if (presentWait) {
+			enabledDeviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+			enabledDeviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+			presentWaitFeatures.pNext = deviceCreatepNextChain;
+			deviceCreatepNextChain = &presentIdFeatures;
+		}
+		else {
+			std::cerr << "Present wait is not supported by the selected device, input latency is measured until the present is queued\n";
+		}
+	}
+
+	if (settings.deviceGroup) {
+		setupDeviceGroup();
+	}
+
+	vulkanDevice->enableMemoryAllocator = settings.memoryAllocator;
+	VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+	if (settings.transferQueue) {
+		requestedQueueTypes |= VK_QUEUE_TRANSFER_BIT;
+	}
+	VkResult res;
+	{
+		VKS_STARTUP_SCOPE(vks::StartupReport::Phase, "initVulkan: createLogicalDevice");
+		res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain, true, requestedQueueTypes);
+	}
 	if (res != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), res);
 		return false;
 	}
 	device = vulkanDevice->logicalDevice;
+	latencyTracker.setup(device, presentWait);
+	if (memoryBudget) {
+		vulkanDevice->memoryTracker.vkGetPhysicalDeviceMemoryProperties2KHR = getMemoryProperties2;
+	}
+
+	shaderModuleCache = new vks::ShaderModuleCache(device, settings.shaderModuleIdentifiers);
+
+	if (settings.dynamicRendering) {
+		vkCmdBeginRenderingKHR = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
+		vkCmdEndRenderingKHR = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
+	}
 
 	// Get a graphics queue from the device
 	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
@@ -1053,6 +2846,9 @@ bool VulkanExampleBase::initVulkan()
 	assert(validDepthFormat);
 
 	swapChain.connect(instance, physicalDevice, device);
+	if (deviceGroup.deviceCount > 1) {
+		swapChain.initDeviceGroup();
+	}
 
 	// Create synchronization objects
 	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
@@ -1073,6 +2869,7 @@ bool VulkanExampleBase::initVulkan()
 	submitInfo.signalSemaphoreCount = 1;
 	submitInfo.pSignalSemaphores = &semaphores.renderComplete;
 
+	startupPhaseEnd = vks::Tracer::now();
 	return true;
 }
 
@@ -1111,6 +2908,9 @@ void VulkanExampleBase::setupDPIAwareness()
 HWND VulkanExampleBase::setupWindow(HINSTANCE hinstance, WNDPROC wndproc)
 {
 	this->windowInstance = hinstance;
+	if (settings.offscreen) {
+		return nullptr;
+	}
 
 	WNDCLASSEX wndClass;
 
@@ -1225,6 +3025,9 @@ HWND VulkanExampleBase::setupWindow(HINSTANCE hinstance, WNDPROC wndproc)
 
 void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
+	if (((uMsg >= WM_KEYFIRST) && (uMsg <= WM_KEYLAST)) || ((uMsg >= WM_MOUSEFIRST) && (uMsg <= WM_MOUSELAST))) {
+		latencyTracker.inputEvent();
+	}
 	switch (uMsg)
 	{
 	case WM_CLOSE:
@@ -1356,6 +3159,7 @@ void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPAR
 int32_t VulkanExampleBase::handleAppInput(struct android_app* app, AInputEvent* event)
 {
 	VulkanExampleBase* vulkanExample = reinterpret_cast<VulkanExampleBase*>(app->userData);
+	vulkanExample->latencyTracker.inputEvent();
 	if (AInputEvent_getType(event) == AINPUT_EVENT_TYPE_MOTION)
 	{
 		int32_t eventSource = AInputEvent_getSource(event);
@@ -1871,10 +3675,16 @@ void VulkanExampleBase::displayLinkOutputCb()
 {
 #if defined(VK_EXAMPLE_XCODE_GENERATED)
 	if (benchmark.active) {
-		benchmark.run([=] { render(); }, vulkanDevice->properties);
-		if (benchmark.filename != "") {
+		benchmark.run([=] { benchmarkFrame(); }, vulkanDevice->properties);
+		latencyTracker.update(swapChain.swapChain);
+		benchmark.recordInputLatencies(latencyTracker.getSamples(), latencyTracker.presentWaitEnabled());
+		benchmark.recordMemoryUsage(vulkanDevice->memoryTracker);
+		if ((benchmark.filename != "") || (benchmark.jsonFilename != "")) {
 			benchmark.saveResults();
 		}
+		if ((benchmark.baselineFilename != "") && !benchmark.compareWithBaseline()) {
+			exitCode = 1;
+		}
 		quit = true;	// SRS - quit NSApp rendering loop when benchmarking complete
 		return;
 	}
@@ -2000,6 +3810,9 @@ IDirectFBSurface *VulkanExampleBase::setupWindow()
 
 void VulkanExampleBase::handleEvent(const DFBWindowEvent *event)
 {
+	if (event->type & (DWET_KEYDOWN | DWET_KEYUP | DWET_BUTTONDOWN | DWET_BUTTONUP | DWET_MOTION)) {
+		latencyTracker.inputEvent();
+	}
 	switch (event->type)
 	{
 	case DWET_CLOSE:
@@ -2133,6 +3946,7 @@ void VulkanExampleBase::handleEvent(const DFBWindowEvent *event)
 }
 void VulkanExampleBase::pointerMotion(wl_pointer *pointer, uint32_t time, wl_fixed_t sx, wl_fixed_t sy)
 {
+	latencyTracker.inputEvent();
 	handleMouseMove(wl_fixed_to_int(sx), wl_fixed_to_int(sy));
 }
 
@@ -2147,6 +3961,7 @@ void VulkanExampleBase::pointerMotion(wl_pointer *pointer, uint32_t time, wl_fix
 void VulkanExampleBase::pointerButton(struct wl_pointer *pointer,
 		uint32_t serial, uint32_t time, uint32_t button, uint32_t state)
 {
+	latencyTracker.inputEvent();
 	switch (button)
 	{
 	case BTN_LEFT:
@@ -2214,6 +4029,7 @@ void VulkanExampleBase::pointerAxis(wl_pointer *pointer, uint32_t time,
 void VulkanExampleBase::keyboardKey(struct wl_keyboard *keyboard,
 		uint32_t serial, uint32_t time, uint32_t key, uint32_t state)
 {
+	latencyTracker.inputEvent();
 	switch (key)
 	{
 	case KEY_W:
@@ -2412,6 +4228,9 @@ static const struct xdg_toplevel_listener xdg_toplevel_listener = {
 
 struct xdg_surface *VulkanExampleBase::setupWindow()
 {
+	if (settings.offscreen) {
+		return nullptr;
+	}
 	surface = wl_compositor_create_surface(compositor);
 	xdg_surface = xdg_wm_base_get_xdg_surface(shell, surface);
 
@@ -2436,6 +4255,9 @@ static inline xcb_intern_atom_reply_t* intern_atom_helper(xcb_connection_t *conn
 // Set up a window using XCB and request event types
 xcb_window_t VulkanExampleBase::setupWindow()
 {
+	if (settings.offscreen) {
+		return 0;
+	}
 	uint32_t value_mask, value_list[32];
 
 	window = xcb_generate_id(connection);
@@ -2538,6 +4360,11 @@ void VulkanExampleBase::initxcbConnection()
 
 void VulkanExampleBase::handleEvent(const xcb_generic_event_t *event)
 {
+	// Key press up to motion notify are the keyboard and pointer events
+	const uint8_t eventType = event->response_type & 0x7f;
+	if ((eventType >= XCB_KEY_PRESS) && (eventType <= XCB_MOTION_NOTIFY)) {
+		latencyTracker.inputEvent();
+	}
 	switch (event->response_type & 0x7f)
 	{
 	case XCB_CLIENT_MESSAGE:
@@ -2669,6 +4496,52 @@ void VulkanExampleBase::createSynchronizationPrimitives()
 	for (auto& fence : waitFences) {
 		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
 	}
+	// No frame is using any of the (possibly recreated) swap chain images yet
+	imageFences.assign(drawCmdBuffers.size(), VK_NULL_HANDLE);
+	frameTimeline.imageValues.assign(drawCmdBuffers.size(), 0);
+}
+
+void VulkanExampleBase::createFrameObjects()
+{
+	if (!supportsFramesInFlight) {
+		// The example submits with its own semaphores and without a frame fence, so the queue has to become idle after each frame
+		if (settings.framesInFlight > 1) {
+			std::cout << "This example does not support multiple frames in flight, rendering with a single frame in flight\n";
+			settings.framesInFlight = 1;
+		}
+		return;
+	}
+	if ((settings.framesInFlight <= 1) && !(settings.timelineSemaphores && vulkanDevice->enableTimelineSemaphores)) {
+		return;
+	}
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	// Fences are created in signaled state so the first wait for each frame returns immediately
+	VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+	frameObjects.resize(settings.framesInFlight);
+	for (auto& frame : frameObjects) {
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.presentComplete));
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.renderComplete));
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &frame.fence));
+	}
+	currentFrame = 0;
+	if (settings.timelineSemaphores && vulkanDevice->enableTimelineSemaphores) {
+		frameTimeline.semaphore = vulkanDevice->createTimelineSemaphore();
+		frameTimeline.value = 0;
+	}
+}
+
+void VulkanExampleBase::destroyFrameObjects()
+{
+	for (auto& frame : frameObjects) {
+		vkDestroySemaphore(device, frame.presentComplete, nullptr);
+		vkDestroySemaphore(device, frame.renderComplete, nullptr);
+		vkDestroyFence(device, frame.fence, nullptr);
+	}
+	frameObjects.clear();
+	if (frameTimeline.semaphore != VK_NULL_HANDLE) {
+		vkDestroySemaphore(device, frameTimeline.semaphore, nullptr);
+		frameTimeline.semaphore = VK_NULL_HANDLE;
+	}
 }
 
 void VulkanExampleBase::createCommandPool()
@@ -2691,9 +4564,10 @@ void VulkanExampleBase::setupDepthStencil()
 	imageCI.arrayLayers = 1;
 	imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-	imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | depthStencil.additionalUsage;
 
 	VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &depthStencil.image));
+	vks::debugutils::setObjectName(device, VK_OBJECT_TYPE_IMAGE, (uint64_t)depthStencil.image, "depth stencil");
 	VkMemoryRequirements memReqs{};
 	vkGetImageMemoryRequirements(device, depthStencil.image, &memReqs);
 
@@ -2701,7 +4575,7 @@ void VulkanExampleBase::setupDepthStencil()
 	memAllloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	memAllloc.allocationSize = memReqs.size;
 	memAllloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device, &memAllloc, nullptr, &depthStencil.mem));
+	VK_CHECK_RESULT(vulkanDevice->allocateMemory(memAllloc, vks::MemoryCategory::Image, &depthStencil.mem));
 	VK_CHECK_RESULT(vkBindImageMemory(device, depthStencil.image, depthStencil.mem, 0));
 
 	VkImageViewCreateInfo imageViewCI{};
@@ -2719,6 +4593,7 @@ void VulkanExampleBase::setupDepthStencil()
 		imageViewCI.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
 	}
 	VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &depthStencil.view));
+	vks::debugutils::setObjectName(device, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)depthStencil.view, "depth stencil");
 }
 
 void VulkanExampleBase::setupFrameBuffer()
@@ -2744,6 +4619,7 @@ void VulkanExampleBase::setupFrameBuffer()
 	{
 		attachments[0] = swapChain.buffers[i].view;
 		VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &frameBuffers[i]));
+		vks::debugutils::setObjectName(device, VK_OBJECT_TYPE_FRAMEBUFFER, (uint64_t)frameBuffers[i], ("swapchain framebuffer " + std::to_string(i)).c_str());
 	}
 }
 
@@ -2817,6 +4693,185 @@ void VulkanExampleBase::setupRenderPass()
 	renderPassInfo.pDependencies = dependencies.data();
 
 	VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
+	vks::debugutils::setObjectName(device, VK_OBJECT_TYPE_RENDER_PASS, (uint64_t)renderPass, "swapchain render pass");
+}
+
+void VulkanExampleBase::setupOverlayRenderPass()
+{
+	if (settings.dynamicRendering) {
+		return;
+	}
+	// Draws on top of the example's rendering, which leaves the image ready for presentation
+	VkAttachmentDescription attachment{};
+	attachment.format = swapChain.colorFormat;
+	attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachment.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+	VkSubpassDescription subpassDescription{};
+	subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDescription.colorAttachmentCount = 1;
+	subpassDescription.pColorAttachments = &colorReference;
+
+	// Blending reads the color written by the example's submission
+	VkSubpassDependency dependency{};
+	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass = 0;
+	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
+	renderPassInfo.attachmentCount = 1;
+	renderPassInfo.pAttachments = &attachment;
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpassDescription;
+	renderPassInfo.dependencyCount = 1;
+	renderPassInfo.pDependencies = &dependency;
+	VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &overlayResources.renderPass));
+}
+
+void VulkanExampleBase::createOverlayFrameBuffers()
+{
+	if (overlayResources.renderPass == VK_NULL_HANDLE) {
+		return;
+	}
+	VkFramebufferCreateInfo frameBufferCreateInfo = vks::initializers::framebufferCreateInfo();
+	frameBufferCreateInfo.renderPass = overlayResources.renderPass;
+	frameBufferCreateInfo.attachmentCount = 1;
+	frameBufferCreateInfo.width = width;
+	frameBufferCreateInfo.height = height;
+	frameBufferCreateInfo.layers = 1;
+	overlayResources.frameBuffers.resize(swapChain.imageCount);
+	for (uint32_t i = 0; i < swapChain.imageCount; i++) {
+		frameBufferCreateInfo.pAttachments = &swapChain.buffers[i].view;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &overlayResources.frameBuffers[i]));
+	}
+}
+
+void VulkanExampleBase::createOverlayFrames()
+{
+	const uint32_t imageCount = swapChain.imageCount;
+	createOverlayFrameBuffers();
+	overlayResources.commandBuffers.resize(imageCount);
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, imageCount);
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, overlayResources.commandBuffers.data()));
+	// Fences are created in signaled state so the first wait for each image returns immediately
+	VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	overlayResources.fences.resize(imageCount);
+	overlayResources.sceneComplete.resize(imageCount);
+	for (uint32_t i = 0; i < imageCount; i++) {
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &overlayResources.fences[i]));
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &overlayResources.sceneComplete[i]));
+	}
+}
+
+void VulkanExampleBase::destroyOverlayFrames()
+{
+	for (auto frameBuffer : overlayResources.frameBuffers) {
+		vkDestroyFramebuffer(device, frameBuffer, nullptr);
+	}
+	if (!overlayResources.commandBuffers.empty()) {
+		vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(overlayResources.commandBuffers.size()), overlayResources.commandBuffers.data());
+	}
+	for (auto fence : overlayResources.fences) {
+		vkDestroyFence(device, fence, nullptr);
+	}
+	for (auto semaphore : overlayResources.sceneComplete) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	overlayResources.frameBuffers.clear();
+	overlayResources.commandBuffers.clear();
+	overlayResources.fences.clear();
+	overlayResources.sceneComplete.clear();
+}
+
+void VulkanExampleBase::submitOverlay(VkSemaphore signalSemaphore)
+{
+	VkCommandBuffer commandBuffer = overlayResources.commandBuffers[currentBuffer];
+	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+	cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+	const VkImageSubresourceRange colorRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	if (settings.dynamicRendering) {
+		vks::tools::insertImageMemoryBarrier(
+			commandBuffer,
+			swapChain.buffers[currentBuffer].image,
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			colorRange);
+		VkRenderingAttachmentInfoKHR colorAttachment{};
+		colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		colorAttachment.imageView = swapChain.buffers[currentBuffer].view;
+		colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		VkRenderingInfoKHR renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+		renderingInfo.renderArea = { 0, 0, width, height };
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachments = &colorAttachment;
+		vkCmdBeginRenderingKHR(commandBuffer, &renderingInfo);
+	}
+	else {
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = overlayResources.renderPass;
+		renderPassBeginInfo.framebuffer = overlayResources.frameBuffers[currentBuffer];
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	}
+
+	if (UIOverlay.visible) {
+		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		UIOverlay.draw(commandBuffer, currentBuffer);
+	}
+
+	if (settings.dynamicRendering) {
+		vkCmdEndRenderingKHR(commandBuffer);
+		vks::tools::insertImageMemoryBarrier(
+			commandBuffer,
+			swapChain.buffers[currentBuffer].image,
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			0,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			colorRange);
+	}
+	else {
+		vkCmdEndRenderPass(commandBuffer);
+	}
+	VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+	const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	VkSubmitInfo overlaySubmitInfo = vks::initializers::submitInfo();
+	overlaySubmitInfo.waitSemaphoreCount = 1;
+	overlaySubmitInfo.pWaitSemaphores = &overlayResources.sceneComplete[currentBuffer];
+	overlaySubmitInfo.pWaitDstStageMask = &waitStage;
+	overlaySubmitInfo.commandBufferCount = 1;
+	overlaySubmitInfo.pCommandBuffers = &commandBuffer;
+	overlaySubmitInfo.signalSemaphoreCount = 1;
+	overlaySubmitInfo.pSignalSemaphores = &signalSemaphore;
+	VK_CHECK_RESULT(vkResetFences(device, 1, &overlayResources.fences[currentBuffer]));
+	VK_CHECK_RESULT(vulkanDevice->flushMappedRanges());
+	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &overlaySubmitInfo, overlayResources.fences[currentBuffer]));
 }
 
 void VulkanExampleBase::getEnabledFeatures() {}
@@ -2832,43 +4887,78 @@ void VulkanExampleBase::windowResize()
 	prepared = false;
 	resized = true;
 
-	// Ensure all operations on the device have been finished before destroying resources
-	vkDeviceWaitIdle(device);
+	const uint32_t imageCount = swapChain.imageCount;
+	RetiredSwapChain retiredSwapChain;
+	if (settings.deferredResize) {
+		// Without frames in flight, submitFrame() only waits for the queue after a successful present
+		if (frameObjects.empty()) {
+			VK_CHECK_RESULT(vulkanDevice->queueWaitIdle(queue));
+		}
+	}
+	else {
+		// Ensure all operations on the device have been finished before destroying resources
+		vkDeviceWaitIdle(device);
+	}
 
 	// Recreate swap chain
 	width = destWidth;
 	height = destHeight;
-	setupSwapChain();
+	setupSwapChain(settings.deferredResize ? &retiredSwapChain : nullptr);
 
-	// Recreate the frame buffers
-	vkDestroyImageView(device, depthStencil.view, nullptr);
-	vkDestroyImage(device, depthStencil.image, nullptr);
-	vkFreeMemory(device, depthStencil.mem, nullptr);
-	setupDepthStencil();
-	for (uint32_t i = 0; i < frameBuffers.size(); i++) {
-		vkDestroyFramebuffer(device, frameBuffers[i], nullptr);
+	if (settings.deferredResize && (swapChain.imageCount == imageCount)) {
+		windowResizeDeferred(retiredSwapChain);
 	}
-	setupFrameBuffer();
+	else {
+		if (retiredSwapChain.swapChain != VK_NULL_HANDLE) {
+			// A different number of images changes the per-image resources of the base and the examples, so fall back to recreating everything
+			vkDeviceWaitIdle(device);
+			swapChain.destroy(retiredSwapChain);
+		}
+		vulkanDevice->releaseDeferredDestructions();
+		// Recreate the frame buffers
+		vkDestroyImageView(device, depthStencil.view, nullptr);
+		vkDestroyImage(device, depthStencil.image, nullptr);
+		vulkanDevice->freeMemory(depthStencil.mem);
+		setupDepthStencil();
+		// Dynamic rendering references the new images when recording, there are no frame buffers to recreate
+		if (!settings.dynamicRendering) {
+			for (uint32_t i = 0; i < frameBuffers.size(); i++) {
+				vkDestroyFramebuffer(device, frameBuffers[i], nullptr);
+			}
+			setupFrameBuffer();
+		}
 
-	if ((width > 0.0f) && (height > 0.0f)) {
+		if ((width > 0.0f) && (height > 0.0f)) {
+			if (settings.overlay) {
+				UIOverlay.resize(width, height);
+			}
+		}
+
+		// Command buffers need to be recreated as they may store
+		// references to the recreated frame buffer
+		destroyCommandBuffers();
+		createCommandBuffers();
+		// The number of command buffers to profile may have changed too
+		benchmark.gpuProfiler.prepare(vulkanDevice, static_cast<uint32_t>(drawCmdBuffers.size()), 32, benchmark.pipelineStatistics);
+		// And so may the number of overlay buffers
 		if (settings.overlay) {
-			UIOverlay.resize(width, height);
+			UIOverlay.setBufferCount(swapChain.imageCount);
+			UIOverlay.allocateBuffers();
 		}
-	}
+		if (settings.overlayPass) {
+			destroyOverlayFrames();
+			createOverlayFrames();
+		}
+		buildCommandBuffers();
+		
+		// SRS - Recreate fences in case number of swapchain images has changed on resize
+		for (auto& fence : waitFences) {
+			vkDestroyFence(device, fence, nullptr);
+		}
+		createSynchronizationPrimitives();
 
-	// Command buffers need to be recreated as they may store
-	// references to the recreated frame buffer
-	destroyCommandBuffers();
-	createCommandBuffers();
-	buildCommandBuffers();
-	
-	// SRS - Recreate fences in case number of swapchain images has changed on resize
-	for (auto& fence : waitFences) {
-		vkDestroyFence(device, fence, nullptr);
+		vkDeviceWaitIdle(device);
 	}
-	createSynchronizationPrimitives();
-
-	vkDeviceWaitIdle(device);
 
 	if ((width > 0.0f) && (height > 0.0f)) {
 		camera.updateAspectRatio((float)width / (float)height);
@@ -2881,6 +4971,50 @@ void VulkanExampleBase::windowResize()
 	prepared = true;
 }
 
+void VulkanExampleBase::windowResizeDeferred(const RetiredSwapChain& retiredSwapChain)
+{
+	// Frames in flight may still use the resources depending on the old swap chain, so these are only released once they have finished
+	// The number of images didn't change, so per-image resources like fences, profiler queries and overlay buffers are kept
+	const auto oldDepthStencil = depthStencil;
+	const std::vector<VkFramebuffer> oldFrameBuffers = frameBuffers;
+	const std::vector<VkFramebuffer> oldOverlayFrameBuffers = overlayResources.frameBuffers;
+	const std::vector<VkCommandBuffer> oldCommandBuffers = drawCmdBuffers;
+	// One more frame leaves time for pending presents of the old images
+	vulkanDevice->deferDestruction(frameNumber + 1, [this, retiredSwapChain, oldDepthStencil, oldFrameBuffers, oldOverlayFrameBuffers, oldCommandBuffers]() {
+		// The overlay pass is submitted after the frame's fence has been signaled, so it has to be waited for separately
+		if (!overlayResources.fences.empty()) {
+			VK_CHECK_RESULT(vkWaitForFences(device, static_cast<uint32_t>(overlayResources.fences.size()), overlayResources.fences.data(), VK_TRUE, UINT64_MAX));
+		}
+		for (auto frameBuffer : oldOverlayFrameBuffers) {
+			vkDestroyFramebuffer(device, frameBuffer, nullptr);
+		}
+		for (auto frameBuffer : oldFrameBuffers) {
+			vkDestroyFramebuffer(device, frameBuffer, nullptr);
+		}
+		vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(oldCommandBuffers.size()), oldCommandBuffers.data());
+		vkDestroyImageView(device, oldDepthStencil.view, nullptr);
+		vkDestroyImage(device, oldDepthStencil.image, nullptr);
+		vulkanDevice->freeMemory(oldDepthStencil.mem);
+		swapChain.destroy(retiredSwapChain);
+	});
+
+	setupDepthStencil();
+	if (!settings.dynamicRendering) {
+		setupFrameBuffer();
+	}
+	if ((width > 0.0f) && (height > 0.0f)) {
+		if (settings.overlay) {
+			UIOverlay.resize(width, height);
+		}
+	}
+	// The old command buffers may be pending, so new ones are recorded instead of resetting them
+	createCommandBuffers();
+	if (settings.overlayPass) {
+		createOverlayFrameBuffers();
+	}
+	buildCommandBuffers();
+}
+
 void VulkanExampleBase::handleMouseMove(int32_t x, int32_t y)
 {
 	int32_t dx = (int32_t)mousePos.x - x;
@@ -2916,8 +5050,16 @@ void VulkanExampleBase::handleMouseMove(int32_t x, int32_t y)
 
 void VulkanExampleBase::windowResized() {}
 
+void VulkanExampleBase::renderResolutionChanged() {}
+
+void VulkanExampleBase::qualityLevelChanged(uint32_t qualityLevel) {}
+
 void VulkanExampleBase::initSwapchain()
 {
+	if (settings.offscreen) {
+		swapChain.initOffscreen(queue, vulkanDevice->queueFamilyIndices.graphics);
+		return;
+	}
 #if defined(_WIN32)
 	swapChain.initSurface(windowInstance, window);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
@@ -2935,9 +5077,11 @@ void VulkanExampleBase::initSwapchain()
 #endif
 }
 
-void VulkanExampleBase::setupSwapChain()
+void VulkanExampleBase::setupSwapChain(RetiredSwapChain* retired)
 {
-	swapChain.create(&width, &height, settings.vsync, settings.fullscreen);
+	swapChain.requestedPresentMode = settings.presentMode;
+	swapChain.requestedImageCount = settings.swapchainImageCount;
+	swapChain.create(&width, &height, settings.vsync, settings.fullscreen, retired);
 }
 
 void VulkanExampleBase::OnUpdateUIOverlay(vks::UIOverlay *overlay) {}
@@ -42,8 +42,11 @@
 #include <ctime>
 #include <iostream>
 #include <chrono>
+#include <thread>
 #include <random>
 #include <algorithm>
+#include <functional>
+#include <memory>
 #include <sys/stat.h>
 
 #define GLM_FORCE_RADIANS
@@ -68,11 +71,26 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTexture.h"
+#include "VulkanShaderWatcher.h"
+#include "VulkanShaderModuleCache.h"
+#include "VulkanFrameArena.h"
+#include "VulkanTrace.h"
+#include "VulkanLatencyTracker.h"
+#include "VulkanPerformanceGovernor.h"
+#include "VulkanReadback.h"
+#include "VulkanStartupReport.h"
+#include "VulkanCommandCapture.h"
+#include "VulkanMemoryDefragmenter.h"
 
 #include "VulkanInitializers.hpp"
 #include "camera.hpp"
 #include "benchmark.hpp"
 
+namespace vks
+{
+	class ThreadPool;
+}
+
 class VulkanExampleBase
 {
 private:
@@ -81,17 +99,108 @@ private:
 	uint32_t destHeight;
 	bool resizing = false;
 	void windowResize();
+	void windowResizeDeferred(const RetiredSwapChain& retiredSwapChain);
 	void handleMouseMove(int32_t x, int32_t y);
 	void nextFrame();
 	void updateOverlay();
 	void createPipelineCache();
+	void savePipelineCache();
+	std::string getPipelineCacheFileName() const;
 	void createCommandPool();
 	void createSynchronizationPrimitives();
+	void createFrameObjects();
+	void destroyFrameObjects();
 	void initSwapchain();
-	void setupSwapChain();
+	void setupSwapChain(RetiredSwapChain* retired = nullptr);
 	void createCommandBuffers();
 	void destroyCommandBuffers();
 	std::string shaderDir = "glsl";
+	// Chained into the device creation if timeline semaphores have been requested
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+	// Chained into the device creation if shader module identifiers have been requested
+	VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT shaderModuleIdentifierFeatures{};
+	VkPhysicalDevicePipelineCreationCacheControlFeaturesEXT pipelineCreationCacheControlFeatures{};
+	// Chained into the device creation if dynamic rendering has been requested
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+	// Chained into the device creation if image compression control has been requested
+	VkPhysicalDeviceImageCompressionControlFeaturesEXT imageCompressionControlFeatures{};
+	// Chained into the device creation if half precision shaders have been requested
+	VkPhysicalDeviceShaderFloat16Int8FeaturesKHR shaderFloat16Int8Features{};
+	// Chained into the device creation in benchmark mode if VK_KHR_pipeline_executable_properties is supported
+	VkPhysicalDevicePipelineExecutablePropertiesFeaturesKHR pipelineExecutablePropertiesFeatures{};
+	// Chained into the device creation if input latency is measured and VK_KHR_present_wait is supported
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+	// Input to present latency, measured for benchmarks and with Settings::measureLatency
+	vks::LatencyTracker latencyTracker;
+	void printInputLatency();
+	// Separate pass drawing the UI overlay on top of the example's rendering, see Settings::overlayPass
+	struct {
+		// VK_NULL_HANDLE with dynamic rendering
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		// Indexed by swap chain image
+		std::vector<VkFramebuffer> frameBuffers;
+		std::vector<VkCommandBuffer> commandBuffers;
+		// Signaled once the image's overlay command buffer finished execution, waited on before it's recorded again
+		std::vector<VkFence> fences;
+		// Signaled by the example's submission instead of the render complete semaphore, waited on by the overlay submission
+		std::vector<VkSemaphore> sceneComplete;
+		// Set once prepareFrame() redirected the example's submission to the overlay pass of the acquired image
+		bool pending = false;
+	} overlayResources;
+	void setupOverlayRenderPass();
+	void createOverlayFrames();
+	void createOverlayFrameBuffers();
+	void destroyOverlayFrames();
+	void submitOverlay(VkSemaphore signalSemaphore);
+	// Number of the frame being recorded, counting from 1, deferred destructions are tagged with it (see vks::VulkanDevice::deferDestruction)
+	uint64_t frameNumber = 0;
+	// Time each swap chain image's command buffer was last submitted at while tracing, the GPU profiler scopes of the submission are placed relative to it
+	std::vector<uint64_t> traceSubmitTimes;
+	void addTraceGpuScopes(uint32_t imageIndex);
+	void benchmarkFrame();
+	// Submissions and mapped buffer contents of the first frames of a benchmark, replayed instead of the example's frames with benchmark.replayFrames
+	vks::CommandCapture commandCapture;
+	void replayFrame();
+	// CPU and GPU frame times of the recent frames, shown as graphs in the overlay's "Frame times" section
+	vks::FrameTimeHistory frameTimeHistory;
+	// End of the last startup phase measured by the base class, the phases in between (window setup, the example's prepare) start there
+	uint64_t startupPhaseEnd = 0;
+	void updateDynamicResolution();
+	void waitForPreviousFrames();
+	// Thermal and frame time driven limits, see Settings::performanceGovernor
+	vks::PerformanceGovernor performanceGovernor;
+	void updatePerformanceGovernor(double frameTime);
+	void applyPerformancePolicy();
+	// Copies every Settings::offscreenCaptureInterval-th offscreen frame to a file instead of discarding it
+	std::unique_ptr<vks::ReadbackRing> offscreenReadback;
+	// Alternate frame rendering across the physical devices of a device group, see Settings::deviceGroup
+	struct {
+		// Number of physical devices in the logical device, 1 without a device group
+		uint32_t deviceCount = 1;
+		std::vector<VkPhysicalDevice> physicalDevices;
+		// Chained into the device creation
+		VkDeviceGroupDeviceCreateInfoKHR deviceCreateInfo{};
+		// Device index rendering the current frame and its device mask, the mask is 0 if the frame is rendered without device masks
+		uint32_t frameDevice = 0;
+		uint32_t frameDeviceMask = 0;
+		// Presented by the frame's device (local) or copied to a device with a presentation engine (remote)
+		VkDeviceGroupPresentModeFlagBitsKHR presentMode = VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR;
+		// Chained into submitInfo by prepareFrame() so the frame's command buffer and semaphores are executed and signaled on the frame's device
+		VkDeviceGroupSubmitInfoKHR submitInfo{};
+		// Device index the last submission of each swap chain image's command buffer rendered on, its profiler results belong to that device
+		std::vector<uint32_t> imageDevices;
+		// GPU frame times (sum of the frames' profiler time) and frame counts per device index
+		std::vector<double> gpuTime;
+		std::vector<uint64_t> frames;
+		// Frames presented by the device that rendered them, and frames whose image was copied to another device's presentation engine
+		uint64_t localPresents = 0;
+		uint64_t remotePresents = 0;
+	} deviceGroup;
+	void setupDeviceGroup();
+	void selectFrameDevice();
+	void updateDeviceGroupFrame(uint32_t imageIndex);
+	void printDeviceGroupSummary();
 protected:
 	// Returns the path to the root of the glsl or hlsl shader directory.
 	std::string getShadersPath() const;
@@ -133,18 +242,33 @@ protected:
 	VkSubmitInfo submitInfo;
 	// Command buffers used for rendering
 	std::vector<VkCommandBuffer> drawCmdBuffers;
-	// Global render pass for frame buffer writes
+	// Global render pass for frame buffer writes (VK_NULL_HANDLE with dynamic rendering)
 	VkRenderPass renderPass = VK_NULL_HANDLE;
-	// List of available frame buffers (same as number of swap chain images)
+	// List of available frame buffers (same as number of swap chain images, empty with dynamic rendering)
 	std::vector<VkFramebuffer>frameBuffers;
+	// Attachment formats of the swapchain rendering, chained into pipelines by setupPipelineRendering() with dynamic rendering
+	VkPipelineRenderingCreateInfoKHR pipelineRenderingCreateInfo{};
+	// Loaded if dynamic rendering is enabled
+	PFN_vkCmdBeginRenderingKHR vkCmdBeginRenderingKHR = nullptr;
+	PFN_vkCmdEndRenderingKHR vkCmdEndRenderingKHR = nullptr;
 	// Active frame buffer index
 	uint32_t currentBuffer = 0;
 	// Descriptor set pool
 	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
-	// List of shader modules created (stored for cleanup)
+	// Shader modules returned by loadShader since the last releaseShaderModules(), in load order (owned by the shader module cache)
 	std::vector<VkShaderModule> shaderModules;
+	// Shares the modules of shader files loaded more than once
+	vks::ShaderModuleCache *shaderModuleCache = nullptr;
+	// Created by the first getThreadPool() call
+	std::unique_ptr<vks::ThreadPool> threadPoolShared;
+	// Recompiles changed shader sources if hot reload is enabled
+	vks::ShaderWatcher *shaderWatcher = nullptr;
+	// Shaders loaded since the last watchShaders() call
+	std::vector<std::string> unwatchedShaders;
+	// Set while the watcher rebuilds pipelines, which load and register their shaders again
+	bool reloadingShaders = false;
 	// Pipeline cache object
-	VkPipelineCache pipelineCache;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
 	// Wraps the swap chain to present images (framebuffers) to the windowing system
 	VulkanSwapChain swapChain;
 	// Synchronization semaphores
@@ -155,6 +279,139 @@ protected:
 		VkSemaphore renderComplete;
 	} semaphores;
 	std::vector<VkFence> waitFences;
+	/** @brief Per-frame synchronization objects, only used if more than one frame is in flight or timeline semaphores are enabled (see Settings) */
+	struct FrameObjects {
+		// Swap chain image presentation
+		VkSemaphore presentComplete = VK_NULL_HANDLE;
+		// Command buffer submission and execution
+		VkSemaphore renderComplete = VK_NULL_HANDLE;
+		// Signaled once the frame's command buffer(s) finished execution (binary backend)
+		VkFence fence = VK_NULL_HANDLE;
+		// Value of the frame timeline semaphore signaled by the frame's submission (timeline backend)
+		uint64_t timelineValue = 0;
+		// Number of the frame last recorded with these objects
+		uint64_t frameNumber = 0;
+	};
+	std::vector<FrameObjects> frameObjects;
+	// Fence of the frame that last rendered to a swap chain image (indexed by swap chain image)
+	std::vector<VkFence> imageFences;
+	// Index of the frame in flight that is currently being recorded
+	uint32_t currentFrame = 0;
+	/** @brief Timeline semaphore backend for frame synchronization (VK_KHR_timeline_semaphore) */
+	struct {
+		// Signaled with a monotonically increasing value by a final submission of each frame
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+		// Last value submitted for signaling
+		uint64_t value = 0;
+		// Timeline value of the frame that last rendered to a swap chain image (indexed by swap chain image)
+		std::vector<uint64_t> imageValues;
+	} frameTimeline;
+	/** @brief Set in the constructor of examples whose submissions keep the per-frame semaphores installed by prepareFrame() and signal getFrameFence(), all other examples run with a single frame in flight */
+	bool supportsFramesInFlight = false;
+	/** @brief Returns the fence that the current frame's submission must signal (VK_NULL_HANDLE if only one frame is in flight) */
+	VkFence getFrameFence() const;
+	/** @brief Waits until all frames in flight have finished execution on the GPU */
+	void waitForFramesInFlight();
+	/**
+	* @brief Releases resources that may still be used by the frames recorded so far once these have finished, without waiting for the device
+	* @note Queued with vks::VulkanDevice::deferDestruction and released in prepareFrame(). The function may run after the derived class has been destroyed, so capture the handles by value.
+	*/
+	void deferDestruction(std::function<void()> destroy);
+	/**
+	* @brief Linear allocator for transient CPU allocations of a frame (e.g. vks::FrameVector<VkWriteDescriptorSet> writes(frameArena))
+	* @note Reset in submitFrame() once the frame has been submitted, so its memory must not be kept beyond that
+	*/
+	vks::FrameArena frameArena;
+	/** @brief Offscreen attachments rendered at a fraction of the window size, so resizes and scale changes only reallocate them if they have to grow (see updateRenderResolution) */
+	struct {
+		// Fraction of the window size rendered at
+		float scale = 1.0f;
+		// Region of the attachments rendered to, used for the viewport and render area
+		VkExtent2D renderExtent = { 0, 0 };
+		// Size the attachments have to be created at, only grows
+		VkExtent2D attachmentExtent = { 0, 0 };
+		// Maps the window's texture coordinates to the rendered region of the attachments
+		glm::vec2 uvScale = glm::vec2(1.0f);
+		// Upper limit of the render extent (e.g. for attachments of a fixed size), 0 only limits it to the maximum image size
+		VkExtent2D maxExtent = { 0, 0 };
+	} renderResolution;
+	/**
+	* @brief Adjusts renderResolution.scale to hold the GPU frame time at Settings::dynamicResolutionTarget
+	* @note The GPU frame time is the sum of the GPU profiler scopes of the acquired image's last submission, so examples have to record non-overlapping scopes covering their work into the per-image slots
+	*/
+	struct {
+		// Range the scale is kept in
+		float minScale = 0.5f;
+		float maxScale = 1.0f;
+		// Scale changes are rounded to this step, so measurement noise doesn't change it every few frames
+		float step = 0.05f;
+		// Smoothed GPU frame time in milliseconds
+		double gpuTime = 0.0;
+		// Number of measurements averaged so far since the last change
+		uint32_t samples = 0;
+		// Measurements left to skip after a change, as they are from command buffers recorded before it
+		uint32_t skipSamples = 0;
+	} dynamicResolution;
+	/** @brief Updates the render extent for the current window size and scale, returns true if the attachments have to be (re)created at the new attachment extent */
+	bool updateRenderResolution();
+	/** @brief Buffer written on the async compute queue and read by the graphics queue, ownership is transferred if the queue families differ */
+	struct AsyncComputeBuffer {
+		VkBuffer buffer;
+		// Stages and accesses of the compute queue writing the buffer
+		VkPipelineStageFlags computeStages;
+		VkAccessFlags computeAccess;
+		// Stages and accesses of the graphics queue reading the buffer
+		VkPipelineStageFlags graphicsStages;
+		VkAccessFlags graphicsAccess;
+	};
+	/** @brief Resources of one compute submission, compute writes one slot while graphics reads the one written in the previous frame */
+	struct AsyncComputeSlot {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		// Signaled once the slot's compute submission finished, waited on before the command buffer is recorded again
+		VkFence fence = VK_NULL_HANDLE;
+		// Signaled by the compute submission, waited on by the graphics submission reading the slot
+		VkSemaphore computeComplete = VK_NULL_HANDLE;
+		// Signaled by the graphics submission reading the slot, waited on by the next compute submission writing it
+		VkSemaphore graphicsComplete = VK_NULL_HANDLE;
+		// Binary semaphores that have a pending signal operation no submission has waited on yet
+		bool computePending = false;
+		bool graphicsPending = false;
+		// Current queue family transfer state of the slot's buffers
+		bool releasedToGraphics = false;
+		bool releasedToCompute = false;
+		std::vector<AsyncComputeBuffer> buffers;
+	};
+	/** @brief Async compute path (see prepareAsyncCompute), compute work of frame N + 1 is submitted before and overlaps the graphics work of frame N */
+	struct {
+		VkQueue queue = VK_NULL_HANDLE;
+		uint32_t queueFamilyIndex = 0;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		std::vector<AsyncComputeSlot> slots;
+		// Slot written by the next compute submission
+		uint32_t writeSlot = 0;
+		// Slot read by the next graphics submission (written by the compute submission before the last one)
+		uint32_t readSlot = 0;
+		// Semaphore arrays of the graphics submit info returned by getAsyncComputeSubmitInfo()
+		std::vector<VkSemaphore> waitSemaphores;
+		std::vector<VkPipelineStageFlags> waitStages;
+		std::vector<VkSemaphore> signalSemaphores;
+	} asyncCompute;
+	/** @brief Creates the queue, command buffers and synchronization objects of the async compute path with the given number of slots */
+	void prepareAsyncCompute(uint32_t slotCount = 2);
+	/** @brief Registers a buffer of a slot whose queue family ownership is transferred between the compute and graphics queue */
+	void addAsyncComputeBuffer(uint32_t slot, VkBuffer buffer, VkPipelineStageFlags computeStages, VkAccessFlags computeAccess, VkPipelineStageFlags graphicsStages, VkAccessFlags graphicsAccess);
+	/** @brief Waits for the write slot to become available and begins its compute command buffer */
+	VkCommandBuffer beginAsyncCompute();
+	/** @brief Ends and submits the write slot's compute command buffer and advances the write and read slots */
+	void submitAsyncCompute();
+	/** @brief Records the acquire of the read slot's buffers, must be recorded into the graphics command buffer before they're used */
+	void acquireAsyncComputeBuffers(VkCommandBuffer commandBuffer);
+	/** @brief Records the release of the read slot's buffers to the compute queue, must be recorded into the graphics command buffer after their last use */
+	void releaseAsyncComputeBuffers(VkCommandBuffer commandBuffer);
+	/** @brief Returns a copy of submitInfo that also waits for the read slot's compute submission and signals the slot's graphics semaphore */
+	VkSubmitInfo getAsyncComputeSubmitInfo();
+	void destroyAsyncCompute();
+	void recordAsyncComputeTransfer(VkCommandBuffer commandBuffer, const std::vector<AsyncComputeBuffer>& buffers, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, bool toGraphics, bool release);
 public:
 	bool prepared = false;
 	bool resized = false;
@@ -169,9 +426,13 @@ public:
 	float frameTimer = 1.0f;
 
 	vks::Benchmark benchmark;
+	/** @brief Process exit code returned by the example's main entry point (e.g. non-zero if a benchmark regressed against its baseline) */
+	int exitCode = 0;
 
 	/** @brief Encapsulated physical and logical vulkan device */
 	vks::VulkanDevice *vulkanDevice;
+	/** @brief Moves the resources registered with it out of sparsely used memory blocks between frames, only created if Settings::defragmentBudget is set */
+	std::unique_ptr<vks::MemoryDefragmenter> memoryDefragmenter;
 
 	/** @brief Example settings that can be changed e.g. by command line arguments */
 	struct Settings {
@@ -181,8 +442,68 @@ public:
 		bool fullscreen = false;
 		/** @brief Set to true if v-sync will be forced for the swapchain */
 		bool vsync = false;
+		/** @brief Present mode for the swapchain, VK_PRESENT_MODE_MAX_ENUM_KHR selects it based on vsync */
+		VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+		/** @brief Minimum number of swapchain images, 0 uses the implementation's minimum plus one */
+		uint32_t swapchainImageCount = 0;
+		/** @brief Target frame time in milliseconds for the CPU frame limiter, 0 disables the limiter */
+		double frameLimit = 0.0;
 		/** @brief Enable UI overlay */
 		bool overlay = true;
+		/** @brief Number of frames the CPU may record ahead of the GPU, 1 waits for the queue to become idle after each frame (must be set before prepare, ignored for examples that don't set supportsFramesInFlight) */
+		uint32_t framesInFlight = 1;
+		/** @brief Use timeline semaphores instead of fences for frame and command buffer flush synchronization (if supported by the device) */
+		bool timelineSemaphores = false;
+		/** @brief Load the pipeline cache from disk at startup and store it at shutdown (one file per example and device in the user's cache directory) */
+		bool persistentPipelineCache = true;
+		/** @brief Sub-allocate buffer and texture memory from larger device memory blocks (see vks::MemoryAllocator) */
+		bool memoryAllocator = false;
+		/** @brief Request a dedicated transfer queue for asset uploads through the staging ring (see vks::StagingRing) */
+		bool transferQueue = false;
+		/** @brief Recompile changed shader sources in the background and rebuild the pipelines registered with watchShaders() (desktop only) */
+		bool shaderHotReload = false;
+		/** @brief Allow deferred shader stages that skip module creation on pipeline cache hits, for pipelines created through vks::PipelineBatch (if VK_EXT_shader_module_identifier is supported) */
+		bool shaderModuleIdentifiers = false;
+		/** @brief Record the UI overlay into a render pass and command buffer of its own every frame, so UI changes don't rebuild the example's command buffers (for examples submitting with submitInfo and submitFrame(), must be set before prepare) */
+		bool overlayPass = false;
+		/** @brief Render to the swapchain with VK_KHR_dynamic_rendering instead of a render pass and frame buffers (if supported by the device), for examples recording with beginSwapchainRendering() (must be set before prepare) */
+		bool dynamicRendering = false;
+		/** @brief Recreate the swapchain and the resources depending on it on resize without waiting for the device, releasing the old ones through deferDestruction() (examples have to release their own resources in windowResized() the same way, must be set before prepare) */
+		bool deferredResize = false;
+		/** @brief Target GPU frame time in milliseconds the render resolution of examples supporting it is scaled for, 0 disables dynamic resolution (see renderResolution) */
+		float dynamicResolutionTarget = 0.0f;
+		/** @brief Step through the workload sizes of examples supporting a stress test and print their timings per size (e.g. the crowd sizes of gltfskinning) */
+		bool stressTest = false;
+		/** @brief Number of recent frames the frame time graphs of the UI overlay are drawn for and summarized over */
+		uint32_t frameTimeWindow = 300;
+		/** @brief Load the assets of examples supporting it in the background and render with placeholders until they are available, so the first frame isn't delayed by asset loading */
+		bool lazyLoading = false;
+		/** @brief Measure the latency from input events to the presentation of the frame consuming them and print it at exit (always measured in benchmark mode, must be set before initVulkan) */
+		bool measureLatency = false;
+		/** @brief Adjust the frame limit, the dynamic resolution scale and the effect quality to the thermal status (Android) and frame time headroom, logging the time spent at each performance level (see vks::PerformanceGovernor) */
+		bool performanceGovernor = false;
+		/** @brief Render into offscreen images instead of a window's swapchain, so examples and benchmarks run without a window system or compositor (desktop only, see VulkanSwapChain::initOffscreen) */
+		bool offscreen = false;
+		/** @brief Number of frames rendered in offscreen mode outside of benchmarks, 0 renders until the process is terminated */
+		uint32_t offscreenFrames = 0;
+		/** @brief Save every n-th offscreen frame as a PPM file (offscreen_<frame>.ppm), 0 discards all frames */
+		uint32_t offscreenCaptureInterval = 0;
+		/** @brief Create the device for all physical devices of the selected device's device group (VK_KHR_device_group) and alternate the frames between them, for examples submitting with submitInfo and submitFrame() (use with framesInFlight of at least the number of devices, must be set before initVulkan) */
+		bool deviceGroup = false;
+		/** @brief Chrome trace JSON file the CPU scopes (see vks::Tracer) and GPU profiler scopes are saved to at exit, empty disables tracing */
+		std::string traceFilename = "";
+		/** @brief Print the startup phases, asset loads and pipeline creations ranked by duration once the first frame has been rendered (see vks::StartupReport) */
+		bool startupReport = false;
+		/** @brief File the startup report is also saved to as comma separated values, empty only prints it */
+		std::string startupReportFilename = "";
+		/** @brief Request framebuffer compression for the render targets of examples supporting it with VK_EXT_image_compression_control (if supported by the device) and read back the applied compression (see vks::createAttachmentImage) */
+		bool imageCompressionControl = false;
+		/** @brief Compression requested for render targets: VK_IMAGE_COMPRESSION_DEFAULT_EXT (lossless), VK_IMAGE_COMPRESSION_FIXED_RATE_DEFAULT_EXT (fixed-rate for intermediate targets, lossless for the others) or VK_IMAGE_COMPRESSION_DISABLED_EXT */
+		VkImageCompressionFlagsEXT imageCompression = VK_IMAGE_COMPRESSION_DEFAULT_EXT;
+		/** @brief Use the half precision (fp16) variants of the shaders of examples supporting it (see getShaderVariant), reset if the device doesn't support the shaderFloat16 feature */
+		bool halfPrecision = false;
+		/** @brief CPU time in milliseconds the memory defragmenter may spend per frame moving the resources examples registered with it, 0 disables defragmentation (enables the memory allocator, see memoryDefragmenter) */
+		float defragmentBudget = 0.0f;
 	} settings;
 
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
@@ -207,6 +528,8 @@ public:
 		VkImage image;
 		VkDeviceMemory mem;
 		VkImageView view;
+		/** @brief Usage flags added to the depth attachment usage, e.g. VK_IMAGE_USAGE_SAMPLED_BIT to read the depth in shaders (must be set before prepare) */
+		VkImageUsageFlags additionalUsage = 0;
 	} depthStencil;
 
 	struct {
@@ -358,6 +681,10 @@ public:
 	virtual void mouseMoved(double x, double y, bool &handled);
 	/** @brief (Virtual) Called when the window has been resized, can be used by the sample application to recreate resources */
 	virtual void windowResized();
+	/** @brief (Virtual) Called after the dynamic resolution controller changed renderResolution.scale, to be implemented by examples rendering at renderResolution (update it with updateRenderResolution and record the command buffers again, no frame is in flight) */
+	virtual void renderResolutionChanged();
+	/** @brief (Virtual) Called when the performance governor changes the effect quality, from 0 (lowest) to vks::PerformanceGovernor::maxQuality, to be implemented by examples with effects that can be scaled down (see Settings::performanceGovernor) */
+	virtual void qualityLevelChanged(uint32_t qualityLevel);
 	/** @brief (Virtual) Called when resources have been recreated that require a rebuild of the command buffers (e.g. frame buffer), to be implemented by the sample application */
 	virtual void buildCommandBuffers();
 	/** @brief (Virtual) Setup default depth and stencil views */
@@ -374,15 +701,46 @@ public:
 	/** @brief Prepares all Vulkan resources and functions required to run the sample */
 	virtual void prepare();
 
-	/** @brief Loads a SPIR-V shader file for the given shader stage */
-	VkPipelineShaderStageCreateInfo loadShader(std::string fileName, VkShaderStageFlagBits stage);
+	/**
+	* @brief Loads a SPIR-V shader file for the given shader stage, files loaded more than once share their module
+	* @param deferModule Only reference the module by its identifier if shader module identifiers are enabled, the stage may then only be used with a vks::PipelineBatch created with shaderModuleCache
+	*/
+	VkPipelineShaderStageCreateInfo loadShader(std::string fileName, VkShaderStageFlagBits stage, bool deferModule = false);
+	/** @brief Returns the half precision variant of a shader file ("<name>_fp16.<stage>.spv") if settings.halfPrecision is set and the variant exists, otherwise the file itself */
+	std::string getShaderVariant(const std::string& fileName) const;
+	/** @brief Worker pool shared by the example's parallel work (e.g. building a vks::PipelineBatch), created with one worker per hardware thread on first use */
+	vks::ThreadPool* getThreadPool();
+	/** @brief Pipeline creation flags for pipelines whose shader statistics are reported with reportShaderStatistics() */
+	VkPipelineCreateFlags getShaderStatisticsPipelineFlags() const;
+	/**
+	* @brief Adds the driver's statistics of a shader stage of a pipeline (e.g. instruction and register counts) to the benchmark metrics
+	* @note Only reported in benchmark mode on devices supporting VK_KHR_pipeline_executable_properties, the pipeline has to be created with getShaderStatisticsPipelineFlags()
+	*/
+	void reportShaderStatistics(VkPipeline pipeline, VkShaderStageFlagBits stage, const std::string& name);
+	/** @brief Destroys all shader modules loaded so far, call once the pipelines using them have been created (otherwise they are destroyed with the example) */
+	void releaseShaderModules();
+	/**
+	* @brief Registers a function that recreates the pipelines using the shaders loaded since the last call, for shader hot reload
+	* @note The function is called between frames with the device idle once any of these shaders has been recompiled, buildCommandBuffers() is called after it
+	*/
+	void watchShaders(std::function<void()> rebuildPipelines);
 
 	/** @brief Entry point for the main render loop */
 	void renderLoop();
 
-	/** @brief Adds the drawing commands for the ImGui overlay to the given command buffer */
+	/** @brief Adds the drawing commands for the ImGui overlay to the given command buffer (no-op if the overlay is drawn in a pass of its own) */
 	void drawUI(const VkCommandBuffer commandBuffer);
 
+	/**
+	* @brief Begins rendering to a swapchain image with cleared color and depth, using the default render pass and frame buffer or dynamic rendering
+	* @note With dynamic rendering this also transitions the images, endSwapchainRendering() transitions the color image for presentation
+	*/
+	void beginSwapchainRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	/** @brief Ends rendering started by beginSwapchainRendering() */
+	void endSwapchainRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	/** @brief Chains the swapchain attachment formats into a pipeline created with the default render pass (no-op without dynamic rendering) */
+	void setupPipelineRendering(VkGraphicsPipelineCreateInfo &pipelineCreateInfo);
+
 	/** Prepare the next frame for workload submission by acquiring the next swap chain image */
 	void prepareFrame();
 	/** @brief Presents the current image to the swap chain */
@@ -419,8 +777,9 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)									\
 	vulkanExample->setupWindow(hInstance, WndProc);													\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
+	int exitCode = vulkanExample->exitCode;															\
 	delete(vulkanExample);																			\
-	return 0;																						\
+	return exitCode;																				\
 }
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
 // Android entry point
@@ -451,8 +810,9 @@ int main(const int argc, const char *argv[])													    \
 	vulkanExample->initVulkan();																	\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
+	int exitCode = vulkanExample->exitCode;															\
 	delete(vulkanExample);																			\
-	return 0;																						\
+	return exitCode;																				\
 }
 #elif defined(VK_USE_PLATFORM_DIRECTFB_EXT)
 #define VULKAN_EXAMPLE_MAIN()																		\
@@ -472,8 +832,9 @@ int main(const int argc, const char *argv[])													    \
 	vulkanExample->setupWindow();					 												\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
+	int exitCode = vulkanExample->exitCode;															\
 	delete(vulkanExample);																			\
-	return 0;																						\
+	return exitCode;																				\
 }
 #elif (defined(VK_USE_PLATFORM_WAYLAND_KHR) || defined(VK_USE_PLATFORM_HEADLESS_EXT))
 #define VULKAN_EXAMPLE_MAIN()																		\
@@ -486,8 +847,9 @@ int main(const int argc, const char *argv[])													    \
 	vulkanExample->setupWindow();					 												\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
+	int exitCode = vulkanExample->exitCode;															\
 	delete(vulkanExample);																			\
-	return 0;																						\
+	return exitCode;																				\
 }
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
 #define VULKAN_EXAMPLE_MAIN()																		\
@@ -507,8 +869,9 @@ int main(const int argc, const char *argv[])													    \
 	vulkanExample->setupWindow();					 												\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
+	int exitCode = vulkanExample->exitCode;															\
 	delete(vulkanExample);																			\
-	return 0;																						\
+	return exitCode;																				\
 }
 #elif (defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 #if defined(VK_EXAMPLE_XCODE_GENERATED)
@@ -516,6 +879,7 @@ int main(const int argc, const char *argv[])													    \
 VulkanExample *vulkanExample;																		\
 int main(const int argc, const char *argv[])														\
 {																									\
+	int exitCode = 0;																			\
 	@autoreleasepool																				\
 	{																								\
 		for (size_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };				\
@@ -524,9 +888,10 @@ int main(const int argc, const char *argv[])														\
 		vulkanExample->setupWindow(nullptr);														\
 		vulkanExample->prepare();																	\
 		vulkanExample->renderLoop();																\
+		exitCode = vulkanExample->exitCode;															\
 		delete(vulkanExample);																		\
 	}																								\
-	return 0;																						\
+	return exitCode;																				\
 }
 #else
 #define VULKAN_EXAMPLE_MAIN()
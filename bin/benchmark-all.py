@@ -1,16 +1,24 @@
 # Benchmark all examples
+#
+# Runs the selected examples in benchmark mode with identical settings and
+# collects the per-example results into one consolidated report
+import argparse
+import csv
+import datetime
+import json
 import subprocess
 import sys
 import os
 import platform
 
 EXAMPLES = [
+	"apioverhead",
 	"bloom",
 	"computecloth",
 	"computecullandlod",
 	"computenbody",
 	"computeparticles",
-	"computeraytracing",	
+	"computeraytracing",
 	"computeshader",
 	"conditionalrender",
 	"conservativeraster",
@@ -22,7 +30,7 @@ EXAMPLES = [
 	"descriptorsets",
 	"displacement",
 	"distancefieldfonts",
-	"dynamicrendering",	
+	"dynamicrendering",
 	"dynamicuniformbuffer",
 	"gears",
 	"geometryshader",
@@ -36,6 +44,7 @@ EXAMPLES = [
 	"inlineuniformblocks",
 	"inputattachments",
 	"instancing",
+	"memorybandwidth",
 	"multisampling",
 	"multithreading",
 	"multiview",
@@ -79,28 +88,111 @@ EXAMPLES = [
 	"triangle",
 	"variablerateshading",
 	"vertexattributes",
+	"vertexpulling",
 	"viewportarray",
-	"vulkanscene"
+	"voxelization",
+	"vulkanscene",
+	"homework0",
+	"homework1",
+	"homework2"
 ]
 
-CURR_INDEX = 0
+# Frame time metrics copied from the per-example JSON results into the consolidated report
+REPORT_METRICS = ["min", "max", "avg", "stddev", "p50", "p90", "p99", "p99.9"]
 
-ARGS = "-fullscreen -b"
+parser = argparse.ArgumentParser(description="Run examples in benchmark mode and collect a consolidated report")
+parser.add_argument("examples", nargs="*", help="Examples to run (defaults to all examples)")
+parser.add_argument("--list", help="File with the names of the examples to run, one per line")
+parser.add_argument("--bindir", default=".", help="Directory containing the example binaries")
+parser.add_argument("--output", default="./benchmark", help="Directory for the result files and the report")
+parser.add_argument("--warmup", type=int, default=1, help="Warmup time in seconds")
+parser.add_argument("--duration", type=int, default=10, help="Benchmark duration in seconds")
+parser.add_argument("--width", type=int, help="Window width")
+parser.add_argument("--height", type=int, help="Window height")
+parser.add_argument("--fullscreen", action="store_true", help="Run examples in fullscreen mode")
+parser.add_argument("--gpu", type=int, help="Index of the GPU to run on")
+parser.add_argument("--frametimes", action="store_true", help="Store frame times in the result files")
+parser.add_argument("--pipelinestats", action="store_true", help="Collect pipeline statistics per frame")
+parser.add_argument("--baseline", help="Directory with result files of an earlier run to compare against")
+parser.add_argument("--threshold", type=float, help="Allowed regression against the baseline in percent")
+options = parser.parse_args()
 
-print("Benchmarking all examples...")
+examples = options.examples
+if options.list:
+	with open(options.list) as listFile:
+		examples += [line.strip() for line in listFile if line.strip() and not line.startswith("#")]
+if not examples:
+	examples = EXAMPLES
 
-os.makedirs("./benchmark", exist_ok=True)
+ARGS = ["-b", "-bw", str(options.warmup), "-br", str(options.duration)]
+if options.fullscreen:
+	ARGS += ["-f"]
+if options.width:
+	ARGS += ["-w", str(options.width)]
+if options.height:
+	ARGS += ["-h", str(options.height)]
+if options.gpu is not None:
+	ARGS += ["-g", str(options.gpu)]
+if options.frametimes:
+	ARGS += ["-bt"]
+if options.pipelinestats:
+	ARGS += ["-bps"]
+if options.threshold is not None:
+	ARGS += ["-brt", str(options.threshold)]
 
-for example in EXAMPLES:
-	print("---- (%d/%d) Running %s in benchmark mode ----" % (CURR_INDEX+1, len(EXAMPLES), example))
-	if platform.system() == 'Linux' or platform.system() == 'Darwin':
-		RESULT_CODE = subprocess.call("./%s %s -bf ./benchmark/%s.csv 5" % (example, ARGS, example), shell=True)
-	else:
-		RESULT_CODE = subprocess.call("%s %s -bf ./benchmark/%s.csv 5" % (example, ARGS, example))
+print("Benchmarking %d examples..." % len(examples))
+
+os.makedirs(options.output, exist_ok=True)
+
+results = []
+failed = []
+
+for CURR_INDEX, example in enumerate(examples):
+	print("---- (%d/%d) Running %s in benchmark mode ----" % (CURR_INDEX+1, len(examples), example))
+	executable = os.path.join(options.bindir, example + (".exe" if platform.system() == 'Windows' else ""))
+	csvFile = os.path.join(options.output, example + ".csv")
+	jsonFile = os.path.join(options.output, example + ".json")
+	command = [executable] + ARGS + ["-bf", csvFile, "-bj", jsonFile]
+	if options.baseline:
+		baselineFile = os.path.join(options.baseline, example + ".csv")
+		if os.path.exists(baselineFile):
+			command += ["-bbl", baselineFile]
+	if not os.path.exists(executable):
+		print("Error, %s not found" % executable)
+		failed.append({"example": example, "resultcode": None})
+		continue
+	RESULT_CODE = subprocess.call(command)
 	if RESULT_CODE == 0:
-		print("Results written to ./benchmark/%s.csv" % example)
+		print("Results written to %s" % csvFile)
 	else:
 		print("Error, result code = %d" % RESULT_CODE)
-	CURR_INDEX += 1
+		failed.append({"example": example, "resultcode": RESULT_CODE})
+	if os.path.exists(jsonFile):
+		with open(jsonFile) as resultFile:
+			result = json.load(resultFile)
+		result["example"] = example
+		result["resultcode"] = RESULT_CODE
+		results.append(result)
+
+# Consolidated report, device and driver are stored per example as examples may select different devices
+report = {
+	"date": datetime.datetime.now().isoformat(),
+	"platform": platform.platform(),
+	"arguments": ARGS,
+	"results": results,
+	"failed": failed
+}
+with open(os.path.join(options.output, "report.json"), "w") as reportFile:
+	json.dump(report, reportFile, indent=2)
+
+with open(os.path.join(options.output, "report.csv"), "w", newline="") as reportFile:
+	writer = csv.writer(reportFile)
+	writer.writerow(["example", "device", "driverversion", "resultcode", "frames", "fps"] + ["%s (ms)" % metric for metric in REPORT_METRICS])
+	for result in results:
+		frametime = result.get("frametime", {})
+		writer.writerow([result["example"], result.get("device", ""), result.get("driverversion", ""), result["resultcode"], result.get("frames", ""), result.get("fps", "")] + [frametime.get(metric, "") for metric in REPORT_METRICS])
 
-print("Benchmark run finished")
+print("Benchmark run finished, report written to %s" % os.path.join(options.output, "report.csv"))
+if failed:
+	print("%d example(s) failed: %s" % (len(failed), ", ".join(entry["example"] for entry in failed)))
+	sys.exit(1)
@@ -0,0 +1,26 @@
+#version 450
+
+// Half precision variant of mesh.frag, selected with --halfprecision if the device supports shaderFloat16
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require
+
+layout (set = 1, binding = 0) uniform sampler2D samplerColorMap;
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec3 inColor;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec3 inViewVec;
+layout (location = 4) in vec3 inLightVec;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+	f16vec4 color = f16vec4(texture(samplerColorMap, inUV)) * f16vec4(f16vec3(inColor), 1.0hf);
+
+	f16vec3 N = f16vec3(normalize(inNormal));
+	f16vec3 L = f16vec3(normalize(inLightVec));
+	f16vec3 V = f16vec3(normalize(inViewVec));
+	f16vec3 R = reflect(L, N);
+	f16vec3 specular = pow(max(dot(R, V), 0.0hf), 16.0hf) * f16vec3(0.75hf);
+	outFragColor = vec4(vec3(color.rgb + specular), 1.0);		
+}
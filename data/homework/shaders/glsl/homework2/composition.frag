@@ -0,0 +1,49 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D samplerColor;
+layout (binding = 1) uniform usampler2D samplerShadingRate;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+layout(push_constant) uniform PushConsts {
+	ivec2 texelSize;
+	int colorShadingRates;
+} pushConsts;
+
+// Encoding of the shading rate image, fragment size exponents for VK_KHR_fragment_shading_rate, palette indices for VK_NV_shading_rate_image
+layout (constant_id = 0) const bool SHADING_RATE_KHR = false;
+
+void main()
+{
+	outFragColor = texture(samplerColor, inUV);
+
+	if (pushConsts.colorShadingRates == 1) {
+		// Fragment size requested for this pixel by the shading rate image
+		const uint value = texelFetch(samplerShadingRate, ivec2(gl_FragCoord.xy) / pushConsts.texelSize, 0).r;
+		uvec2 fragmentSize;
+		if (SHADING_RATE_KHR) {
+			fragmentSize = uvec2(1u << ((value >> 2) & 3u), 1u << (value & 3u));
+		} else {
+			// Palette entries 5 to 11 set up in homework2.cpp
+			const uvec2 paletteSizes[7] = uvec2[](uvec2(1, 1), uvec2(2, 1), uvec2(1, 2), uvec2(2, 2), uvec2(4, 2), uvec2(2, 4), uvec2(4, 4));
+			fragmentSize = paletteSizes[clamp(value, 5u, 11u) - 5u];
+		}
+		if (fragmentSize == uvec2(1, 1)) {
+			outFragColor.rgb *= vec3(0.0, 0.8, 0.4);
+		} else if (fragmentSize == uvec2(2, 1)) {
+			outFragColor.rgb *= vec3(0.2, 0.6, 1.0);
+		} else if (fragmentSize == uvec2(1, 2)) {
+			outFragColor.rgb *= vec3(0.0, 0.4, 0.8);
+		} else if (fragmentSize == uvec2(2, 2)) {
+			outFragColor.rgb *= vec3(1.0, 1.0, 0.2);
+		} else if (fragmentSize == uvec2(4, 2)) {
+			outFragColor.rgb *= vec3(0.8, 0.8, 0.0);
+		} else if (fragmentSize == uvec2(2, 4)) {
+			outFragColor.rgb *= vec3(1.0, 0.4, 0.2);
+		} else {
+			outFragColor.rgb *= vec3(0.8, 0.0, 0.0);
+		}
+	}
+}
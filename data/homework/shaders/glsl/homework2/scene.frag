@@ -1,7 +1,5 @@
 #version 450
 
-#extension GL_NV_shading_rate_image : require
-
 layout (set = 1, binding = 0) uniform sampler2D samplerColorMap;
 layout (set = 1, binding = 1) uniform sampler2D samplerNormalMap;
 
@@ -19,7 +17,6 @@ layout (set = 0, binding = 0) uniform UBOScene
 	mat4 model;
 	vec4 lightPos;
 	vec4 viewPos;
-	int colorShadingRates;
 } uboScene;
 
 layout (location = 0) out vec4 outFragColor;
@@ -50,35 +47,4 @@ void main()
 	vec3 diffuse = max(dot(N, L), ambient).rrr;
 	float specular = pow(max(dot(R, V), 0.0), 32.0);
 	outFragColor = vec4(diffuse * color.rgb + specular, color.a);
-
-	if (uboScene.colorShadingRates == 1) {
-		if (gl_FragmentSizeNV.x == 1 && gl_FragmentSizeNV.y == 1) {
-			outFragColor.rgb *= vec3(0.0, 0.8, 0.4);
-			return;
-		}
-		if (gl_FragmentSizeNV.x == 2 && gl_FragmentSizeNV.y == 1) {
-			outFragColor.rgb *= vec3(0.2, 0.6, 1.0);
-			return;
-		}
-		if (gl_FragmentSizeNV.x == 1 && gl_FragmentSizeNV.y == 2) {
-			outFragColor.rgb *= vec3(0.0, 0.4, 0.8);
-			return;
-		}
-		if (gl_FragmentSizeNV.x == 2 && gl_FragmentSizeNV.y == 2) {
-			outFragColor.rgb *= vec3(1.0, 1.0, 0.2);
-			return;
-		}
-		if (gl_FragmentSizeNV.x == 4 && gl_FragmentSizeNV.y == 2) {
-			outFragColor.rgb *= vec3(0.8, 0.8, 0.0);
-			return;
-		}
-		if (gl_FragmentSizeNV.x == 2 && gl_FragmentSizeNV.y == 4) {
-			outFragColor.rgb *= vec3(1.0, 0.4, 0.2);
-			return;
-		}
-		if (gl_FragmentSizeNV.x == 4 && gl_FragmentSizeNV.y == 4) {
-			outFragColor.rgb *= vec3(0.8, 0.0, 0.0);
-			return;
-		}
-	}
 }
\ No newline at end of file
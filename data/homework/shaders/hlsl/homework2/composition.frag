@@ -0,0 +1,49 @@
+// Copyright 2020 Sascha Willems
+
+Texture2D textureColor : register(t0);
+SamplerState samplerColor : register(s0);
+Texture2D<uint> textureShadingRate : register(t1);
+
+struct PushConsts {
+	int2 texelSize;
+	int colorShadingRates;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+// Encoding of the shading rate image, fragment size exponents for VK_KHR_fragment_shading_rate, palette indices for VK_NV_shading_rate_image
+[[vk::constant_id(0)]] const bool SHADING_RATE_KHR = false;
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0, float4 fragCoord : SV_POSITION) : SV_TARGET
+{
+	float4 color = textureColor.Sample(samplerColor, inUV);
+
+	if (pushConsts.colorShadingRates == 1) {
+		// Fragment size requested for this pixel by the shading rate image
+		const uint value = textureShadingRate.Load(int3(int2(fragCoord.xy) / pushConsts.texelSize, 0));
+		uint2 fragmentSize;
+		if (SHADING_RATE_KHR) {
+			fragmentSize = uint2(1u << ((value >> 2) & 3u), 1u << (value & 3u));
+		} else {
+			// Palette entries 5 to 11 set up in homework2.cpp
+			const uint2 paletteSizes[7] = { uint2(1, 1), uint2(2, 1), uint2(1, 2), uint2(2, 2), uint2(4, 2), uint2(2, 4), uint2(4, 4) };
+			fragmentSize = paletteSizes[clamp(value, 5u, 11u) - 5u];
+		}
+		if (all(fragmentSize == uint2(1, 1))) {
+			color.rgb *= float3(0.0, 0.8, 0.4);
+		} else if (all(fragmentSize == uint2(2, 1))) {
+			color.rgb *= float3(0.2, 0.6, 1.0);
+		} else if (all(fragmentSize == uint2(1, 2))) {
+			color.rgb *= float3(0.0, 0.4, 0.8);
+		} else if (all(fragmentSize == uint2(2, 2))) {
+			color.rgb *= float3(1.0, 1.0, 0.2);
+		} else if (all(fragmentSize == uint2(4, 2))) {
+			color.rgb *= float3(0.8, 0.8, 0.0);
+		} else if (all(fragmentSize == uint2(2, 4))) {
+			color.rgb *= float3(1.0, 0.4, 0.2);
+		} else {
+			color.rgb *= float3(0.8, 0.0, 0.0);
+		}
+	}
+
+	return color;
+}
@@ -12,7 +12,6 @@ struct UBO
 	float4x4 model;
 	float4 lightPos;
 	float4 viewPos;
-	int colorShadingRates;
 };
 cbuffer ubo : register(b0) { UBO ubo; };
 
@@ -29,7 +28,7 @@ struct VSOutput
 [[vk::location(5)]] float4 Tangent : TEXCOORD3;
 };
 
-float4 main(VSOutput input, uint shadingRate : SV_ShadingRate) : SV_TARGET
+float4 main(VSOutput input) : SV_TARGET
 {
 	float4 color = textureColorMap.Sample(samplerColorMap, input.UV) * float4(input.Color, 1.0);
 
@@ -51,33 +50,5 @@ float4 main(VSOutput input, uint shadingRate : SV_ShadingRate) : SV_TARGET
 	float3 R = reflect(-L, N);
 	float3 diffuse = max(dot(N, L), ambient).rrr;
 	float3 specular = pow(max(dot(R, V), 0.0), 32.0);
-	color =  float4(diffuse * color.rgb + specular, color.a);
-
-    const uint SHADING_RATE_PER_PIXEL = 0x0;
-    const uint SHADING_RATE_PER_2X1_PIXELS = 6;
-    const uint SHADING_RATE_PER_1X2_PIXELS = 7;
-    const uint SHADING_RATE_PER_2X2_PIXELS = 8;
-    const uint SHADING_RATE_PER_4X2_PIXELS = 9;
-    const uint SHADING_RATE_PER_2X4_PIXELS = 10;
-
-	if (ubo.colorShadingRates == 1) {
-		switch(shadingRate) {
-			case SHADING_RATE_PER_PIXEL:
-				return color * float4(0.0, 0.8, 0.4, 1.0);
-			case SHADING_RATE_PER_2X1_PIXELS:
-				return color * float4(0.2, 0.6, 1.0, 1.0);
-			case SHADING_RATE_PER_1X2_PIXELS:
-				return color * float4(0.0, 0.4, 0.8, 1.0);
-			case SHADING_RATE_PER_2X2_PIXELS:
-				return color * float4(1.0, 1.0, 0.2, 1.0);
-			case SHADING_RATE_PER_4X2_PIXELS:
-				return color * float4(0.8, 0.8, 0.0, 1.0);
-			case SHADING_RATE_PER_2X4_PIXELS:
-				return color * float4(1.0, 0.4, 0.2, 1.0);
-		default:
-			return color * float4(0.8, 0.0, 0.0, 1.0);
-		}
-	}
-
-	return color;
+	return float4(diffuse * color.rgb + specular, color.a);
 }
\ No newline at end of file
@@ -16,7 +16,6 @@ struct UBO
 	float4x4 model;
 	float4 lightPos;
 	float4 viewPos;
-	int colorShadingRates;
 };
 cbuffer ubo : register(b0) { UBO ubo; };
 
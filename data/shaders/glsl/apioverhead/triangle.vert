@@ -0,0 +1,28 @@
+#version 450
+
+layout (binding = 0) uniform UBO 
+{
+	vec4 color;
+} ubo;
+
+layout (push_constant) uniform PushConsts 
+{
+	vec4 offset;
+} pushConsts;
+
+// Only changes the color, so the pipelines of the pipeline switch test aren't identical
+layout (constant_id = 0) const float BRIGHTNESS = 1.0;
+
+layout (location = 0) out vec3 outColor;
+
+const uint gridSize = 128;
+
+void main() 
+{
+	// Every draw is a small triangle in a cell of a grid, selected by the draw's first vertex
+	const vec2 positions[3] = vec2[](vec2(0.0, 0.0), vec2(0.8, 0.0), vec2(0.0, 0.8));
+	uint cell = (gl_VertexIndex / 3) % (gridSize * gridSize);
+	vec2 pos = (vec2(cell % gridSize, cell / gridSize) + positions[gl_VertexIndex % 3]) / float(gridSize);
+	gl_Position = vec4(pos * 2.0 - 1.0 + pushConsts.offset.xy, 0.0, 1.0);
+	outColor = ubo.color.rgb * BRIGHTNESS;
+}
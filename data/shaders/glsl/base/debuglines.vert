@@ -0,0 +1,40 @@
+#version 450
+
+// Pulls the vertices of the debug lines from the line buffer, see vks::DebugLineRenderer
+
+struct LineVertex {
+	vec4 position;
+	vec4 color;
+};
+
+layout (std430, binding = 0) readonly buffer DrawCommand {
+	uint vertexCount;
+	uint instanceCount;
+	uint firstVertex;
+	uint firstInstance;
+	uint hostVertexCount;
+	mat4 viewProjection;
+} drawCommand;
+
+layout (std430, binding = 1) readonly buffer Vertices {
+	LineVertex vertices[];
+};
+
+layout (location = 0) out vec4 outColor;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+void main() 
+{
+	// Lines appended beyond the capacity of the buffer are counted, but not stored, so they're moved outside of the view volume
+	if (gl_VertexIndex >= vertices.length()) {
+		outColor = vec4(0.0);
+		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+		return;
+	}
+	outColor = vertices[gl_VertexIndex].color;
+	gl_Position = drawCommand.viewProjection * vec4(vertices[gl_VertexIndex].position.xyz, 1.0);
+}
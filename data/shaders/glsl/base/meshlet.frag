@@ -0,0 +1,32 @@
+#version 450
+
+// Diffuse shading of meshlets emitted by meshlet.mesh, each meshlet gets a color of its own to visualize the meshlet boundaries
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec3 inWorldPos;
+layout (location = 3) flat in uint inMeshletIndex;
+
+layout (set = 0, binding = 0) uniform UBOScene {
+	mat4 projection;
+	mat4 view;
+	vec4 frustumPlanes[6];
+	vec4 viewPos;
+} uboScene;
+
+layout (location = 0) out vec4 outFragColor;
+
+vec3 meshletColor(uint index)
+{
+	uint hash = index * 0x9e3779b9u;
+	hash ^= hash >> 16;
+	return vec3(hash & 0xff, (hash >> 8) & 0xff, (hash >> 16) & 0xff) / 255.0 * 0.75 + 0.25;
+}
+
+void main()
+{
+	const vec3 N = normalize(inNormal);
+	const vec3 V = normalize(uboScene.viewPos.xyz - inWorldPos);
+	const float diffuse = max(dot(N, V), 0.15);
+	outFragColor = vec4(meshletColor(inMeshletIndex) * diffuse, 1.0);
+}
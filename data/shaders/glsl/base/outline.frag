@@ -0,0 +1,46 @@
+#version 450
+
+// Outline composite, see vks::OutlineRenderer
+// Pixels outside of the mask within the outline width of a border pixel get the color of that pixel's id, the last pixel is faded
+// by its coverage for an antialiased edge. Pixels inside of the mask are tinted with the fill opacity.
+
+layout (binding = 0) uniform usampler2D samplerMask;
+layout (binding = 1) uniform usampler2D samplerDistances;
+
+layout (binding = 2) uniform UBO
+{
+	vec4 colors[16];
+	float width;
+	float fillOpacity;
+} ubo;
+
+layout (location = 0) out vec4 outFragColor;
+
+#define EMPTY 0xFFFFFFFFu
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	uint id = texelFetch(samplerMask, texel, 0).r;
+	if (id != 0) {
+		if (ubo.fillOpacity <= 0.0) {
+			discard;
+		}
+		vec4 color = ubo.colors[id];
+		outFragColor = vec4(color.rgb, color.a * ubo.fillOpacity);
+		return;
+	}
+
+	uint seed = texelFetch(samplerDistances, texel, 0).r;
+	if (seed == EMPTY) {
+		discard;
+	}
+	ivec2 seedTexel = ivec2(seed & 0xFFFFu, seed >> 16u);
+	// Border pixels are inside of the mask, so the first pixel outside of it is at a distance of one
+	float coverage = clamp(ubo.width - length(vec2(seedTexel - texel)) + 1.0, 0.0, 1.0);
+	if (coverage <= 0.0) {
+		discard;
+	}
+	vec4 color = ubo.colors[texelFetch(samplerMask, seedTexel, 0).r];
+	outFragColor = vec4(color.rgb, color.a * coverage);
+}
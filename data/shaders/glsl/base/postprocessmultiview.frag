@@ -0,0 +1,85 @@
+#version 450
+
+#extension GL_EXT_multiview : enable
+
+// Post processing uber pass (vks::PostProcessStack) for multiview render passes, reads the input layer of the view being rendered
+// Otherwise identical to postprocess.frag
+
+#define EFFECT_EXPOSURE 0
+#define EFFECT_TONEMAP 1
+#define EFFECT_COLOR_GRADING 2
+#define EFFECT_VIGNETTE 3
+#define EFFECT_DITHER 4
+
+// Layer per view
+layout (binding = 0) uniform sampler2DArray samplerInput;
+// Color grading table indexed by red, green and blue
+layout (binding = 1) uniform sampler3D samplerLut;
+
+layout (binding = 2) uniform UBO
+{
+	ivec4 effects[2];
+	int effectCount;
+	float exposure;
+	float colorGradingStrength;
+	float lutSize;
+	float vignetteIntensity;
+	float vignetteRadius;
+	float ditherStrength;
+} ubo;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+// ACES filmic tone mapping curve fit by Krzysztof Narkowicz
+vec3 tonemapACES(vec3 color)
+{
+	return clamp((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+}
+
+vec3 colorGrading(vec3 color)
+{
+	// Sample at the entry centers so the table's first and last entries map to 0 and 1
+	vec3 uvw = clamp(color, 0.0, 1.0) * ((ubo.lutSize - 1.0) / ubo.lutSize) + 0.5 / ubo.lutSize;
+	return mix(color, texture(samplerLut, uvw).rgb, ubo.colorGradingStrength);
+}
+
+vec3 vignette(vec3 color)
+{
+	// 0 at the center, 1 at the corners
+	float dist = length(inUV - 0.5) * 1.41421356;
+	return color * (1.0 - ubo.vignetteIntensity * smoothstep(ubo.vignetteRadius, 1.0, dist));
+}
+
+vec3 dither(vec3 color)
+{
+	// Interleaved gradient noise, stable per pixel and without a noise texture
+	float noise = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+	return color + (noise - 0.5) * ubo.ditherStrength;
+}
+
+void main() 
+{
+	vec3 color = texture(samplerInput, vec3(inUV, gl_ViewIndex)).rgb;
+	for (int i = 0; i < ubo.effectCount; i++) {
+		switch (ubo.effects[i / 4][i % 4]) {
+			case EFFECT_EXPOSURE:
+				color *= ubo.exposure;
+				break;
+			case EFFECT_TONEMAP:
+				color = tonemapACES(color);
+				break;
+			case EFFECT_COLOR_GRADING:
+				color = colorGrading(color);
+				break;
+			case EFFECT_VIGNETTE:
+				color = vignette(color);
+				break;
+			case EFFECT_DITHER:
+				color = dither(color);
+				break;
+		}
+	}
+	outFragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,34 @@
+#version 450
+
+// Stores the voxels covered by a fragment into the level's slices of the voxel texture
+
+layout (binding = 0, rgba8) uniform writeonly image3D voxels;
+
+layout (push_constant) uniform PushConstants {
+	mat4 model;
+	vec4 origin;
+	uint level;
+	uint resolution;
+} pushConstants;
+
+layout (location = 0) in vec3 inVoxelPos;
+layout (location = 1) in vec3 inColor;
+layout (location = 2) flat in uint inAxis;
+
+void main() 
+{
+	int resolution = int(pushConstants.resolution);
+	ivec3 voxel = ivec3(floor(inVoxelPos));
+	// The projection along the dominant axis limits the depth slope to one voxel per pixel, a fragment can touch up to two voxels
+	// along the projection axis, which are both stored so inclined surfaces don't get holes
+	float depth = inVoxelPos[inAxis];
+	float depthRange = min(fwidth(depth) * 0.5, 1.0);
+	int firstVoxel = int(floor(depth - depthRange));
+	int lastVoxel = int(floor(depth + depthRange));
+	for (int i = firstVoxel; i <= lastVoxel; i++) {
+		voxel[inAxis] = i;
+		if (all(greaterThanEqual(voxel, ivec3(0))) && all(lessThan(voxel, ivec3(resolution)))) {
+			imageStore(voxels, ivec3(voxel.xy, voxel.z + int(pushConstants.level) * resolution), vec4(inColor, 1.0));
+		}
+	}
+}
@@ -0,0 +1,25 @@
+#version 450
+
+// Voxelizes the scene into a clipmap level, see vks::Voxelizer
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inColor;
+
+layout (push_constant) uniform PushConstants {
+	mat4 model;
+	// xyz = level origin, w = voxel size
+	vec4 origin;
+	uint level;
+	uint resolution;
+} pushConstants;
+
+layout (location = 0) out vec3 outVoxelPos;
+layout (location = 1) out vec3 outColor;
+
+void main() 
+{
+	// Position in voxels of the level, projected by the geometry shader
+	vec3 worldPos = (pushConstants.model * vec4(inPos, 1.0)).xyz;
+	outVoxelPos = (worldPos - pushConstants.origin.xyz) / pushConstants.origin.w;
+	outColor = inColor;
+}
@@ -0,0 +1,134 @@
+#version 450
+
+// Composition subpass of the single render pass path, the G-Buffer is read from tile memory
+// Depth instead of positions for the packed G-Buffer
+layout (input_attachment_index = 0, binding = 1) uniform subpassInput samplerposition;
+layout (input_attachment_index = 1, binding = 2) uniform subpassInput samplerNormal;
+layout (input_attachment_index = 2, binding = 3) uniform subpassInput samplerAlbedo;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragcolor;
+
+layout (constant_id = 0) const bool PACKED_GBUFFER = false;
+
+struct Light {
+	// xyz: position, w: range
+	vec4 position;
+	vec3 color;
+	float radius;
+	// xyz: spot direction, w: cosine of the cone angle (-2 for point lights)
+	vec4 direction;
+};
+
+layout (binding = 4) uniform UBO 
+{
+	mat4 view;
+	mat4 invProjection;
+	mat4 invViewProjection;
+	vec4 viewPos;
+	int displayDebugTarget;
+	int lightCount;
+	vec2 uvScale;
+	ivec2 renderExtent;
+	int clustered;
+	float zNear;
+	float zFar;
+} ubo;
+
+layout (binding = 5, std430) readonly buffer Lights
+{
+	Light lights[ ];
+};
+
+vec3 decodeNormal(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+vec3 shade(Light light, vec3 fragPos, vec3 normal, vec4 albedo)
+{
+	// Vector to light
+	vec3 L = light.position.xyz - fragPos;
+	// Distance from light to fragment position
+	float dist = length(L);
+
+	// Viewer to fragment
+	vec3 V = ubo.viewPos.xyz - fragPos;
+	V = normalize(V);
+
+	// Light to fragment
+	L = normalize(L);
+
+	// Attenuation, faded out towards the light's range
+	float atten = light.radius / (pow(dist, 2.0) + 1.0);
+	float window = clamp(1.0 - pow(dist / light.position.w, 4.0), 0.0, 1.0);
+	atten *= window * window;
+	// Spot cone
+	atten *= smoothstep(light.direction.w, light.direction.w + 0.05, dot(-L, light.direction.xyz));
+
+	// Diffuse part
+	vec3 N = normalize(normal);
+	float NdotL = max(0.0, dot(N, L));
+	vec3 diff = light.color * albedo.rgb * NdotL * atten;
+
+	// Specular part
+	// Specular map values are stored in alpha of albedo mrt
+	vec3 R = reflect(-L, N);
+	float NdotR = max(0.0, dot(R, V));
+	vec3 spec = light.color * albedo.a * pow(NdotR, 16.0) * atten;
+
+	return diff + spec;
+}
+
+void main() 
+{
+	// Read G-Buffer values from the previous subpass
+	vec3 fragPos;
+	vec3 normal;
+	if (PACKED_GBUFFER) {
+		vec4 pos = ubo.invViewProjection * vec4(inUV * 2.0 - 1.0, subpassLoad(samplerposition).r, 1.0);
+		fragPos = pos.xyz / pos.w;
+		normal = decodeNormal(subpassLoad(samplerNormal).rg);
+	} else {
+		fragPos = subpassLoad(samplerposition).rgb;
+		normal = subpassLoad(samplerNormal).rgb;
+	}
+	vec4 albedo = subpassLoad(samplerAlbedo);
+	
+	// Debug display
+	if (ubo.displayDebugTarget > 0) {
+		switch (ubo.displayDebugTarget) {
+			case 1: 
+				outFragcolor.rgb = fragPos;
+				break;
+			case 2: 
+				outFragcolor.rgb = normal;
+				break;
+			case 3: 
+				outFragcolor.rgb = albedo.rgb;
+				break;
+			case 4: 
+				outFragcolor.rgb = albedo.aaa;
+				break;
+		}		
+		outFragcolor.a = 1.0;
+		return;
+	}
+
+	#define ambient 0.0
+	
+	// Ambient part
+	vec3 fragcolor  = albedo.rgb * ambient;
+	
+	// Light culling needs the depth buffer before the composition, so all lights are shaded within the render pass
+	for (int i = 0; i < ubo.lightCount; ++i) {
+		fragcolor += shade(lights[i], fragPos, normal, albedo);
+	}
+   
+	outFragcolor = vec4(fragcolor, 1.0);
+}
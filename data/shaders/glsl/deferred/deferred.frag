@@ -1,5 +1,6 @@
 #version 450
 
+// Depth instead of positions for the packed G-Buffer
 layout (binding = 1) uniform sampler2D samplerposition;
 layout (binding = 2) uniform sampler2D samplerNormal;
 layout (binding = 3) uniform sampler2D samplerAlbedo;
@@ -8,25 +9,107 @@ layout (location = 0) in vec2 inUV;
 
 layout (location = 0) out vec4 outFragcolor;
 
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 128
+
+layout (constant_id = 0) const bool PACKED_GBUFFER = false;
+
 struct Light {
+	// xyz: position, w: range
 	vec4 position;
 	vec3 color;
 	float radius;
+	// xyz: spot direction, w: cosine of the cone angle (-2 for point lights)
+	vec4 direction;
 };
 
 layout (binding = 4) uniform UBO 
 {
-	Light lights[6];
+	mat4 view;
+	mat4 invProjection;
+	mat4 invViewProjection;
 	vec4 viewPos;
 	int displayDebugTarget;
+	int lightCount;
+	vec2 uvScale;
+	ivec2 renderExtent;
+	int clustered;
+	float zNear;
+	float zFar;
 } ubo;
 
+layout (binding = 5, std430) readonly buffer Lights
+{
+	Light lights[ ];
+};
+
+// Light lists written by clusters.comp
+layout (binding = 6, std430) readonly buffer Clusters
+{
+	uint clusterData[ ];
+};
+
+vec3 decodeNormal(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+vec3 shade(Light light, vec3 fragPos, vec3 normal, vec4 albedo)
+{
+	// Vector to light
+	vec3 L = light.position.xyz - fragPos;
+	// Distance from light to fragment position
+	float dist = length(L);
+
+	// Viewer to fragment
+	vec3 V = ubo.viewPos.xyz - fragPos;
+	V = normalize(V);
+
+	// Light to fragment
+	L = normalize(L);
+
+	// Attenuation, faded out towards the light's range so lights outside of a cluster don't contribute
+	float atten = light.radius / (pow(dist, 2.0) + 1.0);
+	float window = clamp(1.0 - pow(dist / light.position.w, 4.0), 0.0, 1.0);
+	atten *= window * window;
+	// Spot cone
+	atten *= smoothstep(light.direction.w, light.direction.w + 0.05, dot(-L, light.direction.xyz));
+
+	// Diffuse part
+	vec3 N = normalize(normal);
+	float NdotL = max(0.0, dot(N, L));
+	vec3 diff = light.color * albedo.rgb * NdotL * atten;
+
+	// Specular part
+	// Specular map values are stored in alpha of albedo mrt
+	vec3 R = reflect(-L, N);
+	float NdotR = max(0.0, dot(R, V));
+	vec3 spec = light.color * albedo.a * pow(NdotR, 16.0) * atten;
+
+	return diff + spec;
+}
+
 void main() 
 {
-	// Get G-Buffer values
-	vec3 fragPos = texture(samplerposition, inUV).rgb;
-	vec3 normal = texture(samplerNormal, inUV).rgb;
-	vec4 albedo = texture(samplerAlbedo, inUV);
+	// Get G-Buffer values, the scene is rendered to the top left part of the attachments
+	vec2 uv = inUV * ubo.uvScale;
+	vec3 fragPos;
+	vec3 normal;
+	if (PACKED_GBUFFER) {
+		vec4 pos = ubo.invViewProjection * vec4(inUV * 2.0 - 1.0, texture(samplerposition, uv).r, 1.0);
+		fragPos = pos.xyz / pos.w;
+		normal = decodeNormal(texture(samplerNormal, uv).rg);
+	} else {
+		fragPos = texture(samplerposition, uv).rgb;
+		normal = texture(samplerNormal, uv).rgb;
+	}
+	vec4 albedo = texture(samplerAlbedo, uv);
 	
 	// Debug display
 	if (ubo.displayDebugTarget > 0) {
@@ -50,45 +133,26 @@ void main()
 
 	// Render-target composition
 
-	#define lightCount 6
 	#define ambient 0.0
 	
 	// Ambient part
 	vec3 fragcolor  = albedo.rgb * ambient;
 	
-	for(int i = 0; i < lightCount; ++i)
-	{
-		// Vector to light
-		vec3 L = ubo.lights[i].position.xyz - fragPos;
-		// Distance from light to fragment position
-		float dist = length(L);
-
-		// Viewer to fragment
-		vec3 V = ubo.viewPos.xyz - fragPos;
-		V = normalize(V);
-		
-		//if(dist < ubo.lights[i].radius)
-		{
-			// Light to fragment
-			L = normalize(L);
-
-			// Attenuation
-			float atten = ubo.lights[i].radius / (pow(dist, 2.0) + 1.0);
-
-			// Diffuse part
-			vec3 N = normalize(normal);
-			float NdotL = max(0.0, dot(N, L));
-			vec3 diff = ubo.lights[i].color * albedo.rgb * NdotL * atten;
-
-			// Specular part
-			// Specular map values are stored in alpha of albedo mrt
-			vec3 R = reflect(-L, N);
-			float NdotR = max(0.0, dot(R, V));
-			vec3 spec = ubo.lights[i].color * albedo.a * pow(NdotR, 16.0) * atten;
-
-			fragcolor += diff + spec;	
-		}	
-	}    	
+	if (ubo.clustered == 1) {
+		// Only the lights binned into the fragment's cluster
+		uvec2 tile = min(uvec2(inUV * vec2(CLUSTER_X, CLUSTER_Y)), uvec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+		float depth = -(ubo.view * vec4(fragPos, 1.0)).z;
+		uint slice = uint(clamp(log(depth / ubo.zNear) / log(ubo.zFar / ubo.zNear) * float(CLUSTER_Z), 0.0, float(CLUSTER_Z - 1)));
+		uint cluster = ((slice * CLUSTER_Y + tile.y) * CLUSTER_X + tile.x) * (MAX_LIGHTS_PER_CLUSTER + 1);
+		uint count = clusterData[cluster];
+		for (uint i = 0; i < count; i++) {
+			fragcolor += shade(lights[clusterData[cluster + 1 + i]], fragPos, normal, albedo);
+		}
+	} else {
+		for (int i = 0; i < ubo.lightCount; ++i) {
+			fragcolor += shade(lights[i], fragPos, normal, albedo);
+		}
+	}
    
   outFragcolor = vec4(fragcolor, 1.0);	
 }
\ No newline at end of file
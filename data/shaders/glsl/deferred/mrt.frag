@@ -8,22 +8,48 @@ layout (location = 1) in vec2 inUV;
 layout (location = 2) in vec3 inColor;
 layout (location = 3) in vec3 inWorldPos;
 layout (location = 4) in vec3 inTangent;
+layout (location = 5) in vec4 inCurrentPos;
+layout (location = 6) in vec4 inPrevPos;
 
-layout (location = 0) out vec4 outPosition;
-layout (location = 1) out vec4 outNormal;
-layout (location = 2) out vec4 outAlbedo;
+// Packed G-Buffer: no position attachment (reconstructed from depth), octahedral encoded normals in two channels
+layout (constant_id = 0) const bool PACKED_GBUFFER = false;
 
-void main() 
+layout (location = 0) out vec4 outNormal;
+layout (location = 1) out vec4 outAlbedo;
+layout (location = 2) out vec4 outPosition;
+// Screen space motion since the previous frame in texture coordinates, for temporal anti-aliasing
+layout (location = 3) out vec2 outVelocity;
+
+vec2 octWrap(vec2 v)
+{
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Maps a unit vector onto the octahedron unfolded into [0..1]
+vec2 encodeNormal(vec3 n)
 {
-	outPosition = vec4(inWorldPos, 1.0);
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	n.xy = n.z >= 0.0 ? n.xy : octWrap(n.xy);
+	return n.xy * 0.5 + 0.5;
+}
 
+void main() 
+{
 	// Calculate normal in tangent space
 	vec3 N = normalize(inNormal);
 	vec3 T = normalize(inTangent);
 	vec3 B = cross(N, T);
 	mat3 TBN = mat3(T, B, N);
 	vec3 tnorm = TBN * normalize(texture(samplerNormalMap, inUV).xyz * 2.0 - vec3(1.0));
-	outNormal = vec4(tnorm, 1.0);
 
 	outAlbedo = texture(samplerColor, inUV);
-}
\ No newline at end of file
+
+	if (PACKED_GBUFFER) {
+		outNormal = vec4(encodeNormal(normalize(tnorm)), 0.0, 1.0);
+	} else {
+		outNormal = vec4(tnorm, 1.0);
+		outPosition = vec4(inWorldPos, 1.0);
+	}
+
+	outVelocity = (inCurrentPos.xy / inCurrentPos.w - inPrevPos.xy / inPrevPos.w) * 0.5;
+}
@@ -12,6 +12,9 @@ layout (binding = 0) uniform UBO
 	mat4 model;
 	mat4 view;
 	vec4 instancePos[3];
+	// Unjittered, for the velocity
+	mat4 viewProjection;
+	mat4 prevViewProjection;
 } ubo;
 
 layout (location = 0) out vec3 outNormal;
@@ -19,6 +22,8 @@ layout (location = 1) out vec2 outUV;
 layout (location = 2) out vec3 outColor;
 layout (location = 3) out vec3 outWorldPos;
 layout (location = 4) out vec3 outTangent;
+layout (location = 5) out vec4 outCurrentPos;
+layout (location = 6) out vec4 outPrevPos;
 
 void main() 
 {
@@ -30,6 +35,10 @@ void main()
 
 	// Vertex position in world space
 	outWorldPos = vec3(ubo.model * tmpPos);
+
+	// The scene is static, so only the camera moves the vertex between frames
+	outCurrentPos = ubo.viewProjection * vec4(outWorldPos, 1.0);
+	outPrevPos = ubo.prevViewProjection * vec4(outWorldPos, 1.0);
 	
 	// Normal in world space
 	mat3 mNormal = transpose(inverse(mat3(ubo.model)));
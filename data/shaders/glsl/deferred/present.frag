@@ -0,0 +1,13 @@
+#version 450
+
+// Composition resolved with temporal anti-aliasing
+layout (binding = 0) uniform sampler2D samplerResolved;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+	outFragColor = vec4(texture(samplerResolved, inUV).rgb, 1.0);
+}
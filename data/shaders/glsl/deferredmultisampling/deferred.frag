@@ -1,5 +1,6 @@
 #version 450
 
+// Depth instead of positions for the packed G-Buffer
 layout (binding = 1) uniform sampler2DMS samplerPosition;
 layout (binding = 2) uniform sampler2DMS samplerNormal;
 layout (binding = 3) uniform sampler2DMS samplerAlbedo;
@@ -18,10 +19,12 @@ layout (binding = 4) uniform UBO
 {
 	Light lights[6];
 	vec4 viewPos;
+	mat4 invViewProjection;
 	int debugDisplayTarget;
 } ubo;
 
 layout (constant_id = 0) const int NUM_SAMPLES = 8;
+layout (constant_id = 1) const bool PACKED_GBUFFER = false;
 
 #define NUM_LIGHTS 6
 
@@ -38,6 +41,33 @@ vec4 resolve(sampler2DMS tex, ivec2 uv)
 	return result / float(NUM_SAMPLES);
 }
 
+vec3 decodeNormal(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+vec3 fetchPosition(ivec2 uv, int sampleIndex)
+{
+	if (PACKED_GBUFFER) {
+		vec2 ndc = (vec2(uv) + 0.5) / vec2(textureSize(samplerPosition)) * 2.0 - 1.0;
+		vec4 pos = ubo.invViewProjection * vec4(ndc, texelFetch(samplerPosition, uv, sampleIndex).r, 1.0);
+		return pos.xyz / pos.w;
+	}
+	return texelFetch(samplerPosition, uv, sampleIndex).rgb;
+}
+
+vec3 fetchNormal(ivec2 uv, int sampleIndex)
+{
+	if (PACKED_GBUFFER) {
+		return decodeNormal(texelFetch(samplerNormal, uv, sampleIndex).rg);
+	}
+	return texelFetch(samplerNormal, uv, sampleIndex).rgb;
+}
+
 vec3 calculateLighting(vec3 pos, vec3 normal, vec4 albedo)
 {
 	vec3 result = vec3(0.0);
@@ -83,10 +113,10 @@ void main()
 	if (ubo.debugDisplayTarget > 0) {
 		switch (ubo.debugDisplayTarget) {
 			case 1: 
-				outFragcolor.rgb = texelFetch(samplerPosition, UV, 0).rgb;
+				outFragcolor.rgb = fetchPosition(UV, 0);
 				break;
 			case 2: 
-				outFragcolor.rgb = texelFetch(samplerNormal, UV, 0).rgb;
+				outFragcolor.rgb = fetchNormal(UV, 0);
 				break;
 			case 3: 
 				outFragcolor.rgb = texelFetch(samplerAlbedo, UV, 0).rgb;
@@ -108,8 +138,8 @@ void main()
 	// Calualte lighting for every MSAA sample
 	for (int i = 0; i < NUM_SAMPLES; i++)
 	{ 
-		vec3 pos = texelFetch(samplerPosition, UV, i).rgb;
-		vec3 normal = texelFetch(samplerNormal, UV, i).rgb;
+		vec3 pos = fetchPosition(UV, i);
+		vec3 normal = fetchNormal(UV, i);
 		vec4 albedo = texelFetch(samplerAlbedo, UV, i);
 		fragColor += calculateLighting(pos, normal, albedo);
 	}
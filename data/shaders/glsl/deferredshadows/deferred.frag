@@ -1,44 +1,64 @@
 #version 450
 
+// Depth instead of positions for the packed G-Buffer
 layout (binding = 1) uniform sampler2D samplerposition;
 layout (binding = 2) uniform sampler2D samplerNormal;
 layout (binding = 3) uniform sampler2D samplerAlbedo;
-layout (binding = 5) uniform sampler2DArray samplerShadowMap;
+// Shadow atlas with one tile per light
+layout (binding = 5) uniform sampler2D samplerShadowMap;
 
 layout (location = 0) in vec2 inUV;
 
 layout (location = 0) out vec4 outFragColor;
 
-#define LIGHT_COUNT 3
+#define LIGHT_COUNT 32
 #define SHADOW_FACTOR 0.25
 #define AMBIENT_LIGHT 0.1
 #define USE_PCF
 
+layout (constant_id = 0) const bool PACKED_GBUFFER = false;
+
 struct Light 
 {
 	vec4 position;
 	vec4 target;
 	vec4 color;
 	mat4 viewMatrix;
+	// Offset (xy) and scale (zw) of the light's shadow atlas tile, zero if the light has no tile
+	vec4 shadowRect;
 };
 
 layout (binding = 4) uniform UBO 
 {
 	vec4 viewPos;
 	Light lights[LIGHT_COUNT];
+	mat4 invViewProjection;
 	int useShadows;
 	int debugDisplayTarget;
+	int lightCount;
 } ubo;
 
-float textureProj(vec4 P, float layer, vec2 offset)
+vec3 decodeNormal(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+float textureProj(vec4 P, vec4 rect, vec2 offset)
 {
 	float shadow = 1.0;
 	vec4 shadowCoord = P / P.w;
 	shadowCoord.st = shadowCoord.st * 0.5 + 0.5;
 	
-	if (shadowCoord.z > -1.0 && shadowCoord.z < 1.0) 
+	if (shadowCoord.z > -1.0 && shadowCoord.z < 1.0 && all(greaterThanEqual(shadowCoord.st, vec2(0.0))) && all(lessThanEqual(shadowCoord.st, vec2(1.0)))) 
 	{
-		float dist = texture(samplerShadowMap, vec3(shadowCoord.st + offset, layer)).r;
+		// Map to the light's tile, clamped half a texel inside so filtering never reads from a neighbouring tile
+		vec2 halfTexel = 0.5 / vec2(textureSize(samplerShadowMap, 0));
+		vec2 uv = clamp(rect.xy + (shadowCoord.st + offset) * rect.zw, rect.xy + halfTexel, rect.xy + rect.zw - halfTexel);
+		float dist = texture(samplerShadowMap, uv).r;
 		if (shadowCoord.w > 0.0 && dist < shadowCoord.z) 
 		{
 			shadow = SHADOW_FACTOR;
@@ -47,12 +67,13 @@ float textureProj(vec4 P, float layer, vec2 offset)
 	return shadow;
 }
 
-float filterPCF(vec4 sc, float layer)
+float filterPCF(vec4 sc, vec4 rect)
 {
-	ivec2 texDim = textureSize(samplerShadowMap, 0).xy;
+	// Offsets are in tile texels, tiles have different resolutions
+	vec2 texDim = vec2(textureSize(samplerShadowMap, 0)) * rect.zw;
 	float scale = 1.5;
-	float dx = scale * 1.0 / float(texDim.x);
-	float dy = scale * 1.0 / float(texDim.y);
+	float dx = scale * 1.0 / texDim.x;
+	float dy = scale * 1.0 / texDim.y;
 
 	float shadowFactor = 0.0;
 	int count = 0;
@@ -62,7 +83,7 @@ float filterPCF(vec4 sc, float layer)
 	{
 		for (int y = -range; y <= range; y++)
 		{
-			shadowFactor += textureProj(sc, layer, vec2(dx*x, dy*y));
+			shadowFactor += textureProj(sc, rect, vec2(dx*x, dy*y));
 			count++;
 		}
 	
@@ -70,35 +91,43 @@ float filterPCF(vec4 sc, float layer)
 	return shadowFactor / count;
 }
 
-vec3 shadow(vec3 fragcolor, vec3 fragpos) {
-	for(int i = 0; i < LIGHT_COUNT; ++i)
-	{
-		vec4 shadowClip	= ubo.lights[i].viewMatrix * vec4(fragpos, 1.0);
-
-		float shadowFactor;
-		#ifdef USE_PCF
-			shadowFactor= filterPCF(shadowClip, i);
-		#else
-			shadowFactor = textureProj(shadowClip, i, vec2(0.0));
-		#endif
-
-		fragcolor *= shadowFactor;
+float shadow(int light, vec3 fragpos) {
+	vec4 rect = ubo.lights[light].shadowRect;
+	// Lights that didn't get a tile of the atlas don't cast shadows
+	if (rect.z == 0.0) {
+		return 1.0;
 	}
-	return fragcolor;
+	vec4 shadowClip	= ubo.lights[light].viewMatrix * vec4(fragpos, 1.0);
+	#ifdef USE_PCF
+		return filterPCF(shadowClip, rect);
+	#else
+		return textureProj(shadowClip, rect, vec2(0.0));
+	#endif
 }
 
 void main() 
 {
 	// Get G-Buffer values
-	vec3 fragPos = texture(samplerposition, inUV).rgb;
-	vec3 normal = texture(samplerNormal, inUV).rgb;
+	vec3 fragPos;
+	vec3 normal;
+	if (PACKED_GBUFFER) {
+		vec4 pos = ubo.invViewProjection * vec4(inUV * 2.0 - 1.0, texture(samplerposition, inUV).r, 1.0);
+		fragPos = pos.xyz / pos.w;
+		normal = decodeNormal(texture(samplerNormal, inUV).rg);
+	} else {
+		fragPos = texture(samplerposition, inUV).rgb;
+		normal = texture(samplerNormal, inUV).rgb;
+	}
 	vec4 albedo = texture(samplerAlbedo, inUV);
 
 	// Debug display
 	if (ubo.debugDisplayTarget > 0) {
 		switch (ubo.debugDisplayTarget) {
 			case 1: 
-				outFragColor.rgb = shadow(vec3(1.0), fragPos).rgb;
+				outFragColor.rgb = vec3(1.0);
+				for (int i = 0; i < ubo.lightCount; ++i) {
+					outFragColor.rgb *= shadow(i, fragPos);
+				}
 				break;
 			case 2: 
 				outFragColor.rgb = fragPos;
@@ -122,7 +151,7 @@ void main()
 
 	vec3 N = normalize(normal);
 		
-	for(int i = 0; i < LIGHT_COUNT; ++i)
+	for(int i = 0; i < ubo.lightCount; ++i)
 	{
 		// Vector to light
 		vec3 L = ubo.lights[i].position.xyz - fragPos;
@@ -136,7 +165,7 @@ void main()
 
 		float lightCosInnerAngle = cos(radians(15.0));
 		float lightCosOuterAngle = cos(radians(25.0));
-		float lightRange = 100.0;
+		float lightRange = ubo.lights[i].target.w;
 
 		// Direction vector from source to target
 		vec3 dir = normalize(ubo.lights[i].position.xyz - ubo.lights[i].target.xyz);
@@ -145,6 +174,11 @@ void main()
 		float cosDir = dot(L, dir);
 		float spotEffect = smoothstep(lightCosOuterAngle, lightCosInnerAngle, cosDir);
 		float heightAttenuation = smoothstep(lightRange, 0.0f, dist);
+		float attenuation = spotEffect * heightAttenuation;
+		// Skip the shadow lookup for fragments outside of the light's cone and range
+		if (attenuation <= 0.0) {
+			continue;
+		}
 
 		// Diffuse lighting
 		float NdotL = max(0.0, dot(N, L));
@@ -155,14 +189,11 @@ void main()
 		float NdotR = max(0.0, dot(R, V));
 		vec3 spec = vec3(pow(NdotR, 16.0) * albedo.a * 2.5);
 
-		fragcolor += vec3((diff + spec) * spotEffect * heightAttenuation) * ubo.lights[i].color.rgb * albedo.rgb;
-	}    	
+		// Shadows are applied per light, so a fragment shadowed from one light is still lit by the others
+		float shadowFactor = (ubo.useShadows > 0) ? shadow(i, fragPos) : 1.0;
 
-	// Shadow calculations in a separate pass
-	if (ubo.useShadows > 0)
-	{
-		fragcolor = shadow(fragcolor, fragPos);
-	}
+		fragcolor += vec3((diff + spec) * attenuation * shadowFactor) * ubo.lights[i].color.rgb * albedo.rgb;
+	}    	
 
 	outFragColor = vec4(fragcolor, 1.0);
 }
\ No newline at end of file
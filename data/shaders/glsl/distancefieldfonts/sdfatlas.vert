@@ -0,0 +1,20 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in float inPage;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+} ubo;
+
+layout (location = 0) out vec3 outUV;
+
+void main() 
+{
+	// The page of the runtime generated atlas is the array layer
+	outUV = vec3(inUV, inPage);
+	gl_Position = ubo.projection * ubo.model * vec4(inPos.xyz, 1.0);
+}
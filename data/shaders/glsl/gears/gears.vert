@@ -2,17 +2,28 @@
 
 layout (location = 0) in vec4 inPos;
 layout (location = 1) in vec3 inNormal;
-layout (location = 2) in vec3 inColor;
 
 layout (binding = 0) uniform UBO 
 {
 	mat4 projection;
-	mat4 model;
-	mat4 normal;
 	mat4 view;
-	vec3 lightpos;
+	vec4 lightpos;
+	float time;
 } ubo;
 
+struct GearInstance
+{
+	// xyz = position, w = rotation offset in degrees
+	vec4 pos;
+	// rgb = color, w = rotation speed
+	vec4 color;
+};
+
+layout (std430, binding = 1) readonly buffer Instances
+{
+	GearInstance instances[];
+};
+
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec3 outColor;
 layout (location = 2) out vec3 outEyePos;
@@ -20,12 +31,21 @@ layout (location = 3) out vec3 outLightVec;
 
 void main() 
 {
-	outNormal = normalize(mat3(ubo.normal) * inNormal);
-	outColor = inColor;
-	mat4 modelView = ubo.view * ubo.model;
+	GearInstance instance = instances[gl_InstanceIndex];
+	float angle = radians(instance.color.w * ubo.time + instance.pos.w);
+	float s = sin(angle);
+	float c = cos(angle);
+	mat4 model = mat4(
+		vec4(c, s, 0.0, 0.0),
+		vec4(-s, c, 0.0, 0.0),
+		vec4(0.0, 0.0, 1.0, 0.0),
+		vec4(instance.pos.xyz, 1.0));
+	mat4 modelView = ubo.view * model;
+	outNormal = normalize(mat3(modelView) * inNormal);
+	outColor = instance.color.rgb;
 	vec4 pos = modelView * inPos;	
 	outEyePos = vec3(modelView * pos);
-	vec4 lightPos = vec4(ubo.lightpos, 1.0) * modelView;
+	vec4 lightPos = vec4(ubo.lightpos.xyz, 1.0) * modelView;
 	outLightVec = normalize(lightPos.xyz - outEyePos);
 	gl_Position = ubo.projection * pos;
-}
\ No newline at end of file
+}
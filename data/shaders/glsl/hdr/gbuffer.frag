@@ -18,6 +18,8 @@ layout (location = 0) out vec4 outColor0;
 layout (location = 1) out vec4 outColor1;
 
 layout (constant_id = 0) const int type = 0;
+// Write the linear scene color and leave exposure and bloom to the fused tone mapping pass
+layout (constant_id = 1) const int linearOutput = 0;
 
 #define PI 3.1415926
 #define TwoPI (2.0 * PI)
@@ -85,6 +87,12 @@ void main()
 	}
 
 
+	if (linearOutput == 1) {
+		outColor0 = vec4(color.rgb, 1.0);
+		outColor1 = vec4(0.0);
+		return;
+	}
+
 	// Color with manual exposure into attachment 0
 	outColor0.rgb = vec3(1.0) - exp(-color.rgb * exposure.exposure);
 
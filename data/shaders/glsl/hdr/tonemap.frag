@@ -0,0 +1,27 @@
+#version 450
+
+// Fused bloom composition and tone mapping, replaces the composition and second bloom pass when the scene is rendered with linear output
+
+layout (binding = 0) uniform sampler2D samplerColor;
+// Result of the compute bloom chain (vks::BloomChain)
+layout (binding = 1) uniform sampler2D samplerBloom;
+
+layout (binding = 2) uniform Params {
+	float exposure;
+	float bloomStrength;
+} params;
+
+layout (constant_id = 0) const int applyBloom = 1;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outColor;
+
+void main() 
+{
+	vec3 color = texture(samplerColor, inUV).rgb;
+	if (applyBloom == 1) {
+		color += texture(samplerBloom, inUV).rgb * params.bloomStrength;
+	}
+	outColor = vec4(vec3(1.0) - exp(-color * params.exposure), 1.0);
+}
@@ -19,17 +19,24 @@ layout (binding = 0) uniform UBO
 	vec4 lightPos;
 } ubo;
 
+// Selects the view when each view is rendered in a pass of its own, gl_ViewIndex is 0 outside of multiview render passes
+layout (push_constant) uniform PushConsts {
+	int viewOffset;
+} pushConsts;
+
 void main() 
 {
+	int view = gl_ViewIndex + pushConsts.viewOffset;
+
 	outColor = inColor;
-	outNormal = mat3(ubo.modelview[gl_ViewIndex]) * inNormal;
+	outNormal = mat3(ubo.modelview[view]) * inNormal;
 
 	vec4 pos = vec4(inPos.xyz, 1.0);
-	vec4 worldPos = ubo.modelview[gl_ViewIndex] * pos;
+	vec4 worldPos = ubo.modelview[view] * pos;
 		
-	vec3 lPos = vec3(ubo.modelview[gl_ViewIndex] * ubo.lightPos);
+	vec3 lPos = vec3(ubo.modelview[view] * ubo.lightPos);
 	outLightVec = lPos - worldPos.xyz;
 	outViewVec = -worldPos.xyz;	
 
-	gl_Position = ubo.projection[gl_ViewIndex] * worldPos;
+	gl_Position = ubo.projection[view] * worldPos;
 }
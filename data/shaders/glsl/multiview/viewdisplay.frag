@@ -5,6 +5,7 @@ layout (binding = 1) uniform sampler2DArray samplerView;
 layout (binding = 0) uniform UBO 
 {
 	layout(offset = 272) float distortionAlpha;
+	layout(offset = 280) vec2 uvScale;
 } ubo;
 
 layout (location = 0) in vec2 inUV;
@@ -21,5 +22,6 @@ void main()
 	p2 = (p2 + 1.0) * 0.5;
 
 	bool inside = ((p2.x >= 0.0) && (p2.x <= 1.0) && (p2.y >= 0.0 ) && (p2.y <= 1.0));
-	outColor = inside ? texture(samplerView, vec3(p2, VIEW_LAYER)) : vec4(0.0);
+	// The views are rendered to the top left part of the attachment
+	outColor = inside ? texture(samplerView, vec3(p2 * ubo.uvScale, VIEW_LAYER)) : vec4(0.0);
 }
\ No newline at end of file
@@ -17,7 +17,7 @@ void main()
 		
 	// Slow single pass blur
 	// For demonstration purposes only
-	const float blurSize = 1.0 / 512.0;	
+	const vec2 blurSize = 1.0 / vec2(textureSize(samplerColor, 0));
 
 	outFragColor = vec4(vec3(0.0), 1.);
 
@@ -29,7 +29,7 @@ void main()
 		{
 			for (int y = -3; y <= 3; y++)
 			{
-				reflection += texture(samplerColor, vec2(projCoord.s + x * blurSize, projCoord.t + y * blurSize)) / 49.0;
+				reflection += texture(samplerColor, vec2(projCoord.s + x * blurSize.x, projCoord.t + y * blurSize.y)) / 49.0;
 			}
 		}
 		outFragColor += reflection;
@@ -7,12 +7,14 @@ layout (binding = 0) uniform UBO
 	mat4 projection;
 	mat4 view;
 	mat4 model;
+	mat4 reflectionViewProjection;
 } ubo;
 
 layout (location = 0) out vec4 outPos;
 
 void main() 
 {
-	outPos = ubo.projection * ubo.view * ubo.model * vec4(inPos.xyz, 1.0);
-	gl_Position = outPos;		
+	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(inPos.xyz, 1.0);
+	// The reflection may have been rendered with an older view projection, look it up where it was rendered
+	outPos = ubo.reflectionViewProjection * ubo.model * vec4(inPos.xyz, 1.0);
 }
@@ -0,0 +1,34 @@
+#version 450
+
+// Stores the first KBUFFER_LAYER_COUNT fragments of each pixel in fixed per pixel slots, memory doesn't depend on the scene
+
+#define KBUFFER_LAYER_COUNT 8
+
+layout (early_fragment_tests) in;
+
+layout (set = 0, binding = 2, r32ui) uniform coherent uimage2D fragmentCountImage;
+
+// Layer major, packed color and depth of the fragment
+layout (set = 0, binding = 3) buffer KBufferSBO
+{
+    uvec2 fragments[];
+};
+
+layout(push_constant) uniform PushConsts {
+	mat4 model;
+    vec4 color;
+} pushConsts;
+
+void main()
+{
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    uint layer = imageAtomicAdd(fragmentCountImage, coord, 1);
+
+    // Fragments beyond the layer count are dropped
+    if (layer < KBUFFER_LAYER_COUNT)
+    {
+        ivec2 size = imageSize(fragmentCountImage);
+        uint index = (layer * uint(size.y) + uint(coord.y)) * uint(size.x) + uint(coord.x);
+        fragments[index] = uvec2(packUnorm4x8(pushConsts.color), floatBitsToUint(gl_FragCoord.z));
+    }
+}
@@ -0,0 +1,48 @@
+#version 450
+
+#define KBUFFER_LAYER_COUNT 8
+
+layout (location = 0) out vec4 outFragColor;
+
+layout (set = 0, binding = 0, r32ui) uniform uimage2D fragmentCountImage;
+
+layout (set = 0, binding = 1) buffer KBufferSBO
+{
+    uvec2 fragments[];
+};
+
+void main()
+{
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    ivec2 size = imageSize(fragmentCountImage);
+    uint count = min(imageLoad(fragmentCountImage, coord).r, KBUFFER_LAYER_COUNT);
+
+    uvec2 layers[KBUFFER_LAYER_COUNT];
+    for (uint i = 0; i < count; ++i)
+    {
+        layers[i] = fragments[(i * uint(size.y) + uint(coord.y)) * uint(size.x) + uint(coord.x)];
+    }
+
+    // Do the insertion sort, depth values are positive so their bit patterns sort like the values
+    for (uint i = 1; i < count; ++i)
+    {
+        uvec2 insert = layers[i];
+        uint j = i;
+        while (j > 0 && insert.y > layers[j - 1].y)
+        {
+            layers[j] = layers[j - 1];
+            --j;
+        }
+        layers[j] = insert;
+    }
+
+    // Do blending
+    vec4 color = vec4(0.025, 0.025, 0.025, 1.0f);
+    for (uint i = 0; i < count; ++i)
+    {
+        vec4 fragmentColor = unpackUnorm4x8(layers[i].x);
+        color = mix(color, fragmentColor, fragmentColor.a);
+    }
+
+    outFragColor = color;
+}
@@ -2,6 +2,8 @@
 
 layout (binding = 1) uniform sampler2D sColorMap;
 layout (binding = 2) uniform sampler2D sNormalHeightMap;
+// Height pyramid (vks::DepthPyramid of the height channel), R = maximum and G = minimum height covered by a texel
+layout (binding = 4) uniform sampler2D sHeightPyramid;
 
 layout (binding = 3) uniform UBO 
 {
@@ -9,6 +11,10 @@ layout (binding = 3) uniform UBO
 	float parallaxBias;
 	float numLayers;
 	int mappingMode;
+	// Layer count of the adaptive mode for views along the surface normal
+	float minLayers;
+	int pyramidLevels;
+	int showFetches;
 } ubo;
 
 layout (location = 0) in vec2 inUV;
@@ -18,6 +24,12 @@ layout (location = 3) in vec3 inTangentFragPos;
 
 layout (location = 0) out vec4 outColor;
 
+// Upper bound for the cell steps of the hierarchical traversal
+#define MAX_HIERARCHY_STEPS 128
+
+// Height map fetches of the current fragment for the visualization
+int heightFetches = 0;
+
 vec2 parallaxMapping(vec2 uv, vec3 viewDir) 
 {
 	float height = 1.0 - textureLod(sNormalHeightMap, uv, 0.0).a;
@@ -32,10 +44,12 @@ vec2 steepParallaxMapping(vec2 uv, vec3 viewDir)
 	vec2 deltaUV = viewDir.xy * ubo.heightScale / (viewDir.z * ubo.numLayers);
 	vec2 currUV = uv;
 	float height = 1.0 - textureLod(sNormalHeightMap, currUV, 0.0).a;
+	heightFetches++;
 	for (int i = 0; i < ubo.numLayers; i++) {
 		currLayerDepth += layerDepth;
 		currUV -= deltaUV;
 		height = 1.0 - textureLod(sNormalHeightMap, currUV, 0.0).a;
+		heightFetches++;
 		if (height < currLayerDepth) {
 			break;
 		}
@@ -43,27 +57,99 @@ vec2 steepParallaxMapping(vec2 uv, vec3 viewDir)
 	return currUV;
 }
 
-vec2 parallaxOcclusionMapping(vec2 uv, vec3 viewDir) 
+vec2 parallaxOcclusionMapping(vec2 uv, vec3 viewDir, float numLayers, float lod) 
 {
-	float layerDepth = 1.0 / ubo.numLayers;
+	float layerDepth = 1.0 / numLayers;
 	float currLayerDepth = 0.0;
-	vec2 deltaUV = viewDir.xy * ubo.heightScale / (viewDir.z * ubo.numLayers);
+	vec2 deltaUV = viewDir.xy * ubo.heightScale / (viewDir.z * numLayers);
 	vec2 currUV = uv;
-	float height = 1.0 - textureLod(sNormalHeightMap, currUV, 0.0).a;
-	for (int i = 0; i < ubo.numLayers; i++) {
+	float height = 1.0 - textureLod(sNormalHeightMap, currUV, lod).a;
+	heightFetches++;
+	for (int i = 0; i < numLayers; i++) {
 		currLayerDepth += layerDepth;
 		currUV -= deltaUV;
-		height = 1.0 - textureLod(sNormalHeightMap, currUV, 0.0).a;
+		height = 1.0 - textureLod(sNormalHeightMap, currUV, lod).a;
+		heightFetches++;
 		if (height < currLayerDepth) {
 			break;
 		}
 	}
 	vec2 prevUV = currUV + deltaUV;
 	float nextDepth = height - currLayerDepth;
-	float prevDepth = 1.0 - textureLod(sNormalHeightMap, prevUV, 0.0).a - currLayerDepth + layerDepth;
+	float prevDepth = 1.0 - textureLod(sNormalHeightMap, prevUV, lod).a - currLayerDepth + layerDepth;
+	heightFetches++;
 	return mix(currUV, prevUV, nextDepth / (nextDepth - prevDepth));
 }
 
+// Parallax occlusion mapping with a layer count that follows the view angle and the mip level of the height map: steep views
+// need fewer layers than grazing ones and every mip level halves the height map resolution the march has to resolve
+vec2 adaptiveParallaxOcclusionMapping(vec2 uv, vec3 viewDir)
+{
+	float lod = max(textureQueryLod(sNormalHeightMap, uv).y, 0.0);
+	float numLayers = mix(ubo.numLayers, ubo.minLayers, abs(viewDir.z));
+	numLayers = max(floor(numLayers / exp2(lod)), ubo.minLayers);
+	return parallaxOcclusionMapping(uv, viewDir, numLayers, lod);
+}
+
+// Relief mapping accelerated by the maximum heights of the height pyramid: the ray (with depth = 1 - height, as in the layer march)
+// skips every cell whose highest texel it passes above, descends into a cell where it drops below that height and goes back up a
+// level after leaving a cell. Flat or low areas are crossed in a few large steps instead of one fetch per layer.
+vec2 hierarchicalReliefMapping(vec2 uv, vec3 viewDir)
+{
+	vec2 deltaUV = viewDir.xy * ubo.heightScale / viewDir.z;
+	vec2 rayDir = -deltaUV;
+	vec2 baseSize = vec2(textureSize(sHeightPyramid, 0));
+	// Ray distance covering a single texel of the first level
+	float texelDistance = 1.0 / (max(baseSize.x, baseSize.y) * max(max(abs(deltaUV.x), abs(deltaUV.y)), 1.0e-6));
+
+	int topLevel = ubo.pyramidLevels - 1;
+	int level = topLevel;
+	float t = 0.0;
+	for (int i = 0; (i < MAX_HIERARCHY_STEPS) && (level >= 0); i++) {
+		vec2 currUV = uv + rayDir * t;
+		float cellDepth = 1.0 - textureLod(sHeightPyramid, currUV, float(level)).r;
+		heightFetches++;
+		if (t >= cellDepth) {
+			// Below the highest texel of the cell, refine
+			level--;
+			continue;
+		}
+		// Distance to the border of the cell in the direction of the ray
+		vec2 cellCount = vec2(textureSize(sHeightPyramid, level));
+		vec2 border = (floor(currUV * cellCount) + step(0.0, rayDir)) / cellCount;
+		vec2 borderDistance = (border - currUV) / rayDir;
+		float exitDistance = t + min(borderDistance.x, borderDistance.y);
+		if (cellDepth < exitDistance) {
+			// Reaches the highest texel's depth inside of the cell
+			t = cellDepth;
+			level--;
+		} else {
+			// Step over the border and continue on the next coarser level
+			t = exitDistance + 0.25 * texelDistance;
+			level = min(level + 1, topLevel);
+		}
+		if (t >= 1.0) {
+			t = 1.0;
+			break;
+		}
+	}
+
+	// The traversal stops on the texel that is hit, refine against the filtered height map
+	float t0 = max(t - 2.0 * texelDistance, 0.0);
+	float t1 = t;
+	for (int i = 0; i < 5; i++) {
+		float tMid = 0.5 * (t0 + t1);
+		float depth = 1.0 - textureLod(sNormalHeightMap, uv + rayDir * tMid, 0.0).a;
+		heightFetches++;
+		if (tMid < depth) {
+			t0 = tMid;
+		} else {
+			t1 = tMid;
+		}
+	}
+	return uv + rayDir * t1;
+}
+
 void main(void) 
 {
 	vec3 V = normalize(inTangentViewPos - inTangentFragPos);
@@ -81,7 +167,13 @@ void main(void)
 				uv = steepParallaxMapping(inUV, V);
 				break;
 			case 4:
-				uv = parallaxOcclusionMapping(inUV, V);
+				uv = parallaxOcclusionMapping(inUV, V, ubo.numLayers, 0.0);
+				break;
+			case 5:
+				uv = adaptiveParallaxOcclusionMapping(inUV, V);
+				break;
+			case 6:
+				uv = hierarchicalReliefMapping(inUV, V);
 				break;
 		}
 
@@ -105,5 +197,11 @@ void main(void)
 		vec3 specular = vec3(0.15) * pow(max(dot(N, H), 0.0), 32.0);
 
 		outColor = vec4(ambient + diffuse + specular, 1.0f);
+
+		if (ubo.showFetches != 0) {
+			// Green for no fetches to red for 64 or more
+			float fetches = clamp(float(heightFetches) / 64.0, 0.0, 1.0);
+			outColor.rgb = mix(vec3(0.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), fetches) * (0.5 + 0.5 * max(dot(L, N), 0.0));
+		}
 	}	
 }
@@ -0,0 +1,133 @@
+#version 450
+
+// Half precision variant of pbr.frag, selected with --halfprecision if the device supports shaderFloat16
+// Positions and the light accumulation stay in full precision, the BRDF is evaluated in half precision
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require
+
+layout (location = 0) in vec3 inWorldPos;
+layout (location = 1) in vec3 inNormal;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec3 camPos;
+} ubo;
+
+layout (binding = 1) uniform UBOShared {
+	vec4 lights[4];
+} uboParams;
+
+layout (location = 0) out vec4 outColor;
+
+layout(push_constant) uniform PushConsts {
+	layout(offset = 12) float roughness;
+	layout(offset = 16) float metallic;
+	layout(offset = 20) float r;
+	layout(offset = 24) float g;
+	layout(offset = 28) float b;
+} material;
+
+const float16_t PI = 3.14159265359hf;
+// Largest finite half precision value
+const float16_t HALF_MAX = 65504.0hf;
+// Lower roughnesses make the normal distribution overflow in half precision
+const float16_t MIN_ROUGHNESS = 0.089hf;
+
+//#define ROUGHNESS_PATTERN 1
+
+f16vec3 materialcolor()
+{
+	return f16vec3(material.r, material.g, material.b);
+}
+
+// Normal Distribution function --------------------------------------
+// 1 - dotNH^2 is taken from the cross product of N and H, which keeps its precision for dotNH close to 1
+float16_t D_GGX(float16_t dotNH, f16vec3 N, f16vec3 H, float16_t roughness)
+{
+	f16vec3 NxH = cross(N, H);
+	float16_t alpha = roughness * roughness;
+	float16_t a = dotNH * alpha;
+	float16_t k = alpha / (dot(NxH, NxH) + a * a);
+	return min(k * k * (1.0hf / PI), HALF_MAX);
+}
+
+// Visibility function --------------------------------------
+// Geometric shadowing divided by 4 * dotNL * dotNV, which avoids the division by small values
+float16_t V_SchlicksmithGGX(float16_t dotNL, float16_t dotNV, float16_t roughness)
+{
+	float16_t r = (roughness + 1.0hf);
+	float16_t k = (r*r) / 8.0hf;
+	float16_t GL = dotNL * (1.0hf - k) + k;
+	float16_t GV = dotNV * (1.0hf - k) + k;
+	return 0.25hf / (GL * GV);
+}
+
+// Fresnel function ----------------------------------------------------
+f16vec3 F_Schlick(float16_t cosTheta, float16_t metallic)
+{
+	f16vec3 F0 = mix(f16vec3(0.04hf), materialcolor(), metallic); // * material.specular
+	float16_t f = 1.0hf - cosTheta;
+	float16_t f2 = f * f;
+	return F0 + (1.0hf - F0) * (f2 * f2 * f); 
+}
+
+// Specular BRDF composition --------------------------------------------
+
+f16vec3 BRDF(f16vec3 L, f16vec3 V, f16vec3 N, float16_t metallic, float16_t roughness)
+{
+	// Precalculate vectors and dot products	
+	f16vec3 H = normalize (V + L);
+	float16_t dotNV = clamp(dot(N, V), 0.0hf, 1.0hf);
+	float16_t dotNL = clamp(dot(N, L), 0.0hf, 1.0hf);
+	float16_t dotNH = clamp(dot(N, H), 0.0hf, 1.0hf);
+
+	f16vec3 color = f16vec3(0.0hf);
+
+	if (dotNL > 0.0hf)
+	{
+		float16_t rroughness = max(0.05hf, roughness);
+		// D = Normal distribution (Distribution of the microfacets)
+		float16_t D = D_GGX(dotNH, N, H, max(roughness, MIN_ROUGHNESS)); 
+		// Vis = Geometric shadowing term (Microfacets shadowing) / (4 * dotNL * dotNV)
+		float16_t Vis = V_SchlicksmithGGX(dotNL, dotNV, rroughness);
+		// F = Fresnel factor (Reflectance depending on angle of incidence)
+		f16vec3 F = F_Schlick(dotNV, metallic);
+
+		// Light color fixed
+		color = min(D * Vis, HALF_MAX) * F * dotNL;
+	}
+
+	return color;
+}
+
+// ----------------------------------------------------------------------------
+void main()
+{		  
+	f16vec3 N = f16vec3(normalize(inNormal));
+	f16vec3 V = f16vec3(normalize(ubo.camPos - inWorldPos));
+
+	float roughness = material.roughness;
+
+	// Add striped pattern to roughness based on vertex position
+#ifdef ROUGHNESS_PATTERN
+	roughness = max(roughness, step(fract(inWorldPos.y * 2.02), 0.5));
+#endif
+
+	// Specular contribution, accumulated in full precision as highlights of several lights can exceed the half precision range
+	vec3 Lo = vec3(0.0);
+	for (int i = 0; i < uboParams.lights.length(); i++) {
+		f16vec3 L = f16vec3(normalize(uboParams.lights[i].xyz - inWorldPos));
+		Lo += vec3(BRDF(L, V, N, float16_t(material.metallic), float16_t(roughness)));
+	};
+
+	// Combine with ambient
+	vec3 color = vec3(materialcolor()) * 0.02;
+	color += Lo;
+
+	// Gamma correct
+	color = pow(color, vec3(0.4545));
+
+	outColor = vec4(color, 1.0);
+}
@@ -0,0 +1,28 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec3 camPos;
+} ubo;
+
+// Emissive sphere, xyz is its position and w its scale
+layout(push_constant) uniform PushConsts {
+	vec4 positionScale;
+	vec4 color;
+} emitter;
+
+out gl_PerVertex 
+{
+	vec4 gl_Position;
+};
+
+void main() 
+{
+	vec3 worldPos = inPos * emitter.positionScale.w + emitter.positionScale.xyz;
+	gl_Position = ubo.projection * ubo.view * vec4(worldPos, 1.0);
+}
@@ -15,6 +15,11 @@ layout (binding = 1) uniform UBOParams {
 	vec4 lights[4];
 	float exposure;
 	float gamma;
+	// 1 to evaluate shCoefficients instead of sampling the irradiance cube
+	uint irradianceSH;
+	// Highest mip level of the prefiltered cube, sampled for a roughness of 1
+	float maxReflectionLod;
+	vec4 shCoefficients[9];
 } uboParams;
 
 layout(push_constant) uniform PushConsts {
@@ -76,10 +81,24 @@ vec3 F_SchlickR(float cosTheta, vec3 F0, float roughness)
 	return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
 }
 
+// Irradiance (divided by PI) from the L2 spherical harmonics coefficients of vks::IBLGenerator::generateIrradianceSH()
+vec3 evaluateSH(vec3 n)
+{
+	vec3 result = uboParams.shCoefficients[0].rgb * 0.282095;
+	result += uboParams.shCoefficients[1].rgb * 0.488603 * n.y;
+	result += uboParams.shCoefficients[2].rgb * 0.488603 * n.z;
+	result += uboParams.shCoefficients[3].rgb * 0.488603 * n.x;
+	result += uboParams.shCoefficients[4].rgb * 1.092548 * n.x * n.y;
+	result += uboParams.shCoefficients[5].rgb * 1.092548 * n.y * n.z;
+	result += uboParams.shCoefficients[6].rgb * 0.315392 * (3.0 * n.z * n.z - 1.0);
+	result += uboParams.shCoefficients[7].rgb * 1.092548 * n.x * n.z;
+	result += uboParams.shCoefficients[8].rgb * 0.546274 * (n.x * n.x - n.y * n.y);
+	return max(result, vec3(0.0));
+}
+
 vec3 prefilteredReflection(vec3 R, float roughness)
 {
-	const float MAX_REFLECTION_LOD = 9.0; // todo: param/const
-	float lod = roughness * MAX_REFLECTION_LOD;
+	float lod = roughness * uboParams.maxReflectionLod;
 	float lodf = floor(lod);
 	float lodc = ceil(lod);
 	vec3 a = textureLod(prefilteredMap, R, lodf).rgb;
@@ -135,7 +154,7 @@ void main()
 	
 	vec2 brdf = texture(samplerBRDFLUT, vec2(max(dot(N, V), 0.0), roughness)).rg;
 	vec3 reflection = prefilteredReflection(R, roughness).rgb;	
-	vec3 irradiance = texture(samplerIrradiance, N).rgb;
+	vec3 irradiance = (uboParams.irradianceSH == 1) ? evaluateSH(N) : texture(samplerIrradiance, N).rgb;
 
 	// Diffuse based on irradiance
 	vec3 diffuse = irradiance * ALBEDO;	
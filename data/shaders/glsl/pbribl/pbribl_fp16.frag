@@ -0,0 +1,199 @@
+#version 450
+
+// Half precision variant of pbribl.frag, selected with --halfprecision if the device supports shaderFloat16
+// Positions, image based lighting (HDR values) and tone mapping stay in full precision, the BRDF of the lights is evaluated in half precision
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require
+
+layout (location = 0) in vec3 inWorldPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+
+layout (binding = 0) uniform UBO {
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec3 camPos;
+} ubo;
+
+layout (binding = 1) uniform UBOParams {
+	vec4 lights[4];
+	float exposure;
+	float gamma;
+	// 1 to evaluate shCoefficients instead of sampling the irradiance cube
+	uint irradianceSH;
+	// Highest mip level of the prefiltered cube, sampled for a roughness of 1
+	float maxReflectionLod;
+	vec4 shCoefficients[9];
+} uboParams;
+
+layout(push_constant) uniform PushConsts {
+	layout(offset = 12) float roughness;
+	layout(offset = 16) float metallic;
+	layout(offset = 20) float specular;
+	layout(offset = 24) float r;
+	layout(offset = 28) float g;
+	layout(offset = 32) float b;
+} material;
+
+layout (binding = 2) uniform samplerCube samplerIrradiance;
+layout (binding = 3) uniform sampler2D samplerBRDFLUT;
+layout (binding = 4) uniform samplerCube prefilteredMap;
+
+layout (location = 0) out vec4 outColor;
+
+#define PI 3.1415926535897932384626433832795
+#define ALBEDO vec3(material.r, material.g, material.b)
+
+// From http://filmicgames.com/archives/75
+vec3 Uncharted2Tonemap(vec3 x)
+{
+	float A = 0.15;
+	float B = 0.50;
+	float C = 0.10;
+	float D = 0.20;
+	float E = 0.02;
+	float F = 0.30;
+	return ((x*(A*x+C*B)+D*E)/(x*(A*x+B)+D*F))-E/F;
+}
+
+// Largest finite half precision value
+const float16_t HALF_MAX = 65504.0hf;
+// Lower roughnesses make the normal distribution overflow in half precision
+const float16_t MIN_ROUGHNESS = 0.089hf;
+
+// Normal Distribution function --------------------------------------
+// 1 - dotNH^2 is taken from the cross product of N and H, which keeps its precision for dotNH close to 1
+float16_t D_GGX(float16_t dotNH, f16vec3 N, f16vec3 H, float16_t roughness)
+{
+	f16vec3 NxH = cross(N, H);
+	float16_t alpha = roughness * roughness;
+	float16_t a = dotNH * alpha;
+	float16_t k = alpha / (dot(NxH, NxH) + a * a);
+	return min(k * k * float16_t(1.0 / PI), HALF_MAX);
+}
+
+// Visibility function --------------------------------------
+// Geometric shadowing divided by 4 * dotNL * dotNV, which avoids the division by small values
+float16_t V_SchlicksmithGGX(float16_t dotNL, float16_t dotNV, float16_t roughness)
+{
+	float16_t r = (roughness + 1.0hf);
+	float16_t k = (r*r) / 8.0hf;
+	float16_t GL = dotNL * (1.0hf - k) + k;
+	float16_t GV = dotNV * (1.0hf - k) + k;
+	return 0.25hf / (GL * GV);
+}
+
+// Fresnel function ----------------------------------------------------
+f16vec3 F_Schlick(float16_t cosTheta, f16vec3 F0)
+{
+	float16_t f = 1.0hf - cosTheta;
+	float16_t f2 = f * f;
+	return F0 + (1.0hf - F0) * (f2 * f2 * f);
+}
+// Fresnel with roughness for the image based lighting, in full precision
+vec3 F_SchlickR(float cosTheta, vec3 F0, float roughness)
+{
+	return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+// Irradiance (divided by PI) from the L2 spherical harmonics coefficients of vks::IBLGenerator::generateIrradianceSH()
+vec3 evaluateSH(vec3 n)
+{
+	vec3 result = uboParams.shCoefficients[0].rgb * 0.282095;
+	result += uboParams.shCoefficients[1].rgb * 0.488603 * n.y;
+	result += uboParams.shCoefficients[2].rgb * 0.488603 * n.z;
+	result += uboParams.shCoefficients[3].rgb * 0.488603 * n.x;
+	result += uboParams.shCoefficients[4].rgb * 1.092548 * n.x * n.y;
+	result += uboParams.shCoefficients[5].rgb * 1.092548 * n.y * n.z;
+	result += uboParams.shCoefficients[6].rgb * 0.315392 * (3.0 * n.z * n.z - 1.0);
+	result += uboParams.shCoefficients[7].rgb * 1.092548 * n.x * n.z;
+	result += uboParams.shCoefficients[8].rgb * 0.546274 * (n.x * n.x - n.y * n.y);
+	return max(result, vec3(0.0));
+}
+
+vec3 prefilteredReflection(vec3 R, float roughness)
+{
+	float lod = roughness * uboParams.maxReflectionLod;
+	float lodf = floor(lod);
+	float lodc = ceil(lod);
+	vec3 a = textureLod(prefilteredMap, R, lodf).rgb;
+	vec3 b = textureLod(prefilteredMap, R, lodc).rgb;
+	return mix(a, b, lod - lodf);
+}
+
+f16vec3 specularContribution(f16vec3 L, f16vec3 V, f16vec3 N, f16vec3 F0, f16vec3 albedo, float16_t metallic, float16_t roughness)
+{
+	// Precalculate vectors and dot products	
+	f16vec3 H = normalize (V + L);
+	float16_t dotNH = clamp(dot(N, H), 0.0hf, 1.0hf);
+	float16_t dotNV = clamp(dot(N, V), 0.0hf, 1.0hf);
+	float16_t dotNL = clamp(dot(N, L), 0.0hf, 1.0hf);
+
+	f16vec3 color = f16vec3(0.0hf);
+
+	if (dotNL > 0.0hf) {
+		// D = Normal distribution (Distribution of the microfacets)
+		float16_t D = D_GGX(dotNH, N, H, max(roughness, MIN_ROUGHNESS)); 
+		// Vis = Geometric shadowing term (Microfacets shadowing) / (4 * dotNL * dotNV)
+		float16_t Vis = V_SchlicksmithGGX(dotNL, dotNV, roughness);
+		// F = Fresnel factor (Reflectance depending on angle of incidence)
+		f16vec3 F = F_Schlick(dotNV, F0);		
+		f16vec3 spec = min(D * Vis, HALF_MAX) * F;		
+		f16vec3 kD = (f16vec3(1.0hf) - F) * (1.0hf - metallic);			
+		// Light color fixed
+		color = (kD * albedo * float16_t(1.0 / PI) + spec) * dotNL;
+	}
+
+	return color;
+}
+
+void main()
+{		
+	vec3 N = normalize(inNormal);
+	vec3 V = normalize(ubo.camPos - inWorldPos);
+	vec3 R = reflect(-V, N); 
+
+	float metallic = material.metallic;
+	float roughness = material.roughness;
+
+	vec3 F0 = vec3(0.04); 
+	F0 = mix(F0, ALBEDO, metallic);
+
+	// Contributions of the lights, accumulated in full precision as highlights of several lights can exceed the half precision range
+	f16vec3 halfN = f16vec3(N);
+	f16vec3 halfV = f16vec3(V);
+	f16vec3 halfF0 = f16vec3(F0);
+	f16vec3 halfAlbedo = f16vec3(ALBEDO);
+	vec3 Lo = vec3(0.0);
+	for(int i = 0; i < uboParams.lights[i].length(); i++) {
+		f16vec3 L = f16vec3(normalize(uboParams.lights[i].xyz - inWorldPos));
+		Lo += vec3(specularContribution(L, halfV, halfN, halfF0, halfAlbedo, float16_t(metallic), float16_t(roughness)));
+	}   
+	
+	vec2 brdf = texture(samplerBRDFLUT, vec2(max(dot(N, V), 0.0), roughness)).rg;
+	vec3 reflection = prefilteredReflection(R, roughness).rgb;	
+	vec3 irradiance = (uboParams.irradianceSH == 1) ? evaluateSH(N) : texture(samplerIrradiance, N).rgb;
+
+	// Diffuse based on irradiance
+	vec3 diffuse = irradiance * ALBEDO;	
+
+	vec3 F = F_SchlickR(max(dot(N, V), 0.0), F0, roughness);
+
+	// Specular reflectance
+	vec3 specular = reflection * (F * brdf.x + brdf.y);
+
+	// Ambient part
+	vec3 kD = 1.0 - F;
+	kD *= 1.0 - metallic;	  
+	vec3 ambient = (kD * diffuse + specular);
+	
+	vec3 color = ambient + Lo;
+
+	// Tone mapping
+	color = Uncharted2Tonemap(color * uboParams.exposure);
+	color = color * (1.0f / Uncharted2Tonemap(vec3(11.2f)));	
+	// Gamma correction
+	color = pow(color, vec3(1.0f / uboParams.gamma));
+
+	outColor = vec4(color, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#version 450
+
+layout (binding = 1) uniform samplerCube samplerEnv;
+
+layout (location = 0) in vec3 inUVW;
+
+layout (location = 0) out vec4 outColor;
+
+layout(push_constant) uniform PushConsts {
+	vec4 positionScale;
+	vec4 color;
+} object;
+
+void main() 
+{
+	// The capture is filtered for lighting, so it stores linear radiance without tone mapping
+	vec3 color = (object.color.a > 0.0) ? object.color.rgb : textureLod(samplerEnv, inUVW, 0.0).rgb;
+	outColor = vec4(color, 1.0);
+}
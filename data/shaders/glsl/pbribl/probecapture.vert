@@ -0,0 +1,34 @@
+#version 450
+
+#extension GL_EXT_multiview : enable
+
+// Renders the scene into all faces of an environment probe's cube map at once, see vks::EnvironmentProbes
+
+layout (location = 0) in vec3 inPos;
+
+// One projection and view per cube map face, the view index is the face (and layer) rendered to
+layout (binding = 0) uniform UBO 
+{
+	mat4 viewProjection[6];
+	vec4 position;
+} ubo;
+
+// Emissive sphere or the sky box (color.a = 0) centered on the probe, xyz is the position and w the scale
+layout(push_constant) uniform PushConsts {
+	vec4 positionScale;
+	vec4 color;
+} object;
+
+layout (location = 0) out vec3 outUVW;
+
+out gl_PerVertex 
+{
+	vec4 gl_Position;
+};
+
+void main() 
+{
+	outUVW = inPos;
+	vec3 worldPos = inPos * object.positionScale.w + object.positionScale.xyz;
+	gl_Position = ubo.viewProjection[gl_ViewIndex] * vec4(worldPos, 1.0);
+}
@@ -0,0 +1,55 @@
+#version 450
+
+// Draw path of vkglTF::Model::draw: one draw per primitive and placement, the node matrix is pushed by the model (see vkglTF::Model::PushDescriptors)
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec4 inColor;
+
+layout (set = 0, binding = 0) uniform UBO
+{
+	mat4 projection;
+	mat4 view;
+	mat4 invProjection;
+	vec4 viewPos;
+	ivec2 renderExtent;
+	uint lightCount;
+	uint clustered;
+	float zNear;
+	float zFar;
+} ubo;
+
+// Placement matrices of all archetypes
+layout (set = 0, binding = 3) readonly buffer Placements
+{
+	mat4 placements[];
+};
+
+layout (push_constant) uniform PushConsts
+{
+	uint placement;
+	layout (offset = 16) mat4 nodeMatrix;
+	uint nodeIndex;
+} pushConsts;
+
+layout (location = 0) out vec3 outWorldPos;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec2 outUV;
+layout (location = 3) out vec4 outColor;
+layout (location = 4) out float outViewDepth;
+layout (location = 5) flat out uint outPlacement;
+
+void main()
+{
+	mat4 model = placements[pushConsts.placement] * pushConsts.nodeMatrix;
+	vec4 worldPos = model * vec4(inPos, 1.0);
+	outWorldPos = worldPos.xyz;
+	outNormal = mat3(model) * inNormal;
+	outUV = inUV;
+	outColor = inColor;
+	vec4 viewPos = ubo.view * worldPos;
+	outViewDepth = -viewPos.z;
+	outPlacement = pushConsts.placement;
+	gl_Position = ubo.projection * viewPos;
+}
@@ -0,0 +1,123 @@
+#version 450
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Bindless materials of the multi draw indirect path (see vkglTF::Model::Bindless), lit by all lights or the lights of the fragment's cluster
+
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 128
+
+struct Light {
+	// xyz: position, w: range
+	vec4 position;
+	vec4 color;
+};
+
+struct Material {
+	vec4 baseColorFactor;
+	float metallicFactor;
+	float roughnessFactor;
+	float alphaCutoff;
+	uint alphaMode;
+	int baseColorTexture;
+	int metallicRoughnessTexture;
+	int normalTexture;
+	int occlusionTexture;
+	int emissiveTexture;
+	int specularGlossinessTexture;
+	int diffuseTexture;
+	int padding;
+};
+
+layout (set = 0, binding = 0) uniform UBO
+{
+	mat4 projection;
+	mat4 view;
+	mat4 invProjection;
+	vec4 viewPos;
+	ivec2 renderExtent;
+	uint lightCount;
+	uint clustered;
+	float zNear;
+	float zFar;
+} ubo;
+
+layout (set = 0, binding = 1, std430) readonly buffer Lights
+{
+	Light lights[];
+};
+
+// Per cluster the number of lights followed by MAX_LIGHTS_PER_CLUSTER light indices
+layout (set = 0, binding = 2, std430) readonly buffer Clusters
+{
+	uint clusterData[];
+};
+
+layout (set = 2, binding = 0) readonly buffer Materials
+{
+	Material materials[];
+};
+
+// The material index is the same for all invocations of a draw, so dynamic indexing is enough
+layout (set = 2, binding = 1) uniform sampler2D textures[];
+
+layout (location = 0) in vec3 inWorldPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec4 inColor;
+layout (location = 4) in float inViewDepth;
+layout (location = 5) flat in uint inMaterial;
+layout (location = 6) flat in uint inPlacement;
+
+layout (location = 0) out vec4 outFragColor;
+
+#define ALPHAMODE_MASK 1
+
+// Per placement color variation, so copies of the same archetype can be told apart
+vec3 placementTint(uint placement)
+{
+	uint h = placement * 747796405u + 2891336453u;
+	h = ((h >> ((h >> 28u) + 4u)) ^ h) * 277803737u;
+	h = (h >> 22u) ^ h;
+	return mix(vec3(1.0), vec3(h & 0xffu, (h >> 8u) & 0xffu, (h >> 16u) & 0xffu) / 255.0, 0.35);
+}
+
+vec3 shadeLight(Light light, vec3 N)
+{
+	vec3 L = light.position.xyz - inWorldPos;
+	float dist = length(L);
+	float falloff = clamp(1.0 - dist / light.position.w, 0.0, 1.0);
+	return light.color.rgb * max(dot(N, L / max(dist, 0.0001)), 0.0) * falloff * falloff;
+}
+
+void main()
+{
+	Material material = materials[inMaterial];
+	vec4 color = inColor;
+	if (material.baseColorTexture >= 0) {
+		color *= texture(textures[material.baseColorTexture], inUV);
+	}
+	if ((material.alphaMode == ALPHAMODE_MASK) && (color.a < material.alphaCutoff)) {
+		discard;
+	}
+	color.rgb *= placementTint(inPlacement);
+
+	vec3 N = normalize(inNormal);
+	vec3 lighting = vec3(0.15);
+	if (ubo.clustered == 1) {
+		uvec2 tile = min(uvec2(gl_FragCoord.xy * vec2(CLUSTER_X, CLUSTER_Y) / vec2(ubo.renderExtent)), uvec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+		uint slice = uint(clamp(log(inViewDepth / ubo.zNear) / log(ubo.zFar / ubo.zNear) * float(CLUSTER_Z), 0.0, float(CLUSTER_Z - 1)));
+		uint cluster = ((slice * CLUSTER_Y + tile.y) * CLUSTER_X + tile.x) * (MAX_LIGHTS_PER_CLUSTER + 1);
+		uint count = clusterData[cluster];
+		for (uint i = 0; i < count; i++) {
+			lighting += shadeLight(lights[clusterData[cluster + 1 + i]], N);
+		}
+	} else {
+		for (uint i = 0; i < ubo.lightCount; i++) {
+			lighting += shadeLight(lights[i], N);
+		}
+	}
+	outFragColor = vec4(color.rgb * lighting, 1.0);
+}
@@ -0,0 +1,63 @@
+#version 450
+
+// Multi draw indirect path: the transform and material of a draw are looked up with gl_InstanceIndex (see vkglTF::Model::IndirectDraw)
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+layout (location = 3) in vec4 inColor;
+
+layout (set = 0, binding = 0) uniform UBO
+{
+	mat4 projection;
+	mat4 view;
+	mat4 invProjection;
+	vec4 viewPos;
+	ivec2 renderExtent;
+	uint lightCount;
+	uint clustered;
+	float zNear;
+	float zFar;
+} ubo;
+
+layout (set = 1, binding = 0) readonly buffer Transforms
+{
+	mat4 transforms[];
+};
+
+// x = transform index, y = material index, z = first lod, w = lod count
+layout (set = 1, binding = 1) readonly buffer DrawData
+{
+	uvec4 drawData[];
+};
+
+// Placements of the archetype start at firstPlacement, every placement has the same number of transforms
+layout (push_constant) uniform PushConsts
+{
+	uint firstPlacement;
+	uint transformsPerPlacement;
+} pushConsts;
+
+layout (location = 0) out vec3 outWorldPos;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec2 outUV;
+layout (location = 3) out vec4 outColor;
+layout (location = 4) out float outViewDepth;
+layout (location = 5) flat out uint outMaterial;
+layout (location = 6) flat out uint outPlacement;
+
+void main()
+{
+	uvec4 draw = drawData[gl_InstanceIndex];
+	mat4 model = transforms[draw.x];
+	vec4 worldPos = model * vec4(inPos, 1.0);
+	outWorldPos = worldPos.xyz;
+	outNormal = mat3(model) * inNormal;
+	outUV = inUV;
+	outColor = inColor;
+	vec4 viewPos = ubo.view * worldPos;
+	outViewDepth = -viewPos.z;
+	outMaterial = draw.y;
+	outPlacement = pushConsts.firstPlacement + draw.x / pushConsts.transformsPerPlacement;
+	gl_Position = ubo.projection * viewPos;
+}
@@ -7,12 +7,14 @@ layout (location = 1) in vec2 inUV;
 #define SHADOW_MAP_CASCADE_COUNT 4
 
 layout(push_constant) uniform PushConsts {
+	// w: weight of the dynamic caster offset
 	vec4 position;
 	uint cascadeIndex;
 } pushConsts;
 
 layout (binding = 0) uniform UBO {
 	mat4[SHADOW_MAP_CASCADE_COUNT] cascadeViewProjMat;
+	vec4 dynamicCasterOffset;
 } ubo;
 
 layout (location = 0) out vec2 outUV;
@@ -24,6 +26,6 @@ out gl_PerVertex {
 void main()
 {
 	outUV = inUV;
-	vec3 pos = inPos + pushConsts.position.xyz;
+	vec3 pos = inPos + pushConsts.position.xyz + ubo.dynamicCasterOffset.xyz * pushConsts.position.w;
 	gl_Position =  ubo.cascadeViewProjMat[pushConsts.cascadeIndex] * vec4(pos, 1.0);
 }
\ No newline at end of file
@@ -9,6 +9,7 @@ layout (binding = 0) uniform UBO {
 	mat4 projection;
 	mat4 view;
 	mat4 model;
+	vec4 dynamicCasterOffset;
 } ubo;
 
 layout (location = 0) out vec3 outNormal;
@@ -18,6 +19,7 @@ layout (location = 3) out vec3 outPos;
 layout (location = 4) out vec2 outUV;
 
 layout(push_constant) uniform PushConsts {
+	// w: weight of the dynamic caster offset
 	vec4 position;
 	uint cascadeIndex;
 } pushConsts;
@@ -31,7 +33,7 @@ void main()
 	outColor = inColor;
 	outNormal = inNormal;
 	outUV = inUV;
-	vec3 pos = inPos + pushConsts.position.xyz;
+	vec3 pos = inPos + pushConsts.position.xyz + ubo.dynamicCasterOffset.xyz * pushConsts.position.w;
 	outPos = pos;
 	outViewPos = (ubo.view * vec4(pos.xyz, 1.0)).xyz;
 	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(pos.xyz, 1.0);
@@ -0,0 +1,35 @@
+#version 450
+
+#extension GL_EXT_multiview : enable
+
+layout (location = 0) in vec3 inPos;
+
+layout (location = 0) out vec4 outPos;
+layout (location = 1) out vec3 outLightPos;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view; 
+	mat4 model;
+	vec4 lightPos;
+} ubo;
+
+// One view matrix per cube map face, the view index is the face (and layer) rendered to
+layout (binding = 2) uniform UBOFaceViews
+{
+	mat4 faceViews[6];
+} uboFaceViews;
+ 
+out gl_PerVertex 
+{
+	vec4 gl_Position;
+};
+ 
+void main()
+{
+	gl_Position = ubo.projection * uboFaceViews.faceViews[gl_ViewIndex] * ubo.model * vec4(inPos, 1.0);
+
+	outPos = vec4(inPos, 1.0);	
+	outLightPos = ubo.lightPos.xyz; 
+}
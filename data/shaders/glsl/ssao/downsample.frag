@@ -0,0 +1,37 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D samplerPositionDepth;
+layout (binding = 1) uniform sampler2D samplerNormal;
+
+// Ratio of the G-Buffer resolution to the target resolution
+layout (constant_id = 0) const int DOWNSAMPLE_FACTOR = 2;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outPosition;
+layout (location = 1) out vec4 outNormal;
+
+void main() 
+{
+	// One texel of the footprint is picked instead of averaging them, so position and normal belong to the same surface
+	// Picking the nearest and the farthest texel in a checkerboard pattern keeps both sides of depth edges
+	ivec2 base = ivec2(gl_FragCoord.xy) * DOWNSAMPLE_FACTOR;
+	ivec2 maxCoord = textureSize(samplerPositionDepth, 0) - 1;
+	bool farthest = ((int(gl_FragCoord.x) + int(gl_FragCoord.y)) & 1) == 1;
+	ivec2 selected = min(base, maxCoord);
+	float selectedDepth = farthest ? -1.0 : 1.0e30;
+	for (int y = 0; y < DOWNSAMPLE_FACTOR; y++) {
+		for (int x = 0; x < DOWNSAMPLE_FACTOR; x++) {
+			ivec2 coord = min(base + ivec2(x, y), maxCoord);
+			// Texels without geometry are cleared to a depth of zero
+			float depth = texelFetch(samplerPositionDepth, coord, 0).w;
+			depth = (depth > 0.0) ? depth : 1.0e30;
+			if (farthest ? (depth > selectedDepth) : (depth < selectedDepth)) {
+				selected = coord;
+				selectedDepth = depth;
+			}
+		}
+	}
+	outPosition = texelFetch(samplerPositionDepth, selected, 0);
+	outNormal = texelFetch(samplerNormal, selected, 0);
+}
@@ -6,6 +6,8 @@ layout (binding = 2) uniform sampler2D ssaoNoise;
 
 layout (constant_id = 0) const int SSAO_KERNEL_SIZE = 64;
 layout (constant_id = 1) const float SSAO_RADIUS = 0.5;
+// Samples taken per pixel, with fewer samples than the kernel size every frame uses a different subset of the kernel
+layout (constant_id = 2) const int SSAO_SAMPLE_COUNT = 64;
 
 layout (binding = 3) uniform UBOSSAOKernel
 {
@@ -15,6 +17,10 @@ layout (binding = 3) uniform UBOSSAOKernel
 layout (binding = 4) uniform UBO 
 {
 	mat4 projection;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	int frameIndex;
 } ubo;
 
 layout (location = 0) in vec2 inUV;
@@ -30,7 +36,9 @@ void main()
 	// Get a random vector using a noise lookup
 	ivec2 texDim = textureSize(samplerPositionDepth, 0); 
 	ivec2 noiseDim = textureSize(ssaoNoise, 0);
-	const vec2 noiseUV = vec2(float(texDim.x)/float(noiseDim.x), float(texDim.y)/(noiseDim.y)) * inUV;  
+	vec2 noiseUV = vec2(float(texDim.x)/float(noiseDim.x), float(texDim.y)/(noiseDim.y)) * inUV;  
+	// Shift the noise by whole texels every frame, so accumulated frames use different sample rotations
+	noiseUV += vec2(ubo.frameIndex % noiseDim.x, (ubo.frameIndex / noiseDim.x) % noiseDim.y) / vec2(noiseDim);
 	vec3 randomVec = texture(ssaoNoise, noiseUV).xyz * 2.0 - 1.0;
 	
 	// Create TBN matrix
@@ -42,9 +50,11 @@ void main()
 	float occlusion = 0.0f;
 	// remove banding
 	const float bias = 0.025f;
-	for(int i = 0; i < SSAO_KERNEL_SIZE; i++)
+	// Every n-th kernel sample, so the subset covers all sample distances
+	const int kernelStep = SSAO_KERNEL_SIZE / SSAO_SAMPLE_COUNT;
+	for(int i = 0; i < SSAO_SAMPLE_COUNT; i++)
 	{		
-		vec3 samplePos = TBN * uboSSAOKernel.samples[i].xyz; 
+		vec3 samplePos = TBN * uboSSAOKernel.samples[i * kernelStep + ubo.frameIndex % kernelStep].xyz; 
 		samplePos = fragPos + samplePos * SSAO_RADIUS; 
 		
 		// project
@@ -58,7 +68,7 @@ void main()
 		float rangeCheck = smoothstep(0.0f, 1.0f, SSAO_RADIUS / abs(fragPos.z - sampleDepth));
 		occlusion += (sampleDepth >= samplePos.z + bias ? 1.0f : 0.0f) * rangeCheck;           
 	}
-	occlusion = 1.0 - (occlusion / float(SSAO_KERNEL_SIZE));
+	occlusion = 1.0 - (occlusion / float(SSAO_SAMPLE_COUNT));
 	
 	outFragColor = occlusion;
 }
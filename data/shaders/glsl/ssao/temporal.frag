@@ -0,0 +1,39 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D samplerSSAO;
+layout (binding = 1) uniform sampler2D samplerHistory;
+layout (binding = 2) uniform sampler2D samplerPositionDepth;
+
+layout (binding = 3) uniform UBO 
+{
+	// From the current frame's view space to the previous frame's clip space
+	mat4 reprojection;
+	float historyWeight;
+	int historyValid;
+} ubo;
+
+layout (location = 0) in vec2 inUV;
+
+// r = accumulated occlusion, g = linear depth it was accumulated at
+layout (location = 0) out vec2 outFragColor;
+
+void main() 
+{
+	float occlusion = texture(samplerSSAO, inUV).r;
+	vec4 position = texture(samplerPositionDepth, inUV);
+
+	if ((ubo.historyValid == 1) && (position.w > 0.0)) {
+		// Where the surface was in the previous frame, w is its linear depth in that frame
+		vec4 previous = ubo.reprojection * vec4(position.xyz, 1.0);
+		vec2 previousUV = previous.xy / previous.w * 0.5 + 0.5;
+		if (all(greaterThanEqual(previousUV, vec2(0.0))) && all(lessThanEqual(previousUV, vec2(1.0)))) {
+			vec2 history = texture(samplerHistory, previousUV).rg;
+			// The history is discarded if it belongs to a different surface (disocclusion)
+			if (abs(history.g - previous.w) < 0.05 * previous.w) {
+				occlusion = mix(occlusion, history.r, ubo.historyWeight);
+			}
+		}
+	}
+
+	outFragColor = vec2(occlusion, position.w);
+}
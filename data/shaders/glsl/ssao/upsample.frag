@@ -0,0 +1,49 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D samplerSSAO;
+layout (binding = 1) uniform sampler2D samplerLowPositionDepth;
+layout (binding = 2) uniform sampler2D samplerLowNormal;
+layout (binding = 3) uniform sampler2D samplerPositionDepth;
+layout (binding = 4) uniform sampler2D samplerNormal;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out float outFragColor;
+
+void main() 
+{
+	float depth = texture(samplerPositionDepth, inUV).w;
+	vec3 normal = normalize(texture(samplerNormal, inUV).rgb * 2.0 - 1.0);
+
+	// Nothing to guide the filter for pixels without geometry
+	if (depth <= 0.0) {
+		outFragColor = texture(samplerSSAO, inUV).r;
+		return;
+	}
+
+	// Joint bilateral filter over the 4x4 low resolution texels around the pixel: a tent filter two low resolution texels wide
+	// that also smooths the reduced sample count, with the weights of texels from other surfaces (depth or orientation) scaled down
+	ivec2 lowSize = textureSize(samplerSSAO, 0);
+	vec2 lowCoord = inUV * vec2(lowSize) - 0.5;
+	ivec2 base = ivec2(floor(lowCoord));
+	vec2 f = lowCoord - vec2(base);
+	float occlusion = 0.0;
+	float weightSum = 0.0;
+	for (int y = -1; y <= 2; y++) {
+		for (int x = -1; x <= 2; x++) {
+			ivec2 coord = clamp(base + ivec2(x, y), ivec2(0), lowSize - 1);
+			vec2 dist = abs(vec2(x, y) - f);
+			float spatialWeight = max(1.0 - dist.x * 0.5, 0.0) * max(1.0 - dist.y * 0.5, 0.0);
+			float lowDepth = texelFetch(samplerLowPositionDepth, coord, 0).w;
+			vec3 lowNormal = normalize(texelFetch(samplerLowNormal, coord, 0).rgb * 2.0 - 1.0);
+			float depthWeight = exp(-abs(lowDepth - depth) / (0.02 * depth));
+			float normalWeight = pow(max(dot(lowNormal, normal), 0.0), 8.0);
+			float weight = spatialWeight * depthWeight * normalWeight;
+			occlusion += texelFetch(samplerSSAO, coord, 0).r * weight;
+			weightSum += weight;
+		}
+	}
+
+	// Fall back to the plain low resolution value if no texel matches the surface
+	outFragColor = (weightSum > 1.0e-4) ? occlusion / weightSum : texture(samplerSSAO, inUV).r;
+}
@@ -0,0 +1,13 @@
+#version 450
+
+layout (push_constant) uniform PushConsts {
+	vec4 offset;
+	uint id;
+} pushConsts;
+
+layout (location = 0) out uint outId;
+
+void main()
+{
+	outId = pushConsts.id;
+}
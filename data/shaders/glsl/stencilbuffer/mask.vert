@@ -0,0 +1,27 @@
+#version 450
+
+// Object id mask of the jump flood outlines, see vks::OutlineRenderer
+
+layout (location = 0) in vec3 inPos;
+
+layout (binding = 0) uniform UBO
+{
+	mat4 projection;
+	mat4 model;
+	vec4 lightPos;
+} ubo;
+
+layout (push_constant) uniform PushConsts {
+	vec4 offset;
+	uint id;
+} pushConsts;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+void main()
+{
+	gl_Position = ubo.projection * ubo.model * vec4(inPos + pushConsts.offset.xyz, 1.0);
+}
@@ -11,6 +11,11 @@ layout (binding = 0) uniform UBO
 	float outlineWidth;
 } ubo;
 
+layout (push_constant) uniform PushConsts {
+	vec4 offset;
+	uint id;
+} pushConsts;
+
 out gl_PerVertex
 {
 	vec4 gl_Position;
@@ -19,6 +24,6 @@ out gl_PerVertex
 void main() 
 {
 	// Extrude along normal
-	vec4 pos = vec4(inPos.xyz + inNormal * ubo.outlineWidth, inPos.w);
+	vec4 pos = vec4(inPos.xyz + pushConsts.offset.xyz + inNormal * ubo.outlineWidth, inPos.w);
 	gl_Position = ubo.projection * ubo.model * pos;
 }
@@ -11,6 +11,11 @@ layout (binding = 0) uniform UBO
 	vec4 lightPos;
 } ubo;
 
+layout (push_constant) uniform PushConsts {
+	vec4 offset;
+	uint id;
+} pushConsts;
+
 layout (location = 0) out vec3 outNormal;
 layout (location = 1) out vec3 outColor;
 layout (location = 2) out vec3 outLightVec;
@@ -23,9 +28,9 @@ out gl_PerVertex
 void main() 
 {
 	outColor = vec3(1.0, 0.0, 0.0);
-	gl_Position = ubo.projection * ubo.model * vec4(inPos.xyz, 1.0);
+	gl_Position = ubo.projection * ubo.model * vec4(inPos.xyz + pushConsts.offset.xyz, 1.0);
 	outNormal = mat3(ubo.model) * inNormal;
-	vec4 pos = ubo.model * vec4(inPos, 1.0);
+	vec4 pos = ubo.model * vec4(inPos + pushConsts.offset.xyz, 1.0);
 	vec3 lPos = mat3(ubo.model) * ubo.lightPos.xyz;
 	outLightVec = lPos - pos.xyz;
 }
\ No newline at end of file
@@ -0,0 +1,132 @@
+#version 450
+
+layout (set = 0, binding = 0) uniform UBO
+{
+	mat4 projection;
+	mat4 modelview;
+	vec4 cameraPos;
+	vec4 lightDir;
+	vec4 frustumPlanes[6];
+	ivec4 clipRegions[8];
+	vec2 terrainOrigin;
+	float terrainSize;
+	float terrainTexels;
+	float texelSize;
+	float heightScale;
+	float lodRange;
+	float tessellationFactor;
+	uint maxDepth;
+	uint clipLevels;
+	float clipSize;
+	float blendTexels;
+	uint maxNodes;
+	uint showLod;
+} ubo;
+
+layout (set = 0, binding = 1) uniform sampler2DArray samplerClipHeight;
+layout (set = 0, binding = 2) uniform sampler2DArray samplerClipNormal;
+layout (set = 0, binding = 3) uniform sampler2DArray samplerLayers;
+
+layout (location = 0) in vec3 inWorldPos;
+layout (location = 1) in float inDepth;
+
+layout (location = 0) out vec4 outFragColor;
+
+// Level 0 texel position of a world space position, clamped to the terrain
+vec2 terrainTexel(vec2 pos)
+{
+	return clamp((pos - ubo.terrainOrigin) / ubo.texelSize, vec2(0.0), vec2(ubo.terrainTexels - 1.0));
+}
+
+// Finest clipmap level whose resident region contains the position, weight drops to zero towards the border of the region
+void clipmapLevel(vec2 pos, out uint level, out float weight)
+{
+	vec2 texel = terrainTexel(pos);
+	for (level = 0; level < ubo.clipLevels - 1; level++) {
+		vec2 levelTexel = (texel + 0.5) / float(1 << level) - 0.5;
+		vec4 region = vec4(ubo.clipRegions[level]);
+		vec2 edge = min(levelTexel - region.xy, region.zw - levelTexel);
+		// Bilinear filtering reads one texel further
+		float edgeDistance = min(edge.x, edge.y) - 1.0;
+		if (edgeDistance >= 0.0) {
+			weight = clamp(edgeDistance / ubo.blendTexels, 0.0, 1.0);
+			return;
+		}
+	}
+	weight = 1.0;
+}
+
+// Texture coordinate of a position in a clipmap level, layers are addressed toroidally with a repeating sampler
+vec3 clipmapCoord(vec2 pos, uint level)
+{
+	float scale = float(1 << level);
+	float levelWidth = ceil(ubo.terrainTexels / scale);
+	vec2 levelTexel = clamp((terrainTexel(pos) + 0.5) / scale - 0.5, vec2(0.0), vec2(levelWidth - 1.0));
+	return vec3((levelTexel + 0.5) / ubo.clipSize, float(level));
+}
+
+// Height (x) and normal (yzw, y pointing up) from the clipmap, blended between two levels near the border of the finer one
+vec4 sampleTerrain(vec2 pos)
+{
+	uint level;
+	float weight;
+	clipmapLevel(pos, level, weight);
+	vec3 coord = clipmapCoord(pos, level);
+	vec3 value = vec3(textureLod(samplerClipHeight, coord, 0.0).r, textureLod(samplerClipNormal, coord, 0.0).rg);
+	if (weight < 1.0) {
+		coord = clipmapCoord(pos, level + 1);
+		value = mix(vec3(textureLod(samplerClipHeight, coord, 0.0).r, textureLod(samplerClipNormal, coord, 0.0).rg), value, weight);
+	}
+	return vec4(value.x, value.y, sqrt(max(1.0 - dot(value.yz, value.yz), 0.0)), value.z);
+}
+
+vec3 sampleTerrainLayer(float height, vec2 uv)
+{
+	// Define some layer ranges for sampling depending on terrain height
+	vec2 layers[6];
+	layers[0] = vec2(-10.0, 10.0);
+	layers[1] = vec2(5.0, 45.0);
+	layers[2] = vec2(45.0, 80.0);
+	layers[3] = vec2(75.0, 100.0);
+	layers[4] = vec2(95.0, 140.0);
+	layers[5] = vec2(140.0, 190.0);
+
+	vec3 color = vec3(0.0);
+	height *= 255.0;
+	for (int i = 0; i < 6; i++)
+	{
+		float range = layers[i].y - layers[i].x;
+		float weight = (range - abs(height - layers[i].y)) / range;
+		weight = max(0.0, weight);
+		color += weight * texture(samplerLayers, vec3(uv, i)).rgb;
+	}
+
+	return color;
+}
+
+float fog(float density)
+{
+	const float LOG2 = -1.442695;
+	float dist = distance(inWorldPos, ubo.cameraPos.xyz) * 0.01;
+	float d = density * dist;
+	return 1.0 - clamp(exp2(d * d * LOG2), 0.0, 1.0);
+}
+
+void main()
+{
+	vec4 terrain = sampleTerrain(inWorldPos.xz);
+	// Up is -y in world space
+	vec3 N = normalize(vec3(terrain.y, -terrain.z, terrain.w));
+	vec3 L = normalize(ubo.lightDir.xyz);
+	vec3 ambient = vec3(0.5);
+	vec3 diffuse = max(dot(N, L), 0.0) * vec3(1.0);
+
+	vec3 color = (ambient + diffuse) * sampleTerrainLayer(terrain.x, inWorldPos.xz / 8.0);
+	if (ubo.showLod != 0) {
+		// Tint by quadtree depth
+		color *= 0.6 + 0.4 * cos(6.28318 * (inDepth / 8.0 + vec3(0.0, 0.33, 0.67)));
+	}
+
+	const vec4 fogColor = vec4(0.47, 0.5, 0.67, 0.0);
+	outFragColor = mix(vec4(color, 1.0), fogColor, fog(0.25));
+}
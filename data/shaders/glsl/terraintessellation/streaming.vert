@@ -0,0 +1,21 @@
+#version 450
+
+layout (location = 0) in vec2 inPos;
+
+// World space xz origin (xy), size (z) and depth (w) of the selected leaves
+layout (set = 0, binding = 6) readonly buffer Leaves
+{
+	vec4 leaves[];
+};
+
+layout (location = 0) out vec2 outLocal;
+layout (location = 1) out vec4 outNode;
+
+void main(void)
+{
+	// Each instance is the patch grid of one quadtree leaf, the vertex positions are relative to the leaf
+	vec4 node = leaves[gl_InstanceIndex];
+	outLocal = inPos;
+	outNode = node;
+	gl_Position = vec4(node.x + inPos.x * node.z, 0.0, node.y + inPos.y * node.z, 1.0);
+}
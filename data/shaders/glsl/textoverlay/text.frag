@@ -1,13 +1,24 @@
 #version 450 core
 
 layout (location = 0) in vec2 inUV;
+layout (location = 1) in vec4 inColor;
 
 layout (binding = 0) uniform sampler2D samplerFont;
 
+// Signed distance field font with the distance in the alpha channel, coverage bitmap font in the red channel otherwise
+layout (constant_id = 0) const bool SDF = false;
+
 layout (location = 0) out vec4 outFragColor;
 
 void main(void)
 {
-	float color = texture(samplerFont, inUV).r;
-	outFragColor = vec4(color);
+	float alpha;
+	if (SDF) {
+		float distance = texture(samplerFont, inUV).a;
+		float smoothWidth = fwidth(distance);
+		alpha = smoothstep(0.5 - smoothWidth, 0.5 + smoothWidth, distance);
+	} else {
+		alpha = texture(samplerFont, inUV).r;
+	}
+	outFragColor = vec4(inColor.rgb, inColor.a * alpha);
 }
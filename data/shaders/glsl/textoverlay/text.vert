@@ -1,17 +1,48 @@
 #version 450 core
 
+// Per glyph instance
 layout (location = 0) in vec2 inPos;
-layout (location = 1) in vec2 inUV;
+// x = glyph index, y = glyph size in 1/16 pixels
+layout (location = 1) in uvec2 inGlyph;
+layout (location = 2) in vec4 inColor;
+
+struct Glyph
+{
+	// Quad corners relative to the pen position, in font units
+	vec4 rect;
+	// Texture coordinates of the corners
+	vec4 uv;
+};
+
+layout (std430, binding = 1) readonly buffer Glyphs
+{
+	Glyph glyphs[];
+};
+
+layout (push_constant) uniform PushConsts
+{
+	// Size of a pixel in normalized device coordinates
+	vec2 pixelSize;
+	// Size the glyph metrics are given for
+	float fontSize;
+} pushConsts;
 
 layout (location = 0) out vec2 outUV;
+layout (location = 1) out vec4 outColor;
 
-out gl_PerVertex 
+out gl_PerVertex
 {
-	vec4 gl_Position;   
+	vec4 gl_Position;
 };
 
 void main(void)
 {
-	gl_Position = vec4(inPos, 0.0, 1.0);
-	outUV = inUV;
+	// Expand the quad from the vertex index of the triangle strip (0 = top left, 1 = top right, 2 = bottom left, 3 = bottom right)
+	Glyph glyph = glyphs[inGlyph.x];
+	bvec2 corner = bvec2((gl_VertexIndex & 1) != 0, (gl_VertexIndex & 2) != 0);
+	vec2 offset = mix(glyph.rect.xy, glyph.rect.zw, corner);
+	float scale = float(inGlyph.y) / 16.0 / pushConsts.fontSize;
+	gl_Position = vec4(inPos + offset * scale * pushConsts.pixelSize, 0.0, 1.0);
+	outUV = mix(glyph.uv.xy, glyph.uv.zw, corner);
+	outColor = inColor;
 }
@@ -0,0 +1,29 @@
+#version 450
+
+layout (binding = 1) uniform samplerCubeArray samplerCubeMapArray;
+
+layout (binding = 0) uniform UBO
+{
+	mat4 faceViewProjection[6];
+	float time;
+	int sourceLayerCount;
+} ubo;
+
+layout (constant_id = 0) const bool SKY = true;
+
+layout (location = 0) in vec3 inUVW;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) flat in int inLayer;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+	if (SKY) {
+		outFragColor = textureLod(samplerCubeMapArray, vec4(inUVW, inLayer % ubo.sourceLayerCount), 0.0);
+	} else {
+		const vec3 colors[4] = vec3[](vec3(1.0, 0.3, 0.2), vec3(0.2, 1.0, 0.3), vec3(0.2, 0.4, 1.0), vec3(1.0, 0.9, 0.2));
+		float diffuse = max(dot(normalize(inNormal), normalize(vec3(0.5, -1.0, 0.25))), 0.15);
+		outFragColor = vec4(colors[inLayer % 4] * diffuse, 1.0);
+	}
+}
@@ -0,0 +1,41 @@
+#version 450
+
+#extension GL_ARB_shader_viewport_layer_array : require
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+
+layout (binding = 0) uniform UBO
+{
+	mat4 faceViewProjection[6];
+	float time;
+	int sourceLayerCount;
+} ubo;
+
+// Selects between the sky and the object orbiting the center of the cube maps
+layout (constant_id = 0) const bool SKY = true;
+
+layout (location = 0) out vec3 outUVW;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) flat out int outLayer;
+
+void main()
+{
+	// Each instance renders into one face of one cube map of the array
+	int face = gl_InstanceIndex % 6;
+	outLayer = gl_InstanceIndex / 6;
+	gl_Layer = gl_InstanceIndex;
+
+	// Every cube map turns at its own speed, so each of them shows different content
+	float angle = ubo.time * (0.5 + 0.25 * float(outLayer));
+	mat3 rotation = mat3(cos(angle), 0.0, -sin(angle), 0.0, 1.0, 0.0, sin(angle), 0.0, cos(angle));
+	if (SKY) {
+		outUVW = rotation * inPos;
+		outUVW.yz *= -1.0;
+		gl_Position = ubo.faceViewProjection[face] * vec4(inPos, 1.0);
+	} else {
+		vec3 pos = rotation * (inPos * 0.35 + vec3(2.0, 0.5 * sin(angle * 2.0), 0.0));
+		outNormal = rotation * inNormal;
+		gl_Position = ubo.faceViewProjection[face] * vec4(pos, 1.0);
+	}
+}
@@ -4,6 +4,15 @@
 
 layout (set = 1, binding = 0) uniform sampler2D samplerColorMap;
 layout (set = 1, binding = 1) uniform sampler2D samplerNormalMap;
+// Inline uniform block or uniform buffer range, depending on device support
+layout (set = 1, binding = 2) uniform MaterialConstants
+{
+	vec4 baseColorFactor;
+	float metallicFactor;
+	float roughnessFactor;
+	float alphaCutoff;
+	uint alphaMode;
+} material;
 
 layout (location = 0) in vec3 inNormal;
 layout (location = 1) in vec3 inColor;
@@ -25,14 +34,13 @@ layout (set = 0, binding = 0) uniform UBOScene
 layout (location = 0) out vec4 outFragColor;
 
 layout (constant_id = 0) const bool ALPHA_MASK = false;
-layout (constant_id = 1) const float ALPHA_MASK_CUTOFF = 0.0f;
 
 void main() 
 {
-	vec4 color = texture(samplerColorMap, inUV) * vec4(inColor, 1.0);
+	vec4 color = texture(samplerColorMap, inUV) * vec4(inColor, 1.0) * material.baseColorFactor;
 
 	if (ALPHA_MASK) {
-		if (color.a < ALPHA_MASK_CUTOFF) {
+		if (color.a < material.alphaCutoff) {
 			discard;
 		}
 	}
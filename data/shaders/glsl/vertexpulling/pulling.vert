@@ -0,0 +1,69 @@
+#version 450
+
+#extension GL_EXT_buffer_reference : require
+
+layout (buffer_reference, std430, buffer_reference_align = 4) readonly buffer VertexWords { uint words[]; };
+
+// Address and layout of the model's vertices, see vkglTF::Model::VertexFetch
+layout (push_constant) uniform VertexFetch
+{
+	VertexWords vertices;
+	uint stride;
+	uint formats;
+	uint offsets[7];
+} fetch;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	vec4 lightPos;
+} ubo;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec3 outViewVec;
+layout (location = 3) out vec3 outLightVec;
+
+// vkglTF::VertexComponent
+const uint COMPONENT_POSITION = 0;
+const uint COMPONENT_NORMAL = 1;
+const uint COMPONENT_COLOR = 3;
+
+// Reads a vertex component in any of the formats of vkglTF::Model::VertexFetchFormat, components that aren't stored return the default value
+vec4 fetchComponent(uint component, vec4 defaultValue)
+{
+	uint format = (fetch.formats >> (component * 4)) & 0xF;
+	uint i = (gl_VertexIndex * fetch.stride + fetch.offsets[component]) / 4;
+	switch (format) {
+		case 1:
+			return vec4(uintBitsToFloat(fetch.vertices.words[i]), uintBitsToFloat(fetch.vertices.words[i + 1]), defaultValue.zw);
+		case 2:
+			return vec4(uintBitsToFloat(fetch.vertices.words[i]), uintBitsToFloat(fetch.vertices.words[i + 1]), uintBitsToFloat(fetch.vertices.words[i + 2]), defaultValue.w);
+		case 3:
+			return vec4(uintBitsToFloat(fetch.vertices.words[i]), uintBitsToFloat(fetch.vertices.words[i + 1]), uintBitsToFloat(fetch.vertices.words[i + 2]), uintBitsToFloat(fetch.vertices.words[i + 3]));
+		case 4:
+			return vec4(unpackHalf2x16(fetch.vertices.words[i]), defaultValue.zw);
+		case 5:
+			return vec4(unpackSnorm2x16(fetch.vertices.words[i]), unpackSnorm2x16(fetch.vertices.words[i + 1]));
+		case 6:
+			return unpackUnorm4x8(fetch.vertices.words[i]);
+		case 7:
+			return vec4((uvec4(fetch.vertices.words[i]) >> uvec4(0, 8, 16, 24)) & 0xFF);
+	}
+	return defaultValue;
+}
+
+void main() 
+{
+	vec3 inPos = fetchComponent(COMPONENT_POSITION, vec4(0.0)).xyz;
+	vec3 inNormal = fetchComponent(COMPONENT_NORMAL, vec4(0.0)).xyz;
+	outColor = fetchComponent(COMPONENT_COLOR, vec4(1.0)).rgb;
+	gl_Position = ubo.projection * ubo.model * vec4(inPos.xyz, 1.0);
+	
+	vec4 pos = ubo.model * vec4(inPos, 1.0);
+	outNormal = mat3(ubo.model) * inNormal;
+	vec3 lPos = mat3(ubo.model) * ubo.lightPos.xyz;
+	outLightVec = lPos - pos.xyz;
+	outViewVec = -pos.xyz;
+}
@@ -0,0 +1,40 @@
+#version 450
+
+#extension GL_ARB_shader_viewport_layer_array : require
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec3 inColor;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection[16];
+	mat4 modelview[16];
+	vec4 lightPos;
+	int viewportCount;
+} ubo;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec3 outViewVec;
+layout (location = 3) out vec3 outLightVec;
+
+void main() 
+{
+	// Each instance renders to the viewport with the same index
+	int viewport = gl_InstanceIndex;
+
+	outNormal = mat3(ubo.modelview[viewport]) * inNormal;
+	outColor = inColor;
+
+	vec4 worldPos = ubo.modelview[viewport] * vec4(inPos.xyz, 1.0);
+
+	vec3 lPos = vec3(ubo.modelview[viewport] * ubo.lightPos);
+	outLightVec = lPos - worldPos.xyz;
+	outViewVec = -worldPos.xyz;
+
+	gl_Position = ubo.projection[viewport] * worldPos;
+
+	// Set the viewport index that the vertex will be emitted to
+	gl_ViewportIndex = viewport;
+}
@@ -0,0 +1,106 @@
+#version 450
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+	mat4 inverseViewProjection;
+	vec4 cameraPos;
+	vec4 lightDir;
+	// Voxel clipmap, see vks::Voxelizer::ShaderData
+	vec4 voxelLevels[8];
+	uint voxelResolution;
+	uint voxelLevelCount;
+	uvec2 voxelPadding;
+	float aoStrength;
+	int displayMode;
+	int shadows;
+} ubo;
+
+layout (binding = 1) uniform sampler3D samplerVoxels;
+
+layout (location = 0) in vec3 inWorldPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec3 inColor;
+
+layout (location = 0) out vec4 outFragColor;
+
+// Finest clipmap level that contains the position and has voxels of at least the given size, voxelLevelCount if there is none
+uint findLevel(vec3 pos, float minVoxelSize)
+{
+	for (uint level = 0; level < ubo.voxelLevelCount; level++) {
+		vec4 voxelLevel = ubo.voxelLevels[level];
+		vec3 uvw = (pos - voxelLevel.xyz) / (voxelLevel.w * float(ubo.voxelResolution));
+		if ((voxelLevel.w >= minVoxelSize) && all(greaterThan(uvw, vec3(0.0))) && all(lessThan(uvw, vec3(1.0)))) {
+			return level;
+		}
+	}
+	return ubo.voxelLevelCount;
+}
+
+// Filtered voxel (rgb = color, a = occupancy) of a level at a world space position
+vec4 sampleVoxels(vec3 pos, uint level)
+{
+	float resolution = float(ubo.voxelResolution);
+	vec4 voxelLevel = ubo.voxelLevels[level];
+	vec3 uvw = (pos - voxelLevel.xyz) / (voxelLevel.w * resolution);
+	// Clamped to the texel centers of the level, so filtering doesn't read from the neighbouring levels stacked along z
+	uvw = clamp(uvw, vec3(0.5 / resolution), vec3(1.0 - 0.5 / resolution));
+	uvw.z = (uvw.z + float(level)) / float(ubo.voxelLevelCount);
+	return textureLod(samplerVoxels, uvw, 0.0);
+}
+
+// Approximates a cone by sampling coarser levels with growing distance, so each step is a single fetch
+float traceCone(vec3 origin, vec3 direction, float aperture, float maxDistance)
+{
+	float baseVoxelSize = ubo.voxelLevels[0].w;
+	float occlusion = 0.0;
+	// Start outside of the voxels of the surface itself
+	float dist = baseVoxelSize * 2.0;
+	while ((dist < maxDistance) && (occlusion < 0.95)) {
+		vec3 pos = origin + direction * dist;
+		float diameter = max(baseVoxelSize, 2.0 * aperture * dist);
+		uint level = findLevel(pos, diameter * 0.5);
+		if (level >= ubo.voxelLevelCount) {
+			break;
+		}
+		float sampleOcclusion = sampleVoxels(pos, level).a;
+		occlusion += (1.0 - occlusion) * sampleOcclusion;
+		dist += diameter * 0.5;
+	}
+	return occlusion;
+}
+
+float ambientOcclusion(vec3 pos, vec3 normal)
+{
+	// One cone along the normal and four around it, 60 degrees apart
+	vec3 tangent = normalize(cross(normal, abs(normal.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+	vec3 bitangent = cross(normal, tangent);
+	const float aperture = 0.577;
+	const float maxDistance = 2.0;
+	float occlusion = traceCone(pos, normal, aperture, maxDistance);
+	occlusion += 0.75 * traceCone(pos, normalize(normal + tangent), aperture, maxDistance);
+	occlusion += 0.75 * traceCone(pos, normalize(normal - tangent), aperture, maxDistance);
+	occlusion += 0.75 * traceCone(pos, normalize(normal + bitangent), aperture, maxDistance);
+	occlusion += 0.75 * traceCone(pos, normalize(normal - bitangent), aperture, maxDistance);
+	return clamp(1.0 - occlusion / 4.0 * ubo.aoStrength, 0.0, 1.0);
+}
+
+void main() 
+{
+	vec3 N = normalize(inNormal);
+	vec3 L = -ubo.lightDir.xyz;
+	float occlusion = ambientOcclusion(inWorldPos, N);
+	if (ubo.displayMode == 1) {
+		outFragColor = vec4(vec3(occlusion), 1.0);
+		return;
+	}
+
+	float diffuse = max(dot(N, L), 0.0);
+	if ((ubo.shadows == 1) && (diffuse > 0.0)) {
+		// Narrow cone towards the light for soft shadows
+		diffuse *= 1.0 - traceCone(inWorldPos, L, 0.05, 16.0);
+	}
+	vec3 color = inColor * (0.3 * occlusion + 0.8 * diffuse);
+	outFragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,34 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec3 inColor;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+	mat4 inverseViewProjection;
+	vec4 cameraPos;
+	vec4 lightDir;
+	vec4 voxelLevels[8];
+	uint voxelResolution;
+	uint voxelLevelCount;
+	uvec2 voxelPadding;
+	float aoStrength;
+	int displayMode;
+	int shadows;
+} ubo;
+
+layout (location = 0) out vec3 outWorldPos;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec3 outColor;
+
+void main() 
+{
+	// Vertices are pre-transformed to world space
+	outWorldPos = inPos;
+	outNormal = inNormal;
+	outColor = inColor;
+	gl_Position = ubo.projection * ubo.view * vec4(inPos, 1.0);
+}
@@ -0,0 +1,72 @@
+#version 450
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+	mat4 inverseViewProjection;
+	vec4 cameraPos;
+	vec4 lightDir;
+	// Voxel clipmap, see vks::Voxelizer::ShaderData
+	vec4 voxelLevels[8];
+	uint voxelResolution;
+	uint voxelLevelCount;
+	uvec2 voxelPadding;
+	float aoStrength;
+	int displayMode;
+	int shadows;
+} ubo;
+
+layout (binding = 1) uniform sampler3D samplerVoxels;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+const vec3 levelColors[4] = vec3[](vec3(1.0, 0.6, 0.6), vec3(0.6, 1.0, 0.6), vec3(0.6, 0.6, 1.0), vec3(1.0, 1.0, 0.6));
+
+// Finest clipmap level that contains the position, voxelLevelCount if there is none
+uint findLevel(vec3 pos)
+{
+	for (uint level = 0; level < ubo.voxelLevelCount; level++) {
+		vec4 voxelLevel = ubo.voxelLevels[level];
+		vec3 uvw = (pos - voxelLevel.xyz) / (voxelLevel.w * float(ubo.voxelResolution));
+		if (all(greaterThanEqual(uvw, vec3(0.0))) && all(lessThan(uvw, vec3(1.0)))) {
+			return level;
+		}
+	}
+	return ubo.voxelLevelCount;
+}
+
+void main() 
+{
+	// World space ray through the pixel
+	vec4 nearPos = ubo.inverseViewProjection * vec4(inUV * 2.0 - 1.0, 0.0, 1.0);
+	vec4 farPos = ubo.inverseViewProjection * vec4(inUV * 2.0 - 1.0, 1.0, 1.0);
+	vec3 origin = nearPos.xyz / nearPos.w;
+	vec3 direction = normalize(farPos.xyz / farPos.w - origin);
+
+	// March in steps of half a voxel of the level at the current position, each step fetches the voxel it's in
+	int resolution = int(ubo.voxelResolution);
+	float dist = 0.0;
+	for (int i = 0; i < 1024; i++) {
+		vec3 pos = origin + direction * dist;
+		uint level = findLevel(pos);
+		if (level >= ubo.voxelLevelCount) {
+			break;
+		}
+		vec4 voxelLevel = ubo.voxelLevels[level];
+		ivec3 voxel = clamp(ivec3(floor((pos - voxelLevel.xyz) / voxelLevel.w)), ivec3(0), ivec3(resolution - 1));
+		vec4 value = texelFetch(samplerVoxels, ivec3(voxel.xy, voxel.z + int(level) * resolution), 0);
+		if (value.a > 0.5) {
+			// Shade the voxel faces by the axis the ray entered through
+			vec3 localPos = (pos - voxelLevel.xyz) / voxelLevel.w - vec3(voxel) - 0.5;
+			vec3 absPos = abs(localPos);
+			float shade = (absPos.x > absPos.y && absPos.x > absPos.z) ? 0.8 : ((absPos.y > absPos.z) ? 1.0 : 0.6);
+			outFragColor = vec4(value.rgb * levelColors[level % 4] * shade, 1.0);
+			return;
+		}
+		dist += voxelLevel.w * 0.5;
+	}
+	outFragColor = vec4(0.5, 0.6, 0.7, 1.0);
+}
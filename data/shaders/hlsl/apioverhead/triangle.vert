@@ -0,0 +1,38 @@
+// Copyright 2020 Google LLC
+
+struct UBO
+{
+	float4 color;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+struct PushConsts
+{
+	float4 offset;
+};
+
+[[vk::push_constant]] PushConsts pushConsts;
+
+// Only changes the color, so the pipelines of the pipeline switch test aren't identical
+[[vk::constant_id(0)]] const float BRIGHTNESS = 1.0;
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Color : COLOR0;
+};
+
+static const uint gridSize = 128;
+
+VSOutput main(uint VertexIndex : SV_VertexID)
+{
+	// Every draw is a small triangle in a cell of a grid, selected by the draw's first vertex
+	const float2 positions[3] = { float2(0.0, 0.0), float2(0.8, 0.0), float2(0.0, 0.8) };
+	uint cell = (VertexIndex / 3) % (gridSize * gridSize);
+	float2 pos = (float2(cell % gridSize, cell / gridSize) + positions[VertexIndex % 3]) / float(gridSize);
+	VSOutput output = (VSOutput)0;
+	output.Pos = float4(pos * 2.0 - 1.0 + pushConsts.offset.xy, 0.0, 1.0);
+	output.Color = ubo.color.rgb * BRIGHTNESS;
+	return output;
+}
@@ -0,0 +1,6 @@
+// Copyright 2020 Google LLC
+
+float4 main([[vk::location(0)]] float4 Color : COLOR0) : SV_TARGET
+{
+	return Color;
+}
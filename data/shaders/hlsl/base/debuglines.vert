@@ -0,0 +1,45 @@
+// Copyright 2020 Google LLC
+
+// Pulls the vertices of the debug lines from the line buffer, see vks::DebugLineRenderer
+
+struct LineVertex
+{
+	float4 position;
+	float4 color;
+};
+
+struct DrawCommand
+{
+	uint vertexCount;
+	uint instanceCount;
+	uint firstVertex;
+	uint firstInstance;
+	uint hostVertexCount;
+	uint3 padding;
+	float4x4 viewProjection;
+};
+
+StructuredBuffer<DrawCommand> drawCommand : register(t0);
+StructuredBuffer<LineVertex> vertices : register(t1);
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float4 Color : COLOR0;
+};
+
+VSOutput main(uint VertexIndex : SV_VertexID)
+{
+	VSOutput output = (VSOutput)0;
+	uint vertexCapacity, stride;
+	vertices.GetDimensions(vertexCapacity, stride);
+	// Lines appended beyond the capacity of the buffer are counted, but not stored, so they're moved outside of the view volume
+	if (VertexIndex >= vertexCapacity)
+	{
+		output.Pos = float4(2.0, 2.0, 2.0, 1.0);
+		return output;
+	}
+	output.Color = vertices[VertexIndex].color;
+	output.Pos = mul(drawCommand[0].viewProjection, float4(vertices[VertexIndex].position.xyz, 1.0));
+	return output;
+}
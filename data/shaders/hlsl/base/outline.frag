@@ -0,0 +1,47 @@
+// Copyright 2020 Google LLC
+
+// Outline composite, see vks::OutlineRenderer
+// Pixels outside of the mask within the outline width of a border pixel get the color of that pixel's id, the last pixel is faded
+// by its coverage for an antialiased edge. Pixels inside of the mask are tinted with the fill opacity.
+
+Texture2D<uint> textureMask : register(t0);
+SamplerState samplerMask : register(s0);
+Texture2D<uint> textureDistances : register(t1);
+SamplerState samplerDistances : register(s1);
+
+struct UBO
+{
+	float4 colors[16];
+	float width;
+	float fillOpacity;
+};
+
+cbuffer ubo : register(b2) { UBO ubo; }
+
+#define EMPTY 0xFFFFFFFFu
+
+float4 main(float4 FragCoord : SV_POSITION) : SV_TARGET
+{
+	int2 texel = int2(FragCoord.xy);
+	uint id = textureMask.Load(int3(texel, 0));
+	if (id != 0) {
+		if (ubo.fillOpacity <= 0.0) {
+			discard;
+		}
+		float4 color = ubo.colors[id];
+		return float4(color.rgb, color.a * ubo.fillOpacity);
+	}
+
+	uint seed = textureDistances.Load(int3(texel, 0));
+	if (seed == EMPTY) {
+		discard;
+	}
+	int2 seedTexel = int2(seed & 0xFFFFu, seed >> 16u);
+	// Border pixels are inside of the mask, so the first pixel outside of it is at a distance of one
+	float coverage = clamp(ubo.width - length(float2(seedTexel - texel)) + 1.0, 0.0, 1.0);
+	if (coverage <= 0.0) {
+		discard;
+	}
+	float4 color = ubo.colors[textureMask.Load(int3(seedTexel, 0))];
+	return float4(color.rgb, color.a * coverage);
+}
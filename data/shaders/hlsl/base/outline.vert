@@ -0,0 +1,9 @@
+// Copyright 2020 Google LLC
+
+// Fullscreen triangle of the outline composite, see vks::OutlineRenderer
+
+float4 main(uint VertexIndex : SV_VertexID) : SV_POSITION
+{
+	float2 uv = float2((VertexIndex << 1) & 2, VertexIndex & 2);
+	return float4(uv * 2.0f - 1.0f, 0.0f, 1.0f);
+}
@@ -0,0 +1,81 @@
+// Copyright 2020 Google LLC
+
+// Post processing uber pass (vks::PostProcessStack), applies the enabled effects in the order given by the uniform block
+
+#define EFFECT_EXPOSURE 0
+#define EFFECT_TONEMAP 1
+#define EFFECT_COLOR_GRADING 2
+#define EFFECT_VIGNETTE 3
+#define EFFECT_DITHER 4
+
+Texture2D textureInput : register(t0);
+SamplerState samplerInput : register(s0);
+// Color grading table indexed by red, green and blue
+Texture3D textureLut : register(t1);
+SamplerState samplerLut : register(s1);
+
+struct UBO
+{
+	int4 effects[2];
+	int effectCount;
+	float exposure;
+	float colorGradingStrength;
+	float lutSize;
+	float vignetteIntensity;
+	float vignetteRadius;
+	float ditherStrength;
+};
+
+cbuffer ubo : register(b2) { UBO ubo; }
+
+// ACES filmic tone mapping curve fit by Krzysztof Narkowicz
+float3 tonemapACES(float3 color)
+{
+	return saturate((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14));
+}
+
+float3 colorGrading(float3 color)
+{
+	// Sample at the entry centers so the table's first and last entries map to 0 and 1
+	float3 uvw = saturate(color) * ((ubo.lutSize - 1.0) / ubo.lutSize) + 0.5 / ubo.lutSize;
+	return lerp(color, textureLut.Sample(samplerLut, uvw).rgb, ubo.colorGradingStrength);
+}
+
+float3 vignette(float3 color, float2 uv)
+{
+	// 0 at the center, 1 at the corners
+	float dist = length(uv - 0.5) * 1.41421356;
+	return color * (1.0 - ubo.vignetteIntensity * smoothstep(ubo.vignetteRadius, 1.0, dist));
+}
+
+float3 dither(float3 color, float2 fragCoord)
+{
+	// Interleaved gradient noise, stable per pixel and without a noise texture
+	float noise = frac(52.9829189 * frac(dot(fragCoord, float2(0.06711056, 0.00583715))));
+	return color + (noise - 0.5) * ubo.ditherStrength;
+}
+
+float4 main(float4 fragCoord : SV_POSITION, [[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float3 color = textureInput.Sample(samplerInput, inUV).rgb;
+	for (int i = 0; i < ubo.effectCount; i++) {
+		switch (ubo.effects[i / 4][i % 4]) {
+			case EFFECT_EXPOSURE:
+				color *= ubo.exposure;
+				break;
+			case EFFECT_TONEMAP:
+				color = tonemapACES(color);
+				break;
+			case EFFECT_COLOR_GRADING:
+				color = colorGrading(color);
+				break;
+			case EFFECT_VIGNETTE:
+				color = vignette(color, inUV);
+				break;
+			case EFFECT_DITHER:
+				color = dither(color, fragCoord.xy);
+				break;
+		}
+	}
+	return float4(color, 1.0);
+}
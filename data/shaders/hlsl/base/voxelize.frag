@@ -0,0 +1,32 @@
+// Stores the voxels covered by a fragment into the level's slices of the voxel texture
+
+[[vk::image_format("rgba8")]] RWTexture3D<float4> voxels : register(u0);
+
+struct PushConsts
+{
+	float4x4 model;
+	float4 origin;
+	uint level;
+	uint resolution;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+void main([[vk::location(0)]] float3 inVoxelPos : POSITION0, [[vk::location(1)]] float3 inColor : COLOR0, [[vk::location(2)]] nointerpolation uint inAxis : TEXCOORD0)
+{
+	int resolution = int(pushConsts.resolution);
+	int3 voxel = int3(floor(inVoxelPos));
+	// The projection along the dominant axis limits the depth slope to one voxel per pixel, a fragment can touch up to two voxels
+	// along the projection axis, which are both stored so inclined surfaces don't get holes
+	float depth = inVoxelPos[inAxis];
+	float depthRange = min(fwidth(depth) * 0.5, 1.0);
+	int firstVoxel = int(floor(depth - depthRange));
+	int lastVoxel = int(floor(depth + depthRange));
+	for (int i = firstVoxel; i <= lastVoxel; i++)
+	{
+		voxel[inAxis] = i;
+		if (all(voxel >= 0) && all(voxel < resolution))
+		{
+			voxels[int3(voxel.xy, voxel.z + int(pushConsts.level) * resolution)] = float4(inColor, 1.0);
+		}
+	}
+}
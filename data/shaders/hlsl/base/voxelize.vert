@@ -0,0 +1,33 @@
+// Voxelizes the scene into a clipmap level, see vks::Voxelizer
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Color : COLOR0;
+};
+
+struct PushConsts
+{
+	float4x4 model;
+	// xyz = level origin, w = voxel size
+	float4 origin;
+	uint level;
+	uint resolution;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+struct VSOutput
+{
+[[vk::location(0)]] float3 VoxelPos : POSITION0;
+[[vk::location(1)]] float3 Color : COLOR0;
+};
+
+VSOutput main(VSInput input)
+{
+	// Position in voxels of the level, projected by the geometry shader
+	VSOutput output = (VSOutput)0;
+	float3 worldPos = mul(pushConsts.model, float4(input.Pos, 1.0)).xyz;
+	output.VoxelPos = (worldPos - pushConsts.origin.xyz) / pushConsts.origin.w;
+	output.Color = input.Color;
+	return output;
+}
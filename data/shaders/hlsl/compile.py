@@ -45,6 +45,10 @@ for root, dirs, files in os.walk(dir_path):
                 profile = 'ps_6_1'
             elif(hlsl_file.find('.comp') != -1):
                 profile = 'cs_6_1'
+                # Wave intrinsics map to subgroup operations, which need Vulkan 1.1
+                with open(hlsl_file) as f:
+                    if 'Wave' in f.read():
+                        target = '-fspv-target-env=vulkan1.1'
             elif(hlsl_file.find('.geom') != -1):
                 profile = 'gs_6_1'
             elif(hlsl_file.find('.tesc') != -1):
@@ -55,7 +59,8 @@ for root, dirs, files in os.walk(dir_path):
 				hlsl_file.find('.rchit') != -1 or
 				hlsl_file.find('.rmiss') != -1):
                 target='-fspv-target-env=vulkan1.2'
-                profile = 'lib_6_3'
+                # GeometryIndex() needs shader model 6.5
+                profile = 'lib_6_5'
 
             print('Compiling %s' % (hlsl_file))
             subprocess.check_output([
@@ -67,6 +72,9 @@ for root, dirs, files in os.walk(dir_path):
                 '-fspv-extension=SPV_KHR_multiview',
                 '-fspv-extension=SPV_KHR_shader_draw_parameters',
                 '-fspv-extension=SPV_EXT_descriptor_indexing',
+                '-fspv-extension=SPV_KHR_physical_storage_buffer',
+                '-fspv-extension=SPV_EXT_shader_viewport_index_layer',
+                '-fspv-extension=SPV_KHR_fragment_shading_rate',
                 target,
                 hlsl_file,
                 '-Fo', spv_out])
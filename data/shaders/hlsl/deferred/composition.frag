@@ -0,0 +1,131 @@
+// Copyright 2020 Google LLC
+
+// Composition subpass of the single render pass path, the G-Buffer is read from tile memory
+// Depth instead of positions for the packed G-Buffer
+[[vk::input_attachment_index(0)]][[vk::binding(1)]] SubpassInput samplerposition;
+[[vk::input_attachment_index(1)]][[vk::binding(2)]] SubpassInput samplerNormal;
+[[vk::input_attachment_index(2)]][[vk::binding(3)]] SubpassInput samplerAlbedo;
+
+[[vk::constant_id(0)]] const bool PACKED_GBUFFER = false;
+
+struct Light {
+	// xyz: position, w: range
+	float4 position;
+	float3 color;
+	float radius;
+	// xyz: spot direction, w: cosine of the cone angle (-2 for point lights)
+	float4 direction;
+};
+
+struct UBO
+{
+	float4x4 view;
+	float4x4 invProjection;
+	float4x4 invViewProjection;
+	float4 viewPos;
+	int displayDebugTarget;
+	int lightCount;
+	float2 uvScale;
+	int2 renderExtent;
+	int clustered;
+	float zNear;
+	float zFar;
+};
+
+cbuffer ubo : register(b4) { UBO ubo; }
+
+StructuredBuffer<Light> lights : register(t5);
+
+float3 decodeNormal(float2 e)
+{
+	e = e * 2.0 - 1.0;
+	float3 n = float3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += float2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+float3 shade(Light light, float3 fragPos, float3 normal, float4 albedo)
+{
+	// Vector to light
+	float3 L = light.position.xyz - fragPos;
+	// Distance from light to fragment position
+	float dist = length(L);
+
+	// Viewer to fragment
+	float3 V = ubo.viewPos.xyz - fragPos;
+	V = normalize(V);
+
+	// Light to fragment
+	L = normalize(L);
+
+	// Attenuation, faded out towards the light's range
+	float atten = light.radius / (pow(dist, 2.0) + 1.0);
+	float window = clamp(1.0 - pow(dist / light.position.w, 4.0), 0.0, 1.0);
+	atten *= window * window;
+	// Spot cone
+	atten *= smoothstep(light.direction.w, light.direction.w + 0.05, dot(-L, light.direction.xyz));
+
+	// Diffuse part
+	float3 N = normalize(normal);
+	float NdotL = max(0.0, dot(N, L));
+	float3 diff = light.color * albedo.rgb * NdotL * atten;
+
+	// Specular part
+	// Specular map values are stored in alpha of albedo mrt
+	float3 R = reflect(-L, N);
+	float NdotR = max(0.0, dot(R, V));
+	float3 spec = light.color * albedo.a * pow(NdotR, 16.0) * atten;
+
+	return diff + spec;
+}
+
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	// Read G-Buffer values from the previous subpass
+	float3 fragPos;
+	float3 normal;
+	if (PACKED_GBUFFER) {
+		float4 pos = mul(ubo.invViewProjection, float4(inUV * 2.0 - 1.0, samplerposition.SubpassLoad().r, 1.0));
+		fragPos = pos.xyz / pos.w;
+		normal = decodeNormal(samplerNormal.SubpassLoad().rg);
+	} else {
+		fragPos = samplerposition.SubpassLoad().rgb;
+		normal = samplerNormal.SubpassLoad().rgb;
+	}
+	float4 albedo = samplerAlbedo.SubpassLoad();
+
+	float3 fragcolor;
+
+	// Debug display
+	if (ubo.displayDebugTarget > 0) {
+		switch (ubo.displayDebugTarget) {
+			case 1: 
+				fragcolor.rgb = fragPos;
+				break;
+			case 2: 
+				fragcolor.rgb = normal;
+				break;
+			case 3: 
+				fragcolor.rgb = albedo.rgb;
+				break;
+			case 4: 
+				fragcolor.rgb = albedo.aaa;
+				break;
+		}		
+		return float4(fragcolor, 1.0);
+	}
+
+	#define ambient 0.0
+
+	// Ambient part
+	fragcolor = albedo.rgb * ambient;
+
+	// Light culling needs the depth buffer before the composition, so all lights are shaded within the render pass
+	for (int i = 0; i < ubo.lightCount; ++i) {
+		fragcolor += shade(lights[i], fragPos, normal, albedo);
+	}
+
+	return float4(fragcolor, 1.0);
+}
@@ -1,5 +1,6 @@
 // Copyright 2020 Google LLC
 
+// Depth instead of positions for the packed G-Buffer
 Texture2D textureposition : register(t1);
 SamplerState samplerposition : register(s1);
 Texture2D textureNormal : register(t2);
@@ -7,28 +8,104 @@ SamplerState samplerNormal : register(s2);
 Texture2D textureAlbedo : register(t3);
 SamplerState samplerAlbedo : register(s3);
 
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 128
+
+[[vk::constant_id(0)]] const bool PACKED_GBUFFER = false;
+
 struct Light {
+	// xyz: position, w: range
 	float4 position;
 	float3 color;
 	float radius;
+	// xyz: spot direction, w: cosine of the cone angle (-2 for point lights)
+	float4 direction;
 };
 
 struct UBO
 {
-	Light lights[6];
+	float4x4 view;
+	float4x4 invProjection;
+	float4x4 invViewProjection;
 	float4 viewPos;
 	int displayDebugTarget;
+	int lightCount;
+	float2 uvScale;
+	int2 renderExtent;
+	int clustered;
+	float zNear;
+	float zFar;
 };
 
 cbuffer ubo : register(b4) { UBO ubo; }
 
+StructuredBuffer<Light> lights : register(t5);
+
+// Light lists written by clusters.comp
+StructuredBuffer<uint> clusterData : register(t6);
+
+float3 decodeNormal(float2 e)
+{
+	e = e * 2.0 - 1.0;
+	float3 n = float3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += float2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+float3 shade(Light light, float3 fragPos, float3 normal, float4 albedo)
+{
+	// Vector to light
+	float3 L = light.position.xyz - fragPos;
+	// Distance from light to fragment position
+	float dist = length(L);
+
+	// Viewer to fragment
+	float3 V = ubo.viewPos.xyz - fragPos;
+	V = normalize(V);
+
+	// Light to fragment
+	L = normalize(L);
+
+	// Attenuation, faded out towards the light's range so lights outside of a cluster don't contribute
+	float atten = light.radius / (pow(dist, 2.0) + 1.0);
+	float window = clamp(1.0 - pow(dist / light.position.w, 4.0), 0.0, 1.0);
+	atten *= window * window;
+	// Spot cone
+	atten *= smoothstep(light.direction.w, light.direction.w + 0.05, dot(-L, light.direction.xyz));
+
+	// Diffuse part
+	float3 N = normalize(normal);
+	float NdotL = max(0.0, dot(N, L));
+	float3 diff = light.color * albedo.rgb * NdotL * atten;
+
+	// Specular part
+	// Specular map values are stored in alpha of albedo mrt
+	float3 R = reflect(-L, N);
+	float NdotR = max(0.0, dot(R, V));
+	float3 spec = light.color * albedo.a * pow(NdotR, 16.0) * atten;
+
+	return diff + spec;
+}
+
 
 float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 {
-	// Get G-Buffer values
-	float3 fragPos = textureposition.Sample(samplerposition, inUV).rgb;
-	float3 normal = textureNormal.Sample(samplerNormal, inUV).rgb;
-	float4 albedo = textureAlbedo.Sample(samplerAlbedo, inUV);
+	// Get G-Buffer values, the scene is rendered to the top left part of the attachments
+	float2 uv = inUV * ubo.uvScale;
+	float3 fragPos;
+	float3 normal;
+	if (PACKED_GBUFFER) {
+		float4 pos = mul(ubo.invViewProjection, float4(inUV * 2.0 - 1.0, textureposition.Sample(samplerposition, uv).r, 1.0));
+		fragPos = pos.xyz / pos.w;
+		normal = decodeNormal(textureNormal.Sample(samplerNormal, uv).rg);
+	} else {
+		fragPos = textureposition.Sample(samplerposition, uv).rgb;
+		normal = textureNormal.Sample(samplerNormal, uv).rgb;
+	}
+	float4 albedo = textureAlbedo.Sample(samplerAlbedo, uv);
 
 	float3 fragcolor;
 
@@ -51,43 +128,24 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 		return float4(fragcolor, 1.0);
 	}
 
-	#define lightCount 6
 	#define ambient 0.0
 
 	// Ambient part
 	fragcolor = albedo.rgb * ambient;
 
-	for(int i = 0; i < lightCount; ++i)
-	{
-		// Vector to light
-		float3 L = ubo.lights[i].position.xyz - fragPos;
-		// Distance from light to fragment position
-		float dist = length(L);
-
-		// Viewer to fragment
-		float3 V = ubo.viewPos.xyz - fragPos;
-		V = normalize(V);
-
-		//if(dist < ubo.lights[i].radius)
-		{
-			// Light to fragment
-			L = normalize(L);
-
-			// Attenuation
-			float atten = ubo.lights[i].radius / (pow(dist, 2.0) + 1.0);
-
-			// Diffuse part
-			float3 N = normalize(normal);
-			float NdotL = max(0.0, dot(N, L));
-			float3 diff = ubo.lights[i].color * albedo.rgb * NdotL * atten;
-
-			// Specular part
-			// Specular map values are stored in alpha of albedo mrt
-			float3 R = reflect(-L, N);
-			float NdotR = max(0.0, dot(R, V));
-			float3 spec = ubo.lights[i].color * albedo.a * pow(NdotR, 16.0) * atten;
-
-			fragcolor += diff + spec;
+	if (ubo.clustered == 1) {
+		// Only the lights binned into the fragment's cluster
+		uint2 tile = min(uint2(inUV * float2(CLUSTER_X, CLUSTER_Y)), uint2(CLUSTER_X - 1, CLUSTER_Y - 1));
+		float depth = -mul(ubo.view, float4(fragPos, 1.0)).z;
+		uint slice = uint(clamp(log(depth / ubo.zNear) / log(ubo.zFar / ubo.zNear) * float(CLUSTER_Z), 0.0, float(CLUSTER_Z - 1)));
+		uint cluster = ((slice * CLUSTER_Y + tile.y) * CLUSTER_X + tile.x) * (MAX_LIGHTS_PER_CLUSTER + 1);
+		uint count = clusterData[cluster];
+		for (uint i = 0; i < count; i++) {
+			fragcolor += shade(lights[clusterData[cluster + 1 + i]], fragPos, normal, albedo);
+		}
+	} else {
+		for (int i = 0; i < ubo.lightCount; ++i) {
+			fragcolor += shade(lights[i], fragPos, normal, albedo);
 		}
 	}
 
@@ -1,5 +1,6 @@
 // Copyright 2020 Google LLC
 
+// Depth instead of positions for the packed G-Buffer
 Texture2DMS<float4> texturePosition : register(t1);
 SamplerState samplerPosition : register(s1);
 Texture2DMS<float4> textureNormal : register(t2);
@@ -17,12 +18,14 @@ struct UBO
 {
 	Light lights[6];
 	float4 viewPos;
+	float4x4 invViewProjection;
 	int debugDisplayTarget;
 };
 
 cbuffer ubo : register(b4) { UBO ubo; }
 
 [[vk::constant_id(0)]] const int NUM_SAMPLES = 8;
+[[vk::constant_id(1)]] const bool PACKED_GBUFFER = false;
 
 #define NUM_LIGHTS 6
 
@@ -40,6 +43,37 @@ float4 resolve(Texture2DMS<float4> tex, int2 uv)
 	return result / float(NUM_SAMPLES);
 }
 
+float3 decodeNormal(float2 e)
+{
+	e = e * 2.0 - 1.0;
+	float3 n = float3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += float2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+float3 fetchPosition(int2 uv, int sampleIndex)
+{
+	uint status = 0;
+	if (PACKED_GBUFFER) {
+		int2 attDim; int sampleCount;
+		texturePosition.GetDimensions(attDim.x, attDim.y, sampleCount);
+		float2 ndc = (float2(uv) + 0.5) / float2(attDim) * 2.0 - 1.0;
+		float4 pos = mul(ubo.invViewProjection, float4(ndc, texturePosition.Load(uv, sampleIndex, int2(0, 0), status).r, 1.0));
+		return pos.xyz / pos.w;
+	}
+	return texturePosition.Load(uv, sampleIndex, int2(0, 0), status).rgb;
+}
+
+float3 fetchNormal(int2 uv, int sampleIndex)
+{
+	uint status = 0;
+	if (PACKED_GBUFFER) {
+		return decodeNormal(textureNormal.Load(uv, sampleIndex, int2(0, 0), status).rg);
+	}
+	return textureNormal.Load(uv, sampleIndex, int2(0, 0), status).rgb;
+}
+
 float3 calculateLighting(float3 pos, float3 normal, float4 albedo)
 {
 	float3 result = float3(0.0, 0.0, 0.0);
@@ -89,10 +123,10 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 	if (ubo.debugDisplayTarget > 0) {
 		switch (ubo.debugDisplayTarget) {
 			case 1: 
-				fragColor.rgb = texturePosition.Load(UV, 0, int2(0, 0), status).rgb;
+				fragColor.rgb = fetchPosition(UV, 0);
 				break;
 			case 2: 
-				fragColor.rgb = textureNormal.Load(UV, 0, int2(0, 0), status).rgb;
+				fragColor.rgb = fetchNormal(UV, 0);
 				break;
 			case 3: 
 				fragColor.rgb = textureAlbedo.Load(UV, 0, int2(0, 0), status).rgb;
@@ -113,8 +147,8 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 	// Calualte lighting for every MSAA sample
 	for (int i = 0; i < NUM_SAMPLES; i++)
 	{
-		float3 pos = texturePosition.Load(UV, i, int2(0, 0), status).rgb;
-		float3 normal = textureNormal.Load(UV, i, int2(0, 0), status).rgb;
+		float3 pos = fetchPosition(UV, i);
+		float3 normal = fetchNormal(UV, i);
 		float4 albedo = textureAlbedo.Load(UV, i, int2(0, 0), status);
 		fragColor += calculateLighting(pos, normal, albedo);
 	}
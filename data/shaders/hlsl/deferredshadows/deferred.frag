@@ -1,48 +1,68 @@
 // Copyright 2020 Google LLC
 
+// Depth instead of positions for the packed G-Buffer
 Texture2D textureposition : register(t1);
 SamplerState samplerposition : register(s1);
 Texture2D textureNormal : register(t2);
 SamplerState samplerNormal : register(s2);
 Texture2D textureAlbedo : register(t3);
 SamplerState samplerAlbedo : register(s3);
-// Depth from the light's point of view
-//layout (binding = 5) uniform sampler2DShadow samplerShadowMap;
-Texture2DArray textureShadowMap : register(t5);
+// Shadow atlas with one tile per light
+Texture2D textureShadowMap : register(t5);
 SamplerState samplerShadowMap : register(s5);
 
-#define LIGHT_COUNT 3
+#define LIGHT_COUNT 32
 #define SHADOW_FACTOR 0.25
 #define AMBIENT_LIGHT 0.1
 #define USE_PCF
 
+[[vk::constant_id(0)]] const bool PACKED_GBUFFER = false;
+
 struct Light
 {
 	float4 position;
 	float4 target;
 	float4 color;
 	float4x4 viewMatrix;
+	// Offset (xy) and scale (zw) of the light's shadow atlas tile, zero if the light has no tile
+	float4 shadowRect;
 };
 
 struct UBO
 {
 	float4 viewPos;
 	Light lights[LIGHT_COUNT];
+	float4x4 invViewProjection;
 	int useShadows;
 	int displayDebugTarget;
+	int lightCount;
 };
 
 cbuffer ubo : register(b4) { UBO ubo; }
 
-float textureProj(float4 P, float layer, float2 offset)
+float3 decodeNormal(float2 e)
+{
+	e = e * 2.0 - 1.0;
+	float3 n = float3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += float2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+float textureProj(float4 P, float4 rect, float2 offset)
 {
 	float shadow = 1.0;
 	float4 shadowCoord = P / P.w;
 	shadowCoord.xy = shadowCoord.xy * 0.5 + 0.5;
 
-	if (shadowCoord.z > -1.0 && shadowCoord.z < 1.0)
+	if (shadowCoord.z > -1.0 && shadowCoord.z < 1.0 && all(shadowCoord.xy >= 0.0) && all(shadowCoord.xy <= 1.0))
 	{
-		float dist = textureShadowMap.Sample(samplerShadowMap, float3(shadowCoord.xy + offset, layer)).r;
+		// Map to the light's tile, clamped half a texel inside so filtering never reads from a neighbouring tile
+		int2 texDim; int levels;
+		textureShadowMap.GetDimensions(0, texDim.x, texDim.y, levels);
+		float2 halfTexel = 0.5 / float2(texDim);
+		float2 uv = clamp(rect.xy + (shadowCoord.xy + offset) * rect.zw, rect.xy + halfTexel, rect.xy + rect.zw - halfTexel);
+		float dist = textureShadowMap.Sample(samplerShadowMap, uv).r;
 		if (shadowCoord.w > 0.0 && dist < shadowCoord.z)
 		{
 			shadow = SHADOW_FACTOR;
@@ -51,13 +71,15 @@ float textureProj(float4 P, float layer, float2 offset)
 	return shadow;
 }
 
-float filterPCF(float4 sc, float layer)
+float filterPCF(float4 sc, float4 rect)
 {
-	int2 texDim; int elements; int levels;
-	textureShadowMap.GetDimensions(0, texDim.x, texDim.y, elements, levels);
+	// Offsets are in tile texels, tiles have different resolutions
+	int2 atlasDim; int levels;
+	textureShadowMap.GetDimensions(0, atlasDim.x, atlasDim.y, levels);
+	float2 texDim = float2(atlasDim) * rect.zw;
 	float scale = 1.5;
-	float dx = scale * 1.0 / float(texDim.x);
-	float dy = scale * 1.0 / float(texDim.y);
+	float dx = scale * 1.0 / texDim.x;
+	float dy = scale * 1.0 / texDim.y;
 
 	float shadowFactor = 0.0;
 	int count = 0;
@@ -67,7 +89,7 @@ float filterPCF(float4 sc, float layer)
 	{
 		for (int y = -range; y <= range; y++)
 		{
-			shadowFactor += textureProj(sc, layer, float2(dx*x, dy*y));
+			shadowFactor += textureProj(sc, rect, float2(dx*x, dy*y));
 			count++;
 		}
 
@@ -75,28 +97,33 @@ float filterPCF(float4 sc, float layer)
 	return shadowFactor / count;
 }
 
-float3 shadow(float3 fragcolor, float3 fragPos) {
-	for (int i = 0; i < LIGHT_COUNT; ++i)
-	{
-		float4 shadowClip = mul(ubo.lights[i].viewMatrix, float4(fragPos.xyz, 1.0));
-
-		float shadowFactor;
-		#ifdef USE_PCF
-			shadowFactor= filterPCF(shadowClip, i);
-		#else
-			shadowFactor = textureProj(shadowClip, i, float2(0.0, 0.0));
-		#endif
-
-		fragcolor *= shadowFactor;
+float shadow(int light, float3 fragPos) {
+	float4 rect = ubo.lights[light].shadowRect;
+	// Lights that didn't get a tile of the atlas don't cast shadows
+	if (rect.z == 0.0) {
+		return 1.0;
 	}
-	return fragcolor;
+	float4 shadowClip = mul(ubo.lights[light].viewMatrix, float4(fragPos.xyz, 1.0));
+	#ifdef USE_PCF
+		return filterPCF(shadowClip, rect);
+	#else
+		return textureProj(shadowClip, rect, float2(0.0, 0.0));
+	#endif
 }
 
 float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 {
 	// Get G-Buffer values
-	float3 fragPos = textureposition.Sample(samplerposition, inUV).rgb;
-	float3 normal = textureNormal.Sample(samplerNormal, inUV).rgb;
+	float3 fragPos;
+	float3 normal;
+	if (PACKED_GBUFFER) {
+		float4 pos = mul(ubo.invViewProjection, float4(inUV * 2.0 - 1.0, textureposition.Sample(samplerposition, inUV).r, 1.0));
+		fragPos = pos.xyz / pos.w;
+		normal = decodeNormal(textureNormal.Sample(samplerNormal, inUV).rg);
+	} else {
+		fragPos = textureposition.Sample(samplerposition, inUV).rgb;
+		normal = textureNormal.Sample(samplerNormal, inUV).rgb;
+	}
 	float4 albedo = textureAlbedo.Sample(samplerAlbedo, inUV);
 
 	float3 fragcolor;
@@ -105,7 +132,10 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 	if (ubo.displayDebugTarget > 0) {
 		switch (ubo.displayDebugTarget) {
 			case 1: 
-				fragcolor.rgb = shadow(float3(1.0, 1.0, 1.0), fragPos);
+				fragcolor.rgb = float3(1.0, 1.0, 1.0);
+				for (int i = 0; i < ubo.lightCount; ++i) {
+					fragcolor.rgb *= shadow(i, fragPos);
+				}
 				break;
 			case 2: 
 				fragcolor.rgb = fragPos;
@@ -128,7 +158,7 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 
 	float3 N = normalize(normal);
 
-	for(int i = 0; i < LIGHT_COUNT; ++i)
+	for(int i = 0; i < ubo.lightCount; ++i)
 	{
 		// Vector to light
 		float3 L = ubo.lights[i].position.xyz - fragPos;
@@ -142,7 +172,7 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 
 		float lightCosInnerAngle = cos(radians(15.0));
 		float lightCosOuterAngle = cos(radians(25.0));
-		float lightRange = 100.0;
+		float lightRange = ubo.lights[i].target.w;
 
 		// Direction vector from source to target
 		float3 dir = normalize(ubo.lights[i].position.xyz - ubo.lights[i].target.xyz);
@@ -151,6 +181,11 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 		float cosDir = dot(L, dir);
 		float spotEffect = smoothstep(lightCosOuterAngle, lightCosInnerAngle, cosDir);
 		float heightAttenuation = smoothstep(lightRange, 0.0f, dist);
+		float attenuation = spotEffect * heightAttenuation;
+		// Skip the shadow lookup for fragments outside of the light's cone and range
+		if (attenuation <= 0.0) {
+			continue;
+		}
 
 		// Diffuse lighting
 		float NdotL = max(0.0, dot(N, L));
@@ -161,13 +196,10 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 		float NdotR = max(0.0, dot(R, V));
 		float3 spec = (pow(NdotR, 16.0) * albedo.a * 2.5).xxx;
 
-		fragcolor += float3((diff + spec) * spotEffect * heightAttenuation) * ubo.lights[i].color.rgb * albedo.rgb;
-	}
+		// Shadows are applied per light, so a fragment shadowed from one light is still lit by the others
+		float shadowFactor = (ubo.useShadows > 0) ? shadow(i, fragPos) : 1.0;
 
-	// Shadow calculations in a separate pass
-	if (ubo.useShadows > 0)
-	{
-		fragcolor = shadow(fragcolor, fragPos);
+		fragcolor += float3((diff + spec) * attenuation * shadowFactor) * ubo.lights[i].color.rgb * albedo.rgb;
 	}
 
 	return float4(fragcolor, 1);
@@ -5,6 +5,9 @@ SamplerState samplerColor : register(s1);
 Texture2D textureNormalMap : register(t2);
 SamplerState samplerNormalMap : register(s2);
 
+// Packed G-Buffer: no position attachment (reconstructed from depth), octahedral encoded normals in two channels
+[[vk::constant_id(0)]] const bool PACKED_GBUFFER = false;
+
 struct VSOutput
 {
 [[vk::location(0)]] float3 Normal : NORMAL0;
@@ -12,19 +15,36 @@ struct VSOutput
 [[vk::location(2)]] float3 Color : COLOR0;
 [[vk::location(3)]] float3 WorldPos : POSITION0;
 [[vk::location(4)]] float3 Tangent : TEXCOORD1;
+[[vk::location(5)]] float4 CurrentPos : POSITION1;
+[[vk::location(6)]] float4 PrevPos : POSITION2;
 };
 
 struct FSOutput
 {
-	float4 Position : SV_TARGET0;
-	float4 Normal : SV_TARGET1;
-	float4 Albedo : SV_TARGET2;
+	float4 Normal : SV_TARGET0;
+	float4 Albedo : SV_TARGET1;
+	// Screen space motion since the previous frame in texture coordinates, for temporal anti-aliasing
+	float2 Velocity : SV_TARGET2;
+	// Last, so the packed G-Buffer (which has no position attachment) keeps the same attachment indices for the other outputs
+	float4 Position : SV_TARGET3;
 };
 
+float2 octWrap(float2 v)
+{
+	return (1.0 - abs(v.yx)) * float2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Maps a unit vector onto the octahedron unfolded into [0..1]
+float2 encodeNormal(float3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	n.xy = n.z >= 0.0 ? n.xy : octWrap(n.xy);
+	return n.xy * 0.5 + 0.5;
+}
+
 FSOutput main(VSOutput input)
 {
 	FSOutput output = (FSOutput)0;
-	output.Position = float4(input.WorldPos, 1.0);
 
 	// Calculate normal in tangent space
 	float3 N = normalize(input.Normal);
@@ -32,8 +52,16 @@ FSOutput main(VSOutput input)
 	float3 B = cross(N, T);
 	float3x3 TBN = float3x3(T, B, N);
 	float3 tnorm = mul(normalize(textureNormalMap.Sample(samplerNormalMap, input.UV).xyz * 2.0 - float3(1.0, 1.0, 1.0)), TBN);
-	output.Normal = float4(tnorm, 1.0);
 
 	output.Albedo = textureColor.Sample(samplerColor, input.UV);
+
+	if (PACKED_GBUFFER) {
+		output.Normal = float4(encodeNormal(normalize(tnorm)), 0.0, 1.0);
+	} else {
+		output.Normal = float4(tnorm, 1.0);
+		output.Position = float4(input.WorldPos, 1.0);
+	}
+
+	output.Velocity = (input.CurrentPos.xy / input.CurrentPos.w - input.PrevPos.xy / input.PrevPos.w) * 0.5;
 	return output;
-}
\ No newline at end of file
+}
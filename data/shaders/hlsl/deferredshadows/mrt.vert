@@ -15,6 +15,9 @@ struct UBO
 	float4x4 model;
 	float4x4 view;
 	float4 instancePos[3];
+	// Unjittered, for the velocity
+	float4x4 viewProjection;
+	float4x4 prevViewProjection;
 };
 
 cbuffer ubo : register(b0) { UBO ubo; }
@@ -27,6 +30,8 @@ struct VSOutput
 [[vk::location(2)]] float3 Color : COLOR0;
 [[vk::location(3)]] float3 WorldPos : POSITION0;
 [[vk::location(4)]] float3 Tangent : TEXCOORD1;
+[[vk::location(5)]] float4 CurrentPos : POSITION1;
+[[vk::location(6)]] float4 PrevPos : POSITION2;
 };
 
 VSOutput main(VSInput input, uint InstanceIndex : SV_InstanceID)
@@ -41,6 +46,10 @@ VSOutput main(VSInput input, uint InstanceIndex : SV_InstanceID)
 	// Vertex position in world space
 	output.WorldPos = mul(ubo.model, tmpPos).xyz;
 
+	// The scene is static, so only the camera moves the vertex between frames
+	output.CurrentPos = mul(ubo.viewProjection, float4(output.WorldPos, 1.0));
+	output.PrevPos = mul(ubo.prevViewProjection, float4(output.WorldPos, 1.0));
+
 	// Normal in world space
 	output.Normal = normalize(input.Normal);
 	output.Tangent = normalize(input.Tangent);
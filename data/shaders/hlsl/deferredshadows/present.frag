@@ -0,0 +1,10 @@
+// Copyright 2020 Google LLC
+
+// Composition resolved with temporal anti-aliasing
+Texture2D textureResolved : register(t0);
+SamplerState samplerResolved : register(s0);
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	return float4(textureResolved.Sample(samplerResolved, inUV).rgb, 1.0);
+}
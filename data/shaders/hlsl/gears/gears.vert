@@ -4,20 +4,29 @@ struct VSInput
 {
 [[vk::location(0)]] float4 Pos : POSITION0;
 [[vk::location(1)]] float3 Normal : NORMAL0;
-[[vk::location(2)]] float3 Color : COLOR0;
+uint InstanceIndex : SV_InstanceID;
 };
 
 struct UBO
 {
 	float4x4 projection;
-	float4x4 model;
-	float4x4 normal;
 	float4x4 view;
-	float3 lightpos;
+	float4 lightpos;
+	float time;
 };
 
 cbuffer ubo : register(b0) { UBO ubo; }
 
+struct GearInstance
+{
+	// xyz = position, w = rotation offset in degrees
+	float4 pos;
+	// rgb = color, w = rotation speed
+	float4 color;
+};
+
+StructuredBuffer<GearInstance> instances : register(t1);
+
 struct VSOutput
 {
 	float4 Pos : SV_POSITION;
@@ -30,13 +39,22 @@ struct VSOutput
 VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
-	output.Normal = normalize(mul((float4x3)ubo.normal, input.Normal).xyz);
-	output.Color = input.Color;
-	float4x4 modelView = mul(ubo.view, ubo.model);
+	GearInstance instance = instances[input.InstanceIndex];
+	float angle = radians(instance.color.w * ubo.time + instance.pos.w);
+	float s = sin(angle);
+	float c = cos(angle);
+	float4x4 model = float4x4(
+		c, -s, 0.0, instance.pos.x,
+		s, c, 0.0, instance.pos.y,
+		0.0, 0.0, 1.0, instance.pos.z,
+		0.0, 0.0, 0.0, 1.0);
+	float4x4 modelView = mul(ubo.view, model);
+	output.Normal = normalize(mul((float3x3)modelView, input.Normal));
+	output.Color = instance.color.rgb;
 	float4 pos = mul(modelView, input.Pos);
 	output.EyePos = mul(modelView, pos).xyz;
-	float4 lightPos = mul(float4(ubo.lightpos, 1.0), modelView);
+	float4 lightPos = mul(float4(ubo.lightpos.xyz, 1.0), modelView);
 	output.LightVec = normalize(lightPos.xyz - output.EyePos);
 	output.Pos = mul(ubo.projection, pos);
 	return output;
-}
\ No newline at end of file
+}
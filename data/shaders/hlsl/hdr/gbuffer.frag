@@ -19,6 +19,8 @@ struct FSOutput
 };
 
 [[vk::constant_id(0)]] const int type = 0;
+// Write the linear scene color and leave exposure and bloom to the fused tone mapping pass
+[[vk::constant_id(1)]] const int linearOutput = 0;
 
 #define PI 3.1415926
 #define TwoPI (2.0 * PI)
@@ -96,6 +98,12 @@ FSOutput main(VSOutput input)
 	}
 
 
+	if (linearOutput == 1) {
+		output.Color0 = float4(color.rgb, 1.0);
+		output.Color1 = float4(0.0, 0.0, 0.0, 0.0);
+		return output;
+	}
+
 	// Color with manual exposure into attachment 0
 	output.Color0.rgb = float3(1.0, 1.0, 1.0) - exp(-color.rgb * exposure);
 
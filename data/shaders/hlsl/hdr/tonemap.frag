@@ -0,0 +1,26 @@
+// Copyright 2020 Google LLC
+
+// Fused bloom composition and tone mapping, replaces the composition and second bloom pass when the scene is rendered with linear output
+
+Texture2D textureColor : register(t0);
+SamplerState samplerColor : register(s0);
+// Result of the compute bloom chain (vks::BloomChain)
+Texture2D textureBloom : register(t1);
+SamplerState samplerBloom : register(s1);
+
+cbuffer Params : register(b2)
+{
+	float exposure;
+	float bloomStrength;
+}
+
+[[vk::constant_id(0)]] const int applyBloom = 1;
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float3 color = textureColor.Sample(samplerColor, inUV).rgb;
+	if (applyBloom == 1) {
+		color += textureBloom.Sample(samplerBloom, inUV).rgb * bloomStrength;
+	}
+	return float4(float3(1.0, 1.0, 1.0) - exp(-color * exposure), 1.0);
+}
@@ -0,0 +1,97 @@
+// Copyright 2020 Google LLC
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 Color : COLOR0;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 modelview;
+	float4 lightPos;
+	float locSpeed;
+	float globSpeed;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+// Instance data as uploaded by the example, two float4 per instance: xyz = position, w = rotation x and x = rotation y, y = rotation z, z = scale, w = texture index
+StructuredBuffer<float4> instances : register(t2);
+
+// Indices of the visible instances written by the culling pass, the indirect draw of each level of detail starts at its range
+StructuredBuffer<uint> visibleInstances : register(t3);
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float3 UV : TEXCOORD0;
+[[vk::location(3)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(4)]] float3 LightVec : TEXCOORD2;
+};
+
+VSOutput main(VSInput input, uint InstanceIndex : SV_InstanceID)
+{
+	// SV_InstanceID includes the first instance of the indirect draw
+	uint instanceIndex = visibleInstances[InstanceIndex];
+	float4 data0 = instances[instanceIndex * 2];
+	float4 data1 = instances[instanceIndex * 2 + 1];
+	float3 instancePos = data0.xyz;
+	float3 instanceRot = float3(data0.w, data1.xy);
+	float instanceScale = data1.z;
+
+	VSOutput output = (VSOutput)0;
+	output.Color = input.Color;
+	output.UV = float3(input.UV, float(asuint(data1.w)));
+
+	// rotate around x
+	float s = sin(instanceRot.x + ubo.locSpeed);
+	float c = cos(instanceRot.x + ubo.locSpeed);
+
+	float3x3 mx = { c, -s, 0.0,
+					s, c, 0.0,
+					0.0, 0.0, 1.0 };
+
+	// rotate around y
+	s = sin(instanceRot.y + ubo.locSpeed);
+	c = cos(instanceRot.y + ubo.locSpeed);
+
+	float3x3 my = { c, 0.0, -s,
+					0.0, 1.0, 0.0,
+					s, 0.0, c };
+
+	// rot around z
+	s = sin(instanceRot.z + ubo.locSpeed);
+	c = cos(instanceRot.z + ubo.locSpeed);
+
+	float3x3 mz = { 1.0, 0.0, 0.0,
+					0.0, c, -s,
+					0.0, s, c };
+
+	float3x3 rotMat = mul(mz, mul(my, mx));
+
+	float4x4 gRotMat;
+	s = sin(instanceRot.y + ubo.globSpeed);
+	c = cos(instanceRot.y + ubo.globSpeed);
+	gRotMat[0] = float4(c, 0.0, -s, 0.0);
+	gRotMat[1] = float4(0.0, 1.0, 0.0, 0.0);
+	gRotMat[2] = float4(s, 0.0, c, 0.0);
+	gRotMat[3] = float4(0.0, 0.0, 0.0, 1.0);
+
+	float4 locPos = float4(mul(rotMat, input.Pos.xyz), 1.0);
+	float4 pos = float4((locPos.xyz * instanceScale) + instancePos, 1.0);
+
+	output.Pos = mul(ubo.projection, mul(ubo.modelview, mul(gRotMat, pos)));
+	output.Normal = mul((float3x3)mul(ubo.modelview, gRotMat), mul(rotMat, input.Normal));
+
+	pos = mul(ubo.modelview, float4(input.Pos.xyz + instancePos, 1.0));
+	float3 lPos = mul((float3x3)ubo.modelview, ubo.lightPos.xyz);
+	output.LightVec = lPos - pos.xyz;
+	output.ViewVec = -pos.xyz;
+	return output;
+}
@@ -25,8 +25,15 @@ struct UBO
 
 cbuffer ubo : register(b0) { UBO ubo; }
 
-VSOutput main(VSInput input, uint ViewIndex : SV_ViewID)
+// Selects the view when each view is rendered in a pass of its own, SV_ViewID is 0 outside of multiview render passes
+struct PushConsts {
+	int viewOffset;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+VSOutput main(VSInput input, uint ViewID : SV_ViewID)
 {
+	uint ViewIndex = ViewID + pushConsts.viewOffset;
 	VSOutput output = (VSOutput)0;
 	output.Color = input.Color;
 	output.Normal = mul((float3x3)ubo.modelview[ViewIndex], input.Normal);
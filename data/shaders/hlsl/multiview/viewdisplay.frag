@@ -6,6 +6,7 @@ SamplerState samplerView : register(s1);
 struct UBO
 {
 	[[vk::offset(272)]] float distortionAlpha;
+	[[vk::offset(280)]] float2 uvScale;
 };
 
 cbuffer ubo : register(b0) { UBO ubo; }
@@ -21,5 +22,6 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 	p2 = (p2 + 1.0) * 0.5;
 
 	bool inside = ((p2.x >= 0.0) && (p2.x <= 1.0) && (p2.y >= 0.0 ) && (p2.y <= 1.0));
-	return inside ? textureView.Sample(samplerView, float3(p2, VIEW_LAYER)) : float4(0.0, 0.0, 0.0, 0.0);
+	// The views are rendered to the top left part of the attachment
+	return inside ? textureView.Sample(samplerView, float3(p2 * ubo.uvScale, VIEW_LAYER)) : float4(0.0, 0.0, 0.0, 0.0);
 }
\ No newline at end of file
@@ -19,7 +19,9 @@ float4 main(VSOutput input, bool FrontFacing : SV_IsFrontFace) : SV_TARGET
 
 	// Slow single pass blur
 	// For demonstration purposes only
-	const float blurSize = 1.0 / 512.0;
+	float2 textureSize;
+	textureColor.GetDimensions(textureSize.x, textureSize.y);
+	const float2 blurSize = 1.0 / textureSize;
 
 	float4 color = float4(float3(0.0, 0.0, 0.0), 1.);
 
@@ -31,7 +33,7 @@ float4 main(VSOutput input, bool FrontFacing : SV_IsFrontFace) : SV_TARGET
 		{
 			for (int y = -3; y <= 3; y++)
 			{
-				reflection += textureColor.Sample(samplerColor, float2(projCoord.x + x * blurSize, projCoord.y + y * blurSize)) / 49.0;
+				reflection += textureColor.Sample(samplerColor, float2(projCoord.x + x * blurSize.x, projCoord.y + y * blurSize.y)) / 49.0;
 			}
 		}
 		color += reflection;
@@ -10,6 +10,7 @@ struct UBO
 	float4x4 projection;
 	float4x4 view;
 	float4x4 model;
+	float4x4 reflectionViewProjection;
 };
 
 cbuffer ubo : register(b0) { UBO ubo; }
@@ -23,7 +24,8 @@ struct VSOutput
 VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
-	output.ProjCoord = mul(ubo.projection, mul(ubo.view, mul(ubo.model, float4(input.Pos.xyz, 1.0))));
-	output.Pos = output.ProjCoord;
+	output.Pos = mul(ubo.projection, mul(ubo.view, mul(ubo.model, float4(input.Pos.xyz, 1.0))));
+	// The reflection may have been rendered with an older view projection, look it up where it was rendered
+	output.ProjCoord = mul(ubo.reflectionViewProjection, mul(ubo.model, float4(input.Pos.xyz, 1.0)));
 	return output;
 }
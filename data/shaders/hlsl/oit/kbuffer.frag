@@ -0,0 +1,44 @@
+// Copyright 2020 Sascha Willems
+
+// Stores the first KBUFFER_LAYER_COUNT fragments of each pixel in fixed per pixel slots, memory doesn't depend on the scene
+
+#define KBUFFER_LAYER_COUNT 8
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+};
+
+RWTexture2D<uint> fragmentCountImage : register(u2);
+
+// Layer major, packed color and depth of the fragment
+RWStructuredBuffer<uint2> fragments : register(u3);
+
+struct PushConsts {
+	float4x4 model;
+	float4 color;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+uint packUnorm4x8(float4 value)
+{
+    uint4 bytes = uint4(round(saturate(value) * 255.0));
+    return bytes.x | (bytes.y << 8) | (bytes.z << 16) | (bytes.w << 24);
+}
+
+[earlydepthstencil]
+void main(VSOutput input)
+{
+    uint2 coord = uint2(input.Pos.xy);
+    uint layer;
+    InterlockedAdd(fragmentCountImage[coord], 1, layer);
+
+    // Fragments beyond the layer count are dropped
+    if (layer < KBUFFER_LAYER_COUNT)
+    {
+        uint width, height;
+        fragmentCountImage.GetDimensions(width, height);
+        uint index = (layer * height + coord.y) * width + coord.x;
+        fragments[index] = uint2(packUnorm4x8(pushConsts.color), asuint(input.Pos.z));
+    }
+}
@@ -0,0 +1,54 @@
+// Copyright 2020 Sascha Willems
+
+#define KBUFFER_LAYER_COUNT 8
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+};
+
+RWTexture2D<uint> fragmentCountImage : register(u0);
+
+RWStructuredBuffer<uint2> fragments : register(u1);
+
+float4 unpackUnorm4x8(uint value)
+{
+    return float4(value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, value >> 24) / 255.0;
+}
+
+float4 main(VSOutput input) : SV_TARGET
+{
+    uint2 coord = uint2(input.Pos.xy);
+    uint width, height;
+    fragmentCountImage.GetDimensions(width, height);
+    uint count = min(fragmentCountImage[coord], KBUFFER_LAYER_COUNT);
+
+    uint2 layers[KBUFFER_LAYER_COUNT];
+    for (uint l = 0; l < count; ++l)
+    {
+        layers[l] = fragments[(l * height + coord.y) * width + coord.x];
+    }
+
+    // Do the insertion sort, depth values are positive so their bit patterns sort like the values
+    for (uint i = 1; i < count; ++i)
+    {
+        uint2 insert = layers[i];
+        uint j = i;
+        while (j > 0 && insert.y > layers[j - 1].y)
+        {
+            layers[j] = layers[j - 1];
+            --j;
+        }
+        layers[j] = insert;
+    }
+
+    // Do blending
+    float4 color = float4(0.025, 0.025, 0.025, 1.0f);
+    for (uint f = 0; f < count; ++f)
+    {
+        float4 fragmentColor = unpackUnorm4x8(layers[f].x);
+        color = lerp(color, fragmentColor, fragmentColor.a);
+    }
+
+    return color;
+}
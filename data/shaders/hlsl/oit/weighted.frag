@@ -0,0 +1,34 @@
+// Copyright 2020 Sascha Willems
+
+// Weighted blended order independent transparency (McGuire and Bavoil), accumulates all fragments without storing them
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+};
+
+struct FSOutput
+{
+	float4 Accumulation : SV_TARGET0;
+	float Revealage : SV_TARGET1;
+};
+
+struct PushConsts {
+	float4x4 model;
+	float4 color;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+FSOutput main(VSOutput input)
+{
+    FSOutput output = (FSOutput)0;
+    float4 color = pushConsts.color;
+
+    // Depth based weight, nearer fragments dominate the average
+    float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - input.Pos.z * 0.9, 3.0), 1e-2, 3e3);
+
+    // Additively blended, the revealage attachment is multiplied by (1 - alpha)
+    output.Accumulation = float4(color.rgb * color.a, color.a) * weight;
+    output.Revealage = color.a;
+    return output;
+}
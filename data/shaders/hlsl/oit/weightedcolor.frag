@@ -0,0 +1,24 @@
+// Copyright 2020 Sascha Willems
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+};
+
+Texture2D textureAccumulation : register(t0);
+SamplerState samplerAccumulation : register(s0);
+Texture2D textureRevealage : register(t1);
+SamplerState samplerRevealage : register(s1);
+
+float4 main(VSOutput input) : SV_TARGET
+{
+    int3 coord = int3(input.Pos.xy, 0);
+    float4 accumulation = textureAccumulation.Load(coord);
+    float revealage = textureRevealage.Load(coord).r;
+
+    // Weighted average of the fragment colors, covering the background by the product of their transparencies
+    float3 average = accumulation.rgb / max(accumulation.a, 1e-5);
+    float3 background = float3(0.025, 0.025, 0.025);
+
+    return float4(lerp(background, average, 1.0 - revealage), 1.0);
+}
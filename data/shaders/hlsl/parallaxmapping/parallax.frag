@@ -4,6 +4,9 @@ Texture2D textureColorMap : register(t1);
 SamplerState samplerColorMap : register(s1);
 Texture2D textureNormalHeightMap : register(t2);
 SamplerState samplerNormalHeightMap : register(s2);
+// Height pyramid (vks::DepthPyramid of the height channel), R = maximum and G = minimum height covered by a texel
+Texture2D textureHeightPyramid : register(t4);
+SamplerState samplerHeightPyramid : register(s4);
 
 struct UBO
 {
@@ -11,6 +14,10 @@ struct UBO
 	float parallaxBias;
 	float numLayers;
 	int mappingMode;
+	// Layer count of the adaptive mode for views along the surface normal
+	float minLayers;
+	int pyramidLevels;
+	int showFetches;
 };
 
 cbuffer ubo : register(b3) { UBO ubo; }
@@ -23,6 +30,12 @@ struct VSOutput
 [[vk::location(3)]] float3 TangentFragPos : TEXCOORD3;
 };
 
+// Upper bound for the cell steps of the hierarchical traversal
+#define MAX_HIERARCHY_STEPS 128
+
+// Height map fetches of the current fragment for the visualization
+static int heightFetches = 0;
+
 float2 parallaxMapping(float2 uv, float3 viewDir)
 {
 	float height = 1.0 - textureNormalHeightMap.SampleLevel(samplerNormalHeightMap, uv, 0.0).a;
@@ -37,10 +50,12 @@ float2 steepParallaxMapping(float2 uv, float3 viewDir)
 	float2 deltaUV = viewDir.xy * ubo.heightScale / (viewDir.z * ubo.numLayers);
 	float2 currUV = uv;
 	float height = 1.0 - textureNormalHeightMap.SampleLevel(samplerNormalHeightMap, currUV, 0.0).a;
+	heightFetches++;
 	for (int i = 0; i < ubo.numLayers; i++) {
 		currLayerDepth += layerDepth;
 		currUV -= deltaUV;
 		height = 1.0 - textureNormalHeightMap.SampleLevel(samplerNormalHeightMap, currUV, 0.0).a;
+		heightFetches++;
 		if (height < currLayerDepth) {
 			break;
 		}
@@ -48,27 +63,106 @@ float2 steepParallaxMapping(float2 uv, float3 viewDir)
 	return currUV;
 }
 
-float2 parallaxOcclusionMapping(float2 uv, float3 viewDir)
+float2 parallaxOcclusionMapping(float2 uv, float3 viewDir, float numLayers, float lod)
 {
-	float layerDepth = 1.0 / ubo.numLayers;
+	float layerDepth = 1.0 / numLayers;
 	float currLayerDepth = 0.0;
-	float2 deltaUV = viewDir.xy * ubo.heightScale / (viewDir.z * ubo.numLayers);
+	float2 deltaUV = viewDir.xy * ubo.heightScale / (viewDir.z * numLayers);
 	float2 currUV = uv;
-	float height = 1.0 - textureNormalHeightMap.SampleLevel(samplerNormalHeightMap, currUV, 0.0).a;
-	for (int i = 0; i < ubo.numLayers; i++) {
+	float height = 1.0 - textureNormalHeightMap.SampleLevel(samplerNormalHeightMap, currUV, lod).a;
+	heightFetches++;
+	for (int i = 0; i < numLayers; i++) {
 		currLayerDepth += layerDepth;
 		currUV -= deltaUV;
-		height = 1.0 - textureNormalHeightMap.SampleLevel(samplerNormalHeightMap, currUV, 0.0).a;
+		height = 1.0 - textureNormalHeightMap.SampleLevel(samplerNormalHeightMap, currUV, lod).a;
+		heightFetches++;
 		if (height < currLayerDepth) {
 			break;
 		}
 	}
 	float2 prevUV = currUV + deltaUV;
 	float nextDepth = height - currLayerDepth;
-	float prevDepth = 1.0 - textureNormalHeightMap.SampleLevel(samplerNormalHeightMap, prevUV, 0.0).a - currLayerDepth + layerDepth;
+	float prevDepth = 1.0 - textureNormalHeightMap.SampleLevel(samplerNormalHeightMap, prevUV, lod).a - currLayerDepth + layerDepth;
+	heightFetches++;
 	return lerp(currUV, prevUV, nextDepth / (nextDepth - prevDepth));
 }
 
+// Parallax occlusion mapping with a layer count that follows the view angle and the mip level of the height map: steep views
+// need fewer layers than grazing ones and every mip level halves the height map resolution the march has to resolve
+float2 adaptiveParallaxOcclusionMapping(float2 uv, float3 viewDir)
+{
+	float lod = max(textureNormalHeightMap.CalculateLevelOfDetailUnclamped(samplerNormalHeightMap, uv), 0.0);
+	float numLayers = lerp(ubo.numLayers, ubo.minLayers, abs(viewDir.z));
+	numLayers = max(floor(numLayers / exp2(lod)), ubo.minLayers);
+	return parallaxOcclusionMapping(uv, viewDir, numLayers, lod);
+}
+
+float2 pyramidLevelSize(int level)
+{
+	float width, height, levels;
+	textureHeightPyramid.GetDimensions(level, width, height, levels);
+	return float2(width, height);
+}
+
+// Relief mapping accelerated by the maximum heights of the height pyramid: the ray (with depth = 1 - height, as in the layer march)
+// skips every cell whose highest texel it passes above, descends into a cell where it drops below that height and goes back up a
+// level after leaving a cell. Flat or low areas are crossed in a few large steps instead of one fetch per layer.
+float2 hierarchicalReliefMapping(float2 uv, float3 viewDir)
+{
+	float2 deltaUV = viewDir.xy * ubo.heightScale / viewDir.z;
+	float2 rayDir = -deltaUV;
+	float2 baseSize = pyramidLevelSize(0);
+	// Ray distance covering a single texel of the first level
+	float texelDistance = 1.0 / (max(baseSize.x, baseSize.y) * max(max(abs(deltaUV.x), abs(deltaUV.y)), 1.0e-6));
+
+	int topLevel = ubo.pyramidLevels - 1;
+	int level = topLevel;
+	float t = 0.0;
+	for (int i = 0; (i < MAX_HIERARCHY_STEPS) && (level >= 0); i++) {
+		float2 currUV = uv + rayDir * t;
+		float cellDepth = 1.0 - textureHeightPyramid.SampleLevel(samplerHeightPyramid, currUV, float(level)).r;
+		heightFetches++;
+		if (t >= cellDepth) {
+			// Below the highest texel of the cell, refine
+			level--;
+			continue;
+		}
+		// Distance to the border of the cell in the direction of the ray
+		float2 cellCount = pyramidLevelSize(level);
+		float2 border = (floor(currUV * cellCount) + step(0.0, rayDir)) / cellCount;
+		float2 borderDistance = (border - currUV) / rayDir;
+		float exitDistance = t + min(borderDistance.x, borderDistance.y);
+		if (cellDepth < exitDistance) {
+			// Reaches the highest texel's depth inside of the cell
+			t = cellDepth;
+			level--;
+		} else {
+			// Step over the border and continue on the next coarser level
+			t = exitDistance + 0.25 * texelDistance;
+			level = min(level + 1, topLevel);
+		}
+		if (t >= 1.0) {
+			t = 1.0;
+			break;
+		}
+	}
+
+	// The traversal stops on the texel that is hit, refine against the filtered height map
+	float t0 = max(t - 2.0 * texelDistance, 0.0);
+	float t1 = t;
+	for (int j = 0; j < 5; j++) {
+		float tMid = 0.5 * (t0 + t1);
+		float depth = 1.0 - textureNormalHeightMap.SampleLevel(samplerNormalHeightMap, uv + rayDir * tMid, 0.0).a;
+		heightFetches++;
+		if (tMid < depth) {
+			t0 = tMid;
+		} else {
+			t1 = tMid;
+		}
+	}
+	return uv + rayDir * t1;
+}
+
 float4 main(VSOutput input) : SV_TARGET
 {
 	float3 V = normalize(input.TangentViewPos - input.TangentFragPos);
@@ -86,7 +180,13 @@ float4 main(VSOutput input) : SV_TARGET
 				uv = steepParallaxMapping(input.UV, V);
 				break;
 			case 4:
-				uv = parallaxOcclusionMapping(input.UV, V);
+				uv = parallaxOcclusionMapping(input.UV, V, ubo.numLayers, 0.0);
+				break;
+			case 5:
+				uv = adaptiveParallaxOcclusionMapping(input.UV, V);
+				break;
+			case 6:
+				uv = hierarchicalReliefMapping(input.UV, V);
 				break;
 		}
 
@@ -105,6 +205,12 @@ float4 main(VSOutput input) : SV_TARGET
 		float3 diffuse = max(dot(L, N), 0.0) * color;
 		float3 specular = float3(0.15, 0.15, 0.15) * pow(max(dot(N, H), 0.0), 32.0);
 
+		if (ubo.showFetches != 0) {
+			// Green for no fetches to red for 64 or more
+			float fetches = clamp(float(heightFetches) / 64.0, 0.0, 1.0);
+			return float4(lerp(float3(0.0, 1.0, 0.0), float3(1.0, 0.0, 0.0), fetches) * (0.5 + 0.5 * max(dot(L, N), 0.0)), 1.0);
+		}
+
 		return float4(ambient + diffuse + specular, 1.0f);
 	}
 }
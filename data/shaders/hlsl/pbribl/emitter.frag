@@ -0,0 +1,38 @@
+// Copyright 2020 Google LLC
+
+struct UBOParams {
+	float4 lights[4];
+	float exposure;
+	float gamma;
+};
+cbuffer uboParams : register(b1) { UBOParams uboParams; };
+
+struct PushConsts {
+	float4 positionScale;
+	float4 color;
+};
+[[vk::push_constant]] PushConsts emitter;
+
+// From http://filmicworlds.com/blog/filmic-tonemapping-operators/
+float3 Uncharted2Tonemap(float3 color)
+{
+	float A = 0.15;
+	float B = 0.50;
+	float C = 0.10;
+	float D = 0.20;
+	float E = 0.02;
+	float F = 0.30;
+	float W = 11.2;
+	return ((color*(A*color+C*B)+D*E)/(color*(A*color+B)+D*F))-E/F;
+}
+
+float4 main() : SV_TARGET
+{
+	// Tone mapping
+	float3 color = Uncharted2Tonemap(emitter.color.rgb * uboParams.exposure);
+	color = color * (1.0f / Uncharted2Tonemap((11.2f).xxx));
+	// Gamma correction
+	color = pow(color, (1.0f / uboParams.gamma).xxx);
+
+	return float4(color, 1.0);
+}
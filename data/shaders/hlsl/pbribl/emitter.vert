@@ -0,0 +1,24 @@
+// Copyright 2020 Google LLC
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 model;
+	float4x4 view;
+	float3 camPos;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+// Emissive sphere, xyz is its position and w its scale
+struct PushConsts {
+	float4 positionScale;
+	float4 color;
+};
+[[vk::push_constant]] PushConsts emitter;
+
+float4 main([[vk::location(0)]] float3 Pos : POSITION0) : SV_POSITION
+{
+	float3 worldPos = Pos * emitter.positionScale.w + emitter.positionScale.xyz;
+	return mul(ubo.projection, mul(ubo.view, float4(worldPos, 1.0)));
+}
@@ -20,6 +20,11 @@ struct UBOParams {
 	float4 lights[4];
 	float exposure;
 	float gamma;
+	// 1 to evaluate shCoefficients instead of sampling the irradiance cube
+	uint irradianceSH;
+	// Highest mip level of the prefiltered cube, sampled for a roughness of 1
+	float maxReflectionLod;
+	float4 shCoefficients[9];
 };
 cbuffer uboParams : register(b1) { UBOParams uboParams; };
 
@@ -84,10 +89,24 @@ float3 F_SchlickR(float cosTheta, float3 F0, float roughness)
 	return F0 + (max((1.0 - roughness).xxx, F0) - F0) * pow(1.0 - cosTheta, 5.0);
 }
 
+// Irradiance (divided by PI) from the L2 spherical harmonics coefficients of vks::IBLGenerator::generateIrradianceSH()
+float3 evaluateSH(float3 n)
+{
+	float3 result = uboParams.shCoefficients[0].rgb * 0.282095;
+	result += uboParams.shCoefficients[1].rgb * 0.488603 * n.y;
+	result += uboParams.shCoefficients[2].rgb * 0.488603 * n.z;
+	result += uboParams.shCoefficients[3].rgb * 0.488603 * n.x;
+	result += uboParams.shCoefficients[4].rgb * 1.092548 * n.x * n.y;
+	result += uboParams.shCoefficients[5].rgb * 1.092548 * n.y * n.z;
+	result += uboParams.shCoefficients[6].rgb * 0.315392 * (3.0 * n.z * n.z - 1.0);
+	result += uboParams.shCoefficients[7].rgb * 1.092548 * n.x * n.z;
+	result += uboParams.shCoefficients[8].rgb * 0.546274 * (n.x * n.x - n.y * n.y);
+	return max(result, float3(0.0, 0.0, 0.0));
+}
+
 float3 prefilteredReflection(float3 R, float roughness)
 {
-	const float MAX_REFLECTION_LOD = 9.0; // todo: param/const
-	float lod = roughness * MAX_REFLECTION_LOD;
+	float lod = roughness * uboParams.maxReflectionLod;
 	float lodf = floor(lod);
 	float lodc = ceil(lod);
 	float3 a = prefilteredMapTexture.SampleLevel(prefilteredMapSampler, R, lodf).rgb;
@@ -143,7 +162,7 @@ float4 main(VSOutput input) : SV_TARGET
 
 	float2 brdf = textureBRDFLUT.Sample(samplerBRDFLUT, float2(max(dot(N, V), 0.0), roughness)).rg;
 	float3 reflection = prefilteredReflection(R, roughness).rgb;
-	float3 irradiance = textureIrradiance.Sample(samplerIrradiance, N).rgb;
+	float3 irradiance = (uboParams.irradianceSH == 1) ? evaluateSH(N) : textureIrradiance.Sample(samplerIrradiance, N).rgb;
 
 	// Diffuse based on irradiance
 	float3 diffuse = irradiance * ALBEDO;
@@ -0,0 +1,17 @@
+// Copyright 2020 Google LLC
+
+TextureCube textureEnv : register(t1);
+SamplerState samplerEnv : register(s1);
+
+struct PushConsts {
+	float4 positionScale;
+	float4 color;
+};
+[[vk::push_constant]] PushConsts object;
+
+float4 main([[vk::location(0)]] float3 inUVW : TEXCOORD0) : SV_TARGET
+{
+	// The capture is filtered for lighting, so it stores linear radiance without tone mapping
+	float3 color = (object.color.a > 0.0) ? object.color.rgb : textureEnv.SampleLevel(samplerEnv, inUVW, 0.0).rgb;
+	return float4(color, 1.0);
+}
@@ -0,0 +1,34 @@
+// Copyright 2020 Google LLC
+
+// Renders the scene into all faces of an environment probe's cube map at once, see vks::EnvironmentProbes
+
+// One projection and view per cube map face, the view index is the face (and layer) rendered to
+struct UBO
+{
+	float4x4 viewProjection[6];
+	float4 position;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+// Emissive sphere or the sky box (color.a = 0) centered on the probe, xyz is the position and w the scale
+struct PushConsts {
+	float4 positionScale;
+	float4 color;
+};
+[[vk::push_constant]] PushConsts object;
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 UVW : TEXCOORD0;
+};
+
+VSOutput main([[vk::location(0)]] float3 Pos : POSITION0, uint ViewIndex : SV_ViewID)
+{
+	VSOutput output = (VSOutput)0;
+	output.UVW = Pos;
+	float3 worldPos = Pos * object.positionScale.w + object.positionScale.xyz;
+	output.Pos = mul(ubo.viewProjection[ViewIndex], float4(worldPos, 1.0));
+	return output;
+}
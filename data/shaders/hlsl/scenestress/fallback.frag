@@ -0,0 +1,92 @@
+// Draw path of vkglTF::Model::draw with the material images pushed per draw, shaded like indirect.frag
+
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 128
+
+struct Light {
+	// xyz: position, w: range
+	float4 position;
+	float4 color;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4x4 invProjection;
+	float4 viewPos;
+	int2 renderExtent;
+	uint lightCount;
+	uint clustered;
+	float zNear;
+	float zFar;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+StructuredBuffer<Light> lights : register(t1);
+// Per cluster the number of lights followed by MAX_LIGHTS_PER_CLUSTER light indices
+StructuredBuffer<uint> clusterData : register(t2);
+
+Texture2D textureColor : register(t0, space1);
+SamplerState samplerColor : register(s0, space1);
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 WorldPos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float4 Color : COLOR0;
+[[vk::location(4)]] float ViewDepth : TEXCOORD1;
+[[vk::location(5)]] nointerpolation uint Placement : TEXCOORD2;
+};
+
+// Per placement color variation, so copies of the same archetype can be told apart
+float3 placementTint(uint placement)
+{
+	uint h = placement * 747796405u + 2891336453u;
+	h = ((h >> ((h >> 28u) + 4u)) ^ h) * 277803737u;
+	h = (h >> 22u) ^ h;
+	return lerp(float3(1.0, 1.0, 1.0), float3(h & 0xffu, (h >> 8u) & 0xffu, (h >> 16u) & 0xffu) / 255.0, 0.35);
+}
+
+float3 shadeLight(Light light, float3 worldPos, float3 N)
+{
+	float3 L = light.position.xyz - worldPos;
+	float dist = length(L);
+	float falloff = clamp(1.0 - dist / light.position.w, 0.0, 1.0);
+	return light.color.rgb * max(dot(N, L / max(dist, 0.0001)), 0.0) * falloff * falloff;
+}
+
+float3 lighting(float4 fragCoord, float3 worldPos, float3 N, float viewDepth)
+{
+	float3 result = float3(0.15, 0.15, 0.15);
+	if (ubo.clustered == 1) {
+		uint2 tile = min(uint2(fragCoord.xy * float2(CLUSTER_X, CLUSTER_Y) / float2(ubo.renderExtent)), uint2(CLUSTER_X - 1, CLUSTER_Y - 1));
+		uint slice = uint(clamp(log(viewDepth / ubo.zNear) / log(ubo.zFar / ubo.zNear) * float(CLUSTER_Z), 0.0, float(CLUSTER_Z - 1)));
+		uint cluster = ((slice * CLUSTER_Y + tile.y) * CLUSTER_X + tile.x) * (MAX_LIGHTS_PER_CLUSTER + 1);
+		uint count = clusterData[cluster];
+		for (uint i = 0; i < count; i++) {
+			result += shadeLight(lights[clusterData[cluster + 1 + i]], worldPos, N);
+		}
+	} else {
+		for (uint i = 0; i < ubo.lightCount; i++) {
+			result += shadeLight(lights[i], worldPos, N);
+		}
+	}
+	return result;
+}
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	// The material constants aren't available to this path, masked materials use the default cutoff
+	float4 color = input.Color * textureColor.Sample(samplerColor, input.UV);
+	if (color.a < 0.5) {
+		discard;
+	}
+	color.rgb *= placementTint(input.Placement);
+	return float4(color.rgb * lighting(input.Pos, input.WorldPos, normalize(input.Normal), input.ViewDepth), 1.0);
+}
@@ -0,0 +1,62 @@
+// Draw path of vkglTF::Model::draw: one draw per primitive and placement, the node matrix is pushed by the model (see vkglTF::Model::PushDescriptors)
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float4 Color : COLOR0;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4x4 invProjection;
+	float4 viewPos;
+	int2 renderExtent;
+	uint lightCount;
+	uint clustered;
+	float zNear;
+	float zFar;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+// Placement matrices of all archetypes
+StructuredBuffer<float4x4> placements : register(t3);
+
+struct PushConsts
+{
+	uint placement;
+	[[vk::offset(16)]] float4x4 nodeMatrix;
+	uint nodeIndex;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 WorldPos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float4 Color : COLOR0;
+[[vk::location(4)]] float ViewDepth : TEXCOORD1;
+[[vk::location(5)]] nointerpolation uint Placement : TEXCOORD2;
+};
+
+VSOutput main(VSInput input)
+{
+	float4x4 model = mul(placements[pushConsts.placement], pushConsts.nodeMatrix);
+	float4 worldPos = mul(model, float4(input.Pos, 1.0));
+	VSOutput output = (VSOutput)0;
+	output.WorldPos = worldPos.xyz;
+	output.Normal = mul((float3x3)model, input.Normal);
+	output.UV = input.UV;
+	output.Color = input.Color;
+	float4 viewPos = mul(ubo.view, worldPos);
+	output.ViewDepth = -viewPos.z;
+	output.Placement = pushConsts.placement;
+	output.Pos = mul(ubo.projection, viewPos);
+	return output;
+}
@@ -0,0 +1,67 @@
+// Multi draw indirect path: the transform and material of a draw are looked up with the instance index (see vkglTF::Model::IndirectDraw)
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float4 Color : COLOR0;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4x4 invProjection;
+	float4 viewPos;
+	int2 renderExtent;
+	uint lightCount;
+	uint clustered;
+	float zNear;
+	float zFar;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+StructuredBuffer<float4x4> transforms : register(t0, space1);
+// x = transform index, y = material index, z = first lod, w = lod count
+StructuredBuffer<uint4> drawData : register(t1, space1);
+
+// Placements of the archetype start at firstPlacement, every placement has the same number of transforms
+struct PushConsts
+{
+	uint firstPlacement;
+	uint transformsPerPlacement;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 WorldPos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float4 Color : COLOR0;
+[[vk::location(4)]] float ViewDepth : TEXCOORD1;
+[[vk::location(5)]] nointerpolation uint Material : TEXCOORD2;
+[[vk::location(6)]] nointerpolation uint Placement : TEXCOORD3;
+};
+
+// SV_InstanceID doesn't include the first instance of the draw, which selects the draw data
+VSOutput main(VSInput input, uint InstanceIndex : SV_InstanceID, [[vk::builtin("BaseInstance")]] uint BaseInstance : BASEINSTANCE)
+{
+	uint4 draw = drawData[BaseInstance + InstanceIndex];
+	float4x4 model = transforms[draw.x];
+	float4 worldPos = mul(model, float4(input.Pos, 1.0));
+	VSOutput output = (VSOutput)0;
+	output.WorldPos = worldPos.xyz;
+	output.Normal = mul((float3x3)model, input.Normal);
+	output.UV = input.UV;
+	output.Color = input.Color;
+	float4 viewPos = mul(ubo.view, worldPos);
+	output.ViewDepth = -viewPos.z;
+	output.Material = draw.y;
+	output.Placement = pushConsts.firstPlacement + draw.x / pushConsts.transformsPerPlacement;
+	output.Pos = mul(ubo.projection, viewPos);
+	return output;
+}
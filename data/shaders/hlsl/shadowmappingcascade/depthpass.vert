@@ -9,6 +9,7 @@ struct VSInput
 #define SHADOW_MAP_CASCADE_COUNT 4
 
 struct PushConsts {
+	// w: weight of the dynamic caster offset
 	float4 position;
 	uint cascadeIndex;
 };
@@ -16,6 +17,7 @@ struct PushConsts {
 
 struct UBO  {
 	float4x4 cascadeViewProjMat[SHADOW_MAP_CASCADE_COUNT];
+	float4 dynamicCasterOffset;
 };
 
 cbuffer ubo : register(b0) { UBO ubo; }
@@ -30,7 +32,7 @@ VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
 	output.UV = input.UV;
-	float3 pos = input.Pos + pushConsts.position.xyz;
+	float3 pos = input.Pos + pushConsts.position.xyz + ubo.dynamicCasterOffset.xyz * pushConsts.position.w;
 	output.Pos = mul(ubo.cascadeViewProjMat[pushConsts.cascadeIndex], float4(pos, 1.0));
 	return output;
 }
\ No newline at end of file
@@ -12,6 +12,7 @@ struct UBO  {
 	float4x4 projection;
 	float4x4 view;
 	float4x4 model;
+	float4 dynamicCasterOffset;
 };
 
 cbuffer ubo : register(b0) { UBO ubo; }
@@ -27,6 +28,7 @@ struct VSOutput
 };
 
 struct PushConsts {
+	// w: weight of the dynamic caster offset
 	float4 position;
 	uint cascadeIndex;
 };
@@ -38,7 +40,7 @@ VSOutput main(VSInput input)
 	output.Color = input.Color;
 	output.Normal = input.Normal;
 	output.UV = input.UV;
-	float3 pos = input.Pos + pushConsts.position.xyz;
+	float3 pos = input.Pos + pushConsts.position.xyz + ubo.dynamicCasterOffset.xyz * pushConsts.position.w;
 	output.WorldPos = pos;
 	output.ViewPos = mul(ubo.view, float4(pos.xyz, 1.0)).xyz;
 	output.Pos = mul(ubo.projection, mul(ubo.view, mul(ubo.model, float4(pos.xyz, 1.0))));
@@ -0,0 +1,36 @@
+// Copyright 2020 Google LLC
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float4 WorldPos : POSITION0;
+[[vk::location(1)]] float3 LightPos : POSITION1;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4x4 model;
+	float4 lightPos;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+// One view matrix per cube map face, the view index is the face (and layer) rendered to
+struct UBOFaceViews
+{
+	float4x4 faceViews[6];
+};
+
+cbuffer uboFaceViews : register(b2) { UBOFaceViews uboFaceViews; }
+
+VSOutput main([[vk::location(0)]] float3 Pos : POSITION0, uint ViewIndex : SV_ViewID)
+{
+	VSOutput output = (VSOutput)0;
+	output.Pos = mul(ubo.projection, mul(uboFaceViews.faceViews[ViewIndex], mul(ubo.model, float4(Pos, 1.0))));
+
+	output.WorldPos = float4(Pos, 1.0);
+	output.LightPos = ubo.lightPos.xyz;
+	return output;
+}
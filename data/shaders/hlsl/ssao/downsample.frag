@@ -0,0 +1,45 @@
+// Copyright 2020 Google LLC
+
+Texture2D texturePositionDepth : register(t0);
+SamplerState samplerPositionDepth : register(s0);
+Texture2D textureNormal : register(t1);
+SamplerState samplerNormal : register(s1);
+
+// Ratio of the G-Buffer resolution to the target resolution
+[[vk::constant_id(0)]] const int DOWNSAMPLE_FACTOR = 2;
+
+struct FSOutput
+{
+	float4 Position : SV_TARGET0;
+	float4 Normal : SV_TARGET1;
+};
+
+FSOutput main(float4 FragCoord : SV_POSITION, [[vk::location(0)]] float2 inUV : TEXCOORD0)
+{
+	FSOutput output;
+
+	// One texel of the footprint is picked instead of averaging them, so position and normal belong to the same surface
+	// Picking the nearest and the farthest texel in a checkerboard pattern keeps both sides of depth edges
+	int2 base = int2(FragCoord.xy) * DOWNSAMPLE_FACTOR;
+	int2 texDim;
+	texturePositionDepth.GetDimensions(texDim.x, texDim.y);
+	int2 maxCoord = texDim - 1;
+	bool farthest = ((int(FragCoord.x) + int(FragCoord.y)) & 1) == 1;
+	int2 selected = min(base, maxCoord);
+	float selectedDepth = farthest ? -1.0 : 1.0e30;
+	for (int y = 0; y < DOWNSAMPLE_FACTOR; y++) {
+		for (int x = 0; x < DOWNSAMPLE_FACTOR; x++) {
+			int2 coord = min(base + int2(x, y), maxCoord);
+			// Texels without geometry are cleared to a depth of zero
+			float depth = texturePositionDepth.Load(int3(coord, 0)).w;
+			depth = (depth > 0.0) ? depth : 1.0e30;
+			if (farthest ? (depth > selectedDepth) : (depth < selectedDepth)) {
+				selected = coord;
+				selectedDepth = depth;
+			}
+		}
+	}
+	output.Position = texturePositionDepth.Load(int3(selected, 0));
+	output.Normal = textureNormal.Load(int3(selected, 0));
+	return output;
+}
@@ -10,6 +10,8 @@ SamplerState ssaoNoiseSampler : register(s2);
 #define SSAO_KERNEL_ARRAY_SIZE 64
 [[vk::constant_id(0)]] const int SSAO_KERNEL_SIZE = 64;
 [[vk::constant_id(1)]] const float SSAO_RADIUS = 0.5;
+// Samples taken per pixel, with fewer samples than the kernel size every frame uses a different subset of the kernel
+[[vk::constant_id(2)]] const int SSAO_SAMPLE_COUNT = 64;
 
 struct UBOSSAOKernel
 {
@@ -20,6 +22,10 @@ cbuffer uboSSAOKernel : register(b3) { UBOSSAOKernel uboSSAOKernel; };
 struct UBO
 {
 	float4x4 projection;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	int frameIndex;
 };
 cbuffer ubo : register(b4) { UBO ubo; };
 
@@ -34,7 +40,9 @@ float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 	texturePositionDepth.GetDimensions(texDim.x, texDim.y);
 	int2 noiseDim;
 	ssaoNoiseTexture.GetDimensions(noiseDim.x, noiseDim.y);
-	const float2 noiseUV = float2(float(texDim.x)/float(noiseDim.x), float(texDim.y)/(noiseDim.y)) * inUV;
+	float2 noiseUV = float2(float(texDim.x)/float(noiseDim.x), float(texDim.y)/(noiseDim.y)) * inUV;
+	// Shift the noise by whole texels every frame, so accumulated frames use different sample rotations
+	noiseUV += float2(ubo.frameIndex % noiseDim.x, (ubo.frameIndex / noiseDim.x) % noiseDim.y) / float2(noiseDim);
 	float3 randomVec = ssaoNoiseTexture.Sample(ssaoNoiseSampler, noiseUV).xyz * 2.0 - 1.0;
 
 	// Create TBN matrix
@@ -44,9 +52,11 @@ float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 
 	// Calculate occlusion value
 	float occlusion = 0.0f;
-	for(int i = 0; i < SSAO_KERNEL_SIZE; i++)
+	// Every n-th kernel sample, so the subset covers all sample distances
+	const int kernelStep = SSAO_KERNEL_SIZE / SSAO_SAMPLE_COUNT;
+	for(int i = 0; i < SSAO_SAMPLE_COUNT; i++)
 	{
-		float3 samplePos = mul(TBN, uboSSAOKernel.samples[i].xyz);
+		float3 samplePos = mul(TBN, uboSSAOKernel.samples[i * kernelStep + ubo.frameIndex % kernelStep].xyz);
 		samplePos = fragPos + samplePos * SSAO_RADIUS;
 
 		// project
@@ -60,7 +70,7 @@ float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 		float rangeCheck = smoothstep(0.0f, 1.0f, SSAO_RADIUS / abs(fragPos.z - sampleDepth));
 		occlusion += (sampleDepth >= samplePos.z ? 1.0f : 0.0f) * rangeCheck;
 	}
-	occlusion = 1.0 - (occlusion / float(SSAO_KERNEL_SIZE));
+	occlusion = 1.0 - (occlusion / float(SSAO_SAMPLE_COUNT));
 
 	return occlusion;
 }
@@ -0,0 +1,39 @@
+// Copyright 2020 Google LLC
+
+Texture2D textureSSAO : register(t0);
+SamplerState samplerSSAO : register(s0);
+Texture2D textureHistory : register(t1);
+SamplerState samplerHistory : register(s1);
+Texture2D texturePositionDepth : register(t2);
+SamplerState samplerPositionDepth : register(s2);
+
+struct UBO
+{
+	// From the current frame's view space to the previous frame's clip space
+	float4x4 reprojection;
+	float historyWeight;
+	int historyValid;
+};
+cbuffer ubo : register(b3) { UBO ubo; };
+
+// r = accumulated occlusion, g = linear depth it was accumulated at
+float2 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float occlusion = textureSSAO.Sample(samplerSSAO, inUV).r;
+	float4 position = texturePositionDepth.Sample(samplerPositionDepth, inUV);
+
+	if ((ubo.historyValid == 1) && (position.w > 0.0)) {
+		// Where the surface was in the previous frame, w is its linear depth in that frame
+		float4 previous = mul(ubo.reprojection, float4(position.xyz, 1.0));
+		float2 previousUV = previous.xy / previous.w * 0.5 + 0.5;
+		if (all(previousUV >= 0.0) && all(previousUV <= 1.0)) {
+			float2 history = textureHistory.Sample(samplerHistory, previousUV).rg;
+			// The history is discarded if it belongs to a different surface (disocclusion)
+			if (abs(history.g - previous.w) < 0.05 * previous.w) {
+				occlusion = lerp(occlusion, history.r, ubo.historyWeight);
+			}
+		}
+	}
+
+	return float2(occlusion, position.w);
+}
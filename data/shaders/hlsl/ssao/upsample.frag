@@ -0,0 +1,50 @@
+// Copyright 2020 Google LLC
+
+Texture2D textureSSAO : register(t0);
+SamplerState samplerSSAO : register(s0);
+Texture2D textureLowPositionDepth : register(t1);
+SamplerState samplerLowPositionDepth : register(s1);
+Texture2D textureLowNormal : register(t2);
+SamplerState samplerLowNormal : register(s2);
+Texture2D texturePositionDepth : register(t3);
+SamplerState samplerPositionDepth : register(s3);
+Texture2D textureNormal : register(t4);
+SamplerState samplerNormal : register(s4);
+
+float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float depth = texturePositionDepth.Sample(samplerPositionDepth, inUV).w;
+	float3 normal = normalize(textureNormal.Sample(samplerNormal, inUV).rgb * 2.0 - 1.0);
+
+	// Nothing to guide the filter for pixels without geometry
+	if (depth <= 0.0) {
+		return textureSSAO.Sample(samplerSSAO, inUV).r;
+	}
+
+	// Joint bilateral filter over the 4x4 low resolution texels around the pixel: a tent filter two low resolution texels wide
+	// that also smooths the reduced sample count, with the weights of texels from other surfaces (depth or orientation) scaled down
+	int2 lowSize;
+	textureSSAO.GetDimensions(lowSize.x, lowSize.y);
+	float2 lowCoord = inUV * float2(lowSize) - 0.5;
+	int2 base = int2(floor(lowCoord));
+	float2 f = lowCoord - float2(base);
+	float occlusion = 0.0;
+	float weightSum = 0.0;
+	for (int y = -1; y <= 2; y++) {
+		for (int x = -1; x <= 2; x++) {
+			int2 coord = clamp(base + int2(x, y), int2(0, 0), lowSize - 1);
+			float2 dist = abs(float2(x, y) - f);
+			float spatialWeight = max(1.0 - dist.x * 0.5, 0.0) * max(1.0 - dist.y * 0.5, 0.0);
+			float lowDepth = textureLowPositionDepth.Load(int3(coord, 0)).w;
+			float3 lowNormal = normalize(textureLowNormal.Load(int3(coord, 0)).rgb * 2.0 - 1.0);
+			float depthWeight = exp(-abs(lowDepth - depth) / (0.02 * depth));
+			float normalWeight = pow(max(dot(lowNormal, normal), 0.0), 8.0);
+			float weight = spatialWeight * depthWeight * normalWeight;
+			occlusion += textureSSAO.Load(int3(coord, 0)).r * weight;
+			weightSum += weight;
+		}
+	}
+
+	// Fall back to the plain low resolution value if no texel matches the surface
+	return (weightSum > 1.0e-4) ? occlusion / weightSum : textureSSAO.Sample(samplerSSAO, inUV).r;
+}
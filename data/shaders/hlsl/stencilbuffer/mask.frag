@@ -0,0 +1,12 @@
+// Copyright 2020 Google LLC
+
+struct PushConsts {
+	float4 offset;
+	uint id;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+uint main() : SV_TARGET
+{
+	return pushConsts.id;
+}
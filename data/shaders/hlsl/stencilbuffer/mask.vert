@@ -0,0 +1,28 @@
+// Copyright 2020 Google LLC
+
+// Object id mask of the jump flood outlines, see vks::OutlineRenderer
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 model;
+	float4 lightPos;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+struct PushConsts {
+	float4 offset;
+	uint id;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+float4 main(VSInput input) : SV_POSITION
+{
+	return mul(ubo.projection, mul(ubo.model, float4(input.Pos + pushConsts.offset.xyz, 1.0)));
+}
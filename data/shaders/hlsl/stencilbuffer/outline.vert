@@ -16,9 +16,15 @@ struct UBO
 
 cbuffer ubo : register(b0) { UBO ubo; }
 
+struct PushConsts {
+	float4 offset;
+	uint id;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
 float4 main(VSInput input) : SV_POSITION
 {
 	// Extrude along normal
-	float4 pos = float4(input.Pos.xyz + input.Normal * ubo.outlineWidth, input.Pos.w);
+	float4 pos = float4(input.Pos.xyz + pushConsts.offset.xyz + input.Normal * ubo.outlineWidth, input.Pos.w);
 	return mul(ubo.projection, mul(ubo.model, pos));
 }
@@ -16,6 +16,12 @@ struct UBO
 
 cbuffer ubo : register(b0) { UBO ubo; }
 
+struct PushConsts {
+	float4 offset;
+	uint id;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
 struct VSOutput
 {
 	float4 Pos : SV_POSITION;
@@ -28,9 +34,9 @@ VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
 	output.Color = float3(1.0, 0.0, 0.0);
-	output.Pos = mul(ubo.projection, mul(ubo.model, float4(input.Pos.xyz, 1.0)));
+	output.Pos = mul(ubo.projection, mul(ubo.model, float4(input.Pos.xyz + pushConsts.offset.xyz, 1.0)));
 	output.Normal = mul((float3x3)ubo.model, input.Normal);
-	float4 pos = mul(ubo.model, float4(input.Pos, 1.0));
+	float4 pos = mul(ubo.model, float4(input.Pos + pushConsts.offset.xyz, 1.0));
 	float3 lPos = mul((float3x3)ubo.model, ubo.lightPos.xyz);
 	output.LightVec = lPos - pos.xyz;
 	return output;
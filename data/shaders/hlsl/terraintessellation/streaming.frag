@@ -0,0 +1,138 @@
+// Copyright 2020 Google LLC
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 modelview;
+	float4 cameraPos;
+	float4 lightDir;
+	float4 frustumPlanes[6];
+	int4 clipRegions[8];
+	float2 terrainOrigin;
+	float terrainSize;
+	float terrainTexels;
+	float texelSize;
+	float heightScale;
+	float lodRange;
+	float tessellationFactor;
+	uint maxDepth;
+	uint clipLevels;
+	float clipSize;
+	float blendTexels;
+	uint maxNodes;
+	uint showLod;
+};
+cbuffer ubo : register(b0) { UBO ubo; };
+
+Texture2DArray textureClipHeight : register(t1);
+SamplerState samplerClipHeight : register(s1);
+Texture2DArray textureClipNormal : register(t2);
+SamplerState samplerClipNormal : register(s2);
+Texture2DArray textureLayers : register(t3);
+SamplerState samplerLayers : register(s3);
+
+struct DSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 WorldPos : POSITION0;
+[[vk::location(1)]] float Depth : TEXCOORD0;
+};
+
+// Level 0 texel position of a world space position, clamped to the terrain
+float2 terrainTexel(float2 pos)
+{
+	return clamp((pos - ubo.terrainOrigin) / ubo.texelSize, float2(0.0, 0.0), (ubo.terrainTexels - 1.0).xx);
+}
+
+// Finest clipmap level whose resident region contains the position, weight drops to zero towards the border of the region
+void clipmapLevel(float2 pos, out uint level, out float weight)
+{
+	float2 texel = terrainTexel(pos);
+	for (level = 0; level < ubo.clipLevels - 1; level++) {
+		float2 levelTexel = (texel + 0.5) / float(1 << level) - 0.5;
+		float4 region = float4(ubo.clipRegions[level]);
+		float2 edge = min(levelTexel - region.xy, region.zw - levelTexel);
+		// Bilinear filtering reads one texel further
+		float edgeDistance = min(edge.x, edge.y) - 1.0;
+		if (edgeDistance >= 0.0) {
+			weight = saturate(edgeDistance / ubo.blendTexels);
+			return;
+		}
+	}
+	weight = 1.0;
+}
+
+// Texture coordinate of a position in a clipmap level, layers are addressed toroidally with a repeating sampler
+float3 clipmapCoord(float2 pos, uint level)
+{
+	float scale = float(1 << level);
+	float levelWidth = ceil(ubo.terrainTexels / scale);
+	float2 levelTexel = clamp((terrainTexel(pos) + 0.5) / scale - 0.5, float2(0.0, 0.0), (levelWidth - 1.0).xx);
+	return float3((levelTexel + 0.5) / ubo.clipSize, float(level));
+}
+
+// Height (x) and normal (yzw, y pointing up) from the clipmap, blended between two levels near the border of the finer one
+float4 sampleTerrain(float2 pos)
+{
+	uint level;
+	float weight;
+	clipmapLevel(pos, level, weight);
+	float3 coord = clipmapCoord(pos, level);
+	float3 value = float3(textureClipHeight.SampleLevel(samplerClipHeight, coord, 0.0).r, textureClipNormal.SampleLevel(samplerClipNormal, coord, 0.0).rg);
+	if (weight < 1.0) {
+		coord = clipmapCoord(pos, level + 1);
+		value = lerp(float3(textureClipHeight.SampleLevel(samplerClipHeight, coord, 0.0).r, textureClipNormal.SampleLevel(samplerClipNormal, coord, 0.0).rg), value, weight);
+	}
+	return float4(value.x, value.y, sqrt(max(1.0 - dot(value.yz, value.yz), 0.0)), value.z);
+}
+
+float3 sampleTerrainLayer(float height, float2 uv)
+{
+	// Define some layer ranges for sampling depending on terrain height
+	float2 layers[6];
+	layers[0] = float2(-10.0, 10.0);
+	layers[1] = float2(5.0, 45.0);
+	layers[2] = float2(45.0, 80.0);
+	layers[3] = float2(75.0, 100.0);
+	layers[4] = float2(95.0, 140.0);
+	layers[5] = float2(140.0, 190.0);
+
+	float3 color = float3(0.0, 0.0, 0.0);
+	height *= 255.0;
+	for (int i = 0; i < 6; i++)
+	{
+		float range = layers[i].y - layers[i].x;
+		float weight = (range - abs(height - layers[i].y)) / range;
+		weight = max(0.0, weight);
+		color += weight * textureLayers.Sample(samplerLayers, float3(uv, i)).rgb;
+	}
+
+	return color;
+}
+
+float fog(float density, float3 worldPos)
+{
+	const float LOG2 = -1.442695;
+	float dist = distance(worldPos, ubo.cameraPos.xyz) * 0.01;
+	float d = density * dist;
+	return 1.0 - clamp(exp2(d * d * LOG2), 0.0, 1.0);
+}
+
+float4 main(DSOutput input) : SV_TARGET
+{
+	float4 terrain = sampleTerrain(input.WorldPos.xz);
+	// Up is -y in world space
+	float3 N = normalize(float3(terrain.y, -terrain.z, terrain.w));
+	float3 L = normalize(ubo.lightDir.xyz);
+	float3 ambient = float3(0.5, 0.5, 0.5);
+	float3 diffuse = max(dot(N, L), 0.0).xxx;
+
+	float3 color = (ambient + diffuse) * sampleTerrainLayer(terrain.x, input.WorldPos.xz / 8.0);
+	if (ubo.showLod != 0) {
+		// Tint by quadtree depth
+		color *= 0.6 + 0.4 * cos(6.28318 * (input.Depth / 8.0 + float3(0.0, 0.33, 0.67)));
+	}
+
+	const float4 fogColor = float4(0.47, 0.5, 0.67, 0.0);
+	return lerp(float4(color, 1.0), fogColor, fog(0.25, input.WorldPos));
+}
@@ -0,0 +1,23 @@
+// Copyright 2020 Google LLC
+
+// World space xz origin (xy), size (z) and depth (w) of the selected leaves
+[[vk::binding(6)]]
+StructuredBuffer<float4> leaves;
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float2 Local : TEXCOORD0;
+[[vk::location(1)]] float4 Node : TEXCOORD1;
+};
+
+VSOutput main([[vk::location(0)]] float2 Pos : POSITION0, uint InstanceIndex : SV_InstanceID)
+{
+	// Each instance is the patch grid of one quadtree leaf, the vertex positions are relative to the leaf
+	VSOutput output = (VSOutput)0;
+	float4 node = leaves[InstanceIndex];
+	output.Local = Pos;
+	output.Node = node;
+	output.Pos = float4(node.x + Pos.x * node.z, 0.0, node.y + Pos.y * node.z, 1.0);
+	return output;
+}
@@ -3,8 +3,18 @@
 Texture2D textureFont : register(t0);
 SamplerState samplerFont : register(s0);
 
-float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+// Signed distance field font with the distance in the alpha channel, coverage bitmap font in the red channel otherwise
+[[vk::constant_id(0)]] const bool SDF = false;
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0, [[vk::location(1)]] float4 inColor : COLOR0) : SV_TARGET
 {
-	float color = textureFont.Sample(samplerFont, inUV).r;
-	return color.xxxx;
+	float alpha;
+	if (SDF) {
+		float distance = textureFont.Sample(samplerFont, inUV).a;
+		float smoothWidth = fwidth(distance);
+		alpha = smoothstep(0.5 - smoothWidth, 0.5 + smoothWidth, distance);
+	} else {
+		alpha = textureFont.Sample(samplerFont, inUV).r;
+	}
+	return float4(inColor.rgb, inColor.a * alpha);
 }
@@ -2,20 +2,50 @@
 
 struct VSInput
 {
+// Per glyph instance
 [[vk::location(0)]] float2 Pos : POSITION0;
-[[vk::location(1)]] float2 UV : TEXCOORD0;
+// x = glyph index, y = glyph size in 1/16 pixels
+[[vk::location(1)]] uint2 Glyph : TEXCOORD0;
+[[vk::location(2)]] float4 Color : COLOR0;
+uint VertexIndex : SV_VertexID;
 };
 
+struct Glyph
+{
+	// Quad corners relative to the pen position, in font units
+	float4 rect;
+	// Texture coordinates of the corners
+	float4 uv;
+};
+
+StructuredBuffer<Glyph> glyphs : register(t1);
+
+struct PushConsts
+{
+	// Size of a pixel in normalized device coordinates
+	float2 pixelSize;
+	// Size the glyph metrics are given for
+	float fontSize;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
 struct VSOutput
 {
 	float4 Pos : SV_POSITION;
 [[vk::location(0)]] float2 UV : TEXCOORD0;
+[[vk::location(1)]] float4 Color : COLOR0;
 };
 
 VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
-	output.Pos = float4(input.Pos, 0.0, 1.0);
-	output.UV = input.UV;
+	// Expand the quad from the vertex index of the triangle strip (0 = top left, 1 = top right, 2 = bottom left, 3 = bottom right)
+	Glyph glyph = glyphs[input.Glyph.x];
+	float2 corner = float2(input.VertexIndex & 1, (input.VertexIndex >> 1) & 1);
+	float2 offset = lerp(glyph.rect.xy, glyph.rect.zw, corner);
+	float scale = float(input.Glyph.y) / 16.0 / pushConsts.fontSize;
+	output.Pos = float4(input.Pos + offset * scale * pushConsts.pixelSize, 0.0, 1.0);
+	output.UV = lerp(glyph.uv.xy, glyph.uv.zw, corner);
+	output.Color = input.Color;
 	return output;
 }
@@ -0,0 +1,32 @@
+// Copyright 2020 Google LLC
+
+TextureCubeArray textureCubeMapArray : register(t1);
+SamplerState samplerCubeMapArray : register(s1);
+
+struct UBO
+{
+	float4x4 faceViewProjection[6];
+	float time;
+	int sourceLayerCount;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+[[vk::constant_id(0)]] const bool SKY = true;
+
+struct VSOutput
+{
+[[vk::location(0)]] float3 UVW : TEXCOORD0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] nointerpolation int Layer : TEXCOORD1;
+};
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	if (SKY) {
+		return textureCubeMapArray.SampleLevel(samplerCubeMapArray, float4(input.UVW, input.Layer % ubo.sourceLayerCount), 0.0);
+	}
+	const float3 colors[4] = { float3(1.0, 0.3, 0.2), float3(0.2, 1.0, 0.3), float3(0.2, 0.4, 1.0), float3(1.0, 0.9, 0.2) };
+	float diffuse = max(dot(normalize(input.Normal), normalize(float3(0.5, -1.0, 0.25))), 0.15);
+	return float4(colors[input.Layer % 4] * diffuse, 1.0);
+}
@@ -0,0 +1,51 @@
+// Copyright 2020 Google LLC
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+};
+
+struct UBO
+{
+	float4x4 faceViewProjection[6];
+	float time;
+	int sourceLayerCount;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+// Selects between the sky and the object orbiting the center of the cube maps
+[[vk::constant_id(0)]] const bool SKY = true;
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 UVW : TEXCOORD0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] nointerpolation int Layer : TEXCOORD1;
+	uint RenderTargetIndex : SV_RenderTargetArrayIndex;
+};
+
+VSOutput main(VSInput input, uint InstanceIndex : SV_InstanceID)
+{
+	VSOutput output = (VSOutput)0;
+	// Each instance renders into one face of one cube map of the array
+	int face = InstanceIndex % 6;
+	output.Layer = InstanceIndex / 6;
+	output.RenderTargetIndex = InstanceIndex;
+
+	// Every cube map turns at its own speed, so each of them shows different content
+	float angle = ubo.time * (0.5 + 0.25 * float(output.Layer));
+	float3x3 rotation = float3x3(cos(angle), 0.0, sin(angle), 0.0, 1.0, 0.0, -sin(angle), 0.0, cos(angle));
+	if (SKY) {
+		output.UVW = mul(rotation, input.Pos);
+		output.UVW.yz *= -1.0;
+		output.Pos = mul(ubo.faceViewProjection[face], float4(input.Pos, 1.0));
+	} else {
+		float3 pos = mul(rotation, input.Pos * 0.35 + float3(2.0, 0.5 * sin(angle * 2.0), 0.0));
+		output.Normal = mul(rotation, input.Normal);
+		output.Pos = mul(ubo.faceViewProjection[face], float4(pos, 1.0));
+	}
+	return output;
+}
@@ -5,6 +5,17 @@ SamplerState samplerColorMap : register(s0, space1);
 Texture2D textureNormalMap : register(t1, space1);
 SamplerState samplerNormalMap : register(s1, space1);
 
+// Inline uniform block or uniform buffer range, depending on device support
+struct MaterialConstants
+{
+	float4 baseColorFactor;
+	float metallicFactor;
+	float roughnessFactor;
+	float alphaCutoff;
+	uint alphaMode;
+};
+cbuffer material : register(b2, space1) { MaterialConstants material; };
+
 struct UBO
 {
 	float4x4 projection;
@@ -17,7 +28,6 @@ struct UBO
 cbuffer ubo : register(b0) { UBO ubo; };
 
 [[vk::constant_id(0)]] const bool ALPHA_MASK = false;
-[[vk::constant_id(1)]] const float ALPHA_MASK_CUTOFF = 0.0;
 
 struct VSOutput
 {
@@ -31,10 +41,10 @@ struct VSOutput
 
 float4 main(VSOutput input, uint shadingRate : SV_ShadingRate) : SV_TARGET
 {
-	float4 color = textureColorMap.Sample(samplerColorMap, input.UV) * float4(input.Color, 1.0);
+	float4 color = textureColorMap.Sample(samplerColorMap, input.UV) * float4(input.Color, 1.0) * material.baseColorFactor;
 
 	if (ALPHA_MASK) {
-		if (color.a < ALPHA_MASK_CUTOFF) {
+		if (color.a < material.alphaCutoff) {
 			discard;
 		}
 	}
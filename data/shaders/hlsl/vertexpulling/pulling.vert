@@ -0,0 +1,87 @@
+// Copyright 2020 Google LLC
+
+// Address and layout of the model's vertices, see vkglTF::Model::VertexFetch
+struct VertexFetch
+{
+	uint64_t vertices;
+	uint stride;
+	uint formats;
+	uint offsets[7];
+};
+
+[[vk::push_constant]] VertexFetch fetch;
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 model;
+	float4 lightPos;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(3)]] float3 LightVec : TEXCOORD2;
+};
+
+// vkglTF::VertexComponent
+#define COMPONENT_POSITION 0
+#define COMPONENT_NORMAL 1
+#define COMPONENT_COLOR 3
+
+uint loadWord(uint byteOffset)
+{
+	return vk::RawBufferLoad<uint>(fetch.vertices + byteOffset);
+}
+
+float2 unpackSnorm2x16(uint value)
+{
+	int2 components = int2(value << 16, value) >> 16;
+	return max(float2(components) / 32767.0, -1.0);
+}
+
+// Reads a vertex component in any of the formats of vkglTF::Model::VertexFetchFormat, components that aren't stored return the default value
+float4 fetchComponent(uint vertexIndex, uint component, float4 defaultValue)
+{
+	uint format = (fetch.formats >> (component * 4)) & 0xF;
+	uint offset = vertexIndex * fetch.stride + fetch.offsets[component];
+	switch (format) {
+		case 1:
+			return float4(asfloat(loadWord(offset)), asfloat(loadWord(offset + 4)), defaultValue.zw);
+		case 2:
+			return float4(asfloat(loadWord(offset)), asfloat(loadWord(offset + 4)), asfloat(loadWord(offset + 8)), defaultValue.w);
+		case 3:
+			return float4(asfloat(loadWord(offset)), asfloat(loadWord(offset + 4)), asfloat(loadWord(offset + 8)), asfloat(loadWord(offset + 12)));
+		case 4:
+			return float4(f16tof32(loadWord(offset)), f16tof32(loadWord(offset) >> 16), defaultValue.zw);
+		case 5:
+			return float4(unpackSnorm2x16(loadWord(offset)), unpackSnorm2x16(loadWord(offset + 4)));
+		case 6:
+			return float4((loadWord(offset).xxxx >> uint4(0, 8, 16, 24)) & 0xFF) / 255.0;
+		case 7:
+			return float4((loadWord(offset).xxxx >> uint4(0, 8, 16, 24)) & 0xFF);
+	}
+	return defaultValue;
+}
+
+VSOutput main(uint VertexIndex : SV_VertexID)
+{
+	float3 inPos = fetchComponent(VertexIndex, COMPONENT_POSITION, float4(0.0, 0.0, 0.0, 0.0)).xyz;
+	float3 inNormal = fetchComponent(VertexIndex, COMPONENT_NORMAL, float4(0.0, 0.0, 0.0, 0.0)).xyz;
+
+	VSOutput output = (VSOutput)0;
+	output.Color = fetchComponent(VertexIndex, COMPONENT_COLOR, float4(1.0, 1.0, 1.0, 1.0)).rgb;
+	output.Pos = mul(ubo.projection, mul(ubo.model, float4(inPos.xyz, 1.0)));
+
+	float4 pos = mul(ubo.model, float4(inPos, 1.0));
+	output.Normal = mul((float3x3)ubo.model, inNormal);
+	float3 lPos = mul((float3x3)ubo.model, ubo.lightPos.xyz);
+	output.LightVec = lPos - pos.xyz;
+	output.ViewVec = -pos.xyz;
+	return output;
+}
@@ -0,0 +1,50 @@
+// Copyright 2020 Google LLC
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float3 Color : COLOR0;
+};
+
+struct UBO
+{
+	float4x4 projection[16];
+	float4x4 modelview[16];
+	float4 lightPos;
+	int viewportCount;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+	uint ViewportIndex : SV_ViewportArrayIndex;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float3 ViewVec : TEXCOOR1;
+[[vk::location(3)]] float3 LightVec : TEXCOOR2;
+};
+
+VSOutput main(VSInput input, uint InstanceIndex : SV_InstanceID)
+{
+	VSOutput output = (VSOutput)0;
+	// Each instance renders to the viewport with the same index
+	uint viewport = InstanceIndex;
+
+	output.Normal = mul((float3x3)ubo.modelview[viewport], input.Normal);
+	output.Color = input.Color;
+
+	float4 worldPos = mul(ubo.modelview[viewport], float4(input.Pos.xyz, 1.0));
+
+	float3 lPos = mul(ubo.modelview[viewport], ubo.lightPos).xyz;
+	output.LightVec = lPos - worldPos.xyz;
+	output.ViewVec = -worldPos.xyz;
+
+	output.Pos = mul(ubo.projection[viewport], worldPos);
+
+	// Set the viewport index that the vertex will be emitted to
+	output.ViewportIndex = viewport;
+	return output;
+}
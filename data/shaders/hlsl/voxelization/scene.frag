@@ -0,0 +1,113 @@
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4x4 inverseViewProjection;
+	float4 cameraPos;
+	float4 lightDir;
+	// Voxel clipmap, see vks::Voxelizer::ShaderData
+	float4 voxelLevels[8];
+	uint voxelResolution;
+	uint voxelLevelCount;
+	uint2 voxelPadding;
+	float aoStrength;
+	int displayMode;
+	int shadows;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+Texture3D textureVoxels : register(t1);
+SamplerState samplerVoxels : register(s1);
+
+struct VSOutput
+{
+[[vk::location(0)]] float3 WorldPos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float3 Color : COLOR0;
+};
+
+// Finest clipmap level that contains the position and has voxels of at least the given size, voxelLevelCount if there is none
+uint findLevel(float3 pos, float minVoxelSize)
+{
+	for (uint level = 0; level < ubo.voxelLevelCount; level++)
+	{
+		float4 voxelLevel = ubo.voxelLevels[level];
+		float3 uvw = (pos - voxelLevel.xyz) / (voxelLevel.w * float(ubo.voxelResolution));
+		if ((voxelLevel.w >= minVoxelSize) && all(uvw > 0.0) && all(uvw < 1.0))
+		{
+			return level;
+		}
+	}
+	return ubo.voxelLevelCount;
+}
+
+// Filtered voxel (rgb = color, a = occupancy) of a level at a world space position
+float4 sampleVoxels(float3 pos, uint level)
+{
+	float resolution = float(ubo.voxelResolution);
+	float4 voxelLevel = ubo.voxelLevels[level];
+	float3 uvw = (pos - voxelLevel.xyz) / (voxelLevel.w * resolution);
+	// Clamped to the texel centers of the level, so filtering doesn't read from the neighbouring levels stacked along z
+	uvw = clamp(uvw, 0.5 / resolution, 1.0 - 0.5 / resolution);
+	uvw.z = (uvw.z + float(level)) / float(ubo.voxelLevelCount);
+	return textureVoxels.SampleLevel(samplerVoxels, uvw, 0.0);
+}
+
+// Approximates a cone by sampling coarser levels with growing distance, so each step is a single fetch
+float traceCone(float3 origin, float3 direction, float aperture, float maxDistance)
+{
+	float baseVoxelSize = ubo.voxelLevels[0].w;
+	float occlusion = 0.0;
+	// Start outside of the voxels of the surface itself
+	float dist = baseVoxelSize * 2.0;
+	while ((dist < maxDistance) && (occlusion < 0.95))
+	{
+		float3 pos = origin + direction * dist;
+		float diameter = max(baseVoxelSize, 2.0 * aperture * dist);
+		uint level = findLevel(pos, diameter * 0.5);
+		if (level >= ubo.voxelLevelCount)
+		{
+			break;
+		}
+		float sampleOcclusion = sampleVoxels(pos, level).a;
+		occlusion += (1.0 - occlusion) * sampleOcclusion;
+		dist += diameter * 0.5;
+	}
+	return occlusion;
+}
+
+float ambientOcclusion(float3 pos, float3 normal)
+{
+	// One cone along the normal and four around it, 60 degrees apart
+	float3 tangent = normalize(cross(normal, abs(normal.y) < 0.99 ? float3(0.0, 1.0, 0.0) : float3(1.0, 0.0, 0.0)));
+	float3 bitangent = cross(normal, tangent);
+	const float aperture = 0.577;
+	const float maxDistance = 2.0;
+	float occlusion = traceCone(pos, normal, aperture, maxDistance);
+	occlusion += 0.75 * traceCone(pos, normalize(normal + tangent), aperture, maxDistance);
+	occlusion += 0.75 * traceCone(pos, normalize(normal - tangent), aperture, maxDistance);
+	occlusion += 0.75 * traceCone(pos, normalize(normal + bitangent), aperture, maxDistance);
+	occlusion += 0.75 * traceCone(pos, normalize(normal - bitangent), aperture, maxDistance);
+	return clamp(1.0 - occlusion / 4.0 * ubo.aoStrength, 0.0, 1.0);
+}
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	float3 N = normalize(input.Normal);
+	float3 L = -ubo.lightDir.xyz;
+	float occlusion = ambientOcclusion(input.WorldPos, N);
+	if (ubo.displayMode == 1)
+	{
+		return float4(occlusion.xxx, 1.0);
+	}
+
+	float diffuse = max(dot(N, L), 0.0);
+	if ((ubo.shadows == 1) && (diffuse > 0.0))
+	{
+		// Narrow cone towards the light for soft shadows
+		diffuse *= 1.0 - traceCone(input.WorldPos, L, 0.05, 16.0);
+	}
+	float3 color = input.Color * (0.3 * occlusion + 0.8 * diffuse);
+	return float4(color, 1.0);
+}
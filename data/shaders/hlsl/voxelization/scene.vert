@@ -0,0 +1,44 @@
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float3 Color : COLOR0;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4x4 inverseViewProjection;
+	float4 cameraPos;
+	float4 lightDir;
+	// Voxel clipmap, see vks::Voxelizer::ShaderData
+	float4 voxelLevels[8];
+	uint voxelResolution;
+	uint voxelLevelCount;
+	uint2 voxelPadding;
+	float aoStrength;
+	int displayMode;
+	int shadows;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 WorldPos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float3 Color : COLOR0;
+};
+
+VSOutput main(VSInput input)
+{
+	// Vertices are pre-transformed to world space
+	VSOutput output = (VSOutput)0;
+	output.WorldPos = input.Pos;
+	output.Normal = input.Normal;
+	output.Color = input.Color;
+	output.Pos = mul(ubo.projection, mul(ubo.view, float4(input.Pos, 1.0)));
+	return output;
+}
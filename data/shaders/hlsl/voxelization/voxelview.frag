@@ -0,0 +1,73 @@
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4x4 inverseViewProjection;
+	float4 cameraPos;
+	float4 lightDir;
+	// Voxel clipmap, see vks::Voxelizer::ShaderData
+	float4 voxelLevels[8];
+	uint voxelResolution;
+	uint voxelLevelCount;
+	uint2 voxelPadding;
+	float aoStrength;
+	int displayMode;
+	int shadows;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+Texture3D textureVoxels : register(t1);
+SamplerState samplerVoxels : register(s1);
+
+static const float3 levelColors[4] = { float3(1.0, 0.6, 0.6), float3(0.6, 1.0, 0.6), float3(0.6, 0.6, 1.0), float3(1.0, 1.0, 0.6) };
+
+// Finest clipmap level that contains the position, voxelLevelCount if there is none
+uint findLevel(float3 pos)
+{
+	for (uint level = 0; level < ubo.voxelLevelCount; level++)
+	{
+		float4 voxelLevel = ubo.voxelLevels[level];
+		float3 uvw = (pos - voxelLevel.xyz) / (voxelLevel.w * float(ubo.voxelResolution));
+		if (all(uvw >= 0.0) && all(uvw < 1.0))
+		{
+			return level;
+		}
+	}
+	return ubo.voxelLevelCount;
+}
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	// World space ray through the pixel
+	float4 nearPos = mul(ubo.inverseViewProjection, float4(inUV * 2.0 - 1.0, 0.0, 1.0));
+	float4 farPos = mul(ubo.inverseViewProjection, float4(inUV * 2.0 - 1.0, 1.0, 1.0));
+	float3 origin = nearPos.xyz / nearPos.w;
+	float3 direction = normalize(farPos.xyz / farPos.w - origin);
+
+	// March in steps of half a voxel of the level at the current position, each step fetches the voxel it's in
+	int resolution = int(ubo.voxelResolution);
+	float dist = 0.0;
+	for (int i = 0; i < 1024; i++)
+	{
+		float3 pos = origin + direction * dist;
+		uint level = findLevel(pos);
+		if (level >= ubo.voxelLevelCount)
+		{
+			break;
+		}
+		float4 voxelLevel = ubo.voxelLevels[level];
+		int3 voxel = clamp(int3(floor((pos - voxelLevel.xyz) / voxelLevel.w)), 0, resolution - 1);
+		float4 value = textureVoxels.Load(int4(voxel.xy, voxel.z + int(level) * resolution, 0));
+		if (value.a > 0.5)
+		{
+			// Shade the voxel faces by the axis the ray entered through
+			float3 localPos = (pos - voxelLevel.xyz) / voxelLevel.w - float3(voxel) - 0.5;
+			float3 absPos = abs(localPos);
+			float shade = (absPos.x > absPos.y && absPos.x > absPos.z) ? 0.8 : ((absPos.y > absPos.z) ? 1.0 : 0.6);
+			return float4(value.rgb * levelColors[level % 4] * shade, 1.0);
+		}
+		dist += voxelLevel.w * 0.5;
+	}
+	return float4(0.5, 0.6, 0.7, 1.0);
+}
@@ -1,5 +1,3 @@
-// Copyright 2020 Google LLC
-
 struct VSOutput
 {
 	float4 Pos : SV_POSITION;
@@ -12,4 +10,4 @@ VSOutput main(uint VertexIndex : SV_VertexID)
 	output.UV = float2((VertexIndex << 1) & 2, VertexIndex & 2);
 	output.Pos = float4(output.UV * 2.0f - 1.0f, 0.0f, 1.0f);
 	return output;
-}
\ No newline at end of file
+}
@@ -0,0 +1,742 @@
+/*
+* Vulkan Example - API overhead microbenchmarks
+*
+* Measures the CPU cost of individual operations in the driver and the framework: draws with and without descriptor set rebinds, pipeline
+* switches, push constant updates, dynamic offsets, push descriptors, descriptor buffer offsets, secondary command buffer execution and queue submissions
+*
+* Every frame records each enabled test with the same number of operations (one draw each, plus the operation under test) into a secondary
+* command buffer of its own and measures the time spent in the recording calls. Subtracting the cost of a plain draw gives the cost of the operation
+* In benchmark mode the averages of the benchmark phase are reported as benchmark metrics in nanoseconds per operation, so runs on different
+* devices and drivers can be compared (and checked against a baseline)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanexamplebase.h"
+
+#define ENABLE_VALIDATION false
+
+// Number of uniform buffer slots (and descriptors) the tests cycle through
+#define SLOT_COUNT 256
+// Number of prerecorded command buffers the secondary command buffer test cycles through
+#define SECONDARY_COUNT 64
+
+class VulkanExample : public VulkanExampleBase
+{
+public:
+	enum Test {
+		TestDraw = 0,
+		TestBindDescriptorSet,
+		TestPipelineSwitch,
+		TestPushConstants,
+		TestDynamicOffset,
+		TestPushDescriptor,
+		TestDescriptorBuffer,
+		TestExecuteSecondary,
+		TestQueueSubmit,
+		TestCount
+	};
+
+	struct TestState {
+		const char* name;
+		bool supported = true;
+		bool enabled = true;
+		// CPU time of the measured operations in ms and their number, reset when the benchmark phase starts
+		double time = 0.0;
+		uint64_t operations = 0;
+		// Index of the test's benchmark metric
+		size_t metric = 0;
+	};
+	std::array<TestState, TestCount> tests;
+
+	// Operations recorded per test and frame, and empty submissions of the queue submit test per frame
+	uint32_t operationCount = 10000;
+	uint32_t submitCount = 100;
+
+	bool pushDescriptorsSupported = false;
+	bool descriptorBuffersSupported = false;
+
+	// Colors of the triangles, one per slot, slots are aligned for dynamic offsets
+	vks::Buffer uniformBuffer;
+	VkDeviceSize slotSize = 0;
+	// Push constant values (screen offsets), one per slot
+	std::vector<glm::vec4> pushOffsets;
+
+	struct {
+		VkDescriptorSetLayout uniform = VK_NULL_HANDLE;
+		VkDescriptorSetLayout dynamic = VK_NULL_HANDLE;
+		VkDescriptorSetLayout push = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorBuffer = VK_NULL_HANDLE;
+	} descriptorSetLayouts;
+
+	// All layouts have the same interface: a uniform buffer at set 0, binding 0 and a vec4 push constant
+	struct {
+		VkPipelineLayout uniform = VK_NULL_HANDLE;
+		VkPipelineLayout dynamic = VK_NULL_HANDLE;
+		VkPipelineLayout push = VK_NULL_HANDLE;
+		VkPipelineLayout descriptorBuffer = VK_NULL_HANDLE;
+	} pipelineLayouts;
+
+	struct {
+		// Same shaders with different specialization constants, alternated by the pipeline switch test
+		std::array<VkPipeline, 2> uniform{};
+		VkPipeline dynamic = VK_NULL_HANDLE;
+		VkPipeline push = VK_NULL_HANDLE;
+		VkPipeline descriptorBuffer = VK_NULL_HANDLE;
+	} pipelines;
+
+	// Two sets pointing at different slots, so drivers can't skip rebinds as redundant
+	std::array<VkDescriptorSet, 2> descriptorSets{};
+	VkDescriptorSet dynamicDescriptorSet = VK_NULL_HANDLE;
+
+	// One write per slot, prepared up front so the push descriptor test only measures the push
+	std::vector<VkDescriptorBufferInfo> slotDescriptors;
+	std::vector<VkWriteDescriptorSet> pushDescriptorWrites;
+	PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR = nullptr;
+
+	// Uniform buffer descriptors of all slots at a fixed stride (VK_EXT_descriptor_buffer)
+	struct DescriptorBuffer {
+		vks::Buffer buffer;
+		VkDeviceSize stride = 0;
+		PFN_vkCmdBindDescriptorBuffersEXT vkCmdBindDescriptorBuffersEXT = nullptr;
+		PFN_vkCmdSetDescriptorBufferOffsetsEXT vkCmdSetDescriptorBufferOffsetsEXT = nullptr;
+	} descriptorBuffer;
+
+	VkPhysicalDeviceBufferDeviceAddressFeatures enabledBufferDeviceAddressFeatures{};
+	VkPhysicalDeviceDescriptorBufferFeaturesEXT enabledDescriptorBufferFeatures{};
+
+	// Per swap chain image, the secondary command buffers of the tests recorded into secondaries and of the UI
+	std::vector<std::array<VkCommandBuffer, TestExecuteSecondary>> testCommandBuffers;
+	std::vector<VkCommandBuffer> uiCommandBuffers;
+	// Draws executed by the secondary command buffer test, recorded once
+	std::array<VkCommandBuffer, SECONDARY_COUNT> prerecordedCommandBuffers{};
+	// Submitted by the queue submit test
+	VkCommandBuffer emptyCommandBuffer = VK_NULL_HANDLE;
+
+	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
+	{
+		title = "API overhead microbenchmarks";
+		supportsFramesInFlight = true;
+		apiVersion = VK_API_VERSION_1_1;
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
+		commandLineParser.add("operations", { "-ops", "--operations" }, 1, "Set the number of operations recorded per test and frame (default 10000)");
+		commandLineParser.add("queuesubmits", { "-qs", "--queuesubmits" }, 1, "Set the number of queue submissions per frame of the queue submit test (default 100)");
+		commandLineParser.parse(args);
+		operationCount = static_cast<uint32_t>(std::max(commandLineParser.getValueAsInt("operations", operationCount), 1));
+		submitCount = static_cast<uint32_t>(std::max(commandLineParser.getValueAsInt("queuesubmits", submitCount), 1));
+
+		const char* names[TestCount] = {
+			"draw",
+			"draw + bind descriptor set",
+			"draw + pipeline switch",
+			"draw + push constants",
+			"draw + dynamic offset",
+			"draw + push descriptor",
+			"draw + descriptor buffer offset",
+			"execute secondary command buffer",
+			"queue submit"
+		};
+		for (uint32_t i = 0; i < TestCount; i++) {
+			tests[i].name = names[i];
+		}
+	}
+
+	~VulkanExample()
+	{
+		if (device) {
+			for (VkPipeline pipeline : pipelines.uniform) {
+				vkDestroyPipeline(device, pipeline, nullptr);
+			}
+			vkDestroyPipeline(device, pipelines.dynamic, nullptr);
+			vkDestroyPipeline(device, pipelines.push, nullptr);
+			vkDestroyPipeline(device, pipelines.descriptorBuffer, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayouts.uniform, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayouts.dynamic, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayouts.push, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayouts.descriptorBuffer, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.uniform, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.dynamic, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.push, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.descriptorBuffer, nullptr);
+			uniformBuffer.destroy();
+			descriptorBuffer.buffer.destroy();
+		}
+		printResults();
+	}
+
+	virtual void getEnabledExtensions()
+	{
+		pushDescriptorsSupported = vulkanDevice->extensionSupported(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+		if (pushDescriptorsSupported) {
+			enabledDeviceExtensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+		}
+
+		// Descriptor buffers also need buffer device addresses and the extensions they depend on for Vulkan 1.1
+		const char* descriptorBufferExtensions[] = { VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME, VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME, VK_KHR_MAINTENANCE3_EXTENSION_NAME };
+		descriptorBuffersSupported = std::all_of(std::begin(descriptorBufferExtensions), std::end(descriptorBufferExtensions), [this](const char* extension) { return vulkanDevice->extensionSupported(extension); });
+		if (descriptorBuffersSupported) {
+			enabledDescriptorBufferFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
+			enabledBufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+			enabledDescriptorBufferFeatures.pNext = &enabledBufferDeviceAddressFeatures;
+			VkPhysicalDeviceFeatures2 features2{};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features2.pNext = &enabledDescriptorBufferFeatures;
+			vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+			descriptorBuffersSupported = enabledDescriptorBufferFeatures.descriptorBuffer && enabledBufferDeviceAddressFeatures.bufferDeviceAddress;
+		}
+		if (descriptorBuffersSupported) {
+			for (const char* extension : descriptorBufferExtensions) {
+				enabledDeviceExtensions.push_back(extension);
+			}
+			// Only enable the features the example uses
+			enabledDescriptorBufferFeatures = {};
+			enabledDescriptorBufferFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
+			enabledDescriptorBufferFeatures.descriptorBuffer = VK_TRUE;
+			enabledDescriptorBufferFeatures.pNext = &enabledBufferDeviceAddressFeatures;
+			enabledBufferDeviceAddressFeatures = {};
+			enabledBufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+			enabledBufferDeviceAddressFeatures.bufferDeviceAddress = VK_TRUE;
+			enabledBufferDeviceAddressFeatures.pNext = deviceCreatepNextChain;
+			deviceCreatepNextChain = &enabledDescriptorBufferFeatures;
+		}
+
+		tests[TestPushDescriptor].supported = pushDescriptorsSupported;
+		tests[TestDescriptorBuffer].supported = descriptorBuffersSupported;
+	}
+
+	void prepareUniformBuffer()
+	{
+		const VkDeviceSize alignment = vulkanDevice->properties.limits.minUniformBufferOffsetAlignment;
+		slotSize = (sizeof(glm::vec4) + alignment - 1) / alignment * alignment;
+		const VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | (descriptorBuffersSupported ? VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT : 0);
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffer, slotSize * SLOT_COUNT));
+		VK_CHECK_RESULT(uniformBuffer.map());
+		std::default_random_engine rndEngine(0);
+		std::uniform_real_distribution<float> rndColor(0.25f, 1.0f);
+		std::uniform_real_distribution<float> rndOffset(-0.002f, 0.002f);
+		pushOffsets.resize(SLOT_COUNT);
+		slotDescriptors.resize(SLOT_COUNT);
+		for (uint32_t i = 0; i < SLOT_COUNT; i++) {
+			const glm::vec4 color(rndColor(rndEngine), rndColor(rndEngine), rndColor(rndEngine), 1.0f);
+			memcpy(static_cast<char*>(uniformBuffer.mapped) + slotSize * i, &color, sizeof(glm::vec4));
+			pushOffsets[i] = glm::vec4(rndOffset(rndEngine), rndOffset(rndEngine), 0.0f, 0.0f);
+			slotDescriptors[i] = { uniformBuffer.buffer, slotSize * i, sizeof(glm::vec4) };
+		}
+	}
+
+	void setupDescriptors()
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		// Binding 0 : Vertex shader uniform buffer, with the descriptor type and layout flags of each test
+		VkDescriptorSetLayoutBinding setLayoutBinding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(&setLayoutBinding, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.uniform));
+		if (pushDescriptorsSupported) {
+			descriptorLayoutCI.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.push));
+		}
+		if (descriptorBuffersSupported) {
+			descriptorLayoutCI.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.descriptorBuffer));
+		}
+		descriptorLayoutCI.flags = 0;
+		setLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.dynamic));
+
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+		for (size_t i = 0; i < descriptorSets.size(); i++) {
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.uniform, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets[i]));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &slotDescriptors[i]));
+		}
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.dynamic, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &dynamicDescriptorSet));
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(dynamicDescriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &slotDescriptors[0]));
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		if (pushDescriptorsSupported) {
+			vkCmdPushDescriptorSetKHR = reinterpret_cast<PFN_vkCmdPushDescriptorSetKHR>(vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetKHR"));
+			pushDescriptorWrites.resize(SLOT_COUNT);
+			for (uint32_t i = 0; i < SLOT_COUNT; i++) {
+				pushDescriptorWrites[i] = vks::initializers::writeDescriptorSet(VK_NULL_HANDLE, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &slotDescriptors[i]);
+			}
+		}
+
+		if (descriptorBuffersSupported) {
+			prepareDescriptorBuffer();
+		}
+	}
+
+	// Writes the descriptors of all slots into a descriptor buffer, draws select theirs with an offset
+	void prepareDescriptorBuffer()
+	{
+		PFN_vkGetDescriptorSetLayoutSizeEXT vkGetDescriptorSetLayoutSizeEXT = reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(vkGetDeviceProcAddr(device, "vkGetDescriptorSetLayoutSizeEXT"));
+		PFN_vkGetDescriptorSetLayoutBindingOffsetEXT vkGetDescriptorSetLayoutBindingOffsetEXT = reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(vkGetDeviceProcAddr(device, "vkGetDescriptorSetLayoutBindingOffsetEXT"));
+		PFN_vkGetDescriptorEXT vkGetDescriptorEXT = reinterpret_cast<PFN_vkGetDescriptorEXT>(vkGetDeviceProcAddr(device, "vkGetDescriptorEXT"));
+		descriptorBuffer.vkCmdBindDescriptorBuffersEXT = reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>(vkGetDeviceProcAddr(device, "vkCmdBindDescriptorBuffersEXT"));
+		descriptorBuffer.vkCmdSetDescriptorBufferOffsetsEXT = reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDescriptorBufferOffsetsEXT"));
+
+		VkPhysicalDeviceDescriptorBufferPropertiesEXT descriptorBufferProperties{};
+		descriptorBufferProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT;
+		VkPhysicalDeviceProperties2 deviceProperties2{};
+		deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		deviceProperties2.pNext = &descriptorBufferProperties;
+		vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+
+		const VkDeviceSize alignment = descriptorBufferProperties.descriptorBufferOffsetAlignment;
+		vkGetDescriptorSetLayoutSizeEXT(device, descriptorSetLayouts.descriptorBuffer, &descriptorBuffer.stride);
+		descriptorBuffer.stride = std::max((descriptorBuffer.stride + alignment - 1) / alignment * alignment, alignment);
+		VkDeviceSize bindingOffset = 0;
+		vkGetDescriptorSetLayoutBindingOffsetEXT(device, descriptorSetLayouts.descriptorBuffer, 0, &bindingOffset);
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&descriptorBuffer.buffer,
+			descriptorBuffer.stride * SLOT_COUNT));
+		VK_CHECK_RESULT(descriptorBuffer.buffer.map());
+
+		const VkDeviceAddress uniformAddress = uniformBuffer.getDeviceAddress();
+		for (uint32_t i = 0; i < SLOT_COUNT; i++) {
+			VkDescriptorAddressInfoEXT addressInfo{};
+			addressInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT;
+			addressInfo.address = uniformAddress + slotDescriptors[i].offset;
+			addressInfo.range = slotDescriptors[i].range;
+			addressInfo.format = VK_FORMAT_UNDEFINED;
+			VkDescriptorGetInfoEXT descriptorInfo{};
+			descriptorInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+			descriptorInfo.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			descriptorInfo.data.pUniformBuffer = &addressInfo;
+			vkGetDescriptorEXT(device, &descriptorInfo, descriptorBufferProperties.uniformBufferDescriptorSize, static_cast<char*>(descriptorBuffer.buffer.mapped) + descriptorBuffer.stride * i + bindingOffset);
+		}
+	}
+
+	void preparePipelines()
+	{
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::vec4), 0);
+		auto createPipelineLayout = [&](VkDescriptorSetLayout setLayout, VkPipelineLayout *pipelineLayout) {
+			VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&setLayout, 1);
+			pipelineLayoutCI.pushConstantRangeCount = 1;
+			pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, pipelineLayout));
+		};
+		createPipelineLayout(descriptorSetLayouts.uniform, &pipelineLayouts.uniform);
+		createPipelineLayout(descriptorSetLayouts.dynamic, &pipelineLayouts.dynamic);
+		if (pushDescriptorsSupported) {
+			createPipelineLayout(descriptorSetLayouts.push, &pipelineLayouts.push);
+		}
+		if (descriptorBuffersSupported) {
+			createPipelineLayout(descriptorSetLayouts.descriptorBuffer, &pipelineLayouts.descriptorBuffer);
+		}
+
+		// The triangles don't overlap, so there's no need for depth testing
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayouts.uniform, renderPass);
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.pVertexInputState = &emptyInputState;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+
+		shaderStages[0] = loadShader(getShadersPath() + "apioverhead/triangle.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "apioverhead/triangle.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		// Brightness of the triangles
+		float brightness = 1.0f;
+		VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(float));
+		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(float), &brightness);
+		shaderStages[0].pSpecializationInfo = &specializationInfo;
+
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.uniform[0]));
+		brightness = 0.5f;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.uniform[1]));
+		brightness = 1.0f;
+
+		pipelineCI.layout = pipelineLayouts.dynamic;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.dynamic));
+		if (pushDescriptorsSupported) {
+			pipelineCI.layout = pipelineLayouts.push;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.push));
+		}
+		if (descriptorBuffersSupported) {
+			pipelineCI.layout = pipelineLayouts.descriptorBuffer;
+			pipelineCI.flags = VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.descriptorBuffer));
+		}
+	}
+
+	void prepareCommandBuffers()
+	{
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+		testCommandBuffers.resize(drawCmdBuffers.size());
+		uiCommandBuffers.resize(drawCmdBuffers.size());
+		for (size_t i = 0; i < drawCmdBuffers.size(); i++) {
+			cmdBufAllocateInfo.commandBufferCount = static_cast<uint32_t>(testCommandBuffers[i].size());
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, testCommandBuffers[i].data()));
+			cmdBufAllocateInfo.commandBufferCount = 1;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &uiCommandBuffers[i]));
+		}
+		cmdBufAllocateInfo.commandBufferCount = SECONDARY_COUNT;
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, prerecordedCommandBuffers.data()));
+		recordPrerecordedCommandBuffers();
+
+		// The empty command buffer is pending several times per frame
+		cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &emptyCommandBuffer));
+		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(emptyCommandBuffer, &commandBufferBeginInfo));
+		VK_CHECK_RESULT(vkEndCommandBuffer(emptyCommandBuffer));
+	}
+
+	// The secondary command buffer test executes these, every one draws a single triangle with its own state
+	void recordPrerecordedCommandBuffers()
+	{
+		// Not bound to a framebuffer, so the command buffers can be executed in the render pass of any swap chain image
+		VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+		commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+		for (uint32_t i = 0; i < SECONDARY_COUNT; i++) {
+			VkCommandBuffer commandBuffer = prerecordedCommandBuffers[i];
+			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+			setupTestState(commandBuffer, TestDraw);
+			vkCmdDraw(commandBuffer, 3, 1, (operationCount + i) * 3, 0);
+			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+		}
+	}
+
+	// Records the state all operations of a test share, a secondary command buffer doesn't inherit any state
+	void setupTestState(VkCommandBuffer commandBuffer, Test test)
+	{
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		VkPipelineLayout pipelineLayout = pipelineLayouts.uniform;
+		switch (test) {
+		case TestDynamicOffset:
+			pipelineLayout = pipelineLayouts.dynamic;
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.dynamic);
+			break;
+		case TestPushDescriptor:
+			pipelineLayout = pipelineLayouts.push;
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.push);
+			break;
+		case TestDescriptorBuffer: {
+			pipelineLayout = pipelineLayouts.descriptorBuffer;
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.descriptorBuffer);
+			VkDescriptorBufferBindingInfoEXT bindingInfo{};
+			bindingInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
+			bindingInfo.address = descriptorBuffer.buffer.getDeviceAddress();
+			bindingInfo.usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT;
+			descriptorBuffer.vkCmdBindDescriptorBuffersEXT(commandBuffer, 1, &bindingInfo);
+			break;
+		}
+		default:
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.uniform[0]);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[0], 0, nullptr);
+		}
+		// Every pipeline reads the push constants, so they're set once even if the test doesn't update them
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec4), &pushOffsets[0]);
+	}
+
+	// Records the measured operations of a test, every operation draws a triangle (selected by the first vertex) after the operation under test
+	void recordTestOperations(VkCommandBuffer commandBuffer, Test test)
+	{
+		const uint32_t count = operationCount;
+		switch (test) {
+		case TestDraw:
+			for (uint32_t i = 0; i < count; i++) {
+				vkCmdDraw(commandBuffer, 3, 1, i * 3, 0);
+			}
+			break;
+		case TestBindDescriptorSet:
+			for (uint32_t i = 0; i < count; i++) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.uniform, 0, 1, &descriptorSets[i % 2], 0, nullptr);
+				vkCmdDraw(commandBuffer, 3, 1, i * 3, 0);
+			}
+			break;
+		case TestPipelineSwitch:
+			for (uint32_t i = 0; i < count; i++) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.uniform[i % 2]);
+				vkCmdDraw(commandBuffer, 3, 1, i * 3, 0);
+			}
+			break;
+		case TestPushConstants:
+			for (uint32_t i = 0; i < count; i++) {
+				vkCmdPushConstants(commandBuffer, pipelineLayouts.uniform, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec4), &pushOffsets[i % SLOT_COUNT]);
+				vkCmdDraw(commandBuffer, 3, 1, i * 3, 0);
+			}
+			break;
+		case TestDynamicOffset:
+			for (uint32_t i = 0; i < count; i++) {
+				const uint32_t dynamicOffset = static_cast<uint32_t>(slotSize * (i % SLOT_COUNT));
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.dynamic, 0, 1, &dynamicDescriptorSet, 1, &dynamicOffset);
+				vkCmdDraw(commandBuffer, 3, 1, i * 3, 0);
+			}
+			break;
+		case TestPushDescriptor:
+			for (uint32_t i = 0; i < count; i++) {
+				vkCmdPushDescriptorSetKHR(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.push, 0, 1, &pushDescriptorWrites[i % SLOT_COUNT]);
+				vkCmdDraw(commandBuffer, 3, 1, i * 3, 0);
+			}
+			break;
+		case TestDescriptorBuffer: {
+			const uint32_t bufferIndex = 0;
+			for (uint32_t i = 0; i < count; i++) {
+				const VkDeviceSize offset = descriptorBuffer.stride * (i % SLOT_COUNT);
+				descriptorBuffer.vkCmdSetDescriptorBufferOffsetsEXT(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.descriptorBuffer, 0, 1, &bufferIndex, &offset);
+				vkCmdDraw(commandBuffer, 3, 1, i * 3, 0);
+			}
+			break;
+		}
+		case TestExecuteSecondary:
+			// Recorded into the primary command buffer, one call per command buffer
+			for (uint32_t i = 0; i < count; i++) {
+				vkCmdExecuteCommands(commandBuffer, 1, &prerecordedCommandBuffers[i % SECONDARY_COUNT]);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	void addTestTime(Test test, std::chrono::high_resolution_clock::time_point tStart, uint32_t operations)
+	{
+		tests[test].time += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		tests[test].operations += operations;
+	}
+
+	void recordCommandBuffer()
+	{
+		VkCommandBuffer commandBuffer = drawCmdBuffers[currentBuffer];
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[currentBuffer];
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+		// All tests share one subpass, which can only contain secondary command buffers
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+		VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.framebuffer = frameBuffers[currentBuffer];
+		VkCommandBufferBeginInfo secondaryBeginInfo = vks::initializers::commandBufferBeginInfo();
+		secondaryBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		secondaryBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		// Only the operations are measured, not beginning and ending the command buffer or setting up the shared state
+		for (uint32_t i = 0; i < TestExecuteSecondary; i++) {
+			const Test test = static_cast<Test>(i);
+			if (!tests[test].supported || !tests[test].enabled) {
+				continue;
+			}
+			VkCommandBuffer testCommandBuffer = testCommandBuffers[currentBuffer][test];
+			VK_CHECK_RESULT(vkBeginCommandBuffer(testCommandBuffer, &secondaryBeginInfo));
+			setupTestState(testCommandBuffer, test);
+			const auto tStart = std::chrono::high_resolution_clock::now();
+			recordTestOperations(testCommandBuffer, test);
+			addTestTime(test, tStart, operationCount);
+			VK_CHECK_RESULT(vkEndCommandBuffer(testCommandBuffer));
+			vkCmdExecuteCommands(commandBuffer, 1, &testCommandBuffer);
+		}
+
+		if (tests[TestExecuteSecondary].enabled) {
+			const auto tStart = std::chrono::high_resolution_clock::now();
+			recordTestOperations(commandBuffer, TestExecuteSecondary);
+			addTestTime(TestExecuteSecondary, tStart, operationCount);
+		}
+
+		if (UIOverlay.visible) {
+			VK_CHECK_RESULT(vkBeginCommandBuffer(uiCommandBuffers[currentBuffer], &secondaryBeginInfo));
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+			vkCmdSetViewport(uiCommandBuffers[currentBuffer], 0, 1, &viewport);
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+			vkCmdSetScissor(uiCommandBuffers[currentBuffer], 0, 1, &scissor);
+			drawUI(uiCommandBuffers[currentBuffer]);
+			VK_CHECK_RESULT(vkEndCommandBuffer(uiCommandBuffers[currentBuffer]));
+			vkCmdExecuteCommands(commandBuffer, 1, &uiCommandBuffers[currentBuffer]);
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	// Submits the empty command buffer, one submission each, ahead of the frame's command buffer
+	void submitEmptyCommandBuffers()
+	{
+		VkSubmitInfo emptySubmitInfo = vks::initializers::submitInfo();
+		emptySubmitInfo.commandBufferCount = 1;
+		emptySubmitInfo.pCommandBuffers = &emptyCommandBuffer;
+		const auto tStart = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < submitCount; i++) {
+			VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &emptySubmitInfo, VK_NULL_HANDLE));
+		}
+		addTestTime(TestQueueSubmit, tStart, submitCount);
+	}
+
+	// Average cost of an operation of a test in nanoseconds
+	double getTestCost(const TestState &test) const
+	{
+		return (test.operations > 0) ? test.time * 1000000.0 / static_cast<double>(test.operations) : 0.0;
+	}
+
+	void updateMetrics()
+	{
+		for (const TestState &test : tests) {
+			if (test.supported) {
+				benchmark.metrics[test.metric].second = getTestCost(test);
+			}
+		}
+	}
+
+	void resetResults()
+	{
+		for (TestState &test : tests) {
+			test.time = 0.0;
+			test.operations = 0;
+		}
+	}
+
+	void printResults()
+	{
+		std::cout << std::fixed << std::setprecision(1);
+		std::cout << "API overhead (" << operationCount << " operations per test and frame, " << submitCount << " queue submissions per frame):" << "\n";
+		for (const TestState &test : tests) {
+			if (!test.supported) {
+				std::cout << "  " << test.name << ": not supported" << "\n";
+			}
+			else if (test.operations > 0) {
+				const double cost = getTestCost(test);
+				std::cout << "  " << test.name << ": " << cost << " ns (" << ((cost > 0.0) ? 1000.0 / cost : 0.0) << " million per second)" << "\n";
+			}
+		}
+	}
+
+	void draw()
+	{
+		VulkanExampleBase::prepareFrame();
+
+		// Only the benchmark phase is measured
+		if (benchmark.active && !benchmark.warmingUp && (benchmark.phaseFrame == 0)) {
+			resetResults();
+		}
+
+		recordCommandBuffer();
+
+		if (tests[TestQueueSubmit].enabled) {
+			submitEmptyCommandBuffers();
+		}
+
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
+
+		VulkanExampleBase::submitFrame();
+
+		if (benchmark.active) {
+			updateMetrics();
+		}
+	}
+
+	void prepare()
+	{
+		VulkanExampleBase::prepare();
+		prepareUniformBuffer();
+		setupDescriptors();
+		preparePipelines();
+		prepareCommandBuffers();
+		// Registered up front, so updating the values doesn't allocate while benchmarking
+		for (TestState &test : tests) {
+			if (test.supported) {
+				test.metric = benchmark.addMetric(std::string(test.name) + " (ns)");
+			}
+		}
+		prepared = true;
+	}
+
+	virtual void render()
+	{
+		if (!prepared)
+			return;
+		draw();
+	}
+
+	virtual void windowResized()
+	{
+		// The prerecorded command buffers set the viewport and scissor
+		vkDeviceWaitIdle(device);
+		recordPrerecordedCommandBuffers();
+	}
+
+	virtual void buildCommandBuffers()
+	{
+		// Command buffers are recorded every frame
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Cost per operation")) {
+			for (TestState &test : tests) {
+				if (!test.supported) {
+					overlay->text("%s: not supported", test.name);
+					continue;
+				}
+				const double cost = getTestCost(test);
+				overlay->checkBox(test.name, &test.enabled);
+				overlay->text("%.1f ns (%.2f M/s)", cost, (cost > 0.0) ? 1000.0 / cost : 0.0);
+			}
+			if (overlay->button("Reset")) {
+				resetResults();
+			}
+		}
+		if (overlay->header("Settings")) {
+			overlay->text("Operations per test: %d", operationCount);
+			overlay->text("Queue submissions: %d", submitCount);
+		}
+	}
+};
+
+VULKAN_EXAMPLE_MAIN()
@@ -1,6 +1,11 @@
 /*
 * Vulkan Example - Implements a separable two-pass fullscreen blur (also known as bloom)
 *
+* Alternatively builds the bloom in compute with a progressive downsample and tent filter upsample chain (vks::BloomChain), whose cost
+* doesn't grow with the blur radius
+*
+* The offscreen passes are recorded by a render graph (vks::RenderGraph), which creates their render passes, framebuffers and barriers
+*
 * Copyright (C) Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -8,6 +13,10 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanFrameBuffer.hpp"
+#include "VulkanBloom.h"
+#include "VulkanRenderGraph.h"
+#include <memory>
 
 #define ENABLE_VALIDATION false
 
@@ -19,6 +28,10 @@ class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool bloom = true;
+	// Use the compute mip chain instead of the separable blur
+	bool computeBloom = true;
+	float bloomRadius = 1.0f;
+	std::unique_ptr<vks::BloomChain> bloomChain;
 
 	vks::TextureCubeMap cubemap;
 
@@ -53,6 +66,7 @@ public:
 	struct {
 		VkPipeline blurVert;
 		VkPipeline blurHorz;
+		VkPipeline bloomComposite;
 		VkPipeline glowPass;
 		VkPipeline phongPass;
 		VkPipeline skyBox;
@@ -66,6 +80,7 @@ public:
 	struct {
 		VkDescriptorSet blurVert;
 		VkDescriptorSet blurHorz;
+		VkDescriptorSet bloomComposite;
 		VkDescriptorSet scene;
 		VkDescriptorSet skyBox;
 	} descriptorSets;
@@ -75,24 +90,37 @@ public:
 		VkDescriptorSetLayout scene;
 	} descriptorSetLayouts;
 
-	// Framebuffer for offscreen rendering
+	// Color targets of the offscreen passes, imported into the render graphs
 	struct FrameBufferAttachment {
 		VkImage image;
 		VkDeviceMemory mem;
 		VkImageView view;
+		vks::ImageCompression compression;
 	};
 	struct FrameBuffer {
-		VkFramebuffer framebuffer;
-		FrameBufferAttachment color, depth;
+		FrameBufferAttachment color;
 		VkDescriptorImageInfo descriptor;
 	};
 	struct OffscreenPass {
 		int32_t width, height;
-		VkRenderPass renderPass;
 		VkSampler sampler;
 		std::array<FrameBuffer, 2> framebuffers;
 	} offscreenPass;
 
+	/*
+		One graph per bloom method, both render the glow pass into the first offscreen target
+		The separable blur graph adds the vertical blur into the second target, the compute graph the bloom mip chain
+		The depth buffer of the glow pass is a transient image of the graphs
+	*/
+	struct {
+		std::unique_ptr<vks::RenderGraph> blur;
+		std::unique_ptr<vks::RenderGraph> compute;
+	} graphs;
+	struct {
+		vks::RenderGraph::Pass *glow;
+		vks::RenderGraph::Pass *verticalBlur;
+	} graphPasses;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Bloom (offscreen rendering)";
@@ -108,25 +136,25 @@ public:
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
 
+		bloomChain.reset();
+
+		// The graphs own the render passes and framebuffers
+		graphs.blur.reset();
+		graphs.compute.reset();
+
 		vkDestroySampler(device, offscreenPass.sampler, nullptr);
 
-		// Frame buffer
+		// Color targets
 		for (auto& framebuffer : offscreenPass.framebuffers)
 		{
-			// Attachments
 			vkDestroyImageView(device, framebuffer.color.view, nullptr);
 			vkDestroyImage(device, framebuffer.color.image, nullptr);
 			vkFreeMemory(device, framebuffer.color.mem, nullptr);
-			vkDestroyImageView(device, framebuffer.depth.view, nullptr);
-			vkDestroyImage(device, framebuffer.depth.image, nullptr);
-			vkFreeMemory(device, framebuffer.depth.mem, nullptr);
-
-			vkDestroyFramebuffer(device, framebuffer.framebuffer, nullptr);
 		}
-		vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
 
 		vkDestroyPipeline(device, pipelines.blurHorz, nullptr);
 		vkDestroyPipeline(device, pipelines.blurVert, nullptr);
+		vkDestroyPipeline(device, pipelines.bloomComposite, nullptr);
 		vkDestroyPipeline(device, pipelines.phongPass, nullptr);
 		vkDestroyPipeline(device, pipelines.glowPass, nullptr);
 		vkDestroyPipeline(device, pipelines.skyBox, nullptr);
@@ -145,11 +173,11 @@ public:
 		cubemap.destroy();
 	}
 
-	// Setup the offscreen framebuffer for rendering the mirrored scene
-	// The color attachment of this framebuffer will then be sampled from
-	void prepareOffscreenFramebuffer(FrameBuffer *frameBuf, VkFormat colorFormat, VkFormat depthFormat)
+	// Setup the color target of an offscreen pass, render passes and framebuffers are created by the render graphs
+	// The color attachment of this target will then be sampled from
+	// It only holds the glowing parts of the scene and their blur, so it may use lossy fixed-rate compression if requested
+	void prepareOffscreenFramebuffer(FrameBuffer *frameBuf, VkFormat colorFormat)
 	{
-		// Color attachment
 		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
 		image.imageType = VK_IMAGE_TYPE_2D;
 		image.format = colorFormat;
@@ -177,7 +205,7 @@ public:
 		colorImageView.subresourceRange.baseArrayLayer = 0;
 		colorImageView.subresourceRange.layerCount = 1;
 
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &frameBuf->color.image));
+		VK_CHECK_RESULT(vks::createAttachmentImage(vulkanDevice, image, settings.imageCompression, &frameBuf->color.image, &frameBuf->color.compression));
 		vkGetImageMemoryRequirements(device, frameBuf->color.image, &memReqs);
 		memAlloc.allocationSize = memReqs.size;
 		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
@@ -187,54 +215,35 @@ public:
 		colorImageView.image = frameBuf->color.image;
 		VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &frameBuf->color.view));
 
-		// Depth stencil attachment
-		image.format = depthFormat;
-		image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-
-		VkImageViewCreateInfo depthStencilView = vks::initializers::imageViewCreateInfo();
-		depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		depthStencilView.format = depthFormat;
-		depthStencilView.flags = 0;
-		depthStencilView.subresourceRange = {};
-		depthStencilView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-		if (vks::tools::formatHasStencil(depthFormat)) {
-			depthStencilView.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-		}
-		depthStencilView.subresourceRange.baseMipLevel = 0;
-		depthStencilView.subresourceRange.levelCount = 1;
-		depthStencilView.subresourceRange.baseArrayLayer = 0;
-		depthStencilView.subresourceRange.layerCount = 1;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &frameBuf->depth.image));
-		vkGetImageMemoryRequirements(device, frameBuf->depth.image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &frameBuf->depth.mem));
-		VK_CHECK_RESULT(vkBindImageMemory(device, frameBuf->depth.image, frameBuf->depth.mem, 0));
-
-		depthStencilView.image = frameBuf->depth.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &frameBuf->depth.view));
-
-		VkImageView attachments[2];
-		attachments[0] = frameBuf->color.view;
-		attachments[1] = frameBuf->depth.view;
-
-		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-		fbufCreateInfo.renderPass = offscreenPass.renderPass;
-		fbufCreateInfo.attachmentCount = 2;
-		fbufCreateInfo.pAttachments = attachments;
-		fbufCreateInfo.width = FB_DIM;
-		fbufCreateInfo.height = FB_DIM;
-		fbufCreateInfo.layers = 1;
-
-		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuf->framebuffer));
-
 		// Fill a descriptor for later use in a descriptor set
 		frameBuf->descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		frameBuf->descriptor.imageView = frameBuf->color.view;
 		frameBuf->descriptor.sampler = offscreenPass.sampler;
 	}
 
+	// Add the glow pass rendering the glowing parts of the model (separate mesh) to the glow target, returns the glow target's handle
+	vks::RenderGraph::ImageHandle addGlowPass(vks::RenderGraph &graph, VkFormat depthFormat, vks::RenderGraph::Pass **pass = nullptr)
+	{
+		const FrameBuffer &target = offscreenPass.framebuffers[0];
+		vks::RenderGraph::ImageHandle glow = graph.importImage("glow", target.color.image, target.color.view, FB_COLOR_FORMAT, FB_DIM, FB_DIM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		vks::RenderGraph::ImageHandle depth = graph.createImage("glow depth", vks::RenderGraph::ImageInfo(depthFormat));
+		vks::RenderGraph::Pass &glowPass = graph.addPass("glow", vks::RenderGraph::PassType::Graphics, [this](VkCommandBuffer commandBuffer, const vks::RenderGraph::PassContext &context) {
+			VkViewport viewport = vks::initializers::viewport((float)context.extent.width, (float)context.extent.height, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			VkRect2D scissor = vks::initializers::rect2D(context.extent.width, context.extent.height, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.glowPass);
+			models.ufoGlow.draw(commandBuffer);
+		});
+		glowPass.writeColor(glow, { { 0.0f, 0.0f, 0.0f, 1.0f } });
+		glowPass.writeDepth(depth, { 1.0f, 0 });
+		if (pass) {
+			*pass = &glowPass;
+		}
+		return glow;
+	}
+
 	// Prepare the offscreen framebuffers used for the vertical- and horizontal blur
 	void prepareOffscreen()
 	{
@@ -246,68 +255,6 @@ public:
 		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &fbDepthFormat);
 		assert(validDepthFormat);
 
-		// Create a separate render pass for the offscreen rendering as it may differ from the one used for scene rendering
-
-		std::array<VkAttachmentDescription, 2> attchmentDescriptions = {};
-		// Color attachment
-		attchmentDescriptions[0].format = FB_COLOR_FORMAT;
-		attchmentDescriptions[0].samples = VK_SAMPLE_COUNT_1_BIT;
-		attchmentDescriptions[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attchmentDescriptions[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		attchmentDescriptions[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attchmentDescriptions[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attchmentDescriptions[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attchmentDescriptions[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		// Depth attachment
-		attchmentDescriptions[1].format = fbDepthFormat;
-		attchmentDescriptions[1].samples = VK_SAMPLE_COUNT_1_BIT;
-		attchmentDescriptions[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attchmentDescriptions[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attchmentDescriptions[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attchmentDescriptions[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attchmentDescriptions[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attchmentDescriptions[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
-		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
-
-		VkSubpassDescription subpassDescription = {};
-		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpassDescription.colorAttachmentCount = 1;
-		subpassDescription.pColorAttachments = &colorReference;
-		subpassDescription.pDepthStencilAttachment = &depthReference;
-
-		// Use subpass dependencies for layout transitions
-		std::array<VkSubpassDependency, 2> dependencies;
-
-		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-		dependencies[1].srcSubpass = 0;
-		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-		// Create the actual renderpass
-		VkRenderPassCreateInfo renderPassInfo = {};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.attachmentCount = static_cast<uint32_t>(attchmentDescriptions.size());
-		renderPassInfo.pAttachments = attchmentDescriptions.data();
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = &subpassDescription;
-		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
-		renderPassInfo.pDependencies = dependencies.data();
-
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &offscreenPass.renderPass));
-
 		// Create sampler to sample from the color attachments
 		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
 		sampler.magFilter = VK_FILTER_LINEAR;
@@ -323,9 +270,53 @@ public:
 		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &offscreenPass.sampler));
 
-		// Create two frame buffers
-		prepareOffscreenFramebuffer(&offscreenPass.framebuffers[0], FB_COLOR_FORMAT, fbDepthFormat);
-		prepareOffscreenFramebuffer(&offscreenPass.framebuffers[1], FB_COLOR_FORMAT, fbDepthFormat);
+		// Create two color targets
+		prepareOffscreenFramebuffer(&offscreenPass.framebuffers[0], FB_COLOR_FORMAT);
+		prepareOffscreenFramebuffer(&offscreenPass.framebuffers[1], FB_COLOR_FORMAT);
+
+		/*
+			Separable blur: Render the glow pass and blur it vertically into the second target
+			The passes stay separate render passes, as the blur samples neighbouring texels of the glow target
+		*/
+		graphs.blur.reset(new vks::RenderGraph(vulkanDevice, offscreenPass.width, offscreenPass.height));
+		const vks::RenderGraph::ImageHandle blurGlow = addGlowPass(*graphs.blur, fbDepthFormat, &graphPasses.glow);
+		const FrameBuffer &blurTarget = offscreenPass.framebuffers[1];
+		const vks::RenderGraph::ImageHandle verticalBlur = graphs.blur->importImage("vertical blur", blurTarget.color.image, blurTarget.color.view, FB_COLOR_FORMAT, FB_DIM, FB_DIM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		graphPasses.verticalBlur = &graphs.blur->addPass("vertical blur", vks::RenderGraph::PassType::Graphics, [this](VkCommandBuffer commandBuffer, const vks::RenderGraph::PassContext &context) {
+			VkViewport viewport = vks::initializers::viewport((float)context.extent.width, (float)context.extent.height, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			VkRect2D scissor = vks::initializers::rect2D(context.extent.width, context.extent.height, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurVert, 0, NULL);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurVert);
+			vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+		});
+		graphPasses.verticalBlur->readSampled(blurGlow, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		graphPasses.verticalBlur->writeColor(verticalBlur, { { 0.0f, 0.0f, 0.0f, 1.0f } });
+		graphs.blur->compile();
+
+		// The compute bloom chain is built from the glow pass, the glow parts are already isolated so no threshold is needed
+		bloomChain.reset(new vks::BloomChain(vulkanDevice, getShadersPath() + "base/bloomdownsample.comp.spv", getShadersPath() + "base/bloomupsample.comp.spv"));
+		if (bloomChain->isSupported()) {
+			bloomChain->setThreshold(0.0f, 0.0f);
+			bloomChain->setRadius(bloomRadius);
+			bloomChain->create(offscreenPass.width, offscreenPass.height, offscreenPass.framebuffers[0].color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+			/*
+				Compute bloom: Render the glow pass and downsample it through the mip chain and upsample it back with a tent filter
+				The chain's output isn't an image of the graph, so the compute pass only declares its read of the glow target (and isn't culled)
+				The glow pass renders with the pipeline created for the separable blur graph's render pass, which is compatible
+			*/
+			graphs.compute.reset(new vks::RenderGraph(vulkanDevice, offscreenPass.width, offscreenPass.height));
+			const vks::RenderGraph::ImageHandle computeGlow = addGlowPass(*graphs.compute, fbDepthFormat);
+			vks::RenderGraph::Pass &bloomPass = graphs.compute->addPass("bloom chain", vks::RenderGraph::PassType::Compute, [this](VkCommandBuffer commandBuffer, const vks::RenderGraph::PassContext &) {
+				bloomChain->record(commandBuffer);
+			});
+			bloomPass.readSampled(computeGlow, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			graphs.compute->compile();
+		} else {
+			computeBloom = false;
+		}
 	}
 
 	void buildCommandBuffers()
@@ -333,8 +324,6 @@ public:
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VkClearValue clearValues[2];
-		VkViewport viewport;
-		VkRect2D scissor;
 
 		/*
 			The blur method used in this example is multi pass and renders the vertical blur first and then the horizontal one
@@ -345,58 +334,13 @@ public:
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			if (bloom) {
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = offscreenPass.renderPass;
-				renderPassBeginInfo.framebuffer = offscreenPass.framebuffers[0].framebuffer;
-				renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
-				renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues;
-
-				viewport = vks::initializers::viewport((float)offscreenPass.width, (float)offscreenPass.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				scissor = vks::initializers::rect2D(offscreenPass.width, offscreenPass.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				/*
-					First render pass: Render glow parts of the model (separate mesh) to an offscreen frame buffer
-				*/
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.glowPass);
-
-				models.ufoGlow.draw(drawCmdBuffers[i]);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				/*
-					Second render pass: Vertical blur
-
-					Render contents of the first pass into a second framebuffer and apply a vertical blur
-					This is the first blur pass, the horizontal blur is applied when rendering on top of the scene
-				*/
-
-				renderPassBeginInfo.framebuffer = offscreenPass.framebuffers[1].framebuffer;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurVert, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurVert);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-			}
-
 			/*
-				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
+				First and second pass: Glow parts of the model and the vertical blur (or the compute bloom chain)
+				The graph records the barriers between the passes and leaves the targets ready to be sampled by the scene pass
 			*/
+			if (bloom) {
+				(computeBloom ? graphs.compute : graphs.blur)->execute(drawCmdBuffers[i]);
+			}
 
 			/*
 				Third render pass: Scene rendering with applied vertical blur
@@ -434,7 +378,13 @@ public:
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phongPass);
 				models.ufo.draw(drawCmdBuffers[i]);
 
-				if (bloom)
+				if (bloom && computeBloom)
+				{
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.bloomComposite, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.bloomComposite);
+					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				}
+				else if (bloom)
 				{
 					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurHorz, 0, NULL);
 					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurHorz);
@@ -463,10 +413,10 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 8),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 9),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7)
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 5);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 6);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -521,6 +471,17 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSets.blurHorz, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &offscreenPass.framebuffers[1].descriptor),	// Binding 1: Fragment shader texture sampler
 		};
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+		// Compute bloom composition
+		if (bloomChain->isSupported()) {
+			VkDescriptorImageInfo bloomDescriptor = bloomChain->getDescriptor();
+			descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.blur, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSets.bloomComposite));
+			writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSets.bloomComposite, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.blurParams.descriptor),			// Binding 0: Fragment shader uniform buffer
+				vks::initializers::writeDescriptorSet(descriptorSets.bloomComposite, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &bloomDescriptor),					// Binding 1: Fragment shader texture sampler
+			};
+			vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+		}
 
 		// Scene rendering
 		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.scene, 1);
@@ -586,12 +547,15 @@ public:
 		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(uint32_t), &blurdirection);
 		shaderStages[1].pSpecializationInfo = &specializationInfo;
 		// Vertical blur pipeline
-		pipelineCI.renderPass = offscreenPass.renderPass;
+		pipelineCI.renderPass = graphs.blur->getRenderPass(*graphPasses.verticalBlur);
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.blurVert));
 		// Horizontal blur pipeline
 		blurdirection = 1;
 		pipelineCI.renderPass = renderPass;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.blurHorz));
+		// Compute bloom composition pipeline, blended like the horizontal blur
+		shaderStages[1] = loadShader(getShadersPath() + "bloom/bloomcomposite.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.bloomComposite));
 
 		// Phong pass (3D model)
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal});
@@ -607,7 +571,7 @@ public:
 		// Color only pass (offscreen blur base)
 		shaderStages[0] = loadShader(getShadersPath() + "bloom/colorpass.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "bloom/colorpass.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		pipelineCI.renderPass = offscreenPass.renderPass;
+		pipelineCI.renderPass = graphs.blur->getRenderPass(*graphPasses.glow);
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.glowPass));
 
 		// Skybox (cubemap)
@@ -685,7 +649,7 @@ public:
 		VulkanExampleBase::prepareFrame();
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -720,10 +684,24 @@ public:
 			if (overlay->checkBox("Bloom", &bloom)) {
 				buildCommandBuffers();
 			}
+			if (bloomChain->isSupported()) {
+				if (overlay->checkBox("Compute bloom (mip chain)", &computeBloom)) {
+					buildCommandBuffers();
+				}
+				// The radius is recorded as a push constant
+				if (computeBloom && overlay->sliderFloat("Radius", &bloomRadius, 0.5f, 4.0f)) {
+					bloomChain->setRadius(bloomRadius);
+					buildCommandBuffers();
+				}
+			}
 			if (overlay->inputFloat("Scale", &ubos.blurParams.blurScale, 0.1f, 2)) {
 				updateUniformBuffersBlur();
 			}
 		}
+		if (settings.imageCompressionControl && overlay->header("Framebuffer compression")) {
+			overlay->text("Glow: %s", offscreenPass.framebuffers[0].color.compression.toString().c_str());
+			overlay->text("Vertical blur: %s", offscreenPass.framebuffers[1].color.compression.toString().c_str());
+		}
 	}
 };
 
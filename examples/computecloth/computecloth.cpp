@@ -11,6 +11,12 @@
 
 #define ENABLE_VALIDATION false
 
+// Needs to match the defines of cloth_tiled.comp
+#define TILED_TILE_SIZE 32
+#define TILED_HALO_SIZE 4
+#define TILED_OUTPUT_SIZE (TILED_TILE_SIZE - 2 * TILED_HALO_SIZE)
+#define TILED_THREAD_COUNT 256
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -19,6 +25,13 @@ public:
 	uint32_t indexCount;
 	bool simulateWind = false;
 	bool specializedComputeQueue = false;
+	// Solver iterations per frame, needs to be a multiple of TILED_HALO_SIZE
+	const uint32_t solverIterations = 64;
+	// Runs TILED_HALO_SIZE iterations per dispatch in shared memory instead of one
+	bool tiledSolver = false;
+	bool tiledSolverSupported = false;
+	const std::vector<uint32_t> resolutions = { 60, 128, 256, 512 };
+	int32_t resolutionIndex = 0;
 
 	vks::Texture2D textureCloth;
 	vkglTF::Model modelSphere;
@@ -59,6 +72,11 @@ public:
 		std::array<VkDescriptorSet,2> descriptorSets;
 		VkPipelineLayout pipelineLayout;
 		VkPipeline pipeline;
+		VkPipeline pipelineTiled = VK_NULL_HANDLE;
+		struct PushConstants {
+			uint32_t calculateNormals;
+			uint32_t iterations;
+		} pushConstants;
 		struct computeUBO {
 			float deltaT = 0.0f;
 			float particleMass = 0.1f;
@@ -116,6 +134,7 @@ public:
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroyPipeline(device, compute.pipeline, nullptr);
+		vkDestroyPipeline(device, compute.pipelineTiled, nullptr);
 		vkDestroySemaphore(device, compute.semaphores.ready, nullptr);
 		vkDestroySemaphore(device, compute.semaphores.complete, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
@@ -287,26 +306,35 @@ public:
 			// Acquire the storage buffers from the graphics queue
 			addGraphicsToComputeBarriers(compute.commandBuffers[i], 0, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 
-			vkCmdBindPipeline(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
+			// The tiled solver fuses several iterations into one dispatch, so there are fewer dispatches and barriers between them
+			// and the particles only go through global memory once per dispatch. The workgroups overlap by the halo of the tiles.
+			const bool tiled = tiledSolver && tiledSolverSupported;
+			const uint32_t iterationsPerDispatch = tiled ? TILED_HALO_SIZE : 1;
+			const glm::uvec2 groupSize = tiled ? glm::uvec2(TILED_OUTPUT_SIZE) : glm::uvec2(10);
+			const glm::uvec2 groupCount = (cloth.gridsize + groupSize - 1u) / groupSize;
+			// Even, so that the last dispatch writes to the output buffer that is drawn
+			const uint32_t dispatchCount = solverIterations / iterationsPerDispatch;
+
+			vkCmdBindPipeline(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, tiled ? compute.pipelineTiled : compute.pipeline);
 
-			uint32_t calculateNormals = 0;
-			vkCmdPushConstants(compute.commandBuffers[i], compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &calculateNormals);
+			compute.pushConstants.calculateNormals = 0;
+			compute.pushConstants.iterations = iterationsPerDispatch;
+			vkCmdPushConstants(compute.commandBuffers[i], compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(compute.pushConstants), &compute.pushConstants);
 
 			// Dispatch the compute job
-			const uint32_t iterations = 64;
-			for (uint32_t j = 0; j < iterations; j++) {
+			for (uint32_t j = 0; j < dispatchCount; j++) {
 				readSet = 1 - readSet;
 				vkCmdBindDescriptorSets(compute.commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSets[readSet], 0, 0);
 
-				if (j == iterations - 1) {
-					calculateNormals = 1;
-					vkCmdPushConstants(compute.commandBuffers[i], compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &calculateNormals);
+				if (j == dispatchCount - 1) {
+					compute.pushConstants.calculateNormals = 1;
+					vkCmdPushConstants(compute.commandBuffers[i], compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(compute.pushConstants), &compute.pushConstants);
 				}
 
-				vkCmdDispatch(compute.commandBuffers[i], cloth.gridsize.x / 10, cloth.gridsize.y / 10, 1);
+				vkCmdDispatch(compute.commandBuffers[i], groupCount.x, groupCount.y, 1);
 
 				// Don't add a barrier on the last iteration of the loop, since we'll have an explicit release to the graphics queue
-				if (j != iterations - 1) {
+				if (j != dispatchCount - 1) {
 					addComputeToComputeBarriers(compute.commandBuffers[i]);
 				}
 
@@ -388,9 +416,11 @@ public:
 			storageBufferSize);
 
 		// Copy from staging buffer
+		// Both buffers get the initial state, as pinned particles and the uv coordinates are only read from the input of a dispatch
 		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 		VkBufferCopy copyRegion = {};
 		copyRegion.size = storageBufferSize;
+		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffers.input.buffer, 1, &copyRegion);
 		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffers.output.buffer, 1, &copyRegion);
 		// Add an initial release barrier to the graphics queue,
 		// so that when the compute command buffer executes for the first time
@@ -560,6 +590,21 @@ public:
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &graphics.pipelines.sphere));
 	}
 
+	// Input and output are swapped between the two sets
+	void updateComputeDescriptorSets()
+	{
+		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
+			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffers.input.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.storageBuffers.output.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &compute.uniformBuffer.descriptor),
+
+			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffers.output.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.storageBuffers.input.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &compute.uniformBuffer.descriptor)
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
+	}
+
 	void prepareCompute()
 	{
 		// Create a compute capable device queue
@@ -582,7 +627,7 @@ public:
 
 		// Push constants used to pass some parameters
 		VkPushConstantRange pushConstantRange =
-			vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), 0);
+			vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(compute.pushConstants), 0);
 		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
 		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
@@ -594,24 +639,22 @@ public:
 		// Create two descriptor sets with input and output buffers switched
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSets[0]));
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSets[1]));
+		updateComputeDescriptorSets();
 
-		std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffers.input.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.storageBuffers.output.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[0], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &compute.uniformBuffer.descriptor),
-
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffers.output.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &compute.storageBuffers.input.descriptor),
-			vks::initializers::writeDescriptorSet(compute.descriptorSets[1], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &compute.uniformBuffer.descriptor)
-		};
-
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
-
-		// Create pipeline
+		// Create pipelines
 		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecloth/cloth.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
 
+		// The tiled solver keeps positions and velocities of a whole tile in shared memory
+		const VkPhysicalDeviceLimits &limits = vulkanDevice->properties.limits;
+		tiledSolverSupported = (limits.maxComputeSharedMemorySize >= 2 * TILED_TILE_SIZE * TILED_TILE_SIZE * sizeof(glm::vec4)) && (limits.maxComputeWorkGroupInvocations >= TILED_THREAD_COUNT) && (limits.maxComputeWorkGroupSize[0] >= TILED_THREAD_COUNT);
+		if (tiledSolverSupported) {
+			computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecloth/cloth_tiled.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineTiled));
+			tiledSolver = true;
+		}
+
 		// Separate command pool as queue family for compute may be different than graphics
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
 		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -646,14 +689,7 @@ public:
 		VK_CHECK_RESULT(compute.uniformBuffer.map());
 
 		// Initial values
-		float dx = cloth.size.x / (cloth.gridsize.x - 1);
-		float dy = cloth.size.y / (cloth.gridsize.y - 1);
-
-		compute.ubo.restDistH = dx;
-		compute.ubo.restDistV = dy;
-		compute.ubo.restDistD = sqrtf(dx * dx + dy * dy);
-		compute.ubo.particleCount = cloth.gridsize;
-
+		updateClothParameters();
 		updateComputeUBO();
 
 		// Vertex shader uniform buffer block
@@ -667,6 +703,18 @@ public:
 		updateGraphicsUBO();
 	}
 
+	// Rest distances and particle count depend on the cloth resolution
+	void updateClothParameters()
+	{
+		float dx = cloth.size.x / (cloth.gridsize.x - 1);
+		float dy = cloth.size.y / (cloth.gridsize.y - 1);
+
+		compute.ubo.restDistH = dx;
+		compute.ubo.restDistV = dy;
+		compute.ubo.restDistD = sqrtf(dx * dx + dy * dy);
+		compute.ubo.particleCount = cloth.gridsize;
+	}
+
 	void updateComputeUBO()
 	{
 		if (!paused) {
@@ -717,7 +765,7 @@ public:
 		computeSubmitInfo.commandBufferCount = 1;
 		computeSubmitInfo.pCommandBuffers = &compute.commandBuffers[readSet];
 
-		VK_CHECK_RESULT( vkQueueSubmit( compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE) );
+		VK_CHECK_RESULT( vulkanDevice->queueSubmit( compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE) );
 
 		// Submit graphics commands
 		VulkanExampleBase::prepareFrame();
@@ -739,7 +787,7 @@ public:
 		submitInfo.pSignalSemaphores = signalSemaphores;
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -778,10 +826,39 @@ public:
 		updateGraphicsUBO();
 	}
 
+	// Recreates the particles and the buffers depending on the cloth resolution
+	void changeResolution()
+	{
+		vkDeviceWaitIdle(device);
+		cloth.gridsize = glm::uvec2(resolutions[resolutionIndex]);
+		compute.storageBuffers.input.destroy();
+		compute.storageBuffers.output.destroy();
+		graphics.indices.destroy();
+		prepareStorageBuffers();
+		updateClothParameters();
+		updateComputeUBO();
+		updateComputeDescriptorSets();
+		buildComputeCommandBuffer();
+		buildCommandBuffers();
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Simulate wind", &simulateWind);
+			std::vector<std::string> resolutionNames;
+			for (uint32_t resolution : resolutions) {
+				resolutionNames.push_back(std::to_string(resolution) + " x " + std::to_string(resolution));
+			}
+			if (overlay->comboBox("Resolution", &resolutionIndex, resolutionNames)) {
+				changeResolution();
+			}
+			if (tiledSolverSupported) {
+				if (overlay->checkBox("Shared memory solver", &tiledSolver)) {
+					vkDeviceWaitIdle(device);
+					buildComputeCommandBuffer();
+				}
+			}
 		}
 	}
 };
@@ -24,11 +24,38 @@
 
 #define MAX_LOD_LEVEL 5
 
+// Needs to match the local size of the culling shaders
+#define CULL_WORKGROUP_SIZE 256
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool fixedFrustum = false;
 
+	// How the culling writes the indirect commands
+	enum CompactionMode {
+		// Every object has its own command, culled objects get an instance count of zero
+		CompactionNone = 0,
+		// Visible objects get consecutive commands, with one atomic per invocation (cull.comp)
+		CompactionAtomic = 1,
+		// One atomic per subgroup, the slots within the subgroup come from a ballot (cull_subgroup.comp)
+		CompactionSubgroupBallot = 2,
+		// Culling pass storing the visibility and the count per work group, scan over the work groups and scatter pass, no atomics
+		CompactionPrefixSum = 3
+	};
+	const std::vector<std::string> compactionModeNames = { "None", "Atomic per object", "Subgroup ballot", "Two pass prefix sum" };
+	int32_t compactionMode = CompactionNone;
+	// Modes supported by the device, as offered in the UI
+	std::vector<int32_t> supportedCompactionModes;
+	std::vector<std::string> supportedCompactionModeNames;
+	int32_t compactionModeIndex = 0;
+
+	// Compacted commands are drawn with a draw count read from the stats buffer
+	PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR = nullptr;
+
+	// Number of objects along each axis of the grid
+	uint32_t objectGridSize = OBJECT_COUNT;
+
 	// The model contains multiple versions of a single object with different levels of detail
 	vkglTF::Model lodModel;
 
@@ -43,6 +70,9 @@ public:
 	// Contains the indirect drawing commands
 	vks::Buffer indirectCommandsBuffer;
 	vks::Buffer indirectDrawCountBuffer;
+	// Prefix sum compaction: LOD level + 1 of each object (zero if culled) and number of visible objects per culling work group
+	vks::Buffer visibilityBuffer;
+	vks::Buffer groupCountsBuffer;
 
 	// Indirect draw statistics (updated via compute)
 	struct {
@@ -84,8 +114,24 @@ public:
 		VkDescriptorSet descriptorSet;				// Compute shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the compute pipeline
 		VkPipeline pipeline;						// Compute pipeline for updating particle positions
+		struct {
+			VkPipeline atomic = VK_NULL_HANDLE;
+			VkPipeline subgroupBallot = VK_NULL_HANDLE;
+			VkPipeline prefixSumCull = VK_NULL_HANDLE;
+			VkPipeline prefixSumScan = VK_NULL_HANDLE;
+			VkPipeline prefixSumScatter = VK_NULL_HANDLE;
+		} compactionPipelines;						// Pipelines for the compaction modes
 	} compute;
 
+	// GPU time of the culling passes on the compute queue, averaged over the frames since the last mode change
+	struct {
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		// Set once the timestamps have been written
+		bool pending = false;
+		double totalTime = 0.0;
+		uint32_t frames = 0;
+	} cullTimer;
+
 	// View frustum for culling invisible objects
 	vks::Frustum frustum;
 
@@ -99,10 +145,26 @@ public:
 		camera.setTranslation(glm::vec3(0.5f, 0.0f, 0.0f));
 		camera.movementSpeed = 5.0f;
 		memset(&indirectStats, 0, sizeof(indirectStats));
+		// Subgroup operations for the ballot and prefix sum compaction
+		apiVersion = VK_API_VERSION_1_1;
+		commandLineParser.add("objectgrid", { "-og", "--objectgrid" }, 1, "Set the number of objects along each axis of the grid (e.g. 160 for about four million objects)");
+		commandLineParser.add("compaction", { "-cm", "--compaction" }, 1, "Select the compaction of visible objects (none, atomic, ballot or prefixsum)");
+		commandLineParser.parse(args);
+		// Culling dispatches one dimensional grids of at most 65535 work groups
+		objectGridSize = static_cast<uint32_t>(std::min(std::max(commandLineParser.getValueAsInt("objectgrid", OBJECT_COUNT), 1), 255));
+		const std::string compaction = commandLineParser.getValueAsString("compaction", "none");
+		const std::vector<std::string> compactionArgs = { "none", "atomic", "ballot", "prefixsum" };
+		auto compactionArg = std::find(compactionArgs.begin(), compactionArgs.end(), compaction);
+		if (compactionArg != compactionArgs.end()) {
+			compactionMode = static_cast<int32_t>(std::distance(compactionArgs.begin(), compactionArg));
+		}
 	}
 
 	~VulkanExample()
 	{
+		if (cullTimer.frames > 0) {
+			std::cout << "Culling " << objectCount << " objects (" << compactionModeNames[compactionMode] << "): " << cullTimer.totalTime / cullTimer.frames << " ms average over " << cullTimer.frames << " frames" << std::endl;
+		}
 		vkDestroyPipeline(device, pipelines.plants, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -110,11 +172,20 @@ public:
 		indirectCommandsBuffer.destroy();
 		uniformData.scene.destroy();
 		indirectDrawCountBuffer.destroy();
+		visibilityBuffer.destroy();
+		groupCountsBuffer.destroy();
 		compute.lodLevelsBuffers.destroy();
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroyPipeline(device, compute.pipeline, nullptr);
-		vkDestroyFence(device, compute.fence, nullptr);
+		vkDestroyPipeline(device, compute.compactionPipelines.atomic, nullptr);
+		vkDestroyPipeline(device, compute.compactionPipelines.subgroupBallot, nullptr);
+		vkDestroyPipeline(device, compute.compactionPipelines.prefixSumCull, nullptr);
+		vkDestroyPipeline(device, compute.compactionPipelines.prefixSumScan, nullptr);
+		vkDestroyPipeline(device, compute.compactionPipelines.prefixSumScatter, nullptr);
+		if (cullTimer.queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, cullTimer.queryPool, nullptr);
+		}		vkDestroyFence(device, compute.fence, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
 		vkDestroySemaphore(device, compute.semaphore, nullptr);
 	}
@@ -127,6 +198,14 @@ public:
 		}
 	}
 
+	virtual void getEnabledExtensions()
+	{
+		// Compacted commands are drawn with vkCmdDrawIndexedIndirectCountKHR
+		if (vulkanDevice->extensionSupported(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+			enabledDeviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		}
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -164,6 +243,10 @@ public:
 					0,
 					indirectCommandsBuffer.descriptor.range
 				};
+				// The stats buffer holds the draw count of the compacted commands
+				std::array<VkBufferMemoryBarrier, 2> buffer_barriers = { buffer_barrier, buffer_barrier };
+				buffer_barriers[1].buffer = indirectDrawCountBuffer.buffer;
+				buffer_barriers[1].size = VK_WHOLE_SIZE;
 
 				vkCmdPipelineBarrier(
 					drawCmdBuffers[i],
@@ -171,7 +254,7 @@ public:
 					VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
 					0,
 					0, nullptr,
-					1, &buffer_barrier,
+					static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
 					0, nullptr);
 			}
 
@@ -193,7 +276,13 @@ public:
 
 			vkCmdBindIndexBuffer(drawCmdBuffers[i], lodModel.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 
-			if (vulkanDevice->features.multiDrawIndirect)
+			if (compactionMode != CompactionNone)
+			{
+				// Only the commands of visible objects have been written, their number is the first member of the stats buffer
+				const uint32_t maxDrawCount = std::min(objectCount, vulkanDevice->properties.limits.maxDrawIndirectCount);
+				vkCmdDrawIndexedIndirectCountKHR(drawCmdBuffers[i], indirectCommandsBuffer.buffer, 0, indirectDrawCountBuffer.buffer, 0, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+			}
+			else if (vulkanDevice->features.multiDrawIndirect)
 			{
 				vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, 0, static_cast<uint32_t>(indirectCommands.size()), sizeof(VkDrawIndexedIndirectCommand));
 			}
@@ -225,6 +314,9 @@ public:
 					0,
 					indirectCommandsBuffer.descriptor.range
 				};
+				std::array<VkBufferMemoryBarrier, 2> buffer_barriers = { buffer_barrier, buffer_barrier };
+				buffer_barriers[1].buffer = indirectDrawCountBuffer.buffer;
+				buffer_barriers[1].size = VK_WHOLE_SIZE;
 
 				vkCmdPipelineBarrier(
 					drawCmdBuffers[i],
@@ -232,7 +324,7 @@ public:
 					VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
 					0,
 					0, nullptr,
-					1, &buffer_barrier,
+					static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
 					0, nullptr);
 			}
 
@@ -268,27 +360,36 @@ public:
 				0,
 				indirectCommandsBuffer.descriptor.range
 			};
+			// The stats buffer is cleared with a transfer first
+			std::array<VkBufferMemoryBarrier, 2> buffer_barriers = { buffer_barrier, buffer_barrier };
+			buffer_barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			buffer_barriers[1].buffer = indirectDrawCountBuffer.buffer;
+			buffer_barriers[1].size = VK_WHOLE_SIZE;
 
 			vkCmdPipelineBarrier(
 				compute.commandBuffer,
 				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 				VK_FLAGS_NONE,
 				0, nullptr,
-				1, &buffer_barrier,
+				static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
 				0, nullptr);
 		}
 
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
+		if (cullTimer.queryPool != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(compute.commandBuffer, cullTimer.queryPool, 0, 2);
+			vkCmdWriteTimestamp(compute.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, cullTimer.queryPool, 0);
+		}
+
 		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
 
 		// Clear the buffer that the compute shader pass will write statistics and draw calls to
-		vkCmdFillBuffer(compute.commandBuffer, indirectDrawCountBuffer.buffer, 0, indirectCommandsBuffer.descriptor.range, 0);
+		vkCmdFillBuffer(compute.commandBuffer, indirectDrawCountBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
 
 		// This barrier ensures that the fill command is finished before the compute shader can start writing to the buffer
 		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
 		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
 		vkCmdPipelineBarrier(
 			compute.commandBuffer,
@@ -302,7 +403,39 @@ public:
 		// Dispatch the compute job
 		// The compute shader will do the frustum culling and adjust the indirect draw calls depending on object visibility.
 		// It also determines the lod to use depending on distance to the viewer.
-		vkCmdDispatch(compute.commandBuffer, objectCount / 16, 1, 1);
+		const uint32_t groupCount = (objectCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE;
+		switch (compactionMode) {
+		case CompactionAtomic:
+			vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.compactionPipelines.atomic);
+			vkCmdDispatch(compute.commandBuffer, groupCount, 1, 1);
+			break;
+		case CompactionSubgroupBallot:
+			vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.compactionPipelines.subgroupBallot);
+			vkCmdDispatch(compute.commandBuffer, groupCount, 1, 1);
+			break;
+		case CompactionPrefixSum:
+		{
+			// Culling pass, scan of the work group counts and scatter pass, each reading what the previous one wrote
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.compactionPipelines.prefixSumCull);
+			vkCmdDispatch(compute.commandBuffer, groupCount, 1, 1);
+			vkCmdPipelineBarrier(compute.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.compactionPipelines.prefixSumScan);
+			vkCmdDispatch(compute.commandBuffer, 1, 1, 1);
+			vkCmdPipelineBarrier(compute.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.compactionPipelines.prefixSumScatter);
+			vkCmdDispatch(compute.commandBuffer, groupCount, 1, 1);
+			break;
+		}
+		default:
+			vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
+			vkCmdDispatch(compute.commandBuffer, groupCount, 1, 1);
+		}
+
+		if (cullTimer.queryPool != VK_NULL_HANDLE) {
+			vkCmdWriteTimestamp(compute.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, cullTimer.queryPool, 1);
+		}
 
 		// Release barrier
 		// Add memory barrier to ensure that the compute shader has finished writing the indirect command buffer before it's consumed
@@ -320,6 +453,9 @@ public:
 				0,
 				indirectCommandsBuffer.descriptor.range
 			};
+			std::array<VkBufferMemoryBarrier, 2> buffer_barriers = { buffer_barrier, buffer_barrier };
+			buffer_barriers[1].buffer = indirectDrawCountBuffer.buffer;
+			buffer_barriers[1].size = VK_WHOLE_SIZE;
 
 			vkCmdPipelineBarrier(
 				compute.commandBuffer,
@@ -327,12 +463,10 @@ public:
 				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
 				VK_FLAGS_NONE,
 				0, nullptr,
-				1, &buffer_barrier,
+				static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
 				0, nullptr);
 		}
 
-		// todo: barrier for indirect stats buffer?
-
 		vkEndCommandBuffer(compute.commandBuffer);
 	}
 
@@ -340,7 +474,7 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6)
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -435,7 +569,7 @@ public:
 
 	void prepareBuffers()
 	{
-		objectCount = OBJECT_COUNT * OBJECT_COUNT * OBJECT_COUNT;
+		objectCount = objectGridSize * objectGridSize * objectGridSize;
 
 		vks::Buffer stagingBuffer;
 
@@ -443,13 +577,13 @@ public:
 		indirectCommands.resize(objectCount);
 
 		// Indirect draw commands
-		for (uint32_t x = 0; x < OBJECT_COUNT; x++)
+		for (uint32_t x = 0; x < objectGridSize; x++)
 		{
-			for (uint32_t y = 0; y < OBJECT_COUNT; y++)
+			for (uint32_t y = 0; y < objectGridSize; y++)
 			{
-				for (uint32_t z = 0; z < OBJECT_COUNT; z++)
+				for (uint32_t z = 0; z < objectGridSize; z++)
 				{
-					uint32_t index = x + y * OBJECT_COUNT + z * OBJECT_COUNT * OBJECT_COUNT;
+					uint32_t index = x + y * objectGridSize + z * objectGridSize * objectGridSize;
 					indirectCommands[index].instanceCount = 1;
 					indirectCommands[index].firstInstance = index;
 					// firstIndex and indexCount are written by the compute shader
@@ -459,41 +593,45 @@ public:
 
 		indirectStats.drawCount = static_cast<uint32_t>(indirectCommands.size());
 
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			indirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand),
-			indirectCommands.data()));
-
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			&indirectCommandsBuffer,
-			stagingBuffer.size));
-
-		vulkanDevice->copyBuffer(&stagingBuffer, &indirectCommandsBuffer, queue);
+			indirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand)));
 
-		stagingBuffer.destroy();
+		uploadIndirectCommands();
 
+		// The draw count is also the count buffer of the compacted commands
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&indirectDrawCountBuffer,
 			sizeof(indirectStats)));
 
+		// Only used by the prefix sum compaction, the shaders derive the object and work group count from their sizes
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&visibilityBuffer,
+			objectCount * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&groupCountsBuffer,
+			((objectCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE) * sizeof(uint32_t)));
+
 		// Map for host access
 		VK_CHECK_RESULT(indirectDrawCountBuffer.map());
 
 		// Instance data
-		for (uint32_t x = 0; x < OBJECT_COUNT; x++)
+		for (uint32_t x = 0; x < objectGridSize; x++)
 		{
-			for (uint32_t y = 0; y < OBJECT_COUNT; y++)
+			for (uint32_t y = 0; y < objectGridSize; y++)
 			{
-				for (uint32_t z = 0; z < OBJECT_COUNT; z++)
+				for (uint32_t z = 0; z < objectGridSize; z++)
 				{
-					uint32_t index = x + y * OBJECT_COUNT + z * OBJECT_COUNT * OBJECT_COUNT;
-					instanceData[index].pos = glm::vec3((float)x, (float)y, (float)z) - glm::vec3((float)OBJECT_COUNT / 2.0f);
+					uint32_t index = x + y * objectGridSize + z * objectGridSize * objectGridSize;
+					instanceData[index].pos = glm::vec3((float)x, (float)y, (float)z) - glm::vec3((float)objectGridSize / 2.0f);
 					instanceData[index].scale = 2.0f;
 				}
 			}
@@ -533,6 +671,9 @@ public:
 				0,
 				indirectCommandsBuffer.descriptor.range
 			};
+			std::array<VkBufferMemoryBarrier, 2> buffer_barriers = { buffer_barrier, buffer_barrier };
+			buffer_barriers[1].buffer = indirectDrawCountBuffer.buffer;
+			buffer_barriers[1].size = VK_WHOLE_SIZE;
 
 			vkCmdPipelineBarrier(
 				copyCmd,
@@ -540,7 +681,7 @@ public:
 				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
 				0,
 				0, nullptr,
-				1, &buffer_barrier,
+				static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
 				0, nullptr);
 		}
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
@@ -596,6 +737,81 @@ public:
 		updateUniformBuffer(true);
 	}
 
+	// Uploads the commands with one slot per object (compaction overwrites them with the visible objects' commands)
+	void uploadIndirectCommands()
+	{
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			indirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand),
+			indirectCommands.data()));
+
+		vulkanDevice->copyBuffer(&stagingBuffer, &indirectCommandsBuffer, queue);
+
+		stagingBuffer.destroy();
+	}
+
+	// Checks which compaction modes the device supports and falls back to no compaction if the selected one isn't
+	void checkCompactionSupport()
+	{
+		bool drawIndirectCount = false;
+		if (deviceFeatures.multiDrawIndirect && vulkanDevice->extensionSupported(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+			vkCmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+			drawIndirectCount = vkCmdDrawIndexedIndirectCountKHR != nullptr;
+		}
+
+		// Subgroup operations are core in Vulkan 1.1, the shaders keep the sums of up to 64 subgroups per work group
+		bool subgroups = false;
+		if (vulkanDevice->properties.apiVersion >= VK_API_VERSION_1_1) {
+			VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+			subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+			VkPhysicalDeviceProperties2 deviceProperties2{};
+			deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			deviceProperties2.pNext = &subgroupProperties;
+			vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+			const VkSubgroupFeatureFlags requiredOperations = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+			subgroups = (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) && ((subgroupProperties.supportedOperations & requiredOperations) == requiredOperations) && (subgroupProperties.subgroupSize >= 4);
+		}
+
+		supportedCompactionModes = { CompactionNone };
+		if (drawIndirectCount) {
+			supportedCompactionModes.push_back(CompactionAtomic);
+			if (subgroups) {
+				supportedCompactionModes.push_back(CompactionSubgroupBallot);
+				supportedCompactionModes.push_back(CompactionPrefixSum);
+			}
+		}
+		supportedCompactionModeNames.clear();
+		for (auto mode : supportedCompactionModes) {
+			supportedCompactionModeNames.push_back(compactionModeNames[mode]);
+		}
+
+		auto mode = std::find(supportedCompactionModes.begin(), supportedCompactionModes.end(), compactionMode);
+		if (mode == supportedCompactionModes.end()) {
+			std::cout << "Compaction mode \"" << compactionModeNames[compactionMode] << "\" is not supported by the device, culling without compaction" << std::endl;
+			compactionMode = CompactionNone;
+			mode = supportedCompactionModes.begin();
+		}
+		compactionModeIndex = static_cast<int32_t>(std::distance(supportedCompactionModes.begin(), mode));
+	}
+
+	void setCompactionMode(int32_t mode)
+	{
+		vkDeviceWaitIdle(device);
+		compactionMode = mode;
+		// Restore the slot per object layout of the commands
+		if (compactionMode == CompactionNone) {
+			uploadIndirectCommands();
+		}
+		cullTimer.pending = false;
+		cullTimer.totalTime = 0.0;
+		cullTimer.frames = 0;
+		buildComputeCommandBuffer();
+		buildCommandBuffers();
+	}
+
 	void prepareCompute()
 	{
 		// Get a compute capable device queue
@@ -630,6 +846,16 @@ public:
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				VK_SHADER_STAGE_COMPUTE_BIT,
 				4),
+			// Binding 5: Visibility of each object (prefix sum compaction)
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				5),
+			// Binding 6: Visible objects per work group (prefix sum compaction)
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				6),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -685,7 +911,19 @@ public:
 				compute.descriptorSet,
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				4,
-				&compute.lodLevelsBuffers.descriptor)
+				&compute.lodLevelsBuffers.descriptor),
+			// Binding 5: Visibility of each object
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				5,
+				&visibilityBuffer.descriptor),
+			// Binding 6: Visible objects per work group
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				6,
+				&groupCountsBuffer.descriptor)
 		};
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
@@ -694,17 +932,25 @@ public:
 		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 
-		// Use specialization constants to pass max. level of detail (determined by no. of meshes)
-		VkSpecializationMapEntry specializationEntry{};
-		specializationEntry.constantID = 0;
-		specializationEntry.offset = 0;
-		specializationEntry.size = sizeof(uint32_t);
-
-		uint32_t specializationData = static_cast<uint32_t>(lodModel.nodes.size()) - 1;
+		// Use specialization constants to pass max. level of detail (determined by no. of meshes) and the compaction variant of the shader
+		struct SpecializationData {
+			uint32_t maxLodLevel;
+			VkBool32 variant;
+		} specializationData;
+		std::array<VkSpecializationMapEntry, 2> specializationEntries{};
+		specializationEntries[0].constantID = 0;
+		specializationEntries[0].offset = offsetof(SpecializationData, maxLodLevel);
+		specializationEntries[0].size = sizeof(uint32_t);
+		specializationEntries[1].constantID = 1;
+		specializationEntries[1].offset = offsetof(SpecializationData, variant);
+		specializationEntries[1].size = sizeof(VkBool32);
+
+		specializationData.maxLodLevel = static_cast<uint32_t>(lodModel.nodes.size()) - 1;
+		specializationData.variant = VK_FALSE;
 
 		VkSpecializationInfo specializationInfo;
-		specializationInfo.mapEntryCount = 1;
-		specializationInfo.pMapEntries = &specializationEntry;
+		specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+		specializationInfo.pMapEntries = specializationEntries.data();
 		specializationInfo.dataSize = sizeof(specializationData);
 		specializationInfo.pData = &specializationData;
 
@@ -712,6 +958,36 @@ public:
 
 		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
 
+		// Compaction pipelines, only created if the device supports them
+		checkCompactionSupport();
+		auto supported = [this](CompactionMode mode) { return std::find(supportedCompactionModes.begin(), supportedCompactionModes.end(), mode) != supportedCompactionModes.end(); };
+		if (supported(CompactionAtomic)) {
+			specializationData.variant = VK_TRUE;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.compactionPipelines.atomic));
+		}
+		if (supported(CompactionSubgroupBallot)) {
+			computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/cull_subgroup.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+			specializationData.variant = VK_FALSE;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.compactionPipelines.subgroupBallot));
+			specializationData.variant = VK_TRUE;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.compactionPipelines.prefixSumCull));
+			computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/compactscan.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.compactionPipelines.prefixSumScan));
+			computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/compactscatter.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.compactionPipelines.prefixSumScatter));
+		}
+
+		// Culling time is measured with timestamps on the compute queue
+		if (vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.compute].timestampValidBits > 0) {
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &cullTimer.queryPool));
+		}
+
 		// Separate command pool as queue family for compute may be different than graphics
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
 		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -766,13 +1042,23 @@ public:
 		vkWaitForFences(device, 1, &compute.fence, VK_TRUE, UINT64_MAX);
 		vkResetFences(device, 1, &compute.fence);
 
+		// The fence also guarantees that the previous culling passes have finished
+		if (cullTimer.pending) {
+			uint64_t timestamps[2];
+			if (vkGetQueryPoolResults(device, cullTimer.queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+				cullTimer.totalTime += static_cast<double>(timestamps[1] - timestamps[0]) * vulkanDevice->properties.limits.timestampPeriod / 1000000.0;
+				cullTimer.frames++;
+			}
+		}
+
 		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
 		computeSubmitInfo.commandBufferCount = 1;
 		computeSubmitInfo.pCommandBuffers = &compute.commandBuffer;
 		computeSubmitInfo.signalSemaphoreCount = 1;
 		computeSubmitInfo.pSignalSemaphores = &compute.semaphore;
 
-		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+		cullTimer.pending = cullTimer.queryPool != VK_NULL_HANDLE;
 
 		// Submit graphics command buffer
 
@@ -794,7 +1080,7 @@ public:
 		submitInfo.pWaitDstStageMask = stageFlags.data();
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, compute.fence));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, compute.fence));
 
 		VulkanExampleBase::submitFrame();
 
@@ -840,8 +1126,16 @@ public:
 			if (overlay->checkBox("Freeze frustum", &fixedFrustum)) {
 				updateUniformBuffer(true);
 			}
+			if (overlay->comboBox("Compaction", &compactionModeIndex, supportedCompactionModeNames)) {
+				setCompactionMode(supportedCompactionModes[compactionModeIndex]);
+			}
 		}
 		if (overlay->header("Statistics")) {
+			overlay->text("Objects: %d", objectCount);
+			if (cullTimer.frames > 0) {
+				const double cullTime = cullTimer.totalTime / cullTimer.frames;
+				overlay->text("Culling: %.3f ms (%.0f M objects/s)", cullTime, objectCount / cullTime / 1000.0);
+			}
 			overlay->text("Visible objects: %d", indirectStats.drawCount);
 			for (uint32_t i = 0; i < MAX_LOD_LEVEL + 1; i++) {
 				overlay->text("LOD %d: %d", i, indirectStats.lodCount[i]);
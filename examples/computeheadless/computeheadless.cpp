@@ -23,6 +23,8 @@
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <array>
+#include <chrono>
 
 #if defined(VK_USE_PLATFORM_MACOS_MVK)
 #define VK_ENABLE_BETA_EXTENSIONS
@@ -71,15 +73,35 @@ public:
 	VkPipelineCache pipelineCache;
 	VkQueue queue;
 	VkCommandPool commandPool;
-	VkCommandBuffer commandBuffer;
-	VkFence fence;
 	VkDescriptorPool descriptorPool;
 	VkDescriptorSetLayout descriptorSetLayout;
-	VkDescriptorSet descriptorSet;
 	VkPipelineLayout pipelineLayout;
 	VkPipeline pipeline;
 	VkShaderModule shaderModule;
 
+	// Jobs are submitted in batches, two batches are alternated so the host can prepare one while the device processes the other
+	struct JobBatch {
+		VkBuffer deviceBuffer, hostBuffer;
+		VkDeviceMemory deviceMemory, hostMemory;
+		uint32_t *mapped;
+		VkCommandBuffer commandBuffer;
+		VkFence fence;
+		VkDescriptorSet descriptorSet;
+		// Range of jobs in flight, jobCount is 0 while the batch is idle
+		uint32_t firstJob = 0;
+		uint32_t jobCount = 0;
+	};
+	std::array<JobBatch, 2> batches;
+	uint32_t jobsPerBatch;
+	// Distance between the jobs of a batch in its buffers, aligned for dynamic storage buffer offsets
+	VkDeviceSize jobStride;
+	// Two timestamps per job of each batch, VK_NULL_HANDLE if the queue doesn't support timestamps
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	float timestampPeriod;
+	std::vector<uint32_t> jobInputs, jobOutputs;
+	// GPU time of each job in milliseconds
+	std::vector<double> jobTimes;
+
 	VkDebugReportCallbackEXT debugReportCallback{};
 
 	VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkBuffer *buffer, VkDeviceMemory *memory, VkDeviceSize size, void *data = nullptr)
@@ -122,6 +144,236 @@ public:
 		return VK_SUCCESS;
 	}
 
+	// Host reference of the compute shader's calculation
+	static uint32_t fibonacci(uint32_t n)
+	{
+		if (n <= 1) {
+			return n;
+		}
+		uint32_t curr = 1;
+		uint32_t prev = 1;
+		for (uint32_t i = 2; i < n; ++i) {
+			uint32_t temp = curr;
+			curr += prev;
+			prev = temp;
+		}
+		return curr;
+	}
+
+	/*
+		Create the buffers, command buffers and synchronization objects of the job batches
+		Each batch has a device local storage buffer and a persistently mapped host visible buffer, both with room for jobsPerBatch jobs
+		The host buffer is used for staging the inputs and reading back the outputs of the batch
+	*/
+	void prepareJobBatches(VkDeviceSize minStorageBufferOffsetAlignment, bool timestamps)
+	{
+		const VkDeviceSize jobSize = BUFFER_ELEMENTS * sizeof(uint32_t);
+		jobStride = (jobSize + minStorageBufferOffsetAlignment - 1) & ~(minStorageBufferOffsetAlignment - 1);
+		const VkDeviceSize batchSize = jobStride * jobsPerBatch;
+
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		for (auto &batch : batches) {
+			createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &batch.hostBuffer, &batch.hostMemory, batchSize);
+			VK_CHECK_RESULT(vkMapMemory(device, batch.hostMemory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&batch.mapped)));
+			createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &batch.deviceBuffer, &batch.deviceMemory, batchSize);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &batch.commandBuffer));
+			VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &batch.fence));
+
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &batch.descriptorSet));
+			// The range of a dynamic storage buffer is a single job, its offset is passed when binding
+			VkDescriptorBufferInfo bufferDescriptor = { batch.deviceBuffer, 0, jobSize };
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(batch.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 0, &bufferDescriptor);
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		}
+
+		// Two timestamps per job of each batch
+		if (timestamps) {
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = static_cast<uint32_t>(batches.size()) * jobsPerBatch * 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+		}
+	}
+
+	void destroyJobBatches()
+	{
+		for (auto &batch : batches) {
+			vkUnmapMemory(device, batch.hostMemory);
+			vkDestroyBuffer(device, batch.hostBuffer, nullptr);
+			vkFreeMemory(device, batch.hostMemory, nullptr);
+			vkDestroyBuffer(device, batch.deviceBuffer, nullptr);
+			vkFreeMemory(device, batch.deviceMemory, nullptr);
+			vkDestroyFence(device, batch.fence, nullptr);
+		}
+		if (queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, queryPool, nullptr);
+		}
+	}
+
+	/*
+		Stage the inputs of a range of jobs and submit them as a single batch
+		All jobs of the batch are recorded into one command buffer: one upload, one dispatch per job and one read back
+	*/
+	void submitBatch(JobBatch &batch, uint32_t firstJob, uint32_t jobCount)
+	{
+		const uint32_t batchIndex = static_cast<uint32_t>(&batch - batches.data());
+		const VkDeviceSize jobSize = BUFFER_ELEMENTS * sizeof(uint32_t);
+		const VkDeviceSize batchSize = jobStride * jobCount;
+
+		for (uint32_t i = 0; i < jobCount; i++) {
+			memcpy(reinterpret_cast<uint8_t*>(batch.mapped) + i * jobStride, &jobInputs[(firstJob + i) * BUFFER_ELEMENTS], jobSize);
+		}
+		// Flush writes to host visible buffer
+		VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
+		mappedRange.memory = batch.hostMemory;
+		mappedRange.offset = 0;
+		mappedRange.size = VK_WHOLE_SIZE;
+		VK_CHECK_RESULT(vkFlushMappedMemoryRanges(device, 1, &mappedRange));
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(batch.commandBuffer, &cmdBufInfo));
+
+		const uint32_t firstQuery = batchIndex * jobsPerBatch * 2;
+		if (queryPool != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(batch.commandBuffer, queryPool, firstQuery, jobCount * 2);
+		}
+
+		// Upload the inputs of all jobs at once
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = batchSize;
+		vkCmdCopyBuffer(batch.commandBuffer, batch.hostBuffer, batch.deviceBuffer, 1, &copyRegion);
+
+		// Barrier to ensure that input buffer transfer is finished before compute shader reads from it
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.buffer = batch.deviceBuffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+		vkCmdPipelineBarrier(
+			batch.commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_FLAGS_NONE,
+			0, nullptr,
+			1, &bufferBarrier,
+			0, nullptr);
+
+		vkCmdBindPipeline(batch.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+		// Jobs work on separate parts of the buffer, so their dispatches don't need barriers between them and may overlap
+		for (uint32_t i = 0; i < jobCount; i++) {
+			const uint32_t dynamicOffset = static_cast<uint32_t>(i * jobStride);
+			vkCmdBindDescriptorSets(batch.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &batch.descriptorSet, 1, &dynamicOffset);
+			if (queryPool != VK_NULL_HANDLE) {
+				vkCmdWriteTimestamp(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, firstQuery + i * 2);
+			}
+			vkCmdDispatch(batch.commandBuffer, BUFFER_ELEMENTS, 1, 1);
+			if (queryPool != VK_NULL_HANDLE) {
+				vkCmdWriteTimestamp(batch.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, firstQuery + i * 2 + 1);
+			}
+		}
+
+		// Barrier to ensure that shader writes are finished before buffer is read back from GPU
+		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		vkCmdPipelineBarrier(
+			batch.commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_FLAGS_NONE,
+			0, nullptr,
+			1, &bufferBarrier,
+			0, nullptr);
+
+		// Read back to host visible buffer
+		vkCmdCopyBuffer(batch.commandBuffer, batch.deviceBuffer, batch.hostBuffer, 1, &copyRegion);
+
+		// Barrier to ensure that buffer copy is finished before host reading from it
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.buffer = batch.hostBuffer;
+
+		vkCmdPipelineBarrier(
+			batch.commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT,
+			VK_FLAGS_NONE,
+			0, nullptr,
+			1, &bufferBarrier,
+			0, nullptr);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(batch.commandBuffer));
+
+		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
+		computeSubmitInfo.commandBufferCount = 1;
+		computeSubmitInfo.pCommandBuffers = &batch.commandBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &computeSubmitInfo, batch.fence));
+
+		batch.firstJob = firstJob;
+		batch.jobCount = jobCount;
+	}
+
+	/*
+		Wait for a submitted batch and collect the outputs and GPU times of its jobs
+	*/
+	void finishBatch(JobBatch &batch)
+	{
+		if (batch.jobCount == 0) {
+			return;
+		}
+		const uint32_t batchIndex = static_cast<uint32_t>(&batch - batches.data());
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX));
+		VK_CHECK_RESULT(vkResetFences(device, 1, &batch.fence));
+
+		// Make device writes visible to the host
+		VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
+		mappedRange.memory = batch.hostMemory;
+		mappedRange.offset = 0;
+		mappedRange.size = VK_WHOLE_SIZE;
+		VK_CHECK_RESULT(vkInvalidateMappedMemoryRanges(device, 1, &mappedRange));
+
+		// Copy to output
+		for (uint32_t i = 0; i < batch.jobCount; i++) {
+			memcpy(&jobOutputs[(batch.firstJob + i) * BUFFER_ELEMENTS], reinterpret_cast<uint8_t*>(batch.mapped) + i * jobStride, BUFFER_ELEMENTS * sizeof(uint32_t));
+		}
+
+		if (queryPool != VK_NULL_HANDLE) {
+			std::vector<uint64_t> timestamps(batch.jobCount * 2);
+			VK_CHECK_RESULT(vkGetQueryPoolResults(device, queryPool, batchIndex * jobsPerBatch * 2, batch.jobCount * 2, timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+			for (uint32_t i = 0; i < batch.jobCount; i++) {
+				jobTimes[batch.firstJob + i] = static_cast<double>(timestamps[i * 2 + 1] - timestamps[i * 2]) * timestampPeriod / 1000000.0;
+			}
+		}
+		batch.jobCount = 0;
+	}
+
+	/*
+		Run jobs in batches of up to jobsPerBatch jobs, alternating between the two batches
+		While the device processes one batch, the host collects the results of the previous one and stages the inputs of the next one
+	*/
+	void runJobs(uint32_t jobCount)
+	{
+		uint32_t batchIndex = 0;
+		for (uint32_t firstJob = 0; firstJob < jobCount; firstJob += jobsPerBatch) {
+			JobBatch &batch = batches[batchIndex];
+			finishBatch(batch);
+			submitBatch(batch, firstJob, std::min(jobsPerBatch, jobCount - firstJob));
+			batchIndex = (batchIndex + 1) % static_cast<uint32_t>(batches.size());
+		}
+		// Batches are finished in submission order
+		for (size_t i = 0; i < batches.size(); i++) {
+			finishBatch(batches[(batchIndex + i) % batches.size()]);
+		}
+	}
+
 	VulkanExample()
 	{
 		LOG("Running headless compute example\n");
@@ -293,89 +545,21 @@ public:
 		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
 
-		/*
-			Prepare storage buffers
-		*/
-		std::vector<uint32_t> computeInput(BUFFER_ELEMENTS);
-		std::vector<uint32_t> computeOutput(BUFFER_ELEMENTS);
-
-		// Fill input data
-		uint32_t n = 0;
-		std::generate(computeInput.begin(), computeInput.end(), [&n] { return n++; });
-
-		const VkDeviceSize bufferSize = BUFFER_ELEMENTS * sizeof(uint32_t);
-
-		VkBuffer deviceBuffer, hostBuffer;
-		VkDeviceMemory deviceMemory, hostMemory;
-
-		// Copy input data to VRAM using a staging buffer
-		{
-			createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-				&hostBuffer,
-				&hostMemory,
-				bufferSize,
-				computeInput.data());
-
-			// Flush writes to host visible buffer
-			void* mapped;
-			vkMapMemory(device, hostMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
-			VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
-			mappedRange.memory = hostMemory;
-			mappedRange.offset = 0;
-			mappedRange.size = VK_WHOLE_SIZE;
-			vkFlushMappedMemoryRanges(device, 1, &mappedRange);
-			vkUnmapMemory(device, hostMemory);
-
-			createBuffer(
-				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				&deviceBuffer,
-				&deviceMemory,
-				bufferSize);
-
-			// Copy to staging buffer
-			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
-			VkCommandBuffer copyCmd;
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &copyCmd));
-			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-			VK_CHECK_RESULT(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
-
-			VkBufferCopy copyRegion = {};
-			copyRegion.size = bufferSize;
-			vkCmdCopyBuffer(copyCmd, hostBuffer, deviceBuffer, 1, &copyRegion);
-			VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
-
-			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
-			submitInfo.commandBufferCount = 1;
-			submitInfo.pCommandBuffers = &copyCmd;
-			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-			VkFence fence;
-			VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-
-			// Submit to the queue
-			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
-			VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
-
-			vkDestroyFence(device, fence, nullptr);
-			vkFreeCommandBuffers(device, commandPool, 1, &copyCmd);
-		}
-
 		/*
 			Prepare compute pipeline
 		*/
 		{
+			// Every job of a batch uses the same descriptor set, selecting its part of the batch's buffer with a dynamic offset
 			std::vector<VkDescriptorPoolSize> poolSizes = {
-				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, static_cast<uint32_t>(batches.size())),
 			};
 
 			VkDescriptorPoolCreateInfo descriptorPoolInfo =
-				vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 1);
+				vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), static_cast<uint32_t>(batches.size()));
 			VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
 			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT, 0),
 			};
 			VkDescriptorSetLayoutCreateInfo descriptorLayout =
 				vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
@@ -385,16 +569,6 @@ public:
 				vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
 			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 
-			VkDescriptorSetAllocateInfo allocInfo =
-				vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
-
-			VkDescriptorBufferInfo bufferDescriptor = { deviceBuffer, 0, VK_WHOLE_SIZE };
-			std::vector<VkWriteDescriptorSet> computeWriteDescriptorSets = {
-				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &bufferDescriptor),
-			};
-			vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
-
 			VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 			pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
 			VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
@@ -430,133 +604,72 @@ public:
 			assert(shaderStage.module != VK_NULL_HANDLE);
 			computePipelineCreateInfo.stage = shaderStage;
 			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
-
-			// Create a command buffer for compute operations
-			VkCommandBufferAllocateInfo cmdBufAllocateInfo =
-				vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
-
-			// Fence for compute CB sync
-			VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-			VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
 		}
 
 		/*
-			Command buffer creation (for compute work submission)
+			Prepare the job batches, these stay alive for all jobs
 		*/
-		{
-			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
-
-			// Barrier to ensure that input buffer transfer is finished before compute shader reads from it
-			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
-			bufferBarrier.buffer = deviceBuffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				VK_PIPELINE_STAGE_HOST_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				1, &bufferBarrier,
-				0, nullptr);
-
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, 0);
-
-			vkCmdDispatch(commandBuffer, BUFFER_ELEMENTS, 1, 1);
-
-			// Barrier to ensure that shader writes are finished before buffer is read back from GPU
-			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			bufferBarrier.buffer = deviceBuffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				1, &bufferBarrier,
-				0, nullptr);
-
-			// Read back to host visible buffer
-			VkBufferCopy copyRegion = {};
-			copyRegion.size = bufferSize;
-			vkCmdCopyBuffer(commandBuffer, deviceBuffer, hostBuffer, 1, &copyRegion);
-
-			// Barrier to ensure that buffer copy is finished before host reading from it
-			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
-			bufferBarrier.buffer = hostBuffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(
-				commandBuffer,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_HOST_BIT,
-				VK_FLAGS_NONE,
-				0, nullptr,
-				1, &bufferBarrier,
-				0, nullptr);
-
-			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
-
-			// Submit compute work
-			vkResetFences(device, 1, &fence);
-			const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
-			computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
-			computeSubmitInfo.commandBufferCount = 1;
-			computeSubmitInfo.pCommandBuffers = &commandBuffer;
-			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &computeSubmitInfo, fence));
-			VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
-
-			// Make device writes visible to the host
-			void *mapped;
-			vkMapMemory(device, hostMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
-			VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
-			mappedRange.memory = hostMemory;
-			mappedRange.offset = 0;
-			mappedRange.size = VK_WHOLE_SIZE;
-			vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
-
-			// Copy to output
-			memcpy(computeOutput.data(), mapped, bufferSize);
-			vkUnmapMemory(device, hostMemory);
+		uint32_t jobCount = 1;
+		jobsPerBatch = 16;
+		if (commandLineParser.isSet("jobs")) {
+			jobCount = static_cast<uint32_t>(commandLineParser.getValueAsInt("jobs", 1));
 		}
-
-		vkQueueWaitIdle(queue);
-
-		// Output buffer contents
-		LOG("Compute input:\n");
-		for (auto v : computeInput) {
-			LOG("%d \t", v);
+		if (commandLineParser.isSet("batchsize")) {
+			jobsPerBatch = static_cast<uint32_t>(commandLineParser.getValueAsInt("batchsize", 16));
 		}
-		std::cout << std::endl;
+		// Timestamps are only available if the queue supports them
+		timestampPeriod = deviceProperties.limits.timestampPeriod;
+		const bool timestamps = queueFamilyProperties[queueFamilyIndex].timestampValidBits > 0;
+		prepareJobBatches(deviceProperties.limits.minStorageBufferOffsetAlignment, timestamps);
 
-		LOG("Compute output:\n");
-		for (auto v : computeOutput) {
-			LOG("%d \t", v);
+		/*
+			Run the jobs
+		*/
+		// Job j calculates the fibonacci numbers of j to j + BUFFER_ELEMENTS - 1
+		jobInputs.resize(jobCount * BUFFER_ELEMENTS);
+		for (uint32_t job = 0; job < jobCount; job++) {
+			uint32_t n = job;
+			std::generate(jobInputs.begin() + job * BUFFER_ELEMENTS, jobInputs.begin() + (job + 1) * BUFFER_ELEMENTS, [&n] { return n++; });
 		}
-		std::cout << std::endl;
+		jobOutputs.resize(jobInputs.size());
+		jobTimes.assign(jobCount, 0.0);
+
+		const auto tStart = std::chrono::high_resolution_clock::now();
+		runJobs(jobCount);
+		const auto tEnd = std::chrono::high_resolution_clock::now();
+
+		if (jobCount == 1) {
+			// Output buffer contents
+			LOG("Compute input:\n");
+			for (uint32_t i = 0; i < BUFFER_ELEMENTS; i++) {
+				LOG("%d \t", jobInputs[i]);
+			}
+			std::cout << std::endl;
 
-		// Clean up
-		vkDestroyBuffer(device, deviceBuffer, nullptr);
-		vkFreeMemory(device, deviceMemory, nullptr);
-		vkDestroyBuffer(device, hostBuffer, nullptr);
-		vkFreeMemory(device, hostMemory, nullptr);
+			LOG("Compute output:\n");
+			for (uint32_t i = 0; i < BUFFER_ELEMENTS; i++) {
+				LOG("%d \t", jobOutputs[i]);
+			}
+			std::cout << std::endl;
+		}
+		else {
+			// Check the results against the host
+			uint32_t mismatches = 0;
+			for (size_t i = 0; i < jobInputs.size(); i++) {
+				if (jobOutputs[i] != fibonacci(jobInputs[i])) {
+					mismatches++;
+				}
+			}
+			LOG("Ran %u jobs in batches of %u in %.3f ms, %u wrong results\n", jobCount, jobsPerBatch, std::chrono::duration<double, std::milli>(tEnd - tStart).count(), mismatches);
+		}
+		if (queryPool != VK_NULL_HANDLE) {
+			const auto minmax = std::minmax_element(jobTimes.begin(), jobTimes.end());
+			double total = 0.0;
+			for (auto time : jobTimes) {
+				total += time;
+			}
+			LOG("GPU time per job: %.4f ms average, %.4f ms min, %.4f ms max\n", total / jobCount, *minmax.first, *minmax.second);
+		}
 	}
 
 	~VulkanExample()
@@ -566,7 +679,7 @@ public:
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 		vkDestroyPipeline(device, pipeline, nullptr);
 		vkDestroyPipelineCache(device, pipelineCache, nullptr);
-		vkDestroyFence(device, fence, nullptr);
+		destroyJobBatches();
 		vkDestroyCommandPool(device, commandPool, nullptr);
 		vkDestroyShaderModule(device, shaderModule, nullptr);
 		vkDestroyDevice(device, nullptr);
@@ -607,6 +720,8 @@ void android_main(android_app* state) {
 int main(int argc, char* argv[]) {
 	commandLineParser.add("help", { "--help" }, 0, "Show help");
 	commandLineParser.add("shaders", { "-s", "--shaders" }, 1, "Select shader type to use (glsl or hlsl)");
+	commandLineParser.add("jobs", { "-j", "--jobs" }, 1, "Number of jobs to run (default 1)");
+	commandLineParser.add("batchsize", { "-b", "--batchsize" }, 1, "Number of jobs submitted together (default 16)");
 	commandLineParser.parse(argc, argv);
 	if (commandLineParser.isSet("help")) {
 		commandLineParser.printHelp();
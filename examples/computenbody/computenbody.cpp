@@ -7,6 +7,7 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanRadixSort.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -16,11 +17,24 @@
 #else
 #define PARTICLES_PER_ATTRACTOR 4 * 1024
 #endif
+// Significant bits of the Morton codes, 10 per axis
+#define MORTON_CODE_BITS 30
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
+	enum Solver {
+		// Every particle against every other one, O(N^2)
+		AllPairs = 0,
+		// Octree approximation of distant particles, O(N log N)
+		BarnesHut = 1,
+	};
+	int32_t solver = AllPairs;
+
 	uint32_t numParticles;
+	std::vector<uint32_t> particlesPerAttractorOptions = { PARTICLES_PER_ATTRACTOR, 16 * 1024, 64 * 1024, 256 * 1024, 512 * 1024 };
+	int32_t particlesPerAttractorIndex = 0;
+	uint32_t attractorCount = 0;
 
 	struct {
 		vks::Texture2D particle;
@@ -70,9 +84,28 @@ public:
 		struct computeUBO {							// Compute shader uniform block object
 			float deltaT;							//		Frame delta time
 			int32_t particleCount;
+			float theta = 0.5f;						//		Barnes-Hut opening angle
 		} ubo;
 	} compute;
 
+	// Resources for the Barnes-Hut solver, rebuilding a Morton ordered tree of the particles every frame
+	struct {
+		vks::Buffer particleBounds;					// Bounding box of the particles, used to quantize the positions
+		vks::Buffer keys;							// Morton codes, sorted in place
+		vks::Buffer values;							// Particle indices sorted along with the codes
+		vks::Buffer nodes;							// Binary radix tree, count - 1 internal nodes followed by count leaves
+		vks::Buffer nodeFlags;						// Children summarized per internal node
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline bounds;
+		VkPipeline morton;
+		VkPipeline build;
+		VkPipeline summarize;
+		VkPipeline calculate;
+	} tree;
+	std::unique_ptr<vks::RadixSort> radixSort;
+
 	// SSBO particle declaration
 	struct Particle {
 		glm::vec4 pos;								// xyz = position, w = mass
@@ -87,6 +120,8 @@ public:
 		camera.setRotation(glm::vec3(-26.0f, 75.0f, 0.0f));
 		camera.setTranslation(glm::vec3(0.0f, 0.0f, -14.0f));
 		camera.movementSpeed = 2.5f;
+		// The radix sort of the Barnes-Hut solver uses subgroup operations
+		apiVersion = VK_API_VERSION_1_1;
 	}
 
 	~VulkanExample()
@@ -108,6 +143,17 @@ public:
 		vkDestroySemaphore(device, compute.semaphore, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
 
+		// Barnes-Hut
+		destroyTreeBuffers();
+		vkDestroyPipeline(device, tree.bounds, nullptr);
+		vkDestroyPipeline(device, tree.morton, nullptr);
+		vkDestroyPipeline(device, tree.build, nullptr);
+		vkDestroyPipeline(device, tree.summarize, nullptr);
+		vkDestroyPipeline(device, tree.calculate, nullptr);
+		vkDestroyPipelineLayout(device, tree.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, tree.descriptorSetLayout, nullptr);
+		radixSort.reset();
+
 		textures.particle.destroy();
 		textures.gradient.destroy();
 	}
@@ -253,9 +299,16 @@ public:
 
 		// First pass: Calculate particle movement
 		// -------------------------------------------------------------------------------------------------------
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
-		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
-		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
+		if (solver == BarnesHut)
+		{
+			recordBarnesHut(compute.commandBuffer);
+		}
+		else
+		{
+			vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
+			vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
+			vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
+		}
 
 		// Add memory barrier to ensure that the computer shader has finished writing to the buffer
 		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
@@ -279,6 +332,7 @@ public:
 		// Second pass: Integrate particles
 		// -------------------------------------------------------------------------------------------------------
 		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
+		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
 		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
 
 		// Release barrier
@@ -310,6 +364,51 @@ public:
 		vkEndCommandBuffer(compute.commandBuffer);
 	}
 
+	// Makes the previous compute pass' writes visible to the next one
+	void computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+	{
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, srcStageMask, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_FLAGS_NONE, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	// Builds the tree from the current positions and calculates the velocities from it, replacing the all pairs pass
+	// Bounds -> Morton codes -> radix sort -> radix tree -> centers of mass -> traversal
+	void recordBarnesHut(VkCommandBuffer commandBuffer)
+	{
+		const uint32_t blockCount = (numParticles + 255) / 256;
+
+		// Empty bounds and unvisited nodes
+		vkCmdFillBuffer(commandBuffer, tree.particleBounds.buffer, 0, sizeof(uint32_t) * 4, 0xffffffff);
+		vkCmdFillBuffer(commandBuffer, tree.particleBounds.buffer, sizeof(uint32_t) * 4, sizeof(uint32_t) * 4, 0);
+		vkCmdFillBuffer(commandBuffer, tree.nodeFlags.buffer, 0, VK_WHOLE_SIZE, 0);
+		computeBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, tree.pipelineLayout, 0, 1, &tree.descriptorSet, 0, nullptr);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, tree.bounds);
+		vkCmdDispatch(commandBuffer, blockCount, 1, 1);
+		computeBarrier(commandBuffer);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, tree.morton);
+		vkCmdDispatch(commandBuffer, blockCount, 1, 1);
+
+		// Makes the Morton codes visible to the sort and the sorted codes and indices to the build pass
+		radixSort->record(commandBuffer, numParticles, MORTON_CODE_BITS);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, tree.pipelineLayout, 0, 1, &tree.descriptorSet, 0, nullptr);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, tree.build);
+		vkCmdDispatch(commandBuffer, blockCount, 1, 1);
+		computeBarrier(commandBuffer);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, tree.summarize);
+		vkCmdDispatch(commandBuffer, blockCount, 1, 1);
+		computeBarrier(commandBuffer);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, tree.calculate);
+		vkCmdDispatch(commandBuffer, blockCount, 1, 1);
+	}
+
 	// Setup and fill the compute shader storage buffers containing the particles
 	void prepareStorageBuffers()
 	{
@@ -329,7 +428,9 @@ public:
 		};
 #endif
 
-		numParticles = static_cast<uint32_t>(attractors.size()) * PARTICLES_PER_ATTRACTOR;
+		const uint32_t particlesPerAttractor = particlesPerAttractorOptions[particlesPerAttractorIndex];
+		attractorCount = static_cast<uint32_t>(attractors.size());
+		numParticles = attractorCount * particlesPerAttractor;
 
 		// Initial particle positions
 		std::vector<Particle> particleBuffer(numParticles);
@@ -339,9 +440,9 @@ public:
 
 		for (uint32_t i = 0; i < static_cast<uint32_t>(attractors.size()); i++)
 		{
-			for (uint32_t j = 0; j < PARTICLES_PER_ATTRACTOR; j++)
+			for (uint32_t j = 0; j < particlesPerAttractor; j++)
 			{
-				Particle &particle = particleBuffer[i * PARTICLES_PER_ATTRACTOR + j];
+				Particle &particle = particleBuffer[i * particlesPerAttractor + j];
 
 				// First particle in group as heavy center of gravity
 				if (j == 0)
@@ -461,20 +562,100 @@ public:
 		vertices.inputState.pVertexAttributeDescriptions = vertices.attributeDescriptions.data();
 	}
 
+	// Setup the Barnes-Hut buffers, sized for the current particle count
+	void prepareTreeBuffers()
+	{
+		// Center of mass, children, parent and size, matches the Node struct of the tree shaders
+		const VkDeviceSize nodeSize = sizeof(glm::vec4) + sizeof(uint32_t) * 4;
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &tree.particleBounds, sizeof(uint32_t) * 8));
+		// Written back by the radix sort if it ends with an odd number of passes
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &tree.keys, sizeof(uint32_t) * numParticles));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &tree.values, sizeof(uint32_t) * numParticles));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &tree.nodes, nodeSize * (2 * numParticles - 1)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &tree.nodeFlags, sizeof(uint32_t) * (numParticles - 1)));
+		radixSort->setBuffers(tree.keys.buffer, tree.values.buffer, numParticles);
+	}
+
+	void destroyTreeBuffers()
+	{
+		tree.particleBounds.destroy();
+		tree.keys.destroy();
+		tree.values.destroy();
+		tree.nodes.destroy();
+		tree.nodeFlags.destroy();
+	}
+
+	void prepareTreeDescriptorSets()
+	{
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0 : Particle position storage buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		// Binding 2 : Bounds, 3 : Keys, 4 : Values, 8 : Nodes, 9 : Node flags
+		for (uint32_t binding : { 2, 3, 4, 8, 9 }) {
+			setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, binding));
+		}
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &tree.descriptorSetLayout));
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&tree.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &tree.pipelineLayout));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &tree.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &tree.descriptorSet));
+
+		updateTreeDescriptorSets();
+	}
+
+	void updateTreeDescriptorSets()
+	{
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(tree.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(tree.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &compute.uniformBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(tree.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &tree.particleBounds.descriptor),
+			vks::initializers::writeDescriptorSet(tree.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &tree.keys.descriptor),
+			vks::initializers::writeDescriptorSet(tree.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &tree.values.descriptor),
+			vks::initializers::writeDescriptorSet(tree.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8, &tree.nodes.descriptor),
+			vks::initializers::writeDescriptorSet(tree.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 9, &tree.nodeFlags.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	// Recreates the particles and the buffers depending on their count
+	void changeParticleCount()
+	{
+		vkDeviceWaitIdle(device);
+		compute.storageBuffer.destroy();
+		destroyTreeBuffers();
+		prepareStorageBuffers();
+		prepareTreeBuffers();
+
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.storageBuffer.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		updateTreeDescriptorSets();
+
+		buildComputeCommandBuffer();
+		buildCommandBuffers();
+	}
+
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
 		};
 
+		// Graphics, compute and Barnes-Hut sets
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				static_cast<uint32_t>(poolSizes.size()),
 				poolSizes.data(),
-				2);
+				3);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -625,8 +806,8 @@ public:
 		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
 		submitInfo.signalSemaphoreCount = 1;
 		submitInfo.pSignalSemaphores = &graphics.semaphore;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueWaitIdle(queue));
 	}
 
 	void prepareCompute()
@@ -729,6 +910,24 @@ public:
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/particle_integrate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineIntegrate));
 
+		// Barnes-Hut tree build and traversal, the traversal uses the same force parameters as the all pairs pass
+		radixSort.reset(new vks::RadixSort(vulkanDevice, getShadersPath() + "base/radixsort_histogram.comp.spv", getShadersPath() + "base/radixsort_scan.comp.spv", getShadersPath() + "base/radixsort_scatter.comp.spv", apiVersion));
+		prepareTreeBuffers();
+		prepareTreeDescriptorSets();
+		computePipelineCreateInfo.layout = tree.pipelineLayout;
+		const std::vector<std::pair<std::string, VkPipeline*>> treeShaders = {
+			{ "tree_bounds", &tree.bounds },
+			{ "tree_morton", &tree.morton },
+			{ "tree_build", &tree.build },
+			{ "tree_summarize", &tree.summarize },
+			{ "tree_calculate", &tree.calculate },
+		};
+		for (auto& treeShader : treeShaders) {
+			computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computenbody/" + treeShader.first + ".comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, treeShader.second));
+		}
+
 		// Separate command pool as queue family for compute may be different than graphics
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
 		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -856,7 +1055,7 @@ public:
 		computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
 		computeSubmitInfo.signalSemaphoreCount = 1;
 		computeSubmitInfo.pSignalSemaphores = &compute.semaphore;
-		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::prepareFrame();
 
@@ -872,7 +1071,7 @@ public:
 		submitInfo.pWaitDstStageMask = graphicsWaitStageMasks;
 		submitInfo.signalSemaphoreCount = 2;
 		submitInfo.pSignalSemaphores = graphicsSignalSemaphores;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -907,6 +1106,28 @@ public:
 	{
 		updateGraphicsUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			// Sorting the Morton codes needs subgroup operations
+			if (radixSort->isSupported() && overlay->comboBox("Solver", &solver, { "All pairs", "Barnes-Hut" })) {
+				// The compute command buffer may still be executing
+				vulkanDevice->queueWaitIdle(compute.queue);
+				buildComputeCommandBuffer();
+			}
+			if (solver == BarnesHut) {
+				overlay->sliderFloat("Opening angle", &compute.ubo.theta, 0.0f, 1.5f);
+			}
+			std::vector<std::string> particleCounts;
+			for (uint32_t count : particlesPerAttractorOptions) {
+				particleCounts.push_back(std::to_string(count * attractorCount));
+			}
+			if (overlay->comboBox("Particles", &particlesPerAttractorIndex, particleCounts)) {
+				changeParticleCount();
+			}
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
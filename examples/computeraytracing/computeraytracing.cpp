@@ -1,12 +1,17 @@
 /*
 * Vulkan Example - Compute shader ray tracing
 *
+* Besides the analytic spheres and planes, a glTF mesh is traced through a BVH built on the CPU (vkglTF::TriangleBvh) and flattened
+* for stackless traversal, so arbitrary triangle meshes can be rendered without VK_KHR_ray_tracing_pipeline
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+#include "VulkanglTFBvh.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -17,6 +22,9 @@
 #define TEX_DIM 2048
 #endif
 
+// Needs to match the define of the ray tracing compute shader, spheres and planes need to use lower ids
+#define TRIANGLE_ID_OFFSET 1000
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -36,6 +44,10 @@ public:
 		struct {
 			vks::Buffer spheres;						// (Shader) storage buffer object with scene spheres
 			vks::Buffer planes;						// (Shader) storage buffer object with scene planes
+			vks::Buffer bvhNodes;					// Flattened BVH of the mesh triangles
+			vks::Buffer triangles;					// Mesh triangles in BVH leaf order
+			vks::Buffer triangleNormals;			// Vertex normals of the mesh triangles
+			vks::Buffer materials;					// Base color of the mesh materials
 		} storageBuffers;
 		vks::Buffer uniformBuffer;					// Uniform buffer object containing scene data
 		VkQueue queue;								// Separate queue for compute commands (queue family may differ from the one used for graphics)
@@ -79,6 +91,9 @@ public:
 		glm::ivec3 _pad;
 	};
 
+	vkglTF::Model mesh;
+	vkglTF::TriangleBvh meshBvh;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Compute shader ray tracing";
@@ -114,6 +129,10 @@ public:
 		compute.uniformBuffer.destroy();
 		compute.storageBuffers.spheres.destroy();
 		compute.storageBuffers.planes.destroy();
+		compute.storageBuffers.bvhNodes.destroy();
+		compute.storageBuffers.triangles.destroy();
+		compute.storageBuffers.triangleNormals.destroy();
+		compute.storageBuffers.materials.destroy();
 
 		textureComputeTarget.destroy();
 	}
@@ -379,6 +398,56 @@ public:
 		return plane;
 	}
 
+	void loadAssets()
+	{
+		// The host copy of the geometry is only needed to build the BVH
+		mesh.loadFromFile(getAssetPath() + "models/suzanne.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::KeepHostGeometry | vkglTF::FileLoadingFlags::DontLoadImages);
+	}
+
+	// Create a device local storage buffer for the compute shader and fill it through a staging buffer
+	void createStorageBuffer(vks::Buffer &buffer, const void *data, VkDeviceSize size)
+	{
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			size,
+			const_cast<void*>(data)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&buffer,
+			size));
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = size;
+		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, buffer.buffer, 1, &copyRegion);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		stagingBuffer.destroy();
+	}
+
+	// Build the BVH over the mesh triangles and upload it with the triangle data
+	void prepareMeshBuffers()
+	{
+		// This scene's y axis points down, glTF's up
+		const glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f, 1.25f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.6f, -0.6f, 0.6f));
+		meshBvh.build(mesh, transform);
+		const std::vector<vkglTF::TriangleBvh::Node> &nodes = meshBvh.getNodes();
+		const std::vector<vkglTF::TriangleBvh::Triangle> &triangles = meshBvh.getTriangles();
+		const std::vector<vkglTF::TriangleBvh::TriangleNormals> &triangleNormals = meshBvh.getTriangleNormals();
+		assert(!nodes.empty());
+		std::vector<glm::vec4> materialColors;
+		for (auto& material : mesh.materials) {
+			materialColors.push_back(material.baseColorFactor);
+		}
+		createStorageBuffer(compute.storageBuffers.bvhNodes, nodes.data(), nodes.size() * sizeof(vkglTF::TriangleBvh::Node));
+		createStorageBuffer(compute.storageBuffers.triangles, triangles.data(), triangles.size() * sizeof(vkglTF::TriangleBvh::Triangle));
+		createStorageBuffer(compute.storageBuffers.triangleNormals, triangleNormals.data(), triangleNormals.size() * sizeof(vkglTF::TriangleBvh::TriangleNormals));
+		createStorageBuffer(compute.storageBuffers.materials, materialColors.data(), materialColors.size() * sizeof(glm::vec4));
+		std::cout << "Mesh BVH: " << triangles.size() << " triangles, " << nodes.size() << " nodes, depth " << meshBvh.getDepth() << "\n";
+	}
+
 	// Setup and fill the compute shader storage buffers containing primitives for the raytraced scene
 	void prepareStorageBuffers()
 	{
@@ -425,6 +494,7 @@ public:
 		planes.push_back(newPlane(glm::vec3(-1.0f, 0.0f, 0.0f), roomDim, glm::vec3(1.0f, 0.0f, 0.0f), 32.0f));
 		planes.push_back(newPlane(glm::vec3(1.0f, 0.0f, 0.0f), roomDim, glm::vec3(0.0f, 1.0f, 0.0f), 32.0f));
 		storageBufferSize = planes.size() * sizeof(Plane);
+		assert(currentId < TRIANGLE_ID_OFFSET);
 
 		// Stage
 		vulkanDevice->createBuffer(
@@ -481,7 +551,7 @@ public:
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),			// Compute UBO
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4),	// Graphics image samplers
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),				// Storage image for ray traced image output
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2),			// Storage buffer for the scene primitives
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6),			// Storage buffers for the scene primitives and the mesh
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -659,7 +729,27 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				VK_SHADER_STAGE_COMPUTE_BIT,
-				3)
+				3),
+			// Binding 4: Shader storage buffer for the mesh BVH nodes
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				4),
+			// Binding 5: Shader storage buffer for the mesh triangles
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				5),
+			// Binding 6: Shader storage buffer for the mesh normals
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				6),
+			// Binding 7: Shader storage buffer for the mesh materials
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				7)
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -709,7 +799,31 @@ public:
 				compute.descriptorSet,
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				3,
-				&compute.storageBuffers.planes.descriptor)
+				&compute.storageBuffers.planes.descriptor),
+			// Binding 4: Shader storage buffer for the mesh BVH nodes
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				4,
+				&compute.storageBuffers.bvhNodes.descriptor),
+			// Binding 5: Shader storage buffer for the mesh triangles
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				5,
+				&compute.storageBuffers.triangles.descriptor),
+			// Binding 6: Shader storage buffer for the mesh normals
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				6,
+				&compute.storageBuffers.triangleNormals.descriptor),
+			// Binding 7: Shader storage buffer for the mesh materials
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				7,
+				&compute.storageBuffers.materials.descriptor)
 		};
 
 		vkUpdateDescriptorSets(device, computeWriteDescriptorSets.size(), computeWriteDescriptorSets.data(), 0, NULL);
@@ -757,6 +871,9 @@ public:
 			&compute.uniformBuffer,
 			sizeof(compute.ubo));
 
+		// Map persistent
+		VK_CHECK_RESULT(compute.uniformBuffer.map());
+
 		updateUniformBuffers();
 	}
 
@@ -766,9 +883,7 @@ public:
 		compute.ubo.lightPos.y = 0.0f + sin(glm::radians(timer * 360.0f)) * 2.0f;
 		compute.ubo.lightPos.z = 0.0f + cos(glm::radians(timer * 360.0f)) * 2.0f;
 		compute.ubo.camera.pos = camera.position * -1.0f;
-		VK_CHECK_RESULT(compute.uniformBuffer.map());
 		memcpy(compute.uniformBuffer.mapped, &compute.ubo, sizeof(compute.ubo));
-		compute.uniformBuffer.unmap();
 	}
 
 	void draw()
@@ -782,14 +897,14 @@ public:
 		computeSubmitInfo.commandBufferCount = 1;
 		computeSubmitInfo.pCommandBuffers = &compute.commandBuffer;
 
-		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, compute.fence));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(compute.queue, 1, &computeSubmitInfo, compute.fence));
 		
 		VulkanExampleBase::prepareFrame();
 
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();		
 	}
@@ -797,8 +912,10 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		loadAssets();
 		prepareTextureTarget(&textureComputeTarget, TEX_DIM, TEX_DIM, VK_FORMAT_R8G8B8A8_UNORM);
 		prepareStorageBuffers();
+		prepareMeshBuffers();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -11,6 +11,16 @@
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
 
+// Needs to match the FILTER_* and MAX_STAGES defines of filtertiled.comp and filterchain.comp
+#define FILTER_EMBOSS 0
+#define FILTER_EDGEDETECT 1
+#define FILTER_SHARPEN 2
+#define CHAIN_MAX_STAGES 3
+#define FILTER_TILE_SIZE 16
+
+// Dispatches between the two timestamps of a throughput measurement
+#define FILTER_BENCHMARK_ITERATIONS 32
+
 // Vertex layout for this example
 struct Vertex {
 	float pos[3];
@@ -49,9 +59,42 @@ public:
 		VkDescriptorSet descriptorSet;				// Compute shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the compute pipeline
 		std::vector<VkPipeline> pipelines;			// Compute pipelines for image filters
+		std::vector<VkPipeline> tiledPipelines;		// Variants of the filters loading their tile into shared memory
+		std::vector<VkPipeline> separablePipelines;	// Tiled variants summing the box kernels per row and column
+		VkPipeline chainPipeline;					// Runs several filters in one dispatch (see filterchain.comp)
 		int32_t pipelineIndex = 0;					// Current image filtering compute pipeline index
+		int32_t implementationIndex = 0;			// Current filter implementation
 	} compute;
 
+	enum FilterImplementation {
+		Direct = 0,
+		Tiled = 1,
+		TiledSeparable = 2,
+		FusedChain = 3
+	};
+	std::vector<std::string> implementationNames = { "Direct", "Tiled", "Tiled separable", "Fused chain (sharpen + filter)" };
+
+	// Matches the push constants of filterchain.comp
+	struct ChainPushConstants {
+		uint32_t filters[4];
+		uint32_t stageCount;
+	};
+
+	// Throughput of the filter implementations at common output resolutions (see runFilterBenchmark())
+	struct FilterBenchmark {
+		struct Result {
+			std::string resolution;
+			// Filter name or "chain"
+			std::string filter;
+			std::string implementation;
+			double megapixelsPerSecond;
+		};
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		std::vector<Result> results;
+		bool requested = false;
+	} filterBenchmark;
+
 	vks::Buffer vertexBuffer;
 	vks::Buffer indexBuffer;
 	uint32_t indexCount;
@@ -74,6 +117,9 @@ public:
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -2.0f));
 		camera.setRotation(glm::vec3(0.0f));
 		camera.setPerspective(60.0f, (float)width * 0.5f / (float)height, 1.0f, 256.0f);
+		commandLineParser.add("filterbenchmark", { "-fb", "--filterbenchmark" }, 0, "Measure the throughput of all filter implementations at 1080p to 8K after startup");
+		commandLineParser.parse(args);
+		filterBenchmark.requested = commandLineParser.isSet("filterbenchmark");
 	}
 
 	~VulkanExample()
@@ -89,11 +135,26 @@ public:
 		{
 			vkDestroyPipeline(device, pipeline, nullptr);
 		}
+		for (auto& pipeline : compute.tiledPipelines)
+		{
+			vkDestroyPipeline(device, pipeline, nullptr);
+		}
+		for (auto& pipeline : compute.separablePipelines)
+		{
+			vkDestroyPipeline(device, pipeline, nullptr);
+		}
+		vkDestroyPipeline(device, compute.chainPipeline, nullptr);
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroySemaphore(device, compute.semaphore, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
 
+		// Filter benchmark
+		if (filterBenchmark.queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, filterBenchmark.queryPool, nullptr);
+		}
+		vkDestroyDescriptorPool(device, filterBenchmark.descriptorPool, nullptr);
+
 		vertexBuffer.destroy();
 		indexBuffer.destroy();
 		uniformBufferVS.destroy();
@@ -103,7 +164,7 @@ public:
 	}
 
 	// Prepare a texture target that is used to store compute shader calculations
-	void prepareTextureTarget(vks::Texture *tex, uint32_t width, uint32_t height, VkFormat format)
+	void prepareTextureTarget(vks::Texture *tex, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags additionalUsage = 0)
 	{
 		VkFormatProperties formatProperties;
 
@@ -125,7 +186,7 @@ public:
 		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 		// Image will be sampled in the fragment shader and used as storage target in the compute shader
-		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | additionalUsage;
 		imageCreateInfo.flags = 0;
 		// If compute and graphics queue family indices differ, we create an image that can be shared between them
 		// This can result in worse performance than exclusive sharing mode, but save some synchronization to keep the sample simple
@@ -196,7 +257,7 @@ public:
 
 	void loadAssets()
 	{
-		textureColorMap.loadFromFile(getAssetPath() + "textures/vulkan_11_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+		textureColorMap.loadFromFile(getAssetPath() + "textures/vulkan_11_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_LAYOUT_GENERAL);
 	}
 
 	void buildCommandBuffers()
@@ -281,20 +342,61 @@ public:
 	void buildComputeCommandBuffer()
 	{
 		// Flush the queue if we're rebuilding the command buffer after a pipeline change to ensure it's not currently in use
-		vkQueueWaitIdle(compute.queue);
+		vulkanDevice->queueWaitIdle(compute.queue);
 
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
 
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelines[compute.pipelineIndex]);
-		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
-
-		vkCmdDispatch(compute.commandBuffer, textureComputeTarget.width / 16, textureComputeTarget.height / 16, 1);
+		recordFilter(compute.commandBuffer, compute.implementationIndex, compute.pipelineIndex, compute.descriptorSet, textureComputeTarget.width, textureComputeTarget.height);
 
 		vkEndCommandBuffer(compute.commandBuffer);
 	}
 
+	// Records a fused chain of up to CHAIN_MAX_STAGES filters, reading from binding 0 and writing to binding 1 of the descriptor set
+	void recordFilterChain(VkCommandBuffer commandBuffer, const std::vector<uint32_t> &filters, VkDescriptorSet descriptorSet, uint32_t width, uint32_t height)
+	{
+		assert(!filters.empty() && filters.size() <= CHAIN_MAX_STAGES);
+		ChainPushConstants pushConstants{};
+		for (size_t i = 0; i < filters.size(); i++) {
+			pushConstants.filters[i] = filters[i];
+		}
+		pushConstants.stageCount = static_cast<uint32_t>(filters.size());
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.chainPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &descriptorSet, 0, 0);
+		vkCmdPushConstants(commandBuffer, compute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ChainPushConstants), &pushConstants);
+		vkCmdDispatch(commandBuffer, (width + FILTER_TILE_SIZE - 1) / FILTER_TILE_SIZE, (height + FILTER_TILE_SIZE - 1) / FILTER_TILE_SIZE, 1);
+	}
+
+	// Records a filter with the given implementation, reading from binding 0 and writing to binding 1 of the descriptor set
+	void recordFilter(VkCommandBuffer commandBuffer, int32_t implementation, uint32_t filter, VkDescriptorSet descriptorSet, uint32_t width, uint32_t height)
+	{
+		if (implementation == FusedChain) {
+			recordFilterChain(commandBuffer, { FILTER_SHARPEN, filter }, descriptorSet, width, height);
+			return;
+		}
+		VkPipeline pipeline = compute.pipelines[filter];
+		if (implementation == Tiled) {
+			pipeline = compute.tiledPipelines[filter];
+		}
+		if (implementation == TiledSeparable) {
+			pipeline = compute.separablePipelines[filter];
+		}
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &descriptorSet, 0, 0);
+		// All implementations use 16x16 workgroups, partial workgroups at the right and bottom edge return early
+		vkCmdDispatch(commandBuffer, (width + FILTER_TILE_SIZE - 1) / FILTER_TILE_SIZE, (height + FILTER_TILE_SIZE - 1) / FILTER_TILE_SIZE, 1);
+	}
+
+	// Makes the writes of a filter pass visible to the next one
+	void filterPassBarrier(VkCommandBuffer commandBuffer)
+	{
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
 	// Setup vertices for a single uv-mapped quad
 	void generateQuad()
 	{
@@ -493,8 +595,8 @@ public:
 		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
 		submitInfo.signalSemaphoreCount = 1;
 		submitInfo.pSignalSemaphores = &graphics.semaphore;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-		VK_CHECK_RESULT(vkQueueWaitIdle(queue));	
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueWaitIdle(queue));	
 	}
 
 	void prepareCompute()
@@ -517,6 +619,10 @@ public:
 
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =
 			vks::initializers::pipelineLayoutCreateInfo(&compute.descriptorSetLayout, 1);
+		// Push constants select the stages of the fused filter chain
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ChainPushConstants), 0);
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
 
@@ -544,6 +650,31 @@ public:
 			compute.pipelines.push_back(pipeline);
 		}
 
+		// Tiled variants of the filters, the filter and whether the box sum is separated are specialization constants
+		struct SpecializationData {
+			uint32_t filter;
+			VkBool32 separable;
+		} specializationData;
+		std::vector<VkSpecializationMapEntry> specializationMapEntries = {
+			vks::initializers::specializationMapEntry(0, offsetof(SpecializationData, filter), sizeof(uint32_t)),
+			vks::initializers::specializationMapEntry(1, offsetof(SpecializationData, separable), sizeof(VkBool32)),
+		};
+		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(specializationMapEntries, sizeof(specializationData), &specializationData);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computeshader/filtertiled.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+		for (uint32_t filter = 0; filter < static_cast<uint32_t>(shaderNames.size()); filter++) {
+			for (VkBool32 separable : { VK_FALSE, VK_TRUE }) {
+				specializationData.filter = filter;
+				specializationData.separable = separable;
+				VkPipeline pipeline;
+				VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
+				(separable ? compute.separablePipelines : compute.tiledPipelines).push_back(pipeline);
+			}
+		}
+
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computeshader/filterchain.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.chainPipeline));
+
 		// Separate command pool as queue family for compute may be different than graphics
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
 		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -568,6 +699,137 @@ public:
 		buildComputeCommandBuffer();
 	}
 
+	void prepareFilterBenchmark()
+	{
+		// Timestamps are written on the compute queue, the benchmark is not available if that queue doesn't support them
+		if (vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.compute].timestampValidBits > 0) {
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &filterBenchmark.queryPool));
+		}
+
+		// One descriptor set per pass of the multi pass chains
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 6),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &filterBenchmark.descriptorPool));
+	}
+
+	// Measures the throughput of the filter implementations in megapixels per second for 1080p to 8K inputs
+	// Every measurement records FILTER_BENCHMARK_ITERATIONS dispatches with a barrier in between (like consecutive frames) between two
+	// timestamps on the compute queue. The chains run sharpen, edge detect and emboss either as three passes through an intermediate
+	// image or fused in one dispatch.
+	void runFilterBenchmark()
+	{
+		filterBenchmark.results.clear();
+		if (filterBenchmark.queryPool == VK_NULL_HANDLE) {
+			std::cout << "Filter throughput can't be measured, the compute queue doesn't support timestamps" << std::endl;
+			return;
+		}
+
+		VK_CHECK_RESULT(vulkanDevice->queueWaitIdle(queue));
+		VK_CHECK_RESULT(vulkanDevice->queueWaitIdle(compute.queue));
+
+		const uint32_t validBits = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.compute].timestampValidBits;
+		const uint64_t timestampMask = validBits >= 64 ? ~0ULL : (1ULL << validBits) - 1;
+		const std::vector<std::pair<std::string, VkExtent2D>> resolutions = {
+			{ "1080p", { 1920, 1080 } },
+			{ "1440p", { 2560, 1440 } },
+			{ "4K", { 3840, 2160 } },
+			{ "8K", { 7680, 4320 } },
+		};
+		const std::vector<uint32_t> chain = { FILTER_SHARPEN, FILTER_EDGEDETECT, FILTER_EMBOSS };
+
+		for (auto& resolution : resolutions) {
+			const uint32_t imageWidth = resolution.second.width;
+			const uint32_t imageHeight = resolution.second.height;
+
+			// Input (the color map scaled up to the resolution), output and intermediate image of the multi pass chains
+			std::array<vks::Texture2D, 3> images;
+			for (auto& image : images) {
+				prepareTextureTarget(&image, imageWidth, imageHeight, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+			}
+			VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			VkImageBlit imageBlit{};
+			imageBlit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			imageBlit.srcOffsets[1] = { static_cast<int32_t>(textureColorMap.width), static_cast<int32_t>(textureColorMap.height), 1 };
+			imageBlit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			imageBlit.dstOffsets[1] = { static_cast<int32_t>(imageWidth), static_cast<int32_t>(imageHeight), 1 };
+			vkCmdBlitImage(copyCmd, textureColorMap.image, VK_IMAGE_LAYOUT_GENERAL, images[0].image, VK_IMAGE_LAYOUT_GENERAL, 1, &imageBlit, VK_FILTER_LINEAR);
+			vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+
+			// Pass i of the multi pass chains reads from images[sources[i]] and writes to images[targets[i]]
+			const std::array<uint32_t, 3> sources = { 0, 1, 2 };
+			const std::array<uint32_t, 3> targets = { 1, 2, 1 };
+			std::array<VkDescriptorSet, 3> descriptorSets;
+			VK_CHECK_RESULT(vkResetDescriptorPool(device, filterBenchmark.descriptorPool, 0));
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(filterBenchmark.descriptorPool, &compute.descriptorSetLayout, 1);
+			for (size_t i = 0; i < descriptorSets.size(); i++) {
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets[i]));
+				std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+					vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, &images[sources[i]].descriptor),
+					vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &images[targets[i]].descriptor)
+				};
+				vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+			}
+
+			auto measure = [&](const std::string& filter, const std::string& implementation, const std::function<void(VkCommandBuffer)>& record) {
+				VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool, true);
+				vkCmdResetQueryPool(commandBuffer, filterBenchmark.queryPool, 0, 2);
+				// One untimed run to warm up caches and clocks
+				record(commandBuffer);
+				filterPassBarrier(commandBuffer);
+				vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, filterBenchmark.queryPool, 0);
+				for (uint32_t i = 0; i < FILTER_BENCHMARK_ITERATIONS; i++) {
+					record(commandBuffer);
+					filterPassBarrier(commandBuffer);
+				}
+				vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, filterBenchmark.queryPool, 1);
+				vulkanDevice->flushCommandBuffer(commandBuffer, compute.queue, compute.commandPool, true);
+
+				uint64_t timestamps[2];
+				VK_CHECK_RESULT(vkGetQueryPoolResults(device, filterBenchmark.queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+				const double seconds = static_cast<double>((timestamps[1] - timestamps[0]) & timestampMask) * vulkanDevice->properties.limits.timestampPeriod / 1.0e9;
+				const double megapixels = static_cast<double>(imageWidth) * static_cast<double>(imageHeight) * FILTER_BENCHMARK_ITERATIONS / 1.0e6;
+				FilterBenchmark::Result result{ resolution.first, filter, implementation, seconds > 0.0 ? megapixels / seconds : 0.0 };
+				std::cout << "Filter throughput " << result.resolution << " " << result.filter << " " << result.implementation << ": " << static_cast<uint64_t>(result.megapixelsPerSecond) << " MP/s" << std::endl;
+				filterBenchmark.results.push_back(result);
+			};
+
+			for (uint32_t filter = 0; filter < static_cast<uint32_t>(shaderNames.size()); filter++) {
+				for (int32_t implementation : { Direct, Tiled, TiledSeparable }) {
+					// Emboss has no box sum to separate
+					if (implementation == TiledSeparable && filter == FILTER_EMBOSS) {
+						continue;
+					}
+					measure(shaderNames[filter], implementationNames[implementation], [&](VkCommandBuffer commandBuffer) {
+						recordFilter(commandBuffer, implementation, filter, descriptorSets[0], imageWidth, imageHeight);
+					});
+				}
+			}
+			for (int32_t implementation : { Direct, TiledSeparable }) {
+				measure("chain", implementationNames[implementation] + " (3 passes)", [&](VkCommandBuffer commandBuffer) {
+					for (size_t i = 0; i < chain.size(); i++) {
+						if (i > 0) {
+							filterPassBarrier(commandBuffer);
+						}
+						recordFilter(commandBuffer, implementation, chain[i], descriptorSets[i], imageWidth, imageHeight);
+					}
+				});
+			}
+			measure("chain", "Fused", [&](VkCommandBuffer commandBuffer) {
+				recordFilterChain(commandBuffer, chain, descriptorSets[0], imageWidth, imageHeight);
+			});
+
+			for (auto& image : images) {
+				image.destroy();
+			}
+		}
+	}
+
 	// Prepare and initialize uniform buffer containing shader uniforms
 	void prepareUniformBuffers()
 	{
@@ -605,7 +867,7 @@ public:
 		computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
 		computeSubmitInfo.signalSemaphoreCount = 1;
 		computeSubmitInfo.pSignalSemaphores = &compute.semaphore;
-		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));	
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(compute.queue, 1, &computeSubmitInfo, VK_NULL_HANDLE));	
 		VulkanExampleBase::prepareFrame();
 
 		VkPipelineStageFlags graphicsWaitStageMasks[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
@@ -620,7 +882,7 @@ public:
 		submitInfo.pWaitDstStageMask = graphicsWaitStageMasks;
 		submitInfo.signalSemaphoreCount = 2;
 		submitInfo.pSignalSemaphores = graphicsSignalSemaphores;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -639,6 +901,7 @@ public:
 		setupDescriptorSet();
 		prepareGraphics();
 		prepareCompute();
+		prepareFilterBenchmark();
 		buildCommandBuffers();
 		prepared = true;
 	}
@@ -647,6 +910,10 @@ public:
 	{
 		if (!prepared)
 			return;
+		if (filterBenchmark.requested) {
+			filterBenchmark.requested = false;
+			runFilterBenchmark();
+		}
 		draw();
 		if (camera.updated) {
 			updateUniformBuffers();
@@ -665,6 +932,20 @@ public:
 			if (overlay->comboBox("Shader", &compute.pipelineIndex, shaderNames)) {
 				buildComputeCommandBuffer();
 			}
+			if (overlay->comboBox("Implementation", &compute.implementationIndex, implementationNames)) {
+				buildComputeCommandBuffer();
+			}
+		}
+		if (overlay->header("Filter throughput")) {
+			if (overlay->button("Measure 1080p to 8K")) {
+				filterBenchmark.requested = true;
+			}
+			// Results of the selected filter and the chains
+			for (auto& result : filterBenchmark.results) {
+				if ((result.filter == shaderNames[compute.pipelineIndex]) || (result.filter == "chain")) {
+					overlay->text("%s %s %s: %.0f MP/s", result.resolution.c_str(), result.filter.c_str(), result.implementation.c_str(), result.megapixelsPerSecond);
+				}
+			}
 		}
 	}
 };
@@ -6,6 +6,10 @@
 * With conditional rendering it's possible to execute certain rendering commands based on a buffer value instead of having to rebuild the command buffers.
 * This example sets up a conditional buffer with one value per glTF part, that is used to toggle visibility of single model parts.
 *
+* The occlusion modes test the bounding box of each part against a depth pyramid of the previous frame in a compute shader. The GPU occlusion mode
+* writes the results directly into a device local conditional buffer, the readback mode copies them to the host, which combines them with the toggles
+* and writes the host visible conditional buffer like the manual mode, to compare both approaches.
+*
 * Copyright (C) 2018-2023 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -13,6 +17,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanDepthPyramid.h"
 
 #define ENABLE_VALIDATION false
 
@@ -40,9 +45,66 @@ public:
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkDescriptorSet descriptorSet;
 
+	// Source of the conditional rendering predicates
+	enum VisibilityMode { Manual = 0, GPUOcclusion = 1, ReadbackOcclusion = 2 };
+	int32_t visibilityMode = GPUOcclusion;
+	const std::vector<std::string> visibilityModeNames = { "Manual", "GPU occlusion", "Occlusion readback" };
+	// The benchmark is run for both occlusion modes in turn
+	const uint32_t benchmarkFramesPerMode = 500;
+	uint32_t benchmarkFrame = 0;
+
+	// Model space bounding box of a node, min > max for nodes without a mesh
+	struct NodeBounds {
+		glm::vec4 min;
+		glm::vec4 max;
+	};
+
+	struct UBOOcclusion {
+		glm::mat4 viewProjection;
+		glm::vec2 pyramidSize;
+		uint32_t pyramidLevels;
+		uint32_t pyramidValid;
+		uint32_t nodeCount;
+	};
+
+	struct {
+		// Requires the depth format to be sampled and the pyramid format to be a storage image
+		bool supported = false;
+		std::unique_ptr<vks::DepthPyramid> depthPyramid;
+		// Depth aspect view of the depth attachment the pyramid is built from
+		VkImageView depthView = VK_NULL_HANDLE;
+		// Set once a pyramid has been built for the current size
+		bool pyramidValid = false;
+		UBOOcclusion ubo;
+		vks::Buffer uniformBuffer;
+		vks::Buffer bounds;
+		// Predicates written by the compute shader and used for conditional rendering in the GPU occlusion mode
+		vks::Buffer predicates;
+		// Copies of the predicates per command buffer for the host
+		std::vector<vks::Buffer> readback;
+		// Command buffer submitted in each frame in flight slot and its frame number, 0 if the slot's results can't be used
+		std::vector<uint32_t> slotBuffers;
+		std::vector<uint64_t> slotFrames;
+		uint64_t frameNumber = 0;
+		// View projection the scene was last rendered with, the pyramid is in its screen space
+		glm::mat4 previousViewProjection{ 1.0f };
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		// Statistics for the UI
+		uint32_t visibleNodes = 0;
+		uint32_t meshNodes = 0;
+		// Age of the depth the predicates of the current frame were tested against, in frames
+		uint64_t resultAge = 0;
+		// Host time spent reading back and combining the results in milliseconds
+		double hostTime = 0.0;
+	} occlusion;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Conditional rendering";
+		supportsFramesInFlight = true;
 		camera.type = Camera::CameraType::lookat;
 		camera.setPerspective(45.0f, (float)width / (float)height, 0.1f, 512.0f);
 		camera.setRotation(glm::vec3(-2.25f, -52.0f, 0.0f));
@@ -62,6 +124,19 @@ public:
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		uniformBuffer.destroy();
 		conditionalBuffer.destroy();
+		if (occlusion.supported) {
+			vkDestroyPipeline(device, occlusion.pipeline, nullptr);
+			vkDestroyPipelineLayout(device, occlusion.pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, occlusion.descriptorSetLayout, nullptr);
+			vkDestroyImageView(device, occlusion.depthView, nullptr);
+			occlusion.depthPyramid.reset();
+			occlusion.uniformBuffer.destroy();
+			occlusion.bounds.destroy();
+			occlusion.predicates.destroy();
+			for (auto& buffer : occlusion.readback) {
+				buffer.destroy();
+			}
+		}
 	}
 
 	void renderNode(vkglTF::Node *node, VkCommandBuffer commandBuffer) {
@@ -80,7 +155,8 @@ public:
 				*/
 				VkConditionalRenderingBeginInfoEXT conditionalRenderingBeginInfo{};
 				conditionalRenderingBeginInfo.sType = VK_STRUCTURE_TYPE_CONDITIONAL_RENDERING_BEGIN_INFO_EXT;
-				conditionalRenderingBeginInfo.buffer = conditionalBuffer.buffer;
+				// The GPU occlusion mode uses the predicates written by the compute shader, the other modes the ones written by the host
+				conditionalRenderingBeginInfo.buffer = (visibilityMode == GPUOcclusion) ? occlusion.predicates.buffer : conditionalBuffer.buffer;
 				conditionalRenderingBeginInfo.offset = sizeof(int32_t) * node->index;
 
 				/*
@@ -102,6 +178,67 @@ public:
 	}
 
 
+	/*
+		[POI] Test the node bounds against the depth pyramid of the previous frame and write the predicates on the GPU
+	*/
+	void recordOcclusionTest(VkCommandBuffer commandBuffer, uint32_t index)
+	{
+		// The draws of the previous frame and the copy of its results have to be done before the predicates are overwritten
+		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferBarrier.srcAccessMask = 0;
+		bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.buffer = occlusion.predicates.buffer;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_CONDITIONAL_RENDERING_BIT_EXT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+		// Host visibility is combined on the GPU, unless the results are read back and combined on the host
+		const uint32_t combineManual = (visibilityMode == GPUOcclusion) ? 1 : 0;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusion.pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusion.pipelineLayout, 0, 1, &occlusion.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, occlusion.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &combineManual);
+		vkCmdDispatch(commandBuffer, (static_cast<uint32_t>(conditionalVisibility.size()) + 63) / 64, 1, 1);
+
+		// Make the predicates visible to conditional rendering and the copy
+		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_CONDITIONAL_RENDERING_READ_BIT_EXT | VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_CONDITIONAL_RENDERING_BIT_EXT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+		// The readback mode uses the copy to set the host visible conditional buffer, the GPU occlusion mode only for the statistics
+		VkBufferCopy copyRegion{};
+		copyRegion.size = occlusion.predicates.size;
+		vkCmdCopyBuffer(commandBuffer, occlusion.predicates.buffer, occlusion.readback[index].buffer, 1, &copyRegion);
+		bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		bufferBarrier.buffer = occlusion.readback[index].buffer;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+	}
+
+	// Reduce the depth of the frame into the pyramid tested against by the next frame
+	void recordDepthPyramid(VkCommandBuffer commandBuffer)
+	{
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+		if (vks::tools::formatHasStencil(depthFormat)) {
+			subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		imageBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		imageBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		imageBarrier.image = depthStencil.image;
+		imageBarrier.subresourceRange = subresourceRange;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+		occlusion.depthPyramid->record(commandBuffer);
+
+		// The next render pass clears the depth attachment, which has to wait for the reduction
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		imageBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		imageBarrier.srcAccessMask = 0;
+		imageBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -124,6 +261,15 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			benchmark.gpuProfiler.reset(drawCmdBuffers[i], i);
+
+			const bool occlusionTest = (visibilityMode != Manual);
+			if (occlusionTest) {
+				benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, "Occlusion test (" + visibilityModeNames[visibilityMode] + ")");
+				recordOcclusionTest(drawCmdBuffers[i], i);
+				benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
+			}
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -138,14 +284,22 @@ public:
 			const VkDeviceSize offsets[1] = { 0 };
 			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &scene.vertices.buffer, offsets);
 			vkCmdBindIndexBuffer(drawCmdBuffers[i], scene.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, "Scene (" + visibilityModeNames[visibilityMode] + ")");
 			for (auto node : scene.nodes) {
 				renderNode(node, drawCmdBuffers[i]);
 			}
+			benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
 
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			if (occlusionTest) {
+				benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, "Depth pyramid");
+				recordDepthPyramid(drawCmdBuffers[i]);
+				benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
+			}
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -158,9 +312,11 @@ public:
 	void setupDescriptorSets()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes.size(), poolSizes.data(), 1);
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes.size(), poolSizes.data(), 2);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &descriptorPool));
 
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
@@ -187,6 +343,21 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffer.descriptor)
 		};
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+
+		// Occlusion test
+		if (occlusion.supported) {
+			descriptorSetAllocateInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &occlusion.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &occlusion.descriptorSet));
+			VkDescriptorImageInfo pyramidDescriptor = occlusion.depthPyramid->getDescriptor();
+			writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(occlusion.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &occlusion.uniformBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(occlusion.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &pyramidDescriptor),
+				vks::initializers::writeDescriptorSet(occlusion.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &occlusion.bounds.descriptor),
+				vks::initializers::writeDescriptorSet(occlusion.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &conditionalBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(occlusion.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &occlusion.predicates.descriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
 	}
 
 	void preparePipelines()
@@ -275,8 +446,9 @@ public:
 			This sample renders multiple rows of objects conditionally, so we setup a buffer with one value per row
 		*/
 		conditionalVisibility.resize(scene.linearNodes.size());
+		// Also read by the occlusion test for the host visibility
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT,
+			VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&conditionalBuffer,
 			sizeof(int32_t) *conditionalVisibility.size(),
@@ -294,20 +466,254 @@ public:
 		updateConditionalBuffer();
 	}
 
+	// Model space bounds of the node's primitives, including the node transform the vertex shader applies
+	NodeBounds getNodeBounds(vkglTF::Node *node)
+	{
+		NodeBounds nodeBounds = { glm::vec4(FLT_MAX), glm::vec4(-FLT_MAX) };
+		if (!node->mesh) {
+			return nodeBounds;
+		}
+		const glm::mat4 matrix = node->getMatrix();
+		for (vkglTF::Primitive *primitive : node->mesh->primitives) {
+			for (uint32_t i = 0; i < 8; i++) {
+				const glm::vec3 corner = glm::vec3(
+					(i & 1) ? primitive->dimensions.max.x : primitive->dimensions.min.x,
+					(i & 2) ? primitive->dimensions.max.y : primitive->dimensions.min.y,
+					(i & 4) ? primitive->dimensions.max.z : primitive->dimensions.min.z);
+				const glm::vec4 position = matrix * glm::vec4(corner, 1.0f);
+				nodeBounds.min = glm::min(nodeBounds.min, glm::vec4(glm::vec3(position), 0.0f));
+				nodeBounds.max = glm::max(nodeBounds.max, glm::vec4(glm::vec3(position), 0.0f));
+			}
+		}
+		return nodeBounds;
+	}
+
+	/*
+		[POI] Occlusion test setup
+
+		The bounds of all nodes are tested against a depth pyramid in a compute shader that writes the conditional rendering predicates
+	*/
+	void prepareOcclusion()
+	{
+		occlusion.depthPyramid.reset(new vks::DepthPyramid(vulkanDevice, getShadersPath() + "base/depthpyramid.comp.spv"));
+		if (!occlusion.depthPyramid->isSupported()) {
+			occlusion.supported = false;
+			occlusion.depthPyramid.reset();
+			visibilityMode = Manual;
+			return;
+		}
+
+		const uint32_t nodeCount = static_cast<uint32_t>(conditionalVisibility.size());
+		std::vector<NodeBounds> nodeBounds(nodeCount, { glm::vec4(FLT_MAX), glm::vec4(-FLT_MAX) });
+		for (auto node : scene.linearNodes) {
+			nodeBounds[node->index] = getNodeBounds(node);
+			if (node->mesh) {
+				occlusion.meshNodes++;
+			}
+		}
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&occlusion.bounds,
+			sizeof(NodeBounds) * nodeBounds.size(),
+			nodeBounds.data()));
+
+		// Only accessed by the GPU, except for the copies read back by the host
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&occlusion.predicates,
+			sizeof(int32_t) * nodeCount));
+		occlusion.readback.resize(drawCmdBuffers.size());
+		for (auto& buffer : occlusion.readback) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&buffer,
+				sizeof(int32_t) * nodeCount));
+			VK_CHECK_RESULT(buffer.map());
+		}
+		occlusion.slotBuffers.resize(settings.framesInFlight, 0);
+		occlusion.slotFrames.resize(settings.framesInFlight, 0);
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&occlusion.uniformBuffer,
+			sizeof(UBOOcclusion)));
+		VK_CHECK_RESULT(occlusion.uniformBuffer.map());
+		occlusion.ubo.nodeCount = nodeCount;
+
+		// Binding 0: Uniform buffer, binding 1: Depth pyramid, binding 2: Node bounds, binding 3: Host visibility, binding 4: Predicates
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &occlusion.descriptorSetLayout));
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&occlusion.descriptorSetLayout, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), 0);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &occlusion.pipelineLayout));
+
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(occlusion.pipelineLayout, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "conditionalrender/occlusion.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &occlusion.pipeline));
+
+		prepareDepthPyramid();
+	}
+
+	// (Re)creates the depth pyramid for the current depth attachment
+	void prepareDepthPyramid()
+	{
+		if (occlusion.depthView != VK_NULL_HANDLE) {
+			vkDestroyImageView(device, occlusion.depthView, nullptr);
+		}
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = depthFormat;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+		viewCI.image = depthStencil.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &occlusion.depthView));
+
+		occlusion.depthPyramid->create(width, height, occlusion.depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+		occlusion.ubo.pyramidSize = glm::vec2(static_cast<float>(occlusion.depthPyramid->getWidth()), static_cast<float>(occlusion.depthPyramid->getHeight()));
+		occlusion.ubo.pyramidLevels = occlusion.depthPyramid->getLevelCount();
+		occlusion.pyramidValid = false;
+
+		// The occlusion test binds the pyramid before the first frame has built it
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(
+			commandBuffer,
+			occlusion.depthPyramid->getImage(),
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			{ VK_IMAGE_ASPECT_COLOR_BIT, 0, occlusion.depthPyramid->getLevelCount(), 0, 1 });
+		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+
+		if (occlusion.descriptorSet != VK_NULL_HANDLE) {
+			VkDescriptorImageInfo pyramidDescriptor = occlusion.depthPyramid->getDescriptor();
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(occlusion.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &pyramidDescriptor);
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		}
+	}
+
+	void updateOcclusionUniformBuffer()
+	{
+		// Without a pyramid only the view frustum of the current frame is tested
+		occlusion.ubo.viewProjection = occlusion.pyramidValid ? occlusion.previousViewProjection : uboVS.projection * uboVS.view * uboVS.model;
+		occlusion.ubo.pyramidValid = occlusion.pyramidValid ? 1 : 0;
+		memcpy(occlusion.uniformBuffer.mapped, &occlusion.ubo, sizeof(UBOOcclusion));
+	}
+
+	/*
+		[POI] Readback path for comparison
+
+		Reads the results of the last frame known to be complete and combines them with the host visibility into the host visible conditional buffer
+	*/
+	void applyOcclusionReadback()
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		const uint64_t resultFrame = occlusion.slotFrames[currentFrame];
+		if (resultFrame != 0) {
+			const int32_t *results = static_cast<const int32_t*>(occlusion.readback[occlusion.slotBuffers[currentFrame]].mapped);
+			int32_t *predicates = static_cast<int32_t*>(conditionalBuffer.mapped);
+			for (size_t i = 0; i < conditionalVisibility.size(); i++) {
+				predicates[i] = (conditionalVisibility[i] != 0) && (results[i] != 0) ? 1 : 0;
+			}
+			// The results were tested against the depth of the frame before the one they were computed in
+			occlusion.resultAge = occlusion.frameNumber + 2 - resultFrame;
+		}
+		else {
+			updateConditionalBuffer();
+			occlusion.resultAge = 0;
+		}
+		occlusion.hostTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
+	// Visible node count of the last complete frame for the UI, the GPU occlusion mode doesn't depend on it
+	void updateOcclusionStatistics()
+	{
+		occlusion.visibleNodes = 0;
+		if (occlusion.slotFrames[currentFrame] != 0) {
+			const int32_t *results = static_cast<const int32_t*>(occlusion.readback[occlusion.slotBuffers[currentFrame]].mapped);
+			for (auto node : scene.linearNodes) {
+				if (node->mesh && (results[node->index] != 0) && (conditionalVisibility[node->index] != 0)) {
+					occlusion.visibleNodes++;
+				}
+			}
+		}
+		if (visibilityMode == GPUOcclusion) {
+			occlusion.resultAge = occlusion.pyramidValid ? 1 : 0;
+			occlusion.hostTime = 0.0;
+		}
+	}
+
+	void setVisibilityMode(int32_t mode)
+	{
+		vulkanDevice->queueWaitIdle(queue);
+		visibilityMode = mode;
+		// Results of the previous mode can't be used, and the manual mode doesn't build the pyramid
+		std::fill(occlusion.slotFrames.begin(), occlusion.slotFrames.end(), 0);
+		occlusion.pyramidValid = false;
+		updateConditionalBuffer();
+		buildCommandBuffers();
+	}
+
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
+		const bool occlusionTest = (visibilityMode != Manual);
+		if (occlusionTest) {
+			// The frame that last used this frame in flight slot is complete, so its results can be read
+			if (visibilityMode == ReadbackOcclusion) {
+				applyOcclusionReadback();
+			}
+			updateOcclusionStatistics();
+			updateOcclusionUniformBuffer();
+		}
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
+		if (occlusionTest) {
+			occlusion.frameNumber++;
+			// A command buffer's readback buffer is overwritten by its new submission
+			for (uint32_t slot = 0; slot < occlusion.slotBuffers.size(); slot++) {
+				if (occlusion.slotBuffers[slot] == currentBuffer) {
+					occlusion.slotFrames[slot] = 0;
+				}
+			}
+			occlusion.slotBuffers[currentFrame] = currentBuffer;
+			occlusion.slotFrames[currentFrame] = occlusion.frameNumber;
+			occlusion.previousViewProjection = uboVS.projection * uboVS.view * uboVS.model;
+			occlusion.pyramidValid = true;
+		}
 		VulkanExampleBase::submitFrame();
 	}
 
 	void prepare()
 	{
+		// The depth pyramid is built from the depth attachment
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, depthFormat, &formatProperties);
+		occlusion.supported = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+		if (occlusion.supported) {
+			depthStencil.additionalUsage = VK_IMAGE_USAGE_SAMPLED_BIT;
+		}
+		else {
+			visibilityMode = Manual;
+		}
 		VulkanExampleBase::prepare();
 		loadAssets();
 		prepareConditionalRendering();
+		if (occlusion.supported) {
+			prepareOcclusion();
+		}
 		prepareUniformBuffers();
 		setupDescriptorSets();
 		preparePipelines();
@@ -319,6 +725,15 @@ public:
 	{
 		if (!prepared)
 			return;
+		if (benchmark.active && occlusion.supported) {
+			if (benchmarkFrame == 0) {
+				setVisibilityMode(GPUOcclusion);
+			}
+			else if (benchmarkFrame % benchmarkFramesPerMode == 0) {
+				setVisibilityMode((visibilityMode == GPUOcclusion) ? ReadbackOcclusion : GPUOcclusion);
+			}
+			benchmarkFrame++;
+		}
 		draw();
 		if (camera.updated) {
 			updateUniformBuffers();
@@ -330,8 +745,34 @@ public:
 		updateUniformBuffers();
 	}
 
+	virtual void windowResized()
+	{
+		if (occlusion.supported) {
+			prepareDepthPyramid();
+			// The command buffers have been recorded with the old pyramid
+			buildCommandBuffers();
+		}
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
+		if (occlusion.supported && overlay->header("Occlusion")) {
+			int32_t mode = visibilityMode;
+			if (overlay->comboBox("Visibility", &mode, visibilityModeNames)) {
+				setVisibilityMode(mode);
+			}
+			if (visibilityMode != Manual) {
+				overlay->text("Visible nodes: %d / %d", occlusion.visibleNodes, occlusion.meshNodes);
+				overlay->text("Depth age: %d frames", static_cast<int32_t>(occlusion.resultAge));
+				overlay->text("Host readback: %.3f ms", occlusion.hostTime);
+			}
+		}
+		if (overlay->header("GPU times")) {
+			for (auto& result : benchmark.gpuProfiler.results) {
+				overlay->text("%s: %.3f ms", result.first.c_str(), result.second);
+			}
+		}
+
 		if (overlay->header("Visibility")) {
 
 			if (overlay->button("All")) {
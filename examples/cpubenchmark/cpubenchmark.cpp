@@ -0,0 +1,444 @@
+/*
+* Vulkan Example - CPU micro benchmarks of loader and math hot paths
+*
+* Runs the CPU side hot paths of the framework in isolation and reports the time and the number of heap allocations per operation:
+* the stages of loading a glTF file (parsing and uploading), hierarchy updates (Model::updateNodes, Node::getMatrix) and animation updates,
+* frustum tests, heightmap sampling and perlin / fractal noise. The fixtures are fixed (glTF files from the asset pack, synthetic node
+* hierarchies and random data with fixed seeds), so the results of two builds can be compared to measure an optimization without GPU noise
+*
+* No window is created, a device is only needed for uploading the loaded models
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#if defined(_WIN32)
+#pragma comment(linker, "/subsystem:console")
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <atomic>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <new>
+#include <random>
+
+#include <vulkan/vulkan.h>
+#include "VulkanTools.h"
+#include "VulkanDevice.h"
+#include "VulkanglTFModel.h"
+#include "VulkanHeightmap.hpp"
+#include "CommandLineParser.hpp"
+#include "frustum.hpp"
+#include "noise.hpp"
+
+CommandLineParser commandLineParser;
+
+// Heap allocations of the whole process (all threads), the replaced global operator new counts every allocation made through new and the standard containers
+static std::atomic<uint64_t> allocationCount{ 0 };
+
+void* operator new(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	void* p = malloc(size > 0 ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+class VulkanExample
+{
+public:
+	struct Result {
+		std::string name;
+		double nsPerOp;
+		double allocationsPerOp;
+		uint64_t operations;
+	};
+	std::vector<Result> results;
+
+	// Minimum time each benchmark runs for, in seconds
+	double minTime = 0.5;
+	// Only benchmarks whose name contains the filter are run
+	std::string filter;
+	// Number of times each glTF fixture is loaded
+	uint32_t loadIterations = 3;
+
+	VkInstance instance = VK_NULL_HANDLE;
+	vks::VulkanDevice* vulkanDevice = nullptr;
+	VkQueue queue = VK_NULL_HANDLE;
+
+	// Keeps the results of the measured functions alive, so the compiler can't remove the calls
+	volatile float sink = 0.0f;
+
+	bool selected(const std::string& name) const
+	{
+		return filter.empty() || (name.find(filter) != std::string::npos);
+	}
+
+	void addResult(const std::string& name, double seconds, uint64_t allocations, uint64_t operations)
+	{
+		Result result;
+		result.name = name;
+		result.nsPerOp = seconds * 1e9 / static_cast<double>(operations);
+		result.allocationsPerOp = static_cast<double>(allocations) / static_cast<double>(operations);
+		result.operations = operations;
+		results.push_back(result);
+		std::cout << std::left << std::setw(48) << name << std::right << std::fixed
+			<< std::setw(16) << std::setprecision(1) << result.nsPerOp << " ns/op"
+			<< std::setw(12) << std::setprecision(2) << result.allocationsPerOp << " allocs/op"
+			<< std::setw(12) << operations << " ops" << "\n";
+	}
+
+	/*
+		Calls fn until the minimum time has passed, every call performs operationsPerCall operations
+		The first call is a warm up (caches, lazily allocated scratch memory) and isn't measured
+	*/
+	void run(const std::string& name, uint64_t operationsPerCall, const std::function<void()>& fn)
+	{
+		if (!selected(name)) {
+			return;
+		}
+		fn();
+		uint64_t calls = 0;
+		const uint64_t allocationsStart = allocationCount.load();
+		const auto tStart = std::chrono::high_resolution_clock::now();
+		double seconds = 0.0;
+		do {
+			fn();
+			calls++;
+			seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count();
+		} while (seconds < minTime);
+		addResult(name, seconds, allocationCount.load() - allocationsStart, calls * operationsPerCall);
+	}
+
+	// Only a graphics queue for uploads, no window system integration
+	void prepareDevice()
+	{
+		VkApplicationInfo appInfo = {};
+		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+		appInfo.pApplicationName = "Vulkan CPU benchmark";
+		appInfo.pEngineName = "VulkanExample";
+		appInfo.apiVersion = VK_API_VERSION_1_0;
+		VkInstanceCreateInfo instanceCreateInfo = {};
+		instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+		instanceCreateInfo.pApplicationInfo = &appInfo;
+		VK_CHECK_RESULT(vkCreateInstance(&instanceCreateInfo, nullptr, &instance));
+
+		uint32_t deviceCount = 0;
+		VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr));
+		if (deviceCount == 0) {
+			vks::tools::exitFatal("No device with Vulkan support found", -1);
+		}
+		std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
+		VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data()));
+		vulkanDevice = new vks::VulkanDevice(physicalDevices[0]);
+		VK_CHECK_RESULT(vulkanDevice->createLogicalDevice(VkPhysicalDeviceFeatures{}, {}, nullptr, false, VK_QUEUE_GRAPHICS_BIT));
+		vkGetDeviceQueue(vulkanDevice->logicalDevice, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
+		std::cout << "Device: " << vulkanDevice->properties.deviceName << "\n\n";
+	}
+
+	// Parsing (file, images, nodes and primitives) and uploading are measured separately, each load starts with a new model
+	void benchmarkLoading(const std::string& name, const std::string& filename, uint32_t fileLoadingFlags)
+	{
+		const std::string parseName = "gltf " + name + " parse";
+		const std::string uploadName = "gltf " + name + " upload";
+		if (!selected(parseName) && !selected(uploadName)) {
+			return;
+		}
+		if (!vks::tools::fileExists(filename)) {
+			std::cout << std::left << std::setw(48) << ("gltf " + name) << "skipped, " << filename << " not found (asset pack missing?)" << "\n";
+			return;
+		}
+		double parseTime = 0.0, uploadTime = 0.0;
+		uint64_t parseAllocations = 0, uploadAllocations = 0;
+		for (uint32_t i = 0; i < loadIterations; i++) {
+			vkglTF::Model* model = new vkglTF::Model();
+			uint64_t allocationsStart = allocationCount.load();
+			auto tStart = std::chrono::high_resolution_clock::now();
+			model->loadFromFileAsync(filename, vulkanDevice, fileLoadingFlags).wait();
+			parseTime += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count();
+			parseAllocations += allocationCount.load() - allocationsStart;
+			allocationsStart = allocationCount.load();
+			tStart = std::chrono::high_resolution_clock::now();
+			model->finishLoading(queue);
+			uploadTime += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count();
+			uploadAllocations += allocationCount.load() - allocationsStart;
+			delete model;
+		}
+		if (selected(parseName)) {
+			addResult(parseName, parseTime, parseAllocations, loadIterations);
+		}
+		if (selected(uploadName)) {
+			addResult(uploadName, uploadTime, uploadAllocations, loadIterations);
+		}
+	}
+
+	// Full hierarchy passes (all roots dirty) and world matrix lookups of a loaded model, and its animation updates
+	void benchmarkModel(const std::string& name, const std::string& filename, uint32_t fileLoadingFlags)
+	{
+		const std::string prefix = "gltf " + name + " ";
+		if (!selected(prefix + "updateNodes") && !selected(prefix + "getMatrix") && !selected(prefix + "updateAnimation")) {
+			return;
+		}
+		if (!vks::tools::fileExists(filename)) {
+			return;
+		}
+		vkglTF::Model model;
+		model.loadFromFile(filename, vulkanDevice, queue, fileLoadingFlags);
+		benchmarkHierarchy(prefix, model);
+		if (!model.animations.empty()) {
+			float time = 0.0f;
+			const float duration = model.animations[0].end - model.animations[0].start;
+			run(prefix + "updateAnimation", 1, [&]() {
+				time += 1.0f / 60.0f;
+				if (time > duration) {
+					time = 0.0f;
+				}
+				model.updateAnimation(0, time);
+			});
+		}
+	}
+
+	void benchmarkHierarchy(const std::string& prefix, vkglTF::Model& model)
+	{
+		run(prefix + "updateNodes", 1, [&]() {
+			for (vkglTF::Node* node : model.nodes) {
+				node->dirty = true;
+			}
+			model.updateNodes();
+		});
+		run(prefix + "getMatrix", model.linearNodes.size(), [&]() {
+			float sum = 0.0f;
+			for (vkglTF::Node* node : model.linearNodes) {
+				sum += node->getMatrix()[3][0];
+			}
+			sink = sink + sum;
+		});
+	}
+
+	// Adds a node below parent (or a root if there is none) without a mesh
+	static vkglTF::Node* addNode(vkglTF::Model& model, vkglTF::Node* parent, std::default_random_engine& rndEngine)
+	{
+		std::uniform_real_distribution<float> rndDist(-1.0f, 1.0f);
+		vkglTF::Node* node = new vkglTF::Node();
+		node->parent = parent;
+		node->index = static_cast<uint32_t>(model.linearNodes.size());
+		node->matrix = glm::mat4(1.0f);
+		node->mesh = nullptr;
+		node->skin = nullptr;
+		node->translation = glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine));
+		node->rotation = glm::normalize(glm::quat(1.0f, rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine)));
+		if (parent) {
+			parent->children.push_back(node);
+		}
+		else {
+			model.nodes.push_back(node);
+		}
+		model.linearNodes.push_back(node);
+		return node;
+	}
+
+	// A deep chain (worst case for the top-down pass) and a wide tree with a branching factor of four
+	void benchmarkSyntheticHierarchies()
+	{
+		std::default_random_engine rndEngine(0);
+		{
+			vkglTF::Model model;
+			model.device = vulkanDevice;
+			vkglTF::Node* node = nullptr;
+			for (uint32_t i = 0; i < 1024; i++) {
+				node = addNode(model, node, rndEngine);
+			}
+			benchmarkHierarchy("synthetic chain (1024 nodes) ", model);
+		}
+		{
+			vkglTF::Model model;
+			model.device = vulkanDevice;
+			std::vector<vkglTF::Node*> level = { addNode(model, nullptr, rndEngine) };
+			for (uint32_t depth = 1; depth < 7; depth++) {
+				std::vector<vkglTF::Node*> nextLevel;
+				for (vkglTF::Node* parent : level) {
+					for (uint32_t i = 0; i < 4; i++) {
+						nextLevel.push_back(addNode(model, parent, rndEngine));
+					}
+				}
+				level.swap(nextLevel);
+			}
+			benchmarkHierarchy("synthetic tree (" + std::to_string(model.linearNodes.size()) + " nodes) ", model);
+		}
+	}
+
+	// Random spheres and boxes around the camera, about half of them are visible
+	void benchmarkFrustum()
+	{
+		const size_t count = 4096;
+		vks::Frustum frustum;
+		frustum.update(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 256.0f) * glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+		std::default_random_engine rndEngine(0);
+		std::uniform_real_distribution<float> rndPos(-128.0f, 128.0f);
+		std::uniform_real_distribution<float> rndRadius(0.5f, 4.0f);
+		std::vector<float> x(count), y(count), z(count), radius(count);
+		for (size_t i = 0; i < count; i++) {
+			x[i] = rndPos(rndEngine);
+			y[i] = rndPos(rndEngine);
+			z[i] = rndPos(rndEngine);
+			radius[i] = rndRadius(rndEngine);
+		}
+		std::vector<uint32_t> visibility((count + 31) / 32);
+
+		run("frustum checkSphere", count, [&]() {
+			uint32_t visible = 0;
+			for (size_t i = 0; i < count; i++) {
+				visible += frustum.checkSphere(glm::vec3(x[i], y[i], z[i]), radius[i]) ? 1 : 0;
+			}
+			sink = sink + static_cast<float>(visible);
+		});
+		run("frustum checkSpheres", count, [&]() {
+			frustum.checkSpheres(x.data(), y.data(), z.data(), radius.data(), count, visibility.data());
+			sink = sink + static_cast<float>(visibility[0]);
+		});
+	}
+
+	// Random sample positions of the terrain heightmap
+	void benchmarkHeightMap()
+	{
+		if (!selected("heightmap getHeight")) {
+			return;
+		}
+		const std::string filename = getAssetPath() + "textures/terrain_heightmap_r16.ktx";
+		if (!vks::tools::fileExists(filename)) {
+			std::cout << std::left << std::setw(48) << "heightmap getHeight" << "skipped, " << filename << " not found (asset pack missing?)" << "\n";
+			return;
+		}
+		const uint32_t patchSize = 64;
+		vks::HeightMap heightMap(vulkanDevice, queue);
+		heightMap.loadFromFile(filename, patchSize, glm::vec3(2.0f, 1.0f, 2.0f), vks::HeightMap::topologyTriangles);
+		const size_t count = 4096;
+		std::default_random_engine rndEngine(0);
+		std::uniform_int_distribution<uint32_t> rndCoord(0, patchSize - 1);
+		std::vector<glm::uvec2> coords(count);
+		for (auto& coord : coords) {
+			coord = glm::uvec2(rndCoord(rndEngine), rndCoord(rndEngine));
+		}
+		run("heightmap getHeight", count, [&]() {
+			float sum = 0.0f;
+			for (const auto& coord : coords) {
+				sum += heightMap.getHeight(coord.x, coord.y);
+			}
+			sink = sink + sum;
+		});
+	}
+
+	// Samples of a slice through a 3D noise volume, as texture3d generates them
+	void benchmarkNoise()
+	{
+		const uint32_t size = 64;
+		const size_t count = size * size;
+		vks::PerlinNoise<float> perlinNoise(0);
+		vks::FractalNoise<float> fractalNoise(perlinNoise);
+		std::vector<float> x(count), y(count), z(count), result(count);
+		for (uint32_t j = 0; j < size; j++) {
+			for (uint32_t i = 0; i < size; i++) {
+				x[j * size + i] = static_cast<float>(i) / static_cast<float>(size) * 4.0f;
+				y[j * size + i] = static_cast<float>(j) / static_cast<float>(size) * 4.0f;
+				z[j * size + i] = 0.5f;
+			}
+		}
+		run("perlin noise", count, [&]() {
+			float sum = 0.0f;
+			for (size_t i = 0; i < count; i++) {
+				sum += perlinNoise.noise(x[i], y[i], z[i]);
+			}
+			sink = sink + sum;
+		});
+		run("perlin noise batch", count, [&]() {
+			perlinNoise.noise(x.data(), y.data(), z.data(), result.data(), count);
+			sink = sink + result[0];
+		});
+		run("fractal noise", count, [&]() {
+			float sum = 0.0f;
+			for (size_t i = 0; i < count; i++) {
+				sum += fractalNoise.noise(x[i], y[i], z[i]);
+			}
+			sink = sink + sum;
+		});
+		run("fractal noise batch", count, [&]() {
+			fractalNoise.noise(x.data(), y.data(), z.data(), result.data(), count);
+			sink = sink + result[0];
+		});
+	}
+
+	VulkanExample()
+	{
+		minTime = std::max(commandLineParser.getValueAsInt("time", 500), 1) / 1000.0;
+		loadIterations = static_cast<uint32_t>(std::max(commandLineParser.getValueAsInt("loads", loadIterations), 1));
+		filter = commandLineParser.getValueAsString("filter", "");
+
+		prepareDevice();
+
+		const std::string busterDrone = getAssetPath() + "models/buster_drone/busterDrone.gltf";
+		const std::string sponza = getAssetPath() + "models/sponza/sponza.gltf";
+		benchmarkLoading("busterDrone", busterDrone, vkglTF::FileLoadingFlags::None);
+		benchmarkLoading("sponza", sponza, vkglTF::FileLoadingFlags::PreTransformVertices);
+		benchmarkModel("busterDrone", busterDrone, vkglTF::FileLoadingFlags::None);
+		benchmarkSyntheticHierarchies();
+		benchmarkFrustum();
+		benchmarkHeightMap();
+		benchmarkNoise();
+	}
+
+	~VulkanExample()
+	{
+		delete vulkanDevice;
+		vkDestroyInstance(instance, nullptr);
+	}
+};
+
+int main(int argc, char* argv[]) {
+	commandLineParser.add("help", { "--help" }, 0, "Show help");
+	commandLineParser.add("filter", { "-f", "--filter" }, 1, "Only run the benchmarks whose name contains the filter");
+	commandLineParser.add("time", { "-t", "--time" }, 1, "Minimum time per benchmark in milliseconds (default 500)");
+	commandLineParser.add("loads", { "-l", "--loads" }, 1, "Number of times each glTF file is loaded (default 3)");
+	commandLineParser.parse(argc, argv);
+	if (commandLineParser.isSet("help")) {
+		commandLineParser.printHelp();
+		return 0;
+	}
+	VulkanExample *vulkanExample = new VulkanExample();
+	delete(vulkanExample);
+	return 0;
+}
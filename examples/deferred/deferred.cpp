@@ -8,6 +8,9 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanFrameBuffer.hpp"
+#include "VulkanSpecialization.hpp"
+#include "VulkanTemporalAntiAliasing.h"
 
 #define ENABLE_VALIDATION false
 
@@ -18,10 +21,34 @@
 // Offscreen frame buffer properties
 #define FB_DIM TEX_DIM
 
+// Clustered lighting, has to match the composition and light culling shaders
+#define MAX_LIGHTS 1024
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 128
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	int32_t debugDisplayTarget = 0;
+	// Bin the lights into view space clusters with a compute pass, so the composition only shades the lights that can reach each pixel
+	bool clusteredLighting = true;
+	int32_t lightCount = 256;
+	// Lowered by the performance governor, each step below the highest quality halves the number of lights shaded
+	uint32_t qualityLevel = vks::PerformanceGovernor::maxQuality;
+	// Reconstruct positions from depth and store octahedral encoded normals in two 16 bit channels, which halves the G-Buffer size
+	bool packedGBuffer = false;
+	// Render the G-Buffer and the composition as subpasses of a single render pass, so on tile based GPUs the G-Buffer never leaves tile memory
+	bool singleRenderPass = false;
+	// Render the scene with a sub-pixel jitter that changes every frame and resolve the composition against the reprojected previous frames,
+	// which anti-aliases the deferred path without multisampled G-Buffer attachments (separate render pass path only)
+	bool temporalAntiAliasing = false;
+	std::unique_ptr<vks::TemporalAntiAliasing> taa;
+	vks::TemporalAntiAliasing::Settings taaSettings;
+	uint32_t taaFrame = 0;
+	// Discard the history with the next frame, e.g. after switching anti-aliasing on
+	bool taaReset = true;
 
 	struct {
 		struct {
@@ -44,18 +71,44 @@ public:
 		glm::mat4 model;
 		glm::mat4 view;
 		glm::vec4 instancePos[3];
+		// Unjittered view projections of the current and the previous frame for the velocity output
+		glm::mat4 viewProjection = glm::mat4(1.0f);
+		glm::mat4 prevViewProjection = glm::mat4(1.0f);
 	} uboOffscreenVS;
 
 	struct Light {
+		// xyz: position, w: range
 		glm::vec4 position;
 		glm::vec3 color;
 		float radius;
+		// xyz: spot direction, w: cosine of the cone angle (-2 for point lights)
+		glm::vec4 direction;
+	};
+	std::vector<Light> lights;
+
+	// Circular path of the generated lights
+	struct LightPath {
+		glm::vec3 center;
+		float radius;
+		float speed;
+		float phase;
 	};
+	std::vector<LightPath> lightPaths;
 
+	// Shared by the composition and the light culling shaders
 	struct {
-		Light lights[6];
+		glm::mat4 view;
+		glm::mat4 invProjection;
+		glm::mat4 invViewProjection;
 		glm::vec4 viewPos;
 		int debugDisplayTarget = 0;
+		int lightCount = 0;
+		// Rendered region of the G-Buffer
+		alignas(8) glm::vec2 uvScale = glm::vec2(1.0f);
+		alignas(8) glm::ivec2 renderExtent = glm::ivec2(0);
+		int clustered = 0;
+		float zNear;
+		float zFar;
 	} uboComposition;
 
 	struct {
@@ -63,12 +116,32 @@ public:
 		vks::Buffer composition;
 	} uniformBuffers;
 
+	struct {
+		// Lights, written by the host every frame
+		vks::Buffer lights;
+		// Light count and MAX_LIGHTS_PER_CLUSTER light indices per cluster
+		vks::Buffer clusters;
+	} storageBuffers;
+
 	struct {
 		VkPipeline offscreen;
 		VkPipeline composition;
+		VkPipeline lightCulling;
+		// Single render pass path
+		VkPipeline mergedOffscreen;
+		VkPipeline mergedComposition;
+		// Temporal anti-aliasing path: composition to the window sized color target, and presenting the resolved image
+		VkPipeline compositionTAA;
+		VkPipeline present;
 	} pipelines;
 	VkPipelineLayout pipelineLayout;
 
+	struct {
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+	} lightCulling;
+
 	struct {
 		VkDescriptorSet model;
 		VkDescriptorSet floor;
@@ -79,23 +152,52 @@ public:
 
 	// Framebuffer for offscreen rendering
 	struct FrameBufferAttachment {
-		VkImage image;
-		VkDeviceMemory mem;
-		VkImageView view;
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory mem = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
 		VkFormat format;
+		vks::ImageCompression compression;
 	};
 	struct FrameBuffer {
 		int32_t width, height;
 		VkFramebuffer frameBuffer;
 		FrameBufferAttachment position, normal, albedo;
+		// Screen space motion since the previous frame, read by the temporal anti-aliasing resolve
+		FrameBufferAttachment velocity;
 		FrameBufferAttachment depth;
+		// Depth aspect only view for sampling the depth attachment in the light culling and (packed G-Buffer) composition shaders
+		VkImageView depthSampleView;
 		VkRenderPass renderPass;
 	} offScreenFrameBuf;
 
 	// One sampler for the frame buffer color attachments
 	VkSampler colorSampler;
 
-	VkCommandBuffer offScreenCmdBuffer = VK_NULL_HANDLE;
+	// Window sized G-Buffer of the single render pass path, the attachments are transient and only read as input attachments of the composition subpass
+	struct {
+		int32_t width, height;
+		FrameBufferAttachment position, normal, albedo;
+		FrameBufferAttachment depth;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		// One per swap chain image
+		std::vector<VkFramebuffer> frameBuffers;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout;
+	} merged;
+
+	// Window sized target of the composition that is resolved with temporal anti-aliasing, and the descriptors for presenting the result
+	struct {
+		FrameBufferAttachment color;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFramebuffer frameBuffer = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout;
+	} taaTarget;
+
+	// One per swap chain image, so the G-Buffer pass is timed in the same GPU profiler slot as the composition pass
+	std::vector<VkCommandBuffer> offScreenCmdBuffers;
 
 	// Semaphore used to synchronize between offscreen and final scene rendering
 	VkSemaphore offscreenSemaphore = VK_NULL_HANDLE;
@@ -111,6 +213,9 @@ public:
 		camera.position = { 2.15f, 0.3f, -8.75f };
 		camera.setRotation(glm::vec3(-0.75f, 12.5f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+		commandLineParser.add("taa", { "-taa", "--temporalaa" }, 0, "Enable temporal anti-aliasing");
+		commandLineParser.parse(args);
+		temporalAntiAliasing = commandLineParser.isSet("taa");
 	}
 
 	~VulkanExample()
@@ -118,42 +223,36 @@ public:
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
 
-		vkDestroySampler(device, colorSampler, nullptr);
-
-		// Frame buffer
-
-		// Color attachments
-		vkDestroyImageView(device, offScreenFrameBuf.position.view, nullptr);
-		vkDestroyImage(device, offScreenFrameBuf.position.image, nullptr);
-		vkFreeMemory(device, offScreenFrameBuf.position.mem, nullptr);
-
-		vkDestroyImageView(device, offScreenFrameBuf.normal.view, nullptr);
-		vkDestroyImage(device, offScreenFrameBuf.normal.image, nullptr);
-		vkFreeMemory(device, offScreenFrameBuf.normal.mem, nullptr);
-
-		vkDestroyImageView(device, offScreenFrameBuf.albedo.view, nullptr);
-		vkDestroyImage(device, offScreenFrameBuf.albedo.image, nullptr);
-		vkFreeMemory(device, offScreenFrameBuf.albedo.mem, nullptr);
-
-		// Depth attachment
-		vkDestroyImageView(device, offScreenFrameBuf.depth.view, nullptr);
-		vkDestroyImage(device, offScreenFrameBuf.depth.image, nullptr);
-		vkFreeMemory(device, offScreenFrameBuf.depth.mem, nullptr);
-
-		vkDestroyFramebuffer(device, offScreenFrameBuf.frameBuffer, nullptr);
+		destroyOffscreenFramebuffer();
+		destroyMergedAttachments();
+		vkDestroyRenderPass(device, merged.renderPass, nullptr);
+		destroyTemporalAntiAliasingTarget();
+		vkDestroyRenderPass(device, taaTarget.renderPass, nullptr);
 
 		vkDestroyPipeline(device, pipelines.composition, nullptr);
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
+		vkDestroyPipeline(device, pipelines.lightCulling, nullptr);
+		vkDestroyPipeline(device, pipelines.mergedOffscreen, nullptr);
+		vkDestroyPipeline(device, pipelines.mergedComposition, nullptr);
+		vkDestroyPipeline(device, pipelines.compositionTAA, nullptr);
+		vkDestroyPipeline(device, pipelines.present, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, lightCulling.pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, merged.pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, taaTarget.pipelineLayout, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, lightCulling.descriptorSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, merged.descriptorSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, taaTarget.descriptorSetLayout, nullptr);
 
 		// Uniform buffers
 		uniformBuffers.offscreen.destroy();
 		uniformBuffers.composition.destroy();
 
-		vkDestroyRenderPass(device, offScreenFrameBuf.renderPass, nullptr);
+		storageBuffers.lights.destroy();
+		storageBuffers.clusters.destroy();
 
 		textures.model.colorMap.destroy();
 		textures.model.normalMap.destroy();
@@ -161,6 +260,7 @@ public:
 		textures.floor.normalMap.destroy();
 
 		vkDestroySemaphore(device, offscreenSemaphore, nullptr);
+		vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(offScreenCmdBuffers.size()), offScreenCmdBuffers.data());
 	}
 
 	// Enable physical device features required for this example
@@ -172,11 +272,12 @@ public:
 		}
 	};
 
-	// Create a frame buffer attachment
+	// Create a frame buffer attachment, requesting the given framebuffer compression if image compression control is enabled
 	void createAttachment(
 		VkFormat format,
 		VkImageUsageFlagBits usage,
-		FrameBufferAttachment *attachment)
+		FrameBufferAttachment *attachment,
+		VkImageCompressionFlagsEXT compression)
 	{
 		VkImageAspectFlags aspectMask = 0;
 		VkImageLayout imageLayout;
@@ -213,7 +314,7 @@ public:
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
 
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment->image));
+		VK_CHECK_RESULT(vks::createAttachmentImage(vulkanDevice, image, compression, &attachment->image, &attachment->compression));
 		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
 		memAlloc.allocationSize = memReqs.size;
 		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
@@ -239,25 +340,43 @@ public:
 		offScreenFrameBuf.width = FB_DIM;
 		offScreenFrameBuf.height = FB_DIM;
 
+		// The scene is rendered to the part of the G-Buffer that matches the window's aspect ratio and the (dynamic) render scale
+		renderResolution.maxExtent = { FB_DIM, FB_DIM };
+		renderResolution.attachmentExtent = { FB_DIM, FB_DIM };
+		updateRenderResolution();
+
 		// Color attachments
 
-		// (World space) Positions
+		// (World space) Normals, octahedral encoded for the packed G-Buffer
 		createAttachment(
-			VK_FORMAT_R16G16B16A16_SFLOAT,
+			packedGBuffer ? vks::tools::getSupportedColorAttachmentFormat(physicalDevice, { VK_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16_SFLOAT }) : VK_FORMAT_R16G16B16A16_SFLOAT,
 			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-			&offScreenFrameBuf.position);
+			&offScreenFrameBuf.normal,
+			vks::getLosslessCompression(settings.imageCompression));
 
-		// (World space) Normals
+		// Albedo (color), the only target that may use lossy fixed-rate compression as positions and lighting vectors aren't derived from it
 		createAttachment(
-			VK_FORMAT_R16G16B16A16_SFLOAT,
+			VK_FORMAT_R8G8B8A8_UNORM,
 			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-			&offScreenFrameBuf.normal);
+			&offScreenFrameBuf.albedo,
+			settings.imageCompression);
+
+		// (World space) Positions, the packed G-Buffer reconstructs them from depth
+		if (!packedGBuffer)
+		{
+			createAttachment(
+				VK_FORMAT_R16G16B16A16_SFLOAT,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+				&offScreenFrameBuf.position,
+				vks::getLosslessCompression(settings.imageCompression));
+		}
 
-		// Albedo (color)
+		// Velocity in texture coordinates
 		createAttachment(
-			VK_FORMAT_R8G8B8A8_UNORM,
+			VK_FORMAT_R16G16_SFLOAT,
 			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-			&offScreenFrameBuf.albedo);
+			&offScreenFrameBuf.velocity,
+			vks::getLosslessCompression(settings.imageCompression));
 
 		// Depth attachment
 
@@ -269,44 +388,55 @@ public:
 		createAttachment(
 			attDepthFormat,
 			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-			&offScreenFrameBuf.depth);
+			&offScreenFrameBuf.depth,
+			vks::getLosslessCompression(settings.imageCompression));
 
 		// Set up separate renderpass with references to the color and depth attachments
-		std::array<VkAttachmentDescription, 4> attachmentDescs = {};
+		std::vector<FrameBufferAttachment*> colorAttachments = { &offScreenFrameBuf.normal, &offScreenFrameBuf.albedo };
+		if (!packedGBuffer)
+		{
+			colorAttachments.push_back(&offScreenFrameBuf.position);
+		}
+		colorAttachments.push_back(&offScreenFrameBuf.velocity);
+		const uint32_t colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size());
+		std::vector<VkAttachmentDescription> attachmentDescs(colorAttachmentCount + 1);
+		std::vector<VkImageView> attachments(colorAttachmentCount + 1);
 
 		// Init attachment properties
-		for (uint32_t i = 0; i < 4; ++i)
+		for (uint32_t i = 0; i <= colorAttachmentCount; ++i)
 		{
 			attachmentDescs[i].samples = VK_SAMPLE_COUNT_1_BIT;
 			attachmentDescs[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 			attachmentDescs[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 			attachmentDescs[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 			attachmentDescs[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			if (i == 3)
+			if (i == colorAttachmentCount)
 			{
+				// Read by the light culling shader
 				attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-				attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+				attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+				attachmentDescs[i].format = offScreenFrameBuf.depth.format;
+				attachments[i] = offScreenFrameBuf.depth.view;
 			}
 			else
 			{
 				attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 				attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				attachmentDescs[i].format = colorAttachments[i]->format;
+				attachments[i] = colorAttachments[i]->view;
 			}
 		}
 
-		// Formats
-		attachmentDescs[0].format = offScreenFrameBuf.position.format;
-		attachmentDescs[1].format = offScreenFrameBuf.normal.format;
-		attachmentDescs[2].format = offScreenFrameBuf.albedo.format;
-		attachmentDescs[3].format = offScreenFrameBuf.depth.format;
-
-		std::vector<VkAttachmentReference> colorReferences;
-		colorReferences.push_back({ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-		colorReferences.push_back({ 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-		colorReferences.push_back({ 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+		// Fragment shader outputs: 0 = normals, 1 = albedo, 2 = positions (unused for the packed G-Buffer), 3 = velocity
+		std::vector<VkAttachmentReference> colorReferences = {
+			{ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+			{ 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+			{ packedGBuffer ? VK_ATTACHMENT_UNUSED : 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+			{ colorAttachmentCount - 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+		};
 
 		VkAttachmentReference depthReference = {};
-		depthReference.attachment = 3;
+		depthReference.attachment = colorAttachmentCount;
 		depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 		VkSubpassDescription subpass = {};
@@ -326,12 +456,13 @@ public:
 		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
+		// Also makes the depth writes visible to the light culling and composition shaders, and the velocity to the temporal anti-aliasing resolve
 		dependencies[1].srcSubpass = 0;
 		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
 		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 		VkRenderPassCreateInfo renderPassInfo = {};
@@ -345,12 +476,6 @@ public:
 
 		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &offScreenFrameBuf.renderPass));
 
-		std::array<VkImageView,4> attachments;
-		attachments[0] = offScreenFrameBuf.position.view;
-		attachments[1] = offScreenFrameBuf.normal.view;
-		attachments[2] = offScreenFrameBuf.albedo.view;
-		attachments[3] = offScreenFrameBuf.depth.view;
-
 		VkFramebufferCreateInfo fbufCreateInfo = {};
 		fbufCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 		fbufCreateInfo.pNext = NULL;
@@ -362,6 +487,14 @@ public:
 		fbufCreateInfo.layers = 1;
 		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offScreenFrameBuf.frameBuffer));
 
+		// Views of combined depth stencil images can only be sampled with a single aspect
+		VkImageViewCreateInfo depthViewCI = vks::initializers::imageViewCreateInfo();
+		depthViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		depthViewCI.format = offScreenFrameBuf.depth.format;
+		depthViewCI.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+		depthViewCI.image = offScreenFrameBuf.depth.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &depthViewCI, nullptr, &offScreenFrameBuf.depthSampleView));
+
 		// Create sampler to sample from the color attachments
 		VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
 		sampler.magFilter = VK_FILTER_NEAREST;
@@ -378,59 +511,540 @@ public:
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &colorSampler));
 	}
 
-	// Build command buffer for rendering the scene to the offscreen frame buffer attachments
-	void buildDeferredCommandBuffer()
+	void destroyOffscreenFramebuffer()
 	{
-		if (offScreenCmdBuffer == VK_NULL_HANDLE)
+		vkDestroySampler(device, colorSampler, nullptr);
+
+		// Color attachments, the packed G-Buffer has no position attachment
+		vkDestroyImageView(device, offScreenFrameBuf.position.view, nullptr);
+		vkDestroyImage(device, offScreenFrameBuf.position.image, nullptr);
+		vkFreeMemory(device, offScreenFrameBuf.position.mem, nullptr);
+		offScreenFrameBuf.position = {};
+
+		vkDestroyImageView(device, offScreenFrameBuf.normal.view, nullptr);
+		vkDestroyImage(device, offScreenFrameBuf.normal.image, nullptr);
+		vkFreeMemory(device, offScreenFrameBuf.normal.mem, nullptr);
+
+		vkDestroyImageView(device, offScreenFrameBuf.albedo.view, nullptr);
+		vkDestroyImage(device, offScreenFrameBuf.albedo.image, nullptr);
+		vkFreeMemory(device, offScreenFrameBuf.albedo.mem, nullptr);
+
+		vkDestroyImageView(device, offScreenFrameBuf.velocity.view, nullptr);
+		vkDestroyImage(device, offScreenFrameBuf.velocity.image, nullptr);
+		vkFreeMemory(device, offScreenFrameBuf.velocity.mem, nullptr);
+
+		// Depth attachment
+		vkDestroyImageView(device, offScreenFrameBuf.depth.view, nullptr);
+		vkDestroyImageView(device, offScreenFrameBuf.depthSampleView, nullptr);
+		vkDestroyImage(device, offScreenFrameBuf.depth.image, nullptr);
+		vkFreeMemory(device, offScreenFrameBuf.depth.mem, nullptr);
+
+		vkDestroyFramebuffer(device, offScreenFrameBuf.frameBuffer, nullptr);
+		vkDestroyRenderPass(device, offScreenFrameBuf.renderPass, nullptr);
+	}
+
+	// Create a window sized attachment for the single render pass path
+	void createTransientAttachment(
+		VkFormat format,
+		VkImageUsageFlags usage,
+		VkImageAspectFlags aspectMask,
+		FrameBufferAttachment *attachment)
+	{
+		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+		image.imageType = VK_IMAGE_TYPE_2D;
+		image.format = format;
+		image.extent.width = merged.width;
+		image.extent.height = merged.height;
+		image.extent.depth = 1;
+		image.mipLevels = 1;
+		image.arrayLayers = 1;
+		image.samples = VK_SAMPLE_COUNT_1_BIT;
+		image.tiling = VK_IMAGE_TILING_OPTIMAL;
+		// Only accessed within the render pass, so the contents never have to be written to memory
+		image.usage = usage | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
+
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment->image));
+		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		// Tile based GPUs may never back lazily allocated memory with actual memory
+		VkBool32 lazyMemTypePresent;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, &lazyMemTypePresent);
+		if (!lazyMemTypePresent)
+		{
+			// If this is not available, fall back to device local memory
+			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->mem, 0));
+
+		VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
+		imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageView.format = format;
+		imageView.subresourceRange = { aspectMask, 0, 1, 0, 1 };
+		imageView.image = attachment->image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &attachment->view));
+	}
+
+	// Set up the render pass of the single render pass path with a G-Buffer and a composition subpass
+	void prepareMergedRenderPass()
+	{
+		merged.normal.format = packedGBuffer ? vks::tools::getSupportedColorAttachmentFormat(physicalDevice, { VK_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16_SFLOAT }) : VK_FORMAT_R16G16B16A16_SFLOAT;
+		merged.albedo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		merged.position.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		// Depth only format, so the packed G-Buffer can read depth as an input attachment through the attachment's view
+		merged.depth.format = VK_FORMAT_D16_UNORM;
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_D32_SFLOAT, &formatProperties);
+		if (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
 		{
-			offScreenCmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+			merged.depth.format = VK_FORMAT_D32_SFLOAT;
 		}
 
-		// Create a semaphore used to synchronize offscreen rendering and usage
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &offscreenSemaphore));
+		// Attachments: 0 = swap chain image, 1 = normals, 2 = albedo, 3 = positions (not used by the packed G-Buffer), last = depth
+		std::vector<VkFormat> gBufferFormats = { merged.normal.format, merged.albedo.format };
+		if (!packedGBuffer)
+		{
+			gBufferFormats.push_back(merged.position.format);
+		}
+		const uint32_t colorAttachmentCount = static_cast<uint32_t>(gBufferFormats.size());
+		const uint32_t depthAttachment = colorAttachmentCount + 1;
+		std::vector<VkAttachmentDescription> attachmentDescs(colorAttachmentCount + 2);
+
+		attachmentDescs[0].format = swapChain.colorFormat;
+		attachmentDescs[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachmentDescs[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachmentDescs[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachmentDescs[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachmentDescs[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachmentDescs[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachmentDescs[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+		// The G-Buffer is cleared and discarded within the render pass
+		for (uint32_t i = 1; i <= depthAttachment; ++i)
+		{
+			attachmentDescs[i].samples = VK_SAMPLE_COUNT_1_BIT;
+			attachmentDescs[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachmentDescs[i].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachmentDescs[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachmentDescs[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			if (i == depthAttachment)
+			{
+				attachmentDescs[i].format = merged.depth.format;
+				attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+			}
+			else
+			{
+				attachmentDescs[i].format = gBufferFormats[i - 1];
+				attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			}
+		}
+
+		std::array<VkSubpassDescription, 2> subpassDescriptions{};
+
+		// First subpass: Fill the G-Buffer, fragment shader outputs are the same as for the separate G-Buffer pass
+		std::vector<VkAttachmentReference> colorReferences;
+		for (uint32_t i = 1; i <= colorAttachmentCount; ++i)
+		{
+			colorReferences.push_back({ i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+		}
+		VkAttachmentReference depthReference = { depthAttachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		subpassDescriptions[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescriptions[0].colorAttachmentCount = colorAttachmentCount;
+		subpassDescriptions[0].pColorAttachments = colorReferences.data();
+		subpassDescriptions[0].pDepthStencilAttachment = &depthReference;
+
+		// Second subpass: Composition (and UI) reading the G-Buffer as input attachments
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		// Input attachments: 0 = positions (depth for the packed G-Buffer), 1 = normals, 2 = albedo
+		std::array<VkAttachmentReference, 3> inputReferences;
+		inputReferences[0] = packedGBuffer ? VkAttachmentReference{ depthAttachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL } : VkAttachmentReference{ 3, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		inputReferences[1] = { 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		inputReferences[2] = { 2, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+		subpassDescriptions[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescriptions[1].colorAttachmentCount = 1;
+		subpassDescriptions[1].pColorAttachments = &colorReference;
+		subpassDescriptions[1].inputAttachmentCount = static_cast<uint32_t>(inputReferences.size());
+		subpassDescriptions[1].pInputAttachments = inputReferences.data();
+
+		std::array<VkSubpassDependency, 3> dependencies;
+
+		// The G-Buffer attachments are shared by all frames, so the previous frame's G-Buffer subpass has to be done with them
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		// The composition only reads the G-Buffer texels of its own pixel, so the dependency is by region and stays in tile memory
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = 1;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		dependencies[2].srcSubpass = 1;
+		dependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[2].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[2].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescs.size());
+		renderPassInfo.pAttachments = attachmentDescs.data();
+		renderPassInfo.subpassCount = static_cast<uint32_t>(subpassDescriptions.size());
+		renderPassInfo.pSubpasses = subpassDescriptions.data();
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &merged.renderPass));
+	}
+
+	// Create the window sized G-Buffer of the single render pass path and the frame buffers for all swap chain images
+	void createMergedAttachments()
+	{
+		merged.width = width;
+		merged.height = height;
+
+		createTransientAttachment(merged.normal.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, &merged.normal);
+		createTransientAttachment(merged.albedo.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, &merged.albedo);
+		if (!packedGBuffer)
+		{
+			createTransientAttachment(merged.position.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, &merged.position);
+		}
+		createTransientAttachment(merged.depth.format, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, &merged.depth);
+
+		std::vector<VkImageView> attachments = { VK_NULL_HANDLE, merged.normal.view, merged.albedo.view };
+		if (!packedGBuffer)
+		{
+			attachments.push_back(merged.position.view);
+		}
+		attachments.push_back(merged.depth.view);
+
+		VkFramebufferCreateInfo frameBufferCreateInfo = vks::initializers::framebufferCreateInfo();
+		frameBufferCreateInfo.renderPass = merged.renderPass;
+		frameBufferCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		frameBufferCreateInfo.pAttachments = attachments.data();
+		frameBufferCreateInfo.width = merged.width;
+		frameBufferCreateInfo.height = merged.height;
+		frameBufferCreateInfo.layers = 1;
+
+		merged.frameBuffers.resize(swapChain.imageCount);
+		for (uint32_t i = 0; i < merged.frameBuffers.size(); i++)
+		{
+			attachments[0] = swapChain.buffers[i].view;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &merged.frameBuffers[i]));
+		}
+	}
+
+	void destroyMergedAttachments()
+	{
+		for (auto& frameBuffer : merged.frameBuffers)
+		{
+			vkDestroyFramebuffer(device, frameBuffer, nullptr);
+		}
+		merged.frameBuffers.clear();
+		for (FrameBufferAttachment* attachment : { &merged.position, &merged.normal, &merged.albedo, &merged.depth })
+		{
+			vkDestroyImageView(device, attachment->view, nullptr);
+			vkDestroyImage(device, attachment->image, nullptr);
+			vkFreeMemory(device, attachment->mem, nullptr);
+			attachment->view = VK_NULL_HANDLE;
+			attachment->image = VK_NULL_HANDLE;
+			attachment->mem = VK_NULL_HANDLE;
+		}
+	}
+
+	// Set up the render pass of the composition target that is resolved with temporal anti-aliasing
+	void prepareTemporalAntiAliasingRenderPass()
+	{
+		VkAttachmentDescription attachmentDesc{};
+		attachmentDesc.format = vks::TemporalAntiAliasing::format;
+		attachmentDesc.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachmentDesc.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachmentDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachmentDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachmentDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachmentDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		// Read by the resolve compute shader
+		attachmentDesc.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorReference;
+
+		std::array<VkSubpassDependency, 2> dependencies;
+
+		// The previous frame's resolve has to be done reading the target
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = 0;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[1].dependencyFlags = 0;
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = 1;
+		renderPassInfo.pAttachments = &attachmentDesc;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &taaTarget.renderPass));
+	}
+
+	// Create the window sized composition target and the temporal anti-aliasing images for it, the history starts empty
+	void createTemporalAntiAliasingTarget()
+	{
+		taaTarget.color.format = vks::TemporalAntiAliasing::format;
+
+		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+		image.imageType = VK_IMAGE_TYPE_2D;
+		image.format = taaTarget.color.format;
+		image.extent = { width, height, 1 };
+		image.mipLevels = 1;
+		image.arrayLayers = 1;
+		image.samples = VK_SAMPLE_COUNT_1_BIT;
+		image.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &taaTarget.color.image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, taaTarget.color.image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &taaTarget.color.mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, taaTarget.color.image, taaTarget.color.mem, 0));
+
+		VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
+		imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageView.format = taaTarget.color.format;
+		imageView.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		imageView.image = taaTarget.color.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &taaTarget.color.view));
+
+		VkFramebufferCreateInfo frameBufferCreateInfo = vks::initializers::framebufferCreateInfo();
+		frameBufferCreateInfo.renderPass = taaTarget.renderPass;
+		frameBufferCreateInfo.attachmentCount = 1;
+		frameBufferCreateInfo.pAttachments = &taaTarget.color.view;
+		frameBufferCreateInfo.width = width;
+		frameBufferCreateInfo.height = height;
+		frameBufferCreateInfo.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &taaTarget.frameBuffer));
+
+		// The velocity covers the same part of the G-Buffer as the other attachments, see updateTemporalAntiAliasing()
+		const VkDescriptorImageInfo colorDescriptor = vks::initializers::descriptorImageInfo(colorSampler, taaTarget.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		const VkDescriptorImageInfo velocityDescriptor = vks::initializers::descriptorImageInfo(colorSampler, offScreenFrameBuf.velocity.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		taa->create(width, height, colorDescriptor, velocityDescriptor, queue);
+		if (taa->isSupported())
+		{
+			VkDescriptorImageInfo outputDescriptor = taa->getOutputDescriptor();
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(taaTarget.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &outputDescriptor);
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		}
+	}
+
+	void destroyTemporalAntiAliasingTarget()
+	{
+		vkDestroyFramebuffer(device, taaTarget.frameBuffer, nullptr);
+		vkDestroyImageView(device, taaTarget.color.view, nullptr);
+		vkDestroyImage(device, taaTarget.color.image, nullptr);
+		vkFreeMemory(device, taaTarget.color.mem, nullptr);
+		taaTarget.frameBuffer = VK_NULL_HANDLE;
+		taaTarget.color = {};
+	}
+
+	// Temporal anti-aliasing replaces the direct composition to the swap chain image in the separate render pass path
+	bool temporalAntiAliasingActive() const
+	{
+		return temporalAntiAliasing && !singleRenderPass && taa && taa->isSupported();
+	}
+
+	// The window sized G-Buffer of the single render pass path and the anti-aliased composition target are recreated along with the swap chain frame buffers
+	void setupFrameBuffer()
+	{
+		VulkanExampleBase::setupFrameBuffer();
+		if (merged.renderPass != VK_NULL_HANDLE)
+		{
+			destroyMergedAttachments();
+			createMergedAttachments();
+			updateMergedDescriptorSet();
+		}
+		if (taaTarget.renderPass != VK_NULL_HANDLE)
+		{
+			destroyTemporalAntiAliasingTarget();
+			createTemporalAntiAliasingTarget();
+		}
+	}
+
+	// The UI is drawn in the composition subpass of the single render pass path, so its pipeline has to match the render pass in use
+	void updateOverlayPipeline()
+	{
+		if (!settings.overlay || settings.overlayPass)
+		{
+			return;
+		}
+		vkDestroyPipeline(device, UIOverlay.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, UIOverlay.pipelineLayout, nullptr);
+		UIOverlay.subpass = singleRenderPass ? 1 : 0;
+		UIOverlay.preparePipeline(pipelineCache, singleRenderPass ? merged.renderPass : renderPass, swapChain.colorFormat, depthFormat);
+	}
+
+	// Recreate the G-Buffer and everything depending on its layout after switching between the full and the packed G-Buffer
+	void rebuildGBuffer()
+	{
+		vkDeviceWaitIdle(device);
+		destroyOffscreenFramebuffer();
+		prepareOffscreenFramebuffer();
+		destroyMergedAttachments();
+		vkDestroyRenderPass(device, merged.renderPass, nullptr);
+		prepareMergedRenderPass();
+		createMergedAttachments();
+		vkDestroyPipeline(device, pipelines.composition, nullptr);
+		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
+		vkDestroyPipeline(device, pipelines.lightCulling, nullptr);
+		vkDestroyPipeline(device, pipelines.mergedOffscreen, nullptr);
+		vkDestroyPipeline(device, pipelines.mergedComposition, nullptr);
+		vkDestroyPipeline(device, pipelines.compositionTAA, nullptr);
+		vkDestroyPipeline(device, pipelines.present, nullptr);
+		preparePipelines();
+		if (singleRenderPass)
+		{
+			updateOverlayPipeline();
+		}
+		vkResetDescriptorPool(device, descriptorPool, 0);
+		setupDescriptorSet();
+		// The resolve reads the new velocity attachment
+		destroyTemporalAntiAliasingTarget();
+		createTemporalAntiAliasingTarget();
+		buildCommandBuffers();
+	}
+
+	// (Re)allocate the offscreen command buffers if the number of swap chain images changed
+	void createDeferredCommandBuffers()
+	{
+		if (offScreenCmdBuffers.size() == drawCmdBuffers.size())
+		{
+			return;
+		}
+		if (!offScreenCmdBuffers.empty())
+		{
+			vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(offScreenCmdBuffers.size()), offScreenCmdBuffers.data());
+		}
+		offScreenCmdBuffers.resize(drawCmdBuffers.size());
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(offScreenCmdBuffers.size()));
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, offScreenCmdBuffers.data()));
+	}
+
+	// Draw the scene with the bound G-Buffer pipeline
+	void drawScene(VkCommandBuffer cmdBuffer)
+	{
+		// Background
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.floor, 0, nullptr);
+		models.floor.draw(cmdBuffer);
+
+		// Instanced object
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.model, 0, nullptr);
+		models.model.bindBuffers(cmdBuffer);
+		vkCmdDrawIndexed(cmdBuffer, models.model.indices.count, 3, 0, 0, 0);
+	}
+
+	// Build command buffers for rendering the scene to the offscreen frame buffer attachments
+	void buildDeferredCommandBuffer()
+	{
+		createDeferredCommandBuffers();
 
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-		// Clear values for all attachments written in the fragment shader
-		std::array<VkClearValue,4> clearValues;
-		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-		clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-		clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-		clearValues[3].depthStencil = { 1.0f, 0 };
+		// Clear values for all attachments written in the fragment shader, depth is the last attachment
+		std::vector<VkClearValue> clearValues(packedGBuffer ? 4 : 5);
+		for (auto& clearValue : clearValues)
+		{
+			clearValue.color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		}
+		clearValues.back().depthStencil = { 1.0f, 0 };
 
 		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
 		renderPassBeginInfo.renderPass =  offScreenFrameBuf.renderPass;
 		renderPassBeginInfo.framebuffer = offScreenFrameBuf.frameBuffer;
-		renderPassBeginInfo.renderArea.extent.width = offScreenFrameBuf.width;
-		renderPassBeginInfo.renderArea.extent.height = offScreenFrameBuf.height;
+		renderPassBeginInfo.renderArea.extent = renderResolution.renderExtent;
 		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassBeginInfo.pClearValues = clearValues.data();
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(offScreenCmdBuffer, &cmdBufInfo));
+		for (uint32_t i = 0; i < offScreenCmdBuffers.size(); i++)
+		{
+			VkCommandBuffer cmdBuffer = offScreenCmdBuffers[i];
+			VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
 
-		vkCmdBeginRenderPass(offScreenCmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			// The G-Buffer pass is submitted first, so it resets the image's profiler queries
+			benchmark.gpuProfiler.reset(cmdBuffer, i);
+			benchmark.gpuProfiler.beginScope(cmdBuffer, i, "G-Buffer");
 
-		VkViewport viewport = vks::initializers::viewport((float)offScreenFrameBuf.width, (float)offScreenFrameBuf.height, 0.0f, 1.0f);
-		vkCmdSetViewport(offScreenCmdBuffer, 0, 1, &viewport);
+			vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-		VkRect2D scissor = vks::initializers::rect2D(offScreenFrameBuf.width, offScreenFrameBuf.height, 0, 0);
-		vkCmdSetScissor(offScreenCmdBuffer, 0, 1, &scissor);
+			VkViewport viewport = vks::initializers::viewport((float)renderResolution.renderExtent.width, (float)renderResolution.renderExtent.height, 0.0f, 1.0f);
+			vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 
-		vkCmdBindPipeline(offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
+			VkRect2D scissor = vks::initializers::rect2D(renderResolution.renderExtent.width, renderResolution.renderExtent.height, 0, 0);
+			vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-		// Background
-		vkCmdBindDescriptorSets(offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.floor, 0, nullptr);
-		models.floor.draw(offScreenCmdBuffer);
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
+			drawScene(cmdBuffer);
 
-		// Instanced object
-		vkCmdBindDescriptorSets(offScreenCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.model, 0, nullptr);
-		models.model.bindBuffers(offScreenCmdBuffer);
-		vkCmdDrawIndexed(offScreenCmdBuffer, models.model.indices.count, 3, 0, 0, 0);
+			vkCmdEndRenderPass(cmdBuffer);
+
+			benchmark.gpuProfiler.endScope(cmdBuffer, i);
 
-		vkCmdEndRenderPass(offScreenCmdBuffer);
+			if (clusteredLighting)
+			{
+				// The render pass' outgoing dependency makes the depth attachment visible to the compute shader
+				benchmark.gpuProfiler.beginScope(cmdBuffer, i, "Light culling");
+				vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.lightCulling);
+				vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lightCulling.pipelineLayout, 0, 1, &lightCulling.descriptorSet, 0, nullptr);
+				// One work group per screen tile, looping over the tile's depth slices
+				vkCmdDispatch(cmdBuffer, CLUSTER_X, CLUSTER_Y, 1);
+				benchmark.gpuProfiler.endScope(cmdBuffer, i);
+
+				// The composition pass reads the light lists
+				VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+				bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bufferBarrier.buffer = storageBuffers.clusters.buffer;
+				bufferBarrier.size = VK_WHOLE_SIZE;
+				vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+			}
 
-		VK_CHECK_RESULT(vkEndCommandBuffer(offScreenCmdBuffer));
+			VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+		}
 	}
 
 	void loadAssets()
@@ -444,8 +1058,80 @@ public:
 		textures.floor.normalMap.loadFromFile(getAssetPath() + "textures/stonefloor01_normal_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 	}
 
+	// Build command buffers rendering the G-Buffer and the composition in a single render pass
+	void buildMergedCommandBuffers()
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		// Swap chain image, G-Buffer color attachments and depth as the last attachment
+		std::vector<VkClearValue> clearValues(packedGBuffer ? 4 : 5);
+		for (auto& clearValue : clearValues)
+		{
+			clearValue.color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		}
+		clearValues.front().color = { { 0.0f, 0.0f, 0.2f, 0.0f } };
+		clearValues.back().depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = merged.renderPass;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		renderPassBeginInfo.pClearValues = clearValues.data();
+
+		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+		{
+			renderPassBeginInfo.framebuffer = merged.frameBuffers[i];
+
+			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+
+			// There is no separate G-Buffer command buffer to reset the image's profiler queries
+			benchmark.gpuProfiler.reset(drawCmdBuffers[i], i);
+			benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, "Single render pass");
+
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			// The G-Buffer matches the window, so the scene is always rendered at full resolution
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+			// First subpass: G-Buffer
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.mergedOffscreen);
+			drawScene(drawCmdBuffers[i]);
+
+			// Second subpass: Composition from the input attachments
+			vkCmdNextSubpass(drawCmdBuffers[i], VK_SUBPASS_CONTENTS_INLINE);
+
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, merged.pipelineLayout, 0, 1, &merged.descriptorSet, 0, nullptr);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.mergedComposition);
+			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+
+			drawUI(drawCmdBuffers[i]);
+
+			vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+			benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+		}
+	}
+
 	void buildCommandBuffers()
 	{
+		if (singleRenderPass)
+		{
+			buildMergedCommandBuffers();
+			return;
+		}
+
+		// The render extent follows the window size and the (dynamic) render scale
+		updateRenderResolution();
+		// Recorded first, as it starts the profiler scopes of each image
+		buildDeferredCommandBuffer();
+
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VkClearValue clearValues[2];
@@ -461,24 +1147,59 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
+		// The anti-aliased composition is rendered to its own target and resolved before being presented
+		VkRenderPassBeginInfo taaRenderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		taaRenderPassBeginInfo.renderPass = taaTarget.renderPass;
+		taaRenderPassBeginInfo.framebuffer = taaTarget.frameBuffer;
+		taaRenderPassBeginInfo.renderArea.extent.width = width;
+		taaRenderPassBeginInfo.renderArea.extent.height = height;
+
+		const bool resolveTemporal = temporalAntiAliasingActive();
+
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			renderPassBeginInfo.framebuffer = frameBuffers[i];
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, "Composition");
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
 			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			if (resolveTemporal)
+			{
+				vkCmdBeginRenderPass(drawCmdBuffers[i], &taaRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.compositionTAA);
+				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+				benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
+				benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, "Temporal anti-aliasing");
+				taa->record(drawCmdBuffers[i]);
+				benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
+				benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, "Present");
+			}
+
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-   			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
-			// Final composition as full screen quad
+			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+			if (resolveTemporal)
+			{
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, taaTarget.pipelineLayout, 0, 1, &taaTarget.descriptorSet, 0, nullptr);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.present);
+			}
+			else
+			{
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
+			}
+			// Final composition (or the resolved image) as full screen quad
 			// Note: Also used for debug display if debugDisplayTarget > 0
 			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
@@ -486,6 +1207,8 @@ public:
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -493,11 +1216,13 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 8),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 3)
 		};
 
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 6);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -515,6 +1240,10 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
 			// Binding 4 : Fragment shader uniform buffer
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+			// Binding 5 : Lights
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
+			// Binding 6 : Cluster light lists
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 6),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
@@ -523,6 +1252,69 @@ public:
 		// Shared pipeline layout used by all pipelines
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		// Light culling layout
+		setLayoutBindings = {
+			// Binding 0 : Composition uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Lights
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Depth attachment
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3 : Cluster light lists
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &lightCulling.descriptorSetLayout));
+		pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&lightCulling.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &lightCulling.pipelineLayout));
+
+		// Single render pass composition layout
+		setLayoutBindings = {
+			// Binding 1 : Position input attachment (depth for the packed G-Buffer)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+			// Binding 2 : Normals input attachment
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+			// Binding 3 : Albedo input attachment
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
+			// Binding 4 : Fragment shader uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+			// Binding 5 : Lights
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &merged.descriptorSetLayout));
+		pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&merged.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &merged.pipelineLayout));
+
+		// Presenting the temporal anti-aliasing output
+		setLayoutBindings = {
+			// Binding 0 : Resolved image
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &taaTarget.descriptorSetLayout));
+		pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&taaTarget.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &taaTarget.pipelineLayout));
+	}
+
+	// Point the single render pass composition at the current window sized G-Buffer
+	void updateMergedDescriptorSet()
+	{
+		std::array<VkDescriptorImageInfo, 3> inputDescriptors = {
+			vks::initializers::descriptorImageInfo(
+				VK_NULL_HANDLE,
+				packedGBuffer ? merged.depth.view : merged.position.view,
+				packedGBuffer ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, merged.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, merged.albedo.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+		for (uint32_t i = 0; i < inputDescriptors.size(); i++)
+		{
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(merged.descriptorSet, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, i + 1, &inputDescriptors[i]));
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 	}
 
 	void setupDescriptorSet()
@@ -530,12 +1322,12 @@ public:
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 
-		// Image descriptors for the offscreen color attachments
+		// Image descriptors for the offscreen color attachments, the packed G-Buffer passes depth instead of positions
 		VkDescriptorImageInfo texDescriptorPosition =
 			vks::initializers::descriptorImageInfo(
 				colorSampler,
-				offScreenFrameBuf.position.view,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				packedGBuffer ? offScreenFrameBuf.depthSampleView : offScreenFrameBuf.position.view,
+				packedGBuffer ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo texDescriptorNormal =
 			vks::initializers::descriptorImageInfo(
@@ -560,9 +1352,49 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &texDescriptorAlbedo),
 			// Binding 4 : Fragment shader uniform buffer
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.composition.descriptor),
+			// Binding 5 : Lights
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &storageBuffers.lights.descriptor),
+			// Binding 6 : Cluster light lists
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &storageBuffers.clusters.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		// Light culling
+		VkDescriptorSetAllocateInfo lightCullingAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &lightCulling.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &lightCullingAllocInfo, &lightCulling.descriptorSet));
+		VkDescriptorImageInfo texDescriptorDepth =
+			vks::initializers::descriptorImageInfo(
+				colorSampler,
+				offScreenFrameBuf.depthSampleView,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+		writeDescriptorSets = {
+			// Binding 0 : Composition uniform buffer
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.composition.descriptor),
+			// Binding 1 : Lights
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &storageBuffers.lights.descriptor),
+			// Binding 2 : Depth attachment
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &texDescriptorDepth),
+			// Binding 3 : Cluster light lists
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &storageBuffers.clusters.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		// Single render pass composition
+		VkDescriptorSetAllocateInfo mergedAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &merged.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &mergedAllocInfo, &merged.descriptorSet));
+		updateMergedDescriptorSet();
+		writeDescriptorSets = {
+			// Binding 4 : Fragment shader uniform buffer
+			vks::initializers::writeDescriptorSet(merged.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.composition.descriptor),
+			// Binding 5 : Lights
+			vks::initializers::writeDescriptorSet(merged.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &storageBuffers.lights.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 
+		// Temporal anti-aliasing output, written along with the output image in createTemporalAntiAliasingTarget()
+		VkDescriptorSetAllocateInfo taaAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &taaTarget.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &taaAllocInfo, &taaTarget.descriptorSet));
+
 		// Offscreen (scene)
 
 		// Model
@@ -603,6 +1435,10 @@ public:
 		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
 		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
 
+		// layout (constant_id = 0) const bool PACKED_GBUFFER
+		vks::SpecializationConstants<VkBool32> specializationConstants;
+		specializationConstants.set<0>(packedGBuffer ? VK_TRUE : VK_FALSE);
+
 		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass);
 		pipelineCI.pInputAssemblyState = &inputAssemblyState;
 		pipelineCI.pRasterizationState = &rasterizationState;
@@ -618,11 +1454,23 @@ public:
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		shaderStages[0] = loadShader(getShadersPath() + "deferred/deferred.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "deferred/deferred.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[1].pSpecializationInfo = specializationConstants.getInfo();
 		// Empty vertex input state, vertices are generated by the vertex shader
 		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		pipelineCI.pVertexInputState = &emptyInputState;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.composition));
 
+		// Same composition to the target resolved with temporal anti-aliasing
+		pipelineCI.renderPass = taaTarget.renderPass;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.compositionTAA));
+
+		// Presenting the resolved image
+		pipelineCI.renderPass = renderPass;
+		pipelineCI.layout = taaTarget.pipelineLayout;
+		shaderStages[1] = loadShader(getShadersPath() + "deferred/present.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.present));
+		pipelineCI.layout = pipelineLayout;
+
 		// Vertex input state from glTF model for pipeline rendering models
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Tangent});
 		rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
@@ -630,6 +1478,7 @@ public:
 		// Offscreen pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "deferred/mrt.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "deferred/mrt.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[1].pSpecializationInfo = specializationConstants.getInfo();
 
 		// Separate render pass
 		pipelineCI.renderPass = offScreenFrameBuf.renderPass;
@@ -637,16 +1486,41 @@ public:
 		// Blend attachment states required for all color attachments
 		// This is important, as color write mask will otherwise be 0x0 and you
 		// won't see anything rendered to the attachment
-		std::array<VkPipelineColorBlendAttachmentState, 3> blendAttachmentStates = {
+		std::array<VkPipelineColorBlendAttachmentState, 4> blendAttachmentStates = {
+			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE)
 		};
 
+		// One state per color reference, including the unused position reference of the packed G-Buffer
 		colorBlendState.attachmentCount = static_cast<uint32_t>(blendAttachmentStates.size());
 		colorBlendState.pAttachments = blendAttachmentStates.data();
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
+
+		// Single render pass path, same G-Buffer pipeline in the first subpass, which has no velocity attachment and no position attachment for the packed G-Buffer
+		colorBlendState.attachmentCount = packedGBuffer ? 2 : 3;
+		pipelineCI.renderPass = merged.renderPass;
+		pipelineCI.subpass = 0;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.mergedOffscreen));
+
+		// Composition reading the G-Buffer as input attachments in the second subpass
+		colorBlendState.attachmentCount = 1;
+		colorBlendState.pAttachments = &blendAttachmentState;
+		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
+		pipelineCI.pVertexInputState = &emptyInputState;
+		pipelineCI.layout = merged.pipelineLayout;
+		pipelineCI.subpass = 1;
+		shaderStages[0] = loadShader(getShadersPath() + "deferred/deferred.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "deferred/composition.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[1].pSpecializationInfo = specializationConstants.getInfo();
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.mergedComposition));
+
+		// Light culling pipeline
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(lightCulling.pipelineLayout, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "deferred/clusters.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.lightCulling));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -666,9 +1540,24 @@ public:
 		    &uniformBuffers.composition,
 			sizeof(uboComposition)));
 
+		// Lights
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&storageBuffers.lights,
+			MAX_LIGHTS * sizeof(Light)));
+
+		// Cluster light lists, only accessed by the GPU
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&storageBuffers.clusters,
+			CLUSTER_X * CLUSTER_Y * CLUSTER_Z * (MAX_LIGHTS_PER_CLUSTER + 1) * sizeof(uint32_t)));
+
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.offscreen.map());
 		VK_CHECK_RESULT(uniformBuffers.composition.map());
+		VK_CHECK_RESULT(storageBuffers.lights.map());
 
 		// Setup instanced model positions
 		uboOffscreenVS.instancePos[0] = glm::vec4(0.0f);
@@ -683,63 +1572,145 @@ public:
 	// Update matrices used for the offscreen rendering of the scene
 	void updateUniformBufferOffscreen()
 	{
-		uboOffscreenVS.projection = camera.matrices.perspective;
+		uboOffscreenVS.projection = camera.matrices.jitteredPerspective;
 		uboOffscreenVS.view = camera.matrices.view;
 		uboOffscreenVS.model = glm::mat4(1.0f);
+		uboOffscreenVS.viewProjection = camera.matrices.perspective * camera.matrices.view;
 		memcpy(uniformBuffers.offscreen.mapped, &uboOffscreenVS, sizeof(uboOffscreenVS));
 	}
 
-	// Update lights and parameters passed to the composition shaders
+	// Distance at which a light's attenuation drops below the cutoff, the shaders fade the light out towards it
+	static float lightRange(float radius, float cutoff)
+	{
+		return sqrt(std::max(radius / cutoff - 1.0f, 1.0f));
+	}
+
+	// Lights shaded at the current quality level, the six main lights are always kept
+	int32_t activeLightCount() const
+	{
+		return std::max(lightCount >> (vks::PerformanceGovernor::maxQuality - qualityLevel), 6);
+	}
+
+	// Set up the six main lights and a field of small point and spot lights moving above the floor
+	void prepareLights()
+	{
+		lights.resize(MAX_LIGHTS);
+		lightPaths.resize(MAX_LIGHTS);
+		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
+		std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
+		for (uint32_t i = 6; i < MAX_LIGHTS; i++)
+		{
+			Light& light = lights[i];
+			const float radius = 0.2f + rndDist(rndEngine) * 0.4f;
+			light.position = glm::vec4(0.0f, 0.0f, 0.0f, lightRange(radius, 0.02f));
+			light.color = glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine));
+			light.radius = radius;
+			// Every fourth light is a spot light pointing down
+			light.direction = (i % 4 == 0) ? glm::vec4(0.0f, 1.0f, 0.0f, cos(glm::radians(35.0f))) : glm::vec4(0.0f, 0.0f, 0.0f, -2.0f);
+			LightPath& path = lightPaths[i];
+			path.center = glm::vec3(rndDist(rndEngine) * 20.0f - 10.0f, -0.2f - rndDist(rndEngine) * 1.3f, rndDist(rndEngine) * 20.0f - 10.0f);
+			path.radius = 0.5f + rndDist(rndEngine) * 1.5f;
+			path.speed = 0.5f + rndDist(rndEngine);
+			path.phase = rndDist(rndEngine) * 360.0f;
+		}
+	}
+
+	void updateLights()
+	{
+		const glm::vec3 mainLights[6][3] = {
+			// Position, color, radius
+			{ glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.5f), glm::vec3(15.0f * 0.25f) },             // White
+			{ glm::vec3(-2.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(15.0f) },        // Red
+			{ glm::vec3(2.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 2.5f), glm::vec3(5.0f) },         // Blue
+			{ glm::vec3(0.0f, -0.9f, 0.5f), glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(2.0f) },         // Yellow
+			{ glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(0.0f, 1.0f, 0.2f), glm::vec3(5.0f) },         // Green
+			{ glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(1.0f, 0.7f, 0.3f), glm::vec3(25.0f) },        // Yellow
+		};
+		for (uint32_t i = 0; i < 6; i++)
+		{
+			// Large ranges so the main lights look like the unbounded ones they used to be
+			lights[i].position = glm::vec4(mainLights[i][0], lightRange(mainLights[i][2].x, 0.005f));
+			lights[i].color = mainLights[i][1];
+			lights[i].radius = mainLights[i][2].x;
+			lights[i].direction = glm::vec4(0.0f, 0.0f, 0.0f, -2.0f);
+		}
+
+		lights[0].position.x = sin(glm::radians(360.0f * timer)) * 5.0f;
+		lights[0].position.z = cos(glm::radians(360.0f * timer)) * 5.0f;
+
+		lights[1].position.x = -4.0f + sin(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
+		lights[1].position.z =  0.0f + cos(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
+
+		lights[2].position.x = 4.0f + sin(glm::radians(360.0f * timer)) * 2.0f;
+		lights[2].position.z = 0.0f + cos(glm::radians(360.0f * timer)) * 2.0f;
+
+		lights[4].position.x = 0.0f + sin(glm::radians(360.0f * timer + 90.0f)) * 5.0f;
+		lights[4].position.z = 0.0f - cos(glm::radians(360.0f * timer + 45.0f)) * 5.0f;
+
+		lights[5].position.x = 0.0f + sin(glm::radians(-360.0f * timer + 135.0f)) * 10.0f;
+		lights[5].position.z = 0.0f - cos(glm::radians(-360.0f * timer - 45.0f)) * 10.0f;
+
+		const int32_t activeLights = activeLightCount();
+		for (int32_t i = 6; i < activeLights; i++)
+		{
+			const LightPath& path = lightPaths[i];
+			const float angle = glm::radians(360.0f * timer * path.speed + path.phase);
+			lights[i].position.x = path.center.x + sin(angle) * path.radius;
+			lights[i].position.y = path.center.y;
+			lights[i].position.z = path.center.z + cos(angle) * path.radius;
+		}
+
+		memcpy(storageBuffers.lights.mapped, lights.data(), activeLights * sizeof(Light));
+	}
+
+	// Update lights and parameters passed to the composition and light culling shaders
 	void updateUniformBufferComposition()
 	{
-		// White
-		uboComposition.lights[0].position = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
-		uboComposition.lights[0].color = glm::vec3(1.5f);
-		uboComposition.lights[0].radius = 15.0f * 0.25f;
-		// Red
-		uboComposition.lights[1].position = glm::vec4(-2.0f, 0.0f, 0.0f, 0.0f);
-		uboComposition.lights[1].color = glm::vec3(1.0f, 0.0f, 0.0f);
-		uboComposition.lights[1].radius = 15.0f;
-		// Blue
-		uboComposition.lights[2].position = glm::vec4(2.0f, -1.0f, 0.0f, 0.0f);
-		uboComposition.lights[2].color = glm::vec3(0.0f, 0.0f, 2.5f);
-		uboComposition.lights[2].radius = 5.0f;
-		// Yellow
-		uboComposition.lights[3].position = glm::vec4(0.0f, -0.9f, 0.5f, 0.0f);
-		uboComposition.lights[3].color = glm::vec3(1.0f, 1.0f, 0.0f);
-		uboComposition.lights[3].radius = 2.0f;
-		// Green
-		uboComposition.lights[4].position = glm::vec4(0.0f, -0.5f, 0.0f, 0.0f);
-		uboComposition.lights[4].color = glm::vec3(0.0f, 1.0f, 0.2f);
-		uboComposition.lights[4].radius = 5.0f;
-		// Yellow
-		uboComposition.lights[5].position = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
-		uboComposition.lights[5].color = glm::vec3(1.0f, 0.7f, 0.3f);
-		uboComposition.lights[5].radius = 25.0f;
-
-		uboComposition.lights[0].position.x = sin(glm::radians(360.0f * timer)) * 5.0f;
-		uboComposition.lights[0].position.z = cos(glm::radians(360.0f * timer)) * 5.0f;
-
-		uboComposition.lights[1].position.x = -4.0f + sin(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
-		uboComposition.lights[1].position.z =  0.0f + cos(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
-
-		uboComposition.lights[2].position.x = 4.0f + sin(glm::radians(360.0f * timer)) * 2.0f;
-		uboComposition.lights[2].position.z = 0.0f + cos(glm::radians(360.0f * timer)) * 2.0f;
-
-		uboComposition.lights[4].position.x = 0.0f + sin(glm::radians(360.0f * timer + 90.0f)) * 5.0f;
-		uboComposition.lights[4].position.z = 0.0f - cos(glm::radians(360.0f * timer + 45.0f)) * 5.0f;
-
-		uboComposition.lights[5].position.x = 0.0f + sin(glm::radians(-360.0f * timer + 135.0f)) * 10.0f;
-		uboComposition.lights[5].position.z = 0.0f - cos(glm::radians(-360.0f * timer - 45.0f)) * 10.0f;
+		updateLights();
 
 		// Current view position
 		uboComposition.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
 
+		// Clusters are built in the view space of the G-Buffer pass
+		uboComposition.view = camera.matrices.view;
+		// Positions are reconstructed from the jittered depth
+		uboComposition.invProjection = glm::inverse(camera.matrices.jitteredPerspective);
+		uboComposition.invViewProjection = glm::inverse(camera.matrices.jitteredPerspective * camera.matrices.view);
+		uboComposition.zNear = camera.getNearClip();
+		uboComposition.zFar = camera.getFarClip();
+
 		uboComposition.debugDisplayTarget = debugDisplayTarget;
+		uboComposition.lightCount = activeLightCount();
+		uboComposition.clustered = clusteredLighting ? 1 : 0;
+		uboComposition.uvScale = renderResolution.uvScale;
+		uboComposition.renderExtent = glm::ivec2(renderResolution.renderExtent.width, renderResolution.renderExtent.height);
 
 		memcpy(uniformBuffers.composition.mapped, &uboComposition, sizeof(uboComposition));
 	}
 
+	// Advance the jitter to the next frame's offset, called once per frame after submitting, the frame just submitted becomes the history of the next one
+	void updateTemporalAntiAliasing()
+	{
+		uboOffscreenVS.prevViewProjection = uboOffscreenVS.viewProjection;
+		camera.setJitter(Camera::jitterSequence(taaFrame++), renderResolution.renderExtent.width, renderResolution.renderExtent.height);
+		updateUniformBufferOffscreen();
+		updateUniformBufferComposition();
+		// The velocity is written to the rendered part of the G-Buffer
+		taa->update(renderResolution.uvScale, taaReset);
+		taaReset = false;
+	}
+
+	// Switch the jitter and the command buffers to the current anti-aliasing settings
+	void temporalAntiAliasingChanged()
+	{
+		taaReset = true;
+		camera.setJitter(glm::vec2(0.0f), renderResolution.renderExtent.width, renderResolution.renderExtent.height);
+		uboOffscreenVS.prevViewProjection = camera.matrices.perspective * camera.matrices.view;
+		updateUniformBufferOffscreen();
+		updateUniformBufferComposition();
+		buildCommandBuffers();
+	}
+
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
@@ -755,28 +1726,43 @@ public:
 		// that command buffers will be executed in the order they
 		// have been submitted by the application
 
+		if (singleRenderPass)
+		{
+			// G-Buffer and composition are part of the same command buffer, which waits for and signals the frame's semaphores set up by prepareFrame()
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+			VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
+			VulkanExampleBase::submitFrame();
+			return;
+		}
+
+		// The offscreen submission waits for the frame's swap chain image, the composition submission signals the frame's render complete semaphore
+		const VkSemaphore* frameWaitSemaphores = submitInfo.pWaitSemaphores;
+		const VkSemaphore* frameSignalSemaphores = submitInfo.pSignalSemaphores;
+
 		// Offscreen rendering
 
-		// Wait for swap chain presentation to finish
-		submitInfo.pWaitSemaphores = &semaphores.presentComplete;
 		// Signal ready with offscreen semaphore
 		submitInfo.pSignalSemaphores = &offscreenSemaphore;
 
 		// Submit work
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &offScreenCmdBuffer;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		submitInfo.pCommandBuffers = &offScreenCmdBuffers[currentBuffer];
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		// Scene rendering
 
 		// Wait for offscreen semaphore
 		submitInfo.pWaitSemaphores = &offscreenSemaphore;
-		// Signal ready with render complete semaphore
-		submitInfo.pSignalSemaphores = &semaphores.renderComplete;
+		// Signal ready with the frame's render complete semaphore
+		submitInfo.pSignalSemaphores = frameSignalSemaphores;
 
 		// Submit work
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
+
+		// Restore the frame's wait semaphore, prepareFrame() only sets it up when using per-frame synchronization objects
+		submitInfo.pWaitSemaphores = frameWaitSemaphores;
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -785,14 +1771,23 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		prepareLights();
 		prepareOffscreenFramebuffer();
+		prepareMergedRenderPass();
+		createMergedAttachments();
+		prepareTemporalAntiAliasingRenderPass();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
+		taa.reset(new vks::TemporalAntiAliasing(vulkanDevice, getShadersPath() + "base/taa.comp.spv"));
+		taa->setSettings(taaSettings);
+		createTemporalAntiAliasingTarget();
+		// Create a semaphore used to synchronize offscreen rendering and usage
+		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &offscreenSemaphore));
 		buildCommandBuffers();
-		buildDeferredCommandBuffer();
 		prepared = true;
 	}
 
@@ -801,7 +1796,14 @@ public:
 		if (!prepared)
 			return;
 		draw();
-		if (!paused)
+		if (temporalAntiAliasingActive())
+		{
+			// Updates all uniforms for the next jitter offset
+			updateTemporalAntiAliasing();
+			return;
+		}
+		// The light culling shader uses the camera too
+		if (!paused || camera.updated)
 		{
 			updateUniformBufferComposition();
 		}
@@ -814,6 +1816,24 @@ public:
 	virtual void viewChanged()
 	{
 		updateUniformBufferOffscreen();
+		updateUniformBufferComposition();
+	}
+
+	virtual void windowResized()
+	{
+		updateUniformBufferComposition();
+	}
+
+	virtual void renderResolutionChanged()
+	{
+		buildCommandBuffers();
+		updateUniformBufferComposition();
+	}
+
+	virtual void qualityLevelChanged(uint32_t qualityLevel)
+	{
+		this->qualityLevel = qualityLevel;
+		updateUniformBufferComposition();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
@@ -823,6 +1843,51 @@ public:
 			{
 				updateUniformBufferComposition();
 			}
+			if (overlay->checkBox("Clustered lighting", &clusteredLighting))
+			{
+				// The light culling dispatch is part of the G-Buffer command buffers
+				buildCommandBuffers();
+				updateUniformBufferComposition();
+			}
+			if (overlay->sliderInt("Lights", &lightCount, 6, MAX_LIGHTS))
+			{
+				updateUniformBufferComposition();
+			}
+			if (overlay->checkBox("Packed G-Buffer", &packedGBuffer))
+			{
+				rebuildGBuffer();
+			}
+			// Light culling needs the depth buffer between the G-Buffer and the composition, so the single render pass shades all lights
+			if (overlay->checkBox("Single render pass", &singleRenderPass))
+			{
+				vkDeviceWaitIdle(device);
+				updateOverlayPipeline();
+				temporalAntiAliasingChanged();
+			}
+			if (taa->isSupported())
+			{
+				// The single render pass path never leaves the render pass between the G-Buffer and the composition, so it isn't anti-aliased
+				if (overlay->checkBox("Temporal anti-aliasing", &temporalAntiAliasing))
+				{
+					temporalAntiAliasingChanged();
+				}
+				if (temporalAntiAliasingActive() && overlay->sliderFloat("History feedback", &taaSettings.feedbackMax, 0.9f, 0.99f))
+				{
+					taaSettings.feedbackMin = std::min(taaSettings.feedbackMin, taaSettings.feedbackMax);
+					taa->setSettings(taaSettings);
+				}
+			}
+		}
+		if (settings.imageCompressionControl && overlay->header("Framebuffer compression")) {
+			std::vector<std::pair<const char*, FrameBufferAttachment*>> targets = { { "Normals", &offScreenFrameBuf.normal }, { "Albedo", &offScreenFrameBuf.albedo } };
+			if (!packedGBuffer) {
+				targets.push_back({ "Position", &offScreenFrameBuf.position });
+			}
+			targets.push_back({ "Velocity", &offScreenFrameBuf.velocity });
+			targets.push_back({ "Depth", &offScreenFrameBuf.depth });
+			for (auto& target : targets) {
+				overlay->text("%s: %s", target.first, target.second->compression.toString().c_str());
+			}
 		}
 	}
 };
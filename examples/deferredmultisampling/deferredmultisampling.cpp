@@ -9,6 +9,7 @@
 #include "vulkanexamplebase.h"
 #include "VulkanFrameBuffer.hpp"
 #include "VulkanglTFModel.h"
+#include "VulkanSpecialization.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -25,6 +26,8 @@ public:
 	int32_t debugDisplayTarget = 0;
 	bool useMSAA = true;
 	bool useSampleShading = true;
+	// Reconstruct positions from depth and store octahedral encoded normals in two 16 bit channels, which halves the G-Buffer size
+	bool packedGBuffer = false;
 	VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT;
 
 	struct {
@@ -59,6 +62,7 @@ public:
 	struct {
 		Light lights[6];
 		glm::vec4 viewPos;
+		glm::mat4 invViewProjection;
 		int32_t debugDisplayTarget = 0;
 	} uboComposition;
 
@@ -157,7 +161,7 @@ public:
 		offscreenframeBuffers->width = FB_DIM;
 		offscreenframeBuffers->height = FB_DIM;
 
-		// Four attachments (3 color, 1 depth)
+		// Four attachments (3 color, 1 depth), three for the packed G-Buffer (2 color, 1 depth)
 		vks::AttachmentCreateInfo attachmentInfo = {};
 		attachmentInfo.width = FB_DIM;
 		attachmentInfo.height = FB_DIM;
@@ -166,26 +170,30 @@ public:
 		attachmentInfo.imageSampleCount = sampleCount;
 
 		// Color attachments
-		// Attachment 0: (World space) Positions
-		attachmentInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		// Attachment 0: (World space) Normals, octahedral encoded for the packed G-Buffer
+		attachmentInfo.format = packedGBuffer ? vks::tools::getSupportedColorAttachmentFormat(physicalDevice, { VK_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16_SFLOAT }) : VK_FORMAT_R16G16B16A16_SFLOAT;
 		offscreenframeBuffers->addAttachment(attachmentInfo);
 
-		// Attachment 1: (World space) Normals
-		attachmentInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
-		offscreenframeBuffers->addAttachment(attachmentInfo);
-
-		// Attachment 2: Albedo (color)
+		// Attachment 1: Albedo (color)
 		attachmentInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
 		offscreenframeBuffers->addAttachment(attachmentInfo);
 
+		// Attachment 2: (World space) Positions, the packed G-Buffer reconstructs them from depth
+		if (!packedGBuffer)
+		{
+			attachmentInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+			offscreenframeBuffers->addAttachment(attachmentInfo);
+		}
+
 		// Depth attachment
 		// Find a suitable depth format
 		VkFormat attDepthFormat;
 		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &attDepthFormat);
 		assert(validDepthFormat);
 
+		// The packed G-Buffer fetches the depth samples in the composition pass
 		attachmentInfo.format = attDepthFormat;
-		attachmentInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		attachmentInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (packedGBuffer ? VK_IMAGE_USAGE_SAMPLED_BIT : 0);
 		offscreenframeBuffers->addAttachment(attachmentInfo);
 
 		// Create sampler to sample from the color attachments
@@ -210,11 +218,13 @@ public:
 
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-		// Clear values for all attachments written in the fragment shader
-		std::array<VkClearValue,4> clearValues;
-		clearValues[0].color = clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-		clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-		clearValues[3].depthStencil = { 1.0f, 0 };
+		// Clear values for all attachments written in the fragment shader, depth is the last attachment
+		std::vector<VkClearValue> clearValues(offscreenframeBuffers->attachments.size());
+		for (auto& clearValue : clearValues)
+		{
+			clearValue.color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		}
+		clearValues.back().depthStencil = { 1.0f, 0 };
 
 		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
 		renderPassBeginInfo.renderPass = offscreenframeBuffers->renderPass;
@@ -348,23 +358,23 @@ public:
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 
-		// Image descriptors for the offscreen color attachments
+		// Image descriptors for the offscreen color attachments, attachment 2 is the depth attachment for the packed G-Buffer
 		VkDescriptorImageInfo texDescriptorPosition =
 			vks::initializers::descriptorImageInfo(
 				offscreenframeBuffers->sampler,
-				offscreenframeBuffers->attachments[0].view,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				offscreenframeBuffers->attachments[2].view,
+				packedGBuffer ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo texDescriptorNormal =
 			vks::initializers::descriptorImageInfo(
 				offscreenframeBuffers->sampler,
-				offscreenframeBuffers->attachments[1].view,
+				offscreenframeBuffers->attachments[0].view,
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo texDescriptorAlbedo =
 			vks::initializers::descriptorImageInfo(
 				offscreenframeBuffers->sampler,
-				offscreenframeBuffers->attachments[2].view,
+				offscreenframeBuffers->attachments[1].view,
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		// Deferred composition
@@ -438,30 +448,23 @@ public:
 		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		pipelineCI.pVertexInputState = &emptyInputState;
 
-		// Use specialization constants to pass number of samples to the shader (used for MSAA resolve)
-		VkSpecializationMapEntry specializationEntry{};
-		specializationEntry.constantID = 0;
-		specializationEntry.offset = 0;
-		specializationEntry.size = sizeof(uint32_t);
-
-		uint32_t specializationData = sampleCount;
-
-		VkSpecializationInfo specializationInfo;
-		specializationInfo.mapEntryCount = 1;
-		specializationInfo.pMapEntries = &specializationEntry;
-		specializationInfo.dataSize = sizeof(specializationData);
-		specializationInfo.pData = &specializationData;
+		// Use specialization constants to pass number of samples (used for MSAA resolve) and the G-Buffer layout to the shader
+		// layout (constant_id = 0) const int NUM_SAMPLES
+		// layout (constant_id = 1) const bool PACKED_GBUFFER
+		vks::SpecializationConstants<uint32_t, VkBool32> specializationConstants;
+		specializationConstants.set<0>(sampleCount);
+		specializationConstants.set<1>(packedGBuffer ? VK_TRUE : VK_FALSE);
 
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 
 		// With MSAA
 		shaderStages[0] = loadShader(getShadersPath() + "deferredmultisampling/deferred.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "deferredmultisampling/deferred.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		shaderStages[1].pSpecializationInfo = &specializationInfo;
+		shaderStages[1].pSpecializationInfo = specializationConstants.getInfo();
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.deferred));
 
 		// No MSAA (1 sample)
-		specializationData = 1;
+		specializationConstants.set<0>(1);
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.deferredNoMSAA));
 
 		// Vertex input state from glTF model for pipeline rendering models
@@ -474,6 +477,10 @@ public:
 
 		shaderStages[0] = loadShader(getShadersPath() + "deferredmultisampling/mrt.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "deferredmultisampling/mrt.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		// layout (constant_id = 0) const bool PACKED_GBUFFER
+		vks::SpecializationConstants<VkBool32> mrtSpecializationConstants;
+		mrtSpecializationConstants.set<0>(packedGBuffer ? VK_TRUE : VK_FALSE);
+		shaderStages[1].pSpecializationInfo = mrtSpecializationConstants.getInfo();
 
 		//rasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
 		//rasterizationState.lineWidth = 2.0f;
@@ -489,7 +496,8 @@ public:
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE)
 		};
 
-		colorBlendState.attachmentCount = static_cast<uint32_t>(blendAttachmentStates.size());
+		// The packed G-Buffer has no position attachment
+		colorBlendState.attachmentCount = packedGBuffer ? 2 : 3;
 		colorBlendState.pAttachments = blendAttachmentStates.data();
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
@@ -583,6 +591,7 @@ public:
 
 		// Current view position
 		uboComposition.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
+		uboComposition.invViewProjection = glm::inverse(camera.matrices.perspective * camera.matrices.view);
 		uboComposition.debugDisplayTarget = debugDisplayTarget;
 
 		memcpy(uniformBuffers.composition.mapped, &uboComposition, sizeof(uboComposition));
@@ -602,7 +611,7 @@ public:
 		// Submit work
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &offScreenCmdBuffer;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		// Scene rendering
 
@@ -613,11 +622,28 @@ public:
 
 		// Submit work
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
 
+	// Recreate the G-Buffer and everything depending on its layout after switching between the full and the packed G-Buffer
+	void rebuildGBuffer()
+	{
+		vkDeviceWaitIdle(device);
+		delete offscreenframeBuffers;
+		deferredSetup();
+		vkDestroyPipeline(device, pipelines.deferred, nullptr);
+		vkDestroyPipeline(device, pipelines.deferredNoMSAA, nullptr);
+		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
+		vkDestroyPipeline(device, pipelines.offscreenSampleShading, nullptr);
+		preparePipelines();
+		vkResetDescriptorPool(device, descriptorPool, 0);
+		setupDescriptorSet();
+		buildCommandBuffers();
+		buildDeferredCommandBuffer();
+	}
+
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
@@ -665,6 +691,9 @@ public:
 					buildDeferredCommandBuffer();
 				}
 			}
+			if (overlay->checkBox("Packed G-Buffer", &packedGBuffer)) {
+				rebuildGBuffer();
+			}
 		}
 	}
 
@@ -1,6 +1,9 @@
 /*
 * Vulkan Example - Deferred shading with shadows from multiple light sources using geometry shader instancing
 *
+* The shadow maps of all lights are packed into tiles of a shadow atlas, sized by each light's screen coverage and only rendered again
+* if the light has changed. All tiles that need to be rendered are output in one pass using geometry shader instancing and viewport arrays
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -9,16 +12,22 @@
 #include "vulkanexamplebase.h"
 #include "VulkanFrameBuffer.hpp"
 #include "VulkanglTFModel.h"
+#include "VulkanSpecialization.hpp"
+#include "VulkanShadowAtlas.h"
+#include "VulkanTemporalAntiAliasing.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
 
-// Shadowmap properties
+// Shadow atlas properties, the atlas has a fixed size and tiles are assigned to lights based on their screen coverage
 #if defined(__ANDROID__)
-#define SHADOWMAP_DIM 1024
+#define SHADOW_ATLAS_DIM 2048
+#define SHADOW_TILE_MAX 512
 #else
-#define SHADOWMAP_DIM 2048
+#define SHADOW_ATLAS_DIM 4096
+#define SHADOW_TILE_MAX 1024
 #endif
+#define SHADOW_TILE_MIN 64
 
 #if defined(__ANDROID__)
 // Use max. screen dimension as deferred framebuffer size
@@ -28,19 +37,35 @@
 #endif
 
 // Must match the LIGHT_COUNT define in the shadow and deferred shaders
-#define LIGHT_COUNT 3
+#define LIGHT_COUNT 32
+// Number of atlas tiles rendered per draw, must match the MAX_VIEWPORTS define in the shadow geometry shader
+// Devices supporting multiple viewports support at least 16 viewports
+#define SHADOW_VIEWPORTS 16
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	int32_t debugDisplayTarget = 0;
 	bool enableShadows = true;
+	// Reconstruct positions from depth and store octahedral encoded normals in two 16 bit channels, which halves the G-Buffer size
+	bool packedGBuffer = false;
+	// Keep the atlas tiles of lights that haven't moved, instead of rendering all shadow maps every frame
+	bool cacheShadowTiles = true;
+	int32_t lightCount = LIGHT_COUNT;
+	// Render the scene with a sub-pixel jitter that changes every frame and resolve the composition against the reprojected previous frames
+	bool temporalAntiAliasing = false;
+	std::unique_ptr<vks::TemporalAntiAliasing> taa;
+	vks::TemporalAntiAliasing::Settings taaSettings;
+	uint32_t taaFrame = 0;
+	// Discard the history with the next frame, e.g. after switching anti-aliasing on
+	bool taaReset = true;
 
 	// Keep depth range as small as possible
 	// for better shadow map precision
 	float zNear = 0.1f;
 	float zFar = 64.0f;
 	float lightFOV = 100.0f;
+	float lightRange = 100.0f;
 
 	// Depth bias (and slope) are used to avoid shadowing artifacts
 	float depthBiasConstant = 1.25f;
@@ -67,11 +92,13 @@ public:
 		glm::mat4 model;
 		glm::mat4 view;
 		glm::vec4 instancePos[3];
-		int layer;
+		// Unjittered view projections of the current and the previous frame for the velocity output
+		glm::mat4 viewProjection = glm::mat4(1.0f);
+		glm::mat4 prevViewProjection = glm::mat4(1.0f);
 	} uboOffscreenVS;
 
 	// This UBO stores the shadow matrices for all of the light sources
-	// The matrices are indexed using geometry shader instancing
+	// The matrices are indexed by the light index the geometry shader invocation renders
 	// The instancePos is used to place the models using instanced draws
 	struct {
 		glm::mat4 mvp[LIGHT_COUNT];
@@ -80,18 +107,35 @@ public:
 
 	struct Light {
 		glm::vec4 position;
+		// Range of the light is stored in w
 		glm::vec4 target;
 		glm::vec4 color;
 		glm::mat4 viewMatrix;
+		// Offset (xy) and scale (zw) of the light's shadow atlas tile, zero if the light has no tile
+		glm::vec4 shadowRect;
 	};
 
 	struct {
 		glm::vec4 viewPos;
 		Light lights[LIGHT_COUNT];
+		glm::mat4 invViewProjection;
 		uint32_t useShadows = 1;
 		int32_t debugDisplayTarget = 0;
+		int32_t lightCount = LIGHT_COUNT;
 	} uboComposition;
 
+	// Atlas tiles to be rendered by the geometry shader invocations of one draw
+	struct ShadowPushConstants {
+		uint32_t tileCount;
+		uint32_t lightIndex[SHADOW_VIEWPORTS];
+	};
+
+	std::unique_ptr<vks::ShadowAtlas> shadowAtlas;
+	// Tiles that need to be rendered this frame
+	std::vector<vks::ShadowAtlas::Allocation> shadowTiles;
+	// Shadow matrices of the lights at the time their tiles were rendered, used to detect lights that have changed
+	std::array<glm::mat4, LIGHT_COUNT> renderedShadowMatrices;
+
 	struct {
 		vks::Buffer offscreen;
 		vks::Buffer composition;
@@ -102,6 +146,9 @@ public:
 		VkPipeline deferred;
 		VkPipeline offscreen;
 		VkPipeline shadowpass;
+		// Temporal anti-aliasing path: composition to the window sized color target, and presenting the resolved image
+		VkPipeline compositionTAA;
+		VkPipeline present;
 	} pipelines;
 	VkPipelineLayout pipelineLayout;
 
@@ -122,6 +169,18 @@ public:
 		vks::Framebuffer *shadow;
 	} frameBuffers;
 
+	// Window sized target of the composition that is resolved with temporal anti-aliasing, and the descriptors for presenting the result
+	struct {
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory mem = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFramebuffer frameBuffer = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout;
+	} taaTarget;
+
 	struct {
 		VkCommandBuffer deferred = VK_NULL_HANDLE;
 	} commandBuffers;
@@ -144,6 +203,9 @@ public:
 		camera.setPerspective(60.0f, (float)width / (float)height, zNear, zFar);
 		timerSpeed *= 0.25f;
 		paused = true;
+		commandLineParser.add("taa", { "-taa", "--temporalaa" }, 0, "Enable temporal anti-aliasing");
+		commandLineParser.parse(args);
+		temporalAntiAliasing = commandLineParser.isSet("taa");
 	}
 
 	~VulkanExample()
@@ -157,14 +219,20 @@ public:
 		{
 			delete frameBuffers.shadow;
 		}
+		destroyTemporalAntiAliasingTarget();
+		vkDestroyRenderPass(device, taaTarget.renderPass, nullptr);
 
 		vkDestroyPipeline(device, pipelines.deferred, nullptr);
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
 		vkDestroyPipeline(device, pipelines.shadowpass, nullptr);
+		vkDestroyPipeline(device, pipelines.compositionTAA, nullptr);
+		vkDestroyPipeline(device, pipelines.present, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, taaTarget.pipelineLayout, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, taaTarget.descriptorSetLayout, nullptr);
 
 		// Uniform buffers
 		uniformBuffers.composition.destroy();
@@ -183,13 +251,20 @@ public:
 	// Enable physical device features required for this example
 	virtual void getEnabledFeatures()
 	{
-		// Geometry shader support is required for writing to multiple shadow map layers in one single pass
+		// Geometry shader support is required for writing to multiple shadow atlas tiles in one single pass
 		if (deviceFeatures.geometryShader) {
 			enabledFeatures.geometryShader = VK_TRUE;
 		}
 		else {
 			vks::tools::exitFatal("Selected GPU does not support geometry shaders!", VK_ERROR_FEATURE_NOT_PRESENT);
 		}
+		// Each atlas tile is rendered to a separate viewport selected in the geometry shader
+		if (deviceFeatures.multiViewport) {
+			enabledFeatures.multiViewport = VK_TRUE;
+		}
+		else {
+			vks::tools::exitFatal("Selected GPU does not support multiple viewports!", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
 		// Enable anisotropic filtering if supported
 		if (deviceFeatures.samplerAnisotropy) {
 			enabledFeatures.samplerAnisotropy = VK_TRUE;
@@ -206,39 +281,52 @@ public:
 		}
 	}
 
-	// Prepare a layered shadow map with each layer containing depth from a light's point of view
+	// Prepare a shadow atlas containing the depth from the lights' point of view, with one tile per light
 	// The shadow mapping pass uses geometry shader instancing to output the scene from the different
-	// light sources' point of view to the layers of the depth attachment in one single pass
+	// light sources' point of view to the viewports of their tiles in one single pass
 	void shadowSetup()
 	{
 		frameBuffers.shadow = new vks::Framebuffer(vulkanDevice);
 
-		frameBuffers.shadow->width = SHADOWMAP_DIM;
-		frameBuffers.shadow->height = SHADOWMAP_DIM;
+		frameBuffers.shadow->width = SHADOW_ATLAS_DIM;
+		frameBuffers.shadow->height = SHADOW_ATLAS_DIM;
 
 		// Find a suitable depth format
 		VkFormat shadowMapFormat;
 		VkBool32 validShadowMapFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &shadowMapFormat);
 		assert(validShadowMapFormat);
 
-		// Create a layered depth attachment for rendering the depth maps from the lights' point of view
-		// Each layer corresponds to one of the lights
-		// The actual output to the separate layers is done in the geometry shader using shader instancing
-		// We will pass the matrices of the lights to the GS that selects the layer by the current invocation
+		// Create a single depth attachment for the atlas, each light renders to the area of its tile
+		// The matrices of the lights are passed to the GS, which selects the light and the tile's viewport by the current invocation
 		vks::AttachmentCreateInfo attachmentInfo = {};
 		attachmentInfo.format = shadowMapFormat;
-		attachmentInfo.width = SHADOWMAP_DIM;
-		attachmentInfo.height = SHADOWMAP_DIM;
-		attachmentInfo.layerCount = LIGHT_COUNT;
-		attachmentInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		attachmentInfo.width = SHADOW_ATLAS_DIM;
+		attachmentInfo.height = SHADOW_ATLAS_DIM;
+		attachmentInfo.layerCount = 1;
+		attachmentInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		frameBuffers.shadow->addAttachment(attachmentInfo);
 
+		// Cached tiles must be preserved, so the atlas is loaded instead of cleared and only the tiles that are rendered get cleared
+		frameBuffers.shadow->attachments[0].description.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		frameBuffers.shadow->attachments[0].description.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
 		// Create sampler to sample from to depth attachment
 		// Used to sample in the fragment shader for shadowed rendering
 		VK_CHECK_RESULT(frameBuffers.shadow->createSampler(VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
 
 		// Create default renderpass for the framebuffer
 		VK_CHECK_RESULT(frameBuffers.shadow->createRenderPass());
+
+		// Clear the whole atlas once and transition it to the layout the render pass expects
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		const VkImageSubresourceRange subresourceRange = frameBuffers.shadow->attachments[0].subresourceRange;
+		vks::tools::setImageLayout(copyCmd, frameBuffers.shadow->attachments[0].image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		VkClearDepthStencilValue clearValue = { 1.0f, 0 };
+		vkCmdClearDepthStencilImage(copyCmd, frameBuffers.shadow->attachments[0].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearValue, 1, &subresourceRange);
+		vks::tools::setImageLayout(copyCmd, frameBuffers.shadow->attachments[0].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, subresourceRange);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+
+		shadowAtlas.reset(new vks::ShadowAtlas(SHADOW_ATLAS_DIM, SHADOW_TILE_MIN, SHADOW_TILE_MAX));
 	}
 
 	// Prepare the framebuffer for offscreen rendering with multiple attachments used as render targets inside the fragment shaders
@@ -249,7 +337,7 @@ public:
 		frameBuffers.deferred->width = FB_DIM;
 		frameBuffers.deferred->height = FB_DIM;
 
-		// Four attachments (3 color, 1 depth)
+		// Five attachments (4 color, 1 depth), four for the packed G-Buffer (3 color, 1 depth)
 		vks::AttachmentCreateInfo attachmentInfo = {};
 		attachmentInfo.width = FB_DIM;
 		attachmentInfo.height = FB_DIM;
@@ -257,26 +345,34 @@ public:
 		attachmentInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
 		// Color attachments
-		// Attachment 0: (World space) Positions
-		attachmentInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		// Attachment 0: (World space) Normals, octahedral encoded for the packed G-Buffer
+		attachmentInfo.format = packedGBuffer ? vks::tools::getSupportedColorAttachmentFormat(physicalDevice, { VK_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16_SFLOAT }) : VK_FORMAT_R16G16B16A16_SFLOAT;
 		frameBuffers.deferred->addAttachment(attachmentInfo);
 
-		// Attachment 1: (World space) Normals
-		attachmentInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		// Attachment 1: Albedo (color)
+		attachmentInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
 		frameBuffers.deferred->addAttachment(attachmentInfo);
 
-		// Attachment 2: Albedo (color)
-		attachmentInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+		// Attachment 2: Velocity in texture coordinates, read by the temporal anti-aliasing resolve
+		attachmentInfo.format = VK_FORMAT_R16G16_SFLOAT;
 		frameBuffers.deferred->addAttachment(attachmentInfo);
 
+		// Attachment 3: (World space) Positions, the packed G-Buffer reconstructs them from depth
+		if (!packedGBuffer)
+		{
+			attachmentInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+			frameBuffers.deferred->addAttachment(attachmentInfo);
+		}
+
 		// Depth attachment
 		// Find a suitable depth format
 		VkFormat attDepthFormat;
 		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &attDepthFormat);
 		assert(validDepthFormat);
 
+		// The packed G-Buffer samples depth in the composition pass
 		attachmentInfo.format = attDepthFormat;
-		attachmentInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		attachmentInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (packedGBuffer ? VK_IMAGE_USAGE_SAMPLED_BIT : 0);
 		frameBuffers.deferred->addAttachment(attachmentInfo);
 
 		// Create sampler to sample from the color attachments
@@ -286,6 +382,137 @@ public:
 		VK_CHECK_RESULT(frameBuffers.deferred->createRenderPass());
 	}
 
+	// Set up the render pass of the composition target that is resolved with temporal anti-aliasing
+	void prepareTemporalAntiAliasingRenderPass()
+	{
+		VkAttachmentDescription attachmentDesc{};
+		attachmentDesc.format = vks::TemporalAntiAliasing::format;
+		attachmentDesc.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachmentDesc.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachmentDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachmentDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachmentDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachmentDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		// Read by the resolve compute shader
+		attachmentDesc.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorReference;
+
+		std::array<VkSubpassDependency, 2> dependencies;
+
+		// The previous frame's resolve has to be done reading the target
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = 0;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[1].dependencyFlags = 0;
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = 1;
+		renderPassInfo.pAttachments = &attachmentDesc;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &taaTarget.renderPass));
+	}
+
+	// Create the window sized composition target and the temporal anti-aliasing images for it, the history starts empty
+	void createTemporalAntiAliasingTarget()
+	{
+		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+		image.imageType = VK_IMAGE_TYPE_2D;
+		image.format = vks::TemporalAntiAliasing::format;
+		image.extent = { width, height, 1 };
+		image.mipLevels = 1;
+		image.arrayLayers = 1;
+		image.samples = VK_SAMPLE_COUNT_1_BIT;
+		image.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &taaTarget.image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, taaTarget.image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &taaTarget.mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, taaTarget.image, taaTarget.mem, 0));
+
+		VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
+		imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageView.format = vks::TemporalAntiAliasing::format;
+		imageView.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		imageView.image = taaTarget.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &taaTarget.view));
+
+		VkFramebufferCreateInfo frameBufferCreateInfo = vks::initializers::framebufferCreateInfo();
+		frameBufferCreateInfo.renderPass = taaTarget.renderPass;
+		frameBufferCreateInfo.attachmentCount = 1;
+		frameBufferCreateInfo.pAttachments = &taaTarget.view;
+		frameBufferCreateInfo.width = width;
+		frameBufferCreateInfo.height = height;
+		frameBufferCreateInfo.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &taaTarget.frameBuffer));
+
+		// The G-Buffer is stretched over the window, so the velocity covers the same texture coordinates as the composition
+		const VkDescriptorImageInfo colorDescriptor = vks::initializers::descriptorImageInfo(frameBuffers.deferred->sampler, taaTarget.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		const VkDescriptorImageInfo velocityDescriptor = vks::initializers::descriptorImageInfo(frameBuffers.deferred->sampler, frameBuffers.deferred->attachments[2].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		taa->create(width, height, colorDescriptor, velocityDescriptor, queue);
+		if (taa->isSupported())
+		{
+			VkDescriptorImageInfo outputDescriptor = taa->getOutputDescriptor();
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(taaTarget.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &outputDescriptor);
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		}
+	}
+
+	void destroyTemporalAntiAliasingTarget()
+	{
+		vkDestroyFramebuffer(device, taaTarget.frameBuffer, nullptr);
+		vkDestroyImageView(device, taaTarget.view, nullptr);
+		vkDestroyImage(device, taaTarget.image, nullptr);
+		vkFreeMemory(device, taaTarget.mem, nullptr);
+		taaTarget.frameBuffer = VK_NULL_HANDLE;
+		taaTarget.view = VK_NULL_HANDLE;
+		taaTarget.image = VK_NULL_HANDLE;
+		taaTarget.mem = VK_NULL_HANDLE;
+	}
+
+	// Temporal anti-aliasing replaces the direct composition to the swap chain image
+	bool temporalAntiAliasingActive() const
+	{
+		return temporalAntiAliasing && taa && taa->isSupported();
+	}
+
+	// The anti-aliased composition target is window sized and recreated along with the swap chain frame buffers
+	void setupFrameBuffer()
+	{
+		VulkanExampleBase::setupFrameBuffer();
+		if (taaTarget.renderPass != VK_NULL_HANDLE)
+		{
+			destroyTemporalAntiAliasingTarget();
+			createTemporalAntiAliasingTarget();
+		}
+	}
+
 	// Put render commands for the scene into the given command buffer
 	void renderScene(VkCommandBuffer cmdBuffer, bool shadow)
 	{
@@ -308,62 +535,101 @@ public:
 		}
 
 		// Create a semaphore used to synchronize offscreen rendering and usage
-		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &offscreenSemaphore));
+		if (offscreenSemaphore == VK_NULL_HANDLE)
+		{
+			VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &offscreenSemaphore));
+		}
 
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-		std::array<VkClearValue, 4> clearValues = {};
+		std::array<VkClearValue, 5> clearValues = {};
 		VkViewport viewport;
 		VkRect2D scissor;
 
-		// First pass: Shadow map generation
-		// -------------------------------------------------------------------------------------------------------
-
-		clearValues[0].depthStencil = { 1.0f, 0 };
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffers.deferred, &cmdBufInfo));
 
-		renderPassBeginInfo.renderPass = frameBuffers.shadow->renderPass;
-		renderPassBeginInfo.framebuffer = frameBuffers.shadow->framebuffer;
-		renderPassBeginInfo.renderArea.extent.width = frameBuffers.shadow->width;
-		renderPassBeginInfo.renderArea.extent.height = frameBuffers.shadow->height;
-		renderPassBeginInfo.clearValueCount = 1;
-		renderPassBeginInfo.pClearValues = clearValues.data();
+		// First pass: Shadow atlas tiles of new and changed lights
+		// -------------------------------------------------------------------------------------------------------
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffers.deferred, &cmdBufInfo));
+		// Cached tiles are sampled as they are, so the pass is skipped if no tile needs to be rendered
+		if (!shadowTiles.empty())
+		{
+			renderPassBeginInfo.renderPass = frameBuffers.shadow->renderPass;
+			renderPassBeginInfo.framebuffer = frameBuffers.shadow->framebuffer;
+			renderPassBeginInfo.renderArea.extent.width = frameBuffers.shadow->width;
+			renderPassBeginInfo.renderArea.extent.height = frameBuffers.shadow->height;
+			renderPassBeginInfo.clearValueCount = 0;
+			renderPassBeginInfo.pClearValues = nullptr;
+
+			vkCmdBeginRenderPass(commandBuffers.deferred, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			// Only clear the tiles that are rendered, the others keep their cached shadow maps
+			VkClearAttachment clearAttachment{};
+			clearAttachment.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+			clearAttachment.clearValue.depthStencil = { 1.0f, 0 };
+			std::vector<VkClearRect> clearRects;
+			for (const vks::ShadowAtlas::Allocation &allocation : shadowTiles)
+			{
+				VkClearRect clearRect{};
+				clearRect.rect = vks::initializers::rect2D(allocation.tile.size, allocation.tile.size, allocation.tile.x, allocation.tile.y);
+				clearRect.layerCount = 1;
+				clearRects.push_back(clearRect);
+			}
+			vkCmdClearAttachments(commandBuffers.deferred, 1, &clearAttachment, static_cast<uint32_t>(clearRects.size()), clearRects.data());
 
-		viewport = vks::initializers::viewport((float)frameBuffers.shadow->width, (float)frameBuffers.shadow->height, 0.0f, 1.0f);
-		vkCmdSetViewport(commandBuffers.deferred, 0, 1, &viewport);
+			vkCmdBindPipeline(commandBuffers.deferred, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.shadowpass);
 
-		scissor = vks::initializers::rect2D(frameBuffers.shadow->width, frameBuffers.shadow->height, 0, 0);
-		vkCmdSetScissor(commandBuffers.deferred, 0, 1, &scissor);
+			// Set depth bias (aka "Polygon offset")
+			vkCmdSetDepthBias(
+				commandBuffers.deferred,
+				depthBiasConstant,
+				0.0f,
+				depthBiasSlope);
 
-		// Set depth bias (aka "Polygon offset")
-		vkCmdSetDepthBias(
-			commandBuffers.deferred,
-			depthBiasConstant,
-			0.0f,
-			depthBiasSlope);
+			// Each draw renders up to SHADOW_VIEWPORTS tiles, with one geometry shader invocation per tile
+			for (size_t first = 0; first < shadowTiles.size(); first += SHADOW_VIEWPORTS)
+			{
+				std::array<VkViewport, SHADOW_VIEWPORTS> viewports;
+				std::array<VkRect2D, SHADOW_VIEWPORTS> scissors;
+				ShadowPushConstants pushConstants{};
+				pushConstants.tileCount = static_cast<uint32_t>(std::min(shadowTiles.size() - first, static_cast<size_t>(SHADOW_VIEWPORTS)));
+				for (uint32_t i = 0; i < SHADOW_VIEWPORTS; i++)
+				{
+					// Viewports not used by this draw still need valid values
+					const vks::ShadowAtlas::Allocation &allocation = shadowTiles[first + std::min(i, pushConstants.tileCount - 1)];
+					viewports[i] = vks::initializers::viewport((float)allocation.tile.size, (float)allocation.tile.size, 0.0f, 1.0f);
+					viewports[i].x = (float)allocation.tile.x;
+					viewports[i].y = (float)allocation.tile.y;
+					scissors[i] = vks::initializers::rect2D(allocation.tile.size, allocation.tile.size, allocation.tile.x, allocation.tile.y);
+					pushConstants.lightIndex[i] = allocation.id;
+				}
+				vkCmdSetViewport(commandBuffers.deferred, 0, SHADOW_VIEWPORTS, viewports.data());
+				vkCmdSetScissor(commandBuffers.deferred, 0, SHADOW_VIEWPORTS, scissors.data());
+				vkCmdPushConstants(commandBuffers.deferred, pipelineLayout, VK_SHADER_STAGE_GEOMETRY_BIT, 0, sizeof(ShadowPushConstants), &pushConstants);
+				renderScene(commandBuffers.deferred, true);
+			}
 
-		vkCmdBeginRenderPass(commandBuffers.deferred, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(commandBuffers.deferred, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.shadowpass);
-		renderScene(commandBuffers.deferred, true);
-		vkCmdEndRenderPass(commandBuffers.deferred);
+			vkCmdEndRenderPass(commandBuffers.deferred);
+		}
 
 		// Second pass: Deferred calculations
 		// -------------------------------------------------------------------------------------------------------
 
-		// Clear values for all attachments written in the fragment shader
+		// Clear values for all attachments written in the fragment shader, depth is the last attachment
+		const uint32_t deferredAttachmentCount = static_cast<uint32_t>(frameBuffers.deferred->attachments.size());
 		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
 		clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
 		clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-		clearValues[3].depthStencil = { 1.0f, 0 };
+		clearValues[3].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		clearValues[deferredAttachmentCount - 1].depthStencil = { 1.0f, 0 };
 
 		renderPassBeginInfo.renderPass = frameBuffers.deferred->renderPass;
 		renderPassBeginInfo.framebuffer = frameBuffers.deferred->framebuffer;
 		renderPassBeginInfo.renderArea.extent.width = frameBuffers.deferred->width;
 		renderPassBeginInfo.renderArea.extent.height = frameBuffers.deferred->height;
-		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		renderPassBeginInfo.clearValueCount = deferredAttachmentCount;
 		renderPassBeginInfo.pClearValues = clearValues.data();
 
 		vkCmdBeginRenderPass(commandBuffers.deferred, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
@@ -409,6 +675,15 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
+		// The anti-aliased composition is rendered to its own target and resolved before being presented
+		VkRenderPassBeginInfo taaRenderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		taaRenderPassBeginInfo.renderPass = taaTarget.renderPass;
+		taaRenderPassBeginInfo.framebuffer = taaTarget.frameBuffer;
+		taaRenderPassBeginInfo.renderArea.extent.width = width;
+		taaRenderPassBeginInfo.renderArea.extent.height = height;
+
+		const bool resolveTemporal = temporalAntiAliasingActive();
+
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			// Set target frame buffer
@@ -416,19 +691,39 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+
+			if (resolveTemporal)
+			{
+				vkCmdBeginRenderPass(drawCmdBuffers[i], &taaRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.compositionTAA);
+				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+				taa->record(drawCmdBuffers[i]);
+			}
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-
-			// Final composition as full screen quad
+			if (resolveTemporal)
+			{
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, taaTarget.pipelineLayout, 0, 1, &taaTarget.descriptorSet, 0, nullptr);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.present);
+			}
+			else
+			{
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.deferred);
+			}
+			// Final composition (or the resolved image) as full screen quad
 			// Note: Also used for debug display if debugDisplayTarget > 0
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.deferred);
 			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
 			drawUI(drawCmdBuffers[i]);
@@ -451,7 +746,7 @@ public:
 			vks::initializers::descriptorPoolCreateInfo(
 				static_cast<uint32_t>(poolSizes.size()),
 				poolSizes.data(),
-				4);
+				5);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -477,8 +772,22 @@ public:
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
 		// Shared pipeline layout used by all pipelines
+		// The push constants select the atlas tiles rendered by the shadow pass geometry shader
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_GEOMETRY_BIT, sizeof(ShadowPushConstants), 0);
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		// Presenting the temporal anti-aliasing output
+		setLayoutBindings = {
+			// Binding 0: Resolved image
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &taaTarget.descriptorSetLayout));
+		pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&taaTarget.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &taaTarget.pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -486,23 +795,23 @@ public:
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 
-		// Image descriptors for the offscreen color attachments
+		// Image descriptors for the offscreen color attachments, attachment 3 is the depth attachment for the packed G-Buffer
 		VkDescriptorImageInfo texDescriptorPosition =
 			vks::initializers::descriptorImageInfo(
 				frameBuffers.deferred->sampler,
-				frameBuffers.deferred->attachments[0].view,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				frameBuffers.deferred->attachments[3].view,
+				packedGBuffer ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo texDescriptorNormal =
 			vks::initializers::descriptorImageInfo(
 				frameBuffers.deferred->sampler,
-				frameBuffers.deferred->attachments[1].view,
+				frameBuffers.deferred->attachments[0].view,
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo texDescriptorAlbedo =
 			vks::initializers::descriptorImageInfo(
 				frameBuffers.deferred->sampler,
-				frameBuffers.deferred->attachments[2].view,
+				frameBuffers.deferred->attachments[1].view,
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 		VkDescriptorImageInfo texDescriptorShadowMap =
@@ -527,6 +836,10 @@ public:
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
+		// Temporal anti-aliasing output, written along with the output image in createTemporalAntiAliasingTarget()
+		VkDescriptorSetAllocateInfo taaAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &taaTarget.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &taaAllocInfo, &taaTarget.descriptorSet));
+
 		// Offscreen (scene)
 
 		// Model
@@ -575,6 +888,10 @@ public:
 		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
 		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
 
+		// layout (constant_id = 0) const bool PACKED_GBUFFER
+		vks::SpecializationConstants<VkBool32> specializationConstants;
+		specializationConstants.set<0>(packedGBuffer ? VK_TRUE : VK_FALSE);
+
 		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass);
 		pipelineCI.pInputAssemblyState = &inputAssemblyState;
 		pipelineCI.pRasterizationState = &rasterizationState;
@@ -590,11 +907,23 @@ public:
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		shaderStages[0] = loadShader(getShadersPath() + "deferredshadows/deferred.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "deferredshadows/deferred.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[1].pSpecializationInfo = specializationConstants.getInfo();
 		// Empty vertex input state, vertices are generated by the vertex shader
 		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		pipelineCI.pVertexInputState = &emptyInputState;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.deferred));
 
+		// Same composition to the target resolved with temporal anti-aliasing
+		pipelineCI.renderPass = taaTarget.renderPass;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.compositionTAA));
+
+		// Presenting the resolved image
+		pipelineCI.renderPass = renderPass;
+		pipelineCI.layout = taaTarget.pipelineLayout;
+		shaderStages[1] = loadShader(getShadersPath() + "deferredshadows/present.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.present));
+		pipelineCI.layout = pipelineLayout;
+
 		// Vertex input state from glTF model for pipeline rendering models
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Tangent });
 		rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
@@ -606,22 +935,25 @@ public:
 		// Blend attachment states required for all color attachments
 		// This is important, as color write mask will otherwise be 0x0 and you
 		// won't see anything rendered to the attachment
-		std::array<VkPipelineColorBlendAttachmentState, 3> blendAttachmentStates =
+		std::array<VkPipelineColorBlendAttachmentState, 4> blendAttachmentStates =
 		{
+			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
 			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE)
 		};
-		colorBlendState.attachmentCount = static_cast<uint32_t>(blendAttachmentStates.size());
+		// The packed G-Buffer has no position attachment
+		colorBlendState.attachmentCount = packedGBuffer ? 3 : 4;
 		colorBlendState.pAttachments = blendAttachmentStates.data();
 
 		shaderStages[0] = loadShader(getShadersPath() + "deferredshadows/mrt.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "deferredshadows/mrt.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[1].pSpecializationInfo = specializationConstants.getInfo();
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
 
 		// Shadow mapping pipeline
 		// The shadow mapping pipeline uses geometry shader instancing (invocations layout modifier) to output
-		// shadow maps for multiple lights sources into the different shadow map layers in one single render pass
+		// shadow maps for multiple lights sources into the viewports of their atlas tiles in one single render pass
 		std::array<VkPipelineShaderStageCreateInfo, 2> shadowStages;
 		shadowStages[0] = loadShader(getShadersPath() + "deferredshadows/shadow.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shadowStages[1] = loadShader(getShadersPath() + "deferredshadows/shadow.geom.spv", VK_SHADER_STAGE_GEOMETRY_BIT);
@@ -640,6 +972,9 @@ public:
 		// Add depth bias to dynamic state, so we can change it at runtime
 		dynamicStateEnables.push_back(VK_DYNAMIC_STATE_DEPTH_BIAS);
 		dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		// One viewport per atlas tile rendered in a draw
+		viewportState.viewportCount = SHADOW_VIEWPORTS;
+		viewportState.scissorCount = SHADOW_VIEWPORTS;
 		// Reset blend attachment state
 		pipelineCI.renderPass = frameBuffers.shadow->renderPass;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.shadowpass));
@@ -684,37 +1019,49 @@ public:
 
 		// Update
 		updateUniformBufferOffscreen();
+		// Atlas tiles are assigned in render(), right before the shadow pass is recorded
+		updateLights();
 		updateUniformBufferDeferredLights();
 	}
 
 	void updateUniformBufferOffscreen()
 	{
-		uboOffscreenVS.projection = camera.matrices.perspective;
+		uboOffscreenVS.projection = camera.matrices.jitteredPerspective;
 		uboOffscreenVS.view = camera.matrices.view;
 		uboOffscreenVS.model = glm::mat4(1.0f);
+		uboOffscreenVS.viewProjection = camera.matrices.perspective * camera.matrices.view;
 		memcpy(uniformBuffers.offscreen.mapped, &uboOffscreenVS, sizeof(uboOffscreenVS));
 	}
 
-	Light initLight(glm::vec3 pos, glm::vec3 target, glm::vec3 color)
+	Light initLight(glm::vec3 pos, glm::vec3 target, glm::vec3 color, float range)
 	{
 		Light light;
 		light.position = glm::vec4(pos, 1.0f);
-		light.target = glm::vec4(target, 0.0f);
+		light.target = glm::vec4(target, range);
 		light.color = glm::vec4(color, 0.0f);
+		light.shadowRect = glm::vec4(0.0f);
 		return light;
 	}
 
 	void initLights()
 	{
-		uboComposition.lights[0] = initLight(glm::vec3(-14.0f, -0.5f, 15.0f), glm::vec3(-2.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.5f, 0.5f));
-		uboComposition.lights[1] = initLight(glm::vec3(14.0f, -4.0f, 12.0f), glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		uboComposition.lights[2] = initLight(glm::vec3(0.0f, -10.0f, 4.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f));
+		uboComposition.lights[0] = initLight(glm::vec3(-14.0f, -0.5f, 15.0f), glm::vec3(-2.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.5f, 0.5f), lightRange);
+		uboComposition.lights[1] = initLight(glm::vec3(14.0f, -4.0f, 12.0f), glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), lightRange);
+		uboComposition.lights[2] = initLight(glm::vec3(0.0f, -10.0f, 4.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), lightRange);
+		// Static short range lights spread over the scene, looking down at the floor
+		for (uint32_t i = 3; i < LIGHT_COUNT; i++)
+		{
+			const float angle = static_cast<float>(i) * 2.4f;
+			const float radius = 5.0f + static_cast<float>(i % 4) * 3.5f;
+			const glm::vec3 pos(sin(angle) * radius, -6.0f, cos(angle) * radius - 2.0f);
+			const glm::vec3 color(0.5f + 0.5f * cos(angle), 0.5f + 0.5f * cos(angle + 2.1f), 0.5f + 0.5f * cos(angle + 4.2f));
+			uboComposition.lights[i] = initLight(pos, pos + glm::vec3(0.0f, 6.0f, 1.5f), color, 14.0f);
+		}
 	}
 
-	// Update fragment shader light position uniform block
-	void updateUniformBufferDeferredLights()
+	// Animate the lights and update their shadow matrices
+	void updateLights()
 	{
-		// Animate
 		uboComposition.lights[0].position.x = -14.0f + std::abs(sin(glm::radians(timer * 360.0f)) * 20.0f);
 		uboComposition.lights[0].position.z = 15.0f + cos(glm::radians(timer *360.0f)) * 1.0f;
 
@@ -726,24 +1073,95 @@ public:
 
 		for (uint32_t i = 0; i < LIGHT_COUNT; i++)
 		{
-			// mvp from light's pov (for shadows)
-			glm::mat4 shadowProj = glm::perspective(glm::radians(lightFOV), 1.0f, zNear, zFar);
+			// mvp from light's pov (for shadows), the far plane doesn't need to be further away than the light's range
+			const float range = uboComposition.lights[i].target.w;
+			glm::mat4 shadowProj = glm::perspective(glm::radians(lightFOV), 1.0f, zNear, std::min(range, zFar));
 			glm::mat4 shadowView = glm::lookAt(glm::vec3(uboComposition.lights[i].position), glm::vec3(uboComposition.lights[i].target), glm::vec3(0.0f, 1.0f, 0.0f));
 			glm::mat4 shadowModel = glm::mat4(1.0f);
 
 			uboShadowGeometryShader.mvp[i] = shadowProj * shadowView * shadowModel;
 			uboComposition.lights[i].viewMatrix = uboShadowGeometryShader.mvp[i];
 		}
+	}
+
+	// Assign the atlas tiles for this frame and collect the tiles that need to be rendered
+	void updateShadowAtlas()
+	{
+		std::vector<vks::ShadowAtlas::Request> requests;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(lightCount); i++)
+		{
+			uboComposition.lights[i].shadowRect = glm::vec4(0.0f);
+			// Bounding sphere of the light's range along its direction
+			const glm::vec3 position = glm::vec3(uboComposition.lights[i].position);
+			const glm::vec3 direction = glm::normalize(glm::vec3(uboComposition.lights[i].target) - position);
+			const float range = uboComposition.lights[i].target.w;
+			const float coverage = vks::ShadowAtlas::getScreenCoverage(position + direction * range * 0.5f, range * 0.5f, camera.matrices.view, camera.matrices.perspective);
+			// Lights behind the camera don't need a shadow map this frame
+			if (coverage <= 0.0f)
+			{
+				continue;
+			}
+			const bool changed = !cacheShadowTiles || (uboShadowGeometryShader.mvp[i] != renderedShadowMatrices[i]);
+			requests.push_back({ i, shadowAtlas->getTileSize(coverage), changed });
+		}
+		for (uint32_t i = static_cast<uint32_t>(lightCount); i < LIGHT_COUNT; i++)
+		{
+			uboComposition.lights[i].shadowRect = glm::vec4(0.0f);
+		}
+
+		shadowTiles.clear();
+		for (const vks::ShadowAtlas::Allocation &allocation : shadowAtlas->update(requests))
+		{
+			if (allocation.tile.size == 0)
+			{
+				continue;
+			}
+			uboComposition.lights[allocation.id].shadowRect = vks::ShadowAtlas::getTileRect(allocation.tile, shadowAtlas->getAtlasSize());
+			if (allocation.render)
+			{
+				shadowTiles.push_back(allocation);
+				renderedShadowMatrices[allocation.id] = uboShadowGeometryShader.mvp[allocation.id];
+			}
+		}
+	}
 
+	// Update fragment shader light position uniform block
+	void updateUniformBufferDeferredLights()
+	{
 		memcpy(uboShadowGeometryShader.instancePos, uboOffscreenVS.instancePos, sizeof(uboOffscreenVS.instancePos));
 		memcpy(uniformBuffers.shadowGeometryShader.mapped, &uboShadowGeometryShader, sizeof(uboShadowGeometryShader));
 
 		uboComposition.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);;
+		// Positions are reconstructed from the jittered depth
+		uboComposition.invViewProjection = glm::inverse(camera.matrices.jitteredPerspective * camera.matrices.view);
 		uboComposition.debugDisplayTarget = debugDisplayTarget;
+		uboComposition.lightCount = lightCount;
 
 		memcpy(uniformBuffers.composition.mapped, &uboComposition, sizeof(uboComposition));
 	}
 
+	// Advance the jitter to the next frame's offset, called once per frame after submitting, the frame just submitted becomes the history of the next one
+	void updateTemporalAntiAliasing()
+	{
+		uboOffscreenVS.prevViewProjection = uboOffscreenVS.viewProjection;
+		camera.setJitter(Camera::jitterSequence(taaFrame++), frameBuffers.deferred->width, frameBuffers.deferred->height);
+		updateUniformBufferOffscreen();
+		// The whole G-Buffer is sampled, so the velocity needs no scale
+		taa->update(glm::vec2(1.0f), taaReset);
+		taaReset = false;
+	}
+
+	// Switch the jitter and the command buffers to the current anti-aliasing settings
+	void temporalAntiAliasingChanged()
+	{
+		taaReset = true;
+		camera.setJitter(glm::vec2(0.0f), frameBuffers.deferred->width, frameBuffers.deferred->height);
+		uboOffscreenVS.prevViewProjection = camera.matrices.perspective * camera.matrices.view;
+		updateUniformBufferOffscreen();
+		updateUniformBufferDeferredLights();
+		buildCommandBuffers();
+	}
+
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
@@ -760,7 +1178,7 @@ public:
 		// Shadow map pass
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffers.deferred;
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		// Scene rendering
 
@@ -771,23 +1189,48 @@ public:
 
 		// Submit work
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
 
+	// Recreate the G-Buffer and everything depending on its layout after switching between the full and the packed G-Buffer
+	void rebuildGBuffer()
+	{
+		vkDeviceWaitIdle(device);
+		delete frameBuffers.deferred;
+		deferredSetup();
+		vkDestroyPipeline(device, pipelines.deferred, nullptr);
+		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
+		vkDestroyPipeline(device, pipelines.shadowpass, nullptr);
+		vkDestroyPipeline(device, pipelines.compositionTAA, nullptr);
+		vkDestroyPipeline(device, pipelines.present, nullptr);
+		preparePipelines();
+		vkResetDescriptorPool(device, descriptorPool, 0);
+		setupDescriptorSet();
+		// The resolve reads the new velocity attachment
+		destroyTemporalAntiAliasingTarget();
+		createTemporalAntiAliasingTarget();
+		buildCommandBuffers();
+		buildDeferredCommandBuffer();
+	}
+
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
 		deferredSetup();
 		shadowSetup();
+		prepareTemporalAntiAliasingRenderPass();
 		initLights();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
+		taa.reset(new vks::TemporalAntiAliasing(vulkanDevice, getShadersPath() + "base/taa.comp.spv"));
+		taa->setSettings(taaSettings);
+		createTemporalAntiAliasingTarget();
 		buildCommandBuffers();
 		buildDeferredCommandBuffer();
 		prepared = true;
@@ -797,12 +1240,21 @@ public:
 	{
 		if (!prepared)
 			return;
-		draw();
-		updateUniformBufferDeferredLights();
 		if (camera.updated) 
 		{
 			updateUniformBufferOffscreen();
 		}
+		// The tiles to render change from frame to frame, so the shadow pass is recorded after assigning them
+		updateLights();
+		updateShadowAtlas();
+		updateUniformBufferDeferredLights();
+		buildDeferredCommandBuffer();
+		draw();
+		if (temporalAntiAliasingActive())
+		{
+			// Jitters the G-Buffer pass of the next frame, the composition uniforms follow it with the next updateUniformBufferDeferredLights()
+			updateTemporalAntiAliasing();
+		}
 	}
 
 	virtual void viewChanged()
@@ -822,6 +1274,26 @@ public:
 				uboComposition.useShadows = shadows;
 				updateUniformBufferDeferredLights();
 			}
+			if (overlay->checkBox("Packed G-Buffer", &packedGBuffer)) {
+				rebuildGBuffer();
+			}
+			if (taa->isSupported()) {
+				if (overlay->checkBox("Temporal anti-aliasing", &temporalAntiAliasing)) {
+					temporalAntiAliasingChanged();
+				}
+				if (temporalAntiAliasingActive() && overlay->sliderFloat("History feedback", &taaSettings.feedbackMax, 0.9f, 0.99f)) {
+					taaSettings.feedbackMin = std::min(taaSettings.feedbackMin, taaSettings.feedbackMax);
+					taa->setSettings(taaSettings);
+				}
+			}
+		}
+		if (overlay->header("Shadow atlas")) {
+			overlay->sliderInt("Lights", &lightCount, 3, LIGHT_COUNT);
+			overlay->checkBox("Cache static shadow tiles", &cacheShadowTiles);
+			const vks::ShadowAtlas::Statistics &statistics = shadowAtlas->getStatistics();
+			overlay->text("Tiles: %d (%d rendered, %d cached)", statistics.tileCount, statistics.renderedTiles, statistics.cachedTiles);
+			overlay->text("Lights without tile: %d", statistics.droppedLights);
+			overlay->text("Atlas usage: %.1f%% of %dx%d", statistics.usage * 100.0f, SHADOW_ATLAS_DIM, SHADOW_ATLAS_DIM);
 		}
 	}
 };
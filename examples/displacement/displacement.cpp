@@ -8,6 +8,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "frustum.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -20,6 +21,9 @@ private:
 public:
 	bool splitScreen = true;
 	bool displacement = true;
+	// Derive the tessellation factors from the projected edge lengths instead of using a fixed level
+	bool adaptiveTessellation = false;
+	bool frustumCulling = true;
 
 	vkglTF::Model plane;
 
@@ -28,7 +32,17 @@ public:
 	} uniformBuffers;
 
 	struct UBOTessControl {
+		glm::mat4 projection;
+		glm::mat4 modelView;
+		glm::vec4 frustumPlanes[6];
+		glm::vec2 viewportDim;
 		float tessLevel = 64.0f;
+		// Desired edge length of the generated triangles in pixels
+		float targetEdgeSize = 8.0f;
+		// Maximum displacement along the normal, enlarges the culling bounds of the patches
+		float tessStrength;
+		int32_t adaptive;
+		int32_t frustumCulling;
 	} uboTessControl;
 
 	struct UBOTessEval {
@@ -48,6 +62,14 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	// View frustum passed to the tessellation control shader for culling
+	vks::Frustum frustum;
+
+	// Pipeline statistics of the solid draw
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	// Primitives generated by the tessellator (clipping invocations), patches and evaluation shader invocations, in the order of the statistic bits
+	uint64_t pipelineStats[3] = { 0 };
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Tessellation shader displacement";
@@ -69,6 +91,10 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
+		if (queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, queryPool, nullptr);
+		}
+
 		uniformBuffers.tessControl.destroy();
 		uniformBuffers.tessEval.destroy();
 		textures.colorHeightMap.destroy();
@@ -91,6 +117,29 @@ public:
 		else {
 			splitScreen = false;
 		}
+		// Pipeline statistics are used to display the number of generated primitives
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			enabledFeatures.pipelineStatisticsQuery = VK_TRUE;
+		}
+	}
+
+	void setupQueryPool()
+	{
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+		queryPoolInfo.pipelineStatistics =
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_CONTROL_SHADER_PATCHES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT;
+		queryPoolInfo.queryCount = 1;
+		VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, NULL, &queryPool));
+	}
+
+	// Retrieves the results of the pipeline statistics query submitted to the command buffer
+	void getQueryResults()
+	{
+		vkGetQueryPoolResults(device, queryPool, 0, 1, sizeof(pipelineStats), pipelineStats, sizeof(pipelineStats), VK_QUERY_RESULT_64_BIT);
 	}
 
 	void loadAssets()
@@ -124,6 +173,10 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				vkCmdResetQueryPool(drawCmdBuffers[i], queryPool, 0, 1);
+			}
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -147,7 +200,13 @@ public:
 			}
 
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.solid);
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 0, 0);
+			}
 			plane.draw(drawCmdBuffers[i]);
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				vkCmdEndQuery(drawCmdBuffers[i], queryPool, 0);
+			}
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -335,6 +394,15 @@ public:
 		memcpy(uniformBuffers.tessEval.mapped, &uboTessEval, sizeof(uboTessEval));
 
 		// Tessellation control
+		uboTessControl.projection = camera.matrices.perspective;
+		uboTessControl.modelView = camera.matrices.view;
+		uboTessControl.viewportDim = glm::vec2((float)width, (float)height);
+		uboTessControl.tessStrength = uboTessEval.tessStrength;
+		uboTessControl.adaptive = (adaptiveTessellation && displacement) ? 1 : 0;
+		uboTessControl.frustumCulling = frustumCulling ? 1 : 0;
+		frustum.update(uboTessControl.projection * uboTessControl.modelView);
+		memcpy(uboTessControl.frustumPlanes, frustum.planes.data(), sizeof(glm::vec4) * 6);
+
 		float savedLevel = uboTessControl.tessLevel;
 		if (!displacement)
 		{
@@ -358,7 +426,12 @@ public:
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			// Read query results for displaying in next frame
+			getQueryResults();
+		}
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -367,6 +440,9 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			setupQueryPool();
+		}
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -400,7 +476,21 @@ public:
 			if (overlay->inputFloat("Strength", &uboTessEval.tessStrength, 0.025f, 3)) {
 				updateUniformBuffers();
 			}
-			if (overlay->inputFloat("Level", &uboTessControl.tessLevel, 0.5f, 2)) {
+			if (overlay->checkBox("Screen space tessellation", &adaptiveTessellation)) {
+				updateUniformBuffers();
+			}
+			if (adaptiveTessellation) {
+				if (overlay->inputFloat("Triangle size (px)", &uboTessControl.targetEdgeSize, 1.0f, 1)) {
+					uboTessControl.targetEdgeSize = std::max(uboTessControl.targetEdgeSize, 1.0f);
+					updateUniformBuffers();
+				}
+			}
+			else {
+				if (overlay->inputFloat("Level", &uboTessControl.tessLevel, 0.5f, 2)) {
+					updateUniformBuffers();
+				}
+			}
+			if (overlay->checkBox("Frustum culling", &frustumCulling)) {
 				updateUniformBuffers();
 			}
 			if (deviceFeatures.fillModeNonSolid) {
@@ -411,6 +501,13 @@ public:
 			}
 
 		}
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			if (overlay->header("Pipeline statistics")) {
+				overlay->text("Patches: %d", pipelineStats[1]);
+				overlay->text("TE invocations: %d", pipelineStats[2]);
+				overlay->text("Primitives: %d", pipelineStats[0]);
+			}
+		}
 	}
 };
 
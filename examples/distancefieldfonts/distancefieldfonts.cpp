@@ -3,12 +3,16 @@
 *
 * Font generated using https://github.com/libgdx/libgdx/wiki/Hiero
 *
+* Alternatively the distance field atlas is built at runtime from a TrueType font with vks::SDFFontAtlas (jump flood distance transform
+* in compute shaders), generating the glyphs of the displayed text on demand
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanSDFFontAtlas.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -17,6 +21,8 @@
 struct Vertex {
 	float pos[3];
 	float uv[2];
+	// Array layer of the runtime atlas, unused by the prebaked atlas
+	float page;
 };
 
 // AngelCode .fnt format structs and classes
@@ -49,6 +55,23 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool splitScreen = true;
 
+	// 0 = prebaked atlas (font.fnt / font_sdf_rgba.ktx), 1 = atlas generated at runtime
+	int32_t fontSource = 0;
+	std::unique_ptr<vks::SDFFontAtlas> fontAtlas;
+	int32_t textIndex = 0;
+	bool cycleTexts = false;
+	float cycleTimer = 0.0f;
+	const std::vector<std::string> texts = {
+		u8"Vulkan",
+		u8"Gr\u00f6\u00dfen\u00e4nderung",
+		u8"\u039a\u03b1\u03bb\u03b7\u03bc\u03ad\u03c1\u03b1 \u03ba\u03cc\u03c3\u03bc\u03b5",
+		u8"\u0421\u044a\u0435\u0448\u044c \u0436\u0435 \u0435\u0449\u0451",
+		u8"Sphinx of black quartz",
+		u8"Fran\u00e7ais, Espa\u00f1ol, Portugu\u00eas",
+	};
+	// The UI font only covers latin characters
+	const std::vector<std::string> textNames = { "Vulkan", "German", "Greek", "Russian", "Pangram", "Accents" };
+
 	struct {
 		vks::Texture2D fontSDF;
 		vks::Texture2D fontBitmap;
@@ -64,6 +87,13 @@ public:
 	vks::Buffer indexBuffer;
 	uint32_t indexCount;
 
+	// Text laid out with the glyphs of the runtime atlas
+	struct {
+		vks::Buffer vertexBuffer;
+		vks::Buffer indexBuffer;
+		uint32_t indexCount = 0;
+	} atlasText;
+
 	struct {
 		vks::Buffer vs;
 		vks::Buffer fs;
@@ -82,11 +112,13 @@ public:
 
 	struct {
 		VkPipeline sdf;
+		VkPipeline sdfAtlas;
 		VkPipeline bitmap;
 	} pipelines;
 
 	struct {
 		VkDescriptorSet sdf;
+		VkDescriptorSet sdfAtlas;
 		VkDescriptorSet bitmap;
 	} descriptorSets;
 
@@ -112,6 +144,7 @@ public:
 		textures.fontBitmap.destroy();
 
 		vkDestroyPipeline(device, pipelines.sdf, nullptr);
+		vkDestroyPipeline(device, pipelines.sdfAtlas, nullptr);
 		vkDestroyPipeline(device, pipelines.bitmap, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
@@ -119,6 +152,9 @@ public:
 
 		vertexBuffer.destroy();
 		indexBuffer.destroy();
+		atlasText.vertexBuffer.destroy();
+		atlasText.indexBuffer.destroy();
+		fontAtlas.reset();
 
 		uniformBuffers.vs.destroy();
 		uniformBuffers.fs.destroy();
@@ -185,6 +221,12 @@ public:
 	{
 		textures.fontSDF.loadFromFile(getAssetPath() + "textures/font_sdf_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 		textures.fontBitmap.loadFromFile(getAssetPath() + "textures/font_bitmap_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
+		// Same size as the prebaked font, with a small atlas so cycling through the texts evicts pages
+		vks::SDFFontAtlas::Settings atlasSettings;
+		atlasSettings.fontSize = 36.0f;
+		atlasSettings.pageDim = 256;
+		atlasSettings.pageCount = 2;
+		fontAtlas.reset(new vks::SDFFontAtlas(vulkanDevice, queue, getShadersPath(), getAssetPath() + "Roboto-Medium.ttf", atlasSettings));
 	}
 
 	void buildCommandBuffers()
@@ -221,19 +263,32 @@ public:
 			VkDeviceSize offsets[1] = { 0 };
 
 			// Signed distance field font
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.sdf, 0, NULL);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.sdf);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &vertexBuffer.buffer, offsets);
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdDrawIndexed(drawCmdBuffers[i], indexCount, 1, 0, 0, 0);
+			if (fontSource == 0)
+			{
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.sdf, 0, NULL);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.sdf);
+			}
+			else
+			{
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.sdfAtlas, 0, NULL);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.sdfAtlas);
+			}
+			if ((fontSource == 0) || (atlasText.indexCount > 0))
+			{
+				vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, (fontSource == 0) ? &vertexBuffer.buffer : &atlasText.vertexBuffer.buffer, offsets);
+				vkCmdBindIndexBuffer(drawCmdBuffers[i], (fontSource == 0) ? indexBuffer.buffer : atlasText.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+				vkCmdDrawIndexed(drawCmdBuffers[i], (fontSource == 0) ? indexCount : atlasText.indexCount, 1, 0, 0, 0);
+			}
 
-			// Linear filtered bitmap font
+			// Linear filtered bitmap font (only available for the prebaked text)
 			if (splitScreen)
 			{
 				viewport.y = (float)height / 2.0f;
 				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.bitmap, 0, NULL);
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.bitmap);
+				vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &vertexBuffer.buffer, offsets);
+				vkCmdBindIndexBuffer(drawCmdBuffers[i], indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
 				vkCmdDrawIndexed(drawCmdBuffers[i], indexCount, 1, 0, 0, 0);
 			}
 
@@ -279,10 +334,10 @@ public:
 
 			posy = yo;
 
-			vertices.push_back({ { posx + dimx + xo,  posy + dimy, 0.0f }, { ue, te } });
-			vertices.push_back({ { posx + xo,         posy + dimy, 0.0f }, { us, te } });
-			vertices.push_back({ { posx + xo,         posy,        0.0f }, { us, ts } });
-			vertices.push_back({ { posx + dimx + xo,  posy,        0.0f }, { ue, ts } });
+			vertices.push_back({ { posx + dimx + xo,  posy + dimy, 0.0f }, { ue, te }, 0.0f });
+			vertices.push_back({ { posx + xo,         posy + dimy, 0.0f }, { us, te }, 0.0f });
+			vertices.push_back({ { posx + xo,         posy,        0.0f }, { us, ts }, 0.0f });
+			vertices.push_back({ { posx + dimx + xo,  posy,        0.0f }, { ue, ts }, 0.0f });
 
 			std::array<uint32_t, 6> letterIndices = { 0,1,2, 2,3,0 };
 			for (auto& index : letterIndices)
@@ -320,6 +375,94 @@ public:
 			indices.data()));
 	}
 
+	// Lays out the passed utf-8 text with the glyphs of the runtime atlas, generating the missing ones
+	void generateAtlasText(const std::string &text)
+	{
+		if (!fontAtlas->request(text))
+		{
+			std::cerr << "Not all glyphs of \"" << text << "\" fit into the font atlas\n";
+		}
+
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		uint32_t indexOffset = 0;
+
+		// Atlas texels are scaled by the font size, like the prebaked font
+		const float scale = 1.0f / fontAtlas->getSettings().fontSize;
+		const float ascent = fontAtlas->getAscent();
+		float posx = 0.0f;
+		uint32_t previous = 0;
+
+		for (uint32_t codepoint : vks::SDFFontAtlas::decodeUTF8(text))
+		{
+			const vks::SDFFontAtlas::Glyph *glyph = fontAtlas->getGlyph(codepoint);
+			if (!glyph)
+			{
+				continue;
+			}
+			if (previous != 0)
+			{
+				posx += fontAtlas->getKerning(previous, codepoint) * scale;
+			}
+			previous = codepoint;
+
+			if (glyph->size.x > 0.0f)
+			{
+				const float x0 = posx + glyph->offset.x * scale;
+				const float x1 = x0 + glyph->size.x * scale;
+				const float y0 = (ascent + glyph->offset.y) * scale;
+				const float y1 = y0 + glyph->size.y * scale;
+				const float page = static_cast<float>(glyph->page);
+
+				vertices.push_back({ { x1, y1, 0.0f }, { glyph->uv.z, glyph->uv.w }, page });
+				vertices.push_back({ { x0, y1, 0.0f }, { glyph->uv.x, glyph->uv.w }, page });
+				vertices.push_back({ { x0, y0, 0.0f }, { glyph->uv.x, glyph->uv.y }, page });
+				vertices.push_back({ { x1, y0, 0.0f }, { glyph->uv.z, glyph->uv.y }, page });
+
+				std::array<uint32_t, 6> letterIndices = { 0,1,2, 2,3,0 };
+				for (auto& index : letterIndices)
+				{
+					indices.push_back(indexOffset + index);
+				}
+				indexOffset += 4;
+			}
+
+			posx += glyph->advance * scale;
+		}
+
+		// Center and shrink longer texts to about the width of the prebaked one
+		const float fit = std::min(1.0f, 4.0f / std::max(posx, 1.0f));
+		for (auto& v : vertices)
+		{
+			v.pos[0] = (v.pos[0] - posx / 2.0f) * fit;
+			v.pos[1] = (v.pos[1] - 0.5f) * fit;
+		}
+
+		// The buffers of the previous text may still be in use
+		vkDeviceWaitIdle(device);
+		atlasText.vertexBuffer.destroy();
+		atlasText.indexBuffer.destroy();
+		atlasText.indexCount = static_cast<uint32_t>(indices.size());
+		if (atlasText.indexCount == 0)
+		{
+			return;
+		}
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&atlasText.vertexBuffer,
+			vertices.size() * sizeof(Vertex),
+			vertices.data()));
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&atlasText.indexBuffer,
+			indices.size() * sizeof(uint32_t),
+			indices.data()));
+	}
+
 	void setupVertexDescriptions()
 	{
 		// Binding description
@@ -332,7 +475,7 @@ public:
 
 		// Attribute descriptions
 		// Describes memory layout and shader positions
-		vertices.attributeDescriptions.resize(2);
+		vertices.attributeDescriptions.resize(3);
 		// Location 0 : Position
 		vertices.attributeDescriptions[0] =
 			vks::initializers::vertexInputAttributeDescription(
@@ -347,6 +490,13 @@ public:
 				1,
 				VK_FORMAT_R32G32_SFLOAT,
 				sizeof(float) * 3);
+		// Location 2 : Atlas page
+		vertices.attributeDescriptions[2] =
+			vks::initializers::vertexInputAttributeDescription(
+				VERTEX_BUFFER_BIND_ID,
+				2,
+				VK_FORMAT_R32_SFLOAT,
+				sizeof(float) * 5);
 
 		vertices.inputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		vertices.inputState.vertexBindingDescriptionCount = vertices.bindingDescriptions.size();
@@ -359,15 +509,15 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 6),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				poolSizes.size(),
 				poolSizes.data(),
-				2);
+				3);
 
 		VkResult vkRes = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
 		assert(!vkRes);
@@ -451,6 +601,35 @@ public:
 
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 
+		// Runtime atlas descriptor set
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.sdfAtlas));
+
+		VkDescriptorImageInfo atlasDescriptor = fontAtlas->getTexture().descriptor;
+
+		writeDescriptorSets =
+		{
+			// Binding 0 : Vertex shader uniform buffer
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.sdfAtlas,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				0,
+				&uniformBuffers.vs.descriptor),
+			// Binding 1 : Fragment shader atlas sampler
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.sdfAtlas,
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				1,
+				&atlasDescriptor),
+			// Binding 2 : Fragment shader uniform buffer
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.sdfAtlas,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				2,
+				&uniformBuffers.fs.descriptor)
+		};
+
+		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+
 		// Default font rendering descriptor set
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.bitmap));
 
@@ -560,6 +739,11 @@ public:
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.sdf));
 
+		// Signed distance field font rendering pipeline for the runtime atlas
+		shaderStages[0] = loadShader(getShadersPath() + "distancefieldfonts/sdfatlas.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "distancefieldfonts/sdfatlas.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.sdfAtlas));
+
 		// Default bitmap font rendering pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "distancefieldfonts/bitmap.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "distancefieldfonts/bitmap.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
@@ -613,7 +797,7 @@ public:
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -624,6 +808,7 @@ public:
 		parsebmFont();
 		loadAssets();
 		generateText("Vulkan");
+		generateAtlasText(texts[textIndex]);
 		setupVertexDescriptions();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
@@ -638,6 +823,18 @@ public:
 	{
 		if (!prepared)
 			return;
+		// Cycling through the texts of different scripts keeps requesting new glyphs, evicting the least recently used atlas pages
+		if ((fontSource == 1) && cycleTexts && !paused)
+		{
+			cycleTimer += frameTimer;
+			if (cycleTimer > 2.0f)
+			{
+				cycleTimer = 0.0f;
+				textIndex = (textIndex + 1) % static_cast<int32_t>(texts.size());
+				generateAtlasText(texts[textIndex]);
+				buildCommandBuffers();
+			}
+		}
 		draw();
 	}
 
@@ -660,6 +857,21 @@ public:
 				buildCommandBuffers();
 				updateUniformBuffers();
 			}
+			if (overlay->comboBox("Font atlas", &fontSource, { "Prebaked", "Runtime" })) {
+				buildCommandBuffers();
+			}
+		}
+		if ((fontSource == 1) && overlay->header("Runtime atlas")) {
+			if (overlay->comboBox("Text", &textIndex, textNames)) {
+				generateAtlasText(texts[textIndex]);
+				buildCommandBuffers();
+			}
+			overlay->checkBox("Cycle texts", &cycleTexts);
+			const vks::SDFFontAtlas::Statistics &statistics = fontAtlas->getStatistics();
+			overlay->text("Resident glyphs: %d", statistics.residentGlyphs);
+			overlay->text("Generated glyphs: %d", statistics.generatedGlyphs);
+			overlay->text("Evicted pages: %d", statistics.evictedPages);
+			overlay->text("Last generation: %.2f ms", statistics.generationTime);
 		}
 	}
 };
@@ -6,6 +6,7 @@
  * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
  */
 
+#include <chrono>
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
 
@@ -14,12 +15,13 @@
 class VulkanExample : public VulkanExampleBase
 {
 public:
-	PFN_vkCmdBeginRenderingKHR vkCmdBeginRenderingKHR;
-	PFN_vkCmdEndRenderingKHR vkCmdEndRenderingKHR;
-
-	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeaturesKHR{};
-
 	vkglTF::Model model;
+	/*
+		With --lazyloading the model is parsed in the background and its images are decoded after the upload (vkglTF::FileLoadingFlags::LazyImages),
+		so the first frames are rendered without the model, which is then drawn with placeholder textures until its images have been swapped in
+	*/
+	std::future<void> modelLoading;
+	bool modelReady = false;
 
 	struct UniformData {
 		glm::mat4 projection;
@@ -28,52 +30,68 @@ public:
 	} uniformData;
 	vks::Buffer uniformBuffer;
 
-	VkPipeline pipeline;
-	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	/*
+		With VK_KHR_push_descriptor the model's material images can be pushed into the command buffer (vkglTF::RenderFlags::UsePushDescriptors)
+		instead of binding a descriptor set per material, which needs a pipeline layout with the model's push descriptor layout at set 1
+	*/
+	bool pushDescriptorsSupported = false;
+	bool usePushDescriptors = false;
+	VkPipeline pushDescriptorPipeline = VK_NULL_HANDLE;
+	VkPipelineLayout pushDescriptorPipelineLayout = VK_NULL_HANDLE;
+	// CPU time for recording the model's draws with descriptor sets [0] and push descriptors [1]
+	struct RecordingTimes {
+		double total[2] = { 0.0, 0.0 };
+		uint32_t count[2] = { 0, 0 };
+		double last[2] = { 0.0, 0.0 };
+	} recordingTimes;
+	uint32_t benchmarkFrame = 0;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Dynamic rendering";
+		supportsFramesInFlight = true;
 		camera.type = Camera::CameraType::lookat;
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -10.0f));
 		camera.setRotation(glm::vec3(-7.5f, 72.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
 
-		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
-
-		enabledDeviceExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
-		
-		// Since we are not requiring Vulkan 1.2, we need to enable some additional extensios as required per the spec
-		enabledDeviceExtensions.push_back(VK_KHR_MAINTENANCE2_EXTENSION_NAME);
-		enabledDeviceExtensions.push_back(VK_KHR_MULTIVIEW_EXTENSION_NAME);
-		enabledDeviceExtensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
-		enabledDeviceExtensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
-
+		// The base class enables VK_KHR_dynamic_rendering (and the extensions it requires without Vulkan 1.2) and skips
+		// the creation of the render pass and frame buffers, which also makes window resizes cheaper
+		settings.dynamicRendering = true;
 	}
 
 	~VulkanExample()
 	{
+		if (benchmark.active) {
+			const char* names[2] = { "Descriptor sets", "Push descriptors" };
+			std::cout << "Model draw recording (CPU):" << std::endl;
+			for (uint32_t i = 0; i < 2; i++) {
+				if (recordingTimes.count[i] > 0) {
+					std::cout << "	" << names[i] << ": " << std::fixed << std::setprecision(3) << recordingTimes.total[i] / recordingTimes.count[i] << " ms (" << recordingTimes.count[i] << " frames)" << std::endl;
+				}
+			}
+		}
 		if (device) {
+			// Finish a background load before the model is destroyed
+			if (modelLoading.valid()) {
+				modelLoading.wait();
+			}
 			vkDestroyPipeline(device, pipeline, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			if (pushDescriptorPipeline != VK_NULL_HANDLE) {
+				vkDestroyPipeline(device, pushDescriptorPipeline, nullptr);
+				vkDestroyPipelineLayout(device, pushDescriptorPipelineLayout, nullptr);
+			}
 			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 			uniformBuffer.destroy();
 		}
 	}
 
-	void setupRenderPass()
-	{
-		// With VK_KHR_dynamic_rendering we no longer need a render pass, so skip the sample base render pass setup
-		renderPass = VK_NULL_HANDLE;
-	}
-
-	void setupFrameBuffer()
-	{
-		// With VK_KHR_dynamic_rendering we no longer need a frame buffer, so skip the sample base framebuffer setup
-	}
-
 	// Enable physical device features required for this example
 	virtual void getEnabledFeatures()
 	{
@@ -81,109 +99,101 @@ public:
 		if (deviceFeatures.samplerAnisotropy) {
 			enabledFeatures.samplerAnisotropy = VK_TRUE;
 		};
+	}
 
-		dynamicRenderingFeaturesKHR.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
-		dynamicRenderingFeaturesKHR.dynamicRendering = VK_TRUE;
-
-		deviceCreatepNextChain = &dynamicRenderingFeaturesKHR;
+	virtual void getEnabledExtensions()
+	{
+		pushDescriptorsSupported = vulkanDevice->extensionSupported(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+		if (pushDescriptorsSupported) {
+			enabledDeviceExtensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+		}
 	}
 
 	void loadAssets()
 	{
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
+		if (settings.lazyLoading) {
+			modelLoading = model.loadFromFileAsync(getAssetPath() + "models/voyager.gltf", vulkanDevice, glTFLoadingFlags | vkglTF::FileLoadingFlags::LazyImages);
+			return;
+		}
 		model.loadFromFile(getAssetPath() + "models/voyager.gltf", vulkanDevice, queue, glTFLoadingFlags);
+		prepareModel();
 	}
 
-	void buildCommandBuffers()
+	// The pipelines use the model's descriptor set layouts, so they are created once the model has been uploaded
+	void prepareModel()
+	{
+		if (pushDescriptorsSupported) {
+			// Descriptor sets are still allocated (no FileLoadingFlags::PushDescriptors), so both ways can be compared
+			pushDescriptorsSupported = model.preparePushDescriptors();
+			// The vertices are pre-transformed, the shaders don't read the node data
+			model.pushDescriptors.nodeDataStages = 0;
+		}
+		setupPipelineLayouts();
+		preparePipelines();
+		modelReady = true;
+	}
+
+	// Uploads the model once the background load has parsed it and swaps in its images once they have been decoded
+	void updateLazyLoading()
+	{
+		if (modelLoading.valid() && (modelLoading.wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+			modelLoading.get();
+			model.finishLoading(queue);
+			prepareModel();
+			vulkanDevice->queueWaitIdle(queue);
+			buildCommandBuffers();
+		}
+		else if (modelReady && model.updateLazyImages(queue)) {
+			vulkanDevice->queueWaitIdle(queue);
+			buildCommandBuffers();
+		}
+	}
+
+	void recordCommandBuffer(uint32_t index, bool pushDescriptors)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VkCommandBuffer commandBuffer = drawCmdBuffers[index];
 
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+		// Begin dynamic rendering
+		// The base class transitions the swapchain and depth images and passes them as attachments to vkCmdBeginRenderingKHR
+		beginSwapchainRendering(commandBuffer, index);
+
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		// Only the UI is drawn while the model is being loaded in the background
+		if (modelReady) {
+			auto tStart = std::chrono::high_resolution_clock::now();
+			const VkPipelineLayout modelPipelineLayout = pushDescriptors ? pushDescriptorPipelineLayout : pipelineLayout;
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, modelPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pushDescriptors ? pushDescriptorPipeline : pipeline);
+
+			model.draw(commandBuffer, vkglTF::RenderFlags::BindImages | (pushDescriptors ? vkglTF::RenderFlags::UsePushDescriptors : 0), modelPipelineLayout);
+			const double recordingTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			recordingTimes.total[pushDescriptors ? 1 : 0] += recordingTime;
+			recordingTimes.count[pushDescriptors ? 1 : 0]++;
+			recordingTimes.last[pushDescriptors ? 1 : 0] = recordingTime;
+		}
+
+		drawUI(commandBuffer);
+
+		// End dynamic rendering and transition the color image for presentation
+		endSwapchainRendering(commandBuffer, index);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	void buildCommandBuffers()
+	{
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-
-			// Transition color and depth images for drawing
-			vks::tools::insertImageMemoryBarrier(
-				drawCmdBuffers[i],
-				swapChain.buffers[i].image,
-				0,
-				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-				VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-			vks::tools::insertImageMemoryBarrier(
-				drawCmdBuffers[i],
-				depthStencil.image,
-				0,
-				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED,
-                                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-				VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
-				VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
-				VkImageSubresourceRange{ VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, 0, 1, 0, 1 });
-
-			// New structures are used to define the attachments used in dynamic rendering
-			VkRenderingAttachmentInfoKHR colorAttachment{};
-			colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
-			colorAttachment.imageView = swapChain.buffers[i].view;
-			colorAttachment.imageLayout = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL_KHR;
-			colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			colorAttachment.clearValue.color = { 0.0f,0.0f,0.0f,0.0f };
-
-			// A single depth stencil attachment info can be used, but they can also be specified separately.
-			// When both are specified separately, the only requirement is that the image view is identical.			
-			VkRenderingAttachmentInfoKHR depthStencilAttachment{};
-			depthStencilAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
-			depthStencilAttachment.imageView = depthStencil.view;
-			depthStencilAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-			depthStencilAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			depthStencilAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			depthStencilAttachment.clearValue.depthStencil = { 1.0f,  0 };
-
-			VkRenderingInfoKHR renderingInfo{};
-			renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
-			renderingInfo.renderArea = { 0, 0, width, height };
-			renderingInfo.layerCount = 1;
-			renderingInfo.colorAttachmentCount = 1;
-			renderingInfo.pColorAttachments = &colorAttachment;
-			renderingInfo.pDepthAttachment = &depthStencilAttachment;
-			renderingInfo.pStencilAttachment = &depthStencilAttachment;
-
-			// Begin dynamic rendering
-			vkCmdBeginRenderingKHR(drawCmdBuffers[i], &renderingInfo);
-
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-
-			model.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayout);
-			
-			drawUI(drawCmdBuffers[i]);
-
-			// End dynamic rendering
-			vkCmdEndRenderingKHR(drawCmdBuffers[i]);
-
-			// Transition color image for presentation
-			vks::tools::insertImageMemoryBarrier(
-				drawCmdBuffers[i],
-				swapChain.buffers[i].image,
-				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-				0,
-				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-				VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-				VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+			recordCommandBuffer(i, usePushDescriptors);
 		}
 	}
 
@@ -192,7 +202,7 @@ public:
 		VulkanExampleBase::prepareFrame();
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -215,7 +225,10 @@ public:
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+	}
 
+	void setupPipelineLayouts()
+	{
 		// Layout uses set 0 for passing vertex shader ubo and set 1 for fragment shader images (taken from glTF model)
 		const std::vector<VkDescriptorSetLayout> setLayouts = {
 			descriptorSetLayout,
@@ -223,6 +236,16 @@ public:
 		};
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), 2);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		// Same bindings, but the images are pushed instead of bound as a descriptor set
+		if (pushDescriptorsSupported) {
+			const std::vector<VkDescriptorSetLayout> pushSetLayouts = {
+				descriptorSetLayout,
+				model.pushDescriptors.materialLayout,
+			};
+			pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(pushSetLayouts.data(), 2);
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pushDescriptorPipelineLayout));
+		}
 	}
 
 	void setupDescriptorSet()
@@ -249,9 +272,7 @@ public:
 		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
 		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
 
-		// We no longer need to set a renderpass for the pipeline create info
-		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo();
-		pipelineCI.layout = pipelineLayout;
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass);
 		pipelineCI.pInputAssemblyState = &inputAssemblyState;
 		pipelineCI.pRasterizationState = &rasterizationState;
 		pipelineCI.pColorBlendState = &colorBlendState;
@@ -263,19 +284,19 @@ public:
 		pipelineCI.pStages = shaderStages.data();
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV });
 
-		// New create info to define color, depth and stencil attachments at pipeline create time
-		VkPipelineRenderingCreateInfoKHR pipelineRenderingCreateInfo{};
-		pipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
-		pipelineRenderingCreateInfo.colorAttachmentCount = 1;
-		pipelineRenderingCreateInfo.pColorAttachmentFormats = &swapChain.colorFormat;
-		pipelineRenderingCreateInfo.depthAttachmentFormat = depthFormat;
-		pipelineRenderingCreateInfo.stencilAttachmentFormat = depthFormat;
-		// Chain into the pipeline creat einfo
-		pipelineCI.pNext = &pipelineRenderingCreateInfo;
+		// We no longer need a render pass for the pipeline, instead the color, depth and stencil attachment formats are
+		// defined at pipeline create time with a VkPipelineRenderingCreateInfoKHR chained into the pipeline create info
+		setupPipelineRendering(pipelineCI);
 
 		shaderStages[0] = loadShader(getShadersPath() + "dynamicrendering/texture.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "dynamicrendering/texture.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+
+		// The set 1 layouts differ, so the layouts aren't compatible and the push descriptor path needs a pipeline of its own
+		if (pushDescriptorsSupported) {
+			pipelineCI.layout = pushDescriptorPipelineLayout;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pushDescriptorPipeline));
+		}
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -299,13 +320,9 @@ public:
 	{
 		VulkanExampleBase::prepare();
 
-		vkCmdBeginRenderingKHR = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
-		vkCmdEndRenderingKHR = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
-
+		setupDescriptorSetLayout();
 		loadAssets();
 		prepareUniformBuffers();
-		setupDescriptorSetLayout();
-		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
 		buildCommandBuffers();
@@ -316,13 +333,41 @@ public:
 	{
 		if (!prepared)
 			return;
-		draw();
+		updateLazyLoading();
+		if (benchmark.active) {
+			// In benchmark mode the current command buffer is recorded every frame to measure the CPU cost of the model's draws
+			// If supported, frames alternate between descriptor sets and push descriptors so both are compared in a single run
+			if (benchmarkFrame == 0) {
+				// Discard the initial recording of all command buffers
+				recordingTimes = RecordingTimes();
+			}
+			VulkanExampleBase::prepareFrame();
+			recordCommandBuffer(currentBuffer, pushDescriptorsSupported && (benchmarkFrame % 2 == 1));
+			benchmarkFrame++;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+			VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
+			VulkanExampleBase::submitFrame();
+		}
+		else {
+			draw();
+		}
 	}
 
 	virtual void viewChanged()
 	{
 		updateUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (pushDescriptorsSupported && overlay->header("Settings")) {
+			if (overlay->checkBox("Push descriptors", &usePushDescriptors)) {
+				buildCommandBuffers();
+			}
+			overlay->text("Draw recording: %.3f ms", recordingTimes.last[usePushDescriptors ? 1 : 0]);
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
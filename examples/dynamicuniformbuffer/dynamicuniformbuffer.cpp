@@ -14,9 +14,14 @@
 *
 * The used descriptor type VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC then allows to set a dynamic
 * offset used to pass data from the single uniform buffer to the connected shader binding point.
+*
+* The buffer is managed by a vks::UniformRing that holds one region per frame in flight. The matrices
+* are written straight into the persistently mapped region of the current frame and the command buffer
+* is recorded with the dynamic offsets returned by the ring every frame.
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanUniformRing.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -28,30 +33,6 @@ struct Vertex {
 	float color[3];
 };
 
-// Wrapper functions for aligned memory allocation
-// There is currently no standard for this in C++ that works across all platforms and vendors, so we abstract this
-void* alignedAlloc(size_t size, size_t alignment)
-{
-	void *data = nullptr;
-#if defined(_MSC_VER) || defined(__MINGW32__)
-	data = _aligned_malloc(size, alignment);
-#else
-	int res = posix_memalign(&data, alignment, size);
-	if (res != 0)
-		data = nullptr;
-#endif
-	return data;
-}
-
-void alignedFree(void* data)
-{
-#if	defined(_MSC_VER) || defined(__MINGW32__)
-	_aligned_free(data);
-#else
-	free(data);
-#endif
-}
-
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -67,7 +48,6 @@ public:
 
 	struct {
 		vks::Buffer view;
-		vks::Buffer dynamic;
 	} uniformBuffers;
 
 	struct {
@@ -79,11 +59,11 @@ public:
 	glm::vec3 rotations[OBJECT_INSTANCES];
 	glm::vec3 rotationSpeeds[OBJECT_INSTANCES];
 
-	// One big uniform buffer that contains all matrices
-	// Note that we need to manually allocate the data to cope for GPU-specific uniform buffer offset alignments
-	struct UboDataDynamic {
-		glm::mat4 *model = nullptr;
-	} uboDataDynamic;
+	// One big uniform buffer that contains the matrices of all frames in flight
+	// The ring aligns each matrix to the GPU-specific uniform buffer offset alignment
+	std::unique_ptr<vks::UniformRing> uniformRing;
+	// Ring offsets of the current frame's matrices, passed as dynamic offsets
+	uint32_t dynamicOffsets[OBJECT_INSTANCES];
 
 	VkPipeline pipeline;
 	VkPipelineLayout pipelineLayout;
@@ -92,11 +72,10 @@ public:
 
 	float animationTimer = 0.0f;
 
-	size_t dynamicAlignment;
-
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Dynamic uniform buffers";
+		supportsFramesInFlight = true;
 		camera.type = Camera::CameraType::lookat;
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -30.0f));
 		camera.setRotation(glm::vec3(0.0f));
@@ -105,10 +84,6 @@ public:
 
 	~VulkanExample()
 	{
-		if (uboDataDynamic.model) {
-			alignedFree(uboDataDynamic.model);
-		}
-
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
 		vkDestroyPipeline(device, pipeline, nullptr);
@@ -120,10 +95,14 @@ public:
 		indexBuffer.destroy();
 
 		uniformBuffers.view.destroy();
-		uniformBuffers.dynamic.destroy();
 	}
 
+	// The command buffers use the dynamic offsets of the frame they are recorded for, so the current one is recorded every frame in draw()
 	void buildCommandBuffers()
+	{
+	}
+
+	void recordCommandBuffer(uint32_t i)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -140,7 +119,6 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			renderPassBeginInfo.framebuffer = frameBuffers[i];
 
@@ -164,9 +142,8 @@ public:
 			for (uint32_t j = 0; j < OBJECT_INSTANCES; j++)
 			{
 				// One dynamic offset per dynamic descriptor to offset into the ubo containing all model matrices
-				uint32_t dynamicOffset = j * static_cast<uint32_t>(dynamicAlignment);
 				// Bind the descriptor set for rendering a mesh using the dynamic offset
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &dynamicOffset);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &dynamicOffsets[j]);
 
 				vkCmdDrawIndexed(drawCmdBuffers[i], indexCount, 1, 0, 0, 0);
 			}
@@ -183,12 +160,17 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		// The GPU has finished the frame that last used this frame's region of the ring, so its matrices can be overwritten
+		uniformRing->beginFrame(currentFrame);
+		updateDynamicUniformBuffer();
+		recordCommandBuffer(currentBuffer);
+
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -302,11 +284,14 @@ public:
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
 
+		// The descriptor's range is a single matrix, the dynamic offset selects the matrix in the ring
+		VkDescriptorBufferInfo dynamicDescriptor = uniformRing->getDescriptor(sizeof(glm::mat4));
+
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 			// Binding 0 : Projection/View matrix uniform buffer
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.view.descriptor),
 			// Binding 1 : Instance matrix as dynamic uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, &uniformBuffers.dynamic.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, &dynamicDescriptor),
 		};
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
@@ -390,23 +375,12 @@ public:
 	// Prepare and initialize uniform buffer containing shader uniforms
 	void prepareUniformBuffers()
 	{
-		// Allocate data for the dynamic uniform buffer object
-		// We allocate this manually as the alignment of the offset differs between GPUs
-
-		// Calculate required alignment based on minimum device offset alignment
-		size_t minUboAlignment = vulkanDevice->properties.limits.minUniformBufferOffsetAlignment;
-		dynamicAlignment = sizeof(glm::mat4);
-		if (minUboAlignment > 0) {
-			dynamicAlignment = (dynamicAlignment + minUboAlignment - 1) & ~(minUboAlignment - 1);
-		}
-
-		size_t bufferSize = OBJECT_INSTANCES * dynamicAlignment;
-
-		uboDataDynamic.model = (glm::mat4*)alignedAlloc(bufferSize, dynamicAlignment);
-		assert(uboDataDynamic.model);
+		// Ring buffer for the dynamic uniform buffer object, with room for all matrices of each frame in flight
+		// The alignment of the offsets differs between GPUs, so the regions are sized for the largest alignment allowed
+		uniformRing.reset(new vks::UniformRing(vulkanDevice, vks::UniformRing::requiredFrameSize(OBJECT_INSTANCES, sizeof(glm::mat4)), settings.framesInFlight));
 
-		std::cout << "minUniformBufferOffsetAlignment = " << minUboAlignment << std::endl;
-		std::cout << "dynamicAlignment = " << dynamicAlignment << std::endl;
+		std::cout << "minUniformBufferOffsetAlignment = " << vulkanDevice->properties.limits.minUniformBufferOffsetAlignment << std::endl;
+		std::cout << "dynamicAlignment = " << uniformRing->getAlignment() << std::endl;
 
 		// Vertex shader uniform buffer block
 
@@ -417,19 +391,8 @@ public:
 			&uniformBuffers.view,
 			sizeof(uboVS)));
 
-		// Uniform buffer object with per-object matrices
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-			&uniformBuffers.dynamic,
-			bufferSize));
-
-		// Override descriptor range to [base, base + dynamicAlignment]
-		uniformBuffers.dynamic.descriptor.range = dynamicAlignment;
-
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.view.map());
-		VK_CHECK_RESULT(uniformBuffers.dynamic.map());
 
 		// Prepare per-object matrices with offsets and random rotations
 		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
@@ -440,7 +403,6 @@ public:
 		}
 
 		updateUniformBuffers();
-		updateDynamicUniformBuffer(true);
 	}
 
 	void updateUniformBuffers()
@@ -452,13 +414,14 @@ public:
 		memcpy(uniformBuffers.view.mapped, &uboVS, sizeof(uboVS));
 	}
 
-	void updateDynamicUniformBuffer(bool force = false)
+	// Writes the per-object model matrices of the current frame into the ring
+	void updateDynamicUniformBuffer()
 	{
-		// Update at max. 60 fps
-		animationTimer += frameTimer;
-		if ((animationTimer <= 1.0f / 60.0f) && (!force)) {
-			return;
+		// Animate at max. 60 fps, the matrices are written every frame as the ring region of each frame is rewound
+		if (!paused) {
+			animationTimer += frameTimer;
 		}
+		const bool animate = (animationTimer > 1.0f / 60.0f);
 
 		// Dynamic ubo with per-object model matrices indexed by offsets in the command buffer
 		uint32_t dim = static_cast<uint32_t>(pow(OBJECT_INSTANCES, (1.0f / 3.0f)));
@@ -472,30 +435,27 @@ public:
 				{
 					uint32_t index = x * dim * dim + y * dim + z;
 
-					// Aligned offset
-					glm::mat4* modelMat = (glm::mat4*)(((uint64_t)uboDataDynamic.model + (index * dynamicAlignment)));
-
 					// Update rotations
-					rotations[index] += animationTimer * rotationSpeeds[index];
+					if (animate) {
+						rotations[index] += animationTimer * rotationSpeeds[index];
+					}
 
 					// Update matrices
 					glm::vec3 pos = glm::vec3(-((dim * offset.x) / 2.0f) + offset.x / 2.0f + x * offset.x, -((dim * offset.y) / 2.0f) + offset.y / 2.0f + y * offset.y, -((dim * offset.z) / 2.0f) + offset.z / 2.0f + z * offset.z);
-					*modelMat = glm::translate(glm::mat4(1.0f), pos);
-					*modelMat = glm::rotate(*modelMat, rotations[index].x, glm::vec3(1.0f, 1.0f, 0.0f));
-					*modelMat = glm::rotate(*modelMat, rotations[index].y, glm::vec3(0.0f, 1.0f, 0.0f));
-					*modelMat = glm::rotate(*modelMat, rotations[index].z, glm::vec3(0.0f, 0.0f, 1.0f));
+					glm::mat4 modelMat = glm::translate(glm::mat4(1.0f), pos);
+					modelMat = glm::rotate(modelMat, rotations[index].x, glm::vec3(1.0f, 1.0f, 0.0f));
+					modelMat = glm::rotate(modelMat, rotations[index].y, glm::vec3(0.0f, 1.0f, 0.0f));
+					modelMat = glm::rotate(modelMat, rotations[index].z, glm::vec3(0.0f, 0.0f, 1.0f));
+
+					// Aligned slice of the current frame's region, the ring memory is host coherent so no flush is required
+					dynamicOffsets[index] = uniformRing->push(modelMat);
 				}
 			}
 		}
 
-		animationTimer = 0.0f;
-
-		memcpy(uniformBuffers.dynamic.mapped, uboDataDynamic.model, uniformBuffers.dynamic.size);
-		// Flush to make changes visible to the host
-		VkMappedMemoryRange memoryRange = vks::initializers::mappedMemoryRange();
-		memoryRange.memory = uniformBuffers.dynamic.memory;
-		memoryRange.size = uniformBuffers.dynamic.size;
-		vkFlushMappedMemoryRanges(device, 1, &memoryRange);
+		if (animate) {
+			animationTimer = 0.0f;
+		}
 	}
 
 	void prepare()
@@ -508,7 +468,6 @@ public:
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
-		buildCommandBuffers();
 		prepared = true;
 	}
 
@@ -517,8 +476,6 @@ public:
 		if (!prepared)
 			return;
 		draw();
-		if (!paused)
-			updateDynamicUniformBuffer();
 	}
 
 	virtual void viewChanged()
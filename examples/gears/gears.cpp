@@ -1,5 +1,8 @@
 /*
-* Vulkan Example - Animated gears using multiple uniform buffers
+* Vulkan Example - Animated gears using instanced rendering
+*
+* Each set of gear parameters is turned into a single mesh, the gears' positions, colors and rotations are read from an instance storage
+* buffer and animated in the vertex shader, so any number of gears is drawn with one draw per mesh
 *
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
@@ -25,10 +28,33 @@ public:
 		VkPipeline solid;
 	} pipelines;
 
+	// One mesh per set of gear parameters
 	std::vector<VulkanGear*> gears;
+	std::vector<GearInfo> gearInfos;
+
+	// The three gears are repeated on a grid of gridSize x gridSize, the instances of each mesh are stored consecutively
+	int32_t gridSize = 1;
+	const int32_t maxGridSize = 32;
+	vks::Buffer instanceBuffer;
+	// Draw all instances of a mesh with a single draw, or issue one draw (and buffer binds) per gear to compare the per object overhead
+	bool instanced = true;
+	// The benchmark alternates between both submission modes, unless a mode has been passed on the command line
+	bool fixedMode = false;
+	const uint32_t benchmarkFramesPerMode = 500;
+	uint32_t benchmarkFrame = 0;
+
+	struct {
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::vec4 lightPos;
+		// Animation time in degrees
+		float time;
+	} uboVS;
+	vks::Buffer uniformBuffer;
 
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorSet descriptorSet;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -38,6 +64,13 @@ public:
 		camera.setRotation(glm::vec3(-23.75f, 41.25f, 21.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.001f, 256.0f);
 		timerSpeed *= 0.25f;
+		commandLineParser.add("geargrid", { "-gg", "--geargrid" }, 1, "Repeat the gears on a grid of n x n");
+		commandLineParser.add("perobject", { "-pod", "--perobject" }, 0, "Draw each gear with a draw of its own instead of instancing");
+		commandLineParser.add("instanced", { "-ins", "--instanced" }, 0, "Draw all gears with the same mesh in one instanced draw");
+		commandLineParser.parse(args);
+		gridSize = std::min(std::max(commandLineParser.getValueAsInt("geargrid", gridSize), 1), maxGridSize);
+		instanced = !commandLineParser.isSet("perobject");
+		fixedMode = commandLineParser.isSet("perobject") || commandLineParser.isSet("instanced");
 	}
 
 	~VulkanExample()
@@ -49,12 +82,20 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
+		uniformBuffer.destroy();
+		instanceBuffer.destroy();
+
 		for (auto& gear : gears)
 		{
 			delete(gear);
 		}
 	}
 
+	uint32_t instancesPerMesh() const
+	{
+		return static_cast<uint32_t>(gridSize * gridSize);
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -72,12 +113,19 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
+		// GPU times are logged per mode and gear count, so the benchmark results of both modes can be compared
+		const uint32_t instanceCount = instancesPerMesh();
+		const std::string scope = std::string(instanced ? "Gears instanced" : "Gears per object") + " (" + std::to_string(instanceCount * gears.size()) + ")";
+
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			renderPassBeginInfo.framebuffer = frameBuffers[i];
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			benchmark.gpuProfiler.reset(drawCmdBuffers[i], i);
+			benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, scope);
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -87,16 +135,34 @@ public:
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.solid);
+			// All gears share the uniform buffer and the instance buffer
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 
-			for (auto& gear : gears)
+			for (uint32_t g = 0; g < gears.size(); g++)
 			{
-				gear->draw(drawCmdBuffers[i], pipelineLayout);
+				const uint32_t firstInstance = g * instanceCount;
+				if (instanced)
+				{
+					gears[g]->bind(drawCmdBuffers[i]);
+					gears[g]->draw(drawCmdBuffers[i], instanceCount, firstInstance);
+				}
+				else
+				{
+					// Same work per gear as drawing separate objects with buffers of their own
+					for (uint32_t j = 0; j < instanceCount; j++)
+					{
+						gears[g]->bind(drawCmdBuffers[i]);
+						gears[g]->draw(drawCmdBuffers[i], 1, firstInstance + j);
+					}
+				}
 			}
 
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -123,9 +189,10 @@ public:
 		std::vector<float> rotationOffsets = { 0.0f, -9.0f, -30.0f };
 
 		gears.resize(positions.size());
+		gearInfos.resize(positions.size());
 		for (int32_t i = 0; i < gears.size(); ++i)
 		{
-			GearInfo gearInfo = {};
+			GearInfo& gearInfo = gearInfos[i];
 			gearInfo.innerRadius = innerRadiuses[i];
 			gearInfo.outerRadius = outerRadiuses[i];
 			gearInfo.width = widths[i];
@@ -150,7 +217,7 @@ public:
 
 		// Attribute descriptions
 		// Describes memory layout and shader positions
-		vertices.attributeDescriptions.resize(3);
+		vertices.attributeDescriptions.resize(2);
 		// Location 0 : Position
 		vertices.attributeDescriptions[0] =
 			vks::initializers::vertexInputAttributeDescription(
@@ -165,13 +232,6 @@ public:
 				1,
 				VK_FORMAT_R32G32B32_SFLOAT,
 				sizeof(float) * 3);
-		// Location 2 : Color
-		vertices.attributeDescriptions[2] =
-			vks::initializers::vertexInputAttributeDescription(
-				VERTEX_BUFFER_BIND_ID,
-				2,
-				VK_FORMAT_R32G32B32_SFLOAT,
-				sizeof(float) * 6);
 
 		vertices.inputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		vertices.inputState.vertexBindingDescriptionCount = static_cast<uint32_t>(vertices.bindingDescriptions.size());
@@ -180,20 +240,62 @@ public:
 		vertices.inputState.pVertexAttributeDescriptions = vertices.attributeDescriptions.data();
 	}
 
+	// Fill the instance buffer for the current grid size, the buffer is sized for the largest grid so changing the grid doesn't touch the descriptor
+	void updateInstances()
+	{
+		const float spacing = 15.0f;
+		const float center = (float)(gridSize - 1) * 0.5f;
+		std::vector<GearInstance> instances;
+		instances.reserve(instancesPerMesh() * gearInfos.size());
+		for (auto& gearInfo : gearInfos)
+		{
+			for (int32_t y = 0; y < gridSize; y++)
+			{
+				for (int32_t x = 0; x < gridSize; x++)
+				{
+					instances.push_back(GearInstance(gearInfo, glm::vec3(((float)x - center) * spacing, ((float)y - center) * spacing, 0.0f)));
+				}
+			}
+		}
+		memcpy(instanceBuffer.mapped, instances.data(), instances.size() * sizeof(GearInstance));
+	}
+
+	void prepareInstances()
+	{
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&instanceBuffer,
+			maxGridSize * maxGridSize * gearInfos.size() * sizeof(GearInstance)));
+		VK_CHECK_RESULT(instanceBuffer.map());
+		updateInstances();
+	}
+
+	void prepareUniformBuffers()
+	{
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffer,
+			sizeof(uboVS)));
+		// Map persistent
+		VK_CHECK_RESULT(uniformBuffer.map());
+	}
+
 	void setupDescriptorPool()
 	{
-		// One UBO for each gear
+		// One descriptor set shared by all gears
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1),
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				static_cast<uint32_t>(poolSizes.size()),
 				poolSizes.data(),
-				// Three descriptor sets (for each gear)
-				3);
+				1);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -206,7 +308,12 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				VK_SHADER_STAGE_VERTEX_BIT,
-				0)
+				0),
+			// Binding 1 : Gear instances
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_VERTEX_BIT,
+				1)
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -226,10 +333,16 @@ public:
 
 	void setupDescriptorSets()
 	{
-		for (auto& gear : gears)
-		{
-			gear->setupDescriptorSet(descriptorPool, descriptorSetLayout);
-		}
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			// Binding 0 : Vertex shader uniform buffer
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffer.descriptor),
+			// Binding 1 : Gear instances
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &instanceBuffer.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 	}
 
 	void preparePipelines()
@@ -310,10 +423,11 @@ public:
 
 	void updateUniformBuffers()
 	{
-		for (auto& gear : gears)
-		{
-			gear->updateUniformBuffer(camera.matrices.perspective, camera.matrices.view, timer * 360.0f);
-		}
+		uboVS.projection = camera.matrices.perspective;
+		uboVS.view = camera.matrices.view;
+		uboVS.time = timer * 360.0f;
+		uboVS.lightPos = glm::vec4(sin(glm::radians(uboVS.time)) * 8.0f, 0.0f, cos(glm::radians(uboVS.time)) * 8.0f, 1.0f);
+		memcpy(uniformBuffer.mapped, &uboVS, sizeof(uboVS));
 	}
 
 	void draw()
@@ -325,7 +439,7 @@ public:
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -334,6 +448,8 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		prepareVertices();
+		prepareInstances();
+		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
@@ -347,6 +463,13 @@ public:
 	{
 		if (!prepared)
 			return;
+		if (benchmark.active && !fixedMode) {
+			if (benchmarkFrame > 0 && benchmarkFrame % benchmarkFramesPerMode == 0) {
+				instanced = !instanced;
+				buildCommandBuffers();
+			}
+			benchmarkFrame++;
+		}
 		vkDeviceWaitIdle(device);
 		draw();
 		vkDeviceWaitIdle(device);
@@ -360,6 +483,24 @@ public:
 	{
 		updateUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			if (overlay->checkBox("Instanced", &instanced)) {
+				buildCommandBuffers();
+			}
+			if (overlay->sliderInt("Grid size", &gridSize, 1, maxGridSize)) {
+				updateInstances();
+				buildCommandBuffers();
+			}
+		}
+		if (overlay->header("Statistics")) {
+			const uint32_t gearCount = instancesPerMesh() * static_cast<uint32_t>(gears.size());
+			overlay->text("Gears: %d", gearCount);
+			overlay->text("Draws: %d", instanced ? static_cast<uint32_t>(gears.size()) : gearCount);
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
\ No newline at end of file
@@ -1,5 +1,5 @@
 /*
-* Vulkan Example - Animated gears using multiple uniform buffers
+* Vulkan Example - Animated gears using instanced rendering
 *
 * See readme.md for details
 *
@@ -12,7 +12,7 @@
 
 int32_t VulkanGear::newVertex(std::vector<Vertex> *vBuffer, float x, float y, float z, const glm::vec3& normal)
 {
-	Vertex v(glm::vec3(x, y, z), normal, color);
+	Vertex v(glm::vec3(x, y, z), normal);
 	vBuffer->push_back(v);
 	return static_cast<int32_t>(vBuffer->size()) - 1;
 }
@@ -27,18 +27,12 @@ void VulkanGear::newFace(std::vector<uint32_t> *iBuffer, int a, int b, int c)
 VulkanGear::~VulkanGear()
 {
 	// Clean up vulkan resources
-	uniformBuffer.destroy();
 	vertexBuffer.destroy();
 	indexBuffer.destroy();
 }
 
 void VulkanGear::generate(GearInfo *gearinfo, VkQueue queue)
 {
-	this->color = gearinfo->color;
-	this->pos = gearinfo->pos;
-	this->rotOffset = gearinfo->rotOffset;
-	this->rotSpeed = gearinfo->rotSpeed;
-
 	std::vector<Vertex> vBuffer;
 	std::vector<uint32_t> iBuffer;
 
@@ -252,61 +246,22 @@ void VulkanGear::generate(GearInfo *gearinfo, VkQueue queue)
 	}
 
 	indexCount = iBuffer.size();
+}
 
-	prepareUniformBuffer();
+uint32_t VulkanGear::getIndexCount() const
+{
+	return indexCount;
 }
 
-void VulkanGear::draw(VkCommandBuffer cmdbuffer, VkPipelineLayout pipelineLayout)
+void VulkanGear::bind(VkCommandBuffer cmdbuffer)
 {
 	VkDeviceSize offsets[1] = { 0 };
-	vkCmdBindDescriptorSets(cmdbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
 	vkCmdBindVertexBuffers(cmdbuffer, 0, 1, &vertexBuffer.buffer, offsets);
 	vkCmdBindIndexBuffer(cmdbuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-	vkCmdDrawIndexed(cmdbuffer, indexCount, 1, 0, 0, 1);
-}
-
-void VulkanGear::updateUniformBuffer(glm::mat4 perspective, glm::mat4 view, float timer)
-{
-	ubo.projection = perspective;
-	ubo.view = view;
-	ubo.model = glm::mat4(1.0f);
-	ubo.model = glm::translate(ubo.model, pos);
-	ubo.model = glm::rotate(ubo.model, glm::radians((rotSpeed * timer) + rotOffset), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.normal = glm::inverseTranspose(ubo.view * ubo.model);
-	ubo.lightPos = glm::vec3(0.0f, 0.0f, 2.5f);
-	ubo.lightPos.x = sin(glm::radians(timer)) * 8.0f;
-	ubo.lightPos.z = cos(glm::radians(timer)) * 8.0f;
-	memcpy(uniformBuffer.mapped, &ubo, sizeof(ubo));
-}
-
-void VulkanGear::setupDescriptorSet(VkDescriptorPool pool, VkDescriptorSetLayout descriptorSetLayout)
-{
-	VkDescriptorSetAllocateInfo allocInfo =
-		vks::initializers::descriptorSetAllocateInfo(
-			pool,
-			&descriptorSetLayout,
-			1);
-
-	VK_CHECK_RESULT(vkAllocateDescriptorSets(vulkanDevice->logicalDevice, &allocInfo, &descriptorSet));
-
-	// Binding 0 : Vertex shader uniform buffer
-	VkWriteDescriptorSet writeDescriptorSet =
-		vks::initializers::writeDescriptorSet(
-			descriptorSet,
-			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-			0,
-			&uniformBuffer.descriptor);
-
-	vkUpdateDescriptorSets(vulkanDevice->logicalDevice, 1, &writeDescriptorSet, 0, NULL);
 }
 
-void VulkanGear::prepareUniformBuffer()
+// The instances' data is indexed with gl_InstanceIndex, which includes firstInstance
+void VulkanGear::draw(VkCommandBuffer cmdbuffer, uint32_t instanceCount, uint32_t firstInstance)
 {
-	VK_CHECK_RESULT(vulkanDevice->createBuffer(
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&uniformBuffer,
-		sizeof(ubo)));
-	// Map persistent
-	VK_CHECK_RESULT(uniformBuffer.map());
+	vkCmdDrawIndexed(cmdbuffer, indexCount, instanceCount, 0, 0, firstInstance);
 }
@@ -1,5 +1,5 @@
 /*
-* Vulkan Example - Animated gears using multiple uniform buffers
+* Vulkan Example - Animated gears using instanced rendering
 *
 * See readme.md for details
 *
@@ -24,20 +24,17 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 
+// The color is passed per instance, so gears of different colors share a mesh
 struct Vertex
 {
 	float pos[3];
 	float normal[3];
-	float color[3];
 
-	Vertex(const glm::vec3& p, const glm::vec3& n, const glm::vec3& c)
+	Vertex(const glm::vec3& p, const glm::vec3& n)
 	{
 		pos[0] = p.x;
 		pos[1] = p.y;
 		pos[2] = p.z;
-		color[0] = c.x;
-		color[1] = c.y;
-		color[2] = c.z;
 		normal[0] = n.x;
 		normal[1] = n.y;
 		normal[2] = n.z;
@@ -57,48 +54,43 @@ struct GearInfo
 	float rotOffset;
 };
 
-class VulkanGear
+// Per gear data in the instance storage buffer, the vertex shader animates the gears from the rotation speed and offset
+struct GearInstance
 {
-private:
-	struct UBO
+	// xyz: position, w: rotation offset in degrees
+	glm::vec4 pos;
+	// rgb: color, w: rotation speed
+	glm::vec4 color;
+
+	GearInstance(const GearInfo& info, const glm::vec3& offset)
 	{
-		glm::mat4 projection;
-		glm::mat4 model;
-		glm::mat4 normal;
-		glm::mat4 view;
-		glm::vec3 lightPos;
-	};
+		pos = glm::vec4(info.pos + offset, info.rotOffset);
+		color = glm::vec4(info.color, info.rotSpeed);
+	}
+};
 
+// Mesh of a gear, generated once for each set of gear parameters and shared by all instances of that gear
+class VulkanGear
+{
+private:
 	vks::VulkanDevice *vulkanDevice;
 
-	glm::vec3 color;
-	glm::vec3 pos;
-	float rotSpeed;
-	float rotOffset;
-
 	vks::Buffer vertexBuffer;
 	vks::Buffer indexBuffer;
 	uint32_t indexCount;
 
-	UBO ubo;
-	vks::Buffer uniformBuffer;
-
 	int32_t newVertex(std::vector<Vertex> *vBuffer, float x, float y, float z, const glm::vec3& normal);
 	void newFace(std::vector<uint32_t> *iBuffer, int a, int b, int c);
 
-	void prepareUniformBuffer();
 public:
-	VkDescriptorSet descriptorSet;
-
-	void draw(VkCommandBuffer cmdbuffer, VkPipelineLayout pipelineLayout);
-	void updateUniformBuffer(glm::mat4 perspective, glm::mat4 view, float timer);
-
-	void setupDescriptorSet(VkDescriptorPool pool, VkDescriptorSetLayout descriptorSetLayout);
+	void bind(VkCommandBuffer cmdbuffer);
+	void draw(VkCommandBuffer cmdbuffer, uint32_t instanceCount, uint32_t firstInstance);
 
 	VulkanGear(vks::VulkanDevice *vulkanDevice) : vulkanDevice(vulkanDevice) {};
 	~VulkanGear();
 
 	void generate(GearInfo *gearinfo, VkQueue queue);
+	uint32_t getIndexCount() const;
 
 };
 
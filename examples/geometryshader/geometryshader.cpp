@@ -1,6 +1,8 @@
 /*
 * Vulkan Example - Geometry shader (vertex normal debugging)
 *
+* The normals can also be generated by a compute shader into the batched debug lines of vks::DebugLineRenderer, which needs no geometry shader support
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -8,6 +10,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanDebugLines.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -16,6 +19,13 @@ class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool displayNormals = true;
+	// Normals are drawn by the geometry shader, or as debug lines appended by a compute shader
+	enum NormalsPath { GeometryShader = 0, DebugLines = 1 };
+	int32_t normalsPath = GeometryShader;
+	bool geometryShaderSupported = false;
+	bool displayBounds = false;
+	std::unique_ptr<vks::DebugLineRenderer> debugLines;
+	uint32_t debugLinesSource = 0;
 
 	vkglTF::Model scene;
 
@@ -37,7 +47,7 @@ public:
 
 	struct {
 		VkPipeline solid;
-		VkPipeline normals;
+		VkPipeline normals{ VK_NULL_HANDLE };
 	} pipelines;
 
 	VkPipelineLayout pipelineLayout;
@@ -51,6 +61,11 @@ public:
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -1.0f));
 		camera.setRotation(glm::vec3(0.0f, -25.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 128.0f);
+		commandLineParser.add("debuglines", { "-dl", "--debuglines" }, 0, "Draw the normals as debug lines generated in a compute shader instead of using a geometry shader");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("debuglines")) {
+			normalsPath = DebugLines;
+		}
 	}
 
 	~VulkanExample()
@@ -58,7 +73,10 @@ public:
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
 		vkDestroyPipeline(device, pipelines.solid, nullptr);
-		vkDestroyPipeline(device, pipelines.normals, nullptr);
+		if (pipelines.normals != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.normals, nullptr);
+		}
+		debugLines.reset();
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -70,12 +88,14 @@ public:
 	// Enable physical device features required for this example
 	virtual void getEnabledFeatures()
 	{
-		// Geometry shader support is required for this example
-		if (deviceFeatures.geometryShader) {
+		// Without geometry shader support, the normals can only be drawn as debug lines
+		geometryShaderSupported = deviceFeatures.geometryShader;
+		if (geometryShaderSupported) {
 			enabledFeatures.geometryShader = VK_TRUE;
 		}
 		else {
-			vks::tools::exitFatal("Selected GPU does not support geometry shaders!", VK_ERROR_FEATURE_NOT_PRESENT);
+			std::cout << "Selected GPU does not support geometry shaders, drawing the normals as debug lines\n";
+			normalsPath = DebugLines;
 		}
 	}
 
@@ -103,6 +123,15 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			// [POI] Generate a line per vertex from the vertex buffer in a compute shader, appended behind the lines added on the host
+			// The scene's vertices are pre-transformed, so they're already in world space
+			const bool normalsAsDebugLines = displayNormals && (normalsPath == DebugLines);
+			debugLines->beginAppend(drawCmdBuffers[i], i);
+			if (normalsAsDebugLines) {
+				debugLines->appendNormals(drawCmdBuffers[i], i, debugLinesSource, scene.vertices.count, sizeof(vkglTF::Vertex), offsetof(vkglTF::Vertex, pos), offsetof(vkglTF::Vertex, normal), glm::mat4(1.0f), 0.02f);
+			}
+			debugLines->endAppend(drawCmdBuffers[i], i);
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f
@@ -121,12 +150,15 @@ public:
 			scene.draw(drawCmdBuffers[i]);
 
 			// Normal debugging
-			if (displayNormals)
+			if (displayNormals && (normalsPath == GeometryShader))
 			{
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.normals);
 				scene.draw(drawCmdBuffers[i]);
 			}
 
+			// All debug lines (normals and bounds) in a single indirect draw
+			debugLines->draw(drawCmdBuffers[i], i);
+
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
@@ -137,6 +169,8 @@ public:
 
 	void loadAssets()
 	{
+		// The debug lines' compute shader reads the vertices from a storage buffer
+		vkglTF::memoryPropertyFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 		scene.loadFromFile(getAssetPath() + "models/suzanne.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY);
 	}
 
@@ -229,7 +263,6 @@ public:
 		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_LINE_WIDTH };
 		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables, 0);
 
-		// Tessellation pipeline
 		std::array<VkPipelineShaderStageCreateInfo, 3> shaderStages;
 		shaderStages[0] = loadShader(getShadersPath() + "geometryshader/base.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "geometryshader/base.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
@@ -249,7 +282,9 @@ public:
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Color });
 
 		// Normal debugging pipeline
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.normals));
+		if (geometryShaderSupported) {
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.normals));
+		}
 
 		// Solid rendering pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "geometryshader/mesh.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
@@ -295,16 +330,29 @@ public:
 		memcpy(uniformBuffers.GS.mapped, &uboGS, sizeof(uboGS));
 	}
 
+	// Host lines are written to the buffer of the acquired image's command buffer, which has finished execution in prepareFrame()
+	void updateDebugLines()
+	{
+		debugLines->setViewProjection(currentBuffer, camera.matrices.perspective * camera.matrices.view);
+		debugLines->begin(currentBuffer);
+		if (displayBounds) {
+			debugLines->addBox(scene.dimensions.min, scene.dimensions.max, glm::mat4(1.0f), glm::vec4(1.0f, 1.0f, 0.0f, 1.0f));
+			debugLines->addSphere(scene.dimensions.center, scene.dimensions.radius, glm::vec4(0.0f, 1.0f, 0.0f, 1.0f));
+		}
+		debugLines->end();
+	}
+
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
+		updateDebugLines();
 
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -313,6 +361,8 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		debugLines.reset(new vks::DebugLineRenderer(vulkanDevice, renderPass, pipelineCache, static_cast<uint32_t>(drawCmdBuffers.size()), getShadersPath() + "base/debuglines.vert.spv", getShadersPath() + "base/debuglines.frag.spv", getShadersPath() + "base/debugnormals.comp.spv"));
+		debugLinesSource = debugLines->addVertexSource(scene.vertices.buffer);
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -340,6 +390,13 @@ public:
 			if (overlay->checkBox("Display normals", &displayNormals)) {
 				buildCommandBuffers();
 			}
+			if (geometryShaderSupported) {
+				if (overlay->comboBox("Normals", &normalsPath, { "Geometry shader", "Compute debug lines" })) {
+					buildCommandBuffers();
+				}
+			}
+			// Host lines are written every frame, so no rebuild is required
+			overlay->checkBox("Display bounds", &displayBounds);
 		}
 	}
 
@@ -29,13 +29,13 @@ VulkanglTFScene::~VulkanglTFScene()
 	vkDestroyBuffer(vulkanDevice->logicalDevice, indices.buffer, nullptr);
 	vkFreeMemory(vulkanDevice->logicalDevice, indices.memory, nullptr);
 	for (Image image : images) {
-		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
-		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
+		image.texture.destroy();
 	}
 	for (Material material : materials) {
 		vkDestroyPipeline(vulkanDevice->logicalDevice, material.pipeline, nullptr);
+		if (material.bindlessPipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(vulkanDevice->logicalDevice, material.bindlessPipeline, nullptr);
+		}
 	}
 }
 
@@ -236,7 +236,7 @@ VkDescriptorImageInfo VulkanglTFScene::getTextureDescriptor(const size_t index)
 */
 
 // Draw a single node including child nodes (if present)
-void VulkanglTFScene::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFScene::Node* node)
+void VulkanglTFScene::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFScene::Node* node, bool bindless)
 {
 	if (!node->visible) {
 		return;
@@ -255,28 +255,40 @@ void VulkanglTFScene::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout p
 		for (VulkanglTFScene::Primitive& primitive : node->mesh.primitives) {
 			if (primitive.indexCount > 0) {
 				VulkanglTFScene::Material& material = materials[primitive.materialIndex];
-				// POI: Bind the pipeline for the node's material
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipeline);
-				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &material.descriptorSet, 0, nullptr);
+				if (bindless) {
+					// POI: The texture array is bound once for the whole scene, so a material only changes the pipeline (if it differs from the last one) and the texture indices
+					if (material.bindlessPipeline != boundPipeline) {
+						vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material.bindlessPipeline);
+						boundPipeline = material.bindlessPipeline;
+					}
+					const MaterialIndices materialIndices = { material.baseColorTextureIndex, material.normalTextureIndex };
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::mat4), sizeof(MaterialIndices), &materialIndices);
+				}
+				else {
+					// POI: Bind the pipeline for the node's material
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipeline);
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &material.descriptorSet, 0, nullptr);
+				}
 				vkCmdDrawIndexed(commandBuffer, primitive.indexCount, 1, primitive.firstIndex, 0, 0);
 			}
 		}
 	}
 	for (auto& child : node->children) {
-		drawNode(commandBuffer, pipelineLayout, child);
+		drawNode(commandBuffer, pipelineLayout, child, bindless);
 	}
 }
 
 // Draw the glTF scene starting at the top-level-nodes
-void VulkanglTFScene::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+void VulkanglTFScene::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, bool bindless)
 {
+	boundPipeline = VK_NULL_HANDLE;
 	// All vertices and indices are stored in single buffers, so we only need to bind once
 	VkDeviceSize offsets[1] = { 0 };
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
 	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 	// Render all nodes at top-level
 	for (auto& node : nodes) {
-		drawNode(commandBuffer, pipelineLayout, node);
+		drawNode(commandBuffer, pipelineLayout, node, bindless);
 	}
 }
 
@@ -287,27 +299,74 @@ void VulkanglTFScene::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipel
 VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 {
 	title = "glTF scene rendering";
+	supportsFramesInFlight = true;
 	camera.type = Camera::CameraType::firstperson;
 	camera.flipY = true;
 	camera.setPosition(glm::vec3(0.0f, 1.0f, 0.0f));
 	camera.setRotation(glm::vec3(0.0f, -90.0f, 0.0f));
 	camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+	// The bindless path needs descriptor indexing, support for it is checked in getEnabledExtensions
+	enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+#if defined(VK_USE_PLATFORM_MACOS_MVK)
+	// SRS - on macOS set environment variable to configure MoltenVK for using Metal argument buffers (needed for descriptor indexing)
+	setenv("MVK_CONFIG_USE_METAL_ARGUMENT_BUFFERS", "1", 1);
+#endif
 }
 
 VulkanExample::~VulkanExample()
 {
+	if (benchmark.active) {
+		// Compare the CPU time spent recording the scene's draw calls with per material descriptor sets and with the bindless texture array
+		const char* names[2] = { "Per material descriptor sets", "Bindless texture array" };
+		std::cout << "Scene draw call recording (CPU):" << std::endl;
+		for (uint32_t i = 0; i < 2; i++) {
+			if (recordingTimes.count[i] > 0) {
+				std::cout << "	" << names[i] << ": " << std::fixed << std::setprecision(3) << recordingTimes.total[i] / recordingTimes.count[i] << " ms (" << recordingTimes.count[i] << " frames)" << std::endl;
+			}
+		}
+	}
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.matrices, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.textures, nullptr);
+	if (bindlessSupported) {
+		vkDestroyPipelineLayout(device, bindlessResources.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, bindlessResources.descriptorSetLayout, nullptr);
+	}
 	shaderData.buffer.destroy();
 }
 
 void VulkanExample::getEnabledFeatures()
 {
 	enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+	// Material indices are pushed per draw, so the texture array is only indexed with dynamically uniform values
+	enabledFeatures.shaderSampledImageArrayDynamicIndexing = deviceFeatures.shaderSampledImageArrayDynamicIndexing;
 }
 
-void VulkanExample::buildCommandBuffers()
+void VulkanExample::getEnabledExtensions()
+{
+	// The bindless path samples from a runtime sized texture array, without descriptor indexing only the per material descriptor sets are available
+	if (vulkanDevice->extensionSupported(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) && vulkanDevice->extensionSupported(VK_KHR_MAINTENANCE3_EXTENSION_NAME) && deviceFeatures.shaderSampledImageArrayDynamicIndexing) {
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedFeatures{};
+		supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2KHR deviceFeatures2{};
+		deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		deviceFeatures2.pNext = &supportedFeatures;
+		PFN_vkGetPhysicalDeviceFeatures2KHR vkGetPhysicalDeviceFeatures2KHR = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+		vkGetPhysicalDeviceFeatures2KHR(physicalDevice, &deviceFeatures2);
+		bindlessSupported = supportedFeatures.runtimeDescriptorArray && supportedFeatures.descriptorBindingVariableDescriptorCount;
+	}
+	if (bindlessSupported) {
+		enabledDeviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+		enabledDeviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		physicalDeviceDescriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		physicalDeviceDescriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		physicalDeviceDescriptorIndexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+		deviceCreatepNextChain = &physicalDeviceDescriptorIndexingFeatures;
+		bindless = true;
+	}
+}
+
+void VulkanExample::recordCommandBuffer(int32_t index, bool useBindless)
 {
 	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
@@ -328,22 +387,37 @@ void VulkanExample::buildCommandBuffers()
 	const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 	const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 
-	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-	{
-		renderPassBeginInfo.framebuffer = frameBuffers[i];
-		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-		// Bind scene matrices descriptor to set 0
-		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+	renderPassBeginInfo.framebuffer = frameBuffers[index];
+	VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[index], &cmdBufInfo));
+	vkCmdBeginRenderPass(drawCmdBuffers[index], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdSetViewport(drawCmdBuffers[index], 0, 1, &viewport);
+	vkCmdSetScissor(drawCmdBuffers[index], 0, 1, &scissor);
+
+	auto tStart = std::chrono::high_resolution_clock::now();
+	const VkPipelineLayout scenePipelineLayout = useBindless ? bindlessResources.pipelineLayout : pipelineLayout;
+	// Bind scene matrices descriptor to set 0
+	vkCmdBindDescriptorSets(drawCmdBuffers[index], VK_PIPELINE_BIND_POINT_GRAPHICS, scenePipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+	if (useBindless) {
+		// POI: Bind the texture array with all of the scene's images to set 1 once
+		vkCmdBindDescriptorSets(drawCmdBuffers[index], VK_PIPELINE_BIND_POINT_GRAPHICS, scenePipelineLayout, 1, 1, &bindlessResources.descriptorSet, 0, nullptr);
+	}
 
-		// POI: Draw the glTF scene
-		glTFScene.draw(drawCmdBuffers[i], pipelineLayout);
+	// POI: Draw the glTF scene
+	glTFScene.draw(drawCmdBuffers[index], scenePipelineLayout, useBindless);
+	auto tEnd = std::chrono::high_resolution_clock::now();
+	recordingTimes.total[useBindless ? 1 : 0] += std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+	recordingTimes.count[useBindless ? 1 : 0]++;
+
+	drawUI(drawCmdBuffers[index]);
+	vkCmdEndRenderPass(drawCmdBuffers[index]);
+	VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[index]));
+}
 
-		drawUI(drawCmdBuffers[i]);
-		vkCmdEndRenderPass(drawCmdBuffers[i]);
-		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+void VulkanExample::buildCommandBuffers()
+{
+	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+	{
+		recordCommandBuffer(i, bindless);
 	}
 }
 
@@ -473,12 +547,14 @@ void VulkanExample::setupDescriptors()
 
 	// One ubo to pass dynamic data to the shader
 	// Two combined image samplers per material as each material uses color and normal maps
+	// The bindless path adds one combined image sampler per image for the texture array
+	const uint32_t imageCount = static_cast<uint32_t>(glTFScene.images.size());
 	std::vector<VkDescriptorPoolSize> poolSizes = {
 		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(glTFScene.materials.size()) * 2),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(glTFScene.materials.size()) * 2 + (bindlessSupported ? imageCount : 0)),
 	};
-	// One set for matrices and one per model image/texture
-	const uint32_t maxSetCount = static_cast<uint32_t>(glTFScene.images.size()) + 1;
+	// One set for matrices and one per model image/texture (and one for the texture array)
+	const uint32_t maxSetCount = imageCount + 1 + (bindlessSupported ? 1 : 0);
 	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxSetCount);
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
@@ -529,6 +605,50 @@ void VulkanExample::setupDescriptors()
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 	}
+
+	if (!bindlessSupported) {
+		return;
+	}
+
+	// POI: Descriptor set layout for the bindless path with all of the scene's images in a single runtime sized array
+	// In the fragment shader:
+	//	layout (set = 1, binding = 0) uniform sampler2D textures[];
+	VkDescriptorSetLayoutBinding textureArrayBinding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0, imageCount);
+	const VkDescriptorBindingFlagsEXT descriptorBindingFlags = VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT;
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT setLayoutBindingFlags{};
+	setLayoutBindingFlags.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	setLayoutBindingFlags.bindingCount = 1;
+	setLayoutBindingFlags.pBindingFlags = &descriptorBindingFlags;
+	descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(&textureArrayBinding, 1);
+	descriptorSetLayoutCI.pNext = &setLayoutBindingFlags;
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &bindlessResources.descriptorSetLayout));
+
+	// The material's texture indices are pushed to the fragment shader behind the vertex shader's matrix
+	setLayouts = { descriptorSetLayouts.matrices, bindlessResources.descriptorSetLayout };
+	std::array<VkPushConstantRange, 2> pushConstantRanges = {
+		vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4), 0),
+		vks::initializers::pushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(VulkanglTFScene::MaterialIndices), sizeof(glm::mat4)),
+	};
+	pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
+	pipelineLayoutCI.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+	pipelineLayoutCI.pPushConstantRanges = pushConstantRanges.data();
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &bindlessResources.pipelineLayout));
+
+	VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableDescriptorCountAllocInfo{};
+	variableDescriptorCountAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+	variableDescriptorCountAllocInfo.descriptorSetCount = 1;
+	variableDescriptorCountAllocInfo.pDescriptorCounts = &imageCount;
+	allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &bindlessResources.descriptorSetLayout, 1);
+	allocInfo.pNext = &variableDescriptorCountAllocInfo;
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &bindlessResources.descriptorSet));
+
+	// Materials index the array with the same indices used for their per material descriptor sets
+	std::vector<VkDescriptorImageInfo> textureDescriptors(imageCount);
+	for (uint32_t i = 0; i < imageCount; i++) {
+		textureDescriptors[i] = glTFScene.getTextureDescriptor(i);
+	}
+	writeDescriptorSet = vks::initializers::writeDescriptorSet(bindlessResources.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, textureDescriptors.data(), imageCount);
+	vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
 }
 
 void VulkanExample::preparePipelines()
@@ -595,6 +715,34 @@ void VulkanExample::preparePipelines()
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &material.pipeline));
 	}
+
+	if (!bindlessSupported) {
+		return;
+	}
+
+	// POI: The bindless pipelines use the same material state, but read their textures from the texture array at the pushed indices
+	pipelineCI.layout = bindlessResources.pipelineLayout;
+	shaderStages[1] = loadShader(getShadersPath() + "gltfscenerendering/scenebindless.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+	for (auto &material : glTFScene.materials) {
+		struct MaterialSpecializationData {
+			VkBool32 alphaMask;
+			float alphaMaskCutoff;
+		} materialSpecializationData;
+
+		materialSpecializationData.alphaMask = material.alphaMode == "MASK";
+		materialSpecializationData.alphaMaskCutoff = material.alphaCutOff;
+
+		std::vector<VkSpecializationMapEntry> specializationMapEntries = {
+			vks::initializers::specializationMapEntry(0, offsetof(MaterialSpecializationData, alphaMask), sizeof(MaterialSpecializationData::alphaMask)),
+			vks::initializers::specializationMapEntry(1, offsetof(MaterialSpecializationData, alphaMaskCutoff), sizeof(MaterialSpecializationData::alphaMaskCutoff)),
+		};
+		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(specializationMapEntries, sizeof(materialSpecializationData), &materialSpecializationData);
+		shaderStages[1].pSpecializationInfo = &specializationInfo;
+
+		rasterizationStateCI.cullMode = material.doubleSided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &material.bindlessPipeline));
+	}
 }
 
 void VulkanExample::prepareUniformBuffers()
@@ -629,7 +777,24 @@ void VulkanExample::prepare()
 
 void VulkanExample::render()
 {
-	renderFrame();
+	if (benchmark.active) {
+		// POI: In benchmark mode the current command buffer is recorded every frame to measure the CPU cost of the scene's draw calls
+		// If supported, frames alternate between the per material descriptor sets and the bindless texture array so both are compared in a single run
+		if (benchmarkFrame == 0) {
+			// Discard the initial recording of all command buffers
+			recordingTimes = RecordingTimes();
+		}
+		VulkanExampleBase::prepareFrame();
+		recordCommandBuffer(currentBuffer, bindlessSupported && (benchmarkFrame % 2 == 1));
+		benchmarkFrame++;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
+		VulkanExampleBase::submitFrame();
+	}
+	else {
+		renderFrame();
+	}
 	if (camera.updated) {
 		updateUniformBuffers();
 	}
@@ -666,6 +831,11 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 		}
 		ImGui::EndChild();
 	}
+	if (bindlessSupported && overlay->header("Settings")) {
+		if (overlay->checkBox("Bindless textures", &bindless)) {
+			buildCommandBuffers();
+		}
+	}
 }
 
 VULKAN_EXAMPLE_MAIN()
@@ -98,6 +98,14 @@ public:
 		bool doubleSided = false;
 		VkDescriptorSet descriptorSet;
 		VkPipeline pipeline;
+		// Pipeline variant sampling the material's textures from the bindless texture array
+		VkPipeline bindlessPipeline = VK_NULL_HANDLE;
+	};
+
+	// Texture array indices of a material, passed to the fragment shader with push constants by the bindless path
+	struct MaterialIndices {
+		uint32_t colorTextureIndex;
+		uint32_t normalTextureIndex;
 	};
 
 	// Contains the texture for a single glTF image
@@ -122,14 +130,17 @@ public:
 
 	std::string path;
 
+	// Pipeline bound last while recording, the bindless path skips redundant binds
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+
 	~VulkanglTFScene();
 	VkDescriptorImageInfo getTextureDescriptor(const size_t index);
 	void loadImages(tinygltf::Model& input);
 	void loadTextures(tinygltf::Model& input);
 	void loadMaterials(tinygltf::Model& input);
 	void loadNode(const tinygltf::Node& inputNode, const tinygltf::Model& input, VulkanglTFScene::Node* parent, std::vector<uint32_t>& indexBuffer, std::vector<VulkanglTFScene::Vertex>& vertexBuffer);
-	void drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFScene::Node* node);
-	void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+	void drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFScene::Node* node, bool bindless);
+	void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, bool bindless = false);
 };
 
 class VulkanExample : public VulkanExampleBase
@@ -155,9 +166,30 @@ public:
 		VkDescriptorSetLayout textures;
 	} descriptorSetLayouts;
 
+	// POI: Instead of binding a descriptor set per material, the bindless path binds all scene images as one descriptor indexed texture array
+	// and selects a material's textures with indices passed as push constants
+	bool bindlessSupported = false;
+	bool bindless = false;
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT physicalDeviceDescriptorIndexingFeatures{};
+
+	struct Bindless {
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	} bindlessResources;
+
+	// CPU time spent recording the scene's draw calls in benchmark mode, per material descriptor sets [0] and bindless [1]
+	struct RecordingTimes {
+		double total[2] = { 0.0, 0.0 };
+		uint32_t count[2] = { 0, 0 };
+	} recordingTimes;
+	uint32_t benchmarkFrame = 0;
+
 	VulkanExample();
 	~VulkanExample();
 	virtual void getEnabledFeatures();
+	virtual void getEnabledExtensions();
+	void recordCommandBuffer(int32_t index, bool useBindless);
 	void buildCommandBuffers();
 	void loadglTFFile(std::string filename);
 	void loadAssets();
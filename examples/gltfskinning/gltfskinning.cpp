@@ -46,10 +46,7 @@ VulkanglTFModel::~VulkanglTFModel()
 	vkFreeMemory(vulkanDevice->logicalDevice, indices.memory, nullptr);
 	for (Image image : images)
 	{
-		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
-		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
+		image.texture.destroy();
 	}
 	for (Skin skin : skins)
 	{
@@ -490,7 +487,8 @@ glm::mat4 VulkanglTFModel::getNodeMatrix(VulkanglTFModel::Node *node)
 }
 
 // POI: Update the joint matrices from the current animation frame and pass them to the GPU
-void VulkanglTFModel::updateJoints(VulkanglTFModel::Node *node)
+// Crowd instances pass joint buffers of their own (one per skin), otherwise the skins' buffers are written
+void VulkanglTFModel::updateJoints(VulkanglTFModel::Node *node, std::vector<vks::Buffer> *jointBuffers)
 {
 	if (node->skin > -1)
 	{
@@ -505,17 +503,18 @@ void VulkanglTFModel::updateJoints(VulkanglTFModel::Node *node)
 			jointMatrices[i] = inverseTransform * jointMatrices[i];
 		}
 		// Update ssbo
-		skin.ssbo.copyTo(jointMatrices.data(), jointMatrices.size() * sizeof(glm::mat4));
+		vks::Buffer &ssbo = jointBuffers ? (*jointBuffers)[node->skin] : skin.ssbo;
+		ssbo.copyTo(jointMatrices.data(), jointMatrices.size() * sizeof(glm::mat4));
 	}
 
 	for (auto &child : node->children)
 	{
-		updateJoints(child);
+		updateJoints(child, jointBuffers);
 	}
 }
 
 // POI: Update the current animation
-void VulkanglTFModel::updateAnimation(float deltaTime)
+void VulkanglTFModel::updateAnimation(float deltaTime, std::vector<vks::Buffer> *jointBuffers)
 {
 	if (activeAnimation > static_cast<uint32_t>(animations.size()) - 1)
 	{
@@ -573,7 +572,7 @@ void VulkanglTFModel::updateAnimation(float deltaTime)
 	}
 	for (auto &node : nodes)
 	{
-		updateJoints(node);
+		updateJoints(node, jointBuffers);
 	}
 }
 
@@ -582,7 +581,7 @@ void VulkanglTFModel::updateAnimation(float deltaTime)
 */
 
 // Draw a single node including child nodes (if present)
-void VulkanglTFModel::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node node)
+void VulkanglTFModel::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node node, const glm::mat4 &instanceMatrix, const std::vector<VkDescriptorSet> *jointDescriptorSets)
 {
 	if (node.mesh.primitives.size() > 0)
 	{
@@ -595,10 +594,12 @@ void VulkanglTFModel::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout p
 			nodeMatrix    = currentParent->matrix * nodeMatrix;
 			currentParent = currentParent->parent;
 		}
+		nodeMatrix = instanceMatrix * nodeMatrix;
 		// Pass the final matrix to the vertex shader using push constants
 		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &nodeMatrix);
 		// Bind SSBO with skin data for this node to set 1
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &skins[node.skin].descriptorSet, 0, nullptr);
+		const VkDescriptorSet jointDescriptorSet = jointDescriptorSets ? (*jointDescriptorSets)[node.skin] : skins[node.skin].descriptorSet;
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &jointDescriptorSet, 0, nullptr);
 		for (VulkanglTFModel::Primitive &primitive : node.mesh.primitives)
 		{
 			if (primitive.indexCount > 0)
@@ -613,12 +614,12 @@ void VulkanglTFModel::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout p
 	}
 	for (auto &child : node.children)
 	{
-		drawNode(commandBuffer, pipelineLayout, *child);
+		drawNode(commandBuffer, pipelineLayout, *child, instanceMatrix, jointDescriptorSets);
 	}
 }
 
 // Draw the glTF scene starting at the top-level-nodes
-void VulkanglTFModel::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+void VulkanglTFModel::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4 &instanceMatrix, const std::vector<VkDescriptorSet> *jointDescriptorSets)
 {
 	// All vertices and indices are stored in single buffers, so we only need to bind once
 	VkDeviceSize offsets[1] = {0};
@@ -627,7 +628,7 @@ void VulkanglTFModel::draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipel
 	// Render all nodes at top-level
 	for (auto &node : nodes)
 	{
-		drawNode(commandBuffer, pipelineLayout, *node);
+		drawNode(commandBuffer, pipelineLayout, *node, instanceMatrix, jointDescriptorSets);
 	}
 }
 
@@ -661,6 +662,7 @@ VulkanExample::~VulkanExample()
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.textures, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.jointMatrices, nullptr);
 
+	destroyCrowd();
 	shaderData.buffer.destroy();
 }
 
@@ -698,13 +700,19 @@ void VulkanExample::buildCommandBuffers()
 	{
 		renderPassBeginInfo.framebuffer = frameBuffers[i];
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		benchmark.gpuProfiler.reset(drawCmdBuffers[i], i);
 		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 		// Bind scene matrices descriptor to set 0
 		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.solid);
-		glTFModel.draw(drawCmdBuffers[i], pipelineLayout);
+		benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, "crowd");
+		for (auto &instance : crowd.instances)
+		{
+			glTFModel.draw(drawCmdBuffers[i], pipelineLayout, instance.matrix, &instance.jointDescriptorSets);
+		}
+		benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
 		drawUI(drawCmdBuffers[i]);
 		vkCmdEndRenderPass(drawCmdBuffers[i]);
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
@@ -892,6 +900,157 @@ void VulkanExample::setupDescriptors()
 	}
 }
 
+/*
+	Crowd stress test
+	Every instance samples the animation at its own time and writes the joint matrices of all skins into buffers of its own,
+	so the CPU and upload cost grows linearly with the crowd while all instances share the model's geometry and textures
+*/
+
+void VulkanExample::prepareCrowd(uint32_t instanceCount)
+{
+	destroyCrowd();
+	const uint32_t skinCount = static_cast<uint32_t>(glTFModel.skins.size());
+	if (skinCount > 0)
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+		    vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, instanceCount * skinCount),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, instanceCount * skinCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &crowd.descriptorPool));
+	}
+
+	// Instances are placed on a square grid around the origin and start at evenly spread times of the animation
+	const uint32_t gridSize  = static_cast<uint32_t>(ceil(sqrt(static_cast<float>(instanceCount))));
+	const float    spacing   = 1.0f;
+	const float    duration  = glTFModel.animations.empty() ? 0.0f : glTFModel.animations[glTFModel.activeAnimation].end;
+	crowd.instances.resize(instanceCount);
+	for (uint32_t i = 0; i < instanceCount; i++)
+	{
+		CrowdInstance &instance = crowd.instances[i];
+		const glm::vec3 position((static_cast<float>(i % gridSize) - (gridSize - 1) * 0.5f) * spacing, 0.0f, static_cast<float>(i / gridSize) * spacing);
+		instance.matrix        = glm::translate(glm::mat4(1.0f), position);
+		instance.animationTime = fmod(static_cast<float>(i) * 0.618034f, 1.0f) * duration;
+		instance.jointBuffers.resize(skinCount);
+		instance.jointDescriptorSets.resize(skinCount);
+		for (uint32_t j = 0; j < skinCount; j++)
+		{
+			const VulkanglTFModel::Skin &skin = glTFModel.skins[j];
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			    &instance.jointBuffers[j],
+			    sizeof(glm::mat4) * std::max(skin.inverseBindMatrices.size(), (size_t) 1),
+			    skin.inverseBindMatrices.empty() ? nullptr : (void *) skin.inverseBindMatrices.data()));
+			VK_CHECK_RESULT(instance.jointBuffers[j].map());
+			const VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(crowd.descriptorPool, &descriptorSetLayouts.jointMatrices, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &instance.jointDescriptorSets[j]));
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(instance.jointDescriptorSets[j], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &instance.jointBuffers[j].descriptor);
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		}
+	}
+	// Initial pose of all instances
+	updateCrowd(0.0f);
+}
+
+void VulkanExample::destroyCrowd()
+{
+	for (auto &instance : crowd.instances)
+	{
+		for (auto &buffer : instance.jointBuffers)
+		{
+			buffer.destroy();
+		}
+	}
+	crowd.instances.clear();
+	if (crowd.descriptorPool != VK_NULL_HANDLE)
+	{
+		vkDestroyDescriptorPool(device, crowd.descriptorPool, nullptr);
+		crowd.descriptorPool = VK_NULL_HANDLE;
+	}
+}
+
+// Advance the animation of every instance and write its joint matrices, timing the CPU cost and counting the bytes written
+void VulkanExample::updateCrowd(float deltaTime)
+{
+	if (glTFModel.animations.empty())
+	{
+		return;
+	}
+	VulkanglTFModel::Animation &animation = glTFModel.animations[glTFModel.activeAnimation];
+	VkDeviceSize jointUploadBytes = 0;
+	auto tStart = std::chrono::high_resolution_clock::now();
+	for (auto &instance : crowd.instances)
+	{
+		// The model's nodes hold the pose of the instance being updated
+		animation.currentTime = instance.animationTime;
+		glTFModel.updateAnimation(deltaTime, &instance.jointBuffers);
+		instance.animationTime = animation.currentTime;
+		for (auto &buffer : instance.jointBuffers)
+		{
+			jointUploadBytes += buffer.size;
+		}
+	}
+	auto tEnd = std::chrono::high_resolution_clock::now();
+	crowd.animationTime    = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+	crowd.jointUploadBytes = jointUploadBytes;
+}
+
+// Step through the crowd sizes, averaging the timings of each after a warm up and printing them once measured
+void VulkanExample::updateStressTest()
+{
+	if (!stressTest.active)
+	{
+		return;
+	}
+	stressTest.frame++;
+	if (stressTest.frame <= stressTest.warmupFrames)
+	{
+		return;
+	}
+	stressTest.animationTime += crowd.animationTime;
+	if (crowd.gpuTime > 0.0)
+	{
+		stressTest.gpuTime += crowd.gpuTime;
+		stressTest.gpuFrames++;
+	}
+	if (stressTest.frame < stressTest.warmupFrames + stressTest.measureFrames)
+	{
+		return;
+	}
+	if (crowd.sizeIndex == 0)
+	{
+		std::cout << "instances | CPU animation (ms) | joint uploads (KB/frame) | GPU scene (ms)" << std::endl;
+	}
+	std::cout << std::setw(9) << crowd.instances.size() << " | " << std::fixed << std::setprecision(3)
+	          << std::setw(18) << stressTest.animationTime / stressTest.measureFrames << " | "
+	          << std::setw(24) << crowd.jointUploadBytes / 1024.0 << " | ";
+	if (stressTest.gpuFrames > 0)
+	{
+		std::cout << stressTest.gpuTime / stressTest.gpuFrames;
+	}
+	else
+	{
+		std::cout << "n/a";
+	}
+	std::cout << std::endl;
+
+	stressTest.frame         = 0;
+	stressTest.gpuFrames     = 0;
+	stressTest.animationTime = 0.0;
+	stressTest.gpuTime       = 0.0;
+	if (crowd.sizeIndex + 1 < static_cast<int32_t>(crowd.sizes.size()))
+	{
+		crowd.sizeIndex++;
+		vkDeviceWaitIdle(device);
+		prepareCrowd(crowd.sizes[crowd.sizeIndex]);
+		buildCommandBuffers();
+	}
+	else
+	{
+		stressTest.active = false;
+	}
+}
+
 void VulkanExample::preparePipelines()
 {
 	VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI   = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
@@ -977,6 +1136,8 @@ void VulkanExample::prepare()
 	prepareUniformBuffers();
 	setupDescriptors();
 	preparePipelines();
+	stressTest.active = settings.stressTest;
+	prepareCrowd(crowd.sizes[crowd.sizeIndex]);
 	buildCommandBuffers();
 	prepared = true;
 }
@@ -988,11 +1149,18 @@ void VulkanExample::render()
 	{
 		updateUniformBuffers();
 	}
-	// POI: Advance animation
-	if (!paused)
+	// The profiler has collected the last submission of the acquired command buffer
+	crowd.gpuTime = 0.0;
+	for (auto &result : benchmark.gpuProfiler.results)
 	{
-		glTFModel.updateAnimation(frameTimer);
+		if (result.first == "crowd")
+		{
+			crowd.gpuTime = result.second;
+		}
 	}
+	// POI: Advance animation
+	updateCrowd(paused ? 0.0f : frameTimer);
+	updateStressTest();
 }
 
 void VulkanExample::viewChanged()
@@ -1008,6 +1176,27 @@ void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay *overlay)
 		{
 			buildCommandBuffers();
 		}
+		std::vector<std::string> sizeNames;
+		for (auto size : crowd.sizes)
+		{
+			sizeNames.push_back(std::to_string(size));
+		}
+		if (!stressTest.active && overlay->comboBox("Instances", &crowd.sizeIndex, sizeNames))
+		{
+			vkDeviceWaitIdle(device);
+			prepareCrowd(crowd.sizes[crowd.sizeIndex]);
+			buildCommandBuffers();
+		}
+	}
+	if (overlay->header("Crowd"))
+	{
+		overlay->text("CPU animation: %.3f ms", crowd.animationTime);
+		overlay->text("Joint uploads: %.1f KB", crowd.jointUploadBytes / 1024.0);
+		overlay->text("GPU scene: %.3f ms", crowd.gpuTime);
+		if (stressTest.active)
+		{
+			overlay->text("Stress test running...");
+		}
 	}
 }
 
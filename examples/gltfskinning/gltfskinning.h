@@ -181,10 +181,10 @@ class VulkanglTFModel
 	void      loadAnimations(tinygltf::Model &input);
 	void      loadNode(const tinygltf::Node &inputNode, const tinygltf::Model &input, VulkanglTFModel::Node *parent, uint32_t nodeIndex, std::vector<uint32_t> &indexBuffer, std::vector<VulkanglTFModel::Vertex> &vertexBuffer);
 	glm::mat4 getNodeMatrix(VulkanglTFModel::Node *node);
-	void      updateJoints(VulkanglTFModel::Node *node);
-	void      updateAnimation(float deltaTime);
-	void      drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node node);
-	void      draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+	void      updateJoints(VulkanglTFModel::Node *node, std::vector<vks::Buffer> *jointBuffers = nullptr);
+	void      updateAnimation(float deltaTime, std::vector<vks::Buffer> *jointBuffers = nullptr);
+	void      drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node node, const glm::mat4 &instanceMatrix, const std::vector<VkDescriptorSet> *jointDescriptorSets);
+	void      draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4 &instanceMatrix = glm::mat4(1.0f), const std::vector<VkDescriptorSet> *jointDescriptorSets = nullptr);
 };
 
 class VulkanExample : public VulkanExampleBase
@@ -220,6 +220,39 @@ class VulkanExample : public VulkanExampleBase
 
 	VulkanglTFModel glTFModel;
 
+	// Crowd of model copies with desynchronized animation times, each with joint matrix buffers (one per skin) of its own
+	struct CrowdInstance
+	{
+		glm::mat4                    matrix;
+		float                        animationTime;
+		std::vector<vks::Buffer>     jointBuffers;
+		std::vector<VkDescriptorSet> jointDescriptorSets;
+	};
+
+	struct Crowd
+	{
+		const std::vector<uint32_t> sizes     = {1, 10, 100, 1000};
+		int32_t                     sizeIndex = 0;
+		std::vector<CrowdInstance>  instances;
+		VkDescriptorPool            descriptorPool = VK_NULL_HANDLE;
+		// Last frame's CPU time for sampling the animations and writing the joint matrices, the bytes written and the GPU time of the scene pass
+		double       animationTime    = 0.0;
+		VkDeviceSize jointUploadBytes = 0;
+		double       gpuTime          = 0.0;
+	} crowd;
+
+	// Stress test (--stresstest), runs every crowd size for a number of frames and prints the averages of the crowd timings
+	struct StressTest
+	{
+		const uint32_t warmupFrames  = 30;
+		const uint32_t measureFrames = 300;
+		bool           active        = false;
+		uint32_t       frame         = 0;
+		uint32_t       gpuFrames     = 0;
+		double         animationTime = 0.0;
+		double         gpuTime       = 0.0;
+	} stressTest;
+
 	VulkanExample();
 	~VulkanExample();
 	void         loadglTFFile(std::string filename);
@@ -227,6 +260,10 @@ class VulkanExample : public VulkanExampleBase
 	void         buildCommandBuffers();
 	void         loadAssets();
 	void         setupDescriptors();
+	void         prepareCrowd(uint32_t instanceCount);
+	void         destroyCrowd();
+	void         updateCrowd(float deltaTime);
+	void         updateStressTest();
 	void         preparePipelines();
 	void         prepareUniformBuffers();
 	void         updateUniformBuffers();
@@ -477,7 +477,7 @@ public:
 
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -512,7 +512,7 @@ public:
 		if (newPipelineCreated)
 		{
 			newPipelineCreated = false;
-			vkQueueWaitIdle(queue);
+			vulkanDevice->queueWaitIdle(queue);
 			buildCommandBuffers();
 		}
 		draw();
@@ -3,6 +3,10 @@
 *
 * Note: Requires the separate asset pack (see data/README.md)
 *
+* The offscreen color targets use the smallest float format the device can render to and sample from (selectable in the UI). With the
+* fused post processing path the scene is stored in linear space, the bloom is built from it in compute (vks::BloomChain) and a single
+* fullscreen pass adds the bloom and applies the tone mapping, so the bright pass target and the separable blur are skipped
+*
 * Copyright by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -10,6 +14,10 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanFrameBuffer.hpp"
+#include "VulkanBloom.h"
+#include "VulkanSpecialization.hpp"
+#include <memory>
 
 #define ENABLE_VALIDATION false
 
@@ -18,6 +26,14 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool bloom = true;
 	bool displaySkybox = true;
+	// Bloom in compute and tone mapping in the composition pass instead of the bright pass and separable blur
+	bool fusedPostProcess = true;
+	std::unique_ptr<vks::BloomChain> bloomChain;
+
+	// Float formats usable for the offscreen color targets, smallest first
+	std::vector<VkFormat> colorFormats;
+	std::vector<std::string> colorFormatNames;
+	int32_t colorFormatIndex = 0;
 
 	struct {
 		vks::TextureCubeMap envmap;
@@ -42,6 +58,8 @@ public:
 
 	struct UBOParams {
 		float exposure = 1.0f;
+		// Only used by the fused tone mapping pass
+		float bloomStrength = 0.5f;
 	} uboParams;
 
 	struct {
@@ -49,12 +67,17 @@ public:
 		VkPipeline reflect;
 		VkPipeline composition;
 		VkPipeline bloom[2];
+		// Fused path: scene with linear output and tone mapping without (0) and with (1) bloom
+		VkPipeline skyboxLinear;
+		VkPipeline reflectLinear;
+		VkPipeline tonemap[2];
 	} pipelines;
 
 	struct {
 		VkPipelineLayout models;
 		VkPipelineLayout composition;
 		VkPipelineLayout bloomFilter;
+		VkPipelineLayout tonemap;
 	} pipelineLayouts;
 
 	struct {
@@ -62,12 +85,14 @@ public:
 		VkDescriptorSet skybox;
 		VkDescriptorSet composition;
 		VkDescriptorSet bloomFilter;
+		VkDescriptorSet tonemap;
 	} descriptorSets;
 
 	struct {
 		VkDescriptorSetLayout models;
 		VkDescriptorSetLayout composition;
 		VkDescriptorSetLayout bloomFilter;
+		VkDescriptorSetLayout tonemap;
 	} descriptorSetLayouts;
 
 	// Framebuffer for offscreen rendering
@@ -76,6 +101,7 @@ public:
 		VkDeviceMemory mem;
 		VkImageView view;
 		VkFormat format;
+		vks::ImageCompression compression;
 		void destroy(VkDevice device)
 		{
 			vkDestroyImageView(device, view, nullptr);
@@ -89,6 +115,8 @@ public:
 		FrameBufferAttachment color[2];
 		FrameBufferAttachment depth;
 		VkRenderPass renderPass;
+		// Compatible with renderPass, but doesn't store the bright pass target that the fused path doesn't use
+		VkRenderPass renderPassFused;
 		VkSampler sampler;
 	} offscreen;
 
@@ -113,21 +141,43 @@ public:
 
 	~VulkanExample()
 	{
-		vkDestroyPipeline(device, pipelines.skybox, nullptr);
-		vkDestroyPipeline(device, pipelines.reflect, nullptr);
-		vkDestroyPipeline(device, pipelines.composition, nullptr);
-		vkDestroyPipeline(device, pipelines.bloom[0], nullptr);
-		vkDestroyPipeline(device, pipelines.bloom[1], nullptr);
+		destroyPipelines();
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.models, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.composition, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.bloomFilter, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.tonemap, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.models, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.composition, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.bloomFilter, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.tonemap, nullptr);
+
+		destroyOffscreen();
+		bloomChain.reset();
 
+		uniformBuffers.matrices.destroy();
+		uniformBuffers.params.destroy();
+		textures.envmap.destroy();
+	}
+
+	void destroyPipelines()
+	{
+		vkDestroyPipeline(device, pipelines.skybox, nullptr);
+		vkDestroyPipeline(device, pipelines.reflect, nullptr);
+		vkDestroyPipeline(device, pipelines.composition, nullptr);
+		vkDestroyPipeline(device, pipelines.bloom[0], nullptr);
+		vkDestroyPipeline(device, pipelines.bloom[1], nullptr);
+		vkDestroyPipeline(device, pipelines.skyboxLinear, nullptr);
+		vkDestroyPipeline(device, pipelines.reflectLinear, nullptr);
+		vkDestroyPipeline(device, pipelines.tonemap[0], nullptr);
+		vkDestroyPipeline(device, pipelines.tonemap[1], nullptr);
+	}
+
+	void destroyOffscreen()
+	{
 		vkDestroyRenderPass(device, offscreen.renderPass, nullptr);
+		vkDestroyRenderPass(device, offscreen.renderPassFused, nullptr);
 		vkDestroyRenderPass(device, filterPass.renderPass, nullptr);
 
 		vkDestroyFramebuffer(device, offscreen.frameBuffer, nullptr);
@@ -141,10 +191,27 @@ public:
 		offscreen.color[1].destroy(device);
 
 		filterPass.color[0].destroy(device);
+	}
 
-		uniformBuffers.matrices.destroy();
-		uniformBuffers.params.destroy();
-		textures.envmap.destroy();
+	// Collect the float formats that can be rendered to and sampled from with linear filtering, the smallest one is used by default
+	void selectColorFormats()
+	{
+		const std::vector<std::pair<VkFormat, std::string>> candidates = {
+			{ VK_FORMAT_B10G11R11_UFLOAT_PACK32, "B10G11R11 (4 bytes)" },
+			{ VK_FORMAT_R16G16B16A16_SFLOAT, "R16G16B16A16 (8 bytes)" },
+			{ VK_FORMAT_R32G32B32A32_SFLOAT, "R32G32B32A32 (16 bytes)" },
+		};
+		const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+		for (auto& candidate : candidates) {
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, candidate.first, &formatProperties);
+			if ((formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures) {
+				colorFormats.push_back(candidate.first);
+				colorFormatNames.push_back(candidate.second);
+			}
+		}
+		assert(!colorFormats.empty());
+		colorFormatIndex = 0;
 	}
 
 	void buildCommandBuffers()
@@ -180,7 +247,7 @@ public:
 				clearValues[2].depthStencil = { 1.0f, 0 };
 
 				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = offscreen.renderPass;
+				renderPassBeginInfo.renderPass = fusedPostProcess ? offscreen.renderPassFused : offscreen.renderPass;
 				renderPassBeginInfo.framebuffer = offscreen.frameBuffer;
 				renderPassBeginInfo.renderArea.extent.width = offscreen.width;
 				renderPassBeginInfo.renderArea.extent.height = offscreen.height;
@@ -203,7 +270,7 @@ public:
 					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.models, 0, 1, &descriptorSets.skybox, 0, NULL);
 					vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &models.skybox.vertices.buffer, offsets);
 					vkCmdBindIndexBuffer(drawCmdBuffers[i], models.skybox.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skybox);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, fusedPostProcess ? pipelines.skyboxLinear : pipelines.skybox);
 					models.skybox.draw(drawCmdBuffers[i]);
 				}
 
@@ -211,16 +278,28 @@ public:
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.models, 0, 1, &descriptorSets.object, 0, NULL);
 				vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &models.objects[models.objectIndex].vertices.buffer, offsets);
 				vkCmdBindIndexBuffer(drawCmdBuffers[i], models.objects[models.objectIndex].indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.reflect);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, fusedPostProcess ? pipelines.reflectLinear : pipelines.reflect);
 				models.objects[models.objectIndex].draw(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
 
+			/*
+				Fused path: Build the bloom from the linear scene color in compute
+			*/
+			if (fusedPostProcess && bloom) {
+				// The offscreen pass' external dependency doesn't cover compute shader reads
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+				bloomChain->record(drawCmdBuffers[i]);
+			}
+
 			/*
 				Second render pass: First bloom pass
 			*/
-			if (bloom) {
+			if (!fusedPostProcess && bloom) {
 				VkClearValue clearValues[2];
 				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
 				clearValues[1].depthStencil = { 1.0f, 0 };
@@ -279,16 +358,23 @@ public:
 				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composition, 0, 1, &descriptorSets.composition, 0, NULL);
-
-				// Scene
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				if (fusedPostProcess) {
+					// Scene, bloom and tone mapping in one pass
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.tonemap, 0, 1, &descriptorSets.tonemap, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.tonemap[bloom ? 1 : 0]);
+					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+				} else {
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composition, 0, 1, &descriptorSets.composition, 0, NULL);
 
-				// Bloom
-				if (bloom) {
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.bloom[0]);
+					// Scene
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
 					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+
+					// Bloom
+					if (bloom) {
+						vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.bloom[0]);
+						vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+					}
 				}
 
 				drawUI(drawCmdBuffers[i]);
@@ -300,7 +386,8 @@ public:
 		}
 	}
 
-	void createAttachment(VkFormat format, VkImageUsageFlagBits usage, FrameBufferAttachment *attachment)
+	// Requests the given framebuffer compression if image compression control is enabled
+	void createAttachment(VkFormat format, VkImageUsageFlagBits usage, FrameBufferAttachment *attachment, VkImageCompressionFlagsEXT compression)
 	{
 		VkImageAspectFlags aspectMask = 0;
 		VkImageLayout imageLayout;
@@ -337,7 +424,7 @@ public:
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
 
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment->image));
+		VK_CHECK_RESULT(vks::createAttachmentImage(vulkanDevice, image, compression, &attachment->image, &attachment->compression));
 		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
 		memAlloc.allocationSize = memReqs.size;
 		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
@@ -366,11 +453,11 @@ public:
 
 			// Color attachments
 
-			// Two floating point color buffers
-			createAttachment(VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &offscreen.color[0]);
-			createAttachment(VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &offscreen.color[1]);
+			// Two floating point color buffers, the bright parts only feed the blurred bloom and may use lossy fixed-rate compression
+			createAttachment(colorFormats[colorFormatIndex], VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &offscreen.color[0], vks::getLosslessCompression(settings.imageCompression));
+			createAttachment(colorFormats[colorFormatIndex], VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &offscreen.color[1], settings.imageCompression);
 			// Depth attachment
-			createAttachment(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, &offscreen.depth);
+			createAttachment(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, &offscreen.depth, vks::getLosslessCompression(settings.imageCompression));
 
 			// Set up separate renderpass with references to the color and depth attachments
 			std::array<VkAttachmentDescription, 3> attachmentDescs = {};
@@ -444,6 +531,11 @@ public:
 
 			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &offscreen.renderPass));
 
+			// Load and store operations don't affect render pass compatibility, so the fused path can use the same pipelines and framebuffer
+			attachmentDescs[1].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachmentDescs[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &offscreen.renderPassFused));
+
 			std::array<VkImageView, 3> attachments;
 			attachments[0] = offscreen.color[0].view;
 			attachments[1] = offscreen.color[1].view;
@@ -483,8 +575,8 @@ public:
 
 			// Color attachments
 
-			// Two floating point color buffers
-			createAttachment(VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &filterPass.color[0]);
+			// Floating point color buffer, blurred so it may use lossy fixed-rate compression
+			createAttachment(colorFormats[colorFormatIndex], VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &filterPass.color[0], settings.imageCompression);
 
 			// Set up separate renderpass with references to the color and depth attachments
 			std::array<VkAttachmentDescription, 1> attachmentDescs = {};
@@ -566,6 +658,11 @@ public:
 			sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 			VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &filterPass.sampler));
 		}
+
+		// Compute bloom from the linear scene color
+		if (bloomChain->isSupported()) {
+			bloomChain->create(offscreen.width, offscreen.height, offscreen.color[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		}
 	}
 
 	void loadAssets()
@@ -586,10 +683,10 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8)
 		};
-		uint32_t numDescriptorSets = 4;
+		uint32_t numDescriptorSets = 5;
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), numDescriptorSets);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -638,6 +735,19 @@ public:
 
 		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.composition, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.composition));
+
+		// Fused bloom and tone mapping
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+		};
+
+		descriptorLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutInfo, nullptr, &descriptorSetLayouts.tonemap));
+
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.tonemap, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.tonemap));
 	}
 
 	void setupDescriptorSets()
@@ -672,21 +782,33 @@ public:
 		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.bloomFilter, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.bloomFilter));
 
+		// Composition descriptor set
+		allocInfo =	vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.composition, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.composition));
+
+		// Fused tone mapping descriptor set
+		allocInfo =	vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.tonemap, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.tonemap));
+
+		updateDescriptorSets();
+	}
+
+	// Update the descriptors referencing the offscreen targets, called again after they have been recreated
+	void updateDescriptorSets()
+	{
+		// Bloom filter
 		std::vector<VkDescriptorImageInfo> colorDescriptors = {
 			vks::initializers::descriptorImageInfo(offscreen.sampler, offscreen.color[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
 			vks::initializers::descriptorImageInfo(offscreen.sampler, offscreen.color[1].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
 		};
 
-		writeDescriptorSets = {
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSets.bloomFilter, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &colorDescriptors[0]),
 			vks::initializers::writeDescriptorSet(descriptorSets.bloomFilter, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &colorDescriptors[1]),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
-		// Composition descriptor set
-		allocInfo =	vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.composition, 1);
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.composition));
-
+		// Composition
 		colorDescriptors = {
 			vks::initializers::descriptorImageInfo(offscreen.sampler, offscreen.color[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
 			vks::initializers::descriptorImageInfo(offscreen.sampler, filterPass.color[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
@@ -697,6 +819,21 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &colorDescriptors[1]),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// Fused tone mapping, only used with the bloom chain
+		if (bloomChain->isSupported()) {
+			colorDescriptors = {
+				vks::initializers::descriptorImageInfo(offscreen.sampler, offscreen.color[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+				bloomChain->getDescriptor(),
+			};
+
+			writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSets.tonemap, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &colorDescriptors[0]),
+				vks::initializers::writeDescriptorSet(descriptorSets.tonemap, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &colorDescriptors[1]),
+				vks::initializers::writeDescriptorSet(descriptorSets.tonemap, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffers.params.descriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+		}
 	}
 
 	void preparePipelines()
@@ -771,6 +908,20 @@ public:
 		dir = 0;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.bloom[1]));
 
+		// Fused bloom and tone mapping pass, without and with bloom
+		// layout (constant_id = 0) const int applyBloom
+		vks::SpecializationConstants<int32_t> tonemapSpecializationConstants;
+		blendAttachmentState.blendEnable = VK_FALSE;
+		pipelineCI.layout = pipelineLayouts.tonemap;
+		pipelineCI.renderPass = renderPass;
+		shaderStages[0] = loadShader(getShadersPath() + "hdr/composition.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "hdr/tonemap.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[1].pSpecializationInfo = tonemapSpecializationConstants.getInfo();
+		for (int32_t applyBloom = 0; applyBloom < 2; applyBloom++) {
+			tonemapSpecializationConstants.set<0>(applyBloom);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.tonemap[applyBloom]));
+		}
+
 		// Object rendering pipelines
 		// Use vertex input state from glTF model setup
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal });
@@ -783,23 +934,47 @@ public:
 		shaderStages[0] = loadShader(getShadersPath() + "hdr/gbuffer.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "hdr/gbuffer.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		// Set constant parameters via specialization constants
-		specializationMapEntries[0] = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
-		uint32_t shadertype = 0;
-		specializationInfo = vks::initializers::specializationInfo(1, specializationMapEntries.data(), sizeof(shadertype), &shadertype);
-		shaderStages[0].pSpecializationInfo = &specializationInfo;
-		shaderStages[1].pSpecializationInfo = &specializationInfo;
+		// layout (constant_id = 0) const int type
+		// layout (constant_id = 1) const int linearOutput
+		vks::SpecializationConstants<int32_t, int32_t> gbufferSpecializationConstants;
+		gbufferSpecializationConstants.set<0>(0);
+		gbufferSpecializationConstants.set<1>(0);
+		shaderStages[0].pSpecializationInfo = gbufferSpecializationConstants.getInfo();
+		shaderStages[1].pSpecializationInfo = gbufferSpecializationConstants.getInfo();
 		// Skybox pipeline (background cube)
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skybox));
+		gbufferSpecializationConstants.set<1>(1);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skyboxLinear));
 
 		// Object rendering pipeline
-		shadertype = 1;
+		gbufferSpecializationConstants.set<0>(1);
+		gbufferSpecializationConstants.set<1>(0);
 		// Enable depth test and write
 		depthStencilState.depthWriteEnable = VK_TRUE;
 		depthStencilState.depthTestEnable = VK_TRUE;
 		// Flip cull mode
 		rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.reflect));
+		gbufferSpecializationConstants.set<1>(1);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.reflectLinear));
+	}
+
+	// Recreate the offscreen targets and everything referencing them, after a resize or a change of the color format
+	void rebuildOffscreen()
+	{
+		vkDeviceWaitIdle(device);
+		destroyPipelines();
+		destroyOffscreen();
+		prepareoffscreenfer();
+		preparePipelines();
+		updateDescriptorSets();
+		buildCommandBuffers();
+	}
+
+	virtual void windowResized()
+	{
+		rebuildOffscreen();
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -845,7 +1020,7 @@ public:
 		VulkanExampleBase::prepareFrame();
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -854,6 +1029,11 @@ public:
 		VulkanExampleBase::prepare();
 		loadAssets();
 		prepareUniformBuffers();
+		selectColorFormats();
+		bloomChain.reset(new vks::BloomChain(vulkanDevice, getShadersPath() + "base/bloomdownsample.comp.spv", getShadersPath() + "base/bloomupsample.comp.spv"));
+		// The scene is stored in linear space in the fused path, only values above 1 contribute to the bloom
+		bloomChain->setThreshold(1.0f, 0.5f);
+		fusedPostProcess = bloomChain->isSupported();
 		prepareoffscreenfer();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -890,10 +1070,25 @@ public:
 			if (overlay->checkBox("Bloom", &bloom)) {
 				buildCommandBuffers();
 			}
+			if (bloomChain->isSupported() && overlay->checkBox("Fused bloom and tone mapping", &fusedPostProcess)) {
+				buildCommandBuffers();
+			}
+			if (fusedPostProcess && bloom && overlay->sliderFloat("Bloom strength", &uboParams.bloomStrength, 0.0f, 2.0f)) {
+				updateParams();
+			}
+			if (overlay->comboBox("Render target format", &colorFormatIndex, colorFormatNames)) {
+				rebuildOffscreen();
+			}
 			if (overlay->checkBox("Skybox", &displaySkybox)) {
 				buildCommandBuffers();
 			}
 		}
+		if (settings.imageCompressionControl && overlay->header("Framebuffer compression")) {
+			overlay->text("Scene color: %s", offscreen.color[0].compression.toString().c_str());
+			overlay->text("Bright parts: %s", offscreen.color[1].compression.toString().c_str());
+			overlay->text("Depth: %s", offscreen.depth.compression.toString().c_str());
+			overlay->text("Bloom filter: %s", filterPass.color[0].compression.toString().c_str());
+		}
 	}
 };
 
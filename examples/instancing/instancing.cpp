@@ -1,6 +1,9 @@
 /*
 * Vulkan Example - Instanced mesh rendering, uses a separate vertex buffer for instanced data
 *
+* Optionally the instances are frustum culled in a compute shader that also selects a level of detail per instance and writes the indirect
+* draws of the visible instances, so the instance count can be scaled far beyond what the plain instanced draw can handle
+*
 * Copyright (C) 2016-2021 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -8,15 +11,21 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "frustum.hpp"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define INSTANCE_BUFFER_BIND_ID 1
 #define ENABLE_VALIDATION false
+// Default number of instances and the number the instance buffers are sized for
 #if defined(__ANDROID__)
 #define INSTANCE_COUNT 4096
+#define MAX_INSTANCE_COUNT 262144
 #else
 #define INSTANCE_COUNT 8192
+#define MAX_INSTANCE_COUNT 1048576
 #endif
+// Maximum number of levels of detail of the rock used by the GPU culling path
+#define MAX_LOD_COUNT 4
 
 class VulkanExample : public VulkanExampleBase
 {
@@ -39,7 +48,7 @@ public:
 		float scale;
 		uint32_t texIndex;
 	};
-	// Contains the instanced data
+	// Contains the instanced data, sized for MAX_INSTANCE_COUNT instances
 	struct InstanceBuffer {
 		VkBuffer buffer = VK_NULL_HANDLE;
 		VkDeviceMemory memory = VK_NULL_HANDLE;
@@ -47,6 +56,15 @@ public:
 		VkDescriptorBufferInfo descriptor;
 	} instanceBuffer;
 
+	// Number of instances drawn, can be changed at runtime (see setInstanceCount) and with the "-ic" command line argument
+	uint32_t instanceCount = INSTANCE_COUNT;
+	std::vector<uint32_t> instanceCounts;
+	int32_t instanceCountIndex = 0;
+	// The benchmark steps through all instance counts, drawing each of them for this number of frames
+	const uint32_t benchmarkFramesPerCount = 500;
+	uint32_t benchmarkFrame = 0;
+	bool fixedInstanceCount = false;
+
 	struct UBOVS {
 		glm::mat4 projection;
 		glm::mat4 view;
@@ -55,13 +73,56 @@ public:
 		float globSpeed = 0.0f;
 	} uboVS;
 
+	// Uniform block of the culling compute shader
+	struct UBOCulling {
+		glm::vec4 frustumPlanes[6];
+		glm::vec4 viewPos;
+		// Simplification error of each level of detail in model units
+		float lodErrors[MAX_LOD_COUNT];
+		float globSpeed;
+		// Simplification error allowed per unit of distance from the camera, derived from lodPixelError
+		float errorPerDistance;
+		// Radius of the rock's bounding sphere around its origin
+		float radius;
+		uint32_t instanceCount;
+		uint32_t lodCount;
+		// Every level of detail has its own range of the visible instance buffer with room for all instances
+		uint32_t lodCapacity = MAX_INSTANCE_COUNT;
+	} uboCulling;
+
 	struct {
 		vks::Buffer scene;
+		vks::Buffer culling;
 	} uniformBuffers;
 
+	// [POI] GPU culling and level of detail selection
+	// A compute shader tests every instance against the view frustum and appends the visible ones to the instance range of their level of detail,
+	// the instance counts of the indirect draws (one per level of detail) are incremented by the same shader
+	struct {
+		bool supported = false;
+		bool enabled = true;
+		// Index ranges of the rock's levels of detail (generated at load time), the first one is the full detail mesh
+		std::vector<vkglTF::Primitive::Lod> lods;
+		// Indices of the visible instances, level of detail i starts at i * MAX_INSTANCE_COUNT
+		vks::Buffer visibleInstances;
+		vks::Buffer indirectCommands;
+		// Commands with zero instances, copied into indirectCommands before the culling pass
+		std::vector<VkDrawIndexedIndirectCommand> commands;
+		// Copies of the indirect commands per command buffer, read back once the command buffer has finished
+		std::vector<vks::Buffer> statistics;
+		uint32_t visibleCounts[MAX_LOD_COUNT] = {};
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+	} culling;
+	// Screen space error in pixels below which a lower level of detail is selected
+	float lodPixelError = 1.0f;
+
 	VkPipelineLayout pipelineLayout;
 	struct {
 		VkPipeline instancedRocks;
+		VkPipeline culledRocks = VK_NULL_HANDLE;
 		VkPipeline planet;
 		VkPipeline starfield;
 	} pipelines;
@@ -69,30 +130,62 @@ public:
 	VkDescriptorSetLayout descriptorSetLayout;
 	struct {
 		VkDescriptorSet instancedRocks;
+		VkDescriptorSet culledRocks;
 		VkDescriptorSet planet;
 	} descriptorSets;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Instanced mesh rendering";
+		supportsFramesInFlight = true;
 		camera.type = Camera::CameraType::lookat;
 		camera.setPosition(glm::vec3(5.5f, -1.85f, -18.5f));
 		camera.setRotation(glm::vec3(-17.2f, -4.7f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 1.0f, 256.0f);
+		// Selectable instance counts, the benchmark is run for all of them unless a count is passed on the command line
+		for (uint32_t count = INSTANCE_COUNT; count <= MAX_INSTANCE_COUNT; count *= 4) {
+			instanceCounts.push_back(count);
+		}
+		if (instanceCounts.back() != MAX_INSTANCE_COUNT) {
+			instanceCounts.push_back(MAX_INSTANCE_COUNT);
+		}
+		commandLineParser.add("instancecount", { "-ic", "--instancecount" }, 1, "Set the number of rock instances");
+		commandLineParser.parse(args);
+		if (commandLineParser.isSet("instancecount")) {
+			instanceCount = std::min(static_cast<uint32_t>(commandLineParser.getValueAsInt("instancecount", INSTANCE_COUNT)), static_cast<uint32_t>(MAX_INSTANCE_COUNT));
+			// Instances are distributed on two rings in pairs
+			instanceCount = std::max(instanceCount & ~1u, 2u);
+			fixedInstanceCount = true;
+		}
+		for (size_t i = 0; i < instanceCounts.size(); i++) {
+			if (instanceCounts[i] <= instanceCount) {
+				instanceCountIndex = static_cast<int32_t>(i);
+			}
+		}
 	}
 
 	~VulkanExample()
 	{
 		vkDestroyPipeline(device, pipelines.instancedRocks, nullptr);
+		vkDestroyPipeline(device, pipelines.culledRocks, nullptr);
 		vkDestroyPipeline(device, pipelines.planet, nullptr);
 		vkDestroyPipeline(device, pipelines.starfield, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		vkDestroyPipeline(device, culling.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, culling.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, culling.descriptorSetLayout, nullptr);
 		vkDestroyBuffer(device, instanceBuffer.buffer, nullptr);
 		vkFreeMemory(device, instanceBuffer.memory, nullptr);
+		culling.visibleInstances.destroy();
+		culling.indirectCommands.destroy();
+		for (auto& buffer : culling.statistics) {
+			buffer.destroy();
+		}
 		textures.rocks.destroy();
 		textures.planet.destroy();
 		uniformBuffers.scene.destroy();
+		uniformBuffers.culling.destroy();
 	}
 
 	// Enable physical device features required for this example
@@ -102,6 +195,14 @@ public:
 		if (deviceFeatures.samplerAnisotropy) {
 			enabledFeatures.samplerAnisotropy = VK_TRUE;
 		}
+		// The indirect draws of the culling path start at the instance range of their level of detail
+		if (deviceFeatures.drawIndirectFirstInstance) {
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+		}
+		// Draw all levels of detail with a single call if supported
+		if (deviceFeatures.multiDrawIndirect) {
+			enabledFeatures.multiDrawIndirect = VK_TRUE;
+		}
 	};
 
 	void buildCommandBuffers()
@@ -126,6 +227,18 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			benchmark.gpuProfiler.reset(drawCmdBuffers[i], i);
+
+			// GPU times are logged per instance count, so the benchmark results of all counts can be compared
+			const std::string countSuffix = " (" + std::to_string(instanceCount) + " instances)";
+			const bool gpuCulling = culling.supported && culling.enabled;
+
+			if (gpuCulling) {
+				benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, "Culling" + countSuffix);
+				recordCulling(drawCmdBuffers[i], i);
+				benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
+			}
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -147,17 +260,38 @@ public:
 			models.planet.draw(drawCmdBuffers[i]);
 
 			// Instanced rocks
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.instancedRocks, 0, NULL);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.instancedRocks);
-			// Binding point 0 : Mesh vertex buffer
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &models.rock.vertices.buffer, offsets);
-			// Binding point 1 : Instance data buffer
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], INSTANCE_BUFFER_BIND_ID, 1, &instanceBuffer.buffer, offsets);
-			// Bind index buffer
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], models.rock.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-
-			// Render instances
-			vkCmdDrawIndexed(drawCmdBuffers[i], models.rock.indices.count, INSTANCE_COUNT, 0, 0, 0);
+			benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, (gpuCulling ? "Rocks culled" : "Rocks") + countSuffix);
+			if (gpuCulling) {
+				// The visible instances are fetched by the vertex shader from the instance buffer through the visible instance indices
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.culledRocks, 0, NULL);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.culledRocks);
+				vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &models.rock.vertices.buffer, offsets);
+				vkCmdBindIndexBuffer(drawCmdBuffers[i], models.rock.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+				// One indirect draw per level of detail, with the instance counts written by the culling pass
+				const uint32_t lodCount = static_cast<uint32_t>(culling.lods.size());
+				if (vulkanDevice->enabledFeatures.multiDrawIndirect) {
+					vkCmdDrawIndexedIndirect(drawCmdBuffers[i], culling.indirectCommands.buffer, 0, lodCount, sizeof(VkDrawIndexedIndirectCommand));
+				}
+				else {
+					for (uint32_t lod = 0; lod < lodCount; lod++) {
+						vkCmdDrawIndexedIndirect(drawCmdBuffers[i], culling.indirectCommands.buffer, lod * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+					}
+				}
+			}
+			else {
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.instancedRocks, 0, NULL);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.instancedRocks);
+				// Binding point 0 : Mesh vertex buffer
+				vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &models.rock.vertices.buffer, offsets);
+				// Binding point 1 : Instance data buffer
+				vkCmdBindVertexBuffers(drawCmdBuffers[i], INSTANCE_BUFFER_BIND_ID, 1, &instanceBuffer.buffer, offsets);
+				// Bind index buffer
+				vkCmdBindIndexBuffer(drawCmdBuffers[i], models.rock.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+				// Render instances
+				vkCmdDrawIndexed(drawCmdBuffers[i], culling.lods[0].indexCount, instanceCount, culling.lods[0].firstIndex, 0, 0);
+			}
+			benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -167,30 +301,86 @@ public:
 		}
 	}
 
+	// Frustum cull the instances and write the indirect draws of the visible ones, recorded outside of the render pass
+	void recordCulling(VkCommandBuffer commandBuffer, uint32_t index)
+	{
+		// The previous frame's draws have to be done with the commands and visible instances before they are written again
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = 0;
+		memoryBarrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		// Reset the instance counts of the indirect draws
+		vkCmdUpdateBuffer(commandBuffer, culling.indirectCommands.buffer, 0, culling.commands.size() * sizeof(VkDrawIndexedIndirectCommand), culling.commands.data());
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling.pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling.pipelineLayout, 0, 1, &culling.descriptorSet, 0, nullptr);
+		vkCmdDispatch(commandBuffer, (instanceCount + 63) / 64, 1, 1);
+
+		// Make the commands and visible instances available to the draws and the statistics copy
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		// Copy the commands for the visible instance counts displayed in the UI
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = culling.commands.size() * sizeof(VkDrawIndexedIndirectCommand);
+		vkCmdCopyBuffer(commandBuffer, culling.indirectCommands.buffer, culling.statistics[index].buffer, 1, &copyRegion);
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
 	void loadAssets()
 	{
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
-		models.rock.loadFromFile(getAssetPath() + "models/rock01.gltf", vulkanDevice, queue, glTFLoadingFlags);
+		// Simplified index ranges of the rock are generated for the level of detail selection of the culling path
+		models.rock.loadFromFile(getAssetPath() + "models/rock01.gltf", vulkanDevice, queue, glTFLoadingFlags | vkglTF::FileLoadingFlags::GenerateLods);
 		models.planet.loadFromFile(getAssetPath() + "models/lavaplanet.gltf", vulkanDevice, queue, glTFLoadingFlags);
 
+		// The rock is a single primitive
+		for (auto node : models.rock.linearNodes) {
+			if (node->mesh && !node->mesh->primitives.empty()) {
+				const vkglTF::Primitive* primitive = node->mesh->primitives[0];
+				for (size_t i = 0; i < std::min(primitive->lods.size(), static_cast<size_t>(MAX_LOD_COUNT)); i++) {
+					culling.lods.push_back(primitive->lods[i]);
+				}
+				break;
+			}
+		}
+		if (culling.lods.empty()) {
+			culling.lods.push_back({ 0, models.rock.indices.count, 0.0f });
+		}
+		uboCulling.lodCount = static_cast<uint32_t>(culling.lods.size());
+		for (uint32_t i = 0; i < MAX_LOD_COUNT; i++) {
+			uboCulling.lodErrors[i] = culling.lods[std::min(i, uboCulling.lodCount - 1)].error;
+		}
+		// Bounding sphere around the rock's origin, which instances are rotated and scaled around
+		const glm::vec3 extent = glm::max(glm::abs(models.rock.dimensions.min), glm::abs(models.rock.dimensions.max));
+		uboCulling.radius = glm::length(extent);
+
 		textures.planet.loadFromFile(getAssetPath() + "textures/lavaplanet_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 		textures.rocks.loadFromFile(getAssetPath() + "textures/texturearray_rocks_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 	}
 
 	void setupDescriptorPool()
 	{
-		// Example uses one ubo
+		// Example uses one ubo for rendering and one for culling
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				poolSizes.size(),
 				poolSizes.data(),
-				2);
+				4);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -202,6 +392,10 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
 			// Binding 1 : Fragment shader combined sampler
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+			// Binding 2 : Vertex shader instance data (culling path only)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 2),
+			// Binding 3 : Vertex shader visible instance indices (culling path only)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 3),
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
 			vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
@@ -209,6 +403,23 @@ public:
 
 		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		// Culling compute shader
+		setLayoutBindings = {
+			// Binding 0 : Culling uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Instance data
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Visible instance indices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3 : Indirect draw commands
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &culling.descriptorSetLayout));
+
+		pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&culling.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &culling.pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -234,6 +445,26 @@ public:
 		};
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 
+		// Culled rocks
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descripotrSetAllocInfo, &descriptorSets.culledRocks));
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.culledRocks, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.scene.descriptor),				// Binding 0 : Vertex shader uniform buffer
+			vks::initializers::writeDescriptorSet(descriptorSets.culledRocks, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.rocks.descriptor),			// Binding 1 : Color map
+			vks::initializers::writeDescriptorSet(descriptorSets.culledRocks, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &instanceBuffer.descriptor),					// Binding 2 : Instance data
+			vks::initializers::writeDescriptorSet(descriptorSets.culledRocks, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &culling.visibleInstances.descriptor)			// Binding 3 : Visible instance indices
+		};
+		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+
+		// Culling
+		descripotrSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &culling.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descripotrSetAllocInfo, &culling.descriptorSet));
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(culling.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.culling.descriptor),				// Binding 0 : Culling uniform buffer
+			vks::initializers::writeDescriptorSet(culling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &instanceBuffer.descriptor),						// Binding 1 : Instance data
+			vks::initializers::writeDescriptorSet(culling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &culling.visibleInstances.descriptor),				// Binding 2 : Visible instance indices
+			vks::initializers::writeDescriptorSet(culling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &culling.indirectCommands.descriptor)				// Binding 3 : Indirect draw commands
+		};
+		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 	}
 
 	void preparePipelines()
@@ -315,6 +546,18 @@ public:
 		inputState.vertexAttributeDescriptionCount = 4;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.planet));
 
+		// Culled rocks pipeline
+		// Uses the same per-vertex input as the planet, the instance data is fetched from the storage buffers
+		if (culling.supported) {
+			shaderStages[0] = loadShader(getShadersPath() + "instancing/culled.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			shaderStages[1] = loadShader(getShadersPath() + "instancing/instancing.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.culledRocks));
+
+			VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(culling.pipelineLayout, 0);
+			computePipelineCI.stage = loadShader(getShadersPath() + "instancing/cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &culling.pipeline));
+		}
+
 		// Star field pipeline
 		rasterizationState.cullMode = VK_CULL_MODE_NONE;
 		depthStencilState.depthWriteEnable = VK_FALSE;
@@ -326,19 +569,24 @@ public:
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.starfield));
 	}
 
+	// Generates instanceCount instances, the instance buffer is created on the first call
 	void prepareInstanceData()
 	{
 		std::vector<InstanceData> instanceData;
-		instanceData.resize(INSTANCE_COUNT);
+		instanceData.resize(instanceCount);
 
 		std::default_random_engine rndGenerator(benchmark.active ? 0 : (unsigned)time(nullptr));
 		std::uniform_real_distribution<float> uniformDist(0.0, 1.0);
 		std::uniform_int_distribution<uint32_t> rndTextureIndex(0, textures.rocks.layerCount);
 
-		// Distribute rocks randomly on two different rings
-		for (auto i = 0; i < INSTANCE_COUNT / 2; i++) {
+		// Rocks get smaller as their number increases, so the rings are about as dense as with the default instance count
+		const float scale = std::min(sqrt((float)INSTANCE_COUNT / (float)instanceCount), 1.0f);
+
+		// Distribute rocks randomly on two different rings, alternating between the rings
+		for (uint32_t j = 0; j < instanceCount / 2; j++) {
 			glm::vec2 ring0 { 7.0f, 11.0f };
 			glm::vec2 ring1 { 14.0f, 18.0f };
+			const uint32_t i = j * 2;
 
 			float rho, theta;
 
@@ -349,19 +597,19 @@ public:
 			instanceData[i].rot = glm::vec3(M_PI * uniformDist(rndGenerator), M_PI * uniformDist(rndGenerator), M_PI * uniformDist(rndGenerator));
 			instanceData[i].scale = 1.5f + uniformDist(rndGenerator) - uniformDist(rndGenerator);
 			instanceData[i].texIndex = rndTextureIndex(rndGenerator);
-			instanceData[i].scale *= 0.75f;
+			instanceData[i].scale *= 0.75f * scale;
 
 			// Outer ring
 			rho = sqrt((pow(ring1[1], 2.0f) - pow(ring1[0], 2.0f)) * uniformDist(rndGenerator) + pow(ring1[0], 2.0f));
 			theta = 2.0 * M_PI * uniformDist(rndGenerator);
-			instanceData[i + INSTANCE_COUNT / 2].pos = glm::vec3(rho*cos(theta), uniformDist(rndGenerator) * 0.5f - 0.25f, rho*sin(theta));
-			instanceData[i + INSTANCE_COUNT / 2].rot = glm::vec3(M_PI * uniformDist(rndGenerator), M_PI * uniformDist(rndGenerator), M_PI * uniformDist(rndGenerator));
-			instanceData[i + INSTANCE_COUNT / 2].scale = 1.5f + uniformDist(rndGenerator) - uniformDist(rndGenerator);
-			instanceData[i + INSTANCE_COUNT / 2].texIndex = rndTextureIndex(rndGenerator);
-			instanceData[i + INSTANCE_COUNT / 2].scale *= 0.75f;
+			instanceData[i + 1].pos = glm::vec3(rho*cos(theta), uniformDist(rndGenerator) * 0.5f - 0.25f, rho*sin(theta));
+			instanceData[i + 1].rot = glm::vec3(M_PI * uniformDist(rndGenerator), M_PI * uniformDist(rndGenerator), M_PI * uniformDist(rndGenerator));
+			instanceData[i + 1].scale = 1.5f + uniformDist(rndGenerator) - uniformDist(rndGenerator);
+			instanceData[i + 1].texIndex = rndTextureIndex(rndGenerator);
+			instanceData[i + 1].scale *= 0.75f * scale;
 		}
 
-		instanceBuffer.size = instanceData.size() * sizeof(InstanceData);
+		const VkDeviceSize dataSize = instanceData.size() * sizeof(InstanceData);
 
 		// Staging
 		// Instanced data is static, copy to device local memory
@@ -375,23 +623,27 @@ public:
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			instanceBuffer.size,
+			dataSize,
 			&stagingBuffer.buffer,
 			&stagingBuffer.memory,
 			instanceData.data()));
 
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			instanceBuffer.size,
-			&instanceBuffer.buffer,
-			&instanceBuffer.memory));
+		if (instanceBuffer.buffer == VK_NULL_HANDLE) {
+			// Also read as a storage buffer by the culling compute shader and the culled rocks vertex shader
+			instanceBuffer.size = MAX_INSTANCE_COUNT * sizeof(InstanceData);
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				instanceBuffer.size,
+				&instanceBuffer.buffer,
+				&instanceBuffer.memory));
+		}
 
 		// Copy to staging buffer
 		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
 		VkBufferCopy copyRegion = { };
-		copyRegion.size = instanceBuffer.size;
+		copyRegion.size = dataSize;
 		vkCmdCopyBuffer(
 			copyCmd,
 			stagingBuffer.buffer,
@@ -421,9 +673,66 @@ public:
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.scene.map());
 
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffers.culling,
+			sizeof(uboCulling)));
+		VK_CHECK_RESULT(uniformBuffers.culling.map());
+
 		updateUniformBuffer(true);
 	}
 
+	void prepareCullingBuffers()
+	{
+		// The culling path needs indirect draws with a first instance other than zero
+		culling.supported = (vulkanDevice->enabledFeatures.drawIndirectFirstInstance == VK_TRUE);
+
+		const uint32_t lodCount = static_cast<uint32_t>(culling.lods.size());
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&culling.visibleInstances,
+			lodCount * MAX_INSTANCE_COUNT * sizeof(uint32_t)));
+
+		// The instances of level of detail i are drawn from firstInstance i * MAX_INSTANCE_COUNT on, the culling pass only increments the instance counts
+		culling.commands.resize(lodCount);
+		for (uint32_t i = 0; i < lodCount; i++) {
+			culling.commands[i].indexCount = culling.lods[i].indexCount;
+			culling.commands[i].instanceCount = 0;
+			culling.commands[i].firstIndex = culling.lods[i].firstIndex;
+			culling.commands[i].vertexOffset = 0;
+			culling.commands[i].firstInstance = i * MAX_INSTANCE_COUNT;
+		}
+		const VkDeviceSize commandsSize = culling.commands.size() * sizeof(VkDrawIndexedIndirectCommand);
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&culling.indirectCommands,
+			commandsSize));
+
+		culling.statistics.resize(drawCmdBuffers.size());
+		for (auto& buffer : culling.statistics) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&buffer,
+				commandsSize));
+			VK_CHECK_RESULT(buffer.map());
+			memset(buffer.mapped, 0, commandsSize);
+		}
+	}
+
+	// Changes the number of instances, the instance data is generated again
+	void setInstanceCount(uint32_t count)
+	{
+		vkDeviceWaitIdle(device);
+		instanceCount = count;
+		prepareInstanceData();
+		updateCullingUniformBuffer();
+		buildCommandBuffers();
+	}
+
 	void updateUniformBuffer(bool viewChanged)
 	{
 		if (viewChanged)
@@ -439,18 +748,42 @@ public:
 		}
 
 		memcpy(uniformBuffers.scene.mapped, &uboVS, sizeof(uboVS));
+
+		updateCullingUniformBuffer();
+	}
+
+	void updateCullingUniformBuffer()
+	{
+		// The culling pass tests the instances against the frustum of the matrices used for rendering
+		vks::Frustum frustum;
+		frustum.update(uboVS.projection * uboVS.view);
+		memcpy(uboCulling.frustumPlanes, frustum.planes.data(), sizeof(glm::vec4) * 6);
+		uboCulling.viewPos = glm::inverse(uboVS.view)[3];
+		uboCulling.globSpeed = uboVS.globSpeed;
+		// A level of detail is selected if its error projects to less than lodPixelError pixels
+		uboCulling.errorPerDistance = lodPixelError * 2.0f / (fabs(uboVS.projection[1][1]) * (float)height);
+		uboCulling.instanceCount = instanceCount;
+		memcpy(uniformBuffers.culling.mapped, &uboCulling, sizeof(uboCulling));
 	}
 
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
 
+		// The frame fence of this command buffer has been waited for, so its copy of the visible instance counts is complete
+		if (culling.supported && culling.enabled) {
+			const VkDrawIndexedIndirectCommand* commands = reinterpret_cast<const VkDrawIndexedIndirectCommand*>(culling.statistics[currentBuffer].mapped);
+			for (size_t i = 0; i < culling.lods.size(); i++) {
+				culling.visibleCounts[i] = commands[i].instanceCount;
+			}
+		}
+
 		// Command buffer to be sumitted to the queue
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -460,6 +793,7 @@ public:
 		VulkanExampleBase::prepare();
 		loadAssets();
 		prepareInstanceData();
+		prepareCullingBuffers();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -475,6 +809,18 @@ public:
 		{
 			return;
 		}
+		// The benchmark is run for all instance counts in turn, unless a count has been passed on the command line
+		if (benchmark.active && !fixedInstanceCount) {
+			if (benchmarkFrame == 0) {
+				instanceCountIndex = 0;
+				setInstanceCount(instanceCounts[instanceCountIndex]);
+			}
+			else if (benchmarkFrame % benchmarkFramesPerCount == 0) {
+				instanceCountIndex = (instanceCountIndex + 1) % static_cast<int32_t>(instanceCounts.size());
+				setInstanceCount(instanceCounts[instanceCountIndex]);
+			}
+			benchmarkFrame++;
+		}
 		draw();
 		if ((!paused) || (camera.updated))
 		{			
@@ -489,8 +835,43 @@ public:
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
+		if (overlay->header("Settings")) {
+			std::vector<std::string> countNames;
+			for (auto count : instanceCounts) {
+				countNames.push_back(std::to_string(count));
+			}
+			if (overlay->comboBox("Instances", &instanceCountIndex, countNames)) {
+				setInstanceCount(instanceCounts[instanceCountIndex]);
+			}
+			if (culling.supported) {
+				if (overlay->checkBox("GPU culling and LOD", &culling.enabled)) {
+					buildCommandBuffers();
+				}
+				if (overlay->sliderFloat("LOD pixel error", &lodPixelError, 0.25f, 8.0f)) {
+					updateCullingUniformBuffer();
+				}
+			}
+			else {
+				overlay->text("GPU culling needs drawIndirectFirstInstance");
+			}
+		}
 		if (overlay->header("Statistics")) {
-			overlay->text("Instances: %d", INSTANCE_COUNT);
+			overlay->text("Instances: %d", instanceCount);
+			if (culling.supported && culling.enabled) {
+				uint32_t visibleCount = 0;
+				for (size_t i = 0; i < culling.lods.size(); i++) {
+					visibleCount += culling.visibleCounts[i];
+				}
+				overlay->text("Visible: %d", visibleCount);
+				for (size_t i = 0; i < culling.lods.size(); i++) {
+					overlay->text("LOD %d: %d", (int32_t)i, culling.visibleCounts[i]);
+				}
+			}
+		}
+		if (overlay->header("GPU times")) {
+			for (auto& result : benchmark.gpuProfiler.results) {
+				overlay->text("%s: %.3f ms", result.first.c_str(), result.second);
+			}
 		}
 	}
 };
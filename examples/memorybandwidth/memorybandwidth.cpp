@@ -0,0 +1,492 @@
+/*
+* Vulkan Example - Memory bandwidth microbenchmarks
+*
+* Measures the bandwidth of every memory type the device exposes for buffers: sequential CPU writes and reads through a mapping (for host
+* visible types) and GPU reads from a compute shader (timed with timestamp queries). From the results a memory type is recommended for
+* each usage pattern, e.g. for streaming data written by the CPU and read once by the GPU every frame, which depending on the device is best
+* placed in host visible device local memory (resizable BAR, integrated GPUs) or in write combined system memory
+*
+* In benchmark mode the results are reported as benchmark metrics in milliseconds per GiB, so they can be compared against a baseline
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanexamplebase.h"
+#include "VulkanProfiler.hpp"
+
+#define ENABLE_VALIDATION false
+
+class VulkanExample : public VulkanExampleBase
+{
+public:
+	// Bandwidths in GB/s, zero if not applicable to the memory type
+	struct MemoryTypeResult {
+		uint32_t memoryType = 0;
+		VkMemoryPropertyFlags propertyFlags = 0;
+		uint32_t heapIndex = 0;
+		bool tested = false;
+		double cpuWrite = 0.0;
+		double cpuRead = 0.0;
+		double gpuRead = 0.0;
+	};
+	std::vector<MemoryTypeResult> results;
+
+	struct Recommendation {
+		const char* usage;
+		int32_t memoryType = -1;
+	};
+	enum {
+		RecommendationDevice = 0,
+		RecommendationStreaming,
+		RecommendationReadback,
+		RecommendationCount
+	};
+	std::array<Recommendation, RecommendationCount> recommendations{};
+
+	// Size of the buffer tested per memory type in MiB
+	uint32_t bufferSizeMiB = 64;
+	// The best of multiple passes is taken, so caches and page faults of the first touch don't distort the results
+	const uint32_t cpuPasses = 3;
+	const uint32_t gpuPasses = 4;
+	// CPU reads are limited to a part of the buffer, reads from uncached memory can be slower by orders of magnitude
+	const VkDeviceSize maxCpuReadSize = 16 * 1024 * 1024;
+
+	bool measureRequested = false;
+	// Checksum of the CPU reads, kept so the reads can't be optimized away
+	uint64_t cpuReadChecksum = 0;
+
+	struct TestBuffer {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+	};
+
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	// Written by the read shader's (never taken) result branch
+	vks::Buffer resultBuffer;
+	vks::GpuProfiler gpuProfiler;
+
+	struct PushConstants {
+		uint32_t elementCount;
+		uint32_t threadCount;
+	};
+	// Enough threads to saturate the memory system, every thread reads multiple elements
+	const uint32_t workGroupCount = 1024;
+
+	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
+	{
+		title = "Memory bandwidth microbenchmarks";
+		commandLineParser.add("membuffersize", { "-mbs", "--membuffersize" }, 1, "Set the size of the buffer tested per memory type in MiB (default 64)");
+		commandLineParser.parse(args);
+		bufferSizeMiB = static_cast<uint32_t>(std::max(commandLineParser.getValueAsInt("membuffersize", bufferSizeMiB), 1));
+		recommendations[RecommendationDevice].usage = "Device resources (uploaded once, read by the GPU)";
+		recommendations[RecommendationStreaming].usage = "Streaming (written by the CPU, read once by the GPU)";
+		recommendations[RecommendationReadback].usage = "Readback (written by the GPU, read by the CPU)";
+	}
+
+	~VulkanExample()
+	{
+		if (device) {
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+			resultBuffer.destroy();
+			gpuProfiler.destroy();
+		}
+	}
+
+	static std::string propertyFlagsString(VkMemoryPropertyFlags flags)
+	{
+		const std::pair<VkMemoryPropertyFlags, const char*> names[] = {
+			{ VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "device local" },
+			{ VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "host visible" },
+			{ VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "host coherent" },
+			{ VK_MEMORY_PROPERTY_HOST_CACHED_BIT, "host cached" }
+		};
+		std::string result;
+		for (auto& name : names) {
+			if (flags & name.first) {
+				result += (result.empty() ? "" : " | ") + std::string(name.second);
+			}
+		}
+		return result.empty() ? "none" : result;
+	}
+
+	void preparePipeline()
+	{
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1)
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "memorybandwidth/read.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipeline));
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &resultBuffer, 256 * sizeof(uint32_t)));
+
+		// One scope per memory type
+		gpuProfiler.prepare(vulkanDevice, 1, VK_MAX_MEMORY_TYPES);
+	}
+
+	// Measures all memory types a storage buffer can be allocated from, the device must be idle
+	void measure()
+	{
+		const VkDeviceSize bufferSize = static_cast<VkDeviceSize>(bufferSizeMiB) * 1024 * 1024;
+		results.clear();
+
+		// One per result, untested memory types have no buffer
+		std::vector<TestBuffer> testBuffers;
+
+		VkBufferCreateInfo bufferCI = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, bufferSize);
+		VkBuffer probeBuffer;
+		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCI, nullptr, &probeBuffer));
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(device, probeBuffer, &memReqs);
+		vkDestroyBuffer(device, probeBuffer, nullptr);
+
+		for (uint32_t i = 0; i < vulkanDevice->memoryProperties.memoryTypeCount; i++) {
+			const VkMemoryType& memoryType = vulkanDevice->memoryProperties.memoryTypes[i];
+			if (!(memReqs.memoryTypeBits & (1u << i)) || (memoryType.propertyFlags & (VK_MEMORY_PROPERTY_PROTECTED_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))) {
+				continue;
+			}
+			MemoryTypeResult result;
+			result.memoryType = i;
+			result.propertyFlags = memoryType.propertyFlags;
+			result.heapIndex = memoryType.heapIndex;
+			TestBuffer testBuffer;
+			// Small heaps (e.g. a 256 MiB BAR window without resizable BAR) may not fit the buffer, these types are listed as not tested
+			if (vulkanDevice->memoryProperties.memoryHeaps[memoryType.heapIndex].size >= bufferSize * 2) {
+				VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCI, nullptr, &testBuffer.buffer));
+				VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+				memAlloc.allocationSize = memReqs.size;
+				memAlloc.memoryTypeIndex = i;
+				if (vulkanDevice->allocateMemory(memAlloc, vks::MemoryCategory::Buffer, &testBuffer.memory) == VK_SUCCESS) {
+					VK_CHECK_RESULT(vkBindBufferMemory(device, testBuffer.buffer, testBuffer.memory, 0));
+					result.tested = true;
+				}
+				else {
+					vkDestroyBuffer(device, testBuffer.buffer, nullptr);
+					testBuffer.buffer = VK_NULL_HANDLE;
+				}
+			}
+			results.push_back(result);
+			testBuffers.push_back(testBuffer);
+		}
+
+		measureGpuRead(testBuffers, bufferSize);
+		for (size_t i = 0; i < results.size(); i++) {
+			if (results[i].tested && (results[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+				measureCpu(results[i], testBuffers[i].memory, bufferSize);
+			}
+		}
+
+		for (TestBuffer& testBuffer : testBuffers) {
+			if (testBuffer.buffer != VK_NULL_HANDLE) {
+				vkDestroyBuffer(device, testBuffer.buffer, nullptr);
+				vulkanDevice->freeMemory(testBuffer.memory);
+			}
+		}
+
+		updateRecommendations();
+		printResults();
+	}
+
+	// Reads every tested buffer gpuPasses times with the read shader, each memory type in its own profiler scope
+	void measureGpuRead(const std::vector<TestBuffer>& testBuffers, VkDeviceSize bufferSize)
+	{
+		if (!gpuProfiler.supported) {
+			return;
+		}
+		const uint32_t setCount = std::max(static_cast<uint32_t>(testBuffers.size()), 1u);
+		VkDescriptorPool pool;
+		VkDescriptorPoolSize poolSize = vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, setCount * 2);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(1, &poolSize, setCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &pool));
+
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		gpuProfiler.reset(commandBuffer, 0);
+
+		// The shader expects zeroes, filling also makes sure every page is resident before the reads are timed
+		for (size_t i = 0; i < testBuffers.size(); i++) {
+			if (results[i].tested) {
+				vkCmdFillBuffer(commandBuffer, testBuffers[i].buffer, 0, bufferSize, 0);
+			}
+		}
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		PushConstants pushConstants{};
+		pushConstants.elementCount = static_cast<uint32_t>(bufferSize / sizeof(glm::uvec4));
+		pushConstants.threadCount = workGroupCount * 256;
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+		// Passes only read the source, the barrier between them keeps the (never taken) result writes ordered
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+		std::vector<size_t> measured;
+		for (size_t i = 0; i < testBuffers.size(); i++) {
+			if (!results[i].tested) {
+				continue;
+			}
+			VkDescriptorSet descriptorSet;
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(pool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+			VkDescriptorBufferInfo sourceDescriptor = { testBuffers[i].buffer, 0, bufferSize };
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &sourceDescriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &resultBuffer.descriptor)
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+			// Warm up (e.g. TLB misses of the first access) outside of the scope
+			vkCmdDispatch(commandBuffer, workGroupCount, 1, 1);
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			gpuProfiler.beginScope(commandBuffer, 0, "memory type " + std::to_string(results[i].memoryType));
+			for (uint32_t pass = 0; pass < gpuPasses; pass++) {
+				vkCmdDispatch(commandBuffer, workGroupCount, 1, 1);
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+			gpuProfiler.endScope(commandBuffer, 0);
+			measured.push_back(i);
+		}
+
+		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+		vkDestroyDescriptorPool(device, pool, nullptr);
+
+		if (gpuProfiler.collect(0) && (gpuProfiler.results.size() == measured.size())) {
+			for (size_t i = 0; i < measured.size(); i++) {
+				const double seconds = gpuProfiler.results[i].second / 1000.0;
+				results[measured[i]].gpuRead = (seconds > 0.0) ? static_cast<double>(bufferSize * gpuPasses) / seconds / 1e9 : 0.0;
+			}
+		}
+	}
+
+	// Sequential writes (as done by uploads of streaming data) and reads through a mapping, including the flushes or invalidations non coherent memory needs
+	void measureCpu(MemoryTypeResult& result, VkDeviceMemory memory, VkDeviceSize bufferSize)
+	{
+		const bool coherent = (result.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+		void* mapped = nullptr;
+		VK_CHECK_RESULT(vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+		VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
+		mappedRange.memory = memory;
+		mappedRange.offset = 0;
+		mappedRange.size = VK_WHOLE_SIZE;
+
+		// Zeroes, so the GPU read shader's assumption still holds
+		std::vector<uint8_t> source(static_cast<size_t>(bufferSize), 0);
+		double bestWrite = std::numeric_limits<double>::max();
+		for (uint32_t pass = 0; pass < cpuPasses; pass++) {
+			const auto tStart = std::chrono::high_resolution_clock::now();
+			memcpy(mapped, source.data(), source.size());
+			if (!coherent) {
+				VK_CHECK_RESULT(vkFlushMappedMemoryRanges(device, 1, &mappedRange));
+			}
+			bestWrite = std::min(bestWrite, std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count());
+		}
+		result.cpuWrite = static_cast<double>(bufferSize) / bestWrite / 1e9;
+
+		const VkDeviceSize readSize = std::min(bufferSize, maxCpuReadSize);
+		const size_t readCount = static_cast<size_t>(readSize / sizeof(uint64_t));
+		double bestRead = std::numeric_limits<double>::max();
+		uint64_t value = 0;
+		for (uint32_t pass = 0; pass < cpuPasses; pass++) {
+			const auto tStart = std::chrono::high_resolution_clock::now();
+			if (!coherent) {
+				VK_CHECK_RESULT(vkInvalidateMappedMemoryRanges(device, 1, &mappedRange));
+			}
+			const uint64_t* data = static_cast<const uint64_t*>(mapped);
+			for (size_t i = 0; i < readCount; i++) {
+				value ^= data[i];
+			}
+			bestRead = std::min(bestRead, std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count());
+		}
+		result.cpuRead = static_cast<double>(readSize) / bestRead / 1e9;
+		cpuReadChecksum ^= value;
+
+		vkUnmapMemory(device, memory);
+	}
+
+	void updateRecommendations()
+	{
+		for (Recommendation& recommendation : recommendations) {
+			recommendation.memoryType = -1;
+		}
+		double bestDevice = 0.0, bestStreaming = std::numeric_limits<double>::max(), bestReadback = 0.0;
+		for (const MemoryTypeResult& result : results) {
+			if (!result.tested) {
+				continue;
+			}
+			if (result.gpuRead > bestDevice) {
+				bestDevice = result.gpuRead;
+				recommendations[RecommendationDevice].memoryType = static_cast<int32_t>(result.memoryType);
+			}
+			if ((result.cpuWrite > 0.0) && (result.gpuRead > 0.0)) {
+				// Time to write a byte on the CPU and read it once on the GPU
+				const double streamingCost = 1.0 / result.cpuWrite + 1.0 / result.gpuRead;
+				if (streamingCost < bestStreaming) {
+					bestStreaming = streamingCost;
+					recommendations[RecommendationStreaming].memoryType = static_cast<int32_t>(result.memoryType);
+				}
+			}
+			if (result.cpuRead > bestReadback) {
+				bestReadback = result.cpuRead;
+				recommendations[RecommendationReadback].memoryType = static_cast<int32_t>(result.memoryType);
+			}
+		}
+	}
+
+	void printResults()
+	{
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "Memory bandwidth (" << bufferSizeMiB << " MiB per memory type, GB/s):" << "\n";
+		for (const MemoryTypeResult& result : results) {
+			std::cout << "  type " << result.memoryType << " (heap " << result.heapIndex << ", " << propertyFlagsString(result.propertyFlags) << "): ";
+			if (!result.tested) {
+				std::cout << "not tested" << "\n";
+				continue;
+			}
+			std::cout << "cpu write " << result.cpuWrite << ", cpu read " << result.cpuRead << ", gpu read " << result.gpuRead << "\n";
+		}
+		for (const Recommendation& recommendation : recommendations) {
+			std::cout << "  " << recommendation.usage << ": ";
+			if (recommendation.memoryType < 0) {
+				std::cout << "no measured memory type" << "\n";
+				continue;
+			}
+			std::cout << "type " << recommendation.memoryType << " (" << propertyFlagsString(vulkanDevice->memoryProperties.memoryTypes[recommendation.memoryType].propertyFlags) << ")" << "\n";
+		}
+	}
+
+	// Bandwidths are reported as the time to transfer a GiB, so lower values are better as the baseline comparison expects
+	void addMetrics()
+	{
+		auto addMetric = [&](const std::string& name, double bandwidth) {
+			if (bandwidth > 0.0) {
+				size_t index = benchmark.addMetric(name + " (ms/GiB)");
+				benchmark.metrics[index].second = 1024.0 * 1024.0 * 1024.0 / (bandwidth * 1e9) * 1000.0;
+			}
+		};
+		for (const MemoryTypeResult& result : results) {
+			const std::string prefix = "memory type " + std::to_string(result.memoryType);
+			addMetric(prefix + " cpu write", result.cpuWrite);
+			addMetric(prefix + " cpu read", result.cpuRead);
+			addMetric(prefix + " gpu read", result.gpuRead);
+		}
+	}
+
+	void buildCommandBuffers()
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+		{
+			renderPassBeginInfo.framebuffer = frameBuffers[i];
+
+			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+			// The results are only shown in the UI
+			drawUI(drawCmdBuffers[i]);
+
+			vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+		}
+	}
+
+	void draw()
+	{
+		VulkanExampleBase::prepareFrame();
+
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+		VulkanExampleBase::submitFrame();
+	}
+
+	void prepare()
+	{
+		VulkanExampleBase::prepare();
+		preparePipeline();
+		measure();
+		addMetrics();
+		buildCommandBuffers();
+		prepared = true;
+	}
+
+	virtual void render()
+	{
+		if (!prepared)
+			return;
+		if (measureRequested) {
+			measureRequested = false;
+			vkDeviceWaitIdle(device);
+			measure();
+		}
+		draw();
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Bandwidth (GB/s)")) {
+			for (const MemoryTypeResult& result : results) {
+				overlay->text("Type %d (heap %d): %s", result.memoryType, result.heapIndex, propertyFlagsString(result.propertyFlags).c_str());
+				if (!result.tested) {
+					overlay->text("  not tested");
+					continue;
+				}
+				overlay->text("  CPU write %.2f, CPU read %.2f, GPU read %.2f", result.cpuWrite, result.cpuRead, result.gpuRead);
+			}
+			if (overlay->button("Measure again")) {
+				measureRequested = true;
+			}
+		}
+		if (overlay->header("Recommended memory types")) {
+			for (const Recommendation& recommendation : recommendations) {
+				overlay->text("%s:", recommendation.usage);
+				if (recommendation.memoryType < 0) {
+					overlay->text("  no measured memory type");
+					continue;
+				}
+				overlay->text("  type %d (%s)", recommendation.memoryType, propertyFlagsString(vulkanDevice->memoryProperties.memoryTypes[recommendation.memoryType].propertyFlags).c_str());
+			}
+		}
+	}
+};
+
+VULKAN_EXAMPLE_MAIN()
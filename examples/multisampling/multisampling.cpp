@@ -11,24 +11,47 @@
 
 #define ENABLE_VALIDATION false
 
+// Render target attachment, the transient multisampled targets prefer lazily allocated memory that tile-based GPUs may never back with physical memory
+struct Attachment {
+	VkImage image = VK_NULL_HANDLE;
+	VkImageView view = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize size = 0;
+	bool lazilyAllocated = false;
+};
+
 struct {
-	struct {
-		VkImage image;
-		VkImageView view;
-		VkDeviceMemory memory;
-	} color;
-	struct {
-		VkImage image;
-		VkImageView view;
-		VkDeviceMemory memory;
-	} depth;
+	Attachment color;
+	Attachment depth;
+	// Single sampled depth attachment the multisampled depth is resolved into with VK_KHR_depth_stencil_resolve
+	Attachment resolvedDepth;
 } multisampleTarget;
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool useSampleShading = false;
+	// Minimum fraction of the samples of a pixel that are shaded individually with sample shading
+	float minSampleShading = 0.25f;
 	VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT;
+	// Selectable sample counts up to the maximum usable one, the benchmark renders each of them in turn unless a count is passed on the command line
+	std::vector<VkSampleCountFlagBits> sampleCounts;
+	int32_t sampleCountIndex = 0;
+	const uint32_t benchmarkFramesPerSampleCount = 500;
+	uint32_t benchmarkFrame = 0;
+	bool fixedSampleCount = false;
+
+	// Resolve the multisampled depth attachment at the end of the render pass too, as needed by passes that read the scene's depth after it
+	bool depthResolveSupported = false;
+	bool resolveDepth = false;
+	PFN_vkCreateRenderPass2KHR vkCreateRenderPass2KHR = nullptr;
+
+	// Attachment memory for each sample count, committed memory is only less than the allocated memory for lazily allocated attachments
+	struct AttachmentMemory {
+		VkDeviceSize allocated = 0;
+		VkDeviceSize committed = 0;
+	};
+	std::vector<AttachmentMemory> attachmentMemory;
 
 	vkglTF::Model model;
 
@@ -41,14 +64,13 @@ public:
 	} uboVS;
 
 	struct {
-		VkPipeline MSAA;
-		VkPipeline MSAASampleShading;
+		VkPipeline MSAA = VK_NULL_HANDLE;
+		VkPipeline MSAASampleShading = VK_NULL_HANDLE;
 	} pipelines;
 
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
-	VkExtent2D attachmentSize;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -57,25 +79,38 @@ public:
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
 		camera.setRotation(glm::vec3(0.0f, -90.0f, 0.0f));
 		camera.setTranslation(glm::vec3(2.5f, 2.5f, -7.5f));
+		commandLineParser.add("samplecount", { "-sc", "--samplecount" }, 1, "Set the MSAA sample count");
+		commandLineParser.add("depthresolve", { "-dsr", "--depthresolve" }, 0, "Resolve the multisampled depth attachment (VK_KHR_depth_stencil_resolve)");
+		commandLineParser.parse(args);
+		fixedSampleCount = commandLineParser.isSet("samplecount");
+		resolveDepth = commandLineParser.isSet("depthresolve");
 	}
 
 	~VulkanExample()
 	{
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
-		vkDestroyPipeline(device, pipelines.MSAA, nullptr);
-		vkDestroyPipeline(device, pipelines.MSAASampleShading, nullptr);
+		if (benchmark.active && !attachmentMemory.empty()) {
+			updateCommittedMemory();
+			std::cout << "Attachment memory:" << std::endl;
+			for (size_t i = 0; i < sampleCounts.size(); i++) {
+				if (attachmentMemory[i].allocated > 0) {
+					std::cout << "	" << sampleCounts[i] << "x: " << std::fixed << std::setprecision(2) << attachmentMemory[i].allocated / (1024.0 * 1024.0) << " MiB allocated, " << attachmentMemory[i].committed / (1024.0 * 1024.0) << " MiB committed" << std::endl;
+				}
+			}
+		}
+
+		destroyPipelines();
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
 		// Destroy MSAA target
-		vkDestroyImage(device, multisampleTarget.color.image, nullptr);
-		vkDestroyImageView(device, multisampleTarget.color.view, nullptr);
-		vkFreeMemory(device, multisampleTarget.color.memory, nullptr);
-		vkDestroyImage(device, multisampleTarget.depth.image, nullptr);
-		vkDestroyImageView(device, multisampleTarget.depth.view, nullptr);
-		vkFreeMemory(device, multisampleTarget.depth.memory, nullptr);
+		for (Attachment* attachment : { &multisampleTarget.color, &multisampleTarget.depth, &multisampleTarget.resolvedDepth }) {
+			vkDestroyImage(device, attachment->image, nullptr);
+			vkDestroyImageView(device, attachment->view, nullptr);
+			vkFreeMemory(device, attachment->memory, nullptr);
+		}
 
 		uniformBuffer.destroy();
 	}
@@ -93,17 +128,28 @@ public:
 		}
 	}
 
-	// Creates a multi sample render target (image and view) that is used to resolve
-	// into the visible frame buffer target in the render pass
-	void setupMultisampleTarget()
+	virtual void getEnabledExtensions()
 	{
-		// Check if device supports requested sample count for color and depth frame buffer
-		assert((deviceProperties.limits.framebufferColorSampleCounts >= sampleCount) && (deviceProperties.limits.framebufferDepthSampleCounts >= sampleCount));
+		// VK_KHR_depth_stencil_resolve and the extensions it depends on for Vulkan 1.0 devices
+		const std::vector<const char*> extensions = { VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME, VK_KHR_MULTIVIEW_EXTENSION_NAME, VK_KHR_MAINTENANCE2_EXTENSION_NAME };
+		depthResolveSupported = std::all_of(extensions.begin(), extensions.end(), [this](const char* extension) { return vulkanDevice->extensionSupported(extension); });
+		if (depthResolveSupported) {
+			enabledDeviceExtensions.insert(enabledDeviceExtensions.end(), extensions.begin(), extensions.end());
+		}
+		else if (resolveDepth) {
+			std::cerr << "Depth resolve is not supported by the selected device, the multisampled depth attachment is not resolved\n";
+			resolveDepth = false;
+		}
+	}
+
+	// Creates an image and view for one of the render targets
+	void createAttachment(Attachment& attachment, VkFormat format, VkSampleCountFlagBits samples, VkImageUsageFlags usage, VkImageAspectFlags aspectMask)
+	{
+		const bool transient = (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0;
 
-		// Color target
 		VkImageCreateInfo info = vks::initializers::imageCreateInfo();
 		info.imageType = VK_IMAGE_TYPE_2D;
-		info.format = swapChain.colorFormat;
+		info.format = format;
 		info.extent.width = width;
 		info.extent.height = height;
 		info.extent.depth = 1;
@@ -111,89 +157,114 @@ public:
 		info.arrayLayers = 1;
 		info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		info.tiling = VK_IMAGE_TILING_OPTIMAL;
-		info.samples = sampleCount;
-		// Image will only be used as a transient target
-		info.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		info.samples = samples;
+		info.usage = usage;
 		info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &info, nullptr, &multisampleTarget.color.image));
+		VK_CHECK_RESULT(vkCreateImage(device, &info, nullptr, &attachment.image));
 
 		VkMemoryRequirements memReqs;
-		vkGetImageMemoryRequirements(device, multisampleTarget.color.image, &memReqs);
+		vkGetImageMemoryRequirements(device, attachment.image, &memReqs);
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		memAlloc.allocationSize = memReqs.size;
-		// We prefer a lazily allocated memory type
+		// We prefer a lazily allocated memory type for transient targets
 		// This means that the memory gets allocated when the implementation sees fit, e.g. when first using the images
-		VkBool32 lazyMemTypePresent;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, &lazyMemTypePresent);
+		// Tile-based GPUs keep transient attachments that are neither loaded nor stored in tile memory, so they may never be backed by physical memory
+		VkBool32 lazyMemTypePresent = VK_FALSE;
+		if (transient) {
+			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, &lazyMemTypePresent);
+		}
 		if (!lazyMemTypePresent)
 		{
 			// If this is not available, fall back to device local memory
 			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 		}
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &multisampleTarget.color.memory));
-		vkBindImageMemory(device, multisampleTarget.color.image, multisampleTarget.color.memory, 0);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, attachment.image, attachment.memory, 0));
+		attachment.size = memReqs.size;
+		attachment.lazilyAllocated = (lazyMemTypePresent == VK_TRUE);
 
-		// Create image view for the MSAA target
 		VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
-		viewInfo.image = multisampleTarget.color.image;
+		viewInfo.image = attachment.image;
 		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		viewInfo.format = swapChain.colorFormat;
+		viewInfo.format = format;
 		viewInfo.components.r = VK_COMPONENT_SWIZZLE_R;
 		viewInfo.components.g = VK_COMPONENT_SWIZZLE_G;
 		viewInfo.components.b = VK_COMPONENT_SWIZZLE_B;
 		viewInfo.components.a = VK_COMPONENT_SWIZZLE_A;
-		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.aspectMask = aspectMask;
 		viewInfo.subresourceRange.levelCount = 1;
 		viewInfo.subresourceRange.layerCount = 1;
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewInfo, nullptr, &attachment.view));
+	}
 
-		VK_CHECK_RESULT(vkCreateImageView(device, &viewInfo, nullptr, &multisampleTarget.color.view));
-
-		// Depth target
-		info.imageType = VK_IMAGE_TYPE_2D;
-		info.format = depthFormat;
-		info.extent.width = width;
-		info.extent.height = height;
-		info.extent.depth = 1;
-		info.mipLevels = 1;
-		info.arrayLayers = 1;
-		info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		info.tiling = VK_IMAGE_TILING_OPTIMAL;
-		info.samples = sampleCount;
-		// Image will only be used as a transient target
-		info.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-		info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-
-		VK_CHECK_RESULT(vkCreateImage(device, &info, nullptr, &multisampleTarget.depth.image));
+	// Creates the multi sample render targets (images and views) that are resolved
+	// into the visible frame buffer target in the render pass
+	void setupMultisampleTarget()
+	{
+		// Check if device supports requested sample count for color and depth frame buffer
+		assert((deviceProperties.limits.framebufferColorSampleCounts & sampleCount) && (deviceProperties.limits.framebufferDepthSampleCounts & sampleCount));
 
-		vkGetImageMemoryRequirements(device, multisampleTarget.depth.image, &memReqs);
-		memAlloc = vks::initializers::memoryAllocateInfo();
-		memAlloc.allocationSize = memReqs.size;
+		VkImageAspectFlags depthAspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT) {
+			depthAspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
 
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, &lazyMemTypePresent);
-		if (!lazyMemTypePresent)
-		{
-			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		// Without multisampling the scene is rendered to the swap chain image directly, only the depth target is needed
+		if (sampleCount != VK_SAMPLE_COUNT_1_BIT) {
+			// Image will only be used as a transient target
+			createAttachment(multisampleTarget.color, swapChain.colorFormat, sampleCount, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+		}
+		createAttachment(multisampleTarget.depth, depthFormat, sampleCount, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthAspectMask);
+		if (depthResolveEnabled()) {
+			// The resolved depth is stored, so later passes could sample it
+			createAttachment(multisampleTarget.resolvedDepth, depthFormat, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, depthAspectMask);
 		}
 
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &multisampleTarget.depth.memory));
-		vkBindImageMemory(device, multisampleTarget.depth.image, multisampleTarget.depth.memory, 0);
+		AttachmentMemory& memory = attachmentMemory[sampleCountIndex];
+		memory.allocated = multisampleTarget.color.size + multisampleTarget.depth.size + multisampleTarget.resolvedDepth.size;
+		memory.committed = 0;
+	}
 
-		// Create image view for the MSAA target
-		viewInfo.image = multisampleTarget.depth.image;
-		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		viewInfo.format = depthFormat;
-		viewInfo.components.r = VK_COMPONENT_SWIZZLE_R;
-		viewInfo.components.g = VK_COMPONENT_SWIZZLE_G;
-		viewInfo.components.b = VK_COMPONENT_SWIZZLE_B;
-		viewInfo.components.a = VK_COMPONENT_SWIZZLE_A;
-		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-		if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT)
-			viewInfo.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-		viewInfo.subresourceRange.levelCount = 1;
-		viewInfo.subresourceRange.layerCount = 1;
+	// Frames in flight may still render to the targets, so they are released once these have finished
+	void destroyMultisampleTarget()
+	{
+		const VkDevice logicalDevice = device;
+		const Attachment oldColor = multisampleTarget.color;
+		const Attachment oldDepth = multisampleTarget.depth;
+		const Attachment oldResolvedDepth = multisampleTarget.resolvedDepth;
+		vulkanDevice->deferDestruction([logicalDevice, oldColor, oldDepth, oldResolvedDepth]() {
+			for (const Attachment& attachment : { oldColor, oldDepth, oldResolvedDepth }) {
+				vkDestroyImageView(logicalDevice, attachment.view, nullptr);
+				vkDestroyImage(logicalDevice, attachment.image, nullptr);
+				vkFreeMemory(logicalDevice, attachment.memory, nullptr);
+			}
+		});
+		multisampleTarget.color = Attachment();
+		multisampleTarget.depth = Attachment();
+		multisampleTarget.resolvedDepth = Attachment();
+	}
 
-		VK_CHECK_RESULT(vkCreateImageView(device, &viewInfo, nullptr, &multisampleTarget.depth.view));
+	bool depthResolveEnabled() const
+	{
+		return resolveDepth && (sampleCount != VK_SAMPLE_COUNT_1_BIT);
+	}
+
+	// Memory the implementation actually backs the lazily allocated attachments with, which can only grow while they are used
+	void updateCommittedMemory()
+	{
+		VkDeviceSize committed = 0;
+		for (const Attachment* attachment : { &multisampleTarget.color, &multisampleTarget.depth, &multisampleTarget.resolvedDepth }) {
+			if (attachment->lazilyAllocated) {
+				VkDeviceSize bytes = 0;
+				vkGetDeviceMemoryCommitment(device, attachment->memory, &bytes);
+				committed += bytes;
+			}
+			else {
+				committed += attachment->size;
+			}
+		}
+		AttachmentMemory& memory = attachmentMemory[sampleCountIndex];
+		memory.committed = std::max(memory.committed, committed);
 	}
 
 	// Setup a render pass for using a multi sampled attachment
@@ -202,48 +273,63 @@ public:
 	void setupRenderPass()
 	{
 		// Overrides the virtual function of the base class
-		
-		attachmentSize = { width, height };
-
-		std::array<VkAttachmentDescription, 3> attachments = {};
 
-		// Multisampled attachment that we render to
-		attachments[0].format = swapChain.colorFormat;
-		attachments[0].samples = sampleCount;
-		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		const bool multisampled = (sampleCount != VK_SAMPLE_COUNT_1_BIT);
+		std::vector<VkAttachmentDescription> attachments;
+
+		VkAttachmentDescription attachment{};
+		if (multisampled) {
+			// Multisampled attachment that we render to
+			// It is neither loaded nor stored, so it can stay in tile memory and be resolved from there on tile-based GPUs
+			attachment.format = swapChain.colorFormat;
+			attachment.samples = sampleCount;
+			attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			attachments.push_back(attachment);
+		}
 
 		// This is the frame buffer attachment to where the multisampled image
 		// will be resolved to and which will be presented to the swapchain
-		attachments[1].format = swapChain.colorFormat;
-		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
-		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[1].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		// Without multisampling it's rendered to directly
+		attachment.format = swapChain.colorFormat;
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.loadOp = multisampled ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		attachments.push_back(attachment);
 
 		// Multisampled depth attachment we render to
-		attachments[2].format = depthFormat;
-		attachments[2].samples = sampleCount;
-		attachments[2].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attachments[2].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attachments[2].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attachments[2].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attachments[2].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[2].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		attachment.format = depthFormat;
+		attachment.samples = sampleCount;
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		attachments.push_back(attachment);
+
+		if (depthResolveEnabled()) {
+			// Single sampled depth attachment the multisampled depth is resolved to, this one is stored
+			attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+			attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachments.push_back(attachment);
+		}
 
 		VkAttachmentReference colorReference = {};
 		colorReference.attachment = 0;
 		colorReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 		VkAttachmentReference depthReference = {};
-		depthReference.attachment = 2;
+		depthReference.attachment = multisampled ? 2 : 1;
 		depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 		// Resolve attachment reference for the color attachment
@@ -256,12 +342,13 @@ public:
 		subpass.colorAttachmentCount = 1;
 		subpass.pColorAttachments = &colorReference;
 		// Pass our resolve attachments to the sub pass
-		subpass.pResolveAttachments = &resolveReference;
+		subpass.pResolveAttachments = multisampled ? &resolveReference : nullptr;
 		subpass.pDepthStencilAttachment = &depthReference;
 
 		std::array<VkSubpassDependency, 2> dependencies{};
 
 		// Depth attachment
+		// Depth resolves are done in the late fragment tests stage, so this also covers the resolved depth attachment
 		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[0].dstSubpass = 0;
 		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
@@ -278,17 +365,95 @@ public:
 		dependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
 		dependencies[1].dependencyFlags = 0;
 
+		if (depthResolveEnabled()) {
+			createDepthResolveRenderPass(attachments, subpass, dependencies);
+			return;
+		}
+
 		VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
-		renderPassInfo.attachmentCount = attachments.size();
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
 		renderPassInfo.pAttachments = attachments.data();
 		renderPassInfo.subpassCount = 1;
 		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 2;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 		renderPassInfo.pDependencies = dependencies.data();
 
 		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
 	}
 
+	// Depth resolve attachments can only be passed to vkCreateRenderPass2KHR, so the render pass description is converted to its extensible version
+	// The last attachment is the one the depth attachment is resolved to
+	void createDepthResolveRenderPass(const std::vector<VkAttachmentDescription>& attachments, const VkSubpassDescription& subpass, const std::array<VkSubpassDependency, 2>& dependencies)
+	{
+		std::vector<VkAttachmentDescription2KHR> attachments2(attachments.size());
+		for (size_t i = 0; i < attachments.size(); i++) {
+			attachments2[i].sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2_KHR;
+			attachments2[i].format = attachments[i].format;
+			attachments2[i].samples = attachments[i].samples;
+			attachments2[i].loadOp = attachments[i].loadOp;
+			attachments2[i].storeOp = attachments[i].storeOp;
+			attachments2[i].stencilLoadOp = attachments[i].stencilLoadOp;
+			attachments2[i].stencilStoreOp = attachments[i].stencilStoreOp;
+			attachments2[i].initialLayout = attachments[i].initialLayout;
+			attachments2[i].finalLayout = attachments[i].finalLayout;
+		}
+
+		auto reference2 = [](const VkAttachmentReference& reference) {
+			VkAttachmentReference2KHR reference2{};
+			reference2.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2_KHR;
+			reference2.attachment = reference.attachment;
+			reference2.layout = reference.layout;
+			return reference2;
+		};
+		const VkAttachmentReference2KHR colorReference = reference2(subpass.pColorAttachments[0]);
+		const VkAttachmentReference2KHR resolveReference = reference2(subpass.pResolveAttachments[0]);
+		const VkAttachmentReference2KHR depthReference = reference2(*subpass.pDepthStencilAttachment);
+		VkAttachmentReference2KHR depthResolveReference{};
+		depthResolveReference.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2_KHR;
+		depthResolveReference.attachment = static_cast<uint32_t>(attachments.size() - 1);
+		depthResolveReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		// [POI] Resolve the depth attachment at the end of the subpass
+		// Taking sample zero is supported by all implementations of the extension, for both depth and stencil, so it also meets the requirement for identical modes of devices without independent resolves
+		VkSubpassDescriptionDepthStencilResolveKHR depthStencilResolve{};
+		depthStencilResolve.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_DEPTH_STENCIL_RESOLVE_KHR;
+		depthStencilResolve.depthResolveMode = VK_RESOLVE_MODE_SAMPLE_ZERO_BIT_KHR;
+		depthStencilResolve.stencilResolveMode = vks::tools::formatHasStencil(depthFormat) ? VK_RESOLVE_MODE_SAMPLE_ZERO_BIT_KHR : VK_RESOLVE_MODE_NONE_KHR;
+		depthStencilResolve.pDepthStencilResolveAttachment = &depthResolveReference;
+
+		VkSubpassDescription2KHR subpass2{};
+		subpass2.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2_KHR;
+		subpass2.pNext = &depthStencilResolve;
+		subpass2.pipelineBindPoint = subpass.pipelineBindPoint;
+		subpass2.colorAttachmentCount = 1;
+		subpass2.pColorAttachments = &colorReference;
+		subpass2.pResolveAttachments = &resolveReference;
+		subpass2.pDepthStencilAttachment = &depthReference;
+
+		std::array<VkSubpassDependency2KHR, 2> dependencies2{};
+		for (size_t i = 0; i < dependencies.size(); i++) {
+			dependencies2[i].sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2_KHR;
+			dependencies2[i].srcSubpass = dependencies[i].srcSubpass;
+			dependencies2[i].dstSubpass = dependencies[i].dstSubpass;
+			dependencies2[i].srcStageMask = dependencies[i].srcStageMask;
+			dependencies2[i].dstStageMask = dependencies[i].dstStageMask;
+			dependencies2[i].srcAccessMask = dependencies[i].srcAccessMask;
+			dependencies2[i].dstAccessMask = dependencies[i].dstAccessMask;
+			dependencies2[i].dependencyFlags = dependencies[i].dependencyFlags;
+		}
+
+		VkRenderPassCreateInfo2KHR renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2_KHR;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments2.size());
+		renderPassInfo.pAttachments = attachments2.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass2;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies2.size());
+		renderPassInfo.pDependencies = dependencies2.data();
+
+		VK_CHECK_RESULT(vkCreateRenderPass2KHR(device, &renderPassInfo, nullptr, &renderPass));
+	}
+
 	// Frame buffer attachments must match with render pass setup,
 	// so we need to adjust frame buffer creation to cover our
 	// multisample target
@@ -297,32 +462,27 @@ public:
 		// Overrides the virtual function of the base class
 
 		// SRS - If the window is resized, the MSAA attachments need to be released and recreated
-		if (attachmentSize.width != width || attachmentSize.height != height)
-		{
-			attachmentSize = { width, height };
-			
-			// Destroy MSAA target
-			vkDestroyImage(device, multisampleTarget.color.image, nullptr);
-			vkDestroyImageView(device, multisampleTarget.color.view, nullptr);
-			vkFreeMemory(device, multisampleTarget.color.memory, nullptr);
-			vkDestroyImage(device, multisampleTarget.depth.image, nullptr);
-			vkDestroyImageView(device, multisampleTarget.depth.view, nullptr);
-			vkFreeMemory(device, multisampleTarget.depth.memory, nullptr);
-		}
-		
-		std::array<VkImageView, 3> attachments;
-
+		destroyMultisampleTarget();
 		setupMultisampleTarget();
 
-		attachments[0] = multisampleTarget.color.view;
-		// attachment[1] = swapchain image
-		attachments[2] = multisampleTarget.depth.view;
+		// The swap chain image is the resolve attachment, or the color attachment without multisampling
+		std::vector<VkImageView> attachments;
+		uint32_t swapChainAttachment = 0;
+		if (sampleCount != VK_SAMPLE_COUNT_1_BIT) {
+			attachments.push_back(multisampleTarget.color.view);
+			swapChainAttachment = 1;
+		}
+		attachments.push_back(VK_NULL_HANDLE);
+		attachments.push_back(multisampleTarget.depth.view);
+		if (depthResolveEnabled()) {
+			attachments.push_back(multisampleTarget.resolvedDepth.view);
+		}
 
 		VkFramebufferCreateInfo frameBufferCreateInfo = {};
 		frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 		frameBufferCreateInfo.pNext = NULL;
 		frameBufferCreateInfo.renderPass = renderPass;
-		frameBufferCreateInfo.attachmentCount = attachments.size();
+		frameBufferCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
 		frameBufferCreateInfo.pAttachments = attachments.data();
 		frameBufferCreateInfo.width = width;
 		frameBufferCreateInfo.height = height;
@@ -332,7 +492,7 @@ public:
 		frameBuffers.resize(swapChain.imageCount);
 		for (uint32_t i = 0; i < frameBuffers.size(); i++)
 		{
-			attachments[1] = swapChain.buffers[i].view;
+			attachments[swapChainAttachment] = swapChain.buffers[i].view;
 			VK_CHECK_RESULT(vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &frameBuffers[i]));
 		}
 	}
@@ -341,18 +501,35 @@ public:
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-		VkClearValue clearValues[3];
 		// Clear to a white background for higher contrast
+		// Clear values are indexed by attachment, so the single sampled render pass has the depth value at the index of the resolve attachment
+		std::vector<VkClearValue> clearValues(4);
 		clearValues[0].color = { { 1.0f, 1.0f, 1.0f, 1.0f } };
 		clearValues[1].color = { { 1.0f, 1.0f, 1.0f, 1.0f } };
 		clearValues[2].depthStencil = { 1.0f, 0 };
+		if (sampleCount == VK_SAMPLE_COUNT_1_BIT) {
+			clearValues[1].depthStencil = { 1.0f, 0 };
+		}
 
 		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
 		renderPassBeginInfo.renderPass = renderPass;
 		renderPassBeginInfo.renderArea.extent.width = width;
 		renderPassBeginInfo.renderArea.extent.height = height;
-		renderPassBeginInfo.clearValueCount = 3;
-		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		renderPassBeginInfo.pClearValues = clearValues.data();
+
+		// GPU times are logged per setting, so the benchmark results of all sample counts can be compared
+		const bool sampleShading = useSampleShading && (pipelines.MSAASampleShading != VK_NULL_HANDLE);
+		std::string sceneScope = "Scene (" + std::to_string(sampleCount) + "x MSAA";
+		if (depthResolveEnabled()) {
+			sceneScope += ", depth resolve";
+		}
+		if (sampleShading) {
+			std::stringstream minSampleShadingText;
+			minSampleShadingText << std::fixed << std::setprecision(2) << minSampleShading;
+			sceneScope += ", sample shading " + minSampleShadingText.str();
+		}
+		sceneScope += ")";
 
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
@@ -360,6 +537,8 @@ public:
 			renderPassBeginInfo.framebuffer = frameBuffers[i];
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			benchmark.gpuProfiler.reset(drawCmdBuffers[i], i);
+			benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, sceneScope);
 
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
@@ -370,12 +549,13 @@ public:
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, useSampleShading ? pipelines.MSAASampleShading : pipelines.MSAA);
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, sampleShading ? pipelines.MSAASampleShading : pipelines.MSAA);
 			model.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayout);
 
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
+			benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
@@ -477,11 +657,45 @@ public:
 			// Enable per-sample shading (instead of per-fragment)
 			multisampleState.sampleShadingEnable = VK_TRUE;
 			// Minimum fraction for sample shading
-			multisampleState.minSampleShading = 0.25f;
+			multisampleState.minSampleShading = minSampleShading;
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.MSAASampleShading));
 		}
 	}
 
+	void destroyPipelines()
+	{
+		vkDestroyPipeline(device, pipelines.MSAA, nullptr);
+		vkDestroyPipeline(device, pipelines.MSAASampleShading, nullptr);
+		pipelines.MSAA = VK_NULL_HANDLE;
+		pipelines.MSAASampleShading = VK_NULL_HANDLE;
+	}
+
+	// The render pass, the frame buffers and the pipelines depend on the sample count and the depth resolve
+	void recreateRenderTargets(int32_t newSampleCountIndex)
+	{
+		vkDeviceWaitIdle(device);
+		// Commitment of the current attachments is measured before they are released
+		updateCommittedMemory();
+		sampleCountIndex = newSampleCountIndex;
+		sampleCount = sampleCounts[sampleCountIndex];
+		for (auto& frameBuffer : frameBuffers) {
+			vkDestroyFramebuffer(device, frameBuffer, nullptr);
+		}
+		vkDestroyRenderPass(device, renderPass, nullptr);
+		destroyPipelines();
+		setupRenderPass();
+		setupFrameBuffer();
+		preparePipelines();
+		// The overlay is drawn in the scene's render pass, unless it has a pass of its own
+		if (settings.overlay && !settings.overlayPass) {
+			vkDestroyPipeline(device, UIOverlay.pipeline, nullptr);
+			vkDestroyPipelineLayout(device, UIOverlay.pipelineLayout, nullptr);
+			UIOverlay.rasterizationSamples = sampleCount;
+			UIOverlay.preparePipeline(pipelineCache, renderPass, swapChain.colorFormat, depthFormat);
+		}
+		buildCommandBuffers();
+	}
+
 	// Prepare and initialize uniform buffer containing shader uniforms
 	void prepareUniformBuffers()
 	{
@@ -514,14 +728,36 @@ public:
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
 
 	void prepare()
 	{
-		sampleCount = getMaxUsableSampleCount();
+		// Selectable sample counts
+		const VkSampleCountFlags counts = deviceProperties.limits.framebufferColorSampleCounts & deviceProperties.limits.framebufferDepthSampleCounts;
+		const VkSampleCountFlagBits maxSampleCount = getMaxUsableSampleCount();
+		for (uint32_t count = VK_SAMPLE_COUNT_1_BIT; count <= maxSampleCount; count <<= 1) {
+			if (counts & count) {
+				sampleCounts.push_back(static_cast<VkSampleCountFlagBits>(count));
+			}
+		}
+		attachmentMemory.resize(sampleCounts.size());
+		// Defaults to the highest sample count, or the highest one up to the one passed on the command line
+		sampleCountIndex = static_cast<int32_t>(sampleCounts.size()) - 1;
+		if (fixedSampleCount) {
+			const int32_t requestedSampleCount = commandLineParser.getValueAsInt("samplecount", maxSampleCount);
+			for (size_t i = 0; i < sampleCounts.size(); i++) {
+				if (static_cast<int32_t>(sampleCounts[i]) <= requestedSampleCount) {
+					sampleCountIndex = static_cast<int32_t>(i);
+				}
+			}
+		}
+		sampleCount = sampleCounts[sampleCountIndex];
+		if (depthResolveSupported) {
+			vkCreateRenderPass2KHR = reinterpret_cast<PFN_vkCreateRenderPass2KHR>(vkGetDeviceProcAddr(device, "vkCreateRenderPass2KHR"));
+		}
 		UIOverlay.rasterizationSamples = sampleCount;
 		VulkanExampleBase::prepare();
 		loadAssets();
@@ -538,6 +774,18 @@ public:
 	{
 		if (!prepared)
 			return;
+		// The benchmark is run for all sample counts in turn, unless a count has been passed on the command line
+		if (benchmark.active && !fixedSampleCount) {
+			if (benchmarkFrame == 0) {
+				if (sampleCountIndex != 0) {
+					recreateRenderTargets(0);
+				}
+			}
+			else if (benchmarkFrame % benchmarkFramesPerSampleCount == 0) {
+				recreateRenderTargets((sampleCountIndex + 1) % static_cast<int32_t>(sampleCounts.size()));
+			}
+			benchmarkFrame++;
+		}
 		draw();
 		if (camera.updated) {
 			updateUniformBuffers();
@@ -564,11 +812,41 @@ public:
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
-		if (vulkanDevice->features.sampleRateShading) {
-			if (overlay->header("Settings")) {
+		if (overlay->header("Settings")) {
+			std::vector<std::string> sampleCountNames;
+			for (auto count : sampleCounts) {
+				sampleCountNames.push_back(std::to_string(count) + "x");
+			}
+			int32_t index = sampleCountIndex;
+			if (overlay->comboBox("Sample count", &index, sampleCountNames) && (index != sampleCountIndex)) {
+				recreateRenderTargets(index);
+			}
+			if (depthResolveSupported) {
+				if (overlay->checkBox("Resolve depth", &resolveDepth)) {
+					recreateRenderTargets(sampleCountIndex);
+				}
+			}
+			if (vulkanDevice->features.sampleRateShading) {
 				if (overlay->checkBox("Sample rate shading", &useSampleShading)) {
 					buildCommandBuffers();
 				}
+				if (useSampleShading) {
+					if (overlay->sliderFloat("Min. sample shading", &minSampleShading, 0.0f, 1.0f)) {
+						vkDeviceWaitIdle(device);
+						destroyPipelines();
+						preparePipelines();
+						buildCommandBuffers();
+					}
+				}
+			}
+		}
+		if (overlay->header("Statistics")) {
+			updateCommittedMemory();
+			const AttachmentMemory& memory = attachmentMemory[sampleCountIndex];
+			overlay->text("Attachments: %.2f MiB", memory.allocated / (1024.0 * 1024.0));
+			overlay->text("Committed: %.2f MiB", memory.committed / (1024.0 * 1024.0));
+			for (auto& result : benchmark.gpuProfiler.results) {
+				overlay->text("%s: %.3f ms", result.first.c_str(), result.second);
 			}
 		}
 	}
@@ -9,7 +9,9 @@
 #include "vulkanexamplebase.h"
 
 #include "threadpool.hpp"
+#include "VulkanParallelRecorder.h"
 #include "frustum.hpp"
+#include "VulkanOcclusionCuller.h"
 
 #include "VulkanglTFModel.h"
 
@@ -19,6 +21,8 @@ class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool displayStarSphere = true;
+	// Record the object command buffers once and reuse them instead of recording them again each frame
+	bool retainedCommandBuffers = false;
 
 	struct {
 		vkglTF::Model ufo;
@@ -33,11 +37,49 @@ public:
 
 	struct {
 		VkPipeline phong;
+		VkPipeline phongRetained;
 		VkPipeline starsphere;
 	} pipelines;
 
 	VkPipelineLayout pipelineLayout;
 
+	/*
+		Retained mode: every object has a secondary command buffer of its own that is only recorded again if the object's commands change
+		Transforms are read from a storage buffer indexed by the draw's first instance, so animating objects doesn't invalidate their command buffers
+	*/
+	struct RetainedMode {
+		VkPipelineLayout pipelineLayout;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet descriptorSet;
+		// View projection matrix
+		vks::Buffer uniformBuffer;
+		// Model matrix of each object
+		vks::Buffer objectBuffer;
+		// Objects are statically assigned to a pool (object index % pool count), every pool is recorded from by one job at a time
+		std::vector<VkCommandPool> commandPools;
+		std::vector<VkCommandBuffer> commandBuffers;
+		// Set for objects whose command buffers need to be recorded again, a byte per object so jobs can write them concurrently
+		std::vector<uint8_t> dirty;
+		uint32_t recordedCommandBuffers = 0;
+	} retained;
+
+	/*
+		Software occlusion culling: the objects closest to the camera are rasterized into a small CPU depth buffer while the background
+		and UI command buffers are recorded, objects whose bounding boxes are hidden behind them are then skipped like those outside of the frustum
+	*/
+	bool occlusionCulling = false;
+	vks::OcclusionCuller occlusionCuller;
+	// Number of the closest visible objects used as occluders
+	const uint32_t occluderCount = 16;
+	// Bounds of the (pre-transformed) object model
+	glm::vec3 objectMin;
+	glm::vec3 objectMax;
+	uint32_t occludedObjects = 0;
+
+	// CPU time spent updating, culling and recording the command buffers of a frame
+	float recordTime = 0.0f;
+
 	VkCommandBuffer primaryCommandBuffer;
 
 	// Secondary scene command buffers used to store backdrop and user interface
@@ -48,11 +90,15 @@ public:
 
 	// Number of animated objects to be renderer
 	// by using threads and secondary command buffers
-	uint32_t numObjectsPerThread;
+	const uint32_t numObjects = 512;
 
 	// Multi threaded stuff
 	// Max. number of concurrent threads
 	uint32_t numThreads;
+	bool pinThreads = false;
+	// Worker utilization of the last second, as the statistics are reset once per second
+	std::vector<vks::ThreadPool::WorkerStatistics> workerStatistics;
+	float statisticsTimer = 0.0f;
 
 	// Use push constants to update shader
 	// parameters on a per-thread base
@@ -73,18 +119,14 @@ public:
 		bool visible = true;
 	};
 
-	struct ThreadData {
-		VkCommandPool commandPool;
-		// One command buffer per render object
-		std::vector<VkCommandBuffer> commandBuffer;
-		// One push constant block per render object
-		std::vector<ThreadPushConstantBlock> pushConstBlock;
-		// Per object information (position, rotation, etc.)
-		std::vector<ObjectData> objectData;
-	};
-	std::vector<ThreadData> threadData;
+	// One push constant block per render object
+	std::vector<ThreadPushConstantBlock> pushConstBlock;
+	// Per object information (position, rotation, etc.)
+	std::vector<ObjectData> objectData;
 
 	vks::ThreadPool threadPool;
+	// Splits the objects into ranges recorded into secondary command buffers by the pool's workers
+	std::unique_ptr<vks::ParallelCommandRecorder> commandRecorder;
 
 	// Fence to wait for all command buffers to finish before
 	// presenting to the swap chain
@@ -103,16 +145,21 @@ public:
 		camera.setRotation(glm::vec3(0.0f));
 		camera.setRotationSpeed(0.5f);
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
-		// Get number of max. concurrent threads
-		numThreads = std::thread::hardware_concurrency();
-		assert(numThreads > 0);
+		commandLineParser.add("threads", { "-th", "--threads" }, 1, "Set the number of worker threads (default one per performance core)");
+		commandLineParser.add("pinthreads", { "-pin", "--pinthreads" }, 0, "Pin each worker thread to a single processor");
+		commandLineParser.parse(args);
+		// Command buffers are recorded on the critical path of the frame, so the workers run on the performance cores of heterogeneous CPUs
+		// Workers on efficiency cores would take longer for their share of the jobs and make the other workers wait at the end of the frame
+		const vks::CpuTopology& topology = vks::CpuTopology::get();
+		numThreads = static_cast<uint32_t>(commandLineParser.getValueAsInt("threads", static_cast<int32_t>(topology.getProcessors(vks::CoreClass::Performance).size())));
+		numThreads = std::max(numThreads, 1u);
+		pinThreads = commandLineParser.isSet("pinthreads");
 #if defined(__ANDROID__)
-		LOGD("numThreads = %d", numThreads);
+		LOGD("numThreads = %d (%d performance classes)", numThreads, topology.performanceClassCount);
 #else
-		std::cout << "numThreads = " << numThreads << std::endl;
+		std::cout << "numThreads = " << numThreads << " (" << topology.performanceClassCount << " performance classes)" << std::endl;
 #endif
-		threadPool.setThreadCount(numThreads);
-		numObjectsPerThread = 512 / numThreads;
+		threadPool.setThreadCount(numThreads, vks::CoreClass::Performance, pinThreads);
 		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
 	}
 
@@ -121,15 +168,21 @@ public:
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
 		vkDestroyPipeline(device, pipelines.phong, nullptr);
+		vkDestroyPipeline(device, pipelines.phongRetained, nullptr);
 		vkDestroyPipeline(device, pipelines.starsphere, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-
-		for (auto& thread : threadData) {
-			vkFreeCommandBuffers(device, thread.commandPool, thread.commandBuffer.size(), thread.commandBuffer.data());
-			vkDestroyCommandPool(device, thread.commandPool, nullptr);
+		vkDestroyPipelineLayout(device, retained.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, retained.descriptorSetLayout, nullptr);
+		vkDestroyDescriptorPool(device, retained.descriptorPool, nullptr);
+		retained.uniformBuffer.destroy();
+		retained.objectBuffer.destroy();
+		for (auto& commandPool : retained.commandPools) {
+			vkDestroyCommandPool(device, commandPool, nullptr);
 		}
 
+		commandRecorder.reset();
+
 		vkDestroyFence(device, renderFence, nullptr);
 	}
 
@@ -157,71 +210,81 @@ public:
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers.background));
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers.ui));
 
-		threadData.resize(numThreads);
+		// Only one frame is in flight (see draw), so the recorder needs a single set of per-thread command pools
+		commandRecorder.reset(new vks::ParallelCommandRecorder(device, swapChain.queueNodeIndex, threadPool, 1));
 
-		float maxX = std::floor(std::sqrt(numThreads * numObjectsPerThread));
-		uint32_t posX = 0;
-		uint32_t posZ = 0;
+		pushConstBlock.resize(numObjects);
+		objectData.resize(numObjects);
 
-		for (uint32_t i = 0; i < numThreads; i++) {
-			ThreadData *thread = &threadData[i];
+		for (uint32_t j = 0; j < numObjects; j++) {
+			float theta = 2.0f * float(M_PI) * rnd(1.0f);
+			float phi = acos(1.0f - 2.0f * rnd(1.0f));
+			objectData[j].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * 35.0f;
 
-			// Create one command pool for each thread
+			objectData[j].rotation = glm::vec3(0.0f, rnd(360.0f), 0.0f);
+			objectData[j].deltaT = rnd(1.0f);
+			objectData[j].rotationDir = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
+			objectData[j].rotationSpeed = (2.0f + rnd(4.0f)) * objectData[j].rotationDir;
+			objectData[j].scale = 0.75f + rnd(0.5f);
+
+			pushConstBlock[j].color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
+		}
+
+		prepareRetainedMode();
+	}
+
+	void prepareRetainedMode()
+	{
+		// Host visible buffers are updated in place, the previous frame has finished by the time the next one is updated (see draw)
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &retained.uniformBuffer, sizeof(glm::mat4)));
+		VK_CHECK_RESULT(retained.uniformBuffer.map());
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &retained.objectBuffer, numObjects * sizeof(glm::mat4)));
+		VK_CHECK_RESULT(retained.objectBuffer.map());
+
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &retained.descriptorPool));
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(retained.descriptorPool, &retained.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &retained.descriptorSet));
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(retained.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &retained.uniformBuffer.descriptor),	// Binding 0 : View projection matrix
+			vks::initializers::writeDescriptorSet(retained.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &retained.objectBuffer.descriptor)	// Binding 1 : Model matrices
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		// One pool per thread (including the waiting thread), command buffers are reset individually when they are recorded again
+		retained.commandPools.resize(threadPool.getThreadCount() + 1);
+		for (auto& commandPool : retained.commandPools) {
 			VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
 			cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
 			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &thread->commandPool));
-
-			// One secondary command buffer per object that is updated by this thread
-			thread->commandBuffer.resize(numObjectsPerThread);
-			// Generate secondary command buffers for each thread
-			VkCommandBufferAllocateInfo secondaryCmdBufAllocateInfo =
-				vks::initializers::commandBufferAllocateInfo(
-					thread->commandPool,
-					VK_COMMAND_BUFFER_LEVEL_SECONDARY,
-					thread->commandBuffer.size());
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &secondaryCmdBufAllocateInfo, thread->commandBuffer.data()));
-
-			thread->pushConstBlock.resize(numObjectsPerThread);
-			thread->objectData.resize(numObjectsPerThread);
-
-			for (uint32_t j = 0; j < numObjectsPerThread; j++) {
-				float theta = 2.0f * float(M_PI) * rnd(1.0f);
-				float phi = acos(1.0f - 2.0f * rnd(1.0f));
-				thread->objectData[j].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * 35.0f;
-
-				thread->objectData[j].rotation = glm::vec3(0.0f, rnd(360.0f), 0.0f);
-				thread->objectData[j].deltaT = rnd(1.0f);
-				thread->objectData[j].rotationDir = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
-				thread->objectData[j].rotationSpeed = (2.0f + rnd(4.0f)) * thread->objectData[j].rotationDir;
-				thread->objectData[j].scale = 0.75f + rnd(0.5f);
-
-				thread->pushConstBlock[j].color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
-			}
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
 		}
-
+		retained.commandBuffers.resize(numObjects);
+		for (uint32_t i = 0; i < numObjects; i++) {
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(retained.commandPools[i % retained.commandPools.size()], VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &retained.commandBuffers[i]));
+		}
+		retained.dirty.assign(numObjects, 1);
 	}
 
-	// Builds the secondary command buffer for each thread
-	void threadRenderCode(uint32_t threadIndex, uint32_t cmdBufferIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
+	// Records the retained command buffer of an object, which draws the object with its transform from the object buffer
+	void recordRetainedCommandBuffer(uint32_t objectIndex)
 	{
-		ThreadData *thread = &threadData[threadIndex];
-		ObjectData *objectData = &thread->objectData[cmdBufferIndex];
-
-		// Check visibility against view frustum using a simple sphere check based on the radius of the mesh
-		objectData->visible = frustum.checkSphere(objectData->pos, models.ufo.dimensions.radius * 0.5f);
+		VkCommandBuffer cmdBuffer = retained.commandBuffers[objectIndex];
 
-		if (!objectData->visible)
-		{
-			return;
-		}
+		// Not bound to a framebuffer, so the command buffer can be executed in the render pass of any swap chain image
+		VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.framebuffer = VK_NULL_HANDLE;
 
 		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
-		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
 		commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
 
-		VkCommandBuffer cmdBuffer = thread->commandBuffer[cmdBufferIndex];
-
 		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &commandBufferBeginInfo));
 
 		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -230,7 +293,81 @@ public:
 		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phong);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phongRetained);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, retained.pipelineLayout, 0, 1, &retained.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(cmdBuffer, retained.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec3), &pushConstBlock[objectIndex].color);
+
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &models.ufo.vertices.buffer, offsets);
+		vkCmdBindIndexBuffer(cmdBuffer, models.ufo.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		// The first instance selects the object's model matrix in the vertex shader
+		vkCmdDrawIndexed(cmdBuffer, models.ufo.indices.count, 1, 0, 0, objectIndex);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+
+		retained.dirty[objectIndex] = 0;
+	}
+
+	// Updates the transforms of the visible objects in the object buffer, records the dirty command buffers and adds the visible ones to the recorder
+	void updateRetainedCommandBuffers()
+	{
+		const glm::mat4 viewProjection = matrices.projection * matrices.view;
+		memcpy(retained.uniformBuffer.mapped, &viewProjection, sizeof(glm::mat4));
+		glm::mat4* objectModels = reinterpret_cast<glm::mat4*>(retained.objectBuffer.mapped);
+		for (uint32_t i = 0; i < numObjects; i++) {
+			if (objectData[i].visible) {
+				objectModels[i] = objectData[i].model;
+			}
+		}
+
+		// Dirty objects are recorded by one job per command pool, as command buffers of the same pool can't be recorded concurrently
+		const uint32_t poolCount = static_cast<uint32_t>(retained.commandPools.size());
+		std::atomic<uint32_t> recorded{ 0 };
+		vks::JobCounter counter;
+		threadPool.addJobs(poolCount, [&](uint32_t pool) {
+			return [&, pool] {
+				for (uint32_t i = pool; i < numObjects; i += poolCount) {
+					if (retained.dirty[i]) {
+						recordRetainedCommandBuffer(i);
+						recorded++;
+					}
+				}
+			};
+		}, &counter);
+		threadPool.wait(counter);
+		retained.recordedCommandBuffers = recorded;
+
+		// Only submit if object is within the current view frustum and not occluded
+		for (uint32_t i = 0; i < numObjects; i++) {
+			if (objectData[i].visible) {
+				commandRecorder->add(retained.commandBuffers[i]);
+			}
+		}
+	}
+
+	// Gives a few random objects a new color, their retained command buffers have to be recorded again
+	void recolorObjects(uint32_t count)
+	{
+		std::uniform_int_distribution<uint32_t> rndObject(0, numObjects - 1);
+		for (uint32_t i = 0; i < count; i++) {
+			const uint32_t objectIndex = rndObject(rndEngine);
+			pushConstBlock[objectIndex].color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
+			retained.dirty[objectIndex] = 1;
+		}
+	}
+
+	// Animates an object and updates its push constant block, returns false if the object is outside of the view frustum
+	bool updateObject(uint32_t objectIndex)
+	{
+		ObjectData *objectData = &this->objectData[objectIndex];
+
+		// Check visibility against view frustum using a simple sphere check based on the radius of the mesh
+		objectData->visible = frustum.checkSphere(objectData->pos, models.ufo.dimensions.radius * 0.5f);
+
+		if (!objectData->visible)
+		{
+			return false;
+		}
 
 		// Update
 		if (!paused) {
@@ -250,24 +387,94 @@ public:
 		objectData->model = glm::rotate(objectData->model, glm::radians(objectData->deltaT * 360.0f), glm::vec3(0.0f, objectData->rotationDir, 0.0f));
 		objectData->model = glm::scale(objectData->model, glm::vec3(objectData->scale));
 
-		thread->pushConstBlock[cmdBufferIndex].mvp = matrices.projection * matrices.view * objectData->model;
+		pushConstBlock[objectIndex].mvp = matrices.projection * matrices.view * objectData->model;
 
-		// Update shader push constant block
-		// Contains model view matrix
-		vkCmdPushConstants(
-			cmdBuffer,
-			pipelineLayout,
-			VK_SHADER_STAGE_VERTEX_BIT,
-			0,
-			sizeof(ThreadPushConstantBlock),
-			&thread->pushConstBlock[cmdBufferIndex]);
+		return true;
+	}
+
+	// Animates all objects on the pool's workers, objects outside of the view frustum are marked invisible
+	void updateObjects()
+	{
+		threadPool.parallelFor(numObjects, 64, [this](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				updateObject(static_cast<uint32_t>(i));
+			}
+		});
+	}
+
+	// Adds the visible objects closest to the camera as occluders, they are most likely to hide others and cover the most pixels
+	void addOccluders()
+	{
+		occlusionCuller.begin(matrices.projection * matrices.view);
+		const glm::vec3 viewPos = glm::vec3(glm::inverse(matrices.view)[3]);
+		std::vector<uint32_t> candidates;
+		candidates.reserve(numObjects);
+		for (uint32_t i = 0; i < numObjects; i++) {
+			if (objectData[i].visible) {
+				candidates.push_back(i);
+			}
+		}
+		const size_t count = std::min(static_cast<size_t>(occluderCount), candidates.size());
+		std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), [&](uint32_t a, uint32_t b) {
+			return glm::distance(objectData[a].pos, viewPos) < glm::distance(objectData[b].pos, viewPos);
+		});
+		const vkglTF::Model::HostGeometry &geometry = models.ufo.hostGeometry;
+		for (size_t i = 0; i < count; i++) {
+			occlusionCuller.addOccluder(&geometry.vertices[0].pos.x, sizeof(vkglTF::Vertex), geometry.indices.data(), static_cast<uint32_t>(geometry.indices.size()), objectData[candidates[i]].model);
+		}
+	}
+
+	// Tests the bounds of the visible objects against the rasterized occluders and marks the hidden ones invisible
+	void cullOccludedObjects()
+	{
+		std::vector<uint8_t> occluded(numObjects, 0);
+		threadPool.parallelFor(numObjects, 64, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				if (objectData[i].visible && !occlusionCuller.testAABB(objectMin, objectMax, objectData[i].model)) {
+					objectData[i].visible = false;
+					occluded[i] = 1;
+				}
+			}
+		});
+		occludedObjects = static_cast<uint32_t>(std::count(occluded.begin(), occluded.end(), 1));
+	}
+
+	// Records the visible objects of a range into a secondary command buffer, called on a worker thread by the command recorder
+	void threadRenderCode(VkCommandBuffer cmdBuffer, size_t begin, size_t end)
+	{
+		// Secondary command buffers don't inherit any state, so every range sets up its own
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.phong);
 
 		VkDeviceSize offsets[1] = { 0 };
 		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &models.ufo.vertices.buffer, offsets);
 		vkCmdBindIndexBuffer(cmdBuffer, models.ufo.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(cmdBuffer, models.ufo.indices.count, 1, 0, 0, 0);
 
-		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+		for (size_t i = begin; i < end; i++)
+		{
+			// Only draw objects within the current view frustum and not occluded (see updateObjects)
+			if (!objectData[i].visible)
+			{
+				continue;
+			}
+
+			// Update shader push constant block
+			// Contains model view matrix
+			vkCmdPushConstants(
+				cmdBuffer,
+				pipelineLayout,
+				VK_SHADER_STAGE_VERTEX_BIT,
+				0,
+				sizeof(ThreadPushConstantBlock),
+				&pushConstBlock[i]);
+
+			vkCmdDrawIndexed(cmdBuffer, models.ufo.indices.count, 1, 0, 0, 0);
+		}
 	}
 
 	void updateSecondaryCommandBuffers(VkCommandBufferInheritanceInfo inheritanceInfo)
@@ -331,9 +538,6 @@ public:
 	// lat submitted to the queue for rendering
 	void updateCommandBuffers(VkFramebuffer frameBuffer)
 	{
-		// Contains the list of secondary command buffers to be submitted
-		std::vector<VkCommandBuffer> commandBuffers;
-
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VkClearValue clearValues[2];
@@ -364,43 +568,50 @@ public:
 		// Secondary command buffer also use the currently active framebuffer
 		inheritanceInfo.framebuffer = frameBuffer;
 
+		auto tStart = std::chrono::high_resolution_clock::now();
+		updateObjects();
+
+		// The occluders are rasterized by a job (and the workers it splits the work across) while this thread records the background and UI
+		vks::JobCounter occlusionCounter;
+		if (occlusionCulling) {
+			addOccluders();
+			threadPool.addJob([this] { occlusionCuller.render(&threadPool); }, &occlusionCounter);
+		}
+
 		// Update secondary sene command buffers
 		updateSecondaryCommandBuffers(inheritanceInfo);
 
-		if (displayStarSphere) {
-			commandBuffers.push_back(secondaryCommandBuffers.background);
+		if (occlusionCulling) {
+			threadPool.wait(occlusionCounter);
+			cullOccludedObjects();
+		} else {
+			occludedObjects = 0;
 		}
 
-		// Add a job to the thread's queue for each object to be rendered
-		for (uint32_t t = 0; t < numThreads; t++)
-		{
-			for (uint32_t i = 0; i < numObjectsPerThread; i++)
-			{
-				threadPool.threads[t]->addJob([=] { threadRenderCode(t, i, inheritanceInfo); });
-			}
-		}
+		// The previous frame has finished executing, so all secondary command buffers can be recycled at once
+		commandRecorder->beginFrame(0);
 
-		threadPool.wait();
+		if (displayStarSphere) {
+			commandRecorder->add(secondaryCommandBuffers.background);
+		}
 
-		// Only submit if object is within the current view frustum
-		for (uint32_t t = 0; t < numThreads; t++)
-		{
-			for (uint32_t i = 0; i < numObjectsPerThread; i++)
-			{
-				if (threadData[t].objectData[i].visible)
-				{
-					commandBuffers.push_back(threadData[t].commandBuffer[i]);
-				}
-			}
+		if (retainedCommandBuffers) {
+			updateRetainedCommandBuffers();
+		} else {
+			// Split the objects across the workers, each range of objects is recorded into a secondary command buffer of its own
+			commandRecorder->record(numObjects, 16, inheritanceInfo, [this](VkCommandBuffer commandBuffer, size_t begin, size_t end) {
+				threadRenderCode(commandBuffer, begin, end);
+			});
 		}
+		recordTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 
 		// Render ui last
 		if (UIOverlay.visible) {
-			commandBuffers.push_back(secondaryCommandBuffers.ui);
+			commandRecorder->add(secondaryCommandBuffers.ui);
 		}
 
-		// Execute render commands from the secondary command buffer
-		vkCmdExecuteCommands(primaryCommandBuffer, commandBuffers.size(), commandBuffers.data());
+		// Execute render commands from the secondary command buffers in the order they have been added
+		commandRecorder->executeCommands(primaryCommandBuffer);
 
 		vkCmdEndRenderPass(primaryCommandBuffer);
 
@@ -410,7 +621,15 @@ public:
 	void loadAssets()
 	{
 		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
-		models.ufo.loadFromFile(getAssetPath() + "models/retroufo_red_lowpoly.gltf",vulkanDevice, queue,glTFLoadingFlags);
+		// The host copy of the object's geometry is rasterized by the occlusion culler
+		models.ufo.loadFromFile(getAssetPath() + "models/retroufo_red_lowpoly.gltf",vulkanDevice, queue, glTFLoadingFlags | vkglTF::FileLoadingFlags::KeepHostGeometry);
+		// The model's dimensions are calculated before pre-transforming and flipping, so the bounds are taken from the final vertices
+		objectMin = glm::vec3(FLT_MAX);
+		objectMax = glm::vec3(-FLT_MAX);
+		for (const vkglTF::Vertex &vertex : models.ufo.hostGeometry.vertices) {
+			objectMin = glm::min(objectMin, vertex.pos);
+			objectMax = glm::max(objectMax, vertex.pos);
+		}
 		models.starSphere.loadFromFile(getAssetPath() + "models/sphere.gltf", vulkanDevice, queue, glTFLoadingFlags);
 	}
 
@@ -431,6 +650,19 @@ public:
 		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		// Retained mode reads the transforms from buffers and only pushes the object's color
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),	// Binding 0 : View projection matrix
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 1)	// Binding 1 : Model matrices
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &retained.descriptorSetLayout));
+		pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::vec3), 0);
+		pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&retained.descriptorSetLayout, 1);
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &retained.pipelineLayout));
 	}
 
 	void preparePipelines()
@@ -463,6 +695,12 @@ public:
 		shaderStages[1] = loadShader(getShadersPath() + "multithreading/phong.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phong));
 
+		// Object rendering pipeline for retained command buffers
+		pipelineCI.layout = retained.pipelineLayout;
+		shaderStages[0] = loadShader(getShadersPath() + "multithreading/phongretained.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phongRetained));
+		pipelineCI.layout = pipelineLayout;
+
 		// Star sphere rendering pipeline
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		depthStencilState.depthWriteEnable = VK_FALSE;
@@ -495,7 +733,7 @@ public:
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &primaryCommandBuffer;
 
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, renderFence));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, renderFence));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -510,6 +748,7 @@ public:
 		setupPipelineLayout();
 		preparePipelines();
 		prepareMultiThreadedRenderer();
+		resizeOcclusionCuller();
 		updateMatrices();
 		prepared = true;
 	}
@@ -523,6 +762,13 @@ public:
 		{
 			updateMatrices();
 		}
+		statisticsTimer += frameTimer;
+		if (statisticsTimer >= 1.0f)
+		{
+			workerStatistics = threadPool.getWorkerStatistics();
+			threadPool.resetWorkerStatistics();
+			statisticsTimer = 0.0f;
+		}
 	}
 
 	virtual void viewChanged()
@@ -530,13 +776,51 @@ public:
 		updateMatrices();
 	}
 
+	// The culler's depth buffer is much smaller than the window, but has the same aspect ratio
+	void resizeOcclusionCuller()
+	{
+		occlusionCuller.resize(256, std::max(256 * height / width, 1u));
+	}
+
+	virtual void windowResized()
+	{
+		// The viewport and scissor of the retained command buffers depend on the window size
+		std::fill(retained.dirty.begin(), retained.dirty.end(), 1);
+		resizeOcclusionCuller();
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Statistics")) {
-			overlay->text("Active threads: %d", numThreads);
+			overlay->text("Active threads: %d%s", numThreads, pinThreads ? " (pinned)" : "");
+			if (retainedCommandBuffers) {
+				overlay->text("Recorded command buffers: %d of %d", retained.recordedCommandBuffers, numObjects);
+			} else {
+				overlay->text("Secondary command buffers: %d", commandRecorder->getStatistics().recordedCommandBuffers);
+			}
+			if (occlusionCulling) {
+				overlay->text("Occluded objects: %d", occludedObjects);
+				overlay->text("Occluder triangles: %d of %d", occlusionCuller.getStatistics().rasterizedTriangles, occlusionCuller.getStatistics().occluderTriangles);
+			}
+			overlay->text("Command buffer update: %.3f ms", recordTime);
+		}
+		if (overlay->header("Workers")) {
+			for (size_t i = 0; i < workerStatistics.size(); i++) {
+				const vks::ThreadPool::WorkerStatistics& statistics = workerStatistics[i];
+				if (statistics.processor >= 0) {
+					overlay->text("Worker %d (cpu %d): %.0f %%, %d jobs", (int)i, statistics.processor, statistics.utilization * 100.0f, (int)statistics.jobCount);
+				} else {
+					overlay->text("Worker %d: %.0f %%, %d jobs", (int)i, statistics.utilization * 100.0f, (int)statistics.jobCount);
+				}
+			}
 		}
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Stars", &displayStarSphere);
+			overlay->checkBox("Retained command buffers", &retainedCommandBuffers);
+			overlay->checkBox("Occlusion culling", &occlusionCulling);
+			if (retainedCommandBuffers && overlay->button("Recolor objects")) {
+				recolorObjects(numObjects / 16);
+			}
 		}
 
 	}
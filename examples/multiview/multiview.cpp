@@ -8,6 +8,7 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#include <chrono>
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
 
@@ -21,9 +22,14 @@ public:
 			VkImage image;
 			VkDeviceMemory memory;
 			VkImageView view;
+			// Single layer views for rendering each view in a pass of its own
+			std::array<VkImageView, 2> layerViews;
 		} color, depth;
 		VkFramebuffer frameBuffer;
 		VkRenderPass renderPass;
+		// Render pass without multiview and a framebuffer per layer, for comparing against submitting the scene once for both views
+		std::array<VkFramebuffer, 2> viewFrameBuffers;
+		VkRenderPass singleViewRenderPass;
 		VkDescriptorImageInfo descriptor;
 		VkSampler sampler;
 		VkSemaphore semaphore;
@@ -38,17 +44,39 @@ public:
 		glm::mat4 modelview[2];
 		glm::vec4 lightPos = glm::vec4(-2.5f, -3.5f, 0.0f, 1.0f);
 		float distortionAlpha = 0.2f;
+		// Rendered region of the attachments, matches the offset in the view display shader
+		alignas(8) glm::vec2 uvScale = glm::vec2(1.0f);
 	} ubo;
 
 	vks::Buffer uniformBuffer;
 
 	VkPipeline pipeline;
+	VkPipeline singleViewPipeline;
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
 	VkPipeline viewDisplayPipelines[2];
 
+	/*
+		The scene is either drawn once and broadcast to both views by multiview, or drawn once per view into a render pass per layer
+		The command buffer of the scene is recorded every frame, so the CPU cost of both ways can be compared
+	*/
+	enum SubmissionMode { Multiview = 0, PerView = 1 };
+	int32_t submissionMode = Multiview;
+	const std::vector<std::string> submissionModeNames = { "Multiview (single submission)", "Per view (double submission)" };
+	struct SubmissionStatistics {
+		// Host time for recording the scene command buffer in milliseconds
+		double recordTime = 0.0;
+		// GPU time of the scene passes in milliseconds
+		double gpuTime = 0.0;
+	} submissionStatistics[2];
+	// Mode the scene command buffers were last recorded with, to assign the GPU times collected for them
+	std::vector<int32_t> recordedSubmissionModes;
+	// The benchmark is run for both submission modes in turn
+	const uint32_t benchmarkFramesPerMode = 500;
+	uint32_t benchmarkFrame = 0;
+
 	VkPhysicalDeviceMultiviewFeaturesKHR physicalDeviceMultiviewFeatures{};
 
 	// Camera and view properties
@@ -76,11 +104,15 @@ public:
 		physicalDeviceMultiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
 		physicalDeviceMultiviewFeatures.multiview = VK_TRUE;
 		deviceCreatepNextChain = &physicalDeviceMultiviewFeatures;
+
+		// The layered attachments are rendered at a scale of the window size, so resizes don't have to wait for the device
+		settings.deferredResize = true;
 	}
 
 	~VulkanExample()
 	{
 		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipeline(device, singleViewPipeline, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -93,8 +125,14 @@ public:
 		vkDestroyImageView(device, multiviewPass.depth.view, nullptr);
 		vkDestroyImage(device, multiviewPass.depth.image, nullptr);
 		vkFreeMemory(device, multiviewPass.depth.memory, nullptr);
+		for (uint32_t i = 0; i < 2; i++) {
+			vkDestroyImageView(device, multiviewPass.color.layerViews[i], nullptr);
+			vkDestroyImageView(device, multiviewPass.depth.layerViews[i], nullptr);
+			vkDestroyFramebuffer(device, multiviewPass.viewFrameBuffers[i], nullptr);
+		}
 
 		vkDestroyRenderPass(device, multiviewPass.renderPass, nullptr);
+		vkDestroyRenderPass(device, multiviewPass.singleViewRenderPass, nullptr);
 		vkDestroySampler(device, multiviewPass.sampler, nullptr);
 		vkDestroyFramebuffer(device, multiviewPass.frameBuffer, nullptr);
 
@@ -112,13 +150,14 @@ public:
 	}
 
 	/*
-		Prepares all resources required for the multiview attachment
-		Images, views, attachments, renderpass, framebuffer, etc.
+		Creates the layered attachments and the framebuffer at the attachment extent of the render resolution
+		Only the render extent is rendered to, so smaller windows or render scales reuse them
 	*/
-	void prepareMultiview()
+	void createMultiviewAttachments()
 	{
 		// Example renders to two views (left/right)
 		const uint32_t multiviewLayerCount = 2;
+		const VkExtent2D extent = renderResolution.attachmentExtent;
 
 		/*
 			Layered depth/stencil framebuffer
@@ -127,7 +166,7 @@ public:
 			VkImageCreateInfo imageCI= vks::initializers::imageCreateInfo();
 			imageCI.imageType = VK_IMAGE_TYPE_2D;
 			imageCI.format = depthFormat;
-			imageCI.extent = { width, height, 1 };
+			imageCI.extent = { extent.width, extent.height, 1 };
 			imageCI.mipLevels = 1;
 			imageCI.arrayLayers = multiviewLayerCount;
 			imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -165,6 +204,13 @@ public:
 			VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &multiviewPass.depth.memory));
 			VK_CHECK_RESULT(vkBindImageMemory(device, multiviewPass.depth.image, multiviewPass.depth.memory, 0));
 			VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &multiviewPass.depth.view));
+
+			depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			depthStencilView.subresourceRange.layerCount = 1;
+			for (uint32_t i = 0; i < multiviewLayerCount; i++) {
+				depthStencilView.subresourceRange.baseArrayLayer = i;
+				VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &multiviewPass.depth.layerViews[i]));
+			}
 		}
 
 		/*
@@ -174,7 +220,7 @@ public:
 			VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
 			imageCI.imageType = VK_IMAGE_TYPE_2D;
 			imageCI.format = swapChain.colorFormat;
-			imageCI.extent = { width, height, 1 };
+			imageCI.extent = { extent.width, extent.height, 1 };
 			imageCI.mipLevels = 1;
 			imageCI.arrayLayers = multiviewLayerCount;
 			imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -204,6 +250,92 @@ public:
 			imageViewCI.image = multiviewPass.color.image;
 			VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &multiviewPass.color.view));
 
+			imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			imageViewCI.subresourceRange.layerCount = 1;
+			for (uint32_t i = 0; i < multiviewLayerCount; i++) {
+				imageViewCI.subresourceRange.baseArrayLayer = i;
+				VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &multiviewPass.color.layerViews[i]));
+			}
+
+			// Fill a descriptor for later use in a descriptor set
+			multiviewPass.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			multiviewPass.descriptor.imageView = multiviewPass.color.view;
+			multiviewPass.descriptor.sampler = multiviewPass.sampler;
+		}
+
+		/*
+			Framebuffer
+		*/
+		{
+			VkImageView attachments[2];
+			attachments[0] = multiviewPass.color.view;
+			attachments[1] = multiviewPass.depth.view;
+
+			VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+			framebufferCI.renderPass = multiviewPass.renderPass;
+			framebufferCI.attachmentCount = 2;
+			framebufferCI.pAttachments = attachments;
+			framebufferCI.width = extent.width;
+			framebufferCI.height = extent.height;
+			framebufferCI.layers = 1;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &multiviewPass.frameBuffer));
+
+			// One framebuffer per layer for the render pass without multiview
+			framebufferCI.renderPass = multiviewPass.singleViewRenderPass;
+			for (uint32_t i = 0; i < multiviewLayerCount; i++) {
+				attachments[0] = multiviewPass.color.layerViews[i];
+				attachments[1] = multiviewPass.depth.layerViews[i];
+				VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &multiviewPass.viewFrameBuffers[i]));
+			}
+		}
+	}
+
+	// The attachments may still be used by the frame in flight, so they're released through the base class
+	void destroyMultiviewAttachments()
+	{
+		const MultiviewPass::FrameBufferAttachment color = multiviewPass.color;
+		const MultiviewPass::FrameBufferAttachment depth = multiviewPass.depth;
+		const VkFramebuffer frameBuffer = multiviewPass.frameBuffer;
+		const std::array<VkFramebuffer, 2> viewFrameBuffers = multiviewPass.viewFrameBuffers;
+		deferDestruction([this, color, depth, frameBuffer, viewFrameBuffers]() {
+			for (uint32_t i = 0; i < 2; i++) {
+				vkDestroyFramebuffer(device, viewFrameBuffers[i], nullptr);
+				vkDestroyImageView(device, color.layerViews[i], nullptr);
+				vkDestroyImageView(device, depth.layerViews[i], nullptr);
+			}
+			vkDestroyImageView(device, color.view, nullptr);
+			vkDestroyImage(device, color.image, nullptr);
+			vkFreeMemory(device, color.memory, nullptr);
+			vkDestroyImageView(device, depth.view, nullptr);
+			vkDestroyImage(device, depth.image, nullptr);
+			vkFreeMemory(device, depth.memory, nullptr);
+			vkDestroyFramebuffer(device, frameBuffer, nullptr);
+		});
+	}
+
+	// Recreates the attachments if the render extent outgrew them, returns true if the descriptors have been updated
+	bool updateMultiviewAttachments()
+	{
+		if (!updateRenderResolution()) {
+			return false;
+		}
+		// This example keeps a single frame in flight, so the queue is idle here and the descriptor set can be updated in place
+		destroyMultiviewAttachments();
+		createMultiviewAttachments();
+		updateDescriptors();
+		return true;
+	}
+
+	/*
+		Prepares all resources required for the multiview attachment
+		Images, views, attachments, renderpass, framebuffer, etc.
+	*/
+	void prepareMultiview()
+	{
+		/*
+			Sampler
+		*/
+		{
 			// Create sampler to sample from the attachment in the fragment shader
 			VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
 			samplerCI.magFilter = VK_FILTER_NEAREST;
@@ -218,11 +350,6 @@ public:
 			samplerCI.maxLod = 1.0f;
 			samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 			VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &multiviewPass.sampler));
-
-			// Fill a descriptor for later use in a descriptor set
-			multiviewPass.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			multiviewPass.descriptor.imageView = multiviewPass.color.view;
-			multiviewPass.descriptor.sampler = multiviewPass.sampler;
 		}
 
 		/*
@@ -317,25 +444,17 @@ public:
 			renderPassCI.pNext = &renderPassMultiviewCI;
 
 			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &multiviewPass.renderPass));
-		}
-
-		/*
-			Framebuffer
-		*/
-		{
-			VkImageView attachments[2];
-			attachments[0] = multiviewPass.color.view;
-			attachments[1] = multiviewPass.depth.view;
 
-			VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
-			framebufferCI.renderPass = multiviewPass.renderPass;
-			framebufferCI.attachmentCount = 2;
-			framebufferCI.pAttachments = attachments;
-			framebufferCI.width = width;
-			framebufferCI.height = height;
-			framebufferCI.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &multiviewPass.frameBuffer));
+			/*
+				Same attachments without multiview, rendering a single layer
+				Used to draw the scene once per view for comparison
+			*/
+			renderPassCI.pNext = nullptr;
+			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &multiviewPass.singleViewRenderPass));
 		}
+
+		updateRenderResolution();
+		createMultiviewAttachments();
 	}
 
 	void buildCommandBuffers()
@@ -393,45 +512,61 @@ public:
 				VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 			}
 		}
+	}
 
-		/*
-			Multiview layered attachment scene rendering
-		*/
-
-		{
-			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-
-			VkClearValue clearValues[2];
-			clearValues[0].color = defaultClearColor;
-			clearValues[1].depthStencil = { 1.0f, 0 };
-
-			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-			renderPassBeginInfo.renderPass = multiviewPass.renderPass;
-			renderPassBeginInfo.renderArea.offset.x = 0;
-			renderPassBeginInfo.renderArea.offset.y = 0;
-			renderPassBeginInfo.renderArea.extent.width = width;
-			renderPassBeginInfo.renderArea.extent.height = height;
-			renderPassBeginInfo.clearValueCount = 2;
-			renderPassBeginInfo.pClearValues = clearValues;
-
-			for (int32_t i = 0; i < multiviewPass.commandBuffers.size(); ++i) {
-				renderPassBeginInfo.framebuffer = multiviewPass.frameBuffer;
-
-				VK_CHECK_RESULT(vkBeginCommandBuffer(multiviewPass.commandBuffers[i], &cmdBufInfo));
-				vkCmdBeginRenderPass(multiviewPass.commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-				vkCmdSetViewport(multiviewPass.commandBuffers[i], 0, 1, &viewport);
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(multiviewPass.commandBuffers[i], 0, 1, &scissor);
+	/*
+		Multiview layered attachment scene rendering
+		Recorded every frame once the command buffer's last submission has finished, the recording time is the CPU cost of the submission mode
+	*/
+	void buildMultiviewCommandBuffer(uint32_t index)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		VkCommandBuffer commandBuffer = multiviewPass.commandBuffers[index];
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent = renderResolution.renderExtent;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		VkViewport viewport = vks::initializers::viewport((float)renderResolution.renderExtent.width, (float)renderResolution.renderExtent.height, 0.0f, 1.0f);
+		VkRect2D scissor = vks::initializers::rect2D(renderResolution.renderExtent.width, renderResolution.renderExtent.height, 0, 0);
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		benchmark.gpuProfiler.reset(commandBuffer, index);
+		benchmark.gpuProfiler.beginScope(commandBuffer, index, "Scene (" + submissionModeNames[submissionMode] + ")");
+
+		// Multiview draws the scene once for both views, otherwise it's drawn into a render pass per layer
+		const uint32_t passCount = (submissionMode == Multiview) ? 1 : 2;
+		for (uint32_t pass = 0; pass < passCount; pass++) {
+			renderPassBeginInfo.renderPass = (submissionMode == Multiview) ? multiviewPass.renderPass : multiviewPass.singleViewRenderPass;
+			renderPassBeginInfo.framebuffer = (submissionMode == Multiview) ? multiviewPass.frameBuffer : multiviewPass.viewFrameBuffers[pass];
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, (submissionMode == Multiview) ? pipeline : singleViewPipeline);
+			// Added to gl_ViewIndex, which is 0 outside of multiview render passes
+			int32_t viewOffset = static_cast<int32_t>(pass);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(int32_t), &viewOffset);
+			scene.draw(commandBuffer);
+
+			vkCmdEndRenderPass(commandBuffer);
+		}
 
-				vkCmdBindDescriptorSets(multiviewPass.commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-				vkCmdBindPipeline(multiviewPass.commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-				scene.draw(multiviewPass.commandBuffers[i]);
+		benchmark.gpuProfiler.endScope(commandBuffer, index);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 
-				vkCmdEndRenderPass(multiviewPass.commandBuffers[i]);
-				VK_CHECK_RESULT(vkEndCommandBuffer(multiviewPass.commandBuffers[i]));
-			}
-		}
+		recordedSubmissionModes[index] = submissionMode;
+		submissionStatistics[submissionMode].recordTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 	}
 
 	void loadAssets()
@@ -461,6 +596,10 @@ public:
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo =vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		// View offset for drawing the scene once per view
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(int32_t), 0);
+		pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
 
 		/*
@@ -549,6 +688,10 @@ public:
 		pipelineCI.pStages = shaderStages.data();
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
 
+		// Render passes with different view masks aren't compatible, so drawing each view in a pass of its own needs a pipeline of its own
+		pipelineCI.renderPass = multiviewPass.singleViewRenderPass;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &singleViewPipeline));
+
 		/*
 			Full screen pass
 		*/
@@ -639,6 +782,8 @@ public:
 		ubo.projection[1] = glm::frustum(left, right, bottom, top, zNear, zFar);
 		ubo.modelview[1] = rotM * transM;
 
+		ubo.uvScale = renderResolution.uvScale;
+
 		memcpy(uniformBuffer.mapped, &ubo, sizeof(ubo));
 	}
 
@@ -649,11 +794,16 @@ public:
 		// Multiview offscreen render
 		VK_CHECK_RESULT(vkWaitForFences(device, 1, &multiviewPass.waitFences[currentBuffer], VK_TRUE, UINT64_MAX));
 		VK_CHECK_RESULT(vkResetFences(device, 1, &multiviewPass.waitFences[currentBuffer]));
+		// The GPU times collected by prepareFrame() belong to the mode the command buffer was last recorded with
+		if (benchmark.gpuProfiler.supported && !benchmark.gpuProfiler.results.empty()) {
+			submissionStatistics[recordedSubmissionModes[currentBuffer]].gpuTime = benchmark.gpuProfiler.results[0].second;
+		}
+		buildMultiviewCommandBuffer(currentBuffer);
 		submitInfo.pWaitSemaphores = &semaphores.presentComplete;
 		submitInfo.pSignalSemaphores = &multiviewPass.semaphore;
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &multiviewPass.commandBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, multiviewPass.waitFences[currentBuffer]));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, multiviewPass.waitFences[currentBuffer]));
 
 		// View display
 		VK_CHECK_RESULT(vkWaitForFences(device, 1, &waitFences[currentBuffer], VK_TRUE, UINT64_MAX));
@@ -662,7 +812,7 @@ public:
 		submitInfo.pSignalSemaphores = &semaphores.renderComplete;
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, waitFences[currentBuffer]));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, waitFences[currentBuffer]));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -679,6 +829,7 @@ public:
 		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(drawCmdBuffers.size()));
 		multiviewPass.commandBuffers.resize(drawCmdBuffers.size());
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, multiviewPass.commandBuffers.data()));
+		recordedSubmissionModes.resize(multiviewPass.commandBuffers.size(), submissionMode);
 
 		buildCommandBuffers();
 
@@ -694,46 +845,46 @@ public:
 	// SRS - Recreate and update Multiview resources when window size has changed
 	virtual void windowResized()
 	{
-		vkDestroyImageView(device, multiviewPass.color.view, nullptr);
-		vkDestroyImage(device, multiviewPass.color.image, nullptr);
-		vkFreeMemory(device, multiviewPass.color.memory, nullptr);
-		vkDestroyImageView(device, multiviewPass.depth.view, nullptr);
-		vkDestroyImage(device, multiviewPass.depth.image, nullptr);
-		vkFreeMemory(device, multiviewPass.depth.memory, nullptr);
+		// The attachments are only recreated if the new window size doesn't fit into them
+		updateMultiviewAttachments();
 
-		vkDestroyRenderPass(device, multiviewPass.renderPass, nullptr);
-		vkDestroySampler(device, multiviewPass.sampler, nullptr);
-		vkDestroyFramebuffer(device, multiviewPass.frameBuffer, nullptr);
+		// SRS - Recreate Multiview command buffers and fences in case number of swapchain images has changed on resize
+		// The base class waits for the device if that's the case, otherwise the existing ones are recorded again
+		if (multiviewPass.commandBuffers.size() != drawCmdBuffers.size()) {
+			vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(multiviewPass.commandBuffers.size()), multiviewPass.commandBuffers.data());
 
-		prepareMultiview();
-		updateDescriptors();
-		
-		// SRS - Recreate Multiview command buffers in case number of swapchain images has changed on resize
-		vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(multiviewPass.commandBuffers.size()), multiviewPass.commandBuffers.data());
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(drawCmdBuffers.size()));
+			multiviewPass.commandBuffers.resize(drawCmdBuffers.size());
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, multiviewPass.commandBuffers.data()));
+			recordedSubmissionModes.resize(multiviewPass.commandBuffers.size(), submissionMode);
 
-		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(drawCmdBuffers.size()));
-		multiviewPass.commandBuffers.resize(drawCmdBuffers.size());
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, multiviewPass.commandBuffers.data()));
+			for (auto& fence : multiviewPass.waitFences) {
+				vkDestroyFence(device, fence, nullptr);
+			}
+			VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+			multiviewPass.waitFences.resize(multiviewPass.commandBuffers.size());
+			for (auto& fence : multiviewPass.waitFences) {
+				VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
+			}
+		}
 
 		resized = false;
 		buildCommandBuffers();
-		
-		// SRS - Recreate Multiview fences in case number of swapchain images has changed on resize
-		for (auto& fence : multiviewPass.waitFences) {
-			vkDestroyFence(device, fence, nullptr);
-		}
-		
-		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-		multiviewPass.waitFences.resize(multiviewPass.commandBuffers.size());
-		for (auto& fence : multiviewPass.waitFences) {
-			VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
-		}
 	}
 
 	virtual void render()
 	{
 		if (!prepared)
 			return;
+		if (benchmark.active) {
+			if (benchmarkFrame == 0) {
+				submissionMode = Multiview;
+			}
+			else if (benchmarkFrame % benchmarkFramesPerMode == 0) {
+				submissionMode = (submissionMode == Multiview) ? PerView : Multiview;
+			}
+			benchmarkFrame++;
+		}
 		draw();
 		if (camera.updated) {
 			updateUniformBuffers();
@@ -754,6 +905,22 @@ public:
 			if (overlay->sliderFloat("Barrel distortion", &ubo.distortionAlpha, -0.6f, 0.6f)) {
 				updateUniformBuffers();
 			}
+			if (overlay->sliderFloat("Render scale", &renderResolution.scale, 0.25f, 1.0f)) {
+				updateMultiviewAttachments();
+				buildCommandBuffers();
+				updateUniformBuffers();
+			}
+			// The scene command buffer is recorded every frame, so switching doesn't need a rebuild
+			overlay->comboBox("Submission", &submissionMode, submissionModeNames);
+		}
+		if (overlay->header("Submission costs")) {
+			for (uint32_t i = 0; i < 2; i++) {
+				overlay->text("%s", submissionModeNames[i].c_str());
+				overlay->text("  CPU recording: %.3f ms", submissionStatistics[i].recordTime);
+				if (benchmark.gpuProfiler.supported) {
+					overlay->text("  GPU: %.3f ms", submissionStatistics[i].gpuTime);
+				}
+			}
 		}
 	}
 
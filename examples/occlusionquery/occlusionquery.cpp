@@ -8,6 +8,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanQueryReadback.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -53,8 +54,9 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
-	// Pool that stores all occlusion queries
-	VkQueryPool queryPool;
+	// Query pools of all command buffers, with the results copied to a host buffer on the GPU
+	std::unique_ptr<vks::QueryReadback> queries;
+	std::vector<uint64_t> queryResults;
 
 	// Passed query samples
 	uint64_t passedSamples[2] = { 1,1 };
@@ -62,6 +64,7 @@ public:
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Occlusion queries";
+		supportsFramesInFlight = true;
 		camera.type = Camera::CameraType::lookat;
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -7.5f));
 		camera.setRotation(glm::vec3(0.0f, -123.75f, 0.0f));
@@ -80,39 +83,28 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		vkDestroyQueryPool(device, queryPool, nullptr);
+		queries.reset();
 
 		uniformBuffers.occluder.destroy();
 		uniformBuffers.sphere.destroy();
 		uniformBuffers.teapot.destroy();
 	}
 
-	// Create a query pool for storing the occlusion query result
+	// Create the query pools for storing the occlusion query results, one per command buffer
 	void setupQueryPool()
 	{
-		VkQueryPoolCreateInfo queryPoolInfo = {};
-		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
-		queryPoolInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
-		queryPoolInfo.queryCount = 2;
-		VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, NULL, &queryPool));
+		queries.reset(new vks::QueryReadback(vulkanDevice, VK_QUERY_TYPE_OCCLUSION, 2, static_cast<uint32_t>(drawCmdBuffers.size())));
 	}
 
-	// Retrieves the results of the occlusion queries submitted to the command buffer
+	// Retrieves the results of the occlusion queries of the last completed submission of the current command buffer
 	void getQueryResults()
 	{
-		// We use vkGetQueryResults to copy the results into a host visible buffer
-		vkGetQueryPoolResults(
-			device,
-			queryPool,
-			0,
-			2,
-			sizeof(passedSamples),
-			passedSamples,
-			sizeof(uint64_t),
-			// Store results a 64 bit values and wait until the results have been finished
-			// If you don't want to wait, you can use VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
-			// which also returns the state of the result (ready) in the result
-			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+		// The results have been copied into a host visible buffer by the command buffer, so reading them doesn't wait for the GPU
+		// They are a few frames old, but the frame just submitted doesn't have to finish before the next one can be recorded
+		if (queries->getResults(currentBuffer, queryResults)) {
+			passedSamples[0] = queryResults[0];
+			passedSamples[1] = queryResults[1];
+		}
 	}
 
 	void buildCommandBuffers()
@@ -132,6 +124,11 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
+		// The number of command buffers changes if the swap chain is recreated with a different number of images
+		if (queries->getSlotCount() != drawCmdBuffers.size()) {
+			setupQueryPool();
+		}
+
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			// Set target frame buffer
@@ -141,7 +138,7 @@ public:
 
 			// Reset query pool
 			// Must be done outside of render pass
-			vkCmdResetQueryPool(drawCmdBuffers[i], queryPool, 0, 2);
+			queries->reset(drawCmdBuffers[i], i);
 
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
@@ -169,16 +166,16 @@ public:
 			models.plane.draw(drawCmdBuffers[i]);
 
 			// Teapot
-			vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 0, VK_FLAGS_NONE);
+			queries->begin(drawCmdBuffers[i], i, 0);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.teapot, 0, NULL);
 			models.teapot.draw(drawCmdBuffers[i]);
-			vkCmdEndQuery(drawCmdBuffers[i], queryPool, 0);
+			queries->end(drawCmdBuffers[i], i, 0);
 
 			// Sphere
-			vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 1, VK_FLAGS_NONE);
+			queries->begin(drawCmdBuffers[i], i, 1);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.sphere, 0, NULL);
 			models.sphere.draw(drawCmdBuffers[i]);
-			vkCmdEndQuery(drawCmdBuffers[i], queryPool, 1);
+			queries->end(drawCmdBuffers[i], i, 1);
 
 			// Visible pass
 			// Clear color and depth attachments
@@ -222,21 +219,24 @@ public:
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			// Copy the results for the host, must be done outside of render pass
+			queries->copyResults(drawCmdBuffers[i], i);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
 
 	void draw()
 	{
-		updateUniformBuffers();
 		VulkanExampleBase::prepareFrame();
 
+		// The last submission of the command buffer has finished, so its query results can be read without waiting
+		getQueryResults();
+		updateUniformBuffers();
+
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-
-		// Read query results for displaying in next frame
-		getQueryResults();
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
 
 		VulkanExampleBase::submitFrame();
 	}
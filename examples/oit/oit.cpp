@@ -13,11 +13,26 @@
 #include "VulkanglTFModel.h"
 
 #define ENABLE_VALIDATION false
-#define NODE_COUNT 20
+// Initial capacity of the linked list in nodes per pixel, it's then adapted to the node count of the rendered frames
+#define INITIAL_NODES_PER_PIXEL 4
+// Frames after which the linked list is shrunk if none of them used more than a quarter of its nodes
+#define NODE_SHRINK_FRAMES 300
+// Has to match the kbuffer.frag and kbuffercolor.frag shaders
+#define KBUFFER_LAYER_COUNT 8
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
+	enum Method {
+		// Per pixel linked list of all fragments, the node buffer follows the scene's fragment count
+		LinkedList = 0,
+		// Fixed number of layers per pixel
+		KBuffer = 1,
+		// Weighted average of all fragments, no per fragment storage
+		WeightedBlended = 2,
+	};
+	int32_t method = LinkedList;
+
 	struct {
 		vkglTF::Model sphere;
 		vkglTF::Model cube;
@@ -33,19 +48,43 @@ public:
 		uint32_t next;
 	};
 
-	struct {
+	struct GeometrySBO {
 		uint32_t count;
 		uint32_t maxNodeCount;
-	} geometrySBO;
+	};
+
+	struct FrameBufferAttachment {
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+	};
 
+	// Only the resources of the selected method are allocated
 	struct GeometryPass {
 		VkRenderPass renderPass;
-		VkFramebuffer framebuffer;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
 		vks::Buffer geometry;
+		// Head index (linked list) or fragment count (k-buffer) per pixel
 		vks::Texture headIndex;
 		vks::Buffer linkedList;
+		vks::Buffer kBuffer;
+		// Node counts of the last submission of each command buffer, the counter keeps counting when the list is full
+		vks::Buffer nodeCounts;
+		uint32_t maxNodeCount = 0;
+		// Highest node count since the capacity was last checked for shrinking
+		uint32_t peakNodeCount = 0;
+		uint32_t framesSinceShrinkCheck = 0;
 	} geometryPass;
 
+	// Accumulation and revealage targets of the weighted blended method
+	struct WeightedPass {
+		VkRenderPass renderPass;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		FrameBufferAttachment accumulation;
+		FrameBufferAttachment revealage;
+		VkSampler sampler;
+	} weightedPass;
+
 	struct {
 		glm::mat4 projection;
 		glm::mat4 view;
@@ -59,18 +98,25 @@ public:
 	struct {
 		VkDescriptorSetLayout geometry;
 		VkDescriptorSetLayout color;
+		VkDescriptorSetLayout weightedColor;
 	} descriptorSetLayouts;
 
 	struct {
 		VkPipelineLayout geometry;
 		VkPipelineLayout color;
+		VkPipelineLayout weightedColor;
 	} pipelineLayouts;
 
 	struct {
 		VkPipeline geometry;
 		VkPipeline color;
+		VkPipeline kBufferGeometry;
+		VkPipeline kBufferColor;
+		VkPipeline weightedGeometry;
+		VkPipeline weightedColor;
 	} pipelines;
 
+	// Sets of the selected method, the geometry and color sets are shared by the linked list and the k-buffer
 	struct {
 		VkDescriptorSet geometry;
 		VkDescriptorSet color;
@@ -79,6 +125,7 @@ public:
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Order independent transparency rendering";
+		supportsFramesInFlight = true;
 		camera.type = Camera::CameraType::lookat;
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -6.0f));
 		camera.setRotation(glm::vec3(0.0f, 0.0f, 0.0f));
@@ -89,14 +136,25 @@ public:
 	{
 		vkDestroyPipeline(device, pipelines.geometry, nullptr);
 		vkDestroyPipeline(device, pipelines.color, nullptr);
+		vkDestroyPipeline(device, pipelines.kBufferGeometry, nullptr);
+		vkDestroyPipeline(device, pipelines.kBufferColor, nullptr);
+		vkDestroyPipeline(device, pipelines.weightedGeometry, nullptr);
+		vkDestroyPipeline(device, pipelines.weightedColor, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.geometry, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.color, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.weightedColor, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.geometry, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.color, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.weightedColor, nullptr);
 
 		destroyGeometryPass();
+		vkDestroyRenderPass(device, geometryPass.renderPass, nullptr);
+		vkDestroyRenderPass(device, weightedPass.renderPass, nullptr);
+		vkDestroySampler(device, weightedPass.sampler, nullptr);
+		geometryPass.geometry.destroy();
+		geometryPass.nodeCounts.destroy();
 
 		uniformBuffers.renderPass.destroy();
 	}
@@ -115,6 +173,7 @@ public:
 		VulkanExampleBase::prepare();
 		loadAssets();
 		prepareUniformBuffers();
+		prepareRenderPasses();
 		prepareGeometryPass();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -134,11 +193,8 @@ public:
 
 	void windowResized() override
 	{
-		destroyGeometryPass();
-		prepareGeometryPass();
-		vkResetDescriptorPool(device, descriptorPool, 0);
-		setupDescriptorSets();
-
+		vkDeviceWaitIdle(device);
+		recreateGeometryPass();
 		resized = false;
 		buildCommandBuffers();
 	}
@@ -148,6 +204,35 @@ public:
 		updateUniformBuffers();
 	}
 
+	void OnUpdateUIOverlay(vks::UIOverlay *overlay) override
+	{
+		if (overlay->header("Settings")) {
+			if (overlay->comboBox("Method", &method, { "Linked list", "K-buffer", "Weighted blended" })) {
+				vkDeviceWaitIdle(device);
+				recreateGeometryPass();
+				buildCommandBuffers();
+			}
+		}
+		if (overlay->header("Memory")) {
+			VkDeviceSize size = 0;
+			switch (method) {
+			case LinkedList:
+				size = geometryPass.linkedList.size + geometryPass.headIndex.width * geometryPass.headIndex.height * sizeof(uint32_t);
+				overlay->text("Nodes: %u", geometryPass.maxNodeCount);
+				break;
+			case KBuffer:
+				size = geometryPass.kBuffer.size + geometryPass.headIndex.width * geometryPass.headIndex.height * sizeof(uint32_t);
+				overlay->text("Layers: %u", KBUFFER_LAYER_COUNT);
+				break;
+			case WeightedBlended:
+				// RGBA16F accumulation and R16F revealage
+				size = static_cast<VkDeviceSize>(width) * height * (4 + 1) * 2;
+				break;
+			}
+			overlay->text("Size: %.2f MB", static_cast<float>(size) / (1024.0f * 1024.0f));
+		}
+	}
+
 private:
 	void loadAssets()
 	{
@@ -166,9 +251,28 @@ private:
 			sizeof(renderPassUBO)));
 
 		VK_CHECK_RESULT(uniformBuffers.renderPass.map());
+
+		// Create a buffer for GeometrySBO, its values are written by the command buffers
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&geometryPass.geometry,
+			sizeof(GeometrySBO)));
+
+		// Create a host visible buffer the node count of each command buffer is copied to
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&geometryPass.nodeCounts,
+			sizeof(uint32_t) * drawCmdBuffers.size()));
+		VK_CHECK_RESULT(geometryPass.nodeCounts.map());
+		memset(geometryPass.nodeCounts.mapped, 0, sizeof(uint32_t) * drawCmdBuffers.size());
+
+		geometryPass.maxNodeCount = INITIAL_NODES_PER_PIXEL * width * height;
 	}
 
-	void prepareGeometryPass()
+	// The render passes don't depend on the window size or the method, so the pipelines are created once
+	void prepareRenderPasses()
 	{
 		VkSubpassDescription subpassDescription = {};
 		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
@@ -181,6 +285,109 @@ private:
 
 		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &geometryPass.renderPass));
 
+		// Weighted blended render pass accumulates into two color attachments read by the color pass
+		std::array<VkAttachmentDescription, 2> attachments = {};
+		attachments[0].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		attachments[1].format = VK_FORMAT_R16_SFLOAT;
+		for (VkAttachmentDescription& attachment : attachments) {
+			attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+			attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+		std::array<VkAttachmentReference, 2> colorReferences = {};
+		colorReferences[0] = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		colorReferences[1] = { 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		subpassDescription.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+		subpassDescription.pColorAttachments = colorReferences.data();
+
+		std::array<VkSubpassDependency, 2> dependencies;
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &weightedPass.renderPass));
+
+		// The color pass reads the weighted blended targets at pixel centers
+		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.maxAnisotropy = 1.0f;
+		samplerInfo.maxLod = 0.0f;
+		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerInfo, nullptr, &weightedPass.sampler));
+	}
+
+	void createAttachment(VkFormat format, FrameBufferAttachment *attachment)
+	{
+		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = format;
+		imageInfo.extent = { width, height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageInfo, nullptr, &attachment->image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->memory, 0));
+
+		VkImageViewCreateInfo imageViewInfo = vks::initializers::imageViewCreateInfo();
+		imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageViewInfo.format = format;
+		imageViewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		imageViewInfo.image = attachment->image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageViewInfo, nullptr, &attachment->view));
+	}
+
+	void prepareGeometryPass()
+	{
+		if (method == WeightedBlended) {
+			createAttachment(VK_FORMAT_R16G16B16A16_SFLOAT, &weightedPass.accumulation);
+			createAttachment(VK_FORMAT_R16_SFLOAT, &weightedPass.revealage);
+
+			VkImageView attachments[2] = { weightedPass.accumulation.view, weightedPass.revealage.view };
+			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+			fbufCreateInfo.renderPass = weightedPass.renderPass;
+			fbufCreateInfo.attachmentCount = 2;
+			fbufCreateInfo.pAttachments = attachments;
+			fbufCreateInfo.width = width;
+			fbufCreateInfo.height = height;
+			fbufCreateInfo.layers = 1;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &weightedPass.framebuffer));
+			return;
+		}
+
 		// Geometry frame buffer doesn't need any output attachment.
 		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
 		fbufCreateInfo.renderPass = geometryPass.renderPass;
@@ -191,38 +398,8 @@ private:
 
 		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &geometryPass.framebuffer));
 
-		// Create a buffer for GeometrySBO
-		vks::Buffer stagingBuffer;
-	
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			sizeof(geometrySBO)));
-		VK_CHECK_RESULT(stagingBuffer.map());
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&geometryPass.geometry,
-			sizeof(geometrySBO)));
-
-		// Set up GeometrySBO data.
-		geometrySBO.count = 0;
-		geometrySBO.maxNodeCount = NODE_COUNT * width * height;
-		memcpy(stagingBuffer.mapped, &geometrySBO, sizeof(geometrySBO));
-
-		// Copy data to device
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBufferCopy copyRegion = {};
-		copyRegion.size = sizeof(geometrySBO);
-		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, geometryPass.geometry.buffer, 1, &copyRegion);
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
-
-		stagingBuffer.destroy();
-		
 		// Create a texture for HeadIndex.
-		// This image will track the head index of each fragment.
+		// This image will track the head index (linked list) or the fragment count (k-buffer) of each pixel.
 		geometryPass.headIndex.device = vulkanDevice;
 
 		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
@@ -277,21 +454,24 @@ private:
 		geometryPass.headIndex.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 		geometryPass.headIndex.sampler = VK_NULL_HANDLE;
 
-		// Create a buffer for LinkedListSBO
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&geometryPass.linkedList,
-			sizeof(Node) * geometrySBO.maxNodeCount));
+		if (method == LinkedList) {
+			// Create a buffer for LinkedListSBO, sized for the node count of the previous frames instead of the worst case
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&geometryPass.linkedList,
+				sizeof(Node) * geometryPass.maxNodeCount));
+		} else {
+			// Create a buffer for KBufferSBO with a packed color and depth per layer and pixel
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&geometryPass.kBuffer,
+				sizeof(uint32_t) * 2 * KBUFFER_LAYER_COUNT * width * height));
+		}
 
 		// Change HeadIndex image's layout from UNDEFINED to GENERAL
-		VkCommandBufferAllocateInfo cmdBufAllocInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
-
-		VkCommandBuffer cmdBuf;
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocInfo, &cmdBuf));
-
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuf, &cmdBufInfo));
+		VkCommandBuffer cmdBuf = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
 		VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
 		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
@@ -304,14 +484,20 @@ private:
 
 		vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuf));
-
-		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &cmdBuf;
+		vulkanDevice->flushCommandBuffer(cmdBuf, queue, true);
+	}
 
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	// Replaces the resources of the geometry pass and their descriptor sets, the device has to be idle
+	void recreateGeometryPass()
+	{
+		destroyGeometryPass();
+		prepareGeometryPass();
+		vkResetDescriptorPool(device, descriptorPool, 0);
+		setupDescriptorSets();
+		// Counts of the previous method or capacity must not trigger another resize
+		memset(geometryPass.nodeCounts.mapped, 0, sizeof(uint32_t) * drawCmdBuffers.size());
+		geometryPass.peakNodeCount = 0;
+		geometryPass.framesSinceShrinkCheck = 0;
 	}
 
 	void setupDescriptorSetLayout()
@@ -333,7 +519,7 @@ private:
 				VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 				VK_SHADER_STAGE_FRAGMENT_BIT,
 				2),
-			// LinkedListSBO
+			// LinkedListSBO / KBufferSBO
 			vks::initializers::descriptorSetLayoutBinding(
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				VK_SHADER_STAGE_FRAGMENT_BIT,
@@ -358,7 +544,7 @@ private:
 				VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 				VK_SHADER_STAGE_FRAGMENT_BIT,
 				0),
-			// LinkedListSBO
+			// LinkedListSBO / KBufferSBO
 			vks::initializers::descriptorSetLayoutBinding(
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				VK_SHADER_STAGE_FRAGMENT_BIT,
@@ -371,6 +557,26 @@ private:
 		// Create a color pipeline layout.
 		pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.color, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.color));
+
+		// Create a weighted blended color descriptor set layout.
+		setLayoutBindings = {
+			// samplerAccumulation
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				0),
+			// samplerRevealage
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				1),
+		};
+
+		descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.weightedColor));
+
+		pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.weightedColor, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.weightedColor));
 	}
 
 	void preparePipelines()
@@ -403,6 +609,37 @@ private:
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.geometry));
 
+		// Create a k-buffer geometry pipeline.
+		shaderStages[1] = loadShader(getShadersPath() + "oit/kbuffer.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.kBufferGeometry));
+
+		// Create a weighted blended geometry pipeline.
+		// Accumulation is summed up, revealage is multiplied by one minus the fragment's alpha
+		std::array<VkPipelineColorBlendAttachmentState, 2> weightedBlendAttachmentStates = {
+			vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_TRUE),
+			vks::initializers::pipelineColorBlendAttachmentState(0x1, VK_TRUE),
+		};
+		weightedBlendAttachmentStates[0].srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		weightedBlendAttachmentStates[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		weightedBlendAttachmentStates[0].colorBlendOp = VK_BLEND_OP_ADD;
+		weightedBlendAttachmentStates[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		weightedBlendAttachmentStates[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		weightedBlendAttachmentStates[0].alphaBlendOp = VK_BLEND_OP_ADD;
+		weightedBlendAttachmentStates[1].srcColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+		weightedBlendAttachmentStates[1].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR;
+		weightedBlendAttachmentStates[1].colorBlendOp = VK_BLEND_OP_ADD;
+		weightedBlendAttachmentStates[1].srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		weightedBlendAttachmentStates[1].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		weightedBlendAttachmentStates[1].alphaBlendOp = VK_BLEND_OP_ADD;
+		VkPipelineColorBlendStateCreateInfo weightedColorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(static_cast<uint32_t>(weightedBlendAttachmentStates.size()), weightedBlendAttachmentStates.data());
+
+		pipelineCI.renderPass = weightedPass.renderPass;
+		pipelineCI.pColorBlendState = &weightedColorBlendState;
+		shaderStages[1] = loadShader(getShadersPath() + "oit/weighted.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.weightedGeometry));
+
 		// Create a color pipeline.
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
 		colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
@@ -428,15 +665,27 @@ private:
 		rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.color));
+
+		// Create a k-buffer color pipeline.
+		shaderStages[1] = loadShader(getShadersPath() + "oit/kbuffercolor.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.kBufferColor));
+
+		// Create a weighted blended color pipeline.
+		pipelineCI.layout = pipelineLayouts.weightedColor;
+		shaderStages[1] = loadShader(getShadersPath() + "oit/weightedcolor.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.weightedColor));
 	}
 
 	void setupDescriptorPool()
 	{
+		// Enough for the sets of any method
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2),
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -456,6 +705,28 @@ private:
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.geometry));
 
+		// The weighted blended method only reads the RenderPassUBO in the geometry pass
+		if (method == WeightedBlended) {
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSets.geometry, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.renderPass.descriptor);
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, NULL);
+
+			allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.weightedColor, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.color));
+
+			VkDescriptorImageInfo accumulationDescriptor = vks::initializers::descriptorImageInfo(weightedPass.sampler, weightedPass.accumulation.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			VkDescriptorImageInfo revealageDescriptor = vks::initializers::descriptorImageInfo(weightedPass.sampler, weightedPass.revealage.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				// Binding 0: samplerAccumulation
+				vks::initializers::writeDescriptorSet(descriptorSets.color, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &accumulationDescriptor),
+				// Binding 1: samplerRevealage
+				vks::initializers::writeDescriptorSet(descriptorSets.color, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &revealageDescriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+			return;
+		}
+
+		vks::Buffer &fragmentBuffer = (method == LinkedList) ? geometryPass.linkedList : geometryPass.kBuffer;
+
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 			// Binding 0: RenderPassUBO
 			vks::initializers::writeDescriptorSet(
@@ -475,12 +746,12 @@ private:
 				VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 				2,
 				&geometryPass.headIndex.descriptor),
-			// Binding 4: LinkedListSBO
+			// Binding 4: LinkedListSBO / KBufferSBO
 			vks::initializers::writeDescriptorSet(
 				descriptorSets.geometry,
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				3,
-				&geometryPass.linkedList.descriptor)
+				&fragmentBuffer.descriptor)
 		};
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
@@ -501,17 +772,52 @@ private:
 				VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 				0,
 				&geometryPass.headIndex.descriptor),
-			// Binding 1: LinkedListSBO
+			// Binding 1: LinkedListSBO / KBufferSBO
 			vks::initializers::writeDescriptorSet(
 				descriptorSets.color,
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				1,
-				&geometryPass.linkedList.descriptor)
+				&fragmentBuffer.descriptor)
 		};
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 	}
 
+	void drawScene(VkCommandBuffer commandBuffer)
+	{
+		models.sphere.bindBuffers(commandBuffer);
+
+		// Render the scene
+		ObjectData objectData;
+
+		objectData.color = glm::vec4(1.0f, 0.0f, 0.0f, 0.5f);
+		for (int32_t x = 0; x < 5; x++)
+		{
+			for (int32_t y = 0; y < 5; y++)
+			{
+				for (int32_t z = 0; z < 5; z++)
+				{
+					glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(x - 2, y - 2, z - 2));
+					glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.3f));
+					objectData.model = T * S;
+					vkCmdPushConstants(commandBuffer, pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
+					models.sphere.draw(commandBuffer);
+				}
+			}
+		}
+
+		models.cube.bindBuffers(commandBuffer);
+		objectData.color = glm::vec4(0.0f, 0.0f, 1.0f, 0.5f);
+		for (uint32_t x = 0; x < 2; x++)
+		{
+			glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f * x - 1.5f, 0.0f, 0.0f));
+			glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f));
+			objectData.model = T * S;
+			vkCmdPushConstants(commandBuffer, pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
+			models.cube.draw(commandBuffer);
+		}
+	}
+
 	void buildCommandBuffers() override
 	{
 		if (resized)
@@ -523,6 +829,11 @@ private:
 		clearValues[0].color = defaultClearColor;
 		clearValues[1].depthStencil = { 1.0f, 0 };
 
+		// Accumulation starts at zero, revealage at one (fully revealed background)
+		VkClearValue weightedClearValues[2];
+		weightedClearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		weightedClearValues[1].color = { { 1.0f, 0.0f, 0.0f, 0.0f } };
+
 		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
 		renderPassBeginInfo.renderArea.offset.x = 0;
 		renderPassBeginInfo.renderArea.offset.y = 0;
@@ -542,79 +853,85 @@ private:
 			// Update dynamic scissor state
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			VkClearColorValue clearColor;
-			clearColor.uint32[0] = 0xffffffff;
-
-			VkImageSubresourceRange subresRange = {};
-
-			subresRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			subresRange.levelCount = 1;
-			subresRange.layerCount = 1;
-
-			vkCmdClearColorImage(drawCmdBuffers[i], geometryPass.headIndex.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresRange);
-
-			// Clear previous geometry pass data
-			vkCmdFillBuffer(drawCmdBuffers[i], geometryPass.geometry.buffer, 0, sizeof(uint32_t), 0);
-
-			// We need a barrier to make sure all writes are finished before starting to write again
-			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
-			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
-
-			// Begin the geometry render pass
-			renderPassBeginInfo.renderPass = geometryPass.renderPass;
-			renderPassBeginInfo.framebuffer = geometryPass.framebuffer;
-			renderPassBeginInfo.clearValueCount = 0;
-			renderPassBeginInfo.pClearValues = nullptr;
-
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometry);
-			uint32_t dynamicOffset = 0;
-			models.sphere.bindBuffers(drawCmdBuffers[i]);
-
-			// Render the scene
-			ObjectData objectData;
-
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.geometry, 0, 1, &descriptorSets.geometry, 0, nullptr);
-			objectData.color = glm::vec4(1.0f, 0.0f, 0.0f, 0.5f);
-			for (int32_t x = 0; x < 5; x++)
+			if (method == WeightedBlended)
 			{
-				for (int32_t y = 0; y < 5; y++)
-				{
-					for (int32_t z = 0; z < 5; z++)
-					{
-						glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(x - 2, y - 2, z - 2));
-						glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.3f));
-						objectData.model = T * S;
-						vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
-						models.sphere.draw(drawCmdBuffers[i]);
-					}
-				}
+				// Begin the weighted blended geometry render pass
+				renderPassBeginInfo.renderPass = weightedPass.renderPass;
+				renderPassBeginInfo.framebuffer = weightedPass.framebuffer;
+				renderPassBeginInfo.clearValueCount = 2;
+				renderPassBeginInfo.pClearValues = weightedClearValues;
+
+				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.weightedGeometry);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.geometry, 0, 1, &descriptorSets.geometry, 0, nullptr);
+				drawScene(drawCmdBuffers[i]);
+				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
-
-			models.cube.bindBuffers(drawCmdBuffers[i]);
-			objectData.color = glm::vec4(0.0f, 0.0f, 1.0f, 0.5f);
-			for (uint32_t x = 0; x < 2; x++)
+			else
 			{
-				glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f * x - 1.5f, 0.0f, 0.0f));
-				glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f));
-				objectData.model = T * S;
-				vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
-				models.cube.draw(drawCmdBuffers[i]);
+				// The linked list starts empty (head index 0xffffffff), the k-buffer with no fragments per pixel
+				VkClearColorValue clearColor;
+				clearColor.uint32[0] = (method == LinkedList) ? 0xffffffff : 0;
+
+				VkImageSubresourceRange subresRange = {};
+
+				subresRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				subresRange.levelCount = 1;
+				subresRange.layerCount = 1;
+
+				// The previous submission's node count copy has to be done before the counter is cleared
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+				vkCmdClearColorImage(drawCmdBuffers[i], geometryPass.headIndex.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresRange);
+
+				// Clear previous geometry pass data and set the current capacity of the linked list
+				vkCmdFillBuffer(drawCmdBuffers[i], geometryPass.geometry.buffer, offsetof(GeometrySBO, count), sizeof(uint32_t), 0);
+				vkCmdFillBuffer(drawCmdBuffers[i], geometryPass.geometry.buffer, offsetof(GeometrySBO, maxNodeCount), sizeof(uint32_t), geometryPass.maxNodeCount);
+
+				// We need a barrier to make sure all writes are finished before starting to write again
+				memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+				// Begin the geometry render pass
+				renderPassBeginInfo.renderPass = geometryPass.renderPass;
+				renderPassBeginInfo.framebuffer = geometryPass.framebuffer;
+				renderPassBeginInfo.clearValueCount = 0;
+				renderPassBeginInfo.pClearValues = nullptr;
+
+				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, (method == LinkedList) ? pipelines.geometry : pipelines.kBufferGeometry);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.geometry, 0, 1, &descriptorSets.geometry, 0, nullptr);
+				drawScene(drawCmdBuffers[i]);
+				vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+				// Make a pipeline barrier to guarantee the geometry pass is done
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+				// We need a barrier to make sure all writes are finished before starting to write again
+				memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+				vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+				if (method == LinkedList)
+				{
+					// Read back the number of nodes the frame needed, it decides the capacity of the next frames
+					VkBufferCopy copyRegion = {};
+					copyRegion.srcOffset = offsetof(GeometrySBO, count);
+					copyRegion.dstOffset = sizeof(uint32_t) * i;
+					copyRegion.size = sizeof(uint32_t);
+					vkCmdCopyBuffer(drawCmdBuffers[i], geometryPass.geometry.buffer, geometryPass.nodeCounts.buffer, 1, &copyRegion);
+
+					memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+					vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+				}
 			}
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-			// Make a pipeline barrier to guarantee the geometry pass is done
-			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
-
-			// We need a barrier to make sure all writes are finished before starting to write again
-			memoryBarrier = vks::initializers::memoryBarrier();
-			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
-
 			// Begin the color render pass
 			renderPassBeginInfo.renderPass = renderPass;
 			renderPassBeginInfo.framebuffer = frameBuffers[i];
@@ -622,8 +939,21 @@ private:
 			renderPassBeginInfo.pClearValues = clearValues;
 
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.color);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.color, 0, 1, &descriptorSets.color, 0, nullptr);
+			switch (method)
+			{
+			case LinkedList:
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.color);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.color, 0, 1, &descriptorSets.color, 0, nullptr);
+				break;
+			case KBuffer:
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.kBufferColor);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.color, 0, 1, &descriptorSets.color, 0, nullptr);
+				break;
+			case WeightedBlended:
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.weightedColor);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.weightedColor, 0, 1, &descriptorSets.color, 0, nullptr);
+				break;
+			}
 			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 			drawUI(drawCmdBuffers[i]);
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
@@ -639,26 +969,72 @@ private:
 		memcpy(uniformBuffers.renderPass.mapped, &renderPassUBO, sizeof(renderPassUBO));
 	}
 
+	// Fit the linked list to the node count of the command buffer's last submission, which has finished at this point
+	// Fragments are only dropped for the frames that overflowed, until the grown list is used
+	void updateLinkedListCapacity()
+	{
+		const uint32_t nodeCount = static_cast<uint32_t*>(geometryPass.nodeCounts.mapped)[currentBuffer];
+		geometryPass.peakNodeCount = std::max(geometryPass.peakNodeCount, nodeCount);
+		uint32_t maxNodeCount = geometryPass.maxNodeCount;
+		if (nodeCount > geometryPass.maxNodeCount) {
+			// Leave some headroom so a slowly growing fragment count doesn't reallocate every frame
+			maxNodeCount = nodeCount + nodeCount / 2;
+		}
+		else if (++geometryPass.framesSinceShrinkCheck >= NODE_SHRINK_FRAMES) {
+			if (geometryPass.peakNodeCount < geometryPass.maxNodeCount / 4) {
+				maxNodeCount = std::max(geometryPass.peakNodeCount + geometryPass.peakNodeCount / 2, width * height);
+			}
+			geometryPass.peakNodeCount = 0;
+			geometryPass.framesSinceShrinkCheck = 0;
+		}
+		if (maxNodeCount == geometryPass.maxNodeCount) {
+			return;
+		}
+		// Reallocations are rare, so waiting for the GPU is simpler than keeping per frame copies of the list and its descriptor sets
+		vkDeviceWaitIdle(device);
+		geometryPass.maxNodeCount = maxNodeCount;
+		recreateGeometryPass();
+		buildCommandBuffers();
+	}
+
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
+		if (method == LinkedList) {
+			updateLinkedListCapacity();
+		}
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
 		VulkanExampleBase::submitFrame();
 	}
 
+	void destroyAttachment(FrameBufferAttachment *attachment)
+	{
+		vkDestroyImageView(device, attachment->view, nullptr);
+		vkDestroyImage(device, attachment->image, nullptr);
+		vkFreeMemory(device, attachment->memory, nullptr);
+		*attachment = FrameBufferAttachment();
+	}
+
+	// Destroys the size and method dependent resources, the render passes are kept
 	void destroyGeometryPass()
 	{
-		vkDestroyRenderPass(device, geometryPass.renderPass, nullptr);
 		vkDestroyFramebuffer(device, geometryPass.framebuffer, nullptr);
-		geometryPass.geometry.destroy();
-		geometryPass.headIndex.destroy();
+		geometryPass.framebuffer = VK_NULL_HANDLE;
+		if (geometryPass.headIndex.image != VK_NULL_HANDLE) {
+			geometryPass.headIndex.destroy();
+			geometryPass.headIndex = vks::Texture();
+		}
 		geometryPass.linkedList.destroy();
+		geometryPass.linkedList = vks::Buffer();
+		geometryPass.kBuffer.destroy();
+		geometryPass.kBuffer = vks::Buffer();
+		vkDestroyFramebuffer(device, weightedPass.framebuffer, nullptr);
+		weightedPass.framebuffer = VK_NULL_HANDLE;
+		destroyAttachment(&weightedPass.accumulation);
+		destroyAttachment(&weightedPass.revealage);
 	}
-
-private:
-	VkDeviceSize objectUniformBufferSize;
 };
 
 VULKAN_EXAMPLE_MAIN()
@@ -8,6 +8,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanDepthPyramid.h"
 
 #define ENABLE_VALIDATION false
 
@@ -20,6 +21,12 @@ public:
 		vks::Texture2D normalHeightMap;
 	} textures;
 
+	// Maximum and minimum heights of the height map (alpha channel) per texel of each mip level, built with the depth pyramid reduction
+	std::unique_ptr<vks::DepthPyramid> heightPyramid;
+	// Level 0 view of the height map with the alpha channel swizzled into red, the channel read by the reduction
+	VkImageView heightView = VK_NULL_HANDLE;
+	bool showFetches = false;
+
 	vkglTF::Model plane;
 
 	struct {
@@ -45,6 +52,10 @@ public:
 			float numLayers = 48.0f;
 			// (Parallax) mapping mode to use
 			int32_t mappingMode = 4;
+			// Layer count of the adaptive mode for views along the surface normal, numLayers is used for grazing views
+			float minLayers = 8.0f;
+			int32_t pyramidLevels = 0;
+			int32_t showFetches = 0;
 		} fragmentShader;
 
 	} ubos;
@@ -60,6 +71,8 @@ public:
 		"Parallax mapping",
 		"Steep parallax mapping",
 		"Parallax occlusion mapping",
+		"Adaptive parallax occlusion mapping",
+		"Hierarchical relief mapping",
 	};
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
@@ -82,6 +95,8 @@ public:
 		uniformBuffers.vertexShader.destroy();
 		uniformBuffers.fragmentShader.destroy();
 
+		heightPyramid.reset();
+		vkDestroyImageView(device, heightView, nullptr);
 		textures.colorMap.destroy();
 		textures.normalHeightMap.destroy();
 	}
@@ -94,6 +109,29 @@ public:
 		textures.colorMap.loadFromFile(getAssetPath() + "textures/rocks_color_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 	}
 
+	// Reduce the height map into a pyramid of per texel height bounds for the hierarchical relief mapping mode
+	void prepareHeightPyramid()
+	{
+		heightPyramid.reset(new vks::DepthPyramid(vulkanDevice, getShadersPath() + "base/depthpyramid.comp.spv"));
+		if (!heightPyramid->isSupported()) {
+			vks::tools::exitFatal("Height pyramid format is not supported as a storage image!", VK_ERROR_FORMAT_NOT_SUPPORTED);
+		}
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = VK_FORMAT_R8G8B8A8_UNORM;
+		viewCI.components = { VK_COMPONENT_SWIZZLE_A, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_R };
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		viewCI.image = textures.normalHeightMap.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &heightView));
+
+		heightPyramid->create(textures.normalHeightMap.width, textures.normalHeightMap.height, heightView, textures.normalHeightMap.imageLayout);
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		heightPyramid->record(commandBuffer);
+		vulkanDevice->flushCommandBuffer(commandBuffer, queue);
+		ubos.fragmentShader.pyramidLevels = static_cast<int32_t>(heightPyramid->getLevelCount());
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -140,11 +178,11 @@ public:
 
 	void setupDescriptorPool()
 	{
-		// Example uses two ubos and two image sampler
+		// Example uses two ubos and three image samplers
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -160,6 +198,7 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),	// Binding 1: Fragment shader color map image sampler
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),	// Binding 2: Fragment combined normal and heightmap
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),			// Binding 3: Fragment shader uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),	// Binding 4: Fragment shader height pyramid
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
@@ -173,11 +212,13 @@ public:
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
 
+		VkDescriptorImageInfo heightPyramidDescriptor = heightPyramid->getDescriptor();
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.vertexShader.descriptor),		// Binding 0: Vertex shader uniform buffer
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.colorMap.descriptor),			// Binding 1: Fragment shader image sampler
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.normalHeightMap.descriptor),	// Binding 2: Combined normal and heightmap
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.fragmentShader.descriptor),		// Binding 3: Fragment shader uniform buffer
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &heightPyramidDescriptor),				// Binding 4: Height pyramid
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 	}
@@ -252,6 +293,7 @@ public:
 		memcpy(uniformBuffers.vertexShader.mapped, &ubos.vertexShader, sizeof(ubos.vertexShader));
 
 		// Fragment shader
+		ubos.fragmentShader.showFetches = showFetches ? 1 : 0;
 		memcpy(uniformBuffers.fragmentShader.mapped, &ubos.fragmentShader, sizeof(ubos.fragmentShader));
 	}
 
@@ -260,7 +302,7 @@ public:
 		VulkanExampleBase::prepareFrame();
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -268,6 +310,7 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		prepareHeightPyramid();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -294,6 +337,14 @@ public:
 			if (overlay->comboBox("Mode", &ubos.fragmentShader.mappingMode, mappingModes)) {
 				updateUniformBuffers();
 			}
+			if (ubos.fragmentShader.mappingMode == 5) {
+				if (overlay->sliderFloat("Min. layers", &ubos.fragmentShader.minLayers, 1.0f, ubos.fragmentShader.numLayers)) {
+					updateUniformBuffers();
+				}
+			}
+			if (overlay->checkBox("Show height fetches", &showFetches)) {
+				updateUniformBuffers();
+			}
 		}
 	}
 
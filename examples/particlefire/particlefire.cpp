@@ -1,5 +1,9 @@
 /*
-* Vulkan Example - CPU based fire particle system
+* Vulkan Example - Fire particle system simulated in compute shaders
+*
+* Particles are spawned from a free list of dead particle slots and simulated in compute shaders, the alive ones are drawn with an indirect
+* draw whose index count the simulation writes, so the CPU only updates a few uniforms per frame
+* The premultiplied alpha particles are depth sorted on the GPU every frame (vks::RadixSort) and drawn back to front through an index buffer
 *
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
@@ -8,16 +12,20 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanRadixSort.h"
 
 #define ENABLE_VALIDATION false
-#define PARTICLE_COUNT 512
+// Size of the particle pool, the emission rate decides how many of them are alive
+#define MAX_PARTICLE_COUNT (64 * 1024)
+// Upper bound of the particles spawned in a single frame, size of the emit dispatch
+#define MAX_EMIT_COUNT (4 * 1024)
 #define PARTICLE_SIZE 10.0f
 
 #define FLAME_RADIUS 8.0f
+// View distance mapped to the full range of the 16 bit sort keys
+#define SORT_MAX_DISTANCE 256.0f
 
-#define PARTICLE_TYPE_FLAME 0
-#define PARTICLE_TYPE_SMOKE 1
-
+// Matches the particle struct of the compute shaders (std430)
 struct Particle {
 	glm::vec4 pos;
 	glm::vec4 color;
@@ -25,9 +33,11 @@ struct Particle {
 	float size;
 	float rotation;
 	uint32_t type;
-	// Attributes not used in shader
+	// Attributes not used in the vertex shader
 	glm::vec4 vel;
 	float rotationSpeed;
+	uint32_t alive;
+	uint32_t padding[2];
 };
 
 class VulkanExample : public VulkanExampleBase
@@ -52,14 +62,50 @@ public:
 	glm::vec3 minVel = glm::vec3(-3.0f, 0.5f, -3.0f);
 	glm::vec3 maxVel = glm::vec3(3.0f, 7.0f, 3.0f);
 
+	// Particles spawned per second
+	float emissionRate = 2000.0f;
+	float emitRemainder = 0.0f;
+
+	// Particle simulation
+	struct {
+		// Particle pool, also the vertex buffer
+		vks::Buffer particles;
+		// Stack of the dead particles' indices
+		vks::Buffer deadList;
+		// Indices of the alive particles in simulation order, the unsorted index buffer
+		vks::Buffer aliveList;
+		// Indexed indirect draw arguments, the index count being the alive count, followed by the dead list size
+		vks::Buffer counters;
+		vks::Buffer uniformBuffer;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline emit;
+		VkPipeline simulate;
+		struct UniformData {
+			glm::vec4 emitterPos;
+			glm::vec4 minVel;
+			glm::vec4 maxVel;
+			float deltaT;
+			uint32_t emitCount;
+			uint32_t seed;
+			float flameRadius = FLAME_RADIUS;
+			uint32_t maxParticleCount = MAX_PARTICLE_COUNT;
+		} uniformData;
+	} compute;
+
+	// GPU depth sort of the particles
 	struct {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-		// Store the mapped address of the particle data for reuse
-		void *mappedMemory;
-		// Size of the particle buffer in bytes
-		size_t size;
-	} particles;
+		vks::Buffer keys;
+		// Sorted particle indices, also used as the index buffer
+		vks::Buffer indices;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} depthSort;
+	std::unique_ptr<vks::RadixSort> radixSort;
+	bool sortParticles = true;
 
 	struct {
 		vks::Buffer fire;
@@ -93,19 +139,20 @@ public:
 		VkDescriptorSet environment;
 	} descriptorSets;
 
-	std::vector<Particle> particleBuffer;
-
+	// Seeds of the shaders' random numbers
 	std::default_random_engine rndEngine;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
-		title = "CPU based particle system";
+		title = "Compute shader fire particle system";
 		camera.type = Camera::CameraType::lookat;
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -75.0f));
 		camera.setRotation(glm::vec3(-15.0f, 45.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 1.0f, 256.0f);
 		timerSpeed *= 8.0f;
 		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
+		// The radix sort uses subgroup operations
+		apiVersion = VK_API_VERSION_1_1;
 	}
 
 	~VulkanExample()
@@ -124,13 +171,26 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		vkUnmapMemory(device, particles.memory);
-		vkDestroyBuffer(device, particles.buffer, nullptr);
-		vkFreeMemory(device, particles.memory, nullptr);
+		compute.particles.destroy();
+		compute.deadList.destroy();
+		compute.aliveList.destroy();
+		compute.counters.destroy();
+		compute.uniformBuffer.destroy();
+		vkDestroyPipeline(device, compute.emit, nullptr);
+		vkDestroyPipeline(device, compute.simulate, nullptr);
+		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 
 		uniformBuffers.environment.destroy();
 		uniformBuffers.fire.destroy();
 
+		depthSort.keys.destroy();
+		depthSort.indices.destroy();
+		vkDestroyPipeline(device, depthSort.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, depthSort.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, depthSort.descriptorSetLayout, nullptr);
+		radixSort.reset();
+
 		vkDestroySampler(device, textures.particles.sampler, nullptr);
 	}
 
@@ -166,6 +226,9 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			const bool sorted = sortParticles && radixSort->isSupported();
+			recordSimulation(drawCmdBuffers[i], sorted);
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -181,11 +244,12 @@ public:
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.environment);
 			environment.draw(drawCmdBuffers[i]);
 
-			// Particle system (no index buffer)
+			// Particle system, the alive particles back to front through the sorted indices if available
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.particles, 0, nullptr);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.particles);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &particles.buffer, offsets);
-			vkCmdDraw(drawCmdBuffers[i], PARTICLE_COUNT, 1, 0, 0);
+			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &compute.particles.buffer, offsets);
+			vkCmdBindIndexBuffer(drawCmdBuffers[i], sorted ? depthSort.indices.buffer : compute.aliveList.buffer, 0, VK_INDEX_TYPE_UINT32);
+			vkCmdDrawIndexedIndirect(drawCmdBuffers[i], compute.counters.buffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -195,114 +259,87 @@ public:
 		}
 	}
 
-	float rnd(float range)
-	{
-		std::uniform_real_distribution<float> rndDist(0.0f, range);
-		return rndDist(rndEngine);
-	}
-
-	void initParticle(Particle *particle, glm::vec3 emitterPos)
-	{
-		particle->vel = glm::vec4(0.0f, minVel.y + rnd(maxVel.y - minVel.y), 0.0f, 0.0f);
-		particle->alpha = rnd(0.75f);
-		particle->size = 1.0f + rnd(0.5f);
-		particle->color = glm::vec4(1.0f);
-		particle->type = PARTICLE_TYPE_FLAME;
-		particle->rotation = rnd(2.0f * float(M_PI));
-		particle->rotationSpeed = rnd(2.0f) - rnd(2.0f);
-
-		// Get random sphere point
-		float theta = rnd(2.0f * float(M_PI));
-		float phi = rnd(float(M_PI)) - float(M_PI) / 2.0f;
-		float r = rnd(FLAME_RADIUS);
-
-		particle->pos.x = r * cos(theta) * cos(phi);
-		particle->pos.y = r * sin(phi);
-		particle->pos.z = r * sin(theta) * cos(phi);
-
-		particle->pos += glm::vec4(emitterPos, 0.0f);
-	}
-
-	void transitionParticle(Particle *particle)
-	{
-		switch (particle->type)
-		{
-		case PARTICLE_TYPE_FLAME:
-			// Flame particles have a chance of turning into smoke
-			if (rnd(1.0f) < 0.05f)
-			{
-				particle->alpha = 0.0f;
-				particle->color = glm::vec4(0.25f + rnd(0.25f));
-				particle->pos.x *= 0.5f;
-				particle->pos.z *= 0.5f;
-				particle->vel = glm::vec4(rnd(1.0f) - rnd(1.0f), (minVel.y * 2) + rnd(maxVel.y - minVel.y), rnd(1.0f) - rnd(1.0f), 0.0f);
-				particle->size = 1.0f + rnd(0.5f);
-				particle->rotationSpeed = rnd(1.0f) - rnd(1.0f);
-				particle->type = PARTICLE_TYPE_SMOKE;
-			}
-			else
-			{
-				initParticle(particle, emitterPos);
-			}
-			break;
-		case PARTICLE_TYPE_SMOKE:
-			// Respawn at end of life
-			initParticle(particle, emitterPos);
-			break;
-		}
-	}
-
-	void prepareParticles()
+	// Emission -> simulation -> optional depth sort, leaving the particles, indices and draw arguments ready for the indirect draw
+	void recordSimulation(VkCommandBuffer commandBuffer, bool sorted)
 	{
-		particleBuffer.resize(PARTICLE_COUNT);
-		for (auto& particle : particleBuffer)
-		{
-			initParticle(&particle, emitterPos);
-			particle.alpha = 1.0f - (abs(particle.pos.y) / (FLAME_RADIUS * 2.0f));
+		// The previous frame's particle draw may still be reading the buffers
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+		// The simulation counts the alive particles again
+		vkCmdFillBuffer(commandBuffer, compute.counters.buffer, 0, sizeof(uint32_t), 0);
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, nullptr);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.emit);
+		vkCmdDispatch(commandBuffer, MAX_EMIT_COUNT / 256, 1, 1);
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.simulate);
+		vkCmdDispatch(commandBuffer, MAX_PARTICLE_COUNT / 256, 1, 1);
+
+		if (sorted) {
+			// Keys of the whole pool, the dead particles are sorted behind the alive ones
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			struct {
+				uint32_t count = MAX_PARTICLE_COUNT;
+				float maxDistance = SORT_MAX_DISTANCE;
+			} pushConstants;
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthSort.pipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthSort.pipelineLayout, 0, 1, &depthSort.descriptorSet, 0, nullptr);
+			vkCmdPushConstants(commandBuffer, depthSort.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+			vkCmdDispatch(commandBuffer, MAX_PARTICLE_COUNT / 256, 1, 1);
+			radixSort->record(commandBuffer, MAX_PARTICLE_COUNT, 16, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
 		}
 
-		particles.size = particleBuffer.size() * sizeof(Particle);
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			particles.size,
-			&particles.buffer,
-			&particles.memory,
-			particleBuffer.data()));
-
-		// Map the memory and store the pointer for reuse
-		VK_CHECK_RESULT(vkMapMemory(device, particles.memory, 0, particles.size, 0, &particles.mappedMemory));
+		// Particles, indices and the index count written by the simulation
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 	}
 
-	void updateParticles()
+	// Setup the particle pool with all particles dead and the buffers of the simulation and the depth sort
+	void prepareParticles()
 	{
-		float particleTimer = frameTimer * 0.45f;
-		for (auto& particle : particleBuffer)
-		{
-			switch (particle.type)
-			{
-			case PARTICLE_TYPE_FLAME:
-				particle.pos.y -= particle.vel.y * particleTimer * 3.5f;
-				particle.alpha += particleTimer * 2.5f;
-				particle.size -= particleTimer * 0.5f;
-				break;
-			case PARTICLE_TYPE_SMOKE:
-				particle.pos -= particle.vel * frameTimer * 1.0f;
-				particle.alpha += particleTimer * 1.25f;
-				particle.size += particleTimer * 0.125f;
-				particle.color -= particleTimer * 0.05f;
-				break;
-			}
-			particle.rotation += particleTimer * particle.rotationSpeed;
-			// Transition particle state
-			if (particle.alpha > 2.0f)
-			{
-				transitionParticle(&particle);
-			}
+		const VkDeviceSize indexBufferSize = sizeof(uint32_t) * MAX_PARTICLE_COUNT;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &compute.particles, sizeof(Particle) * MAX_PARTICLE_COUNT));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &compute.deadList, indexBufferSize));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &compute.aliveList, indexBufferSize));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &compute.counters, sizeof(VkDrawIndexedIndirectCommand) + sizeof(uint32_t)));
+
+		// Every slot starts on the dead list
+		std::vector<uint32_t> deadList(MAX_PARTICLE_COUNT);
+		for (uint32_t i = 0; i < MAX_PARTICLE_COUNT; i++) {
+			deadList[i] = i;
 		}
-		size_t size = particleBuffer.size() * sizeof(Particle);
-		memcpy(particles.mappedMemory, particleBuffer.data(), size);
+		struct {
+			VkDrawIndexedIndirectCommand drawCommand = { 0, 1, 0, 0, 0 };
+			uint32_t deadCount = MAX_PARTICLE_COUNT;
+		} counters;
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, indexBufferSize + sizeof(counters)));
+		VK_CHECK_RESULT(stagingBuffer.map());
+		memcpy(stagingBuffer.mapped, deadList.data(), indexBufferSize);
+		memcpy((char*)stagingBuffer.mapped + indexBufferSize, &counters, sizeof(counters));
+
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		// Zero also clears the alive flags
+		vkCmdFillBuffer(copyCmd, compute.particles.buffer, 0, VK_WHOLE_SIZE, 0);
+		VkBufferCopy copyRegion = { 0, 0, indexBufferSize };
+		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.deadList.buffer, 1, &copyRegion);
+		copyRegion = { indexBufferSize, 0, sizeof(counters) };
+		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.counters.buffer, 1, &copyRegion);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		stagingBuffer.destroy();
+
+		// Sort keys and indices, written back by the radix sort if it ends with an odd number of passes
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthSort.keys, indexBufferSize));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthSort.indices, indexBufferSize));
+		radixSort.reset(new vks::RadixSort(vulkanDevice, getShadersPath() + "base/radixsort_histogram.comp.spv", getShadersPath() + "base/radixsort_scan.comp.spv", getShadersPath() + "base/radixsort_scatter.comp.spv", apiVersion));
+		radixSort->setBuffers(depthSort.keys.buffer, depthSort.indices.buffer, MAX_PARTICLE_COUNT);
 	}
 
 	void loadAssets()
@@ -349,10 +386,11 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7)
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 4);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -372,6 +410,45 @@ public:
 
 		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		// Emission and simulation
+		setLayoutBindings = {
+			// Binding 0 : Particles
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Simulation uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Dead list
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3 : Alive list
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			// Binding 4 : Counters
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &compute.descriptorSetLayout));
+		pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&compute.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &compute.pipelineLayout));
+
+		// Depth sort keys
+		setLayoutBindings = {
+			// Binding 0 : Particles
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Particle uniform buffer with the view matrix
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Sort keys
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3 : Particle indices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &depthSort.descriptorSetLayout));
+
+		// Particle count and maximum distance
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t) * 2, 0);
+		pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&depthSort.descriptorSetLayout, 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &depthSort.pipelineLayout));
 	}
 
 	void setupDescriptorSets()
@@ -416,6 +493,40 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSets.environment, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.floor.normalMap.descriptor),
 		};
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+
+		// Emission and simulation
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &compute.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSet));
+
+		writeDescriptorSets = {
+			// Binding 0: Particles
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.particles.descriptor),
+			// Binding 1: Simulation uniform buffer
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &compute.uniformBuffer.descriptor),
+			// Binding 2: Dead list
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &compute.deadList.descriptor),
+			// Binding 3: Alive list
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &compute.aliveList.descriptor),
+			// Binding 4: Counters
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &compute.counters.descriptor),
+		};
+		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+
+		// Depth sort
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &depthSort.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &depthSort.descriptorSet));
+
+		writeDescriptorSets = {
+			// Binding 0: Particles
+			vks::initializers::writeDescriptorSet(depthSort.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &compute.particles.descriptor),
+			// Binding 1: Particle uniform buffer
+			vks::initializers::writeDescriptorSet(depthSort.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &uniformBuffers.fire.descriptor),
+			// Binding 2: Sort keys
+			vks::initializers::writeDescriptorSet(depthSort.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &depthSort.keys.descriptor),
+			// Binding 3: Particle indices
+			vks::initializers::writeDescriptorSet(depthSort.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &depthSort.indices.descriptor),
+		};
+		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 	}
 
 	void preparePipelines()
@@ -496,6 +607,18 @@ public:
 			shaderStages[1] = loadShader(getShadersPath() + "particlefire/normalmap.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.environment));
 		}
+
+		// Emission and simulation
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "particlefire/emit.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &compute.emit));
+		computePipelineCI.stage = loadShader(getShadersPath() + "particlefire/simulate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &compute.simulate));
+
+		// Depth sort keys
+		computePipelineCI.layout = depthSort.pipelineLayout;
+		computePipelineCI.stage = loadShader(getShadersPath() + "particlefire/depthkeys.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &depthSort.pipeline));
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -515,9 +638,22 @@ public:
 			&uniformBuffers.environment,
 			sizeof(uboEnv)));
 
+		// Compute shader uniform buffer block
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&compute.uniformBuffer,
+			sizeof(compute.uniformData)));
+
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.fire.map());
 		VK_CHECK_RESULT(uniformBuffers.environment.map());
+		VK_CHECK_RESULT(compute.uniformBuffer.map());
+
+		compute.uniformData.emitterPos = glm::vec4(emitterPos, 0.0f);
+		compute.uniformData.minVel = glm::vec4(minVel, 0.0f);
+		compute.uniformData.maxVel = glm::vec4(maxVel, 0.0f);
+		updateComputeUniformBuffer();
 
 		updateUniformBuffers();
 	}
@@ -531,6 +667,20 @@ public:
 		memcpy(uniformBuffers.environment.mapped, &uboEnv, sizeof(uboEnv));
 	}
 
+	// Time step and number of particles to spawn in this frame
+	void updateComputeUniformBuffer()
+	{
+		compute.uniformData.deltaT = paused ? 0.0f : frameTimer;
+		compute.uniformData.emitCount = 0;
+		if (!paused) {
+			emitRemainder += emissionRate * frameTimer;
+			compute.uniformData.emitCount = std::min(static_cast<uint32_t>(emitRemainder), (uint32_t)MAX_EMIT_COUNT);
+			emitRemainder = std::min(emitRemainder - static_cast<float>(compute.uniformData.emitCount), 1.0f);
+		}
+		compute.uniformData.seed = static_cast<uint32_t>(rndEngine());
+		memcpy(compute.uniformBuffer.mapped, &compute.uniformData, sizeof(compute.uniformData));
+	}
+
 	void updateUniformBuffers()
 	{
 		// Particle system fire
@@ -555,7 +705,7 @@ public:
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -578,11 +728,11 @@ public:
 	{
 		if (!prepared)
 			return;
+		updateComputeUniformBuffer();
 		draw();
 		if (!paused)
 		{
 			updateUniformBufferLight();
-			updateParticles();
 		}
 		if (camera.updated)
 		{
@@ -594,6 +744,22 @@ public:
 	{
 		updateUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			overlay->sliderFloat("Emission rate", &emissionRate, 0.0f, 40000.0f);
+			overlay->text("Pool: %d particles", MAX_PARTICLE_COUNT);
+			if (radixSort->isSupported()) {
+				if (overlay->checkBox("Depth sort", &sortParticles)) {
+					buildCommandBuffers();
+				}
+			}
+			else {
+				overlay->text("Depth sort not supported");
+			}
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
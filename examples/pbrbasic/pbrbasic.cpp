@@ -10,6 +10,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanglTFResidency.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -37,9 +38,14 @@ struct Material {
 class VulkanExample : public VulkanExampleBase
 {
 public:
+	// The objects are streamed in when they're selected, the least recently selected ones are evicted once they exceed the budget
 	struct Meshes {
-		std::vector<vkglTF::Model> objects;
+		std::unique_ptr<vkglTF::ModelResidency> residency;
+		std::vector<uint32_t> handles;
 		int32_t objectIndex = 0;
+		// Object drawn by the command buffers, nullptr while the selected object is being loaded
+		vkglTF::Model *current = nullptr;
+		int32_t budgetMB = 16;
 	} models;
 
 	struct {
@@ -163,7 +169,9 @@ public:
 				mat.params.roughness = glm::clamp((float)x / (float)objcount, 0.005f, 1.0f);
 				vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec3), &pos);
 				vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::vec3), sizeof(Material::PushBlock), &mat);
-				models.objects[models.objectIndex].draw(drawCmdBuffers[i]);
+				if (models.current) {
+					models.current->draw(drawCmdBuffers[i]);
+				}
 			}
 #else
 			for (uint32_t y = 0; y < GRID_DIM; y++) {
@@ -173,7 +181,9 @@ public:
 					mat.params.metallic = glm::clamp((float)x / (float)(GRID_DIM - 1), 0.1f, 1.0f);
 					mat.params.roughness = glm::clamp((float)y / (float)(GRID_DIM - 1), 0.05f, 1.0f);
 					vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(glm::vec3), sizeof(Material::PushBlock), &mat);
-					models.objects[models.objectIndex].draw(drawCmdBuffers[i]);
+					if (models.current) {
+						models.current->draw(drawCmdBuffers[i]);
+					}
 				}
 			}
 #endif
@@ -188,9 +198,13 @@ public:
 	void loadAssets()
 	{
 		std::vector<std::string> filenames = { "sphere.gltf", "teapot.gltf", "torusknot.gltf", "venus.gltf" };
-		models.objects.resize(filenames.size());
-		for (size_t i = 0; i < filenames.size(); i++) {			
-			models.objects[i].loadFromFile(getAssetPath() + "models/" + filenames[i], vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::FlipY);
+		models.residency.reset(new vkglTF::ModelResidency(vulkanDevice, queue, static_cast<VkDeviceSize>(models.budgetMB) * 1024 * 1024));
+		// Textures of the streamed models are compacted with --defragment
+		if (memoryDefragmenter) {
+			models.residency->setDefragmenter(memoryDefragmenter.get());
+		}
+		for (size_t i = 0; i < filenames.size(); i++) {
+			models.handles.push_back(models.residency->add(getAssetPath() + "models/" + filenames[i], vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::FlipY));
 		}
 	}
 
@@ -274,11 +288,14 @@ public:
 
 		// PBR pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "pbrbasic/pbr.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "pbrbasic/pbr.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		// The lighting is evaluated in half precision with --halfprecision
+		shaderStages[1] = loadShader(getShaderVariant(getShadersPath() + "pbrbasic/pbr.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT);
 		// Enable depth test and write
 		depthStencilState.depthWriteEnable = VK_TRUE;
 		depthStencilState.depthTestEnable = VK_TRUE;
+		pipelineCI.flags = getShaderStatisticsPipelineFlags();
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		reportShaderStatistics(pipeline, VK_SHADER_STAGE_FRAGMENT_BIT, "pbr");
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -341,7 +358,7 @@ public:
 
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -358,10 +375,26 @@ public:
 		prepared = true;
 	}
 
+	// Stream the selected object in at the frame boundary and switch the command buffers to it once it's resident
+	void updateResidency()
+	{
+		const uint32_t handle = models.handles[models.objectIndex];
+		models.residency->acquire(handle);
+		models.residency->update();
+		vkglTF::Model *model = models.residency->getModel(handle);
+		if (model != models.current) {
+			models.current = model;
+			// The previous object may have been evicted, but its destruction is deferred until the frames in flight that draw it have finished
+			waitForFramesInFlight();
+			buildCommandBuffers();
+		}
+	}
+
 	virtual void render()
 	{
 		if (!prepared)
 			return;
+		updateResidency();
 		draw();
 		if (!paused)
 			updateLights();
@@ -380,7 +413,21 @@ public:
 			}
 			if (overlay->comboBox("Object type", &models.objectIndex, objectNames)) {
 				updateUniformBuffers();
-				buildCommandBuffers();
+			}
+		}
+		if (overlay->header("Streaming")) {
+			if (overlay->sliderInt("Budget (MB)", &models.budgetMB, 1, 64)) {
+				models.residency->setBudget(static_cast<VkDeviceSize>(models.budgetMB) * 1024 * 1024);
+			}
+			const vkglTF::ModelResidency::Statistics &statistics = models.residency->getStatistics();
+			overlay->text("Resident: %u objects, %.2f MB", statistics.residentModels, (float)statistics.residentBytes / (1024.0f * 1024.0f));
+			overlay->text("Loads: %u, evictions: %u", statistics.loads, statistics.evictions);
+			if (memoryDefragmenter) {
+				const vks::MemoryDefragmenter::Statistics &defragmenterStatistics = memoryDefragmenter->getStatistics();
+				overlay->text("Defragmenter: %u moves, %u blocks released", (uint32_t)defragmenterStatistics.moves, defragmenterStatistics.blocksReleased);
+			}
+			if (!models.current) {
+				overlay->text("Loading...");
 			}
 		}
 	}
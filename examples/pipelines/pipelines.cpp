@@ -8,6 +8,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanPipelineBatch.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -263,20 +264,35 @@ public:
 		// As we use the handle, we must set the index to -1 (see section 9.5 of the specification)
 		pipelineCI.basePipelineIndex = -1;
 
+		// The derivatives need the base pipeline's handle, so only they are compiled in parallel
+		// Each of them needs its own copy of the state that differs, as the batch keeps the create infos until it's built
+		vks::PipelineBatch pipelineBatch(device, pipelineCache, getThreadPool());
+
 		// Toon shading pipeline
-		shaderStages[0] = loadShader(getShadersPath() + "pipelines/toon.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "pipelines/toon.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.toon));
+		std::array<VkPipelineShaderStageCreateInfo, 2> toonShaderStages = {
+			loadShader(getShadersPath() + "pipelines/toon.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+			loadShader(getShadersPath() + "pipelines/toon.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+		};
+		VkGraphicsPipelineCreateInfo toonPipelineCI = pipelineCI;
+		toonPipelineCI.pStages = toonShaderStages.data();
+		pipelineBatch.add(toonPipelineCI, &pipelines.toon);
 
 		// Pipeline for wire frame rendering
 		// Non solid rendering is not a mandatory Vulkan feature
+		VkPipelineRasterizationStateCreateInfo wireframeRasterizationState = rasterizationState;
+		std::array<VkPipelineShaderStageCreateInfo, 2> wireframeShaderStages;
+		VkGraphicsPipelineCreateInfo wireframePipelineCI = pipelineCI;
 		if (enabledFeatures.fillModeNonSolid)
 		{
-			rasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
-			shaderStages[0] = loadShader(getShadersPath() + "pipelines/wireframe.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-			shaderStages[1] = loadShader(getShadersPath() + "pipelines/wireframe.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
+			wireframeRasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
+			wireframeShaderStages[0] = loadShader(getShadersPath() + "pipelines/wireframe.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			wireframeShaderStages[1] = loadShader(getShadersPath() + "pipelines/wireframe.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			wireframePipelineCI.pRasterizationState = &wireframeRasterizationState;
+			wireframePipelineCI.pStages = wireframeShaderStages.data();
+			pipelineBatch.add(wireframePipelineCI, &pipelines.wireframe);
 		}
+
+		pipelineBatch.build();
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -308,7 +324,7 @@ public:
 
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
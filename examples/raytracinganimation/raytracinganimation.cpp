@@ -0,0 +1,707 @@
+/*
+* Vulkan Example - Hardware accelerated ray tracing of animated geometry
+*
+* Ray traces several instances of a skinned glTF model walking over a floor. The model is skinned in a compute shader every frame and its
+* bottom level acceleration structure is refit to the skinned vertices instead of being rebuilt, with a full rebuild after a number of refits
+* to keep the tracing performance from degrading. The top level acceleration structure is rebuilt every frame from a persistently mapped
+* instance buffer.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanRaytracingSample.h"
+#include "VulkanglTFModel.h"
+#include "VulkanglTFSkinning.h"
+
+// Upper bound for the character count selectable in the UI, the top level acceleration structure is sized for it
+#define MAX_CHARACTER_COUNT 16
+
+class VulkanExample : public VulkanRaytracingSample
+{
+public:
+	// One bottom level acceleration structure per mesh node of the model
+	struct MeshAccelerationStructure {
+		vkglTF::Node* node;
+		DynamicBottomLevelAccelerationStructure bottomLevelAS;
+		// First index of the node's triangles, passed to the closest hit shader as the instance custom index
+		uint32_t firstIndex;
+		bool skinned;
+	};
+	std::vector<MeshAccelerationStructure> meshAccelerationStructures;
+
+	AccelerationStructure floorBottomLevelAS{};
+	DynamicTopLevelAccelerationStructure topLevelAS{};
+
+	std::vector<VkRayTracingShaderGroupCreateInfoKHR> shaderGroups{};
+	struct ShaderBindingTables {
+		ShaderBindingTable raygen;
+		ShaderBindingTable miss;
+		ShaderBindingTable hit;
+	} shaderBindingTables;
+
+	struct UniformData {
+		glm::mat4 viewInverse;
+		glm::mat4 projInverse;
+		glm::vec4 lightPos;
+		int32_t vertexSize;
+	} uniformData;
+	vks::Buffer ubo;
+
+	VkPipeline pipeline;
+	VkPipelineLayout pipelineLayout;
+	VkDescriptorSet descriptorSet;
+	VkDescriptorSetLayout descriptorSetLayout;
+
+	vkglTF::Model model;
+	vkglTF::ComputeSkinning* skinning = nullptr;
+	struct Floor {
+		vks::Buffer vertices;
+		vks::Buffer indices;
+	} floorGeometry;
+
+	// Skinning, refits and the top level build are recorded into this command buffer every frame
+	VkCommandBuffer accelerationStructureCmdBuffer = VK_NULL_HANDLE;
+
+	int32_t characterCount = 8;
+	int32_t rebuildInterval = 60;
+	float animationTime = 0.0f;
+	bool animate = true;
+	// Set when the pose changed since the skinned vertices were last written
+	bool poseChanged = true;
+
+	// This sample is derived from an extended base class that saves most of the ray tracing setup boiler plate
+	VulkanExample() : VulkanRaytracingSample()
+	{
+		title = "Ray tracing animated geometry";
+		timerSpeed *= 0.25f;
+		camera.type = Camera::CameraType::lookat;
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 512.0f);
+		camera.setRotation(glm::vec3(-25.0f, 0.0f, 0.0f));
+		camera.setTranslation(glm::vec3(0.0f, 0.0f, -12.0f));
+		enableExtensions();
+	}
+
+	~VulkanExample()
+	{
+		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		deleteStorageImage();
+		for (MeshAccelerationStructure& meshAccelerationStructure : meshAccelerationStructures) {
+			deleteDynamicBottomLevelAccelerationStructure(meshAccelerationStructure.bottomLevelAS);
+		}
+		deleteAccelerationStructure(floorBottomLevelAS);
+		deleteDynamicTopLevelAccelerationStructure(topLevelAS);
+		shaderBindingTables.raygen.destroy();
+		shaderBindingTables.miss.destroy();
+		shaderBindingTables.hit.destroy();
+		ubo.destroy();
+		floorGeometry.vertices.destroy();
+		floorGeometry.indices.destroy();
+		delete skinning;
+		vkFreeCommandBuffers(device, cmdPool, 1, &accelerationStructureCmdBuffer);
+	}
+
+	void loadAssets()
+	{
+		// The closest hit shader reads the skinned vertices and the indices, the acceleration structures are built from them
+		// The skinning pass copies the model's vertices into its output buffer, which needs transfer source usage
+		vkglTF::memoryPropertyFlags = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		// Vertices can't be pre-transformed, the skinning pass works in the space of each mesh's node
+		model.loadFromFile(getAssetPath() + "models/CesiumMan/glTF/CesiumMan.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::CompactAnimations);
+		skinning = new vkglTF::ComputeSkinning(vulkanDevice, model, getShadersPath() + "base/skinning.comp.spv", 1, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+		if (!skinning->isSupported()) {
+			std::cout << "Compute skinning is not available for this model, the model is ray traced in its bind pose\n";
+		}
+	}
+
+	/*
+		Create the bottom level acceleration structures for the model's meshes, these are refit every frame the pose changes
+	*/
+	void createMeshAccelerationStructures()
+	{
+		VkDeviceOrHostAddressConstKHR vertexBufferDeviceAddress{};
+		VkDeviceOrHostAddressConstKHR indexBufferDeviceAddress{};
+		// Outputs of the skinning pass, the model's own vertex buffer if there's nothing to skin
+		vertexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(skinning->getVertexBuffer(0));
+		indexBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(model.indices.buffer);
+
+		for (vkglTF::Node* node : model.linearNodes) {
+			if (!node->mesh || node->mesh->primitives.empty()) {
+				continue;
+			}
+			// The primitives of a mesh are stored one after another, so the whole mesh is a single geometry and the shader only needs the first index
+			const uint32_t firstIndex = node->mesh->primitives.front()->firstIndex;
+			uint32_t indexCount = 0;
+			for (vkglTF::Primitive* primitive : node->mesh->primitives) {
+				assert(primitive->firstIndex == firstIndex + indexCount);
+				indexCount += primitive->indexCount;
+			}
+			if (indexCount == 0) {
+				continue;
+			}
+			// Instance custom indices have 24 bits
+			assert(firstIndex < (1u << 24));
+
+			VkAccelerationStructureGeometryKHR geometry = vks::initializers::accelerationStructureGeometryKHR();
+			geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+			geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+			geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+			geometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+			geometry.geometry.triangles.vertexData = vertexBufferDeviceAddress;
+			geometry.geometry.triangles.maxVertex = model.vertices.count - 1;
+			geometry.geometry.triangles.vertexStride = sizeof(vkglTF::Vertex);
+			geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+			geometry.geometry.triangles.indexData = indexBufferDeviceAddress;
+
+			VkAccelerationStructureBuildRangeInfoKHR buildRange{};
+			buildRange.primitiveCount = indexCount / 3;
+			buildRange.primitiveOffset = firstIndex * sizeof(uint32_t);
+
+			MeshAccelerationStructure meshAccelerationStructure{};
+			meshAccelerationStructure.node = node;
+			meshAccelerationStructure.firstIndex = firstIndex;
+			meshAccelerationStructure.skinned = skinning->isSupported() && (node->skin != nullptr);
+			meshAccelerationStructure.bottomLevelAS.geometries = { geometry };
+			meshAccelerationStructure.bottomLevelAS.buildRanges = { buildRange };
+			meshAccelerationStructure.bottomLevelAS.rebuildInterval = static_cast<uint32_t>(rebuildInterval);
+			meshAccelerationStructures.push_back(meshAccelerationStructure);
+		}
+		// The structures are built by the first frame, once the skinning pass has written the vertices
+		for (MeshAccelerationStructure& meshAccelerationStructure : meshAccelerationStructures) {
+			createDynamicBottomLevelAccelerationStructure(meshAccelerationStructure.bottomLevelAS);
+		}
+	}
+
+	/*
+		Create the static bottom level acceleration structure for the floor
+	*/
+	void createFloorAccelerationStructure()
+	{
+		const float size = 20.0f;
+		std::vector<glm::vec3> vertices = {
+			{ -size, 0.0f, -size },
+			{ size, 0.0f, -size },
+			{ size, 0.0f, size },
+			{ -size, 0.0f, size },
+		};
+		std::vector<uint32_t> indices = { 0, 1, 2, 0, 2, 3 };
+
+		const VkBufferUsageFlags bufferUsageFlags = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			bufferUsageFlags,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&floorGeometry.vertices,
+			vertices.size() * sizeof(glm::vec3),
+			vertices.data()));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			bufferUsageFlags,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&floorGeometry.indices,
+			indices.size() * sizeof(uint32_t),
+			indices.data()));
+
+		VkAccelerationStructureGeometryKHR geometry = vks::initializers::accelerationStructureGeometryKHR();
+		geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+		geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+		geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+		geometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+		geometry.geometry.triangles.vertexData.deviceAddress = getBufferDeviceAddress(floorGeometry.vertices.buffer);
+		geometry.geometry.triangles.maxVertex = static_cast<uint32_t>(vertices.size()) - 1;
+		geometry.geometry.triangles.vertexStride = sizeof(glm::vec3);
+		geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+		geometry.geometry.triangles.indexData.deviceAddress = getBufferDeviceAddress(floorGeometry.indices.buffer);
+
+		VkAccelerationStructureBuildRangeInfoKHR buildRange{};
+		buildRange.primitiveCount = static_cast<uint32_t>(indices.size()) / 3;
+
+		std::vector<BottomLevelAccelerationStructureInput> inputs(1);
+		inputs[0].accelerationStructure = &floorBottomLevelAS;
+		inputs[0].geometries = { geometry };
+		inputs[0].buildRanges = { buildRange };
+		buildBottomLevelAccelerationStructures(inputs);
+	}
+
+	/*
+		Create the top level acceleration structure, it's rebuilt every frame from the instances written by updateInstances()
+	*/
+	void createTopLevelAccelerationStructure()
+	{
+		const uint32_t maxInstanceCount = 1 + MAX_CHARACTER_COUNT * static_cast<uint32_t>(meshAccelerationStructures.size());
+		createDynamicTopLevelAccelerationStructure(topLevelAS, maxInstanceCount);
+		updateInstances();
+	}
+
+	/*
+		Write the floor and character instances into the mapped instance buffer, the characters walk on a circle around the center
+	*/
+	void updateInstances()
+	{
+		uint32_t instanceIndex = 0;
+
+		VkAccelerationStructureInstanceKHR& floorInstance = topLevelAS.instances[instanceIndex++];
+		floorInstance = {};
+		floorInstance.transform = {
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f };
+		floorInstance.instanceCustomIndex = 0;
+		floorInstance.mask = 0xFF;
+		// The floor uses the second hit group
+		floorInstance.instanceShaderBindingTableRecordOffset = 1;
+		floorInstance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+		floorInstance.accelerationStructureReference = floorBottomLevelAS.deviceAddress;
+
+		const float radius = 4.0f;
+		for (int32_t i = 0; i < characterCount; i++) {
+			const float angle = glm::radians(360.0f) * (float)i / (float)characterCount + animationTime * 0.25f;
+			// The glTF model is y-up, the scene uses the default negative y-up of the samples
+			glm::mat4 characterMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(cos(angle) * radius, 0.0f, sin(angle) * radius));
+			characterMatrix = glm::rotate(characterMatrix, -angle, glm::vec3(0.0f, 1.0f, 0.0f));
+			characterMatrix = glm::rotate(characterMatrix, glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+			for (const MeshAccelerationStructure& meshAccelerationStructure : meshAccelerationStructures) {
+				// Vertices are in the space of the mesh's node
+				const glm::mat4 transform = characterMatrix * meshAccelerationStructure.node->worldMatrix;
+				// Row major 3x4 matrix
+				const glm::mat3x4 rows = glm::mat3x4(glm::transpose(transform));
+				VkAccelerationStructureInstanceKHR& instance = topLevelAS.instances[instanceIndex++];
+				instance = {};
+				memcpy(&instance.transform, &rows, sizeof(VkTransformMatrixKHR));
+				instance.instanceCustomIndex = meshAccelerationStructure.firstIndex;
+				instance.mask = 0xFF;
+				instance.instanceShaderBindingTableRecordOffset = 0;
+				instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+				instance.accelerationStructureReference = meshAccelerationStructure.bottomLevelAS.accelerationStructure.deviceAddress;
+			}
+		}
+		topLevelAS.instanceCount = instanceIndex;
+	}
+
+	/*
+		Create the Shader Binding Tables that binds the programs and top-level acceleration structure
+
+		SBT Layout used in this sample:
+
+			/-----------\
+			| raygen    |
+			|-----------|
+			| miss      |
+			|-----------|
+			| shadow    |
+			|-----------|
+			| character |
+			|-----------|
+			| floor     |
+			\-----------/
+
+	*/
+	void createShaderBindingTables() {
+		const uint32_t handleSize = rayTracingPipelineProperties.shaderGroupHandleSize;
+		const uint32_t handleSizeAligned = vks::tools::alignedSize(rayTracingPipelineProperties.shaderGroupHandleSize, rayTracingPipelineProperties.shaderGroupHandleAlignment);
+		const uint32_t groupCount = static_cast<uint32_t>(shaderGroups.size());
+		const uint32_t sbtSize = groupCount * handleSizeAligned;
+
+		std::vector<uint8_t> shaderHandleStorage(sbtSize);
+		VK_CHECK_RESULT(vkGetRayTracingShaderGroupHandlesKHR(device, pipeline, 0, groupCount, sbtSize, shaderHandleStorage.data()));
+
+		createShaderBindingTable(shaderBindingTables.raygen, 1);
+		createShaderBindingTable(shaderBindingTables.miss, 2);
+		// One hit group for the characters and one for the floor, selected by the instance's shader binding table offset
+		createShaderBindingTable(shaderBindingTables.hit, 2);
+
+		// Copy handles, each one to the aligned start of its record
+		memcpy(shaderBindingTables.raygen.mapped, shaderHandleStorage.data(), handleSize);
+		for (uint32_t i = 0; i < 2; i++) {
+			memcpy((uint8_t*)shaderBindingTables.miss.mapped + i * handleSizeAligned, shaderHandleStorage.data() + handleSizeAligned * (1 + i), handleSize);
+			memcpy((uint8_t*)shaderBindingTables.hit.mapped + i * handleSizeAligned, shaderHandleStorage.data() + handleSizeAligned * (3 + i), handleSize);
+		}
+	}
+
+	/*
+		Create the descriptor sets used for the ray tracing dispatch
+	*/
+	void createDescriptorSets()
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			{ VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1 },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 }
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &descriptorPool));
+
+		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet));
+
+		// The top level acceleration structure is rebuilt in place, so the descriptor stays valid
+		VkWriteDescriptorSetAccelerationStructureKHR descriptorAccelerationStructureInfo = vks::initializers::writeDescriptorSetAccelerationStructureKHR();
+		descriptorAccelerationStructureInfo.accelerationStructureCount = 1;
+		descriptorAccelerationStructureInfo.pAccelerationStructures = &topLevelAS.accelerationStructure.handle;
+
+		VkWriteDescriptorSet accelerationStructureWrite{};
+		accelerationStructureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		// The specialized acceleration structure descriptor has to be chained
+		accelerationStructureWrite.pNext = &descriptorAccelerationStructureInfo;
+		accelerationStructureWrite.dstSet = descriptorSet;
+		accelerationStructureWrite.dstBinding = 0;
+		accelerationStructureWrite.descriptorCount = 1;
+		accelerationStructureWrite.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+
+		VkDescriptorImageInfo storageImageDescriptor{ VK_NULL_HANDLE, storageImage.view, VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorBufferInfo vertexBufferDescriptor{ skinning->getVertexBuffer(0), 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo indexBufferDescriptor{ model.indices.buffer, 0, VK_WHOLE_SIZE };
+
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			// Binding 0: Top level acceleration structure
+			accelerationStructureWrite,
+			// Binding 1: Ray tracing result image
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &storageImageDescriptor),
+			// Binding 2: Uniform data
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &ubo.descriptor),
+			// Binding 3: Skinned vertex buffer
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &vertexBufferDescriptor),
+			// Binding 4: Model index buffer
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &indexBufferDescriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, VK_NULL_HANDLE);
+	}
+
+	/*
+		Create our ray tracing pipeline
+	*/
+	void createRayTracingPipeline()
+	{
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Acceleration structure
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 0),
+			// Binding 1: Storage image
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 1),
+			// Binding 2: Uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR, 2),
+			// Binding 3: Vertex buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 3),
+			// Binding 4: Index buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 4),
+		};
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout));
+
+		VkPipelineLayoutCreateInfo pPipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCI, nullptr, &pipelineLayout));
+
+		/*
+			Setup ray tracing shader groups
+		*/
+		std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+
+		VkRayTracingShaderGroupCreateInfoKHR generalShaderGroup{};
+		generalShaderGroup.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
+		generalShaderGroup.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
+		generalShaderGroup.closestHitShader = VK_SHADER_UNUSED_KHR;
+		generalShaderGroup.anyHitShader = VK_SHADER_UNUSED_KHR;
+		generalShaderGroup.intersectionShader = VK_SHADER_UNUSED_KHR;
+
+		VkRayTracingShaderGroupCreateInfoKHR hitShaderGroup{};
+		hitShaderGroup.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
+		hitShaderGroup.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
+		hitShaderGroup.generalShader = VK_SHADER_UNUSED_KHR;
+		hitShaderGroup.anyHitShader = VK_SHADER_UNUSED_KHR;
+		hitShaderGroup.intersectionShader = VK_SHADER_UNUSED_KHR;
+
+		// Ray generation group
+		shaderStages.push_back(loadShader(getShadersPath() + "raytracinganimation/raygen.rgen.spv", VK_SHADER_STAGE_RAYGEN_BIT_KHR));
+		generalShaderGroup.generalShader = static_cast<uint32_t>(shaderStages.size()) - 1;
+		shaderGroups.push_back(generalShaderGroup);
+
+		// Miss groups, the second one is used by shadow rays
+		shaderStages.push_back(loadShader(getShadersPath() + "raytracinganimation/miss.rmiss.spv", VK_SHADER_STAGE_MISS_BIT_KHR));
+		generalShaderGroup.generalShader = static_cast<uint32_t>(shaderStages.size()) - 1;
+		shaderGroups.push_back(generalShaderGroup);
+		shaderStages.push_back(loadShader(getShadersPath() + "raytracinganimation/shadow.rmiss.spv", VK_SHADER_STAGE_MISS_BIT_KHR));
+		generalShaderGroup.generalShader = static_cast<uint32_t>(shaderStages.size()) - 1;
+		shaderGroups.push_back(generalShaderGroup);
+
+		// Closest hit groups for the characters and the floor
+		shaderStages.push_back(loadShader(getShadersPath() + "raytracinganimation/closesthit.rchit.spv", VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR));
+		hitShaderGroup.closestHitShader = static_cast<uint32_t>(shaderStages.size()) - 1;
+		shaderGroups.push_back(hitShaderGroup);
+		shaderStages.push_back(loadShader(getShadersPath() + "raytracinganimation/floor.rchit.spv", VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR));
+		hitShaderGroup.closestHitShader = static_cast<uint32_t>(shaderStages.size()) - 1;
+		shaderGroups.push_back(hitShaderGroup);
+
+		VkRayTracingPipelineCreateInfoKHR rayTracingPipelineCI = vks::initializers::rayTracingPipelineCreateInfoKHR();
+		rayTracingPipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		rayTracingPipelineCI.pStages = shaderStages.data();
+		rayTracingPipelineCI.groupCount = static_cast<uint32_t>(shaderGroups.size());
+		rayTracingPipelineCI.pGroups = shaderGroups.data();
+		rayTracingPipelineCI.maxPipelineRayRecursionDepth = 2;
+		rayTracingPipelineCI.layout = pipelineLayout;
+		VK_CHECK_RESULT(vkCreateRayTracingPipelinesKHR(device, VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &rayTracingPipelineCI, nullptr, &pipeline));
+	}
+
+	/*
+		Create the uniform buffer used to pass matrices to the ray tracing ray generation shader
+	*/
+	void createUniformBuffer()
+	{
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&ubo,
+			sizeof(uniformData),
+			&uniformData));
+		VK_CHECK_RESULT(ubo.map());
+
+		updateUniformBuffers();
+	}
+
+	/*
+		If the window has been resized, we need to recreate the storage image and it's descriptor
+	*/
+	void handleResize()
+	{
+		// Recreate image
+		createStorageImage(swapChain.colorFormat, { width, height, 1 });
+		// Update descriptor
+		VkDescriptorImageInfo storageImageDescriptor{ VK_NULL_HANDLE, storageImage.view, VK_IMAGE_LAYOUT_GENERAL };
+		VkWriteDescriptorSet resultImageWrite = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &storageImageDescriptor);
+		vkUpdateDescriptorSets(device, 1, &resultImageWrite, 0, VK_NULL_HANDLE);
+		resized = false;
+	}
+
+	/*
+		Command buffer generation
+	*/
+	void buildCommandBuffers()
+	{
+		if (resized)
+		{
+			handleResize();
+		}
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+		{
+			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+
+			/*
+				Dispatch the ray tracing commands
+			*/
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipeline);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipelineLayout, 0, 1, &descriptorSet, 0, 0);
+
+			VkStridedDeviceAddressRegionKHR emptySbtEntry = {};
+			vkCmdTraceRaysKHR(
+				drawCmdBuffers[i],
+				&shaderBindingTables.raygen.stridedDeviceAddressRegion,
+				&shaderBindingTables.miss.stridedDeviceAddressRegion,
+				&shaderBindingTables.hit.stridedDeviceAddressRegion,
+				&emptySbtEntry,
+				width,
+				height,
+				1);
+
+			/*
+				Copy ray tracing output to swap chain image
+			*/
+
+			// Prepare current swap chain image as transfer destination
+			vks::tools::setImageLayout(
+				drawCmdBuffers[i],
+				swapChain.images[i],
+				VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				subresourceRange);
+
+			// Prepare ray tracing output image as transfer source
+			vks::tools::setImageLayout(
+				drawCmdBuffers[i],
+				storageImage.image,
+				VK_IMAGE_LAYOUT_GENERAL,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				subresourceRange);
+
+			VkImageCopy copyRegion{};
+			copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			copyRegion.srcOffset = { 0, 0, 0 };
+			copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			copyRegion.dstOffset = { 0, 0, 0 };
+			copyRegion.extent = { width, height, 1 };
+			vkCmdCopyImage(drawCmdBuffers[i], storageImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapChain.images[i], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+			// Transition swap chain image back for presentation
+			vks::tools::setImageLayout(
+				drawCmdBuffers[i],
+				swapChain.images[i],
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+				subresourceRange);
+
+			// Transition ray tracing output image back to general layout
+			vks::tools::setImageLayout(
+				drawCmdBuffers[i],
+				storageImage.image,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_IMAGE_LAYOUT_GENERAL,
+				subresourceRange);
+
+			drawUI(drawCmdBuffers[i], frameBuffers[i]);
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+		}
+	}
+
+	/*
+		Record the skinning pass, the bottom level refits and the top level build for the current frame
+		Which of the bottom level structures are refit or rebuilt changes from frame to frame, so this is recorded again every frame
+	*/
+	void buildAccelerationStructureCommandBuffer()
+	{
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(accelerationStructureCmdBuffer, &cmdBufInfo));
+
+		std::vector<DynamicBottomLevelAccelerationStructure*> updatedStructures;
+		for (MeshAccelerationStructure& meshAccelerationStructure : meshAccelerationStructures) {
+			// Static meshes are only built once
+			if (!meshAccelerationStructure.bottomLevelAS.built || (meshAccelerationStructure.skinned && poseChanged)) {
+				updatedStructures.push_back(&meshAccelerationStructure.bottomLevelAS);
+			}
+		}
+		// The skinning pass also writes the unskinned vertices on its first run, so it has to run before the first build
+		if (poseChanged || !updatedStructures.empty()) {
+			skinning->record(accelerationStructureCmdBuffer, 0);
+			// Skinned vertices are read by the acceleration structure builds and the closest hit shader
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(accelerationStructureCmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			poseChanged = false;
+		}
+		recordBottomLevelAccelerationStructureUpdates(accelerationStructureCmdBuffer, updatedStructures);
+		recordTopLevelAccelerationStructureBuild(accelerationStructureCmdBuffer, topLevelAS);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(accelerationStructureCmdBuffer));
+	}
+
+	void updateUniformBuffers()
+	{
+		uniformData.projInverse = glm::inverse(camera.matrices.perspective);
+		uniformData.viewInverse = glm::inverse(camera.matrices.view);
+		uniformData.lightPos = glm::vec4(cos(glm::radians(timer * 360.0f)) * 40.0f, -50.0f + sin(glm::radians(timer * 360.0f)) * 20.0f, 25.0f + sin(glm::radians(timer * 360.0f)) * 5.0f, 0.0f);
+		// Pass the vertex size to the shader for unpacking vertices
+		uniformData.vertexSize = sizeof(vkglTF::Vertex);
+		memcpy(ubo.mapped, &uniformData, sizeof(uniformData));
+	}
+
+	/*
+		Advance the animation, the joint palette and the instances are consumed by the next acceleration structure command buffer
+	*/
+	void updateAnimation()
+	{
+		if (animate && !paused && !model.animations.empty()) {
+			animationTime += frameTimer;
+			const vkglTF::Animation& animation = model.animations[0];
+			const float duration = animation.end - animation.start;
+			model.updateAnimation(0, animation.start + (duration > 0.0f ? fmod(animationTime, duration) : 0.0f));
+			skinning->update(0);
+			poseChanged = true;
+		}
+		updateInstances();
+	}
+
+	void getEnabledFeatures()
+	{
+		// Enable features required for ray tracing using feature chaining via pNext
+		enabledBufferDeviceAddresFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+		enabledBufferDeviceAddresFeatures.bufferDeviceAddress = VK_TRUE;
+
+		enabledRayTracingPipelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
+		enabledRayTracingPipelineFeatures.rayTracingPipeline = VK_TRUE;
+		enabledRayTracingPipelineFeatures.pNext = &enabledBufferDeviceAddresFeatures;
+
+		enabledAccelerationStructureFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+		enabledAccelerationStructureFeatures.accelerationStructure = VK_TRUE;
+		enabledAccelerationStructureFeatures.pNext = &enabledRayTracingPipelineFeatures;
+
+		deviceCreatepNextChain = &enabledAccelerationStructureFeatures;
+	}
+
+	void prepare()
+	{
+		VulkanRaytracingSample::prepare();
+
+		loadAssets();
+		skinning->update(0);
+
+		// Create the acceleration structures used to render the ray traced scene, the dynamic ones are built by the first frame
+		createMeshAccelerationStructures();
+		createFloorAccelerationStructure();
+		createTopLevelAccelerationStructure();
+
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &accelerationStructureCmdBuffer));
+
+		createStorageImage(swapChain.colorFormat, { width, height, 1 });
+		createUniformBuffer();
+		createRayTracingPipeline();
+		createShaderBindingTables();
+		createDescriptorSets();
+		buildCommandBuffers();
+		prepared = true;
+	}
+
+	void draw()
+	{
+		VulkanExampleBase::prepareFrame();
+		// The previous frame has finished (see VulkanExampleBase::submitFrame), so the command buffer and the instance buffer can be reused
+		buildAccelerationStructureCommandBuffer();
+		std::array<VkCommandBuffer, 2> commandBuffers = { accelerationStructureCmdBuffer, drawCmdBuffers[currentBuffer] };
+		submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+		submitInfo.pCommandBuffers = commandBuffers.data();
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VulkanExampleBase::submitFrame();
+	}
+
+	virtual void render()
+	{
+		if (!prepared)
+			return;
+		updateAnimation();
+		draw();
+		if (!paused || camera.updated)
+			updateUniformBuffers();
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			overlay->checkBox("Animate", &animate);
+			overlay->sliderInt("Characters", &characterCount, 1, MAX_CHARACTER_COUNT);
+			// Refits are cheaper than builds, but the trace performance degrades the further the vertices move away from the last build
+			if (overlay->sliderInt("Rebuild interval", &rebuildInterval, 0, 240)) {
+				for (MeshAccelerationStructure& meshAccelerationStructure : meshAccelerationStructures) {
+					meshAccelerationStructure.bottomLevelAS.rebuildInterval = static_cast<uint32_t>(rebuildInterval);
+				}
+			}
+		}
+		if (overlay->header("Statistics")) {
+			uint32_t updateCount = 0;
+			uint32_t buildCount = 0;
+			for (const MeshAccelerationStructure& meshAccelerationStructure : meshAccelerationStructures) {
+				updateCount += meshAccelerationStructure.bottomLevelAS.updateCount;
+				buildCount += meshAccelerationStructure.bottomLevelAS.buildCount;
+			}
+			overlay->text("Instances: %d", topLevelAS.instanceCount);
+			overlay->text("Bottom level refits: %d", updateCount);
+			overlay->text("Bottom level builds: %d", buildCount);
+		}
+	}
+};
+
+VULKAN_EXAMPLE_MAIN()
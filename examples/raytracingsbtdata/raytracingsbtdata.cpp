@@ -2,6 +2,8 @@
 * Vulkan Example - Hardware accelerated ray tracing example using SBT data
 *
 * Uses the data section of each shader binding table record to color the background and geometry
+* The table is packed into a single buffer by vks::ShaderBindingTableBuilder, with one hit record per geometry of the bottom level
+* acceleration structure, so every triangle gets its color straight from its record without a lookup in another buffer
 *
 * Example by Nate Morrical (https://github.com/natevm)
 * 
@@ -11,6 +13,7 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanShaderBindingTable.h"
 
 // Holds data for a ray tracing scratch buffer that is used as a temporary storage
 struct RayTracingScratchBuffer
@@ -56,10 +59,10 @@ public:
 	vks::Buffer indexBuffer;
 	uint32_t indexCount;
 	vks::Buffer transformBuffer;
+	// Number of geometries (one triangle each) in the bottom level acceleration structure, each one has its own hit record
+	static const uint32_t geometryCount = 3;
 	std::vector<VkRayTracingShaderGroupCreateInfoKHR> shaderGroups{};
-	vks::Buffer raygenShaderBindingTable;
-	vks::Buffer missShaderBindingTable;
-	vks::Buffer hitShaderBindingTable;
+	std::unique_ptr<vks::ShaderBindingTableBuilder> shaderBindingTable;
 
 	struct StorageImage {
 		VkDeviceMemory memory;
@@ -124,9 +127,7 @@ public:
 		vertexBuffer.destroy();
 		indexBuffer.destroy();
 		transformBuffer.destroy();
-		raygenShaderBindingTable.destroy();
-		missShaderBindingTable.destroy();
-		hitShaderBindingTable.destroy();
+		shaderBindingTable.reset();
 		ubo.destroy();
 	}
 
@@ -261,18 +262,23 @@ public:
 	*/
 	void createBottomLevelAccelerationStructure()
 	{
-		// Setup vertices for a single triangle
+		// Setup vertices for a row of triangles, each one is stored as a separate geometry
 		struct Vertex {
 			float pos[3];
 		};
-		std::vector<Vertex> vertices = {
-			{ {  1.0f,  1.0f, 0.0f } },
-			{ { -1.0f,  1.0f, 0.0f } },
-			{ {  0.0f, -1.0f, 0.0f } }
-		};
+		std::vector<Vertex> vertices;
+		for (uint32_t i = 0; i < geometryCount; i++) {
+			const float x = (static_cast<float>(i) - static_cast<float>(geometryCount - 1) * 0.5f) * 1.6f;
+			vertices.push_back({ { x + 0.7f,  0.7f, 0.0f } });
+			vertices.push_back({ { x - 0.7f,  0.7f, 0.0f } });
+			vertices.push_back({ { x,        -0.7f, 0.0f } });
+		}
 
 		// Setup indices
-		std::vector<uint32_t> indices = { 0, 1, 2 };
+		std::vector<uint32_t> indices(vertices.size());
+		for (uint32_t i = 0; i < static_cast<uint32_t>(indices.size()); i++) {
+			indices[i] = i;
+		}
 		indexCount = static_cast<uint32_t>(indices.size());
 
 		// Setup identity transform matrix
@@ -315,6 +321,7 @@ public:
 		transformBufferDeviceAddress.deviceAddress = getBufferDeviceAddress(transformBuffer.buffer);
 
 		// Build
+		// All geometries read from the same buffers, the build ranges select their triangles
 		VkAccelerationStructureGeometryKHR accelerationStructureGeometry{};
 		accelerationStructureGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
 		accelerationStructureGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
@@ -322,30 +329,31 @@ public:
 		accelerationStructureGeometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
 		accelerationStructureGeometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
 		accelerationStructureGeometry.geometry.triangles.vertexData = vertexBufferDeviceAddress;
-		accelerationStructureGeometry.geometry.triangles.maxVertex = 3;
+		accelerationStructureGeometry.geometry.triangles.maxVertex = static_cast<uint32_t>(vertices.size()) - 1;
 		accelerationStructureGeometry.geometry.triangles.vertexStride = sizeof(Vertex);
 		accelerationStructureGeometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
 		accelerationStructureGeometry.geometry.triangles.indexData = indexBufferDeviceAddress;
 		accelerationStructureGeometry.geometry.triangles.transformData.deviceAddress = 0;
 		accelerationStructureGeometry.geometry.triangles.transformData.hostAddress = nullptr;
 		accelerationStructureGeometry.geometry.triangles.transformData = transformBufferDeviceAddress;
-		
+		std::vector<VkAccelerationStructureGeometryKHR> accelerationStructureGeometries(geometryCount, accelerationStructureGeometry);
+
 		// Get size info
 		VkAccelerationStructureBuildGeometryInfoKHR accelerationStructureBuildGeometryInfo{};
 		accelerationStructureBuildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
 		accelerationStructureBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
 		accelerationStructureBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-		accelerationStructureBuildGeometryInfo.geometryCount = 1;
-		accelerationStructureBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
-		
-		const uint32_t numTriangles = 1;
+		accelerationStructureBuildGeometryInfo.geometryCount = geometryCount;
+		accelerationStructureBuildGeometryInfo.pGeometries = accelerationStructureGeometries.data();
+
+		const std::vector<uint32_t> numTriangles(geometryCount, 1);
 		VkAccelerationStructureBuildSizesInfoKHR accelerationStructureBuildSizesInfo{};
 		accelerationStructureBuildSizesInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
 		vkGetAccelerationStructureBuildSizesKHR(
 			device,
 			VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
 			&accelerationStructureBuildGeometryInfo,
-			&numTriangles,
+			numTriangles.data(),
 			&accelerationStructureBuildSizesInfo);
 
 		createAccelerationStructureBuffer(bottomLevelAS, accelerationStructureBuildSizesInfo);
@@ -366,16 +374,19 @@ public:
 		accelerationBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
 		accelerationBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
 		accelerationBuildGeometryInfo.dstAccelerationStructure = bottomLevelAS.handle;
-		accelerationBuildGeometryInfo.geometryCount = 1;
-		accelerationBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
+		accelerationBuildGeometryInfo.geometryCount = geometryCount;
+		accelerationBuildGeometryInfo.pGeometries = accelerationStructureGeometries.data();
 		accelerationBuildGeometryInfo.scratchData.deviceAddress = scratchBuffer.deviceAddress;
 
-		VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
-		accelerationStructureBuildRangeInfo.primitiveCount = numTriangles;
-		accelerationStructureBuildRangeInfo.primitiveOffset = 0;
-		accelerationStructureBuildRangeInfo.firstVertex = 0;
-		accelerationStructureBuildRangeInfo.transformOffset = 0;
-		std::vector<VkAccelerationStructureBuildRangeInfoKHR*> accelerationBuildStructureRangeInfos = { &accelerationStructureBuildRangeInfo };
+		// One range per geometry, pointing at its triangle in the index buffer
+		std::vector<VkAccelerationStructureBuildRangeInfoKHR> accelerationStructureBuildRangeInfos(geometryCount);
+		for (uint32_t i = 0; i < geometryCount; i++) {
+			accelerationStructureBuildRangeInfos[i].primitiveCount = numTriangles[i];
+			accelerationStructureBuildRangeInfos[i].primitiveOffset = i * 3 * sizeof(uint32_t);
+			accelerationStructureBuildRangeInfos[i].firstVertex = 0;
+			accelerationStructureBuildRangeInfos[i].transformOffset = 0;
+		}
+		std::vector<VkAccelerationStructureBuildRangeInfoKHR*> accelerationBuildStructureRangeInfos = { accelerationStructureBuildRangeInfos.data() };
 
 		// Build the acceleration structure on the device via a one-time command buffer submission
 		// Some implementations may support acceleration structure building on the host (VkPhysicalDeviceAccelerationStructureFeaturesKHR->accelerationStructureHostCommands), but we prefer device builds
@@ -507,7 +518,7 @@ public:
 		Create the Shader Binding Tables that binds the programs and top-level acceleration structure
 		In this example, we embed data in each record that can be read by the device during ray tracing
 
-		SBT Layout used in this sample:
+		SBT Layout used in this sample, all regions are stored in one buffer:
 
 			/----------------\
 			| raygen handle  |
@@ -520,47 +531,36 @@ public:
 			|----------------|
 			| hit handle     |
 			|  - - - - - - - |
-			| hit data       |
+			| hit data (0)   |
+			|----------------|
+			|      ...       |
+			|----------------|
+			| hit handle     |
+			|  - - - - - - - |
+			| hit data (n)   |
 			\----------------/
 
+		The raygen shader traces with a record stride of one, so the hit record used for geometry n is the n-th one of the hit region
 	*/
 	void createShaderBindingTable() {
-		const uint32_t handleSize = rayTracingPipelineProperties.shaderGroupHandleSize;
-		const uint32_t handleSizeAligned = vks::tools::alignedSize(rayTracingPipelineProperties.shaderGroupHandleSize, rayTracingPipelineProperties.shaderGroupHandleAlignment);
-		const uint32_t groupCount = static_cast<uint32_t>(shaderGroups.size());
-		const uint32_t sbtSize = groupCount * handleSizeAligned;
+		shaderBindingTable.reset(new vks::ShaderBindingTableBuilder(vulkanDevice, rayTracingPipelineProperties));
+
+		// We store the handle (which is like lambda function pointers to call in the ray tracing pipeline) 
+		// as well as the data to pass to those functions (which act as the variables being "captured" by those lambda functions)
+		const glm::vec3 raygenColor(0.5f, 0.5f, 0.5f);
+		shaderBindingTable->addRecord(vks::ShaderBindingTableBuilder::Raygen, 0, &raygenColor, sizeof(glm::vec3));
 
-		std::vector<uint8_t> shaderHandleStorage(sbtSize);
-		VK_CHECK_RESULT(vkGetRayTracingShaderGroupHandlesKHR(device, pipeline, 0, groupCount, sbtSize, shaderHandleStorage.data()));
+		const glm::vec3 missColor(1.0f, 1.0f, 1.0f);
+		shaderBindingTable->addRecord(vks::ShaderBindingTableBuilder::Miss, 1, &missColor, sizeof(glm::vec3));
 
-		const VkBufferUsageFlags bufferUsageFlags = VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
-		const VkMemoryPropertyFlags memoryUsageFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		// One hit group record per geometry, all of them share the closest hit group but carry their own color
+		const std::vector<glm::vec3> hitColors = { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+		assert(hitColors.size() == geometryCount);
+		for (auto& hitColor : hitColors) {
+			shaderBindingTable->addRecord(vks::ShaderBindingTableBuilder::Hit, 2, &hitColor, sizeof(glm::vec3));
+		}
 
-		// We allocate space for the handle (which is like lambda function pointers to call in the ray tracing pipeline) 
-		// as well as the data to pass to those functions (which act as the variables being "captured" by those lambda functions)
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(bufferUsageFlags, memoryUsageFlags, &raygenShaderBindingTable, handleSize + sizeof(float) * 3));
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(bufferUsageFlags, memoryUsageFlags, &missShaderBindingTable, handleSize + sizeof(float) * 3));
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(bufferUsageFlags, memoryUsageFlags, &hitShaderBindingTable, handleSize + sizeof(float) * 3));
-
-		// Copy handles
-		raygenShaderBindingTable.map();
-		missShaderBindingTable.map();
-		hitShaderBindingTable.map();
-		memcpy(raygenShaderBindingTable.mapped, shaderHandleStorage.data(), handleSize);
-		memcpy(missShaderBindingTable.mapped, shaderHandleStorage.data() + handleSizeAligned, handleSize);
-		memcpy(hitShaderBindingTable.mapped, shaderHandleStorage.data() + handleSizeAligned * 2, handleSize);
-
-		// Copy over raygen record data
-		glm::vec3 color1(0.5f, 0.5f, 0.5f);
-		memcpy(((uint8_t*)(raygenShaderBindingTable.mapped)) + handleSize, &color1, sizeof(glm::vec3));
-
-		// Copy over miss record data
-		glm::vec3 color2(1.f, 1.f, 1.f);
-		memcpy(((uint8_t*)(missShaderBindingTable.mapped)) + handleSize, &color2, sizeof(glm::vec3));
-
-		// Copy over hit group record data
-		glm::vec3 color3(1.f, 0.f, 0.f);
-		memcpy(((uint8_t*)(hitShaderBindingTable.mapped)) + handleSize, &color3, sizeof(glm::vec3));
+		shaderBindingTable->build(pipeline, static_cast<uint32_t>(shaderGroups.size()));
 	}
 
 	/*
@@ -762,26 +762,11 @@ public:
 				Setup the buffer regions pointing to the shaders in our shader binding table
 			*/
 
-			const uint32_t handleSizeAligned = vks::tools::alignedSize(rayTracingPipelineProperties.shaderGroupHandleSize, rayTracingPipelineProperties.shaderGroupHandleAlignment);
-
-			// Note, we add 3 * sizeof(float) to each SBT entry size to account for the data sections of these records
-			// that we use to store our color data
-			VkStridedDeviceAddressRegionKHR raygenShaderSbtEntry{};
-			raygenShaderSbtEntry.deviceAddress = getBufferDeviceAddress(raygenShaderBindingTable.buffer);
-			raygenShaderSbtEntry.stride = handleSizeAligned;
-			raygenShaderSbtEntry.size =  vks::tools::alignedSize(handleSizeAligned + 3 * sizeof(float), rayTracingPipelineProperties.shaderGroupBaseAlignment);
-
-			VkStridedDeviceAddressRegionKHR missShaderSbtEntry{};
-			missShaderSbtEntry.deviceAddress = getBufferDeviceAddress(missShaderBindingTable.buffer);
-			missShaderSbtEntry.stride = handleSizeAligned;
-			missShaderSbtEntry.size = vks::tools::alignedSize(handleSizeAligned + 3 * sizeof(float), rayTracingPipelineProperties.shaderGroupBaseAlignment);
-
-			VkStridedDeviceAddressRegionKHR hitShaderSbtEntry{};
-			hitShaderSbtEntry.deviceAddress = getBufferDeviceAddress(hitShaderBindingTable.buffer);
-			hitShaderSbtEntry.stride = handleSizeAligned;
-			hitShaderSbtEntry.size = vks::tools::alignedSize(handleSizeAligned + 3 * sizeof(float), rayTracingPipelineProperties.shaderGroupBaseAlignment);
-
-			VkStridedDeviceAddressRegionKHR callableShaderSbtEntry{};
+			// The strides account for the data sections of the records that we use to store our color data
+			const VkStridedDeviceAddressRegionKHR raygenShaderSbtEntry = shaderBindingTable->getRegion(vks::ShaderBindingTableBuilder::Raygen);
+			const VkStridedDeviceAddressRegionKHR missShaderSbtEntry = shaderBindingTable->getRegion(vks::ShaderBindingTableBuilder::Miss);
+			const VkStridedDeviceAddressRegionKHR hitShaderSbtEntry = shaderBindingTable->getRegion(vks::ShaderBindingTableBuilder::Hit);
+			const VkStridedDeviceAddressRegionKHR callableShaderSbtEntry = shaderBindingTable->getRegion(vks::ShaderBindingTableBuilder::Callable);
 
 			/*
 				Dispatch the ray tracing commands
@@ -919,7 +904,7 @@ public:
 		VulkanExampleBase::prepareFrame();
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -8,6 +8,8 @@
 
 #if defined(_WIN32)
 #pragma comment(linker, "/subsystem:console")
+#include <io.h>
+#include <fcntl.h>
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
 #include <android/native_activity.h>
 #include <android/asset_manager.h>
@@ -24,6 +26,9 @@
 #include <array>
 #include <iostream>
 #include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <chrono>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -48,7 +53,9 @@ android_app* androidapp;
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 #define LOG(...) ((void)__android_log_print(ANDROID_LOG_INFO, "vulkanExample", __VA_ARGS__))
 #else
-#define LOG(...) printf(__VA_ARGS__)
+// Batch mode can stream images to stdout, messages are logged to stderr then
+FILE* logOutput = stdout;
+#define LOG(...) fprintf(logOutput, __VA_ARGS__)
 #endif
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugMessageCallback(
@@ -93,16 +100,41 @@ public:
 	int32_t width, height;
 	VkFramebuffer framebuffer;
 	FrameBufferAttachment colorAttachment, depthAttachment;
+	VkFormat colorFormat, depthFormat;
 	VkRenderPass renderPass;
 
+	// Camera of a frame, the default values match the single frame
+	struct FrameParams {
+		glm::vec3 translation = glm::vec3(0.0f);
+		// Euler angles in degrees
+		glm::vec3 rotation = glm::vec3(0.0f);
+		float fov = 60.0f;
+	};
+	// Resources of a frame in flight in batch mode
+	struct BatchFrame {
+		FrameBufferAttachment colorAttachment, depthAttachment;
+		VkFramebuffer framebuffer;
+		VkCommandBuffer commandBuffer;
+		VkFence fence;
+		VkBuffer readbackBuffer;
+		VkDeviceMemory readbackMemory;
+		const uint8_t *readbackData;
+		// Index of the frame in the sequence, -1 while no frame has been submitted
+		int64_t index = -1;
+	};
+	bool readbackCoherent = true;
+
 	VkDebugReportCallbackEXT debugReportCallback{};
 
-	uint32_t getMemoryTypeIndex(uint32_t typeBits, VkMemoryPropertyFlags properties) {
+	uint32_t getMemoryTypeIndex(uint32_t typeBits, VkMemoryPropertyFlags properties, VkBool32 *memTypeFound = nullptr) {
 		VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
 		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceMemoryProperties);
 		for (uint32_t i = 0; i < deviceMemoryProperties.memoryTypeCount; i++) {
 			if ((typeBits & 1) == 1) {
 				if ((deviceMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+					if (memTypeFound) {
+						*memTypeFound = VK_TRUE;
+					}
 					return i;
 				}
 			}
@@ -154,6 +186,336 @@ public:
 		vkDestroyFence(device, fence, nullptr);
 	}
 
+	/*
+		Create color and depth attachments with the size and formats of the offscreen framebuffer
+	*/
+	void createAttachments(FrameBufferAttachment &color, FrameBufferAttachment &depth)
+	{
+		// Color attachment
+		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+		image.imageType = VK_IMAGE_TYPE_2D;
+		image.format = colorFormat;
+		image.extent.width = width;
+		image.extent.height = height;
+		image.extent.depth = 1;
+		image.mipLevels = 1;
+		image.arrayLayers = 1;
+		image.samples = VK_SAMPLE_COUNT_1_BIT;
+		image.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		VkMemoryRequirements memReqs;
+
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &color.image));
+		vkGetImageMemoryRequirements(device, color.image, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &color.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, color.image, color.memory, 0));
+
+		VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
+		colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		colorImageView.format = colorFormat;
+		colorImageView.subresourceRange = {};
+		colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		colorImageView.subresourceRange.baseMipLevel = 0;
+		colorImageView.subresourceRange.levelCount = 1;
+		colorImageView.subresourceRange.baseArrayLayer = 0;
+		colorImageView.subresourceRange.layerCount = 1;
+		colorImageView.image = color.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &color.view));
+
+		// Depth stencil attachment
+		image.format = depthFormat;
+		image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &depth.image));
+		vkGetImageMemoryRequirements(device, depth.image, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &depth.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, depth.image, depth.memory, 0));
+
+		VkImageViewCreateInfo depthStencilView = vks::initializers::imageViewCreateInfo();
+		depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		depthStencilView.format = depthFormat;
+		depthStencilView.flags = 0;
+		depthStencilView.subresourceRange = {};
+		depthStencilView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT)
+			depthStencilView.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		depthStencilView.subresourceRange.baseMipLevel = 0;
+		depthStencilView.subresourceRange.levelCount = 1;
+		depthStencilView.subresourceRange.baseArrayLayer = 0;
+		depthStencilView.subresourceRange.layerCount = 1;
+		depthStencilView.image = depth.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &depth.view));
+	}
+
+	void createFramebuffer(const FrameBufferAttachment &color, const FrameBufferAttachment &depth, VkFramebuffer *framebuffer)
+	{
+		VkImageView attachments[2];
+		attachments[0] = color.view;
+		attachments[1] = depth.view;
+
+		VkFramebufferCreateInfo framebufferCreateInfo = vks::initializers::framebufferCreateInfo();
+		framebufferCreateInfo.renderPass = renderPass;
+		framebufferCreateInfo.attachmentCount = 2;
+		framebufferCreateInfo.pAttachments = attachments;
+		framebufferCreateInfo.width = width;
+		framebufferCreateInfo.height = height;
+		framebufferCreateInfo.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, framebuffer));
+	}
+
+	/*
+		Record the scene's render pass for the given camera parameters
+	*/
+	void recordScene(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer, const FrameParams &params)
+	{
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = {};
+		renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.framebuffer = framebuffer;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport = {};
+		viewport.height = (float)height;
+		viewport.width = (float)width;
+		viewport.minDepth = (float)0.0f;
+		viewport.maxDepth = (float)1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		// Update dynamic scissor state
+		VkRect2D scissor = {};
+		scissor.extent.width = width;
+		scissor.extent.height = height;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+		// Render scene
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+		std::vector<glm::vec3> pos = {
+			glm::vec3(-1.5f, 0.0f, -4.0f),
+			glm::vec3( 0.0f, 0.0f, -2.5f),
+			glm::vec3( 1.5f, 0.0f, -4.0f),
+		};
+
+		glm::mat4 view = glm::rotate(glm::mat4(1.0f), glm::radians(params.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+		view = glm::rotate(view, glm::radians(params.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+		view = glm::rotate(view, glm::radians(params.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+		view = glm::translate(view, params.translation);
+		const glm::mat4 projection = glm::perspective(glm::radians(params.fov), (float)width / (float)height, 0.1f, 256.0f);
+
+		for (auto v : pos) {
+			glm::mat4 mvpMatrix = projection * view * glm::translate(glm::mat4(1.0f), v);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mvpMatrix), &mvpMatrix);
+			vkCmdDrawIndexed(commandBuffer, 3, 1, 0, 0, 0);
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	/*
+		Read the camera parameters of a frame from a line of the batch input
+		Format: translation x y z, rotation x y z (in degrees), field of view (in degrees), missing values keep their defaults
+		Returns false for empty lines and comments starting with #
+	*/
+	static bool parseFrameParams(const std::string &line, FrameParams &params)
+	{
+		std::istringstream stream(line);
+		std::string first;
+		if (!(stream >> first) || (first[0] == '#')) {
+			return false;
+		}
+		stream.clear();
+		stream.seekg(0);
+		float values[7] = { params.translation.x, params.translation.y, params.translation.z, params.rotation.x, params.rotation.y, params.rotation.z, params.fov };
+		for (auto &value : values) {
+			if (!(stream >> value)) {
+				break;
+			}
+		}
+		params.translation = glm::vec3(values[0], values[1], values[2]);
+		params.rotation = glm::vec3(values[3], values[4], values[5]);
+		params.fov = values[6];
+		return true;
+	}
+
+	/*
+		Write the read back image of a finished batch frame to the output sink as a ppm image
+		The output is either a file name pattern with the frame index (e.g. frame_%05u.ppm) or "-" to stream all images to stdout
+	*/
+	void writeBatchFrame(const BatchFrame &frame, const std::string &output)
+	{
+		if (!readbackCoherent) {
+			VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
+			mappedRange.memory = frame.readbackMemory;
+			mappedRange.size = VK_WHOLE_SIZE;
+			VK_CHECK_RESULT(vkInvalidateMappedMemoryRanges(device, 1, &mappedRange));
+		}
+
+		// Assemble the whole image first so it's written with a single call, which keeps images in a stream intact
+		std::string header = "P6\n" + std::to_string(width) + "\n" + std::to_string(height) + "\n255\n";
+		std::vector<char> ppm(header.begin(), header.end());
+		ppm.reserve(header.size() + width * height * 3);
+		const uint8_t *texel = frame.readbackData;
+		for (int32_t i = 0; i < width * height; i++) {
+			ppm.insert(ppm.end(), texel, texel + 3);
+			texel += 4;
+		}
+
+		if (output == "-") {
+			fwrite(ppm.data(), 1, ppm.size(), stdout);
+			fflush(stdout);
+		}
+		else {
+			char filename[256];
+			snprintf(filename, sizeof(filename), output.c_str(), static_cast<uint32_t>(frame.index));
+			std::ofstream file(filename, std::ios::out | std::ios::binary);
+			file.write(ppm.data(), ppm.size());
+			if (!file.good()) {
+				LOG("Could not write %s\n", filename);
+			}
+		}
+	}
+
+	/*
+		Batch mode: Render one frame per line of camera parameters read from a file or stdin
+
+		Each frame in flight has its own framebuffer, command buffer, fence and host visible readback buffer. The copy to the readback
+		buffer is recorded into the frame's command buffer, so a frame only needs a single submission. The host only waits for a frame's
+		fence once its resources are needed again, framesInFlight frames later, and writes out its image while the GPU works on the
+		following frames.
+	*/
+	void renderBatch()
+	{
+		const std::string input = commandLineParser.getValueAsString("batch", "-");
+		const std::string output = commandLineParser.getValueAsString("output", "frame_%05u.ppm");
+		const uint32_t framesInFlight = static_cast<uint32_t>(commandLineParser.getValueAsInt("framesinflight", 3));
+
+		// The file name pattern may only contain the frame index
+		if (output != "-") {
+			const size_t conversion = output.find('%');
+			const size_t type = output.find_first_not_of("0123456789", conversion + 1);
+			if ((conversion == std::string::npos) || (type == std::string::npos) || ((output[type] != 'u') && (output[type] != 'd')) || (output.find('%', type) != std::string::npos)) {
+				LOG("Output has to be - or a file name pattern with a single %%u for the frame index\n");
+				return;
+			}
+		}
+
+		std::ifstream inputFile;
+		if (input != "-") {
+			inputFile.open(input);
+			if (!inputFile.is_open()) {
+				LOG("Could not open %s\n", input.c_str());
+				return;
+			}
+		}
+		std::istream &inputStream = (input == "-") ? std::cin : inputFile;
+
+		// Reading back from cached memory is a lot faster, but may require invalidation
+		VkBool32 cached = VK_FALSE;
+		getMemoryTypeIndex(~0u, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &cached);
+		const VkMemoryPropertyFlags readbackMemoryFlags = cached ? (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT) : (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		readbackCoherent = !cached;
+		const VkDeviceSize readbackSize = static_cast<VkDeviceSize>(width) * height * 4;
+
+		std::vector<BatchFrame> frames(framesInFlight);
+		for (auto &frame : frames) {
+			createAttachments(frame.colorAttachment, frame.depthAttachment);
+			createFramebuffer(frame.colorAttachment, frame.depthAttachment, &frame.framebuffer);
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &frame.commandBuffer));
+			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo();
+			VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &frame.fence));
+			createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, readbackMemoryFlags, &frame.readbackBuffer, &frame.readbackMemory, readbackSize);
+			void *mapped;
+			VK_CHECK_RESULT(vkMapMemory(device, frame.readbackMemory, 0, VK_WHOLE_SIZE, 0, &mapped));
+			frame.readbackData = static_cast<const uint8_t*>(mapped);
+		}
+
+		const auto tStart = std::chrono::high_resolution_clock::now();
+		FrameParams params;
+		std::string line;
+		int64_t frameCount = 0;
+		while (std::getline(inputStream, line)) {
+			if (!parseFrameParams(line, params)) {
+				continue;
+			}
+			BatchFrame &frame = frames[frameCount % framesInFlight];
+			// Wait for the frame that used these resources before and write out its image
+			if (frame.index >= 0) {
+				VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+				VK_CHECK_RESULT(vkResetFences(device, 1, &frame.fence));
+				writeBatchFrame(frame, output);
+			}
+
+			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+			cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			VK_CHECK_RESULT(vkBeginCommandBuffer(frame.commandBuffer, &cmdBufInfo));
+			recordScene(frame.commandBuffer, frame.framebuffer, params);
+			// The render pass leaves the color attachment in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+			VkBufferImageCopy region{};
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			region.imageExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
+			vkCmdCopyImageToBuffer(frame.commandBuffer, frame.colorAttachment.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame.readbackBuffer, 1, &region);
+			// Make the copy visible to the host once the fence has been signaled
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			bufferBarrier.buffer = frame.readbackBuffer;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(frame.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+			VK_CHECK_RESULT(vkEndCommandBuffer(frame.commandBuffer));
+
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &frame.commandBuffer;
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, frame.fence));
+			frame.index = frameCount++;
+		}
+
+		// Write out the frames still in flight in sequence order
+		for (int64_t i = std::max<int64_t>(frameCount - framesInFlight, 0); i < frameCount; i++) {
+			BatchFrame &frame = frames[i % framesInFlight];
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+			writeBatchFrame(frame, output);
+		}
+
+		const auto tEnd = std::chrono::high_resolution_clock::now();
+		const double seconds = std::chrono::duration<double>(tEnd - tStart).count();
+		LOG("Rendered %lld frames with %u frames in flight in %.3f seconds\n", static_cast<long long>(frameCount), framesInFlight, seconds);
+
+		for (auto &frame : frames) {
+			vkUnmapMemory(device, frame.readbackMemory);
+			vkDestroyBuffer(device, frame.readbackBuffer, nullptr);
+			vkFreeMemory(device, frame.readbackMemory, nullptr);
+			vkDestroyFence(device, frame.fence, nullptr);
+			vkFreeCommandBuffers(device, commandPool, 1, &frame.commandBuffer);
+			vkDestroyFramebuffer(device, frame.framebuffer, nullptr);
+			for (auto attachment : { frame.colorAttachment, frame.depthAttachment }) {
+				vkDestroyImageView(device, attachment.view, nullptr);
+				vkDestroyImage(device, attachment.image, nullptr);
+				vkFreeMemory(device, attachment.memory, nullptr);
+			}
+		}
+	}
+
 	VulkanExample()
 	{
 		LOG("Running headless rendering example\n");
@@ -413,71 +775,9 @@ public:
 		*/
 		width = 1024;
 		height = 1024;
-		VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
-		VkFormat depthFormat;
+		colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
 		vks::tools::getSupportedDepthFormat(physicalDevice, &depthFormat);
-		{
-			// Color attachment
-			VkImageCreateInfo image = vks::initializers::imageCreateInfo();
-			image.imageType = VK_IMAGE_TYPE_2D;
-			image.format = colorFormat;
-			image.extent.width = width;
-			image.extent.height = height;
-			image.extent.depth = 1;
-			image.mipLevels = 1;
-			image.arrayLayers = 1;
-			image.samples = VK_SAMPLE_COUNT_1_BIT;
-			image.tiling = VK_IMAGE_TILING_OPTIMAL;
-			image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-
-			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-			VkMemoryRequirements memReqs;
-
-			VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &colorAttachment.image));
-			vkGetImageMemoryRequirements(device, colorAttachment.image, &memReqs);
-			memAlloc.allocationSize = memReqs.size;
-			memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &colorAttachment.memory));
-			VK_CHECK_RESULT(vkBindImageMemory(device, colorAttachment.image, colorAttachment.memory, 0));
-
-			VkImageViewCreateInfo colorImageView = vks::initializers::imageViewCreateInfo();
-			colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			colorImageView.format = colorFormat;
-			colorImageView.subresourceRange = {};
-			colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			colorImageView.subresourceRange.baseMipLevel = 0;
-			colorImageView.subresourceRange.levelCount = 1;
-			colorImageView.subresourceRange.baseArrayLayer = 0;
-			colorImageView.subresourceRange.layerCount = 1;
-			colorImageView.image = colorAttachment.image;
-			VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &colorAttachment.view));
-
-			// Depth stencil attachment
-			image.format = depthFormat;
-			image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-
-			VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &depthAttachment.image));
-			vkGetImageMemoryRequirements(device, depthAttachment.image, &memReqs);
-			memAlloc.allocationSize = memReqs.size;
-			memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &depthAttachment.memory));
-			VK_CHECK_RESULT(vkBindImageMemory(device, depthAttachment.image, depthAttachment.memory, 0));
-
-			VkImageViewCreateInfo depthStencilView = vks::initializers::imageViewCreateInfo();
-			depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			depthStencilView.format = depthFormat;
-			depthStencilView.flags = 0;
-			depthStencilView.subresourceRange = {};
-			depthStencilView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-			if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT)
-				depthStencilView.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-			depthStencilView.subresourceRange.baseMipLevel = 0;
-			depthStencilView.subresourceRange.levelCount = 1;
-			depthStencilView.subresourceRange.baseArrayLayer = 0;
-			depthStencilView.subresourceRange.layerCount = 1;
-			depthStencilView.image = depthAttachment.image;
-			VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &depthAttachment.view));
-		}
+		createAttachments(colorAttachment, depthAttachment);
 
 		/*
 			Create renderpass
@@ -526,10 +826,11 @@ public:
 			dependencies[1].srcSubpass = 0;
 			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
 			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+			// The color attachment is copied from after the render pass
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
 			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			dependencies[1].dependencyFlags = 0;
 
 			// Create the actual renderpass
 			VkRenderPassCreateInfo renderPassInfo = {};
@@ -542,18 +843,7 @@ public:
 			renderPassInfo.pDependencies = dependencies.data();
 			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
 
-			VkImageView attachments[2];
-			attachments[0] = colorAttachment.view;
-			attachments[1] = depthAttachment.view;
-
-			VkFramebufferCreateInfo framebufferCreateInfo = vks::initializers::framebufferCreateInfo();
-			framebufferCreateInfo.renderPass = renderPass;
-			framebufferCreateInfo.attachmentCount = 2;
-			framebufferCreateInfo.pAttachments = attachments;
-			framebufferCreateInfo.width = width;
-			framebufferCreateInfo.height = height;
-			framebufferCreateInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &framebuffer));
+			createFramebuffer(colorAttachment, depthAttachment, &framebuffer);
 		}
 
 		/*
@@ -666,6 +956,11 @@ public:
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 		}
 
+		if (commandLineParser.isSet("batch")) {
+			renderBatch();
+			return;
+		}
+
 		/*
 			Command buffer creation
 		*/
@@ -680,54 +975,7 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
-			VkClearValue clearValues[2];
-			clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
-			clearValues[1].depthStencil = { 1.0f, 0 };
-
-			VkRenderPassBeginInfo renderPassBeginInfo = {};
-			renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassBeginInfo.renderArea.extent.width = width;
-			renderPassBeginInfo.renderArea.extent.height = height;
-			renderPassBeginInfo.clearValueCount = 2;
-			renderPassBeginInfo.pClearValues = clearValues;
-			renderPassBeginInfo.renderPass = renderPass;
-			renderPassBeginInfo.framebuffer = framebuffer;
-
-			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			VkViewport viewport = {};
-			viewport.height = (float)height;
-			viewport.width = (float)width;
-			viewport.minDepth = (float)0.0f;
-			viewport.maxDepth = (float)1.0f;
-			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-			// Update dynamic scissor state
-			VkRect2D scissor = {};
-			scissor.extent.width = width;
-			scissor.extent.height = height;
-			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-
-			// Render scene
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
-			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
-			std::vector<glm::vec3> pos = {
-				glm::vec3(-1.5f, 0.0f, -4.0f),
-				glm::vec3( 0.0f, 0.0f, -2.5f),
-				glm::vec3( 1.5f, 0.0f, -4.0f),
-			};
-
-			for (auto v : pos) {
-				glm::mat4 mvpMatrix = glm::perspective(glm::radians(60.0f), (float)width / (float)height, 0.1f, 256.0f) * glm::translate(glm::mat4(1.0f), v);
-				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mvpMatrix), &mvpMatrix);
-				vkCmdDrawIndexed(commandBuffer, 3, 1, 0, 0, 0);
-			}
-
-			vkCmdEndRenderPass(commandBuffer);
+			recordScene(commandBuffer, framebuffer, FrameParams());
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 
@@ -943,15 +1191,28 @@ void android_main(android_app* state) {
 int main(int argc, char* argv[]) {
 	commandLineParser.add("help", { "--help" }, 0, "Show help");
 	commandLineParser.add("shaders", { "-s", "--shaders" }, 1, "Select shader type to use (glsl or hlsl)");
+	commandLineParser.add("batch", { "-b", "--batch" }, 1, "Render one frame per line of camera parameters (translation xyz, rotation xyz, fov) read from a file, - for stdin");
+	commandLineParser.add("output", { "-o", "--output" }, 1, "Batch mode output, file name pattern with the frame index (default frame_%05u.ppm) or - to stream ppm images to stdout");
+	commandLineParser.add("framesinflight", { "-f", "--framesinflight" }, 1, "Number of frames in flight in batch mode (default 3)");
 	commandLineParser.parse(argc, argv);
 	if (commandLineParser.isSet("help")) {
 		commandLineParser.printHelp();
 		std::cin.get();
 		return 0;
 	}	
+	const bool batch = commandLineParser.isSet("batch");
+	if (batch && (commandLineParser.getValueAsString("output", "") == "-")) {
+#if defined(_WIN32)
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		logOutput = stderr;
+	}
 	VulkanExample *vulkanExample = new VulkanExample();
-	std::cout << "Finished. Press enter to terminate...";
-	std::cin.get();
+	// Batch mode is meant to be scripted and may use stdin for its input
+	if (!batch) {
+		std::cout << "Finished. Press enter to terminate...";
+		std::cin.get();
+	}
 	delete(vulkanExample);
 	return 0;
 }
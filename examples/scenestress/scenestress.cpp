@@ -0,0 +1,838 @@
+/*
+* Vulkan Example - Scene scale stress test of the GPU driven rendering path
+*
+* Fills a large grid with tens of thousands of copies of a few glTF models (including a skinned character animated with compute skinning) and
+* several hundred moving point lights, and draws them either with the GPU driven path (vkglTF::GpuCulling, multi draw indirect with bindless
+* materials and clustered lighting) or with the classic vkglTF::Model::draw path, which records one draw per primitive and copy
+*
+* Every part of the GPU driven path can be toggled at runtime. In benchmark mode all supported configurations are run in turn and the CPU time
+* spent recording and submitting a frame, the GPU times of the passes and the device memory of the resources each configuration uses are
+* reported per configuration
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+#include "VulkanglTFCulling.h"
+#include "VulkanglTFSkinning.h"
+
+#define ENABLE_VALIDATION false
+
+// Clustered lighting, has to match the shading and light culling shaders
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define MAX_LIGHTS_PER_CLUSTER 128
+
+class VulkanExample : public VulkanExampleBase
+{
+public:
+	// Models the scene is filled with, each copy picks one at random
+	struct ArchetypeInfo {
+		const char* file;
+		// Size of the largest extent of the model in the scene
+		float size;
+		bool skinned;
+	};
+	const std::vector<ArchetypeInfo> archetypeInfos = {
+		{ "models/voyager.gltf", 3.0f, false },
+		{ "models/rock01.gltf", 1.5f, false },
+		{ "models/oaktree.gltf", 4.0f, false },
+		{ "models/CesiumMan/glTF/CesiumMan.gltf", 1.8f, true },
+	};
+	struct Archetype {
+		vkglTF::Model model;
+		vkglTF::GpuCulling* culling = nullptr;
+		// Only for the skinned archetype, all of its copies share the pose
+		vkglTF::ComputeSkinning* skinning = nullptr;
+		std::vector<glm::mat4> placements;
+		// Index of the archetype's first placement in the placement buffer
+		uint32_t firstPlacement = 0;
+	};
+	std::vector<Archetype> archetypes;
+	// Number of model copies and lights, can be set on the command line
+	uint32_t placementCount = 20000;
+	uint32_t lightCount = 512;
+	float animationTime = 0.0f;
+
+	struct Light {
+		// xyz: position, w: range
+		glm::vec4 position;
+		glm::vec4 color;
+	};
+	struct LightPath {
+		glm::vec3 center;
+		float radius;
+		float speed;
+		float phase;
+	};
+	std::vector<Light> lights;
+	std::vector<LightPath> lightPaths;
+
+	// Shared by all shaders, see the UBO block of the scenestress shaders
+	struct UniformData {
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::mat4 invProjection;
+		glm::vec4 viewPos;
+		glm::ivec2 renderExtent;
+		uint32_t lightCount;
+		uint32_t clustered;
+		float zNear;
+		float zFar;
+		glm::vec2 padding;
+	} uniformData;
+
+	// Resources written by the host or the GPU every frame, one set per frame in flight
+	struct FrameResources {
+		vks::Buffer uniformBuffer;
+		vks::Buffer lights;
+		// Light count and MAX_LIGHTS_PER_CLUSTER light indices per cluster
+		vks::Buffer clusters;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	};
+	std::vector<FrameResources> frameResources;
+	// Placement matrices of all archetypes, read by the vkglTF::Model::draw path
+	vks::Buffer placementBuffer;
+
+	// Runtime toggles of the GPU driven path
+	bool indirectDraws = true;
+	bool gpuCulling = true;
+	bool clusteredLighting = true;
+	bool indirectSupported = false;
+	bool fallbackSupported = false;
+	bool cullingSupported = false;
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledDescriptorIndexingFeatures{};
+	VkPhysicalDeviceShaderDrawParametersFeatures enabledShaderDrawParametersFeatures{};
+
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	struct {
+		// Scene (0), indirect draw buffers (1) and bindless materials (2)
+		VkPipelineLayout indirect = VK_NULL_HANDLE;
+		// Scene (0) and pushed material images (1)
+		VkPipelineLayout fallback = VK_NULL_HANDLE;
+		VkPipelineLayout lightCulling = VK_NULL_HANDLE;
+	} pipelineLayouts;
+	struct {
+		VkPipeline indirect = VK_NULL_HANDLE;
+		VkPipeline fallback = VK_NULL_HANDLE;
+		VkPipeline lightCulling = VK_NULL_HANDLE;
+	} pipelines;
+
+	// Draw path and lighting toggles a frame is rendered with, the benchmark runs all supported ones in turn
+	struct Configuration {
+		std::string name;
+		bool indirect;
+		bool culling;
+		bool clustered;
+		// Device memory of the scene resources the configuration uses
+		VkDeviceSize memory = 0;
+		// Accumulated over the benchmark phase
+		double cpuTime = 0.0;
+		uint64_t cpuFrames = 0;
+		double gpuTime = 0.0;
+		uint64_t gpuFrames = 0;
+		size_t cpuMetric = 0;
+		size_t gpuMetric = 0;
+		size_t memoryMetric = 0;
+	};
+	std::vector<Configuration> configurations;
+	// Configuration the command buffer of each swap chain image was last recorded with, -1 if none
+	std::vector<int32_t> recordedConfigurations;
+	const uint32_t benchmarkFramesPerConfiguration = 500;
+	uint32_t benchmarkFrame = 0;
+	// Device memory of the resources shared by all configurations and of the optional parts of the GPU driven path
+	struct {
+		VkDeviceSize scene = 0;
+		VkDeviceSize indirect = 0;
+		VkDeviceSize culling = 0;
+		VkDeviceSize clusters = 0;
+	} memoryUsage;
+	// CPU time of the last frame's command buffer recording and submission in ms
+	double lastCpuTime = 0.0;
+
+	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
+	{
+		title = "Scene scale stress test";
+		supportsFramesInFlight = true;
+		camera.type = Camera::CameraType::firstperson;
+		camera.flipY = true;
+		camera.setPosition(glm::vec3(0.0f, 6.0f, 0.0f));
+		camera.setRotation(glm::vec3(-10.0f, 0.0f, 0.0f));
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 512.0f);
+		camera.movementSpeed = 20.0f;
+		apiVersion = VK_API_VERSION_1_1;
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		commandLineParser.add("placementcount", { "-pc", "--placementcount" }, 1, "Set the number of model copies in the scene (default 20000)");
+		commandLineParser.add("lightcount", { "-lc", "--lightcount" }, 1, "Set the number of point lights in the scene (default 512)");
+		commandLineParser.parse(args);
+		placementCount = static_cast<uint32_t>(std::max(commandLineParser.getValueAsInt("placementcount", placementCount), 1));
+		lightCount = static_cast<uint32_t>(std::max(commandLineParser.getValueAsInt("lightcount", lightCount), 1));
+	}
+
+	~VulkanExample()
+	{
+		if (device) {
+			vkDestroyPipeline(device, pipelines.indirect, nullptr);
+			vkDestroyPipeline(device, pipelines.fallback, nullptr);
+			vkDestroyPipeline(device, pipelines.lightCulling, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayouts.indirect, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayouts.fallback, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayouts.lightCulling, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+			for (FrameResources& frame : frameResources) {
+				frame.uniformBuffer.destroy();
+				frame.lights.destroy();
+				frame.clusters.destroy();
+			}
+			placementBuffer.destroy();
+			for (Archetype& archetype : archetypes) {
+				delete archetype.culling;
+				delete archetype.skinning;
+			}
+		}
+		printResults();
+	}
+
+	virtual void getEnabledFeatures()
+	{
+		enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+		// The draw data of the indirect path is found with the first instance of each draw
+		enabledFeatures.drawIndirectFirstInstance = deviceFeatures.drawIndirectFirstInstance;
+		enabledFeatures.multiDrawIndirect = deviceFeatures.multiDrawIndirect;
+		// The material index is the same for a whole draw, so the bindless texture array is only indexed with dynamically uniform values
+		enabledFeatures.shaderSampledImageArrayDynamicIndexing = deviceFeatures.shaderSampledImageArrayDynamicIndexing;
+	}
+
+	virtual void getEnabledExtensions()
+	{
+		// Bindless materials need descriptor indexing with runtime sized arrays
+		if (deviceFeatures.drawIndirectFirstInstance && deviceFeatures.shaderSampledImageArrayDynamicIndexing && vulkanDevice->extensionSupported(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) && vulkanDevice->extensionSupported(VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+			VkPhysicalDeviceShaderDrawParametersFeatures supportedDrawParameters{};
+			supportedDrawParameters.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES;
+			VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedFeatures{};
+			supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+			supportedFeatures.pNext = &supportedDrawParameters;
+			VkPhysicalDeviceFeatures2 features2{};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features2.pNext = &supportedFeatures;
+			vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+			indirectSupported = supportedFeatures.runtimeDescriptorArray && supportedFeatures.descriptorBindingVariableDescriptorCount;
+			// The HLSL version of the indirect vertex shader reads the first instance of the draw with the BaseInstance built-in
+			if (indirectSupported && supportedDrawParameters.shaderDrawParameters) {
+				enabledShaderDrawParametersFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES;
+				enabledShaderDrawParametersFeatures.shaderDrawParameters = VK_TRUE;
+				enabledShaderDrawParametersFeatures.pNext = deviceCreatepNextChain;
+				deviceCreatepNextChain = &enabledShaderDrawParametersFeatures;
+			}
+		}
+		if (indirectSupported) {
+			enabledDeviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+			enabledDeviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+			enabledDescriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+			enabledDescriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+			enabledDescriptorIndexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+			enabledDescriptorIndexingFeatures.pNext = deviceCreatepNextChain;
+			deviceCreatepNextChain = &enabledDescriptorIndexingFeatures;
+			// Culled draws are compacted if the draw count can be read from a buffer
+			if (vulkanDevice->extensionSupported(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+				enabledDeviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+			}
+		}
+		// The node matrices of the vkglTF::Model::draw path are pushed along with the material images
+		fallbackSupported = vulkanDevice->extensionSupported(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+		if (fallbackSupported) {
+			enabledDeviceExtensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+		}
+	}
+
+	// Sum of the device memory allocated by a function
+	VkDeviceSize measureMemory(const std::function<void()>& function)
+	{
+		const VkDeviceSize before = vulkanDevice->memoryTracker.getTotalBytes();
+		function();
+		const VkDeviceSize after = vulkanDevice->memoryTracker.getTotalBytes();
+		return (after > before) ? after - before : 0;
+	}
+
+	void loadAssets()
+	{
+		// The skinning pass copies the model's vertices into its output buffer, which needs transfer source usage
+		vkglTF::memoryPropertyFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		// Vertices can't be pre-transformed, the node matrices are applied by the shaders (and the skinning pass works in the space of each mesh's node)
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreMultiplyVertexColors;
+		archetypes = std::vector<Archetype>(archetypeInfos.size());
+		memoryUsage.scene += measureMemory([&]() {
+			for (size_t i = 0; i < archetypes.size(); i++) {
+				Archetype& archetype = archetypes[i];
+				const std::string file = getAssetPath() + archetypeInfos[i].file;
+				archetype.model.loadFromFile(file, vulkanDevice, queue, glTFLoadingFlags | (archetypeInfos[i].skinned ? vkglTF::FileLoadingFlags::CompactAnimations : 0));
+				if (archetypeInfos[i].skinned) {
+					archetype.skinning = new vkglTF::ComputeSkinning(vulkanDevice, archetype.model, getShadersPath() + "base/skinning.comp.spv", settings.framesInFlight);
+					if (!archetype.skinning->isSupported()) {
+						std::cout << "Compute skinning is not available for " << archetypeInfos[i].file << ", it is drawn in its bind pose\n";
+					}
+				}
+				if (fallbackSupported) {
+					fallbackSupported = archetype.model.preparePushDescriptors();
+				}
+			}
+		});
+	}
+
+	// Scatter the copies of the archetypes on a grid, with a random archetype, rotation and small offset per cell
+	void generatePlacements()
+	{
+		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
+		std::uniform_int_distribution<uint32_t> rndArchetype(0, static_cast<uint32_t>(archetypes.size()) - 1);
+		std::uniform_real_distribution<float> rndAngle(0.0f, glm::two_pi<float>());
+		std::uniform_real_distribution<float> rndOffset(-0.75f, 0.75f);
+		const uint32_t gridSize = static_cast<uint32_t>(ceil(sqrt(static_cast<float>(placementCount))));
+		const float spacing = 5.0f;
+		for (uint32_t i = 0; i < placementCount; i++) {
+			Archetype& archetype = archetypes[rndArchetype(rndEngine)];
+			const vkglTF::Model::Dimensions& dimensions = archetype.model.dimensions;
+			const float extent = std::max(std::max(dimensions.size.x, dimensions.size.y), dimensions.size.z);
+			const float scale = archetypeInfos[&archetype - archetypes.data()].size / std::max(extent, FLT_MIN);
+			const glm::vec3 position = glm::vec3((static_cast<float>(i % gridSize) - gridSize * 0.5f + rndOffset(rndEngine)) * spacing, 0.0f, (static_cast<float>(i / gridSize) - gridSize * 0.5f + rndOffset(rndEngine)) * spacing);
+			// The model stands on the ground plane, centered on its cell
+			glm::mat4 placement = glm::translate(glm::mat4(1.0f), position);
+			placement = glm::rotate(placement, rndAngle(rndEngine), glm::vec3(0.0f, 1.0f, 0.0f));
+			placement = glm::scale(placement, glm::vec3(scale));
+			placement = glm::translate(placement, -glm::vec3(dimensions.center.x, dimensions.min.y, dimensions.center.z));
+			archetype.placements.push_back(placement);
+		}
+		std::vector<glm::mat4> allPlacements;
+		for (Archetype& archetype : archetypes) {
+			archetype.firstPlacement = static_cast<uint32_t>(allPlacements.size());
+			allPlacements.insert(allPlacements.end(), archetype.placements.begin(), archetype.placements.end());
+		}
+		memoryUsage.scene += measureMemory([&]() {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&placementBuffer,
+				allPlacements.size() * sizeof(glm::mat4),
+				allPlacements.data()));
+		});
+	}
+
+	// Prepare the multi draw indirect buffers, the bindless materials and the culling pass of every archetype with at least one copy
+	void prepareIndirect()
+	{
+		memoryUsage.indirect = measureMemory([&]() {
+			for (Archetype& archetype : archetypes) {
+				if (archetype.placements.empty()) {
+					continue;
+				}
+				archetype.model.setIndirectPlacements(archetype.placements);
+				archetype.model.prepareIndirectDraw(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+				archetype.model.prepareBindless();
+			}
+		});
+		memoryUsage.culling = measureMemory([&]() {
+			cullingSupported = true;
+			for (Archetype& archetype : archetypes) {
+				if (archetype.placements.empty()) {
+					continue;
+				}
+				archetype.culling = new vkglTF::GpuCulling(vulkanDevice, archetype.model, getShadersPath() + "base/cull.comp.spv", settings.framesInFlight);
+				cullingSupported &= archetype.culling->isSupported();
+			}
+		});
+		gpuCulling &= cullingSupported;
+	}
+
+	// Point lights moving on small circles above the grid
+	void prepareLights()
+	{
+		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
+		const float extent = ceil(sqrt(static_cast<float>(placementCount))) * 5.0f * 0.5f;
+		std::uniform_real_distribution<float> rndPosition(-extent, extent);
+		std::uniform_real_distribution<float> rndHeight(1.0f, 4.0f);
+		std::uniform_real_distribution<float> rndRange(6.0f, 14.0f);
+		std::uniform_real_distribution<float> rndColor(0.2f, 1.0f);
+		std::uniform_real_distribution<float> rndUnit(0.0f, 1.0f);
+		lights.resize(lightCount);
+		lightPaths.resize(lightCount);
+		for (uint32_t i = 0; i < lightCount; i++) {
+			lightPaths[i].center = glm::vec3(rndPosition(rndEngine), rndHeight(rndEngine), rndPosition(rndEngine));
+			lightPaths[i].radius = 1.0f + rndUnit(rndEngine) * 4.0f;
+			lightPaths[i].speed = (rndUnit(rndEngine) - 0.5f) * 2.0f;
+			lightPaths[i].phase = rndUnit(rndEngine) * glm::two_pi<float>();
+			lights[i].position = glm::vec4(lightPaths[i].center, rndRange(rndEngine));
+			lights[i].color = glm::vec4(rndColor(rndEngine), rndColor(rndEngine), rndColor(rndEngine), 0.0f) * 1.5f;
+		}
+	}
+
+	void prepareFrameResources()
+	{
+		frameResources.resize(settings.framesInFlight);
+		for (FrameResources& frame : frameResources) {
+			memoryUsage.scene += measureMemory([&]() {
+				VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame.uniformBuffer, sizeof(UniformData)));
+				VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame.lights, lightCount * sizeof(Light)));
+			});
+			// Cluster light lists, only accessed by the GPU
+			memoryUsage.clusters += measureMemory([&]() {
+				VK_CHECK_RESULT(vulkanDevice->createBuffer(
+					VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+					&frame.clusters,
+					CLUSTER_X * CLUSTER_Y * CLUSTER_Z * (MAX_LIGHTS_PER_CLUSTER + 1) * sizeof(uint32_t)));
+			});
+		}
+	}
+
+	void setupDescriptors()
+	{
+		const uint32_t frameCount = static_cast<uint32_t>(frameResources.size());
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frameCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frameCount * 3)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, frameCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+		// The scene set is shared by both draw paths and the light culling pass
+		const VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0 : Scene uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, stages, 0),
+			// Binding 1 : Lights
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, 1),
+			// Binding 2 : Cluster light lists
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, 2),
+			// Binding 3 : Placement matrices
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, 3),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+		for (FrameResources& frame : frameResources) {
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &frame.descriptorSet));
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &frame.uniformBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &frame.lights.descriptor),
+				vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &frame.clusters.descriptor),
+				vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &placementBuffer.descriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+	}
+
+	void preparePipelines()
+	{
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		// Foliage is drawn from both sides, so faces aren't culled
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(VK_NULL_HANDLE, renderPass);
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color });
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+
+		if (indirectSupported) {
+			// The indirect draw and bindless set layouts are the same for all models, so the sets of every archetype can be bound with the first one's layouts
+			const vkglTF::Model& model = archetypes[0].model;
+			std::array<VkDescriptorSetLayout, 3> setLayouts = { descriptorSetLayout, model.indirect.descriptorSetLayout, model.bindless.descriptorSetLayout };
+			VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, 2 * sizeof(uint32_t), 0);
+			VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
+			pipelineLayoutCI.pushConstantRangeCount = 1;
+			pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.indirect));
+			pipelineCI.layout = pipelineLayouts.indirect;
+			shaderStages[0] = loadShader(getShadersPath() + "scenestress/indirect.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			shaderStages[1] = loadShader(getShadersPath() + "scenestress/indirect.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.indirect));
+		}
+
+		if (fallbackSupported) {
+			// The placement index is followed by the node data pushed by vkglTF::Model::draw
+			for (Archetype& archetype : archetypes) {
+				archetype.model.pushDescriptors.nodeDataStages = VK_SHADER_STAGE_VERTEX_BIT;
+				archetype.model.pushDescriptors.nodeDataOffset = 16;
+			}
+			std::array<VkDescriptorSetLayout, 2> setLayouts = { descriptorSetLayout, archetypes[0].model.pushDescriptors.materialLayout };
+			VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, 16 + sizeof(vkglTF::Model::PushNodeData), 0);
+			VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
+			pipelineLayoutCI.pushConstantRangeCount = 1;
+			pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.fallback));
+			pipelineCI.layout = pipelineLayouts.fallback;
+			shaderStages[0] = loadShader(getShadersPath() + "scenestress/fallback.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			shaderStages[1] = loadShader(getShadersPath() + "scenestress/fallback.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.fallback));
+		}
+
+		// Light culling
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.lightCulling));
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayouts.lightCulling, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "scenestress/clusters.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.lightCulling));
+	}
+
+	// All supported combinations of the draw path, GPU culling and clustered lighting
+	void prepareConfigurations()
+	{
+		for (uint32_t i = 0; i < 6; i++) {
+			Configuration configuration;
+			configuration.indirect = i >= 2;
+			configuration.culling = i >= 4;
+			configuration.clustered = (i % 2) == 1;
+			if ((configuration.indirect && !indirectSupported) || (!configuration.indirect && !fallbackSupported) || (configuration.culling && !cullingSupported)) {
+				continue;
+			}
+			configuration.name = std::string(configuration.indirect ? (configuration.culling ? "GPU culling + MDI" : "MDI") : "Model::draw") + (configuration.clustered ? ", clustered lights" : ", all lights");
+			configuration.memory = memoryUsage.scene + (configuration.indirect ? memoryUsage.indirect : 0) + (configuration.culling ? memoryUsage.culling : 0) + (configuration.clustered ? memoryUsage.clusters : 0);
+			// Registered up front, so updating the values doesn't allocate while benchmarking
+			configuration.cpuMetric = benchmark.addMetric(configuration.name + ": CPU record and submit (ms)");
+			configuration.gpuMetric = benchmark.addMetric(configuration.name + ": GPU frame (ms)");
+			configuration.memoryMetric = benchmark.addMetric(configuration.name + ": device memory (MB)");
+			benchmark.metrics[configuration.memoryMetric].second = static_cast<double>(configuration.memory) / (1024.0 * 1024.0);
+			configurations.push_back(configuration);
+		}
+		recordedConfigurations.resize(drawCmdBuffers.size(), -1);
+	}
+
+	// Index of the configuration matching the current toggles
+	int32_t currentConfiguration() const
+	{
+		for (size_t i = 0; i < configurations.size(); i++) {
+			const Configuration& configuration = configurations[i];
+			if ((configuration.indirect == indirectDraws) && (configuration.culling == (indirectDraws && gpuCulling)) && (configuration.clustered == clusteredLighting)) {
+				return static_cast<int32_t>(i);
+			}
+		}
+		return -1;
+	}
+
+	void updateLights()
+	{
+		for (uint32_t i = 0; i < lightCount; i++) {
+			const LightPath& path = lightPaths[i];
+			const float angle = path.phase + animationTime * path.speed;
+			lights[i].position.x = path.center.x + sin(angle) * path.radius;
+			lights[i].position.y = path.center.y;
+			lights[i].position.z = path.center.z + cos(angle) * path.radius;
+		}
+		memcpy(frameResources[currentFrame].lights.mapped, lights.data(), lights.size() * sizeof(Light));
+	}
+
+	void updateUniformBuffers()
+	{
+		uniformData.projection = camera.matrices.perspective;
+		uniformData.view = camera.matrices.view;
+		uniformData.invProjection = glm::inverse(camera.matrices.perspective);
+		uniformData.viewPos = camera.viewPos;
+		uniformData.renderExtent = glm::ivec2(width, height);
+		uniformData.lightCount = lightCount;
+		uniformData.clustered = clusteredLighting ? 1 : 0;
+		uniformData.zNear = camera.getNearClip();
+		uniformData.zFar = camera.getFarClip();
+		memcpy(frameResources[currentFrame].uniformBuffer.mapped, &uniformData, sizeof(UniformData));
+	}
+
+	// Advance the shared pose of the skinned archetype, the frame's joint palette is consumed by its skinning pass
+	void updateAnimation()
+	{
+		if (!paused) {
+			animationTime += frameTimer;
+		}
+		for (Archetype& archetype : archetypes) {
+			if (!archetype.skinning || archetype.model.animations.empty()) {
+				continue;
+			}
+			const vkglTF::Animation& animation = archetype.model.animations[0];
+			const float duration = animation.end - animation.start;
+			archetype.model.updateAnimation(0, animation.start + (duration > 0.0f ? fmod(animationTime, duration) : 0.0f));
+			archetype.skinning->update(currentFrame);
+		}
+	}
+
+	// The archetypes share the vertex input bindings, so each one's buffers are bound before its draws in every frame (a model only binds them on its first draw)
+	void bindBuffers(VkCommandBuffer commandBuffer, Archetype& archetype)
+	{
+		if (archetype.skinning) {
+			archetype.skinning->bindBuffers(commandBuffer, currentFrame);
+		}
+		else {
+			archetype.model.bindBuffers(commandBuffer);
+		}
+	}
+
+	void recordCommandBuffer(const Configuration& configuration)
+	{
+		VkCommandBuffer commandBuffer = drawCmdBuffers[currentBuffer];
+		FrameResources& frame = frameResources[currentFrame];
+		// GPU times are logged per configuration, so the benchmark results of all configurations can be compared
+		const std::string suffix = " (" + configuration.name + ")";
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+		benchmark.gpuProfiler.reset(commandBuffer, currentBuffer);
+
+		// Passes outside of the render pass: skinning, culling and light culling
+		benchmark.gpuProfiler.beginScope(commandBuffer, currentBuffer, "Skinning" + suffix);
+		for (Archetype& archetype : archetypes) {
+			if (archetype.skinning) {
+				archetype.skinning->record(commandBuffer, currentFrame);
+			}
+		}
+		benchmark.gpuProfiler.endScope(commandBuffer, currentBuffer);
+		if (configuration.culling) {
+			benchmark.gpuProfiler.beginScope(commandBuffer, currentBuffer, "Culling" + suffix);
+			for (Archetype& archetype : archetypes) {
+				if (archetype.culling) {
+					archetype.culling->record(commandBuffer, currentFrame);
+				}
+			}
+			benchmark.gpuProfiler.endScope(commandBuffer, currentBuffer);
+		}
+		if (configuration.clustered) {
+			benchmark.gpuProfiler.beginScope(commandBuffer, currentBuffer, "Light culling" + suffix);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.lightCulling);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayouts.lightCulling, 0, 1, &frame.descriptorSet, 0, nullptr);
+			// One work group per screen tile, looping over the tile's depth slices
+			vkCmdDispatch(commandBuffer, CLUSTER_X, CLUSTER_Y, 1);
+			benchmark.gpuProfiler.endScope(commandBuffer, currentBuffer);
+			// The scene pass reads the light lists
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = frame.clusters.buffer;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+		}
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.05f, 0.05f, 0.08f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[currentBuffer];
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		benchmark.gpuProfiler.beginScope(commandBuffer, currentBuffer, "Scene" + suffix);
+		if (configuration.indirect) {
+			// A few indirect draws per archetype, independent of the number of copies
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.indirect);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.indirect, 0, 1, &frame.descriptorSet, 0, nullptr);
+			for (Archetype& archetype : archetypes) {
+				if (archetype.placements.empty()) {
+					continue;
+				}
+				const uint32_t pushConstants[2] = { archetype.firstPlacement, static_cast<uint32_t>(archetype.model.indirect.transformSources.size() / archetype.placements.size()) };
+				vkCmdPushConstants(commandBuffer, pipelineLayouts.indirect, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), pushConstants);
+				bindBuffers(commandBuffer, archetype);
+				if (configuration.culling) {
+					archetype.model.drawIndirect(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayouts.indirect, 1, archetype.culling->getCommandBuffer(currentFrame), archetype.culling->getCountBuffer(currentFrame));
+				}
+				else {
+					archetype.model.drawIndirect(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayouts.indirect, 1);
+				}
+			}
+		}
+		else {
+			// One draw per primitive and copy, with the node data and material images recorded per draw
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.fallback);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.fallback, 0, 1, &frame.descriptorSet, 0, nullptr);
+			for (Archetype& archetype : archetypes) {
+				bindBuffers(commandBuffer, archetype);
+				for (uint32_t i = 0; i < static_cast<uint32_t>(archetype.placements.size()); i++) {
+					const uint32_t placement = archetype.firstPlacement + i;
+					vkCmdPushConstants(commandBuffer, pipelineLayouts.fallback, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t), &placement);
+					archetype.model.draw(commandBuffer, vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::UsePushDescriptors, pipelineLayouts.fallback, 1);
+				}
+			}
+		}
+		benchmark.gpuProfiler.endScope(commandBuffer, currentBuffer);
+
+		drawUI(commandBuffer);
+		vkCmdEndRenderPass(commandBuffer);
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	// Accumulate the GPU times of the frame that last used the acquired image's command buffer to the configuration it was recorded with
+	void collectGpuTimes()
+	{
+		const int32_t recorded = recordedConfigurations[currentBuffer];
+		if ((recorded < 0) || !benchmark.gpuProfiler.supported || benchmark.gpuProfiler.results.empty()) {
+			return;
+		}
+		double frameTime = 0.0;
+		for (const auto& result : benchmark.gpuProfiler.results) {
+			frameTime += result.second;
+		}
+		configurations[recorded].gpuTime += frameTime;
+		configurations[recorded].gpuFrames++;
+	}
+
+	void resetResults()
+	{
+		for (Configuration& configuration : configurations) {
+			configuration.cpuTime = 0.0;
+			configuration.cpuFrames = 0;
+			configuration.gpuTime = 0.0;
+			configuration.gpuFrames = 0;
+		}
+	}
+
+	void updateMetrics()
+	{
+		for (const Configuration& configuration : configurations) {
+			benchmark.metrics[configuration.cpuMetric].second = (configuration.cpuFrames > 0) ? configuration.cpuTime / static_cast<double>(configuration.cpuFrames) : 0.0;
+			benchmark.metrics[configuration.gpuMetric].second = (configuration.gpuFrames > 0) ? configuration.gpuTime / static_cast<double>(configuration.gpuFrames) : 0.0;
+		}
+	}
+
+	void printResults()
+	{
+		if (!benchmark.active || configurations.empty()) {
+			return;
+		}
+		std::cout << std::fixed << std::setprecision(3);
+		std::cout << "Scene stress test (" << placementCount << " model copies, " << lightCount << " lights):" << "\n";
+		for (const Configuration& configuration : configurations) {
+			std::cout << "  " << configuration.name << ": ";
+			if (configuration.cpuFrames > 0) {
+				std::cout << "CPU " << configuration.cpuTime / static_cast<double>(configuration.cpuFrames) << " ms";
+			}
+			else {
+				std::cout << "not run";
+			}
+			if (configuration.gpuFrames > 0) {
+				std::cout << ", GPU " << configuration.gpuTime / static_cast<double>(configuration.gpuFrames) << " ms";
+			}
+			std::cout << ", memory " << static_cast<double>(configuration.memory) / (1024.0 * 1024.0) << " MB" << "\n";
+		}
+	}
+
+	void draw()
+	{
+		VulkanExampleBase::prepareFrame();
+		// Only the benchmark phase is measured
+		if (benchmark.active && !benchmark.warmingUp && (benchmark.phaseFrame == 0)) {
+			resetResults();
+		}
+		collectGpuTimes();
+		// Toggles without a matching configuration (e.g. a part of the GPU driven path the device doesn't support) fall back to the first one
+		const int32_t configurationIndex = std::max(currentConfiguration(), 0);
+		Configuration& configuration = configurations[configurationIndex];
+		updateAnimation();
+		updateLights();
+		updateUniformBuffers();
+		if (configuration.culling) {
+			for (Archetype& archetype : archetypes) {
+				if (archetype.culling) {
+					archetype.culling->update(currentFrame, camera.matrices.perspective, camera.matrices.view, glm::vec3(camera.viewPos));
+				}
+			}
+		}
+		// Recording and submitting the frame is the CPU cost the GPU driven path reduces
+		const auto tStart = std::chrono::high_resolution_clock::now();
+		recordCommandBuffer(configuration);
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
+		lastCpuTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		configuration.cpuTime += lastCpuTime;
+		configuration.cpuFrames++;
+		recordedConfigurations[currentBuffer] = configurationIndex;
+		VulkanExampleBase::submitFrame();
+		if (benchmark.active) {
+			updateMetrics();
+		}
+	}
+
+	void prepare()
+	{
+		VulkanExampleBase::prepare();
+		loadAssets();
+		if (!indirectSupported && !fallbackSupported) {
+			vks::tools::exitFatal("The device supports neither multi draw indirect with bindless materials nor push descriptors, which are required by this example", VK_ERROR_FEATURE_NOT_PRESENT);
+			return;
+		}
+		generatePlacements();
+		if (indirectSupported) {
+			prepareIndirect();
+		}
+		indirectDraws = indirectSupported;
+		prepareLights();
+		prepareFrameResources();
+		setupDescriptors();
+		preparePipelines();
+		prepareConfigurations();
+		prepared = true;
+	}
+
+	virtual void render()
+	{
+		if (!prepared)
+			return;
+		// The benchmark is run for all configurations in turn
+		if (benchmark.active) {
+			const Configuration& configuration = configurations[(benchmarkFrame / benchmarkFramesPerConfiguration) % configurations.size()];
+			indirectDraws = configuration.indirect;
+			gpuCulling = configuration.culling;
+			clusteredLighting = configuration.clustered;
+			benchmarkFrame++;
+		}
+		draw();
+	}
+
+	virtual void buildCommandBuffers()
+	{
+		// Command buffers are recorded every frame
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			if (indirectSupported && fallbackSupported) {
+				overlay->checkBox("Multi draw indirect + bindless", &indirectDraws);
+			}
+			if (indirectDraws && cullingSupported) {
+				overlay->checkBox("GPU culling", &gpuCulling);
+			}
+			overlay->checkBox("Clustered lighting", &clusteredLighting);
+		}
+		if (overlay->header("Statistics")) {
+			overlay->text("Model copies: %u", placementCount);
+			overlay->text("Lights: %u", lightCount);
+			overlay->text("Record + submit: %.3f ms", lastCpuTime);
+			const int32_t configurationIndex = currentConfiguration();
+			if (configurationIndex >= 0) {
+				overlay->text("Device memory: %.1f MB", static_cast<double>(configurations[configurationIndex].memory) / (1024.0 * 1024.0));
+			}
+		}
+	}
+};
+
+VULKAN_EXAMPLE_MAIN()
@@ -37,6 +37,26 @@ public:
 	int32_t displayDepthMapCascadeIndex = 0;
 	bool colorCascades = false;
 	bool filterPCF = false;
+	// Reuse the cascade shadow maps of previous frames, a cascade is only re-rendered once the camera left the area it covers
+	// or, at a rate halving with each cascade, when the light moved
+	// The static casters are kept in a separate layer, the dynamic casters are drawn over a copy of it at the same halving rates
+	bool cacheCascades = false;
+	// Cached cascades cover this fraction of their radius around the slice, the camera can move that far before they have to be re-rendered
+	float cacheMargin = 0.1f;
+	// Number of updateCascades() calls, the update intervals of cached cascades are counted in these
+	uint32_t cascadeUpdateCount = 0;
+	uint32_t renderedCascades = SHADOW_MAP_CASCADE_COUNT;
+	uint32_t renderedStaticLayers = 0;
+
+	// Offset of the tree moving through the scene, the only dynamic shadow caster
+	glm::vec4 dynamicCasterOffset = glm::vec4(0.0f);
+
+	// Casters drawn by renderScene()
+	enum Casters {
+		StaticCasters = 0x1,
+		DynamicCasters = 0x2,
+		AllCasters = StaticCasters | DynamicCasters
+	};
 
 	float cascadeSplitLambda = 0.95f;
 
@@ -59,6 +79,7 @@ public:
 		glm::mat4 projection;
 		glm::mat4 view;
 		glm::mat4 model;
+		glm::vec4 dynamicCasterOffset;
 		glm::vec3 lightDir;
 	} uboVS;
 
@@ -85,6 +106,7 @@ public:
 
 	// For simplicity all pipelines use the same push constant block layout
 	struct PushConstBlock {
+		// xyz: position, w: weight of the dynamic caster offset
 		glm::vec4 position;
 		uint32_t cascadeIndex;
 	};
@@ -92,18 +114,23 @@ public:
 	// Resources of the depth map generation pass
 	struct DepthPass {
 		VkRenderPass renderPass;
+		// Cached mode: static casters to the static layer, and dynamic casters over the copy of the static layer in the shadow map
+		VkRenderPass staticRenderPass;
+		VkRenderPass dynamicRenderPass;
 		VkPipelineLayout pipelineLayout;
 		VkPipeline pipeline;
 		vks::Buffer uniformBuffer;
 
 		struct UniformBlock {
 			std::array<glm::mat4, SHADOW_MAP_CASCADE_COUNT> cascadeViewProjMat;
+			glm::vec4 dynamicCasterOffset;
 		} ubo;
 
 	} depthPass;
 
 	// Layered depth image containing the shadow cascade depths
 	struct DepthImage {
+		VkFormat format;
 		VkImage image;
 		VkDeviceMemory mem;
 		VkImageView view;
@@ -116,18 +143,50 @@ public:
 		}
 	} depth;
 
+	// Layered depth image with the static casters of each cascade (cached mode), copied to the cascade's shadow map layer before the dynamic casters are drawn
+	struct StaticLayer {
+		VkImage image;
+		VkDeviceMemory mem;
+		void destroy(VkDevice device) {
+			vkDestroyImage(device, image, nullptr);
+			vkFreeMemory(device, mem, nullptr);
+		}
+	} staticLayer;
+
 	// Contains all resources required for a single shadow map cascade
 	struct Cascade {
 		VkFramebuffer frameBuffer;
 		VkDescriptorSet descriptorSet;
 		VkImageView view;
+		// Layer of the static caster image (cached mode)
+		VkFramebuffer staticFrameBuffer;
+		VkImageView staticView;
+
+		// Depth pass of this cascade, one per swap chain image so it can be submitted only in frames that update the cascade
+		// In cached mode this copies the static layer and draws the dynamic casters over it
+		std::vector<VkCommandBuffer> commandBuffers;
+		// Static caster pass of this cascade (cached mode), only submitted when the cascade's matrix changed
+		std::vector<VkCommandBuffer> staticCommandBuffers;
 
 		float splitDepth;
 		glm::mat4 viewProjMatrix;
 
+		// Set if the matrix changed and the cascade has to be rendered with the next frame
+		bool update = true;
+		// Set if only the dynamic casters have to be drawn again (cached mode)
+		bool updateDynamic = false;
+		uint32_t lastDynamicUpdate = 0;
+		// Slice center and light direction the shadow map has last been rendered with (cached mode)
+		bool cached = false;
+		glm::vec3 cachedCenter;
+		glm::vec3 cachedLightDir;
+		uint32_t lastUpdate = 0;
+
 		void destroy(VkDevice device) {
 			vkDestroyImageView(device, view, nullptr);
 			vkDestroyFramebuffer(device, frameBuffer, nullptr);
+			vkDestroyImageView(device, staticView, nullptr);
+			vkDestroyFramebuffer(device, staticFrameBuffer, nullptr);
 		}
 	};
 	std::array<Cascade, SHADOW_MAP_CASCADE_COUNT> cascades;
@@ -148,10 +207,17 @@ public:
 	{
 		for (auto cascade : cascades) {
 			cascade.destroy(device);
+			if (!cascade.commandBuffers.empty()) {
+				vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(cascade.commandBuffers.size()), cascade.commandBuffers.data());
+				vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(cascade.staticCommandBuffers.size()), cascade.staticCommandBuffers.data());
+			}
 		}
 		depth.destroy(device);
+		staticLayer.destroy(device);
 
 		vkDestroyRenderPass(device, depthPass.renderPass, nullptr);
+		vkDestroyRenderPass(device, depthPass.staticRenderPass, nullptr);
+		vkDestroyRenderPass(device, depthPass.dynamicRenderPass, nullptr);
 
 		vkDestroyPipeline(device, pipelines.debugShadowMap, nullptr);
 		vkDestroyPipeline(device, depthPass.pipeline, nullptr);
@@ -178,29 +244,40 @@ public:
 	/*
 		Render the example scene with given command buffer, pipeline layout and descriptor set
 		Used by the scene rendering and depth pass generation command buffer
+		The dynamic caster is moved by the offset in the uniform buffer, so the command buffers don't have to be recorded again while it moves
 	*/
-	void renderScene(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet, uint32_t cascadeIndex = 0) {
+	void renderScene(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet, uint32_t cascadeIndex = 0, uint32_t casters = AllCasters) {
 		// We use push constants for passing shadow cascade info to the shaders
 		PushConstBlock pushConstBlock = { glm::vec4(0.0f), cascadeIndex };
 
 		// Set 0 contains the vertex and fragment shader uniform buffers, set 1 for images will be set by the glTF model class at draw time
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 
-		// Floor
-		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
-		models.terrain.draw(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayout);
-
-		// Trees
-		const std::vector<glm::vec3> positions = {
-			glm::vec3(0.0f, 0.0f, 0.0f),
-			glm::vec3(1.25f, 0.25f, 1.25f),
-			glm::vec3(-1.25f, -0.2f, 1.25f),
-			glm::vec3(1.25f, 0.1f, -1.25f),
-			glm::vec3(-1.25f, -0.25f, -1.25f),
-		};
+		if (casters & StaticCasters) {
+			// Floor
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
+			models.terrain.draw(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayout);
+
+			// Trees
+			const std::vector<glm::vec3> positions = {
+				glm::vec3(0.0f, 0.0f, 0.0f),
+				glm::vec3(1.25f, 0.25f, 1.25f),
+				glm::vec3(-1.25f, -0.2f, 1.25f),
+				glm::vec3(1.25f, 0.1f, -1.25f),
+				glm::vec3(-1.25f, -0.25f, -1.25f),
+			};
+
+			for (auto position : positions) {
+				pushConstBlock.position = glm::vec4(position, 0.0f);
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+				models.tree.draw(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayout);
+			}
+		}
 
-		for (auto position : positions) {
-			pushConstBlock.position = glm::vec4(position, 0.0f);
+		if (casters & DynamicCasters) {
+			// Moving tree, placed by the dynamic caster offset
+			pushConstBlock.position = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
 			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 			models.tree.draw(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayout);
@@ -208,26 +285,20 @@ public:
 	}
 
 	/*
-		Setup resources used by the depth pass
-		The depth image is layered with each layer storing one shadow map cascade
+		Depth only render pass for the shadow map passes
+		Cached cascades use variants that leave the static layer ready for copying and draw the dynamic casters over the copied layer
 	*/
-	void prepareDepthPass()
+	VkRenderPass createDepthRenderPass(VkAttachmentLoadOp loadOp, VkImageLayout initialLayout, VkImageLayout finalLayout)
 	{
-		VkFormat depthFormat = vulkanDevice->getSupportedDepthFormat(true);
-
-		/*
-			Depth map renderpass
-		*/
-
 		VkAttachmentDescription attachmentDescription{};
-		attachmentDescription.format = depthFormat;
+		attachmentDescription.format = depth.format;
 		attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-		attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachmentDescription.loadOp = loadOp;
 		attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		attachmentDescription.initialLayout = initialLayout;
+		attachmentDescription.finalLayout = finalLayout;
 
 		VkAttachmentReference depthReference = {};
 		depthReference.attachment = 0;
@@ -238,24 +309,40 @@ public:
 		subpass.colorAttachmentCount = 0;
 		subpass.pDepthStencilAttachment = &depthReference;
 
+		// Stage and access of the operation a layout hands the image over to, sampling in the scene pass or copying the static layer
+		auto getLayoutAccess = [](VkImageLayout layout, VkPipelineStageFlags &stageMask, VkAccessFlags &accessMask) {
+			switch (layout) {
+			case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+				stageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+				accessMask = VK_ACCESS_TRANSFER_READ_BIT;
+				break;
+			case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+				stageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+				accessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				break;
+			default:
+				stageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+				accessMask = VK_ACCESS_SHADER_READ_BIT;
+			}
+		};
+
 		// Use subpass dependencies for layout transitions
 		std::array<VkSubpassDependency, 2> dependencies;
 
+		// A cleared image was last used the way the pass leaves it, e.g. read by the previous frame
+		getLayoutAccess((initialLayout != VK_IMAGE_LAYOUT_UNDEFINED) ? initialLayout : finalLayout, dependencies[0].srcStageMask, dependencies[0].srcAccessMask);
 		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = (dependencies[0].srcStageMask == VK_PIPELINE_STAGE_TRANSFER_BIT) ? 0 : VK_DEPENDENCY_BY_REGION_BIT;
 
+		getLayoutAccess(finalLayout, dependencies[1].dstStageMask, dependencies[1].dstAccessMask);
 		dependencies[1].srcSubpass = 0;
 		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 		dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		dependencies[1].dependencyFlags = (dependencies[1].dstStageMask == VK_PIPELINE_STAGE_TRANSFER_BIT) ? 0 : VK_DEPENDENCY_BY_REGION_BIT;
 
 		VkRenderPassCreateInfo renderPassCreateInfo = vks::initializers::renderPassCreateInfo();
 		renderPassCreateInfo.attachmentCount = 1;
@@ -265,7 +352,26 @@ public:
 		renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 		renderPassCreateInfo.pDependencies = dependencies.data();
 
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &depthPass.renderPass));
+		VkRenderPass renderPass;
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass));
+		return renderPass;
+	}
+
+	/*
+		Setup resources used by the depth pass
+		The depth image is layered with each layer storing one shadow map cascade
+	*/
+	void prepareDepthPass()
+	{
+		depth.format = vulkanDevice->getSupportedDepthFormat(true);
+
+		/*
+			Depth map renderpasses
+		*/
+
+		depthPass.renderPass = createDepthRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+		depthPass.staticRenderPass = createDepthRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		depthPass.dynamicRenderPass = createDepthRenderPass(VK_ATTACHMENT_LOAD_OP_LOAD, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
 
 		/*
 			Layered depth image and views
@@ -280,8 +386,9 @@ public:
 		imageInfo.arrayLayers = SHADOW_MAP_CASCADE_COUNT;
 		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageInfo.format = depthFormat;
-		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.format = depth.format;
+		// Cached cascades are filled with a copy of their static layer
+		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageInfo, nullptr, &depth.image));
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
@@ -290,10 +397,18 @@ public:
 		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &depth.mem));
 		VK_CHECK_RESULT(vkBindImageMemory(device, depth.image, depth.mem, 0));
+		// Static caster layers, only written by the depth passes and read by copies
+		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageInfo, nullptr, &staticLayer.image));
+		vkGetImageMemoryRequirements(device, staticLayer.image, &memReqs);
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &staticLayer.mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, staticLayer.image, staticLayer.mem, 0));
 		// Full depth map view (all layers)
 		VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
 		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
-		viewInfo.format = depthFormat;
+		viewInfo.format = depth.format;
 		viewInfo.subresourceRange = {};
 		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
 		viewInfo.subresourceRange.baseMipLevel = 0;
@@ -309,7 +424,7 @@ public:
 			// This view is used to render to that specific depth image layer
 			VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
 			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
-			viewInfo.format = depthFormat;
+			viewInfo.format = depth.format;
 			viewInfo.subresourceRange = {};
 			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
 			viewInfo.subresourceRange.baseMipLevel = 0;
@@ -327,6 +442,12 @@ public:
 			framebufferInfo.height = SHADOWMAP_DIM;
 			framebufferInfo.layers = 1;
 			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &cascades[i].frameBuffer));
+			// Same for the cascade's static caster layer
+			viewInfo.image = staticLayer.image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewInfo, nullptr, &cascades[i].staticView));
+			framebufferInfo.renderPass = depthPass.staticRenderPass;
+			framebufferInfo.pAttachments = &cascades[i].staticView;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &cascades[i].staticFrameBuffer));
 		}
 
 		// Shared sampler for cascade depth reads
@@ -345,52 +466,109 @@ public:
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &depth.sampler));
 	}
 
-	void buildCommandBuffers()
+	/*
+		Generate depth map cascades
+
+		Uses multiple passes with each pass rendering the scene to the cascade's depth image layer
+		Could be optimized using a geometry shader (and layered frame buffer) on devices that support geometry shaders
+		Each cascade's pass is recorded into command buffers of its own, so draw() can leave out the cascades whose shadow map is still valid
+		In cached mode a cascade's static casters are rendered to its static layer by separate command buffers, and its shadow map is
+		filled with a copy of that layer before the dynamic casters are drawn
+	*/
+	void buildDepthPassCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); i++) {
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-
-			/*
-				Generate depth map cascades
+		VkClearValue clearValues[1];
+		clearValues[0].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = depthPass.renderPass;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent.width = SHADOWMAP_DIM;
+		renderPassBeginInfo.renderArea.extent.height = SHADOWMAP_DIM;
+		renderPassBeginInfo.clearValueCount = 1;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		VkViewport viewport = vks::initializers::viewport((float)SHADOWMAP_DIM, (float)SHADOWMAP_DIM, 0.0f, 1.0f);
+		VkRect2D scissor = vks::initializers::rect2D(SHADOWMAP_DIM, SHADOWMAP_DIM, 0, 0);
+
+		for (uint32_t j = 0; j < SHADOW_MAP_CASCADE_COUNT; j++) {
+			Cascade& cascade = cascades[j];
+			// (Re)allocate if the number of swap chain images changed
+			if (cascade.commandBuffers.size() != drawCmdBuffers.size()) {
+				if (!cascade.commandBuffers.empty()) {
+					vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(cascade.commandBuffers.size()), cascade.commandBuffers.data());
+					vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(cascade.staticCommandBuffers.size()), cascade.staticCommandBuffers.data());
+				}
+				cascade.commandBuffers.resize(drawCmdBuffers.size());
+				cascade.staticCommandBuffers.resize(drawCmdBuffers.size());
+				VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(cascade.commandBuffers.size()));
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, cascade.commandBuffers.data()));
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, cascade.staticCommandBuffers.data()));
+			}
 
-				Uses multiple passes with each pass rendering the scene to the cascade's depth image layer
-				Could be optimized using a geometry shader (and layered frame buffer) on devices that support geometry shaders
-			*/
-			{
-				VkClearValue clearValues[1];
-				clearValues[0].depthStencil = { 1.0f, 0 };
+			// Both aspects of combined depth stencil formats have to be transitioned together
+			VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, j, 1 };
+			if (vks::tools::formatHasStencil(depth.format)) {
+				subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+			}
+			VkImageCopy copyRegion{};
+			copyRegion.srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, j, 1 };
+			copyRegion.dstSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, j, 1 };
+			copyRegion.extent = { SHADOWMAP_DIM, SHADOWMAP_DIM, 1 };
+
+			for (size_t i = 0; i < cascade.commandBuffers.size(); i++) {
+				// Static casters to the static layer (cached mode)
+				VkCommandBuffer commandBuffer = cascade.staticCommandBuffers[i];
+				VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+				renderPassBeginInfo.renderPass = depthPass.staticRenderPass;
+				renderPassBeginInfo.framebuffer = cascade.staticFrameBuffer;
+				vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+				vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipeline);
+				renderScene(commandBuffer, depthPass.pipelineLayout, cascade.descriptorSet, j, StaticCasters);
+				vkCmdEndRenderPass(commandBuffer);
+				VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+				commandBuffer = cascade.commandBuffers[i];
+				VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+				if (cacheCascades) {
+					// Replace the shadow map with the static layer, the previous content doesn't need to be kept
+					vks::tools::setImageLayout(commandBuffer, depth.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+					vkCmdCopyImage(commandBuffer, staticLayer.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, depth.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+					renderPassBeginInfo.renderPass = depthPass.dynamicRenderPass;
+				}
+				else {
+					renderPassBeginInfo.renderPass = depthPass.renderPass;
+				}
+				// The layer that this pass renders to is defined by the cascade's image view (selected via the cascade's descriptor set)
+				renderPassBeginInfo.framebuffer = cascade.frameBuffer;
+				vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+				vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipeline);
+				renderScene(commandBuffer, depthPass.pipelineLayout, cascade.descriptorSet, j, cacheCascades ? DynamicCasters : AllCasters);
+				vkCmdEndRenderPass(commandBuffer);
+				VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+			}
+		}
+	}
 
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = depthPass.renderPass;
-				renderPassBeginInfo.renderArea.offset.x = 0;
-				renderPassBeginInfo.renderArea.offset.y = 0;
-				renderPassBeginInfo.renderArea.extent.width = SHADOWMAP_DIM;
-				renderPassBeginInfo.renderArea.extent.height = SHADOWMAP_DIM;
-				renderPassBeginInfo.clearValueCount = 1;
-				renderPassBeginInfo.pClearValues = clearValues;
+	void buildCommandBuffers()
+	{
+		buildDepthPassCommandBuffers();
 
-				VkViewport viewport = vks::initializers::viewport((float)SHADOWMAP_DIM, (float)SHADOWMAP_DIM, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-				VkRect2D scissor = vks::initializers::rect2D(SHADOWMAP_DIM, SHADOWMAP_DIM, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		for (int32_t i = 0; i < drawCmdBuffers.size(); i++) {
 
-				// One pass per cascade
-				// The layer that this pass renders to is defined by the cascade's image view (selected via the cascade's descriptor set)
-				for (uint32_t j = 0; j < SHADOW_MAP_CASCADE_COUNT; j++) {
-					renderPassBeginInfo.framebuffer = cascades[j].frameBuffer;
-					vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipeline);
-					renderScene(drawCmdBuffers[i], depthPass.pipelineLayout, cascades[j].descriptorSet, j);
-					vkCmdEndRenderPass(drawCmdBuffers[i]);
-				}
-			}
+			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
 			/*
-				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
+				Note: Explicit synchronization with the depth passes submitted before is not required, as this is done implicit via sub pass dependencies
 			*/
 
 			/*
@@ -700,18 +878,60 @@ public:
 			}
 			radius = std::ceil(radius * 16.0f) / 16.0f;
 
+			glm::vec3 lightDir = normalize(-lightPos);
+
+			// Store split distance in cascade
+			Cascade& cascade = cascades[i];
+			cascade.splitDepth = (camera.getNearClip() + splitDist * clipRange) * -1.0f;
+			lastSplitDist = cascadeSplits[i];
+
+			if (cacheCascades) {
+				// The radius of a slice's bounding sphere doesn't depend on the camera's position and orientation, so the cached shadow map
+				// still contains the slice as long as its center stays within the margin the map has been enlarged by
+				const bool covered = cascade.cached && (glm::length(frustumCenter - cascade.cachedCenter) <= radius * cacheMargin);
+				// Light changes are picked up every frame by the first cascade, every second frame by the second one, etc.
+				const bool due = (cascadeUpdateCount - cascade.lastUpdate) >= (1u << i);
+				if (covered && (cascade.cachedLightDir == lightDir || !due)) {
+					// The static layer is still valid, the dynamic casters are drawn over it again at the same rates
+					if ((cascadeUpdateCount - cascade.lastDynamicUpdate) >= (1u << i)) {
+						cascade.updateDynamic = true;
+						cascade.lastDynamicUpdate = cascadeUpdateCount;
+					}
+					continue;
+				}
+				radius *= 1.0f + cacheMargin;
+			}
+
 			glm::vec3 maxExtents = glm::vec3(radius);
 			glm::vec3 minExtents = -maxExtents;
 
-			glm::vec3 lightDir = normalize(-lightPos);
 			glm::mat4 lightViewMatrix = glm::lookAt(frustumCenter - lightDir * -minExtents.z, frustumCenter, glm::vec3(0.0f, 1.0f, 0.0f));
 			glm::mat4 lightOrthoMatrix = glm::ortho(minExtents.x, maxExtents.x, minExtents.y, maxExtents.y, 0.0f, maxExtents.z - minExtents.z);
 
-			// Store split distance and matrix in cascade
-			cascades[i].splitDepth = (camera.getNearClip() + splitDist * clipRange) * -1.0f;
-			cascades[i].viewProjMatrix = lightOrthoMatrix * lightViewMatrix;
+			if (cacheCascades) {
+				// Snap the projection to shadow map texels, so re-rendering a cascade for a moved camera doesn't make its edges shimmer
+				glm::vec4 shadowOrigin = lightOrthoMatrix * lightViewMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) * (SHADOWMAP_DIM / 2.0f);
+				glm::vec4 roundOffset = (glm::round(shadowOrigin) - shadowOrigin) * (2.0f / SHADOWMAP_DIM);
+				lightOrthoMatrix[3] += glm::vec4(roundOffset.x, roundOffset.y, 0.0f, 0.0f);
+			}
 
-			lastSplitDist = cascadeSplits[i];
+			// Store matrix in cascade
+			cascade.viewProjMatrix = lightOrthoMatrix * lightViewMatrix;
+			cascade.update = true;
+			cascade.cached = cacheCascades;
+			cascade.cachedCenter = frustumCenter;
+			cascade.cachedLightDir = lightDir;
+			cascade.lastUpdate = cascadeUpdateCount;
+			cascade.lastDynamicUpdate = cascadeUpdateCount;
+		}
+		cascadeUpdateCount++;
+	}
+
+	// Re-render all cascades with the next frame, e.g. after changing the splits
+	void invalidateCascades()
+	{
+		for (auto& cascade : cascades) {
+			cascade.cached = false;
 		}
 	}
 
@@ -720,6 +940,9 @@ public:
 		float angle = glm::radians(timer * 360.0f);
 		float radius = 20.0f;
 		lightPos = glm::vec3(cos(angle) * radius, -radius, sin(angle) * radius);
+		// The dynamic caster circles the static trees
+		float casterAngle = glm::radians(timer * 360.0f * 4.0f);
+		dynamicCasterOffset = glm::vec4(sin(casterAngle) * 2.5f, 0.0f, cos(casterAngle) * 2.5f, 0.0f);
 	}
 
 	void updateUniformBuffers()
@@ -730,6 +953,7 @@ public:
 		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
 			depthPass.ubo.cascadeViewProjMat[i] = cascades[i].viewProjMatrix;
 		}
+		depthPass.ubo.dynamicCasterOffset = dynamicCasterOffset;
 		memcpy(depthPass.uniformBuffer.mapped, &depthPass.ubo, sizeof(depthPass.ubo));
 
 		/*
@@ -738,6 +962,7 @@ public:
 		uboVS.projection = camera.matrices.perspective;
 		uboVS.view = camera.matrices.view;
 		uboVS.model = glm::mat4(1.0f);
+		uboVS.dynamicCasterOffset = dynamicCasterOffset;
 
 		uboVS.lightDir = normalize(-lightPos);
 
@@ -756,9 +981,31 @@ public:
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+		// Depth passes of the cascades to update followed by the scene, taken from the frame arena so the frame loop doesn't allocate
+		vks::FrameVector<VkCommandBuffer> commandBuffers(frameArena);
+		commandBuffers.reserve(2 * SHADOW_MAP_CASCADE_COUNT + 1);
+		renderedCascades = 0;
+		renderedStaticLayers = 0;
+		for (auto& cascade : cascades) {
+			// The static layer is only rendered again if the cascade's matrix changed
+			if (cacheCascades && cascade.update) {
+				commandBuffers.push_back(cascade.staticCommandBuffers[currentBuffer]);
+				renderedStaticLayers++;
+			}
+			// Without caching, all cascades are rendered every frame
+			if (!cacheCascades || cascade.update || cascade.updateDynamic) {
+				commandBuffers.push_back(cascade.commandBuffers[currentBuffer]);
+				renderedCascades++;
+			}
+			cascade.update = false;
+			cascade.updateDynamic = false;
+		}
+		commandBuffers.push_back(drawCmdBuffers[currentBuffer]);
+
+		submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+		submitInfo.pCommandBuffers = commandBuffers.data();
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -792,6 +1039,7 @@ public:
 	{
 		if (overlay->header("Settings")) {
 			if (overlay->sliderFloat("Split lambda", &cascadeSplitLambda, 0.1f, 1.0f)) {
+				invalidateCascades();
 				updateCascades();
 				updateUniformBuffers();
 			}
@@ -809,6 +1057,22 @@ public:
 			if (overlay->checkBox("PCF filtering", &filterPCF)) {
 				buildCommandBuffers();
 			}
+			if (overlay->checkBox("Cache cascades", &cacheCascades)) {
+				invalidateCascades();
+				updateCascades();
+				updateUniformBuffers();
+				// The cascade passes draw all casters or only the dynamic ones
+				buildCommandBuffers();
+			}
+			if (cacheCascades) {
+				if (overlay->sliderFloat("Cache margin", &cacheMargin, 0.0f, 0.5f)) {
+					invalidateCascades();
+					updateCascades();
+					updateUniformBuffers();
+				}
+				overlay->text("Cascades rendered: %d", renderedCascades);
+				overlay->text("Static layers rendered: %d", renderedStaticLayers);
+			}
 		}
 	}
 };
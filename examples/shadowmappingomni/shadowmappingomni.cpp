@@ -1,6 +1,8 @@
 /*
 * Vulkan Example - Omni directional shadows using a dynamic cube map
 *
+* The six faces of the shadow cube map are either rendered with one render pass per face, or all at once with a single VK_KHR_multiview render pass
+*
 * Copyright (C) by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -23,6 +25,10 @@ class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool displayCubeMap = false;
+	// Render all cube map faces in one multiview pass (if VK_KHR_multiview is supported)
+	bool singlePass = true;
+	bool multiviewSupported = false;
+	VkPhysicalDeviceMultiviewFeaturesKHR physicalDeviceMultiviewFeatures{};
 
 	float zNear = 0.1f;
 	float zFar = 1024.0f;
@@ -35,6 +41,7 @@ public:
 	struct {
 		vks::Buffer scene;
 		vks::Buffer offscreen;
+		vks::Buffer faceViews;
 	} uniformBuffers;
 
 	struct {
@@ -53,9 +60,15 @@ public:
 
 	UBO uboVSscene, uboOffscreenVS;
 
+	// View matrices of the cube map faces, indexed by gl_ViewIndex in the multiview pass
+	struct {
+		glm::mat4 faceViews[6];
+	} uboFaceViews;
+
 	struct {
 		VkPipeline scene;
 		VkPipeline offscreen;
+		VkPipeline offscreenMultiview = VK_NULL_HANDLE;
 		VkPipeline cubemapDisplay;
 	} pipelines;
 
@@ -76,9 +89,9 @@ public:
 
 	// Framebuffer for offscreen rendering
 	struct FrameBufferAttachment {
-		VkImage image;
-		VkDeviceMemory mem;
-		VkImageView view;
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory mem = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
 	};
 	struct OffscreenPass {
 		int32_t width, height;
@@ -89,6 +102,15 @@ public:
 		VkDescriptorImageInfo descriptor;
 	} offscreenPass;
 
+	// Single pass rendering of all faces: the view mask selects all six layers of the cube map and of a layered depth attachment
+	struct MultiviewPass {
+		VkFramebuffer frameBuffer = VK_NULL_HANDLE;
+		FrameBufferAttachment depth;
+		// 2D array view of all cube map layers
+		VkImageView colorView = VK_NULL_HANDLE;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+	} multiviewPass;
+
 	VkFormat fbDepthFormat;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
@@ -129,6 +151,17 @@ public:
 
 		vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
 
+		// Multiview pass
+		if (multiviewSupported) {
+			vkDestroyFramebuffer(device, multiviewPass.frameBuffer, nullptr);
+			vkDestroyImageView(device, multiviewPass.colorView, nullptr);
+			vkDestroyImageView(device, multiviewPass.depth.view, nullptr);
+			vkDestroyImage(device, multiviewPass.depth.image, nullptr);
+			vkFreeMemory(device, multiviewPass.depth.mem, nullptr);
+			vkDestroyRenderPass(device, multiviewPass.renderPass, nullptr);
+			vkDestroyPipeline(device, pipelines.offscreenMultiview, nullptr);
+		}
+
 		// Pipelines
 		vkDestroyPipeline(device, pipelines.scene, nullptr);
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
@@ -142,6 +175,20 @@ public:
 		// Uniform buffers
 		uniformBuffers.offscreen.destroy();
 		uniformBuffers.scene.destroy();
+		uniformBuffers.faceViews.destroy();
+	}
+
+	void getEnabledExtensions()
+	{
+		// Multiview is optional, without it the faces are always rendered with one pass each
+		multiviewSupported = vulkanDevice->extensionSupported(VK_KHR_MULTIVIEW_EXTENSION_NAME);
+		if (multiviewSupported) {
+			enabledDeviceExtensions.push_back(VK_KHR_MULTIVIEW_EXTENSION_NAME);
+			physicalDeviceMultiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
+			physicalDeviceMultiviewFeatures.multiview = VK_TRUE;
+			deviceCreatepNextChain = &physicalDeviceMultiviewFeatures;
+		}
+		singlePass = singlePass && multiviewSupported;
 	}
 
 	void prepareCubeMap()
@@ -331,26 +378,130 @@ public:
 		}
 	}
 
-	// Updates a single cube map face
-	// Renders the scene with face's view directly to the cubemap layer `faceIndex`
-	// Uses push constants for quick update of view matrix for the current cube map face
-	void updateCubeFace(uint32_t faceIndex, VkCommandBuffer commandBuffer)
+	// Set up a render pass and framebuffer that render to all six cube map layers at once using multiview
+	// Each view renders to the array layer of its view index, so the vertex shader selects the face's view matrix with gl_ViewIndex
+	void prepareMultiviewPass()
 	{
-		VkClearValue clearValues[2];
-		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-		clearValues[1].depthStencil = { 1.0f, 0 };
+		VkAttachmentDescription attachments[2] = {};
+
+		attachments[0].format = FB_COLOR_FORMAT;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		// The depth attachment is cleared and not needed after the pass
+		attachments[1].format = fbDepthFormat;
+		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
 
-		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-		// Reuse render pass from example pass
-		renderPassBeginInfo.renderPass = offscreenPass.renderPass;
-		renderPassBeginInfo.framebuffer = offscreenPass.frameBuffers[faceIndex];
-		renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
-		renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
-		renderPassBeginInfo.clearValueCount = 2;
-		renderPassBeginInfo.pClearValues = clearValues;
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorReference;
+		subpass.pDepthStencilAttachment = &depthReference;
 
-		// Update view matrix via push constant
+		// The scene pass of the previous frame samples the cube map, and this frame's scene pass samples it after it has been written
+		std::array<VkSubpassDependency, 2> dependencies{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		// All six faces are rendered by the single subpass, the faces see the same geometry from the same position so they're correlated
+		const uint32_t viewMask = 0b00111111;
+		const uint32_t correlationMask = 0b00111111;
+
+		VkRenderPassMultiviewCreateInfo renderPassMultiviewCI{};
+		renderPassMultiviewCI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+		renderPassMultiviewCI.subpassCount = 1;
+		renderPassMultiviewCI.pViewMasks = &viewMask;
+		renderPassMultiviewCI.correlationMaskCount = 1;
+		renderPassMultiviewCI.pCorrelationMasks = &correlationMask;
+
+		VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+		renderPassCI.attachmentCount = 2;
+		renderPassCI.pAttachments = attachments;
+		renderPassCI.subpassCount = 1;
+		renderPassCI.pSubpasses = &subpass;
+		renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassCI.pDependencies = dependencies.data();
+		renderPassCI.pNext = &renderPassMultiviewCI;
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &multiviewPass.renderPass));
+
+		// Layered depth attachment with one layer per face
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = fbDepthFormat;
+		imageCI.extent = { (uint32_t)offscreenPass.width, (uint32_t)offscreenPass.height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 6;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &multiviewPass.depth.image));
 
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, multiviewPass.depth.image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &multiviewPass.depth.mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, multiviewPass.depth.image, multiviewPass.depth.mem, 0));
+
+		VkImageViewCreateInfo depthView = vks::initializers::imageViewCreateInfo();
+		depthView.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		depthView.format = fbDepthFormat;
+		depthView.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 6 };
+		if (fbDepthFormat >= VK_FORMAT_D16_UNORM_S8_UINT)
+			depthView.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		depthView.image = multiviewPass.depth.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &depthView, nullptr, &multiviewPass.depth.view));
+
+		// The cube map is rendered through a 2D array view, as multiview attachments need one layer per view
+		VkImageViewCreateInfo colorView = vks::initializers::imageViewCreateInfo();
+		colorView.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		colorView.format = FB_COLOR_FORMAT;
+		colorView.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6 };
+		colorView.image = shadowCubeMap.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &colorView, nullptr, &multiviewPass.colorView));
+
+		VkImageView fbAttachments[2] = { multiviewPass.colorView, multiviewPass.depth.view };
+		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+		fbufCreateInfo.renderPass = multiviewPass.renderPass;
+		fbufCreateInfo.attachmentCount = 2;
+		fbufCreateInfo.pAttachments = fbAttachments;
+		fbufCreateInfo.width = offscreenPass.width;
+		fbufCreateInfo.height = offscreenPass.height;
+		// With multiview the layers are selected by the view mask, the framebuffer itself has a single layer
+		fbufCreateInfo.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &multiviewPass.frameBuffer));
+	}
+
+	glm::mat4 getCubeFaceViewMatrix(uint32_t faceIndex)
+	{
 		glm::mat4 viewMatrix = glm::mat4(1.0f);
 		switch (faceIndex)
 		{
@@ -375,6 +526,29 @@ public:
 			viewMatrix = glm::rotate(viewMatrix, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 			break;
 		}
+		return viewMatrix;
+	}
+
+	// Updates a single cube map face
+	// Renders the scene with face's view directly to the cubemap layer `faceIndex`
+	// Uses push constants for quick update of view matrix for the current cube map face
+	void updateCubeFace(uint32_t faceIndex, VkCommandBuffer commandBuffer)
+	{
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		// Reuse render pass from example pass
+		renderPassBeginInfo.renderPass = offscreenPass.renderPass;
+		renderPassBeginInfo.framebuffer = offscreenPass.frameBuffers[faceIndex];
+		renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
+		renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		// Update view matrix via push constant
+		glm::mat4 viewMatrix = getCubeFaceViewMatrix(faceIndex);
 
 		// Render scene from cube face's point of view
 		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
@@ -396,6 +570,28 @@ public:
 		vkCmdEndRenderPass(commandBuffer);
 	}
 
+	// Renders all cube map faces with a single submission of the scene
+	void updateCubeFacesMultiview(VkCommandBuffer commandBuffer)
+	{
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = multiviewPass.renderPass;
+		renderPassBeginInfo.framebuffer = multiviewPass.frameBuffer;
+		renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
+		renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreenMultiview);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.offscreen, 0, 1, &descriptorSets.offscreen, 0, NULL);
+		models.scene.draw(commandBuffer);
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -405,7 +601,7 @@ public:
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
 			/*
-				Generate shadow cube maps using one render pass per face
+				Generate shadow cube maps using one render pass per face, or a single multiview render pass for all faces
 			*/
 			{
 				VkViewport viewport = vks::initializers::viewport((float)offscreenPass.width, (float)offscreenPass.height, 0.0f, 1.0f);
@@ -414,8 +610,12 @@ public:
 				VkRect2D scissor = vks::initializers::rect2D(offscreenPass.width, offscreenPass.height, 0, 0);
 				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-				for (uint32_t face = 0; face < 6; face++) {
-					updateCubeFace(face, drawCmdBuffers[i]);
+				if (singlePass) {
+					updateCubeFacesMultiview(drawCmdBuffers[i]);
+				} else {
+					for (uint32_t face = 0; face < 6; face++) {
+						updateCubeFace(face, drawCmdBuffers[i]);
+					}
 				}
 			}
 
@@ -480,9 +680,9 @@ public:
 
 	void setupDescriptorPool()
 	{
-		// Example uses three ubos and two image samplers
+		// Example uses four ubos and two image samplers
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes.size(), poolSizes.data(), 3);
@@ -496,7 +696,9 @@ public:
 			// Binding 0 : Vertex shader uniform buffer
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
 			// Binding 1 : Fragment shader image sampler (cube map)
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+			// Binding 2 : Vertex shader uniform buffer with the cube map face view matrices (multiview pass only)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 2)
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), setLayoutBindings.size());
@@ -541,6 +743,8 @@ public:
 		std::vector<VkWriteDescriptorSet> offScreenWriteDescriptorSets = {
 			// Binding 0 : Vertex shader uniform buffer
 			vks::initializers::writeDescriptorSet(descriptorSets.offscreen, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.offscreen.descriptor),
+			// Binding 2 : Vertex shader face view matrices
+			vks::initializers::writeDescriptorSet(descriptorSets.offscreen, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffers.faceViews.descriptor),
 		};
 		vkUpdateDescriptorSets(device, offScreenWriteDescriptorSets.size(), offScreenWriteDescriptorSets.data(), 0, NULL);
 	}
@@ -638,6 +842,13 @@ public:
 		pipelineCI.renderPass = offscreenPass.renderPass;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
 
+		// Offscreen multiview pipeline, the vertex shader picks the face's view matrix with gl_ViewIndex
+		if (multiviewSupported) {
+			shaderStages[0] = loadShader(getShadersPath() + "shadowmappingomni/offscreenmultiview.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			pipelineCI.renderPass = multiviewPass.renderPass;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreenMultiview));
+		}
+
 		// Cube map display pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "shadowmappingomni/cubemapdisplay.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "shadowmappingomni/cubemapdisplay.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
@@ -666,6 +877,17 @@ public:
 			&uniformBuffers.scene,
 			sizeof(uboVSscene)));
 
+		// Cube map face view matrices, these don't change so they're only written once
+		for (uint32_t face = 0; face < 6; face++) {
+			uboFaceViews.faceViews[face] = getCubeFaceViewMatrix(face);
+		}
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffers.faceViews,
+			sizeof(uboFaceViews),
+			&uboFaceViews));
+
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.offscreen.map());
 		VK_CHECK_RESULT(uniformBuffers.scene.map());
@@ -699,7 +921,7 @@ public:
 		VulkanExampleBase::prepareFrame();
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -711,6 +933,9 @@ public:
 		prepareCubeMap();
 		setupDescriptorSetLayout();
 		prepareOffscreenRenderpass();
+		if (multiviewSupported) {
+			prepareMultiviewPass();
+		}
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSets();
@@ -737,6 +962,11 @@ public:
 			if (overlay->checkBox("Display shadow cube render target", &displayCubeMap)) {
 				buildCommandBuffers();
 			}
+			if (multiviewSupported) {
+				if (overlay->checkBox("Single pass (multiview)", &singlePass)) {
+					buildCommandBuffers();
+				}
+			}
 		}
 	}
 };
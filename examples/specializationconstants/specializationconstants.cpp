@@ -10,6 +10,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanSpecialization.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -211,55 +212,38 @@ public:
 
 		// Prepare specialization data
 
-		// Host data to take specialization constants from
-		struct SpecializationData {
-			// Sets the lighting model used in the fragment "uber" shader
-			uint32_t lightingModel;
-			// Parameter for the toon shading part of the fragment shader
-			float toonDesaturationFactor = 0.5f;
-		} specializationData;
-
-		// Each shader constant of a shader stage corresponds to one map entry
-		std::array<VkSpecializationMapEntry, 2> specializationMapEntries;
 		// Shader bindings based on specialization constants are marked by the new "constant_id" layout qualifier:
 		//	layout (constant_id = 0) const int LIGHTING_MODEL = 0;
 		//	layout (constant_id = 1) const float PARAM_TOON_DESATURATION = 0.0f;
 
-		// Map entry for the lighting model to be used by the fragment shader
-		specializationMapEntries[0].constantID = 0;
-		specializationMapEntries[0].size = sizeof(specializationData.lightingModel);
-		specializationMapEntries[0].offset = 0;
-
-		// Map entry for the toon shader parameter
-		specializationMapEntries[1].constantID = 1;
-		specializationMapEntries[1].size = sizeof(specializationData.toonDesaturationFactor);
-		specializationMapEntries[1].offset = offsetof(SpecializationData, toonDesaturationFactor);
-
-		// Prepare specialization info block for the shader stage
-		VkSpecializationInfo specializationInfo{};
-		specializationInfo.dataSize = sizeof(specializationData);
-		specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationMapEntries.size());
-		specializationInfo.pMapEntries = specializationMapEntries.data();
-		specializationInfo.pData = &specializationData;
+		// Host data to take specialization constants from, each constant of a shader stage corresponds to one map entry
+		// The map entries (constant ids, offsets and sizes) are derived from the list of types at compile time
+		// The pipelines are compiled in parallel, so each of them needs its own constants, shader stages and create info
+		std::array<vks::SpecializationConstants<uint32_t, float>, 3> specializationConstants;
+		std::array<std::array<VkPipelineShaderStageCreateInfo, 2>, 3> pipelineShaderStages;
+		std::array<VkGraphicsPipelineCreateInfo, 3> pipelineCIs;
+		// Solid phong shading, phong and textured, textured discard
+		std::array<VkPipeline*, 3> lightingModelPipelines = { &pipelines.phong, &pipelines.toon, &pipelines.textured };
 
 		// Create pipelines
 		// All pipelines will use the same "uber" shader and specialization constants to change branching and parameters of that shader
 		shaderStages[0] = loadShader(getShadersPath() + "specializationconstants/uber.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "specializationconstants/uber.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		// Specialization info is assigned is part of the shader stage (modul) and must be set after creating the module and before creating the pipeline
-		shaderStages[1].pSpecializationInfo = &specializationInfo;
 
-		// Solid phong shading
-		specializationData.lightingModel = 0;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phong));
-
-		// Phong and textured
-		specializationData.lightingModel = 1;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.toon));
-
-		// Textured discard
-		specializationData.lightingModel = 2;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.textured));
+		vks::PipelineBatch pipelineBatch(device, pipelineCache, getThreadPool());
+		for (uint32_t i = 0; i < static_cast<uint32_t>(lightingModelPipelines.size()); i++) {
+			// Constant 0 sets the lighting model used in the fragment "uber" shader
+			// Constant 1 is the parameter for the toon shading part of the fragment shader
+			specializationConstants[i].set<0>(i);
+			specializationConstants[i].set<1>(0.5f);
+			// Specialization info is assigned is part of the shader stage (modul) and must be set after creating the module and before creating the pipeline
+			pipelineShaderStages[i] = shaderStages;
+			pipelineShaderStages[i][1].pSpecializationInfo = specializationConstants[i].getInfo();
+			pipelineCIs[i] = pipelineCI;
+			pipelineCIs[i].pStages = pipelineShaderStages[i].data();
+			pipelineBatch.add(pipelineCIs[i], lightingModelPipelines[i]);
+		}
+		pipelineBatch.build();
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -294,7 +278,7 @@ public:
 
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -1,6 +1,9 @@
 /*
 * Vulkan Example - Screen space ambient occlusion example
 *
+* Ambient occlusion can be computed at full, half or quarter resolution. The reduced resolutions compute it from a downsampled G-Buffer with
+* fewer samples per frame, accumulate it over frames and upsample it with a joint bilateral filter guided by the full resolution depth and normals
+*
 * Copyright (C) by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -8,11 +11,16 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanFrameBuffer.hpp"
+#include "VulkanBarrierBatcher.h"
+#include "VulkanTextureCompressor.h"
 
 #define ENABLE_VALIDATION false
 
 #define SSAO_KERNEL_SIZE 64
 #define SSAO_RADIUS 0.3f
+// Samples per pixel and frame at reduced resolutions, every frame uses a different subset of the kernel so the accumulation covers all samples
+#define SSAO_REDUCED_SAMPLE_COUNT 16
 
 #if defined(__ANDROID__)
 #define SSAO_NOISE_DIM 8
@@ -29,6 +37,23 @@ public:
 
 	vkglTF::Model scene;
 
+	// Resolution of the ambient occlusion: 0 = full, 1 = half, 2 = quarter
+	int32_t ssaoResolution = 0;
+	// Weight of the reprojected history in the temporal accumulation at reduced resolutions
+	float temporalWeight = 0.9f;
+	bool historyValid = false;
+	glm::mat4 previousViewProjection = glm::mat4(1.0f);
+	// Draw the G-Buffer pass with one draw per material instead of one per primitive
+	bool staticBatching = true;
+
+	// Layout transitions of the temporal accumulation images, recorded with vkCmdPipelineBarrier2 if synchronization2 is supported
+	vks::BarrierBatcher* barrierBatcher = nullptr;
+	bool synchronization2Supported = false;
+	// Block compress the scene's textures while loading (see vkglTF::FileLoadingFlags::CompressTextures)
+	bool compressTextures = false;
+	std::unique_ptr<vks::TextureCompressor> textureCompressor;
+	VkPhysicalDeviceSynchronization2FeaturesKHR enabledSynchronization2Features{};
+
 	struct UBOSceneParams {
 		glm::mat4 projection;
 		glm::mat4 model;
@@ -42,13 +67,25 @@ public:
 		int32_t ssao = true;
 		int32_t ssaoOnly = false;
 		int32_t ssaoBlur = true;
+		// Selects the noise offset and kernel subset of the frame at reduced resolutions
+		int32_t frameIndex = 0;
 	} uboSSAOParams;
 
+	struct UBOTemporalParams {
+		// From the current frame's view space to the previous frame's clip space
+		glm::mat4 reprojection;
+		float historyWeight;
+		int32_t historyValid;
+	} uboTemporalParams;
+
 	struct {
 		VkPipeline offscreen;
 		VkPipeline composition;
 		VkPipeline ssao;
 		VkPipeline ssaoBlur;
+		VkPipeline downsample = VK_NULL_HANDLE;
+		VkPipeline ssaoTemporal = VK_NULL_HANDLE;
+		VkPipeline ssaoUpsample = VK_NULL_HANDLE;
 	} pipelines;
 
 	struct {
@@ -56,15 +93,21 @@ public:
 		VkPipelineLayout ssao;
 		VkPipelineLayout ssaoBlur;
 		VkPipelineLayout composition;
+		VkPipelineLayout downsample;
+		VkPipelineLayout ssaoTemporal;
+		VkPipelineLayout ssaoUpsample;
 	} pipelineLayouts;
 
 	struct {
-		const uint32_t count = 5;
+		const uint32_t count = 8;
 		VkDescriptorSet model;
 		VkDescriptorSet floor;
 		VkDescriptorSet ssao;
 		VkDescriptorSet ssaoBlur;
 		VkDescriptorSet composition;
+		VkDescriptorSet downsample;
+		VkDescriptorSet ssaoTemporal;
+		VkDescriptorSet ssaoUpsample;
 	} descriptorSets;
 
 	struct {
@@ -72,31 +115,39 @@ public:
 		VkDescriptorSetLayout ssao;
 		VkDescriptorSetLayout ssaoBlur;
 		VkDescriptorSetLayout composition;
+		VkDescriptorSetLayout downsample;
+		VkDescriptorSetLayout ssaoTemporal;
+		VkDescriptorSetLayout ssaoUpsample;
 	} descriptorSetLayouts;
 
 	struct {
 		vks::Buffer sceneParams;
 		vks::Buffer ssaoKernel;
 		vks::Buffer ssaoParams;
+		vks::Buffer temporalParams;
 	} uniformBuffers;
 
 	// Framebuffer for offscreen rendering
 	struct FrameBufferAttachment {
-		VkImage image;
-		VkDeviceMemory mem;
-		VkImageView view;
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory mem = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
 		VkFormat format;
+		vks::ImageCompression compression;
 		void destroy(VkDevice device)
 		{
 			vkDestroyImage(device, image, nullptr);
 			vkDestroyImageView(device, view, nullptr);
 			vkFreeMemory(device, mem, nullptr);
+			image = VK_NULL_HANDLE;
+			view = VK_NULL_HANDLE;
+			mem = VK_NULL_HANDLE;
 		}
 	};
 	struct FrameBuffer {
 		int32_t width, height;
-		VkFramebuffer frameBuffer;
-		VkRenderPass renderPass;
+		VkFramebuffer frameBuffer = VK_NULL_HANDLE;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
 		void setSize(int32_t w, int32_t h)
 		{
 			this->width = w;
@@ -106,6 +157,8 @@ public:
 		{
 			vkDestroyFramebuffer(device, frameBuffer, nullptr);
 			vkDestroyRenderPass(device, renderPass, nullptr);
+			frameBuffer = VK_NULL_HANDLE;
+			renderPass = VK_NULL_HANDLE;
 		}
 	};
 
@@ -116,6 +169,14 @@ public:
 		struct SSAO : public FrameBuffer {
 			FrameBufferAttachment color;
 		} ssao, ssaoBlur;
+		// Position + depth and normals at the SSAO resolution (reduced resolutions only)
+		struct Downsample : public FrameBuffer {
+			FrameBufferAttachment position, normal;
+		} downsample;
+		// Accumulated occlusion (r) and its linear depth (g), copied to the history that the next frame reprojects (reduced resolutions only)
+		struct Temporal : public FrameBuffer {
+			FrameBufferAttachment color, history;
+		} ssaoTemporal;
 	} frameBuffers;
 
 	// One sampler for the frame buffer color attachments
@@ -131,9 +192,43 @@ public:
 		camera.position = { 1.0f, 0.75f, 0.0f };
 		camera.setRotation(glm::vec3(0.0f, 90.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, uboSceneParams.nearPlane, uboSceneParams.farPlane);
+		commandLineParser.add("texturecompression", { "-tc", "--texturecompression" }, 0, "Block compress the scene's textures at load time and store them in texture cache files next to the images");
+		commandLineParser.parse(args);
+		compressTextures = commandLineParser.isSet("texturecompression");
 	}
 
 	~VulkanExample()
+	{
+		destroyOffscreenFramebuffers();
+		destroyPipelines();
+
+		vkDestroyPipelineLayout(device, pipelineLayouts.gBuffer, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.ssao, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoBlur, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.composition, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.downsample, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoTemporal, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoUpsample, nullptr);
+
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.gBuffer, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssao, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoBlur, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.composition, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.downsample, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoTemporal, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoUpsample, nullptr);
+
+		// Uniform buffers
+		uniformBuffers.sceneParams.destroy();
+		uniformBuffers.ssaoKernel.destroy();
+		uniformBuffers.ssaoParams.destroy();
+		uniformBuffers.temporalParams.destroy();
+
+		textures.ssaoNoise.destroy();
+		delete barrierBatcher;
+	}
+
+	void destroyOffscreenFramebuffers()
 	{
 		vkDestroySampler(device, colorSampler, nullptr);
 
@@ -144,47 +239,78 @@ public:
 		frameBuffers.offscreen.depth.destroy(device);
 		frameBuffers.ssao.color.destroy(device);
 		frameBuffers.ssaoBlur.color.destroy(device);
+		frameBuffers.downsample.position.destroy(device);
+		frameBuffers.downsample.normal.destroy(device);
+		if (barrierBatcher) {
+			barrierBatcher->untrack(frameBuffers.ssaoTemporal.color.image);
+			barrierBatcher->untrack(frameBuffers.ssaoTemporal.history.image);
+		}
+		frameBuffers.ssaoTemporal.color.destroy(device);
+		frameBuffers.ssaoTemporal.history.destroy(device);
 
 		// Framebuffers
 		frameBuffers.offscreen.destroy(device);
 		frameBuffers.ssao.destroy(device);
 		frameBuffers.ssaoBlur.destroy(device);
+		frameBuffers.downsample.destroy(device);
+		frameBuffers.ssaoTemporal.destroy(device);
+	}
 
+	void destroyPipelines()
+	{
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
 		vkDestroyPipeline(device, pipelines.composition, nullptr);
 		vkDestroyPipeline(device, pipelines.ssao, nullptr);
 		vkDestroyPipeline(device, pipelines.ssaoBlur, nullptr);
+		vkDestroyPipeline(device, pipelines.downsample, nullptr);
+		vkDestroyPipeline(device, pipelines.ssaoTemporal, nullptr);
+		vkDestroyPipeline(device, pipelines.ssaoUpsample, nullptr);
+		pipelines.downsample = VK_NULL_HANDLE;
+		pipelines.ssaoTemporal = VK_NULL_HANDLE;
+		pipelines.ssaoUpsample = VK_NULL_HANDLE;
+	}
 
-		vkDestroyPipelineLayout(device, pipelineLayouts.gBuffer, nullptr);
-		vkDestroyPipelineLayout(device, pipelineLayouts.ssao, nullptr);
-		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoBlur, nullptr);
-		vkDestroyPipelineLayout(device, pipelineLayouts.composition, nullptr);
-
-		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.gBuffer, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssao, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoBlur, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.composition, nullptr);
-
-		// Uniform buffers
-		uniformBuffers.sceneParams.destroy();
-		uniformBuffers.ssaoKernel.destroy();
-		uniformBuffers.ssaoParams.destroy();
-
-		textures.ssaoNoise.destroy();
+	// Ratio of the full resolution to the resolution ambient occlusion is computed at
+	uint32_t getSSAODivisor()
+	{
+#if defined(__ANDROID__)
+		// Android always computes it at half resolution at least
+		return std::max(1u << ssaoResolution, 2u);
+#else
+		return 1u << ssaoResolution;
+#endif
 	}
 
 	void getEnabledFeatures()
 	{
 		enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+		if (compressTextures) {
+			enabledFeatures.textureCompressionBC = deviceFeatures.textureCompressionBC;
+			enabledFeatures.textureCompressionETC2 = deviceFeatures.textureCompressionETC2;
+		}
 	}
 
-	// Create a frame buffer attachment
+	void getEnabledExtensions()
+	{
+		// The feature is required to be supported by devices supporting the extension
+		synchronization2Supported = vulkanDevice->extensionSupported(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+		if (synchronization2Supported) {
+			enabledDeviceExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+			enabledSynchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+			enabledSynchronization2Features.synchronization2 = VK_TRUE;
+			enabledSynchronization2Features.pNext = deviceCreatepNextChain;
+			deviceCreatepNextChain = &enabledSynchronization2Features;
+		}
+	}
+
+	// Create a frame buffer attachment, requesting the given framebuffer compression if image compression control is enabled
 	void createAttachment(
 		VkFormat format,
-		VkImageUsageFlagBits usage,
+		VkImageUsageFlags usage,
 		FrameBufferAttachment *attachment,
 		uint32_t width,
-		uint32_t height)
+		uint32_t height,
+		VkImageCompressionFlagsEXT compression)
 	{
 		VkImageAspectFlags aspectMask = 0;
 
@@ -218,7 +344,7 @@ public:
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
 
-		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment->image));
+		VK_CHECK_RESULT(vks::createAttachmentImage(vulkanDevice, image, compression, &attachment->image, &attachment->compression));
 		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
 		memAlloc.allocationSize = memReqs.size;
 		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
@@ -238,16 +364,76 @@ public:
 		VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &attachment->view));
 	}
 
+	// Create the render pass and framebuffer for a fullscreen pass writing color attachments that are sampled by later passes
+	void prepareColorPass(FrameBuffer &frameBuffer, const std::vector<FrameBufferAttachment*> &attachments)
+	{
+		const uint32_t attachmentCount = static_cast<uint32_t>(attachments.size());
+		std::vector<VkAttachmentDescription> attachmentDescriptions(attachmentCount);
+		std::vector<VkAttachmentReference> colorReferences(attachmentCount);
+		std::vector<VkImageView> views(attachmentCount);
+		for (uint32_t i = 0; i < attachmentCount; i++)
+		{
+			attachmentDescriptions[i] = {};
+			attachmentDescriptions[i].format = attachments[i]->format;
+			attachmentDescriptions[i].samples = VK_SAMPLE_COUNT_1_BIT;
+			attachmentDescriptions[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			attachmentDescriptions[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachmentDescriptions[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachmentDescriptions[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachmentDescriptions[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachmentDescriptions[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			colorReferences[i] = { i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+			views[i] = attachments[i]->view;
+		}
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.pColorAttachments = colorReferences.data();
+		subpass.colorAttachmentCount = attachmentCount;
+
+		std::array<VkSubpassDependency, 2> dependencies;
+
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.pAttachments = attachmentDescriptions.data();
+		renderPassInfo.attachmentCount = attachmentCount;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = 2;
+		renderPassInfo.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffer.renderPass));
+
+		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+		fbufCreateInfo.renderPass = frameBuffer.renderPass;
+		fbufCreateInfo.pAttachments = views.data();
+		fbufCreateInfo.attachmentCount = attachmentCount;
+		fbufCreateInfo.width = frameBuffer.width;
+		fbufCreateInfo.height = frameBuffer.height;
+		fbufCreateInfo.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffer.frameBuffer));
+	}
+
 	void prepareOffscreenFramebuffers()
 	{
 		// Attachments
-#if defined(__ANDROID__)
-		const uint32_t ssaoWidth = width / 2;
-		const uint32_t ssaoHeight = height / 2;
-#else
-		const uint32_t ssaoWidth = width;
-		const uint32_t ssaoHeight = height;
-#endif
+		const uint32_t ssaoWidth = width / getSSAODivisor();
+		const uint32_t ssaoHeight = height / getSSAODivisor();
 
 		frameBuffers.offscreen.setSize(width, height);
 		frameBuffers.ssao.setSize(ssaoWidth, ssaoHeight);
@@ -258,17 +444,37 @@ public:
 		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &attDepthFormat);
 		assert(validDepthFormat);
 
-		// G-Buffer
-		createAttachment(VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.position, width, height);	// Position + Depth
-		createAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.normal, width, height);			// Normals
-		createAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.albedo, width, height);			// Albedo (color)
-		createAttachment(attDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, &frameBuffers.offscreen.depth, width, height);			// Depth
+		// G-Buffer, only the albedo and the occlusion targets may use lossy fixed-rate compression, positions and normals feed the occlusion estimate
+		// and the temporal history would accumulate the compression error
+		createAttachment(VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.position, width, height, vks::getLosslessCompression(settings.imageCompression));	// Position + Depth
+		createAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.normal, width, height, vks::getLosslessCompression(settings.imageCompression));			// Normals
+		createAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.offscreen.albedo, width, height, settings.imageCompression);			// Albedo (color)
+		createAttachment(attDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, &frameBuffers.offscreen.depth, width, height, vks::getLosslessCompression(settings.imageCompression));			// Depth
 
 		// SSAO
-		createAttachment(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssao.color, ssaoWidth, ssaoHeight);				// Color
+		createAttachment(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssao.color, ssaoWidth, ssaoHeight, settings.imageCompression);				// Color
 
 		// SSAO blur
-		createAttachment(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssaoBlur.color, width, height);					// Color
+		createAttachment(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.ssaoBlur.color, width, height, settings.imageCompression);					// Color
+
+		// Reduced resolution G-Buffer and temporal accumulation
+		if (ssaoResolution > 0)
+		{
+			frameBuffers.downsample.setSize(ssaoWidth, ssaoHeight);
+			frameBuffers.ssaoTemporal.setSize(ssaoWidth, ssaoHeight);
+			createAttachment(VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.downsample.position, ssaoWidth, ssaoHeight, vks::getLosslessCompression(settings.imageCompression));	// Position + Depth
+			createAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.downsample.normal, ssaoWidth, ssaoHeight, vks::getLosslessCompression(settings.imageCompression));			// Normals
+			createAttachment(VK_FORMAT_R16G16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, &frameBuffers.ssaoTemporal.color, ssaoWidth, ssaoHeight, vks::getLosslessCompression(settings.imageCompression));
+			createAttachment(VK_FORMAT_R16G16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, &frameBuffers.ssaoTemporal.history, ssaoWidth, ssaoHeight, vks::getLosslessCompression(settings.imageCompression));
+			// The history is only written by copies, it's kept in the layout it's sampled with
+			// The accumulation target's layout is changed by its render pass, which leaves it for fragment shader reads
+			barrierBatcher->track(frameBuffers.ssaoTemporal.color.image, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, vks::BarrierBatcher::Usage::SampledFragment);
+			barrierBatcher->track(frameBuffers.ssaoTemporal.history.image, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, vks::BarrierBatcher::Usage::Undefined);
+			VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			barrierBatcher->transition(frameBuffers.ssaoTemporal.history.image, vks::BarrierBatcher::Usage::SampledFragment);
+			barrierBatcher->flush(layoutCmd);
+			vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+		}
 
 		// Render passes
 
@@ -354,117 +560,16 @@ public:
 		}
 
 		// SSAO
-		{
-			VkAttachmentDescription attachmentDescription{};
-			attachmentDescription.format = frameBuffers.ssao.color.format;
-			attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-			attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-			attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-			VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
-
-			VkSubpassDescription subpass = {};
-			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-			subpass.pColorAttachments = &colorReference;
-			subpass.colorAttachmentCount = 1;
-
-			std::array<VkSubpassDependency, 2> dependencies;
-
-			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[0].dstSubpass = 0;
-			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-			dependencies[1].srcSubpass = 0;
-			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		prepareColorPass(frameBuffers.ssao, { &frameBuffers.ssao.color });
 
-			VkRenderPassCreateInfo renderPassInfo = {};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-			renderPassInfo.pAttachments = &attachmentDescription;
-			renderPassInfo.attachmentCount = 1;
-			renderPassInfo.subpassCount = 1;
-			renderPassInfo.pSubpasses = &subpass;
-			renderPassInfo.dependencyCount = 2;
-			renderPassInfo.pDependencies = dependencies.data();
-			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.ssao.renderPass));
-
-			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-			fbufCreateInfo.renderPass = frameBuffers.ssao.renderPass;
-			fbufCreateInfo.pAttachments = &frameBuffers.ssao.color.view;
-			fbufCreateInfo.attachmentCount = 1;
-			fbufCreateInfo.width = frameBuffers.ssao.width;
-			fbufCreateInfo.height = frameBuffers.ssao.height;
-			fbufCreateInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.ssao.frameBuffer));
-		}
+		// SSAO Blur (or bilateral upsample at reduced resolutions)
+		prepareColorPass(frameBuffers.ssaoBlur, { &frameBuffers.ssaoBlur.color });
 
-		// SSAO Blur
+		// Reduced resolution G-Buffer and temporal accumulation
+		if (ssaoResolution > 0)
 		{
-			VkAttachmentDescription attachmentDescription{};
-			attachmentDescription.format = frameBuffers.ssaoBlur.color.format;
-			attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-			attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-			attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-			VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
-
-			VkSubpassDescription subpass = {};
-			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-			subpass.pColorAttachments = &colorReference;
-			subpass.colorAttachmentCount = 1;
-
-			std::array<VkSubpassDependency, 2> dependencies;
-
-			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[0].dstSubpass = 0;
-			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-			dependencies[1].srcSubpass = 0;
-			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-			VkRenderPassCreateInfo renderPassInfo = {};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-			renderPassInfo.pAttachments = &attachmentDescription;
-			renderPassInfo.attachmentCount = 1;
-			renderPassInfo.subpassCount = 1;
-			renderPassInfo.pSubpasses = &subpass;
-			renderPassInfo.dependencyCount = 2;
-			renderPassInfo.pDependencies = dependencies.data();
-			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.ssaoBlur.renderPass));
-
-			VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-			fbufCreateInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
-			fbufCreateInfo.pAttachments = &frameBuffers.ssaoBlur.color.view;
-			fbufCreateInfo.attachmentCount = 1;
-			fbufCreateInfo.width = frameBuffers.ssaoBlur.width;
-			fbufCreateInfo.height = frameBuffers.ssaoBlur.height;
-			fbufCreateInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.ssaoBlur.frameBuffer));
+			prepareColorPass(frameBuffers.downsample, { &frameBuffers.downsample.position, &frameBuffers.downsample.normal });
+			prepareColorPass(frameBuffers.ssaoTemporal, { &frameBuffers.ssaoTemporal.color });
 		}
 
 		// Shared sampler used for all color attachments
@@ -486,8 +591,65 @@ public:
 	void loadAssets()
 	{
 		vkglTF::descriptorBindingFlags  = vkglTF::DescriptorBindingFlags::ImageBaseColor;
-		const uint32_t gltfLoadingFlags = vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::PreTransformVertices;
+		uint32_t gltfLoadingFlags = vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::StaticBatching;
+		if (compressTextures) {
+			// Images are only decoded and compressed on the first run, later runs load the blocks from the texture cache
+			textureCompressor.reset(new vks::TextureCompressor(vulkanDevice, getShadersPath() + "base/texturecompress.comp.spv"));
+			vkglTF::textureCompressor = textureCompressor.get();
+			gltfLoadingFlags |= vkglTF::FileLoadingFlags::CompressTextures | vkglTF::FileLoadingFlags::UseCache;
+		}
 		scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, gltfLoadingFlags);
+		vkglTF::textureCompressor = nullptr;
+	}
+
+	// Draw a fullscreen triangle into a pass created with prepareColorPass()
+	void drawFullscreenPass(VkCommandBuffer commandBuffer, const FrameBuffer &frameBuffer, VkPipeline pipeline, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet)
+	{
+		// Enough clear values for the passes with most attachments (downsampled G-Buffer)
+		std::array<VkClearValue, 2> clearValues;
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = frameBuffer.renderPass;
+		renderPassBeginInfo.framebuffer = frameBuffer.frameBuffer;
+		renderPassBeginInfo.renderArea.extent.width = frameBuffer.width;
+		renderPassBeginInfo.renderArea.extent.height = frameBuffer.height;
+		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		renderPassBeginInfo.pClearValues = clearValues.data();
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport = vks::initializers::viewport((float)frameBuffer.width, (float)frameBuffer.height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(frameBuffer.width, frameBuffer.height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	// Keep the accumulated occlusion of this frame for the reprojection in the next frame
+	// Both images are transitioned with one barrier before and one after the copy, which only wait for the fragment shaders reading them
+	void copyTemporalToHistory(VkCommandBuffer commandBuffer)
+	{
+		barrierBatcher->assume(frameBuffers.ssaoTemporal.color.image, vks::BarrierBatcher::Usage::SampledFragment);
+		barrierBatcher->transition(frameBuffers.ssaoTemporal.color.image, vks::BarrierBatcher::Usage::TransferSrc);
+		barrierBatcher->transition(frameBuffers.ssaoTemporal.history.image, vks::BarrierBatcher::Usage::TransferDst, true);
+		barrierBatcher->flush(commandBuffer);
+
+		VkImageCopy copyRegion = {};
+		copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.extent = { (uint32_t)frameBuffers.ssaoTemporal.width, (uint32_t)frameBuffers.ssaoTemporal.height, 1 };
+		vkCmdCopyImage(commandBuffer, frameBuffers.ssaoTemporal.color.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frameBuffers.ssaoTemporal.history.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+		barrierBatcher->transition(frameBuffers.ssaoTemporal.color.image, vks::BarrierBatcher::Usage::SampledFragment);
+		barrierBatcher->transition(frameBuffers.ssaoTemporal.history.image, vks::BarrierBatcher::Usage::SampledFragment);
+		barrierBatcher->flush(commandBuffer);
 	}
 
 	void buildCommandBuffers()
@@ -532,58 +694,37 @@ public:
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
 
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBuffer, 0, 1, &descriptorSets.floor, 0, NULL);
-				scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayouts.gBuffer);
+				if (staticBatching) {
+					scene.drawStaticBatches(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayouts.gBuffer);
+				} else {
+					scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayouts.gBuffer);
+				}
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 
-				/*
-					Second pass: SSAO generation
-				*/
-
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				renderPassBeginInfo.framebuffer = frameBuffers.ssao.frameBuffer;
-				renderPassBeginInfo.renderPass = frameBuffers.ssao.renderPass;
-				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssao.width;
-				renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssao.height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues.data();
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				viewport = vks::initializers::viewport((float)frameBuffers.ssao.width, (float)frameBuffers.ssao.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-				scissor = vks::initializers::rect2D(frameBuffers.ssao.width, frameBuffers.ssao.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssao, 0, 1, &descriptorSets.ssao, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssao);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				/*
-					Third pass: SSAO blur
-				*/
-
-				renderPassBeginInfo.framebuffer = frameBuffers.ssaoBlur.frameBuffer;
-				renderPassBeginInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
-				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssaoBlur.width;
-				renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssaoBlur.height;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				viewport = vks::initializers::viewport((float)frameBuffers.ssaoBlur.width, (float)frameBuffers.ssaoBlur.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-				scissor = vks::initializers::rect2D(frameBuffers.ssaoBlur.width, frameBuffers.ssaoBlur.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoBlur, 0, 1, &descriptorSets.ssaoBlur, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoBlur);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				if (ssaoResolution > 0)
+				{
+					/*
+						Reduced resolution: downsample the G-Buffer, compute and temporally accumulate SSAO at that resolution, then upsample it
+					*/
+					drawFullscreenPass(drawCmdBuffers[i], frameBuffers.downsample, pipelines.downsample, pipelineLayouts.downsample, descriptorSets.downsample);
+					drawFullscreenPass(drawCmdBuffers[i], frameBuffers.ssao, pipelines.ssao, pipelineLayouts.ssao, descriptorSets.ssao);
+					drawFullscreenPass(drawCmdBuffers[i], frameBuffers.ssaoTemporal, pipelines.ssaoTemporal, pipelineLayouts.ssaoTemporal, descriptorSets.ssaoTemporal);
+					copyTemporalToHistory(drawCmdBuffers[i]);
+					drawFullscreenPass(drawCmdBuffers[i], frameBuffers.ssaoBlur, pipelines.ssaoUpsample, pipelineLayouts.ssaoUpsample, descriptorSets.ssaoUpsample);
+				}
+				else
+				{
+					/*
+						Second pass: SSAO generation
+					*/
+					drawFullscreenPass(drawCmdBuffers[i], frameBuffers.ssao, pipelines.ssao, pipelineLayouts.ssao, descriptorSets.ssao);
+
+					/*
+						Third pass: SSAO blur
+					*/
+					drawFullscreenPass(drawCmdBuffers[i], frameBuffers.ssaoBlur, pipelines.ssaoBlur, pipelineLayouts.ssaoBlur, descriptorSets.ssaoBlur);
+				}
 			}
 
 			/*
@@ -633,7 +774,7 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 12)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 20)
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes,  descriptorSets.count);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -646,7 +787,6 @@ public:
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo();
 		VkDescriptorSetAllocateInfo descriptorAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, nullptr, 1);
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
-		std::vector<VkDescriptorImageInfo> imageDescriptors;
 
 		// G-Buffer creation (offscreen scene rendering)
 		setLayoutBindings = {
@@ -681,18 +821,6 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssao));
 		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssao;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssao));
-		imageDescriptors = {
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-		};
-		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),					// FS Position+Depth
-			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),					// FS Normals
-			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.ssaoNoise.descriptor),		// FS SSAO Noise
-			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.ssaoKernel.descriptor),		// FS SSAO Kernel UBO
-			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.ssaoParams.descriptor),		// FS SSAO Params UBO
-		};
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
 		// SSAO Blur
 		setLayoutBindings = {
@@ -704,13 +832,6 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssaoBlur));
 		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssaoBlur;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssaoBlur));
-		imageDescriptors = {
-			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssao.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-		};
-		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(descriptorSets.ssaoBlur, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),
-		};
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
 		// Composition
 		setLayoutBindings = {
@@ -727,6 +848,82 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.composition));
 		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.composition;
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.composition));
+
+		// G-Buffer downsample (reduced resolutions)
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS Position+Depth
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),						// FS Normals
+		};
+		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.downsample));
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.downsample;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.downsample));
+		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.downsample;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.downsample));
+
+		// SSAO temporal accumulation (reduced resolutions)
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS SSAO
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),						// FS SSAO history
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),						// FS Downsampled Position+Depth
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),								// FS Temporal params UBO
+		};
+		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.ssaoTemporal));
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.ssaoTemporal;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssaoTemporal));
+		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssaoTemporal;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssaoTemporal));
+
+		// SSAO joint bilateral upsample (reduced resolutions)
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS Accumulated SSAO
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),						// FS Downsampled Position+Depth
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),						// FS Downsampled Normals
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),						// FS Position+Depth
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),						// FS Normals
+		};
+		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.ssaoUpsample));
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.ssaoUpsample;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.ssaoUpsample));
+		descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssaoUpsample;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &descriptorSets.ssaoUpsample));
+
+		updateDescriptorSets();
+	}
+
+	// Write the attachment descriptors, these change with the SSAO resolution
+	void updateDescriptorSets()
+	{
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+		std::vector<VkDescriptorImageInfo> imageDescriptors;
+
+		// SSAO Generation, from the downsampled G-Buffer at reduced resolutions
+		const bool reduced = ssaoResolution > 0;
+		imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, reduced ? frameBuffers.downsample.position.view : frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, reduced ? frameBuffers.downsample.normal.view : frameBuffers.offscreen.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),					// FS Position+Depth
+			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),					// FS Normals
+			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.ssaoNoise.descriptor),		// FS SSAO Noise
+			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.ssaoKernel.descriptor),		// FS SSAO Kernel UBO
+			vks::initializers::writeDescriptorSet(descriptorSets.ssao, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.ssaoParams.descriptor),		// FS SSAO Params UBO
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// SSAO Blur
+		imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssao.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoBlur, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// Composition
 		imageDescriptors = {
 			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
 			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
@@ -743,6 +940,53 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformBuffers.ssaoParams.descriptor),	// FS SSAO Params UBO
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		if (!reduced)
+		{
+			return;
+		}
+
+		// G-Buffer downsample
+		imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.downsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),			// FS Sampler Position+Depth
+			vks::initializers::writeDescriptorSet(descriptorSets.downsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),			// FS Sampler Normals
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// SSAO temporal accumulation
+		imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssao.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssaoTemporal.history.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.downsample.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),			// FS Sampler SSAO
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),			// FS Sampler SSAO history
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &imageDescriptors[2]),			// FS Sampler Downsampled Position+Depth
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoTemporal, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.temporalParams.descriptor),	// FS Temporal params UBO
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// SSAO joint bilateral upsample
+		imageDescriptors = {
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.ssaoTemporal.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.downsample.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.downsample.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		};
+		writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoUpsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),			// FS Sampler Accumulated SSAO
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoUpsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),			// FS Sampler Downsampled Position+Depth
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoUpsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &imageDescriptors[2]),			// FS Sampler Downsampled Normals
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoUpsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &imageDescriptors[3]),			// FS Sampler Position+Depth
+			vks::initializers::writeDescriptorSet(descriptorSets.ssaoUpsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &imageDescriptors[4]),			// FS Sampler Normals
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 	}
 
 	void preparePipelines()
@@ -783,16 +1027,21 @@ public:
 		{
 			pipelineCreateInfo.renderPass = frameBuffers.ssao.renderPass;
 			pipelineCreateInfo.layout = pipelineLayouts.ssao;
-			// SSAO Kernel size and radius are constant for this pipeline, so we set them using specialization constants
+			// SSAO Kernel size, radius and the number of samples taken per frame are constant for this pipeline, so we set them using specialization constants
 			struct SpecializationData {
 				uint32_t kernelSize = SSAO_KERNEL_SIZE;
 				float radius = SSAO_RADIUS;
+				uint32_t sampleCount = SSAO_KERNEL_SIZE;
 			} specializationData;
-			std::array<VkSpecializationMapEntry, 2> specializationMapEntries = {
+			if (ssaoResolution > 0) {
+				specializationData.sampleCount = SSAO_REDUCED_SAMPLE_COUNT;
+			}
+			std::array<VkSpecializationMapEntry, 3> specializationMapEntries = {
 				vks::initializers::specializationMapEntry(0, offsetof(SpecializationData, kernelSize), sizeof(SpecializationData::kernelSize)),
-				vks::initializers::specializationMapEntry(1, offsetof(SpecializationData, radius), sizeof(SpecializationData::radius))
+				vks::initializers::specializationMapEntry(1, offsetof(SpecializationData, radius), sizeof(SpecializationData::radius)),
+				vks::initializers::specializationMapEntry(2, offsetof(SpecializationData, sampleCount), sizeof(SpecializationData::sampleCount))
 			};
-			VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(2, specializationMapEntries.data(), sizeof(specializationData), &specializationData);
+			VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(3, specializationMapEntries.data(), sizeof(specializationData), &specializationData);
 			shaderStages[1] = loadShader(getShadersPath() + "ssao/ssao.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 			shaderStages[1].pSpecializationInfo = &specializationInfo;
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssao));
@@ -806,6 +1055,38 @@ public:
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoBlur));
 		}
 
+		// Reduced resolution pipelines
+		if (ssaoResolution > 0)
+		{
+			// Temporal accumulation
+			pipelineCreateInfo.renderPass = frameBuffers.ssaoTemporal.renderPass;
+			pipelineCreateInfo.layout = pipelineLayouts.ssaoTemporal;
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/temporal.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoTemporal));
+
+			// Joint bilateral upsample, writes to the blur target
+			pipelineCreateInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
+			pipelineCreateInfo.layout = pipelineLayouts.ssaoUpsample;
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/upsample.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoUpsample));
+
+			// G-Buffer downsample, the ratio of the resolutions is a specialization constant
+			uint32_t downsampleFactor = getSSAODivisor();
+			VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
+			VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(uint32_t), &downsampleFactor);
+			std::array<VkPipelineColorBlendAttachmentState, 2> blendAttachmentStates = {
+				vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
+				vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE)
+			};
+			colorBlendState.attachmentCount = static_cast<uint32_t>(blendAttachmentStates.size());
+			colorBlendState.pAttachments = blendAttachmentStates.data();
+			pipelineCreateInfo.renderPass = frameBuffers.downsample.renderPass;
+			pipelineCreateInfo.layout = pipelineLayouts.downsample;
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/downsample.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			shaderStages[1].pSpecializationInfo = &specializationInfo;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.downsample));
+		}
+
 		// Fill G-Buffer pipeline
 		{
 			// Vertex input state from glTF model loader
@@ -851,6 +1132,18 @@ public:
 			&uniformBuffers.ssaoParams,
 			sizeof(uboSSAOParams));
 
+		// Map persistent
+		VK_CHECK_RESULT(uniformBuffers.sceneParams.map());
+		VK_CHECK_RESULT(uniformBuffers.ssaoParams.map());
+
+		// Temporal accumulation parameters, updated every frame
+		vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffers.temporalParams,
+			sizeof(uboTemporalParams));
+		VK_CHECK_RESULT(uniformBuffers.temporalParams.map());
+
 		// Update
 		updateUniformBufferMatrices();
 		updateUniformBufferSSAOParams();
@@ -895,18 +1188,50 @@ public:
 		uboSceneParams.view = camera.matrices.view;
 		uboSceneParams.model = glm::mat4(1.0f);
 
-		VK_CHECK_RESULT(uniformBuffers.sceneParams.map());
 		uniformBuffers.sceneParams.copyTo(&uboSceneParams, sizeof(uboSceneParams));
-		uniformBuffers.sceneParams.unmap();
 	}
 
 	void updateUniformBufferSSAOParams()
 	{
 		uboSSAOParams.projection = camera.matrices.perspective;
 
-		VK_CHECK_RESULT(uniformBuffers.ssaoParams.map());
-		uniformBuffers.ssaoParams.copyTo(&uboSSAOParams, sizeof(uboSSAOParams));
-		uniformBuffers.ssaoParams.unmap();
+		// At reduced resolutions the blur target holds the upsampled occlusion, so it's always used
+		UBOSSAOParams params = uboSSAOParams;
+		if (ssaoResolution > 0) {
+			params.ssaoBlur = true;
+		}
+
+		uniformBuffers.ssaoParams.copyTo(&params, sizeof(params));
+	}
+
+	// Advance the accumulation at reduced resolutions: the next frame uses another noise offset and kernel subset, and reprojects this frame's result
+	void updateTemporalParams()
+	{
+		uboTemporalParams.reprojection = previousViewProjection * glm::inverse(camera.matrices.view);
+		uboTemporalParams.historyWeight = temporalWeight;
+		uboTemporalParams.historyValid = historyValid;
+		memcpy(uniformBuffers.temporalParams.mapped, &uboTemporalParams, sizeof(uboTemporalParams));
+		previousViewProjection = camera.matrices.perspective * camera.matrices.view;
+		historyValid = true;
+
+		uboSSAOParams.frameIndex++;
+		updateUniformBufferSSAOParams();
+	}
+
+	// Recreate the resolution dependent attachments and pipelines, e.g. after changing the SSAO resolution
+	void rebuildOffscreenFramebuffers()
+	{
+		vkDeviceWaitIdle(device);
+		destroyOffscreenFramebuffers();
+		destroyPipelines();
+		prepareOffscreenFramebuffers();
+		updateDescriptorSets();
+		preparePipelines();
+		buildCommandBuffers();
+		// The new history has no valid contents
+		historyValid = false;
+		uboSSAOParams.frameIndex = 0;
+		updateUniformBufferSSAOParams();
 	}
 
 	void draw()
@@ -914,13 +1239,14 @@ public:
 		VulkanExampleBase::prepareFrame();
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
 	}
 
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		barrierBatcher = new vks::BarrierBatcher(device, synchronization2Supported);
 		loadAssets();
 		prepareOffscreenFramebuffers();
 		prepareUniformBuffers();
@@ -936,6 +1262,9 @@ public:
 		if (!prepared) {
 			return;
 		}
+		if (ssaoResolution > 0) {
+			updateTemporalParams();
+		}
 		draw();
 		if (camera.updated) {
 			updateUniformBufferMatrices();
@@ -949,18 +1278,43 @@ public:
 		updateUniformBufferSSAOParams();
 	}
 
+	virtual void windowResized()
+	{
+		rebuildOffscreenFramebuffers();
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
 			if (overlay->checkBox("Enable SSAO", &uboSSAOParams.ssao)) {
 				updateUniformBufferSSAOParams();
 			}
-			if (overlay->checkBox("SSAO blur", &uboSSAOParams.ssaoBlur)) {
-				updateUniformBufferSSAOParams();
+			if (overlay->comboBox("SSAO resolution", &ssaoResolution, { "Full", "Half", "Quarter" })) {
+				rebuildOffscreenFramebuffers();
+			}
+			if (ssaoResolution == 0) {
+				if (overlay->checkBox("SSAO blur", &uboSSAOParams.ssaoBlur)) {
+					updateUniformBufferSSAOParams();
+				}
+			} else {
+				overlay->sliderFloat("Temporal weight", &temporalWeight, 0.0f, 0.95f);
 			}
 			if (overlay->checkBox("SSAO pass only", &uboSSAOParams.ssaoOnly)) {
 				updateUniformBufferSSAOParams();
 			}
+			overlay->checkBox("Static batching", &staticBatching);
+			overlay->text("G-Buffer draws: %d (%d unbatched)", staticBatching ? static_cast<uint32_t>(scene.staticBatching.batches.size()) : scene.staticBatching.primitiveCount, scene.staticBatching.primitiveCount);
+		}
+		if (settings.imageCompressionControl && overlay->header("Framebuffer compression")) {
+			overlay->text("Position: %s", frameBuffers.offscreen.position.compression.toString().c_str());
+			overlay->text("Normals: %s", frameBuffers.offscreen.normal.compression.toString().c_str());
+			overlay->text("Albedo: %s", frameBuffers.offscreen.albedo.compression.toString().c_str());
+			overlay->text("Depth: %s", frameBuffers.offscreen.depth.compression.toString().c_str());
+			overlay->text("SSAO: %s", frameBuffers.ssao.color.compression.toString().c_str());
+			overlay->text("SSAO blur: %s", frameBuffers.ssaoBlur.color.compression.toString().c_str());
+			if (ssaoResolution > 0) {
+				overlay->text("Temporal accumulation: %s", frameBuffers.ssaoTemporal.color.compression.toString().c_str());
+			}
 		}
 	}
 };
@@ -1,5 +1,9 @@
 /*
-* Vulkan Example - Rendering outlines using the stencil buffer
+* Vulkan Example - Rendering outlines and selection highlights
+*
+* Outlines the selected objects either with a screen space jump flood distance field built from an object id mask (constant number of
+* passes for any outline width, see vks::OutlineRenderer), or by drawing the objects extruded along their normals where the stencil buffer
+* wasn't set by the objects themselves
 *
 * Copyright (C) 2016-2017 by Sascha Willems - www.saschawillems.de
 *
@@ -8,6 +12,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanOutlineRenderer.h"
 
 #define ENABLE_VALIDATION false
 
@@ -26,9 +31,28 @@ public:
 
 	vks::Buffer uniformBufferVS;
 
+	enum OutlineMethod {
+		JumpFlood = 0,
+		Stencil = 1,
+	};
+	int32_t outlineMethod = JumpFlood;
+	const std::vector<std::string> outlineMethodNames = { "Jump flood", "Stencil" };
+
+	static const uint32_t objectCount = 3;
+	// Objects are drawn with their offset and mask id (index + 1, 0 is no object) passed as push constants
+	struct PushConstants {
+		glm::vec4 offset;
+		uint32_t id;
+	};
+	std::array<bool, objectCount> selected = { true, false, true };
+
+	vks::OutlineRenderer *outlineRenderer = nullptr;
+	vks::OutlineRenderer::Settings outlineSettings;
+
 	struct {
 		VkPipeline stencil;
 		VkPipeline outline;
+		VkPipeline mask;
 	} pipelines;
 
 	VkPipelineLayout pipelineLayout;
@@ -42,18 +66,42 @@ public:
 		camera.type = Camera::CameraType::lookat;
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 512.0f);
 		camera.setRotation(glm::vec3(2.5f, -35.0f, 0.0f));
-		camera.setTranslation(glm::vec3(0.0f, 0.0f, -2.0f));
+		camera.setTranslation(glm::vec3(0.0f, 0.0f, -3.5f));
+		outlineSettings.fillOpacity = 0.15f;
 	}
 
 	~VulkanExample()
 	{
+		delete outlineRenderer;
 		vkDestroyPipeline(device, pipelines.stencil, nullptr);
 		vkDestroyPipeline(device, pipelines.outline, nullptr);
+		vkDestroyPipeline(device, pipelines.mask, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		uniformBufferVS.destroy();
 	}
 
+	PushConstants getPushConstants(uint32_t index) const
+	{
+		PushConstants pushConstants{};
+		pushConstants.offset = glm::vec4((static_cast<float>(index) - static_cast<float>(objectCount - 1) * 0.5f) * 1.2f, 0.0f, 0.0f, 0.0f);
+		pushConstants.id = index + 1;
+		return pushConstants;
+	}
+
+	void drawObjects(VkCommandBuffer commandBuffer, bool selectedOnly)
+	{
+		for (uint32_t i = 0; i < objectCount; i++)
+		{
+			if (selectedOnly && !selected[i]) {
+				continue;
+			}
+			PushConstants pushConstants = getPushConstants(i);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &pushConstants);
+			model.draw(commandBuffer);
+		}
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -77,6 +125,20 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			VkDeviceSize offsets[1] = { 0 };
+
+			if (outlineMethod == JumpFlood) {
+				// Id mask of the selected objects and the distances to its borders, before the scene's render pass
+				outlineRenderer->beginMask(drawCmdBuffers[i]);
+				vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &model.vertices.buffer, offsets);
+				vkCmdBindIndexBuffer(drawCmdBuffers[i], model.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.mask);
+				drawObjects(drawCmdBuffers[i], true);
+				outlineRenderer->endMask(drawCmdBuffers[i]);
+				outlineRenderer->generate(drawCmdBuffers[i]);
+			}
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -85,8 +147,6 @@ public:
 			VkRect2D scissor = vks::initializers::rect2D(width, height,	0, 0);
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			VkDeviceSize offsets[1] = { 0 };
-
 			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &model.vertices.buffer, offsets);
 			vkCmdBindIndexBuffer(drawCmdBuffers[i], model.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 
@@ -94,11 +154,16 @@ public:
 
 			// First pass renders object (toon shaded) and fills stencil buffer
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.stencil);
-			model.draw(drawCmdBuffers[i]);
+			drawObjects(drawCmdBuffers[i], false);
 
-			// Second pass renders scaled object only where stencil was not set by first pass
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.outline);
-			model.draw(drawCmdBuffers[i]);
+			if (outlineMethod == JumpFlood) {
+				outlineRenderer->draw(drawCmdBuffers[i]);
+			}
+			else {
+				// Second pass renders scaled object only where stencil was not set by first pass
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.outline);
+				drawObjects(drawCmdBuffers[i], true);
+			}
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -135,6 +200,9 @@ public:
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo =
 			vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushConstants), 0);
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
 	}
 
@@ -198,6 +266,19 @@ public:
 		shaderStages[0] = loadShader(getShadersPath() + "stencilbuffer/outline.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "stencilbuffer/outline.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.outline));
+		// Id mask of the jump flood outlines, without depth so hidden parts of the selected objects are outlined too
+		depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_ALWAYS);
+		pipelineCI.renderPass = outlineRenderer->getMaskRenderPass();
+		shaderStages[0] = loadShader(getShadersPath() + "stencilbuffer/mask.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "stencilbuffer/mask.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.mask));
+	}
+
+	void prepareOutlineRenderer()
+	{
+		outlineRenderer = new vks::OutlineRenderer(vulkanDevice, renderPass, pipelineCache, getShadersPath() + "base/");
+		outlineRenderer->setSettings(outlineSettings);
+		outlineRenderer->resize(width, height);
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -229,7 +310,7 @@ public:
 
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -239,6 +320,7 @@ public:
 		VulkanExampleBase::prepare();
 		loadAssets();
 		prepareUniformBuffers();
+		prepareOutlineRenderer();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
@@ -259,11 +341,45 @@ public:
 		updateUniformBuffers();
 	}
 
+	virtual void windowResized()
+	{
+		outlineRenderer->resize(width, height);
+		// The command buffers have been recorded with the old id mask and distance images
+		buildCommandBuffers();
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
-			if (overlay->inputFloat("Outline width", &uboVS.outlineWidth, 0.05f, 2)) {
-				updateUniformBuffers();
+			if (overlay->comboBox("Method", &outlineMethod, outlineMethodNames)) {
+				vulkanDevice->queueWaitIdle(queue);
+				buildCommandBuffers();
+			}
+			for (uint32_t i = 0; i < objectCount; i++) {
+				const std::string caption = "Select object " + std::to_string(i + 1);
+				if (overlay->checkBox(caption.c_str(), &selected[i])) {
+					vulkanDevice->queueWaitIdle(queue);
+					buildCommandBuffers();
+				}
+			}
+			if (outlineMethod == JumpFlood) {
+				bool settingsChanged = overlay->sliderFloat("Outline width (px)", &outlineSettings.width, 1.0f, 64.0f);
+				settingsChanged |= overlay->sliderFloat("Fill opacity", &outlineSettings.fillOpacity, 0.0f, 1.0f);
+				if (settingsChanged) {
+					const uint32_t passCount = outlineRenderer->getPassCount();
+					vulkanDevice->queueWaitIdle(queue);
+					outlineRenderer->setSettings(outlineSettings);
+					// Wider outlines need more jump flood passes
+					if (outlineRenderer->getPassCount() != passCount) {
+						buildCommandBuffers();
+					}
+				}
+				overlay->text("Compute passes: %d", outlineRenderer->getPassCount());
+			}
+			else {
+				if (overlay->inputFloat("Outline width", &uboVS.outlineWidth, 0.05f, 2)) {
+					updateUniformBuffers();
+				}
 			}
 		}
 	}
@@ -820,6 +820,10 @@ public:
 			&uniformBuffers.lights,
 			sizeof(uboLights));
 
+		// Map persistent
+		VK_CHECK_RESULT(uniformBuffers.GBuffer.map());
+		VK_CHECK_RESULT(uniformBuffers.lights.map());
+
 		// Update
 		updateUniformBufferDeferredMatrices();
 		updateUniformBufferDeferredLights();
@@ -831,9 +835,7 @@ public:
 		uboGBuffer.view = camera.matrices.view;
 		uboGBuffer.model = glm::mat4(1.0f);
 
-		VK_CHECK_RESULT(uniformBuffers.GBuffer.map());
 		memcpy(uniformBuffers.GBuffer.mapped, &uboGBuffer, sizeof(uboGBuffer));
-		uniformBuffers.GBuffer.unmap();
 	}
 
 	void initLights()
@@ -865,9 +867,7 @@ public:
 		// Current view position
 		uboLights.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
 
-		VK_CHECK_RESULT(uniformBuffers.lights.map());
 		memcpy(uniformBuffers.lights.mapped, &uboLights, sizeof(uboLights));
-		uniformBuffers.lights.unmap();
 	}
 
 	void draw()
@@ -879,7 +879,7 @@ public:
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
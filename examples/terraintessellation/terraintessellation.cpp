@@ -9,6 +9,9 @@
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
 #include "frustum.hpp"
+#include "VulkanTerrainClipmap.h"
+#include "VulkanQueryReadback.h"
+#include <memory>
 #include <ktx.h>
 #include <ktxvulkan.h>
 
@@ -19,6 +22,20 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool wireframe = false;
 	bool tessellation = true;
+	// Renders a quadtree of tessellated patch grids over a terrain streamed into a clipmap instead of the fixed patch grid
+	bool streamingTerrain = false;
+	bool showLod = false;
+	// Tessellation factor of the streaming terrain's patches as a power of two
+	int32_t streamingTessellationLevel = 2;
+
+	// Leaves selected per frame (and nodes per quadtree depth), has to be a multiple of four
+	const uint32_t streamingMaxNodes = 4096;
+	// Patches per side of the grid drawn for each leaf
+	const uint32_t streamingGridSize = 8;
+	const float streamingTexelSize = 0.5f;
+	const float streamingHeightScale = 128.0f;
+	// Approximate world space size of the smallest leaves
+	const float streamingLeafSize = 16.0f;
 
 	// Holds the buffers for rendering the tessellated terrain
 	struct {
@@ -33,6 +50,20 @@ public:
 		} indices;
 	} terrain;
 
+	// Buffers of the streaming terrain's quadtree node selection and the patch grid instanced per leaf
+	struct {
+		vks::Buffer vertices;
+		vks::Buffer indices;
+		uint32_t indexCount = 0;
+		vks::Buffer nodes;
+		vks::Buffer counters;
+		vks::Buffer leaves;
+		vks::Buffer drawCommand;
+		uint32_t maxDepth = 0;
+	} streaming;
+
+	std::unique_ptr<vks::TerrainClipmap> clipmap;
+
 	struct {
 		vks::Texture2D heightMap;
 		vks::Texture2D skySphere;
@@ -46,6 +77,7 @@ public:
 	struct {
 		vks::Buffer terrainTessellation;
 		vks::Buffer skysphereVertex;
+		vks::Buffer streaming;
 	} uniformBuffers;
 
 	// Shared values for tessellation control and evaluation stages
@@ -61,6 +93,31 @@ public:
 		float tessellatedEdgeSize = 20.0f;
 	} uboTess;
 
+	// Shared values for the streaming terrain's node selection and tessellation stages
+	struct {
+		glm::mat4 projection;
+		glm::mat4 modelview;
+		glm::vec4 cameraPos;
+		glm::vec4 lightDir = glm::vec4(glm::normalize(glm::vec3(-48.0f, -40.0f, 46.0f)), 0.0f);
+		glm::vec4 frustumPlanes[6];
+		glm::ivec4 clipRegions[vks::TerrainClipmap::maxLevels];
+		glm::vec2 terrainOrigin;
+		float terrainSize;
+		float terrainTexels;
+		float texelSize;
+		float heightScale;
+		// Nodes closer to the camera than lodRange times their size are split
+		float lodRange = 2.0f;
+		float tessellationFactor;
+		uint32_t maxDepth;
+		uint32_t clipLevels;
+		float clipSize;
+		// Width of the transition to the next coarser clipmap level in texels of the finer one
+		float blendTexels = 16.0f;
+		uint32_t maxNodes;
+		uint32_t showLod;
+	} uboStreaming;
+
 	// Skysphere vertex shader stage
 	struct {
 		glm::mat4 mvp;
@@ -70,30 +127,33 @@ public:
 		VkPipeline terrain;
 		VkPipeline wireframe = VK_NULL_HANDLE;
 		VkPipeline skysphere;
+		VkPipeline streaming;
+		VkPipeline streamingWireframe = VK_NULL_HANDLE;
+		VkPipeline streamingSelect;
 	} pipelines;
 
 	struct {
 		VkDescriptorSetLayout terrain;
 		VkDescriptorSetLayout skysphere;
+		VkDescriptorSetLayout streaming;
 	} descriptorSetLayouts;
 
 	struct {
 		VkPipelineLayout terrain;
 		VkPipelineLayout skysphere;
+		VkPipelineLayout streaming;
 	} pipelineLayouts;
 
 	struct {
 		VkDescriptorSet terrain;
 		VkDescriptorSet skysphere;
+		VkDescriptorSet streaming;
 	} descriptorSets;
 
-	// Pipeline statistics
-	struct {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-	} queryResult;
-	VkQueryPool queryPool = VK_NULL_HANDLE;
-	uint64_t pipelineStats[2] = { 0 };
+	// Pipeline statistics query pools of all command buffers, with the results copied to a host buffer on the GPU
+	std::unique_ptr<vks::QueryReadback> queries;
+	// Vertex shader invocations, primitives generated by the tessellator (clipping invocations) and evaluation shader invocations
+	std::vector<uint64_t> pipelineStats = std::vector<uint64_t>(3, 0);
 
 	// View frustum passed to tessellation control shader for culling
 	vks::Frustum frustum;
@@ -101,6 +161,7 @@ public:
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Dynamic terrain tessellation";
+		supportsFramesInFlight = true;
 		camera.type = Camera::CameraType::firstperson;
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 512.0f);
 		camera.setRotation(glm::vec3(-12.0f, 159.0f, 0.0f));
@@ -117,15 +178,31 @@ public:
 			vkDestroyPipeline(device, pipelines.wireframe, nullptr);
 		}
 		vkDestroyPipeline(device, pipelines.skysphere, nullptr);
+		vkDestroyPipeline(device, pipelines.streaming, nullptr);
+		if (pipelines.streamingWireframe != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.streamingWireframe, nullptr);
+		}
+		vkDestroyPipeline(device, pipelines.streamingSelect, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.skysphere, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.terrain, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.streaming, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.terrain, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.skysphere, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.streaming, nullptr);
 
 		uniformBuffers.skysphereVertex.destroy();
 		uniformBuffers.terrainTessellation.destroy();
+		uniformBuffers.streaming.destroy();
+
+		streaming.vertices.destroy();
+		streaming.indices.destroy();
+		streaming.nodes.destroy();
+		streaming.counters.destroy();
+		streaming.leaves.destroy();
+		streaming.drawCommand.destroy();
+		clipmap.reset();
 
 		textures.heightMap.destroy();
 		textures.skySphere.destroy();
@@ -136,11 +213,7 @@ public:
 		vkDestroyBuffer(device, terrain.indices.buffer, nullptr);
 		vkFreeMemory(device, terrain.indices.memory, nullptr);
 
-		if (queryPool != VK_NULL_HANDLE) {
-			vkDestroyQueryPool(device, queryPool, nullptr);
-			vkDestroyBuffer(device, queryResult.buffer, nullptr);
-			vkFreeMemory(device, queryResult.memory, nullptr);
-		}
+		queries.reset();
 	}
 
 	// Enable physical device features required for this example
@@ -177,52 +250,25 @@ public:
 		}
 	}
 
-	// Setup pool and buffer for storing pipeline statistics results
-	void setupQueryResultBuffer()
+	// Setup the query pools for the pipeline statistics, one per command buffer
+	void setupQueryPool()
 	{
-		uint32_t bufSize = 2 * sizeof(uint64_t);
-
-		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkBufferCreateInfo bufferCreateInfo =
-			vks::initializers::bufferCreateInfo(
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				bufSize);
-
-		// Results are saved in a host visible buffer for easy access by the application
-		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &queryResult.buffer));
-		vkGetBufferMemoryRequirements(device, queryResult.buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &queryResult.memory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device, queryResult.buffer, queryResult.memory, 0));
-
-		// Create query pool
-		if (deviceFeatures.pipelineStatisticsQuery) {
-			VkQueryPoolCreateInfo queryPoolInfo = {};
-			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
-			queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
-			queryPoolInfo.pipelineStatistics =
-				VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
-				VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT;
-			queryPoolInfo.queryCount = 2;
-			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, NULL, &queryPool));
-		}
+		// The results are copied into a host visible buffer by the command buffers
+		queries.reset(new vks::QueryReadback(
+			vulkanDevice,
+			VK_QUERY_TYPE_PIPELINE_STATISTICS,
+			1,
+			static_cast<uint32_t>(drawCmdBuffers.size()),
+			VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT));
 	}
 
-	// Retrieves the results of the pipeline statistics query submitted to the command buffer
+	// Retrieves the results of the pipeline statistics query of the last completed submission of the current command buffer
 	void getQueryResults()
 	{
-		// We use vkGetQueryResults to copy the results into a host visible buffer
-		vkGetQueryPoolResults(
-			device,
-			queryPool,
-			0,
-			1,
-			sizeof(pipelineStats),
-			pipelineStats,
-			sizeof(uint64_t),
-			VK_QUERY_RESULT_64_BIT);
+		// Reading the copy doesn't wait for the GPU
+		queries->getResults(currentBuffer, pipelineStats);
 	}
 
 	void loadAssets()
@@ -240,7 +286,7 @@ public:
 		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
 
 		// Setup a mirroring sampler for the height map
-		vkDestroySampler(device, textures.heightMap.sampler, nullptr);
+		vulkanDevice->getSamplerCache()->release(textures.heightMap.sampler);
 		samplerInfo.magFilter = VK_FILTER_LINEAR;
 		samplerInfo.minFilter = VK_FILTER_LINEAR;
 		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
@@ -251,11 +297,11 @@ public:
 		samplerInfo.minLod = 0.0f;
 		samplerInfo.maxLod = (float)textures.heightMap.mipLevels;
 		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device, &samplerInfo, nullptr, &textures.heightMap.sampler));
+		textures.heightMap.sampler = vulkanDevice->getSamplerCache()->get(samplerInfo);
 		textures.heightMap.descriptor.sampler = textures.heightMap.sampler;
 
 		// Setup a repeating sampler for the terrain texture layers
-		vkDestroySampler(device, textures.terrainArray.sampler, nullptr);
+		vulkanDevice->getSamplerCache()->release(textures.terrainArray.sampler);
 		samplerInfo = vks::initializers::samplerCreateInfo();
 		samplerInfo.magFilter = VK_FILTER_LINEAR;
 		samplerInfo.minFilter = VK_FILTER_LINEAR;
@@ -272,7 +318,7 @@ public:
 			samplerInfo.maxAnisotropy = 4.0f;
 			samplerInfo.anisotropyEnable = VK_TRUE;
 		}
-		VK_CHECK_RESULT(vkCreateSampler(device, &samplerInfo, nullptr, &textures.terrainArray.sampler));
+		textures.terrainArray.sampler = vulkanDevice->getSamplerCache()->get(samplerInfo);
 		textures.terrainArray.descriptor.sampler = textures.terrainArray.sampler;
 	}
 
@@ -293,14 +339,23 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
+		// The number of command buffers changes if the swap chain is recreated with a different number of images
+		if (queries && (queries->getSlotCount() != drawCmdBuffers.size())) {
+			setupQueryPool();
+		}
+
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			renderPassBeginInfo.framebuffer = frameBuffers[i];
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			if (deviceFeatures.pipelineStatisticsQuery) {
-				vkCmdResetQueryPool(drawCmdBuffers[i], queryPool, 0, 2);
+			if (queries) {
+				queries->reset(drawCmdBuffers[i], i);
+			}
+
+			if (streamingTerrain) {
+				recordNodeSelection(drawCmdBuffers[i]);
 			}
 
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
@@ -321,29 +376,78 @@ public:
 			models.skysphere.draw(drawCmdBuffers[i]);
 
 			// Tessellated terrain
-			if (deviceFeatures.pipelineStatisticsQuery) {
+			if (queries) {
 				// Begin pipeline statistics query
-				vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 0, 0);
+				queries->begin(drawCmdBuffers[i], i, 0);
 			}
 			// Render
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.terrain);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.terrain, 0, 1, &descriptorSets.terrain, 0, nullptr);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &terrain.vertices.buffer, offsets);
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], terrain.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdDrawIndexed(drawCmdBuffers[i], terrain.indices.count, 1, 0, 0, 0);
-			if (deviceFeatures.pipelineStatisticsQuery) {
+			if (streamingTerrain) {
+				// One instance of the patch grid per selected leaf, the instance count is written by the node selection
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.streamingWireframe : pipelines.streaming);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.streaming, 0, 1, &descriptorSets.streaming, 0, nullptr);
+				vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &streaming.vertices.buffer, offsets);
+				vkCmdBindIndexBuffer(drawCmdBuffers[i], streaming.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+				vkCmdDrawIndexedIndirect(drawCmdBuffers[i], streaming.drawCommand.buffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+			}
+			else {
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.terrain);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.terrain, 0, 1, &descriptorSets.terrain, 0, nullptr);
+				vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &terrain.vertices.buffer, offsets);
+				vkCmdBindIndexBuffer(drawCmdBuffers[i], terrain.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+				vkCmdDrawIndexed(drawCmdBuffers[i], terrain.indices.count, 1, 0, 0, 0);
+			}
+			if (queries) {
 				// End pipeline statistics query
-				vkCmdEndQuery(drawCmdBuffers[i], queryPool, 0);
+				queries->end(drawCmdBuffers[i], i, 0);
 			}
 
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			if (queries) {
+				// Copy the results for the host, must be done outside of render pass
+				queries->copyResults(drawCmdBuffers[i], i);
+			}
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
 
+	// Select the quadtree leaves of the streaming terrain on the GPU, one compute dispatch per depth
+	void recordNodeSelection(VkCommandBuffer commandBuffer)
+	{
+		// The previous frame's draw has to be done with the buffers before the counters are reset
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		vkCmdFillBuffer(commandBuffer, streaming.counters.buffer, 0, VK_WHOLE_SIZE, 0);
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.streamingSelect);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayouts.streaming, 0, 1, &descriptorSets.streaming, 0, nullptr);
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		for (uint32_t depth = 0; depth <= streaming.maxDepth; depth++) {
+			// A depth has at most 4^depth nodes, and never more than fit into the node list
+			const uint32_t nodeCount = std::min(1u << std::min(2 * depth, 31u), streamingMaxNodes);
+			vkCmdPushConstants(commandBuffer, pipelineLayouts.streaming, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &depth);
+			vkCmdDispatch(commandBuffer, (nodeCount + 63) / 64, 1, 1);
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+		// Write the leaf count to the draw command
+		const uint32_t finalDepth = streaming.maxDepth + 1;
+		vkCmdPushConstants(commandBuffer, pipelineLayouts.streaming, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &finalDepth);
+		vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
 	// Encapsulate height map data for easy sampling
 	struct HeightMap
 	{
@@ -547,19 +651,82 @@ public:
 		delete[] indices;
 	}
 
+	// Create the streaming terrain's clipmap, the patch grid and the node selection buffers
+	void prepareStreamingTerrain()
+	{
+		clipmap.reset(new vks::TerrainClipmap(vulkanDevice, queue, getAssetPath() + "textures/terrain_heightmap_r16.ktx", streamingTexelSize, streamingHeightScale, settings.framesInFlight));
+
+		// Smallest leaves get close to streamingLeafSize
+		const float terrainSize = clipmap->getWidth() * streamingTexelSize;
+		streaming.maxDepth = 0;
+		while ((terrainSize / static_cast<float>(2 << streaming.maxDepth) >= streamingLeafSize) && (streaming.maxDepth < 16)) {
+			streaming.maxDepth++;
+		}
+
+		// Patch grid in leaf local coordinates (0..1), using the same patch layout as the fixed terrain
+		const uint32_t gridVertices = streamingGridSize + 1;
+		std::vector<glm::vec2> vertices(gridVertices * gridVertices);
+		for (uint32_t x = 0; x < gridVertices; x++) {
+			for (uint32_t y = 0; y < gridVertices; y++) {
+				vertices[x + y * gridVertices] = glm::vec2(x, y) / static_cast<float>(streamingGridSize);
+			}
+		}
+		std::vector<uint32_t> indices(streamingGridSize * streamingGridSize * 4);
+		for (uint32_t x = 0; x < streamingGridSize; x++) {
+			for (uint32_t y = 0; y < streamingGridSize; y++) {
+				uint32_t index = (x + y * streamingGridSize) * 4;
+				indices[index] = (x + y * gridVertices);
+				indices[index + 1] = indices[index] + gridVertices;
+				indices[index + 2] = indices[index + 1] + 1;
+				indices[index + 3] = indices[index] + 1;
+			}
+		}
+		streaming.indexCount = static_cast<uint32_t>(indices.size());
+
+		struct {
+			vks::Buffer vertices;
+			vks::Buffer indices;
+			vks::Buffer drawCommand;
+		} staging;
+		// The instance count is written by the node selection every frame
+		VkDrawIndexedIndirectCommand drawCommand = { streaming.indexCount, 0, 0, 0, 0 };
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging.vertices, vertices.size() * sizeof(glm::vec2), vertices.data()));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging.indices, indices.size() * sizeof(uint32_t), indices.data()));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging.drawCommand, sizeof(drawCommand), &drawCommand));
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &streaming.vertices, staging.vertices.size));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &streaming.indices, staging.indices.size));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &streaming.drawCommand, sizeof(drawCommand)));
+		// Two halves of streamingMaxNodes uvec2 node coordinates, swapping roles between the depths
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &streaming.nodes, 2 * streamingMaxNodes * sizeof(glm::uvec2)));
+		// Node counts per depth followed by the leaf count
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &streaming.counters, (streaming.maxDepth + 2) * sizeof(uint32_t)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &streaming.leaves, streamingMaxNodes * sizeof(glm::vec4)));
+
+		vulkanDevice->copyBuffer(&staging.vertices, &streaming.vertices, queue);
+		vulkanDevice->copyBuffer(&staging.indices, &streaming.indices, queue);
+		vulkanDevice->copyBuffer(&staging.drawCommand, &streaming.drawCommand, queue);
+
+		staging.vertices.destroy();
+		staging.indices.destroy();
+		staging.drawCommand.destroy();
+	}
+
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				static_cast<uint32_t>(poolSizes.size()),
 				poolSizes.data(),
-				2);
+				3);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -614,6 +781,60 @@ public:
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.skysphere));
 		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.skysphere, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.skysphere));
+
+		// Streaming terrain, shared by the node selection and the tessellation pipelines
+		setLayoutBindings =
+		{
+			// Binding 0 : Shared ubo
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT | VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				0),
+			// Binding 1 : Clipmap heights
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				1),
+			// Binding 2 : Clipmap normals
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				2),
+			// Binding 3 : Terrain texture array layers
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				3),
+			// Binding 4 : Quadtree nodes
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				4),
+			// Binding 5 : Node and leaf counters
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				5),
+			// Binding 6 : Selected leaves
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT,
+				6),
+			// Binding 7 : Indirect draw command
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				7),
+		};
+
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayouts.streaming));
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.streaming, 1);
+		// Depth processed by a node selection dispatch
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), 0);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.streaming));
 	}
 
 	void setupDescriptorSets()
@@ -668,6 +889,25 @@ public:
 				&textures.skySphere.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// Streaming terrain
+		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.streaming, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.streaming));
+
+		VkDescriptorImageInfo heightDescriptor = clipmap->getHeightDescriptor();
+		VkDescriptorImageInfo normalDescriptor = clipmap->getNormalDescriptor();
+		writeDescriptorSets =
+		{
+			vks::initializers::writeDescriptorSet(descriptorSets.streaming, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.streaming.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.streaming, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &heightDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.streaming, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &normalDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.streaming, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &textures.terrainArray.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.streaming, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &streaming.nodes.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.streaming, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &streaming.counters.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.streaming, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &streaming.leaves.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.streaming, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7, &streaming.drawCommand.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 	}
 
 	void preparePipelines()
@@ -711,6 +951,32 @@ public:
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
 		};
 
+		// Streaming terrain pipelines, the vertex input is the leaf local position of the patch grid
+		std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
+			vks::initializers::vertexInputBindingDescription(0, sizeof(glm::vec2), VK_VERTEX_INPUT_RATE_VERTEX),
+		};
+		std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32_SFLOAT, 0),
+		};
+		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo(vertexInputBindings, vertexInputAttributes);
+		shaderStages[0] = loadShader(getShadersPath() + "terraintessellation/streaming.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "terraintessellation/streaming.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		shaderStages[2] = loadShader(getShadersPath() + "terraintessellation/streaming.tesc.spv", VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT);
+		shaderStages[3] = loadShader(getShadersPath() + "terraintessellation/streaming.tese.spv", VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT);
+		pipelineCI.layout = pipelineLayouts.streaming;
+		pipelineCI.pVertexInputState = &vertexInputState;
+		rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.streaming));
+		if (deviceFeatures.fillModeNonSolid) {
+			rasterizationState.polygonMode = VK_POLYGON_MODE_LINE;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.streamingWireframe));
+		}
+
+		// Streaming terrain node selection pipeline
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayouts.streaming, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "terraintessellation/streamingselect.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &pipelines.streamingSelect));
+
 		// Skysphere pipeline
 		rasterizationState.cullMode = VK_CULL_MODE_FRONT_BIT;
 		rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
@@ -718,6 +984,7 @@ public:
 		inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		// Reset tessellation state
 		pipelineCI.pTessellationState = nullptr;
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV });
 		// Don't write to depth buffer
 		depthStencilState.depthWriteEnable = VK_FALSE;
 		pipelineCI.stageCount = 2;
@@ -744,9 +1011,17 @@ public:
 			&uniformBuffers.skysphereVertex,
 			sizeof(uboVS)));
 
+		// Streaming terrain uniform buffer
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffers.streaming,
+			sizeof(uboStreaming)));
+
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.terrainTessellation.map());
 		VK_CHECK_RESULT(uniformBuffers.skysphereVertex.map());
+		VK_CHECK_RESULT(uniformBuffers.streaming.map());
 
 		updateUniformBuffers();
 	}
@@ -777,6 +1052,25 @@ public:
 			uboTess.tessellationFactor = savedFactor;
 		}
 
+		// Streaming terrain
+		uboStreaming.projection = camera.matrices.perspective;
+		uboStreaming.modelview = camera.matrices.view;
+		uboStreaming.cameraPos = glm::vec4(glm::vec3(glm::inverse(camera.matrices.view)[3]), 1.0f);
+		memcpy(uboStreaming.frustumPlanes, frustum.planes.data(), sizeof(glm::vec4) * 6);
+		memcpy(uboStreaming.clipRegions, clipmap->getLevelRegions(), sizeof(glm::ivec4) * vks::TerrainClipmap::maxLevels);
+		uboStreaming.terrainOrigin = clipmap->getOrigin();
+		uboStreaming.terrainTexels = static_cast<float>(clipmap->getWidth());
+		uboStreaming.terrainSize = uboStreaming.terrainTexels * streamingTexelSize;
+		uboStreaming.texelSize = streamingTexelSize;
+		uboStreaming.heightScale = streamingHeightScale;
+		uboStreaming.tessellationFactor = static_cast<float>(1 << streamingTessellationLevel);
+		uboStreaming.maxDepth = streaming.maxDepth;
+		uboStreaming.clipLevels = clipmap->getLevelCount();
+		uboStreaming.clipSize = static_cast<float>(vks::TerrainClipmap::clipSize);
+		uboStreaming.maxNodes = streamingMaxNodes;
+		uboStreaming.showLod = showLod ? 1 : 0;
+		memcpy(uniformBuffers.streaming.mapped, &uboStreaming, sizeof(uboStreaming));
+
 		// Skysphere vertex shader
 		uboVS.mvp = camera.matrices.perspective * glm::mat4(glm::mat3(camera.matrices.view));
 		memcpy(uniformBuffers.skysphereVertex.mapped, &uboVS, sizeof(uboVS));
@@ -786,17 +1080,17 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		if (queries) {
+			// The last submission of the command buffer has finished, so its query results can be read without waiting
+			getQueryResults();
+		}
+
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-
-		if (deviceFeatures.pipelineStatisticsQuery) {
-			// Read query results for displaying in next frame
-			getQueryResults();
-		}
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -806,8 +1100,9 @@ public:
 		VulkanExampleBase::prepare();
 		loadAssets();
 		generateTerrain();
+		prepareStreamingTerrain();
 		if (deviceFeatures.pipelineStatisticsQuery) {
-			setupQueryResultBuffer();
+			setupQueryPool();
 		}
 		prepareUniformBuffers();
 		setupDescriptorSetLayouts();
@@ -822,6 +1117,11 @@ public:
 	{
 		if (!prepared)
 			return;
+		if (streamingTerrain) {
+			// Page in the tiles around the camera, the resident regions change without the camera moving
+			clipmap->update(glm::vec3(glm::inverse(camera.matrices.view)[3]));
+			updateUniformBuffers();
+		}
 		draw();
 		if (camera.updated) {
 			updateUniformBuffers();
@@ -843,16 +1143,45 @@ public:
 			if (overlay->inputFloat("Factor", &uboTess.tessellationFactor, 0.05f, 2)) {
 				updateUniformBuffers();
 			}
+			if (!streamingTerrain) {
+				// Target edge length of the tessellated quads in pixels, the streaming terrain uses power of two levels to keep the node joins crack free
+				if (overlay->inputFloat("Edge size (px)", &uboTess.tessellatedEdgeSize, 1.0f, 1)) {
+					uboTess.tessellatedEdgeSize = std::max(uboTess.tessellatedEdgeSize, 1.0f);
+					updateUniformBuffers();
+				}
+			}
 			if (deviceFeatures.fillModeNonSolid) {
 				if (overlay->checkBox("Wireframe", &wireframe)) {
 					buildCommandBuffers();
 				}
 			}
+			if (overlay->checkBox("Streaming terrain", &streamingTerrain)) {
+				// The streaming terrain is much larger than the fixed one
+				camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, streamingTerrain ? 2048.0f : 512.0f);
+				camera.movementSpeed = streamingTerrain ? 30.0f : 7.5f;
+				updateUniformBuffers();
+				buildCommandBuffers();
+			}
+			if (streamingTerrain) {
+				if (overlay->sliderInt("Tessellation level", &streamingTessellationLevel, 0, 6)) {
+					updateUniformBuffers();
+				}
+				if (overlay->checkBox("Show LOD", &showLod)) {
+					updateUniformBuffers();
+				}
+			}
+		}
+		if (streamingTerrain && overlay->header("Terrain streaming")) {
+			const vks::TerrainClipmap::Statistics &statistics = clipmap->getStatistics();
+			overlay->text("Resident tiles: %d", statistics.residentTiles);
+			overlay->text("Pending tiles: %d", statistics.pendingTiles);
+			overlay->text("Uploaded tiles: %d", statistics.uploadedTiles);
 		}
 		if (deviceFeatures.pipelineStatisticsQuery) {
 			if (overlay->header("Pipeline statistics")) {
 				overlay->text("VS invocations: %d", pipelineStats[0]);
-				overlay->text("TE invocations: %d", pipelineStats[1]);
+				overlay->text("TE invocations: %d", pipelineStats[2]);
+				overlay->text("Primitives: %d", pipelineStats[1]);
 			}
 		}
 	}
@@ -11,6 +11,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "frustum.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -19,6 +20,9 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool splitScreen = true;
 	bool wireframe = true;
+	// Derive the tessellation factors from the projected edge lengths instead of using a fixed level
+	bool adaptiveTessellation = false;
+	bool frustumCulling = true;
 
 	vkglTF::Model model;
 
@@ -27,7 +31,15 @@ public:
 	} uniformBuffers;
 
 	struct UBOTessControl {
+		glm::mat4 projection;
+		glm::mat4 modelView;
+		glm::vec4 frustumPlanes[6];
+		glm::vec2 viewportDim;
 		float tessLevel = 3.0f;
+		// Desired edge length of the generated triangles in pixels
+		float targetEdgeSize = 8.0f;
+		int32_t adaptive;
+		int32_t frustumCulling;
 	} uboTessControl;
 
 	struct UBOTessEval {
@@ -47,6 +59,14 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	// View frustum passed to the tessellation control shader for culling
+	vks::Frustum frustum;
+
+	// Pipeline statistics of the PN triangles draw
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	// Primitives generated by the tessellator (clipping invocations), patches and evaluation shader invocations, in the order of the statistic bits
+	uint64_t pipelineStats[3] = { 0 };
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Tessellation shader (PN Triangles)";
@@ -72,6 +92,10 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
+		if (queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, queryPool, nullptr);
+		}
+
 		uniformBuffers.tessControl.destroy();
 		uniformBuffers.tessEval.destroy();
 	}
@@ -96,6 +120,29 @@ public:
 		if (deviceFeatures.samplerAnisotropy) {
 			enabledFeatures.samplerAnisotropy = VK_TRUE;
 		}
+		// Pipeline statistics are used to display the number of generated primitives
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			enabledFeatures.pipelineStatisticsQuery = VK_TRUE;
+		}
+	}
+
+	void setupQueryPool()
+	{
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+		queryPoolInfo.pipelineStatistics =
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_CONTROL_SHADER_PATCHES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT;
+		queryPoolInfo.queryCount = 1;
+		VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, NULL, &queryPool));
+	}
+
+	// Retrieves the results of the pipeline statistics query submitted to the command buffer
+	void getQueryResults()
+	{
+		vkGetQueryPoolResults(device, queryPool, 0, 1, sizeof(pipelineStats), pipelineStats, sizeof(pipelineStats), VK_QUERY_RESULT_64_BIT);
 	}
 
 	void buildCommandBuffers()
@@ -122,6 +169,10 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				vkCmdResetQueryPool(drawCmdBuffers[i], queryPool, 0, 1);
+			}
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport(splitScreen ? (float)width / 2.0f : (float)width, (float)height, 0.0f, 1.0f);
@@ -143,7 +194,13 @@ public:
 
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wire : pipelines.solid);
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 0, 0);
+			}
 			model.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayout);
+			if (deviceFeatures.pipelineStatisticsQuery) {
+				vkCmdEndQuery(drawCmdBuffers[i], queryPool, 0);
+			}
 
 			drawUI(drawCmdBuffers[i]);
 
@@ -289,6 +346,14 @@ public:
 		// Tessellation evaluation uniform block
 		memcpy(uniformBuffers.tessEval.mapped, &uboTessEval, sizeof(uboTessEval));
 		// Tessellation control uniform block
+		uboTessControl.projection = camera.matrices.perspective;
+		uboTessControl.modelView = camera.matrices.view;
+		// The PN triangles are rendered to the right half of the window in split screen mode
+		uboTessControl.viewportDim = glm::vec2(splitScreen ? (float)width / 2.0f : (float)width, (float)height);
+		uboTessControl.adaptive = adaptiveTessellation ? 1 : 0;
+		uboTessControl.frustumCulling = frustumCulling ? 1 : 0;
+		frustum.update(uboTessControl.projection * uboTessControl.modelView);
+		memcpy(uboTessControl.frustumPlanes, frustum.planes.data(), sizeof(glm::vec4) * 6);
 		memcpy(uniformBuffers.tessControl.mapped, &uboTessControl, sizeof(uboTessControl));
 	}
 
@@ -298,7 +363,12 @@ public:
 
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			// Read query results for displaying in next frame
+			getQueryResults();
+		}
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -307,6 +377,9 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			setupQueryPool();
+		}
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -335,7 +408,21 @@ public:
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
-			if (overlay->inputFloat("Tessellation level", &uboTessControl.tessLevel, 0.25f, 2)) {
+			if (overlay->checkBox("Screen space tessellation", &adaptiveTessellation)) {
+				updateUniformBuffers();
+			}
+			if (adaptiveTessellation) {
+				if (overlay->inputFloat("Triangle size (px)", &uboTessControl.targetEdgeSize, 1.0f, 1)) {
+					uboTessControl.targetEdgeSize = std::max(uboTessControl.targetEdgeSize, 1.0f);
+					updateUniformBuffers();
+				}
+			}
+			else {
+				if (overlay->inputFloat("Tessellation level", &uboTessControl.tessLevel, 0.25f, 2)) {
+					updateUniformBuffers();
+				}
+			}
+			if (overlay->checkBox("Frustum culling", &frustumCulling)) {
 				updateUniformBuffers();
 			}
 			if (deviceFeatures.fillModeNonSolid) {
@@ -350,6 +437,13 @@ public:
 				}
 			}
 		}
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			if (overlay->header("Pipeline statistics")) {
+				overlay->text("Patches: %d", pipelineStats[1]);
+				overlay->text("TE invocations: %d", pipelineStats[2]);
+				overlay->text("Primitives: %d", pipelineStats[0]);
+			}
+		}
 	}
 };
 
@@ -8,21 +8,55 @@
 
 #include <sstream>
 #include <iomanip>
+#include <glm/gtc/packing.hpp>
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanSpecialization.hpp"
 #include "../external/stb/stb_font_consolas_24_latin1.inl"
 
 #define ENABLE_VALIDATION false
 
-// Max. number of chars the text overlay buffer can hold
-#define TEXTOVERLAY_MAX_CHAR_COUNT 2048
+// Initial number of chars the text overlay buffer can hold per swapchain image, grows if a text update exceeds it
+#define TEXTOVERLAY_INITIAL_CHAR_COUNT 2048
 
 /*
 	Mostly self-contained text overlay class
+
+	Each char is stored as a single glyph instance (pen position, glyph index, size and color). The vertex shader expands the
+	instances into quads using a table of glyph metrics that is uploaded once, so a text update only writes 16 bytes per char.
+	Every swapchain image has its own region in a persistently mapped buffer that starts with the indirect draw command for its
+	instances, so the command buffers are recorded once and text can be updated without waiting for frames in flight.
 */
 class TextOverlay
 {
 private:
+	// Per char instance data, see text.vert
+	struct GlyphInstance {
+		// Pen position in normalized device coordinates
+		glm::vec2 position;
+		// Index into the glyph metrics
+		uint16_t glyph;
+		// Text size in 1/16 pixels
+		uint16_t size;
+		// RGBA8
+		uint32_t color;
+	};
+
+	// Quad of a glyph, uploaded once to a storage buffer
+	struct GlyphMetrics {
+		// Corners relative to the pen position, in font units
+		glm::vec4 rect;
+		// Texture coordinates of the corners
+		glm::vec4 uv;
+	};
+
+	struct PushConstants {
+		// Size of a pixel in normalized device coordinates
+		glm::vec2 pixelSize;
+		// Size the glyph metrics are given for
+		float fontSize;
+	} pushConstants;
+
 	vks::VulkanDevice *vulkanDevice;
 
 	VkQueue queue;
@@ -33,12 +67,9 @@ private:
 	uint32_t *frameBufferHeight;
 	float scale;
 
-	VkSampler sampler;
-	VkImage image;
-	VkImageView view;
-	VkBuffer buffer;
-	VkDeviceMemory memory;
-	VkDeviceMemory imageMemory;
+	vks::Texture2D fontTexture;
+	vks::Buffer glyphBuffer;
+	vks::Buffer instanceBuffer;
 	VkDescriptorPool descriptorPool;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkDescriptorSet descriptorSet;
@@ -50,11 +81,22 @@ private:
 	std::vector<VkFramebuffer*> frameBuffers;
 	std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
 
-	// Pointer to mapped vertex buffer
-	glm::vec4 *mapped = nullptr;
-
-	stb_fontchar stbFontData[STB_FONT_consolas_24_latin1_NUM_CHARS];
-	uint32_t numLetters;
+	// Signed distance field font (see the distancefieldfonts example) instead of the stb bitmap font
+	bool sdf;
+	// Char code of the first glyph
+	uint32_t firstChar;
+	std::vector<GlyphMetrics> glyphs;
+	// Horizontal advance of each glyph in font units
+	std::vector<float> glyphAdvances;
+
+	// Glyphs of the last text update on the host, copied to the region of an image before it's rendered
+	std::vector<GlyphInstance> instances;
+	uint32_t textVersion = 0;
+	// Text version each image's region was last written with
+	std::vector<uint32_t> regionVersions;
+	// Max. number of chars and size in bytes of an image's region
+	uint32_t regionCapacity = 0;
+	VkDeviceSize regionSize = 0;
 public:
 
 	enum TextAlign { alignLeft, alignCenter, alignRight };
@@ -63,6 +105,7 @@ public:
 
 	std::vector<VkCommandBuffer> cmdBuffers;
 
+	// Pass the AngelCode font description and the distance field texture to use a signed distance field font
 	TextOverlay(
 		vks::VulkanDevice *vulkanDevice,
 		VkQueue queue,
@@ -72,7 +115,9 @@ public:
 		uint32_t *framebufferwidth,
 		uint32_t *framebufferheight,
 		float scale,
-		std::vector<VkPipelineShaderStageCreateInfo> shaderstages)
+		std::vector<VkPipelineShaderStageCreateInfo> shaderstages,
+		const std::string &sdfFontFile = "",
+		const std::string &sdfTextureFile = "")
 	{
 		this->vulkanDevice = vulkanDevice;
 		this->queue = queue;
@@ -92,20 +137,25 @@ public:
 		this->scale = scale;
 
 		cmdBuffers.resize(framebuffers.size());
+		sdf = !sdfFontFile.empty();
+		if (sdf) {
+			loadSdfFont(sdfFontFile, sdfTextureFile);
+		} else {
+			loadBitmapFont();
+		}
 		prepareResources();
 		prepareRenderPass();
 		preparePipeline();
+		updateCommandBuffers();
 	}
 
 	~TextOverlay()
 	{
 		// Free up all Vulkan resources requested by the text overlay
-		vkDestroySampler(vulkanDevice->logicalDevice, sampler, nullptr);
-		vkDestroyImage(vulkanDevice->logicalDevice, image, nullptr);
-		vkDestroyImageView(vulkanDevice->logicalDevice, view, nullptr);
-		vkDestroyBuffer(vulkanDevice->logicalDevice, buffer, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, memory, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, imageMemory, nullptr);
+		fontTexture.destroy();
+		glyphBuffer.destroy();
+		instanceBuffer.unmap();
+		instanceBuffer.destroy();
 		vkDestroyDescriptorSetLayout(vulkanDevice->logicalDevice, descriptorSetLayout, nullptr);
 		vkDestroyDescriptorPool(vulkanDevice->logicalDevice, descriptorPool, nullptr);
 		vkDestroyPipelineLayout(vulkanDevice->logicalDevice, pipelineLayout, nullptr);
@@ -115,16 +165,94 @@ public:
 		vkDestroyCommandPool(vulkanDevice->logicalDevice, commandPool, nullptr);
 	}
 
-	// Prepare all vulkan resources required to render the font
-	// The text overlay uses separate resources for descriptors (pool, sets, layouts), pipelines and command buffers
-	void prepareResources()
+	// Glyph metrics and font texture of the stb font
+	void loadBitmapFont()
 	{
 		const uint32_t fontWidth = STB_FONT_consolas_24_latin1_BITMAP_WIDTH;
 		const uint32_t fontHeight = STB_FONT_consolas_24_latin1_BITMAP_WIDTH;
 
 		static unsigned char font24pixels[fontWidth][fontHeight];
+		static stb_fontchar stbFontData[STB_FONT_consolas_24_latin1_NUM_CHARS];
 		stb_font_consolas_24_latin1(stbFontData, font24pixels, fontHeight);
 
+		firstChar = STB_FONT_consolas_24_latin1_FIRST_CHAR;
+		pushConstants.fontSize = 24.0f;
+		glyphs.resize(STB_FONT_consolas_24_latin1_NUM_CHARS);
+		glyphAdvances.resize(STB_FONT_consolas_24_latin1_NUM_CHARS);
+		for (uint32_t i = 0; i < STB_FONT_consolas_24_latin1_NUM_CHARS; i++)
+		{
+			const stb_fontchar &charData = stbFontData[i];
+			glyphs[i].rect = glm::vec4(charData.x0, charData.y0, charData.x1, charData.y1);
+			glyphs[i].uv = glm::vec4(charData.s0, charData.t0, charData.s1, charData.t1);
+			glyphAdvances[i] = charData.advance;
+		}
+
+		// Size of the font texture is WIDTH * HEIGHT * 1 byte (only one channel)
+		fontTexture.fromBuffer(&font24pixels[0][0], fontWidth * fontHeight, VK_FORMAT_R8_UNORM, fontWidth, fontHeight, vulkanDevice, queue);
+	}
+
+	// Glyph metrics from an AngelCode bitmap font file and the matching distance field texture
+	// See http://www.angelcode.com/products/bmfont/doc/file_format.html for details
+	void loadSdfFont(const std::string &fontFile, const std::string &textureFile)
+	{
+		fontTexture.loadFromFile(textureFile, VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
+
+#if defined(__ANDROID__)
+		// Font description file is stored inside the apk
+		// So we need to load it using the asset manager
+		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, fontFile.c_str(), AASSET_MODE_STREAMING);
+		assert(asset);
+		size_t size = AAsset_getLength(asset);
+		assert(size > 0);
+		std::string fileData(size, '\0');
+		AAsset_read(asset, &fileData[0], size);
+		AAsset_close(asset);
+		std::stringstream istream(fileData);
+#else
+		std::ifstream istream(fontFile);
+#endif
+		assert(istream.good());
+
+		// The distance field font is generated for a size of 36 units, covering the ASCII table
+		firstChar = 0;
+		pushConstants.fontSize = 36.0f;
+		glyphs.assign(256, GlyphMetrics{ glm::vec4(0.0f), glm::vec4(0.0f) });
+		glyphAdvances.assign(256, 0.0f);
+
+		const float textureWidth = (float)fontTexture.width;
+		const float textureHeight = (float)fontTexture.height;
+		std::string line;
+		while (std::getline(istream, line))
+		{
+			std::stringstream lineStream(line);
+			std::string info;
+			lineStream >> info;
+			if (info != "char") {
+				continue;
+			}
+			// Pairs of "key=value" in a fixed order: id, x, y, width, height, xoffset, yoffset, xadvance
+			int32_t values[8];
+			for (auto &value : values)
+			{
+				std::string pair;
+				lineStream >> pair;
+				value = std::stoi(pair.substr(pair.find('=') + 1));
+			}
+			if ((values[0] < 0) || (values[0] >= (int32_t)glyphs.size())) {
+				continue;
+			}
+			const float x = (float)values[1], y = (float)values[2], w = (float)values[3], h = (float)values[4];
+			const float xoffset = (float)values[5], yoffset = (float)values[6];
+			glyphs[values[0]].rect = glm::vec4(xoffset, yoffset, xoffset + w, yoffset + h);
+			glyphs[values[0]].uv = glm::vec4(x / textureWidth, y / textureHeight, (x + w) / textureWidth, (y + h) / textureHeight);
+			glyphAdvances[values[0]] = (float)values[7];
+		}
+	}
+
+	// Prepare all vulkan resources required to render the font
+	// The text overlay uses separate resources for descriptors (pool, sets, layouts), pipelines and command buffers
+	void prepareResources()
+	{
 		// Command buffer
 
 		// Pool
@@ -142,158 +270,31 @@ public:
 
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, cmdBuffers.data()));
 
-		// Vertex buffer
-		VkDeviceSize bufferSize = TEXTOVERLAY_MAX_CHAR_COUNT * sizeof(glm::vec4);
-
-		VkBufferCreateInfo bufferInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, bufferSize);
-		VK_CHECK_RESULT(vkCreateBuffer(vulkanDevice->logicalDevice, &bufferInfo, nullptr, &buffer));
-
-		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
-
-		vkGetBufferMemoryRequirements(vulkanDevice->logicalDevice, buffer, &memReqs);
-		allocInfo.allocationSize = memReqs.size;
-		allocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &allocInfo, nullptr, &memory));
-		VK_CHECK_RESULT(vkBindBufferMemory(vulkanDevice->logicalDevice, buffer, memory, 0));
-
-		// Font texture
-		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
-		imageInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageInfo.format = VK_FORMAT_R8_UNORM;
-		imageInfo.extent.width = fontWidth;
-		imageInfo.extent.height = fontHeight;
-		imageInfo.extent.depth = 1;
-		imageInfo.mipLevels = 1;
-		imageInfo.arrayLayers = 1;
-		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-
-		VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &imageInfo, nullptr, &image));
-
-		vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, image, &memReqs);
-		allocInfo.allocationSize = memReqs.size;
-		allocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &allocInfo, nullptr, &imageMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, image, imageMemory, 0));
-
-		// Staging
-
-		struct {
-			VkDeviceMemory memory;
-			VkBuffer buffer;
-		} stagingBuffer;
-
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = allocInfo.allocationSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-		VK_CHECK_RESULT(vkCreateBuffer(vulkanDevice->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer.buffer));
-
-		// Get memory requirements for the staging buffer (alignment, memory type bits)
-		vkGetBufferMemoryRequirements(vulkanDevice->logicalDevice, stagingBuffer.buffer, &memReqs);
-
-		allocInfo.allocationSize = memReqs.size;
-		// Get memory type index for a host visible buffer
-		allocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &allocInfo, nullptr, &stagingBuffer.memory));
-		VK_CHECK_RESULT(vkBindBufferMemory(vulkanDevice->logicalDevice, stagingBuffer.buffer, stagingBuffer.memory, 0));
-
-		uint8_t *data;
-		VK_CHECK_RESULT(vkMapMemory(vulkanDevice->logicalDevice, stagingBuffer.memory, 0, allocInfo.allocationSize, 0, (void **)&data));
-		// Size of the font texture is WIDTH * HEIGHT * 1 byte (only one channel)
-		memcpy(data, &font24pixels[0][0], fontWidth * fontHeight);
-		vkUnmapMemory(vulkanDevice->logicalDevice, stagingBuffer.memory);
-
-		// Copy to image
-
-		VkCommandBuffer copyCmd;
-		cmdBufAllocateInfo.commandBufferCount = 1;
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, &copyCmd));
-
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-		VK_CHECK_RESULT(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
-
-		// Prepare for transfer
-		vks::tools::setImageLayout(
-			copyCmd,
-			image,
-			VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_IMAGE_LAYOUT_UNDEFINED,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-		VkBufferImageCopy bufferCopyRegion = {};
-		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		bufferCopyRegion.imageSubresource.mipLevel = 0;
-		bufferCopyRegion.imageSubresource.layerCount = 1;
-		bufferCopyRegion.imageExtent.width = fontWidth;
-		bufferCopyRegion.imageExtent.height = fontHeight;
-		bufferCopyRegion.imageExtent.depth = 1;
-
-		vkCmdCopyBufferToImage(
-			copyCmd,
-			stagingBuffer.buffer,
-			image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
-			&bufferCopyRegion
-			);
+		// Glyph metrics, only read by the GPU
+		const VkDeviceSize glyphBufferSize = glyphs.size() * sizeof(GlyphMetrics);
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			glyphBufferSize,
+			glyphs.data()));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&glyphBuffer,
+			glyphBufferSize));
+		vulkanDevice->copyBuffer(&stagingBuffer, &glyphBuffer, queue);
+		stagingBuffer.destroy();
 
-		// Prepare for shader read
-		vks::tools::setImageLayout(
-			copyCmd,
-			image,
-			VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-		VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
-
-		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &copyCmd;
-
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
-
-		vkFreeCommandBuffers(vulkanDevice->logicalDevice, commandPool, 1, &copyCmd);
-		vkFreeMemory(vulkanDevice->logicalDevice, stagingBuffer.memory, nullptr);
-		vkDestroyBuffer(vulkanDevice->logicalDevice, stagingBuffer.buffer, nullptr);
-
-		VkImageViewCreateInfo imageViewInfo = vks::initializers::imageViewCreateInfo();
-		imageViewInfo.image = image;
-		imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		imageViewInfo.format = imageInfo.format;
-		imageViewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B,	VK_COMPONENT_SWIZZLE_A };
-		imageViewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-		VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &imageViewInfo, nullptr, &view));
-
-		// Sampler
-		VkSamplerCreateInfo samplerInfo = vks::initializers::samplerCreateInfo();
-		samplerInfo.magFilter = VK_FILTER_LINEAR;
-		samplerInfo.minFilter = VK_FILTER_LINEAR;
-		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.mipLodBias = 0.0f;
-		samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
-		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = 1.0f;
-		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(vulkanDevice->logicalDevice, &samplerInfo, nullptr, &sampler));
+		// Glyph instances and indirect draw commands
+		prepareInstanceBuffer(TEXTOVERLAY_INITIAL_CHAR_COUNT);
 
 		// Descriptor
 		// Font uses a separate descriptor pool
-		std::array<VkDescriptorPoolSize, 1> poolSizes;
+		std::array<VkDescriptorPoolSize, 2> poolSizes;
 		poolSizes[0] = vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1);
+		poolSizes[1] = vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1);
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
@@ -304,8 +305,11 @@ public:
 		VK_CHECK_RESULT(vkCreateDescriptorPool(vulkanDevice->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
 
 		// Descriptor set layout
-		std::array<VkDescriptorSetLayoutBinding, 1> setLayoutBindings;
+		std::array<VkDescriptorSetLayoutBinding, 2> setLayoutBindings;
+		// Binding 0: Font texture
 		setLayoutBindings[0] = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+		// Binding 1: Glyph metrics
+		setLayoutBindings[1] = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 1);
 
 		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo =
 			vks::initializers::descriptorSetLayoutCreateInfo(
@@ -314,10 +318,13 @@ public:
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(vulkanDevice->logicalDevice, &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout));
 
 		// Pipeline layout
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(PushConstants), 0);
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo =
 			vks::initializers::pipelineLayoutCreateInfo(
 				&descriptorSetLayout,
 				1);
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 		VK_CHECK_RESULT(vkCreatePipelineLayout(vulkanDevice->logicalDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout));
 
 		// Descriptor set
@@ -329,14 +336,9 @@ public:
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(vulkanDevice->logicalDevice, &descriptorSetAllocInfo, &descriptorSet));
 
-		VkDescriptorImageInfo texDescriptor =
-			vks::initializers::descriptorImageInfo(
-				sampler,
-				view,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-		std::array<VkWriteDescriptorSet, 1> writeDescriptorSets;
-		writeDescriptorSets[0] = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &texDescriptor);
+		std::array<VkWriteDescriptorSet, 2> writeDescriptorSets;
+		writeDescriptorSets[0] = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &fontTexture.descriptor);
+		writeDescriptorSets[1] = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &glyphBuffer.descriptor);
 		vkUpdateDescriptorSets(vulkanDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
 		// Pipeline cache
@@ -345,10 +347,30 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineCache(vulkanDevice->logicalDevice, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
 	}
 
+	// Host visible buffer with one region per swapchain image, each starting with the indirect draw command followed by the glyph instances
+	void prepareInstanceBuffer(uint32_t charCount)
+	{
+		regionCapacity = charCount;
+		regionSize = sizeof(VkDrawIndirectCommand) + charCount * sizeof(GlyphInstance);
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&instanceBuffer,
+			regionSize * cmdBuffers.size()));
+		VK_CHECK_RESULT(instanceBuffer.map());
+		// Nothing is drawn until a region has been written
+		const VkDrawIndirectCommand drawCommand = { 4, 0, 0, 0 };
+		for (size_t i = 0; i < cmdBuffers.size(); i++)
+		{
+			memcpy((uint8_t*)instanceBuffer.mapped + i * regionSize, &drawCommand, sizeof(drawCommand));
+		}
+		regionVersions.assign(cmdBuffers.size(), textVersion - 1);
+	}
+
 	// Prepare a separate pipeline for the font rendering decoupled from the main application
 	void preparePipeline()
 	{
-		// Enable blending, using alpha from red channel of the font texture (see text.frag)
+		// Enable blending, using alpha from the font texture (see text.frag)
 		VkPipelineColorBlendAttachmentState blendAttachmentState{};
 		blendAttachmentState.blendEnable = VK_TRUE;
 		blendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
@@ -368,13 +390,14 @@ public:
 		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
 		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
 
-		std::array<VkVertexInputBindingDescription, 2> vertexInputBindings = {
-			vks::initializers::vertexInputBindingDescription(0, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_VERTEX),
-			vks::initializers::vertexInputBindingDescription(1, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_VERTEX),
+		// One instance per char, the quad's four vertices are generated in the vertex shader
+		std::array<VkVertexInputBindingDescription, 1> vertexInputBindings = {
+			vks::initializers::vertexInputBindingDescription(0, sizeof(GlyphInstance), VK_VERTEX_INPUT_RATE_INSTANCE),
 		};
-		std::array<VkVertexInputAttributeDescription, 2> vertexInputAttributes = {
-			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32_SFLOAT, 0),					// Location 0: Position
-			vks::initializers::vertexInputAttributeDescription(1, 1, VK_FORMAT_R32G32_SFLOAT, sizeof(glm::vec2)),	// Location 1: UV
+		std::array<VkVertexInputAttributeDescription, 3> vertexInputAttributes = {
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(GlyphInstance, position)),	// Location 0: Position
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R16G16_UINT, offsetof(GlyphInstance, glyph)),			// Location 1: Glyph index and size
+			vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R8G8B8A8_UNORM, offsetof(GlyphInstance, color)),		// Location 2: Color
 		};
 
 		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
@@ -383,6 +406,17 @@ public:
 		vertexInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributes.size());
 		vertexInputState.pVertexAttributeDescriptions = vertexInputAttributes.data();
 
+		// The fragment shader selects the signed distance field path with a specialization constant
+		vks::SpecializationConstants<VkBool32> specializationConstants;
+		specializationConstants.set<0>(sdf ? VK_TRUE : VK_FALSE);
+		std::vector<VkPipelineShaderStageCreateInfo> stages = shaderStages;
+		for (auto &stage : stages)
+		{
+			if (stage.stage == VK_SHADER_STAGE_FRAGMENT_BIT) {
+				stage.pSpecializationInfo = specializationConstants.getInfo();
+			}
+		}
+
 		VkGraphicsPipelineCreateInfo pipelineCreateInfo = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
 		pipelineCreateInfo.pVertexInputState = &vertexInputState;
 		pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
@@ -392,8 +426,8 @@ public:
 		pipelineCreateInfo.pViewportState = &viewportState;
 		pipelineCreateInfo.pDepthStencilState = &depthStencilState;
 		pipelineCreateInfo.pDynamicState = &dynamicState;
-		pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
-		pipelineCreateInfo.pStages = shaderStages.data();
+		pipelineCreateInfo.stageCount = static_cast<uint32_t>(stages.size());
+		pipelineCreateInfo.pStages = stages.data();
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(vulkanDevice->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 	}
@@ -478,23 +512,20 @@ public:
 		VK_CHECK_RESULT(vkCreateRenderPass(vulkanDevice->logicalDevice, &renderPassInfo, nullptr, &renderPass));
 	}
 
-	// Map buffer
+
+	// Start a new text update, replacing all text
 	void beginTextUpdate()
 	{
-		VK_CHECK_RESULT(vkMapMemory(vulkanDevice->logicalDevice, memory, 0, VK_WHOLE_SIZE, 0, (void **)&mapped));
-		numLetters = 0;
+		instances.clear();
 	}
 
-	// Add text to the current buffer
-	// todo : drop shadow? color attribute?
-	void addText(std::string text, float x, float y, TextAlign align)
+	// Add text to the current update
+	// x and y are the top left of the text in pixels, size is relative to the default text size
+	void addText(std::string text, float x, float y, TextAlign align, const glm::vec4 &color = glm::vec4(1.0f), float size = 1.0f)
 	{
-		const uint32_t firstChar = STB_FONT_consolas_24_latin1_FIRST_CHAR;
-
-		assert(mapped != nullptr);
-
-		const float charW = 1.5f * scale / *frameBufferWidth;
-		const float charH = 1.5f * scale / *frameBufferHeight;
+		const float textSize = 18.0f * scale * size;
+		// Width of a font unit in normalized device coordinates
+		const float unitW = textSize / pushConstants.fontSize * 2.0f / (float)*frameBufferWidth;
 
 		float fbW = (float)*frameBufferWidth;
 		float fbH = (float)*frameBufferHeight;
@@ -505,8 +536,10 @@ public:
 		float textWidth = 0;
 		for (auto letter : text)
 		{
-			stb_fontchar *charData = &stbFontData[(uint32_t)letter - firstChar];
-			textWidth += charData->advance * charW;
+			const uint32_t glyph = (uint8_t)letter - firstChar;
+			if (glyph < glyphs.size()) {
+				textWidth += glyphAdvances[glyph] * unitW;
+			}
 		}
 
 		switch (align)
@@ -521,50 +554,54 @@ public:
 				break;
 		}
 
-		// Generate a uv mapped quad per char in the new text
+		// One instance per char in the new text, chars without a glyph are skipped
+		GlyphInstance instance{};
+		instance.size = (uint16_t)std::min(textSize * 16.0f, 65535.0f);
+		instance.color = glm::packUnorm4x8(color);
 		for (auto letter : text)
 		{
-			stb_fontchar *charData = &stbFontData[(uint32_t)letter - firstChar];
-
-			mapped->x = (x + (float)charData->x0 * charW);
-			mapped->y = (y + (float)charData->y0 * charH);
-			mapped->z = charData->s0;
-			mapped->w = charData->t0;
-			mapped++;
-
-			mapped->x = (x + (float)charData->x1 * charW);
-			mapped->y = (y + (float)charData->y0 * charH);
-			mapped->z = charData->s1;
-			mapped->w = charData->t0;
-			mapped++;
-
-			mapped->x = (x + (float)charData->x0 * charW);
-			mapped->y = (y + (float)charData->y1 * charH);
-			mapped->z = charData->s0;
-			mapped->w = charData->t1;
-			mapped++;
-
-			mapped->x = (x + (float)charData->x1 * charW);
-			mapped->y = (y + (float)charData->y1 * charH);
-			mapped->z = charData->s1;
-			mapped->w = charData->t1;
-			mapped++;
-
-			x += charData->advance * charW;
-
-			numLetters++;
+			const uint32_t glyph = (uint8_t)letter - firstChar;
+			if (glyph >= glyphs.size()) {
+				continue;
+			}
+			instance.position = glm::vec2(x, y);
+			instance.glyph = (uint16_t)glyph;
+			instances.push_back(instance);
+			x += glyphAdvances[glyph] * unitW;
 		}
 	}
 
-	// Unmap buffer and update command buffers
+	// Finish the text update, it's copied to the GPU when the images are rendered
 	void endTextUpdate()
 	{
-		vkUnmapMemory(vulkanDevice->logicalDevice, memory);
-		mapped = nullptr;
-		updateCommandBuffers();
+		textVersion++;
+	}
+
+	// Needs to be called by the application before submitting the command buffer of an image, once the image's previous frame has completed
+	// Copies the current text into the image's region if it has changed since the region was last written
+	void upload(uint32_t imageIndex)
+	{
+		if (regionVersions[imageIndex] == textVersion) {
+			return;
+		}
+		if (instances.size() > regionCapacity) {
+			// The regions of the other images may still be read by frames in flight
+			VK_CHECK_RESULT(vulkanDevice->queueWaitIdle(queue));
+			instanceBuffer.unmap();
+			instanceBuffer.destroy();
+			prepareInstanceBuffer(std::max(regionCapacity * 2, (uint32_t)instances.size()));
+			updateCommandBuffers();
+		}
+		uint8_t *region = (uint8_t*)instanceBuffer.mapped + imageIndex * regionSize;
+		const VkDrawIndirectCommand drawCommand = { 4, (uint32_t)instances.size(), 0, 0 };
+		memcpy(region, &drawCommand, sizeof(drawCommand));
+		if (!instances.empty()) {
+			memcpy(region + sizeof(drawCommand), instances.data(), instances.size() * sizeof(GlyphInstance));
+		}
+		regionVersions[imageIndex] = textVersion;
 	}
 
-	// Needs to be called by the application
+	// Only needs to be called on creation and if the instance buffer has been recreated, as the draws read their glyph count from the buffer
 	void updateCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -579,6 +616,8 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
+		pushConstants.pixelSize = glm::vec2(2.0f / (float)*frameBufferWidth, 2.0f / (float)*frameBufferHeight);
+
 		for (int32_t i = 0; i < cmdBuffers.size(); ++i)
 		{
 			renderPassBeginInfo.framebuffer = *frameBuffers[i];
@@ -595,15 +634,13 @@ public:
 
 			vkCmdBindPipeline(cmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 			vkCmdBindDescriptorSets(cmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+			vkCmdPushConstants(cmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants), &pushConstants);
 
-			VkDeviceSize offsets = 0;
-			vkCmdBindVertexBuffers(cmdBuffers[i], 0, 1, &buffer, &offsets);
-			vkCmdBindVertexBuffers(cmdBuffers[i], 1, 1, &buffer, &offsets);
-			for (uint32_t j = 0; j < numLetters; j++)
-			{
-				vkCmdDraw(cmdBuffers[i], 4, 1, j * 4, 0);
-			}
-
+			// All chars are drawn with a single instanced draw, with the instance count taken from the image's region
+			VkDeviceSize regionOffset = i * regionSize;
+			VkDeviceSize instanceOffset = regionOffset + sizeof(VkDrawIndirectCommand);
+			vkCmdBindVertexBuffers(cmdBuffers[i], 0, 1, &instanceBuffer.buffer, &instanceOffset);
+			vkCmdDrawIndirect(cmdBuffers[i], instanceBuffer.buffer, regionOffset, 1, sizeof(VkDrawIndirectCommand));
 
 			vkCmdEndRenderPass(cmdBuffers[i]);
 
@@ -619,6 +656,8 @@ class VulkanExample : public VulkanExampleBase
 {
 public:
 	TextOverlay *textOverlay = nullptr;
+	// Use the signed distance field font of the distancefieldfonts example
+	bool sdfFont = false;
 
 	vkglTF::Model model;
 
@@ -639,6 +678,7 @@ public:
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Vulkan Example - Text overlay";
+		supportsFramesInFlight = true;
 		camera.type = Camera::CameraType::lookat;
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -2.5f));
 		camera.setRotation(glm::vec3(-25.0f, -0.0f, 0.0f));
@@ -695,7 +735,7 @@ public:
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 
-		vkQueueWaitIdle(queue);
+		vulkanDevice->queueWaitIdle(queue);
 	}
 
 	// Update the text buffer displayed by the text overlay
@@ -703,7 +743,7 @@ public:
 	{
 		textOverlay->beginTextUpdate();
 
-		textOverlay->addText(title, 5.0f * UIOverlay.scale, 5.0f * UIOverlay.scale, TextOverlay::alignLeft);
+		textOverlay->addText(title, 5.0f * UIOverlay.scale, 5.0f * UIOverlay.scale, TextOverlay::alignLeft, glm::vec4(1.0f, 0.85f, 0.3f, 1.0f));
 
 		std::stringstream ss;
 		ss << std::fixed << std::setprecision(2) << (frameTimer * 1000.0f) << "ms (" << lastFPS << " fps)";
@@ -723,12 +763,14 @@ public:
 		}
 
 		glm::vec3 projected = glm::project(glm::vec3(0.0f), uboVS.modelView, uboVS.projection, glm::vec4(0, 0, (float)width, (float)height));
-		textOverlay->addText("A cube", projected.x, projected.y, TextOverlay::alignCenter);
+		// Scaled up glyphs stay sharp with the signed distance field font
+		textOverlay->addText("A cube", projected.x, projected.y, TextOverlay::alignCenter, glm::vec4(1.0f), 2.5f);
 
 #if defined(__ANDROID__)
 #else
 		textOverlay->addText("Press \"space\" to toggle text overlay", 5.0f * UIOverlay.scale, 65.0f * UIOverlay.scale, TextOverlay::alignLeft);
 		textOverlay->addText("Hold middle mouse button and drag to move", 5.0f * UIOverlay.scale, 85.0f * UIOverlay.scale, TextOverlay::alignLeft);
+		textOverlay->addText(sdfFont ? "Press \"f\" to switch to the bitmap font" : "Press \"f\" to switch to the signed distance field font", 5.0f * UIOverlay.scale, 105.0f * UIOverlay.scale, TextOverlay::alignLeft);
 #endif
 		textOverlay->endTextUpdate();
 	}
@@ -846,7 +888,9 @@ public:
 			&width,
 			&height,
 			UIOverlay.scale,
-			shaderStages
+			shaderStages,
+			sdfFont ? getAssetPath() + "font.fnt" : "",
+			sdfFont ? getAssetPath() + "textures/font_sdf_rgba.ktx" : ""
 			);
 		updateTextOverlay();
 	}
@@ -855,10 +899,13 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
-		std::vector<VkCommandBuffer> commandBuffers = {
-			drawCmdBuffers[currentBuffer]
-		};
+		// Taken from the frame arena, so the frame loop doesn't allocate
+		vks::FrameVector<VkCommandBuffer> commandBuffers(frameArena);
+		commandBuffers.reserve(2);
+		commandBuffers.push_back(drawCmdBuffers[currentBuffer]);
 		if (textOverlay->visible) {
+			// The image's previous frame has completed, so its region of the overlay's instance buffer can be written
+			textOverlay->upload(currentBuffer);
 			commandBuffers.push_back(textOverlay->cmdBuffers[currentBuffer]);
 		}
 
@@ -867,7 +914,7 @@ public:
 		submitInfo.pCommandBuffers = commandBuffers.data();
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -895,9 +942,9 @@ public:
 		{
 			updateUniformBuffers();
 		}
+		// Text updates only touch host memory and are copied to the GPU per image, so no need to wait for the device
 		if (frameCounter == 0)
 		{
-			vkDeviceWaitIdle(device);
 			updateTextOverlay();
 		}
 	}
@@ -922,6 +969,15 @@ public:
 		case KEY_KPADD:
 		case KEY_SPACE:
 			textOverlay->visible = !textOverlay->visible;
+			break;
+#if !defined(__ANDROID__)
+		case KEY_F:
+			sdfFont = !sdfFont;
+			vkDeviceWaitIdle(device);
+			delete textOverlay;
+			prepareTextOverlay();
+			break;
+#endif
 		}
 	}
 };
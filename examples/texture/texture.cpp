@@ -1,5 +1,5 @@
 /*
-* Vulkan Example - Texture loading (and display) example (including mip maps)
+* Vulkan Example - Texture loading (and display) example (including mip maps), optionally streaming the texture every frame
 *
 * Copyright (C) 2016-2017 by Sascha Willems - www.saschawillems.de
 *
@@ -62,6 +62,16 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	// Streaming mode uploads the texture's first mip level every frame, scrolled to imitate video frames
+	bool streaming = false;
+	// Streams the frames as NV12 like a video decoder's output, converted to RGB by the sampler
+	bool streamingNV12 = false;
+	vks::StreamingTexture2D streamingTexture;
+	std::vector<uint8_t> streamingSource;
+	// The streaming texture has one image per command buffer, so each command buffer samples it through its own descriptor set
+	std::vector<VkDescriptorSet> streamingDescriptorSets;
+	VkPhysicalDeviceSamplerYcbcrConversionFeatures samplerYcbcrConversionFeatures{};
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Texture loading";
@@ -69,6 +79,15 @@ public:
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -2.5f));
 		camera.setRotation(glm::vec3(0.0f, 15.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+		commandLineParser.add("streamtexture", { "-stex", "--streamtexture" }, 0, "Upload the texture every frame through a streaming texture");
+		commandLineParser.add("streamnv12", { "-snv12", "--streamnv12" }, 0, "Stream the texture as NV12 frames converted by a sampler Y'CbCr conversion (implies --streamtexture)");
+		commandLineParser.parse(args);
+		streamingNV12 = commandLineParser.isSet("streamnv12");
+		streaming = streamingNV12 || commandLineParser.isSet("streamtexture");
+		if (streamingNV12) {
+			// Sampler Y'CbCr conversions are core in Vulkan 1.1
+			apiVersion = VK_API_VERSION_1_1;
+		}
 	}
 
 	~VulkanExample()
@@ -77,6 +96,9 @@ public:
 		// Note : Inherited destructor cleans up resources stored in base class
 
 		destroyTextureImage(texture);
+		if (streaming) {
+			streamingTexture.destroy();
+		}
 
 		vkDestroyPipeline(device, pipelines.solid, nullptr);
 
@@ -97,22 +119,49 @@ public:
 		};
 	}
 
+	// Enable the sampler Y'CbCr conversion feature for NV12 streaming, or fall back to streaming RGBA frames
+	virtual void getEnabledExtensions()
+	{
+		if (!streamingNV12) {
+			return;
+		}
+		if (deviceProperties.apiVersion >= VK_API_VERSION_1_1) {
+			VkPhysicalDeviceSamplerYcbcrConversionFeatures supportedFeatures{};
+			supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SAMPLER_YCBCR_CONVERSION_FEATURES;
+			VkPhysicalDeviceFeatures2 deviceFeatures2{};
+			deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			deviceFeatures2.pNext = &supportedFeatures;
+			PFN_vkGetPhysicalDeviceFeatures2 vkGetPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2"));
+			vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+			streamingNV12 = supportedFeatures.samplerYcbcrConversion && vks::StreamingTexture2D::isFormatSupported(vulkanDevice, VK_FORMAT_G8_B8R8_2PLANE_420_UNORM);
+		}
+		else {
+			streamingNV12 = false;
+		}
+		if (streamingNV12) {
+			samplerYcbcrConversionFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SAMPLER_YCBCR_CONVERSION_FEATURES;
+			samplerYcbcrConversionFeatures.samplerYcbcrConversion = VK_TRUE;
+			deviceCreatepNextChain = &samplerYcbcrConversionFeatures;
+		}
+		else {
+			std::cout << "NV12 streaming textures are not supported by the selected device, streaming RGBA frames instead\n";
+		}
+	}
+
 	/*
 		Upload texture image data to the GPU
 
 		Vulkan offers two types of image tiling (memory layout):
 
 		Linear tiled images:
-			These are stored as is and can be copied directly to. But due to the linear nature they're not a good match for GPUs and format and feature support is very limited.
-			It's not advised to use linear tiled images for anything else than copying from host to GPU if buffer copies are not an option.
-			Linear tiling is thus only implemented for learning purposes, one should always prefer optimal tiled image.
+			These are stored as is and can be written by the host. But due to the linear nature they're not a good match for GPUs, sampling them is slow and format and feature support is very limited.
 
 		Optimal tiled images:
 			These are stored in an implementation specific layout matching the capability of the hardware. They usually support more formats and features and are much faster.
-			Optimal tiled images are stored on the device and not accessible by the host. So they can't be written directly to (like liner tiled images) and always require
-			some sort of data copy, either from a buffer or	a linear tiled image.
+			Optimal tiled images are stored on the device and not accessible by the host. So they always require a copy from a staging buffer.
 
-		In Short: Always use optimal tiled images for rendering.
+		In Short: Always use optimal tiled images for rendering. Textures that change every frame are also copied into optimal tiled images (see vks::StreamingTexture2D),
+		from a persistently mapped staging buffer instead of a staging buffer created for each upload.
 	*/
 	void loadTexture()
 	{
@@ -154,239 +203,166 @@ public:
 		ktx_uint8_t *ktxTextureData = ktxTexture_GetData(ktxTexture);
 		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
 
-		// We prefer using staging to copy the texture data to a device local optimal image
-		VkBool32 useStaging = true;
-
-		// Only use linear tiling if forced
-		bool forceLinearTiling = false;
-		if (forceLinearTiling) {
-			// Don't use linear if format is not supported for (linear) shader sampling
-			// Get device properties for the requested texture format
-			VkFormatProperties formatProperties;
-			vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
-			useStaging = !(formatProperties.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
-		}
-
 		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs = {};
 
-		if (useStaging) {
-			// Copy data to an optimal tiled image
-			// This loads the texture data into a host local buffer that is copied to the optimal tiled image on the device
-
-			// Create a host-visible staging buffer that contains the raw image data
-			// This buffer will be the data source for copying texture data to the optimal tiled image on the device
-			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingMemory;
-
-			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-			bufferCreateInfo.size = ktxTextureSize;
-			// This buffer is used as a transfer source for the buffer copy
-			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-			// Get memory requirements for the staging buffer (alignment, memory type bits)
-			vkGetBufferMemoryRequirements(device, stagingBuffer, &memReqs);
-			memAllocInfo.allocationSize = memReqs.size;
-			// Get memory type index for a host visible buffer
-			memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &stagingMemory));
-			VK_CHECK_RESULT(vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0));
-
-			// Copy texture data into host local staging buffer
-			uint8_t *data;
-			VK_CHECK_RESULT(vkMapMemory(device, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-			memcpy(data, ktxTextureData, ktxTextureSize);
-			vkUnmapMemory(device, stagingMemory);
-
-			// Setup buffer copy regions for each mip level
-			std::vector<VkBufferImageCopy> bufferCopyRegions;
-			uint32_t offset = 0;
-
-			for (uint32_t i = 0; i < texture.mipLevels; i++) {
-				// Calculate offset into staging buffer for the current mip level
-				ktx_size_t offset;
-				KTX_error_code ret = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
-				assert(ret == KTX_SUCCESS);
-				// Setup a buffer image copy structure for the current mip level
-				VkBufferImageCopy bufferCopyRegion = {};
-				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				bufferCopyRegion.imageSubresource.mipLevel = i;
-				bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-				bufferCopyRegion.imageSubresource.layerCount = 1;
-				bufferCopyRegion.imageExtent.width = ktxTexture->baseWidth >> i;
-				bufferCopyRegion.imageExtent.height = ktxTexture->baseHeight >> i;
-				bufferCopyRegion.imageExtent.depth = 1;
-				bufferCopyRegion.bufferOffset = offset;
-				bufferCopyRegions.push_back(bufferCopyRegion);
-			}
-
-			// Create optimal tiled target image on the device
-			VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-			imageCreateInfo.format = format;
-			imageCreateInfo.mipLevels = texture.mipLevels;
-			imageCreateInfo.arrayLayers = 1;
-			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			// Set initial layout of the image to undefined
-			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageCreateInfo.extent = { texture.width, texture.height, 1 };
-			imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-			VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &texture.image));
-
-			vkGetImageMemoryRequirements(device, texture.image, &memReqs);
-			memAllocInfo.allocationSize = memReqs.size;
-			memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &texture.deviceMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(device, texture.image, texture.deviceMemory, 0));
-
-			VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-			// Image memory barriers for the texture image
-
-			// The sub resource range describes the regions of the image that will be transitioned using the memory barriers below
-			VkImageSubresourceRange subresourceRange = {};
-			// Image only contains color data
-			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			// Start at first mip level
-			subresourceRange.baseMipLevel = 0;
-			// We will transition on all mip levels
-			subresourceRange.levelCount = texture.mipLevels;
-			// The 2D texture only has one layer
-			subresourceRange.layerCount = 1;
-
-			// Transition the texture image layout to transfer target, so we can safely copy our buffer data to it.
-			VkImageMemoryBarrier imageMemoryBarrier = vks::initializers::imageMemoryBarrier();;
-			imageMemoryBarrier.image = texture.image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			imageMemoryBarrier.srcAccessMask = 0;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-
-			// Insert a memory dependency at the proper pipeline stages that will execute the image layout transition
-			// Source pipeline stage is host write/read execution (VK_PIPELINE_STAGE_HOST_BIT)
-			// Destination pipeline stage is copy command execution (VK_PIPELINE_STAGE_TRANSFER_BIT)
-			vkCmdPipelineBarrier(
-				copyCmd,
-				VK_PIPELINE_STAGE_HOST_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				0,
-				0, nullptr,
-				0, nullptr,
-				1, &imageMemoryBarrier);
-
-			// Copy mip levels from staging buffer
-			vkCmdCopyBufferToImage(
-				copyCmd,
-				stagingBuffer,
-				texture.image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				static_cast<uint32_t>(bufferCopyRegions.size()),
-				bufferCopyRegions.data());
-
-			// Once the data has been uploaded we transfer to the texture image to the shader read layout, so it can be sampled from
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-			// Insert a memory dependency at the proper pipeline stages that will execute the image layout transition
-			// Source pipeline stage is copy command execution (VK_PIPELINE_STAGE_TRANSFER_BIT)
-			// Destination pipeline stage fragment shader access (VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
-			vkCmdPipelineBarrier(
-				copyCmd,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-				0,
-				0, nullptr,
-				0, nullptr,
-				1, &imageMemoryBarrier);
-
-			// Store current layout for later reuse
-			texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-			vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
-
-			// Clean up staging resources
-			vkFreeMemory(device, stagingMemory, nullptr);
-			vkDestroyBuffer(device, stagingBuffer, nullptr);
-		} else {
-			// Copy data to a linear tiled image
-
-			VkImage mappableImage;
-			VkDeviceMemory mappableMemory;
-
-			// Load mip map level 0 to linear tiling image
-			VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-			imageCreateInfo.format = format;
-			imageCreateInfo.mipLevels = 1;
-			imageCreateInfo.arrayLayers = 1;
-			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-			imageCreateInfo.tiling = VK_IMAGE_TILING_LINEAR;
-			imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
-			imageCreateInfo.extent = { texture.width, texture.height, 1 };
-			VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &mappableImage));
-
-			// Get memory requirements for this image like size and alignment
-			vkGetImageMemoryRequirements(device, mappableImage, &memReqs);
-			// Set memory allocation size to required memory size
-			memAllocInfo.allocationSize = memReqs.size;
-			// Get memory type that can be mapped to host memory
-			memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &mappableMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(device, mappableImage, mappableMemory, 0));
-
-			// Map image memory
-			void *data;
-			VK_CHECK_RESULT(vkMapMemory(device, mappableMemory, 0, memReqs.size, 0, &data));
-			// Copy image data of the first mip level into memory
-			memcpy(data, ktxTextureData, memReqs.size);
-			vkUnmapMemory(device, mappableMemory);
-
-			// Linear tiled images don't need to be staged and can be directly used as textures
-			texture.image = mappableImage;
-			texture.deviceMemory = mappableMemory;
-			texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-			// Setup image memory barrier transfer image to shader read layout
-			VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-			// The sub resource range describes the regions of the image we will be transition
-			VkImageSubresourceRange subresourceRange = {};
-			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			subresourceRange.baseMipLevel = 0;
-			subresourceRange.levelCount = 1;
-			subresourceRange.layerCount = 1;
-
-			// Transition the texture image layout to shader read, so it can be sampled from
-			VkImageMemoryBarrier imageMemoryBarrier = vks::initializers::imageMemoryBarrier();;
-			imageMemoryBarrier.image = texture.image;
-			imageMemoryBarrier.subresourceRange = subresourceRange;
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
-			imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-			// Insert a memory dependency at the proper pipeline stages that will execute the image layout transition
-			// Source pipeline stage is host write/read execution (VK_PIPELINE_STAGE_HOST_BIT)
-			// Destination pipeline stage fragment shader access (VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
-			vkCmdPipelineBarrier(
-				copyCmd,
-				VK_PIPELINE_STAGE_HOST_BIT,
-				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-				0,
-				0, nullptr,
-				0, nullptr,
-				1, &imageMemoryBarrier);
+		// Copy data to an optimal tiled image
+		// This loads the texture data into a host local buffer that is copied to the optimal tiled image on the device
+
+		// Create a host-visible staging buffer that contains the raw image data
+		// This buffer will be the data source for copying texture data to the optimal tiled image on the device
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingMemory;
+
+		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
+		bufferCreateInfo.size = ktxTextureSize;
+		// This buffer is used as a transfer source for the buffer copy
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &stagingBuffer));
+
+		// Get memory requirements for the staging buffer (alignment, memory type bits)
+		vkGetBufferMemoryRequirements(device, stagingBuffer, &memReqs);
+		memAllocInfo.allocationSize = memReqs.size;
+		// Get memory type index for a host visible buffer
+		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &stagingMemory));
+		VK_CHECK_RESULT(vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0));
+
+		// Copy texture data into host local staging buffer
+		uint8_t *data;
+		VK_CHECK_RESULT(vkMapMemory(device, stagingMemory, 0, memReqs.size, 0, (void **)&data));
+		memcpy(data, ktxTextureData, ktxTextureSize);
+		vkUnmapMemory(device, stagingMemory);
+
+		// Setup buffer copy regions for each mip level
+		std::vector<VkBufferImageCopy> bufferCopyRegions;
+		uint32_t offset = 0;
+
+		for (uint32_t i = 0; i < texture.mipLevels; i++) {
+			// Calculate offset into staging buffer for the current mip level
+			ktx_size_t offset;
+			KTX_error_code ret = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
+			assert(ret == KTX_SUCCESS);
+			// Setup a buffer image copy structure for the current mip level
+			VkBufferImageCopy bufferCopyRegion = {};
+			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferCopyRegion.imageSubresource.mipLevel = i;
+			bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+			bufferCopyRegion.imageSubresource.layerCount = 1;
+			bufferCopyRegion.imageExtent.width = ktxTexture->baseWidth >> i;
+			bufferCopyRegion.imageExtent.height = ktxTexture->baseHeight >> i;
+			bufferCopyRegion.imageExtent.depth = 1;
+			bufferCopyRegion.bufferOffset = offset;
+			bufferCopyRegions.push_back(bufferCopyRegion);
+		}
 
-			vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		// Create optimal tiled target image on the device
+		VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.mipLevels = texture.mipLevels;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		// Set initial layout of the image to undefined
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.extent = { texture.width, texture.height, 1 };
+		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &texture.image));
+
+		vkGetImageMemoryRequirements(device, texture.image, &memReqs);
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &texture.deviceMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, texture.image, texture.deviceMemory, 0));
+
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+		// Image memory barriers for the texture image
+
+		// The sub resource range describes the regions of the image that will be transitioned using the memory barriers below
+		VkImageSubresourceRange subresourceRange = {};
+		// Image only contains color data
+		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		// Start at first mip level
+		subresourceRange.baseMipLevel = 0;
+		// We will transition on all mip levels
+		subresourceRange.levelCount = texture.mipLevels;
+		// The 2D texture only has one layer
+		subresourceRange.layerCount = 1;
+
+		// Transition the texture image layout to transfer target, so we can safely copy our buffer data to it.
+		VkImageMemoryBarrier imageMemoryBarrier = vks::initializers::imageMemoryBarrier();;
+		imageMemoryBarrier.image = texture.image;
+		imageMemoryBarrier.subresourceRange = subresourceRange;
+		imageMemoryBarrier.srcAccessMask = 0;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+		// Insert a memory dependency at the proper pipeline stages that will execute the image layout transition
+		// Source pipeline stage is host write/read execution (VK_PIPELINE_STAGE_HOST_BIT)
+		// Destination pipeline stage is copy command execution (VK_PIPELINE_STAGE_TRANSFER_BIT)
+		vkCmdPipelineBarrier(
+			copyCmd,
+			VK_PIPELINE_STAGE_HOST_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &imageMemoryBarrier);
+
+		// Copy mip levels from staging buffer
+		vkCmdCopyBufferToImage(
+			copyCmd,
+			stagingBuffer,
+			texture.image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(bufferCopyRegions.size()),
+			bufferCopyRegions.data());
+
+		// Once the data has been uploaded we transfer to the texture image to the shader read layout, so it can be sampled from
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		// Insert a memory dependency at the proper pipeline stages that will execute the image layout transition
+		// Source pipeline stage is copy command execution (VK_PIPELINE_STAGE_TRANSFER_BIT)
+		// Destination pipeline stage fragment shader access (VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+		vkCmdPipelineBarrier(
+			copyCmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &imageMemoryBarrier);
+
+		// Store current layout for later reuse
+		texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+
+		// Clean up staging resources
+		vkFreeMemory(device, stagingMemory, nullptr);
+		vkDestroyBuffer(device, stagingBuffer, nullptr);
+
+		if (streaming) {
+			// Keep a copy of the first mip level as the source of the streamed frames
+			ktx_size_t levelOffset;
+			KTX_error_code ret = ktxTexture_GetImageOffset(ktxTexture, 0, 0, 0, &levelOffset);
+			assert(ret == KTX_SUCCESS);
+			streamingSource.assign(ktxTextureData + levelOffset, ktxTextureData + levelOffset + ktxTexture_GetImageSize(ktxTexture, 0));
+			if (streamingNV12) {
+				streamingSource = convertToNV12(streamingSource, texture.width, texture.height);
+				streamingTexture.create(VK_FORMAT_G8_B8R8_2PLANE_420_UNORM, texture.width, texture.height, static_cast<uint32_t>(drawCmdBuffers.size()), vulkanDevice);
+			}
+			else {
+				streamingTexture.create(format, texture.width, texture.height, static_cast<uint32_t>(drawCmdBuffers.size()), vulkanDevice);
+			}
 		}
 
 		ktxTexture_Destroy(ktxTexture);
@@ -406,7 +382,7 @@ public:
 		sampler.compareOp = VK_COMPARE_OP_NEVER;
 		sampler.minLod = 0.0f;
 		// Set max level-of-detail to mip level count of the texture
-		sampler.maxLod = (useStaging) ? (float)texture.mipLevels : 0.0f;
+		sampler.maxLod = (float)texture.mipLevels;
 		// Enable anisotropic filtering
 		// This feature is optional, so we must check if it's supported on the device
 		if (vulkanDevice->features.samplerAnisotropy) {
@@ -434,14 +410,35 @@ public:
 		view.subresourceRange.baseMipLevel = 0;
 		view.subresourceRange.baseArrayLayer = 0;
 		view.subresourceRange.layerCount = 1;
-		// Linear tiling usually won't support mip maps
-		// Only set mip map count if optimal tiling is used
-		view.subresourceRange.levelCount = (useStaging) ? texture.mipLevels : 1;
+		view.subresourceRange.levelCount = texture.mipLevels;
 		// The view will be based on the texture's image
 		view.image = texture.image;
 		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &texture.view));
 	}
 
+	// Convert RGBA texels to BT.709 narrow range NV12 once at load time, standing in for the output of a video decoder
+	std::vector<uint8_t> convertToNV12(const std::vector<uint8_t> &rgba, uint32_t width, uint32_t height)
+	{
+		std::vector<uint8_t> nv12(width * height + (width / 2) * (height / 2) * 2);
+		uint8_t *chroma = nv12.data() + width * height;
+		for (uint32_t y = 0; y < height; y++) {
+			for (uint32_t x = 0; x < width; x++) {
+				const uint8_t *texel = &rgba[(y * width + x) * 4];
+				const float luma = 0.2126f * texel[0] + 0.7152f * texel[1] + 0.0722f * texel[2];
+				nv12[y * width + x] = static_cast<uint8_t>(16.0f + luma * 219.0f / 255.0f + 0.5f);
+				if ((x % 2 == 0) && (y % 2 == 0)) {
+					// Chroma of the top left texel of each 2x2 block
+					const float cb = (texel[2] - luma) / 1.8556f;
+					const float cr = (texel[0] - luma) / 1.5748f;
+					uint8_t *chromaTexel = &chroma[((y / 2) * (width / 2) + x / 2) * 2];
+					chromaTexel[0] = static_cast<uint8_t>(128.0f + cb * 224.0f / 255.0f + 0.5f);
+					chromaTexel[1] = static_cast<uint8_t>(128.0f + cr * 224.0f / 255.0f + 0.5f);
+				}
+			}
+		}
+		return nv12;
+	}
+
 	// Free all Vulkan resources used by a texture object
 	void destroyTextureImage(Texture texture)
 	{
@@ -475,6 +472,11 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			if (streaming) {
+				// Copy this command buffer's staging slot into the texture before it's sampled
+				streamingTexture.recordUpload(drawCmdBuffers[i], i);
+			}
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -483,7 +485,7 @@ public:
 			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, streaming ? &streamingDescriptorSets[i] : &descriptorSet, 0, NULL);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.solid);
 
 			VkDeviceSize offsets[1] = { 0 };
@@ -504,16 +506,44 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		if (streaming) {
+			updateStreamingTexture();
+		}
+
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
 
+	// Write the next frame of the streamed texture into the staging slot of the current command buffer, its previous submission has finished in prepareFrame()
+	void updateStreamingTexture()
+	{
+		uint8_t *data = static_cast<uint8_t*>(streamingTexture.getSlotData(currentBuffer));
+		if (streamingNV12) {
+			// Scroll by whole chroma rows, so both planes stay aligned
+			const size_t scrolledRows = (static_cast<size_t>(timer * texture.height) % texture.height) & ~static_cast<size_t>(1);
+			const size_t lumaSize = texture.width * texture.height;
+			scrollRows(data, streamingSource.data(), texture.width, texture.height, scrolledRows);
+			scrollRows(data + lumaSize, streamingSource.data() + lumaSize, texture.width, texture.height / 2, scrolledRows / 2);
+		}
+		else {
+			const size_t rowSize = streamingSource.size() / texture.height;
+			const size_t scrolledRows = static_cast<size_t>(timer * texture.height) % texture.height;
+			scrollRows(data, streamingSource.data(), rowSize, texture.height, scrolledRows);
+		}
+	}
+
+	void scrollRows(uint8_t *dst, const uint8_t *src, size_t rowSize, size_t rowCount, size_t scrolledRows)
+	{
+		memcpy(dst, src + scrolledRows * rowSize, (rowCount - scrolledRows) * rowSize);
+		memcpy(dst + (rowCount - scrolledRows) * rowSize, src, scrolledRows * rowSize);
+	}
+
 	void generateQuad()
 	{
 		// Setup vertices for a single uv-mapped quad made from two triangles
@@ -591,18 +621,21 @@ public:
 
 	void setupDescriptorPool()
 	{
-		// Example uses one ubo and one image sampler
+		// Example uses one ubo and one image sampler, streaming uses one set per command buffer
+		const uint32_t setCount = streaming ? static_cast<uint32_t>(drawCmdBuffers.size()) : 1;
+		// A multi-planar image with a Y'CbCr conversion may consume a combined image sampler descriptor per plane
+		const uint32_t samplerDescriptorCount = streamingNV12 ? setCount * 3 : setCount;
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, setCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, samplerDescriptorCount)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				static_cast<uint32_t>(poolSizes.size()),
 				poolSizes.data(),
-				2);
+				setCount + 1);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -622,6 +655,10 @@ public:
 				VK_SHADER_STAGE_FRAGMENT_BIT,
 				1)
 		};
+		// Samplers with a Y'CbCr conversion can only be used as immutable samplers
+		if (streamingTexture.usesYcbcrConversion()) {
+			setLayoutBindings[1].pImmutableSamplers = &streamingTexture.sampler;
+		}
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
 			vks::initializers::descriptorSetLayoutCreateInfo(
@@ -640,6 +677,11 @@ public:
 
 	void setupDescriptorSet()
 	{
+		if (streaming) {
+			setupStreamingDescriptorSets();
+			return;
+		}
+
 		VkDescriptorSetAllocateInfo allocInfo =
 			vks::initializers::descriptorSetAllocateInfo(
 				descriptorPool,
@@ -674,6 +716,22 @@ public:
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 	}
 
+	// Each command buffer samples the streaming texture's image of its own slot
+	void setupStreamingDescriptorSets()
+	{
+		streamingDescriptorSets.resize(drawCmdBuffers.size());
+		for (uint32_t i = 0; i < static_cast<uint32_t>(streamingDescriptorSets.size()); i++) {
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &streamingDescriptorSets[i]));
+			VkDescriptorImageInfo textureDescriptor = streamingTexture.getDescriptor(i);
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(streamingDescriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBufferVS.descriptor),
+				vks::initializers::writeDescriptorSet(streamingDescriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textureDescriptor)
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+	}
+
 	void preparePipelines()
 	{
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState =
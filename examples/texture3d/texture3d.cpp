@@ -7,10 +7,12 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "noise.hpp"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
 
+
 // Vertex layout for this example
 struct Vertex {
 	float pos[3];
@@ -18,113 +20,6 @@ struct Vertex {
 	float normal[3];
 };
 
-// Translation of Ken Perlin's JAVA implementation (http://mrl.nyu.edu/~perlin/noise/)
-template <typename T>
-class PerlinNoise
-{
-private:
-	uint32_t permutations[512];
-	T fade(T t)
-	{
-		return t * t * t * (t * (t * (T)6 - (T)15) + (T)10);
-	}
-	T lerp(T t, T a, T b)
-	{
-		return a + t * (b - a);
-	}
-	T grad(int hash, T x, T y, T z)
-	{
-		// Convert LO 4 bits of hash code into 12 gradient directions
-		int h = hash & 15;
-		T u = h < 8 ? x : y;
-		T v = h < 4 ? y : h == 12 || h == 14 ? x : z;
-		return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
-	}
-public:
-	PerlinNoise()
-	{
-		// Generate random lookup for permutations containing all numbers from 0..255
-		std::vector<uint8_t> plookup;
-		plookup.resize(256);
-		std::iota(plookup.begin(), plookup.end(), 0);
-		std::default_random_engine rndEngine(std::random_device{}());
-		std::shuffle(plookup.begin(), plookup.end(), rndEngine);
-
-		for (uint32_t i = 0; i < 256; i++)
-		{
-			permutations[i] = permutations[256 + i] = plookup[i];
-		}
-	}
-	T noise(T x, T y, T z)
-	{
-		// Find unit cube that contains point
-		int32_t X = (int32_t)floor(x) & 255;
-		int32_t Y = (int32_t)floor(y) & 255;
-		int32_t Z = (int32_t)floor(z) & 255;
-		// Find relative x,y,z of point in cube
-		x -= floor(x);
-		y -= floor(y);
-		z -= floor(z);
-
-		// Compute fade curves for each of x,y,z
-		T u = fade(x);
-		T v = fade(y);
-		T w = fade(z);
-
-		// Hash coordinates of the 8 cube corners
-		uint32_t A = permutations[X] + Y;
-		uint32_t AA = permutations[A] + Z;
-		uint32_t AB = permutations[A + 1] + Z;
-		uint32_t B = permutations[X + 1] + Y;
-		uint32_t BA = permutations[B] + Z;
-		uint32_t BB = permutations[B + 1] + Z;
-
-		// And add blended results for 8 corners of the cube;
-		T res = lerp(w, lerp(v,
-			lerp(u, grad(permutations[AA], x, y, z), grad(permutations[BA], x - 1, y, z)), lerp(u, grad(permutations[AB], x, y - 1, z), grad(permutations[BB], x - 1, y - 1, z))),
-			lerp(v, lerp(u, grad(permutations[AA + 1], x, y, z - 1), grad(permutations[BA + 1], x - 1, y, z - 1)), lerp(u, grad(permutations[AB + 1], x, y - 1, z - 1), grad(permutations[BB + 1], x - 1, y - 1, z - 1))));
-		return res;
-	}
-};
-
-// Fractal noise generator based on perlin noise above
-template <typename T>
-class FractalNoise
-{
-private:
-	PerlinNoise<float> perlinNoise;
-	uint32_t octaves;
-	T frequency;
-	T amplitude;
-	T persistence;
-public:
-
-	FractalNoise(const PerlinNoise<T> &perlinNoise)
-	{
-		this->perlinNoise = perlinNoise;
-		octaves = 6;
-		persistence = (T)0.5;
-	}
-
-	T noise(T x, T y, T z)
-	{
-		T sum = 0;
-		T frequency = (T)1;
-		T amplitude = (T)1;
-		T max = (T)0;
-		for (uint32_t i = 0; i < octaves; i++)
-		{
-			sum += perlinNoise.noise(x * frequency, y * frequency, z * frequency) * amplitude;
-			max += amplitude;
-			amplitude *= persistence;
-			frequency *= (T)2;
-		}
-
-		sum = sum / max;
-		return (sum + (T)1.0) / (T)2.0;
-	}
-};
-
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -168,6 +63,35 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	enum NoiseGenerator { Compute = 0, CPU = 1 };
+	int32_t noiseGenerator = Compute;
+	int32_t noiseSizeIndex = 1;
+	const std::vector<uint32_t> noiseSizes = { 64, 128, 256 };
+	// Shared by both generators, so their results can be compared
+	vks::PerlinNoise<float> perlinNoise;
+	float noiseScale = 4.0f;
+	// Duration of the last generation with each generator in ms, negative if not measured
+	double generationTimes[2] = { -1.0, -1.0 };
+	std::string comparisonResult;
+	std::vector<std::string> benchmarkResults;
+
+	// Writes the noise directly into the 3D texture, requires storage image support for its format
+	struct {
+		bool supported = false;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		vks::Buffer permutations;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+	} noiseCompute;
+
+	struct NoisePushConstants {
+		float noiseScale;
+		uint32_t octaves;
+		float persistence;
+	};
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "3D textures";
@@ -193,6 +117,24 @@ public:
 		vertexBuffer.destroy();
 		indexBuffer.destroy();
 		uniformBufferVS.destroy();
+
+		if (noiseCompute.supported) {
+			vkDestroyPipeline(device, noiseCompute.pipeline, nullptr);
+			vkDestroyPipelineLayout(device, noiseCompute.pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, noiseCompute.descriptorSetLayout, nullptr);
+			noiseCompute.permutations.destroy();
+			if (noiseCompute.queryPool != VK_NULL_HANDLE) {
+				vkDestroyQueryPool(device, noiseCompute.queryPool, nullptr);
+			}
+		}
+	}
+
+	virtual void getEnabledFeatures()
+	{
+		// Needed for writing to the r8 texture from the compute shader
+		if (deviceFeatures.shaderStorageImageExtendedFormats) {
+			enabledFeatures.shaderStorageImageExtendedFormats = VK_TRUE;
+		}
 	}
 
 	// Prepare all Vulkan resources for the 3D texture (including descriptors)
@@ -216,6 +158,8 @@ public:
 			std::cout << "Error: Device does not support flag TRANSFER_DST for selected texture format!" << std::endl;
 			return;
 		}
+		// The compute shader generator writes the texture as a storage image, otherwise only the CPU generator is available
+		noiseCompute.supported = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) && enabledFeatures.shaderStorageImageExtendedFormats;
 		// Check if GPU supports requested 3D texture dimensions
 		uint32_t maxImageDimension3D(vulkanDevice->properties.limits.maxImageDimension3D);
 		if (width > maxImageDimension3D || height > maxImageDimension3D || depth > maxImageDimension3D)
@@ -238,7 +182,10 @@ public:
 		imageCreateInfo.extent.depth = texture.depth;
 		// Set initial layout of the image to undefined
 		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		if (noiseCompute.supported) {
+			imageCreateInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		}
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &texture.image));
 
 		// Device local memory to back up image
@@ -283,55 +230,72 @@ public:
 		texture.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		texture.descriptor.imageView = texture.view;
 		texture.descriptor.sampler = texture.sampler;
-
-		updateNoiseTexture();
 	}
 
-	// Generate randomized noise and upload it to the 3D texture using staging
+	// Generate randomized noise with the selected generator
 	void updateNoiseTexture()
 	{
-		const uint32_t texMemSize = texture.width * texture.height * texture.depth;
+		// The texture may still be sampled by frames in flight
+		VK_CHECK_RESULT(vulkanDevice->queueWaitIdle(queue));
 
-		uint8_t *data = new uint8_t[texMemSize];
-		memset(data, 0, texMemSize);
+		perlinNoise = vks::PerlinNoise<float>();
+		noiseScale = static_cast<float>(rand() % 10) + 4.0f;
+		comparisonResult.clear();
+
+		std::cout << "Generating " << texture.width << " x " << texture.height << " x " << texture.depth << " noise texture";
+		if ((noiseGenerator == Compute) && noiseCompute.supported) {
+			std::cout << " with a compute shader..." << std::endl;
+			generateNoiseCompute();
+		}
+		else {
+			std::cout << " on the CPU..." << std::endl;
+			generateNoiseCPU();
+		}
+	}
 
-		// Generate perlin based noise
-		std::cout << "Generating " << texture.width << " x " << texture.height << " x " << texture.depth << " noise texture..." << std::endl;
+	// Generate the noise on the CPU, this is the reference the compute shader is compared against
+	std::vector<uint8_t> computeNoiseCPU()
+	{
+		std::vector<uint8_t> data(texture.width * texture.height * texture.depth);
 
 		auto tStart = std::chrono::high_resolution_clock::now();
 
-		PerlinNoise<float> perlinNoise;
-		FractalNoise<float> fractalNoise(perlinNoise);
-
-		const float noiseScale = static_cast<float>(rand() % 10) + 4.0f;
+		vks::FractalNoise<float> fractalNoise(perlinNoise);
 
 #pragma omp parallel for
 		for (int32_t z = 0; z < texture.depth; z++)
 		{
+			// Each row is evaluated with a single batch call
+			std::vector<float> nx(texture.width), ny(texture.width), nz(texture.width), n(texture.width);
 			for (int32_t y = 0; y < texture.height; y++)
 			{
 				for (int32_t x = 0; x < texture.width; x++)
 				{
-					float nx = (float)x / (float)texture.width;
-					float ny = (float)y / (float)texture.height;
-					float nz = (float)z / (float)texture.depth;
-#define FRACTAL
-#ifdef FRACTAL
-					float n = fractalNoise.noise(nx * noiseScale, ny * noiseScale, nz * noiseScale);
-#else
-					float n = 20.0 * perlinNoise.noise(nx, ny, nz);
-#endif
-					n = n - floor(n);
-
-					data[x + y * texture.width + z * texture.width * texture.height] = static_cast<uint8_t>(floor(n * 255));
+					nx[x] = (float)x / (float)texture.width * noiseScale;
+					ny[x] = (float)y / (float)texture.height * noiseScale;
+					nz[x] = (float)z / (float)texture.depth * noiseScale;
+				}
+				fractalNoise.noise(nx.data(), ny.data(), nz.data(), n.data(), texture.width);
+				for (int32_t x = 0; x < texture.width; x++)
+				{
+					const float v = n[x] - floor(n[x]);
+					data[x + y * texture.width + z * texture.width * texture.height] = static_cast<uint8_t>(floor(v * 255));
 				}
 			}
 		}
 
 		auto tEnd = std::chrono::high_resolution_clock::now();
-		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		generationTimes[CPU] = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 
-		std::cout << "Done in " << tDiff << "ms" << std::endl;
+		std::cout << "CPU generation done in " << generationTimes[CPU] << "ms" << std::endl;
+		return data;
+	}
+
+	// Generate the noise on the CPU and upload it to the 3D texture using staging
+	void generateNoiseCPU()
+	{
+		std::vector<uint8_t> data = computeNoiseCPU();
+		const uint32_t texMemSize = static_cast<uint32_t>(data.size());
 
 		// Create a host-visible staging buffer that contains the raw image data
 		VkBuffer stagingBuffer;
@@ -356,7 +320,7 @@ public:
 		// Copy texture data into staging buffer
 		uint8_t *mapped;
 		VK_CHECK_RESULT(vkMapMemory(device, stagingMemory, 0, memReqs.size, 0, (void **)&mapped));
-		memcpy(mapped, data, texMemSize);
+		memcpy(mapped, data.data(), texMemSize);
 		vkUnmapMemory(device, stagingMemory);
 
 		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
@@ -409,11 +373,171 @@ public:
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
 
 		// Clean up staging resources
-		delete[] data;
 		vkFreeMemory(device, stagingMemory, nullptr);
 		vkDestroyBuffer(device, stagingBuffer, nullptr);
 	}
 
+	// Generate the noise with a compute shader writing directly into the 3D texture
+	void generateNoiseCompute()
+	{
+		memcpy(noiseCompute.permutations.mapped, perlinNoise.getPermutations(), 512 * sizeof(uint32_t));
+
+		vks::FractalNoise<float> fractalNoise(perlinNoise);
+		NoisePushConstants pushConstants;
+		pushConstants.noiseScale = noiseScale;
+		pushConstants.octaves = fractalNoise.getOctaves();
+		pushConstants.persistence = fractalNoise.getPersistence();
+
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		// All texels are overwritten, so the previous contents can be discarded
+		vks::tools::setImageLayout(commandBuffer, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresourceRange);
+
+		if (noiseCompute.queryPool != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(commandBuffer, noiseCompute.queryPool, 0, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, noiseCompute.queryPool, 0);
+		}
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, noiseCompute.pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, noiseCompute.pipelineLayout, 0, 1, &noiseCompute.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, noiseCompute.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(NoisePushConstants), &pushConstants);
+		// The shader uses 4 x 4 x 4 work groups
+		vkCmdDispatch(commandBuffer, (texture.width + 3) / 4, (texture.height + 3) / 4, (texture.depth + 3) / 4);
+		if (noiseCompute.queryPool != VK_NULL_HANDLE) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, noiseCompute.queryPool, 1);
+		}
+
+		texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vks::tools::setImageLayout(commandBuffer, texture.image, VK_IMAGE_LAYOUT_GENERAL, texture.imageLayout, subresourceRange);
+
+		vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+
+		if (noiseCompute.queryPool != VK_NULL_HANDLE) {
+			uint64_t timestamps[2] = { 0, 0 };
+			VK_CHECK_RESULT(vkGetQueryPoolResults(device, noiseCompute.queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+			generationTimes[Compute] = static_cast<double>(timestamps[1] - timestamps[0]) * vulkanDevice->properties.limits.timestampPeriod / 1000000.0;
+			std::cout << "Compute shader generation done in " << generationTimes[Compute] << "ms" << std::endl;
+		}
+	}
+
+	// Read the texture back and compare it against the CPU reference generated with the same permutations and scale
+	void compareNoiseGenerators()
+	{
+		VK_CHECK_RESULT(vulkanDevice->queueWaitIdle(queue));
+
+		const std::vector<uint8_t> reference = computeNoiseCPU();
+
+		vks::Buffer readback;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&readback,
+			reference.size()));
+
+		VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vks::tools::setImageLayout(commandBuffer, texture.image, texture.imageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresourceRange);
+		VkBufferImageCopy bufferCopyRegion{};
+		bufferCopyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		bufferCopyRegion.imageExtent = { texture.width, texture.height, texture.depth };
+		vkCmdCopyImageToBuffer(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &bufferCopyRegion);
+		vks::tools::setImageLayout(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.imageLayout, subresourceRange);
+		vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+
+		// Floating point results may differ slightly between host and device, which can push texels to the neighboring value
+		// (or wrap them around at the fractional cut)
+		VK_CHECK_RESULT(readback.map());
+		const uint8_t *texels = static_cast<const uint8_t*>(readback.mapped);
+		size_t mismatches = 0;
+		int32_t maxDifference = 0;
+		for (size_t i = 0; i < reference.size(); i++) {
+			const int32_t difference = std::abs(static_cast<int32_t>(texels[i]) - static_cast<int32_t>(reference[i]));
+			if (difference != 0) {
+				mismatches++;
+				maxDifference = std::max(maxDifference, std::min(difference, 256 - difference));
+			}
+		}
+		readback.destroy();
+
+		std::stringstream ss;
+		ss << mismatches << " of " << reference.size() << " texels differ, max. difference " << maxDifference;
+		comparisonResult = ss.str();
+		std::cout << "Compute shader vs. CPU reference: " << comparisonResult << std::endl;
+	}
+
+	// Single threaded comparison of the scalar and the batch noise evaluation on slices of the 3D texture sizes
+	void benchmarkNoise()
+	{
+		vks::FractalNoise<float> fractalNoise(perlinNoise);
+		benchmarkResults.clear();
+		std::cout << "Fractal noise, scalar vs. batch evaluation";
+#if defined(NOISE_SIMD_AVX2)
+		std::cout << " (AVX2)";
+#elif defined(NOISE_SIMD_SSE)
+		std::cout << " (SSE2)";
+#elif defined(NOISE_SIMD_NEON)
+		std::cout << " (NEON)";
+#else
+		std::cout << " (no SIMD)";
+#endif
+		std::cout << ":" << std::endl;
+		for (uint32_t size : noiseSizes)
+		{
+			// Around a million samples per size, timings are extrapolated to the full volume
+			const uint32_t slices = std::min(size, std::max((1u << 20) / (size * size), 1u));
+			const size_t sampleCount = static_cast<size_t>(size) * size * slices;
+			std::vector<float> x(sampleCount), y(sampleCount), z(sampleCount), scalarResult(sampleCount), batchResult(sampleCount);
+			for (size_t i = 0; i < sampleCount; i++)
+			{
+				x[i] = static_cast<float>(i % size) / static_cast<float>(size) * noiseScale;
+				y[i] = static_cast<float>((i / size) % size) / static_cast<float>(size) * noiseScale;
+				z[i] = static_cast<float>(i / (size * size)) / static_cast<float>(size) * noiseScale;
+			}
+
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (size_t i = 0; i < sampleCount; i++)
+			{
+				scalarResult[i] = fractalNoise.noise(x[i], y[i], z[i]);
+			}
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			const double scalarTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+
+			// One row per call, as in the texture generation
+			tStart = std::chrono::high_resolution_clock::now();
+			for (size_t i = 0; i < sampleCount; i += size)
+			{
+				fractalNoise.noise(&x[i], &y[i], &z[i], &batchResult[i], size);
+			}
+			tEnd = std::chrono::high_resolution_clock::now();
+			const double batchTime = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+
+			float maxDifference = 0.0f;
+			for (size_t i = 0; i < sampleCount; i++)
+			{
+				maxDifference = std::max(maxDifference, std::abs(scalarResult[i] - batchResult[i]));
+			}
+
+			const double volumeScale = static_cast<double>(size) / static_cast<double>(slices);
+			std::stringstream ss;
+			ss << std::fixed << std::setprecision(1) << size << "^3: " << scalarTime * volumeScale << " ms vs. " << batchTime * volumeScale << " ms (" << scalarTime / batchTime << "x)";
+			benchmarkResults.push_back(ss.str());
+			std::cout << benchmarkResults.back() << ", max. difference " << maxDifference << std::endl;
+		}
+	}
+
+	// Recreate the 3D texture with a new size, the descriptors referencing it are updated and the command buffers rebuilt
+	void resizeNoiseTexture()
+	{
+		VK_CHECK_RESULT(vkDeviceWaitIdle(device));
+		destroyTextureImage(texture);
+		texture = Texture();
+		const uint32_t size = noiseSizes[noiseSizeIndex];
+		prepareNoiseTexture(size, size, size);
+		updateNoiseDescriptors();
+		updateNoiseTexture();
+		buildCommandBuffers();
+	}
+
 	// Free all Vulkan resources used a texture object
 	void destroyTextureImage(Texture texture)
 	{
@@ -484,7 +608,7 @@ public:
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
@@ -570,7 +694,10 @@ public:
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+			// Compute shader noise generator
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -611,6 +738,22 @@ public:
 				1);
 
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		if (noiseCompute.supported) {
+			setLayoutBindings = {
+				// Binding 0 : Output 3D texture
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				// Binding 1 : Permutation table
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1)
+			};
+			descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &noiseCompute.descriptorSetLayout));
+			VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(NoisePushConstants), 0);
+			pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&noiseCompute.descriptorSetLayout, 1);
+			pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+			pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &noiseCompute.pipelineLayout));
+		}
 	}
 
 	void setupDescriptorSet()
@@ -640,6 +783,27 @@ public:
 		};
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		if (noiseCompute.supported) {
+			allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &noiseCompute.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &noiseCompute.descriptorSet));
+			updateNoiseDescriptors();
+		}
+	}
+
+	// Point the descriptors at the current 3D texture
+	void updateNoiseDescriptors()
+	{
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texture.descriptor)
+		};
+		// The compute shader writes the texture in the general layout
+		VkDescriptorImageInfo storageImageDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, texture.view, VK_IMAGE_LAYOUT_GENERAL);
+		if (noiseCompute.supported) {
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(noiseCompute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, &storageImageDescriptor));
+			writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(noiseCompute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &noiseCompute.permutations.descriptor));
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 	}
 
 	void preparePipelines()
@@ -715,6 +879,34 @@ public:
 		pipelineCreateInfo.pStages = shaderStages.data();
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.solid));
+
+		if (noiseCompute.supported) {
+			VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(noiseCompute.pipelineLayout, 0);
+			computePipelineCreateInfo.stage = loadShader(getShadersPath() + "texture3d/noise.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &noiseCompute.pipeline));
+		}
+	}
+
+	// Permutation table buffer and timestamp queries of the compute shader noise generator
+	void prepareNoiseCompute()
+	{
+		if (!noiseCompute.supported) {
+			noiseGenerator = CPU;
+			return;
+		}
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&noiseCompute.permutations,
+			512 * sizeof(uint32_t)));
+		VK_CHECK_RESULT(noiseCompute.permutations.map());
+		if (vulkanDevice->properties.limits.timestampComputeAndGraphics) {
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &noiseCompute.queryPool));
+		}
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -754,11 +946,13 @@ public:
 		generateQuad();
 		setupVertexDescriptions();
 		prepareUniformBuffers();
-		prepareNoiseTexture(128, 128, 128);
+		prepareNoiseTexture(noiseSizes[noiseSizeIndex], noiseSizes[noiseSizeIndex], noiseSizes[noiseSizeIndex]);
+		prepareNoiseCompute();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
+		updateNoiseTexture();
 		buildCommandBuffers();
 		prepared = true;
 	}
@@ -780,9 +974,37 @@ public:
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
+			if (noiseCompute.supported) {
+				overlay->comboBox("Generator", &noiseGenerator, { "Compute shader", "CPU" });
+			}
+			if (overlay->comboBox("Size", &noiseSizeIndex, { "64 x 64 x 64", "128 x 128 x 128", "256 x 256 x 256" })) {
+				resizeNoiseTexture();
+			}
 			if (overlay->button("Generate new texture")) {
 				updateNoiseTexture();
 			}
+			if (noiseCompute.supported && overlay->button("Compare with CPU reference")) {
+				compareNoiseGenerators();
+			}
+			if (overlay->button("Benchmark CPU noise")) {
+				benchmarkNoise();
+			}
+		}
+		if (overlay->header("Generation times")) {
+			if (generationTimes[Compute] >= 0.0) {
+				overlay->text("Compute shader: %.2f ms", generationTimes[Compute]);
+			}
+			if (generationTimes[CPU] >= 0.0) {
+				overlay->text("CPU: %.2f ms", generationTimes[CPU]);
+			}
+			if (!comparisonResult.empty()) {
+				overlay->text("%s", comparisonResult.c_str());
+			}
+		}
+		if (!benchmarkResults.empty() && overlay->header("CPU noise benchmark (scalar vs. batch)")) {
+			for (auto& result : benchmarkResults) {
+				overlay->text("%s", result.c_str());
+			}
 		}
 	}
 };
@@ -497,16 +497,13 @@ public:
 			uboVS.instance[i].arrayIndex.x = (float)i;
 		}
 
+		// Map persistent
+		VK_CHECK_RESULT(uniformBufferVS.map());
+
 		// Update instanced part of the uniform buffer
-		uint8_t *pData;
 		uint32_t dataOffset = sizeof(uboVS.matrices);
 		uint32_t dataSize = layerCount * sizeof(UboInstanceData);
-		VK_CHECK_RESULT(vkMapMemory(device, uniformBufferVS.memory, dataOffset, dataSize, 0, (void **)&pData));
-		memcpy(pData, uboVS.instance, dataSize);
-		vkUnmapMemory(device, uniformBufferVS.memory);
-
-		// Map persistent
-		VK_CHECK_RESULT(uniformBufferVS.map());
+		memcpy(static_cast<uint8_t*>(uniformBufferVS.mapped) + dataOffset, uboVS.instance, dataSize);
 
 		updateUniformBuffersCamera();
 	}
@@ -524,7 +521,7 @@ public:
 
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
 	}
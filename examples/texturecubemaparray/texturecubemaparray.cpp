@@ -1,5 +1,5 @@
 /*
-* Vulkan Example - Cube map array texture loading and displaying
+* Vulkan Example - Cube map array texture loading and displaying, optionally rendering dynamic content into all cube maps in a single layered pass
 *
 * Copyright (C) 2020 by Sascha Willems - www.saschawillems.de
 *
@@ -8,6 +8,8 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanMipGenerator.h"
+#include "VulkanSpecialization.hpp"
 #include <ktx.h>
 #include <ktxvulkan.h>
 
@@ -54,6 +56,46 @@ public:
 
 	std::vector<std::string> objectNames;
 
+	// Dynamic mode renders into all faces of all cube maps of an array every frame and samples that array instead of the one loaded from disk
+	// All faces are rendered by a single layered render pass, each instance of a draw writes the layer of its face from the vertex shader (VK_EXT_shader_viewport_index_layer)
+	// The mip chain is then generated in compute, like it would be for local reflection probes updated every frame
+	bool dynamicCubemaps = false;
+	float dynamicTime = 0.0f;
+
+	struct DynamicUniforms {
+		// Projection and view of the cube map faces in the face order of Vulkan (+X, -X, +Y, -Y, +Z, -Z)
+		glm::mat4 faceViewProjection[6];
+		float time;
+		int32_t sourceLayerCount;
+	};
+
+	struct {
+		uint32_t dim = 256;
+		VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+		uint32_t mipLevels;
+		uint32_t layerCount;
+		VkImage image;
+		VkDeviceMemory memory;
+		// First level of all faces of all cube maps, the attachment of the layered framebuffer
+		VkImageView attachmentView;
+		// All levels sampled as a cube map array
+		VkImageView cubeArrayView;
+		VkSampler sampler;
+		VkImage depthImage;
+		VkDeviceMemory depthMemory;
+		VkImageView depthView;
+		VkRenderPass renderPass;
+		VkFramebuffer framebuffer;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline sky;
+		VkPipeline object;
+		// One uniform buffer per command buffer, so the animation can advance while earlier frames are in flight
+		std::vector<vks::Buffer> uniformBuffers;
+		std::vector<VkDescriptorSet> descriptorSets;
+		std::unique_ptr<vks::MipGenerator> mipGenerator;
+	} dynamicTarget;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Cube map textures";
@@ -61,6 +103,13 @@ public:
 		camera.setPosition(glm::vec3(0.0f, 0.0f, -4.0f));
 		camera.setRotationSpeed(0.25f);
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+		commandLineParser.add("dynamiccubemaps", { "-dcm", "--dynamiccubemaps" }, 0, "Render dynamic content into all cube maps every frame with a single layered pass");
+		commandLineParser.parse(args);
+		dynamicCubemaps = commandLineParser.isSet("dynamiccubemaps");
+		if (dynamicCubemaps) {
+			// The compute mip generator uses subgroup operations
+			apiVersion = VK_API_VERSION_1_1;
+		}
 	}
 
 	~VulkanExample()
@@ -71,6 +120,10 @@ public:
 		vkDestroySampler(device, cubeMapArray.sampler, nullptr);
 		vkFreeMemory(device, cubeMapArray.deviceMemory, nullptr);
 
+		if (dynamicCubemaps) {
+			destroyDynamicCubemaps();
+		}
+
 		vkDestroyPipeline(device, pipelines.skybox, nullptr);
 		vkDestroyPipeline(device, pipelines.reflect, nullptr);
 
@@ -93,8 +146,26 @@ public:
 		if (deviceFeatures.samplerAnisotropy) {
 			enabledFeatures.samplerAnisotropy = VK_TRUE;
 		}
+		// Required by the compute mip generator, without it the dynamic mode falls back to the loaded cube maps
+		if (dynamicCubemaps && deviceFeatures.shaderStorageImageWriteWithoutFormat) {
+			enabledFeatures.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+		}
 	};
 
+	virtual void getEnabledExtensions()
+	{
+		if (!dynamicCubemaps) {
+			return;
+		}
+		if (vulkanDevice->extensionSupported(VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME)) {
+			enabledDeviceExtensions.push_back(VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME);
+		}
+		else {
+			std::cout << "VK_EXT_shader_viewport_index_layer is not supported by the selected device, displaying the loaded cube maps instead\n";
+			dynamicCubemaps = false;
+		}
+	}
+
 	void loadCubemapArray(std::string filename, VkFormat format, bool forceLinearTiling)
 	{
 		ktxResult result;
@@ -290,10 +361,288 @@ public:
 		ktxTexture_Destroy(ktxTexture);
 	}
 
+	// Create the render target cube map array, the layered render pass rendering into all of its faces at once and the pipelines of that pass
+	// Returns false if the device can't generate the mip levels of the target in compute
+	bool prepareDynamicCubemaps()
+	{
+		dynamicTarget.mipGenerator.reset(new vks::MipGenerator(vulkanDevice, getShadersPath() + "base/mipgen.comp.spv", apiVersion));
+		dynamicTarget.layerCount = cubeMapArray.layerCount;
+		if (!dynamicTarget.mipGenerator->isFormatSupported(dynamicTarget.format) || (6 * dynamicTarget.layerCount > vulkanDevice->properties.limits.maxFramebufferLayers)) {
+			std::cout << "Compute mip generation or layered rendering into " << dynamicTarget.layerCount << " cube maps is not supported by the selected device, displaying the loaded cube maps instead\n";
+			dynamicTarget.mipGenerator.reset();
+			return false;
+		}
+		dynamicTarget.mipLevels = static_cast<uint32_t>(floor(log2(dynamicTarget.dim))) + 1;
+		const uint32_t faceCount = 6 * dynamicTarget.layerCount;
+
+		// Cube map array target
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = dynamicTarget.format;
+		imageCI.extent = { dynamicTarget.dim, dynamicTarget.dim, 1 };
+		imageCI.mipLevels = dynamicTarget.mipLevels;
+		imageCI.arrayLayers = faceCount;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &dynamicTarget.image));
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, dynamicTarget.image, &memReqs);
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &dynamicTarget.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, dynamicTarget.image, dynamicTarget.memory, 0));
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewCI.format = dynamicTarget.format;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, faceCount };
+		viewCI.image = dynamicTarget.image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &dynamicTarget.attachmentView));
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_CUBE_ARRAY;
+		viewCI.subresourceRange.levelCount = dynamicTarget.mipLevels;
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &dynamicTarget.cubeArrayView));
+
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.maxLod = static_cast<float>(dynamicTarget.mipLevels);
+		samplerCI.maxAnisotropy = 1.0f;
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &dynamicTarget.sampler));
+
+		// Layered depth attachment with one layer per face
+		imageCI.format = depthFormat;
+		imageCI.mipLevels = 1;
+		imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		imageCI.flags = 0;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &dynamicTarget.depthImage));
+		vkGetImageMemoryRequirements(device, dynamicTarget.depthImage, &memReqs);
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &dynamicTarget.depthMemory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, dynamicTarget.depthImage, dynamicTarget.depthMemory, 0));
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewCI.format = depthFormat;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, faceCount };
+		if (vks::tools::formatHasStencil(depthFormat)) {
+			viewCI.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		viewCI.image = dynamicTarget.depthImage;
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &dynamicTarget.depthView));
+
+		// Render pass, the first level is left in the attachment layout for the mip generator
+		std::array<VkAttachmentDescription, 2> attachments = {};
+		attachments[0].format = dynamicTarget.format;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachments[1].format = depthFormat;
+		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+		VkSubpassDescription subpassDescription = {};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = 1;
+		subpassDescription.pColorAttachments = &colorReference;
+		subpassDescription.pDepthStencilAttachment = &depthReference;
+
+		std::array<VkSubpassDependency, 2> dependencies;
+		// The previous frame sampled all levels and wrote the mip chain, both have to finish before the faces are overwritten
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = 0;
+		// The mip generator reads the first level in compute
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[1].dependencyFlags = 0;
+
+		VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+		renderPassCI.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassCI.pAttachments = attachments.data();
+		renderPassCI.subpassCount = 1;
+		renderPassCI.pSubpasses = &subpassDescription;
+		renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassCI.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &dynamicTarget.renderPass));
+
+		// A single framebuffer covers all faces of all cube maps
+		VkImageView framebufferAttachments[2] = { dynamicTarget.attachmentView, dynamicTarget.depthView };
+		VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+		framebufferCI.renderPass = dynamicTarget.renderPass;
+		framebufferCI.attachmentCount = 2;
+		framebufferCI.pAttachments = framebufferAttachments;
+		framebufferCI.width = dynamicTarget.dim;
+		framebufferCI.height = dynamicTarget.dim;
+		framebufferCI.layers = faceCount;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &dynamicTarget.framebuffer));
+
+		dynamicTarget.uniformBuffers.resize(drawCmdBuffers.size());
+		for (auto& uniformBuffer : dynamicTarget.uniformBuffers) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffer, sizeof(DynamicUniforms)));
+			VK_CHECK_RESULT(uniformBuffer.map());
+		}
+		for (uint32_t i = 0; i < static_cast<uint32_t>(dynamicTarget.uniformBuffers.size()); i++) {
+			updateDynamicUniformBuffer(i);
+		}
+
+		// Binding 0 : Face matrices and animation, binding 1 : Loaded cube map array shown as the sky of the rendered cube maps
+		const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)
+		};
+		const VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &dynamicTarget.descriptorSetLayout));
+		const VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&dynamicTarget.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &dynamicTarget.pipelineLayout));
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		// Faces are rendered with y pointing down, which flips the winding, so nothing is culled
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
+		shaderStages[0] = loadShader(getShadersPath() + "texturecubemaparray/cubemaplayered.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "texturecubemaparray/cubemaplayered.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+		// layout (constant_id = 0) const bool SKY
+		vks::SpecializationConstants<VkBool32> specializationConstants;
+		shaderStages[0].pSpecializationInfo = specializationConstants.getInfo();
+		shaderStages[1].pSpecializationInfo = specializationConstants.getInfo();
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(dynamicTarget.pipelineLayout, dynamicTarget.renderPass, 0);
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal });
+
+		// The sky is drawn first and behind everything
+		specializationConstants.set<0>(VK_TRUE);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &dynamicTarget.sky));
+		specializationConstants.set<0>(VK_FALSE);
+		depthStencilState.depthTestEnable = VK_TRUE;
+		depthStencilState.depthWriteEnable = VK_TRUE;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &dynamicTarget.object));
+		return true;
+	}
+
+	void destroyDynamicCubemaps()
+	{
+		vkDestroyPipeline(device, dynamicTarget.sky, nullptr);
+		vkDestroyPipeline(device, dynamicTarget.object, nullptr);
+		vkDestroyPipelineLayout(device, dynamicTarget.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, dynamicTarget.descriptorSetLayout, nullptr);
+		vkDestroyFramebuffer(device, dynamicTarget.framebuffer, nullptr);
+		vkDestroyRenderPass(device, dynamicTarget.renderPass, nullptr);
+		vkDestroyImageView(device, dynamicTarget.depthView, nullptr);
+		vkDestroyImage(device, dynamicTarget.depthImage, nullptr);
+		vkFreeMemory(device, dynamicTarget.depthMemory, nullptr);
+		vkDestroySampler(device, dynamicTarget.sampler, nullptr);
+		vkDestroyImageView(device, dynamicTarget.cubeArrayView, nullptr);
+		vkDestroyImageView(device, dynamicTarget.attachmentView, nullptr);
+		vkDestroyImage(device, dynamicTarget.image, nullptr);
+		vkFreeMemory(device, dynamicTarget.memory, nullptr);
+		for (auto& uniformBuffer : dynamicTarget.uniformBuffers) {
+			uniformBuffer.destroy();
+		}
+		dynamicTarget.mipGenerator.reset();
+	}
+
+	// Record the layered pass rendering all faces of all cube maps, followed by the generation of their mip chains
+	void recordDynamicCubemaps(VkCommandBuffer commandBuffer, uint32_t index)
+	{
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = dynamicTarget.renderPass;
+		renderPassBeginInfo.framebuffer = dynamicTarget.framebuffer;
+		renderPassBeginInfo.renderArea.extent = { dynamicTarget.dim, dynamicTarget.dim };
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport = vks::initializers::viewport((float)dynamicTarget.dim, (float)dynamicTarget.dim, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(dynamicTarget.dim, dynamicTarget.dim, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, dynamicTarget.pipelineLayout, 0, 1, &dynamicTarget.descriptorSets[index], 0, nullptr);
+
+		// One instance per face of each cube map, the vertex shader selects the face and writes its layer
+		const uint32_t faceCount = 6 * dynamicTarget.layerCount;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, dynamicTarget.sky);
+		models.skybox.bindBuffers(commandBuffer);
+		vkCmdDrawIndexed(commandBuffer, models.skybox.indices.count, faceCount, 0, 0, 0);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, dynamicTarget.object);
+		models.objects[0].bindBuffers(commandBuffer);
+		vkCmdDrawIndexed(commandBuffer, models.objects[0].indices.count, faceCount, 0, 0, 0);
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		dynamicTarget.mipGenerator->generate(commandBuffer, dynamicTarget.image, dynamicTarget.format, dynamicTarget.dim, dynamicTarget.dim, dynamicTarget.mipLevels, faceCount, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+
+	void updateDynamicUniformBuffer(uint32_t index)
+	{
+		DynamicUniforms uniforms;
+		const glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 64.0f);
+		// Directions and up vectors matching "Cube Map Face Selection" in the Vulkan specification, with y pointing down in framebuffer space
+		const glm::vec3 directions[6] = { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+		const glm::vec3 ups[6] = { glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) };
+		for (uint32_t face = 0; face < 6; face++) {
+			uniforms.faceViewProjection[face] = projection * glm::lookAt(glm::vec3(0.0f), directions[face], ups[face]);
+		}
+		uniforms.time = dynamicTime;
+		uniforms.sourceLayerCount = static_cast<int32_t>(cubeMapArray.layerCount);
+		memcpy(dynamicTarget.uniformBuffers[index].mapped, &uniforms, sizeof(DynamicUniforms));
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
+		if (dynamicCubemaps) {
+			// The command buffers recorded before aren't executing anymore, so the views and descriptors of their mip generations can be released
+			dynamicTarget.mipGenerator->releaseTransientResources();
+		}
+
 		VkClearValue clearValues[2];
 		clearValues[0].color = defaultClearColor;
 		clearValues[1].depthStencil = { 1.0f, 0 };
@@ -314,6 +663,10 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			if (dynamicCubemaps) {
+				recordDynamicCubemaps(drawCmdBuffers[i], i);
+			}
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width,	(float)height, 0.0f, 1.0f);
@@ -361,11 +714,13 @@ public:
 
 	void setupDescriptorPool()
 	{
+		// The dynamic cube maps are rendered with one descriptor set per command buffer
+		const uint32_t setCount = 2 + (dynamicCubemaps ? static_cast<uint32_t>(drawCmdBuffers.size()) : 0);
 		const std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, setCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount)
 		};
-		const VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
+		const VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, setCount);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -389,6 +744,22 @@ public:
 	{
 		// Image descriptor for the cube map texture
 		VkDescriptorImageInfo textureDescriptor = vks::initializers::descriptorImageInfo(cubeMapArray.sampler, cubeMapArray.view, cubeMapArray.imageLayout);
+		if (dynamicCubemaps) {
+			// The loaded cube maps are the sky of the rendered ones
+			for (uint32_t i = 0; i < static_cast<uint32_t>(drawCmdBuffers.size()); i++) {
+				VkDescriptorSetAllocateInfo dynamicAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &dynamicTarget.descriptorSetLayout, 1);
+				VkDescriptorSet descriptorSet;
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &dynamicAllocInfo, &descriptorSet));
+				std::vector<VkWriteDescriptorSet> dynamicWriteDescriptorSets = {
+					vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &dynamicTarget.uniformBuffers[i].descriptor),
+					vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textureDescriptor)
+				};
+				vkUpdateDescriptorSets(device, static_cast<uint32_t>(dynamicWriteDescriptorSets.size()), dynamicWriteDescriptorSets.data(), 0, nullptr);
+				dynamicTarget.descriptorSets.push_back(descriptorSet);
+			}
+			// Everything else samples the rendered cube maps
+			textureDescriptor = vks::initializers::descriptorImageInfo(dynamicTarget.sampler, dynamicTarget.cubeArrayView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		}
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 
 		// 3D object descriptor set
@@ -497,9 +868,16 @@ public:
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
+		if (dynamicCubemaps) {
+			// The command buffer's previous submission has finished in prepareFrame(), so its uniform buffer can be written
+			if (!paused) {
+				dynamicTime += frameTimer;
+			}
+			updateDynamicUniformBuffer(currentBuffer);
+		}
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -507,6 +885,9 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		if (dynamicCubemaps) {
+			dynamicCubemaps = prepareDynamicCubemaps();
+		}
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -537,7 +918,7 @@ public:
 			if (overlay->sliderInt("Cube map", &shaderData.cubeMapIndex, 0, cubeMapArray.layerCount - 1)) {
 				updateUniformBuffers();
 			}
-			if (overlay->sliderFloat("LOD bias", &shaderData.lodBias, 0.0f, (float)cubeMapArray.mipLevels)) {
+			if (overlay->sliderFloat("LOD bias", &shaderData.lodBias, 0.0f, (float)(dynamicCubemaps ? dynamicTarget.mipLevels : cubeMapArray.mipLevels))) {
 				updateUniformBuffers();
 			}
 			if (overlay->comboBox("Object type", &models.objectIndex, objectNames)) {
@@ -437,9 +437,9 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 
 	// Bind to queue
 	// todo: in draw?
-	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, VK_NULL_HANDLE);
+	vulkanDevice->queueBindSparse(queue, 1, &texture.bindSparseInfo, VK_NULL_HANDLE);
 	//todo: use sparse bind semaphore
-	vkQueueWaitIdle(queue);
+	vulkanDevice->queueWaitIdle(queue);
 
 	// Create sampler
 	VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
@@ -534,7 +534,7 @@ void VulkanExample::draw()
 	VulkanExampleBase::prepareFrame();
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 	VulkanExampleBase::submitFrame();
 }
 
@@ -663,6 +663,9 @@ void VulkanExample::prepareUniformBuffers()
 		sizeof(uboVS),
 		&uboVS));
 
+	// Map persistent
+	VK_CHECK_RESULT(uniformBufferVS.map());
+
 	updateUniformBuffers();
 }
 
@@ -672,9 +675,7 @@ void VulkanExample::updateUniformBuffers()
 	uboVS.model = camera.matrices.view;
 	uboVS.viewPos = camera.viewPos;
 
-	VK_CHECK_RESULT(uniformBufferVS.map());
 	memcpy(uniformBufferVS.mapped, &uboVS, sizeof(uboVS));
-	uniformBufferVS.unmap();
 }
 
 void VulkanExample::prepare()
@@ -789,7 +790,7 @@ void VulkanExample::fillRandomPages()
 	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
 	VkFence fence;
 	VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, fence);
+	vulkanDevice->queueBindSparse(queue, 1, &texture.bindSparseInfo, fence);
 	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
 	vkDestroyFence(device, fence, nullptr);
 
@@ -885,7 +886,7 @@ void VulkanExample::flushRandomPages()
 	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
 	VkFence fence;
 	VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
-	vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, fence);
+	vulkanDevice->queueBindSparse(queue, 1, &texture.bindSparseInfo, fence);
 	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
 	vkDestroyFence(device, fence, nullptr);
 	for (auto& page : texture.pages)
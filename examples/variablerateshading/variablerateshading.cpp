@@ -11,6 +11,7 @@
 VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 {
 	title = "Variable rate shading";
+	supportsFramesInFlight = true;
 	apiVersion = VK_API_VERSION_1_1;
 	camera.type = Camera::CameraType::firstperson;
 	camera.flipY = true;
@@ -20,6 +21,9 @@ VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	camera.setRotationSpeed(0.25f);
 	enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 	enabledDeviceExtensions.push_back(VK_NV_SHADING_RATE_IMAGE_EXTENSION_NAME);
+	commandLineParser.add("inlinematerials", { "-im", "--inlinematerials" }, 0, "Store the material constants as inline uniform blocks (VK_EXT_inline_uniform_block)");
+	commandLineParser.parse(args);
+	inlineMaterialConstants = commandLineParser.isSet("inlinematerials");
 }
 
 VulkanExample::~VulkanExample()
@@ -30,6 +34,14 @@ VulkanExample::~VulkanExample()
 	vkDestroyPipeline(device, shadingRatePipelines.opaque, nullptr);
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+	if (foveationSupported) {
+		vkDestroyPipeline(device, foveation.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, foveation.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, foveation.descriptorSetLayout, nullptr);
+		for (auto& buffer : foveation.uniformBuffers) {
+			buffer.destroy();
+		}
+	}
 	vkDestroyImageView(device, shadingRateImage.view, nullptr);
 	vkDestroyImage(device, shadingRateImage.image, nullptr);
 	vkFreeMemory(device, shadingRateImage.memory, nullptr);
@@ -39,6 +51,8 @@ VulkanExample::~VulkanExample()
 void VulkanExample::getEnabledFeatures()
 {
 	enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+	// The foveation pass writes the R8_UINT shading rate image, which is an extended storage image format
+	enabledFeatures.shaderStorageImageExtendedFormats = deviceFeatures.shaderStorageImageExtendedFormats;
 	// POI
 	enabledPhysicalDeviceShadingRateImageFeaturesNV = {};
 	enabledPhysicalDeviceShadingRateImageFeaturesNV.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADING_RATE_IMAGE_FEATURES_NV;
@@ -46,10 +60,33 @@ void VulkanExample::getEnabledFeatures()
 	deviceCreatepNextChain = &enabledPhysicalDeviceShadingRateImageFeaturesNV;
 }
 
-/*
-	If the window has been resized, we need to recreate the shading rate image
-*/
-void VulkanExample::handleResize()
+void VulkanExample::getEnabledExtensions()
+{
+	// Inline uniform blocks for the material constants, the feature is chained behind the shading rate image features
+	if (inlineMaterialConstants && vulkanDevice->extensionSupported(VK_EXT_INLINE_UNIFORM_BLOCK_EXTENSION_NAME)) {
+		VkPhysicalDeviceInlineUniformBlockFeaturesEXT inlineUniformBlockFeatures{};
+		inlineUniformBlockFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_INLINE_UNIFORM_BLOCK_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2 deviceFeatures2{};
+		deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		deviceFeatures2.pNext = &inlineUniformBlockFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+		if (inlineUniformBlockFeatures.inlineUniformBlock == VK_TRUE) {
+			enabledDeviceExtensions.push_back(VK_EXT_INLINE_UNIFORM_BLOCK_EXTENSION_NAME);
+			enabledInlineUniformBlockFeatures = {};
+			enabledInlineUniformBlockFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_INLINE_UNIFORM_BLOCK_FEATURES_EXT;
+			enabledInlineUniformBlockFeatures.inlineUniformBlock = VK_TRUE;
+			enabledPhysicalDeviceShadingRateImageFeaturesNV.pNext = &enabledInlineUniformBlockFeatures;
+			return;
+		}
+	}
+	if (inlineMaterialConstants) {
+		std::cout << "Inline uniform blocks are not supported by the selected device, the material constants are stored in a uniform buffer\n";
+		inlineMaterialConstants = false;
+	}
+}
+
+// Recreating the image also restores the static pattern after the foveation pass has overwritten it
+void VulkanExample::recreateShadingRateImage()
 {
 	// Delete allocated resources
 	vkDestroyImageView(device, shadingRateImage.view, nullptr);
@@ -57,6 +94,15 @@ void VulkanExample::handleResize()
 	vkFreeMemory(device, shadingRateImage.memory, nullptr);
 	// Recreate image
 	prepareShadingRateImage();
+	updateDescriptors();
+}
+
+/*
+	If the window has been resized, we need to recreate the shading rate image
+*/
+void VulkanExample::handleResize()
+{
+	recreateShadingRateImage();
 	resized = false;
 }
 
@@ -86,10 +132,44 @@ void VulkanExample::buildCommandBuffers()
 	const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 	const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 
+	const bool foveated = enableShadingRate && (shadingRatePattern == Foveated);
+	// GPU times are logged per preset and material constant storage, so the benchmark results of different runs can be compared
+	std::string sceneScope = "full rate";
+	if (enableShadingRate) {
+		sceneScope = foveated ? foveationPresets[foveationPreset].name : "static pattern";
+	}
+	sceneScope = "Scene (" + sceneScope + (inlineMaterialConstants ? ", inline materials)" : ", material buffer)");
+
 	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 	{
 		renderPassBeginInfo.framebuffer = frameBuffers[i];
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		benchmark.gpuProfiler.reset(drawCmdBuffers[i], i);
+
+		// [POI] Generate the shading rates around the current fovea center
+		if (foveated) {
+			benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, "Foveation");
+			// The shading rate image stays in the general layout, so the previous frame's reads only need to finish before it is written
+			VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+			imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+			imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			imageBarrier.srcAccessMask = 0;
+			imageBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			imageBarrier.image = shadingRateImage.image;
+			imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_SHADING_RATE_IMAGE_BIT_NV, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, foveation.pipeline);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, foveation.pipelineLayout, 0, 1, &foveation.descriptorSets[i], 0, nullptr);
+			vkCmdDispatch(drawCmdBuffers[i], (shadingRateImage.extent.width + 7) / 8, (shadingRateImage.extent.height + 7) / 8, 1);
+
+			imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			imageBarrier.dstAccessMask = VK_ACCESS_SHADING_RATE_IMAGE_READ_BIT_NV;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_SHADING_RATE_IMAGE_BIT_NV, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+			benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
+		}
+
+		benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, sceneScope);
 		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
@@ -97,7 +177,7 @@ void VulkanExample::buildCommandBuffers()
 
 		// POI: Bind the image that contains the shading rate patterns
 		if (enableShadingRate) {
-			vkCmdBindShadingRateImageNV(drawCmdBuffers[i], shadingRateImage.view, VK_IMAGE_LAYOUT_SHADING_RATE_OPTIMAL_NV);
+			vkCmdBindShadingRateImageNV(drawCmdBuffers[i], shadingRateImage.view, VK_IMAGE_LAYOUT_GENERAL);
 		};
 
 		// Render the scene
@@ -109,27 +189,32 @@ void VulkanExample::buildCommandBuffers()
 
 		drawUI(drawCmdBuffers[i]);
 		vkCmdEndRenderPass(drawCmdBuffers[i]);
+		benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
 }
 
 void VulkanExample::loadAssets()
 {
-	vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor | vkglTF::DescriptorBindingFlags::ImageNormalMap;
+	vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor | vkglTF::DescriptorBindingFlags::ImageNormalMap | vkglTF::DescriptorBindingFlags::MaterialConstants;
+	vkglTF::inlineMaterialConstants = inlineMaterialConstants;
 	scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices);
 }
 
 void VulkanExample::setupDescriptors()
 {
 	// Pool
+	// The foveation pass has a set per swapchain image, with its parameters
+	const uint32_t frameCount = static_cast<uint32_t>(foveation.uniformBuffers.size());
 	const std::vector<VkDescriptorPoolSize> poolSizes = {
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 + frameCount),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, std::max(frameCount, 1u)),
 	};
-	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1 + frameCount);
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
 	// Descriptor set layout
-	const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
 		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
 	};
 	VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
@@ -150,6 +235,38 @@ void VulkanExample::setupDescriptors()
 		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &shaderData.buffer.descriptor),
 	};
 	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+	// Foveation pass
+	if (foveationSupported) {
+		setLayoutBindings = {
+			// Binding 0 : Shading rate image
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Parameters
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &foveation.descriptorSetLayout));
+		pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&foveation.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &foveation.pipelineLayout));
+		foveation.descriptorSets.resize(frameCount);
+		for (auto& set : foveation.descriptorSets) {
+			allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &foveation.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &set));
+		}
+		updateDescriptors();
+	}
+}
+
+// Write the descriptors of the shading rate image, which is recreated on resize
+void VulkanExample::updateDescriptors()
+{
+	VkDescriptorImageInfo shadingRateDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, shadingRateImage.view, VK_IMAGE_LAYOUT_GENERAL);
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+	for (size_t i = 0; i < foveation.descriptorSets.size(); i++) {
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(foveation.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, &shadingRateDescriptor));
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(foveation.descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &foveation.uniformBuffers[i].descriptor));
+	}
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 }
 
 // [POI]
@@ -161,6 +278,7 @@ void VulkanExample::prepareShadingRateImage()
 	imageExtent.width = static_cast<uint32_t>(ceil(width / (float)physicalDeviceShadingRateImagePropertiesNV.shadingRateTexelSize.width));
 	imageExtent.height = static_cast<uint32_t>(ceil(height / (float)physicalDeviceShadingRateImagePropertiesNV.shadingRateTexelSize.height));
 	imageExtent.depth = 1;
+	shadingRateImage.extent = imageExtent;
 
 	VkImageCreateInfo imageCI{};
 	imageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -174,6 +292,10 @@ void VulkanExample::prepareShadingRateImage()
 	imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	imageCI.usage = VK_IMAGE_USAGE_SHADING_RATE_IMAGE_BIT_NV | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	// The foveation pass writes the image in place
+	if (foveationSupported) {
+		imageCI.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+	}
 	VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &shadingRateImage.image));
 	VkMemoryRequirements memReqs{};
 	vkGetImageMemoryRequirements(device, shadingRateImage.image, &memReqs);
@@ -283,7 +405,8 @@ void VulkanExample::prepareShadingRateImage()
 		VkImageMemoryBarrier imageMemoryBarrier{};
 		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADING_RATE_OPTIMAL_NV;
+		// The general layout is valid for both the shading rate image reads and the foveation pass writes
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
 		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 		imageMemoryBarrier.dstAccessMask = 0;
 		imageMemoryBarrier.image = shadingRateImage.image;
@@ -324,16 +447,13 @@ void VulkanExample::preparePipelines()
 	shaderStages[0] = loadShader(getShadersPath() + "variablerateshading/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 	shaderStages[1] = loadShader(getShadersPath() + "variablerateshading/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 
-	// Properties for alpha masked materials will be passed via specialization constants
+	// Alpha masking is selected via a specialization constant, the cutoff is read from the material constants
 	struct SpecializationData {
 		VkBool32 alphaMask;
-		float alphaMaskCutoff;
 	} specializationData;
 	specializationData.alphaMask = false;
-	specializationData.alphaMaskCutoff = 0.5f;
 	const std::vector<VkSpecializationMapEntry> specializationMapEntries = {
 		vks::initializers::specializationMapEntry(0, offsetof(SpecializationData, alphaMask), sizeof(SpecializationData::alphaMask)),
-		vks::initializers::specializationMapEntry(1, offsetof(SpecializationData, alphaMaskCutoff), sizeof(SpecializationData::alphaMaskCutoff)),
 	};
 	VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(specializationMapEntries, sizeof(specializationData), &specializationData);
 	shaderStages[1].pSpecializationInfo = &specializationInfo;
@@ -375,6 +495,13 @@ void VulkanExample::preparePipelines()
 	specializationData.alphaMask = true;
 	rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
 	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &shadingRatePipelines.masked));
+
+	// Foveation pass
+	if (foveationSupported) {
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(foveation.pipelineLayout, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "variablerateshading/foveation.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &foveation.pipeline));
+	}
 }
 
 void VulkanExample::prepareUniformBuffers()
@@ -386,6 +513,18 @@ void VulkanExample::prepareUniformBuffers()
 		sizeof(shaderData.values)));
 	VK_CHECK_RESULT(shaderData.buffer.map());
 	updateUniformBuffers();
+
+	if (foveationSupported) {
+		foveation.uniformBuffers.resize(drawCmdBuffers.size());
+		for (auto& buffer : foveation.uniformBuffers) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&buffer,
+				sizeof(Foveation::Parameters)));
+			VK_CHECK_RESULT(buffer.map());
+		}
+	}
 }
 
 void VulkanExample::updateUniformBuffers()
@@ -397,6 +536,21 @@ void VulkanExample::updateUniformBuffers()
 	memcpy(shaderData.buffer.mapped, &shaderData.values, sizeof(shaderData.values));
 }
 
+// Written before each submission of the foveation pass, so the fovea follows the cursor without rebuilding the command buffers
+void VulkanExample::updateFoveationParameters()
+{
+	const FoveationPreset& preset = foveationPresets[foveationPreset];
+	Foveation::Parameters& parameters = foveation.parameters;
+	parameters.center = followCursor ? glm::clamp(mousePos, glm::vec2(0.0f), glm::vec2((float)width, (float)height)) : glm::vec2((float)width, (float)height) * 0.5f;
+	parameters.texelSize = glm::vec2((float)physicalDeviceShadingRateImagePropertiesNV.shadingRateTexelSize.width, (float)physicalDeviceShadingRateImagePropertiesNV.shadingRateTexelSize.height);
+	parameters.height = (float)height;
+	parameters.innerRadius = preset.innerRadius;
+	parameters.falloff = preset.falloff;
+	parameters.aspect = preset.aspect;
+	parameters.maxLevel = preset.maxLevel;
+	memcpy(foveation.uniformBuffers[currentBuffer].mapped, &parameters, sizeof(Foveation::Parameters));
+}
+
 void VulkanExample::prepare()
 {
 	VulkanExampleBase::prepare();
@@ -410,6 +564,14 @@ void VulkanExample::prepare()
 	deviceProperties2.pNext = &physicalDeviceShadingRateImagePropertiesNV;
 	vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
 
+	// The foveation pass writes the shading rate image as an R8_UINT storage image
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8_UINT, &formatProperties);
+	foveationSupported = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) && (enabledFeatures.shaderStorageImageExtendedFormats == VK_TRUE);
+	if (!foveationSupported) {
+		shadingRatePattern = Static;
+	}
+
 	prepareShadingRateImage();
 	prepareUniformBuffers();
 	setupDescriptors();
@@ -418,9 +580,21 @@ void VulkanExample::prepare()
 	prepared = true;
 }
 
+void VulkanExample::draw()
+{
+	VulkanExampleBase::prepareFrame();
+	if (enableShadingRate && (shadingRatePattern == Foveated)) {
+		updateFoveationParameters();
+	}
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+	VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
+	VulkanExampleBase::submitFrame();
+}
+
 void VulkanExample::render()
 {
-	renderFrame();
+	draw();
 	if (camera.updated) {
 		updateUniformBuffers();
 	}
@@ -428,11 +602,44 @@ void VulkanExample::render()
 
 void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 {
-	if (overlay->checkBox("Enable shading rate", &enableShadingRate)) {
-		buildCommandBuffers();
+	if (overlay->header("Settings")) {
+		if (overlay->checkBox("Enable shading rate", &enableShadingRate)) {
+			buildCommandBuffers();
+		}
+		if (foveationSupported) {
+			if (overlay->comboBox("Pattern", &shadingRatePattern, { "Static", "Foveated" })) {
+				if (shadingRatePattern == Static) {
+					// The foveation pass has overwritten the static pattern
+					vkDeviceWaitIdle(device);
+					recreateShadingRateImage();
+				}
+				buildCommandBuffers();
+			}
+		}
+		if (shadingRatePattern == Foveated) {
+			std::vector<std::string> presetNames;
+			for (auto& preset : foveationPresets) {
+				presetNames.push_back(preset.name);
+			}
+			// The preset is part of the profiler scope names
+			if (overlay->comboBox("Preset", &foveationPreset, presetNames)) {
+				buildCommandBuffers();
+			}
+			// Read from the per frame parameters, no rebuild required
+			FoveationPreset& preset = foveationPresets[foveationPreset];
+			overlay->sliderFloat("Fovea radius", &preset.innerRadius, 0.0f, 0.5f);
+			overlay->sliderFloat("Falloff", &preset.falloff, 0.01f, 0.25f);
+			overlay->checkBox("Follow cursor", &followCursor);
+		}
+		if (overlay->checkBox("Color shading rates", &colorShadingRate)) {
+			updateUniformBuffers();
+		}
+		overlay->text("Material constants: %s", inlineMaterialConstants ? "inline uniform blocks" : "uniform buffer");
 	}
-	if (overlay->checkBox("Color shading rates", &colorShadingRate)) {
-		updateUniformBuffers();
+	if (overlay->header("GPU times")) {
+		for (auto& result : benchmark.gpuProfiler.results) {
+			overlay->text("%s: %.3f ms", result.first.c_str(), result.second);
+		}
 	}
 }
 
@@ -20,11 +20,62 @@ public:
 		VkImage image;
 		VkDeviceMemory memory;
 		VkImageView view;
+		VkExtent3D extent;
 	} shadingRateImage;
 
 	bool enableShadingRate = true;
 	bool colorShadingRate = false;
 
+	// The shading rate image is either filled once with a static pattern or generated on the GPU every frame from a foveation preset
+	enum ShadingRatePattern { Static = 0, Foveated = 1 };
+	int32_t shadingRatePattern = Foveated;
+	// The foveation pass writes the R8_UINT shading rate image as a storage image
+	bool foveationSupported = false;
+
+	// Radial preset, distances are relative to the window height
+	struct FoveationPreset {
+		std::string name;
+		// Radius of the full rate region around the fovea center
+		float innerRadius;
+		// Width of each ring with the next coarser shading rate
+		float falloff;
+		// Horizontal scale of the distance, values below one stretch the regions horizontally to match wide lenses and displays
+		float aspect;
+		// Coarsest rate level, from 0 (1x1) to 4 (4x4)
+		int32_t maxLevel;
+	};
+	std::vector<FoveationPreset> foveationPresets = {
+		{ "Narrow fovea", 0.1f, 0.05f, 1.0f, 4 },
+		{ "Wide fovea", 0.25f, 0.1f, 1.0f, 3 },
+		{ "Lens matched", 0.2f, 0.08f, 0.75f, 4 },
+	};
+	int32_t foveationPreset = 0;
+	// The fovea center follows the cursor (standing in for the gaze position), otherwise it is the window center
+	bool followCursor = true;
+
+	// Material constants are stored as inline uniform blocks in the material sets if requested and supported, otherwise as ranges of a uniform buffer
+	bool inlineMaterialConstants = false;
+	VkPhysicalDeviceInlineUniformBlockFeaturesEXT enabledInlineUniformBlockFeatures{};
+
+	struct Foveation {
+		struct Parameters {
+			// Fovea center in pixels
+			glm::vec2 center;
+			glm::vec2 texelSize;
+			float height;
+			float innerRadius;
+			float falloff;
+			float aspect;
+			int32_t maxLevel;
+		} parameters;
+		// Per swapchain image, as the center changes every frame
+		std::vector<vks::Buffer> uniformBuffers;
+		std::vector<VkDescriptorSet> descriptorSets;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} foveation;
+
 	struct ShaderData {
 		vks::Buffer buffer;
 		struct Values {
@@ -56,16 +107,21 @@ public:
 	VulkanExample();
 	~VulkanExample();
 	virtual void getEnabledFeatures();
+	virtual void getEnabledExtensions();
+	void recreateShadingRateImage();
 	void handleResize();
 	void buildCommandBuffers();
 	void loadglTFFile(std::string filename);
 	void loadAssets();
 	void prepareShadingRateImage();
 	void setupDescriptors();
+	void updateDescriptors();
 	void preparePipelines();
 	void prepareUniformBuffers();
 	void updateUniformBuffers();
+	void updateFoveationParameters();
 	void prepare();
+	void draw();
 	virtual void render();
 	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay);
 };
\ No newline at end of file
@@ -166,10 +166,7 @@ VulkanExample::~VulkanExample()
 	separateVertexBuffers.uv.destroy();
 	interleavedVertexBuffer.destroy();
 	for (Image image : scene.images) {
-		vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
-		vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
-		vkDestroySampler(vulkanDevice->logicalDevice, image.texture.sampler, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, image.texture.deviceMemory, nullptr);
+		image.texture.destroy();
 	}
 }
 
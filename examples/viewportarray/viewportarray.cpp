@@ -1,6 +1,8 @@
 /*
 * Vulkan Example - Viewport array with single pass rendering using geometry shaders
 *
+* Alternatively broadcasts the scene to the viewports with instanced draws, where the vertex shader selects the viewport from the instance index (VK_EXT_shader_viewport_index_layer)
+*
 * Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -11,20 +13,30 @@
 
 #define ENABLE_VALIDATION false
 
+// Upper limit for the number of viewports, devices supporting multiViewport are guaranteed to support at least 16
+#define MAX_VIEWPORTS 16
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	vkglTF::Model scene;
 
+	// Shared by the geometry shader and the instanced vertex shader
 	struct UBOGS {
-		glm::mat4 projection[2];
-		glm::mat4 modelview[2];
+		glm::mat4 projection[MAX_VIEWPORTS];
+		glm::mat4 modelview[MAX_VIEWPORTS];
 		glm::vec4 lightPos = glm::vec4(-2.5f, -3.5f, 0.0f, 1.0f);
+		int32_t viewportCount = 2;
 	} uboGS;
 
 	vks::Buffer uniformBufferGS;
 
-	VkPipeline pipeline;
+	struct Pipelines {
+		// The number of geometry shader invocations is fixed at compile time, so stereo and the viewport grid use different geometry shaders
+		VkPipeline stereo{ VK_NULL_HANDLE };
+		VkPipeline grid{ VK_NULL_HANDLE };
+		VkPipeline instanced{ VK_NULL_HANDLE };
+	} pipelines;
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
@@ -36,6 +48,13 @@ public:
 	const float zNear = 0.1f;
 	const float zFar = 256.0f;
 
+	// Two viewports render a stereo pair, more viewports are laid out on a grid with cameras looking around the current position (like multi-camera monitoring views)
+	int32_t viewportCount = 2;
+	uint32_t maxViewportCount = MAX_VIEWPORTS;
+	enum BroadcastPath { GeometryShader = 0, InstancedDraw = 1 };
+	int32_t broadcastPath = GeometryShader;
+	bool instancedDrawSupported = false;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Viewport arrays";
@@ -43,11 +62,22 @@ public:
 		camera.setRotation(glm::vec3(0.0f, 90.0f, 0.0f));
 		camera.setTranslation(glm::vec3(7.0f, 3.2f, 0.0f));
 		camera.setMovementSpeed(5.0f);
+		commandLineParser.add("viewports", { "-vp", "--viewports" }, 1, "Number of viewports to render to (2 - 16, 2 renders a stereo pair)");
+		commandLineParser.add("instancedviewports", { "-ivp", "--instancedviewports" }, 0, "Select the viewport from the vertex shader of an instanced draw instead of using a geometry shader");
+		commandLineParser.parse(args);
+		viewportCount = std::min(std::max(commandLineParser.getValueAsInt("viewports", viewportCount), 2), MAX_VIEWPORTS);
+		if (commandLineParser.isSet("instancedviewports")) {
+			broadcastPath = InstancedDraw;
+		}
 	}
 
 	~VulkanExample()
 	{
-		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipeline(device, pipelines.stereo, nullptr);
+		vkDestroyPipeline(device, pipelines.grid, nullptr);
+		if (pipelines.instanced != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.instanced, nullptr);
+		}
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -74,6 +104,26 @@ public:
 		}
 	}
 
+	virtual void getEnabledExtensions()
+	{
+		// Writing the viewport index from the vertex shader is optional, without it only the geometry shader path is available
+		instancedDrawSupported = vulkanDevice->extensionSupported(VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME);
+		if (instancedDrawSupported) {
+			enabledDeviceExtensions.push_back(VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME);
+		}
+		else if (broadcastPath == InstancedDraw) {
+			std::cout << "VK_EXT_shader_viewport_index_layer is not supported by the selected device, using the geometry shader instead\n";
+			broadcastPath = GeometryShader;
+		}
+	}
+
+	// Viewports are laid out on a grid with as many columns as needed to make it roughly square, two viewports are placed side by side
+	void getViewportGrid(uint32_t& columns, uint32_t& rows)
+	{
+		columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(viewportCount))));
+		rows = (viewportCount + columns - 1) / columns;
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -91,38 +141,61 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
+		// The pipelines are created for all viewports, so all of them are set, the ones not used by the current grid are never written to
+		std::array<VkViewport, MAX_VIEWPORTS> viewports;
+		std::array<VkRect2D, MAX_VIEWPORTS> scissorRects;
+		uint32_t columns, rows;
+		getViewportGrid(columns, rows);
+		const uint32_t cellWidth = width / columns;
+		const uint32_t cellHeight = height / rows;
+		for (uint32_t i = 0; i < maxViewportCount; i++) {
+			const uint32_t cell = std::min(i, static_cast<uint32_t>(viewportCount) - 1);
+			const uint32_t x = (cell % columns) * cellWidth;
+			const uint32_t y = (cell / columns) * cellHeight;
+			viewports[i] = { (float)x, (float)y, (float)cellWidth, (float)cellHeight, 0.0f, 1.0f };
+			scissorRects[i] = vks::initializers::rect2D(cellWidth, cellHeight, x, y);
+		}
+
+		VkPipeline pipeline = pipelines.instanced;
+		std::string sceneScope = "Scene (instanced, " + std::to_string(viewportCount) + " viewports)";
+		if (broadcastPath == GeometryShader) {
+			pipeline = (viewportCount == 2) ? pipelines.stereo : pipelines.grid;
+			// GPU times are logged per path and viewport count, so the benchmark results can be compared
+			sceneScope = "Scene (geometry shader, " + std::to_string(viewportCount) + " viewports)";
+		}
+
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			// Set target frame buffer
 			renderPassBeginInfo.framebuffer = frameBuffers[i];
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			benchmark.gpuProfiler.reset(drawCmdBuffers[i], i);
 
+			benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, sceneScope);
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			VkViewport viewports[2];
-			// Left
-			viewports[0] = { 0, 0, (float)width / 2.0f, (float)height, 0.0, 1.0f };
-			// Right
-			viewports[1] = { (float)width / 2.0f, 0, (float)width / 2.0f, (float)height, 0.0, 1.0f };
-
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 2, viewports);
-
-			VkRect2D scissorRects[2] = {
-				vks::initializers::rect2D(width/2, height, 0, 0),
-				vks::initializers::rect2D(width/2, height, width / 2, 0),
-			};
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 2, scissorRects);
+			vkCmdSetViewport(drawCmdBuffers[i], 0, maxViewportCount, viewports.data());
+			vkCmdSetScissor(drawCmdBuffers[i], 0, maxViewportCount, scissorRects.data());
 
 			vkCmdSetLineWidth(drawCmdBuffers[i], 1.0f);
 
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-			scene.draw(drawCmdBuffers[i]);
+			if (broadcastPath == GeometryShader) {
+				scene.draw(drawCmdBuffers[i]);
+			}
+			else {
+				// [POI] One instance per viewport, the vertex shader writes the instance index to gl_ViewportIndex
+				// The vertices are pre-transformed and the scene uses no per-node state, so its whole index buffer can be drawn at once
+				scene.bindBuffers(drawCmdBuffers[i]);
+				vkCmdDrawIndexed(drawCmdBuffers[i], scene.indices.count, viewportCount, 0, 0, 0);
+			}
 
 			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
+			benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
@@ -149,7 +222,7 @@ public:
 	void setupDescriptorSetLayout()
 	{
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_GEOMETRY_BIT, 0)	// Binding 1: Geometry shader ubo
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT, 0)	// Binding 0: Geometry shader (or instanced vertex shader) ubo
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -187,8 +260,8 @@ public:
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
 		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
 		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
-		// We use two viewports
-		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(2, 2, 0);
+		// We use up to 16 viewports
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(maxViewportCount, maxViewportCount, 0);
 		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
 		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_LINE_WIDTH };
 		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
@@ -212,7 +285,17 @@ public:
 		// A geometry shader is used to output geometry to multiple viewports in one single pass
 		// See the "invocations" decorator of the layout input in the shader
 		shaderStages[2] = loadShader(getShadersPath() + "viewportarray/multiview.geom.spv", VK_SHADER_STAGE_GEOMETRY_BIT);
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.stereo));
+		// The grid geometry shader runs one invocation per possible viewport, invocations beyond the current viewport count return without emitting anything
+		shaderStages[2] = loadShader(getShadersPath() + "viewportarray/multiviewgrid.geom.spv", VK_SHADER_STAGE_GEOMETRY_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.grid));
+
+		// [POI] Without a geometry shader, the vertex shader transforms each instance with the matrices of its viewport and selects the viewport
+		if (instancedDrawSupported) {
+			pipelineCI.stageCount = 2;
+			shaderStages[0] = loadShader(getShadersPath() + "viewportarray/sceneinstanced.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.instanced));
+		}
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -232,6 +315,35 @@ public:
 	}
 
 	void updateUniformBuffers()
+	{
+		glm::mat4 rotM = glm::mat4(1.0f);
+		rotM = glm::rotate(rotM, glm::radians(camera.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+		rotM = glm::rotate(rotM, glm::radians(camera.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+		rotM = glm::rotate(rotM, glm::radians(camera.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+
+		uboGS.viewportCount = viewportCount;
+		if (viewportCount == 2) {
+			updateStereoMatrices(rotM);
+		}
+		else {
+			// Each viewport looks into another direction around the camera's position, the first one along the camera's view direction
+			uint32_t columns, rows;
+			getViewportGrid(columns, rows);
+			const float aspectRatio = ((float)width / (float)columns) / ((float)height / (float)rows);
+			const float wd2 = zNear * tan(glm::radians(fov / 2.0f));
+			const glm::mat4 projection = glm::frustum(-aspectRatio * wd2, aspectRatio * wd2, -wd2, wd2, zNear, zFar);
+			const glm::mat4 transM = glm::translate(glm::mat4(1.0f), camera.position);
+			for (int32_t i = 0; i < viewportCount; i++) {
+				const float angle = 360.0f / (float)viewportCount * (float)i;
+				uboGS.projection[i] = projection;
+				uboGS.modelview[i] = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f)) * rotM * transM;
+			}
+		}
+
+		memcpy(uniformBufferGS.mapped, &uboGS, sizeof(uboGS));
+	}
+
+	void updateStereoMatrices(const glm::mat4& rotM)
 	{
 		// Geometry shader matrices for the two viewports
 		// See http://paulbourke.net/stereographics/stereorender/
@@ -251,13 +363,8 @@ public:
 		camFront = glm::normalize(camFront);
 		glm::vec3 camRight = glm::normalize(glm::cross(camFront, glm::vec3(0.0f, 1.0f, 0.0f)));
 
-		glm::mat4 rotM = glm::mat4(1.0f);
 		glm::mat4 transM;
 
-		rotM = glm::rotate(rotM, glm::radians(camera.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
-		rotM = glm::rotate(rotM, glm::radians(camera.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-		rotM = glm::rotate(rotM, glm::radians(camera.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
-
 		// Left eye
 		left = -aspectRatio * wd2 + 0.5f * eyeSeparation * ndfl;
 		right = aspectRatio * wd2 + 0.5f * eyeSeparation * ndfl;
@@ -275,8 +382,6 @@ public:
 
 		uboGS.projection[1] = glm::frustum(left, right, bottom, top, zNear, zFar);
 		uboGS.modelview[1] = rotM * transM;
-
-		memcpy(uniformBufferGS.mapped, &uboGS, sizeof(uboGS));
 	}
 
 	void draw()
@@ -284,13 +389,15 @@ public:
 		VulkanExampleBase::prepareFrame();
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
 	}
 
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		maxViewportCount = std::min(vulkanDevice->properties.limits.maxViewports, static_cast<uint32_t>(MAX_VIEWPORTS));
+		viewportCount = std::min(viewportCount, static_cast<int32_t>(maxViewportCount));
 		loadAssets();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
@@ -316,8 +423,24 @@ public:
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
-			if (overlay->sliderFloat("Eye separation", &eyeSeparation, -1.0f, 1.0f)) {
+			if (instancedDrawSupported) {
+				if (overlay->comboBox("Broadcast", &broadcastPath, { "Geometry shader", "Instanced draw" })) {
+					buildCommandBuffers();
+				}
+			}
+			if (overlay->sliderInt("Viewports", &viewportCount, 2, static_cast<int32_t>(maxViewportCount))) {
 				updateUniformBuffers();
+				buildCommandBuffers();
+			}
+			if (viewportCount == 2) {
+				if (overlay->sliderFloat("Eye separation", &eyeSeparation, -1.0f, 1.0f)) {
+					updateUniformBuffers();
+				}
+			}
+		}
+		if (overlay->header("GPU times")) {
+			for (auto& result : benchmark.gpuProfiler.results) {
+				overlay->text("%s: %.3f ms", result.first.c_str(), result.second);
 			}
 		}
 	}
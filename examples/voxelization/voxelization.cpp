@@ -0,0 +1,316 @@
+/*
+* Vulkan Example - Scene voxelization with conservative rasterization
+*
+* Voxelizes the scene into a clipmap of 3D textures centered on the camera (see vks::Voxelizer), using conservative rasterization if
+* VK_EXT_conservative_rasterization is supported so thin geometry doesn't leave holes in the voxels. The scene is then shaded with ambient
+* occlusion and soft shadows traced through the voxels, each sample being a single texture fetch instead of a test against the triangles,
+* and the voxels themselves can be displayed by ray marching the clipmap
+*
+* Levels are voxelized incrementally by default: only levels whose origin moved with the camera and one further level per frame are updated
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+#include "VulkanVoxelizer.h"
+
+#define ENABLE_VALIDATION false
+
+// Voxels per axis of a clipmap level, the finest level covers VOXEL_EXTENT world units
+#define VOXEL_RESOLUTION 64
+#define VOXEL_LEVELS 4
+#define VOXEL_EXTENT 4.0f
+
+class VulkanExample : public VulkanExampleBase
+{
+public:
+	vkglTF::Model scene;
+	std::unique_ptr<vks::Voxelizer> voxelizer;
+	bool conservativeRasterizationSupported = false;
+
+	// 0 = shaded, 1 = ambient occlusion only, 2 = voxels
+	int32_t displayMode = 0;
+	bool incrementalUpdates = true;
+	bool voxelShadows = true;
+
+	struct UniformData {
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::mat4 inverseViewProjection;
+		glm::vec4 cameraPos;
+		// Direction the light travels in, the scene is flipped so +y points down
+		glm::vec4 lightDir = glm::vec4(glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f)), 0.0f);
+		vks::Voxelizer::ShaderData voxels;
+		float aoStrength = 1.0f;
+		int32_t displayMode = 0;
+		int32_t shadows = 1;
+	} uniformData;
+	vks::Buffer uniformBuffer;
+
+	struct {
+		VkPipeline scene = VK_NULL_HANDLE;
+		VkPipeline voxels = VK_NULL_HANDLE;
+	} pipelines;
+
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
+	{
+		title = "Voxelization";
+		supportsFramesInFlight = true;
+		camera.type = Camera::CameraType::firstperson;
+#ifndef __ANDROID__
+		camera.rotationSpeed = 0.25f;
+#endif
+		camera.position = { 1.0f, 0.75f, 0.0f };
+		camera.setRotation(glm::vec3(0.0f, 90.0f, 0.0f));
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 64.0f);
+		// Required by VK_EXT_conservative_rasterization
+		enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	}
+
+	~VulkanExample()
+	{
+		if (device) {
+			vkDestroyPipeline(device, pipelines.scene, nullptr);
+			vkDestroyPipeline(device, pipelines.voxels, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+			uniformBuffer.destroy();
+			voxelizer.reset();
+		}
+	}
+
+	virtual void getEnabledFeatures()
+	{
+		// The voxelization projects triangles in a geometry shader and writes the voxels with image stores from the fragment shader
+		if (!deviceFeatures.geometryShader) {
+			vks::tools::exitFatal("Selected GPU does not support geometry shaders!", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
+		if (!deviceFeatures.fragmentStoresAndAtomics) {
+			vks::tools::exitFatal("Selected GPU does not support stores and atomic operations in the fragment stage", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
+		enabledFeatures.geometryShader = VK_TRUE;
+		enabledFeatures.fragmentStoresAndAtomics = VK_TRUE;
+	}
+
+	virtual void getEnabledExtensions()
+	{
+		// Optional, without it thin triangles can leave holes in the voxels
+		conservativeRasterizationSupported = vulkanDevice->extensionSupported(VK_EXT_CONSERVATIVE_RASTERIZATION_EXTENSION_NAME);
+		if (conservativeRasterizationSupported) {
+			enabledDeviceExtensions.push_back(VK_EXT_CONSERVATIVE_RASTERIZATION_EXTENSION_NAME);
+		}
+	}
+
+	void buildCommandBuffer()
+	{
+		VkCommandBuffer commandBuffer = drawCmdBuffers[currentBuffer];
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+		// Voxelize the levels that need an update, the scene's vertices are already in world space
+		const glm::vec3 cameraPosition = glm::vec3(uniformData.cameraPos);
+		voxelizer->record(commandBuffer, cameraPosition, [this](VkCommandBuffer commandBuffer) {
+			scene.bindBuffers(commandBuffer);
+			scene.draw(commandBuffer);
+		});
+		updateUniformBuffers();
+
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.5f, 0.6f, 0.7f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[currentBuffer];
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		if (displayMode == 2) {
+			// Voxels ray marched in a fullscreen pass
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.voxels);
+			vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+		} else {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.scene);
+			scene.bindBuffers(commandBuffer);
+			scene.draw(commandBuffer);
+		}
+
+		drawUI(commandBuffer);
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	void loadAssets()
+	{
+		// Vertices are pre-transformed to world space, as the voxelizer doesn't apply node transforms
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
+		scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, glTFLoadingFlags);
+	}
+
+	void prepareVoxelizer()
+	{
+		voxelizer.reset(new vks::Voxelizer(vulkanDevice, pipelineCache, getShadersPath() + "base/voxelize", VOXEL_RESOLUTION, VOXEL_LEVELS, VOXEL_EXTENT, conservativeRasterizationSupported));
+		if (!voxelizer->isSupported()) {
+			vks::tools::exitFatal("Could not create the voxelization pipeline, the voxel format isn't supported as a storage image or the shaders are missing", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
+		voxelizer->setUpdateMode(incrementalUpdates ? vks::Voxelizer::UpdateMode::Incremental : vks::Voxelizer::UpdateMode::EveryFrame);
+	}
+
+	void setupDescriptors()
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0 : Scene and voxel clipmap parameters
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+			// Binding 1 : Voxel clipmap
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		VkDescriptorImageInfo voxelDescriptor = voxelizer->getDescriptor();
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &voxelDescriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void preparePipelines()
+	{
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
+		pipelineCI.pInputAssemblyState = &inputAssemblyState;
+		pipelineCI.pRasterizationState = &rasterizationState;
+		pipelineCI.pColorBlendState = &colorBlendState;
+		pipelineCI.pMultisampleState = &multisampleState;
+		pipelineCI.pViewportState = &viewportState;
+		pipelineCI.pDepthStencilState = &depthStencilState;
+		pipelineCI.pDynamicState = &dynamicState;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+
+		// Scene shaded with occlusion traced through the voxels
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Color });
+		shaderStages[0] = loadShader(getShadersPath() + "voxelization/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "voxelization/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.scene));
+
+		// Fullscreen ray march of the voxels, writes the depth of the hit voxels
+		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+		pipelineCI.pVertexInputState = &emptyInputState;
+		rasterizationState.cullMode = VK_CULL_MODE_NONE;
+		shaderStages[0] = loadShader(getShadersPath() + "voxelization/voxelview.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "voxelization/voxelview.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.voxels));
+	}
+
+	void prepareUniformBuffers()
+	{
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uniformBuffer, sizeof(UniformData)));
+		VK_CHECK_RESULT(uniformBuffer.map());
+		updateUniformBuffers();
+	}
+
+	// The voxel clipmap origins change with the voxelization, so the uniform buffer is updated after record() every frame
+	void updateUniformBuffers()
+	{
+		uniformData.projection = camera.matrices.perspective;
+		uniformData.view = camera.matrices.view;
+		uniformData.inverseViewProjection = glm::inverse(camera.matrices.perspective * camera.matrices.view);
+		uniformData.cameraPos = glm::vec4(glm::vec3(glm::inverse(camera.matrices.view)[3]), 1.0f);
+		uniformData.voxels = voxelizer->getShaderData();
+		uniformData.displayMode = displayMode;
+		uniformData.shadows = voxelShadows ? 1 : 0;
+		memcpy(uniformBuffer.mapped, &uniformData, sizeof(UniformData));
+	}
+
+	void prepare()
+	{
+		VulkanExampleBase::prepare();
+		loadAssets();
+		prepareVoxelizer();
+		prepareUniformBuffers();
+		setupDescriptors();
+		preparePipelines();
+		prepared = true;
+	}
+
+	void draw()
+	{
+		VulkanExampleBase::prepareFrame();
+		// The camera position of this frame centers the voxelization recorded into the command buffer
+		uniformData.cameraPos = glm::vec4(glm::vec3(glm::inverse(camera.matrices.view)[3]), 1.0f);
+		buildCommandBuffer();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
+		VulkanExampleBase::submitFrame();
+	}
+
+	virtual void render()
+	{
+		if (!prepared)
+			return;
+		draw();
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			overlay->comboBox("Display", &displayMode, { "Shaded", "Ambient occlusion", "Voxels" });
+			overlay->sliderFloat("Occlusion strength", &uniformData.aoStrength, 0.0f, 2.0f);
+			overlay->checkBox("Voxel shadows", &voxelShadows);
+			if (overlay->checkBox("Incremental updates", &incrementalUpdates)) {
+				voxelizer->setUpdateMode(incrementalUpdates ? vks::Voxelizer::UpdateMode::Incremental : vks::Voxelizer::UpdateMode::EveryFrame);
+			}
+		}
+		if (overlay->header("Voxels")) {
+			const vks::Voxelizer::Statistics &statistics = voxelizer->getStatistics();
+			overlay->text("Conservative rasterization: %s", voxelizer->isConservative() ? "yes" : "no");
+			overlay->text("Clipmap: %d levels of %d^3 voxels", voxelizer->getLevelCount(), voxelizer->getResolution());
+			overlay->text("Memory: %.1f MiB", static_cast<float>(statistics.memorySize) / (1024.0f * 1024.0f));
+			overlay->text("Levels voxelized last frame: %d", statistics.updatedLevels);
+		}
+	}
+};
+
+VULKAN_EXAMPLE_MAIN()
@@ -12,6 +12,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanGeometryPool.h"
 
 #define ENABLE_VALIDATION false
 
@@ -24,6 +25,8 @@ public:
 		VkPipeline *pipeline;
 	};
 	std::vector<DemoModel> demoModels;
+	// All models share the vertex and index buffers of the pool, so they are bound once per command buffer
+	std::unique_ptr<vks::GeometryPool> geometryPool;
 
 	struct {
 		vks::Buffer meshVS;
@@ -87,6 +90,8 @@ public:
 	void loadAssets()
 	{
 		// Models
+		geometryPool.reset(new vks::GeometryPool(vulkanDevice, 16 * 1024 * 1024, 4 * 1024 * 1024));
+		vkglTF::geometryPool = geometryPool.get();
 		std::vector<std::string> modelFiles = { "vulkanscenelogos.gltf", "vulkanscenebackground.gltf", "vulkanscenemodels.gltf", "cube.gltf" };
 		std::vector<VkPipeline*> modelPipelines = { &pipelines.logos, &pipelines.models, &pipelines.models, &pipelines.skybox };
 		for (auto i = 0; i < modelFiles.size(); i++) {
@@ -97,6 +102,7 @@ public:
 			model.glTF->loadFromFile(getAssetPath() + "models/" + modelFiles[i], vulkanDevice, queue, glTFLoadingFlags);
 			demoModels.push_back(model);
 		}
+		vkglTF::geometryPool = nullptr;
 		// Textures
 		textures.skybox.loadFromFile(getAssetPath() + "textures/cubemap_vulkan.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
 	}
@@ -134,6 +140,8 @@ public:
 
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
 
+			// Models that didn't fit into the pool bind their own buffers in draw()
+			geometryPool->bind(drawCmdBuffers[i]);
 			for (auto model : demoModels) {
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, *model.pipeline);
 				model.glTF->draw(drawCmdBuffers[i]);
@@ -301,7 +309,7 @@ public:
 		VulkanExampleBase::prepareFrame();
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		VulkanExampleBase::submitFrame();
 	}
 
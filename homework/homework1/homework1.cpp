@@ -26,6 +26,10 @@
 #include "tiny_gltf.h"
 
 #include "vulkanexamplebase.h"
+#include "VulkanPipelineBatch.hpp"
+#include "VulkanPostProcess.h"
+#include "VulkanMappedFile.hpp"
+#include <memory>
 
 #define ENABLE_VALIDATION true
 
@@ -74,11 +78,6 @@ public:
 	// ڵģѡϢҿĻԪ
 	struct Mesh {
 		std::vector<Primitive> primitives;
-		struct UniformBuffer {
-			vks::Buffer buffer;
-			VkDescriptorSet descriptorSet;
-			void* mapped;
-		} uniformBuffer;
 	};
 
 	// A node represents an object in the glTF scene graph
@@ -94,6 +93,13 @@ public:
 		glm::vec3           translation{};
 		glm::vec3           scale{ 1.0f };
 		glm::quat           rotation{};
+
+		// Range of the node's matrix in each frame region of the node transform buffer (see NodeTransforms)
+		uint32_t            transformSlot = 0;
+		// World matrix last written to the transform buffer
+		glm::mat4           transform{ 1.0f };
+		// Frame regions that don't hold the current world matrix yet, one bit per region
+		uint32_t            dirtyFrames = 0;
 		
 		glm::mat4 getLocalMatrix()
 		{
@@ -140,16 +146,45 @@ public:
 	// Elysia
 	struct AnimationSampler
 	{
-		std::string interpolation;
+		enum InterpolationType { LINEAR, STEP, CUBICSPLINE };
+		InterpolationType interpolation;
 		std::vector<float> inputs;
 		std::vector<glm::vec4> outputsVec4;
+
+		// Finds the key starting the interval that contains the time, starting at the key of the previous lookup and falling back to a binary search
+		bool findKey(float time, uint32_t& key) const
+		{
+			if ((inputs.size() < 2) || (time < inputs.front()) || (time > inputs.back()))
+			{
+				return false;
+			}
+			const uint32_t lastKey = static_cast<uint32_t>(inputs.size()) - 2;
+			if (key <= lastKey)
+			{
+				if ((time >= inputs[key]) && (time <= inputs[key + 1]))
+				{
+					return true;
+				}
+				if ((key < lastKey) && (time >= inputs[key + 1]) && (time <= inputs[key + 2]))
+				{
+					key++;
+					return true;
+				}
+			}
+			const size_t upper = std::upper_bound(inputs.begin(), inputs.end(), time) - inputs.begin();
+			key = static_cast<uint32_t>(std::min(upper, inputs.size() - 1) - 1);
+			return true;
+		}
 	};
 
 	struct AnimationChannel
 	{
-		std::string path;
+		enum PathType { TRANSLATION, ROTATION, SCALE };
+		PathType path;
 		Node* node;
 		uint32_t    samplerIndex;
+		// Key found by the last lookup
+		uint32_t    key = 0;
 	};
 
 	struct Animation
@@ -174,6 +209,18 @@ public:
 	std::vector<Node*> linearMeshNodes;
 	uint32_t activeAnimation = 0;
 
+	// World matrices of all mesh nodes in one persistently mapped uniform buffer, bound once with a dynamic offset per node
+	// The buffer has one region per swap chain image, so matrices of a frame can be written while the GPU still reads the previous ones
+	struct NodeTransforms {
+		vks::Buffer buffer;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		// Size of one matrix, aligned for dynamic uniform buffer offsets and non-coherent memory flushes
+		VkDeviceSize stride = 0;
+		// Size of one region holding the matrices of all mesh nodes
+		VkDeviceSize frameSize = 0;
+		uint32_t frameCount = 0;
+	} nodeTransforms;
+
 	//
 	~VulkanglTFModel()
 	{
@@ -185,6 +232,7 @@ public:
 		vkFreeMemory(vulkanDevice->logicalDevice, vertices.memory, nullptr);
 		vkDestroyBuffer(vulkanDevice->logicalDevice, indices.buffer, nullptr);
 		vkFreeMemory(vulkanDevice->logicalDevice, indices.memory, nullptr);
+		nodeTransforms.buffer.destroy();
 		for (Image image : images) {
 			vkDestroyImageView(vulkanDevice->logicalDevice, image.texture.view, nullptr);
 			vkDestroyImage(vulkanDevice->logicalDevice, image.texture.image, nullptr);
@@ -210,38 +258,20 @@ public:
 			tinygltf::Image& glTFImage = input.images[i];
 			// Get the image data from the glTF loader
 			//glTFȡͼ
-			unsigned char* buffer = nullptr;
-			VkDeviceSize bufferSize = 0;
-			bool deleteBuffer = false;
 			// We convert RGB-only images to RGBA, as most devices don't support RGB-formats in Vulkan
 			//ǽRGBͨͼתΪRGBAʽΪ豸Vulkanв֧RGBʽ
 			
 			//glTFImage.componentֵΪ3ʾͼͨΪRGBû͸ͨ
 			if (glTFImage.component == 3) 
 			{
-				//»ĴСbufferSizeȳԸ߶ȳ4
-				bufferSize = glTFImage.width * glTFImage.height * 4;
-				//µĻbufferͨÿؽRGBֵƵ»ĶӦλãͬʱÿغĬϵ͸ֵͨ
-				buffer = new unsigned char[bufferSize];
-				unsigned char* rgba = buffer;
-				unsigned char* rgb = &glTFImage.image[0];
-				for (size_t i = 0; i < glTFImage.width * glTFImage.height; ++i) {
-					memcpy(rgba, rgb, sizeof(unsigned char) * 3);
-					rgba += 4;
-					rgb += 3;
-				}
-				//deleteBuffer־ΪtrueʾڲҪʱɾ
-				deleteBuffer = true;
+				// RGB pixels are expanded to RGBA with opaque alpha directly in the staging memory, without a temporary buffer
+				//RGBֱݴڴչΪ͸RGBAأҪʱ
+				images[i].texture.fromRGBBuffer(&glTFImage.image[0], glTFImage.width, glTFImage.height, vulkanDevice, copyQueue);
 			}
 			else {
-				buffer = &glTFImage.image[0];
-				bufferSize = glTFImage.image.size();
-			}
-			// Load texture from image buffer
-			// ͼ񻺳ͼƬ
-			images[i].texture.fromBuffer(buffer, bufferSize, VK_FORMAT_R8G8B8A8_UNORM, glTFImage.width, glTFImage.height, vulkanDevice, copyQueue);
-			if (deleteBuffer) {
-				delete[] buffer;
+				// Load texture from image buffer
+				// ͼ񻺳ͼƬ
+				images[i].texture.fromBuffer(&glTFImage.image[0], glTFImage.image.size(), VK_FORMAT_R8G8B8A8_UNORM, glTFImage.width, glTFImage.height, vulkanDevice, copyQueue);
 			}
 		}
 	}
@@ -433,37 +463,82 @@ public:
 		}
 	}
 
-	//Elysia
-	void prepareMeshUniformBuffers(vks::VulkanDevice* vkDevice)
+	// Creates the node transform buffer with one region per frame and writes the initial matrices of all mesh nodes into every region
+	void prepareNodeTransforms(vks::VulkanDevice* vkDevice, uint32_t frameCount)
 	{
+		assert((frameCount > 0) && (frameCount <= 32));
+		const VkPhysicalDeviceLimits& limits = vkDevice->properties.limits;
+		const VkDeviceSize alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.nonCoherentAtomSize);
+		nodeTransforms.stride = (sizeof(glm::mat4) + alignment - 1) / alignment * alignment;
+		nodeTransforms.frameSize = nodeTransforms.stride * std::max(linearMeshNodes.size(), static_cast<size_t>(1));
+		nodeTransforms.frameCount = frameCount;
+		// Host coherency isn't required, updateNodeTransforms flushes the ranges it writes
+		VK_CHECK_RESULT(vkDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			&nodeTransforms.buffer,
+			nodeTransforms.frameSize * frameCount));
+		VK_CHECK_RESULT(nodeTransforms.buffer.map());
+		// Shaders see a single matrix at the dynamic offset of the node
+		nodeTransforms.buffer.setupDescriptor(sizeof(glm::mat4));
+		for (size_t i = 0; i < linearMeshNodes.size(); i++)
+		{
+			Node* meshNode = linearMeshNodes[i];
+			meshNode->transformSlot = static_cast<uint32_t>(i);
+			meshNode->transform = getNodeMatrix(meshNode);
+			for (uint32_t frame = 0; frame < frameCount; frame++)
+			{
+				memcpy(static_cast<char*>(nodeTransforms.buffer.mapped) + nodeTransforms.frameSize * frame + nodeTransforms.stride * i, &meshNode->transform, sizeof(glm::mat4));
+			}
+		}
+		nodeTransforms.buffer.flush();
+	}
 
+	// Marks the mesh nodes whose world matrix changed as dirty in all frame regions
+	void updateNodeMatrices()
+	{
+		const uint32_t allFrames = (nodeTransforms.frameCount < 32) ? ((1u << nodeTransforms.frameCount) - 1) : UINT32_MAX;
 		for (auto& meshNode : linearMeshNodes)
 		{
-			if (!meshNode->mesh.primitives.empty())
+			const glm::mat4 nodeMatrix = getNodeMatrix(meshNode);
+			if (nodeMatrix != meshNode->transform)
 			{
-				// Vertex shader uniform buffer block for Descriptor set 2
-				VK_CHECK_RESULT(vkDevice->createBuffer(
-					VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-					&meshNode->mesh.uniformBuffer.buffer,
-					sizeof(glm::mat4)));
-
-				// Map persistent
-				VK_CHECK_RESULT(meshNode->mesh.uniformBuffer.buffer.map());
+				meshNode->transform = nodeMatrix;
+				meshNode->dirtyFrames = allFrames;
 			}
 		}
 	}
 
-	//Elysia
-	void updateMeshUniformBuffers()
+	// Writes the matrices that are dirty in the given frame's region and marks the written ranges for the next batched flush, neighbouring slots are marked together
+	// Must only be called once the GPU is done with the frame's previous submission
+	void updateNodeTransforms(uint32_t frame)
 	{
+		const uint32_t frameBit = 1u << frame;
+		const VkDeviceSize frameOffset = nodeTransforms.frameSize * frame;
+		VkDeviceSize rangeStart = 0;
+		VkDeviceSize rangeEnd = 0;
 		for (auto& meshNode : linearMeshNodes)
 		{
-			if (!meshNode->mesh.primitives.empty() && meshNode->mesh.uniformBuffer.buffer.mapped)
+			if ((meshNode->dirtyFrames & frameBit) == 0)
 			{
-				glm::mat4 nodeMatrix = getNodeMatrix(meshNode);
-				memcpy(meshNode->mesh.uniformBuffer.buffer.mapped, static_cast<const void*>(&nodeMatrix), sizeof(glm::mat4));
+				continue;
 			}
+			meshNode->dirtyFrames &= ~frameBit;
+			const VkDeviceSize offset = frameOffset + nodeTransforms.stride * meshNode->transformSlot;
+			memcpy(static_cast<char*>(nodeTransforms.buffer.mapped) + offset, &meshNode->transform, sizeof(glm::mat4));
+			if (offset != rangeEnd)
+			{
+				if (rangeEnd > rangeStart)
+				{
+					nodeTransforms.buffer.markDirty(rangeEnd - rangeStart, rangeStart);
+				}
+				rangeStart = offset;
+			}
+			rangeEnd = offset + nodeTransforms.stride;
+		}
+		if (rangeEnd > rangeStart)
+		{
+			nodeTransforms.buffer.markDirty(rangeEnd - rangeStart, rangeStart);
 		}
 	}
 	
@@ -517,7 +592,16 @@ public:
 			{
 				tinygltf::AnimationSampler glTFSampler = glTFAnimation.samplers[j];
 				AnimationSampler& dstSampler = animations[i].samplers[j];
-				dstSampler.interpolation = glTFSampler.interpolation;
+				dstSampler.interpolation = AnimationSampler::LINEAR;
+				if (glTFSampler.interpolation == "STEP")
+				{
+					dstSampler.interpolation = AnimationSampler::STEP;
+				}
+				if (glTFSampler.interpolation == "CUBICSPLINE")
+				{
+					dstSampler.interpolation = AnimationSampler::CUBICSPLINE;
+					std::cout << "This sample only supports linear and step interpolations, skipping cubic spline sampler\n";
+				}
 
 				// Read sampler keyframe input time values
 				{
@@ -577,14 +661,34 @@ public:
 			}
 
 			// Channels
-			animations[i].channels.resize(glTFAnimation.channels.size());
 			for (size_t j = 0; j < glTFAnimation.channels.size(); j++)
 			{
 				tinygltf::AnimationChannel glTFChannel = glTFAnimation.channels[j];
-				AnimationChannel& dstChannel = animations[i].channels[j];
-				dstChannel.path = glTFChannel.target_path;
+				AnimationChannel dstChannel;
+				if (glTFChannel.target_path == "translation")
+				{
+					dstChannel.path = AnimationChannel::TRANSLATION;
+				}
+				else if (glTFChannel.target_path == "rotation")
+				{
+					dstChannel.path = AnimationChannel::ROTATION;
+				}
+				else if (glTFChannel.target_path == "scale")
+				{
+					dstChannel.path = AnimationChannel::SCALE;
+				}
+				else
+				{
+					// Morph target weights aren't supported
+					continue;
+				}
 				dstChannel.samplerIndex = glTFChannel.sampler;
 				dstChannel.node = nodeFromIndex(glTFChannel.target_node);
+				if (!dstChannel.node || (animations[i].samplers[dstChannel.samplerIndex].interpolation == AnimationSampler::CUBICSPLINE))
+				{
+					continue;
+				}
+				animations[i].channels.push_back(dstChannel);
 			}
 		}
 	}
@@ -594,9 +698,11 @@ public:
 	*/
 
 	// Draw a single node including child nodes (if present)
-	void drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node* node)
+	void drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFModel::Node* node, uint32_t frame)
 	{
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1, &node->mesh.uniformBuffer.descriptorSet, 0, nullptr);
+		// The node's matrix is selected with the dynamic offset into the frame's region of the transform buffer
+		const uint32_t dynamicOffset = static_cast<uint32_t>(nodeTransforms.frameSize * frame + nodeTransforms.stride * node->transformSlot);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1, &nodeTransforms.descriptorSet, 1, &dynamicOffset);
 
 		if (!node->mesh.primitives.empty()) {
 			//// Pass the node's matrix via push constants
@@ -617,7 +723,7 @@ public:
 	}
 
 	// Draw the glTF scene starting at the top-level-nodes
-	void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout)
+	void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t frame)
 	{
 		// All vertices and indices are stored in single buffers, so we only need to bind once
 		VkDeviceSize offsets[1] = { 0 };
@@ -625,7 +731,7 @@ public:
 		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 		// Render all nodes at top-level
 		for (auto& node : linearMeshNodes) {
-			drawNode(commandBuffer, pipelineLayout, node);
+			drawNode(commandBuffer, pipelineLayout, node, frame);
 		}
 	}
 	//Elysia
@@ -659,46 +765,46 @@ public:
 			for (auto& channel : animation.channels)
 			{
 				AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
-				for (size_t i = 0; i < sampler.inputs.size() - 1; i++)
+				// Get the input keyframe values for the current time stamp
+				if (!sampler.findKey(animation.currentTime, channel.key))
 				{
-					if (sampler.interpolation != "LINEAR")
-					{
-						std::cout << "This sample only supports linear interpolations\n";
-						continue;
-					}
-
-					// Get the input keyframe values for the current time stamp
-					if ((animation.currentTime >= sampler.inputs[i]) && (animation.currentTime <= sampler.inputs[i + 1]))
-					{
-						float a = (animation.currentTime - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-						if (channel.path == "translation")
-						{
-							channel.node->translation = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], a);
-						}
-						if (channel.path == "rotation")
-						{
-							glm::quat q1;
-							q1.x = sampler.outputsVec4[i].x;
-							q1.y = sampler.outputsVec4[i].y;
-							q1.z = sampler.outputsVec4[i].z;
-							q1.w = sampler.outputsVec4[i].w;
-
-							glm::quat q2;
-							q2.x = sampler.outputsVec4[i + 1].x;
-							q2.y = sampler.outputsVec4[i + 1].y;
-							q2.z = sampler.outputsVec4[i + 1].z;
-							q2.w = sampler.outputsVec4[i + 1].w;
-
-							channel.node->rotation = glm::normalize(glm::slerp(q1, q2, a));
-						}
-						if (channel.path == "scale")
-						{
-							channel.node->scale = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], a);
-						}
-					}
+					continue;
+				}
+				const uint32_t i = channel.key;
+				const float interval = sampler.inputs[i + 1] - sampler.inputs[i];
+				float a = 0.0f;
+				if ((sampler.interpolation == AnimationSampler::LINEAR) && (interval > 0.0f))
+				{
+					a = (animation.currentTime - sampler.inputs[i]) / interval;
+				}
+				switch (channel.path)
+				{
+				case AnimationChannel::TRANSLATION:
+					channel.node->translation = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], a);
+					break;
+				case AnimationChannel::ROTATION:
+				{
+					glm::quat q1;
+					q1.x = sampler.outputsVec4[i].x;
+					q1.y = sampler.outputsVec4[i].y;
+					q1.z = sampler.outputsVec4[i].z;
+					q1.w = sampler.outputsVec4[i].w;
+
+					glm::quat q2;
+					q2.x = sampler.outputsVec4[i + 1].x;
+					q2.y = sampler.outputsVec4[i + 1].y;
+					q2.z = sampler.outputsVec4[i + 1].z;
+					q2.w = sampler.outputsVec4[i + 1].w;
+
+					channel.node->rotation = glm::normalize(glm::slerp(q1, q2, a));
+					break;
+				}
+				case AnimationChannel::SCALE:
+					channel.node->scale = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], a);
+					break;
 				}
 			}
-			updateMeshUniformBuffers();
+			updateNodeMatrices();
 		}
 };
 
@@ -709,6 +815,28 @@ public:
 	bool test1 = false;
 
 	VulkanglTFModel glTFModel;
+
+	// The scene is rendered into a linear color target, which the post processing stack tone maps into the swapchain image
+	struct FrameBufferAttachment {
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory mem = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+	};
+	struct OffscreenPass {
+		FrameBufferAttachment color, depth;
+		VkFramebuffer frameBuffer = VK_NULL_HANDLE;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		const VkFormat colorFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+	} offscreenPass;
+
+	std::unique_ptr<vks::PostProcessStack> postProcess;
+	// Effects that can be toggled in the UI, exposure is always applied
+	bool tonemapping = true;
+	bool colorGrading = true;
+	bool vignette = true;
+	bool dithering = true;
+	int32_t effectOrderPreset = 0;
+	const std::vector<std::string> effectOrderPresetNames = { "Grade after tone mapping", "Vignette before tone mapping" };
 	
 	struct ShaderData {
 		vks::Buffer buffer;
@@ -721,7 +849,7 @@ public:
 	} shaderData;
 
 	struct Pipelines {
-		VkPipeline solid;
+		VkPipeline solid = VK_NULL_HANDLE;
 		VkPipeline wireframe = VK_NULL_HANDLE;
 	} pipelines;
 
@@ -740,6 +868,7 @@ public:
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "homework1";
+		supportsFramesInFlight = true;
 		camera.type = Camera::CameraType::lookat;
 		camera.flipY = true;
 		camera.setPosition(glm::vec3(0.0f, -0.1f, -1.0f));
@@ -761,6 +890,11 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.matrices, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.textures, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.nodes, nullptr);
+
+		postProcess.reset();
+		destroyOffscreenTargets();
+		vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
 
 		shaderData.buffer.destroy();
 	}
@@ -773,15 +907,177 @@ public:
 		};
 	}
 
+	void createAttachment(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectMask, FrameBufferAttachment *attachment)
+	{
+		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+		image.imageType = VK_IMAGE_TYPE_2D;
+		image.format = format;
+		image.extent = { width, height, 1 };
+		image.mipLevels = 1;
+		image.arrayLayers = 1;
+		image.samples = VK_SAMPLE_COUNT_1_BIT;
+		image.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image.usage = usage;
+		VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment->image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->mem, 0));
+
+		VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
+		imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageView.format = format;
+		imageView.subresourceRange = { aspectMask, 0, 1, 0, 1 };
+		imageView.image = attachment->image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &attachment->view));
+	}
+
+	// The render pass doesn't depend on the window size, so the scene pipelines are kept on resize
+	void prepareOffscreenRenderPass()
+	{
+		std::array<VkAttachmentDescription, 2> attachments = {};
+		attachments[0].format = offscreenPass.colorFormat;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		// Depth is only needed while rendering the scene
+		attachments[1].format = depthFormat;
+		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpassDescription = {};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = 1;
+		subpassDescription.pColorAttachments = &colorReference;
+		subpassDescription.pDepthStencilAttachment = &depthReference;
+
+		// The previous frame's post processing reads the color target before it's cleared, and this frame's post processing reads it after it's written
+		std::array<VkSubpassDependency, 2> dependencies;
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+		renderPassCI.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassCI.pAttachments = attachments.data();
+		renderPassCI.subpassCount = 1;
+		renderPassCI.pSubpasses = &subpassDescription;
+		renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassCI.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &offscreenPass.renderPass));
+	}
+
+	void prepareOffscreenTargets()
+	{
+		createAttachment(offscreenPass.colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT, &offscreenPass.color);
+		VkImageAspectFlags depthAspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (vks::tools::formatHasStencil(depthFormat)) {
+			depthAspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		createAttachment(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthAspectMask, &offscreenPass.depth);
+
+		VkImageView attachments[2] = { offscreenPass.color.view, offscreenPass.depth.view };
+		VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+		framebufferCI.renderPass = offscreenPass.renderPass;
+		framebufferCI.attachmentCount = 2;
+		framebufferCI.pAttachments = attachments;
+		framebufferCI.width = width;
+		framebufferCI.height = height;
+		framebufferCI.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &offscreenPass.frameBuffer));
+	}
+
+	void destroyOffscreenTargets()
+	{
+		vkDestroyFramebuffer(device, offscreenPass.frameBuffer, nullptr);
+		for (FrameBufferAttachment* attachment : { &offscreenPass.color, &offscreenPass.depth }) {
+			vkDestroyImageView(device, attachment->view, nullptr);
+			vkDestroyImage(device, attachment->image, nullptr);
+			vkFreeMemory(device, attachment->mem, nullptr);
+			*attachment = FrameBufferAttachment();
+		}
+		offscreenPass.frameBuffer = VK_NULL_HANDLE;
+	}
+
+	virtual void windowResized()
+	{
+		vkDeviceWaitIdle(device);
+		destroyOffscreenTargets();
+		prepareOffscreenTargets();
+		postProcess->setInput(offscreenPass.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		buildCommandBuffers();
+	}
+
+	// Tone mapping, color grading, vignette and dithering run as a single pass writing the swapchain image instead of one pass per effect
+	void preparePostProcessing()
+	{
+		postProcess.reset(new vks::PostProcessStack(vulkanDevice, queue, renderPass, pipelineCache, getShadersPath() + "base/postprocess.vert.spv", getShadersPath() + "base/postprocess.frag.spv"));
+		postProcess->setInput(offscreenPass.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		updateEffectOrder();
+	}
+
+	// The effect order is part of the stack's uniform buffer, so changing it doesn't require new command buffers
+	void updateEffectOrder()
+	{
+		typedef vks::PostProcessStack Stack;
+		const std::vector<Stack::Effect> presetOrder = (effectOrderPreset == 0) ?
+			std::vector<Stack::Effect>{ Stack::Exposure, Stack::Tonemap, Stack::ColorGrading, Stack::Vignette, Stack::Dither } :
+			std::vector<Stack::Effect>{ Stack::Exposure, Stack::Vignette, Stack::Tonemap, Stack::ColorGrading, Stack::Dither };
+		std::vector<Stack::Effect> effects;
+		for (Stack::Effect effect : presetOrder) {
+			if ((effect == Stack::Tonemap && !tonemapping) || (effect == Stack::ColorGrading && !colorGrading) || (effect == Stack::Vignette && !vignette) || (effect == Stack::Dither && !dithering)) {
+				continue;
+			}
+			effects.push_back(effect);
+		}
+		postProcess->setEffectOrder(effects);
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VkClearValue clearValues[2];
-		clearValues[0].color = defaultClearColor;
-		clearValues[0].color = { { 0.25f, 0.25f, 0.25f, 1.0f } };;
+		clearValues[0].color = { { 0.25f, 0.25f, 0.25f, 1.0f } };
 		clearValues[1].depthStencil = { 1.0f, 0 };
 
+		// The scene is rendered into the offscreen color target
+		VkRenderPassBeginInfo offscreenPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		offscreenPassBeginInfo.renderPass = offscreenPass.renderPass;
+		offscreenPassBeginInfo.framebuffer = offscreenPass.frameBuffer;
+		offscreenPassBeginInfo.renderArea.extent.width = width;
+		offscreenPassBeginInfo.renderArea.extent.height = height;
+		offscreenPassBeginInfo.clearValueCount = 2;
+		offscreenPassBeginInfo.pClearValues = clearValues;
+
+		// The post processing pass overwrites every pixel of the swapchain image before the UI is drawn on top
 		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
 		renderPassBeginInfo.renderPass = renderPass;
 		renderPassBeginInfo.renderArea.offset.x = 0;
@@ -798,17 +1094,34 @@ public:
 		{
 			renderPassBeginInfo.framebuffer = frameBuffers[i];
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			benchmark.gpuProfiler.reset(drawCmdBuffers[i], i);
+			benchmark.gpuProfiler.beginStatistics(drawCmdBuffers[i], i);
+
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &offscreenPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 			// Bind scene matrices descriptor to set 0
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.solid);
 			
-			glTFModel.draw(drawCmdBuffers[i], pipelineLayout);
+			benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, "scene");
+			glTFModel.draw(drawCmdBuffers[i], pipelineLayout, i);
+			benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
+			vkCmdEndRenderPass(drawCmdBuffers[i]);
+
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+			benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, "postprocess");
+			postProcess->draw(drawCmdBuffers[i]);
+			benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
 			
+			benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, "ui");
 			drawUI(drawCmdBuffers[i]);
+			benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
+			benchmark.gpuProfiler.endStatistics(drawCmdBuffers[i], i);
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -827,7 +1140,14 @@ public:
 		// We let tinygltf handle this, by passing the asset manager of our app
 		tinygltf::asset_manager = androidApp->activity->assetManager;
 #endif
-		bool fileLoaded = gltfContext.LoadASCIIFromFile(&glTFInput, &error, &warning, filename);
+		// Binary glTF (.glb) files are parsed from a mapping of the file, text files are read by tinygltf
+		bool fileLoaded = false;
+		vks::MappedFile file;
+		if (file.open(filename) && (file.size >= 4) && (memcmp(file.data, "glTF", 4) == 0)) {
+			fileLoaded = gltfContext.LoadBinaryFromMemory(&glTFInput, &error, &warning, reinterpret_cast<const unsigned char*>(file.data), static_cast<unsigned int>(file.size), filename.substr(0, filename.find_last_of('/')));
+		} else {
+			fileLoaded = gltfContext.LoadASCIIFromFile(&glTFInput, &error, &warning, filename);
+		}
 
 		// Pass some Vulkan resources required for setup and rendering to the glTF model loading class
 		glTFModel.vulkanDevice = vulkanDevice;
@@ -862,29 +1182,6 @@ public:
 		size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
 		glTFModel.indices.count = static_cast<uint32_t>(indexBuffer.size());
 
-		struct StagingBuffer {
-			VkBuffer buffer;
-			VkDeviceMemory memory;
-		} vertexStaging, indexStaging;
-
-		// Create host visible staging buffers (source)
-		//ɼʱԴ
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			vertexBufferSize,
-			&vertexStaging.buffer,
-			&vertexStaging.memory,
-			vertexBuffer.data()));
-		// Index data
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			indexBufferSize,
-			&indexStaging.buffer,
-			&indexStaging.memory,
-			indexBuffer.data()));
-
 		// Create device local buffers (target)
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
@@ -899,33 +1196,11 @@ public:
 			&glTFModel.indices.buffer,
 			&glTFModel.indices.memory));
 
-		// Copy data from staging buffers (host) do device local buffer (gpu)
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBufferCopy copyRegion = {};
-
-		copyRegion.size = vertexBufferSize;
-		vkCmdCopyBuffer(
-			copyCmd,
-			vertexStaging.buffer,
-			glTFModel.vertices.buffer,
-			1,
-			&copyRegion);
-
-		copyRegion.size = indexBufferSize;
-		vkCmdCopyBuffer(
-			copyCmd,
-			indexStaging.buffer,
-			glTFModel.indices.buffer,
-			1,
-			&copyRegion);
-
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
-
-		// Free staging resources
-		vkDestroyBuffer(device, vertexStaging.buffer, nullptr);
-		vkFreeMemory(device, vertexStaging.memory, nullptr);
-		vkDestroyBuffer(device, indexStaging.buffer, nullptr);
-		vkFreeMemory(device, indexStaging.memory, nullptr);
+		// Copy data through the device's staging ring (host) to the device local buffers (gpu)
+		// The copies are submitted with the other pending uploads before the first frame
+		vks::StagingRing* stagingRing = vulkanDevice->getStagingRing();
+		stagingRing->copyToBuffer(vertexBuffer.data(), vertexBufferSize, glTFModel.vertices.buffer);
+		stagingRing->copyToBuffer(indexBuffer.data(), indexBufferSize, glTFModel.indices.buffer);
 	}
 
 	void loadAssets()
@@ -940,12 +1215,14 @@ public:
 	*/
 
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 + static_cast<uint32_t>(glTFModel.linearMeshNodes.size())),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			// All node matrices are read through one dynamic uniform buffer
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1),
 			// One combined image sampler per model image/texture
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(glTFModel.images.size())),
 		};
-		// One set for matrices and one per model image/texture
-		const uint32_t maxSetCount = static_cast<uint32_t>(glTFModel.images.size()) + static_cast<uint32_t>(glTFModel.linearMeshNodes.size()) + 1;
+		// One set for matrices, one for the node matrices and one per model image/texture
+		const uint32_t maxSetCount = static_cast<uint32_t>(glTFModel.images.size()) + 2;
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxSetCount);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
@@ -980,25 +1257,17 @@ public:
 
 		{
 			// Descriptor set 2 layout : passing glTF Node data
+			// The same set is used for all nodes, the matrix of a node is selected with the dynamic offset passed when binding it
 			VkDescriptorSetLayoutBinding setLayoutBinding = vks::initializers::descriptorSetLayoutBinding(
-				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0);
 			VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(&setLayoutBinding, 1);
-			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.nodes))
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayouts.nodes));
 
-				// Descriptor Sets for glTF Node data
-				for (auto& meshNode : glTFModel.linearMeshNodes)
-				{
-					if (!meshNode->mesh.primitives.empty())
-					{
-						const VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.nodes, 1);
-						VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &meshNode->mesh.uniformBuffer.descriptorSet));
-						//VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &node->mesh.uniformBuffer.descriptorSet));
-						VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(
-							meshNode->mesh.uniformBuffer.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0,
-							&meshNode->mesh.uniformBuffer.buffer.descriptor);
-						vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
-					}
-				}
+			const VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.nodes, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &glTFModel.nodeTransforms.descriptorSet));
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(
+				glTFModel.nodeTransforms.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &glTFModel.nodeTransforms.buffer.descriptor);
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
 		}
 
 		// Pipeline Layout using both descriptor sets (set 0 = matrices, set 1 = material, set2 = node)
@@ -1017,6 +1286,15 @@ public:
 
 	void preparePipelines()
 	{
+		// Pipelines are recreated when their shaders are reloaded
+		if (pipelines.solid != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.solid, nullptr);
+		}
+		if (pipelines.wireframe != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, pipelines.wireframe, nullptr);
+			pipelines.wireframe = VK_NULL_HANDLE;
+		}
+
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
 		VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
 		VkPipelineColorBlendAttachmentState blendAttachmentStateCI = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
@@ -1042,12 +1320,14 @@ public:
 		vertexInputStateCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributes.size());
 		vertexInputStateCI.pVertexAttributeDescriptions = vertexInputAttributes.data();
 
+		// Both pipelines are created through the batch, so the modules can be deferred until a pipeline misses the pipeline cache
 		const std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {
-			loadShader(getHomeworkShadersPath() + "homework1/mesh.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
-			loadShader(getHomeworkShadersPath() + "homework1/mesh.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+			loadShader(getHomeworkShadersPath() + "homework1/mesh.vert.spv", VK_SHADER_STAGE_VERTEX_BIT, true),
+			// The lighting is evaluated in half precision with --halfprecision
+			loadShader(getShaderVariant(getHomeworkShadersPath() + "homework1/mesh.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT, true)
 		};
 
-		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, offscreenPass.renderPass, getShaderStatisticsPipelineFlags());
 		pipelineCI.pVertexInputState = &vertexInputStateCI;
 		pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
 		pipelineCI.pRasterizationState = &rasterizationStateCI;
@@ -1059,15 +1339,27 @@ public:
 		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCI.pStages = shaderStages.data();
 
+		// Pipelines are compiled in parallel, so each variant needs its own copy of the state that differs
+		vks::PipelineBatch pipelineBatch(device, pipelineCache, getThreadPool(), shaderModuleCache);
+
 		// Solid rendering pipeline
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.solid));
+		pipelineBatch.add(pipelineCI, &pipelines.solid);
 
 		// Wire frame rendering pipeline
+		VkPipelineRasterizationStateCreateInfo wireframeRasterizationStateCI = rasterizationStateCI;
+		VkGraphicsPipelineCreateInfo wireframePipelineCI = pipelineCI;
 		if (deviceFeatures.fillModeNonSolid) {
-			rasterizationStateCI.polygonMode = VK_POLYGON_MODE_LINE;
-			rasterizationStateCI.lineWidth = 1.0f;
-			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.wireframe));
+			wireframeRasterizationStateCI.polygonMode = VK_POLYGON_MODE_LINE;
+			wireframeRasterizationStateCI.lineWidth = 1.0f;
+			wireframePipelineCI.pRasterizationState = &wireframeRasterizationStateCI;
+			pipelineBatch.add(wireframePipelineCI, &pipelines.wireframe);
 		}
+
+		pipelineBatch.build();
+		reportShaderStatistics(pipelines.solid, VK_SHADER_STAGE_FRAGMENT_BIT, "mesh");
+		releaseShaderModules();
+
+		watchShaders([this]() { preparePipelines(); });
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -1083,8 +1375,8 @@ public:
 		// Map persistent
 		VK_CHECK_RESULT(shaderData.buffer.map());
 
-		//Elysia
-		glTFModel.prepareMeshUniformBuffers(vulkanDevice);
+		// One region of node matrices per command buffer
+		glTFModel.prepareNodeTransforms(vulkanDevice, static_cast<uint32_t>(drawCmdBuffers.size()));
 
 		updateUniformBuffers();
 	}
@@ -1095,17 +1387,18 @@ public:
 		shaderData.values.model = camera.matrices.view;
 		shaderData.values.viewPos = camera.viewPos;
 		memcpy(shaderData.buffer.mapped, &shaderData.values, sizeof(shaderData.values));
-		//Elysia
-		//glTFModel.updateMeshUniformBuffers();
 	}
 	
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		prepareOffscreenRenderPass();
+		prepareOffscreenTargets();
 		loadAssets();
 		prepareUniformBuffers();
 		setupDescriptors();
 		preparePipelines();
+		preparePostProcessing();
 		buildCommandBuffers();
 		prepared = true;
 	}
@@ -1119,7 +1412,7 @@ public:
 
 	virtual void render()
 	{
-		renderFrame();
+		VulkanExampleBase::prepareFrame();
 		if (camera.updated) {
 			updateUniformBuffers();
 		}
@@ -1129,6 +1422,13 @@ public:
 			updateLights();
 			glTFModel.updateAnimation(frameTimer); 
 		}
+		// The previous submission of this command buffer has finished, so its region of the node matrices can be written
+		glTFModel.updateNodeTransforms(currentBuffer);
+		VK_CHECK_RESULT(vulkanDevice->flushMappedRanges());
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
+		VulkanExampleBase::submitFrame();
 	}
 
 	virtual void viewChanged()
@@ -1147,6 +1447,29 @@ public:
 			}
 			//overlay->checkBox("test1", &test1);
 		}
+		if (overlay->header("Post processing"))
+		{
+			bool settingsChanged = false;
+			settingsChanged |= overlay->sliderFloat("Exposure", &postProcess->settings.exposure, 0.1f, 4.0f);
+			bool orderChanged = false;
+			orderChanged |= overlay->checkBox("ACES tone mapping", &tonemapping);
+			orderChanged |= overlay->checkBox("Color grading", &colorGrading);
+			orderChanged |= overlay->checkBox("Vignette", &vignette);
+			if (vignette)
+			{
+				settingsChanged |= overlay->sliderFloat("Vignette intensity", &postProcess->settings.vignetteIntensity, 0.0f, 1.0f);
+			}
+			orderChanged |= overlay->checkBox("Dithering", &dithering);
+			orderChanged |= overlay->comboBox("Effect order", &effectOrderPreset, effectOrderPresetNames);
+			if (orderChanged)
+			{
+				updateEffectOrder();
+			}
+			else if (settingsChanged)
+			{
+				postProcess->updateUniformBuffer();
+			}
+		}
 	}
 };
 
@@ -11,6 +11,7 @@
 VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 {
 	title = "Variable rate shading";
+	supportsFramesInFlight = true;
 	apiVersion = VK_API_VERSION_1_1;
 	camera.type = Camera::CameraType::firstperson;
 	camera.flipY = true;
@@ -19,17 +20,35 @@ VulkanExample::VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
 	camera.setRotationSpeed(0.25f);
 	enabledInstanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
-	enabledDeviceExtensions.push_back(VK_NV_SHADING_RATE_IMAGE_EXTENSION_NAME);
 }
 
 VulkanExample::~VulkanExample()
 {
-	vkDestroyPipeline(device, basePipelines.masked, nullptr);
-	vkDestroyPipeline(device, basePipelines.opaque, nullptr);
-	vkDestroyPipeline(device, shadingRatePipelines.masked, nullptr);
-	vkDestroyPipeline(device, shadingRatePipelines.opaque, nullptr);
+	delete basePipelines;
+	delete shadingRatePipelines;
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+	vkDestroyPipeline(device, composition.pipeline, nullptr);
+	vkDestroyPipelineLayout(device, composition.pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, composition.descriptorSetLayout, nullptr);
+	if (contentAdaptiveSupported) {
+		vkDestroyPipeline(device, adaptiveShadingRate.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, adaptiveShadingRate.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, adaptiveShadingRate.descriptorSetLayout, nullptr);
+		for (auto& frame : adaptiveShadingRate.frames) {
+			frame.parameters.destroy();
+			frame.statistics.destroy();
+		}
+		vkDestroyPipeline(device, foveation.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, foveation.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, foveation.descriptorSetLayout, nullptr);
+		for (auto& buffer : foveation.uniformBuffers) {
+			buffer.destroy();
+		}
+	}
+	destroyOffscreenFramebuffer();
+	vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
+	vkDestroySampler(device, offscreenPass.sampler, nullptr);
 	vkDestroyImageView(device, shadingRateImage.view, nullptr);
 	vkDestroyImage(device, shadingRateImage.image, nullptr);
 	vkFreeMemory(device, shadingRateImage.memory, nullptr);
@@ -39,15 +58,56 @@ VulkanExample::~VulkanExample()
 void VulkanExample::getEnabledFeatures()
 {
 	enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
-	// POI
-	enabledPhysicalDeviceShadingRateImageFeaturesNV = {};
-	enabledPhysicalDeviceShadingRateImageFeaturesNV.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADING_RATE_IMAGE_FEATURES_NV;
-	enabledPhysicalDeviceShadingRateImageFeaturesNV.shadingRateImage = VK_TRUE;
-	deviceCreatepNextChain = &enabledPhysicalDeviceShadingRateImageFeaturesNV;
+	// The content adaptive pass writes the R8_UINT shading rate image, which is an extended storage image format
+	enabledFeatures.shaderStorageImageExtendedFormats = deviceFeatures.shaderStorageImageExtendedFormats;
+}
+
+void VulkanExample::getEnabledExtensions()
+{
+	// POI: The cross-vendor VK_KHR_fragment_shading_rate is preferred, VK_NV_shading_rate_image is used on devices that only support the vendor extension
+	if (vulkanDevice->extensionSupported(VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME) && vulkanDevice->extensionSupported(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME)) {
+		VkPhysicalDeviceFragmentShadingRateFeaturesKHR fragmentShadingRateFeatures{};
+		fragmentShadingRateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_FEATURES_KHR;
+		VkPhysicalDeviceFeatures2 deviceFeatures2{};
+		deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		deviceFeatures2.pNext = &fragmentShadingRateFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+		fragmentShadingRateKHR = fragmentShadingRateFeatures.attachmentFragmentShadingRate == VK_TRUE;
+	}
+	if (fragmentShadingRateKHR) {
+		// The shading rate attachment is part of a VK_KHR_create_renderpass2 render pass, its dependencies are core in Vulkan 1.1
+		enabledDeviceExtensions.push_back(VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME);
+		enabledDeviceExtensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+		enabledPhysicalDeviceFragmentShadingRateFeaturesKHR.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_FEATURES_KHR;
+		enabledPhysicalDeviceFragmentShadingRateFeaturesKHR.attachmentFragmentShadingRate = VK_TRUE;
+		deviceCreatepNextChain = &enabledPhysicalDeviceFragmentShadingRateFeaturesKHR;
+	}
+	else {
+		enabledDeviceExtensions.push_back(VK_NV_SHADING_RATE_IMAGE_EXTENSION_NAME);
+		enabledPhysicalDeviceShadingRateImageFeaturesNV.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADING_RATE_IMAGE_FEATURES_NV;
+		enabledPhysicalDeviceShadingRateImageFeaturesNV.shadingRateImage = VK_TRUE;
+		deviceCreatepNextChain = &enabledPhysicalDeviceShadingRateImageFeaturesNV;
+	}
+
+	// Pipeline libraries are optional, material permutations are created as complete pipelines without them
+	if (vulkanDevice->extensionSupported(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) && vulkanDevice->extensionSupported(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+		graphicsPipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2 deviceFeatures2{};
+		deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		deviceFeatures2.pNext = &graphicsPipelineLibraryFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+		pipelineLibraries = graphicsPipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+	}
+	if (pipelineLibraries) {
+		enabledDeviceExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+		enabledDeviceExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+		graphicsPipelineLibraryFeatures.pNext = deviceCreatepNextChain;
+		deviceCreatepNextChain = &graphicsPipelineLibraryFeatures;
+	}
 }
 
 /*
-	If the window has been resized, we need to recreate the shading rate image
+	If the window has been resized, we need to recreate the shading rate image and the offscreen targets
 */
 void VulkanExample::handleResize()
 {
@@ -55,8 +115,11 @@ void VulkanExample::handleResize()
 	vkDestroyImageView(device, shadingRateImage.view, nullptr);
 	vkDestroyImage(device, shadingRateImage.image, nullptr);
 	vkFreeMemory(device, shadingRateImage.memory, nullptr);
-	// Recreate image
+	destroyOffscreenFramebuffer();
+	// Recreate images, the offscreen framebuffer references the shading rate image with VK_KHR_fragment_shading_rate
 	prepareShadingRateImage();
+	prepareOffscreenFramebuffer();
+	updateDescriptors();
 	resized = false;
 }
 
@@ -75,7 +138,6 @@ void VulkanExample::buildCommandBuffers()
 	clearValues[1].depthStencil = { 1.0f, 0 };
 
 	VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-	renderPassBeginInfo.renderPass = renderPass;
 	renderPassBeginInfo.renderArea.offset.x = 0;
 	renderPassBeginInfo.renderArea.offset.y = 0;
 	renderPassBeginInfo.renderArea.extent.width = width;
@@ -86,29 +148,121 @@ void VulkanExample::buildCommandBuffers()
 	const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 	const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 
+	// Stage and access of the shading rate image reads, the flags of both extensions have the same values
+	const VkPipelineStageFlags shadingRateStage = fragmentShadingRateKHR ? VK_PIPELINE_STAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR : VK_PIPELINE_STAGE_SHADING_RATE_IMAGE_BIT_NV;
+	const VkAccessFlags shadingRateAccess = fragmentShadingRateKHR ? VK_ACCESS_FRAGMENT_SHADING_RATE_ATTACHMENT_READ_BIT_KHR : VK_ACCESS_SHADING_RATE_IMAGE_READ_BIT_NV;
+	// Both generated patterns write the shading rate image at the start of the frame
+	const bool generated = enableShadingRate && (shadingRatePattern != Static);
+	const bool foveated = generated && (shadingRatePattern == Foveated);
+
+	// GPU times are logged per pattern and preset, so the benchmark results of different presets can be compared
+	std::string patternName = "full rate";
+	if (enableShadingRate) {
+		const std::string patternNames[3] = { "static pattern", "content adaptive", foveationPresets[foveationPreset].name };
+		patternName = patternNames[shadingRatePattern];
+	}
+	const std::string generationScope = "Shading rate generation (" + patternName + ")";
+	const std::string sceneScope = "Scene (" + patternName + ")";
+
+	struct CompositionPushConstants {
+		int32_t texelSize[2];
+		int32_t colorShadingRates;
+	} compositionPushConstants;
+	compositionPushConstants.texelSize[0] = static_cast<int32_t>(shadingRateImage.texelSize.width);
+	compositionPushConstants.texelSize[1] = static_cast<int32_t>(shadingRateImage.texelSize.height);
+	compositionPushConstants.colorShadingRates = (enableShadingRate && colorShadingRate) ? 1 : 0;
+
+	// Permutations used for the first time are fast-linked here
+	(enableShadingRate ? shadingRatePipelines : basePipelines)->assign(scene);
+
 	for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 	{
-		renderPassBeginInfo.framebuffer = frameBuffers[i];
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		benchmark.gpuProfiler.reset(drawCmdBuffers[i], i);
+
+		// [POI] Derive the shading rates from the previous frame's color and depth, which the offscreen render pass leaves in shader read layouts,
+		// or around the fovea center of the current frame
+		if (generated) {
+			benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, generationScope);
+			// Both passes accumulate their invocation estimate into the statistics of the frame
+			AdaptiveShadingRate::FrameResources& frame = adaptiveShadingRate.frames[i];
+			vkCmdFillBuffer(drawCmdBuffers[i], frame.statistics.buffer, 0, VK_WHOLE_SIZE, 0);
+
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = frame.statistics.buffer;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			// The shading rate image stays in the general layout, so the previous frame's reads only need to finish before it is written
+			VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+			imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+			imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			imageBarrier.srcAccessMask = 0;
+			imageBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			imageBarrier.image = shadingRateImage.image;
+			imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT | shadingRateStage | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 1, &imageBarrier);
+
+			if (foveated) {
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, foveation.pipeline);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, foveation.pipelineLayout, 0, 1, &foveation.descriptorSets[i], 0, nullptr);
+				// One invocation per texel of the shading rate image
+				vkCmdDispatch(drawCmdBuffers[i], (shadingRateImage.extent.width + 7) / 8, (shadingRateImage.extent.height + 7) / 8, 1);
+			}
+			else {
+				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, adaptiveShadingRate.pipeline);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, adaptiveShadingRate.pipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+				// One workgroup per texel of the shading rate image
+				vkCmdDispatch(drawCmdBuffers[i], shadingRateImage.extent.width, shadingRateImage.extent.height, 1);
+			}
+
+			// Make the shading rates visible to the rasterizer and the composition, and the statistics to the host
+			imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			imageBarrier.dstAccessMask = shadingRateAccess | VK_ACCESS_SHADER_READ_BIT;
+			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, shadingRateStage | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 1, &imageBarrier);
+			benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
+		}
+
+		// Scene
+		benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, sceneScope);
+		renderPassBeginInfo.renderPass = offscreenPass.renderPass;
+		renderPassBeginInfo.framebuffer = offscreenPass.frameBuffer;
 		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
 		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 
 		// POI: Bind the image that contains the shading rate patterns
-		if (enableShadingRate) {
-			vkCmdBindShadingRateImageNV(drawCmdBuffers[i], shadingRateImage.view, VK_IMAGE_LAYOUT_SHADING_RATE_OPTIMAL_NV);
+		// With VK_KHR_fragment_shading_rate the image is an attachment of the render pass instead, which only the shading rate pipelines use
+		if (enableShadingRate && !fragmentShadingRateKHR) {
+			vkCmdBindShadingRateImageNV(drawCmdBuffers[i], shadingRateImage.view, VK_IMAGE_LAYOUT_GENERAL);
 		};
 
-		// Render the scene
-		Pipelines& pipelines = enableShadingRate ? shadingRatePipelines : basePipelines;
-		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.opaque);
-		scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::RenderOpaqueNodes, pipelineLayout);
-		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.masked);
-		scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::RenderAlphaMaskedNodes, pipelineLayout);
+		// Render the scene, every primitive is drawn with the permutation of its material
+		scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::BindMaterialPipelines | vkglTF::RenderFlags::RenderOpaqueNodes, pipelineLayout);
+		scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages | vkglTF::RenderFlags::BindMaterialPipelines | vkglTF::RenderFlags::RenderAlphaMaskedNodes, pipelineLayout);
+		vkCmdEndRenderPass(drawCmdBuffers[i]);
+		benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
+
+		// Composition
+		benchmark.gpuProfiler.beginScope(drawCmdBuffers[i], i, "Composition");
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.framebuffer = frameBuffers[i];
+		vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, composition.pipeline);
+		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, composition.pipelineLayout, 0, 1, &composition.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(drawCmdBuffers[i], composition.pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(CompositionPushConstants), &compositionPushConstants);
+		vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
 		drawUI(drawCmdBuffers[i]);
 		vkCmdEndRenderPass(drawCmdBuffers[i]);
+		benchmark.gpuProfiler.endScope(drawCmdBuffers[i], i);
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
 }
@@ -116,20 +270,27 @@ void VulkanExample::buildCommandBuffers()
 void VulkanExample::loadAssets()
 {
 	vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor | vkglTF::DescriptorBindingFlags::ImageNormalMap;
-	scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices);
+	// Image decoding and vertex extraction are spread across all cores
+	threadPool.setThreadCount(std::max(1u, std::thread::hardware_concurrency()));
+	scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PreTransformVertices, 1.0f, &threadPool);
 }
 
 void VulkanExample::setupDescriptors()
 {
 	// Pool
+	// The content adaptive and foveation passes have a set per swapchain image, with their parameters and statistics
+	const uint32_t frameCount = static_cast<uint32_t>(adaptiveShadingRate.frames.size());
 	const std::vector<VkDescriptorPoolSize> poolSizes = {
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 + frameCount * 2),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 + frameCount * 2),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, std::max(frameCount * 2, 1u)),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, std::max(frameCount * 2, 1u)),
 	};
-	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2 + frameCount * 2);
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
 	// Descriptor set layout
-	const std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
 		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
 	};
 	VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
@@ -150,6 +311,96 @@ void VulkanExample::setupDescriptors()
 		vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &shaderData.buffer.descriptor),
 	};
 	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+	// Composition
+	setLayoutBindings = {
+		// Binding 0 : Offscreen color
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+		// Binding 1 : Shading rate image (visualization)
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+	};
+	descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &composition.descriptorSetLayout));
+	// Texel size of the shading rate image and visualization toggle
+	VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, 3 * sizeof(int32_t), 0);
+	pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&composition.descriptorSetLayout, 1);
+	pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &composition.pipelineLayout));
+	allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &composition.descriptorSetLayout, 1);
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &composition.descriptorSet));
+
+	// Content adaptive shading rate pass
+	if (contentAdaptiveSupported) {
+		setLayoutBindings = {
+			// Binding 0 : Previous frame's color
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Previous frame's depth
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Shading rate image
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3 : Parameters
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			// Binding 4 : Statistics
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &adaptiveShadingRate.descriptorSetLayout));
+		pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&adaptiveShadingRate.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &adaptiveShadingRate.pipelineLayout));
+		for (auto& frame : adaptiveShadingRate.frames) {
+			allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &adaptiveShadingRate.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &frame.descriptorSet));
+		}
+
+		// Foveation pass
+		setLayoutBindings = {
+			// Binding 0 : Shading rate image
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Parameters
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Statistics
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &foveation.descriptorSetLayout));
+		pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&foveation.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &foveation.pipelineLayout));
+		foveation.descriptorSets.resize(frameCount);
+		for (auto& set : foveation.descriptorSets) {
+			allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &foveation.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &set));
+		}
+	}
+
+	updateDescriptors();
+}
+
+// Write the descriptors of the images that are recreated on resize
+void VulkanExample::updateDescriptors()
+{
+	VkDescriptorImageInfo colorDescriptor = vks::initializers::descriptorImageInfo(offscreenPass.sampler, offscreenPass.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	VkDescriptorImageInfo depthDescriptor = vks::initializers::descriptorImageInfo(offscreenPass.sampler, offscreenPass.depth.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+	VkDescriptorImageInfo shadingRateSampledDescriptor = vks::initializers::descriptorImageInfo(offscreenPass.sampler, shadingRateImage.view, VK_IMAGE_LAYOUT_GENERAL);
+	VkDescriptorImageInfo shadingRateStorageDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, shadingRateImage.view, VK_IMAGE_LAYOUT_GENERAL);
+
+	std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+		vks::initializers::writeDescriptorSet(composition.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &colorDescriptor),
+		vks::initializers::writeDescriptorSet(composition.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &shadingRateSampledDescriptor),
+	};
+	for (auto& frame : adaptiveShadingRate.frames) {
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &colorDescriptor));
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &depthDescriptor));
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &shadingRateStorageDescriptor));
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &frame.parameters.descriptor));
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &frame.statistics.descriptor));
+	}
+	for (size_t i = 0; i < foveation.descriptorSets.size(); i++) {
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(foveation.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0, &shadingRateStorageDescriptor));
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(foveation.descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &foveation.uniformBuffers[i].descriptor));
+		writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(foveation.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &adaptiveShadingRate.frames[i].statistics.descriptor));
+	}
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 }
 
 // [POI]
@@ -158,9 +409,10 @@ void VulkanExample::prepareShadingRateImage()
 	// Shading rate image size depends on shading rate texel size
 	// For each texel in the target image, there is a corresponding shading texel size width x height block in the shading rate image
 	VkExtent3D imageExtent{};
-	imageExtent.width = static_cast<uint32_t>(ceil(width / (float)physicalDeviceShadingRateImagePropertiesNV.shadingRateTexelSize.width));
-	imageExtent.height = static_cast<uint32_t>(ceil(height / (float)physicalDeviceShadingRateImagePropertiesNV.shadingRateTexelSize.height));
+	imageExtent.width = static_cast<uint32_t>(ceil(width / (float)shadingRateImage.texelSize.width));
+	imageExtent.height = static_cast<uint32_t>(ceil(height / (float)shadingRateImage.texelSize.height));
 	imageExtent.depth = 1;
+	shadingRateImage.extent = imageExtent;
 
 	VkImageCreateInfo imageCI{};
 	imageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -173,7 +425,11 @@ void VulkanExample::prepareShadingRateImage()
 	imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
 	imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	imageCI.usage = VK_IMAGE_USAGE_SHADING_RATE_IMAGE_BIT_NV | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	imageCI.usage = (fragmentShadingRateKHR ? VK_IMAGE_USAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR : VK_IMAGE_USAGE_SHADING_RATE_IMAGE_BIT_NV) | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	// The content adaptive pass writes the image in place
+	if (contentAdaptiveSupported) {
+		imageCI.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+	}
 	VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &shadingRateImage.image));
 	VkMemoryRequirements memReqs{};
 	vkGetImageMemoryRequirements(device, shadingRateImage.image, &memReqs);
@@ -199,36 +455,52 @@ void VulkanExample::prepareShadingRateImage()
 	imageViewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &shadingRateImage.view));
 
+	// Texel values for a fragment size, the KHR extension encodes the base 2 logarithms of the size, the NV extension indexes the palette set up in preparePipelines
+	auto encodeShadingRate = [this](uint32_t fragmentWidth, uint32_t fragmentHeight) -> uint8_t {
+		const uint32_t widthLog2 = (fragmentWidth >= 4) ? 2 : (fragmentWidth >= 2) ? 1 : 0;
+		const uint32_t heightLog2 = (fragmentHeight >= 4) ? 2 : (fragmentHeight >= 2) ? 1 : 0;
+		if (fragmentShadingRateKHR) {
+			return static_cast<uint8_t>((widthLog2 << 2) | heightLog2);
+		}
+		const uint8_t paletteIndices[9] = { 5, 7, 7, 6, 8, 10, 6, 9, 11 };
+		return paletteIndices[widthLog2 * 3 + heightLog2];
+	};
+
 	// Populate with lowest possible shading rate pattern
-	uint8_t val = VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_4X4_PIXELS_NV;
 	uint8_t* shadingRatePatternData = new uint8_t[bufferSize];
-	memset(shadingRatePatternData, val, bufferSize);
-
-	// Create a circular pattern with decreasing sampling rates outwards (max. range, pattern)
-	std::map<float, VkShadingRatePaletteEntryNV> patternLookup = {
-		{ 8.0f, VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_PIXEL_NV },
-		{ 12.0f, VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_2X1_PIXELS_NV },
-		{ 16.0f, VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_1X2_PIXELS_NV },
-		{ 18.0f, VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_2X2_PIXELS_NV },
-		{ 20.0f, VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_4X2_PIXELS_NV },
-		{ 24.0f, VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_2X4_PIXELS_NV }
+	memset(shadingRatePatternData, encodeShadingRate(4, 4), bufferSize);
+
+	// Create a circular pattern with decreasing sampling rates outwards (max. range, fragment size)
+	std::map<float, VkExtent2D> patternLookup = {
+		{ 8.0f, { 1, 1 } },
+		{ 12.0f, { 2, 1 } },
+		{ 16.0f, { 1, 2 } },
+		{ 18.0f, { 2, 2 } },
+		{ 20.0f, { 4, 2 } },
+		{ 24.0f, { 2, 4 } }
 	};
 
+	// The static pattern's cost relative to full rate shading only depends on its fragment sizes
+	double invocations = 0.0;
 	uint8_t* ptrData = shadingRatePatternData;
 	for (uint32_t y = 0; y < imageExtent.height; y++) {
 		for (uint32_t x = 0; x < imageExtent.width; x++) {
 			const float deltaX = (float)imageExtent.width / 2.0f - (float)x;
 			const float deltaY = ((float)imageExtent.height / 2.0f - (float)y) * ((float)width / (float)height);
 			const float dist = std::sqrt(deltaX * deltaX + deltaY * deltaY);
+			VkExtent2D fragmentSize = { 4, 4 };
 			for (auto pattern : patternLookup) {
 				if (dist < pattern.first) {
-					*ptrData = pattern.second;
+					fragmentSize = pattern.second;
 					break;
 				}
 			}
+			*ptrData = encodeShadingRate(fragmentSize.width, fragmentSize.height);
+			invocations += 1.0 / (fragmentSize.width * fragmentSize.height);
 			ptrData++;
 		}
 	}
+	staticShadingCost = static_cast<float>(invocations / (imageExtent.width * imageExtent.height));
 
 	VkBuffer stagingBuffer;
 	VkDeviceMemory stagingMemory;
@@ -283,7 +555,8 @@ void VulkanExample::prepareShadingRateImage()
 		VkImageMemoryBarrier imageMemoryBarrier{};
 		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADING_RATE_OPTIMAL_NV;
+		// The general layout is valid for reads by both extensions, the content adaptive pass and the composition
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
 		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 		imageMemoryBarrier.dstAccessMask = 0;
 		imageMemoryBarrier.image = shadingRateImage.image;
@@ -296,85 +569,338 @@ void VulkanExample::prepareShadingRateImage()
 	vkDestroyBuffer(device, stagingBuffer, nullptr);
 }
 
+void VulkanExample::createAttachment(VkFormat format, VkImageUsageFlags usage, FrameBufferAttachment *attachment)
+{
+	VkImageAspectFlags aspectMask = 0;
+	if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) {
+		aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+	if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+		// Depth only formats are used, so the depth attachment can be sampled through this view
+		aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	}
+
+	VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+	imageCI.imageType = VK_IMAGE_TYPE_2D;
+	imageCI.format = format;
+	imageCI.extent.width = width;
+	imageCI.extent.height = height;
+	imageCI.extent.depth = 1;
+	imageCI.mipLevels = 1;
+	imageCI.arrayLayers = 1;
+	imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+	// Both attachments are read by the composition or the content adaptive pass
+	imageCI.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &attachment->image));
+
+	VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+	VkMemoryRequirements memReqs;
+	vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
+	memAlloc.allocationSize = memReqs.size;
+	memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->memory));
+	VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->memory, 0));
+
+	VkImageViewCreateInfo imageViewCI = vks::initializers::imageViewCreateInfo();
+	imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	imageViewCI.format = format;
+	imageViewCI.subresourceRange = { aspectMask, 0, 1, 0, 1 };
+	imageViewCI.image = attachment->image;
+	VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &attachment->view));
+}
+
+// [POI] The offscreen render pass leaves color and depth in shader read layouts for the composition and the next frame's content adaptive pass
+void VulkanExample::prepareOffscreenRenderPass()
+{
+	std::array<VkSubpassDependency, 2> dependencies;
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	dependencies[1].dependencyFlags = 0;
+
+	if (fragmentShadingRateKHR) {
+		// With VK_KHR_fragment_shading_rate the shading rate image is a subpass attachment, which requires VK_KHR_create_renderpass2
+		std::array<VkAttachmentDescription2KHR, 3> attachments{};
+		for (auto& attachment : attachments) {
+			attachment.sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2;
+			attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+			attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		}
+		attachments[0].format = offscreenPass.colorFormat;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		attachments[1].format = offscreenPass.depthFormat;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		// The shading rate image keeps its contents and its general layout
+		attachments[2].format = VK_FORMAT_R8_UINT;
+		attachments[2].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		attachments[2].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[2].initialLayout = VK_IMAGE_LAYOUT_GENERAL;
+		attachments[2].finalLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkAttachmentReference2KHR colorReference{ VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2, nullptr, 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT };
+		VkAttachmentReference2KHR depthReference{ VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2, nullptr, 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT };
+		VkAttachmentReference2KHR shadingRateReference{ VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2, nullptr, 2, VK_IMAGE_LAYOUT_GENERAL, 0 };
+
+		VkFragmentShadingRateAttachmentInfoKHR fragmentShadingRateAttachmentInfo{};
+		fragmentShadingRateAttachmentInfo.sType = VK_STRUCTURE_TYPE_FRAGMENT_SHADING_RATE_ATTACHMENT_INFO_KHR;
+		fragmentShadingRateAttachmentInfo.pFragmentShadingRateAttachment = &shadingRateReference;
+		fragmentShadingRateAttachmentInfo.shadingRateAttachmentTexelSize = shadingRateImage.texelSize;
+
+		VkSubpassDescription2KHR subpassDescription{};
+		subpassDescription.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2;
+		subpassDescription.pNext = &fragmentShadingRateAttachmentInfo;
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = 1;
+		subpassDescription.pColorAttachments = &colorReference;
+		subpassDescription.pDepthStencilAttachment = &depthReference;
+
+		std::array<VkSubpassDependency2KHR, 2> dependencies2{};
+		for (size_t i = 0; i < dependencies.size(); i++) {
+			dependencies2[i].sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2;
+			dependencies2[i].srcSubpass = dependencies[i].srcSubpass;
+			dependencies2[i].dstSubpass = dependencies[i].dstSubpass;
+			dependencies2[i].srcStageMask = dependencies[i].srcStageMask;
+			dependencies2[i].dstStageMask = dependencies[i].dstStageMask;
+			dependencies2[i].srcAccessMask = dependencies[i].srcAccessMask;
+			dependencies2[i].dstAccessMask = dependencies[i].dstAccessMask;
+			dependencies2[i].dependencyFlags = dependencies[i].dependencyFlags;
+		}
+
+		VkRenderPassCreateInfo2KHR renderPassCI{};
+		renderPassCI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2;
+		renderPassCI.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassCI.pAttachments = attachments.data();
+		renderPassCI.subpassCount = 1;
+		renderPassCI.pSubpasses = &subpassDescription;
+		renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies2.size());
+		renderPassCI.pDependencies = dependencies2.data();
+		VK_CHECK_RESULT(vkCreateRenderPass2KHR(device, &renderPassCI, nullptr, &offscreenPass.renderPass));
+	}
+	else {
+		// The NV shading rate image is bound to the command buffer and not part of the render pass
+		std::array<VkAttachmentDescription, 2> attachments{};
+		attachments[0].format = offscreenPass.colorFormat;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		attachments[1].format = offscreenPass.depthFormat;
+		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpassDescription{};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = 1;
+		subpassDescription.pColorAttachments = &colorReference;
+		subpassDescription.pDepthStencilAttachment = &depthReference;
+
+		VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+		renderPassCI.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassCI.pAttachments = attachments.data();
+		renderPassCI.subpassCount = 1;
+		renderPassCI.pSubpasses = &subpassDescription;
+		renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassCI.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &offscreenPass.renderPass));
+	}
+
+	// Shared by color, depth and the shading rate image, nearest filtering so the composition and compute pass read exact texels
+	VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+	samplerCI.magFilter = VK_FILTER_NEAREST;
+	samplerCI.minFilter = VK_FILTER_NEAREST;
+	samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCI.maxLod = 1.0f;
+	samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &offscreenPass.sampler));
+}
+
+void VulkanExample::prepareOffscreenFramebuffer()
+{
+	createAttachment(offscreenPass.colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &offscreenPass.color);
+	createAttachment(offscreenPass.depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, &offscreenPass.depth);
+
+	std::vector<VkImageView> attachments = { offscreenPass.color.view, offscreenPass.depth.view };
+	if (fragmentShadingRateKHR) {
+		attachments.push_back(shadingRateImage.view);
+	}
+	VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+	framebufferCI.renderPass = offscreenPass.renderPass;
+	framebufferCI.attachmentCount = static_cast<uint32_t>(attachments.size());
+	framebufferCI.pAttachments = attachments.data();
+	framebufferCI.width = width;
+	framebufferCI.height = height;
+	framebufferCI.layers = 1;
+	VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &offscreenPass.frameBuffer));
+
+	// The first content adaptive pass reads the attachments before the scene has been rendered into them
+	VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	vks::tools::setImageLayout(layoutCmd, offscreenPass.color.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	vks::tools::setImageLayout(layoutCmd, offscreenPass.depth.image, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+}
+
+void VulkanExample::destroyOffscreenFramebuffer()
+{
+	for (auto attachment : { &offscreenPass.color, &offscreenPass.depth }) {
+		vkDestroyImageView(device, attachment->view, nullptr);
+		vkDestroyImage(device, attachment->image, nullptr);
+		vkFreeMemory(device, attachment->memory, nullptr);
+	}
+	vkDestroyFramebuffer(device, offscreenPass.frameBuffer, nullptr);
+}
+
+void VulkanExample::prepareAdaptiveShadingRate()
+{
+	adaptiveShadingRate.frames.resize(drawCmdBuffers.size());
+	for (auto& frame : adaptiveShadingRate.frames) {
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&frame.parameters,
+			sizeof(AdaptiveShadingRate::Parameters)));
+		VK_CHECK_RESULT(frame.parameters.map());
+		// Fragment shader invocations estimated by the compute pass, cleared at the start of each command buffer
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&frame.statistics,
+			sizeof(uint32_t)));
+		VK_CHECK_RESULT(frame.statistics.map());
+		memset(frame.statistics.mapped, 0, sizeof(uint32_t));
+	}
+	foveation.uniformBuffers.resize(drawCmdBuffers.size());
+	for (auto& buffer : foveation.uniformBuffers) {
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&buffer,
+			sizeof(Foveation::Parameters)));
+		VK_CHECK_RESULT(buffer.map());
+	}
+}
+
 void VulkanExample::preparePipelines()
 {
-	VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
-	VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
-	VkPipelineColorBlendAttachmentState blendAttachmentStateCI = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
-	VkPipelineColorBlendStateCreateInfo colorBlendStateCI = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentStateCI);
-	VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
-	VkPipelineViewportStateCreateInfo viewportStateCI = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
-	VkPipelineMultisampleStateCreateInfo multisampleStateCI = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
-	const std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-	VkPipelineDynamicStateCreateInfo dynamicStateCI = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables.data(), static_cast<uint32_t>(dynamicStateEnables.size()), 0);
+	const VkPipelineVertexInputStateCreateInfo vertexInputState = *vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Tangent });
+	const std::string vertexShader = getHomeworkShadersPath() + "homework2/scene.vert.spv";
+	const std::string fragmentShader = getHomeworkShadersPath() + "homework2/scene.frag.spv";
+
+	// Permutations without shading rate
+	// Properties for alpha masked materials are passed via specialization constants
+	basePipelines = new vkglTF::PipelinePermutations(vulkanDevice, pipelineCache, pipelineLayout, offscreenPass.renderPass, vertexInputState, vertexShader, fragmentShader, pipelineLibraries, 0.5f);
+
+	// Permutations with shading rate enabled
+	if (fragmentShadingRateKHR) {
+		// [POI] The pipeline's rate is kept by the primitive combiner and replaced by the attachment's rate
+		fragmentShadingRateState.sType = VK_STRUCTURE_TYPE_PIPELINE_FRAGMENT_SHADING_RATE_STATE_CREATE_INFO_KHR;
+		fragmentShadingRateState.fragmentSize = { 1, 1 };
+		fragmentShadingRateState.combinerOps[0] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
+		fragmentShadingRateState.combinerOps[1] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_REPLACE_KHR;
+		shadingRatePipelines = new vkglTF::PipelinePermutations(vulkanDevice, pipelineCache, pipelineLayout, offscreenPass.renderPass, vertexInputState, vertexShader, fragmentShader, pipelineLibraries, 0.5f, nullptr, &fragmentShadingRateState);
+	}
+	else {
+		// [POI] Possible per-Viewport shading rate palette entries
+		shadingRateViewportState.paletteEntries = {
+			VK_SHADING_RATE_PALETTE_ENTRY_NO_INVOCATIONS_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_16_INVOCATIONS_PER_PIXEL_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_8_INVOCATIONS_PER_PIXEL_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_4_INVOCATIONS_PER_PIXEL_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_2_INVOCATIONS_PER_PIXEL_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_PIXEL_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_2X1_PIXELS_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_1X2_PIXELS_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_2X2_PIXELS_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_4X2_PIXELS_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_2X4_PIXELS_NV,
+			VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_4X4_PIXELS_NV,
+		};
+		shadingRateViewportState.palette.shadingRatePaletteEntryCount = static_cast<uint32_t>(shadingRateViewportState.paletteEntries.size());
+		shadingRateViewportState.palette.pShadingRatePaletteEntries = shadingRateViewportState.paletteEntries.data();
+		shadingRateViewportState.createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_SHADING_RATE_IMAGE_STATE_CREATE_INFO_NV;
+		shadingRateViewportState.createInfo.shadingRateImageEnable = VK_TRUE;
+		shadingRateViewportState.createInfo.viewportCount = 1;
+		shadingRateViewportState.createInfo.pShadingRatePalettes = &shadingRateViewportState.palette;
+		shadingRatePipelines = new vkglTF::PipelinePermutations(vulkanDevice, pipelineCache, pipelineLayout, offscreenPass.renderPass, vertexInputState, vertexShader, fragmentShader, pipelineLibraries, 0.5f, &shadingRateViewportState.createInfo);
+	}
+
+	// The composition and the content adaptive pass decode the texel values of the extension in use
+	vks::SpecializationConstants<VkBool32> specializationConstants;
+	specializationConstants.set<0>(fragmentShadingRateKHR ? VK_TRUE : VK_FALSE);
+
+	// Composition
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+	VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+	VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+	VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+	VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
+	VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+	VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+	std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+	VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 	std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
+	shaderStages[0] = loadShader(getHomeworkShadersPath() + "homework2/composition.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+	shaderStages[1] = loadShader(getHomeworkShadersPath() + "homework2/composition.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+	shaderStages[1].pSpecializationInfo = specializationConstants.getInfo();
 
-	VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
-	pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
-	pipelineCI.pRasterizationState = &rasterizationStateCI;
-	pipelineCI.pColorBlendState = &colorBlendStateCI;
-	pipelineCI.pMultisampleState = &multisampleStateCI;
-	pipelineCI.pViewportState = &viewportStateCI;
-	pipelineCI.pDepthStencilState = &depthStencilStateCI;
-	pipelineCI.pDynamicState = &dynamicStateCI;
+	VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(composition.pipelineLayout, renderPass, 0);
+	pipelineCI.pVertexInputState = &emptyInputState;
+	pipelineCI.pInputAssemblyState = &inputAssemblyState;
+	pipelineCI.pRasterizationState = &rasterizationState;
+	pipelineCI.pColorBlendState = &colorBlendState;
+	pipelineCI.pMultisampleState = &multisampleState;
+	pipelineCI.pViewportState = &viewportState;
+	pipelineCI.pDepthStencilState = &depthStencilState;
+	pipelineCI.pDynamicState = &dynamicState;
 	pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
 	pipelineCI.pStages = shaderStages.data();
-	pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Tangent });
-
-    shaderStages[0] = loadShader(getHomeworkShadersPath() + "homework2/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-	shaderStages[1] = loadShader(getHomeworkShadersPath() + "homework2/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-
-	// Properties for alpha masked materials will be passed via specialization constants
-	struct SpecializationData {
-		VkBool32 alphaMask;
-		float alphaMaskCutoff;
-	} specializationData;
-	specializationData.alphaMask = false;
-	specializationData.alphaMaskCutoff = 0.5f;
-	const std::vector<VkSpecializationMapEntry> specializationMapEntries = {
-		vks::initializers::specializationMapEntry(0, offsetof(SpecializationData, alphaMask), sizeof(SpecializationData::alphaMask)),
-		vks::initializers::specializationMapEntry(1, offsetof(SpecializationData, alphaMaskCutoff), sizeof(SpecializationData::alphaMaskCutoff)),
-	};
-	VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(specializationMapEntries, sizeof(specializationData), &specializationData);
-	shaderStages[1].pSpecializationInfo = &specializationInfo;
-
-	// Create pipeline without shading rate 
-	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &basePipelines.opaque));
-	specializationData.alphaMask = true;
-	rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
-	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &basePipelines.masked));
-	rasterizationStateCI.cullMode = VK_CULL_MODE_BACK_BIT;
-	specializationData.alphaMask = false;
-
-	// Create pipeline with shading rate enabled
-	// [POI] Possible per-Viewport shading rate palette entries
-	const std::vector<VkShadingRatePaletteEntryNV> shadingRatePaletteEntries = {
-		VK_SHADING_RATE_PALETTE_ENTRY_NO_INVOCATIONS_NV,
-		VK_SHADING_RATE_PALETTE_ENTRY_16_INVOCATIONS_PER_PIXEL_NV,
-		VK_SHADING_RATE_PALETTE_ENTRY_8_INVOCATIONS_PER_PIXEL_NV,
-		VK_SHADING_RATE_PALETTE_ENTRY_4_INVOCATIONS_PER_PIXEL_NV,
-		VK_SHADING_RATE_PALETTE_ENTRY_2_INVOCATIONS_PER_PIXEL_NV,
-		VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_PIXEL_NV,
-		VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_2X1_PIXELS_NV,
-		VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_1X2_PIXELS_NV,
-		VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_2X2_PIXELS_NV,
-		VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_4X2_PIXELS_NV,
-		VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_2X4_PIXELS_NV,
-		VK_SHADING_RATE_PALETTE_ENTRY_1_INVOCATION_PER_4X4_PIXELS_NV,
-	};
-	VkShadingRatePaletteNV shadingRatePalette{};
-	shadingRatePalette.shadingRatePaletteEntryCount = static_cast<uint32_t>(shadingRatePaletteEntries.size());
-	shadingRatePalette.pShadingRatePaletteEntries = shadingRatePaletteEntries.data();
-	VkPipelineViewportShadingRateImageStateCreateInfoNV pipelineViewportShadingRateImageStateCI{};
-	pipelineViewportShadingRateImageStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_SHADING_RATE_IMAGE_STATE_CREATE_INFO_NV;
-	pipelineViewportShadingRateImageStateCI.shadingRateImageEnable = VK_TRUE;
-	pipelineViewportShadingRateImageStateCI.viewportCount = 1;
-	pipelineViewportShadingRateImageStateCI.pShadingRatePalettes = &shadingRatePalette;
-	viewportStateCI.pNext = &pipelineViewportShadingRateImageStateCI;
-	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &shadingRatePipelines.opaque));
-	specializationData.alphaMask = true;
-	rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
-	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &shadingRatePipelines.masked));
+	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &composition.pipeline));
+
+	// Content adaptive shading rate pass
+	if (contentAdaptiveSupported) {
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(adaptiveShadingRate.pipelineLayout, 0);
+		computePipelineCI.stage = loadShader(getHomeworkShadersPath() + "homework2/adaptiveshadingrate.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCI.stage.pSpecializationInfo = specializationConstants.getInfo();
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &adaptiveShadingRate.pipeline));
+
+		// Foveation pass
+		computePipelineCI = vks::initializers::computePipelineCreateInfo(foveation.pipelineLayout, 0);
+		computePipelineCI.stage = loadShader(getHomeworkShadersPath() + "homework2/foveation.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		computePipelineCI.stage.pSpecializationInfo = specializationConstants.getInfo();
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &foveation.pipeline));
+	}
 }
 
 void VulkanExample::prepareUniformBuffers()
@@ -393,34 +919,134 @@ void VulkanExample::updateUniformBuffers()
 	shaderData.values.projection = camera.matrices.perspective;
 	shaderData.values.view = camera.matrices.view;
 	shaderData.values.viewPos = camera.viewPos;
-	shaderData.values.colorShadingRate = colorShadingRate;
 	memcpy(shaderData.buffer.mapped, &shaderData.values, sizeof(shaderData.values));
 }
 
+// Written before each submission of the content adaptive pass, which reads the frame rendered with the previous view projection
+void VulkanExample::updateShadingRateParameters()
+{
+	AdaptiveShadingRate::Parameters& parameters = adaptiveShadingRate.parameters;
+	const glm::mat4 viewProjection = camera.matrices.perspective * camera.matrices.view;
+	parameters.previousInvViewProjection = glm::inverse(adaptiveShadingRate.previousViewProjection);
+	parameters.viewProjection = viewProjection;
+	parameters.extent = glm::vec2((float)width, (float)height);
+	parameters.texelSize = glm::vec2((float)shadingRateImage.texelSize.width, (float)shadingRateImage.texelSize.height);
+	parameters.zNear = camera.getNearClip();
+	parameters.zFar = camera.getFarClip();
+	memcpy(adaptiveShadingRate.frames[currentBuffer].parameters.mapped, &parameters, sizeof(AdaptiveShadingRate::Parameters));
+	adaptiveShadingRate.previousViewProjection = viewProjection;
+}
+
+// Written before each submission of the foveation pass, so the fovea follows the cursor without rebuilding the command buffers
+void VulkanExample::updateFoveationParameters()
+{
+	const FoveationPreset& preset = foveationPresets[foveationPreset];
+	Foveation::Parameters& parameters = foveation.parameters;
+	parameters.center = followCursor ? glm::clamp(mousePos, glm::vec2(0.0f), glm::vec2((float)width, (float)height)) : glm::vec2((float)width, (float)height) * 0.5f;
+	parameters.texelSize = glm::vec2((float)shadingRateImage.texelSize.width, (float)shadingRateImage.texelSize.height);
+	parameters.height = (float)height;
+	parameters.innerRadius = preset.innerRadius;
+	parameters.falloff = preset.falloff;
+	parameters.aspect = preset.aspect;
+	parameters.maxLevel = preset.maxLevel;
+	memcpy(foveation.uniformBuffers[currentBuffer].mapped, &parameters, sizeof(Foveation::Parameters));
+}
+
 void VulkanExample::prepare()
 {
 	VulkanExampleBase::prepare();
 	loadAssets();
-	
+
 	// [POI]
-	vkCmdBindShadingRateImageNV = reinterpret_cast<PFN_vkCmdBindShadingRateImageNV>(vkGetDeviceProcAddr(device, "vkCmdBindShadingRateImageNV"));
-	physicalDeviceShadingRateImagePropertiesNV.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADING_RATE_IMAGE_PROPERTIES_NV;
 	VkPhysicalDeviceProperties2 deviceProperties2{};
 	deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
-	deviceProperties2.pNext = &physicalDeviceShadingRateImagePropertiesNV;
-	vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+	if (fragmentShadingRateKHR) {
+		vkCreateRenderPass2KHR = reinterpret_cast<PFN_vkCreateRenderPass2KHR>(vkGetDeviceProcAddr(device, "vkCreateRenderPass2KHR"));
+		physicalDeviceFragmentShadingRatePropertiesKHR.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_PROPERTIES_KHR;
+		deviceProperties2.pNext = &physicalDeviceFragmentShadingRatePropertiesKHR;
+		vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+		// 16x16 texels are supported by most implementations, the texel size has to be within the limits of the device
+		const VkExtent2D& minTexelSize = physicalDeviceFragmentShadingRatePropertiesKHR.minFragmentShadingRateAttachmentTexelSize;
+		const VkExtent2D& maxTexelSize = physicalDeviceFragmentShadingRatePropertiesKHR.maxFragmentShadingRateAttachmentTexelSize;
+		shadingRateImage.texelSize.width = std::min(std::max(16u, minTexelSize.width), maxTexelSize.width);
+		shadingRateImage.texelSize.height = std::min(std::max(16u, minTexelSize.height), maxTexelSize.height);
+	}
+	else {
+		vkCmdBindShadingRateImageNV = reinterpret_cast<PFN_vkCmdBindShadingRateImageNV>(vkGetDeviceProcAddr(device, "vkCmdBindShadingRateImageNV"));
+		physicalDeviceShadingRateImagePropertiesNV.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADING_RATE_IMAGE_PROPERTIES_NV;
+		deviceProperties2.pNext = &physicalDeviceShadingRateImagePropertiesNV;
+		vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+		shadingRateImage.texelSize = physicalDeviceShadingRateImagePropertiesNV.shadingRateTexelSize;
+	}
+
+	// The content adaptive pass writes the shading rate image as an R8_UINT storage image
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8_UINT, &formatProperties);
+	contentAdaptiveSupported = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) && (enabledFeatures.shaderStorageImageExtendedFormats == VK_TRUE);
+	if (!contentAdaptiveSupported) {
+		shadingRatePattern = Static;
+	}
+
+	// The offscreen depth attachment is sampled, so a depth only format is used
+	offscreenPass.depthFormat = VK_FORMAT_D16_UNORM;
+	for (VkFormat format : { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM }) {
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+		const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+		if ((formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures) {
+			offscreenPass.depthFormat = format;
+			break;
+		}
+	}
 
 	prepareShadingRateImage();
+	prepareOffscreenRenderPass();
+	prepareOffscreenFramebuffer();
 	prepareUniformBuffers();
+	if (contentAdaptiveSupported) {
+		prepareAdaptiveShadingRate();
+	}
 	setupDescriptors();
 	preparePipelines();
 	buildCommandBuffers();
 	prepared = true;
 }
 
+void VulkanExample::draw()
+{
+	VulkanExampleBase::prepareFrame();
+	if (enableShadingRate && (shadingRatePattern != Static)) {
+		// The image's previous submission has finished, so its statistics and parameters can be accessed
+		AdaptiveShadingRate::FrameResources& frame = adaptiveShadingRate.frames[currentBuffer];
+		const uint32_t invocations = *reinterpret_cast<uint32_t*>(frame.statistics.mapped);
+		if (invocations > 0) {
+			shadingCost = (float)invocations / (float)(width * height);
+		}
+		if (shadingRatePattern == ContentAdaptive) {
+			updateShadingRateParameters();
+		}
+		else {
+			updateFoveationParameters();
+		}
+	}
+	else {
+		shadingCost = enableShadingRate ? staticShadingCost : 1.0f;
+	}
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+	VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, getFrameFence()));
+	VulkanExampleBase::submitFrame();
+}
+
 void VulkanExample::render()
 {
-	renderFrame();
+	// Swap in the link time optimized permutations once the background threads have built them
+	const bool baseUpdated = basePipelines->update();
+	const bool shadingRateUpdated = shadingRatePipelines->update();
+	if (baseUpdated || shadingRateUpdated) {
+		vulkanDevice->queueWaitIdle(queue);
+		buildCommandBuffers();
+	}
+	draw();
 	if (camera.updated) {
 		updateUniformBuffers();
 	}
@@ -428,11 +1054,54 @@ void VulkanExample::render()
 
 void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 {
-	if (overlay->checkBox("Enable shading rate", &enableShadingRate)) {
-		buildCommandBuffers();
+	if (overlay->header("Settings")) {
+		if (overlay->checkBox("Enable shading rate", &enableShadingRate)) {
+			buildCommandBuffers();
+		}
+		if (contentAdaptiveSupported) {
+			if (overlay->comboBox("Pattern", &shadingRatePattern, { "Static", "Content adaptive", "Foveated" })) {
+				if (shadingRatePattern == Static) {
+					// The generated patterns have overwritten the static pattern, recreating the image (and the framebuffer referencing it) restores it
+					vkDeviceWaitIdle(device);
+					handleResize();
+				}
+				buildCommandBuffers();
+			}
+		}
+		if (shadingRatePattern == Foveated) {
+			std::vector<std::string> presetNames;
+			for (auto& preset : foveationPresets) {
+				presetNames.push_back(preset.name);
+			}
+			// The preset is part of the profiler scope names
+			if (overlay->comboBox("Preset", &foveationPreset, presetNames)) {
+				buildCommandBuffers();
+			}
+			// Read from the per frame parameters, no rebuild required
+			FoveationPreset& preset = foveationPresets[foveationPreset];
+			overlay->sliderFloat("Fovea radius", &preset.innerRadius, 0.0f, 0.5f);
+			overlay->sliderFloat("Falloff", &preset.falloff, 0.01f, 0.25f);
+			overlay->checkBox("Follow cursor", &followCursor);
+		}
+		if (shadingRatePattern == ContentAdaptive) {
+			// Read by the compute pass from the per frame parameters, no rebuild required
+			overlay->sliderFloat("Sensitivity", &adaptiveShadingRate.parameters.sensitivity, 0.01f, 0.25f);
+			overlay->sliderFloat("Motion scale", &adaptiveShadingRate.parameters.motionScale, 0.0f, 2.0f);
+			overlay->sliderFloat("Depth threshold", &adaptiveShadingRate.parameters.depthThreshold, 0.01f, 0.5f);
+		}
+		if (overlay->checkBox("Color shading rates", &colorShadingRate)) {
+			buildCommandBuffers();
+		}
 	}
-	if (overlay->checkBox("Color shading rates", &colorShadingRate)) {
-		updateUniformBuffers();
+	if (overlay->header("Statistics")) {
+		overlay->text("API: %s", fragmentShadingRateKHR ? "VK_KHR_fragment_shading_rate" : "VK_NV_shading_rate_image");
+		overlay->text("Shading cost: %.1f%%", shadingCost * 100.0f);
+		overlay->text("Saved: %.1f%%", (1.0f - shadingCost) * 100.0f);
+	}
+	if (overlay->header("GPU times")) {
+		for (auto& result : benchmark.gpuProfiler.results) {
+			overlay->text("%s: %.3f ms", result.first.c_str(), result.second);
+		}
 	}
 }
 
@@ -8,6 +8,8 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanglTFPipelines.h"
+#include "threadpool.hpp"
 
 #define ENABLE_VALIDATION true
 
@@ -15,16 +17,126 @@ class VulkanExample : public VulkanExampleBase
 {
 public:
 	vkglTF::Model scene;
+	vks::ThreadPool threadPool;
 
 	struct ShadingRateImage {
 		VkImage image;
 		VkDeviceMemory memory;
 		VkImageView view;
+		VkExtent3D extent;
+		// Area covered by one texel of the shading rate image in pixels
+		VkExtent2D texelSize;
 	} shadingRateImage;
 
 	bool enableShadingRate = true;
 	bool colorShadingRate = false;
 
+	// The shading rate image is either filled once with a static pattern, derived from the previous frame or generated from a foveation preset by a compute pass
+	enum ShadingRatePattern { Static = 0, ContentAdaptive = 1, Foveated = 2 };
+	int32_t shadingRatePattern = ContentAdaptive;
+	// The content adaptive and foveated patterns write the R8_UINT shading rate image as a storage image
+	bool contentAdaptiveSupported = false;
+
+	// VK_KHR_fragment_shading_rate is used if supported, VK_NV_shading_rate_image otherwise
+	bool fragmentShadingRateKHR = false;
+
+	// The scene is rendered offscreen, so the content adaptive pass can read the previous frame's color and depth
+	struct FrameBufferAttachment {
+		VkImage image;
+		VkDeviceMemory memory;
+		VkImageView view;
+	};
+	struct OffscreenPass {
+		FrameBufferAttachment color, depth;
+		VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+		VkFormat depthFormat;
+		VkRenderPass renderPass;
+		VkFramebuffer frameBuffer;
+		VkSampler sampler;
+	} offscreenPass;
+
+	// Content adaptive shading rate compute pass
+	struct AdaptiveShadingRate {
+		struct Parameters {
+			glm::mat4 previousInvViewProjection;
+			glm::mat4 viewProjection;
+			glm::vec2 extent;
+			glm::vec2 texelSize;
+			// Luminance difference relative to the tile's luminance that is just noticeable
+			float sensitivity = 0.06f;
+			// Scale of the error tolerance per pixel of screen space motion
+			float motionScale = 0.5f;
+			// Relative linear depth range of a tile that is treated as a silhouette
+			float depthThreshold = 0.1f;
+			float zNear;
+			float zFar;
+		} parameters;
+		// Per swapchain image, as the parameters change every frame and the statistics are read back once the image's last submission has finished
+		struct FrameResources {
+			vks::Buffer parameters;
+			vks::Buffer statistics;
+			VkDescriptorSet descriptorSet;
+		};
+		std::vector<FrameResources> frames;
+		glm::mat4 previousViewProjection = glm::mat4(1.0f);
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} adaptiveShadingRate;
+
+	// Radial preset, distances are relative to the window height
+	struct FoveationPreset {
+		std::string name;
+		// Radius of the full rate region around the fovea center
+		float innerRadius;
+		// Width of each ring with the next coarser shading rate
+		float falloff;
+		// Horizontal scale of the distance, values below one stretch the regions horizontally to match wide lenses and displays
+		float aspect;
+		// Coarsest rate level, from 0 (1x1) to 4 (4x4)
+		int32_t maxLevel;
+	};
+	std::vector<FoveationPreset> foveationPresets = {
+		{ "Narrow fovea", 0.1f, 0.05f, 1.0f, 4 },
+		{ "Wide fovea", 0.25f, 0.1f, 1.0f, 3 },
+		{ "Lens matched", 0.2f, 0.08f, 0.75f, 4 },
+	};
+	int32_t foveationPreset = 0;
+	// The fovea center follows the cursor (standing in for the gaze position), otherwise it is the window center
+	bool followCursor = true;
+
+	// Foveated shading rate compute pass, accumulates its invocation estimate into the statistics of the content adaptive pass
+	struct Foveation {
+		struct Parameters {
+			// Fovea center in pixels
+			glm::vec2 center;
+			glm::vec2 texelSize;
+			float height;
+			float innerRadius;
+			float falloff;
+			float aspect;
+			int32_t maxLevel;
+		} parameters;
+		// Per swapchain image, as the center changes every frame
+		std::vector<vks::Buffer> uniformBuffers;
+		std::vector<VkDescriptorSet> descriptorSets;
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} foveation;
+
+	// Fragment shader invocations of the scene relative to full rate shading, estimated from the shading rate image
+	float shadingCost = 1.0f;
+	float staticShadingCost = 1.0f;
+
+	// Presents the offscreen scene and visualizes the shading rates
+	struct Composition {
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} composition;
+
 	struct ShaderData {
 		vks::Buffer buffer;
 		struct Values {
@@ -33,17 +145,21 @@ public:
 			glm::mat4 model = glm::mat4(1.0f);
 			glm::vec4 lightPos = glm::vec4(0.0f, 2.5f, 0.0f, 1.0f);
 			glm::vec4 viewPos;
-			int32_t colorShadingRate;
 		} values;
 	} shaderData;
 
-	struct Pipelines {
-		VkPipeline opaque;
-		VkPipeline masked;
-	};
+	// Material permutations with and without the shading rate image
+	vkglTF::PipelinePermutations* basePipelines = nullptr;
+	vkglTF::PipelinePermutations* shadingRatePipelines = nullptr;
 
-	Pipelines basePipelines;
-	Pipelines shadingRatePipelines;
+	// Viewport state of the shading rate pipelines, which are created on demand
+	struct ShadingRateViewportState {
+		std::vector<VkShadingRatePaletteEntryNV> paletteEntries;
+		VkShadingRatePaletteNV palette{};
+		VkPipelineViewportShadingRateImageStateCreateInfoNV createInfo{};
+	} shadingRateViewportState;
+	// Pipeline state of the shading rate pipelines with VK_KHR_fragment_shading_rate, the attachment's rate replaces the pipeline's rate
+	VkPipelineFragmentShadingRateStateCreateInfoKHR fragmentShadingRateState{};
 
 	VkPipelineLayout pipelineLayout;
 	VkDescriptorSet descriptorSet;
@@ -51,21 +167,37 @@ public:
 
 	VkPhysicalDeviceShadingRateImagePropertiesNV physicalDeviceShadingRateImagePropertiesNV{};
 	VkPhysicalDeviceShadingRateImageFeaturesNV enabledPhysicalDeviceShadingRateImageFeaturesNV{};
+	VkPhysicalDeviceFragmentShadingRatePropertiesKHR physicalDeviceFragmentShadingRatePropertiesKHR{};
+	VkPhysicalDeviceFragmentShadingRateFeaturesKHR enabledPhysicalDeviceFragmentShadingRateFeaturesKHR{};
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures{};
+	// Material permutations are fast-linked from pipeline libraries if supported
+	bool pipelineLibraries = false;
 	PFN_vkCmdBindShadingRateImageNV vkCmdBindShadingRateImageNV;
+	PFN_vkCreateRenderPass2KHR vkCreateRenderPass2KHR;
 
 	VulkanExample();
 	~VulkanExample();
 	virtual void getEnabledFeatures();
+	virtual void getEnabledExtensions();
 	void handleResize();
 	void buildCommandBuffers();
 	void loadglTFFile(std::string filename);
 	void loadAssets();
 	void prepareShadingRateImage();
+	void createAttachment(VkFormat format, VkImageUsageFlags usage, FrameBufferAttachment *attachment);
+	void prepareOffscreenRenderPass();
+	void prepareOffscreenFramebuffer();
+	void destroyOffscreenFramebuffer();
+	void prepareAdaptiveShadingRate();
+	void updateDescriptors();
 	void setupDescriptors();
 	void preparePipelines();
 	void prepareUniformBuffers();
 	void updateUniformBuffers();
+	void updateShadingRateParameters();
+	void updateFoveationParameters();
 	void prepare();
+	void draw();
 	virtual void render();
 	virtual void OnUpdateUIOverlay(vks::UIOverlay* overlay);
 };
\ No newline at end of file